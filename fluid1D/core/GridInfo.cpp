@@ -19,11 +19,13 @@ along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/GridInfo.h>
 #include <core/Data.h>
+#include <core/HankelTransform.h>
+#include <core/Util.h>
 #include <cmath>
 #include <gsl/gsl_sf.h>
 
-GridInfo::GridInfo(GridInfo::CoordinateSystem coord, int S, double hMean)
-: coord(coord), S(S), rMax(S*hMean), r(S), G(S), w(S), wTilde(S)
+GridInfo::GridInfo(GridInfo::CoordinateSystem coord, int S, double hMean, bool fastTransform)
+: coord(coord), S(S), rMax(S*hMean), r(S), G(S), w(S), wTilde(S), hankel(0)
 {
 	switch(coord)
 	{
@@ -42,6 +44,10 @@ GridInfo::GridInfo(GridInfo::CoordinateSystem coord, int S, double hMean)
 				w[i] =  4 * pow(M_PI/gsl_sf_bessel_j1(x[i+1]),2) * pow(rMax/y[S],3);
 				wTilde[i] = 1. / ((i ? 2 : 4.0/3) * M_PI * pow(rMax,3) * pow(gsl_sf_bessel_j0(y[i]),2));
 			}
+			if(fastTransform)
+			{	hankel = new HankelTransform(*this);
+				break;
+			}
 			//Setup transform matrices
 			matI.resize(S*S); auto elemI = matI.begin();
 			matID.resize(S*S); auto elemID = matID.begin();
@@ -70,6 +76,8 @@ GridInfo::GridInfo(GridInfo::CoordinateSystem coord, int S, double hMean)
 				w[i] =  4*M_PI * pow(rMax/(Y[S]*gsl_sf_bessel_J1(X[i+1])), 2);
 				wTilde[i] = 1. / (M_PI * pow(rMax*gsl_sf_bessel_J0(Y[i]), 2));
 			}
+			if(fastTransform) //J0 has no trigonometric form on these non-uniform grids
+				logPrintf("NOTE: fast transforms are only available for spherical grids; using dense matrices.\n");
 			//Setup transform matrices
 			matI.resize(S*S); auto elemI = matI.begin();
 			matID.resize(S*S); auto elemID = matID.begin();
@@ -110,6 +118,7 @@ GridInfo::~GridInfo()
 	{
 		case Spherical:
 		case Cylindrical:
+			if(hankel) delete hankel;
 			break;
 			
 		case Planar:
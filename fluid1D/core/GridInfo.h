@@ -46,7 +46,8 @@ public:
 	//! @param coord Coordinate system
 	//! @param S Sample count (equal to basis function count for all implemented bases)
 	//! @param hMean Mean grid spacing, defined by rMax/S
-	GridInfo(CoordinateSystem coord, int S, double hMean);
+	//! @param fastTransform Use O(S log^2 S) fast transforms (HankelTransform) instead of dense matrices (Spherical only)
+	GridInfo(CoordinateSystem coord, int S, double hMean, bool fastTransform=false);
 	~GridInfo();
 	
 	std::vector<double> r; //!< Nodes of quadrature grid
@@ -58,6 +59,7 @@ public:
 	
 	fftw_plan planPlanarI, planPlanarIdag, planPlanarID, planPlanarIDdag; //!< FFTW plans for planar transforms
 	std::vector<double> matI, matID, matIDD; //!< Dense SxS row-major matrices for spherical/cylindrical transforms
+	class HankelTransform* hankel; //!< Fast spherical transforms used instead of the dense matrices (if non-null)
 };
 
 #endif // FLUID1D_CORE1D_DATA_H
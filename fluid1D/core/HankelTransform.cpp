@@ -0,0 +1,206 @@
+/*-------------------------------------------------------------------
+Copyright 2012 Ravishankar Sundararaman
+
+This file is part of Fluid1D.
+
+Fluid1D is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Fluid1D is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <core/HankelTransform.h>
+#include <core/GridInfo.h>
+#include <cmath>
+#include <cassert>
+#include <gsl/gsl_sf.h>
+
+//Half-width of Gaussian spreading (in oversampled grid points) and the corresponding relative error
+//of the non-uniform FFTs at oversampling ratio 2 (Greengard and Lee, Table 1), including roundoff
+static const int nSpreadDefault = 16;
+static const double epsNUFFT = 1e-14;
+
+HankelTransform::HankelTransform(const GridInfo& gInfo, double tol)
+: gInfo(gInfo), S(gInfo.S), nSpread(nSpreadDefault), theta(S)
+{	assert(gInfo.coord == GridInfo::Spherical);
+	//Non-uniform frequencies: r_j G_i = (j+1) theta_i with theta_i = r_0 G_i < pi
+	for(int i=0; i<S; i++) theta[i] = gInfo.r[0] * gInfo.G[i];
+	
+	//Oversampled grid covering modes 0 to S (at least twice the M = 2(S+1) modes of [-S-1,S+1)):
+	int M = 2*(S+1);
+	Mr = 2*M;
+	double tau = M_PI*nSpread / (3.*M*M); //optimum Gaussian width for oversampling ratio 2
+	deconv.resize(Mr/2+1);
+	for(int n=0; n<=Mr/2; n++)
+		deconv[n] = sqrt(M_PI/tau) * exp(n*n*tau) / Mr;
+	
+	//Spreading weights:
+	double dTheta = 2*M_PI/Mr;
+	spreadStart.resize(S);
+	spreadWeights.resize(S * 2*nSpread);
+	for(int i=0; i<S; i++)
+	{	spreadStart[i] = int(floor(theta[i]/dTheta)) - nSpread + 1;
+		for(int k=0; k<2*nSpread; k++)
+			spreadWeights[i*2*nSpread+k] = exp(-pow(theta[i] - (spreadStart[i]+k)*dTheta, 2) / (4*tau));
+	}
+	
+	//FFT plans:
+	double* grid = (double*)fftw_malloc(sizeof(double)*Mr);
+	fftw_complex* spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex)*(Mr/2+1));
+	planR2C = fftw_plan_dft_r2c_1d(Mr, grid, spectrum, FFTW_MEASURE);
+	planC2R = fftw_plan_dft_c2r_1d(Mr, spectrum, grid, FFTW_MEASURE);
+	fftw_free(grid);
+	fftw_free(spectrum);
+	
+	for(int kernel=KernelI; kernel<=KernelIDD; kernel++)
+		setupKernel(Kernel(kernel), tol);
+}
+
+HankelTransform::~HankelTransform()
+{	fftw_destroy_plan(planR2C);
+	fftw_destroy_plan(planC2R);
+}
+
+double HankelTransform::kernelEntry(Kernel kernel, int j, int i) const
+{	double G = gInfo.G[i], Gr = gInfo.r[j] * G;
+	switch(kernel)
+	{	case KernelI: return gsl_sf_bessel_j0(Gr);
+		case KernelID: return -G * gsl_sf_bessel_j1(Gr);
+		case KernelIDD: return pow(G,2) * gsl_sf_bessel_j2(Gr);
+	}
+	return 0.;
+}
+
+void HankelTransform::setupKernel(Kernel kernel, double tol)
+{	KernelData& kd = kernelData[kernel];
+	//Trigonometric forms (in terms of x = Gr) and small-x error amplification coeff/x^power of each kernel:
+	double ampCoeff = 1.; int ampPower = 1;
+	switch(kernel)
+	{	case KernelI: //j0 = sin x/x
+			kd.terms.push_back({-1, -1, 1., true});
+			break;
+		case KernelID: //-G j1 = -G (sin x/x^2 - cos x/x)
+			kd.terms.push_back({-2, -1, -1., true});
+			kd.terms.push_back({-1, 0, 1., false});
+			ampCoeff = 3.; ampPower = 2;
+			break;
+		case KernelIDD: //G^2 j2 = G^2 ((3/x^3 - 1/x) sin x - 3 cos x/x^2)
+			kd.terms.push_back({-3, -1, 3., true});
+			kd.terms.push_back({-1, 1, -1., true});
+			kd.terms.push_back({-2, 0, -3., false});
+			ampCoeff = 45.; ampPower = 4;
+			break;
+	}
+	for(const Term& t: kd.terms)
+	{	bool found = false;
+		for(int p: kd.colPowers) if(p == t.colPower) found = true;
+		if(!found) kd.colPowers.push_back(t.colPower);
+	}
+	
+	//Arguments below xCut are evaluated explicitly (where error amplification exceeds tol/epsNUFFT):
+	double xCut = pow(ampCoeff*epsNUFFT/tol, 1./ampPower);
+	//Row blocks n = j+1 in [n0, 4 n0), with FFT for columns i such that n0 theta_i >= xCut (and G_i > 0):
+	for(int jStart=0; jStart<S;)
+	{	int n0 = jStart+1;
+		int iStart = 1;
+		while(iStart<S && n0*theta[iStart] < xCut) iStart++;
+		int jStop = std::min(S, 4*n0-1);
+		if(kd.blocks.size() && kd.blocks.back().iStart==iStart)
+			kd.blocks.back().jStop = jStop; //merge with previous block with same FFT columns
+		else
+			kd.blocks.push_back({jStart, jStop, iStart, std::vector<double>()});
+		jStart = jStop;
+	}
+	//Explicit entries:
+	for(Block& b: kd.blocks)
+	{	b.near.resize((b.jStop-b.jStart) * b.iStart);
+		double* nearData = b.near.data();
+		for(int j=b.jStart; j<b.jStop; j++)
+			for(int i=0; i<b.iStart; i++)
+				*(nearData++) = kernelEntry(kernel, j, i);
+	}
+}
+
+//Integer power of x for the small powers (in [-3,1]) that appear in the kernel terms
+inline double ipow(double x, int p)
+{	switch(p)
+	{	case 0: return 1.;
+		case 1: return x;
+		case -1: return 1./x;
+		case -2: return 1./(x*x);
+		case -3: return 1./(x*x*x);
+		default: return pow(x, p);
+	}
+}
+
+void HankelTransform::apply(Kernel kernel, bool transpose, const double* in, double* out) const
+{	const KernelData& kd = kernelData[kernel];
+	const int nW = 2*nSpread;
+	for(int k=0; k<S; k++) out[k] = 0.;
+	double* grid = (double*)fftw_malloc(sizeof(double)*Mr);
+	fftw_complex* spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex)*(Mr/2+1));
+	for(const Block& b: kd.blocks)
+	{	//Explicit entries:
+		const double* nearData = b.near.data();
+		for(int j=b.jStart; j<b.jStop; j++)
+			for(int i=0; i<b.iStart; i++)
+			{	if(transpose) out[i] += (*nearData) * in[j];
+				else out[j] += (*nearData) * in[i];
+				nearData++;
+			}
+		if(b.iStart >= S) continue;
+		//Non-uniform FFT for each distinct column prefactor:
+		for(int colPower: kd.colPowers)
+		{	if(!transpose)
+			{	//Spread prefactor * input onto the uniform grid:
+				for(int m=0; m<Mr; m++) grid[m] = 0.;
+				for(int i=b.iStart; i<S; i++)
+				{	double a = in[i] * ipow(gInfo.G[i], colPower);
+					const double* w = &spreadWeights[i*nW];
+					for(int k=0, m=spreadStart[i]; k<nW; k++, m++)
+						grid[(m+Mr)%Mr] += a * w[k];
+				}
+				fftw_execute_dft_r2c(planR2C, grid, spectrum);
+				//Collect cos and sin sums with their row prefactors:
+				for(int j=b.jStart; j<b.jStop; j++)
+				{	int n = j+1;
+					double sumCos = deconv[n] * spectrum[n][0];
+					double sumSin = -deconv[n] * spectrum[n][1]; //r2c has the opposite sign convention
+					for(const Term& t: kd.terms) if(t.colPower == colPower)
+						out[j] += t.coeff * ipow(gInfo.r[j], t.rowPower) * (t.isSin ? sumSin : sumCos);
+				}
+			}
+			else
+			{	//Set cos and sin coefficients with their row prefactors (exact adjoint of above):
+				for(int n=0; n<=Mr/2; n++) spectrum[n][0] = spectrum[n][1] = 0.;
+				for(int j=b.jStart; j<b.jStop; j++)
+				{	int n = j+1;
+					double coeffCos = 0., coeffSin = 0.;
+					for(const Term& t: kd.terms) if(t.colPower == colPower)
+						(t.isSin ? coeffSin : coeffCos) += t.coeff * ipow(gInfo.r[j], t.rowPower) * in[j];
+					spectrum[n][0] = 0.5 * deconv[n] * coeffCos; //c2r doubles all modes other than 0 and Mr/2
+					spectrum[n][1] = -0.5 * deconv[n] * coeffSin;
+				}
+				fftw_execute_dft_c2r(planC2R, spectrum, grid);
+				//Interpolate from the uniform grid:
+				for(int i=b.iStart; i<S; i++)
+				{	const double* w = &spreadWeights[i*nW];
+					double result = 0.;
+					for(int k=0, m=spreadStart[i]; k<nW; k++, m++)
+						result += grid[(m+Mr)%Mr] * w[k];
+					out[i] += result * ipow(gInfo.G[i], colPower);
+				}
+			}
+		}
+	}
+	fftw_free(grid);
+	fftw_free(spectrum);
+}
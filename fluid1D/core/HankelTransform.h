@@ -0,0 +1,94 @@
+/*-------------------------------------------------------------------
+Copyright 2012 Ravishankar Sundararaman
+
+This file is part of Fluid1D.
+
+Fluid1D is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Fluid1D is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef FLUID1D_CORE1D_HANKELTRANSFORM_H
+#define FLUID1D_CORE1D_HANKELTRANSFORM_H
+
+/** @file HankelTransform.h
+@brief Fast spherical Bessel transforms on the spherical basis grid
+*/
+
+#include <fftw3.h>
+#include <vector>
+
+class GridInfo;
+
+/** @brief O(S log^2 S) application of the spherical basis transform matrices
+//! @ingroup griddata
+
+The spherical grid has r_j = (j+1) h (roots of j0) and arbitrary G_i (roots of j1), so that
+j0(r_j G_i), -G_i j1(r_j G_i) and G_i^2 j2(r_j G_i) (GridInfo::matI, matID and matIDD)
+are combinations of sin and cos of (j+1) h G_i with separable prefactors. These sums over
+non-uniform frequencies are evaluated with Gaussian-gridding non-uniform FFTs (Greengard and Lee,
+SIAM Review 46, 443 (2004)). The trigonometric forms cancel for small r_j G_i, so the rows are
+split into blocks (geometrically growing with r), each of which sums only columns beyond the
+small-argument region with the FFT, and the remaining (O(S log S)) entries are stored explicitly.
+Each transpose is the exact adjoint of the corresponding forward transform.
+*/
+class HankelTransform
+{
+public:
+	//! Transform matrices (with rows j in real space and columns i in the basis)
+	enum Kernel
+	{	KernelI, //!< j0(r_j G_i), same as GridInfo::matI
+		KernelID, //!< -G_i j1(r_j G_i), same as GridInfo::matID
+		KernelIDD //!< G_i^2 j2(r_j G_i), same as GridInfo::matIDD
+	};
+	
+	//! Setup transforms for a spherical grid, with relative error tolerance tol for the results
+	HankelTransform(const GridInfo& gInfo, double tol=1e-12);
+	~HankelTransform();
+	
+	//! Compute out = M.in (transpose = false) or out = M^T.in (transpose = true) for the matrix M of kernel
+	//! (Thread safe: may be called concurrently if in and out are distinct)
+	void apply(Kernel kernel, bool transpose, const double* in, double* out) const;
+	
+private:
+	const GridInfo& gInfo;
+	int S; //!< number of samples
+	int Mr; //!< length of the oversampled uniform FFT grid
+	int nSpread; //!< half-width of spreading (kernel samples on each side)
+	std::vector<double> theta; //!< h G_i: non-uniform frequencies (in [0,pi)) per unit row index
+	std::vector<double> deconv; //!< Gaussian deconvolution factor for each mode (including 1/Mr)
+	std::vector<int> spreadStart; //!< first uniform grid point for spreading each column
+	std::vector<double> spreadWeights; //!< 2*nSpread Gaussian weights for each column
+	fftw_plan planR2C, planC2R;
+	
+	//! A term of the kernel: rowScale(r) colScale(G) trig((j+1) h G), with trig = sin or cos
+	struct Term { int rowPower; int colPower; double coeff; bool isSin; }; //!< coeff r^rowPower G^colPower
+	
+	//! Block of rows with columns iStart onwards evaluated by FFT, and earlier columns stored explicitly
+	struct Block
+	{	int jStart, jStop, iStart;
+		std::vector<double> near; //!< explicit row-major entries for rows [jStart,jStop) and columns [0,iStart)
+	};
+	
+	//! Setup data for each kernel
+	struct KernelData
+	{	std::vector<Term> terms;
+		std::vector<int> colPowers; //!< distinct column powers (one non-uniform FFT each)
+		std::vector<Block> blocks;
+	};
+	KernelData kernelData[3];
+	
+	void setupKernel(Kernel kernel, double tol);
+	double kernelEntry(Kernel kernel, int j, int i) const; //!< matrix element evaluated directly
+};
+
+#endif // FLUID1D_CORE1D_HANKELTRANSFORM_H
@@ -20,6 +20,7 @@ along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Operators.h>
 #include <core/BlasExtra.h>
 #include <core/Random.h>
+#include <core/HankelTransform.h>
 
 //------------------------------ Linear Unary operators ------------------------------
 
@@ -48,6 +49,20 @@ inline void dgemv(bool transpose, const std::vector<double>& A, const ManagedMem
 		M, N, 1., A.data(), M,  X.data(),1, 0., Y.data(),1);
 }
 
+//Spherical/cylindrical basis transform (Y = M.X or M^T.X) using fast transforms if available, and dense matrices otherwise
+inline void basisTransform(HankelTransform::Kernel kernel, bool transpose, const ManagedMemory& X, ManagedMemory& Y, const GridInfo& gInfo)
+{	if(gInfo.hankel)
+	{	assert(X);
+		assert(Y);
+		gInfo.hankel->apply(kernel, transpose, X.data(), Y.data());
+	}
+	else
+	{	const std::vector<double>& A = (kernel==HankelTransform::KernelI ? gInfo.matI
+			: (kernel==HankelTransform::KernelID ? gInfo.matID : gInfo.matIDD));
+		dgemv(transpose, A, X, Y);
+	}
+}
+
 ScalarFieldTilde O(const ScalarFieldTilde& Y)
 {	ScalarFieldTilde tmp(Y);
 	return O((ScalarFieldTilde&&)tmp);
@@ -75,7 +90,7 @@ ScalarField I(const ScalarFieldTilde& Xtilde)
 		case GridInfo::Cylindrical:
 		{	ScalarFieldTilde tmp(Xtilde);
 			dmul(gInfo.wTilde, tmp); //premultiply by basis weights
-			dgemv(false, gInfo.matI, tmp, X); //multiply by matI
+			basisTransform(HankelTransform::KernelI, false, tmp, X, gInfo); //multiply by matI
 			break;
 		}
 		case GridInfo::Planar:
@@ -97,7 +112,7 @@ ScalarField ID(const ScalarFieldTilde& Xtilde)
 		case GridInfo::Cylindrical:
 		{	ScalarFieldTilde tmp(Xtilde);
 			dmul(gInfo.wTilde, tmp); //premultiply by basis weights
-			dgemv(false, gInfo.matID, tmp, X); //multiply by matID
+			basisTransform(HankelTransform::KernelID, false, tmp, X, gInfo); //multiply by matID
 			break;
 		}
 		case GridInfo::Planar:
@@ -126,7 +141,7 @@ ScalarField IDD(const ScalarFieldTilde& Xtilde)
 		case GridInfo::Cylindrical:
 		{	ScalarFieldTilde tmp(Xtilde);
 			dmul(gInfo.wTilde, tmp); //premultiply by basis weights
-			dgemv(false, gInfo.matIDD, tmp, X); //multiply by matIDD
+			basisTransform(HankelTransform::KernelIDD, false, tmp, X, gInfo); //multiply by matIDD
 			break;
 		}
 		case GridInfo::Planar:
@@ -149,7 +164,7 @@ ScalarField Jdag(const ScalarFieldTilde& Xtilde)
 	{
 		case GridInfo::Spherical:
 		case GridInfo::Cylindrical:
-		{	dgemv(false, gInfo.matI, Xtilde, X); //multiply by matI
+		{	basisTransform(HankelTransform::KernelI, false, Xtilde, X, gInfo); //multiply by matI
 			dmul(gInfo.w, X); //postmultiply by quadrature weights
 			break;
 		}
@@ -176,7 +191,7 @@ ScalarFieldTilde J(const ScalarField& X)
 		case GridInfo::Cylindrical:
 		{	ScalarField tmp(X);
 			dmul(gInfo.w, tmp); //premultiply by quadrature weights
-			dgemv(true, gInfo.matI, tmp, Xtilde); //multiply by transpose(matI)
+			basisTransform(HankelTransform::KernelI, true, tmp, Xtilde, gInfo); //multiply by transpose(matI)
 			break;
 		}
 		case GridInfo::Planar:
@@ -196,7 +211,7 @@ ScalarFieldTilde Idag(const ScalarField& X)
 	{
 		case GridInfo::Spherical:
 		case GridInfo::Cylindrical:
-		{	dgemv(true, gInfo.matI, X, Xtilde); //multiply by transpose(matI)
+		{	basisTransform(HankelTransform::KernelI, true, X, Xtilde, gInfo); //multiply by transpose(matI)
 			dmul(gInfo.wTilde, Xtilde); //postmultiply by basis weights
 			break;
 		}
@@ -218,7 +233,7 @@ ScalarFieldTilde IDdag(const ScalarField& X)
 	{
 		case GridInfo::Spherical:
 		case GridInfo::Cylindrical:
-		{	dgemv(true, gInfo.matID, X, Xtilde); //multiply by transpose(matID)
+		{	basisTransform(HankelTransform::KernelID, true, X, Xtilde, gInfo); //multiply by transpose(matID)
 			dmul(gInfo.wTilde, Xtilde); //postmultiply by basis weights
 			break;
 		}
@@ -245,7 +260,7 @@ ScalarFieldTilde IDDdag(const ScalarField& X)
 	{
 		case GridInfo::Spherical:
 		case GridInfo::Cylindrical:
-		{	dgemv(true, gInfo.matIDD, X, Xtilde); //multiply by transpose(matIDD)
+		{	basisTransform(HankelTransform::KernelIDD, true, X, Xtilde, gInfo); //multiply by transpose(matIDD)
 			dmul(gInfo.wTilde, Xtilde); //postmultiply by basis weights
 			break;
 		}
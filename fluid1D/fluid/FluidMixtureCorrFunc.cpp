@@ -23,15 +23,6 @@ along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
 #include <gsl/gsl_sf_bessel.h>
 #include <gsl/gsl_linalg.h>
 
-//Compute a^dagger.m.b for fixed size arrays
-template<int N> double contract(double m[N][N], double a[N], double b[N])
-{	double result = 0.0;
-	for(register int i=0; i<N; i++)
-		for(register int j=0; j<N; j++)
-			result += m[i][j]*a[i]*b[j];
-	return result;
-}
-
 ScalarFieldTildeCollection FluidMixture::getDirectCorrelations(const std::vector<double>& Nmol) const
 {	assert(gInfo.coord == GridInfo::Spherical);
 
@@ -108,32 +99,17 @@ ScalarFieldTildeCollection FluidMixture::getDirectCorrelations(const std::vector
 			{0,0,0,0,0,-(-5 + n3)/(3.*(-1 + n3)) - (2*log(1 - n3))/(3.*n3)},
 			{0,0,0,0,-(-5 + n3)/(3.*(-1 + n3)) - (2*log(1 - n3))/(3.*n3),(n2*(n3*(1 + (-3 + n3)*n3) + pow(-1 + n3,2)*log(1 - n3)))/(6.*pow(-1 + n3,2)*pow(n3,2)*M_PI)} };
 		
-		//First loop over all site densities
-		for(unsigned c1=0; c1<component.size(); c1++)
-		{	unsigned offs1 = component[c1].offsetDensity;
-			for(unsigned s1=0; s1<component[c1].indexedSite.size(); s1++)
-			{	const SiteProperties& prop1 = *(component[c1].indexedSite[s1]);
-				if(prop1.sphereRadius)
-				{	//Second loop over all site densities with net index lower than first one
-					for(unsigned c2=0; c2<=c1; c2++)
-					{	unsigned offs2 = component[c2].offsetDensity;
-						for(unsigned s2=0; s2<(c1==c2 ? s1+1 : component[c2].indexedSite.size()); s2++)
-						{	const SiteProperties& prop2 = *(component[c2].indexedSite[s2]);
-							if(prop2.sphereRadius)
-							{	double* Cdata = C[corrFuncIndex(offs1+s1,offs2+s2)].data();
-								for(int i=0; i<gInfo.S; i++)
-								{	double smooth = exp(-pow(0.5*gInfo.G[i]*hGrid,2)); //suppress Nyquist frequency components
-									//Collect FMT weight functions for both components at current G:
-									double weights1[6] = { (*prop1.w0)[i], (*prop1.w1)[i], (*prop1.w2)[i], (*prop1.w3)[i], gInfo.G[i]*(*prop1.w1v)[i], -gInfo.G[i]*(*prop1.w3)[i] };
-									double weights2[6] = { (*prop2.w0)[i], (*prop2.w1)[i], (*prop2.w2)[i], (*prop2.w3)[i], gInfo.G[i]*(*prop2.w1v)[i], -gInfo.G[i]*(*prop2.w3)[i] };
-									Cdata[i] += T * contract(d2phi, weights1, weights2) * smooth;
-								}
-							}
-						}
-					}
-				}
-			}
-		}
+		//Combined Hessian of the FMT and bonding terms w.r.t the FMT weighted densities, followed by
+		//the partial n0 of each molecule with bonds (which is its own weighted density in the bonding terms):
+		std::vector<int> iBonded(component.size(), -1); //index of partial n0 amongst bonded molecules
+		int nBonded = 0;
+		for(unsigned ic=0; ic<component.size(); ic++)
+			if(bond[ic].size()) iBonded[ic] = nBonded++;
+		const int nW = 6 + nBonded;
+		std::vector<double> d2F(nW*nW, 0.);
+		for(int a=0; a<6; a++)
+			for(int b=0; b<6; b++)
+				d2F[a*nW+b] = d2phi[a][b];
 		
 		if(bondsPresent)
 		{	for(unsigned ic=0; ic<component.size(); ic++)
@@ -149,34 +125,71 @@ ScalarFieldTildeCollection FluidMixture::getDirectCorrelations(const std::vector
 						{(Rhm*(9 - 9*n3 + 4*n2*Rhm))/((-3 + 3*n3 - 2*n2*Rhm)*(-3 + 3*n3 - n2*Rhm)),(n0mol*pow(Rhm,2)*(-45*pow(-1 + n3,2) + 36*n2*(-1 + n3)*Rhm - 8*pow(n2,2)*pow(Rhm,2)))/(pow(3 - 3*n3 + n2*Rhm,2)*pow(3 - 3*n3 + 2*n2*Rhm,2)),(9*n0mol*Rhm*(9 + 9*pow(n3,2) + 2*n2*Rhm*(4 + n2*Rhm) - 2*n3*(9 + 4*n2*Rhm)))/(pow(3 - 3*n3 + n2*Rhm,2)*pow(3 - 3*n3 + 2*n2*Rhm,2)),0},
 						{-3/(-1 + n3) - 3/(3 - 3*n3 + n2*Rhm) - 3/(3 - 3*n3 + 2*n2*Rhm),(9*n0mol*Rhm*(9 + 9*pow(n3,2) + 2*n2*Rhm*(4 + n2*Rhm) - 2*n3*(9 + 4*n2*Rhm)))/(pow(3 - 3*n3 + n2*Rhm,2)*pow(3 - 3*n3 + 2*n2*Rhm,2)),3*n0mol*(pow(-1 + n3,-2) - 3/pow(3 - 3*n3 + n2*Rhm,2) - 3/pow(3 - 3*n3 + 2*n2*Rhm,2)),0},
 						{0,0,0,(-2*n0mol*Rhm*(9 - 9*n3 + 2*n2*Rhm))/(n2*(3 - 3*n3 + n2*Rhm)*(3 - 3*n3 + 2*n2*Rhm))} };
-
-					//Note that the bonding corrections in one molecule contribute to the direct correlations of all hard-sphere components:
-					//First loop over all site densities
-					for(unsigned c1=0; c1<component.size(); c1++)
-					{	unsigned offs1 = component[c1].offsetDensity;
-						for(unsigned s1=0; s1<component[c1].indexedSite.size(); s1++)
-						{	const SiteProperties& prop1 = *(component[c1].indexedSite[s1]);
-							if(prop1.sphereRadius)
-							{	//Second loop over all site densities with net index lower than first one
-								for(unsigned c2=0; c2<=c1; c2++)
-								{	unsigned offs2 = component[c2].offsetDensity;
-									for(unsigned s2=0; s2<(c1==c2 ? s1+1 : component[c2].indexedSite.size()); s2++)
-									{	const SiteProperties& prop2 = *(component[c2].indexedSite[s2]);
-										if(prop2.sphereRadius)
-										{	double* Cdata = C[corrFuncIndex(offs1+s1,offs2+s2)].data();
-											for(int i=0; i<gInfo.S; i++)
-											{	double smooth = exp(-pow(0.5*gInfo.G[i]*hGrid,2)); //suppress Nyquist frequency components
-												//Collect FMT weight functions for both components at current G:
-												double weights1[4] = { c1==ic ? (*prop1.w0)[i] : 0., (*prop1.w2)[i], (*prop1.w3)[i], -gInfo.G[i]*(*prop1.w3)[i] };
-												double weights2[4] = { c2==ic ? (*prop2.w0)[i] : 0., (*prop2.w2)[i], (*prop2.w3)[i], -gInfo.G[i]*(*prop2.w3)[i] };
-												Cdata[i] += scale * T * contract(d2abond, weights1, weights2) * smooth;
-											}
-										}
-									}
-								}
-							}
-						}
-					}
+					
+					//Accumulate into combined Hessian (bonding n2, n3 and n2v are the FMT weighted densities 2, 3 and 5).
+					//Note that the bonding corrections in one molecule contribute to the direct correlations of all hard-sphere components.
+					const int iMap[4] = { 6+iBonded[ic], 2, 3, 5 };
+					for(int a=0; a<4; a++)
+						for(int b=0; b<4; b++)
+							d2F[iMap[a]*nW+iMap[b]] += scale * d2abond[a][b];
+				}
+			}
+		}
+		
+		//Collect hard-sphere sites:
+		std::vector<const SiteProperties*> hsProp; //properties of each hard sphere site
+		std::vector<unsigned> hsIndex; //density index of each hard sphere site
+		std::vector<int> hsBonded; //index of partial n0 of the molecule of each hard sphere site (-1 if none)
+		for(unsigned ic=0; ic<component.size(); ic++)
+			for(unsigned s=0; s<component[ic].indexedSite.size(); s++)
+				if(component[ic].indexedSite[s]->sphereRadius)
+				{	hsProp.push_back(component[ic].indexedSite[s]);
+					hsIndex.push_back(component[ic].offsetDensity + s);
+					hsBonded.push_back(iBonded[ic]);
+				}
+		const int nHS = hsProp.size();
+		std::vector<double*> Cdata; //output for each pair of hard-sphere sites (lower triangle)
+		for(int h1=0; h1<nHS; h1++)
+			for(int h2=0; h2<=h1; h2++)
+				Cdata.push_back(C[corrFuncIndex(hsIndex[h1],hsIndex[h2])].data());
+		
+		//Contract the combined Hessian with weight functions of all site pairs in one pass over G:
+		std::vector<double> w(nHS*nW), d2Fw(nHS*nW); //weights of each site, and their product with the Hessian
+		for(int i=0; i<gInfo.S; i++)
+		{	double G = gInfo.G[i];
+			double smooth = exp(-pow(0.5*G*hGrid,2)); //suppress Nyquist frequency components
+			//Collect weight functions of all sites at current G:
+			eblas_zero(nHS*nW, w.data());
+			for(int h=0; h<nHS; h++)
+			{	const SiteProperties& prop = *hsProp[h];
+				double* wh = w.data() + h*nW;
+				wh[0] = (*prop.w0)[i];
+				wh[1] = (*prop.w1)[i];
+				wh[2] = (*prop.w2)[i];
+				wh[3] = (*prop.w3)[i];
+				wh[4] = G*(*prop.w1v)[i];
+				wh[5] = -G*(*prop.w3)[i];
+				if(hsBonded[h] >= 0) wh[6+hsBonded[h]] = wh[0];
+			}
+			//Apply Hessian to each site's weights:
+			eblas_zero(nHS*nW, d2Fw.data());
+			for(int h=0; h<nHS; h++)
+			{	const double* wh = w.data() + h*nW;
+				double* d2Fwh = d2Fw.data() + h*nW;
+				for(int a=0; a<nW; a++)
+					for(int b=0; b<nW; b++)
+						d2Fwh[a] += d2F[a*nW+b] * wh[b];
+			}
+			//Pair contractions:
+			double prefac = T * smooth;
+			int iPair = 0;
+			for(int h1=0; h1<nHS; h1++)
+			{	const double* w1 = w.data() + h1*nW;
+				for(int h2=0; h2<=h1; h2++)
+				{	const double* d2Fw2 = d2Fw.data() + h2*nW;
+					double result = 0.;
+					for(int a=0; a<nW; a++) result += w1[a] * d2Fw2[a];
+					Cdata[iPair++][i] += prefac * result;
 				}
 			}
 		}
@@ -0,0 +1,114 @@
+/*-------------------------------------------------------------------
+Copyright 2012 Ravishankar Sundararaman
+
+This file is part of Fluid1D.
+
+Fluid1D is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Fluid1D is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <fluid/FluidSweep.h>
+#include <core/Thread.h>
+#include <algorithm>
+
+FluidSweep::Point::Point(double T, double P, double radius, double Eexternal)
+: T(T), P(P), radius(radius), Eexternal(Eexternal)
+{
+}
+
+double FluidSweep::System::solve(const MinimizeParams& mp, bool warmStart)
+{	return getMixture().minimize(mp);
+}
+
+FluidSweep::FluidSweep(const GridInfo& gInfo, SystemFactory systemFactory)
+: initScale(0.15), warmStart(true), saveDensities(false), nThreads(nProcsAvailable),
+	gInfo(gInfo), systemFactory(systemFactory)
+{
+}
+
+void FluidSweep_solveRange(size_t iStart, size_t iStop, const FluidSweep* sweep, const std::vector<FluidSweep::Point>* points,
+	const std::vector<size_t>* order, std::vector<FluidSweep::Result>* results, std::mutex* logLock)
+{	sweep->solveRange(iStart, iStop, points, order, results, logLock);
+}
+
+std::vector<FluidSweep::Result> FluidSweep::solve(const std::vector<Point>& points) const
+{	//Order states so that neighbours are close (in T first, since that requires a new system):
+	std::vector<size_t> order(points.size());
+	for(size_t i=0; i<order.size(); i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&points](size_t i1, size_t i2)
+	{	const Point& p1 = points[i1];
+		const Point& p2 = points[i2];
+		if(p1.T != p2.T) return p1.T < p2.T;
+		if(p1.P != p2.P) return p1.P < p2.P;
+		if(p1.Eexternal != p2.Eexternal) return p1.Eexternal < p2.Eexternal;
+		return p1.radius < p2.radius;
+	});
+	
+	//Solve contiguous blocks of states in parallel:
+	int nThreadsUsed = std::max(1, std::min(nThreads, int(points.size())));
+	logPrintf("\n----- FluidSweep: solving %lu states on %d threads -----\n", points.size(), nThreadsUsed); logFlush();
+	std::vector<Result> results(points.size());
+	std::mutex logLock;
+	if(nThreadsUsed > 1) suspendOperatorThreading(); //parallelize over states rather than within each solve
+	threadLaunch(nThreadsUsed, FluidSweep_solveRange, points.size(), this, &points, &order, &results, &logLock);
+	if(nThreadsUsed > 1) resumeOperatorThreading();
+	return results;
+}
+
+void FluidSweep::solveRange(size_t iStart, size_t iStop, const std::vector<Point>* points,
+	const std::vector<size_t>* order, std::vector<Result>* results, std::mutex* logLock) const
+{	bool parallel = (iStop-iStart < points->size()); //other threads are solving concurrently
+	MinimizeParams mpState = mp;
+	if(parallel) mpState.fpLog = nullLog; //minimizer output from concurrent solves would be interleaved
+	std::shared_ptr<System> system;
+	bool haveState = false; //whether the mixture contains a converged state (of the same temperature)
+	ScalarFieldCollection prevState; //converged state at a different temperature (for warm start across systems)
+	for(size_t j=iStart; j<iStop; j++)
+	{	size_t i = order->at(j);
+		const Point& point = points->at(i);
+		Result& result = results->at(i);
+		
+		//Create system if necessary:
+		if(!system || system->getMixture().T != point.T)
+		{	if(system && haveState) prevState = system->getMixture().state;
+			if(parallel) logLock->lock(); //serialize construction logs
+			system = systemFactory(gInfo, point.T);
+			if(parallel) logLock->unlock();
+			haveState = false;
+		}
+		FluidMixture& fluidMixture = system->getMixture();
+		
+		//Set conditions (pressure only when changed, as it re-solves the bulk equation of state):
+		if(parallel) logLock->lock(); //serialize logs of setPressure() and initState()
+		if(!haveState || point.P != points->at(order->at(j-1)).P) fluidMixture.setPressure(point.P);
+		fluidMixture.Eexternal = point.Eexternal;
+		system->setExternal(point);
+		result.warmStart = warmStart && (haveState || prevState.size());
+		if(!result.warmStart) fluidMixture.initState(initScale);
+		else if(!haveState) fluidMixture.state = prevState;
+		if(parallel) logLock->unlock();
+		
+		//Solve:
+		mpState.nDim = gInfo.S * fluidMixture.get_nIndep();
+		result.Phi = system->solve(mpState, result.warmStart);
+		if(saveDensities) fluidMixture.getFreeEnergy(FluidMixture::Outputs(&result.N));
+		haveState = true;
+		prevState.clear();
+		
+		if(parallel) logLock->lock();
+		logPrintf("FluidSweep: state %lu  T: %.2lf K  P: %.4lf bar  radius: %.3lf  Eexternal: %.3le  Phi: %.12le (%s start)\n",
+			i, point.T/Kelvin, point.P/Bar, point.radius, point.Eexternal, result.Phi, result.warmStart ? "warm" : "cold");
+		logFlush();
+		if(parallel) logLock->unlock();
+	}
+}
@@ -0,0 +1,90 @@
+/*-------------------------------------------------------------------
+Copyright 2012 Ravishankar Sundararaman
+
+This file is part of Fluid1D.
+
+Fluid1D is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Fluid1D is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef FLUID1D_FLUID1D_FLUIDSWEEP_H
+#define FLUID1D_FLUID1D_FLUIDSWEEP_H
+
+#include <fluid/FluidMixture.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+//! @brief Solve a fluid mixture for a batch of thermodynamic states (T, P, cavity radius, field)
+//! The states are ordered so that neighbours in (T, P, Eexternal, radius) are solved consecutively,
+//! and each converged state warm-starts the next. Contiguous blocks of this order are solved in
+//! parallel threads, each with its own fluid system (constructed by a user-supplied factory),
+//! sharing only the (read-only) grid. Each solve is single-threaded when more than one thread is used.
+class FluidSweep
+{
+public:
+	//! Thermodynamic state and external conditions of one solve
+	struct Point
+	{	double T; //!< temperature
+		double P; //!< pressure
+		double radius; //!< cavity radius (interpreted by System::setExternal)
+		double Eexternal; //!< uniform external electric field
+		Point(double T=298*Kelvin, double P=1.01325*Bar, double radius=0., double Eexternal=0.);
+	};
+	
+	//! Results of one solve
+	struct Result
+	{	double Phi; //!< grand free energy difference at the minimum
+		bool warmStart; //!< whether the solve started from a neighbouring converged state
+		ScalarFieldCollection N; //!< site densities (only if saveDensities)
+	};
+	
+	//! A fluid system: a FluidMixture at fixed temperature along with all its components (Fex, IdealGas etc.)
+	class System
+	{
+	public:
+		virtual ~System() {}
+		virtual FluidMixture& getMixture()=0; //!< the mixture, which must remain owned by this object
+		virtual void setExternal(const Point& point)=0; //!< set the external potentials for point (eg. a cavity of point.radius) on the ideal gases
+		
+		//! Minimize the mixture from the current state and return the free energy.
+		//! Defaults to FluidMixture::minimize(); override for staged solves, which may be skipped when warmStart is true.
+		virtual double solve(const MinimizeParams& mp, bool warmStart);
+	};
+	
+	//! Factory to construct the fluid system on grid gInfo at temperature T (called from the solving threads)
+	typedef std::function<std::shared_ptr<System>(const GridInfo& gInfo, double T)> SystemFactory;
+	
+	FluidSweep(const GridInfo& gInfo, SystemFactory systemFactory);
+	
+	MinimizeParams mp; //!< minimization parameters for each solve (nDim is set automatically)
+	double initScale; //!< scale passed to FluidMixture::initState() for cold starts (default 0.15)
+	bool warmStart; //!< whether to start each solve from the preceding converged state (default true)
+	bool saveDensities; //!< whether to retrieve site densities in the results (default false)
+	int nThreads; //!< number of states solved in parallel (default: number of processors, limited to number of states)
+	
+	//! Solve all points, and return the results in the same order as points
+	std::vector<Result> solve(const std::vector<Point>& points) const;
+	
+private:
+	const GridInfo& gInfo;
+	SystemFactory systemFactory;
+	
+	//! Solve the points with indices order[iStart:iStop) consecutively on one thread
+	void solveRange(size_t iStart, size_t iStop, const std::vector<Point>* points,
+		const std::vector<size_t>* order, std::vector<Result>* results, std::mutex* logLock) const;
+	friend void FluidSweep_solveRange(size_t, size_t, const FluidSweep*, const std::vector<Point>*,
+		const std::vector<size_t>*, std::vector<Result>*, std::mutex*);
+};
+
+#endif // FLUID1D_FLUID1D_FLUIDSWEEP_H
@@ -19,6 +19,7 @@ along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/Minimize.h>
 #include <fluid/FluidMixture.h>
+#include <fluid/FluidSweep.h>
 #include <fluid/IdealGasPsiAlpha.h>
 #include <fluid/IdealGasMuEps.h>
 #include <fluid/IdealGasPomega.h>
@@ -26,60 +27,71 @@ along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
 #include <fluid/Fex_H2O_ScalarEOS.h>
 #include <fluid/Fex_H2O_BondedVoids.h>
 
+//Water with cavity of specified radius
+class WaterSystem : public FluidSweep::System
+{
+	SO3quad quad;
+	TranslationOperatorLspline trans;
+	FluidMixture fluidMixture;
+	//Fex_H2O_FittedCorrelations fex;
+	Fex_H2O_ScalarEOS fex;
+	//Fex_H2O_BondedVoids fex;
+	IdealGasPomega idgas;
+	const GridInfo& gInfo;
+	
+public:
+	WaterSystem(const GridInfo& gInfo, double T)
+	: quad(QuadEuler, 2, 20, 1), //Water molecule has Z2 symmetry about dipole axis; force nAlpha = 1
+		trans(gInfo), fluidMixture(gInfo, T), fex(fluidMixture), idgas(&fex, 1.0, quad, trans), gInfo(gInfo)
+	{
+	}
+	
+	FluidMixture& getMixture() { return fluidMixture; }
+	
+	void setExternal(const FluidSweep::Point& point)
+	{	nullToZero(idgas.V, gInfo);
+		double* Vdata = idgas.V[0].data();
+		for(int i=0; i<gInfo.S; i++)
+			Vdata[i] = gInfo.r[i]<point.radius ? 1. : 0.;
+	}
+	
+	double solve(const MinimizeParams& mp, bool warmStart)
+	{	if(!warmStart) { fluidMixture.Kpol=0; fluidMixture.minimize(mp); } //Initial minimization with frozen polarizability
+		fluidMixture.Kpol=1;
+		return fluidMixture.minimize(mp);
+	}
+};
+
 int main(int argc, char** argv)
 {	initSystem(argc, argv);
 
 	//Setup simulation grid:
 	//GridInfo gInfo(GridInfo::Spherical, 512, 0.125);
 	GridInfo gInfo(GridInfo::Spherical, 256, 0.25);
+	string fexName = "ScalarEOS";
 	
-	//----- Setup quadrature for angular integration -----
-	const int Zn = 2; //Water molecule has Z2 symmetry about dipole axis
-	SO3quad quad(QuadEuler, Zn, 20, 1); //Force nAlpha = 1
-
-	//----- Translation operator -----
-	TranslationOperatorLspline trans(gInfo);
+	//----- Sweep over cavity radii (solved in parallel, warm-starting from neighbouring radii) -----
+	FluidSweep sweep(gInfo, [](const GridInfo& gInfo, double T) { return std::make_shared<WaterSystem>(gInfo, T); });
+	sweep.mp.alphaTstart = 3e4;
+	sweep.mp.energyLabel = "Phi";
+	sweep.mp.nIterations=100;
+	sweep.mp.energyDiffThreshold=1e-11;
 	
-	FluidMixture fluidMixture(gInfo, 298*Kelvin);
-
-	//----- Excess functional -----
-	//Fex_H2O_FittedCorrelations fex(fluidMixture); string fexName = "FittedCorrelations";
-	Fex_H2O_ScalarEOS fex(fluidMixture); string fexName = "ScalarEOS";
-	//Fex_H2O_ScalarEOS fex(fluidMixture, false); string fexName = "ScalarEOSrotOnly";
-	//Fex_H2O_BondedVoids fex(fluidMixture); string fexName = "BondedVoids";
-
-	//----- Ideal gas -----
-	IdealGasPomega idgas(&fex, 1.0, quad, trans);
-
 	double p = 1.01325*Bar;
-	fluidMixture.setPressure(p);
-	
-	//----- FDtest and CG parameters -----
-	MinimizeParams mp;
-	mp.alphaTstart = 3e4;
-	mp.nDim = gInfo.S * fluidMixture.get_nIndep();
-	mp.energyLabel = "Phi";
-	mp.nIterations=100;
-	mp.energyDiffThreshold=1e-11;
+	std::vector<FluidSweep::Point> points;
+	for(int iRadius=0; iRadius<24; iRadius++)
+	{	double radius = iRadius ? 0.75*iRadius + 0.5*gInfo.rMax/gInfo.S : 0.;
+		points.push_back(FluidSweep::Point(298*Kelvin, p, radius));
+	}
+	std::vector<FluidSweep::Result> results = sweep.solve(points);
 	
 	FILE* fp = fopen((fexName + "/sigmavsradius").c_str(), "w");
-	double Phi0 = 0.;
-	for(int iRadius=0; iRadius<24; iRadius++)
-	{
-		//----- Initialize external potential -----
-		double radius = iRadius ? 0.75*iRadius + 0.5*gInfo.rMax/gInfo.S : 0.;
-		logPrintf("\n\nStarting solve #%d for radius %lf bohr:\n", iRadius+1, radius);
-		nullToZero(idgas.V, gInfo);
-		double* Vdata = idgas.V[0].data();
-		for(int i=0; i<gInfo.S; i++)
-			Vdata[i] = gInfo.r[i]<radius ? 1. : 0.;
-
-		fluidMixture.initState(0.15);
-		fluidMixture.Kpol=0; fluidMixture.minimize(mp); fluidMixture.Kpol=1; //Initial minimization with frozen polarizability
-		double Phi = fluidMixture.minimize(mp);
-		if(!iRadius) { Phi0 = Phi; fprintf(fp, "%lf\t%le\n", 0., 0.); }
+	double Phi0 = results[0].Phi;
+	for(size_t iRadius=0; iRadius<points.size(); iRadius++)
+	{	double radius = points[iRadius].radius;
+		double Phi = results[iRadius].Phi;
+		if(!iRadius) fprintf(fp, "%lf\t%le\n", 0., 0.);
 		else fprintf(fp, "%lf\t%le\n", radius, ((Phi-Phi0) - p * (4*M_PI*pow(radius,3)/3)) / (4*M_PI*pow(radius,2)));
-		fflush(fp);
 	}
 	fclose(fp);
 }
@@ -20,6 +20,7 @@ along with Fluid1D.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Operators.h>
 #include <core/Util.h>
 #include <cmath>
+#include <cstring>
 
 int main(int argc, char** argv)
 {	initSystem(argc, argv);
@@ -75,4 +76,27 @@ int main(int argc, char** argv)
 			fprintf(fp, "%lf\t%le\t%le\t%le\t%le\t%le\n", gInfo.r[i], xData[i], DxData[i], numDxData[i], DDxData[i], numDDxData[i]);
 		fclose(fp);
 	}
+
+	{	puts("\nTest 5: Fast spherical transforms against dense matrices:");
+		GridInfo gInfoFast(GridInfo::Spherical, gInfo.S, gInfo.rMax/gInfo.S, true);
+		ScalarField r1(&gInfo), r1fast(&gInfoFast);
+		initRandom(r1);
+		ScalarFieldTilde g1 = J(r1), g1fast(&gInfoFast);
+		memcpy(g1fast.data(), g1.data(), sizeof(double)*gInfo.S);
+		memcpy(r1fast.data(), r1.data(), sizeof(double)*gInfo.S);
+		#define COMPARE(op, X, Xfast) \
+		{	auto Y = op(X); auto Yfast = op(Xfast); \
+			double err=0., norm=0.; \
+			for(int i=0; i<gInfo.S; i++) { err += pow(Y.data()[i]-Yfast.data()[i], 2); norm += pow(Y.data()[i], 2); } \
+			printf("\tRelative error in " #op ": %le\n", sqrt(err/norm)); \
+		}
+		COMPARE(I, g1, g1fast)
+		COMPARE(ID, g1, g1fast)
+		COMPARE(IDD, g1, g1fast)
+		COMPARE(J, r1, r1fast)
+		COMPARE(Idag, r1, r1fast)
+		COMPARE(IDdag, r1, r1fast)
+		COMPARE(IDDdag, r1, r1fast)
+		#undef COMPARE
+	}
 }
@@ -0,0 +1,257 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/ColumnBundle.h>
+#include <electronic/Basis.h>
+#include <electronic/IonInfo.h>
+#include <electronic/ElecInfo.h>
+#include <core/Util.h>
+#include <core/Operators.h>
+#include <core/Coulomb.h>
+#include <core/BlasExtra.h>
+#include <fluid/TranslationOperator.h>
+#include <getopt.h>
+#include <functional>
+#include <cmath>
+
+//Micro-benchmarks of the core operators, sweeping grid sizes, band counts and thread counts.
+//Each operator reports its time per call, achieved GFLOPS and GB/s (using the operation and
+//compulsory memory-traffic counts noted below), and the fraction of the roofline bound
+//min(peak GFLOPS, arithmetic intensity * peak GB/s) that it attains. The ceilings are either
+//specified on the command line or measured using a large zgemm (compute) and daxpy (bandwidth).
+//The GPU version (BenchmarkOperators_gpu) runs the same operators on the GPU (no thread sweep).
+
+struct BenchmarkParams
+{	std::vector<int> gridSizes; //FFT box size along each direction (cubic cell)
+	std::vector<int> bandCounts; //number of columns in ColumnBundle benchmarks
+	std::vector<int> threadCounts; //number of threads (CPU only)
+	double peakGflops, peakGBps; //roofline ceilings (measured if 0)
+	double minTime; //minimum total time per measurement in seconds
+	
+	BenchmarkParams() : gridSizes({48, 64, 96, 128}), bandCounts({32, 64, 128, 256}), peakGflops(0.), peakGBps(0.), minTime(0.5)
+	{	for(int nThreads=1; nThreads<nProcsAvailable; nThreads*=2)
+			threadCounts.push_back(nThreads);
+		threadCounts.push_back(nProcsAvailable);
+	}
+};
+
+//Parse a comma-separated list of positive integers
+std::vector<int> parseList(const char* str, const char* optName)
+{	std::vector<int> result;
+	istringstream iss(str);
+	string token;
+	while(getline(iss, token, ','))
+	{	int n = atoi(token.c_str());
+		if(n <= 0) die("Invalid entry '%s' in list for option %s.\n", token.c_str(), optName);
+		result.push_back(n);
+	}
+	if(!result.size()) die("Empty list for option %s.\n", optName);
+	return result;
+}
+
+void printUsage(const char* name)
+{	printf("Usage: %s [options]\n", name);
+	printf("\n\tMicro-benchmarks of core operators, with GFLOPS and GB/s compared to roofline estimates.\n\n");
+	printf("\t-g <S1,S2,...>  FFT box sizes (cubic cell with 0.4 bohr spacing; default 48,64,96,128)\n");
+	printf("\t-b <n1,n2,...>  band counts for ColumnBundle operators (default 32,64,128,256)\n");
+	printf("\t-t <n1,n2,...>  thread counts (CPU only; default powers of 2 up to all cores)\n");
+	printf("\t-F <GFLOPS>     compute ceiling (default: measured with zgemm at each thread count)\n");
+	printf("\t-B <GB/s>       bandwidth ceiling (default: measured with daxpy at each thread count)\n");
+	printf("\t-m <seconds>    minimum measurement time per entry (default 0.5)\n");
+	printf("\t-h              print this message\n\n");
+}
+
+void sync()
+{
+	#ifdef GPU_ENABLED
+	cudaDeviceSynchronize();
+	#endif
+}
+
+//Time per call of func, repeated till at least minTime has elapsed (after one untimed warm-up call)
+double timeCall(const std::function<void()>& func, double minTime)
+{	func(); sync();
+	int nCalls = 0;
+	double tStart = clock_sec(), tElapsed;
+	do
+	{	func(); sync();
+		nCalls++;
+		tElapsed = clock_sec() - tStart;
+	}
+	while(tElapsed < minTime);
+	return tElapsed / nCalls;
+}
+
+//Roofline ceilings for the current thread count
+struct Roofline
+{	double gflops, GBps;
+	
+	Roofline(const BenchmarkParams& bp)
+	{	gflops = bp.peakGflops;
+		if(!gflops)
+		{	const int n = 1024;
+			matrix A(n,n), B(n,n), C(n,n);
+			A.zero(); B.zero();
+			double t = timeCall([&]()
+			{	callPref(eblas_zgemm)(CblasNoTrans, CblasNoTrans, n, n, n,
+					1., A.dataPref(), n, B.dataPref(), n, 0., C.dataPref(), n);
+			}, bp.minTime);
+			gflops = 8.*pow(n,3) / t * 1e-9;
+		}
+		GBps = bp.peakGBps;
+		if(!GBps)
+		{	const int n = 1<<25;
+			ManagedArray<double> x, y;
+			x.init(n, isGpuEnabled()); callPref(eblas_zero)(n, x.dataPref());
+			y.init(n, isGpuEnabled()); callPref(eblas_zero)(n, y.dataPref());
+			double t = timeCall([&]()
+			{	callPref(eblas_daxpy)(n, 1., x.dataPref(), 1, y.dataPref(), 1);
+			}, bp.minTime);
+			GBps = 24.*n / t * 1e-9;
+		}
+		logPrintf("\nRoofline ceilings: %.1lf GFLOPS, %.1lf GB/s (ridge at %.2lf FLOP/byte)\n", gflops, GBps, gflops/GBps);
+		logPrintf("%-22s %-18s %12s %10s %10s %8s %9s\n", "Operator", "Size", "Time[ms]", "GFLOPS", "GB/s", "FLOP/B", "Roofline");
+	}
+	
+	//Report one measurement with the specified operation count and compulsory memory traffic
+	void report(const char* name, const string& size, double t, double nFlops, double nBytes) const
+	{	double achieved = nFlops / t * 1e-9;
+		double bound = std::min(gflops, (nFlops/nBytes) * GBps);
+		logPrintf("%-22s %-18s %12.3lf %10.2lf %10.2lf %8.2lf %8.1lf%%\n", name, size.c_str(),
+			t*1e3, achieved, nBytes / t * 1e-9, nFlops/nBytes, 100.*achieved/bound);
+		logFlush();
+	}
+};
+
+string sizeString(int S, int nBands=0)
+{	ostringstream oss;
+	oss << S << "^3";
+	if(nBands) oss << " x " << nBands;
+	return oss.str();
+}
+
+//Grid-only operators: Fourier transforms, translation and Coulomb kernel
+void benchmarkGrid(const GridInfo& gInfo, const Roofline& roofline, const BenchmarkParams& bp)
+{	const double N = gInfo.nr, nG = gInfo.nG; //real- and (halved) reciprocal-space grid sizes
+	const double fftFlops = 5.*N*log2(N); //complex 3D FFT (real-to-complex is half as much)
+	string size = sizeString(gInfo.S[0]);
+	
+	//Fourier transforms (traffic: read input and write output once):
+	ScalarField r1, r2; nullToZero(r1, gInfo); nullToZero(r2, gInfo);
+	initRandom(r1); initRandom(r2);
+	ScalarFieldTilde rTilde = J(r1);
+	complexScalarField c = Complex(r1, r2);
+	complexScalarFieldTilde cTilde = J(c);
+	roofline.report("I (real)", size, timeCall([&]() { I(rTilde); }, bp.minTime), 0.5*fftFlops, 16.*nG + 8.*N);
+	roofline.report("J (real)", size, timeCall([&]() { J(r1); }, bp.minTime), 0.5*fftFlops, 8.*N + 16.*nG);
+	roofline.report("I (complex)", size, timeCall([&]() { I(cTilde); }, bp.minTime), fftFlops, 32.*N);
+	roofline.report("Idag (complex)", size, timeCall([&]() { Idag(c); }, bp.minTime), fftFlops, 32.*N);
+	roofline.report("J (complex)", size, timeCall([&]() { J(c); }, bp.minTime), fftFlops, 32.*N);
+	roofline.report("Jdag (complex)", size, timeCall([&]() { Jdag(cTilde); }, bp.minTime), fftFlops, 32.*N);
+	
+	//Translation operators (traffic: read x and read/write y; trilinear interpolation ~ 17 flops/point):
+	const vector3<> t(0.37, -1.21, 2.53); //generic translation (bohr)
+	TranslationOperatorSpline transConstant(gInfo, TranslationOperatorSpline::Constant);
+	TranslationOperatorSpline transLinear(gInfo, TranslationOperatorSpline::Linear);
+	roofline.report("taxpy (constant)", size, timeCall([&]() { transConstant.taxpy(t, 1., r1, r2); }, bp.minTime), 2.*N, 24.*N);
+	roofline.report("taxpy (linear)", size, timeCall([&]() { transLinear.taxpy(t, 1., r1, r2); }, bp.minTime), 17.*N, 24.*N);
+	
+	//Coulomb kernel (traffic: copy of input, then read input and kernel and write output):
+	CoulombParams cp; cp.geometry = CoulombParams::Periodic;
+	logSuspend(); std::shared_ptr<Coulomb> coulomb = cp.createCoulomb(gInfo); logResume();
+	roofline.report("Coulomb::apply", size, timeCall([&]() { (*coulomb)(rTilde); }, bp.minTime), 2.*nG, 72.*nG);
+}
+
+//ColumnBundle operators at a given band count
+void benchmarkBands(const GridInfo& gInfo, const Basis& basis, const QuantumNumber& qnum, int nBands, const Roofline& roofline, const BenchmarkParams& bp)
+{	const double N = gInfo.nr, nBasis = basis.nbasis, n = nBands;
+	const double fftFlops = 5.*N*log2(N);
+	string size = sizeString(gInfo.S[0], nBands);
+	ColumnBundle C(nBands, basis.nbasis, &basis, &qnum, isGpuEnabled()); randomize(C);
+	
+	//Density and local potential (traffic per band: wavefunction coefficients and the in-place FFT box,
+	//plus accumulating the density or applying the potential on the real-space grid):
+	diagMatrix F(nBands, 1.);
+	roofline.report("diagouterI", size, timeCall([&]() { diagouterI(F, C, 1); }, bp.minTime),
+		n*(fftFlops + 4.*N), n*(16.*nBasis + 64.*N));
+	ScalarFieldArray V(1); nullToZero(V[0], gInfo); initRandom(V[0]);
+	roofline.report("Idag_DiagV_I", size, timeCall([&]() { Idag_DiagV_I(C, V); }, bp.minTime),
+		n*(2.*fftFlops + 2.*N), n*(32.*nBasis + 104.*N));
+	
+	//Overlap (traffic: read both bundles and write the result):
+	matrix M;
+	roofline.report("operator^", size, timeCall([&]() { M = C^C; }, bp.minTime),
+		8.*n*n*nBasis, 16.*(2.*n*nBasis + n*n));
+	
+	//Hermitian eigenvalue problem (approximate zheevd operation count with eigenvectors):
+	matrix evecs; diagMatrix eigs;
+	roofline.report("matrix::diagonalize", size, timeCall([&]() { M.diagonalize(evecs, eigs); }, bp.minTime),
+		(56./3)*n*n*n, 48.*n*n);
+}
+
+int main(int argc, char** argv)
+{	initSystem(argc, argv);
+	
+	//Parse command line:
+	BenchmarkParams bp;
+	int c;
+	while((c = getopt(argc, argv, "g:b:t:F:B:m:h")) != -1)
+	{	switch(c)
+		{	case 'g': bp.gridSizes = parseList(optarg, "-g"); break;
+			case 'b': bp.bandCounts = parseList(optarg, "-b"); break;
+			case 't': bp.threadCounts = parseList(optarg, "-t"); break;
+			case 'F': bp.peakGflops = atof(optarg); break;
+			case 'B': bp.peakGBps = atof(optarg); break;
+			case 'm': bp.minTime = atof(optarg); break;
+			case 'h': printUsage(argv[0]); finalizeSystem(); return 0;
+			default: printUsage(argv[0]); finalizeSystem(false); return 1;
+		}
+	}
+	if(isGpuEnabled()) bp.threadCounts.assign(1, 1); //host threads do not matter for GPU operators
+	if(mpiWorld->nProcesses() > 1)
+		logPrintf("WARNING: run on a single process; timings below include all %d processes competing for resources.\n", mpiWorld->nProcesses());
+	
+	const int nProcsOrig = nProcsAvailable;
+	for(int nThreads: bp.threadCounts)
+	{	nProcsAvailable = nThreads;
+		resumeOperatorThreading(); //updates thread count of threaded libraries
+		logPrintf("\n---------- Benchmarks with %d threads%s ----------\n", nThreads, isGpuEnabled() ? " (GPU)" : "");
+		Roofline roofline(bp);
+		for(int S: bp.gridSizes)
+		{	GridInfo gInfo;
+			gInfo.S = vector3<int>(S, S, S);
+			gInfo.R = matrix3<>(1,1,1) * (0.4*S);
+			logSuspend(); gInfo.initialize(); logResume();
+			benchmarkGrid(gInfo, roofline, bp);
+			
+			//Wavefunction basis at the largest cutoff whose density fits in this FFT box:
+			IonInfo iInfo;
+			double Gmax = M_PI*S / gInfo.R(0,0); //Nyquist wave-vector of the density
+			double Ecut = 0.5*pow(0.5*Gmax, 2);
+			Basis basis; QuantumNumber qnum; qnum.weight = 1.;
+			logSuspend(); basis.setup(gInfo, iInfo, Ecut, qnum.k); logResume();
+			for(int nBands: bp.bandCounts)
+				benchmarkBands(gInfo, basis, qnum, nBands, roofline, bp);
+		}
+	}
+	nProcsAvailable = nProcsOrig;
+	
+	finalizeSystem();
+	return 0;
+}
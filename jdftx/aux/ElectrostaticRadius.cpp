@@ -48,6 +48,7 @@ struct MultipoleBasis
 	ColumnBundle getProjector(int l, int m, const std::vector<double>& Garr)
 	{	ColumnBundle proj(Garr.size(), basis.nbasis, &basis, 0, isGpuEnabled());
 		complex* projData = proj.dataPref();
+		AtomPhases phases(basis.gInfo->S, 1, center.data());
 		//Initialize radial grids:
 		const double dG(0.01 * (2*M_PI)/Rmax);
 		const int nG = int(ceil(Gmax/dG))+5;
@@ -67,7 +68,7 @@ struct MultipoleBasis
 			RadialFunctionG jlTilde;
 			jl.transform(l, dG, nG, jlTilde);
 			//Store onto projector:
-			callPref(Vnl)(basis.nbasis, 0, 1, l, m, vector3<>(0,0,0), basis.iGarr.dataPref(), basis.gInfo->G, center.dataPref(), jlTilde, projData+proj.index(i,0));
+			callPref(Vnl)(basis.nbasis, 0, 1, l, m, vector3<>(0,0,0), basis.iGarr.dataPref(), basis.gInfo->G, center.dataPref(), phases.tables(), jlTilde, projData+proj.index(i,0));
 			jlTilde.free();
 		}
 		proj *= (sqrt(4*M_PI) * cis(-l*M_PI/2)); //makes stuff real for real wavefunctions and set normalization
@@ -160,7 +161,7 @@ int main(int argc, char** argv)
 	for(size_t spIndex=0; spIndex<e.iInfo.species.size(); spIndex++)
 	{	const auto& sp = e.iInfo.species[spIndex];
 		ScalarFieldTilde SG; nullToZero(SG, e.gInfo);
-		callPref(getSG)(e.gInfo.S, sp->atpos.size(), sp->atposManaged.dataPref(), 1./e.gInfo.detR, SG->dataPref()); //get structure factor for current species
+		callPref(getSG)(e.gInfo.S, sp->atpos.size(), sp->getAtomPhases().tables(), 1./e.gInfo.detR, SG->dataPref()); //get structure factor for current species
 		rho -= sp->Z * gaussConvolve(SG, vdW.getParams(sp->atomicNumber,spIndex).R0/6.);
 	}
 	//Replace the last (least significant) polarizability eigencomponent with the rotational one:
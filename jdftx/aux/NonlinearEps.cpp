@@ -58,10 +58,11 @@ int main(int argc, char** argv)
 	mp.nIterations=200;
 
 	FILE* fpEps = fopen((solventName+"/nonlineareps").c_str(), "w");
+	fprintf(fpEps, "#D[V/A]\tepsilon\tpolarization/(n*p0)\tn[bohr^-3]\ttime[s]\n");
 	double Dfield=1e-4;
 	bool stateInitialized = false;
 	for(; Dfield<6.5e-2; Dfield+=2e-3)
-	{
+	{	double tStart = clock_sec();
 		mp.energyDiffThreshold = 1e-9 * gInfo.detR * pow(Dfield,2);
 		mp.knormThreshold = 1e-9 * gInfo.detR * Dfield;
 		fluidMixture.Eexternal = vector3<>(0, 0, Dfield);
@@ -84,9 +85,10 @@ int main(int argc, char** argv)
 
 		double epsilon = 1.0/(1.0 - 4*M_PI*pTyp/Dfield);
 		double D_SI = Dfield/(eV/Angstrom); //Dfield in V/A
-		logPrintf("epsilon = %lf at D = %lf V/A\n", epsilon, D_SI);
-		fprintf(fpEps, "%le\t%le\t%le\t%le\n", D_SI, epsilon,
-			pTyp/(nTyp*component.molecule.getDipole().length()), nTyp);
+		double tPoint = clock_sec() - tStart;
+		logPrintf("epsilon = %lf at D = %lf V/A (%.2lf s)\n", epsilon, D_SI, tPoint);
+		fprintf(fpEps, "%le\t%le\t%le\t%le\t%.3lf\n", D_SI, epsilon,
+			pTyp/(nTyp*component.molecule.getDipole().length()), nTyp, tPoint);
 		fflush(fpEps);
 		if(std::isnan(epsilon) || epsilon<0.0) break;
 	}
@@ -35,43 +35,16 @@ inline double wCavity_calc(double G, double d)
 }
 
 void printUsage()
-{	logPrintf("Usage: SigmaModel <solventName> Sphere|Cylinder <radiusInBohrs> Droplet|Cavity Model|DFT\n");
+{	logPrintf("Usage: SigmaModel <solventName> Sphere|Cylinder <radiusInBohrs>[,<radiusInBohrs>...] Droplet|Cavity Model|DFT\n");
+	logPrintf("\tWith a comma-separated list of radii, each is computed in turn, and the results (with the\n");
+	logPrintf("\twall time of each configuration) are also written to SigmaModel.csv\n");
 }
 
 extern EnumStringMap<FluidComponent::Name> solventMap;
 
-int main(int argc, char** argv)
-{	initSystem(argc, argv);
-	
-	//Parse commandline:
-	if(argc != 6) { printUsage(); return 1; }
-	//--- 1:
-	FluidComponent::Name solventName;
-	if(!solventMap.getEnum(argv[1], solventName)) { logPrintf("Unrecognized <solventName> '%s'\n", argv[1]); printUsage(); return 1; }
-	//--- 2:
-	bool cylindrical = false;
-	if(string(argv[2])=="Cylinder") cylindrical = true;
-	else if(string(argv[2])=="Sphere") cylindrical = false;
-	else { logPrintf("Unrecognized geometry '%s'\n", argv[2]); printUsage(); return 1; }
-	//--- 3:
-	double radius = 0.;
-	{	istringstream iss(argv[3]);
-		iss >> radius;
-		if(iss.fail()) { logPrintf("Could not parse <radiusInBohrs> from '%s'\n", argv[3]); printUsage(); return 1; }
-		if(radius <= 0.) { logPrintf("<radiusInBohrs> must be > 0. (given %lg)\n", radius); printUsage(); return 1; }
-	}
-	//--- 4:
-	bool droplet = false;
-	if(string(argv[4])=="Droplet") droplet = true;
-	else if(string(argv[4])=="Cavity") droplet = false;
-	else { logPrintf("Unrecognized topology '%s', must be 'Droplet' or 'Cavity'\n", argv[4]); printUsage(); return 1; }
-	//--- 5:
-	bool model = false;
-	if(string(argv[5])=="Model") model = true;
-	else if(string(argv[5])=="DFT") model = false;
-	else { logPrintf("Unrecognized mode '%s', must be 'Model' or 'DFT'\n", argv[5]); printUsage(); return 1; }
-	
-	//Create component:
+//Compute the surface tension of the cavity or droplet of specified geometry with the weighted-density model or classical DFT
+double computeSigma(FluidComponent::Name solventName, bool cylindrical, double radius, bool droplet, bool model)
+{	//Create component:
 	double T = 298*Kelvin;
 	FluidComponent component(solventName, T, FluidComponent::ScalarEOS);
 	component.s2quadType = QuadOctahedron;
@@ -109,8 +82,8 @@ int main(int argc, char** argv)
 		RadialFunctionG w; w.init(0, gInfo.dGradial, gInfo.GmaxGrid, wCavity_calc, d);
 		ScalarField sbar = I(w * J(s));
 		double sigmaModel = integral(NT*sbar*(1-sbar)*(Gamma+sbar*(1.-Gamma + Cp*(1-sbar)))) / Area;
-		logPrintf("\nSigmaModel_CurvatureAndSigma: %.8lf\t%.8le\n", (droplet?-1.:1.)/radius, sigmaModel);
 		w.free();
+		return sigmaModel;
 	}
 	else //Classical DFT:
 	{
@@ -122,16 +95,74 @@ int main(int argc, char** argv)
 		nullToZero(component.idealGas->V, gInfo);
 		fluidMixture.initState(0.15);
 		if(droplet) component.Nnorm = component.idealGas->get_Nbulk() * Volume;
-		//--- Minimize and print result:
+		//--- Minimize:
 		MinimizeParams mp;
 		mp.fpLog = globalLog;
 		mp.nDim = gInfo.nr * fluidMixture.get_nIndep();
 		mp.energyLabel = "Phi";
 		mp.nIterations = 100;
 		mp.energyDiffThreshold = 1e-6 * (component.sigmaBulk * Area);
-		double sigmaDFT = fluidMixture.minimize(mp) / Area;
-		logPrintf("\nSigmaModel_CurvatureAndSigma: %.8lf\t%.8le\n", (droplet?-1.:1.)/radius, sigmaDFT);
+		return fluidMixture.minimize(mp) / Area;
+	}
+}
+
+int main(int argc, char** argv)
+{	initSystem(argc, argv);
+	
+	//Parse commandline:
+	if(argc != 6) { printUsage(); return 1; }
+	//--- 1:
+	FluidComponent::Name solventName;
+	if(!solventMap.getEnum(argv[1], solventName)) { logPrintf("Unrecognized <solventName> '%s'\n", argv[1]); printUsage(); return 1; }
+	//--- 2:
+	bool cylindrical = false;
+	if(string(argv[2])=="Cylinder") cylindrical = true;
+	else if(string(argv[2])=="Sphere") cylindrical = false;
+	else { logPrintf("Unrecognized geometry '%s'\n", argv[2]); printUsage(); return 1; }
+	//--- 3:
+	std::vector<double> radii;
+	{	istringstream iss(argv[3]);
+		string radiusStr;
+		while(getline(iss, radiusStr, ','))
+		{	istringstream issRadius(radiusStr);
+			double radius = 0.;
+			issRadius >> radius;
+			if(issRadius.fail()) { logPrintf("Could not parse <radiusInBohrs> from '%s'\n", radiusStr.c_str()); printUsage(); return 1; }
+			if(radius <= 0.) { logPrintf("<radiusInBohrs> must be > 0. (given %lg)\n", radius); printUsage(); return 1; }
+			radii.push_back(radius);
+		}
+		if(!radii.size()) { printUsage(); return 1; }
+	}
+	//--- 4:
+	bool droplet = false;
+	if(string(argv[4])=="Droplet") droplet = true;
+	else if(string(argv[4])=="Cavity") droplet = false;
+	else { logPrintf("Unrecognized topology '%s', must be 'Droplet' or 'Cavity'\n", argv[4]); printUsage(); return 1; }
+	//--- 5:
+	bool model = false;
+	if(string(argv[5])=="Model") model = true;
+	else if(string(argv[5])=="DFT") model = false;
+	else { logPrintf("Unrecognized mode '%s', must be 'Model' or 'DFT'\n", argv[5]); printUsage(); return 1; }
+	
+	//Compute each configuration:
+	FILE* fpCsv = 0;
+	if(radii.size()>1 && mpiWorld->isHead())
+	{	fpCsv = fopen("SigmaModel.csv", "w");
+		if(!fpCsv) die("Could not open SigmaModel.csv for writing.\n");
+		fprintf(fpCsv, "radius,curvature,sigma,time_s\n");
+	}
+	for(double radius: radii)
+	{	double tStart = clock_sec();
+		double sigma = computeSigma(solventName, cylindrical, radius, droplet, model);
+		double tConfig = clock_sec() - tStart;
+		double curvature = (droplet?-1.:1.)/radius;
+		logPrintf("\nSigmaModel_CurvatureAndSigma: %.8lf\t%.8le\t(%.2lf s)\n", curvature, sigma, tConfig);
+		if(fpCsv)
+		{	fprintf(fpCsv, "%.8lf,%.8lf,%.8le,%.3lf\n", radius, curvature, sigma, tConfig);
+			fflush(fpCsv);
+		}
 	}
+	if(fpCsv) fclose(fpCsv);
 	
 	finalizeSystem();
 	return 0;
@@ -26,12 +26,12 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 int main(int argc, char** argv)
 {	//Parse command line, initialize system and logs:
-	string inputFilename; bool dryRun, printDefaults;
-	initSystemCmdline(argc, argv, "Calculate electric dipole transition elements between two slater determinants.", inputFilename, dryRun, printDefaults);
-	
 	Everything e; //the parent data structure for, well, everything
+	InitParams ip("Calculate electric dipole transition elements between two slater determinants.", &e);
+	initSystemCmdline(argc, argv, ip);
+	
 	logSuspend(); e.elecMinParams.fpLog = nullLog;
-	parse(readInputFile(inputFilename), e, printDefaults);
+	parse(readInputFile(ip.inputFilename), e, ip.printDefaults);
 	e.setup();
 	logResume(); e.elecMinParams.fpLog = globalLog;
 	if(e.eInfo.isNoncollinear()) die("'%s' not yet implemented with noncollinear spins.\n", argv[0]);
@@ -47,8 +47,8 @@ int main(int argc, char** argv)
 	std::vector<ColumnBundle> C2(qnums);
 	init(C1, e.eInfo.nStates, e.eInfo.nBands, &(e.basis[0]), &(e.eInfo));
 	init(C2, e.eInfo.nStates, e.eInfo.nBands, &(e.basis[0]), &(e.eInfo));
-	read(C1, "C1.wfns", e.eInfo);
-	read(C2, "C2.wfns", e.eInfo);
+	e.eInfo.read(C1, "C1.wfns"); //reads only states on this process (per-state seeks for the indexed format)
+	e.eInfo.read(C2, "C2.wfns");
 
 	// Read fillings
 	std::vector<diagMatrix> F1(qnums);
@@ -71,95 +71,51 @@ int main(int argc, char** argv)
 		
 	}
 
-	std::vector<matrix> dipoleXMatrices(qnums);
-	std::vector<matrix> dipoleYMatrices(qnums);
-	std::vector<matrix> dipoleZMatrices(qnums);
-	std::vector<matrix> overlapMatrices(qnums);
-	complex detDipoleX = 1.;
-	complex detDipoleY = 1.;
-	complex detDipoleZ = 1.;
-	complex detOverlap = 1.;
+	//Select occupied orbitals of each state:
+	const double tol = 1e-4;
+	std::vector<std::vector<int>> occ1(qnums), occ2(qnums);
+	for(int q=0; q<qnums; q++)
+		for(int b=0; b<nbands; b++)
+		{	for(int iSet=0; iSet<2; iSet++)
+			{	double f = (iSet ? F2 : F1)[q][b];
+				if(f > tol && f < 1.-tol) die("Non-integer fillings found... Exiting.\n");
+				if(f >= 1.-tol) (iSet ? occ2 : occ1)[q].push_back(b);
+			}
+		}
 	
 	// Real-space kernels for the dipole calculations
-	ScalarField r0, r1, r2;
-	nullToZero(r0, e.gInfo); 	nullToZero(r1, e.gInfo); 	nullToZero(r2, e.gInfo);
-	applyFunc_r(e.gInfo, Moments::rn_pow_x, 0, e.gInfo.R, 1, vector3<>(0.,0.,0.), r0->data());
-	applyFunc_r(e.gInfo, Moments::rn_pow_x, 1, e.gInfo.R, 1, vector3<>(0.,0.,0.), r1->data());
-	applyFunc_r(e.gInfo, Moments::rn_pow_x, 2, e.gInfo.R, 1, vector3<>(0.,0.,0.), r2->data());
+	ScalarFieldArray r(3);
+	for(int iDir=0; iDir<3; iDir++)
+	{	nullToZero(r[iDir], e.gInfo);
+		applyFunc_r(e.gInfo, Moments::rn_pow_x, iDir, e.gInfo.R, 1, vector3<>(0.,0.,0.), r[iDir]->data());
+	}
 	
+	//Determinants for the states on this process, with the inner products batched over states:
+	int qStart = e.eInfo.qStart, qStop = e.eInfo.qStop;
+	std::vector<std::vector<complex>> dets(4); //overlap and dipole x, y, z
+	dets[0] = detOverlapBatch(C1, C2, occ1, occ2, qStart, qStop);
+	for(int iDir=0; iDir<3; iDir++)
+	{	std::vector<ColumnBundle> rC2(qnums);
+		for(int q=qStart; q<qStop; q++)
+			rC2[q] = Idag_DiagV_I(C2[q], ScalarFieldArray(1, r[iDir]));
+		dets[iDir+1] = detOverlapBatch(C1, rC2, occ1, occ2, qStart, qStop);
+	}
+	
+	//Collect over processes (each state's determinant is non-zero only on its owner):
+	std::vector<complex> detAll(4*qnums);
+	for(int iDet=0; iDet<4; iDet++)
+		for(int q=0; q<qnums; q++)
+			detAll[iDet*qnums+q] = dets[iDet][q];
+	mpiWorld->allReduceData(detAll, MPIUtil::ReduceSum);
+	complex detOverlap = 1., detDipoleX = 1., detDipoleY = 1., detDipoleZ = 1.;
 	logPrintf("\n");
-	for(size_t q =0; q<e.eInfo.qnums.size(); q++)
-	{	
-		logPrintf("Calculating qnum = %zu...", q);
-		
-		double n1 = trace(F1[q]); // No electrons in the q'th qnum for first wavefunction
-		double n2 = trace(F2[q]); // No electrons in the q'th qnum for second wavefunction
-		
-		logPrintf("\n\t%f electrons on F1(q=%zu)\n\t%f electrons on F2(q=%zu)", n1, q, n2, q);
-		
-		double tol = 1e-4;
-		if(std::abs(n1-n2) > tol)  // If different number of electrons are detected, all matrix elements are 0
-		{	detDipoleX *= 0.;
-			detDipoleY *= 0.;
-			detDipoleZ *= 0.;
-			detOverlap *= 0.;
-			break;  // No need to compute other quantum numbers
-		}
-		
-		int nfilled = round(n1);  // Get the number of filled states on each
-		int ni=0, nj=0;           // Counters for the reduced matricex (just filled orbitals)
-		int noBands = e.eInfo.nBands;
-		dipoleXMatrices.at(q).init(nfilled, nfilled);
-		dipoleYMatrices.at(q).init(nfilled, nfilled);
-		dipoleZMatrices.at(q).init(nfilled, nfilled);
-		overlapMatrices.at(q).init(nfilled, nfilled);
-		for(int i=0; i<noBands; i++)
-		{	nj = 0; // Reset nj
-			if(F1[q][i] < (1.-tol))  // Check whether i'th orbital is filled
-					continue;
-			for(int j=0; j<noBands; j++)
-			{	if(F2[q][j] < (1.-tol)) // Check whether j'th orbital is filled
-					continue;
-								
-				// If both orbitals are occupied, then return the matrix element
-				if((F1[q][i] > (1.-tol)) or (F2[q][j] > (1.-tol)))
-				{	
-					complexScalarField psi1 = I(C1.at(q).getColumn(i,0));
-					complexScalarField psi2 = I(C2.at(q).getColumn(j,0));
-					
-					complex dipoleX = (norm(detDipoleX) ? integral(psi1*r0*psi2) : 0.);
-					complex dipoleY = (norm(detDipoleY) ? integral(psi1*r1*psi2) : 0.);
-					complex dipoleZ = (norm(detDipoleZ) ? integral(psi1*r2*psi2) : 0.);
-					complex overlap = (norm(detOverlap) ? integral(psi1*psi2) : 0.);
-					
-					dipoleXMatrices.at(q).set(ni,nj, dipoleX);
-					dipoleYMatrices.at(q).set(ni,nj, dipoleY);
-					dipoleZMatrices.at(q).set(ni,nj, dipoleZ);
-					overlapMatrices.at(q).set(ni,nj, overlap);
-				}
-				else
-				{	die("Non-integer fillings found... Exiting.\n");
-				}
-				
-				nj++;
-			}
-			ni++;
-		}
-		
-		// Assert that the entire matrix have been filled
-		detDipoleX *= det(dipoleXMatrices.at(q));
-		detDipoleY *= det(dipoleYMatrices.at(q));
-		detDipoleZ *= det(dipoleZMatrices.at(q));
-		detOverlap *= det(overlapMatrices.at(q));
-		
-		logPrintf("\n\ndet = %.5e, %.5e\n", real(det(dipoleXMatrices.at(q))), imag(det(dipoleXMatrices.at(q))));
-		dipoleXMatrices.at(q).print(globalLog,"%.2e%+.2ei\t" );
-		logPrintf("\n");
-		
-		logPrintf("\nOverlap: (%.5e, %.5e)\n", real(detOverlap), imag(detOverlap));
-		logPrintf("Dipole: <(%5.e, %.5e), (%5.e, %.5e), (%5.e, %.5e)>\n\n",
-				  real(detDipoleX), imag(detDipoleX), real(detDipoleY), imag(detDipoleY), real(detDipoleZ), imag(detDipoleZ));
-		logPrintf("\n\n");
+	for(int q=0; q<qnums; q++)
+	{	logPrintf("qnum = %d: %lu electrons on F1 and %lu electrons on F2; overlap (%.5e, %.5e)\n",
+			q, occ1[q].size(), occ2[q].size(), detAll[q].real(), detAll[q].imag());
+		detOverlap *= detAll[q];
+		detDipoleX *= detAll[qnums+q];
+		detDipoleY *= detAll[2*qnums+q];
+		detDipoleZ *= detAll[3*qnums+q];
 	}
 	
 	/// //////////////////////////////// ///
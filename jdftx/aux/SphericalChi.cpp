@@ -87,9 +87,10 @@ struct SphericalFit : public Minimizable<diagMatrix>
 			int l = 1;
 			int atomStride = basis.nbasis;
 			colStart.push_back(colOffset);
+			AtomPhases phases(basis.gInfo->S, sp.atpos.size(), sp.atpos.data());
 			for(int m=-l; m<=l; m++)
-			{	callPref(Vnl)(basis.nbasis, atomStride, sp.atpos.size(), l, m, vector3<>(), basis.iGarr.dataPref(), e.gInfo.G, sp.atposManaged.dataPref(), f, U.dataPref()+colOffset*basis.nbasis);
-				callPref(Vnl)(basis.nbasis, atomStride, sp.atpos.size(), l, m, vector3<>(), basis.iGarr.dataPref(), e.gInfo.G, sp.atposManaged.dataPref(), df, dU.dataPref()+colOffset*basis.nbasis);
+			{	callPref(Vnl)(basis.nbasis, atomStride, sp.atpos.size(), l, m, vector3<>(), basis.iGarr.dataPref(), e.gInfo.G, sp.atposManaged.dataPref(), phases.tables(), f, U.dataPref()+colOffset*basis.nbasis);
+				callPref(Vnl)(basis.nbasis, atomStride, sp.atpos.size(), l, m, vector3<>(), basis.iGarr.dataPref(), e.gInfo.G, sp.atposManaged.dataPref(), phases.tables(), df, dU.dataPref()+colOffset*basis.nbasis);
 				colOffset += sp.atpos.size();
 			}
 			colStop.push_back(colOffset);
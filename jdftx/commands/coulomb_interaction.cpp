@@ -181,6 +181,33 @@ struct CommandCoulombTruncationIonMargin : public Command
 commandCoulombTruncationIonMargin;
 
 
+struct CommandCoulombKernelCache : public Command
+{
+	CommandCoulombKernelCache() : Command("coulomb-kernel-cache", "jdftx/Coulomb interactions")
+	{
+		format = "<dir>";
+		comments =
+			"Cache Wigner-Seitz truncated Coulomb kernels (for the Wire and Isolated geometries,\n"
+			"and for Wigner-Seitz truncated exact exchange) in directory <dir>, which must exist.\n"
+			"Each kernel is stored in a file named by a hash of the lattice vectors, sample count,\n"
+			"truncated directions and screening parameter, and is read back instead of recomputed\n"
+			"by any later calculation (or lattice step) with identical parameters. The directory\n"
+			"may be shared between jobs, and should be cleared manually when no longer needed.\n"
+			"(Default: no cache)";
+		hasDefault = false;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.coulombParams.kernelCacheDir, string(), "dir", true);
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", e.coulombParams.kernelCacheDir.c_str());
+	}
+}
+commandCoulombKernelCache;
+
+
 struct CommandExchangeRegularization : public Command
 {
 	CommandExchangeRegularization() : Command("exchange-regularization", "jdftx/Coulomb interactions")
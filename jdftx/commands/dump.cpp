@@ -132,7 +132,7 @@ EnumStringMap<DumpVariable> varMap
 );
 EnumStringMap<DumpVariable> varDescMap
 (	DumpNone,           "Dump nothing",
-	DumpState,          "All variables needed to restart calculation: wavefunction and fluid state/fillings if any",
+	DumpState,          "All variables needed to restart calculation: wavefunction and fluid state/fillings if any (and ionic minimizer history)",
 	DumpIonicPositions, "Ionic positions in the same format (and coordinate system) as the input file",
 	DumpForces,         "Forces on the ions in the coordinate system selected by command forces-output-coords",
 	DumpLattice,        "Lattice vectors in the same format as the input file",
@@ -160,7 +160,7 @@ EnumStringMap<DumpVariable> varDescMap
 	DumpQMC,            "Blip'd orbitals and potential for CASINO \\cite Katie-QMC",
 	DumpOcean,          "Wave functions for Ocean code",
 	DumpBGW,            "G-space wavefunctions, density and potential for Berkeley GW (requires HDF5 support)",
-	DumpRealSpaceWfns,  "Real-space wavefunctions (one column per file)",
+	DumpRealSpaceWfns,  "Real-space wavefunctions of selected bands (one file per state; see dump-realspace-wfns)",
 	DumpExcCompare,     "Energies for other exchange-correlation functionals (see command elec-ex-corr-compare)",
 	DumpFluidDebug,     "Fluid specific debug output if any ",
 	DumpSlabEpsilon,    "Local dielectric function of a slab (see command slab-epsilon) ",
@@ -275,6 +275,289 @@ struct CommandDumpInterval : public Command
 commandDumpInterval;
 
 
+enum WfnsFormat { WfnsFlat, WfnsIndexed };
+EnumStringMap<WfnsFormat> wfnsFormatMap(
+	WfnsFlat, "flat",
+	WfnsIndexed, "indexed" );
+
+struct CommandDumpWfnsFormat : public Command
+{
+	CommandDumpWfnsFormat() : Command("dump-wfns-format", "jdftx/Output")
+	{
+		format = "<format>=" + wfnsFormatMap.optionList() + " [<alignKB>=4]";
+		comments = 
+			"File format for wavefunctions in dump variable State:\n"
+			"+ flat: plain concatenation of all states (default).\n"
+			"+ indexed: header with a table of per-state offsets, basis sizes and checksums,\n"
+			"   followed by the data of each state starting at a multiple of <alignKB> kB.\n"
+			"   States are written in parallel from their owning processes and read back\n"
+			"   lazily by memory-mapping, so that each process only loads its own states.\n"
+			"   States missing from a partial checkpoint are randomized on reading.\n"
+			"   Set <alignKB> to the stripe size of parallel filesystems such as Lustre.\n"
+			"\n"
+			"Both formats are detected automatically when reading wavefunctions.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	WfnsFormat wfnsFormat;
+		pl.get(wfnsFormat, WfnsFlat, wfnsFormatMap, "format");
+		int alignKB;
+		pl.get(alignKB, 4, "alignKB");
+		if(alignKB < 4) throw string("<alignKB> must be at least 4 (the memory page size)");
+		e.dump.wfnsIndexedAlign = (wfnsFormat==WfnsIndexed) ? (size_t(alignKB) << 10) : 0;
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	if(e.dump.wfnsIndexedAlign) logPrintf("indexed %lu", e.dump.wfnsIndexedAlign >> 10);
+		else logPrintf("flat");
+	}
+}
+commandDumpWfnsFormat;
+
+
+enum ExcitationsFormat { ExcitationsText, ExcitationsBinary };
+EnumStringMap<ExcitationsFormat> excitationsFormatMap(
+	ExcitationsText, "text",
+	ExcitationsBinary, "binary" );
+
+struct CommandDumpExcitationsFormat : public Command
+{
+	CommandDumpExcitationsFormat() : Command("dump-excitations-format", "jdftx/Output")
+	{
+		format = "<format>=" + excitationsFormatMap.optionList() + " [<dEmin>] [<dEmax>]";
+		comments = 
+			"Output format and energy window for dump variable Excitations.\n"
+			"Only occupied-unoccupied pairs (at each k-point and spin) with excitation\n"
+			"energy in [<dEmin>, <dEmax>] (in Hartrees; unrestricted by default) are included,\n"
+			"and only bands that can contribute to such pairs are transformed, so that a\n"
+			"narrow window greatly reduces the cost with many bands.\n"
+			"+ text: gap summary followed by one line per excitation with transition strengths\n"
+			"   (default).\n"
+			"+ binary: gap summary in the log, and the sorted excitations in the file as\n"
+			"   fixed-size records of int32 q, o, u followed by float64 dE and the real\n"
+			"   and imaginary parts of the x, y and z components of <psi_u|r|psi_o>.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	ExcitationsFormat fmt;
+		pl.get(fmt, ExcitationsText, excitationsFormatMap, "format");
+		e.dump.excitationsBinary = (fmt==ExcitationsBinary);
+		pl.get(e.dump.excitationsWindow.first, -DBL_MAX, "dEmin");
+		pl.get(e.dump.excitationsWindow.second, DBL_MAX, "dEmax");
+		if(e.dump.excitationsWindow.second <= e.dump.excitationsWindow.first)
+			throw string("<dEmax> must exceed <dEmin>");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s %lg %lg", excitationsFormatMap.getString(e.dump.excitationsBinary ? ExcitationsBinary : ExcitationsText),
+			e.dump.excitationsWindow.first, e.dump.excitationsWindow.second);
+	}
+}
+commandDumpExcitationsFormat;
+
+
+struct CommandDumpCheckpoint : public Command
+{
+	CommandDumpCheckpoint() : Command("dump-checkpoint", "jdftx/Output")
+	{
+		format = "<minutes>";
+		comments = 
+			"Checkpoint the electronic state every <minutes> of wall time during electronic\n"
+			"minimization and SCF, without blocking the calculation. At the first electronic\n"
+			"iteration after each interval, the wavefunctions, eigenvalues, fillings (if\n"
+			"needed) and SCF history are copied in memory, and then written in a background\n"
+			"thread to the filenames of dump variable State (see dump-name). Wavefunctions\n"
+			"are always written in the indexed format (see dump-wfns-format).\n"
+			"\n"
+			"Each file is first written to <filename>.tmp, and renamed only once all processes\n"
+			"have completed writing, so that an interrupted checkpoint never damages the\n"
+			"previous one. A checkpoint is skipped if the previous one is still being written.\n"
+			"Restart from these files using initial-state as usual.\n"
+			"\n"
+			"This requires memory for an additional copy of the wavefunctions (and of the SCF\n"
+			"history on the head process) while a checkpoint is being written.";
+		hasDefault = false;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	double minutes;
+		pl.get(minutes, 0., "minutes", true);
+		if(minutes <= 0.) throw string("<minutes> must be positive");
+		e.dump.checkpointInterval = minutes * 60.;
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%lg", e.dump.checkpointInterval / 60.);
+	}
+}
+commandDumpCheckpoint;
+
+
+struct CommandDumpMetrics : public Command
+{
+	CommandDumpMetrics() : Command("dump-metrics", "jdftx/Output")
+	{
+		format = "<filename>";
+		comments = 
+			"Append a machine-readable record of each iteration of electronic minimization,\n"
+			"SCF, ionic and lattice minimization and ionic dynamics to <filename>, as one\n"
+			"JSON object per line (JSONL). Each record contains the fields:\n"
+			"\n"
+			"+ t: wall time in seconds since the start of the run\n"
+			"+ loop: one of ElecMinimize, SCF, IonicMinimize, LatticeMinimize or IonDynamics\n"
+			"+ iter: iteration number within that loop\n"
+			"+ E: energy being optimized (total energy for IonDynamics)\n"
+			"+ residual: RMS gradient (minimizers) or residual (SCF) norm, null for dynamics\n"
+			"+ dt: wall time since the previous record of the same loop\n"
+			"+ imbalance: maximum / mean over processes of Hamiltonian time since the previous record\n"
+			"+ maxRSS_MB: peak resident memory (maximum over processes) in MB\n"
+			"\n"
+			"along with gpuUsed_MB in GPU builds, and KE and pressure for IonDynamics.\n"
+			"Each line is flushed as it is written, so that the file can be monitored live.";
+		hasDefault = false;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.dump.metricsFilename, string(), "filename", true);
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", e.dump.metricsFilename.c_str());
+	}
+}
+commandDumpMetrics;
+
+
+struct CommandDumpHdf5 : public Command
+{
+	CommandDumpHdf5() : Command("dump-hdf5", "jdftx/Output")
+	{
+		format = "[<compression>=0]";
+		comments = 
+			"Write all scalar-field outputs (densities, potentials etc.) and real-space\n"
+			"wavefunctions (dump variable RealSpaceWfns) of each dump to a single HDF5 file,\n"
+			"instead of one raw binary file per field (and per band for wavefunctions).\n"
+			"The file is named as dump variable 'h5' would be (see dump-name), and contains:\n"
+			"+ R: lattice vectors (in columns) in bohrs\n"
+			"+ S: grid sample count\n"
+			"+ iter: iteration number of the dump\n"
+			"+ <var>: one dataset per field with dimensions S, named as the raw file suffix\n"
+			"+ wfnsRealSpace/<q>: complex wavefunctions of state q as (re,im) pairs,\n"
+			"  with dimensions bands*spinors x S x 2 (selected bands only, see\n"
+			"  dump-realspace-wfns; absent for states with no bands selected)\n"
+			"+ wfnsRealSpaceBandStart: index of first band in above for each state\n"
+			"\n"
+			"All values are in atomic units. Datasets are chunked by grid plane and written\n"
+			"collectively using MPI-IO. Set <compression> between 1 and 9 to gzip-compress\n"
+			"the chunks (requires HDF5 1.10.2 or later for parallel runs).\n"
+			"Other outputs, including State wavefunctions for restart, are written as usual.";
+		hasDefault = false;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{
+		#ifdef HDF5_ENABLED
+		pl.get(e.dump.hdf5Compression, 0, "compression");
+		if(e.dump.hdf5Compression<0 || e.dump.hdf5Compression>9) throw string("<compression> must be between 0 and 9");
+		#else
+		throw string("dump-hdf5 requires JDFTx to be compiled with HDF5 support (EnableHDF5)");
+		#endif
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%d", e.dump.hdf5Compression);
+	}
+}
+commandDumpHdf5;
+
+
+struct CommandDumpRealspaceWfns : public Command
+{
+	CommandDumpRealspaceWfns() : Command("dump-realspace-wfns", "jdftx/Output")
+	{
+		format = "<bandStart> <bandStop> [<Emin> <Emax>]";
+		comments = 
+			"Select the bands written by dump variable RealSpaceWfns, to the range of band\n"
+			"indices <bandStart> <= b < <bandStop> (zero-based, with <bandStop> = 0 => nBands).\n"
+			"If <Emin> and <Emax> are specified (in Hartrees), further restrict to bands with\n"
+			"subspace eigenvalues in that window, separately for each state.\n"
+			"\n"
+			"Bands are transformed to real space in blocks with batched FFTs and streamed\n"
+			"to one file per state, named as dump variable 'wfns_<q>.rs' would be, containing\n"
+			"a little-endian header of six 32-bit integers (first band, number of bands,\n"
+			"spinor length and the three grid dimensions), followed by the complex real-space\n"
+			"wavefunctions of each band (and spinor component) in turn, as (re,im) doubles.\n"
+			"The wavefunctions are written instead to the HDF5 file if dump-hdf5 is in use.\n"
+			"(Default: all bands)";
+		hasDefault = false;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	Dump::RealSpaceWfnsSelection& sel = e.dump.realSpaceWfnsSelection;
+		pl.get(sel.bandStart, 0, "bandStart", true);
+		pl.get(sel.bandStop, 0, "bandStop", true);
+		if(sel.bandStart < 0) throw string("<bandStart> must be non-negative");
+		if(sel.bandStop && sel.bandStop <= sel.bandStart) throw string("<bandStop> must exceed <bandStart> (or be 0)");
+		pl.get(sel.Emin, (double)NAN, "Emin");
+		if(!std::isnan(sel.Emin))
+		{	pl.get(sel.Emax, 0., "Emax", true);
+			if(sel.Emax < sel.Emin) throw string("<Emax> must be at least <Emin>");
+		}
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	const Dump::RealSpaceWfnsSelection& sel = e.dump.realSpaceWfnsSelection;
+		logPrintf("%d %d", sel.bandStart, sel.bandStop);
+		if(!std::isnan(sel.Emin)) logPrintf(" %lg %lg", sel.Emin, sel.Emax);
+	}
+}
+commandDumpRealspaceWfns;
+
+
+EnumStringMap<bool> fieldPrecisionMap
+(	false, "Double",
+	true,  "Single"
+);
+
+struct CommandDumpFieldFormat : public Command
+{
+	CommandDumpFieldFormat() : Command("dump-field-format", "jdftx/Output")
+	{
+		format = "<var> <precision>=" + fieldPrecisionMap.optionList() + " [<downsample>=1]";
+		comments = 
+			"Select the output format of scalar fields for dump variable <var>, such as\n"
+			"ElecDensity, Vscloc, Dtot, Dvac or KEdensity (see command dump).\n"
+			"With <precision> = Single, fields are written as 32-bit floats, halving the output.\n"
+			"With <downsample> > 1, fields are first Fourier resampled to a grid with the sample\n"
+			"count reduced by that factor along each direction (rounded up to an FFT-suitable\n"
+			"even number), which reduces the output by roughly the cube of <downsample>.\n"
+			"The reduced grid sample count is reported in the output when dumping.\n"
+			"This command applies to both raw binary and HDF5 output (see dump-hdf5), and\n"
+			"may be repeated for different <var>. (Default: Double 1 for all variables)";
+		allowMultiple = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	DumpVariable var;
+		pl.get(var, DumpNone, varMap, "var", true);
+		if(e.dump.fieldFormat.count(var)) throw string("Format specified more than once for <var> = ") + varMap.getString(var);
+		Dump::FieldFormat& ff = e.dump.fieldFormat[var];
+		pl.get(ff.singlePrecision, false, fieldPrecisionMap, "precision", true);
+		pl.get(ff.downsample, 1, "downsample");
+		if(ff.downsample < 1) throw string("<downsample> must be a positive integer");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	auto iter = e.dump.fieldFormat.begin();
+		std::advance(iter, iRep);
+		logPrintf("%s %s %d", varMap.getString(iter->first), fieldPrecisionMap.getString(iter->second.singlePrecision), iter->second.downsample);
+	}
+}
+commandDumpFieldFormat;
+
+
 struct CommandDumpName : public Command
 {
 	CommandDumpName() : Command("dump-name", "jdftx/Output")
@@ -326,8 +609,15 @@ struct CommandPolarizability : public Command
 {
     CommandPolarizability() : Command("polarizability", "jdftx/Output")
 	{
-		format = "<eigenBasis>=" + polarizabilityMap.optionList() + " [<Ecut>=0] [<nEigs>=0]";
-		comments = "Output polarizability matrix in specified eigenBasis";
+		format = "<eigenBasis>=" + polarizabilityMap.optionList() + " [<Ecut>=0] [<nEigs>=0] [<lowRank>=no]";
+		comments = "Output polarizability matrix in specified eigenBasis.\n"
+			"\n"
+			"If <lowRank> = yes (which requires eigenBasis NonInteracting and a non-zero <nEigs>),\n"
+			"find the <nEigs> dominant eigenvectors of the non-interacting response by subspace\n"
+			"iteration, without forming the response matrix in the full plane-wave or CV basis,\n"
+			"and compute all the other response matrices within their span. This reduces memory\n"
+			"from O(nbasis^2) to O(nbasis*nEigs), at the cost of approximating Xext and Xtot\n"
+			"by their projections computed within this subspace.";
 		
 		forbid("electron-scattering"); //both are major operations that are given permission to destroy Everything if necessary
 	}
@@ -337,12 +627,13 @@ struct CommandPolarizability : public Command
 		pl.get(e.dump.polarizability->eigenBasis, Polarizability::NonInteracting, polarizabilityMap, "eigenBasis");
 		pl.get(e.dump.polarizability->Ecut, 0., "Ecut");
 		pl.get(e.dump.polarizability->nEigs, 0, "nEigs");
+		pl.get(e.dump.polarizability->lowRank, false, boolMap, "lowRank");
 		e.dump.insert(std::make_pair(DumpFreq_End, DumpPolarizability));
 	}
 
 	void printStatus(Everything& e, int iRep)
-	{	logPrintf("%s %lg %d", polarizabilityMap.getString(e.dump.polarizability->eigenBasis),
-			e.dump.polarizability->Ecut, e.dump.polarizability->nEigs);
+	{	logPrintf("%s %lg %d %s", polarizabilityMap.getString(e.dump.polarizability->eigenBasis),
+			e.dump.polarizability->Ecut, e.dump.polarizability->nEigs, boolMap.getString(e.dump.polarizability->lowRank));
 	}
 }
 commandPolarizability;
@@ -561,6 +852,9 @@ enum VibrationsMember
 	VM_omegaMin,
 	VM_T,
 	VM_omegaResolution,
+	VM_taskCount,
+	VM_taskIndex,
+	VM_resultsFile,
 	VM_Delim
 };
 
@@ -572,7 +866,10 @@ EnumStringMap<VibrationsMember> vibMap
 	VM_rotationSym, "rotationSym",
 	VM_omegaMin, "omegaMin",
 	VM_T, "T",
-	VM_omegaResolution, "omegaResolution"
+	VM_omegaResolution, "omegaResolution",
+	VM_taskCount, "taskCount",
+	VM_taskIndex, "taskIndex",
+	VM_resultsFile, "resultsFile"
 );
 
 struct CommandVibrations : public Command
@@ -599,6 +896,13 @@ struct CommandVibrations : public Command
 			"+ T <T>: temperature (in Kelvin) for free energy calculation (default: 298)\n"
 			"+ omegaResolution <omegaResolution>: resolution for detecting and reporting degeneracies\n"
 			"   in modes (default: 1e-4). Does not affect free energies and all modes are still printed.\n"
+			"+ resultsFile <prefix>: save forces and dipoles of each displaced configuration to <prefix>.<taskIndex>,\n"
+			"   and reuse the results of all tasks found in <prefix>.* (to restart, or to merge tasks).\n"
+			"+ taskCount <n>: divide the displaced configurations between n independent runs (default: 1),\n"
+			"   which may be launched simultaneously with the same input, differing only in taskIndex.\n"
+			"   Each run starts from the ground state and computes only its share; a subsequent run with\n"
+			"   all results available in resultsFile (required when n > 1) merges them and analyzes the modes.\n"
+			"+ taskIndex <i>: subset of displaced configurations computed by this run (0 to n-1, default: 0).\n"
 			"\n"
 			"Note that for a periodic system with k-points, wave functions may be incompatible\n"
 			"with and without the vibrations command due to symmetry-breaking by the perturbations.\n"
@@ -623,7 +927,12 @@ struct CommandVibrations : public Command
 				case VM_omegaMin: pl.get(e.vibrations->omegaMin, 2e-4, "omegaMin", true); break;
 				case VM_T: pl.get(e.vibrations->T, 298., "T", true); e.vibrations->T *= Kelvin; break;
 				case VM_omegaResolution: pl.get(e.vibrations->omegaResolution, 1e-4, "omegaResolution", true); break;
-				case VM_Delim: return; //end of input
+				case VM_taskCount: pl.get(e.vibrations->nTasks, 1, "taskCount", true); if(e.vibrations->nTasks<1) throw string("<taskCount> must be >= 1"); break;
+				case VM_taskIndex: pl.get(e.vibrations->iTask, 0, "taskIndex", true); break;
+				case VM_resultsFile: pl.get(e.vibrations->resultsFilename, string(), "resultsFile", true); break;
+				case VM_Delim:
+					if(e.vibrations->iTask<0 || e.vibrations->iTask>=e.vibrations->nTasks) throw string("<taskIndex> must be in [0,taskCount)");
+					return; //end of input
 			}
 		}
 		
@@ -638,6 +947,9 @@ struct CommandVibrations : public Command
 		logPrintf("\\\n\tomegaMin %g", e.vibrations->omegaMin);
 		logPrintf("\\\n\tT %g", e.vibrations->T/Kelvin);
 		logPrintf("\\\n\tomegaResolution %g", e.vibrations->omegaResolution);
+		logPrintf("\\\n\ttaskCount %d", e.vibrations->nTasks);
+		logPrintf("\\\n\ttaskIndex %d", e.vibrations->iTask);
+		if(e.vibrations->resultsFilename.length()) logPrintf("\\\n\tresultsFile %s", e.vibrations->resultsFilename.c_str());
 	}
 }
 commandVibrations;
@@ -915,6 +1227,7 @@ enum BGWparamsMember
 {	BGWpm_nBandsDense,
 	BGWpm_blockSize,
 	BGWpm_clusterSize,
+	BGWpm_nBandsChunk,
 	BGWpm_EcutChiFluid,
 	BGWpm_q0,
 	BGWpm_freqReMax_eV,
@@ -928,6 +1241,7 @@ EnumStringMap<BGWparamsMember> bgwpmMap
 (	BGWpm_nBandsDense, "nBandsDense",
 	BGWpm_blockSize, "blockSize",
 	BGWpm_clusterSize, "clusterSize",
+	BGWpm_nBandsChunk, "nBandsChunk",
 	BGWpm_EcutChiFluid, "EcutChiFluid",
 	BGWpm_q0, "q0",
 	BGWpm_freqReMax_eV, "freqReMax_eV",
@@ -940,6 +1254,7 @@ EnumStringMap<BGWparamsMember> bgwpmDescMap
 (	BGWpm_nBandsDense, "If non-zero, use a dense ScaLAPACK solver to calculate more bands",
 	BGWpm_blockSize, "Block size for ScaLAPACK diagonalization (default: 32)",
 	BGWpm_clusterSize, "Maximum eigenvalue cluster size to allocate extra ScaLAPACK workspace for (default: 10)",
+	BGWpm_nBandsChunk, "Maximum number of bands per collective wavefunction write, bounding the write buffer (default: 0 => all bands)",
 	BGWpm_EcutChiFluid, "KE cutoff in hartrees for fluid polarizability output (default: 0; set non-zero to enable)",
 	BGWpm_q0, "Zero wavevector replacement to be used for polarizability output (default: (0,0,0))",
 	BGWpm_freqReMax_eV, "Maximum real frequency in eV (default: 30.)",
@@ -974,6 +1289,7 @@ struct CommandBGWparams : public Command
 			{	READ_AND_CHECK(nBandsDense, >=, 0)
 				READ_AND_CHECK(blockSize, >, 0)
 				READ_AND_CHECK(clusterSize, >, 0)
+				READ_AND_CHECK(nBandsChunk, >=, 0)
 				READ_AND_CHECK(EcutChiFluid, >=, 0.)
 				case BGWpm_q0:
 					for(int dir=0; dir<3; dir++)
@@ -997,6 +1313,7 @@ struct CommandBGWparams : public Command
 		PRINT(nBandsDense, "%d")
 		PRINT(blockSize, "%d")
 		PRINT(clusterSize, "%d")
+		PRINT(nBandsChunk, "%d")
 		PRINT(EcutChiFluid, "%lg")
 		logPrintf(" \\\n\tq0 %lg %lg %lg", bgwp.q0[0], bgwp.q0[1], bgwp.q0[2]);
 		PRINT(freqReMax_eV, "%lg")
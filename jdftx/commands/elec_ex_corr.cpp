@@ -322,3 +322,63 @@ struct CommandExchangeParameters : public Command
 	}
 }
 commandExchangeParameters;
+
+
+struct CommandExchangePairScreening : public Command
+{
+	CommandExchangePairScreening() : Command("exchange-pair-screening", "jdftx/Electronic/Functional")
+	{
+		format = "<threshold> [<localize>=yes]";
+		comments =
+			"Skip orbital pairs in exact exchange whose pair density is negligible.\n"
+			"A pair is skipped when a Cauchy-Schwarz bound on the integral of |psi_i psi_j|,\n"
+			"accumulated from the orbital norms within blocks of 4^3 grid points,\n"
+			"is below <threshold> (a dimensionless fraction of the overlap of normalized\n"
+			"orbitals; try 1e-4 to 1e-6).\n"
+			"\n"
+			"If <localize> = yes, the occupied orbitals of each state are first rotated\n"
+			"to localized orbitals by the selected-columns-of-density-matrix (SCDM) method,\n"
+			"so that the number of retained pairs grows roughly linearly with system size\n"
+			"in large insulating cells. Exact exchange is invariant under this rotation\n"
+			"only for uniform occupied fillings, so states with fractional fillings\n"
+			"retain their canonical orbitals.";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.exCorr.exxPairThreshold, 0., "threshold", true);
+		pl.get(e.exCorr.exxLocalize, true, boolMap, "localize");
+		if(e.exCorr.exxPairThreshold < 0.) throw string("<threshold> must be >= 0");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%lg %s", e.exCorr.exxPairThreshold, boolMap.getString(e.exCorr.exxLocalize));
+	}
+}
+commandExchangePairScreening;
+
+
+struct CommandExchangeReduceImages : public Command
+{
+	CommandExchangeReduceImages() : Command("exchange-reduce-images", "jdftx/Electronic/Functional")
+	{
+		format = "<reduce>=yes|no";
+		comments =
+			"Whether to evaluate each distinct image of a reduced k-point under the\n"
+			"symmetry group only once in exact exchange, weighted by the number of\n"
+			"operations (the coset of the k-point's little group) that produce it.\n"
+			"This is exact for wavefunctions and fillings consistent with the symmetries,\n"
+			"and reduces the cost for k-points of high symmetry, such as Gamma in bulk\n"
+			"solids with many symmetry operations. Default: yes.";
+		
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.exCorr.exxReduceImages, true, boolMap, "reduce");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", boolMap.getString(e.exCorr.exxReduceImages));
+	}
+}
+commandExchangeReduceImages;
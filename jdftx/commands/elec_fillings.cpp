@@ -124,6 +124,44 @@ commandTargetMu;
 
 //-------------------------------------------------------------------------------------------------
 
+struct CommandTargetMuScan : public Command
+{
+	CommandTargetMuScan() : Command("target-mu-scan", "jdftx/Electronic/Parameters")
+	{
+		format = "<mu1> <mu2> ...";
+		comments =
+			"Scan a list of electron chemical potentials (absolute, in Hartrees, as in target-mu)\n"
+			"in a single run, replacing the <mu> of target-mu (whose <outerLoop> setting is used).\n"
+			"The calculation (including any ionic minimization) at each <mu> starts from the\n"
+			"converged electronic and fluid state of the previous one, and SCF resumes from\n"
+			"the Pulay history of the previous point. From the third point onwards, the initial\n"
+			"electron count is extrapolated using the differential capacitance dN/dmu of the\n"
+			"previous two points (used by the auxiliary-Hamiltonian fillings and the outer loop).\n"
+			"The charge-potential curve (mu, nElectrons and free energy at each point) is written\n"
+			"to the dump file with variable name muScan; other outputs are dumped for the last point.";
+		
+		require("target-mu");
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	if(std::isnan(e.eInfo.mu)) throw string("target-mu-scan requires target-mu");
+		e.eInfo.muScan.clear();
+		while(true)
+		{	double mu; pl.get(mu, double(NAN), "mu");
+			if(std::isnan(mu)) break;
+			e.eInfo.muScan.push_back(mu);
+		}
+		if(!e.eInfo.muScan.size()) throw string("At least one <mu> must be specified");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	for(double mu: e.eInfo.muScan) logPrintf(" %lg", mu);
+	}
+}
+commandTargetMuScan;
+
+//-------------------------------------------------------------------------------------------------
+
 struct CommandTargetBz : public Command
 {
 	CommandTargetBz() : Command("target-Bz", "jdftx/Electronic/Parameters")
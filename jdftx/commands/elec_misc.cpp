@@ -47,6 +47,36 @@ struct CommandElecCutoff : public Command
 }
 commandElecCutoff;
 
+
+struct CommandElecInitialCutoff : public Command
+{
+	CommandElecInitialCutoff() : Command("elec-initial-cutoff", "jdftx/Initialization")
+	{
+		format = "<EcutInitial> [<dEthreshold>=1e-4]";
+		comments =
+			"Converge fresh (LCAO or random) wavefunctions with a reduced planewave cutoff\n"
+			"<EcutInitial> in Hartrees first, until the energy changes by less than <dEthreshold>\n"
+			"per iteration, and then promote them to the full basis (see elec-cutoff) to continue.\n"
+			"The charge-density grid is unchanged, so only the wavefunction cost is reduced in\n"
+			"the first stage. The stage runs only once, before the first electronic minimization\n"
+			"that starts from fresh wavefunctions (and in vacuum when a fluid is present).";
+		require("elec-cutoff");
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.EcutInitial, 0., "EcutInitial", true);
+		pl.get(e.cntrl.EcutInitialThreshold, 1e-4, "dEthreshold");
+		if(e.cntrl.EcutInitial <= 0. || e.cntrl.EcutInitial >= e.cntrl.Ecut)
+			throw string("<EcutInitial> must be positive and less than <Ecut>");
+		if(e.cntrl.EcutInitialThreshold <= 0.) throw string("<dEthreshold> must be positive");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%lg %lg", e.cntrl.EcutInitial, e.cntrl.EcutInitialThreshold);
+	}
+}
+commandElecInitialCutoff;
+
 //-------------------------------------------------------------------------------------------------
 
 struct CommandFftbox : public Command
@@ -72,6 +102,72 @@ commandFftbox;
 
 //-------------------------------------------------------------------------------------------------
 
+static EnumStringMap<unsigned> plannerMap(FFTW_ESTIMATE, "Estimate", FFTW_MEASURE, "Measure", FFTW_PATIENT, "Patient");
+
+struct CommandFftPlan : public Command
+{
+	CommandFftPlan() : Command("fft-plan", "jdftx/Miscellaneous")
+	{
+		format = "<rigor>=" + plannerMap.optionList() + " [<autotune>=no] [<wisdomFile>]";
+		comments =
+			"Control the creation of the FFTW plans used for CPU Fourier transforms:\n"
+			"+ <rigor>: planner effort: Estimate, Measure (default) or Patient.\n"
+			"+ <autotune>: yes/no: if yes, also time each plan with successively halved\n"
+			"   thread counts and use the fastest (reported in the log for each plan).\n"
+			"+ <wisdomFile>: if specified, import FFTW wisdom from <wisdomFile>.<cpuTag> at the\n"
+			"   first plan, and export the accumulated wisdom back to it whenever a new plan is\n"
+			"   created, where <cpuTag> is a hash of the CPU model. Wisdom is keyed on grid shape\n"
+			"   and thread count by FFTW, so a file shared by many jobs on the same hardware\n"
+			"   eliminates planning time from all but the first job (especially with Patient).\n"
+			"Has no effect on GPU transforms, or when FFTs are provided by MKL (which has no planner).";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(GridInfo::plannerFlags, unsigned(FFTW_MEASURE), plannerMap, "rigor");
+		pl.get(GridInfo::planAutotune, false, boolMap, "autotune");
+		pl.get(GridInfo::wisdomFilename, string(), "wisdomFile");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s %s", plannerMap.getString(GridInfo::plannerFlags), boolMap.getString(GridInfo::planAutotune));
+		if(GridInfo::wisdomFilename.length()) logPrintf(" %s", GridInfo::wisdomFilename.c_str());
+	}
+}
+commandFftPlan;
+
+//-------------------------------------------------------------------------------------------------
+
+struct CommandFftboxTune : public Command
+{
+	CommandFftboxTune() : Command("fftbox-tune", "jdftx/Miscellaneous")
+	{
+		format = "<nCandidates>";
+		comments =
+			"Choose the automatic fftbox size by timing rather than as the smallest FFT-suitable size.\n"
+			"Up to <nCandidates> FFT-suitable sizes (within 20% of the minimum) are considered along each\n"
+			"independent (symmetry-compatible) direction, and the combination with the lowest cost\n"
+			"(measured transform time plus grid-point work, which scales with the number of grid points\n"
+			"for densities and fluids) is selected on the head process and used on all processes.\n"
+			"If a wisdom file is specified by fft-plan, the choice is cached in <wisdomFile>.<cpuTag>.fftbox,\n"
+			"keyed by the FFT backend (and GPU model), thread count and minimum size, and reused by later runs.\n"
+			"Has no effect when the fftbox is specified explicitly. Default: 0 (disabled).";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.gInfo.nTuneS, 0, "nCandidates");
+		if(e.gInfo.nTuneS < 0) throw string("<nCandidates> must be non-negative");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%d", e.gInfo.nTuneS);
+	}
+}
+commandFftboxTune;
+
+//-------------------------------------------------------------------------------------------------
+
 struct CommandElecNbands : public Command
 {
 	CommandElecNbands() : Command("elec-n-bands", "jdftx/Electronic/Parameters")
@@ -259,21 +355,91 @@ commandConvergeEmptyStates;
 
 //-------------------------------------------------------------------------------------------------
 
+struct CommandBandStreaming : public Command
+{
+	CommandBandStreaming() : Command("band-streaming", "jdftx/Electronic/Optimization")
+	{
+		format = "yes|no";
+		comments = "Whether band-structure calculations (see fix-electron-density or fix-electron-potential)\n"
+			"should solve one state at a time and discard its wavefunctions once solved (default no).\n"
+			"Each state starts from the converged bands of the previous one, and its eigenvalues\n"
+			"are written to the eigenvals dump file as soon as it completes. This reduces memory\n"
+			"to the wavefunctions of two states per process, but disables restart and other\n"
+			"wavefunction-dependent outputs (which are dropped with a warning). Ignored otherwise.";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.streamBands, false, boolMap, "shouldStream", true);
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", boolMap.getString(e.cntrl.streamBands));
+	}
+}
+commandBandStreaming;
+
+//-------------------------------------------------------------------------------------------------
+
+struct CommandWavefunctionOffload : public Command
+{
+	CommandWavefunctionOffload() : Command("wavefunction-offload", "jdftx/Electronic/Optimization")
+	{
+		format = "<gpuBudget>";
+		comments = "Limit the wavefunction-sized data (ColumnBundles: wavefunctions, gradients, search directions\n"
+			"and Hamiltonian temporaries) resident on each GPU to <gpuBudget> MB (default 0: unlimited).\n"
+			"The least-recently used ColumnBundles beyond this budget are moved to host memory, and automatically\n"
+			"moved back on their next use on the GPU. Loops over states additionally prefetch the wavefunctions\n"
+			"of the next state in the background while the current one is computed, which only overlaps with\n"
+			"computation when compiled with PinnedHostMemory=yes (page-locked host memory).\n"
+			"This allows systems with many k-points per process to run on fewer GPUs, at the cost of host-device\n"
+			"transfers (reported at the end of the run with the memory usage). Ignored in CPU-only builds.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	double gpuBudgetMB;
+		pl.get(gpuBudgetMB, 0., "gpuBudget");
+		if(gpuBudgetMB < 0.) throw string("<gpuBudget> must be non-negative");
+		#ifdef GPU_ENABLED
+		ManagedMemoryBase::gpuBudget = size_t(gpuBudgetMB * (1<<20));
+		#endif
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%lg", ManagedMemoryBase::gpuBudget/double(1<<20));
+	}
+}
+commandWavefunctionOffload;
+
+//-------------------------------------------------------------------------------------------------
+
 struct CommandWavefunctionDrag : public Command
 {
 	CommandWavefunctionDrag() : Command("wavefunction-drag", "jdftx/Ionic/Optimization")
 	{
-		format = "yes|no";
+		format = "yes|no [<nHistory>=0]";
 		comments =
-			"Drag wavefunctions when ions are moved using atomic orbital projections (yes by default).";
+			"Drag wavefunctions when ions are moved using atomic orbital projections (yes by default).\n"
+			"\n"
+			"With <nHistory> = 2 or 3, ionic minimization steps additionally predict the wavefunctions\n"
+			"from the converged ones of the previous <nHistory> positions, each rotated within its subspace\n"
+			"(Lowdin alignment) to best match the latest. The new displacement is least-squares fit to the\n"
+			"previous ones, the wavefunctions are extrapolated with the same coefficients, and only the\n"
+			"remaining displacement is handled by the atomic-orbital drag. The density of the first SCF\n"
+			"(Pulay) iteration follows from the predicted wavefunctions. This typically reduces the electronic\n"
+			"iterations per ionic step, at the cost of storing <nHistory> copies of the wavefunctions.\n"
+			"The default <nHistory> = 0 only drags the previous wavefunctions.";
 	}
 
 	void process(ParamList& pl, Everything& e)
 	{	pl.get(e.cntrl.dragWavefunctions, true, boolMap, "shouldDrag", true);
+		pl.get(e.cntrl.dragHistory, 0, "nHistory");
+		if(e.cntrl.dragHistory && (e.cntrl.dragHistory < 2 || e.cntrl.dragHistory > 3))
+			throw string("<nHistory> must be 0, 2 or 3");
 	}
 
 	void printStatus(Everything& e, int iRep)
-	{	logPrintf("%s", boolMap.getString(e.cntrl.dragWavefunctions));
+	{	logPrintf("%s %d", boolMap.getString(e.cntrl.dragWavefunctions), e.cntrl.dragHistory);
 	}
 }
 commandWavefunctionDrag;
@@ -284,23 +450,97 @@ struct CommandCacheProjectors : public Command
 {
 	CommandCacheProjectors() : Command("cache-projectors", "jdftx/Miscellaneous")
 	{
-		format = "yes|no";
+		format = "yes|no [<maxMB>=0] [<onTheFly>=no]";
 		comments =
-			"Cache nonlocal-pseudopotential projectors (yes by default); turn off to save memory.";
+			"Cache nonlocal-pseudopotential projectors (yes by default); turn off to save memory.\n"
+			"The orbitals of DFT+U corrections (see add-U) are cached along with the projectors.\n"
+			"\n"
+			"If <maxMB> is non-zero, limit the memory of cached projectors (for all species and\n"
+			"k-points together, on each process) to <maxMB> megabytes, evicting the least recently\n"
+			"used projectors when necessary. Otherwise, the cache is unlimited.\n"
+			"\n"
+			"If <onTheFly>=yes, projectors that are not cached (all of them if caching is off, or\n"
+			"those too large for <maxMB>) are built in blocks of atoms fused with the projections\n"
+			"and their gradients, so that the projectors of all atoms are never held in memory.\n"
+			"This reduces memory usage for large supercells with many atoms per species.";
 	}
 
 	void process(ParamList& pl, Everything& e)
 	{	pl.get(e.cntrl.cacheProjectors, true, boolMap, "shouldCache", true);
+		double maxMB; pl.get(maxMB, 0., "maxMB");
+		if(maxMB < 0.) throw string("<maxMB> must be non-negative");
+		e.iInfo.projectorCache.maxBytes = size_t(maxMB * (1<<20));
+		pl.get(e.cntrl.projectorsOnTheFly, false, boolMap, "onTheFly");
 	}
 
 	void printStatus(Everything& e, int iRep)
-	{	logPrintf("%s", boolMap.getString(e.cntrl.cacheProjectors));
+	{	logPrintf("%s %lg %s", boolMap.getString(e.cntrl.cacheProjectors),
+			e.iInfo.projectorCache.maxBytes / double(1<<20),
+			boolMap.getString(e.cntrl.projectorsOnTheFly));
 	}
 }
 commandCacheProjectors;
 
 //-------------------------------------------------------------------------------------------------
 
+struct CommandRealspaceProjectors : public Command
+{
+	CommandRealspaceProjectors() : Command("realspace-projectors", "jdftx/Electronic/Parameters")
+	{
+		format = "[<tol>=1e-4]";
+		comments =
+			"Apply nonlocal-pseudopotential projectors in real space, within a sphere around each atom,\n"
+			"instead of with plane-wave projectors spanning the whole cell. The radial functions are\n"
+			"filtered (King-Smith et al., PRB 44, 13063 (1991)) and truncated beyond the radius where\n"
+			"they fall below <tol> times their maximum, which sets the accuracy / locality trade-off.\n"
+			"This scales linearly with cell size per atom and is beneficial for large supercells.\n"
+			"Only the projections and the Hamiltonian are affected; forces and stresses still use\n"
+			"reciprocal-space projectors. Not supported on GPUs (ignored with a warning).";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.realSpaceProjectorTol, 1e-4, "tol");
+		if(e.cntrl.realSpaceProjectorTol <= 0.) throw string("<tol> must be positive");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%lg", e.cntrl.realSpaceProjectorTol);
+	}
+}
+commandRealspaceProjectors;
+
+//-------------------------------------------------------------------------------------------------
+
+struct CommandElecMixedPrecision : public Command
+{
+	CommandElecMixedPrecision() : Command("elec-mixed-precision", "jdftx/Electronic/Optimization")
+	{
+		format = "[<dEthreshold>=1e-4]";
+		comments =
+			"Perform the batched wavefunction Fourier transforms in single precision during the early\n"
+			"electronic iterations, and switch to double precision once the energy change per iteration\n"
+			"of the electronic minimizer (or SCF cycle) drops below <dEthreshold> Hartrees.\n"
+			"Each electronic minimization (eg. at every ionic step) starts again in single precision.\n"
+			"Wavefunctions and all other arrays remain double precision; only the transforms (and their\n"
+			"scratch buffers) are affected, which is most beneficial on GPUs with low FP64 throughput.\n"
+			"Requires a GPU build, or a CPU build with EnableSinglePrecisionFFT.";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.mixedPrecisionThreshold, 1e-4, "dEthreshold");
+		if(e.cntrl.mixedPrecisionThreshold <= 0.) throw string("<dEthreshold> must be positive");
+		if(!GridInfo::singlePrecisionAvailable())
+			throw string("single-precision FFTs not available: rebuild with EnableSinglePrecisionFFT");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%lg", e.cntrl.mixedPrecisionThreshold);
+	}
+}
+commandElecMixedPrecision;
+
+//-------------------------------------------------------------------------------------------------
+
 struct CommandBasis : public Command
 {
 	CommandBasis() : Command("basis", "jdftx/Electronic/Parameters")
@@ -323,14 +563,19 @@ commandBasis;
 
 //-------------------------------------------------------------------------------------------------
 
-static EnumStringMap<ElecEigenAlgo> elecEigenMap(ElecEigenCG, "CG", ElecEigenDavidson, "Davidson");
+static EnumStringMap<ElecEigenAlgo> elecEigenMap(ElecEigenCG, "CG", ElecEigenDavidson, "Davidson", ElecEigenPPCG, "PPCG", ElecEigenChebyshev, "Chebyshev");
 
 struct CommandElecEigenAlgo : public Command
 {
     CommandElecEigenAlgo() : Command("elec-eigen-algo", "jdftx/Electronic/Optimization")
 	{
 		format = "<algo>=" + elecEigenMap.optionList();
-		comments = "Selects eigenvalue algorithm for band-structure calculations or inner loop of SCF.";
+		comments = "Selects eigenvalue algorithm for band-structure calculations or inner loop of SCF.\n"
+			"PPCG (projected preconditioned conjugate gradients) performs Rayleigh-Ritz only in small\n"
+			"blocks of bands on most iterations, and is faster than Davidson for large numbers of bands.\n"
+			"Chebyshev (Chebyshev-filtered subspace iteration) applies a polynomial filter in H followed by\n"
+			"one Rayleigh-Ritz per step, which suits the inner loop of SCF with many bands (especially on GPUs).\n"
+			"It does not converge bands tightly in one call, and requires norm-conserving pseudopotentials.";
 		hasDefault = true;
 	}
 
@@ -346,6 +591,34 @@ commandElecEigenAlgo;
 
 //-------------------------------------------------------------------------------------------------
 
+static EnumStringMap<ElecVars::OrthoMethod> orthoMethodMap(ElecVars::OrthoSymmetric, "Symmetric", ElecVars::OrthoCholesky, "Cholesky");
+
+struct CommandWavefunctionOrthonormalization : public Command
+{
+	CommandWavefunctionOrthonormalization() : Command("wavefunction-orthonormalization", "jdftx/Electronic/Optimization")
+	{
+		format = "<method>=" + orthoMethodMap.optionList();
+		comments = "Select how wavefunctions are orthonormalized during minimization:\n"
+			"+ Symmetric: Lowdin orthonormalization by the inverse square root of the overlap,\n"
+			"   which needs an eigen-decomposition of the overlap for each state (default).\n"
+			"+ Cholesky: CholeskyQR2 by triangular factors of the overlap, which is several times\n"
+			"   cheaper for large numbers of bands. States with ill-conditioned overlaps\n"
+			"   (condition number above 1e8) fall back to symmetric orthonormalization.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.eVars.orthoMethod, ElecVars::OrthoSymmetric, orthoMethodMap, "method");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	fputs(orthoMethodMap.getString(e.eVars.orthoMethod), globalLog);
+	}
+}
+commandWavefunctionOrthonormalization;
+
+//-------------------------------------------------------------------------------------------------
+
 struct CommandRhoExternal : public Command
 {
 	CommandRhoExternal() : Command("rhoExternal", "jdftx/Coulomb interactions")
@@ -401,6 +674,34 @@ commandVexternal;
 
 //-------------------------------------------------------------------------------------------------
 
+struct CommandExternalRefresh : public Command
+{
+	CommandExternalRefresh() : Command("external-refresh", "jdftx/Electronic/Parameters")
+	{
+		format = "<enable>=yes|no";
+		comments =
+			"If <enable>=yes (default no), check before each electronic minimization (eg. at every\n"
+			"ionic or dynamics step) whether the files specified by Vexternal and rhoExternal have\n"
+			"been modified, and if so, re-read them and update the external potential and charge in memory.\n"
+			"Wavefunctions, SCF history and fluid state carry over, so that an external driver\n"
+			"(eg. the MM part of an electrostatic embedding) can update these between steps without restarting.\n"
+			"Box potentials and electric fields are retained unchanged.\n"
+			"Programs embedding JDFTx may instead use ElecVars::setExternal directly.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.eVars.externalRefresh, false, boolMap, "enable");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", boolMap.getString(e.eVars.externalRefresh));
+	}
+}
+commandExternalRefresh;
+
+//-------------------------------------------------------------------------------------------------
+
 struct CommandBoxPotential : public Command
 {
 	CommandBoxPotential() : Command("box-potential", "jdftx/Electronic/Parameters")
@@ -80,11 +80,16 @@ struct CommandFluidGummelLoop : public Command
 {
 	CommandFluidGummelLoop() : Command("fluid-gummel-loop", "jdftx/Fluid/Optimization")
 	{
-		format = "[<maxIterations>=10] [<Atol>=1e-5]";
+		format = "[<maxIterations>=10] [<Atol>=1e-5] [<tolFactor>=0.01] [<AtolInner>=0]";
 		comments =
 			"Settings for the fluid <--> electron self-consistency loop:\n"
 			"+ <maxIterations>: Max number of electron and fluid minimization pairs\n"
 			"+ <Atol>: Free energy convergence criterion for this outer loop.\n"
+			"+ <tolFactor>: Converge each inner minimization to this fraction of the free energy change\n"
+			"   of the previous outer iteration (at most 1e-3), and no tighter than the energyDiffThreshold\n"
+			"   of fluid-minimize and electronic-minimize, so that early iterations are not over-converged.\n"
+			"+ <AtolInner>: If non-zero, once the outer free energy change falls below this value,\n"
+			"   finish with a single electronic minimization that solves the fluid every electronic step.\n"
 			"Use fluid-solve-frequency to control whether such a loop is used at all.";
 		hasDefault = true;
 	}
@@ -92,10 +97,14 @@ struct CommandFluidGummelLoop : public Command
 	void process(ParamList& pl, Everything& e)
 	{	pl.get(e.cntrl.fluidGummel_nIterations, 10, "maxIterations");
 		pl.get(e.cntrl.fluidGummel_Atol, 1e-5, "Atol");
+		pl.get(e.cntrl.fluidGummel_tolFactor, 0.01, "tolFactor");
+		pl.get(e.cntrl.fluidGummel_AtolInner, 0., "AtolInner");
+		if(e.cntrl.fluidGummel_tolFactor <= 0.) throw string("<tolFactor> must be positive");
+		if(e.cntrl.fluidGummel_AtolInner < 0.) throw string("<AtolInner> must be non-negative");
 	}
 
 	void printStatus(Everything& e, int iRep)
-	{	logPrintf("%d %le", e.cntrl.fluidGummel_nIterations, e.cntrl.fluidGummel_Atol);
+	{	logPrintf("%d %le %lg %lg", e.cntrl.fluidGummel_nIterations, e.cntrl.fluidGummel_Atol, e.cntrl.fluidGummel_tolFactor, e.cntrl.fluidGummel_AtolInner);
 	}
 }
 commandFluidGummelLoop;
@@ -186,6 +195,29 @@ struct CommandFluidVdwScale : public Command
 commandFluidVDWscale;
 
 
+struct CommandFluidKernelCache : public Command
+{
+	CommandFluidKernelCache() : Command("fluid-kernel-cache", "jdftx/Fluid/Parameters")
+	{
+		format = "<directory>";
+		comments = "Save the radial kernels of fluid molecule sites (electron density, charge, polarizability\n"
+			"and hard-sphere weights) to <directory>, and reuse them in later runs with identical site models\n"
+			"and radial grids, instead of recomputing them during fluid setup. Files are named by a hash of\n"
+			"the site parameters, the contents of any radial density files, and the grid, so that a directory\n"
+			"can be shared between jobs and solvents. (Identical sites within a run always share one computation.)";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(Molecule::Site::kernelCacheDir, string(), "directory", true);
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", Molecule::Site::kernelCacheDir.c_str());
+	}
+}
+commandFluidKernelCache;
+
+
 EnumStringMap<FluidComponent::Name> solventMap
 (	FluidComponent::H2O, "H2O",
 	FluidComponent::CHCl3, "CHCl3",
@@ -233,7 +265,8 @@ EnumStringMap<FluidComponent::Functional> functionalMap
 EnumStringMap<FluidComponent::TranslationMode> translationModeMap
 (	FluidComponent::ConstantSpline, "ConstantSpline",
 	FluidComponent::LinearSpline, "LinearSpline",
-	FluidComponent::Fourier, "Fourier"
+	FluidComponent::Fourier, "Fourier",
+	FluidComponent::FourierCached, "FourierCached"
 );
 
 EnumStringMap<FluidComponent::Representation> representationMap
@@ -36,7 +36,8 @@ struct CommandInitialState : public Command
 			"(where A/x/y is sed for 'find x in A and replace it with y'.)\n"
 			"This command will invoke the read only for those state variables for which\n"
 			"the corresponding files exist, leaving the rest with default initialization.\n"
-			"When using SCF, this will also read scfHistory and eigenvalues if available.";
+			"When using SCF, this will also read scfHistory and eigenvalues if available,\n"
+			"and L-BFGS ionic minimization resumes from ionicHistory if available.";
 		
 		forbid("wavefunction");
 		forbid("elec-initial-fillings");
@@ -77,17 +78,19 @@ void setAvailableFilenames(string filenamePattern, Everything& e)
 		setAvailableFilename(filenamePattern, "fS", e.eVars.fluidInitialStateFilename); //alternate naming convention
 	setAvailableFilename(filenamePattern, "scfHistory", e.scfParams.historyFilename);
 	setAvailableFilename(filenamePattern, "eigenvals", e.eVars.eigsFilename);
+	setAvailableFilename(filenamePattern, "ionicHistory", e.iInfo.ionicHistoryFilename);
 }
 
 //-----------------------------------------------------------------------
 
-enum WfnsInit { WfnsLCAO, WfnsRandom, WfnsRead, WfnsReadRS };
+enum WfnsInit { WfnsLCAO, WfnsRandom, WfnsRead, WfnsReadRS, WfnsReadKmesh };
 
 EnumStringMap<WfnsInit> wfnsInitMap(
 	WfnsLCAO, "lcao",
 	WfnsRandom, "random",
 	WfnsRead, "read",
-	WfnsReadRS, "read-rs" );
+	WfnsReadRS, "read-rs",
+	WfnsReadKmesh, "read-kmesh" );
 
 struct CommandWavefunction : public Command
 {
@@ -97,7 +100,8 @@ struct CommandWavefunction : public Command
 			"lcao\n"
 			"           | random\n"
 			"           | read <filename> [<nBandsOld>] [<EcutOld>]\n"
-			"           | read-rs <filename-pattern> [<nBandsOld>] [<NxOld>] [<NyOld>] [<NzOld>]";
+			"           | read-rs <filename-pattern> [<nBandsOld>] [<NxOld>] [<NyOld>] [<NzOld>]\n"
+			"           | read-kmesh <filename> <kptsFilename>";
 		comments =
 			"Wavefunction initialization: use atomic orbitals (default), randomize or read from files:\n"
 			"+ read expects <filename> to point to a single file with fourier-space G-sphere wavefunctions.\n"
@@ -114,7 +118,13 @@ struct CommandWavefunction : public Command
 			"   Default: 0.0 => old and current Ecut must match exactly.\n"
 			"+ <N*old> specify fftbox dimensions of the input data when reading real-space wavefunctions.\n"
 			"   The wavefunction will be appropriately up/down-sampled in Fourier space.\n"
-			"   Default: 0 => old and current fftbox must match exactly.";
+			"   Default: 0 => old and current fftbox must match exactly.\n"
+			"+ read-kmesh reads wavefunctions from a calculation of the same system on a different\n"
+			"   (typically coarser) k-point mesh, whose k-points are listed in <kptsFilename> (dump Kpoints).\n"
+			"   Each state is initialized from the nearest symmetry-equivalent previous k-point,\n"
+			"   keeping the periodic part of each band, which also seeds the initial density.\n"
+			"   The previous calculation must use the same Ecut and flat wavefunction output;\n"
+			"   the number of bands is detected from the file size.";
 		hasDefault = false;
 		
 		forbid("initial-state");
@@ -150,12 +160,19 @@ struct CommandWavefunction : public Command
 				e.eVars.readConversion = conversion;
 				break;
 			}
+			case WfnsReadKmesh:
+			{	pl.get(e.eVars.wfnsFilename, string(), "filename", true);
+				pl.get(e.eVars.wfnsKmeshFilename, string(), "kptsFilename", true);
+				break;
+			}
 		}
 	}
 
 	void printStatus(Everything& e, int iRep)
 	{	if(!e.eVars.wfnsFilename.length())
 			logPrintf(e.eVars.initLCAO ? "lcao" : "random");
+		else if(e.eVars.wfnsKmeshFilename.length())
+			logPrintf("read-kmesh %s %s", e.eVars.wfnsFilename.c_str(), e.eVars.wfnsKmeshFilename.c_str());
 		else if(!e.eVars.readConversion)
 			logPrintf("read %s", e.eVars.wfnsFilename.c_str());
 		else if(!e.eVars.readConversion->realSpace)
@@ -234,3 +234,39 @@ struct CommandCoreOverlapCheck : public Command
 	}
 }
 commandCoreOverlapCheck;
+
+
+EnumStringMap<IonicPreconditioner> ionicPreconditionerMap
+(	IonicPrecondNone, "None",
+	IonicPrecondExp, "Exponential",
+	IonicPrecondFF, "ForceField"
+);
+
+struct CommandIonicPreconditioner : public Command
+{
+	CommandIonicPreconditioner() : Command("ionic-preconditioner", "jdftx/Ionic/Optimization")
+	{
+		format = "<type>=" + ionicPreconditionerMap.optionList();
+		comments = "Preconditioner for the forces in ionic minimization (and the ionic part of lattice minimization),\n"
+			"estimated from the atomic connectivity at each step:\n"
+			"+ None: identity metric in cartesian coordinates (default)\n"
+			"+ Exponential: connectivity Laplacian with weights exp(-3(r/r_NN - 1)) for neighbours within 2 r_NN,\n"
+			"   where r_NN is the nearest-neighbour distance \\cite ExpPreconditioner\n"
+			"+ ForceField: bond-stretch Hessian with force constants decaying with distance relative to\n"
+			"   reference bond lengths for each pair of periodic-table rows \\cite LindhHessian\n"
+			"\n"
+			"Both are normalized to unit diagonal on average, with a small identity stabilization.\n"
+			"These accelerate soft collective modes (eg. molecules on surfaces) substantially,\n"
+			"and work with all dirUpdateScheme options of ionic-minimize including L-BFGS and FIRE.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.iInfo.ionicPreconditioner, IonicPrecondNone, ionicPreconditionerMap, "type");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", ionicPreconditionerMap.getString(e.iInfo.ionicPreconditioner));
+	}
+}
+commandIonicPreconditioner;
@@ -21,6 +21,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/Everything.h>
 #include <core/Units.h>
 #include <config.h>
+#include <sys/stat.h>
+#include <cerrno>
 
 struct CommandIonSpecies : public Command
 {
@@ -423,3 +425,32 @@ struct CommandAddU : public Command
 	}
 }
 commandAddU;
+
+struct CommandRadialTransformCache : public Command
+{
+	CommandRadialTransformCache() : Command("radial-transform-cache", "jdftx/Ionic/Species")
+	{
+		format = "<directory>";
+		comments =
+			"Cache the Bessel transforms of all pseudopotential radial functions (local and\n"
+			"nonlocal potentials, augmentation charges, atomic orbitals and core densities)\n"
+			"to reciprocal-space grids in <directory>, which is created if necessary.\n"
+			"Each transform is keyed by a hash of the radial samples, angular momentum and\n"
+			"reciprocal-space grid, so that a directory shared by many calculations with the\n"
+			"same pseudopotentials and cutoffs skips these transforms after the first run.\n"
+			"Stale entries are never reused, and the directory can be deleted at any time.";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(RadialFunctionR::transformCacheDir, string(), "directory", true);
+		if(mpiWorld->isHead()
+			&& mkdir(RadialFunctionR::transformCacheDir.c_str(), 0777)
+			&& errno!=EEXIST)
+			logPrintf("WARNING: could not create radial transform cache directory '%s'.\n", RadialFunctionR::transformCacheDir.c_str());
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", RadialFunctionR::transformCacheDir.c_str());
+	}
+}
+commandRadialTransformCache;
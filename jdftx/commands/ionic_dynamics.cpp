@@ -52,6 +52,73 @@ struct CommandIonicDynamics : public Command
 }
 commandIonicDynamics;
 
+struct CommandIonicDynamicsExtrapolation : public Command
+{
+	CommandIonicDynamicsExtrapolation() : Command("ionic-dynamics-extrapolation", "jdftx/Ionic/Dynamics")
+	{	format = "<order>=0";
+		comments = "Initial guess for the wavefunctions at each ionic dynamics step.\n"
+			"With <order> = K > 0, extrapolate the converged wavefunctions of the previous K+1 steps\n"
+			"(each rotated within its subspace to match the latest) using the always stable predictor\n"
+			"of J. Kolafa, J. Comput. Chem. 25, 335 (2004), which reduces the electronic iterations per step.\n"
+			"The density (and fillings) then follow from the extrapolated wavefunctions.\n"
+			"Requires storing K+1 additional copies of the wavefunctions; K = 2 or 3 is typical.\n"
+			"The default <order> = 0 starts from the previous step's wavefunctions\n"
+			"(dragged along with the atoms if wavefunction-drag is enabled).";
+		hasDefault = true;
+		allowMultiple = false;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	int& K = e.ionDynamicsParams.extrapolationOrder;
+		pl.get(K, 0, "order");
+		if(K < 0) throw string("<order> must be non-negative");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%d", e.ionDynamicsParams.extrapolationOrder);
+	}
+}
+commandIonicDynamicsExtrapolation;
+
+EnumStringMap<bool> trajectoryLogMap
+(	false, "Full",
+	true, "Compact"
+);
+
+struct CommandIonicDynamicsTrajectory : public Command
+{
+	CommandIonicDynamicsTrajectory() : Command("ionic-dynamics-trajectory", "jdftx/Ionic/Dynamics")
+	{	format = "<filename> [<stride>=1] [<log>=Full]";
+		comments = "Write the ionic dynamics trajectory to binary file <filename>, one frame every <stride> steps.\n"
+			"Each frame contains the step, time, kinetic, potential and total energies, pressure,\n"
+			"lattice vectors and the cartesian positions, velocities and forces of all atoms\n"
+			"(in atomic units), in fixed-size little-endian records after a header describing the species,\n"
+			"so that any frame can be read directly at a computable offset (see IonDynamicsTrajectory.h).\n"
+			"Frames are written from a background thread and flushed as they complete.\n"
+			"An existing file for the same system is appended to, so restarted runs continue the trajectory.\n"
+			"\n"
+			"With <log>=Compact, each step logs a single line of energies instead of the positions,\n"
+			"forces and energy components (which remain available from the trajectory file).\n"
+			"Default <log>=Full retains the detailed output.";
+		allowMultiple = false;
+		require("ionic-dynamics");
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	IonDynamicsParams& idp = e.ionDynamicsParams;
+		pl.get(idp.trajectoryFilename, string(), "filename", true);
+		pl.get(idp.trajectoryStride, 1, "stride");
+		if(idp.trajectoryStride < 1) throw string("<stride> must be positive");
+		pl.get(idp.compactLog, false, trajectoryLogMap, "log");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	const IonDynamicsParams& idp = e.ionDynamicsParams;
+		logPrintf("%s %d %s", idp.trajectoryFilename.c_str(), idp.trajectoryStride, trajectoryLogMap.getString(idp.compactLog));
+	}
+}
+commandIonicDynamicsTrajectory;
+
 EnumStringMap<ConfiningPotentialType> confiningPotentialTypeMap
 (	ConfineNone, "None",
 	ConfineLinear, "Linear",
@@ -143,3 +210,97 @@ struct CommandNetDriftRemoval : public Command
 	}
 }
 CommandNetDriftRemoval;
+
+
+struct CommandIonicServer : public Command
+{
+	CommandIonicServer() : Command("ionic-server", "jdftx/Ionic/Optimization")
+	{	format = "<inFile> <outFile>";
+		comments =
+			"Instead of ionic minimization or dynamics, serve energy and force requests\n"
+			"from an external driver (such as the ASE interface in scripts/ase), keeping\n"
+			"all setup, FFT plans and caches, and the electronic state between requests.\n"
+			"Each request is read from <inFile> till end of file, and contains lines\n"
+			"\n"
+			"    ion <species> <x> <y> <z>\n"
+			"\n"
+			"with cartesian positions in bohrs for all atoms (in any order), or the single\n"
+			"line 'quit' to end the calculation. The response is written to <outFile> as\n"
+			"\n"
+			"    energy <E>\n"
+			"    force <species> <Fx> <Fy> <Fz>\n"
+			"    end\n"
+			"\n"
+			"with one force line per atom in the order of the request (cartesian, in\n"
+			"hartrees and bohrs). Both files may be named pipes (see mkfifo): the driver\n"
+			"then writes and closes <inFile> and reads <outFile> for each request.";
+		
+		forbid("lattice-minimize");
+		forbid("ionic-dynamics");
+		forbid("dump-only");
+		forbid("fix-electron-density");
+		forbid("fix-electron-potential");
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.serverInput, string(), "inFile", true);
+		pl.get(e.cntrl.serverOutput, string(), "outFile", true);
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s %s", e.cntrl.serverInput.c_str(), e.cntrl.serverOutput.c_str());
+	}
+}
+commandIonicServer;
+
+
+struct CommandNeb : public Command
+{
+	CommandNeb() : Command("neb", "jdftx/Ionic/Optimization")
+	{	format = "<nImages> <finalPositions> [<springConstant>=0.002] [<climb>=yes] [<nIterations>=100] [<forceTol>=1e-3] [<dt>=1]";
+		comments =
+			"Find the minimum energy path between the ionic positions specified by ion commands\n"
+			"and those in the file <finalPositions> (ion lines in the coords-type of this input,\n"
+			"such as an IonicPositions dump of the relaxed product), using the nudged elastic band.\n"
+			"+ <nImages>: number of images including both end points (at least 3).\n"
+			"+ <springConstant>: spring constant between neighbouring images in Eh/bohr^2.\n"
+			"+ <climb>: yes|no, whether the highest-energy image climbs to the saddle point\n"
+			"   (enabled once the largest force drops below 10 <forceTol>).\n"
+			"+ <nIterations>: maximum number of band relaxation (FIRE) steps.\n"
+			"+ <forceTol>: convergence threshold on the largest atomic NEB force in Eh/bohr.\n"
+			"+ <dt>: initial FIRE time step (atomic units with unit masses).\n"
+			"\n"
+			"The images are divided between groups of processes, and each image keeps its\n"
+			"electronic state between band iterations. Symmetries are disabled, and outputs\n"
+			"of each image <i> have 'image<i>.' inserted before $VAR in the dump-name format.";
+		
+		forbid("lattice-minimize");
+		forbid("ionic-dynamics");
+		forbid("ionic-server");
+		forbid("dump-only");
+		forbid("fix-electron-density");
+		forbid("fix-electron-potential");
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	NEBparams& np = e.nebParams;
+		pl.get(np.nImages, 0, "nImages", true);
+		if(np.nImages < 3) throw string("<nImages> must be at least 3");
+		pl.get(np.finalFilename, string(), "finalPositions", true);
+		pl.get(np.springConstant, 0.002, "springConstant");
+		pl.get(np.climb, true, boolMap, "climb");
+		pl.get(np.nIterations, 100, "nIterations");
+		pl.get(np.forceTol, 1e-3, "forceTol");
+		pl.get(np.dt, 1., "dt");
+		if(np.springConstant <= 0.) throw string("<springConstant> must be positive");
+		if(np.forceTol <= 0.) throw string("<forceTol> must be positive");
+		if(np.dt <= 0.) throw string("<dt> must be positive");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	const NEBparams& np = e.nebParams;
+		logPrintf("%d %s %lg %s %d %lg %lg", np.nImages, np.finalFilename.c_str(), np.springConstant,
+			boolMap.getString(np.climb), np.nIterations, np.forceTol, np.dt);
+	}
+}
+commandNeb;
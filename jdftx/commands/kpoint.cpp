@@ -76,3 +76,119 @@ struct CommandKpointFolding : public Command
 	}
 }
 commandKpointFolding;
+
+EnumStringMap<ElecInfo::StateBalance> stateBalanceMap
+(	ElecInfo::BalanceUniform, "Uniform",
+	ElecInfo::BalanceBasis, "Basis",
+	ElecInfo::BalanceMeasured, "Measured"
+);
+EnumStringMap<ElecInfo::StateBalance> stateBalanceDescMap
+(	ElecInfo::BalanceUniform, "Equal number of states on each process",
+	ElecInfo::BalanceBasis, "Equal total basis size on each process (differs from Uniform only for k-dependent bases)",
+	ElecInfo::BalanceMeasured, "Equal total Hamiltonian time on each process, as measured in a previous run and saved to <costsFile> (uses Basis until that file exists)"
+);
+
+struct CommandStateBalance : public Command
+{
+	CommandStateBalance() : Command("state-balance", "jdftx/Electronic/Parameters")
+	{
+		format = "<mode>=" + stateBalanceMap.optionList() + " [<costsFile>=stateCosts]";
+		comments =
+			"Select how k-points/spin states are divided between MPI processes, where <mode> is one of:"
+			+ addDescriptions(stateBalanceMap.optionList(), linkDescription(stateBalanceMap, stateBalanceDescMap))
+			+ "\n\nEach process always handles a contiguous range of states. In Measured mode, the time spent\n"
+			"applying the Hamiltonian to each state is written to <costsFile> after every electronic optimization,\n"
+			"and used to divide states at startup for subsequent runs of the same system.\n"
+			"Default: Uniform";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.eInfo.stateBalance, ElecInfo::BalanceUniform, stateBalanceMap, "mode");
+		pl.get(e.eInfo.stateCostsFilename, string("stateCosts"), "costsFile");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", stateBalanceMap.getString(e.eInfo.stateBalance));
+		if(e.eInfo.stateBalance==ElecInfo::BalanceMeasured)
+			logPrintf(" %s", e.eInfo.stateCostsFilename.c_str());
+	}
+}
+commandStateBalance;
+
+//-------------------------------------------------------------------------------------------------
+
+EnumStringMap<ParallelLayoutMode> parallelLayoutMap
+(	ParallelLayoutNone, "None",
+	ParallelLayoutSuggest, "Suggest",
+	ParallelLayoutAuto, "Auto"
+);
+EnumStringMap<ParallelLayoutMode> parallelLayoutDescMap
+(	ParallelLayoutNone, "No layout benchmarks (default)",
+	ParallelLayoutSuggest, "Report the estimated cost and memory of each layout, and suggest the best one",
+	ParallelLayoutAuto, "Suggest as above, and also set the threads of each process to its share of the node's cores"
+);
+
+struct CommandParallelLayout : public Command
+{
+	CommandParallelLayout() : Command("parallel-layout", "jdftx/Electronic/Parameters")
+	{
+		format = "<mode>=" + parallelLayoutMap.optionList();
+		comments =
+			"Benchmark the division of each node between MPI processes, threads and GPUs at startup, where <mode> is one of:"
+			+ addDescriptions(parallelLayoutMap.optionList(), linkDescription(parallelLayoutMap, parallelLayoutDescMap))
+			+ "\n\nAfter the wavefunction bases are set up, short micro-benchmarks of FFTs, subspace overlaps (ZGEMM)\n"
+			"and grid-sized reductions are timed on the actual grids and basis sizes. These are combined with the\n"
+			"number of states, bands and an estimate of memory per process to predict the time per electronic\n"
+			"iteration for each number of processes per node (dividing the physical cores, or JDFTX_CPUS_PER_NODE,\n"
+			"evenly between them), or for each number of processes per GPU in GPU runs.\n"
+			"The process count and GPU assignment are fixed by the launcher, so they can only be suggested for a\n"
+			"subsequent run; the estimates are rough and intended to catch badly misconfigured job layouts.\n"
+			"Default: None";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.parallelLayout, ParallelLayoutNone, parallelLayoutMap, "mode");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%s", parallelLayoutMap.getString(e.cntrl.parallelLayout));
+	}
+}
+commandParallelLayout;
+
+struct CommandBatch : public Command
+{
+	CommandBatch() : Command("batch", "jdftx/Miscellaneous")
+	{
+		format = "<input1> [<input2> ...]";
+		comments =
+			"Run each of the input files <input1>, <input2> ... as an independent calculation\n"
+			"within this jdftx run, instead of any calculation specified in this input file.\n"
+			"The processes are divided evenly into groups (as many as inputs, upto the number of processes),\n"
+			"and each group runs its share of the inputs one after the other, with the log of each written to\n"
+			"the input filename with extension .out (replacing .in, if present).\n"
+			"\n"
+			"This is intended for high-throughput screening of many small calculations, which individually\n"
+			"cannot use a node or GPU efficiently: start-up costs (MPI, GPU and thread-pool initialization,\n"
+			"memory pools and FFTW planning) are paid once, and with several processes per GPU\n"
+			"(eg. using MPS), the groups' kernels overlap on the device.";
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	string fname;
+		pl.get(fname, string(), "input1", true);
+		while(fname.length())
+		{	e.cntrl.batchInputs.push_back(fname);
+			fname.clear();
+			pl.get(fname, string(), "input");
+		}
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	for(const string& fname: e.cntrl.batchInputs)
+			logPrintf("%s ", fname.c_str());
+	}
+}
+commandBatch;
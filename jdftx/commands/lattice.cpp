@@ -230,6 +230,31 @@ struct CommandLattMoveScale : public Command
 }
 commandLattMoveScale;
 
+struct CommandLattStressStencil : public Command
+{
+	CommandLattStressStencil() : Command("latt-stress-stencil", "jdftx/Ionic/Optimization")
+	{
+		format = "<order>=2|4 [<h>=1e-5]";
+		comments = "Central-difference stencil used for the stress tensor (for lattice minimization and stress output).\n"
+			"Each stress evaluation requires <order> energy evaluations at fixed wavefunctions per independent strain,\n"
+			"so <order> = 2 halves its cost relative to the default 4, with an O(<h>^2) rather than O(<h>^4) error\n"
+			"that is negligible at the default strain step <h> = 1e-5.";
+		hasDefault = true;
+	}
+
+	void process(ParamList& pl, Everything& e)
+	{	pl.get(e.cntrl.lattStressOrder, 4, "order");
+		if(e.cntrl.lattStressOrder!=2 && e.cntrl.lattStressOrder!=4) throw string("<order> must be 2 or 4");
+		pl.get(e.cntrl.lattStressStep, 1e-5, "h");
+		if(e.cntrl.lattStressStep<=0.) throw string("<h> must be positive");
+	}
+
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%d %lg", e.cntrl.lattStressOrder, e.cntrl.lattStressStep);
+	}
+}
+commandLattStressStencil;
+
 EnumStringMap<CoordsType> coordsMap(
 	CoordsLattice, "Lattice",
 	CoordsCartesian, "Cartesian" );
@@ -24,7 +24,8 @@ EnumStringMap<MinimizeParams::DirectionUpdateScheme> dirUpdateMap
 	MinimizeParams::FletcherReeves, "FletcherReeves",
 	MinimizeParams::HestenesStiefel, "HestenesStiefel",
 	MinimizeParams::LBFGS, "L-BFGS",
-	MinimizeParams::SteepestDescent, "SteepestDescent"
+	MinimizeParams::SteepestDescent, "SteepestDescent",
+	MinimizeParams::FIRE, "FIRE"
 );
 
 EnumStringMap<MinimizeParams::LinminMethod> linminMap
@@ -102,6 +102,7 @@ enum PCMparameter
 	PCMp_zMaskH, //half-width in z lattice coordinates for cavity mask
 	PCMp_zMaskIonH, //half-width in z lattice coordinates for ion cavity mask
 	PCMp_zMaskSigma, //smoothness of z-mask in bohrs
+	PCMp_cavityReuseThreshold, //!< relative change in cavity inputs below which the previous cavity is reused
 	PCMp_rhoMin, //!< min electron density (bohr^-3) for SCCS cavity switching function
 	PCMp_rhoMax, //!< max electron density (bohr^-3) for SCCS cavity switching function
 	PCMp_rhoDelta, //!< electron density change (bohr^-3) for SCCS cavity area calculation
@@ -125,6 +126,7 @@ EnumStringMap<PCMparameter> pcmParamMap
 	PCMp_zMaskH, "zMaskH",
 	PCMp_zMaskIonH, "zMaskIonH",
 	PCMp_zMaskSigma, "zMaskSigma",
+	PCMp_cavityReuseThreshold, "cavityReuseThreshold",
 	PCMp_rhoMin, "rhoMin",
 	PCMp_rhoMax, "rhoMin",
 	PCMp_rhoDelta, "rhoDelta",
@@ -147,6 +149,9 @@ EnumStringMap<PCMparameter> pcmParamDescMap
 	PCMp_zMaskIonH, "half-width in z lattice coordinates for ion cavity mask (default: 0 => disabled)",
 	PCMp_zMaskH, "half-width in z lattice coordinates for cavity mask (default: 0 => disabled)",
 	PCMp_zMaskSigma, "smoothness of z-mask in bohrs (default: 0.5)",
+	PCMp_cavityReuseThreshold, "relative RMS change in cavity-determining density (and in the electron charge for CANDLE) below which "
+		"the previous cavity and cavitation energy are reused, skipping all nonlocal cavity convolutions; does not apply to SoftSphere and "
+		"FixedCavity, which only update when atoms move (default: 0 => reuse only if unchanged)",
 	PCMp_rhoMin, "min electron density (bohr^-3) for SCCS cavity switching function",
 	PCMp_rhoMax, "max electron density (bohr^-3) for SCCS cavity switching function",
 	PCMp_rhoDelta, "electron density change (bohr^-3) for SCCS cavity area calculation",
@@ -194,6 +199,7 @@ struct CommandPcmParams : public Command
 				READ_AND_CHECK(zMaskH, >=, 0.)
 				READ_AND_CHECK(zMaskIonH, >=, 0.)
 				READ_AND_CHECK(zMaskSigma, >, 0.)
+				READ_AND_CHECK(cavityReuseThreshold, >=, 0.)
 				READ_AND_CHECK(rhoMin, >, 0.)
 				READ_AND_CHECK(rhoMax, >, 0.)
 				READ_AND_CHECK(rhoDelta, >, 0.)
@@ -223,6 +229,7 @@ struct CommandPcmParams : public Command
 		PRINT(zMaskH)
 		PRINT(zMaskIonH)
 		PRINT(zMaskSigma)
+		PRINT(cavityReuseThreshold)
 		PRINT(rhoMin)
 		PRINT(rhoMax)
 		PRINT(rhoDelta)
@@ -259,6 +266,62 @@ struct CommandPcmNonlinearDebug : public Command
 commandPcmNonlinearDebug;
 
 
+struct CommandPcmMultigrid : public Command
+{
+	CommandPcmMultigrid() : Command("pcm-multigrid", "jdftx/Fluid/Optimization")
+	{
+		format = "[<nLevels>=2]";
+		comments =
+			"Precondition the linear solves of LinearPCM (and the inner solves of NonlinearPCM\n"
+			"in SCF mode) with a multigrid V-cycle on up to <nLevels> successively coarser grids,\n"
+			"instead of the inverse-kinetic preconditioner alone (which serves as the smoother\n"
+			"on each grid). This reduces the number of iterations substantially for high\n"
+			"dielectric contrast, eg. in slab calculations with high-dielectric solvents.\n"
+			"Each grid halves every even dimension of the previous one, down to 8 points.";
+		require("fluid");
+	}
+	
+	void process(ParamList& pl, Everything& e)
+	{	FluidSolverParams& fsp = e.eVars.fluidParams;
+		pl.get(fsp.pcmMultigridLevels, 2, "nLevels");
+		if(fsp.pcmMultigridLevels < 1) throw string("<nLevels> must be at least 1");
+	}
+	
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%d", e.eVars.fluidParams.pcmMultigridLevels);
+	}
+}
+commandPcmMultigrid;
+
+
+struct CommandFluidExtrapolation : public Command
+{
+	CommandFluidExtrapolation() : Command("fluid-extrapolation", "jdftx/Fluid/Optimization")
+	{
+		format = "[<nHistory>=3]";
+		comments =
+			"Initialize the fluid state at each ionic step (of ionic minimization or dynamics) by\n"
+			"extrapolating its converged values at the previous <nHistory> ionic steps, instead of\n"
+			"starting from the state at the previous step. The new atomic displacement is expressed\n"
+			"as a least-squares combination of the displacements between previous steps, and the\n"
+			"same combination is applied to the fluid states; for uniform steps (eg. dynamics),\n"
+			"this reduces to polynomial extrapolation. Useful mainly in ionic dynamics.";
+		require("fluid");
+	}
+	
+	void process(ParamList& pl, Everything& e)
+	{	FluidSolverParams& fsp = e.eVars.fluidParams;
+		pl.get(fsp.extrapolationHistory, 3, "nHistory");
+		if(fsp.extrapolationHistory < 2) throw string("<nHistory> must be at least 2");
+	}
+	
+	void printStatus(Everything& e, int iRep)
+	{	logPrintf("%d", e.eVars.fluidParams.extrapolationHistory);
+	}
+}
+commandFluidExtrapolation;
+
+
 
 struct CommandIonWidth : public Command
 {
@@ -28,7 +28,10 @@ enum PulayParamsMember
 	PPM_residualThreshold,
 	PPM_mixFraction,
 	PPM_qMetric,
-	PPM_history
+	PPM_history,
+	PPM_pulayPeriod,
+	PPM_adaptiveMixing,
+	PPM_historyStorage
 };
 
 EnumStringMap<PulayParamsMember> pulayParamsMap
@@ -37,7 +40,10 @@ EnumStringMap<PulayParamsMember> pulayParamsMap
 	PPM_residualThreshold, "residualThreshold",
 	PPM_mixFraction, "mixFraction",
 	PPM_qMetric, "qMetric",
-	PPM_history, "history"
+	PPM_history, "history",
+	PPM_pulayPeriod, "pulayPeriod",
+	PPM_adaptiveMixing, "adaptiveMixing",
+	PPM_historyStorage, "historyStorage"
 );
 
 EnumStringMap<PulayParamsMember> pulayParamsDescMap
@@ -46,7 +52,16 @@ EnumStringMap<PulayParamsMember> pulayParamsDescMap
 	PPM_residualThreshold, "convergence threshold for the residual in the mixed variable",
 	PPM_mixFraction, "mix fraction (default 0.5)",
 	PPM_qMetric, "wavevector controlling the metric for overlaps (default: 0.8 bohr^-1)",
-	PPM_history, "number of past residuals that are cached and used for mixing"
+	PPM_history, "number of past residuals that are cached and used for mixing",
+	PPM_pulayPeriod, "if > 1, extrapolate using the history only every pulayPeriod cycles, with linear mixing in between (default 1)",
+	PPM_adaptiveMixing, "whether to reduce the mix fraction when the residual grows, and recover it as the residual decreases (default no)",
+	PPM_historyStorage, "storage of past variables and residuals: full (default), single (single precision in memory) or disk (scratch file in $TMPDIR)"
+);
+
+EnumStringMap<PulayParams::HistoryStorage> historyStorageMap
+(	PulayParams::HistoryFull, "full",
+	PulayParams::HistorySingle, "single",
+	PulayParams::HistoryDisk, "disk"
 );
 
 //Base class for pulay-mixing commands
@@ -74,6 +89,9 @@ protected:
 					case PPM_mixFraction: pl.get(pp.mixFraction, 0.5, "mixFraction", true); break;
 					case PPM_qMetric: pl.get(pp.qMetric, 0.8, "qMetric", true); break;
 					case PPM_history: pl.get(pp.history, 10, "history", true); if(pp.history<1) throw string("<history> must be >= 1"); break;
+					case PPM_pulayPeriod: pl.get(pp.pulayPeriod, 1, "pulayPeriod", true); if(pp.pulayPeriod<1) throw string("<pulayPeriod> must be >= 1"); break;
+					case PPM_adaptiveMixing: pl.get(pp.adaptiveMixing, false, boolMap, "adaptiveMixing", true); break;
+					case PPM_historyStorage: pl.get(pp.historyStorage, PulayParams::HistoryFull, historyStorageMap, "historyStorage", true); break;
 				}
 			}
 			else process_sub(keyStr, pl, e);
@@ -89,6 +107,9 @@ protected:
 		PRINT(mixFraction, %lg)
 		PRINT(qMetric, %lg)
 		PRINT(history, %d)
+		PRINT(pulayPeriod, %d)
+		logPrintf(" \\\n\tadaptiveMixing\t%s", boolMap.getString(pp.adaptiveMixing));
+		logPrintf(" \\\n\thistoryStorage\t%s", historyStorageMap.getString(pp.historyStorage));
 		#undef PRINT
 	}
 	
@@ -106,7 +127,10 @@ enum SCFparamsMember
 	SCFpm_qKerker,
 	SCFpm_qKappa,
 	SCFpm_verbose,
-	SCFpm_mixFractionMag
+	SCFpm_mixFractionMag,
+	SCFpm_rmmDiisThreshold,
+	SCFpm_bandFillThreshold,
+	SCFpm_bandBufferFraction
 };
 
 EnumStringMap<SCFparamsMember> scfParamsMap
@@ -116,7 +140,10 @@ EnumStringMap<SCFparamsMember> scfParamsMap
 	SCFpm_qKerker, "qKerker",
 	SCFpm_qKappa, "qKappa",
 	SCFpm_verbose, "verbose",
-	SCFpm_mixFractionMag, "mixFractionMag"
+	SCFpm_mixFractionMag, "mixFractionMag",
+	SCFpm_rmmDiisThreshold, "rmmDiisThreshold",
+	SCFpm_bandFillThreshold, "bandFillThreshold",
+	SCFpm_bandBufferFraction, "bandBufferFraction"
 );
 EnumStringMap<SCFparamsMember> scfParamsDescMap
 (	SCFpm_nEigSteps, "number of eigenvalue steps per iteration (if 0, limited by electronic-minimize nIterations)",
@@ -125,7 +152,11 @@ EnumStringMap<SCFparamsMember> scfParamsDescMap
 	SCFpm_qKerker, "wavevector controlling Kerker preconditioning (default: 0.8 bohr^-1)",
 	SCFpm_qKappa, "wavevector for long-range damping. If negative (default), set to zero or fluid Debye wavevector as appropriate",
 	SCFpm_verbose, "whether the inner eigenvalue solver will print or not",
-	SCFpm_mixFractionMag, "mix fraction for magnetization density / potential (default 1.5)"
+	SCFpm_mixFractionMag, "mix fraction for magnetization density / potential (default 1.5)",
+	SCFpm_rmmDiisThreshold, "if non-zero, switch to RMM-DIIS band refinement once the energy change per cycle drops below this (default 0: disabled)",
+	SCFpm_bandFillThreshold, "if non-zero (with smearing), adapt the number of bands between cycles: grow when the highest band's filling exceeds this, "
+		"and drop bands well beyond those filled above it (default 0: fixed nBands)",
+	SCFpm_bandBufferFraction, "empty bands kept above the last one filled beyond bandFillThreshold, as a fraction of the filled ones (default 0.1, at least 2 bands)"
 );
 
 EnumStringMap<SCFparams::MixedVariable> scfMixing
@@ -168,6 +199,9 @@ struct CommandElectronicScf: public CommandPulay
 				case SCFpm_qKappa: pl.get(sp.qKappa, -1., "qKappa", true); break;
 				case SCFpm_verbose: pl.get(sp.verbose, false, boolMap, "verbose", true); break;
 				case SCFpm_mixFractionMag: pl.get(sp.mixFractionMag, 1.5, "mixFractionMag", true); break;
+				case SCFpm_rmmDiisThreshold: pl.get(sp.rmmDiisThreshold, 0., "rmmDiisThreshold", true); if(sp.rmmDiisThreshold<0.) throw string("<rmmDiisThreshold> must be >= 0"); break;
+				case SCFpm_bandFillThreshold: pl.get(sp.bandFillThreshold, 0., "bandFillThreshold", true); if(sp.bandFillThreshold<0. || sp.bandFillThreshold>=1.) throw string("<bandFillThreshold> must be in [0,1)"); break;
+				case SCFpm_bandBufferFraction: pl.get(sp.bandBufferFraction, 0.1, "bandBufferFraction", true); if(sp.bandBufferFraction<0.) throw string("<bandBufferFraction> must be >= 0"); break;
 			}
 		}
 		else throw string("Parameter <key> must be one of " + pulayParamsMap.optionList() + "|" + scfParamsMap.optionList());
@@ -184,6 +218,9 @@ struct CommandElectronicScf: public CommandPulay
 		PRINT(qKappa, %lg)
 		logPrintf(" \\\n\tverbose\t%s", boolMap.getString(sp.verbose));
 		PRINT(mixFractionMag, %lg)
+		PRINT(rmmDiisThreshold, %lg)
+		PRINT(bandFillThreshold, %lg)
+		PRINT(bandBufferFraction, %lg)
 		#undef PRINT
 	}
 }
@@ -222,3 +259,45 @@ struct CommandPcmNonlinearScf: public CommandPulay
 	}
 }
 commandPcmNonlinearScf;
+
+
+struct CommandPcmNonlinearNewton: public Command
+{
+	CommandPcmNonlinearNewton() : Command("pcm-nonlinear-newton", "jdftx/Fluid/Optimization")
+	{	
+		format = "[<nIterations>=20] [<energyDiffThreshold>=1e-7]";
+		comments =
+			"Converge nonlinear PCM fluids with an inexact Newton-Krylov method on the\n"
+			"electrostatic potential, instead of the default conjugate gradients on the\n"
+			"fluid state or the Pulay-mixed SCF of pcm-nonlinear-scf. Each Newton step\n"
+			"solves the nonlinear Poisson(-Boltzmann) equation linearized about the current\n"
+			"potential with CG, using analytic Hessian-vector products of the nonlinear\n"
+			"dielectric and ionic response, preconditioned by the LinearPCM operator with the\n"
+			"current effective dielectric and screening (see also pcm-multigrid).\n"
+			"This is typically much faster at high ionic strength or in strong fields.\n"
+			"\n"
+			"At most <nIterations> Newton steps are taken, stopping when the free energy\n"
+			"changes by less than <energyDiffThreshold>, and each inner CG solve is limited\n"
+			"by the iteration count in fluid-minimize.";
+		forbid("pcm-nonlinear-scf");
+	}
+	
+	void process(ParamList& pl, Everything& e)
+	{	FluidSolverParams& fsp = e.eVars.fluidParams;
+		fsp.nonlinearSCF = true;
+		fsp.nonlinearNewton = true;
+		PulayParams& pp = fsp.scfParams;
+		pp.energyLabel = "Adiel";
+		pp.energyFormat = "%+.15lf";
+		pp.fpLog = globalLog;
+		pl.get(pp.nIterations, 20, "nIterations");
+		pl.get(pp.energyDiffThreshold, 1e-7, "energyDiffThreshold");
+		if(pp.nIterations < 0) throw string("<nIterations> must be >= 0");
+	}
+	
+	void printStatus(Everything& e, int iRep)
+	{	const PulayParams& pp = e.eVars.fluidParams.scfParams;
+		logPrintf("%d %lg", pp.nIterations, pp.energyDiffThreshold);
+	}
+}
+commandPcmNonlinearNewton;
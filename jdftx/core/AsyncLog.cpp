@@ -0,0 +1,155 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <core/Util.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <list>
+#include <vector>
+
+//Asynchronous log streams: stdio writes (and flushes) only copy into a bounded
+//ring buffer, which a background thread writes (and flushes) to the target file
+namespace AsyncLog
+{
+	struct Stream
+	{	FILE* target; //file that the background thread writes to
+		FILE* fp; //stdio stream exposed to callers
+		std::vector<char> buf; size_t start, count; //ring buffer and its occupied range
+		bool writing, stop;
+		std::timed_mutex lock;
+		std::condition_variable_any cvData, cvSpace, cvIdle;
+		std::thread writer;
+
+		Stream(FILE* target, size_t bufferSize) : target(target), fp(0), buf(bufferSize), start(0), count(0), writing(false), stop(false)
+		{	writer = std::thread(&Stream::writerLoop, this);
+		}
+
+		void writerLoop()
+		{	std::vector<char> chunk;
+			std::unique_lock<std::timed_mutex> lk(lock);
+			while(true)
+			{	cvData.wait(lk, [this]{ return count || stop; });
+				if(!count) break; //stop requested and nothing left to write
+				//Take the contiguous part of the occupied range:
+				size_t n = std::min(count, buf.size()-start);
+				chunk.assign(buf.begin()+start, buf.begin()+start+n);
+				start = (start+n) % buf.size();
+				count -= n;
+				writing = true;
+				cvSpace.notify_all();
+				lk.unlock();
+				fwrite(chunk.data(), 1, n, target);
+				lk.lock();
+				if(!count) //caught up: flush to the file system (only this thread waits on it)
+				{	lk.unlock();
+					fflush(target);
+					lk.lock();
+				}
+				writing = false;
+				if(!count) cvIdle.notify_all();
+			}
+		}
+
+		//Copy data into the ring buffer, waiting for space if full (bounded buffering)
+		size_t write(const char* data, size_t size)
+		{	std::unique_lock<std::timed_mutex> lk(lock);
+			size_t sizeRemaining = size;
+			while(sizeRemaining)
+			{	cvSpace.wait(lk, [this]{ return count < buf.size(); });
+				size_t end = (start+count) % buf.size();
+				size_t n = std::min(sizeRemaining, std::min(buf.size()-count, buf.size()-end));
+				memcpy(buf.data()+end, data, n);
+				data += n; sizeRemaining -= n;
+				count += n;
+				cvData.notify_one();
+			}
+			return size;
+		}
+
+		//Wait (at most timeout) until all buffered data is in the file; returns false on timeout
+		bool drain(std::chrono::milliseconds timeout)
+		{	std::unique_lock<std::timed_mutex> lk(lock, std::defer_lock);
+			if(!lk.try_lock_for(timeout)) return false; //could happen if crashed while holding the lock
+			return cvIdle.wait_for(lk, timeout, [this]{ return !count && !writing; });
+		}
+
+		void close(bool closeTarget=true)
+		{	{	std::lock_guard<std::timed_mutex> lk(lock);
+				stop = true;
+			}
+			cvData.notify_all();
+			writer.join();
+			if(!closeTarget || target==stdout || target==stderr) fflush(target);
+			else fclose(target);
+		}
+	};
+
+	//Active streams (never freed, so that error paths can use it during static destruction):
+	std::mutex& streamsLock() { static std::mutex* m = new std::mutex; return *m; }
+	std::list<Stream*>& streams() { static std::list<Stream*>* s = new std::list<Stream*>; return *s; }
+
+	#ifdef __GLIBC__
+	ssize_t cookieWrite(void* cookie, const char* data, size_t size)
+	{	return ((Stream*)cookie)->write(data, size);
+	}
+
+	int cookieClose(void* cookie)
+	{	Stream* stream = (Stream*)cookie;
+		{	std::lock_guard<std::mutex> lk(streamsLock());
+			streams().remove(stream);
+		}
+		stream->close();
+		delete stream;
+		return 0;
+	}
+	#endif
+}
+
+FILE* asyncLogOpen(FILE* fp, size_t bufferSize)
+{
+	#ifdef __GLIBC__
+	if(!fp || !bufferSize) return fp;
+	fflush(fp);
+	AsyncLog::Stream* stream = new AsyncLog::Stream(fp, bufferSize);
+	cookie_io_functions_t io = { 0, AsyncLog::cookieWrite, 0, AsyncLog::cookieClose };
+	stream->fp = fopencookie(stream, "w", io);
+	if(!stream->fp)
+	{	stream->close(false);
+		delete stream;
+		return fp; //keep writing synchronously
+	}
+	setvbuf(stream->fp, 0, _IOFBF, 1<<16); //stdio buffering in front of the ring buffer
+	std::lock_guard<std::mutex> lk(AsyncLog::streamsLock());
+	AsyncLog::streams().push_back(stream);
+	return stream->fp;
+	#else
+	return fp; //fopencookie unavailable: keep writing synchronously
+	#endif
+}
+
+void asyncLogDrain()
+{	std::unique_lock<std::mutex> lk(AsyncLog::streamsLock(), std::try_to_lock);
+	if(!lk.owns_lock()) return;
+	for(AsyncLog::Stream* stream: AsyncLog::streams())
+	{	if(stream->fp) fflush(stream->fp);
+		stream->drain(std::chrono::milliseconds(5000));
+	}
+}
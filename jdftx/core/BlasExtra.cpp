@@ -63,13 +63,43 @@ void eblas_zgemm(
 	const CBLAS_TRANSPOSE TransA, const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
 	const complex& alpha, const complex *A, const int lda, const complex *B, const int ldb,
 	const complex& beta, complex *C, const int ldc)
-{
+{	if(double(M)*N*K < 4096.) //tiny multiply (eg. per-atom Ylm or DFT+U matrices): threading and timing overheads would dominate
+	{	cblas_zgemm(CblasColMajor, TransA, TransB, M, N, K, &alpha, A, lda, B, ldb, &beta, C, ldc);
+		return;
+	}
+	static StopWatch watch("eblas_zgemm"); watch.start();
+	watch.addWork(8.*M*N*K, 16.*(double(M)*K + double(K)*N + 2.*M*N)); //complex multiply-adds; read A, B and read-write C once
 	#ifdef THREADED_BLAS
 	cblas_zgemm(CblasColMajor, TransA, TransB, M, N, K, &alpha, A, lda, B, ldb, &beta, C, ldc);
 	#else
 	threadLaunch(eblas_zgemm_sub, std::max(M,N), //parallelize along larger dimension of output
  		TransA, TransB, M, N, K, &alpha, A, lda, B, ldb, &beta, C, ldc);
 	#endif
+	watch.stop();
+}
+
+void eblas_zgemm_batch_sub(size_t iStart, size_t iStop, const ZgemmArgs* batch)
+{	for(size_t i=iStart; i<iStop; i++)
+	{	const ZgemmArgs& b = batch[i];
+		cblas_zgemm(CblasColMajor, b.TransA, b.TransB, b.M, b.N, b.K, &b.alpha, b.A, b.lda, b.B, b.ldb, &b.beta, b.C, b.ldc);
+	}
+}
+void eblas_zgemm_batch(const std::vector<ZgemmArgs>& batch)
+{	if(!batch.size()) return;
+	static StopWatch watch("eblas_zgemm_batch"); watch.start();
+	//Thread over the batch when it can occupy all threads or each multiply is too small to thread well:
+	double costMax = 0.;
+	for(const ZgemmArgs& b: batch)
+	{	costMax = std::max(costMax, double(b.M)*b.N*b.K);
+		watch.addWork(8.*b.M*b.N*b.K, 16.*(double(b.M)*b.K + double(b.K)*b.N + 2.*b.M*b.N));
+	}
+	if(shouldThreadOperators() && batch.size()>1 && (int(batch.size())>=nProcsAvailable || costMax<1e7))
+		threadLaunchChunked(0, 2, eblas_zgemm_batch_sub, batch.size(), batch.data()); //chunks balance differing sizes
+	else
+	{	for(const ZgemmArgs& b: batch)
+			eblas_zgemm(b.TransA, b.TransB, b.M, b.N, b.K, b.alpha, b.A, b.lda, b.B, b.ldb, b.beta, b.C, b.ldc);
+	}
+	watch.stop();
 }
 
 template<typename scalar, typename scalar2, typename Conjugator>
@@ -90,6 +120,36 @@ DEFINE_SPARSE_AXPY_CPU_LAUNCHER(gather)
 DEFINE_SPARSE_AXPY(scatter,)
 DEFINE_SPARSE_AXPY(gather,)
 
+//Batched scatter / gather: loop over vectors within blocks of the index array, so that each block
+//of indices (and the corresponding cache lines of the random-access array) is reused nBatch times
+static const size_t sparseAxpyBlockSize = 1024;
+void eblas_scatter_zdaxpy_batch_sub(size_t iStart, size_t iStop, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	for(size_t iBlock=iStart; iBlock<iStop; iBlock+=sparseAxpyBlockSize)
+	{	size_t iBlockStop = std::min(iBlock+sparseAxpyBlockSize, iStop);
+		for(int b=0; b<nBatch; b++)
+		{	const complex* xb = x + b*xStride;
+			complex* yb = y + b*yStride;
+			for(size_t i=iBlock; i<iBlockStop; i++) yb[index[i]] += a * xb[i];
+		}
+	}
+}
+void eblas_gather_zdaxpy_batch_sub(size_t iStart, size_t iStop, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	for(size_t iBlock=iStart; iBlock<iStop; iBlock+=sparseAxpyBlockSize)
+	{	size_t iBlockStop = std::min(iBlock+sparseAxpyBlockSize, iStop);
+		for(int b=0; b<nBatch; b++)
+		{	const complex* xb = x + b*xStride;
+			complex* yb = y + b*yStride;
+			for(size_t i=iBlock; i<iBlockStop; i++) yb[i] += a * xb[index[i]];
+		}
+	}
+}
+void eblas_scatter_zdaxpy_batch(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	threadLaunch((size_t(Nindex)*nBatch<100000) ? 1 : 0, eblas_scatter_zdaxpy_batch_sub, Nindex, a, index, x, xStride, y, yStride, nBatch);
+}
+void eblas_gather_zdaxpy_batch(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	threadLaunch((size_t(Nindex)*nBatch<100000) ? 1 : 0, eblas_gather_zdaxpy_batch_sub, Nindex, a, index, x, xStride, y, yStride, nBatch);
+}
+
 
 void eblas_accumNorm_sub(size_t iStart, size_t iStop, const double& a, const complex* x, double* y)
 {	for(size_t i=iStart; i<iStop; i++) y[i] += a * x[i].norm();
@@ -146,6 +206,29 @@ void eblas_symmetrize(int N, int n, const int* symmIndex, const int* symmMult, c
 		eblas_symmetrize_phase_sub, N, n, symmIndex, symmMult, phase, x);
 }
 
+void eblas_symmetrize_phase_multi_sub(size_t iStart, size_t iStop, int n, const int* symmIndex, const int* symmMult, const complex* phase, int nComp, complex* const* x)
+{	for(size_t i=iStart; i<iStop; i++)
+	{	const int* index = symmIndex + n*i;
+		const complex* phase_i = phase + n*i;
+		double scale = 1./(n*symmMult[i]);
+		for(int c=0; c<nComp; c++)
+		{	complex* xc = x[c];
+			complex xSum = 0.;
+			for(int j=0; j<n; j++)
+				xSum += xc[index[j]] * phase_i[j];
+			xSum *= scale;
+			for(int j=0; j<n; j++)
+				xc[index[j]] = 0.;
+			for(int j=0; j<n; j++)
+				xc[index[j]] += xSum * phase_i[j].conj();
+		}
+	}
+}
+void eblas_symmetrize(int N, int n, const int* symmIndex, const int* symmMult, const complex* phase, int nComp, complex* const* x)
+{	threadLaunch((N*n*nComp<10000) ? 1 : 0, //force single threaded for small problem sizes
+		eblas_symmetrize_phase_multi_sub, N, n, symmIndex, symmMult, phase, nComp, x);
+}
+
 //BLAS-1 threaded wrappers
 
 void eblas_zscal_sub(size_t iStart, size_t iStop, const complex* a, complex* x, int incx)
@@ -256,6 +339,28 @@ double eblas_ddot(int N, const double* x, int incx, const double* y, int incy)
 	#endif
 }
 
+void eblas_ddot_multi_sub(size_t iStart, size_t iStop, int nx, const double* const* x, const double* y,
+	double* result, std::mutex* lock)
+{	//Compute this thread's contribution in blocks that stay in cache across all x:
+	const size_t blockSize = 2048;
+	std::vector<double> resultSub(nx, 0.);
+	for(size_t iBlock=iStart; iBlock<iStop; iBlock+=blockSize)
+	{	int nBlock = std::min(blockSize, iStop-iBlock);
+		for(int j=0; j<nx; j++)
+			resultSub[j] += cblas_ddot(nBlock, x[j]+iBlock, 1, y+iBlock, 1);
+	}
+	//Accumulate over threads (need sync):
+	lock->lock();
+	for(int j=0; j<nx; j++) result[j] += resultSub[j];
+	lock->unlock();
+}
+void eblas_ddot_multi(int N, int nx, const double* const* x, const double* y, double* result)
+{	for(int j=0; j<nx; j++) result[j] = 0.;
+	std::mutex lock;
+	threadLaunch((N<100000) ? 1 : 0,
+		eblas_ddot_multi_sub, N, nx, x, y, result, &lock);
+}
+
 void eblas_dznrm2_sub(size_t iStart, size_t iStop, const complex* x, int incx, double* ret, std::mutex* lock)
 {	//Compute this thread's contribution:
 	double retSub = cblas_dznrm2(iStop-iStart, x+incx*iStart, incx);
@@ -18,8 +18,12 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 -------------------------------------------------------------------*/
 
 #include <core/GpuKernelUtils.h>
+#include <core/BlasExtra.h>
 #include <core/BlasExtra_internal.h>
+#include <core/Profiler.h>
 #include <algorithm>
+#include <map>
+#include <tuple>
 #include <cublas_v2.h>
 #include <cfloat>
 #include <gsl/gsl_cblas.h>
@@ -31,17 +35,17 @@ void eblas_mul_kernel(const int N, const Tx* X, const int incX, Ty* Y, const int
 }
 void eblas_dmul_gpu(const int N, const double* X, const int incX, double* Y, const int incY)
 {	GpuLaunchConfig1D glc(eblas_mul_kernel<double,double>, N);
-	eblas_mul_kernel<double,double><<<glc.nBlocks,glc.nPerBlock>>>(N, X,incX, Y,incY);
+	eblas_mul_kernel<double,double><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X,incX, Y,incY);
 	gpuErrorCheck();
 }
 void eblas_zmul_gpu(const int N, const complex* X, const int incX, complex* Y, const int incY)
 {	GpuLaunchConfig1D glc(eblas_mul_kernel<complex,complex>, N);
-	eblas_mul_kernel<complex,complex><<<glc.nBlocks,glc.nPerBlock>>>(N, X,incX, Y,incY);
+	eblas_mul_kernel<complex,complex><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X,incX, Y,incY);
 	gpuErrorCheck();
 }
 void eblas_zmuld_gpu(const int N, const double* X, const int incX, complex* Y, const int incY)
 {	GpuLaunchConfig1D glc(eblas_mul_kernel<double,complex>, N);
-	eblas_mul_kernel<double,complex><<<glc.nBlocks,glc.nPerBlock>>>(N, X,incX, Y,incY);
+	eblas_mul_kernel<double,complex><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X,incX, Y,incY);
 	gpuErrorCheck();
 }
 
@@ -59,7 +63,7 @@ void eblas_lincomb_gpu(const int N,
 	const complex& sY, const complex* Y, const int incY,
 	complex* Z, const int incZ)
 {	GpuLaunchConfig1D glc(eblas_lincomb_kernel, N);
-	eblas_lincomb_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, sX,X,incX, sY,Y,incY, Z,incZ);
+	eblas_lincomb_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, sX,X,incX, sY,Y,incY, Z,incZ);
 	gpuErrorCheck();
 }
 
@@ -74,9 +78,69 @@ inline cublasOperation_t cublasTranspose(CBLAS_TRANSPOSE trans)
 void eblas_zgemm_gpu(CBLAS_TRANSPOSE TransA, CBLAS_TRANSPOSE TransB, int M, int N, int K,
 	const complex& alpha, const complex *A, const int lda, const complex *B, const int ldb,
 	const complex& beta, complex *C, const int ldc)
-{	cublasZgemm(cublasHandle, cublasTranspose(TransA), cublasTranspose(TransB), M, N, K,
+{	static StopWatch watch("eblas_zgemm"); watch.start();
+	cublasZgemm(cublasHandle, cublasTranspose(TransA), cublasTranspose(TransB), M, N, K,
 		(const double2*)&alpha, (const double2*)A, lda, (const double2*)B, ldb,
 		(const double2*)&beta, (double2*)C, ldc);
+	watch.stop();
+}
+
+void eblas_zgemm_batch_gpu(const std::vector<ZgemmArgs>& batch)
+{	if(!batch.size()) return;
+	static StopWatch watch("eblas_zgemm_batch"); watch.start();
+	//Group multiplies of identical shape and coefficients:
+	typedef std::tuple<int,int,int,int,int,int,int,int, double,double,double,double> Shape;
+	std::map<Shape, std::vector<const ZgemmArgs*>> groups;
+	for(const ZgemmArgs& b: batch)
+		groups[Shape(b.TransA, b.TransB, b.M, b.N, b.K, b.lda, b.ldb, b.ldc,
+			b.alpha.real(), b.alpha.imag(), b.beta.real(), b.beta.imag())].push_back(&b);
+	//Issue each group on its own stream, ordered after preceding work on gpuStream (and vice versa, using events):
+	const int nStreams = 4;
+	static cudaStream_t streams[nStreams];
+	static cudaEvent_t events[nStreams+1]; //one per stream, and one for gpuStream
+	static bool streamsCreated = false;
+	if(!streamsCreated)
+	{	for(int iStream=0; iStream<nStreams; iStream++) cudaStreamCreate(&streams[iStream]);
+		for(int iEvent=0; iEvent<=nStreams; iEvent++) cudaEventCreateWithFlags(&events[iEvent], cudaEventDisableTiming);
+		streamsCreated = true;
+	}
+	cudaEventRecord(events[nStreams], gpuStream);
+	for(int iStream=0; iStream<nStreams; iStream++) cudaStreamWaitEvent(streams[iStream], events[nStreams], 0);
+	std::vector<const double2*> ptrs; //A, B and C pointers of batched groups
+	for(const auto& group: groups)
+		if(group.second.size() > 1)
+			for(int iArr=0; iArr<3; iArr++)
+				for(const ZgemmArgs* b: group.second)
+					ptrs.push_back((const double2*)(iArr==0 ? b->A : (iArr==1 ? b->B : b->C)));
+	const double2** ptrsGpu = 0;
+	if(ptrs.size())
+	{	cudaMalloc(&ptrsGpu, sizeof(const double2*)*ptrs.size());
+		cudaMemcpy(ptrsGpu, ptrs.data(), sizeof(const double2*)*ptrs.size(), cudaMemcpyHostToDevice);
+	}
+	int iStream = 0; size_t ptrOffset = 0;
+	for(const auto& group: groups)
+	{	const ZgemmArgs& b = *(group.second[0]);
+		int nGroup = group.second.size();
+		cublasSetStream(cublasHandle, streams[(iStream++) % nStreams]);
+		if(nGroup == 1)
+			cublasZgemm(cublasHandle, cublasTranspose(b.TransA), cublasTranspose(b.TransB), b.M, b.N, b.K,
+				(const double2*)&b.alpha, (const double2*)b.A, b.lda, (const double2*)b.B, b.ldb,
+				(const double2*)&b.beta, (double2*)b.C, b.ldc);
+		else
+		{	cublasZgemmBatched(cublasHandle, cublasTranspose(b.TransA), cublasTranspose(b.TransB), b.M, b.N, b.K,
+				(const double2*)&b.alpha, ptrsGpu+ptrOffset, b.lda, ptrsGpu+ptrOffset+nGroup, b.ldb,
+				(const double2*)&b.beta, (double2**)(ptrsGpu+ptrOffset+2*nGroup), b.ldc, nGroup);
+			ptrOffset += 3*nGroup;
+		}
+	}
+	cublasSetStream(cublasHandle, gpuStream);
+	for(int iStream=0; iStream<nStreams; iStream++)
+	{	cudaEventRecord(events[iStream], streams[iStream]);
+		cudaStreamWaitEvent(gpuStream, events[iStream], 0);
+	}
+	if(ptrsGpu) cudaFree(ptrsGpu); //implicitly waits for the batched multiplies
+	gpuErrorCheck();
+	watch.stop();
 }
 
 template<typename scalar, typename scalar2, typename Conjugator> __global__ 
@@ -93,7 +157,7 @@ void eblas_gather_axpy_kernel(const int N, scalar2 a, const int* index, const sc
 	template<typename scalar, typename scalar2, typename Conjugator> \
 	void eblas_##type##_axpy_gpu(const int N, scalar2 a, const int* index, const scalar* x, scalar* y, const scalar* w, const Conjugator& conjugator) \
 	{	GpuLaunchConfig1D glc(eblas_##type##_axpy_kernel<scalar,scalar2,Conjugator>, N); \
-		eblas_##type##_axpy_kernel<scalar,scalar,Conjugator><<<glc.nBlocks,glc.nPerBlock>>>(N, a, index, x, y, w, conjugator); \
+		eblas_##type##_axpy_kernel<scalar,scalar,Conjugator><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, a, index, x, y, w, conjugator); \
 		gpuErrorCheck(); \
 	}
 DEFINE_SPARSE_AXPY_GPU_LAUNCHER(scatter)
@@ -101,6 +165,34 @@ DEFINE_SPARSE_AXPY_GPU_LAUNCHER(gather)
 DEFINE_SPARSE_AXPY(scatter, _gpu)
 DEFINE_SPARSE_AXPY(gather, _gpu)
 
+//Batched scatter / gather: each thread handles one index for all vectors of the batch
+__global__
+void eblas_scatter_zdaxpy_batch_kernel(const int N, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	int i = kernelIndex1D();
+	if(i<N)
+	{	int iOut = index[i];
+		for(int b=0; b<nBatch; b++) y[b*yStride+iOut] += a * x[b*xStride+i];
+	}
+}
+__global__
+void eblas_gather_zdaxpy_batch_kernel(const int N, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	int i = kernelIndex1D();
+	if(i<N)
+	{	int iIn = index[i];
+		for(int b=0; b<nBatch; b++) y[b*yStride+i] += a * x[b*xStride+iIn];
+	}
+}
+void eblas_scatter_zdaxpy_batch_gpu(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	GpuLaunchConfig1D glc(eblas_scatter_zdaxpy_batch_kernel, Nindex);
+	eblas_scatter_zdaxpy_batch_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(Nindex, a, index, x, xStride, y, yStride, nBatch);
+	gpuErrorCheck();
+}
+void eblas_gather_zdaxpy_batch_gpu(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch)
+{	GpuLaunchConfig1D glc(eblas_gather_zdaxpy_batch_kernel, Nindex);
+	eblas_gather_zdaxpy_batch_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(Nindex, a, index, x, xStride, y, yStride, nBatch);
+	gpuErrorCheck();
+}
+
 
 __global__
 void eblas_accumNorm_kernel(int N, double a, const complex* x, double* y)
@@ -109,7 +201,7 @@ void eblas_accumNorm_kernel(int N, double a, const complex* x, double* y)
 }
 void eblas_accumNorm_gpu(int N, const double& a, const complex* x, double* y)
 {	GpuLaunchConfig1D glc(eblas_accumNorm_kernel, N);
-	eblas_accumNorm_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, a, x, y);
+	eblas_accumNorm_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, a, x, y);
 	gpuErrorCheck();
 }
 
@@ -124,7 +216,7 @@ void eblas_accumProd_kernel(int N, double a, const complex* xU, const complex* x
 }
 void eblas_accumProd_gpu(int N, const double& a, const complex* xU, const complex* xC, double* yRe, double* yIm)
 {	GpuLaunchConfig1D glc(eblas_accumProd_kernel, N);
-	eblas_accumProd_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, a, xU, xC, yRe, yIm);
+	eblas_accumProd_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, a, xU, xC, yRe, yIm);
 	gpuErrorCheck();
 }
 
@@ -140,7 +232,7 @@ void eblas_symmetrize_kernel(int N, int n, const int* symmIndex, scalar* x, doub
 }
 template<typename scalar> void eblas_symmetrize_gpu(int N, int n, const int* symmIndex, scalar* x)
 {	GpuLaunchConfig1D glc(eblas_symmetrize_kernel<scalar>, N);
-	eblas_symmetrize_kernel<scalar><<<glc.nBlocks,glc.nPerBlock>>>(N, n, symmIndex, x, 1./n);
+	eblas_symmetrize_kernel<scalar><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, symmIndex, x, 1./n);
 	gpuErrorCheck();
 }
 void eblas_symmetrize_gpu(int N, int n, const int* symmIndex, double* x) { eblas_symmetrize_gpu<double>(N, n, symmIndex, x); }
@@ -162,7 +254,7 @@ void eblas_symmetrize_phase_kernel(int N, int n, const int* symmIndex, const int
 }
 void eblas_symmetrize_gpu(int N, int n, const int* symmIndex, const int* symmMult, const complex* phase, complex* x)
 {	GpuLaunchConfig1D glc(eblas_symmetrize_phase_kernel, N);
-	eblas_symmetrize_phase_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, n, symmIndex, symmMult, phase, x);
+	eblas_symmetrize_phase_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, symmIndex, symmMult, phase, x);
 	gpuErrorCheck();
 }
 
@@ -254,7 +346,7 @@ void eblas_capMinMax_gpu(const int N, double* x, double& xMin, double& xMax, dou
 	double* xMinBlk; cudaMalloc(&xMinBlk, sizeof(double)*nBlocksTot*2);
 	double* xMaxBlk = xMinBlk + nBlocksTot;
 	int sharedMemBytes = 2*glc.nPerBlock.x*sizeof(double);
-	eblas_capMinMax_kernel<<<glc.nBlocks,glc.nPerBlock,sharedMemBytes>>>(N,x,xMinBlk,xMaxBlk,capLo,capHi);
+	eblas_capMinMax_kernel<<<glc.nBlocks, glc.nPerBlock, sharedMemBytes, gpuStream>>>(N,x,xMinBlk,xMaxBlk,capLo,capHi);
 	//Finish on the CPU:
 	double* xMinCpu = new double[2*nBlocksTot];
 	double* xMaxCpu = xMinCpu + nBlocksTot;
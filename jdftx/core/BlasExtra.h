@@ -31,6 +31,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <cstdlib>
 #include <cstdio>
 #include <cfloat>
+#include <vector>
 #include <core/scalar.h>
 #include <core/Thread.h>
 
@@ -128,6 +129,23 @@ void eblas_zgemm_gpu(CBLAS_TRANSPOSE TransA, CBLAS_TRANSPOSE TransB, int M, int
 	const complex& beta, complex *C, const int ldc);
 #endif
 
+//! @brief Arguments of one complex matrix multiply in a batch (same meaning as in eblas_zgemm())
+struct ZgemmArgs
+{	CBLAS_TRANSPOSE TransA, TransB;
+	int M, N, K;
+	complex alpha; const complex *A; int lda; const complex *B; int ldb;
+	complex beta; complex *C; int ldc;
+};
+
+//! @brief Batch of independent complex matrix multiplies (whose sizes may differ), such as one per k-point.
+//! Many small multiplies are distributed over threads rather than each being threaded internally.
+void eblas_zgemm_batch(const std::vector<ZgemmArgs>& batch);
+#ifdef GPU_ENABLED
+//! @brief Equivalent of eblas_zgemm_batch() for GPU data pointers: multiplies of identical shape are issued
+//! together with cublasZgemmBatched, and the remainder are overlapped on a pool of CUDA streams
+void eblas_zgemm_batch_gpu(const std::vector<ZgemmArgs>& batch);
+#endif
+
 //Sparse<->dense vector operations:
 //! @brief Scatter y(index) += a * x
 //! @param Nindex Length of index array
@@ -159,7 +177,18 @@ void eblas_gather_zaxpy(const int Nindex, complex a, const int* index, const com
 //! @brief Equivalent of eblas_scatter_zdaxpy() for real data arrays
 void eblas_gather_daxpy(const int Nindex, double a, const int* index, const double* x, double* y, const double* w=0);
 
+//! @brief Scatter nBatch vectors together: y[b*yStride + index] += a * x[b*xStride + (0:Nindex-1)] for 0 <= b < nBatch.
+//! Several vectors are processed per block of index loads, which amortizes the random access pattern (eg. over
+//! the columns and spinor components of a ColumnBundle, scattered to consecutive FFT boxes).
+void eblas_scatter_zdaxpy_batch(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch);
+//! @brief Gather nBatch vectors together: y[b*yStride + (0:Nindex-1)] += a * x[b*xStride + index] for 0 <= b < nBatch (see eblas_scatter_zdaxpy_batch)
+void eblas_gather_zdaxpy_batch(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch);
+
 #ifdef GPU_ENABLED
+//! @brief Equivalent of eblas_scatter_zdaxpy_batch() for GPU data pointers
+void eblas_scatter_zdaxpy_batch_gpu(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch);
+//! @brief Equivalent of eblas_gather_zdaxpy_batch() for GPU data pointers
+void eblas_gather_zdaxpy_batch_gpu(const int Nindex, double a, const int* index, const complex* x, size_t xStride, complex* y, size_t yStride, int nBatch);
 //! @brief Equivalent of eblas_scatter_zdaxpy() for GPU data pointers
 void eblas_scatter_zdaxpy_gpu(const int Nindex, double a, const int* index, const complex* x, complex* y, bool conjx=false, const complex* w=0, bool conjw=false);
 //! @brief Equivalent of eblas_scatter_zaxpy() for GPU data pointers
@@ -223,6 +252,9 @@ void eblas_symmetrize(int N, int n, const int* symmIndex, const int* symmMult, c
 //! @brief Equivalent of eblas_symmetrize() for complex GPU data pointers
 void eblas_symmetrize_gpu(int N, int n, const int* symmIndex, const int* symmMult, const complex* phase, complex* x);
 #endif
+//! @brief Equivalent of eblas_symmetrize() with phase factors for nComp arrays x[0:nComp] at once,
+//! reusing the indices and phases of each equivalence class across arrays (CPU only)
+void eblas_symmetrize(int N, int n, const int* symmIndex, const int* symmMult, const complex* phase, int nComp, complex* const* x);
 
 //Threaded-wrappers for BLAS1 functions (Cblas)
 //! @brief Copy a data array
@@ -250,6 +282,9 @@ void eblas_zaxpy(int N, const complex& a, const complex* x, int incx, complex* y
 complex eblas_zdotc(int N, const complex* x, int incx, const complex* y, int incy);
 //! @brief Dot product of real arrays: threaded wrapper to the cblas_ddot BLAS1 function
 double eblas_ddot(int N, const double* x, int incx, const double* y, int ncy);
+//! @brief Dot products result[j] = x[j] . y of nx real arrays with one array, in a single (threaded) pass
+//! over blocks of y, each of which is contracted with all x[j] while in cache (GEMV with separately stored columns)
+void eblas_ddot_multi(int N, int nx, const double* const* x, const double* y, double* result);
 //! @brief 2-norm of a complex array: threaded wrapper to the cblas_dznrm2 BLAS1 function
 double eblas_dznrm2(int N, const complex* x, int incx);
 //! @brief 2-norm of a real array: threaded wrapper to the cblas_dnrm2 BLAS1 function
@@ -36,18 +36,27 @@ BlipConverter::BlipConverter(const vector3<int>& S) : S(S)
 			gamma[dir][i] = (1.0/6) * pow(k*k/(1-cos(k)),2);
 		}
 	}
+	//Tabulate products, so that conversions are a single (threaded / GPU) multiply:
+	gammaFull.init(S[0]*S[1]*S[2]);
+	gammaHalf.init(S[0]*S[1]*(S[2]/2+1));
+	double* gammaFullData = gammaFull.data();
+	double* gammaHalfData = gammaHalf.data();
+	vector3<int> iv;
+	for(iv[0]=0; iv[0]<S[0]; iv[0]++)
+	for(iv[1]=0; iv[1]<S[1]; iv[1]++)
+	{	double gamma01 = gamma[0][iv[0]]*gamma[1][iv[1]];
+		for(iv[2]=0; iv[2]<S[2]; iv[2]++)
+		{	double gammaCur = gamma01*gamma[2][iv[2]];
+			*(gammaFullData++) = gammaCur;
+			if(iv[2] <= S[2]/2) *(gammaHalfData++) = gammaCur;
+		}
+	}
 }
 
 //Given a complex PW basis object, return corresponding real-space Blip coefficient set
 complexScalarField BlipConverter::operator()(const complexScalarFieldTilde& vTilde) const
 {	assert(vTilde->gInfo.S == S);
-	complex* vTildeData = vTilde->data();
-	int index=0;
-	vector3<int> iv;
-	for(iv[0]=0; iv[0]<S[0]; iv[0]++)
-	for(iv[1]=0; iv[1]<S[1]; iv[1]++)
-	for(iv[2]=0; iv[2]<S[2]; iv[2]++)
-		vTildeData[index++] *= (gamma[0][iv[0]]*gamma[1][iv[1]]*gamma[2][iv[2]]);
+	callPref(eblas_zmuld)(gammaFull.nData(), gammaFull.dataPref(),1, vTilde->dataPref(),1);
 	return I(vTilde);
 }
 complexScalarField BlipConverter::operator()(const complexScalarField& v) const
@@ -57,13 +66,7 @@ complexScalarField BlipConverter::operator()(const complexScalarField& v) const
 //Given a real PW basis object v, return corresponding real-space Blip coefficient set
 ScalarField BlipConverter::operator()(const ScalarFieldTilde& vTilde) const
 {	assert(vTilde->gInfo.S == S);
-	complex* vTildeData = vTilde->data();
-	int index=0;
-	vector3<int> iv;
-	for(iv[0]=0; iv[0]<S[0]; iv[0]++)
-	for(iv[1]=0; iv[1]<S[1]; iv[1]++)
-	for(iv[2]=0; iv[2]<=S[2]/2; iv[2]++)
-		vTildeData[index++] *= (gamma[0][iv[0]]*gamma[1][iv[1]]*gamma[2][iv[2]]);
+	callPref(eblas_zmuld)(gammaHalf.nData(), gammaHalf.dataPref(),1, vTilde->dataPref(),1);
 	return I(vTilde);
 }
 ScalarField BlipConverter::operator()(const ScalarField& v) const
@@ -37,6 +37,7 @@ class BlipConverter
 {
 	vector3<int> S;
 	std::vector<double> gamma[3];
+	ManagedArray<double> gammaFull, gammaHalf; //!< products of gamma over all points in full (complex) and half (real) reciprocal space layouts
 public:
 	BlipConverter(const vector3<int>& S);
 
@@ -22,6 +22,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/CoulombWire.h>
 #include <core/CoulombIsolated.h>
 #include <core/Coulomb_internal.h>
+#include <core/CoulombKernel.h>
 #include <core/Coulomb_ExchangeEval.h>
 #include <core/LoopMacros.h>
 #include <core/BlasExtra.h>
@@ -237,6 +238,48 @@ double Coulomb::energyAndGrad(std::vector<Atom>& atoms) const
 	return Eewald;
 }
 
+//Real-space Ewald contributions involving atom i1 (accumulating only its force, so that atoms may be threaded over):
+double ewaldRealSpace_calc(size_t i1, matrix3<> RTR, vector3<> halfWidth, vector3<int> Nreal, double eta, double rCutSq, std::vector<Atom>* atoms)
+{	Atom& a1 = atoms->at(i1);
+	double etaSq = eta*eta;
+	double E = 0.; vector3<> force(0.,0.,0.);
+	for(const Atom& a2: *atoms)
+	{	vector3<> x0 = a1.pos - a2.pos;
+		//Range of image cells overlapping the cutoff sphere centered on x0:
+		vector3<int> iRmin, iRmax;
+		for(int k=0; k<3; k++)
+		{	iRmin[k] = Nreal[k] ? int(ceil(-x0[k] - halfWidth[k])) : 0;
+			iRmax[k] = Nreal[k] ? int(floor(-x0[k] + halfWidth[k])) : 0;
+		}
+		vector3<int> iR; //integer cell number
+		for(iR[0]=iRmin[0]; iR[0]<=iRmax[0]; iR[0]++)
+			for(iR[1]=iRmin[1]; iR[1]<=iRmax[1]; iR[1]++)
+				for(iR[2]=iRmin[2]; iR[2]<=iRmax[2]; iR[2]++)
+				{	vector3<> x = iR + x0;
+					double rSq = RTR.metric_length_squared(x);
+					if(!rSq || rSq>rCutSq) continue; //exclude self-interaction and negligible terms
+					double r = sqrt(rSq);
+					double erfcTerm = erfc(eta*r)/r;
+					E += 0.5 * a1.Z * a2.Z * erfcTerm;
+					force += (RTR * x) * (a1.Z * a2.Z * (erfcTerm + (2./sqrt(M_PI))*eta*exp(-etaSq*rSq))/rSq);
+				}
+	}
+	a1.force += force;
+	return E;
+}
+
+double ewaldRealSpace(const matrix3<>& R, const vector3<int>& Nreal, double sigma, std::vector<Atom>& atoms)
+{	static StopWatch watch("ewaldRealSpace"); watch.start();
+	double rCut = CoulombKernel::nSigmasPerWidth * sigma;
+	matrix3<> invR = inv(R);
+	vector3<> halfWidth; //half-width of the bounding box of the cutoff sphere in lattice coordinates
+	for(int k=0; k<3; k++)
+		halfWidth[k] = rCut * invR.row(k).length();
+	double E = threadedAccumulate(ewaldRealSpace_calc, atoms.size(), (~R)*R, halfWidth, Nreal, sqrt(0.5)/sigma, rCut*rCut, &atoms);
+	watch.stop();
+	return E;
+}
+
 void getEfieldPotential_sub(size_t iStart, size_t iStop, const vector3<int>& S, const WignerSeitz* ws,
 	const vector3<>& xCenter, const vector3<>& RT_Efield_ramp, const vector3<>& RT_Efield_wave, double* V)
 {	matrix3<> invS = inv(Diag(vector3<>(S)));
@@ -259,10 +302,9 @@ ScalarField Coulomb::getEfieldPotential() const
 	else return ScalarField();
 }
 
-void setEmbedIndex_sub(size_t iStart, size_t iStop, const vector3<int>& S, const vector3<int>& Sembed, const WignerSeitz* ws, int* embedIndex)
-{	vector3<> invS; for(int k=0; k<3; k++) invS[k] = 1./S[k];
-	THREAD_rLoop
-	(	vector3<int> ivEmbed = ws->restrict(iv, S, invS); //wrapped coordinates within WS cell of original mesh
+void setEmbedIndex_sub(size_t iStart, size_t iStop, const vector3<int>& S, const vector3<int>& Sembed, const WignerSeitz::MeshRestriction* wsMesh, int* embedIndex)
+{	THREAD_rLoop
+	(	vector3<int> ivEmbed = (*wsMesh)(iv); //wrapped coordinates within WS cell of original mesh
 		for(int k=0; k<3; k++) //wrapped embedding mesh cooridnates within first fundamental domain:
 		{	ivEmbed[k] = ivEmbed[k] % Sembed[k];
 			if(ivEmbed[k]<0) ivEmbed[k] += Sembed[k];
@@ -274,13 +316,12 @@ void setEmbedIndex_sub(size_t iStart, size_t iStop, const vector3<int>& S, const
 //Initialize index maps for symmetric points on the boundary
 //Note: in this case S is the double size mesh and Sorig is the smaller original mesh
 void setEmbedBoundarySymm_sub(size_t iStart, size_t iStop, const vector3<int>& Sorig, const vector3<int>& S,
-	const WignerSeitz* wsOrig, std::mutex* m, std::multimap<int,int>* boundaryMap)
+	const WignerSeitz* wsOrig, const WignerSeitz::MeshRestriction* wsMesh, std::mutex* m, std::multimap<int,int>* boundaryMap)
 {	//Compute partial index map per thread:
 	std::multimap<int,int> bMap;
-	vector3<> invS; for(int k=0; k<3; k++) invS[k] = 1./S[k];
 	vector3<> invSorig; for(int k=0; k<3; k++) invSorig[k] = 1./Sorig[k];
 	THREAD_rLoop
-	(	vector3<int> ivWS = wsOrig->restrict(iv, S, invS); //this is a double-sized Wigner-Seitz cell restriction
+	(	vector3<int> ivWS = (*wsMesh)(iv); //this is a double-sized Wigner-Seitz cell restriction
 		vector3<> xOrig; for(int k=0; k<3; k++) xOrig[k] = ivWS[k] * invSorig[k]; //original lattice coordinates
 		if(wsOrig->onBoundary(xOrig))
 		{	for(int k=0; k<3; k++)
@@ -327,10 +368,12 @@ Coulomb::Coulomb(const GridInfo& gInfoOrig, const CoulombParams& params)
 		//Setup Wigner-Seitz cell of original mesh and initialize index map:
 		wsOrig = new WignerSeitz(gInfoOrig.R);
 		embedIndex.init(gInfoOrig.nr);
-		threadLaunch(setEmbedIndex_sub, gInfoOrig.nr, gInfoOrig.S, gInfo.S, wsOrig, embedIndex.data());
+		WignerSeitz::MeshRestriction wsMeshOrig(*wsOrig, gInfoOrig.S);
+		threadLaunch(setEmbedIndex_sub, gInfoOrig.nr, gInfoOrig.S, gInfo.S, &wsMeshOrig, embedIndex.data());
 		//Setup boundary symmetrization:
 		std::multimap<int,int> boundaryMap; std::mutex m;
-		threadLaunch(setEmbedBoundarySymm_sub, gInfo.nr, gInfoOrig.S, gInfo.S, wsOrig, &m, &boundaryMap);
+		WignerSeitz::MeshRestriction wsMesh(*wsOrig, gInfo.S);
+		threadLaunch(setEmbedBoundarySymm_sub, gInfo.nr, gInfoOrig.S, gInfo.S, wsOrig, &wsMesh, &m, &boundaryMap);
 		std::map<int, std::vector<int> > symmEquiv; //for each n, n-fold symmetry equivalence classes of the boundary
 		for(auto iter=boundaryMap.begin(); iter!=boundaryMap.end();)
 		{	int count = 0;
@@ -31,7 +31,7 @@ void coulombAnalytic_kernel(int zBlock, vector3<int> S, const matrix3<> GGT, con
 	void coulombAnalytic_gpu(vector3<int> S, const matrix3<>& GGT, const Coulomb##Type##_calc& calc, complex* data) \
 	{	GpuLaunchConfigHalf3D glc(coulombAnalytic_kernel<Coulomb##Type##_calc>, S); \
 		for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++) \
-			coulombAnalytic_kernel<Coulomb##Type##_calc><<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, calc, data); \
+			coulombAnalytic_kernel<Coulomb##Type##_calc><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, calc, data); \
 	}
 DECLARE_coulombAnalytic_gpu(Periodic)
 DECLARE_coulombAnalytic_gpu(Slab)
@@ -61,7 +61,7 @@ template<> void exchangeAnalytic_kernel<ExchangeSlab_calc>(int zBlock,
 	{	\
 		GpuLaunchConfig3D glc(exchangeAnalytic_kernel<Exchange##Type##_calc>, S); \
 		for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++) \
-			exchangeAnalytic_kernel<Exchange##Type##_calc><<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, calc, \
+			exchangeAnalytic_kernel<Exchange##Type##_calc><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, calc, \
 				data, kDiff, Vzero, thresholdSq); \
 	}
 DECLARE_exchangeAnalytic_gpu(Periodic)
@@ -79,7 +79,7 @@ void multRealKernel_kernel(int zBlock, vector3<int> S, const double* kernel, com
 void multRealKernel_gpu(vector3<int> S, const double* kernel, complex* data)
 {	GpuLaunchConfig3D glc(multRealKernel_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		multRealKernel_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, kernel, data);
+		multRealKernel_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, kernel, data);
 }
 
 __global__
@@ -90,5 +90,5 @@ void multTransformedKernel_kernel(int zBlock, vector3<int> S, const double* kern
 void multTransformedKernel_gpu(vector3<int> S, const double* kernel, complex* data, const vector3<int>& offset)
 {	GpuLaunchConfig3D glc(multTransformedKernel_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		multTransformedKernel_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, kernel, data, offset);
+		multTransformedKernel_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, kernel, data, offset);
 }
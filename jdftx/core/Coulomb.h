@@ -53,6 +53,8 @@ struct CoulombParams
 	
 	vector3<> Efield; //!< electric field (in Cartesian coordinates, atomic units [Eh/e/a0])
 	
+	string kernelCacheDir; //!< directory for persistent cache of Wigner-Seitz truncated kernels (none if empty)
+	
 	//Parameters for computing exchange integrals:
 	//! Regularization method for G=0 singularities in exchange
 	enum ExchangeRegularization
@@ -24,17 +24,21 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ManagedMemory.h>
 #include <core/Thread.h>
 #include <cfloat>
+#include <cstdio>
+#include <unistd.h>
 
 const double CoulombKernel::nSigmasPerWidth = 1.+sqrt(-2.*log(DBL_EPSILON)); //gaussian negligible at double precision (+1 sigma for safety)
 
-CoulombKernel::CoulombKernel(const matrix3<> R, const vector3<int> S, const vector3<bool> isTruncated, double omega)
-: R(R), S(S), isTruncated(isTruncated), omega(omega)
+CoulombKernel::CoulombKernel(const matrix3<> R, const vector3<int> S, const vector3<bool> isTruncated, double omega, const string& cacheDir)
+: R(R), S(S), isTruncated(isTruncated), omega(omega), cacheDir(cacheDir)
 {
 }
 
 
 void CoulombKernel::compute(double* data, const WignerSeitz& ws) const
-{	//Count number of truncated directions:
+{	size_t nG = S[0] * (S[1] * size_t(1 + S[2]/2));
+	if(cacheRead(data, nG)) return;
+	//Count number of truncated directions:
 	int nTruncated = 0;
 	for(int k=0; k<3; k++) if(isTruncated[k]) nTruncated++;
 	//Call appropriate routine:
@@ -43,6 +47,84 @@ void CoulombKernel::compute(double* data, const WignerSeitz& ws) const
 		case 3: computeIsolated(data, ws); break;
 		default: assert(!"Invalid truncated direction count");
 	}
+	cacheWrite(data, nG);
+}
+
+//--------- Persistent kernel cache ---------
+
+std::vector<char> CoulombKernel::cacheKey() const
+{	const char magic[8] = { 'J','D','F','T','x','C','K','1' }; //identifies file format (bump on any change to the kernel calculation)
+	std::vector<double> dParams;
+	for(int j=0; j<3; j++) for(int k=0; k<3; k++) dParams.push_back(R(j,k));
+	dParams.push_back(omega);
+	dParams.push_back(nSigmasPerWidth);
+	int32_t iParams[6];
+	for(int k=0; k<3; k++) { iParams[k] = S[k]; iParams[3+k] = isTruncated[k]; }
+	convertToLE(dParams.data(), sizeof(double), dParams.size());
+	convertToLE(iParams, sizeof(int32_t), 6);
+	std::vector<char> key(magic, magic+sizeof(magic));
+	key.insert(key.end(), (const char*)dParams.data(), (const char*)(dParams.data()+dParams.size()));
+	key.insert(key.end(), (const char*)iParams, (const char*)(iParams+6));
+	return key;
+}
+
+string CoulombKernel::cacheFilename(const std::vector<char>& key) const
+{	uint64_t hash = 0xcbf29ce484222325ULL; //64-bit FNV-1a
+	for(char c: key) { hash ^= (unsigned char)c; hash *= 0x100000001b3ULL; }
+	char hashStr[17]; sprintf(hashStr, "%016llx", (unsigned long long)hash);
+	return cacheDir + "/CoulombKernel." + hashStr;
+}
+
+bool CoulombKernel::cacheRead(double* data, size_t nG) const
+{	if(!cacheDir.length()) return false;
+	std::vector<char> key = cacheKey();
+	string fname = cacheFilename(key);
+	bool found = false;
+	if(mpiWorld->isHead())
+	{	FILE* fp = fopen(fname.c_str(), "rb");
+		if(fp)
+		{	std::vector<char> keyIn(key.size());
+			found = (fread(keyIn.data(), 1, keyIn.size(), fp) == keyIn.size())
+				&& (keyIn == key) //guards against hash collisions
+				&& (fread(data, sizeof(double), nG, fp) == nG);
+			fclose(fp);
+		}
+	}
+	mpiWorld->bcast(found);
+	if(!found) return false;
+	if(mpiWorld->isHead()) convertFromLE(data, sizeof(double), nG);
+	mpiWorld->bcast(data, nG);
+	logPrintf("Read truncated coulomb kernel from cache file '%s'.\n", fname.c_str());
+	return true;
+}
+
+void CoulombKernel::cacheWrite(const double* data, size_t nG) const
+{	if(!cacheDir.length() || !mpiWorld->isHead()) return;
+	std::vector<char> key = cacheKey();
+	string fname = cacheFilename(key);
+	ostringstream oss; oss << fname << ".tmp" << getpid();
+	string fnameTmp = oss.str(); //renamed when complete, so that concurrent jobs never see a partial file
+	FILE* fp = fopen(fnameTmp.c_str(), "wb");
+	if(!fp)
+	{	logPrintf("WARNING: could not open '%s' to cache the truncated coulomb kernel.\n", fnameTmp.c_str());
+		return;
+	}
+	bool success = (fwrite(key.data(), 1, key.size(), fp) == key.size());
+	const size_t blockSize = size_t(1) << 16; //convert in blocks to avoid a full copy
+	std::vector<double> buf(blockSize);
+	for(size_t offs=0; offs<nG && success; offs+=blockSize)
+	{	size_t n = std::min(blockSize, nG-offs);
+		std::copy(data+offs, data+offs+n, buf.begin());
+		convertToLE(buf.data(), sizeof(double), n);
+		success = (fwrite(buf.data(), sizeof(double), n, fp) == n);
+	}
+	if(fclose(fp)) success = false;
+	if(success && !rename(fnameTmp.c_str(), fname.c_str()))
+		logPrintf("Wrote truncated coulomb kernel to cache file '%s'.\n", fname.c_str());
+	else
+	{	unlink(fnameTmp.c_str());
+		logPrintf("WARNING: failed to write truncated coulomb kernel cache file '%s'.\n", fname.c_str());
+	}
 }
 
 //! Compute erfc(omega r)/r - erfc(a r)/r
@@ -58,7 +140,7 @@ namespace CoulombKernelIsolated
 {
 	//Initialize the long range part of the kernel in real space with the minimum image convention:
 	inline void realSpace_thread(size_t iStart, size_t iStop, vector3<int> Sdense, matrix3<> R,
-		double* data, const WignerSeitz* ws, double sigma, double omega)
+		double* data, const WignerSeitz::MeshRestriction* wsMesh, double sigma, double omega)
 	{
 		vector3<> invSdense; for(int k=0; k<3; k++) invSdense[k] = 1./Sdense[k];
 		double dV = fabs(det(R)) * (invSdense[0]*invSdense[1]*invSdense[2]); //integration factor
@@ -67,8 +149,9 @@ namespace CoulombKernelIsolated
 		vector3<int> S = Sdense; S[2] = 2*(Sdense[2]/2+1); //padding for in-place r2c transform
 		THREAD_rLoop
 		(	if(iv[2]<Sdense[2]) 
-			{	vector3<> x; for(int k=0; k<3; k++) x[k] = invSdense[k] * iv[k]; //lattice coordinates
-				double r = sqrt(RTR.metric_length_squared(ws->restrict(x))); //minimum image distance
+			{	vector3<int> ivWS = (*wsMesh)(iv); //minimum image on the dense mesh
+				vector3<> x; for(int k=0; k<3; k++) x[k] = invSdense[k] * ivWS[k]; //lattice coordinates
+				double r = sqrt(RTR.metric_length_squared(x)); //minimum image distance
 				data[i] = dV * screenedPotential(r, a, omega);
 			}
 			else data[i] = 0.; //padded points
@@ -125,7 +208,8 @@ void CoulombKernel::computeIsolated(double* data, const WignerSeitz& ws) const
 	
 	//Long-range part in real space
 	logPrintf("Computing truncated long-range part in real space ... "); logFlush();
-	threadLaunch(CoulombKernelIsolated::realSpace_thread, 2*nGdense, Sdense, R, denseRealArr, &ws, sigma, omega);
+	WignerSeitz::MeshRestriction wsMesh(ws, Sdense);
+	threadLaunch(CoulombKernelIsolated::realSpace_thread, 2*nGdense, Sdense, R, denseRealArr, &wsMesh, sigma, omega);
 	logPrintf("Done.\n");
 	
 	//Add short-ranged part in reciprocal space (and down-sample if required):
@@ -152,6 +236,7 @@ struct CoulombKernelWire
 	matrix3<> R; vector3<int> S, Sdense; //lattice vector and sample counts
 	int iDir, jDir, kDir; //iDir is the untruncated direction
 	const WignerSeitz *ws; //Wigner-Seitz cell
+	const double* rho; //minimum image distances in 2D of the dense planar mesh points (shared by all planes)
 	double sigma, omega;
 	
 	void computePlane(int iPlane)
@@ -165,23 +250,17 @@ struct CoulombKernelWire
 		int jPitchDense = 2*(1+Sdense[kDir]/2);
 		double invSjDense = 1./Sdense[jDir], invSkDense = 1./Sdense[kDir];
 		double dA = fabs(det(R)) * (invSjDense*invSkDense) / L; //2D integration factor
-		matrix3<> RTR = (~R)*R;
-		Cbar_k_sigma cbar_k_sigma(kCur, sigma, rhoMax), *cbar_k_screen=0; //Look-up table for convolved cylindrical potential
-		if(omega) cbar_k_screen = new Cbar_k_sigma(kCur, sqrt(0.5)/omega, rhoMax); //Look-up table for screened cylindrical potential
+		std::shared_ptr<const Cbar_k_sigma> cbar_k_sigma = Cbar_k_sigma::get(kCur, sigma, rhoMax), cbar_k_screen; //Look-up table for convolved cylindrical potential
+		if(omega) cbar_k_screen = Cbar_k_sigma::get(kCur, sqrt(0.5)/omega, rhoMax); //Look-up table for screened cylindrical potential
 		complex* denseArr = dense.data();
 		double* denseRealArr = (double*)denseArr; //in-place transform
 		for(int ij=0; ij<Sdense[jDir]; ij++)
 			for(int ik=0; ik<Sdense[kDir]; ik++)
-			{	vector3<> x; //point in lattice coordinates
-				x[iDir] = 0.;
-				x[jDir] = invSjDense * ij;
-				x[kDir] = invSkDense * ik;
-				double rho = sqrt(RTR.metric_length_squared(ws->restrict(x))); //minimum image distance in 2D
+			{	double rhoCur = rho[ik + Sdense[kDir] * ij];
 				int iDense = ik + jPitchDense * ij; //index into dense array (in the fftw in-place r2c layout)
-				denseRealArr[iDense] = dA * (cbar_k_sigma.value(rho) - (omega ? cbar_k_screen->value(rho) : 0.));
+				denseRealArr[iDense] = dA * (cbar_k_sigma->value(rhoCur) - (omega ? cbar_k_screen->value(rhoCur) : 0.));
 			}
 		fftw_execute_dft_r2c(fftPlanR2C, denseRealArr, (fftw_complex*)denseArr);
-		if(omega) delete cbar_k_screen;
 		
 		//Add analytic short-ranged parts in fourier space (and down-sample to final resolution):
 		jPitchDense = 1+Sdense[kDir]/2;
@@ -269,6 +348,18 @@ void CoulombKernel::computeWire(double* data, const WignerSeitz& ws) const
 	fftPlanR2C = fftw_plan_dft_r2c_2d(Sdense[jDir], Sdense[kDir], (double*)temp.data(), (fftw_complex*)temp.data(), FFTW_ESTIMATE);
 	logPrintf("Done.\n");
 	
+	//Minimum image distances in the plane perpendicular to axis (same for all planes):
+	std::vector<double> rho(Sdense[jDir] * size_t(Sdense[kDir]));
+	{	matrix3<> RTR = (~R)*R;
+		for(int ij=0; ij<Sdense[jDir]; ij++)
+			for(int ik=0; ik<Sdense[kDir]; ik++)
+			{	vector3<> x; //point in lattice coordinates
+				x[jDir] = ij * (1./Sdense[jDir]);
+				x[kDir] = ik * (1./Sdense[kDir]);
+				rho[ik + Sdense[kDir] * ij] = sqrt(RTR.metric_length_squared(ws.restrict(x)));
+			}
+	}
+	
 	//Launch threads for initializing each plane perpendicular to axis:
 	logPrintf("Computing truncated coulomb kernel ... "); logFlush();
 	std::vector<CoulombKernelWire> ckwArr(nProcsAvailable);
@@ -279,7 +370,7 @@ void CoulombKernel::computeWire(double* data, const WignerSeitz& ws) const
 		//Copy geometry definitions:
 		c.R = R; c.S = S; c.Sdense = Sdense;
 		c.iDir = iDir; c.jDir = jDir; c.kDir = kDir;
-		c.ws = &ws; c.sigma = sigma; c.omega = omega;
+		c.ws = &ws; c.rho = rho.data(); c.sigma = sigma; c.omega = omega;
 	}
 	std::mutex mJobCount; int nPlanesDone = 0; //for job management
 	threadLaunch(CoulombKernelWire::thread, 0, ckwArr.data(), 1+S[iDir]/2, &nPlanesDone, &mJobCount);
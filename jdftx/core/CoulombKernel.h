@@ -34,14 +34,17 @@ struct CoulombKernel
 	const vector3<int> S; //!< sample count
 	const vector3<bool> isTruncated; //!< whether corresponding lattice direction is truncated
 	double omega; //!< erf-screening parameter (used for screened exchange kernels)
+	const string cacheDir; //!< directory of the persistent kernel cache (none if empty)
 	
-	CoulombKernel(const matrix3<> R, const vector3<int> S, const vector3<bool> isTruncated, double omega=0.);
+	CoulombKernel(const matrix3<> R, const vector3<int> S, const vector3<bool> isTruncated, double omega=0., const string& cacheDir=string());
 	
 	//! Initialize the truncated kernel in data
 	//! data must be allocated for S[0]*S[1]*(1+S[2]/2) entries (fftw c2r order).
 	//! ws is the Wigner-Seitz cell corresponding to lattice vectors R.
 	//!      Supported modes include fully truncated (Isolated or Wigner-Seitz
 	//! truncated exchange kernel) and one direction periodic (Wire geometry).
+	//! If cacheDir is set, the kernel is read from a file named by a hash of (R, S, isTruncated, omega)
+	//! when available, and written there after computing it otherwise.
 	void compute(double* data, const WignerSeitz& ws) const;
 	
 	static const double nSigmasPerWidth; //!< number of sigmas at which gaussian is negligible at working precision
@@ -50,6 +53,12 @@ private:
 	//Various indiviudally optimized cases of computeKernel:
 	void computeIsolated(double* data, const WignerSeitz& ws) const; //!< Fully truncated
 	void computeWire(double* data, const WignerSeitz& ws) const; //!< 1 periodic direction
+	
+	//Persistent cache:
+	std::vector<char> cacheKey() const; //!< little-endian serialization of all parameters that determine the kernel
+	string cacheFilename(const std::vector<char>& key) const; //!< filename in cacheDir (content-addressed by key)
+	bool cacheRead(double* data, size_t nG) const; //!< read kernel from cache (collective; returns false if unavailable)
+	void cacheWrite(const double* data, size_t nG) const; //!< write kernel to cache (from head)
 };
 
 //! @}
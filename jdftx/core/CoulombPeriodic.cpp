@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Coulomb_internal.h>
 #include <core/CoulombKernel.h>
 #include <core/BlasExtra.h>
+#include <core/Thread.h>
 
 //! Standard 3D Ewald sum
 class EwaldPeriodic : public Ewald
@@ -29,6 +30,31 @@ class EwaldPeriodic : public Ewald
 	double sigma; //!< gaussian width for Ewald sums
 	vector3<int> Nreal; //!< max unit cell indices for real-space sum
 	vector3<int> Nrecip; //!< max unit cell indices for reciprocal-space sum
+	std::vector<vector3<int>> iGarr; //!< reciprocal lattice vectors within the Ewald cutoff (one of each +/- pair)
+
+	//Structure factor SG and energy of the pair of reciprocal lattice vectors +/- iGarr[j], which are also returned along with the kernel eG
+	static double recipEnergy_calc(size_t j, const std::vector<vector3<int>>* iGarr, const std::vector<Atom>* atoms,
+		matrix3<> GGT, double sigmaSq, double prefac, complex* SG, double* eG)
+	{	const vector3<int>& iG = iGarr->at(j);
+		double Gsq = GGT.metric_length_squared(iG);
+		complex S = 0.;
+		for(const Atom& a: *atoms)
+			S += a.Z * cis(-2*M_PI*dot(iG,a.pos));
+		SG[j] = S;
+		eG[j] = prefac * exp(-0.5*sigmaSq*Gsq)/Gsq;
+		return eG[j] * S.norm(); //= 0.5 * eG * |SG|^2, summed over +/- iG
+	}
+	
+	//Reciprocal-space force on atom i (using structure factors computed by recipEnergy_calc)
+	static void recipForce_calc(size_t i, const std::vector<vector3<int>>* iGarr, const complex* SG, const double* eG, std::vector<Atom>* atoms)
+	{	Atom& a = atoms->at(i);
+		vector3<> force(0.,0.,0.);
+		for(size_t j=0; j<iGarr->size(); j++)
+		{	const vector3<int>& iG = iGarr->at(j);
+			force -= (2. * eG[j] * a.Z * 2*M_PI * (SG[j].conj() * cis(-2*M_PI*dot(iG,a.pos))).imag()) * iG; //factor of 2 from +/- iG
+		}
+		a.force += force;
+	}
 
 public:
 	EwaldPeriodic(const matrix3<>& R, int nAtoms)
@@ -55,10 +81,19 @@ public:
 		Nreal.print(globalLog, " %d ");
 		logPrintf("Reciprocal space sum over %d terms with max indices ", (2*Nrecip[0]+1)*(2*Nrecip[1]+1)*(2*Nrecip[2]+1));
 		Nrecip.print(globalLog, " %d ");
+		
+		//List reciprocal lattice vectors within Gmax (in half of G-space, excluding G=0):
+		double GsqMax = std::pow(CoulombKernel::nSigmasPerWidth/sigma, 2);
+		vector3<int> iG; //integer reciprocal cell number
+		for(iG[0]=0; iG[0]<=Nrecip[0]; iG[0]++)
+			for(iG[1]=(iG[0] ? -Nrecip[1] : 0); iG[1]<=Nrecip[1]; iG[1]++)
+				for(iG[2]=(iG[0]||iG[1] ? -Nrecip[2] : 1); iG[2]<=Nrecip[2]; iG[2]++)
+					if(GGT.metric_length_squared(iG) <= GsqMax)
+						iGarr.push_back(iG);
 	}
 
 	double energyAndGrad(std::vector<Atom>& atoms) const
-	{	double eta = sqrt(0.5)/sigma, etaSq=eta*eta;
+	{	double eta = sqrt(0.5)/sigma;
 		double sigmaSq = sigma * sigma;
 		double detR = fabs(det(R)); //cell volume
 		//Position independent terms:
@@ -75,38 +110,13 @@ public:
 			for(int k=0; k<3; k++)
 				a.pos[k] -= floor(0.5 + a.pos[k]);
 		//Real space sum:
-		vector3<int> iR; //integer cell number
-		for(const Atom& a2: atoms)
-			for(Atom& a1: atoms)
-				for(iR[0]=-Nreal[0]; iR[0]<=Nreal[0]; iR[0]++)
-					for(iR[1]=-Nreal[1]; iR[1]<=Nreal[1]; iR[1]++)
-						for(iR[2]=-Nreal[2]; iR[2]<=Nreal[2]; iR[2]++)
-						{	vector3<> x = iR + (a1.pos - a2.pos);
-							double rSq = RTR.metric_length_squared(x);
-							if(!rSq) continue; //exclude self-interaction
-							double r = sqrt(rSq);
-							E += 0.5 * a1.Z * a2.Z * erfc(eta*r)/r;
-							a1.force += (RTR * x) *
-								(a1.Z * a2.Z * (erfc(eta*r)/r + (2./sqrt(M_PI))*eta*exp(-etaSq*rSq))/rSq);
-						}
-		//Reciprocal space sum:
-		vector3<int> iG; //integer reciprocal cell number
-		for(iG[0]=-Nrecip[0]; iG[0]<=Nrecip[0]; iG[0]++)
-			for(iG[1]=-Nrecip[1]; iG[1]<=Nrecip[1]; iG[1]++)
-				for(iG[2]=-Nrecip[2]; iG[2]<=Nrecip[2]; iG[2]++)
-				{	double Gsq = GGT.metric_length_squared(iG);
-					if(!Gsq) continue; //skip G=0
-					//Compute structure factor:
-					complex SG = 0.;
-					for(const Atom& a: atoms)
-						SG += a.Z * cis(-2*M_PI*dot(iG,a.pos));
-					//Accumulate energy:
-					double eG = 4*M_PI * exp(-0.5*sigmaSq*Gsq)/(Gsq * detR);
-					E += 0.5 * eG * SG.norm();
-					//Accumulate forces:
-					for(Atom& a: atoms)
-						a.force -= (eG * a.Z * 2*M_PI * (SG.conj() * cis(-2*M_PI*dot(iG,a.pos))).imag()) * iG;
-				}
+		E += ewaldRealSpace(R, Nreal, sigma, atoms);
+		//Reciprocal space sum (over half of G-space, with the other half accounted for by inversion symmetry):
+		static StopWatch watchRecip("EwaldPeriodic::recip"); watchRecip.start();
+		std::vector<complex> SG(iGarr.size()); std::vector<double> eG(iGarr.size());
+		E += threadedAccumulate(recipEnergy_calc, iGarr.size(), &iGarr, &atoms, GGT, sigmaSq, 4*M_PI/detR, SG.data(), eG.data());
+		threadedLoop(recipForce_calc, atoms.size(), &iGarr, SG.data(), eG.data(), &atoms);
+		watchRecip.stop();
 		return E;
 	}
 };
@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Coulomb_internal.h>
 #include <core/CoulombKernel.h>
 #include <core/BlasExtra.h>
+#include <core/Thread.h>
 
 //! 2D Ewald sum
 class EwaldSlab : public Ewald
@@ -32,6 +33,73 @@ class EwaldSlab : public Ewald
 	vector3<int> Nreal; //!< max unit cell indices for real-space sum
 	vector3<int> Nrecip; //!< max unit cell indices for reciprocal-space sum
 
+	//Reciprocal space sum over pairs of atoms in [pStart,pStop) indexed in the order (0,0), (1,0), (1,1), (2,0) ...
+	//Accumulates energy and forces locally, and then into E and atoms (protected by lock)
+	static void recipSum_thread(size_t pStart, size_t pStop, const EwaldSlab* ewald, std::vector<Atom>* atoms, double* E, std::mutex* lock)
+	{	const EwaldSlab& ew = *ewald;
+		const int iDir = ew.iDir;
+		const vector3<int>& Nrecip = ew.Nrecip;
+		double eta = sqrt(0.5)/ew.sigma, etaSq=eta*eta, etaSqrtPiInv = 1./(eta*sqrt(M_PI));
+		double sigmaSq = ew.sigma * ew.sigma;
+		double L = sqrt(ew.RTR(iDir,iDir)); //length of truncated direction
+		double volPrefac = M_PI * L / fabs(det(ew.R));
+		double Elocal = 0.;
+		std::vector<vector3<>> forces(atoms->size(), vector3<>(0.,0.,0.));
+		//Initial pair (i1 >= i2) corresponding to pStart:
+		size_t i1 = size_t(floor(0.5*(sqrt(8.*pStart+1.)-1.)));
+		while(i1*(i1+1)/2 > pStart) i1--; //guard against roundoff
+		while((i1+1)*(i1+2)/2 <= pStart) i1++;
+		size_t i2 = pStart - i1*(i1+1)/2;
+		for(size_t p=pStart; p<pStop; p++)
+		{	const Atom& a1 = atoms->at(i1);
+			const Atom& a2 = atoms->at(i2);
+			double prefac = volPrefac * a1.Z * a2.Z * (i1==i2 ? 1 : 2);
+			vector3<> r12 = a1.pos - a2.pos;
+			double z12 = L * r12[iDir];
+			double E12 = 0.; vector3<> E12_r12(0.,0.,0.); //energy and gradient from this pair
+			vector3<int> iG; //integer reciprocal cell number (iG[iDir] will remain 0)
+			for(iG[0]=-Nrecip[0]; iG[0]<=Nrecip[0]; iG[0]++)
+				for(iG[1]=-Nrecip[1]; iG[1]<=Nrecip[1]; iG[1]++)
+					for(iG[2]=-Nrecip[2]; iG[2]<=Nrecip[2]; iG[2]++)
+					{	//2D structure factor term and derivative
+						double c, s; sincos((2*M_PI)*dot(iG,r12), &s, &c);
+						//Contribution from truncated direction:
+						double Gsq = ew.GGT.metric_length_squared(iG);
+						double zTerm, zTermPrime;
+						if(Gsq)
+						{	double G = sqrt(Gsq);
+							if(fabs(G*z12) > 100.) continue; //negligible contribution
+							double expPlus = exp(G*z12), expMinus = 1./expPlus;
+							double erfcPlus  = erfc(eta*(sigmaSq*G + z12));
+							double erfcMinus = erfc(eta*(sigmaSq*G - z12));
+							zTerm = (0.5/G) * (expPlus * erfcPlus + expMinus * erfcMinus);
+							zTermPrime = 0.5 * (expPlus * erfcPlus - expMinus * erfcMinus);
+						}
+						else
+						{	double erfz = erf(eta * z12);
+							double gauss = exp(-etaSq * z12*z12);
+							zTerm = -z12 * erfz - etaSqrtPiInv * gauss;
+							zTermPrime = -erfz;
+						}
+						//Update energy and forces:
+						E12 += prefac * c * zTerm;
+						E12_r12 += (prefac * -s * zTerm * (2*M_PI)) * iG;
+						E12_r12[iDir] += prefac * c * zTermPrime * L;
+					}
+			Elocal += E12;
+			forces[i1] -= E12_r12;
+			forces[i2] += E12_r12;
+			//Advance to next pair:
+			if(++i2 > i1) { i1++; i2 = 0; }
+		}
+		//Accumulate results:
+		lock->lock();
+		*E += Elocal;
+		for(size_t i=0; i<atoms->size(); i++)
+			atoms->at(i).force += forces[i];
+		lock->unlock();
+	}
+	
 public:
 	EwaldSlab(const matrix3<>& R, int iDir, double ionMargin) : R(R), G((2*M_PI)*inv(R)), RTR((~R)*R), GGT(G*(~G)), iDir(iDir), ionMargin(ionMargin)
 	{	logPrintf("\n---------- Setting up 2D ewald sum ----------\n");
@@ -61,8 +129,7 @@ public:
 	
 	double energyAndGrad(std::vector<Atom>& atoms) const
 	{	if(!atoms.size()) return 0.;
-		double eta = sqrt(0.5)/sigma, etaSq=eta*eta, etaSqrtPiInv = 1./(eta*sqrt(M_PI));
-		double sigmaSq = sigma * sigma;
+		double eta = sqrt(0.5)/sigma;
 		//Position independent terms: (Self-energy correction)
 		double ZsqTot = 0.;
 		for(const Atom& a: atoms)
@@ -78,67 +145,19 @@ public:
 			for(int k=0; k<3; k++)
 				a.pos[k] -= floor(0.5 + a.pos[k] - pos0[k]);
 		//Real space sum:
-		vector3<int> iR; //integer cell number
-		for(const Atom& a2: atoms)
-			for(Atom& a1: atoms)
-				for(iR[0]=-Nreal[0]; iR[0]<=Nreal[0]; iR[0]++)
-					for(iR[1]=-Nreal[1]; iR[1]<=Nreal[1]; iR[1]++)
-						for(iR[2]=-Nreal[2]; iR[2]<=Nreal[2]; iR[2]++)
-						{	vector3<> x = iR + (a1.pos - a2.pos);
-							double rSq = RTR.metric_length_squared(x);
-							if(!rSq) continue; //exclude self-interaction
-							double r = sqrt(rSq);
-							E += 0.5 * a1.Z * a2.Z * erfc(eta*r)/r;
-							a1.force += (RTR * x) *
-								(a1.Z * a2.Z * (erfc(eta*r)/r + (2./sqrt(M_PI))*eta*exp(-etaSq*rSq))/rSq);
-						}
-		//Reciprocal space sum:
+		E += ewaldRealSpace(R, Nreal, sigma, atoms);
+		//Check ion margins (before the threaded reciprocal space sum below):
 		double L = sqrt(RTR(iDir,iDir)); //length of truncated direction
-		double volPrefac = M_PI * L / fabs(det(R));
 		for(unsigned i1=0; i1<atoms.size(); i1++)
-		{	Atom& a1 = atoms[i1];
 			for(unsigned i2=0; i2<=i1; i2++)
-			{	Atom& a2 = atoms[i2];
-				double prefac = volPrefac * a1.Z * a2.Z * (i1==i2 ? 1 : 2);
-				vector3<> r12 = a1.pos - a2.pos;
-				double z12 = L * r12[iDir];
-				if(fabs(z12) >= 0.5*L-ionMargin)
+				if(fabs(L * (atoms[i1].pos[iDir] - atoms[i2].pos[iDir])) >= 0.5*L-ionMargin)
 					die("Separation between atoms %d and %d lies within the margin of %lg bohrs from the Wigner-Seitz boundary.\n" ionMarginMessage, i1+1, i2+1, ionMargin);
-				double E12 = 0.; vector3<> E12_r12(0.,0.,0.); //energy and gradient from this pair
-				vector3<int> iG; //integer reciprocal cell number (iG[iDir] will remain 0)
-				for(iG[0]=-Nrecip[0]; iG[0]<=Nrecip[0]; iG[0]++)
-					for(iG[1]=-Nrecip[1]; iG[1]<=Nrecip[1]; iG[1]++)
-						for(iG[2]=-Nrecip[2]; iG[2]<=Nrecip[2]; iG[2]++)
-						{	//2D structure factor term and derivative
-							double c, s; sincos((2*M_PI)*dot(iG,r12), &s, &c);
-							//Contribution from truncated direction:
-							double Gsq = GGT.metric_length_squared(iG);
-							double zTerm, zTermPrime;
-							if(Gsq)
-							{	double G = sqrt(Gsq);
-								if(fabs(G*z12) > 100.) continue; //negligible contribution
-								double expPlus = exp(G*z12), expMinus = 1./expPlus;
-								double erfcPlus  = erfc(eta*(sigmaSq*G + z12));
-								double erfcMinus = erfc(eta*(sigmaSq*G - z12));
-								zTerm = (0.5/G) * (expPlus * erfcPlus + expMinus * erfcMinus);
-								zTermPrime = 0.5 * (expPlus * erfcPlus - expMinus * erfcMinus);
-							}
-							else
-							{	double erfz = erf(eta * z12);
-								double gauss = exp(-etaSq * z12*z12);
-								zTerm = -z12 * erfz - etaSqrtPiInv * gauss;
-								zTermPrime = -erfz;
-							}
-							//Update energy and forces:
-							E12 += prefac * c * zTerm;
-							E12_r12 += (prefac * -s * zTerm * (2*M_PI)) * iG;
-							E12_r12[iDir] += prefac * c * zTermPrime * L;
-						}
-				E += E12;
-				a1.force -= E12_r12;
-				a2.force += E12_r12;
-			}
-		}
+		//Reciprocal space sum (threaded over pairs of atoms):
+		static StopWatch watchRecip("EwaldSlab::recip"); watchRecip.start();
+		size_t nPairs = atoms.size()*(atoms.size()+1)/2;
+		std::mutex lock;
+		threadLaunch(recipSum_thread, nPairs, this, &atoms, &E, &lock);
+		watchRecip.stop();
 		return E;
 	}
 };
@@ -25,6 +25,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Spline.h>
 #include <core/LoopMacros.h>
 #include <gsl/gsl_sf.h>
+#include <mutex>
+#include <list>
 
 //Check orthogonality and return lattice direction name
 string checkOrthogonality(const GridInfo& gInfo, int iDir)
@@ -97,6 +99,7 @@ double Cbar::integrandLargeRho(double t, void* params)
 //--------------- class Cbar_k_sigma ----------
 
 Cbar_k_sigma::Cbar_k_sigma(double k, double sigma, double rhoMax, double rho0)
+: k(k), sigma(sigma), rhoMax(rhoMax), rho0(rho0)
 {	assert(rhoMax > 0.);
 	//Pick grid and initialize sample values:
 	double drho = 0.03*sigma; //With 5th order splines, this guarantees rel error ~ 1e-14 typical, 1e-12 max
@@ -112,6 +115,35 @@ Cbar_k_sigma::Cbar_k_sigma(double k, double sigma, double rhoMax, double rho0)
 	coeff = QuinticSpline::getCoeff(x);
 }
 
+std::shared_ptr<const Cbar_k_sigma> Cbar_k_sigma::get(double k, double sigma, double rhoMax, double rho0)
+{	static std::mutex cacheLock;
+	static std::list<std::shared_ptr<const Cbar_k_sigma>> cache; //most recently used first
+	static size_t nCoeffCached = 0;
+	const size_t nCoeffCachedMax = size_t(1) << 24; //least recently used tables are dropped beyond this (128 MB)
+	const double relTol = 1e-12; //parameters that differ by roundoff (eg. k from unit cell and supercell lengths) share tables
+	auto matches = [&](const Cbar_k_sigma& c)
+	{	return fabs(c.k-k) <= relTol*std::max(1.,k) && fabs(c.sigma-sigma) <= relTol*sigma
+			&& c.rho0==rho0 && c.rhoMax>=rhoMax;
+	};
+	{	std::lock_guard<std::mutex> lock(cacheLock);
+		for(auto iter=cache.begin(); iter!=cache.end(); iter++)
+			if(matches(**iter))
+			{	cache.splice(cache.begin(), cache, iter); //move to front
+				return cache.front();
+			}
+	}
+	//Compute outside the lock (concurrent callers, such as the kernel plane threads, request different k):
+	std::shared_ptr<const Cbar_k_sigma> result = std::make_shared<Cbar_k_sigma>(k, sigma, rhoMax, rho0);
+	std::lock_guard<std::mutex> lock(cacheLock);
+	cache.push_front(result);
+	nCoeffCached += result->coeff.size();
+	while(nCoeffCached > nCoeffCachedMax && cache.size() > 1)
+	{	nCoeffCached -= cache.back()->coeff.size();
+		cache.pop_back();
+	}
+	return result;
+}
+
 
 //! 1D Ewald sum
 class EwaldWire : public Ewald
@@ -126,7 +158,7 @@ class EwaldWire : public Ewald
 	vector3<int> Nreal; //!< max unit cell indices for real-space sum
 	vector3<int> Nrecip; //!< max unit cell indices for reciprocal-space sum
 	
-	std::vector<std::shared_ptr<Cbar_k_sigma>> cbar_k_sigma;
+	std::vector<std::shared_ptr<const Cbar_k_sigma>> cbar_k_sigma;
 	
 public:
 	EwaldWire(const matrix3<>& R, int iDir, const WignerSeitz& ws, double ionMargin, double Rc=0., double rho0=1.)
@@ -157,7 +189,7 @@ public:
 		double rhoMax = ws.circumRadius(iDir);
 		for(iG[iDir]=0; iG[iDir]<=Nrecip[iDir]; iG[iDir]++)
 		{	double k = sqrt(GGT.metric_length_squared(iG));
-			cbar_k_sigma[iG[iDir]] = std::make_shared<Cbar_k_sigma>(k, sigma, rhoMax, rho0);
+			cbar_k_sigma[iG[iDir]] = Cbar_k_sigma::get(k, sigma, rhoMax, rho0);
 		}
 	}
 	
@@ -237,7 +269,7 @@ CoulombWire::CoulombWire(const GridInfo& gInfoOrig, const CoulombParams& params)
 {	//Check orthogonality
 	string dirName = checkOrthogonality(gInfo, params.iDir);
 	//Create kernel:
-	CoulombKernel(gInfo.R, gInfo.S, params.isTruncated()).compute(Vc.data(), ws);
+	CoulombKernel(gInfo.R, gInfo.S, params.isTruncated(), 0., params.kernelCacheDir).compute(Vc.data(), ws);
 	initExchangeEval();
 }
 
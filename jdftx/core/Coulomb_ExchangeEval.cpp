@@ -428,7 +428,7 @@ ExchangeEval::ExchangeEval(const GridInfo& gInfo, const CoulombParams& params, c
 				die("Exact-exchange in Isolated geometry should be used only with a single k-point.\n");
 			if(omega) //Create an omega-screened version (but gamma-point only):
 			{	VcGamma = new RealKernel(gInfo);
-				CoulombKernel(gInfo.R, gInfo.S, params.isTruncated(), omega).compute(VcGamma->data(), ((CoulombIsolated&)coulomb).ws);
+				CoulombKernel(gInfo.R, gInfo.S, params.isTruncated(), omega, params.kernelCacheDir).compute(VcGamma->data(), ((CoulombIsolated&)coulomb).ws);
 			}
 			else //use the same kernel as hartree/Vloc
 			{	VcGamma = &((CoulombIsolated&)coulomb).Vc; 
@@ -463,7 +463,7 @@ ExchangeEval::ExchangeEval(const GridInfo& gInfo, const CoulombParams& params, c
 			double* dataSuper = new double[nGsuper];
 			if(!dataSuper) die_alone("Out of memory. (need %.1lfGB for supercell exchange kernel)\n", nGsuper*1e-9*sizeof(double));
 			WignerSeitz wsSuper(Rsuper);
-			CoulombKernel(Rsuper, Ssuper, isTruncated, omega).compute(dataSuper, wsSuper);
+			CoulombKernel(Rsuper, Ssuper, isTruncated, omega, params.kernelCacheDir).compute(dataSuper, wsSuper);
 			dataSuper[0] += VzeroCorrection; //For slab/wire geometry kernels in AuxiliaryFunction/ProbeChargeEwald methods
 			
 			//Construct k-point difference mesh:
@@ -485,6 +485,34 @@ ExchangeEval::ExchangeEval(const GridInfo& gInfo, const CoulombParams& params, c
 			break;
 		}
 	}
+	
+	//Tabulate analytic kernels for each k-point difference, if they fit in the memory budget
+	//(so that each application is a single multiply instead of re-evaluating the kernel, including spline interpolation in slab mode):
+	if(kernelMode==PeriodicKernel || kernelMode==SphericalKernel || kernelMode==SlabKernel)
+	{	std::vector< vector3<> > dkList;
+		for(const vector3<>& kpoint: kmesh)
+		{	vector3<> dk = kpoint - kmesh.front();
+			for(int k=0; k<3; k++) dk[k] -= floor(dk[k] + 0.5); //reduce to fundamental zone
+			dkList.push_back(dk);
+		}
+		size_t nKernelData = dkList.size() * gInfo.nr;
+		if(nKernelData*sizeof(double) <= maxAnalyticTableBytes)
+		{	logPrintf("Tabulating exchange kernel for %lu k-point differences (%.1lf MB) ... ", dkList.size(), nKernelData*sizeof(double)/1048576.); logFlush();
+			kernelData.init(nKernelData);
+			double* kernel = kernelData.data();
+			for(const vector3<>& dk: dkList)
+			{	complexScalarFieldTilde ones = complexScalarFieldTildeData::alloc(gInfo);
+				complex* onesData = ones->data();
+				for(int i=0; i<gInfo.nr; i++) onesData[i] = 1.;
+				ones = (*this)((complexScalarFieldTilde&&)ones, dk); //evaluates analytically (kernelData not yet complete)
+				onesData = ones->data();
+				for(int i=0; i<gInfo.nr; i++) kernel[i] = onesData[i].real();
+				kernel += gInfo.nr;
+			}
+			dkArr = dkList; //enables table lookup in operator()
+			logPrintf("Done.\n");
+		}
+	}
 }
 
 ExchangeEval::~ExchangeEval()
@@ -503,8 +531,23 @@ void multTransformedKernel(complexScalarFieldTilde& X, const double* kernel, con
 }
 
 
+bool ExchangeEval::multTabulated(complexScalarFieldTilde& in, const vector3<>& kDiff) const
+{	for(unsigned ik=0; ik<dkArr.size(); ik++)
+		if(circDistanceSquared(dkArr[ik], kDiff) < symmThresholdSq)
+		{	//Find the integer offset, if any:
+			double err;
+			vector3<int> offset = round(dkArr[ik] - kDiff, &err);
+			assert(err < symmThreshold);
+			//Multiply kernel:
+			multTransformedKernel(in, kernelData.dataPref() + gInfo.nr * ik, offset);
+			return true;
+		}
+	return false;
+}
+
 complexScalarFieldTilde ExchangeEval::operator()(complexScalarFieldTilde&& in, vector3<> kDiff) const
-{
+{	if(kernelMode!=NumericalKernel && dkArr.size() && multTabulated(in, kDiff))
+		return in; //tabulated analytic kernel
 	#define CALL_exchangeAnalytic(calc) callPref(exchangeAnalytic)(gInfo.S, gInfo.GGT, calc, in->dataPref(false), kDiff, Vzero, symmThresholdSq)
 	switch(kernelMode)
 	{	case PeriodicKernel:
@@ -527,19 +570,7 @@ complexScalarFieldTilde ExchangeEval::operator()(complexScalarFieldTilde&& in, v
 			break;
 		}
 		case NumericalKernel:
-		{	//Find the appropriate kDiff:
-			bool kDiffFound = false;
-			for(unsigned ik=0; ik<dkArr.size(); ik++)
-				if(circDistanceSquared(dkArr[ik], kDiff) < symmThresholdSq)
-				{	//Find the integer offset, if any:
-					double err;
-					vector3<int> offset = round(dkArr[ik] - kDiff, &err);
-					assert(err < symmThreshold);
-					//Multiply kernel:
-					multTransformedKernel(in, kernelData.dataPref() + gInfo.nr * ik, offset);
-					kDiffFound = true;
-					break;
-				}
+		{	bool kDiffFound = multTabulated(in, kDiff);
 			assert(kDiffFound);
 			break;
 		}
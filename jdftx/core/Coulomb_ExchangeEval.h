@@ -57,9 +57,11 @@ private:
 	ManagedArray<double> slabCoeff;
 	//For Wigner-Seitz Gamma-only truncated mode:
 	RealKernel* VcGamma; //Gamma-point-only kernel (used for Isolated geometry (with no need for regularization))
-	//For precomputed numerical kernel mode:
+	//For precomputed numerical kernel mode (and analytic modes, when their tables fit in maxAnalyticTableBytes):
 	std::vector< vector3<> > dkArr; //list of allowed k-point differences (modulo integer offsets)
 	ManagedArray<double> kernelData; //data for all the kernels
+	static const size_t maxAnalyticTableBytes = size_t(1)<<30; //memory budget for tabulating analytic kernels
+	bool multTabulated(complexScalarFieldTilde& in, const vector3<>& kDiff) const; //multiply by tabulated kernel for kDiff, if found
 };
 
 //! @}
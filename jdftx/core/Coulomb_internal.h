@@ -28,6 +28,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/matrix3.h>
 #include <core/Spline.h>
 #include <gsl/gsl_integration.h>
+#include <vector>
+#include <memory>
 
 //Common citation for Coulomb truncation
 #define wsTruncationPaper "R. Sundararaman and T.A. Arias, Phys. Rev. B 87, 165122 (2013)"
@@ -74,6 +76,13 @@ void coulombAnalytic(vector3<int> S, const matrix3<>& GGT, const CoulombPeriodic
 void coulombAnalytic(vector3<int> S, const matrix3<>& GGT, const CoulombSlab_calc& calc, complex* data);
 void coulombAnalytic(vector3<int> S, const matrix3<>& GGT, const CoulombSpherical_calc& calc, complex* data);
 
+//! Real-space part of the Ewald sums for erfc-screened point charges with gaussian width sigma, shared by the Ewald implementations.
+//! Includes all images (along directions with Nreal[k] non-zero) within the Ewald cutoff CoulombKernel::nSigmasPerWidth*sigma,
+//! scanning only the image cells that overlap the cutoff sphere of each pair, with the atoms divided over threads.
+//! Accumulates the forces in atoms and returns the energy; positions must already be reduced to the fundamental zone.
+struct Atom;
+double ewaldRealSpace(const matrix3<>& R, const vector3<int>& Nreal, double sigma, std::vector<Atom>& atoms);
+
 //! Compute erf(x)/x (with x~0 handled properly)
 __hostanddev__ double erf_by_x(double x)
 {	double xSq = x*x;
@@ -111,7 +120,11 @@ struct Cbar_k_sigma
 	{	double fp = QuinticSpline::deriv(coeff.data(), drhoInv * rho) * drhoInv;
 		return isLog ? fp * value(rho) : fp;
 	}
+	//! Shared look-up table for (k, sigma, rho0) covering at least [0,rhoMax] (thread-safe): kernels with coinciding
+	//! parameters (such as wire Hartree and exchange kernels, or repeated kernel setups) evaluate the integrals only once
+	static std::shared_ptr<const Cbar_k_sigma> get(double k, double sigma, double rhoMax, double rho0=1.);
 private:
+	double k, sigma, rhoMax, rho0; //parameters (to match cached tables)
 	double drhoInv; bool isLog;
 	std::vector<double> coeff;
 };
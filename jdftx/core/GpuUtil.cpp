@@ -28,6 +28,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 cudaDeviceProp cudaDevProps; //cached properties of currently running device
 cublasHandle_t cublasHandle;
+cudaStream_t gpuStream;
+static bool gpuSyncCheck = false; //whether gpuErrorCheck() synchronizes (JDFTX_GPU_SYNC_CHECK)
 #ifdef CUSOLVER_ENABLED
 cusolverDnHandle_t cusolverHandle;
 #endif
@@ -74,14 +76,26 @@ bool gpuInit(FILE* fpLog, const MPIUtil* mpiHostGpu, double* nGPUs)
 		if(nGPUs) *nGPUs = std::min(1., compatibleDevices.size()*1./mpiHostGpu->nProcesses());
 	}
 	
+	//Each process drives exactly one GPU, so warn about devices that would otherwise idle silently:
+	int nProcessesOnHost = mpiHostGpu ? mpiHostGpu->nProcesses() : 1;
+	if(nProcessesOnHost < int(compatibleDevices.size()))
+		fprintf(fpLog, "gpuInit: WARNING: only %d of %d compatible devices on this node will be used;"
+			" run one process per GPU (with the states divided between processes) to use all of them.\n",
+			nProcessesOnHost, int(compatibleDevices.size()));
+	
 	//Print selected devices:
 	fprintf(fpLog, "gpuInit: Selected device %d\n", selectedDevice);
 	cudaSetDevice(selectedDevice);
 	cudaGetDeviceProperties(&cudaDevProps, selectedDevice);
+	cudaStreamCreate(&gpuStream);
 	cublasCreate(&cublasHandle);
+	cublasSetStream(cublasHandle, gpuStream);
 	#ifdef CUSOLVER_ENABLED
 	cusolverDnCreate(&cusolverHandle);
+	cusolverDnSetStream(cusolverHandle, gpuStream);
 	#endif
+	const char* syncCheck = getenv("JDFTX_GPU_SYNC_CHECK");
+	gpuSyncCheck = (syncCheck && string(syncCheck)=="yes");
 	return true;
 }
 
@@ -90,7 +104,7 @@ bool isGpuMine()
 }
 
 void gpuErrorCheck()
-{	//cudaThreadSynchronize(); //NOTE: Uncomment this when trying to debug GPU kernel launches
+{	if(gpuSyncCheck) cudaStreamSynchronize(gpuStream); //attribute asynchronous errors to the right launch
 	cudaError_t err = cudaGetLastError();
 	if(err != cudaSuccess)
 	{	fprintf(stderr, "CUDA Error: %s\n", cudaGetErrorString(err));
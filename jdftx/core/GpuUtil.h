@@ -34,6 +34,11 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 //! @file GpuUtil.h
 
 extern cublasHandle_t cublasHandle; //!< global handle to cublas (defined in GpuUtil.cpp)
+
+//! Stream on which all GPU work (kernels, cublas, cusolver and cufft) is ordered (defined in GpuUtil.cpp).
+//! It is a blocking stream, so synchronous copies on the legacy default stream still wait for preceding work,
+//! while a non-default stream allows the work to be captured into CUDA graphs and overlapped with other streams.
+extern cudaStream_t gpuStream;
 #ifdef CUSOLVER_ENABLED
 #include <cusolverDn.h>
 extern cusolverDnHandle_t cusolverHandle;  //!< global handle to cusolverDn (defined in GpuUtil.cpp)
@@ -42,6 +47,7 @@ extern cusolverDnHandle_t cusolverHandle;  //!< global handle to cusolverDn (def
 //! Must be called before any GPU use (preferably from main(), see #isGpuMine)
 //! If mpiHostGpu (group of GPU processes on the same node) is specified, divide compatible GPUs amongst processes on same node, else select one with max memory
 //! nGPUs returns the number of physical GPUs used (fraction if a GPU is shared with other processes)
+//! Each process drives a single GPU from a single thread (see isGpuMine); a warning is printed if the node has more compatible GPUs than processes
 //! Returns false on failure to find a suitable GPU
 bool gpuInit(FILE* fpLog=stdout, const class MPIUtil* mpiHostGpu=0, double* nGPUs=0);
 
@@ -49,7 +55,9 @@ bool gpuInit(FILE* fpLog=stdout, const class MPIUtil* mpiHostGpu=0, double* nGPU
 //! This function will return true only on the one thread that rules the gpu.
 bool isGpuMine();
 
-//! Check for gpu errors, and if any, abort with a useful messsage
+//! Check for gpu errors, and if any, abort with a useful messsage.
+//! This does not synchronize: errors in asynchronous kernels are reported by a subsequent check,
+//! unless environment variable JDFTX_GPU_SYNC_CHECK=yes (synchronize at each check, for debugging kernel launches)
 extern void gpuErrorCheck();
 
 #endif //GPU_ENABLED
@@ -22,7 +22,13 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Thread.h>
 #include <core/Operators.h>
 #include <core/LatticeUtils.h>
+#include <core/LoopMacros.h>
+#include <core/ManagedMemory.h>
 #include <algorithm>
+#include <cstring>
+#include <cfloat>
+#include <functional>
+#include <unistd.h>
 
 #ifdef MKL_PROVIDES_FFT
 #include <fftw3_mkl.h>
@@ -30,7 +36,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 const double GridInfo::maxAllowedStrain = 0.35;
 
-GridInfo::GridInfo():Gmax(0),GmaxRho(0),nr(0),initialized(false)
+GridInfo::GridInfo():Gmax(0),GmaxRho(0),nTuneS(0),nr(0),initialized(false)
 {
 }
 
@@ -40,11 +46,19 @@ GridInfo::~GridInfo()
 	{	//Destroy cached FFTW plans, if any:
 		for(auto entry: planCache)
 			fftw_destroy_plan(entry.second);
+		#ifdef SINGLE_FFT_ENABLED
+		for(auto entry: planCacheSingle)
+			fftwf_destroy_plan(entry.second);
+		#endif
 		//Destroy GPU plans, if any:
 		#ifdef GPU_ENABLED
 		cufftDestroy(planZ2Z);
 		cufftDestroy(planD2Z);
 		cufftDestroy(planZ2D);
+		for(auto entry: planZ2Zbatch)
+			cufftDestroy(entry.second);
+		for(auto entry: planC2Cbatch)
+			cufftDestroy(entry.second);
 		#endif
 	}
 }
@@ -85,6 +99,37 @@ void GridInfo::updateSdependent()
 	GmaxSphere = Gmax * (1.+maxAllowedStrain);
 }
 
+std::mutex GridInfo::GsqTableLock;
+
+void getGsqTable_sub(size_t iStart, size_t iStop, const vector3<int> S, const matrix3<> GGT, double* Gsq)
+{	THREAD_halfGspaceLoop( Gsq[i] = GGT.metric_length_squared(iG); )
+}
+const double* GridInfo::getGsqTable() const
+{	std::lock_guard<std::mutex> lock(GsqTableLock);
+	if(int(GsqTable.size())!=nG || GsqTableGGT!=GGT)
+	{	GsqTable.resize(nG);
+		threadLaunch(getGsqTable_sub, nG, S, GGT, GsqTable.data());
+		GsqTableGGT = GGT;
+	}
+	return GsqTable.data();
+}
+
+std::mutex GridInfo::workspacesLock;
+complex* GridInfo::getWorkspace(int nBoxes, bool onGpu) const
+{	std::shared_ptr<ManagedArray<complex>> ws;
+	{	std::lock_guard<std::mutex> lock(workspacesLock);
+		std::shared_ptr<ManagedArray<complex>>& wsEntry = workspaces[std::make_pair(std::this_thread::get_id(), onGpu)];
+		if(!wsEntry) wsEntry = std::make_shared<ManagedArray<complex>>();
+		ws = wsEntry; //only this thread resizes its entry below, so the lock need not be held
+	}
+	size_t nData = size_t(nr) * nBoxes;
+	if(ws->nData() < nData) ws->init(nData, onGpu);
+	#ifdef GPU_ENABLED
+	if(onGpu) return ws->dataGpu();
+	#endif
+	return ws->data();
+}
+
 void GridInfo::printLattice()
 {	logPrintf("R = \n"); R.print(globalLog, "%10lg ");
 	logPrintf("unit cell volume = %lg\n", detR);
@@ -217,7 +262,8 @@ void GridInfo::initialize(bool skipHeader, const std::vector<SpaceGroupOp> sym)
 					if(op.rot(j,k))
 						ratios(j,k) = gcd(ratios(j,k), abs(op.rot(j,k)));
 		//Construct integer basis of S's that satisfy these constraints:
-		S = vector3<int>(0,0,0);
+		std::vector<vector3<int>> Sbasis;
+		std::vector<int> scaleMin;
 		vector3<bool> dimsDone(false,false,false); //dimensions yet to be covered by Sbasis
 		for(int j=0; j<3; j++) if(!dimsDone[j])
 		{	vector3<int> Sb; Sb[j] = 1;
@@ -237,7 +283,13 @@ void GridInfo::initialize(bool skipHeader, const std::vector<SpaceGroupOp> sym)
 				if(s > scaleSb) scaleSb = s;
 			}
 			while(!fftSuitable(scaleSb)) scaleSb += 2; //move through even numbers
-			Sb *= scaleSb;
+			Sbasis.push_back(Sb);
+			scaleMin.push_back(scaleSb);
+		}
+		std::vector<int> scales = (nTuneS > 1) ? tuneScales(Sbasis, scaleMin, nTuneS) : scaleMin;
+		S = vector3<int>(0,0,0);
+		for(size_t i=0; i<Sbasis.size(); i++)
+		{	vector3<int> Sb = Sbasis[i]; Sb *= scales[i];
 			S += Sb;
 		}
 	}
@@ -264,6 +316,7 @@ void GridInfo::initialize(bool skipHeader, const std::vector<SpaceGroupOp> sym)
 	cufftPlan3d(&planZ2Z, S[0], S[1], S[2], CUFFT_Z2Z);
 	cufftPlan3d(&planD2Z, S[0], S[1], S[2], CUFFT_D2Z);
 	cufftPlan3d(&planZ2D, S[0], S[1], S[2], CUFFT_Z2D);
+	for(cufftHandle plan: {planZ2Z, planD2Z, planZ2D}) cufftSetStream(plan, gpuStream);
 	gpuErrorCheck();
 	#endif //CPU plans (FFTW/MKL) are created on demand and cached
 
@@ -271,10 +324,72 @@ void GridInfo::initialize(bool skipHeader, const std::vector<SpaceGroupOp> sym)
 }
 
 std::mutex GridInfo::planLock;
+unsigned GridInfo::plannerFlags = FFTW_MEASURE;
+bool GridInfo::planAutotune = false;
+string GridInfo::wisdomFilename;
 
-fftw_plan GridInfo::getPlan(GridInfo::PlanType planType, int nThreads) const
+//Wisdom is only valid on the machine that generated it: tag the wisdom file with a hash of the CPU model
+static string wisdomFilenameTagged()
+{	std::string cpuModel;
+	FILE* fp = fopen("/proc/cpuinfo", "r");
+	if(fp)
+	{	char line[1024];
+		while(fgets(line, sizeof(line), fp))
+			if(!strncmp(line, "model name", 10))
+			{	cpuModel = line;
+				break;
+			}
+		fclose(fp);
+	}
+	ostringstream oss;
+	oss << GridInfo::wisdomFilename << '.' << std::hex << std::hash<std::string>()(cpuModel);
+	return oss.str();
+}
+
+void GridInfo::importWisdom()
+{	static bool imported = false;
+	if(imported) return;
+	imported = true;
+	fftw_import_system_wisdom();
+	if(wisdomFilename.length())
+	{	string fname = wisdomFilenameTagged();
+		if(fftw_import_wisdom_from_filename(fname.c_str()))
+			logPrintf("Imported FFTW wisdom from '%s'.\n", fname.c_str());
+	}
+}
+
+void GridInfo::exportWisdom()
+{	if(!wisdomFilename.length() || !mpiWorld->isHead()) return;
+	//Write to a temporary file and rename, so that concurrent jobs sharing the file never read a partial one:
+	string fname = wisdomFilenameTagged();
+	ostringstream ossTmp; ossTmp << fname << ".tmp" << getpid();
+	string fnameTmp = ossTmp.str();
+	if(!fftw_export_wisdom_to_filename(fnameTmp.c_str()) || rename(fnameTmp.c_str(), fname.c_str()))
+	{	logPrintf("WARNING: could not export FFTW wisdom to '%s'.\n", fname.c_str());
+		unlink(fnameTmp.c_str());
+	}
+}
+
+//Create an FFTW plan of specified type on test data (which is overwritten while planning/timing)
+static fftw_plan createPlan(GridInfo::PlanType planType, const vector3<int>& S, int nr, int nBatch, fftw_complex* testData, fftw_complex* testData2)
+{	unsigned flags = GridInfo::plannerFlags;
+	if(nBatch > 1)
+		return fftw_plan_many_dft(3, &S[0], nBatch, testData, 0, 1, nr, testData, 0, 1, nr,
+			(planType==GridInfo::PlanForwardInPlace ? FFTW_FORWARD : FFTW_BACKWARD), flags);
+	switch(planType)
+	{	case GridInfo::PlanInverse:        return fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData2, FFTW_BACKWARD, flags);
+		case GridInfo::PlanForward:        return fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData2, FFTW_FORWARD, flags);
+		case GridInfo::PlanInverseInPlace: return fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData, FFTW_BACKWARD, flags);
+		case GridInfo::PlanForwardInPlace: return fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData, FFTW_FORWARD, flags);
+		case GridInfo::PlanRtoC:           return fftw_plan_dft_r2c_3d(S[0], S[1], S[2], (double*)testData, testData2, flags);
+		case GridInfo::PlanCtoR:           return fftw_plan_dft_c2r_3d(S[0], S[1], S[2], testData, (double*)testData2, flags);
+	}
+	return 0;
+}
+
+fftw_plan GridInfo::getPlan(GridInfo::PlanType planType, int nThreads, int nBatch) const
 {	//Return cached plan if available:
-	auto key = std::make_pair(planType, nThreads);
+	auto key = std::make_tuple(planType, nThreads, nBatch);
 	planLock.lock();
 	auto iter = planCache.find(key);
 	if(iter != planCache.end())
@@ -282,38 +397,251 @@ fftw_plan GridInfo::getPlan(GridInfo::PlanType planType, int nThreads) const
 		return iter->second;
 	}
 	//Create plan:
-	//--- import wisdom if available:
-	fftw_import_system_wisdom();
-	//--- setup threading:
-	#ifdef MKL_PROVIDES_FFT
-	fftw3_mkl.number_of_user_threads = ceildiv(nProcsAvailable, nThreads); //maximum number of user threads from which plan could be called simultaneously
-	#endif
-	fftw_init_threads();
-	fftw_plan_with_nthreads(nThreads);
+	importWisdom();
 	//--- temp data for planning:
 	bool inPlace = (planType==PlanForwardInPlace) || (planType==PlanInverseInPlace);
+	assert(nBatch==1 || inPlace); //batched plans only supported for in-place complex transforms
 	ManagedArray<fftw_complex> testMem, testMem2;
-	testMem.init(nr);
+	testMem.init(size_t(nr)*nBatch);
 	fftw_complex* testData = testMem.data();
 	fftw_complex* testData2 = 0;
 	if(!inPlace)
 	{	testMem2.init(nr);
 		testData2 = testMem2.data();
 	}
-	//--- plan:
-	#define PLANNER_FLAGS FFTW_MEASURE
+	//--- plan with requested thread count, and with successively halved thread counts if autotuning:
 	fftw_plan plan = 0;
-	switch(planType)
-	{	case PlanInverse:        plan = fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData2, FFTW_BACKWARD, PLANNER_FLAGS); break;
-		case PlanForward:        plan = fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData2, FFTW_FORWARD, PLANNER_FLAGS); break;
-		case PlanInverseInPlace: plan = fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData, FFTW_BACKWARD, PLANNER_FLAGS); break;
-		case PlanForwardInPlace: plan = fftw_plan_dft_3d(S[0], S[1], S[2], testData, testData, FFTW_FORWARD, PLANNER_FLAGS); break;
-		case PlanRtoC:           plan = fftw_plan_dft_r2c_3d(S[0], S[1], S[2], (double*)testData, testData2, PLANNER_FLAGS); break;
-		case PlanCtoR:           plan = fftw_plan_dft_c2r_3d(S[0], S[1], S[2], testData, (double*)testData2, PLANNER_FLAGS); break;
+	int nThreadsBest = 0; double tBest = DBL_MAX;
+	for(int nThreadsCur=nThreads; nThreadsCur>=1; nThreadsCur=(planAutotune ? nThreadsCur/2 : 0))
+	{	//--- setup threading:
+		#ifdef MKL_PROVIDES_FFT
+		fftw3_mkl.number_of_user_threads = ceildiv(nProcsAvailable, nThreadsCur); //maximum number of user threads from which plan could be called simultaneously
+		#endif
+		fftw_init_threads();
+		fftw_plan_with_nthreads(nThreadsCur);
+		fftw_plan planCur = createPlan(planType, S, nr, nBatch, testData, testData2);
+		if(!planCur) die("Failed to create FFT plan with %d threads and batch size %d",  nThreadsCur, nBatch);
+		if(!planAutotune || nThreads==1) { plan = planCur; break; }
+		//--- time candidate (on zeroed data, since c2r plans destroy their input):
+		memset(testData, 0, sizeof(fftw_complex)*size_t(nr)*nBatch);
+		fftw_execute(planCur); //warm up
+		const int nRepeat = 3;
+		double tStart = clock_us();
+		for(int iRepeat=0; iRepeat<nRepeat; iRepeat++)
+			fftw_execute(planCur);
+		double t = (clock_us() - tStart) / nRepeat;
+		if(t < tBest)
+		{	if(plan) fftw_destroy_plan(plan);
+			plan = planCur; tBest = t; nThreadsBest = nThreadsCur;
+		}
+		else fftw_destroy_plan(planCur);
 	}
-	if(!plan) die("Failed to create FFT plan with %d threads",  nThreads);
+	if(planAutotune && nThreads>1)
+		logPrintf("Autotuned FFT plan (type %d, batch %d) for %d x %d x %d grid: %d of %d threads (%.1lf us).\n",
+			int(planType), nBatch, S[0], S[1], S[2], nThreadsBest, nThreads, tBest);
+	exportWisdom();
 	//--- cache and return plan:
 	((GridInfo*)this)->planCache.insert(std::make_pair(key, plan));
 	planLock.unlock();
 	return plan;
 }
+
+//Number of real-space passes over the grid per FFT, with which the timed grid-point work is weighted in tuneScales
+//(density accumulation, exchange-correlation and fluid operations all scale with nr alongside the transforms)
+static const double realSpacePassesPerFFT = 4.;
+
+std::vector<int> GridInfo::tuneScales(const std::vector<vector3<int>>& Sbasis, const std::vector<int>& scaleMin, int nCandidates)
+{	//Candidate scale factors of each basis entry: successive FFT-suitable even numbers, within 20% of the minimum
+	std::vector<std::vector<int>> scaleCandidates(Sbasis.size());
+	for(size_t i=0; i<Sbasis.size(); i++)
+		for(int s=scaleMin[i]; int(scaleCandidates[i].size())<nCandidates && s<=1.2*scaleMin[i]; s+=2)
+			if(fftSuitable(s)) scaleCandidates[i].push_back(s);
+	//Backend and thread count (part of the cache key along with the problem):
+	#if defined(GPU_ENABLED)
+	cudaDeviceProp prop; int device; cudaGetDevice(&device); cudaGetDeviceProperties(&prop, device);
+	string backend = string("cufft[") + prop.name + "]";
+	#elif defined(MKL_PROVIDES_FFT)
+	string backend = "mkl";
+	#else
+	string backend = "fftw";
+	#endif
+	for(char& c: backend) if(isspace(c)) c = '_';
+	ostringstream ossKey;
+	ossKey << backend << ' ' << nProcsAvailable;
+	for(size_t i=0; i<Sbasis.size(); i++)
+		ossKey << " [" << Sbasis[i][0] << ',' << Sbasis[i][1] << ',' << Sbasis[i][2] << "]x" << scaleMin[i];
+	string key = ossKey.str();
+	
+	std::vector<int> scales = scaleMin;
+	if(mpiWorld->isHead()) //time on head alone, and broadcast the choice so that all processes agree
+	{	//Check the cache (next to the FFTW wisdom) first:
+		string cacheFilename = wisdomFilename.length() ? wisdomFilenameTagged()+".fftbox" : string();
+		bool cached = false;
+		if(cacheFilename.length())
+		{	ifstream ifs(cacheFilename);
+			string line;
+			while(getline(ifs, line))
+			{	size_t pos = line.find(" : ");
+				if(pos==string::npos || line.substr(0,pos)!=key) continue;
+				istringstream iss(line.substr(pos+3));
+				std::vector<int> scalesCached(Sbasis.size());
+				for(int& s: scalesCached) iss >> s;
+				if(!iss.fail()) { scales = scalesCached; cached = true; }
+			}
+		}
+		if(cached) logPrintf("Using tuned fftbox scale factors from '%s'.\n", cacheFilename.c_str());
+		else
+		{	//Time each combination of candidates:
+			logPrintf("Tuning fftbox size over candidates:\n");
+			std::vector<int> iCandidate(Sbasis.size(), 0);
+			double costBest = DBL_MAX;
+			while(true)
+			{	vector3<int> Scur(0,0,0);
+				std::vector<int> scalesCur(Sbasis.size());
+				for(size_t i=0; i<Sbasis.size(); i++)
+				{	scalesCur[i] = scaleCandidates[i][iCandidate[i]];
+					vector3<int> Sb = Sbasis[i]; Sb *= scalesCur[i];
+					Scur += Sb;
+				}
+				int nrCur = Scur[0]*Scur[1]*Scur[2];
+				const int nRepeat = 3;
+				ManagedArray<complex> testMem; testMem.init(nrCur, isGpuEnabled());
+				ManagedArray<double> testOut; testOut.init(nrCur, isGpuEnabled());
+				testMem.zero(); testOut.zero();
+				//--- transform time (with the plan types and threads used in the calculation):
+				#ifdef GPU_ENABLED
+				cufftHandle plan;
+				cufftPlan3d(&plan, Scur[0], Scur[1], Scur[2], CUFFT_Z2Z);
+				cufftSetStream(plan, gpuStream);
+				cufftDoubleComplex* data = (cufftDoubleComplex*)testMem.dataGpu();
+				cufftExecZ2Z(plan, data, data, CUFFT_INVERSE); //warm up
+				cudaStreamSynchronize(gpuStream);
+				double tStart = clock_us();
+				for(int iRepeat=0; iRepeat<nRepeat; iRepeat++)
+					cufftExecZ2Z(plan, data, data, CUFFT_INVERSE);
+				cudaStreamSynchronize(gpuStream);
+				double tFFT = (clock_us() - tStart) / nRepeat;
+				cufftDestroy(plan);
+				gpuErrorCheck();
+				#else
+				planLock.lock();
+				importWisdom();
+				#ifdef MKL_PROVIDES_FFT
+				fftw3_mkl.number_of_user_threads = 1;
+				#endif
+				fftw_init_threads();
+				fftw_plan_with_nthreads(nProcsAvailable);
+				fftw_complex* data = (fftw_complex*)testMem.data();
+				fftw_plan plan = createPlan(PlanInverseInPlace, Scur, nrCur, 1, data, 0);
+				if(!plan) die("Failed to create FFT plan while tuning fftbox.\n");
+				exportWisdom();
+				planLock.unlock();
+				memset(data, 0, sizeof(fftw_complex)*nrCur); //planning may overwrite test data
+				fftw_execute(plan); //warm up
+				double tStart = clock_us();
+				for(int iRepeat=0; iRepeat<nRepeat; iRepeat++)
+					fftw_execute(plan);
+				double tFFT = (clock_us() - tStart) / nRepeat;
+				planLock.lock();
+				fftw_destroy_plan(plan);
+				planLock.unlock();
+				#endif
+				//--- grid-point work:
+				double tStartPoints = clock_us();
+				for(int iRepeat=0; iRepeat<nRepeat; iRepeat++)
+					callPref(eblas_accumNorm)(nrCur, 1., testMem.dataPref(), testOut.dataPref());
+				#ifdef GPU_ENABLED
+				cudaStreamSynchronize(gpuStream);
+				#endif
+				double tPoints = (clock_us() - tStartPoints) / nRepeat;
+				double cost = tFFT + realSpacePassesPerFFT * tPoints;
+				logPrintf("\tS = %d %d %d: FFT %.1lf us, grid pass %.1lf us, cost %.1lf us\n",
+					Scur[0], Scur[1], Scur[2], tFFT, tPoints, cost);
+				if(cost < costBest) { costBest = cost; scales = scalesCur; }
+				//Next combination:
+				size_t i = 0;
+				for(; i<Sbasis.size(); i++)
+				{	if(++iCandidate[i] < int(scaleCandidates[i].size())) break;
+					iCandidate[i] = 0;
+				}
+				if(i == Sbasis.size()) break;
+			}
+			//Append choice to cache:
+			if(cacheFilename.length())
+			{	FILE* fp = fopen(cacheFilename.c_str(), "a");
+				if(fp)
+				{	fprintf(fp, "%s :", key.c_str());
+					for(int s: scales) fprintf(fp, " %d", s);
+					fprintf(fp, "\n");
+					fclose(fp);
+				}
+				else logPrintf("WARNING: could not write fftbox tuning cache '%s'.\n", cacheFilename.c_str());
+			}
+		}
+	}
+	mpiWorld->bcastData(scales);
+	return scales;
+}
+
+bool GridInfo::batchSinglePrecision = false;
+
+bool GridInfo::singlePrecisionAvailable()
+{
+	#if defined(GPU_ENABLED) || defined(SINGLE_FFT_ENABLED)
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+#ifdef SINGLE_FFT_ENABLED
+fftwf_plan GridInfo::getPlanSingle(GridInfo::PlanType planType, int nThreads, int nBatch) const
+{	assert((planType==PlanForwardInPlace) || (planType==PlanInverseInPlace));
+	//Return cached plan if available:
+	auto key = std::make_tuple(planType, nThreads, nBatch);
+	std::lock_guard<std::mutex> lock(planLock);
+	auto iter = planCacheSingle.find(key);
+	if(iter != planCacheSingle.end()) return iter->second;
+	//Create plan:
+	#ifdef MKL_PROVIDES_FFT
+	fftw3_mkl.number_of_user_threads = ceildiv(nProcsAvailable, nThreads);
+	#endif
+	fftwf_init_threads();
+	fftwf_plan_with_nthreads(nThreads);
+	ManagedArray<fftwf_complex> testMem;
+	testMem.init(size_t(nr)*nBatch);
+	fftwf_complex* testData = testMem.data();
+	fftwf_plan plan = fftwf_plan_many_dft(3, &S[0], nBatch, testData, 0, 1, nr, testData, 0, 1, nr,
+		(planType==PlanForwardInPlace ? FFTW_FORWARD : FFTW_BACKWARD), plannerFlags);
+	if(!plan) die("Failed to create single-precision FFT plan with %d threads and batch size %d",  nThreads, nBatch);
+	((GridInfo*)this)->planCacheSingle[key] = plan;
+	return plan;
+}
+#endif
+
+#ifdef GPU_ENABLED
+cufftHandle GridInfo::getPlanZ2Zbatch(int nBatch) const
+{	if(nBatch==1) return planZ2Z;
+	std::lock_guard<std::mutex> lock(planLock);
+	auto iter = planZ2Zbatch.find(nBatch);
+	if(iter != planZ2Zbatch.end()) return iter->second;
+	cufftHandle plan;
+	cufftPlanMany(&plan, 3, (int*)&S[0], 0, 1, nr, 0, 1, nr, CUFFT_Z2Z, nBatch);
+	cufftSetStream(plan, gpuStream);
+	gpuErrorCheck();
+	((GridInfo*)this)->planZ2Zbatch[nBatch] = plan;
+	return plan;
+}
+
+cufftHandle GridInfo::getPlanC2Cbatch(int nBatch) const
+{	std::lock_guard<std::mutex> lock(planLock);
+	auto iter = planC2Cbatch.find(nBatch);
+	if(iter != planC2Cbatch.end()) return iter->second;
+	cufftHandle plan;
+	cufftPlanMany(&plan, 3, (int*)&S[0], 0, 1, nr, 0, 1, nr, CUFFT_C2C, nBatch);
+	cufftSetStream(plan, gpuStream);
+	gpuErrorCheck();
+	((GridInfo*)this)->planC2Cbatch[nBatch] = plan;
+	return plan;
+}
+#endif
@@ -25,11 +25,18 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/matrix3.h>
 #include <core/GpuUtil.h>
+#include <core/string.h>
 #include <fftw3.h>
 #include <stdint.h>
 #include <cstdio>
 #include <mutex>
 #include <map>
+#include <tuple>
+#include <vector>
+#include <thread>
+#include <memory>
+
+template<typename T> class ManagedArray;
 
 /** @brief Simulation grid descriptor
 
@@ -81,6 +88,7 @@ public:
 	double Gmax; //!< radius of wavefunction G-sphere, whole density sphere (double the radius) must be inscribable within the FFT box
 	double GmaxRho; //!< if non-zero, override the FFT box inscribable sphere radius
 	vector3<int> S; //!< sample points in each dimension (if 0, will be determined automatically based on Gmax)
+	int nTuneS; //!< if > 1, auto-computed S is chosen by timing up to this many FFT-suitable sizes per independent dimension (see command fftbox-tune; must be set on all processes)
 
 	//! Initialize the dependent quantities below.
 	//! If S is specified and is too small for the given Gmax, the call will abort.
@@ -118,12 +126,22 @@ public:
 		PlanRtoC, //!< Real to complex transform
 		PlanCtoR, //!< Complex to real transform
 	};
-	fftw_plan getPlan(PlanType planType, int nThreads) const; //get an FFTW plan of specified type with specified thread count
+	fftw_plan getPlan(PlanType planType, int nThreads, int nBatch=1) const; //get an FFTW plan of specified type with specified thread count (nBatch>1 only for in-place complex transforms of consecutive boxes)
 	#ifdef GPU_ENABLED
 	cufftHandle planZ2Z; //!< CUFFT plan for all the complex transforms
 	cufftHandle planD2Z; //!< CUFFT plan for R -> G
 	cufftHandle planZ2D; //!< CUFFT plan for G -> R
+	cufftHandle getPlanZ2Zbatch(int nBatch) const; //!< CUFFT plan for nBatch complex transforms of consecutive boxes (created on demand and cached)
+	cufftHandle getPlanC2Cbatch(int nBatch) const; //!< single-precision version of getPlanZ2Zbatch
+	#endif
+	#ifdef SINGLE_FFT_ENABLED
+	fftwf_plan getPlanSingle(PlanType planType, int nThreads, int nBatch) const; //!< single-precision FFTW plan for nBatch in-place complex transforms of consecutive boxes
 	#endif
+	static bool batchSinglePrecision; //!< whether batched (wavefunction) transforms I_batch and Idag_batch are currently performed in single precision
+	static bool singlePrecisionAvailable(); //!< whether this build supports single-precision batched transforms
+	static unsigned plannerFlags; //!< FFTW planner rigor for CPU plans (FFTW_MEASURE by default)
+	static bool planAutotune; //!< if set, time each CPU plan with successively halved thread counts and keep the fastest
+	static string wisdomFilename; //!< if non-empty, FFTW wisdom is imported from and exported to this file (suffixed by a CPU-model tag)
 
 	//Indexing utilities (inlined for efficiency)
 	inline vector3<int> wrapGcoords(const vector3<int> iG) const //!< wrap negative G-indices to the positive side
@@ -144,13 +162,39 @@ public:
 		return iGwrapped[2] + (S[2]/2+1)*(iGwrapped[1] + S[1]*iGwrapped[0]);
 	}
 
+	//! Table of |G|^2 on the half-reduced reciprocal-space box (nG entries, CPU memory), computed on first use
+	//! and recomputed if GGT changes. Used by applyFuncGsq to stream Gsq instead of evaluating the metric per point.
+	const double* getGsqTable() const;
+	
+	//! Scratch space for nBoxes consecutive complex FFT boxes (nr entries each, in GPU memory if onGpu), owned by the calling thread
+	//! and reused across calls so that column loops (see Idag_DiagV_I and diagouterI) do not allocate per call. The contents are not
+	//! preserved, and the space is valid only until the same thread next calls getWorkspace (so the holder must not call other users).
+	complex* getWorkspace(int nBoxes, bool onGpu) const;
+
 private:
 	bool initialized; //!< keep track of whether initialize() has been called
 	void updateSdependent();
 	
-	//FFTW plans by thread count and type:
-	std::map<std::pair<PlanType,int>,fftw_plan> planCache;
+	//FFTW plans by type, thread count and batch size:
+	std::map<std::tuple<PlanType,int,int>,fftw_plan> planCache;
 	static std::mutex planLock; //Global lock since planner routines are not thread safe
+	static void importWisdom(); //import system and user wisdom (once per run; call with planLock held)
+	static void exportWisdom(); //export accumulated wisdom to wisdomFilename, if any (call with planLock held)
+	static std::vector<int> tuneScales(const std::vector<vector3<int>>& Sbasis, const std::vector<int>& scaleMin, int nCandidates); //scale factors of the S basis chosen by timing (see nTuneS)
+	
+	mutable std::vector<double> GsqTable; //cached |G|^2 in half-G space (see getGsqTable)
+	mutable matrix3<> GsqTableGGT; //GGT for which GsqTable was computed
+	static std::mutex GsqTableLock;
+	
+	mutable std::map<std::pair<std::thread::id,bool>,std::shared_ptr<ManagedArray<complex>>> workspaces; //per-thread (and memory space) FFT-box scratch (see getWorkspace)
+	static std::mutex workspacesLock;
+	#ifdef GPU_ENABLED
+	std::map<int,cufftHandle> planZ2Zbatch; //batched CUFFT plans by batch size
+	std::map<int,cufftHandle> planC2Cbatch; //batched single-precision CUFFT plans by batch size
+	#endif
+	#ifdef SINGLE_FFT_ENABLED
+	std::map<std::tuple<PlanType,int,int>,fftwf_plan> planCacheSingle; //single-precision FFTW plans by type, thread count and batch size
+	#endif
 };
 
 //! @}
@@ -93,7 +93,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 	for(int j=0; j<3; j++) if(2*iG[j]>S[j]) iG[j]-=S[j];
 
 
-//! One thread of a loop over symmetry-reduced G-space (see applyFuncGsq_sub in Operators.h for example)
+//! One thread of a loop over symmetry-reduced G-space (see getGsqTable_sub in GridInfo.cpp for example)
 #define THREAD_halfGspaceLoop(code) \
 	int size2 = S[2]/2+1; \
 	size_t i=iStart; \
@@ -37,6 +37,10 @@ MPIUtil::ProcDivision::ProcDivision(const MPIUtil *mpiUtil, size_t nGroups, size
 
 //---------- class MPIUtil ----------
 
+#ifdef MPI_ENABLED
+static bool mpiInitializedHere = false; //whether MPI_Init was called by MPIUtil (and should be finalized by it)
+#endif
+
 MPIUtil::MPIUtil(int argc, char** argv, ProcDivision procDivision)
 : procDivision(procDivision)
 {
@@ -48,9 +52,13 @@ MPIUtil::MPIUtil(int argc, char** argv, ProcDivision procDivision)
 			procDivision.mpiUtil->iProcess(), &comm);
 	}
 	else
-	{	//Initialize MPI (use COMM_WORLD)
-		int rc = MPI_Init(&argc, &argv);
-		if(rc != MPI_SUCCESS) { printf("Error starting MPI program. Terminating.\n"); MPI_Abort(MPI_COMM_WORLD, rc); }
+	{	//Initialize MPI (use COMM_WORLD), unless already done by a host program embedding JDFTx:
+		int initialized; MPI_Initialized(&initialized);
+		if(!initialized)
+		{	int rc = MPI_Init(&argc, &argv);
+			if(rc != MPI_SUCCESS) { printf("Error starting MPI program. Terminating.\n"); MPI_Abort(MPI_COMM_WORLD, rc); }
+			mpiInitializedHere = true;
+		}
 		comm = MPI_COMM_WORLD;
 	}
 
@@ -97,14 +105,98 @@ MPIUtil::~MPIUtil()
 	int finalized;
 	MPI_Finalized(&finalized);
 	if(finalized) return; //to prevent double-free type errors
+	hierarchy = 0; //free sub-communicators first
 	//Finalize communicators or MPI as appropriate:
 	if(comm == MPI_COMM_WORLD)
-		MPI_Finalize();
+	{	if(mpiInitializedHere) MPI_Finalize(); //leave MPI to the host program otherwise
+	}
 	else
 		MPI_Comm_free(&comm);
 	#endif
 }
 
+
+//-------------------------- Two-level collectives ------------------------------------
+
+size_t MPIUtil::hierarchicalMinBytes = 0;
+
+#ifdef MPI_ENABLED
+//Sub-communicators of a communicator for two-level collectives:
+//one per node (shared-memory domain), and one among the lowest rank (leader) of each node
+struct MPIHierarchy
+{	bool enabled; //whether there are several nodes, at least one with several processes
+	MPI_Comm commNode, commLeaders; //commLeaders is MPI_COMM_NULL on processes that are not node leaders
+	std::vector<int> leader, leaderIndex; //rank of node leader, and rank of that leader within commLeaders, for each process
+
+	MPIHierarchy(MPI_Comm comm, int iProc, int nProcs) : enabled(false), commNode(MPI_COMM_NULL), commLeaders(MPI_COMM_NULL)
+	{
+		#if MPI_VERSION >= 3
+		MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, iProc, MPI_INFO_NULL, &commNode);
+		int iProcNode, nProcsNode;
+		MPI_Comm_rank(commNode, &iProcNode);
+		MPI_Comm_size(commNode, &nProcsNode);
+		MPI_Comm_split(comm, iProcNode ? MPI_UNDEFINED : 0, iProc, &commLeaders);
+		//Locate node leaders:
+		int myLeader = iProc, myLeaderIndex = 0, nLeaders = 0;
+		if(commLeaders != MPI_COMM_NULL)
+		{	MPI_Comm_rank(commLeaders, &myLeaderIndex);
+			MPI_Comm_size(commLeaders, &nLeaders);
+		}
+		MPI_Bcast(&myLeader, 1, MPI_INT, 0, commNode);
+		MPI_Bcast(&myLeaderIndex, 1, MPI_INT, 0, commNode);
+		MPI_Bcast(&nLeaders, 1, MPI_INT, 0, commNode);
+		leader.resize(nProcs); leaderIndex.resize(nProcs);
+		MPI_Allgather(&myLeader, 1, MPI_INT, leader.data(), 1, MPI_INT, comm);
+		MPI_Allgather(&myLeaderIndex, 1, MPI_INT, leaderIndex.data(), 1, MPI_INT, comm);
+		int nProcsNodeMax = nProcsNode;
+		MPI_Allreduce(MPI_IN_PLACE, &nProcsNodeMax, 1, MPI_INT, MPI_MAX, comm);
+		enabled = (nLeaders>1 && nProcsNodeMax>1); //otherwise flat collectives are equivalent
+		#endif
+	}
+	
+	~MPIHierarchy()
+	{	int finalized;
+		MPI_Finalized(&finalized);
+		if(finalized) return;
+		if(commLeaders != MPI_COMM_NULL) MPI_Comm_free(&commLeaders);
+		if(commNode != MPI_COMM_NULL) MPI_Comm_free(&commNode);
+	}
+};
+
+bool MPIUtil::bcastHierarchical(void* data, int count, MPI_Datatype type, int root) const
+{	if(!hierarchy) hierarchy = std::make_shared<MPIHierarchy>(comm, iProc, nProcs);
+	const MPIHierarchy& h = *hierarchy;
+	if(!h.enabled) return false;
+	static StopWatch watch("MPIUtil::bcastHierarchical"); watch.start();
+	//Move data from root to the leader of its node, if necessary:
+	int rootLeader = h.leader[root];
+	const int tag = 0x4842; //not used by any other point-to-point communication
+	if(root != rootLeader)
+	{	if(iProc == root) MPI_Send(data, count, type, rootLeader, tag, comm);
+		if(iProc == rootLeader) MPI_Recv(data, count, type, root, tag, comm, MPI_STATUS_IGNORE);
+	}
+	//Broadcast among node leaders, and then within each node:
+	if(h.commLeaders != MPI_COMM_NULL) MPI_Bcast(data, count, type, h.leaderIndex[root], h.commLeaders);
+	MPI_Bcast(data, count, type, 0, h.commNode);
+	watch.stop();
+	return true;
+}
+
+bool MPIUtil::allReduceHierarchical(void* data, int count, MPI_Datatype type, MPI_Op op) const
+{	if(!hierarchy) hierarchy = std::make_shared<MPIHierarchy>(comm, iProc, nProcs);
+	const MPIHierarchy& h = *hierarchy;
+	if(!h.enabled) return false;
+	static StopWatch watch("MPIUtil::allReduceHierarchical"); watch.start();
+	//Reduce within each node, combine among node leaders, and broadcast back within each node:
+	bool isLeader = (h.commLeaders != MPI_COMM_NULL);
+	MPI_Reduce(isLeader ? MPI_IN_PLACE : data, data, count, type, op, 0, h.commNode);
+	if(isLeader) MPI_Allreduce(MPI_IN_PLACE, data, count, type, op, h.commLeaders);
+	MPI_Bcast(data, count, type, 0, h.commNode);
+	watch.stop();
+	return true;
+}
+#endif
+
 void MPIUtil::exit(int errCode) const
 {
 	#ifdef MPI_ENABLED
@@ -365,6 +457,40 @@ void TaskDivision::init(size_t nTasks, const MPIUtil* mpiUtil)
 	stopMine = stop(mpiUtil->iProcess());
 }
 
+void TaskDivision::init(const std::vector<double>& taskCost, const MPIUtil* mpiUtil)
+{	int nProcs = mpiUtil->nProcesses();
+	size_t nTasks = taskCost.size();
+	//Greedily fill contiguous ranges up to a maximum cost per process, returning the number of ranges needed:
+	auto fill = [&](double costMax, std::vector<size_t>* stops)
+	{	int nRanges = 1; double cost = 0.;
+		for(size_t task=0; task<nTasks; task++)
+		{	if(cost && cost+taskCost[task] > costMax)
+			{	if(stops && nRanges<=nProcs) (*stops)[nRanges-1] = task;
+				nRanges++;
+				cost = 0.;
+			}
+			cost += taskCost[task];
+		}
+		return nRanges;
+	};
+	//Bisect for the smallest maximum cost that fits within the available processes:
+	double costLo = 0., costHi = 0.;
+	for(double cost: taskCost)
+	{	costLo = std::max(costLo, cost);
+		costHi += cost;
+	}
+	if(!(costHi > 0.)) { init(nTasks, mpiUtil); return; } //no cost information: divide evenly
+	for(int iter=0; iter<64 && costHi-costLo > 1e-12*costHi; iter++)
+	{	double costMid = 0.5*(costLo + costHi);
+		if(fill(costMid, 0) <= nProcs) costHi = costMid;
+		else costLo = costMid;
+	}
+	stopArr.assign(nProcs, nTasks);
+	fill(costHi, &stopArr);
+	startMine = start(mpiUtil->iProcess());
+	stopMine = stop(mpiUtil->iProcess());
+}
+
 int TaskDivision::whose(size_t q) const
 {	if(stopArr.size()>1)
 		return std::upper_bound(stopArr.begin(),stopArr.end(), q) - stopArr.begin();
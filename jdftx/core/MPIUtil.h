@@ -22,10 +22,12 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/string.h>
 #include <core/matrix3.h>
+#include <core/Profiler.h>
 #include <cstdlib>
 #include <cstdio>
 #include <vector>
 #include <array>
+#include <memory>
 
 #ifdef MPI_ENABLED
 #include <mpi.h>
@@ -44,6 +46,10 @@ class MPIUtil
 	int nProcs, iProc;
 	#ifdef MPI_ENABLED
 	MPI_Comm comm;
+	mutable std::shared_ptr<struct MPIHierarchy> hierarchy; //!< node and node-leader sub-communicators for two-level collectives (created on first use)
+	static bool useHierarchical(size_t nBytes) { return hierarchicalMinBytes && nBytes>=hierarchicalMinBytes; }
+	bool bcastHierarchical(void* data, int count, MPI_Datatype type, int root) const; //!< two-level broadcast (returns false if unavailable, eg. on a single node)
+	bool allReduceHierarchical(void* data, int count, MPI_Datatype type, MPI_Op op) const; //!< two-level all-reduce (returns false if unavailable)
 	#endif
 public:
 	int iProcess() const { return iProc; } //!< rank of current process
@@ -70,6 +76,11 @@ public:
 	MPIUtil(const MPIUtil* mpiUtil, std::vector<int> ranks); //!< create a sub-communicator from listed ranks in parent communicator
 	~MPIUtil();
 	void exit(int errCode) const; //!< global exit (kill other MPI processes as well)
+	
+	//! Minimum size in bytes of blocking bcast / allReduce that are performed in two levels: within each node, and then
+	//! among one leader per node (0 = disabled, the default; set by environment variable JDFTX_HIERARCHICAL_COLLECTIVES in MB).
+	//! Must be identical on all processes.
+	static size_t hierarchicalMinBytes;
 
 	void checkErrors(const ostringstream&) const; //!< collect error messages from all processes; if any, display them and quit
 	
@@ -142,6 +153,9 @@ class TaskDivision
 public:
 	TaskDivision(size_t nTasks=0, const MPIUtil* mpiUtil=0);
 	void init(size_t nTasks, const MPIUtil* mpiUtil);
+	//! Divide tasks into contiguous ranges with approximately equal total cost (minimizing the most expensive range).
+	//! The costs must be identical on all processes, so that all of them arrive at the same division.
+	void init(const std::vector<double>& taskCost, const MPIUtil* mpiUtil);
 	inline size_t start() const { return startMine; } //!< Task number that current process should start on
 	inline size_t stop() const  { return stopMine; } //!< Task number that current process should stop before (non-inclusive)
 	inline size_t start(int iProc) const { return iProc ? stopArr[iProc-1] : 0; } //!< Task number that the specified process should start on
@@ -280,7 +294,7 @@ template<typename T> void MPIUtil::bcast(T* data, size_t nData, int root, Reques
 {	using namespace MPIUtilPrivate;
 	#ifdef MPI_ENABLED
 	if(nProcs>1)
-	{		
+	{	static StopWatch watch("MPIUtil::bcast"); watch.start();
 		#if MPI_VERSION < 3
 		if(request) *request = MPI_REQUEST_NULL; //Non-blocking collective not supported (fall back to blocking version below)
 		#else
@@ -288,8 +302,11 @@ template<typename T> void MPIUtil::bcast(T* data, size_t nData, int root, Reques
 			MPI_Ibcast(data, DataType<T>::nElem*nData, DataType<T>::get(), root, comm, request);
 		else
 		#endif
+		if(!(useHierarchical(sizeof(T)*nData) && bcastHierarchical(data, DataType<T>::nElem*nData, DataType<T>::get(), root)))
 			MPI_Bcast(data, DataType<T>::nElem*nData, DataType<T>::get(), root, comm);
+		watch.stop();
 	}
+	else if(request) *request = MPI_REQUEST_NULL; //nothing to communicate (makes wait a no-op)
 	#endif
 }
 template<typename T> void MPIUtil::bcast(T& data, int root, Request* request) const
@@ -303,7 +320,8 @@ template<typename T> void MPIUtil::allReduce(T* data, size_t nData, MPIUtil::Red
 {	using namespace MPIUtilPrivate;
 	#ifdef MPI_ENABLED
 	if(nProcs>1)
-	{	if(safeMode) //Reduce to root node and then broadcast result (to ensure identical values)
+	{	static StopWatch watch("MPIUtil::allReduce"); watch.start();
+		if(safeMode) //Reduce to root node and then broadcast result (to ensure identical values)
 		{	MPI_Reduce(isHead()?MPI_IN_PLACE:data, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), 0, comm);
 			bcast(data, nData, 0);
 			if(request) throw string("Asynchronous allReduce not supported in safeMode");
@@ -317,9 +335,12 @@ template<typename T> void MPIUtil::allReduce(T* data, size_t nData, MPIUtil::Red
 				MPI_Iallreduce(MPI_IN_PLACE, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), comm, request);
 			else
 			#endif
+			if(!(useHierarchical(sizeof(T)*nData) && allReduceHierarchical(data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op))))
 				MPI_Allreduce(MPI_IN_PLACE, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), comm);
 		}
+		watch.stop();
 	}
+	else if(request) *request = MPI_REQUEST_NULL; //nothing to communicate (makes wait a no-op)
 	#endif
 }
 template<typename T> void MPIUtil::allReduce(T& data, MPIUtil::ReduceOp op, bool safeMode, Request* request) const
@@ -344,16 +365,18 @@ template<typename T> void MPIUtil::reduce(T* data, size_t nData, MPIUtil::Reduce
 {	using namespace MPIUtilPrivate;
 	#ifdef MPI_ENABLED
 	if(nProcs>1)
-	{	
+	{	static StopWatch watch("MPIUtil::reduce"); watch.start();
 		#if MPI_VERSION < 3
 		if(request) *request = MPI_REQUEST_NULL; //Non-blocking collective not supported (fall back to blocking version below)
 		#else
 		if(request)
-			MPI_Ireduce(isHead()?MPI_IN_PLACE:data, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), root, comm, request);
+			MPI_Ireduce(iProc==root?MPI_IN_PLACE:data, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), root, comm, request);
 		else
 		#endif
-			MPI_Reduce(isHead()?MPI_IN_PLACE:data, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), root, comm);
+			MPI_Reduce(iProc==root?MPI_IN_PLACE:data, data, DataType<T>::nElem*nData, DataType<T>::get(), mpiOp(op), root, comm);
+		watch.stop();
 	}
+	else if(request) *request = MPI_REQUEST_NULL; //nothing to communicate (makes wait a no-op)
 	#endif
 }
 template<typename T> void MPIUtil::reduce(T& data, MPIUtil::ReduceOp op, int root, Request* request) const
@@ -365,7 +388,7 @@ template<typename T> void MPIUtil::reduce(T& data, int& index, MPIUtil::ReduceOp
 	if(nProcs>1)
 	{	typename DataTypeIntPair<T>::Elem pair;
 		pair.data = data; pair.index = index;
-		MPI_Reduce(isHead()?MPI_IN_PLACE:&pair, &pair, 1, DataTypeIntPair<T>::get(), mpiLocOp(op), root, comm);
+		MPI_Reduce(iProc==root?MPI_IN_PLACE:&pair, &pair, 1, DataTypeIntPair<T>::get(), mpiLocOp(op), root, comm);
 		data = pair.data; index = pair.index;
 	}
 	#endif
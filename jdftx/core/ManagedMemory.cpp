@@ -19,10 +19,14 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/ManagedMemory.h>
 #include <core/GpuUtil.h>
+#include <core/Thread.h>
 #include <fftw3.h>
 #include <mutex>
 #include <map>
+#include <list>
 #include <set>
+#include <vector>
+#include <algorithm>
 
 //-------- Memory usage profiler ---------
 
@@ -94,6 +98,218 @@ namespace MemUsageReport
 }
 
 
+//-------- Memory telemetry (see ManagedMemoryBase::statsEnabled) ---------
+
+bool ManagedMemoryBase::statsEnabled = false;
+string ManagedMemoryBase::statsPrefix;
+size_t ManagedMemoryBase::softCap = 0;
+
+namespace MemStats
+{
+	const char* spaceName[2] = { "CPU", "GPU" };
+	
+	struct Usage
+	{	size_t current, peak; //current and peak bytes
+		size_t nAlloc, bytesAlloc; //allocation count and total bytes allocated
+		Usage() : current(0), peak(0), nAlloc(0), bytesAlloc(0) {}
+	};
+	
+	//Peaks and allocations within one (or several merged) phases of the same name:
+	struct Phase
+	{	std::map<std::pair<string,bool>,size_t> peak; //peak bytes by category and space
+		size_t peakTotal[2]; //peak bytes in each space
+		size_t nAlloc, bytesAlloc;
+		Phase() : nAlloc(0), bytesAlloc(0) { peakTotal[0] = peakTotal[1] = 0; }
+	};
+	
+	struct State
+	{	std::mutex lock;
+		std::map<std::pair<string,bool>,Usage> usage; //by category and space (onGpu)
+		Usage total[2]; //totals in each space
+		Usage iteration[2]; //peaks and allocations since the last reportIteration (current unused)
+		std::map<string,Phase> phases; std::vector<string> phaseOrder;
+		string phaseName; Phase* phase; //current phase
+		std::map<string,std::pair<size_t,size_t>> sites; //allocation count and bytes by innermost active StopWatch
+		State() : phaseName("setup"), phase(0) {}
+		
+		Phase& currentPhase()
+		{	if(!phase)
+			{	if(!phases.count(phaseName)) phaseOrder.push_back(phaseName);
+				phase = &phases[phaseName];
+			}
+			return *phase;
+		}
+	};
+	//Allocated once and never freed, since static objects in other files may free memory during static destruction:
+	State& state() { static State* st = new State(); return *st; }
+	thread_local const string* pendingCategory = 0; thread_local size_t pendingBytes = 0; //allocation in progress (reported on failure)
+	
+	//Record addition or removal of nBytes of category in specified space (isAlloc distinguishes new allocations from transfers between spaces)
+	void update(const string& category, size_t nBytes, bool onGpu, bool add, bool isAlloc)
+	{	if(!ManagedMemoryBase::statsEnabled) return;
+		const string* site = isAlloc ? StopWatch::currentSection() : 0;
+		bool capExceeded = false;
+		State& st = state();
+		{	std::lock_guard<std::mutex> guard(st.lock);
+			Usage& u = st.usage[std::make_pair(category, onGpu)];
+			Usage& t = st.total[onGpu];
+			if(!add)
+			{	u.current -= nBytes;
+				t.current -= nBytes;
+				return;
+			}
+			u.current += nBytes; u.peak = std::max(u.peak, u.current);
+			t.current += nBytes; t.peak = std::max(t.peak, t.current);
+			Phase& p = st.currentPhase();
+			size_t& pPeak = p.peak[std::make_pair(category, onGpu)];
+			pPeak = std::max(pPeak, u.current);
+			p.peakTotal[onGpu] = std::max(p.peakTotal[onGpu], t.current);
+			st.iteration[onGpu].peak = std::max(st.iteration[onGpu].peak, t.current);
+			if(isAlloc)
+			{	u.nAlloc++; u.bytesAlloc += nBytes;
+				t.nAlloc++; t.bytesAlloc += nBytes;
+				p.nAlloc++; p.bytesAlloc += nBytes;
+				st.iteration[onGpu].nAlloc++; st.iteration[onGpu].bytesAlloc += nBytes;
+				std::pair<size_t,size_t>& s = st.sites[site ? *site : string("(outside profiled sections)")];
+				s.first++; s.second += nBytes;
+			}
+			capExceeded = ManagedMemoryBase::softCap && t.current > ManagedMemoryBase::softCap;
+		}
+		if(capExceeded)
+		{	ManagedMemoryBase::reportStats();
+			die_alone("%s memory usage of %.1lf MB exceeds the soft cap of %.1lf MB (JDFTX_MEMCAP) while allocating %.3lf MB for '%s'%s%s.\n",
+				spaceName[onGpu], st.total[onGpu].current/1048576., ManagedMemoryBase::softCap/1048576., nBytes/1048576.,
+				category.c_str(), site ? " in " : "", site ? site->c_str() : "");
+		}
+	}
+	
+	//Report the pending allocation and telemetry (if any) before an out-of-memory abort
+	void reportFailure()
+	{	if(pendingCategory)
+			logPrintf("Failed allocating %.3lf MB for '%s'.\n", pendingBytes/1048576., pendingCategory->c_str());
+		ManagedMemoryBase::reportStats();
+	}
+}
+
+void ManagedMemoryBase::setPhase(const string& phase)
+{	if(!statsEnabled) return;
+	MemStats::State& st = MemStats::state();
+	std::lock_guard<std::mutex> guard(st.lock);
+	st.phaseName = phase;
+	st.phase = 0;
+	//Start the phase from the memory already in use:
+	MemStats::Phase& p = st.currentPhase();
+	for(const auto& entry: st.usage)
+	{	size_t& pPeak = p.peak[entry.first];
+		pPeak = std::max(pPeak, entry.second.current);
+	}
+	for(int onGpu=0; onGpu<2; onGpu++)
+		p.peakTotal[onGpu] = std::max(p.peakTotal[onGpu], st.total[onGpu].current);
+}
+
+string ManagedMemoryBase::getPhase()
+{	MemStats::State& st = MemStats::state();
+	std::lock_guard<std::mutex> guard(st.lock);
+	return st.phaseName;
+}
+
+void ManagedMemoryBase::reportIteration(const char* context, int iter)
+{	if(!statsEnabled) return;
+	MemStats::State& st = MemStats::state();
+	std::lock_guard<std::mutex> guard(st.lock);
+	logPrintf("MEMSTATS: %s iteration %d:", context, iter);
+	for(int onGpu=0; onGpu<(isGpuEnabled() ? 2 : 1); onGpu++)
+	{	MemStats::Usage& it = st.iteration[onGpu];
+		logPrintf("  %s peak %.1lf MB, %lu allocations of %.1lf MB", MemStats::spaceName[onGpu],
+			std::max(it.peak, st.total[onGpu].current)/1048576., it.nAlloc, it.bytesAlloc/1048576.);
+		it = MemStats::Usage();
+	}
+	logPrintf("\n");
+}
+
+void ManagedMemoryBase::reportStats()
+{	if(!statsEnabled) return;
+	MemStats::State& st = MemStats::state();
+	std::lock_guard<std::mutex> guard(st.lock);
+	const double MB = 1./1048576.;
+	//Categories:
+	logPrintf("\n");
+	for(const auto& entry: st.usage)
+	{	const MemStats::Usage& u = entry.second;
+		logPrintf("MEMSTATS: %30s %s  peak %12.3lf MB  current %12.3lf MB  %10lu allocations of %14.3lf MB\n",
+			entry.first.first.c_str(), MemStats::spaceName[entry.first.second], u.peak*MB, u.current*MB, u.nAlloc, u.bytesAlloc*MB);
+	}
+	for(int onGpu=0; onGpu<2; onGpu++)
+		if(st.total[onGpu].nAlloc)
+		{	const MemStats::Usage& t = st.total[onGpu];
+			logPrintf("MEMSTATS: %30s %s  peak %12.3lf MB  current %12.3lf MB  %10lu allocations of %14.3lf MB\n",
+				"Total", MemStats::spaceName[onGpu], t.peak*MB, t.current*MB, t.nAlloc, t.bytesAlloc*MB);
+		}
+	//Phases:
+	for(const string& name: st.phaseOrder)
+	{	const MemStats::Phase& p = st.phases[name];
+		logPrintf("MEMSTATS-PHASE: %20s  peak %12.3lf MB (CPU) %12.3lf MB (GPU)  %10lu allocations of %14.3lf MB\n",
+			name.c_str(), p.peakTotal[0]*MB, p.peakTotal[1]*MB, p.nAlloc, p.bytesAlloc*MB);
+	}
+	//Top allocation sites by bytes:
+	std::vector<std::pair<size_t,const std::pair<const string,std::pair<size_t,size_t>>*>> sorted;
+	for(const auto& entry: st.sites)
+		sorted.push_back(std::make_pair(entry.second.second, &entry));
+	std::sort(sorted.begin(), sorted.end(), [](const decltype(sorted[0])& a, const decltype(sorted[0])& b) { return a.first > b.first; });
+	const size_t nSitesMax = 10;
+	if(sorted.size() > nSitesMax) sorted.resize(nSitesMax);
+	for(const auto& entry: sorted)
+		logPrintf("MEMSTATS-SITE: %40s  %10lu allocations of %14.3lf MB\n",
+			entry.second->first.c_str(), entry.second->second.first, entry.second->second.second*MB);
+	logFlush();
+	
+	//JSON file:
+	if(!statsPrefix.length()) return;
+	ostringstream oss; oss << statsPrefix << '.' << mpiWorld->iProcess() << ".json";
+	string fname = oss.str();
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(!fp)
+	{	logPrintf("Could not open '%s' for writing memory telemetry.\n", fname.c_str());
+		return;
+	}
+	fprintf(fp, "{\"process\":%d,\n\"categories\":[", mpiWorld->iProcess());
+	bool first = true;
+	for(const auto& entry: st.usage)
+	{	const MemStats::Usage& u = entry.second;
+		fprintf(fp, "%s\n{\"name\":", first ? "" : ","); first = false;
+		Profiler::jsonString(fp, entry.first.first);
+		fprintf(fp, ",\"space\":\"%s\",\"peakBytes\":%lu,\"currentBytes\":%lu,\"nAlloc\":%lu,\"allocBytes\":%lu}",
+			MemStats::spaceName[entry.first.second], u.peak, u.current, u.nAlloc, u.bytesAlloc);
+	}
+	fprintf(fp, "],\n\"phases\":[");
+	first = true;
+	for(const string& name: st.phaseOrder)
+	{	const MemStats::Phase& p = st.phases[name];
+		fprintf(fp, "%s\n{\"name\":", first ? "" : ","); first = false;
+		Profiler::jsonString(fp, name);
+		fprintf(fp, ",\"peakBytes\":{\"CPU\":%lu,\"GPU\":%lu},\"nAlloc\":%lu,\"allocBytes\":%lu,\"categoryPeakBytes\":[",
+			p.peakTotal[0], p.peakTotal[1], p.nAlloc, p.bytesAlloc);
+		bool firstCategory = true;
+		for(const auto& entry: p.peak)
+		{	fprintf(fp, "%s{\"name\":", firstCategory ? "" : ","); firstCategory = false;
+			Profiler::jsonString(fp, entry.first.first);
+			fprintf(fp, ",\"space\":\"%s\",\"peakBytes\":%lu}", MemStats::spaceName[entry.first.second], entry.second);
+		}
+		fprintf(fp, "]}");
+	}
+	fprintf(fp, "],\n\"sites\":[");
+	first = true;
+	for(const auto& entry: sorted)
+	{	fprintf(fp, "%s\n{\"name\":", first ? "" : ","); first = false;
+		Profiler::jsonString(fp, entry.second->first);
+		fprintf(fp, ",\"nAlloc\":%lu,\"allocBytes\":%lu}", entry.second->second.first, entry.second->second.second);
+	}
+	fprintf(fp, "]}\n");
+	fclose(fp);
+	logPrintf("Wrote memory telemetry to '%s.<process>.json'.\n", statsPrefix.c_str());
+}
+
+
 //-------- Memory pool to reduce system alloc/free calls ---------
 
 namespace MemPool
@@ -224,13 +440,17 @@ namespace MemPool
 			return (ret==cudaSuccess) ? ptr : 0;
 		}
 		static void free(void* ptr) { cudaFreeHost(ptr); }
-		static void outOfMemory() die_alone("Host memory allocation failed (out of pinned memory)\n");
+		static void outOfMemory() { MemStats::reportFailure(); die_alone("Host memory allocation failed (out of pinned memory)\n"); }
 	};
 	#else
 	struct MemSpaceCPU
-	{	static void* alloc(size_t size) { return fftw_malloc(size); }
+	{	static void* alloc(size_t size)
+		{	void* ptr = fftw_malloc(size);
+			if(ptr) firstTouch(ptr, size); //place pages near the threads that will process them (if pinned)
+			return ptr;
+		}
 		static void free(void* ptr) { fftw_free(ptr); }
-		static void outOfMemory() die_alone("Memory allocation failed (out of memory)\n");
+		static void outOfMemory() { MemStats::reportFailure(); die_alone("Memory allocation failed (out of memory)\n"); }
 	};
 	#endif
 	#ifdef GPU_ENABLED
@@ -245,7 +465,7 @@ namespace MemPool
 		{	assert(isGpuMine());
 			cudaFree(ptr);
 		}
-		static void outOfMemory() die_alone("GPU memory allocation failed (out of memory)\n");
+		static void outOfMemory() { MemStats::reportFailure(); die_alone("GPU memory allocation failed (out of memory)\n"); }
 	};
 	#endif
 	
@@ -257,25 +477,370 @@ namespace MemPool
 }
 
 
+//-------- Size-class cache of freed blocks to avoid repeated alloc/free (and cudaMalloc/cudaFree syncs) ---------
+
+namespace MemCache
+{
+	//Round up to a size class: 8 classes per power of two, wasting at most 12.5%
+	inline size_t sizeClass(size_t nBytes)
+	{	const size_t minClass = 256;
+		if(nBytes <= minClass) return minClass;
+		int log2size = 0; while((size_t(1) << (log2size+1)) <= nBytes) log2size++;
+		size_t step = size_t(1) << (log2size-3);
+		return ((nBytes + step - 1) / step) * step;
+	}
+	
+	//Cache freed blocks from a pool (MemPool::MemPool<MemSpace>) by category and size class,
+	//holding at most memcacheSize bytes of unused memory at any point
+	template<typename Pool> class MemCache
+	{	Pool& pool;
+		std::mutex lock; //for thread safety
+		std::map<std::pair<string,size_t>, std::vector<void*>> blocks; //(category, size class) -> cached free blocks
+		size_t nBytesCached, nBytesCachedPeak; //current and peak unused memory held in cache
+		struct Stats
+		{	size_t nHits, nMisses, nEvicted;
+			Stats() : nHits(0), nMisses(0), nEvicted(0) {}
+		};
+		std::map<string,Stats> stats; //hit/miss statistics by category
+		
+		//Release all blocks (lock must be held by caller)
+		void releaseAll()
+		{	for(auto& entry: blocks)
+				for(void* ptr: entry.second)
+					pool.free(ptr);
+			blocks.clear();
+			nBytesCached = 0;
+		}
+		
+	public:
+		MemCache(Pool& pool) : pool(pool), nBytesCached(0), nBytesCachedPeak(0) {}
+		~MemCache() { releaseAll(); }
+		
+		void* alloc(const string& category, size_t nBytes)
+		{	if(!memcacheSize) return pool.alloc(nBytes); //cache not in use
+			size_t size = sizeClass(nBytes);
+			std::lock_guard<std::mutex> guard(lock);
+			auto iter = blocks.find(std::make_pair(category, size));
+			if(iter!=blocks.end() && iter->second.size())
+			{	void* ptr = iter->second.back();
+				iter->second.pop_back();
+				nBytesCached -= size;
+				stats[category].nHits++;
+				return ptr;
+			}
+			stats[category].nMisses++;
+			return pool.alloc(size);
+		}
+		
+		void free(const string& category, size_t nBytes, void* ptr)
+		{	if(!memcacheSize) return pool.free(ptr); //cache not in use
+			size_t size = sizeClass(nBytes);
+			std::lock_guard<std::mutex> guard(lock);
+			if(nBytesCached + size > memcacheSize)
+			{	//Evict blocks of this size from other categories first, before giving up on caching this one:
+				for(auto& entry: blocks)
+					if(entry.first.second==size && entry.first.first!=category && entry.second.size())
+					{	pool.free(entry.second.back());
+						entry.second.pop_back();
+						nBytesCached -= size;
+						stats[entry.first.first].nEvicted++;
+						break;
+					}
+				if(nBytesCached + size > memcacheSize)
+				{	pool.free(ptr); //cache full: release directly
+					stats[category].nEvicted++;
+					return;
+				}
+			}
+			blocks[std::make_pair(category, size)].push_back(ptr);
+			nBytesCached += size;
+			if(nBytesCached > nBytesCachedPeak)
+				nBytesCachedPeak = nBytesCached;
+		}
+		
+		void print(const char* spaceName)
+		{	if(!memcacheSize) return;
+			std::lock_guard<std::mutex> guard(lock);
+			static const double bytesToGB = 1./pow(1024.,3);
+			for(auto entry: stats)
+				logPrintf("MEMCACHE(%s): %30s  hits: %10lu  misses: %8lu  evicted: %8lu\n", spaceName,
+					entry.first.c_str(), entry.second.nHits, entry.second.nMisses, entry.second.nEvicted);
+			logPrintf("MEMCACHE(%s): %30s %12.6lf GB\n", spaceName, "Peak unused", nBytesCachedPeak * bytesToGB);
+		}
+	};
+	
+	//Cache accessor functions (to avoid file-level static variables):
+	MemCache<MemPool::MemPool<MemPool::MemSpaceCPU>>& CPU() { static MemCache<MemPool::MemPool<MemPool::MemSpaceCPU>> cache(MemPool::CPU()); return cache; }
+	#ifdef GPU_ENABLED
+	MemCache<MemPool::MemPool<MemPool::MemSpaceGPU>>& GPU() { static MemCache<MemPool::MemPool<MemPool::MemSpaceGPU>> cache(MemPool::GPU()); return cache; }
+	#endif
+}
+
+
+//-------- Per-thread cache of small CPU blocks (eg. for the many tiny matrices) ---------
+
+namespace SmallBlocks
+{
+	const size_t nBytesMax = 1024; //largest block handled here (64 complex numbers)
+	const int nClasses = 7; //power-of-two size classes from 16 to nBytesMax bytes
+	const size_t nCachedMax = 256; //maximum free blocks held per class per thread
+	
+	inline bool handles(size_t nBytes) { return nBytes && nBytes<=nBytesMax; }
+	inline int sizeClass(size_t nBytes) { int iClass=0; while((size_t(16) << iClass) < nBytes) iClass++; return iClass; }
+	
+	//Free lists of the calling thread, which need no locking (blocks may be freed on a thread other than their allocating thread):
+	thread_local bool cacheDestroyed = false; //blocks freed during thread (or program) exit bypass the cache
+	struct Cache
+	{	std::vector<void*> blocks[nClasses];
+		~Cache()
+		{	for(int iClass=0; iClass<nClasses; iClass++)
+				for(void* ptr: blocks[iClass])
+					MemPool::MemSpaceCPU::free(ptr);
+			cacheDestroyed = true;
+		}
+	};
+	thread_local Cache cache;
+	
+	void* alloc(size_t nBytes)
+	{	int iClass = sizeClass(nBytes);
+		if(!cacheDestroyed)
+		{	std::vector<void*>& blocks = cache.blocks[iClass];
+			if(blocks.size())
+			{	void* ptr = blocks.back();
+				blocks.pop_back();
+				return ptr;
+			}
+		}
+		void* ptr = MemPool::MemSpaceCPU::alloc(size_t(16) << iClass);
+		if(!ptr) MemPool::MemSpaceCPU::outOfMemory();
+		return ptr;
+	}
+	
+	void free(size_t nBytes, void* ptr)
+	{	if(!cacheDestroyed)
+		{	std::vector<void*>& blocks = cache.blocks[sizeClass(nBytes)];
+			if(blocks.size() < nCachedMax) { blocks.push_back(ptr); return; }
+		}
+		MemPool::MemSpaceCPU::free(ptr);
+	}
+}
+
+//CPU allocations of ManagedMemoryBase: small blocks from the per-thread cache (bypassing the locks
+//and maps of MemCache and MemPool, which dominate for tiny matrices), and all others from MemCache
+inline void* cpuAlloc(const string& category, size_t nBytes)
+{	return SmallBlocks::handles(nBytes) ? SmallBlocks::alloc(nBytes) : MemCache::CPU().alloc(category, nBytes);
+}
+inline void cpuFree(const string& category, size_t nBytes, void* ptr)
+{	if(SmallBlocks::handles(nBytes)) SmallBlocks::free(nBytes, ptr);
+	else MemCache::CPU().free(category, nBytes, ptr);
+}
+
+
+//-------- Node-shared memory (MPI-3 shared-memory windows) for NodeSharedArray ---------
+
+bool nodeSharedEnabled()
+{
+	#if defined(MPI_ENABLED) && !defined(GPU_ENABLED) && (MPI_VERSION >= 3)
+	return mpiHost && mpiHost->nProcesses()>1;
+	#else
+	return false;
+	#endif
+}
+
+namespace NodeShared
+{
+	#if defined(MPI_ENABLED) && (MPI_VERSION >= 3)
+	std::map<const void*,MPI_Win>& windows() { static std::map<const void*,MPI_Win> win; return win; } //window of each allocation
+	std::mutex lock;
+	
+	void* alloc(size_t nBytes)
+	{	//Allocate all memory on the node head, and map it on the other processes:
+		MPI_Win win; void* ptr;
+		MPI_Win_allocate_shared(mpiHost->isHead() ? nBytes : 0, 1, MPI_INFO_NULL, mpiHost->communicator(), &ptr, &win);
+		MPI_Aint sizeHead; int dispUnit;
+		MPI_Win_shared_query(win, 0, &sizeHead, &dispUnit, &ptr);
+		std::lock_guard<std::mutex> guard(lock);
+		windows()[ptr] = win;
+		return ptr;
+	}
+	
+	void free(void* ptr)
+	{	int finalized; MPI_Finalized(&finalized);
+		if(finalized) return; //released by MPI_Finalize already (objects outliving finalizeSystem())
+		std::lock_guard<std::mutex> guard(lock);
+		auto iter = windows().find(ptr);
+		assert(iter != windows().end());
+		MPI_Win_free(&iter->second);
+		windows().erase(iter);
+	}
+	#endif
+}
+
+void nodeSharedCommit(const void* ptr)
+{	if(!nodeSharedEnabled() || !ptr) return;
+	#if defined(MPI_ENABLED) && (MPI_VERSION >= 3)
+	MPI_Win win;
+	{	std::lock_guard<std::mutex> guard(NodeShared::lock);
+		auto iter = NodeShared::windows().find(ptr);
+		assert(iter != NodeShared::windows().end());
+		win = iter->second;
+	}
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+	MPI_Win_sync(win); //complete writes on the writer
+	MPI_Barrier(mpiHost->communicator());
+	MPI_Win_sync(win); //make them visible on the readers
+	MPI_Win_unlock_all(win);
+	#endif
+}
+
+
 //---------- class ManagedMemoryBase -----------
 
 void ManagedMemoryBase::reportUsage()
 {	MemUsageReport::manager(MemUsageReport::Print);
+	MemCache::CPU().print("CPU");
+	#ifdef GPU_ENABLED
+	MemCache::GPU().print("GPU");
+	#endif
+	reportStats();
+}
+
+static ManagedMemoryBase::TransferStats transferStats; //only updated from the GPU owner thread
+
+ManagedMemoryBase::TransferStats ManagedMemoryBase::getTransferStats()
+{	return transferStats;
+}
+
+void ManagedMemoryBase::reportTransfers(const char* context, const TransferStats& since)
+{	TransferStats cur = transferStats;
+	size_t nToCpu = cur.nToCpu - since.nToCpu;
+	size_t nToGpu = cur.nToGpu - since.nToGpu;
+	if(!(nToCpu || nToGpu)) return;
+	logPrintf("\t%s: %lu transfers to CPU (%.2lf MB) and %lu to GPU (%.2lf MB)\n", context,
+		nToCpu, (cur.bytesToCpu - since.bytesToCpu)*1e-6, nToGpu, (cur.bytesToGpu - since.bytesToGpu)*1e-6);
+}
+
+//---------- GPU residency of evictable data (wavefunction offloading) ----------
+
+size_t ManagedMemoryBase::gpuBudget = 0;
+
+#ifdef GPU_ENABLED
+namespace GpuResidency
+{	//Evictable objects resident on the GPU, most recently used first (only accessed from the GPU owner thread):
+	typedef std::list<const ManagedMemoryBase*> List;
+	List lru;
+	std::map<const ManagedMemoryBase*, List::iterator> position;
+	size_t bytesResident = 0; //including pending prefetches
+	const size_t nProtected = 8; //most recently used objects are never evicted, since their GPU pointers may be in use by the current operation
+	
+	//Pending background transfers to the GPU:
+	struct Prefetch { void* cGpu; cudaEvent_t event; };
+	std::map<const ManagedMemoryBase*, Prefetch> prefetches;
+	cudaStream_t copyStream = 0; //non-blocking stream, so that transfers overlap computation on gpuStream
+}
+#endif
+
+void ManagedMemoryBase::residencyAdd() const
+{
+	#ifdef GPU_ENABLED
+	using namespace GpuResidency;
+	if(position.count(this)) return;
+	lru.push_front(this);
+	position[this] = lru.begin();
+	bytesResident += nBytes;
+	#endif
+}
+
+void ManagedMemoryBase::residencyRemove() const
+{
+	#ifdef GPU_ENABLED
+	using namespace GpuResidency;
+	auto iter = position.find(this);
+	if(iter == position.end()) return;
+	lru.erase(iter->second);
+	position.erase(iter);
+	bytesResident -= nBytes;
+	#endif
+}
+
+void ManagedMemoryBase::residencyTouch() const
+{
+	#ifdef GPU_ENABLED
+	using namespace GpuResidency;
+	auto iter = position.find(this);
+	if(iter == position.end() || iter->second == lru.begin()) return;
+	lru.splice(lru.begin(), lru, iter->second); //iterator remains valid
+	#endif
+}
+
+bool ManagedMemoryBase::prefetchCancel() const
+{
+	#ifdef GPU_ENABLED
+	using namespace GpuResidency;
+	if(!prefetches.size()) return false;
+	auto iter = prefetches.find(this);
+	if(iter == prefetches.end()) return false;
+	cudaEventSynchronize(iter->second.event);
+	cudaEventDestroy(iter->second.event);
+	MemCache::GPU().free(category, nBytes, iter->second.cGpu);
+	prefetches.erase(iter);
+	bytesResident -= nBytes;
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+void ManagedMemoryBase::residencyEvict(size_t nBytesNeeded)
+{
+	#ifdef GPU_ENABLED
+	using namespace GpuResidency;
+	while(bytesResident + nBytesNeeded > gpuBudget && lru.size() > nProtected)
+		lru.back()->toCpu(); //removes it from lru
+	#endif
+}
+
+void ManagedMemoryBase::prefetchGpu() const
+{
+	#ifdef GPU_ENABLED
+	using namespace GpuResidency;
+	if(onGpu || !c || !isEvictable() || prefetches.count(this)) return;
+	assert(isGpuMine());
+	residencyEvict(nBytes);
+	if(!copyStream) cudaStreamCreateWithFlags(&copyStream, cudaStreamNonBlocking);
+	Prefetch p;
+	p.cGpu = MemCache::GPU().alloc(category, nBytes);
+	cudaMemcpyAsync(p.cGpu, c, nBytes, cudaMemcpyHostToDevice, copyStream); //asynchronous only from page-locked memory (PinnedHostMemory)
+	cudaEventCreateWithFlags(&p.event, cudaEventDisableTiming);
+	cudaEventRecord(p.event, copyStream);
+	prefetches[this] = p;
+	bytesResident += nBytes;
+	transferStats.nToGpu++;
+	transferStats.bytesToGpu += nBytes;
+	#endif
 }
 
 //Free memory
 void ManagedMemoryBase::memFree()
 {	if(!nBytes) return; //nothing to free
+	if(gpuBudget)
+	{	prefetchCancel();
+		residencyRemove();
+	}
 	if(onGpu)
 	{
 		#ifdef GPU_ENABLED
-		MemPool::GPU().free(c);
+		MemCache::GPU().free(category, nBytes, c);
 		#else
 		assert(!"onGpu=true without GPU_ENABLED"); //Should never get here!
 		#endif
 	}
-	else MemPool::CPU().free(c);
+	#if defined(MPI_ENABLED) && (MPI_VERSION >= 3)
+	else if(category=="NodeShared" && nodeSharedEnabled()) NodeShared::free(c);
+	#endif
+	else cpuFree(category, nBytes, c);
 	MemUsageReport::manager(MemUsageReport::Remove, category, nBytes);
+	MemStats::update(category, nBytes, onGpu, false, false);
 	onGpu = false;
 	c = 0;
 	nBytes = 0;
@@ -289,51 +854,104 @@ void ManagedMemoryBase::memInit(string category, size_t nBytes, bool onGpu)
 	this->category = category;
 	this->nBytes = nBytes;
 	this->onGpu = onGpu;
+	MemStats::pendingCategory = &this->category; MemStats::pendingBytes = nBytes;
 	if(onGpu)
 	{
 		#ifdef GPU_ENABLED
-		c = MemPool::GPU().alloc(nBytes);
+		if(isEvictable()) residencyEvict(nBytes);
+		c = MemCache::GPU().alloc(category, nBytes);
+		if(isEvictable()) residencyAdd();
 		#else
 		assert(!"onGpu=true without GPU_ENABLED");
 		#endif
 	}
-	else c = MemPool::CPU().alloc(nBytes);
+	#if defined(MPI_ENABLED) && (MPI_VERSION >= 3)
+	else if(category=="NodeShared" && nodeSharedEnabled() && nBytes) c = NodeShared::alloc(nBytes);
+	#endif
+	else c = cpuAlloc(category, nBytes);
+	MemStats::pendingCategory = 0;
 	MemUsageReport::manager(MemUsageReport::Add, category, nBytes);
+	MemStats::update(category, nBytes, onGpu, true, true);
 }
 
 void ManagedMemoryBase::memMove(ManagedMemoryBase&& mOther)
-{	std::swap(category, mOther.category);
+{	if(gpuBudget) //residency is tracked by object, so re-register after the swap:
+	{	prefetchCancel(); mOther.prefetchCancel();
+		residencyRemove(); mOther.residencyRemove();
+	}
+	std::swap(category, mOther.category);
 	std::swap(nBytes, mOther.nBytes);
 	std::swap(onGpu, mOther.onGpu);
 	std::swap(c, mOther.c);
 	//Now mOther will be empty, while *this will have all its contents
+	if(gpuBudget)
+	{	if(onGpu && isEvictable()) residencyAdd();
+		if(mOther.onGpu && mOther.isEvictable()) mOther.residencyAdd();
+	}
 }
 
 //Move data to CPU
 void ManagedMemoryBase::toCpu() const
-{	if(!onGpu || !c) return; //already on cpu, or no data
+{	if(!onGpu || !c) //already on cpu, or no data
+	{	if(gpuBudget) prefetchCancel(); //CPU data may be modified after this
+		return;
+	}
 #ifdef GPU_ENABLED
 	assert(isGpuMine());
+	if(gpuBudget) residencyRemove();
 	ManagedMemoryBase& me = *((ManagedMemoryBase*)this);
-	void* cCpu = MemPool::CPU().alloc(nBytes);
+	void* cCpu = cpuAlloc(category, nBytes);
+	static StopWatch watch("toCpu(transfer)"); watch.start();
 	cudaMemcpy(cCpu, me.c, nBytes, cudaMemcpyDeviceToHost);
-	MemPool::GPU().free(me.c); //Free GPU mem
+	watch.stop();
+	transferStats.nToCpu++;
+	transferStats.bytesToCpu += nBytes;
+	MemCache::GPU().free(category, nBytes, me.c); //Free GPU mem
 	me.c = cCpu; //Make c a cpu pointer
 	me.onGpu = false;
+	MemStats::update(category, nBytes, false, true, false);
+	MemStats::update(category, nBytes, true, false, false);
 #endif
 }
 
 // Move data to GPU
 void ManagedMemoryBase::toGpu() const
-{	if(onGpu || !c) return; //already on gpu, or no data
+{	if(onGpu || !c) //already on gpu, or no data
+	{	if(gpuBudget && onGpu) residencyTouch();
+		return;
+	}
 #ifdef GPU_ENABLED
 	assert(isGpuMine());
 	ManagedMemoryBase& me = *((ManagedMemoryBase*)this);
-	void* cGpu = MemPool::GPU().alloc(nBytes);
+	if(gpuBudget && GpuResidency::prefetches.count(this)) //complete background transfer
+	{	GpuResidency::Prefetch& p = GpuResidency::prefetches[this];
+		static StopWatch watch("toGpu(prefetched)"); watch.start();
+		cudaEventSynchronize(p.event);
+		watch.stop();
+		cudaEventDestroy(p.event);
+		cpuFree(category, nBytes, me.c); //Free CPU mem
+		me.c = p.cGpu; //Make c a gpu pointer
+		me.onGpu = true;
+		MemStats::update(category, nBytes, true, true, false);
+		MemStats::update(category, nBytes, false, false, false);
+		GpuResidency::prefetches.erase(this);
+		GpuResidency::bytesResident -= nBytes; //counted again below
+		residencyAdd();
+		return;
+	}
+	if(isEvictable()) residencyEvict(nBytes);
+	void* cGpu = MemCache::GPU().alloc(category, nBytes);
+	static StopWatch watch("toGpu(transfer)"); watch.start();
 	cudaMemcpy(cGpu, me.c, nBytes, cudaMemcpyHostToDevice);
-	MemPool::CPU().free(me.c); //Free CPU mem
+	watch.stop();
+	transferStats.nToGpu++;
+	transferStats.bytesToGpu += nBytes;
+	cpuFree(category, nBytes, me.c); //Free CPU mem
 	me.c = cGpu; //Make c a gpu pointer
 	me.onGpu = true;
+	MemStats::update(category, nBytes, true, true, false);
+	MemStats::update(category, nBytes, false, false, false);
+	if(isEvictable()) residencyAdd();
 #else
 	assert(!"toGpu() called without GPU_ENABLED");
 #endif
@@ -35,6 +35,33 @@ class ManagedMemoryBase
 {
 public:
 	static void reportUsage(); //!< print memory usage report
+	
+	//! Count and size of host-device transfers of managed memory (always zero without GPU_ENABLED)
+	struct TransferStats
+	{	size_t nToCpu, nToGpu; //!< number of transfers in each direction
+		size_t bytesToCpu, bytesToGpu; //!< total bytes transferred in each direction
+		TransferStats() : nToCpu(0), nToGpu(0), bytesToCpu(0), bytesToGpu(0) {}
+		size_t nTransfers() const { return nToCpu + nToGpu; }
+	};
+	static TransferStats getTransferStats(); //!< cumulative transfers since start of run
+	static void reportTransfers(const char* context, const TransferStats& since); //!< log transfers since a previous getTransferStats() snapshot, if any
+	
+	//! If non-zero (GPU builds only), the maximum bytes of wavefunction (ColumnBundle) data resident on the GPU.
+	//! Beyond this, the least-recently used ColumnBundles are moved to host memory (page-locked with PinnedHostMemory),
+	//! and moved back on their next GPU access or in the background by prefetchGpu(). See command wavefunction-offload.
+	static size_t gpuBudget;
+	
+	//! Memory telemetry (enabled by environment variables JDFTX_MEMSTATS and JDFTX_MEMCAP, see initSystem):
+	//! current and peak bytes, allocation counts and bytes allocated by category and memory space, peaks by phase
+	//! of the calculation (see setPhase) and by allocating code section (innermost StopWatch, when profiling).
+	//! Reported in the log at the end of the run (see reportUsage), and if statsPrefix is set, as JSON in <statsPrefix>.<process>.json.
+	static bool statsEnabled; //!< whether telemetry is collected
+	static string statsPrefix; //!< if non-empty, also write telemetry as JSON to files with this prefix
+	static size_t softCap; //!< if non-zero, report telemetry and abort when either memory space exceeds this many bytes
+	static void setPhase(const string& phase); //!< attribute subsequent peaks to named phase (phases of the same name are merged)
+	static string getPhase(); //!< current phase (initially "setup")
+	static void reportIteration(const char* context, int iter); //!< log peak and allocations since the previous call (if statsEnabled)
+	static void reportStats(); //!< log telemetry and write JSON file (if statsEnabled)
 
 protected:
 	ManagedMemoryBase(): nBytes(0),c(0),onGpu(false) {} //!< Initialize a valid state, but don't allocate anything
@@ -50,6 +77,16 @@ protected:
 	bool onGpu; //!< For reduced \#ifdef's, this flag is retained even in the absence of gpu support
 	void toCpu() const; //!< move data to the CPU (does nothing without GPU_ENABLED); logically const, but data location may change
 	void toGpu() const; //!< move data to the GPU (does nothing without GPU_ENABLED); logically const, but data location may change
+	void prefetchGpu() const; //!< start moving data to the GPU in the background, completed by the next toGpu() (only with gpuBudget, does nothing otherwise)
+
+private:
+	//Residency tracking of evictable data on the GPU (used only with gpuBudget):
+	bool isEvictable() const { return gpuBudget && category=="ColumnBundle"; }
+	void residencyAdd() const; //!< register as most recently used, when moved to / allocated on the GPU
+	void residencyRemove() const; //!< unregister, when moved off / freed from the GPU
+	void residencyTouch() const; //!< mark as most recently used
+	bool prefetchCancel() const; //!< discard pending prefetch (if any), and return whether there was one
+	static void residencyEvict(size_t nBytesNeeded); //!< move least-recently used data to the CPU till nBytesNeeded fit within gpuBudget
 };
 
 //! Base class for managed memory of a specified data type
@@ -86,6 +123,7 @@ public:
 	const T* dataGpu() const { toGpu(); return (const T*)c; } //!< Get a const GPU data pointer (must be called from GPU owner thread)
 	#endif
 
+	void prefetchGpu() const { ManagedMemoryBase::prefetchGpu(); } //!< start moving data to the GPU in the background when gpuBudget is in use (see ManagedMemoryBase::gpuBudget)
 	size_t nData() const { return nElem; } //!< number of data points
 	bool isOnGpu() const { return onGpu; } //!< Check where the data is (for \#ifdef simplicity exposed even when no GPU_ENABLED)
 
@@ -145,6 +183,20 @@ struct IndexVecArray : public ManagedMemory<vector3<int>>
 };
 
 
+bool nodeSharedEnabled(); //!< whether NodeSharedArray is actually shared between processes (same result on all processes)
+void nodeSharedCommit(const void* ptr); //!< synchronize writes to the NodeSharedArray data at ptr (collective over mpiHost)
+
+//! Large read-only array stored once per node, in an MPI-3 shared-memory window over mpiHost (CPU-only MPI builds),
+//! or privately on each process otherwise (eg. with GPUs, where each process needs its own device copy anyway).
+//! init() must be called on all processes of the node together; then only processes with isWriter() fill the data,
+//! followed by a collective commit() before any process reads it. The memory is also released collectively.
+template<typename T> struct NodeSharedArray : public ManagedMemory<T>
+{	void init(size_t size) { ManagedMemory<T>::memInit("NodeShared", size); } //!< allocate (collective)
+	bool isWriter() const { return !nodeSharedEnabled() || mpiHost->isHead(); } //!< whether this process should fill the data
+	void commit() { nodeSharedCommit(this->data()); } //!< make the data written by the writer visible to all processes (collective)
+	~NodeSharedArray() { ManagedMemory<T>::memFree(); }
+};
+
 //Some common elementwise / vector-like operations
 template<typename T> void memcpy(ManagedMemory<T>&, const ManagedMemory<T>&); //!< copy entire object over
 void scale(double alpha, ManagedMemory<double>& y); //! scale y *= alpha
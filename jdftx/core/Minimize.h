@@ -65,6 +65,13 @@ template<typename Vector> struct Minimizable
 	//! Override to return maximum safe step size along a given direction. Steps can be arbitrarily large by default.
 	virtual double safeStepSize(const Vector& dir) const { return DBL_MAX; }
 	
+	//! Override to persist the L-BFGS curvature history, so that a restarted minimization resumes without losing it.
+	//! Called after each history update with scalars = {gamma, rho_1, ...} and vectors = {s_1, Ky_1, ...} (oldest first).
+	virtual void saveHistory(const std::vector<const Vector*>& vectors, const std::vector<double>& scalars) {}
+	
+	//! Override to load a history saved by saveHistory (in the same layout) at the start of L-BFGS; return whether one was loaded
+	virtual bool loadHistory(std::vector<Vector>& vectors, std::vector<double>& scalars) { return false; }
+	
 	//! Minimize this objective function with algorithm controlled by params and return the minimized value
 	double minimize(const MinimizeParams& params);
 	
@@ -76,6 +83,7 @@ private:
 	typedef bool (*Linmin)(Minimizable<Vector>&, const MinimizeParams&, const Vector&, double, double&, double&, Vector&, Vector&);
 	Linmin getLinmin(const MinimizeParams& params) const; //!< Return function pointer to appropriate linmin method based on MinimizeParams
 	double lBFGS(const MinimizeParams& params); //!< limited memory BFGS implementation (differs sufficiently from CG to be justify a separate implementation)
+	double fire(const MinimizeParams& params); //!< FIRE implementation (dynamics rather than line minimization based)
 };
 
 /** Interface (abstract base class) for linear conjugate gradients template which
@@ -117,10 +125,12 @@ public:
 
 #include <core/Minimize_linmin.h>
 #include <core/Minimize_lBFGS.h>
+#include <core/Minimize_FIRE.h>
 
 template<typename Vector> double Minimizable<Vector>::minimize(const MinimizeParams& p)
 {	if(p.fdTest) fdTest(p); // finite difference test
 	if(p.dirUpdateScheme == MinimizeParams::LBFGS) return lBFGS(p);
+	if(p.dirUpdateScheme == MinimizeParams::FIRE) return fire(p);
 	
 	Vector g, gPrev, Kg; //current, previous and preconditioned gradients
 	double E = sync(compute(&g, &Kg)); //get initial energy and gradient
@@ -181,7 +191,8 @@ template<typename Vector> double Minimizable<Vector>::minimize(const MinimizePar
 				case MinimizeParams::PolakRibiere:    beta = (gKNorm-dotgPrevKg)/gKNormPrev; break;
 				case MinimizeParams::HestenesStiefel: beta = (gKNorm-dotgPrevKg)/(dotgd-sync(dot(d,gPrev))); break;
 				case MinimizeParams::SteepestDescent: beta = 0.0; break;
-				case MinimizeParams::LBFGS: break; //Should never encounter since LBFGS handled separately; just to eliminate compiler warnings
+				case MinimizeParams::LBFGS: //Should never encounter since LBFGS and FIRE handled separately; just to eliminate compiler warnings
+				case MinimizeParams::FIRE: break;
 			}
 			if(beta<0.0)
 			{	fprintf(p.fpLog, "\n%sEncountered beta<0, resetting CG.", p.linePrefix);
@@ -190,6 +201,7 @@ template<typename Vector> double Minimizable<Vector>::minimize(const MinimizePar
 		}
 		forceGradDirection = false;
 		fprintf(p.fpLog, "\n"); fflush(p.fpLog);
+		if(p.metrics) p.metrics(iter, E, sqrt(gKNorm/p.nDim));
 		if(sqrt(gKNorm/p.nDim) < p.knormThreshold)
 		{	fprintf(p.fpLog, "%sConverged (|grad|_K<%le).\n", p.linePrefix, p.knormThreshold);
 			fflush(p.fpLog); return E;
@@ -20,6 +20,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef JDFTX_CORE_MINIMIZEPARAMS_H
 #define JDFTX_CORE_MINIMIZEPARAMS_H
 
+#include <functional>
+
 #include <cstdio>
 
 //! @addtogroup Algorithms
@@ -34,7 +36,8 @@ struct MinimizeParams
 		FletcherReeves, //!< Fletcher-Reeves (preconditioned) conjugate gradients
 		HestenesStiefel, //!< Hestenes-Stiefel (preconditioned) conjugate gradients
 		LBFGS, //!< Limited memory version of the BFGS algorithm
-		SteepestDescent //!< Steepest Descent (always along negative (preconditioned) gradient)
+		SteepestDescent, //!< Steepest Descent (always along negative (preconditioned) gradient)
+		FIRE //!< Fast inertial relaxation engine: damped dynamics with adaptive time step (no line minimization)
 	} dirUpdateScheme;
 
 	//! Line minimization method
@@ -69,6 +72,8 @@ struct MinimizeParams
 	
 	bool fdTest; //!< whether to perform a finite difference test before each minimization (default false)
 	
+	std::function<void(int iter, double E, double gradNorm)> metrics; //!< if set, called (collectively) once per iteration after logging, eg. for a metrics stream (see Dump::metrics)
+	
 	//! Set the default values
 	MinimizeParams() 
 	: dirUpdateScheme(PolakRibiere), linminMethod(DirUpdateRecommended),
@@ -0,0 +1,133 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_CORE_MINIMIZE_FIRE_H
+#define JDFTX_CORE_MINIMIZE_FIRE_H
+
+//! @addtogroup Algorithms
+//! @{
+
+//! FIRE algorithm following \cite FIRE, using the (negative) preconditioned gradient as the force on unit masses.
+//! The time step starts at alphaTstart, and each step is additionally limited by safeStepSize.
+template<typename Vector> double Minimizable<Vector>::fire(const MinimizeParams& p)
+{	
+	Vector g, Kg; //gradient and preconditioned gradient
+	double E = sync(compute(&g, &Kg)); //get initial energy and gradient
+	EdiffCheck ediffCheck(p.nEnergyDiff, p.energyDiffThreshold); //list of past energies
+	
+	//Parameters recommended in the reference:
+	const int nMin = 5; //number of downhill steps before increasing time step
+	const double fInc = 1.1, fDec = 0.5; //time step increase / decrease factors
+	const double mixStart = 0.1, fMix = 0.99; //initial velocity mixing and its decay factor
+	const double dtMax = 10.*p.alphaTstart; //maximum time step
+	double dt = p.alphaTstart, mix = mixStart;
+	int nDownhill = 0;
+	
+	Vector v = clone(Kg); v *= 0.; //velocity
+	
+	//Iterate until convergence, max iteration count or kill signal
+	int iter=0;
+	for(iter=0; !killFlag; iter++)
+	{	
+		if(report(iter)) //optional reporting/processing
+		{	E = sync(compute(&g, &Kg)); //update energy and gradient if state was modified
+			fprintf(p.fpLog, "%s\tState modified externally: resetting velocities.\n", p.linePrefix);
+			fflush(p.fpLog);
+			v *= 0.;
+		}
+		
+		double gKnorm = sync(dot(g,Kg));
+		fprintf(p.fpLog, "%sIter: %3d  %s: ", p.linePrefix, iter, p.energyLabel);
+		fprintf(p.fpLog, p.energyFormat, E);
+		fprintf(p.fpLog, "  |grad|_K: %10.3le  dt: %10.3le  t[s]: %9.2lf", sqrt(gKnorm/p.nDim), dt, clock_sec());
+		
+		//Check stopping conditions:
+		fprintf(p.fpLog, "\n"); fflush(p.fpLog);
+		if(p.metrics) p.metrics(iter, E, sqrt(gKnorm/p.nDim));
+		if(sqrt(gKnorm/p.nDim) < p.knormThreshold)
+		{	fprintf(p.fpLog, "%sConverged (|grad|_K<%le).\n", p.linePrefix, p.knormThreshold);
+			fflush(p.fpLog); return E;
+		}
+		if(ediffCheck.checkConvergence(E))
+		{	fprintf(p.fpLog, "%sConverged (|Delta %s|<%le for %d iters).\n",
+				p.linePrefix, p.energyLabel, p.energyDiffThreshold, p.nEnergyDiff);
+			fflush(p.fpLog); return E;
+		}
+		if(!std::isfinite(gKnorm))
+		{	fprintf(p.fpLog, "%s|grad|_K=%le. Stopping ...\n", p.linePrefix, gKnorm);
+			fflush(p.fpLog); return E;
+		}
+		if(!std::isfinite(E))
+		{	fprintf(p.fpLog, "%sE=%le. Stopping ...\n", p.linePrefix, E);
+			fflush(p.fpLog); return E;
+		}
+		if(iter>=p.nIterations) break;
+		
+		//Mix velocity towards the force while moving downhill, and stop otherwise:
+		double power = -sync(dot(Kg, v));
+		if(power > 0.)
+		{	double vNorm = sqrt(sync(dot(v, v)));
+			double fNorm = sqrt(sync(dot(Kg, Kg)));
+			v *= (1.-mix);
+			axpy(-mix*vNorm/fNorm, Kg, v);
+			if(++nDownhill > nMin)
+			{	dt = std::min(dt*fInc, dtMax);
+				mix *= fMix;
+			}
+		}
+		else
+		{	v *= 0.;
+			dt *= fDec;
+			mix = mixStart;
+			nDownhill = 0;
+		}
+		
+		//Semi-implicit Euler step:
+		axpy(-dt, Kg, v);
+		constrain(v); //restrict velocity to allowed subspace
+		double alpha = std::min(dt, safeStepSize(v));
+		step(v, alpha);
+		E = sync(compute(&g, &Kg));
+		while(!std::isfinite(E))
+		{	fprintf(p.fpLog, "%s\tStep failed with %s=%le: undoing step and reducing time step.\n", p.linePrefix, p.energyLabel, E);
+			fflush(p.fpLog);
+			step(v, -alpha);
+			v *= 0.;
+			dt *= fDec; alpha *= fDec;
+			nDownhill = 0; mix = mixStart;
+			if(dt < p.alphaTmin)
+			{	fprintf(p.fpLog, "%sTime step below alphaTmin. (Stopping)\n", p.linePrefix);
+				fflush(p.fpLog);
+				return sync(compute(&g, &Kg));
+			}
+			//Retry a reduced steepest-descent step from the previous state:
+			E = sync(compute(&g, &Kg));
+			axpy(-dt, Kg, v);
+			constrain(v);
+			alpha = std::min(dt, safeStepSize(v));
+			step(v, alpha);
+			E = sync(compute(&g, &Kg));
+		}
+	}
+	fprintf(p.fpLog, "%sNone of the convergence criteria satisfied after %d iterations.\n", p.linePrefix, iter);
+	return E;
+}
+
+//! @}
+#endif //JDFTX_CORE_MINIMIZE_FIRE_H
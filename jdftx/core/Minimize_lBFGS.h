@@ -47,6 +47,33 @@ template<typename Vector> double Minimizable<Vector>::lBFGS(const MinimizeParams
 	std::list< std::shared_ptr<History> > history;
 	double gamma = 0.; //scaling: set to dot(s,y)/dot(y,Ky) each iteration
 	
+	//Resume a saved history, if available:
+	{	std::vector<Vector> vectors; std::vector<double> scalars;
+		if(loadHistory(vectors, scalars) && scalars.size() && vectors.size()==2*(scalars.size()-1))
+		{	gamma = scalars[0];
+			size_t nSaved = scalars.size()-1;
+			size_t iStart = nSaved - std::min(nSaved, size_t(std::max(p.history, 0))); //keep the newest p.history entries
+			for(size_t i=iStart; i<nSaved; i++)
+			{	auto h = std::make_shared<History>();
+				h->s = vectors[2*i];
+				h->Ky = vectors[2*i+1];
+				h->rho = scalars[i+1];
+				history.push_back(h);
+			}
+			fprintf(p.fpLog, "%s\tResuming with %d saved history entries.\n", p.linePrefix, int(history.size()));
+			fflush(p.fpLog);
+		}
+	}
+	auto persistHistory = [&]()
+	{	std::vector<const Vector*> vectors; std::vector<double> scalars(1, gamma);
+		for(const auto& h: history)
+		{	vectors.push_back(&h->s);
+			vectors.push_back(&h->Ky);
+			scalars.push_back(h->rho);
+		}
+		saveHistory(vectors, scalars);
+	};
+	
 	//Select the linmin method:
 	Linmin linmin = getLinmin(p);
 	
@@ -71,6 +98,7 @@ template<typename Vector> double Minimizable<Vector>::lBFGS(const MinimizeParams
 		
 		//Check stopping conditions:
 		fprintf(p.fpLog, "\n"); fflush(p.fpLog);
+		if(p.metrics) p.metrics(iter, E, sqrt(gKnorm/p.nDim));
 		if(sqrt(gKnorm/p.nDim) < p.knormThreshold)
 		{	fprintf(p.fpLog, "%sConverged (|grad|_K<%le).\n", p.linePrefix, p.knormThreshold);
 			fflush(p.fpLog); return E;
@@ -126,6 +154,7 @@ template<typename Vector> double Minimizable<Vector>::lBFGS(const MinimizeParams
 				history.clear();
 				gamma = 0.;
 				linminTest = 0.;
+				persistHistory();
 				continue;
 			}
 			else
@@ -146,6 +175,7 @@ template<typename Vector> double Minimizable<Vector>::lBFGS(const MinimizeParams
 		h->rho = 1./ydots;
 		gamma = ydots / sync(dot(y, h->Ky));
 		history.push_back(h);
+		persistHistory();
 	}
 	fprintf(p.fpLog, "%sNone of the convergence criteria satisfied after %d iterations.\n", p.linePrefix, iter);
 	return E;
@@ -124,10 +124,17 @@ complexScalarFieldTilde O(const complexScalarFieldTilde& in) { return in * in->g
 complexScalarFieldTilde O(complexScalarFieldTilde&& in) { return in *= in->gInfo.detR; }
 
 
+//Nominal work of an FFT of one grid for the roofline summary (see StopWatch::addWork),
+//counting 5 N log2(N) operations and one pass over input and output for complex data, and half of each for real data
+inline double fftFlops(const GridInfo& gInfo, bool real) { return (real ? 2.5 : 5.) * gInfo.nr * log2(gInfo.nr); }
+inline double fftBytes(const GridInfo& gInfo, bool real) { return (real ? 16. : 32.) * gInfo.nr; }
+
 //Forward transform
 ScalarField I(ScalarFieldTilde&& in, int nThreads)
 {	//CPU c2r transforms destroy input, but this input can be destroyed
 	ScalarField out(ScalarFieldData::alloc(in->gInfo, isGpuEnabled()));
+	static StopWatch watch("I(fft)"); watch.start();
+	watch.addWork(fftFlops(in->gInfo, true), fftBytes(in->gInfo, true));
 	#ifdef GPU_ENABLED
 	cufftExecZ2D(in->gInfo.planZ2D, (double2*)in->dataGpu(false), out->dataGpu(false));
 	#else
@@ -135,6 +142,7 @@ ScalarField I(ScalarFieldTilde&& in, int nThreads)
 	fftw_execute_dft_c2r(in->gInfo.getPlan(GridInfo::PlanCtoR, nThreads),
 		(fftw_complex*)in->data(false), out->data(false));
 	#endif
+	watch.stop();
 	out->scale = in->scale;
 	return out;
 }
@@ -148,6 +156,8 @@ ScalarField I(const ScalarFieldTilde& in, int nThreads)
 }
 complexScalarField I(const complexScalarFieldTilde& in, int nThreads)
 {	complexScalarField out(complexScalarFieldData::alloc(in->gInfo, isGpuEnabled()));
+	static StopWatch watch("I(fft)"); watch.start();
+	watch.addWork(fftFlops(in->gInfo, false), fftBytes(in->gInfo, false));
 	#ifdef GPU_ENABLED
 	cufftExecZ2Z(in->gInfo.planZ2Z, (double2*)in->dataGpu(false), (double2*)out->dataGpu(false), CUFFT_INVERSE);
 	#else
@@ -155,11 +165,14 @@ complexScalarField I(const complexScalarFieldTilde& in, int nThreads)
 	fftw_execute_dft(in->gInfo.getPlan(GridInfo::PlanInverse, nThreads),
 		(fftw_complex*)in->data(false), (fftw_complex*)out->data(false));
 	#endif
+	watch.stop();
 	out->scale = in->scale;
 	return out;
 }
 complexScalarField I(complexScalarFieldTilde&& in, int nThreads)
 {	//Destructible input (transform in place):
+	static StopWatch watch("I(fft)"); watch.start();
+	watch.addWork(fftFlops(in->gInfo, false), fftBytes(in->gInfo, false));
 	#ifdef GPU_ENABLED
 	cufftExecZ2Z(in->gInfo.planZ2Z, (double2*)in->dataGpu(false), (double2*)in->dataGpu(false), CUFFT_INVERSE);
 	#else
@@ -167,6 +180,7 @@ complexScalarField I(complexScalarFieldTilde&& in, int nThreads)
 	fftw_execute_dft(in->gInfo.getPlan(GridInfo::PlanInverseInPlace, nThreads),
 		(fftw_complex*)in->data(false), (fftw_complex*)in->data(false));
 	#endif
+	watch.stop();
 	return std::static_pointer_cast<complexScalarFieldData>(std::static_pointer_cast<FieldData<complex>>(in));
 }
 
@@ -174,6 +188,8 @@ complexScalarField I(complexScalarFieldTilde&& in, int nThreads)
 ScalarFieldTilde Idag(const ScalarField& in, int nThreads)
 {	//r2c transform does not destroy input (no backing up needed)
 	ScalarFieldTilde out(ScalarFieldTildeData::alloc(in->gInfo, isGpuEnabled()));
+	static StopWatch watch("Idag(fft)"); watch.start();
+	watch.addWork(fftFlops(in->gInfo, true), fftBytes(in->gInfo, true));
 	#ifdef GPU_ENABLED
 	cufftExecD2Z(in->gInfo.planD2Z, in->dataGpu(false), (double2*)out->dataGpu(false));
 	#else
@@ -181,11 +197,14 @@ ScalarFieldTilde Idag(const ScalarField& in, int nThreads)
 	fftw_execute_dft_r2c(in->gInfo.getPlan(GridInfo::PlanRtoC, nThreads),
 		in->data(false), (fftw_complex*)out->data(false));
 	#endif
+	watch.stop();
 	out->scale = in->scale;
 	return out;
 }
 complexScalarFieldTilde Idag(const complexScalarField& in, int nThreads)
 {	complexScalarFieldTilde out(complexScalarFieldTildeData::alloc(in->gInfo, isGpuEnabled()));
+	static StopWatch watch("Idag(fft)"); watch.start();
+	watch.addWork(fftFlops(in->gInfo, false), fftBytes(in->gInfo, false));
 	#ifdef GPU_ENABLED
 	cufftExecZ2Z(in->gInfo.planZ2Z, (double2*)in->dataGpu(false), (double2*)out->dataGpu(false), CUFFT_FORWARD);
 	#else
@@ -193,11 +212,14 @@ complexScalarFieldTilde Idag(const complexScalarField& in, int nThreads)
 	fftw_execute_dft(in->gInfo.getPlan(GridInfo::PlanForward, nThreads),
 		(fftw_complex*)in->data(false), (fftw_complex*)out->data(false));
 	#endif
+	watch.stop();
 	out->scale = in->scale;
 	return out;
 }
 complexScalarFieldTilde Idag(complexScalarField&& in, int nThreads)
 {	//Destructible input (transform in place):
+	static StopWatch watch("Idag(fft)"); watch.start();
+	watch.addWork(fftFlops(in->gInfo, false), fftBytes(in->gInfo, false));
 	#ifdef GPU_ENABLED
 	cufftExecZ2Z(in->gInfo.planZ2Z, (double2*)in->dataGpu(false), (double2*)in->dataGpu(false), CUFFT_FORWARD);
 	#else
@@ -205,9 +227,80 @@ complexScalarFieldTilde Idag(complexScalarField&& in, int nThreads)
 	fftw_execute_dft(in->gInfo.getPlan(GridInfo::PlanForwardInPlace, nThreads),
 		(fftw_complex*)in->data(false), (fftw_complex*)in->data(false));
 	#endif
+	watch.stop();
 	return std::static_pointer_cast<complexScalarFieldTildeData>(std::static_pointer_cast<FieldData<complex>>(in));
 }
 
+//Batched transforms
+//--- single-precision version (used while GridInfo::batchSinglePrecision is set):
+void convertToSingle_sub(size_t iStart, size_t iStop, const complex* in, float* out)
+{	for(size_t i=iStart; i<iStop; i++)
+	{	out[2*i] = float(in[i].real());
+		out[2*i+1] = float(in[i].imag());
+	}
+}
+void convertFromSingle_sub(size_t iStart, size_t iStop, const float* in, complex* out)
+{	for(size_t i=iStart; i<iStop; i++)
+		out[i] = complex(in[2*i], in[2*i+1]);
+}
+#ifdef GPU_ENABLED
+void convertToSingle_gpu(size_t N, const complex* in, float* out);
+void convertFromSingle_gpu(size_t N, const float* in, complex* out);
+#endif
+void fftBatchSingle(const GridInfo& gInfo, complex* data, int nBatch, int nThreads, bool inverse)
+{	size_t N = size_t(gInfo.nr) * nBatch;
+	ManagedArray<float> buf; buf.init(2*N, isGpuEnabled());
+	#ifdef GPU_ENABLED
+	float* bufData = buf.dataGpu();
+	convertToSingle_gpu(N, data, bufData);
+	cufftExecC2C(gInfo.getPlanC2Cbatch(nBatch), (float2*)bufData, (float2*)bufData, (inverse ? CUFFT_INVERSE : CUFFT_FORWARD));
+	convertFromSingle_gpu(N, bufData, data);
+	#elif defined(SINGLE_FFT_ENABLED)
+	if(!nThreads) nThreads = shouldThreadOperators() ? nProcsAvailable : 1;
+	float* bufData = buf.data();
+	threadLaunch(nThreads, convertToSingle_sub, N, (const complex*)data, bufData);
+	fftwf_execute_dft(gInfo.getPlanSingle((inverse ? GridInfo::PlanInverseInPlace : GridInfo::PlanForwardInPlace), nThreads, nBatch),
+		(fftwf_complex*)bufData, (fftwf_complex*)bufData);
+	threadLaunch(nThreads, convertFromSingle_sub, N, (const float*)bufData, data);
+	#else
+	assert(!"Single-precision transforms not supported in this build");
+	#endif
+}
+void I_batch(const GridInfo& gInfo, complex* data, int nBatch, int nThreads)
+{	if(nBatch <= 0) return;
+	static StopWatch watch("I_batch(fft)"); watch.start();
+	watch.addWork(nBatch*fftFlops(gInfo, false), nBatch*fftBytes(gInfo, false));
+	if(GridInfo::batchSinglePrecision)
+	{	fftBatchSingle(gInfo, data, nBatch, nThreads, true);
+		watch.stop();
+		return;
+	}
+	#ifdef GPU_ENABLED
+	cufftExecZ2Z(gInfo.getPlanZ2Zbatch(nBatch), (double2*)data, (double2*)data, CUFFT_INVERSE);
+	#else
+	if(!nThreads) nThreads = shouldThreadOperators() ? nProcsAvailable : 1;
+	fftw_execute_dft(gInfo.getPlan(GridInfo::PlanInverseInPlace, nThreads, nBatch), (fftw_complex*)data, (fftw_complex*)data);
+	#endif
+	watch.stop();
+}
+void Idag_batch(const GridInfo& gInfo, complex* data, int nBatch, int nThreads)
+{	if(nBatch <= 0) return;
+	static StopWatch watch("Idag_batch(fft)"); watch.start();
+	watch.addWork(nBatch*fftFlops(gInfo, false), nBatch*fftBytes(gInfo, false));
+	if(GridInfo::batchSinglePrecision)
+	{	fftBatchSingle(gInfo, data, nBatch, nThreads, false);
+		watch.stop();
+		return;
+	}
+	#ifdef GPU_ENABLED
+	cufftExecZ2Z(gInfo.getPlanZ2Zbatch(nBatch), (double2*)data, (double2*)data, CUFFT_FORWARD);
+	#else
+	if(!nThreads) nThreads = shouldThreadOperators() ? nProcsAvailable : 1;
+	fftw_execute_dft(gInfo.getPlan(GridInfo::PlanForwardInPlace, nThreads, nBatch), (fftw_complex*)data, (fftw_complex*)data);
+	#endif
+	watch.stop();
+}
+
 //Reverse transform (same as Idag upto the normalization factor)
 ScalarFieldTilde J(const ScalarField& in, int nThreads) { return (1.0/in->gInfo.nr)*Idag(in, nThreads); }
 complexScalarFieldTilde J(const complexScalarField& in, int nThreads) { return (1.0/in->gInfo.nr)*Idag(in, nThreads); }
@@ -675,6 +768,53 @@ double dot(const ScalarFieldTilde& X, const ScalarFieldTilde& Y)
 	return X->scale * Y->scale * (2.0*complexDot - correction1 - correction2).real();
 }
 
+//Real dot products of several arrays with one (blocked single pass on the CPU, one BLAS call per array on the GPU)
+inline void ddotMulti(int N, const std::vector<const double*>& x, const double* y, double* result)
+{
+	#ifdef GPU_ENABLED
+	for(size_t j=0; j<x.size(); j++) result[j] = eblas_ddot_gpu(N, x[j], 1, y, 1);
+	#else
+	eblas_ddot_multi(N, x.size(), x.data(), y, result);
+	#endif
+}
+
+void dotMulti(const std::vector<ScalarField>& X, const ScalarField& Y, double* result, double alpha)
+{	std::vector<const double*> xData; std::vector<size_t> jArr;
+	for(size_t j=0; j<X.size(); j++)
+		if(X[j])
+		{	xData.push_back(X[j]->dataPref(false));
+			jArr.push_back(j);
+		}
+	if(!xData.size()) return;
+	std::vector<double> xDotY(xData.size());
+	ddotMulti(Y->nElem, xData, Y->dataPref(false), xDotY.data());
+	for(size_t i=0; i<jArr.size(); i++)
+		result[jArr[i]] += alpha * X[jArr[i]]->scale * Y->scale * xDotY[i];
+}
+
+void dotMulti(const std::vector<ScalarFieldTilde>& X, const ScalarFieldTilde& Y, double* result, double alpha)
+{	std::vector<const double*> xData; std::vector<size_t> jArr;
+	for(size_t j=0; j<X.size(); j++)
+		if(X[j])
+		{	xData.push_back((const double*)X[j]->dataPref(false));
+			jArr.push_back(j);
+		}
+	if(!xData.size()) return;
+	//Real part of the full complex dot products (as a real dot product of interleaved data):
+	std::vector<double> xDotY(xData.size());
+	ddotMulti(2*Y->nElem, xData, (const double*)Y->dataPref(false), xDotY.data());
+	//Corrections for the inner-dimension planes that are not doubled (as in dot above):
+	int S2 = Y->gInfo.S[2]/2 + 1; //inner dimension
+	int S01 = Y->gInfo.S[0] * Y->gInfo.S[1]; //number of inner dimension slices
+	for(size_t i=0; i<jArr.size(); i++)
+	{	const ScalarFieldTilde& Xj = X[jArr[i]];
+		complex correction1 = callPref(eblas_zdotc)(S01, Xj->dataPref(false), S2, Y->dataPref(false), S2);
+		complex correction2 = callPref(eblas_zdotc)(S01, Xj->dataPref(false)+S2-1, S2, Y->dataPref(false)+S2-1, S2);
+		if(S2==1) correction2=complex(0,0); //because slices 1 and 2 are the same
+		result[jArr[i]] += alpha * Xj->scale * Y->scale * (2.0*xDotY[i] - (correction1 + correction2).real());
+	}
+}
+
 double nrm2(const ScalarField& X)
 {	return fabs(X->scale) * callPref(eblas_dnrm2)(X->nElem, X->dataPref(false), 1);
 }
@@ -29,7 +29,7 @@ void RealG_kernel(int zBlock, const vector3<int> S, const complex* vFull, comple
 void RealG_gpu(const vector3<int> S, const complex* vFull, complex* vHalf, double scaleFac)
 {	GpuLaunchConfigHalf3D glc(RealG_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		RealG_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, vFull, vHalf, scaleFac);
+		RealG_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, vFull, vHalf, scaleFac);
 	gpuErrorCheck();
 }
 
@@ -41,7 +41,7 @@ void ImagG_kernel(int zBlock, const vector3<int> S, const complex* vFull, comple
 void ImagG_gpu(const vector3<int> S, const complex* vFull, complex* vHalf, double scaleFac)
 {	GpuLaunchConfigHalf3D glc(ImagG_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		ImagG_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, vFull, vHalf, scaleFac);
+		ImagG_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, vFull, vHalf, scaleFac);
 	gpuErrorCheck();
 }
 
@@ -53,7 +53,7 @@ void ComplexG_kernel(int zBlock, const vector3<int> S, const complex* vHalf, com
 void ComplexG_gpu(const vector3<int> S, const complex* vHalf, complex *vFull, double scaleFac)
 {	GpuLaunchConfigHalf3D glc(ComplexG_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		ComplexG_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, vHalf, vFull, scaleFac);
+		ComplexG_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, vHalf, vFull, scaleFac);
 	gpuErrorCheck();
 }
 
@@ -67,7 +67,7 @@ void L_kernel(int zBlock, const vector3<int> S, const matrix3<> GGT, complex* v)
 void L_gpu(const vector3<int> S, const matrix3<> GGT, complex* v)
 {	GpuLaunchConfigHalf3D glc(L_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		L_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, v);
+		L_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, v);
 	gpuErrorCheck();
 }
 
@@ -79,7 +79,7 @@ void Linv_kernel(int zBlock, const vector3<int> S, const matrix3<> GGT, complex*
 void Linv_gpu(const vector3<int> S, const matrix3<> GGT, complex* v)
 {	GpuLaunchConfigHalf3D glc(Linv_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		Linv_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, v);
+		Linv_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, v);
 	gpuErrorCheck();
 }
 
@@ -91,7 +91,7 @@ void fullL_kernel(int zBlock, const vector3<int> S, const matrix3<> GGT, complex
 void fullL_gpu(const vector3<int> S, const matrix3<> GGT, complex* v)
 {	GpuLaunchConfig3D glc(fullL_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		fullL_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, v);
+		fullL_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, v);
 	gpuErrorCheck();
 }
 
@@ -103,7 +103,7 @@ void fullLinv_kernel(int zBlock, const vector3<int> S, const matrix3<> GGT, comp
 void fullLinv_gpu(const vector3<int> S, const matrix3<> GGT, complex* v)
 {	GpuLaunchConfig3D glc(fullLinv_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		fullLinv_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, v);
+		fullLinv_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, v);
 	gpuErrorCheck();
 }
 
@@ -116,7 +116,7 @@ void D_kernel(int zBlock, const vector3<int> S, const complex* in, complex* out,
 void D_gpu(const vector3<int> S, const complex* in, complex* out, vector3<> Ge)
 {	GpuLaunchConfigHalf3D glc(D_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		D_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, in, out, Ge);
+		D_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, in, out, Ge);
 	gpuErrorCheck();
 }
 
@@ -128,7 +128,7 @@ void DD_kernel(int zBlock, const vector3<int> S, const complex* in, complex* out
 void DD_gpu(const vector3<int> S, const complex* in, complex* out, vector3<> Ge1, vector3<> Ge2)
 {	GpuLaunchConfigHalf3D glc(DD_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		DD_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, in, out, Ge1, Ge2);
+		DD_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, in, out, Ge1, Ge2);
 	gpuErrorCheck();
 }
 
@@ -140,7 +140,7 @@ void lGradient_kernel(int zBlock, const vector3<int> S, const complex* in, array
 template<int l> void lGradient_gpu(const vector3<int>& S, const complex* in, array<complex*, 2*l+1> out, const matrix3<>& G)
 {	GpuLaunchConfigHalf3D glc(lGradient_kernel<l>, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		lGradient_kernel<l><<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, in, out, G);
+		lGradient_kernel<l><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, in, out, G);
 	gpuErrorCheck();
 }
 void lGradient_gpu(const vector3<int>& S, const complex* in, std::vector<complex*> out, int l, const matrix3<>& G)
@@ -155,7 +155,7 @@ void lDivergence_kernel(int zBlock, const vector3<int> S, const array<const comp
 template<int l> void lDivergence_gpu(const vector3<int>& S, array<const complex*,2*l+1> in, complex* out, const matrix3<>& G)
 {	GpuLaunchConfigHalf3D glc(lDivergence_kernel<l>, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		lDivergence_kernel<l><<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, in, out, G);
+		lDivergence_kernel<l><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, in, out, G);
 	gpuErrorCheck();
 }
 void lDivergence_gpu(const vector3<int>& S, const std::vector<const complex*>& in, complex* out, int l, const matrix3<>& G)
@@ -171,7 +171,7 @@ void multiplyBlochPhase_kernel(int zBlock, const vector3<int> S, const vector3<>
 void multiplyBlochPhase_gpu(const vector3<int>& S, const vector3<>& invS, complex* v, const vector3<>& k)
 {	GpuLaunchConfig3D glc(multiplyBlochPhase_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		 multiplyBlochPhase_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, invS, v, k);
+		 multiplyBlochPhase_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, invS, v, k);
 	gpuErrorCheck();
 }
 
@@ -186,7 +186,7 @@ void radialFunction_gpu(const vector3<int> S, const matrix3<>& GGT,
 	complex* F, const RadialFunctionG& f, vector3<> r0)
 {	GpuLaunchConfigHalf3D glc(radialFunction_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		radialFunction_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, F, f, r0);
+		radialFunction_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, F, f, r0);
 	gpuErrorCheck();
 }
 
@@ -198,7 +198,7 @@ void radialFunctionMultiply_kernel(int zBlock, const vector3<int> S, const matri
 void radialFunctionMultiply_gpu(const vector3<int> S, const matrix3<>& GGT, complex* in, const RadialFunctionG& f)
 {	GpuLaunchConfigHalf3D glc(radialFunctionMultiply_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		radialFunctionMultiply_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, in, f);
+		radialFunctionMultiply_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, in, f);
 	gpuErrorCheck();
 }
 
@@ -210,7 +210,7 @@ void exp_kernel(int N, double* X, double prefac)
 }
 void exp_gpu(int N, double* X, double prefac)
 {	GpuLaunchConfig1D glc(exp_kernel, N);
-	exp_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, X, prefac);
+	exp_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X, prefac);
 	gpuErrorCheck();
 }
 
@@ -220,7 +220,7 @@ void log_kernel(int N, double* X, double prefac)
 }
 void log_gpu(int N, double* X, double prefac)
 {	GpuLaunchConfig1D glc(log_kernel, N);
-	log_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, X, prefac);
+	log_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X, prefac);
 	gpuErrorCheck();
 }
 
@@ -230,7 +230,7 @@ void sqrt_kernel(int N, double* X, double prefac)
 }
 void sqrt_gpu(int N, double* X, double prefac)
 {	GpuLaunchConfig1D glc(sqrt_kernel, N);
-	sqrt_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, X, prefac);
+	sqrt_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X, prefac);
 	gpuErrorCheck();
 }
 
@@ -240,7 +240,7 @@ void inv_kernel(int N, double* X, double prefac)
 }
 void inv_gpu(int N, double* X, double prefac)
 {	GpuLaunchConfig1D glc(inv_kernel, N);
-	inv_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, X, prefac);
+	inv_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X, prefac);
 	gpuErrorCheck();
 }
 
@@ -250,7 +250,7 @@ void pow_kernel(int N, double* X, double scale, double alpha)
 }
 void pow_gpu(int N, double* X, double scale, double alpha)
 {	GpuLaunchConfig1D glc(pow_kernel, N);
-	pow_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, X, scale, alpha);
+	pow_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, X, scale, alpha);
 	gpuErrorCheck();
 }
 
@@ -262,7 +262,7 @@ void gaussConvolve_kernel(int zBlock, const vector3<int> S, const matrix3<> GGT,
 void gaussConvolve_gpu(const vector3<int>& S, const matrix3<>& GGT, complex* data, double sigma)
 {	GpuLaunchConfig3D glc(gaussConvolve_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		gaussConvolve_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, data, sigma);
+		gaussConvolve_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, data, sigma);
 }
 
 
@@ -274,7 +274,7 @@ void changeGrid_kernel(int zBlock, const vector3<int> S, const vector3<int> Sin,
 void changeGrid_gpu(const vector3<int>& S, const vector3<int>& Sin, const vector3<int>& Sout, const complex* in, complex* out)
 {	GpuLaunchConfigHalf3D glc(changeGrid_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		changeGrid_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, Sin, Sout, in, out);
+		changeGrid_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, Sin, Sout, in, out);
 	gpuErrorCheck();
 }
 
@@ -286,7 +286,7 @@ void changeGridFull_kernel(int zBlock, const vector3<int> S, const vector3<int>
 void changeGridFull_gpu(const vector3<int>& S, const vector3<int>& Sin, const vector3<int>& Sout, const complex* in, complex* out)
 {	GpuLaunchConfig3D glc(changeGridFull_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		changeGridFull_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, Sin, Sout, in, out);
+		changeGridFull_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, Sin, Sout, in, out);
 	gpuErrorCheck();
 }
 
@@ -299,7 +299,7 @@ void gradient_kernel(int zBlock, const vector3<int> S, const matrix3<> G, const
 void gradient_gpu(const vector3<int> S, const matrix3<> G, const complex* Xtilde, vector3<complex*> gradTilde)
 {	GpuLaunchConfigHalf3D glc(gradient_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		gradient_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, Xtilde, gradTilde);
+		gradient_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, Xtilde, gradTilde);
 	gpuErrorCheck();
 }
 
@@ -312,7 +312,7 @@ void divergence_kernel(int zBlock, const vector3<int> S, const matrix3<> G, vect
 void divergence_gpu(const vector3<int> S, const matrix3<> G, vector3<const complex*> Vtilde, complex* divTilde)
 {	GpuLaunchConfigHalf3D glc(divergence_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		divergence_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, Vtilde, divTilde);
+		divergence_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, Vtilde, divTilde);
 	gpuErrorCheck();
 }
 
@@ -325,7 +325,7 @@ void tensorGradient_kernel(int zBlock, const vector3<int> S, const matrix3<> G,
 void tensorGradient_gpu(const vector3<int> S, const matrix3<> G, const complex* Xtilde, tensor3<complex*> gradTilde)
 {	GpuLaunchConfigHalf3D glc(tensorGradient_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		tensorGradient_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, Xtilde, gradTilde);
+		tensorGradient_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, Xtilde, gradTilde);
 	gpuErrorCheck();
 }
 
@@ -338,6 +338,32 @@ void tensorDivergence_kernel(int zBlock, const vector3<int> S, const matrix3<> G
 void tensorDivergence_gpu(const vector3<int> S, const matrix3<> G, tensor3<const complex*> Vtilde, complex* divTilde)
 {	GpuLaunchConfigHalf3D glc(tensorDivergence_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		tensorDivergence_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, Vtilde, divTilde);
+		tensorDivergence_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, Vtilde, divTilde);
+	gpuErrorCheck();
+}
+
+
+__global__
+void convertToSingle_kernel(int N, const complex* in, float* out)
+{	int i = kernelIndex1D();
+	if(i<N)
+	{	out[2*i] = float(in[i].real());
+		out[2*i+1] = float(in[i].imag());
+	}
+}
+void convertToSingle_gpu(size_t N, const complex* in, float* out)
+{	GpuLaunchConfig1D glc(convertToSingle_kernel, N);
+	convertToSingle_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, in, out);
+	gpuErrorCheck();
+}
+
+__global__
+void convertFromSingle_kernel(int N, const float* in, complex* out)
+{	int i = kernelIndex1D();
+	if(i<N) out[i] = complex(in[2*i], in[2*i+1]);
+}
+void convertFromSingle_gpu(size_t N, const float* in, complex* out)
+{	GpuLaunchConfig1D glc(convertFromSingle_kernel, N);
+	convertFromSingle_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, in, out);
 	gpuErrorCheck();
 }
@@ -65,6 +65,11 @@ ScalarFieldTilde Idag(const ScalarField&, int nThreads=0); //!< Forward transfor
 complexScalarFieldTilde Idag(const complexScalarField&, int nThreads=0); //!< Forward transform transpose: Real space -> PW basis (preserve input)
 complexScalarFieldTilde Idag(complexScalarField&&, int nThreads=0); //!< Forward transform transpose: Real space -> PW basis (destructible input)
 
+//Batched in-place transforms of nBatch consecutive full boxes (gInfo.nr complex values each) at data,
+//which must be a GPU pointer in GPU mode (i.e. use dataPref() of a managed scratch buffer):
+void I_batch(const GridInfo& gInfo, complex* data, int nBatch, int nThreads=0); //!< Batched forward transforms: PW basis -> real space
+void Idag_batch(const GridInfo& gInfo, complex* data, int nBatch, int nThreads=0); //!< Batched forward transform transposes: Real space -> PW basis
+
 ScalarField Jdag(const ScalarFieldTilde&, int nThreads=0); //!< Inverse transform transpose: PW basis -> real space (preserve input)
 ScalarField Jdag(ScalarFieldTilde&&, int nThreads=0); //!< Inverse transform transpose: PW basis -> real space (destructible input)
 complexScalarField Jdag(const complexScalarFieldTilde&, int nThreads=0); //!< Inverse transform transpose: PW basis -> real space (preserve input)
@@ -224,6 +229,8 @@ template<typename T> complex sum(const Tptr& X) //!< Generic sum for complex typ
 //Special handling for real scalar fields:
 double dot(const ScalarField&, const ScalarField&); //!< Inner product
 double dot(const ScalarFieldTilde&, const ScalarFieldTilde&); //!< Inner product
+void dotMulti(const std::vector<ScalarField>& X, const ScalarField& Y, double* result, double alpha=1.); //!< Accumulate result[j] += alpha * dot(X[j],Y) for all (non-null) X[j], in a single pass over Y
+void dotMulti(const std::vector<ScalarFieldTilde>& X, const ScalarFieldTilde& Y, double* result, double alpha=1.); //!< Accumulate result[j] += alpha * dot(X[j],Y) for all (non-null) X[j], in a single pass over Y
 double nrm2(const ScalarField&); //!< 2-norm
 double nrm2(const ScalarFieldTilde&); //!< 2-norm
 double sum(const ScalarField&); //!< Sum of elements
@@ -283,11 +290,11 @@ template<typename Callable, typename Vec> void checkSymmetry(Callable* func, con
 
 
 template<typename Func, typename... Args>
-void applyFuncGsq_sub(size_t iStart, size_t iStop, const vector3<int> S, const matrix3<> GGT, const Func* f, Args... args)
-{	THREAD_halfGspaceLoop( (*f)(i, GGT.metric_length_squared(iG), args...); )
+void applyFuncGsq_sub(size_t iStart, size_t iStop, const double* Gsq, const Func* f, Args... args)
+{	for(size_t i=iStart; i<iStop; i++) (*f)(i, Gsq[i], args...);
 }
 template<typename Func, typename... Args> void applyFuncGsq(const GridInfo& gInfo, const Func& f, Args... args)
-{	threadLaunch(applyFuncGsq_sub<Func,Args...>, gInfo.nG, gInfo.S, gInfo.GGT, &f, args...);
+{	threadLaunch(applyFuncGsq_sub<Func,Args...>, gInfo.nG, gInfo.getGsqTable(), &f, args...);
 }
 
 template<typename Func, typename... Args>
@@ -0,0 +1,393 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <core/Profiler.h>
+#include <core/Util.h>
+#include <core/GpuUtil.h>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef ENABLE_PROFILING
+bool StopWatch::profilingEnabled = true;
+#else
+bool StopWatch::profilingEnabled = false;
+#endif
+string StopWatch::tracePrefix;
+bool StopWatch::countersEnabled = false;
+double StopWatch::peakGflops = 0.;
+double StopWatch::peakBandwidth = 0.;
+
+namespace Profiler
+{
+	//Hardware counters: one perf-event group per thread, always read as a sum over all threads of the process,
+	//so that a section also accounts for the work of the pool threads it launches
+	namespace Counters
+	{	enum { Cycles, Instructions, CacheMisses, nCounters };
+		typedef std::array<uint64_t,nCounters> Values;
+		const uint64_t bytesPerMiss = 64; //cache line size
+		
+		struct Registry
+		{	std::mutex lock;
+			std::vector<int> fds; //group leader of each thread
+			bool warned;
+			Registry() : warned(false) {}
+		};
+		Registry& registry() { static Registry* reg = new Registry(); return *reg; } //never freed (see Profiler::registry)
+		
+		void initThread()
+		{	thread_local bool initialized = false;
+			if(initialized || !StopWatch::countersEnabled) return;
+			initialized = true;
+			#ifdef __linux__
+			const uint64_t configs[nCounters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+			int leader = -1;
+			for(int i=0; i<nCounters; i++)
+			{	perf_event_attr attr; memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = configs[i];
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP;
+				int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+				if(fd < 0)
+				{	if(leader >= 0) close(leader); //closes the whole group
+					leader = -1;
+					break;
+				}
+				if(i==0) leader = fd;
+			}
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> guard(reg.lock);
+			if(leader >= 0) reg.fds.push_back(leader);
+			else if(!reg.warned)
+			{	reg.warned = true;
+				logPrintf("WARNING: could not open hardware counters (check /proc/sys/kernel/perf_event_paranoid); counter totals will be incomplete.\n");
+			}
+			#endif
+		}
+		
+		//Current totals over all threads (zero if counters are disabled)
+		Values read()
+		{	Values total; total.fill(0);
+			if(!StopWatch::countersEnabled) return total;
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> guard(reg.lock);
+			for(int fd: reg.fds)
+			{	uint64_t buf[1+nCounters]; //number of values followed by the values
+				if(::read(fd, buf, sizeof(buf)) != sizeof(buf)) continue;
+				for(int i=0; i<nCounters; i++) total[i] += buf[1+i];
+			}
+			return total;
+		}
+	}
+	
+	//Node in the call tree of StopWatch sections on one thread
+	struct Node
+	{	const StopWatch* watch; //null for root
+		int parent; //index of parent node (-1 for root)
+		double Ttot, TsqTot; int nT; //timing statistics (in microseconds)
+		double flops, bytes; //nominal work reported using StopWatch::addWork
+		Counters::Values counts; //hardware counter totals (inclusive of nested sections)
+		std::map<const StopWatch*,int> children; //index of child node for each watch started within this one
+		Node(const StopWatch* watch, int parent) : watch(watch), parent(parent), Ttot(0.), TsqTot(0.), nT(0), flops(0.), bytes(0.) { counts.fill(0); }
+	};
+	
+	//Active section on the stack of a thread
+	struct StackEntry
+	{	int iNode;
+		double tStart;
+		Counters::Values countsStart;
+	};
+
+	//Completed section for the timeline trace
+	struct Event
+	{	int iNode;
+		double tStart, tStop;
+	};
+	const size_t maxEventsPerThread = size_t(1) << 22; //cap trace memory at ~100 MB per thread
+
+	//Profiling data of one thread (only ever modified by that thread)
+	struct ThreadData
+	{	int iThread;
+		std::mutex lock; //only contended while reporting
+		std::vector<Node> nodes; //call tree (nodes[0] is the root)
+		std::vector<StackEntry> stack; //currently active nodes and their start times
+		std::vector<Event> events; //timeline (only when tracing)
+		ThreadData(int iThread) : iThread(iThread) { nodes.push_back(Node(0,-1)); }
+	};
+
+	//List of data for all threads that ever used a StopWatch.
+	//Allocated once and never freed, since detached worker threads may outlive static destruction.
+	struct Registry
+	{	std::mutex lock;
+		std::vector<ThreadData*> threads;
+	};
+	Registry& registry() { static Registry* reg = new Registry(); return *reg; }
+
+	inline ThreadData& thisThread()
+	{	thread_local ThreadData* td = 0;
+		if(!td)
+		{	Registry& reg = registry();
+			std::lock_guard<std::mutex> guard(reg.lock);
+			td = new ThreadData(reg.threads.size());
+			reg.threads.push_back(td);
+		}
+		Counters::initThread();
+		return *td;
+	}
+
+	//Merged call tree (across threads) used for reporting
+	struct TreeNode
+	{	double Ttot; int nT;
+		std::map<string,TreeNode> children;
+		TreeNode() : Ttot(0.), nT(0) {}
+
+		void add(const ThreadData& td, int iNode)
+		{	for(const auto& child: td.nodes[iNode].children)
+			{	const Node& node = td.nodes[child.second];
+				TreeNode& tn = children[child.first->getName()];
+				tn.Ttot += node.Ttot;
+				tn.nT += node.nT;
+				tn.add(td, child.second);
+			}
+		}
+
+		void print(int depth, int nTparent, double Tthreshold) const
+		{	//Sort children by decreasing time:
+			std::vector<std::pair<double,const std::pair<const string,TreeNode>*>> sorted;
+			for(const auto& child: children)
+				sorted.push_back(std::make_pair(-child.second.Ttot, &child));
+			std::sort(sorted.begin(), sorted.end());
+			for(const auto& entry: sorted)
+			{	const string& name = entry.second->first;
+				const TreeNode& tn = entry.second->second;
+				if(tn.Ttot < Tthreshold) continue;
+				logPrintf("PROFILER-TREE: %*s%-*s %13.6lf s total, %8d calls",
+					2*depth, "", std::max(1, 40-2*depth), name.c_str(), tn.Ttot*1e-6, tn.nT);
+				if(nTparent) logPrintf(", %9.2lf calls and %12.6lf s per parent call", tn.nT*1./nTparent, tn.Ttot*1e-6/nTparent);
+				logPrintf("\n");
+				tn.print(depth+1, tn.nT, Tthreshold);
+			}
+		}
+	};
+
+	//Write name to a JSON string, escaping special characters
+	void jsonString(FILE* fp, const string& s)
+	{	fputc('"', fp);
+		for(char c: s)
+		{	if(c=='"' || c=='\\') fputc('\\', fp);
+			if((unsigned char)c < 0x20) fprintf(fp, "\\u%04x", int(c));
+			else fputc(c, fp);
+		}
+		fputc('"', fp);
+	}
+}
+
+void StopWatch::startProfile()
+{
+	#ifdef GPU_ENABLED
+	cudaStreamSynchronize(gpuStream);
+	#endif
+	Profiler::ThreadData& td = Profiler::thisThread();
+	Profiler::Counters::Values countsStart = Profiler::Counters::read(); //before locking td (see report)
+	std::lock_guard<std::mutex> guard(td.lock);
+	int iParent = td.stack.size() ? td.stack.back().iNode : 0;
+	int iNode;
+	auto iter = td.nodes[iParent].children.find(this);
+	if(iter == td.nodes[iParent].children.end())
+	{	iNode = td.nodes.size();
+		td.nodes[iParent].children[this] = iNode;
+		td.nodes.push_back(Profiler::Node(this, iParent));
+	}
+	else iNode = iter->second;
+	td.stack.push_back({iNode, clock_us(), countsStart});
+}
+
+void StopWatch::stopProfile()
+{
+	#ifdef GPU_ENABLED
+	cudaStreamSynchronize(gpuStream);
+	#endif
+	double tStop = clock_us();
+	Profiler::Counters::Values countsStop = Profiler::Counters::read();
+	Profiler::ThreadData& td = Profiler::thisThread();
+	std::lock_guard<std::mutex> guard(td.lock);
+	//Find innermost active section of this watch (inner sections not stopped explicitly are closed with it):
+	int iStack = int(td.stack.size())-1;
+	while(iStack>=0 && td.nodes[td.stack[iStack].iNode].watch != this) iStack--;
+	if(iStack < 0) return; //not started on this thread (eg. profiling enabled in between)
+	int iNode = td.stack[iStack].iNode;
+	double tStart = td.stack[iStack].tStart;
+	Profiler::Counters::Values countsStart = td.stack[iStack].countsStart;
+	td.stack.resize(iStack);
+	//Accumulate statistics:
+	Profiler::Node& node = td.nodes[iNode];
+	double T = tStop - tStart;
+	node.Ttot += T;
+	node.TsqTot += T*T;
+	node.nT++;
+	for(int i=0; i<Profiler::Counters::nCounters; i++)
+		node.counts[i] += countsStop[i] - countsStart[i];
+	//Record timeline:
+	if(tracePrefix.length() && td.events.size() < Profiler::maxEventsPerThread)
+		td.events.push_back({iNode, tStart, tStop});
+}
+
+void StopWatch::addWorkProfile(double flops, double bytes)
+{	Profiler::ThreadData& td = Profiler::thisThread();
+	std::lock_guard<std::mutex> guard(td.lock);
+	for(int iStack=int(td.stack.size())-1; iStack>=0; iStack--)
+	{	Profiler::Node& node = td.nodes[td.stack[iStack].iNode];
+		if(node.watch == this)
+		{	node.flops += flops;
+			node.bytes += bytes;
+			return;
+		}
+	}
+}
+
+const string* StopWatch::currentSection()
+{	if(!profilingEnabled) return 0;
+	const Profiler::ThreadData& td = Profiler::thisThread(); //stack only modified by this thread, so no lock needed
+	return td.stack.size() ? &td.nodes[td.stack.back().iNode].watch->getName() : 0;
+}
+
+void StopWatch::initThreadCounters()
+{	Profiler::Counters::initThread();
+}
+
+void StopWatch::report()
+{	Profiler::Registry& reg = Profiler::registry();
+	std::lock_guard<std::mutex> regGuard(reg.lock);
+	std::vector<std::unique_lock<std::mutex>> guards;
+	for(Profiler::ThreadData* td: reg.threads)
+		guards.push_back(std::unique_lock<std::mutex>(td->lock));
+
+	//Flat totals by name (merged over threads and call paths):
+	struct Stats
+	{	double Ttot, TsqTot; int nT;
+		double flops, bytes;
+		Profiler::Counters::Values counts;
+		Stats() : Ttot(0.), TsqTot(0.), nT(0), flops(0.), bytes(0.) { counts.fill(0); }
+	};
+	std::map<string,Stats> flat;
+	for(const Profiler::ThreadData* td: reg.threads)
+		for(const Profiler::Node& node: td->nodes)
+			if(node.watch && node.nT)
+			{	Stats& stats = flat[node.watch->getName()];
+				stats.Ttot += node.Ttot;
+				stats.TsqTot += node.TsqTot;
+				stats.nT += node.nT;
+				stats.flops += node.flops;
+				stats.bytes += node.bytes;
+				for(int i=0; i<Profiler::Counters::nCounters; i++)
+					stats.counts[i] += node.counts[i];
+			}
+	logPrintf("\n");
+	for(const auto& entry: flat)
+	{	const Stats& stats = entry.second;
+		double meanT = stats.Ttot/stats.nT;
+		double sigmaT = sqrt(std::max(0., stats.TsqTot/stats.nT - meanT*meanT));
+		logPrintf("PROFILER: %30s %12.6lf +/- %12.6lf s, %4d calls, %13.6lf s total\n",
+			entry.first.c_str(), meanT*1e-6, sigmaT*1e-6, stats.nT, stats.Ttot*1e-6);
+	}
+
+	//Roofline summary of sections with reported work or counters, skipping those below 0.1% of the run time.
+	//Rates are per process, and the bound is the lesser of peak rate and intensity times peak bandwidth:
+	bool hasWork = countersEnabled;
+	for(const auto& entry: flat)
+		if(entry.second.flops || entry.second.bytes) hasWork = true;
+	if(hasWork)
+	{	logPrintf("\n");
+		if(peakGflops && peakBandwidth)
+			logPrintf("PROFILER-ROOFLINE: machine peaks %lg GFLOP/s and %lg GB/s (ridge at %lg FLOP/byte)\n",
+				peakGflops, peakBandwidth, peakGflops/peakBandwidth);
+		double Tthreshold = 1e-3*clock_us();
+		for(const auto& entry: flat)
+		{	const Stats& stats = entry.second;
+			if(stats.Ttot < Tthreshold) continue;
+			bool hasCounts = stats.counts[Profiler::Counters::Cycles];
+			if(!(stats.flops || stats.bytes || hasCounts)) continue;
+			double T = stats.Ttot*1e-6; //in seconds
+			logPrintf("PROFILER-ROOFLINE: %30s", entry.first.c_str());
+			if(stats.flops) logPrintf(" %9.2lf GFLOP/s", stats.flops*1e-9/T);
+			if(stats.bytes) logPrintf(" %9.2lf GB/s", stats.bytes*1e-9/T);
+			if(stats.flops && stats.bytes)
+			{	double intensity = stats.flops/stats.bytes;
+				logPrintf(" %7.3lf FLOP/byte", intensity);
+				if(peakGflops && peakBandwidth)
+				{	double bound = std::min(peakGflops, intensity*peakBandwidth);
+					logPrintf(" %5.1lf%% of %s bound", 100.*stats.flops*1e-9/(T*bound),
+						(intensity*peakBandwidth < peakGflops ? "memory" : "compute"));
+				}
+			}
+			else if(stats.bytes && peakBandwidth)
+				logPrintf(" %5.1lf%% of peak bandwidth", 100.*stats.bytes*1e-9/(T*peakBandwidth));
+			if(hasCounts)
+			{	using namespace Profiler::Counters;
+				double missBandwidth = stats.counts[CacheMisses]*bytesPerMiss*1e-9/T;
+				logPrintf(" | IPC %5.2lf, %10.3le cache misses, %9.2lf GB/s from misses",
+					stats.counts[Instructions]*1./stats.counts[Cycles], double(stats.counts[CacheMisses]), missBandwidth);
+				if(peakBandwidth) logPrintf(" (%5.1lf%% of peak)", 100.*missBandwidth/peakBandwidth);
+			}
+			logPrintf("\n");
+		}
+	}
+
+	//Call tree (merged over threads), skipping sections below 0.1% of the run time:
+	Profiler::TreeNode tree;
+	for(const Profiler::ThreadData* td: reg.threads)
+		tree.add(*td, 0);
+	logPrintf("\n");
+	tree.print(0, 0, 1e-3*clock_us());
+
+	//Timeline:
+	if(tracePrefix.length())
+	{	ostringstream oss; oss << tracePrefix << '.' << mpiWorld->iProcess() << ".json";
+		string fname = oss.str();
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp)
+		{	logPrintf("Could not open '%s' for writing profiler trace.\n", fname.c_str());
+			return;
+		}
+		fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		bool first = true;
+		for(const Profiler::ThreadData* td: reg.threads)
+		{	for(const Profiler::Event& event: td->events)
+			{	fprintf(fp, "%s{\"name\":", first ? "" : ",\n");
+				Profiler::jsonString(fp, td->nodes[event.iNode].watch->getName());
+				fprintf(fp, ",\"ph\":\"X\",\"ts\":%.3lf,\"dur\":%.3lf,\"pid\":%d,\"tid\":%d}",
+					event.tStart, event.tStop-event.tStart, mpiWorld->iProcess(), td->iThread);
+				first = false;
+			}
+			if(td->events.size() == Profiler::maxEventsPerThread)
+				logPrintf("WARNING: profiler trace truncated after %lu sections on thread %d.\n", td->events.size(), td->iThread);
+		}
+		fprintf(fp, "\n]}\n");
+		fclose(fp);
+		logPrintf("Wrote profiler trace to '%s.<process>.json'.\n", tracePrefix.c_str());
+	}
+}
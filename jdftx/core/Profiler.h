@@ -0,0 +1,75 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_CORE_PROFILER_H
+#define JDFTX_CORE_PROFILER_H
+
+//! @addtogroup Utilities
+//! @{
+
+//! @file Profiler.h Run-time profiling of nested code sections
+
+#include <core/string.h>
+#include <cstdio>
+
+//! Quick drop-in profiler for any function. Usage:
+//! * Create a static object of this class in the function
+//! * Call start and stop before and after the section to be timed
+//! * Timing statistics of the code block will be printed on exit
+//! Timing is always compiled in: it is on by default in builds with EnableProfiling,
+//! and can be switched at run time with environment variable JDFTX_PROFILE=yes/no.
+//! Nested start/stop pairs are tracked per thread, so that a call tree is reported
+//! in addition to the flat totals. Additionally setting JDFTX_TRACE=<prefix> writes
+//! a Chrome-trace / Perfetto JSON timeline to <prefix>.<process>.json on each process.
+//! Kernels may report their nominal work with addWork, and JDFTX_PROFILE_COUNTERS=yes
+//! additionally collects hardware counters (Linux perf events) for each section,
+//! which are summarized against machine peaks in a roofline-style table.
+class StopWatch
+{
+public:
+	StopWatch(string name) : name(name) {}
+	inline void start() { if(profilingEnabled) startProfile(); }
+	inline void stop() { if(profilingEnabled) stopProfile(); }
+	//! Add nominal floating-point operations and memory traffic (in bytes) to the active section of this watch on the calling thread
+	inline void addWork(double flops, double bytes) { if(profilingEnabled) addWorkProfile(flops, bytes); }
+	const string& getName() const { return name; }
+	
+	static bool profilingEnabled; //!< whether timing is currently active (see above)
+	static string tracePrefix; //!< if non-empty, record timeline of individual sections and write it to files with this prefix
+	static bool countersEnabled; //!< whether to collect hardware counters for each section (summed over all threads of the process)
+	static double peakGflops; //!< machine peak floating-point rate (GFLOP/s per process) for the roofline summary (0 if unknown)
+	static double peakBandwidth; //!< machine peak memory bandwidth (GB/s per process) for the roofline summary (0 if unknown)
+	static void report(); //!< print flat and hierarchical timing summaries, and write trace files (if any)
+	static const string* currentSection(); //!< name of the innermost section active on the calling thread (null if none, or if profiling is not enabled)
+	static void initThreadCounters(); //!< open hardware counters for the calling thread, if enabled (called by worker threads on start)
+private:
+	string name;
+	void startProfile();
+	void stopProfile();
+	void addWorkProfile(double flops, double bytes);
+};
+
+//! @cond
+namespace Profiler
+{	void jsonString(FILE* fp, const string& s); //!< write s as a JSON string (with quotes and escapes)
+}
+//! @endcond
+
+//! @}
+#endif // JDFTX_CORE_PROFILER_H
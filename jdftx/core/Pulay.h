@@ -24,6 +24,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/matrix.h>
 #include <core/string.h>
 #include <cfloat>
+#include <deque>
 
 //! @addtogroup Algorithms
 //! @{
@@ -44,6 +45,12 @@ public:
 	
 	void loadState(const char* filename); //!< Load the state from a single binary file
 	void saveState(const char* filename) const; //!< Save the state to a single binary file
+	
+	//! Independent copy of the history, which may be saved later (eg. from a background thread) while the minimization proceeds.
+	//! Past variables and residuals (interleaved) are stored in the byte layout of writeVariable, or packed in single precision.
+	struct StateSnapshot { std::vector<std::vector<char>> entries; bool single; };
+	StateSnapshot getStateSnapshot() const; //!< Deep-copy the current history
+	bool saveState(const char* filename, const StateSnapshot& snapshot) const; //!< Save a snapshot in the format of saveState(filename), without any MPI calls; returns false on I/O error
 	void clearState(); //!< remove past variables and residuals
 	
 	//! Override to synchronize scalars over MPI processes (if the same minimization is happening in sync over many processes)
@@ -65,6 +72,8 @@ protected:
 	virtual void report(int iter) {} //!< Override to perform optional reporting
 	virtual void axpy(double alpha, const Variable& X, Variable& Y) const=0; //!< Scaled accumulate on variable
 	virtual double dot(const Variable& X, const Variable& Y) const=0; //!< Euclidean dot product. Metric applied separately for efficiency.
+	//! Set result[j] = dot(X[j],Y) for all j. Override to contract Y with all X[j] in a single pass over Y (default calls dot() for each j).
+	virtual void dotMulti(const std::vector<Variable>& X, const Variable& Y, double* result) const;
 	virtual size_t variableSize() const=0; //!< Number of bytes per variable
 	virtual void readVariable(Variable&, FILE*) const=0; //!< Read variable from stream
 	virtual void writeVariable(const Variable&, FILE*) const=0; //! Write variable to stream
@@ -75,10 +84,40 @@ protected:
 	virtual Variable applyMetric(const Variable&) const=0; //!< Apply metric to variable/residual
 
 private:
+	//! Past variables or residuals, stored as selected by PulayParams::historyStorage
+	class History
+	{
+	public:
+		History(const Pulay& pulay) : pulay(pulay), fp(0) {}
+		~History() { if(fp) fclose(fp); }
+		size_t size() const { return nEntries; }
+		void push_back(const Variable& v);
+		void pop_front();
+		void clear();
+		Variable operator[](size_t j) const; //!< entry j (reconstructed from storage, except for full storage and the most recent entry)
+		const Variable& back() const { return last; } //!< most recent entry (always kept at full precision)
+		std::vector<char> snapshot(size_t j) const; //!< copy of entry j in the format of StateSnapshot
+	private:
+		const Pulay& pulay;
+		size_t nEntries = 0;
+		Variable last;
+		std::deque<Variable> full; //!< entries for HistoryFull
+		std::deque<std::vector<char>> packed; //!< entries for HistorySingle
+		FILE* fp; //!< scratch file for HistoryDisk
+		std::deque<size_t> slots; //!< slot within scratch file of each entry for HistoryDisk
+		std::vector<size_t> freeSlots; //!< unused slots in scratch file
+		std::vector<char> toBytes(const Variable& v) const; //!< serialize with writeVariable
+		Variable fromBytes(const std::vector<char>& buf) const; //!< deserialize with readVariable
+	};
+	static std::vector<char> packSingle(const std::vector<char>& buf); //!< round serialized variable to single precision
+	static std::vector<char> unpackSingle(const std::vector<char>& buf); //!< inverse of packSingle (up to rounding)
+	
 	const PulayParams& pp; //!< Pulay parameters
-	std::vector<Variable> pastVariables; //!< Previous variables
-	std::vector<Variable> pastResiduals; //!< Previous residuals
+	History pastVariables; //!< Previous variables
+	History pastResiduals; //!< Previous residuals
 	matrix overlap; //!< Overlap matrix of residuals
+	void removeOldest(); //!< drop the oldest variable / residual pair from the history (and overlap)
+	void overlapRow(const Variable& Mresidual, size_t nRow, double* result) const; //!< result[j] = dot(pastResiduals[j], Mresidual) for j < nRow
 };
 
 //! @}
@@ -88,6 +127,11 @@ private:
 
 #include <core/Minimize.h>
 #include <memory>
+#include <cstdlib>
+#include <unistd.h>
+
+static const double maxOverlapConditionInv = 1e-12; //inverse of maximum condition number of residual overlaps used in Pulay extrapolation
+static const size_t maxDecodedHistory = 4; //maximum number of past residuals decoded at once for overlaps when history is compressed or on disk
 
 //Norm convergence check (eigenvalue-difference or residual)
 //Make sure value is within tolerance for nCheck consecutive cycles
@@ -110,7 +154,7 @@ public:
 };
 
 template<typename Variable> Pulay<Variable>::Pulay(const PulayParams& pp)
-: pp(pp), overlap(pp.history, pp.history)
+: pp(pp), pastVariables(*this), pastResiduals(*this), overlap(pp.history, pp.history)
 {
 }
 
@@ -127,16 +171,14 @@ template<typename Variable> double Pulay<Variable>::minimize(double Eprev, std::
 	for(size_t iExtra=0; iExtra<extraNames.size(); iExtra++)
 		extraCheck[iExtra] = std::make_shared<NormCheck>(2, extraThresh[iExtra]);
 
+	double mixScale = 1.; //adaptive scale factor on the preconditioned residual (i.e. the mix fraction)
+	double residualNormPrev = DBL_MAX;
 	for(int iter=0; iter<pp.nIterations; iter++)
 	{
 		//If history is full, remove oldest member
 		assert(pastResiduals.size() == pastVariables.size());
 		if((int)pastResiduals.size() >= pp.history)
-		{	size_t ndim = pastResiduals.size();
-			if(ndim>1) overlap.set(0,ndim-1, 0,ndim-1, overlap(1,ndim, 1,ndim));
-			pastVariables.erase(pastVariables.begin());
-			pastResiduals.erase(pastResiduals.begin());
-		}
+			removeOldest();
 		
 		//Cache the old energy and variables
 		Eprev = E;
@@ -164,6 +206,7 @@ template<typename Variable> double Pulay<Variable>::minimize(double Eprev, std::
 			fprintf(pp.fpLog, "   |%s|: %.3e", extraNames[iExtra].c_str(), extraValues[iExtra]);
 		fprintf(pp.fpLog, "  t[s]: %9.2lf", clock_sec());
 		fprintf(pp.fpLog, "\n"); fflush(pp.fpLog);
+		if(pp.metrics) pp.metrics(iter, E, residualNorm);
 		
 		//Optional reporting:
 		report(iter);
@@ -192,15 +235,42 @@ template<typename Variable> double Pulay<Variable>::minimize(double Eprev, std::
 		fflush(pp.fpLog);
 		if(converged || killFlag) break; //converged or manually interrupted
 		
+		//Adjust the mix fraction based on residual history:
+		if(pp.adaptiveMixing)
+		{	if(residualNorm > residualNormPrev)
+			{	mixScale = std::max(0.1, 0.5*mixScale);
+				fprintf(pp.fpLog, "%sResidual increased: reducing mix fraction to %lg\n", pp.linePrefix, mixScale*pp.mixFraction);
+			}
+			else mixScale = std::min(1., 1.2*mixScale);
+		}
+		residualNormPrev = residualNorm;
+		
 		//---- DIIS/Pulay mixing -----
 			
 		//Update the overlap matrix
 		size_t ndim = pastResiduals.size();
-		Variable MlastResidual = applyMetric(pastResiduals.back());
+		std::vector<double> lastOverlaps(ndim);
+		overlapRow(applyMetric(pastResiduals.back()), ndim, lastOverlaps.data());
 		for(size_t j=0; j<ndim; j++)
-		{	double thisOverlap = dot(pastResiduals[j], MlastResidual);
-			overlap.set(j, ndim-1, thisOverlap);
-			overlap.set(ndim-1, j, thisOverlap);
+		{	overlap.set(j, ndim-1, lastOverlaps[j]);
+			overlap.set(ndim-1, j, lastOverlaps[j]);
+		}
+		
+		//Periodic Pulay: linear (preconditioned) mixing in between extrapolation steps:
+		if(pp.pulayPeriod>1 && (iter+1)%pp.pulayPeriod)
+		{	Variable v = pastVariables.back();
+			axpy(mixScale, precondition(pastResiduals.back()), v);
+			setVariable(v);
+			continue;
+		}
+		
+		//Drop the oldest history while the residual overlap is too ill-conditioned for a stable extrapolation:
+		while(ndim > 1)
+		{	matrix evecs; diagMatrix eigs;
+			matrix(overlap(0,ndim, 0,ndim)).diagonalize(evecs, eigs);
+			if(eigs.front() > maxOverlapConditionInv * eigs.back()) break;
+			removeOldest();
+			ndim--;
 		}
 		
 		//Invert the residual overlap matrix to get the minimum of residual
@@ -218,13 +288,144 @@ template<typename Variable> double Pulay<Variable>::minimize(double Eprev, std::
 		for(size_t j=0; j<ndim; j++)
 		{	double alpha = cOverlap_inv.data()[cOverlap_inv.index(j, ndim)].real();
 			axpy(alpha, pastVariables[j], v);
-			axpy(alpha, precondition(pastResiduals[j]), v);
+			axpy(alpha*mixScale, precondition(pastResiduals[j]), v);
 		}
 		setVariable(v);
 	}
 	return E;
 }
 
+template<typename Variable> void Pulay<Variable>::History::push_back(const Variable& v)
+{	switch(pulay.pp.historyStorage)
+	{	case PulayParams::HistoryFull:
+			full.push_back(v);
+			break;
+		case PulayParams::HistorySingle:
+			packed.push_back(packSingle(toBytes(v)));
+			break;
+		case PulayParams::HistoryDisk:
+		{	if(!fp)
+			{	const char* tmpDir = getenv("TMPDIR");
+				string fnameTemplate = string(tmpDir ? tmpDir : "/tmp") + "/jdftx-pulay-XXXXXX";
+				std::vector<char> fname(fnameTemplate.begin(), fnameTemplate.end()); fname.push_back(0);
+				int fd = mkstemp(fname.data());
+				if(fd < 0) die("Could not create scratch file '%s' for Pulay history.\n", fnameTemplate.c_str());
+				unlink(fname.data()); //removed automatically once closed
+				fp = fdopen(fd, "w+");
+			}
+			size_t slot = slots.size() + freeSlots.size();
+			if(freeSlots.size()) { slot = freeSlots.back(); freeSlots.pop_back(); }
+			std::vector<char> buf = toBytes(v);
+			if(fseek(fp, slot*buf.size(), SEEK_SET) || fwrite(buf.data(), 1, buf.size(), fp) != buf.size())
+				die("Error writing Pulay history to scratch file.\n");
+			slots.push_back(slot);
+			break;
+		}
+	}
+	last = v;
+	nEntries++;
+}
+
+template<typename Variable> void Pulay<Variable>::History::pop_front()
+{	if(!nEntries) return;
+	switch(pulay.pp.historyStorage)
+	{	case PulayParams::HistoryFull: full.pop_front(); break;
+		case PulayParams::HistorySingle: packed.pop_front(); break;
+		case PulayParams::HistoryDisk: freeSlots.push_back(slots.front()); slots.pop_front(); break;
+	}
+	nEntries--;
+	if(!nEntries) last = Variable();
+}
+
+template<typename Variable> void Pulay<Variable>::History::clear()
+{	while(nEntries) pop_front();
+}
+
+template<typename Variable> Variable Pulay<Variable>::History::operator[](size_t j) const
+{	assert(j < nEntries);
+	if(j+1 == nEntries) return last;
+	switch(pulay.pp.historyStorage)
+	{	case PulayParams::HistoryFull: return full[j];
+		case PulayParams::HistorySingle: return fromBytes(unpackSingle(packed[j]));
+		case PulayParams::HistoryDisk:
+		{	std::vector<char> buf(pulay.variableSize());
+			if(fseek(fp, slots[j]*buf.size(), SEEK_SET) || fread(buf.data(), 1, buf.size(), fp) != buf.size())
+				die("Error reading Pulay history from scratch file.\n");
+			return fromBytes(buf);
+		}
+	}
+	return Variable();
+}
+
+template<typename Variable> std::vector<char> Pulay<Variable>::History::snapshot(size_t j) const
+{	if(pulay.pp.historyStorage==PulayParams::HistorySingle && j+1<nEntries)
+		return packed[j];
+	std::vector<char> buf = toBytes((*this)[j]);
+	return pulay.pp.historyStorage==PulayParams::HistorySingle ? packSingle(buf) : buf;
+}
+
+template<typename Variable> std::vector<char> Pulay<Variable>::History::toBytes(const Variable& v) const
+{	std::vector<char> buf(pulay.variableSize()+1); //extra byte for the terminator written by fmemopen
+	FILE* fpMem = fmemopen(buf.data(), buf.size(), "w");
+	pulay.writeVariable(v, fpMem);
+	fclose(fpMem);
+	buf.pop_back();
+	return buf;
+}
+
+template<typename Variable> Variable Pulay<Variable>::History::fromBytes(const std::vector<char>& buf) const
+{	Variable v;
+	FILE* fpMem = fmemopen((void*)buf.data(), buf.size(), "r");
+	pulay.readVariable(v, fpMem);
+	fclose(fpMem);
+	return v;
+}
+
+//Serialized variables consist of little-endian doubles (real or complex):
+template<typename Variable> std::vector<char> Pulay<Variable>::packSingle(const std::vector<char>& buf)
+{	size_t n = buf.size()/sizeof(double);
+	std::vector<double> in(n); memcpy(in.data(), buf.data(), n*sizeof(double));
+	convertFromLE(in.data(), sizeof(double), n);
+	std::vector<char> out(n*sizeof(float));
+	float* outData = (float*)out.data();
+	for(size_t i=0; i<n; i++) outData[i] = float(in[i]);
+	return out;
+}
+
+template<typename Variable> std::vector<char> Pulay<Variable>::unpackSingle(const std::vector<char>& buf)
+{	size_t n = buf.size()/sizeof(float);
+	const float* inData = (const float*)buf.data();
+	std::vector<double> out(n);
+	for(size_t i=0; i<n; i++) out[i] = inData[i];
+	convertToLE(out.data(), sizeof(double), n);
+	std::vector<char> outBuf(n*sizeof(double));
+	memcpy(outBuf.data(), out.data(), outBuf.size());
+	return outBuf;
+}
+
+template<typename Variable> void Pulay<Variable>::removeOldest()
+{	size_t ndim = pastResiduals.size();
+	if(ndim>1) overlap.set(0,ndim-1, 0,ndim-1, overlap(1,ndim, 1,ndim));
+	pastVariables.pop_front();
+	pastResiduals.pop_front();
+}
+
+template<typename Variable> void Pulay<Variable>::overlapRow(const Variable& Mresidual, size_t nRow, double* result) const
+{	//Contract with all past residuals together (in batches when they need to be decoded from compressed / disk storage):
+	size_t batchSize = (pp.historyStorage==PulayParams::HistoryFull) ? nRow : maxDecodedHistory;
+	for(size_t jStart=0; jStart<nRow; jStart+=batchSize)
+	{	size_t jStop = std::min(nRow, jStart+batchSize);
+		std::vector<Variable> residuals; residuals.reserve(jStop-jStart);
+		for(size_t j=jStart; j<jStop; j++) residuals.push_back(pastResiduals[j]);
+		dotMulti(residuals, Mresidual, result+jStart);
+	}
+}
+
+template<typename Variable> void Pulay<Variable>::dotMulti(const std::vector<Variable>& X, const Variable& Y, double* result) const
+{	for(size_t j=0; j<X.size(); j++)
+		result[j] = dot(X[j], Y);
+}
+
 template<typename Variable> Variable Pulay<Variable>::getResidual() const
 {	Variable residual = getVariable(); 
 	axpy(-1., pastVariables.back(), residual);
@@ -244,23 +445,23 @@ template<typename Variable> void Pulay<Variable>::loadState(const char* filename
 	if(nBytesFile % nBytesCycle != 0)
 		die("Pulay history file '%s' does not contain an integral multiple of the mixed variables and residuals.\n", filename);
 	fprintf(pp.fpLog, "%sReading %lu past variables and residuals from '%s' ... ", pp.linePrefix, ndim, filename); logFlush();
-	pastVariables.resize(ndim);
-	pastResiduals.resize(ndim);
+	clearState();
 	FILE* fp = fopen(filename, "r");
 	if(dimOffset) fseek(fp, dimOffset*nBytesCycle, SEEK_SET);
 	for(size_t idim=0; idim<ndim; idim++)
-	{	readVariable(pastVariables[idim], fp);
-		readVariable(pastResiduals[idim], fp);
+	{	Variable variable, residual;
+		readVariable(variable, fp); pastVariables.push_back(variable);
+		readVariable(residual, fp); pastResiduals.push_back(residual);
 	}
 	fclose(fp);
 	fprintf(pp.fpLog, "done.\n"); fflush(pp.fpLog);
 	//Compute overlaps of loaded history:
+	std::vector<double> overlaps_i(ndim);
 	for(size_t i=0; i<ndim; i++)
-	{	Variable Mresidual_i = applyMetric(pastResiduals[i]);
+	{	overlapRow(applyMetric(pastResiduals[i]), i+1, overlaps_i.data());
 		for(size_t j=0; j<=i; j++)
-		{	double thisOverlap = dot(pastResiduals[j], Mresidual_i);
-			overlap.set(i,j, thisOverlap);
-			overlap.set(j,i, thisOverlap);
+		{	overlap.set(i,j, overlaps_i[j]);
+			overlap.set(j,i, overlaps_i[j]);
 		}
 	}
 }
@@ -277,6 +478,29 @@ template<typename Variable> void Pulay<Variable>::saveState(const char* filename
 	}
 }
 
+template<typename Variable> typename Pulay<Variable>::StateSnapshot Pulay<Variable>::getStateSnapshot() const
+{	StateSnapshot snapshot;
+	snapshot.single = (pp.historyStorage == PulayParams::HistorySingle);
+	for(size_t idim=0; idim<pastVariables.size(); idim++)
+	{	snapshot.entries.push_back(pastVariables.snapshot(idim));
+		snapshot.entries.push_back(pastResiduals.snapshot(idim));
+	}
+	return snapshot;
+}
+
+template<typename Variable> bool Pulay<Variable>::saveState(const char* filename, const StateSnapshot& snapshot) const
+{	FILE* fp = fopen(filename, "w");
+	if(!fp) return false;
+	bool success = true;
+	for(const std::vector<char>& entry: snapshot.entries)
+	{	const std::vector<char> buf = snapshot.single ? unpackSingle(entry) : entry;
+		if(fwrite(buf.data(), 1, buf.size(), fp) != buf.size()) success = false;
+	}
+	if(ferror(fp)) success = false;
+	if(fclose(fp)) success = false;
+	return success;
+}
+
 template<typename Variable> void Pulay<Variable>::clearState()
 {	pastVariables.clear();
 	pastResiduals.clear();
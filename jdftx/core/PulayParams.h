@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_CORE_PULAYPARAMS_H
 
 #include <cstdio>
+#include <functional>
 
 //! @addtogroup Algorithms
 //! @{
@@ -40,11 +41,23 @@ struct PulayParams
 	int history; //!< Number of past residuals and vectors that are cached and used for mixing
 	double mixFraction;  //!< Mixing fraction for total density / potential
 	double qMetric; //!< Wavevector controlling the metric for overlaps
+	int pulayPeriod; //!< if > 1, extrapolate with Pulay only every pulayPeriod cycles, with preconditioned linear mixing in between (periodic Pulay)
+	bool adaptiveMixing; //!< whether to scale down the mix fraction when the residual grows, recovering it gradually as the residual decreases
+	
+	//! Storage of past variables and residuals
+	enum HistoryStorage
+	{	HistoryFull, //!< in memory at full precision (default)
+		HistorySingle, //!< in memory, rounded to single precision (except the most recent entry)
+		HistoryDisk //!< in an unlinked scratch file in $TMPDIR (or /tmp), read back one entry at a time
+	}
+	historyStorage;
+	
+	std::function<void(int iter, double E, double residualNorm)> metrics; //!< if set, called (collectively) once per cycle after logging, eg. for a metrics stream (see Dump::metrics)
 	
 	PulayParams()
 	: fpLog(stdout), linePrefix("Pulay: "), energyLabel("E"), energyFormat("%22.15le"),
 		nIterations(50), energyDiffThreshold(1e-8), residualThreshold(1e-7),
-		history(10), mixFraction(0.5), qMetric(0.8)
+		history(10), mixFraction(0.5), qMetric(0.8), pulayPeriod(1), adaptiveMixing(false), historyStorage(HistoryFull)
 	{
 	}
 };
@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/SphericalHarmonics.h>
 #include <core/GpuUtil.h>
 #include <core/Thread.h>
+#include <unistd.h>
 
 RadialFunctionG::RadialFunctionG() : dGinv(0), nCoeff(0),
 #ifdef GPU_ENABLED
@@ -163,18 +164,86 @@ static void RadialFunction_transform_sub(int iMineStart, int iMineStop, int iGst
 		fTilde[iG] = rFunc->transform(l, iG*dG);
 }
 
+//Disk cache of uniform-grid transforms:
+string RadialFunctionR::transformCacheDir;
+namespace RadialTransformCache
+{
+	//64-bit FNV-1a hash over the 8-byte words of the data
+	inline void hashWords(uint64_t& hash, const void* data, size_t nWords)
+	{	const uint64_t* words = (const uint64_t*)data;
+		for(size_t i=0; i<nWords; i++)
+			hash = (hash ^ words[i]) * 0x100000001b3UL;
+	}
+	
+	uint64_t key(const RadialFunctionR& rFunc, int l, double dG, int nGrid)
+	{	uint64_t hash = 0xcbf29ce484222325UL;
+		hashWords(hash, rFunc.r.data(), rFunc.r.size());
+		hashWords(hash, rFunc.dr.data(), rFunc.dr.size());
+		hashWords(hash, rFunc.f.data(), rFunc.f.size());
+		int64_t lnGrid[2] = { l, nGrid };
+		hashWords(hash, lnGrid, 2);
+		hashWords(hash, &dG, 1);
+		return hash;
+	}
+	
+	string filename(uint64_t key)
+	{	ostringstream oss;
+		oss << RadialFunctionR::transformCacheDir << "/radial_" << std::hex << key << ".bin";
+		return oss.str();
+	}
+	
+	//File contents: key, followed by nGrid samples (in native byte order, since the key is too)
+	bool read(uint64_t key, std::vector<double>& fTilde)
+	{	FILE* fp = fopen(filename(key).c_str(), "rb");
+		if(!fp) return false;
+		uint64_t keyFile = 0;
+		bool success = (fread(&keyFile, sizeof(uint64_t), 1, fp) == 1) && (keyFile == key)
+			&& (fread(fTilde.data(), sizeof(double), fTilde.size(), fp) == fTilde.size())
+			&& (fgetc(fp) == EOF);
+		fclose(fp);
+		return success;
+	}
+	
+	void write(uint64_t key, const std::vector<double>& fTilde)
+	{	//Write to a temporary file and rename, so that concurrent jobs never see a partial file:
+		string fname = filename(key);
+		ostringstream ossTmp; ossTmp << fname << ".tmp" << getpid();
+		string fnameTmp = ossTmp.str();
+		FILE* fp = fopen(fnameTmp.c_str(), "wb");
+		if(!fp) return; //cache is optional: silently skip if not writable
+		bool success = (fwrite(&key, sizeof(uint64_t), 1, fp) == 1)
+			&& (fwrite(fTilde.data(), sizeof(double), fTilde.size(), fp) == fTilde.size());
+		success = !fclose(fp) && success;
+		if(!success || rename(fnameTmp.c_str(), fname.c_str()))
+			unlink(fnameTmp.c_str());
+	}
+}
+
 // Initialize a uniform G radial function from the log-grid function
 void RadialFunctionR::transform(int l, double dG, int nGrid, RadialFunctionG& func) const
 {	static StopWatch watch("RadialFunctionR::transform"); watch.start();
 	std::vector<double> fTilde(nGrid, 0.);
-	int iGstart, iGstop; TaskDivision(nGrid, mpiWorld).myRange(iGstart, iGstop);
-	int nGridMine = iGstop-iGstart;
-	if(nGridMine)
-		threadLaunch(RadialFunction_transform_sub, nGridMine, iGstart, l, dG, this, fTilde.data());
-	mpiWorld->allReduceData(fTilde, MPIUtil::ReduceSum);
+	//Check cache (on head):
+	bool useCache = transformCacheDir.length();
+	uint64_t cacheKey = useCache ? RadialTransformCache::key(*this, l, dG, nGrid) : 0;
+	bool cached = false;
+	if(useCache)
+	{	if(mpiWorld->isHead()) cached = RadialTransformCache::read(cacheKey, fTilde);
+		mpiWorld->bcast(cached);
+	}
+	if(cached)
+		mpiWorld->bcastData(fTilde);
+	else
+	{	//Compute transform in parallel:
+		int iGstart, iGstop; TaskDivision(nGrid, mpiWorld).myRange(iGstart, iGstop);
+		int nGridMine = iGstop-iGstart;
+		if(nGridMine)
+			threadLaunch(RadialFunction_transform_sub, nGridMine, iGstart, l, dG, this, fTilde.data());
+		mpiWorld->allReduceData(fTilde, MPIUtil::ReduceSum);
+		if(useCache && mpiWorld->isHead()) RadialTransformCache::write(cacheKey, fTilde);
+	}
 	func.free(this!=func.rFunc);
 	func.init(l, fTilde, dG);
 	if(this!=func.rFunc) func.rFunc = new RadialFunctionR(*this);
 	watch.stop();
 }
-
@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_CORE_RADIALFUNCTION_H
 
 #include <core/Spline.h>
+#include <core/string.h>
 
 //! @addtogroup DataStructures
 //! @{
@@ -128,6 +129,11 @@ struct RadialFunctionR
 	//! Initialize a uniform G radial function from the logPrintf grid function according to
 	//! @$ func(G) = \int dr 4\pi r^2 j_l(G r) f(r) @$
 	void transform(int l, double dG, int nGrid, RadialFunctionG& func) const;
+	
+	//! If non-empty, the above uniform-grid transforms are cached in this directory, keyed by
+	//! a hash of the samples, weights, l, dG and nGrid (i.e. pseudopotential data and cutoff),
+	//! so that subsequent runs with the same species and grids skip the Bessel transforms
+	static string transformCacheDir;
 };
 
 //! @}
@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_CORE_RANDOM_H
 
 #include <core/scalar.h>
+#include <cstdint>
 
 //! @addtogroup Utilities
 //! @{
@@ -32,6 +33,34 @@ namespace Random
 	double uniform(double start=0.0, double end=1.0); //!< uniform random numbers between 0 and 1
 	double normal(double mean=0.0, double sigma=1.0, double cap=0.0); //!< normal random numbers with mean, sigma and an optional cap if non-zero
 	complex normalComplex(double sigma=1.0); //!< normal complex number with mean 0 and deviation sigma
+	
+	//! Philox-4x32-10 counter-based generator: scramble the four 32-bit words of ctr in place using the key.
+	//! The result is a pure function of counter and key, so that random numbers can be generated in parallel
+	//! (on CPU threads or on GPUs) and reproducibly, independent of parallelization, by assigning distinct counters
+	__hostanddev__ void philox4x32(uint32_t ctr[4], uint32_t key0, uint32_t key1)
+	{	for(int round=0; round<10; round++)
+		{	uint64_t p0 = uint64_t(0xD2511F53u) * ctr[0];
+			uint64_t p1 = uint64_t(0xCD9E8D57u) * ctr[2];
+			uint32_t c0 = uint32_t(p1>>32) ^ ctr[1] ^ key0;
+			uint32_t c2 = uint32_t(p0>>32) ^ ctr[3] ^ key1;
+			ctr[0] = c0; ctr[1] = uint32_t(p1);
+			ctr[2] = c2; ctr[3] = uint32_t(p0);
+			key0 += 0x9E3779B9u; key1 += 0xBB67AE85u;
+		}
+	}
+	
+	//! Normal complex number with mean 0 and deviation sigma (in each component) determined by counter (c0,c1,c2,c3) and key
+	__hostanddev__ complex counterNormalComplex(double sigma, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t key0, uint32_t key1)
+	{	uint32_t ctr[4] = { c0, c1, c2, c3 };
+		philox4x32(ctr, key0, key1);
+		//Box-Muller transform of two 53-bit uniform random numbers:
+		const double scale = 1./9007199254740992.; //2^-53
+		double u1 = ((((uint64_t(ctr[0])<<32) | ctr[1]) >> 11) + 1) * scale; //in (0,1]
+		double u2 = (((uint64_t(ctr[2])<<32) | ctr[3]) >> 11) * scale; //in [0,1)
+		double r = sigma * sqrt(-2.*log(u1));
+		double theta = (2*M_PI) * u2;
+		return complex(r*cos(theta), r*sin(theta));
+	}
 }
 
 //! @}
@@ -133,6 +133,19 @@ template<typename T> double dot(const TptrCollection& x, const TptrCollection& y
 	return ret;
 }
 
+//! Accumulate result[j] += alpha * dot(X[j],y) for several collections X[j], in a single pass over each component of y
+template<typename T> void dotMulti(const std::vector<TptrCollection>& X, const TptrCollection& y, double* result, double alpha=1.)
+{	std::vector<std::shared_ptr<T> > Xi(X.size());
+	for(unsigned i=0; i<y.size(); i++)
+	{	if(!y[i]) continue;
+		for(size_t j=0; j<X.size(); j++)
+		{	assert(X[j].size()==y.size());
+			Xi[j] = X[j][i];
+		}
+		dotMulti(Xi, y[i], result, alpha);
+	}
+}
+
 //Spherical tensor derivatives
 ScalarFieldTildeArray lGradient(const ScalarFieldTilde&, int l); //!< spherical tensor gradient of order l (2l+1 outputs, multiplied by Ylm(Ghat) (iG)^l)
 ScalarFieldTilde lDivergence(const ScalarFieldTildeArray&, int l); //!< spherical tensor divergence of order l (2l+1 inputs, multiplied by Ylm(Ghat) (iG)^l, and summed)
@@ -0,0 +1,243 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_CORE_SCALARFIELDEXPR_H
+#define JDFTX_CORE_SCALARFIELDEXPR_H
+
+//! @addtogroup DataStructures
+//! @{
+
+/** @file ScalarFieldExpr.h Fused evaluation of pointwise expressions of scalar fields
+
+Each arithmetic operator on ScalarField's etc. (see Operators.h) makes a separate pass over the grid
+with a new temporary. Wrapping one operand with lazy() instead builds an expression tree, which is
+evaluated in a single threaded pass without intermediates when assigned to a field with eval(),
+or accumulated with += / -=. For example:
+\code
+ScalarField epsByE = eval(inv(lazy(E)) * (Ecomb + sqrt(Ecomb*Ecomb + 3.*E)));
+Vscloc += lazy(Vxc) * 2. - Vext;
+\endcode
+Fields in an expression can be any of the ScalarField types, but must all be of the same type.
+Subtraction (and negation), multiplication and addition of scalars are supported for all of them, while
+division and the nonlinear functions (exp, log, sqrt, inv and pow) are supported only for real-space real fields.
+
+The expressions hold references to their fields, and must be evaluated within the same statement.
+GPU builds evaluate the tree node by node with the usual operators instead, since the fused loop
+is instantiated in CPU code.
+*/
+
+#include <core/Operators.h>
+#include <core/Thread.h>
+#include <cmath>
+#include <type_traits>
+
+//! @cond
+struct FieldExprBase {}; //common base of all expression nodes (used to select the operators below)
+
+//Leaf of an expression tree: a field with its pending scale factor
+template<typename T> struct FieldExprLeaf : FieldExprBase
+{	typedef T Field;
+	typedef typename T::element_type::DataType DataType;
+	const T& X; const DataType* xData; double scale;
+	FieldExprLeaf(const T& X) : X(X), xData(isGpuEnabled() ? 0 : X->data(false)), scale(X->scale) { assert(X); }
+	DataType operator()(size_t i) const { return scale * xData[i]; }
+	const GridInfo& gInfo() const { return X->gInfo; }
+	T materialize() const { return X; }
+};
+
+//Sum (sign=+1) or difference (sign=-1) of two expressions
+template<typename A, typename B, int sign> struct FieldExprSum : FieldExprBase
+{	typedef typename A::Field Field;
+	typedef typename A::DataType DataType;
+	static_assert(std::is_same<Field, typename B::Field>::value, "Fields in an expression must all be of the same type");
+	A a; B b;
+	FieldExprSum(const A& a, const B& b) : a(a), b(b) {}
+	DataType operator()(size_t i) const { return sign>0 ? a(i)+b(i) : a(i)-b(i); }
+	const GridInfo& gInfo() const { return a.gInfo(); }
+	Field materialize() const { return sign>0 ? a.materialize()+b.materialize() : a.materialize()-b.materialize(); }
+};
+
+//Elementwise product of two expressions
+template<typename A, typename B> struct FieldExprProd : FieldExprBase
+{	typedef typename A::Field Field;
+	typedef typename A::DataType DataType;
+	static_assert(std::is_same<Field, typename B::Field>::value, "Fields in an expression must all be of the same type");
+	A a; B b;
+	FieldExprProd(const A& a, const B& b) : a(a), b(b) {}
+	DataType operator()(size_t i) const { return a(i) * b(i); }
+	const GridInfo& gInfo() const { return a.gInfo(); }
+	Field materialize() const { return a.materialize() * b.materialize(); }
+};
+
+//Elementwise quotient of two real-space real expressions
+template<typename A, typename B> struct FieldExprQuot : FieldExprBase
+{	typedef ScalarField Field;
+	typedef double DataType;
+	static_assert(std::is_same<typename A::Field, ScalarField>::value && std::is_same<typename B::Field, ScalarField>::value,
+		"Division is only supported for real-space real fields");
+	A a; B b;
+	FieldExprQuot(const A& a, const B& b) : a(a), b(b) {}
+	double operator()(size_t i) const { return a(i) / b(i); }
+	const GridInfo& gInfo() const { return a.gInfo(); }
+	Field materialize() const { return a.materialize() * inv(b.materialize()); }
+};
+
+//Expression scaled by a real number
+template<typename A> struct FieldExprScale : FieldExprBase
+{	typedef typename A::Field Field;
+	typedef typename A::DataType DataType;
+	A a; double s;
+	FieldExprScale(const A& a, double s) : a(a), s(s) {}
+	DataType operator()(size_t i) const { return s * a(i); }
+	const GridInfo& gInfo() const { return a.gInfo(); }
+	Field materialize() const { return s * a.materialize(); }
+};
+
+//Real-space real expression shifted by a real number
+template<typename A> struct FieldExprShift : FieldExprBase
+{	typedef ScalarField Field;
+	typedef double DataType;
+	static_assert(std::is_same<typename A::Field, ScalarField>::value, "Scalar addition is only supported for real-space real fields");
+	A a; double c;
+	FieldExprShift(const A& a, double c) : a(a), c(c) {}
+	double operator()(size_t i) const { return a(i) + c; }
+	const GridInfo& gInfo() const { return a.gInfo(); }
+	Field materialize() const { return a.materialize() + c; }
+};
+
+//Nonlinear function of a real-space real expression (Func provides apply(x) and materialize(X))
+template<typename A, typename Func> struct FieldExprFunc : FieldExprBase
+{	typedef ScalarField Field;
+	typedef double DataType;
+	static_assert(std::is_same<typename A::Field, ScalarField>::value, "Nonlinear functions are only supported for real-space real fields");
+	A a; Func f;
+	FieldExprFunc(const A& a, const Func& f) : a(a), f(f) {}
+	double operator()(size_t i) const { return f.apply(a(i)); }
+	const GridInfo& gInfo() const { return a.gInfo(); }
+	Field materialize() const { return f.materialize(a.materialize()); }
+};
+#define DECLARE_FieldExprFunc(func, code) \
+	struct FieldExprFunc_##func \
+	{	double alpha; \
+		double apply(double x) const { return code; } \
+		ScalarField materialize(ScalarField&& X) const { return func(X); } \
+	};
+DECLARE_FieldExprFunc(exp, ::exp(x))
+DECLARE_FieldExprFunc(log, ::log(x))
+DECLARE_FieldExprFunc(sqrt, ::sqrt(x))
+DECLARE_FieldExprFunc(inv, 1./x)
+#undef DECLARE_FieldExprFunc
+struct FieldExprFunc_pow
+{	double alpha;
+	double apply(double x) const { return ::pow(x, alpha); }
+	ScalarField materialize(ScalarField&& X) const { return pow(X, alpha); }
+};
+
+//Conversion of operands (expressions or fields) to expression nodes:
+template<typename X, typename Enable=void> struct FieldExprOperand { static const bool isExpr=false, isOperand=false; };
+template<typename X> struct FieldExprOperand<X, typename std::enable_if<std::is_base_of<FieldExprBase,X>::value>::type>
+{	static const bool isExpr=true, isOperand=true;
+	typedef X type;
+	static const X& get(const X& x) { return x; }
+};
+template<typename T> struct FieldExprOperand<std::shared_ptr<T>, typename std::enable_if<std::is_class<typename T::DataType>::value || std::is_arithmetic<typename T::DataType>::value>::type>
+{	static const bool isExpr=false, isOperand=true;
+	typedef FieldExprLeaf<std::shared_ptr<T>> type;
+	static type get(const std::shared_ptr<T>& x) { return type(x); }
+};
+//Enabled for a pair of operands at least one of which is an expression
+template<typename X, typename Y, typename Result> struct FieldExprBinary : std::enable_if<
+	FieldExprOperand<X>::isOperand && FieldExprOperand<Y>::isOperand && (FieldExprOperand<X>::isExpr || FieldExprOperand<Y>::isExpr), Result> {};
+template<typename X, typename Result> struct FieldExprUnary : std::enable_if<FieldExprOperand<X>::isExpr, Result> {};
+#define ExprOf(X) typename FieldExprOperand<X>::type
+//! @endcond
+
+//! Start a fused expression from a field (see ScalarFieldExpr.h)
+template<typename T> FieldExprLeaf<std::shared_ptr<T>> lazy(const std::shared_ptr<T>& X) { return FieldExprLeaf<std::shared_ptr<T>>(X); }
+
+//Binary operators between expressions, or an expression and a field (enabled only if one operand is an expression):
+template<typename X, typename Y> typename FieldExprBinary<X,Y, FieldExprSum<ExprOf(X),ExprOf(Y),+1>>::type operator+(const X& x, const Y& y)
+{	return FieldExprSum<ExprOf(X),ExprOf(Y),+1>(FieldExprOperand<X>::get(x), FieldExprOperand<Y>::get(y));
+}
+template<typename X, typename Y> typename FieldExprBinary<X,Y, FieldExprSum<ExprOf(X),ExprOf(Y),-1>>::type operator-(const X& x, const Y& y)
+{	return FieldExprSum<ExprOf(X),ExprOf(Y),-1>(FieldExprOperand<X>::get(x), FieldExprOperand<Y>::get(y));
+}
+template<typename X, typename Y> typename FieldExprBinary<X,Y, FieldExprProd<ExprOf(X),ExprOf(Y)>>::type operator*(const X& x, const Y& y)
+{	return FieldExprProd<ExprOf(X),ExprOf(Y)>(FieldExprOperand<X>::get(x), FieldExprOperand<Y>::get(y));
+}
+template<typename X, typename Y> typename FieldExprBinary<X,Y, FieldExprQuot<ExprOf(X),ExprOf(Y)>>::type operator/(const X& x, const Y& y)
+{	return FieldExprQuot<ExprOf(X),ExprOf(Y)>(FieldExprOperand<X>::get(x), FieldExprOperand<Y>::get(y));
+}
+
+//Operators with real numbers:
+template<typename X> typename FieldExprUnary<X, FieldExprScale<X>>::type operator*(const X& x, double s) { return FieldExprScale<X>(x, s); }
+template<typename X> typename FieldExprUnary<X, FieldExprScale<X>>::type operator*(double s, const X& x) { return FieldExprScale<X>(x, s); }
+template<typename X> typename FieldExprUnary<X, FieldExprScale<X>>::type operator/(const X& x, double s) { return FieldExprScale<X>(x, 1./s); }
+template<typename X> typename FieldExprUnary<X, FieldExprScale<X>>::type operator-(const X& x) { return FieldExprScale<X>(x, -1.); }
+template<typename X> typename FieldExprUnary<X, FieldExprShift<X>>::type operator+(const X& x, double c) { return FieldExprShift<X>(x, c); }
+template<typename X> typename FieldExprUnary<X, FieldExprShift<X>>::type operator+(double c, const X& x) { return FieldExprShift<X>(x, c); }
+template<typename X> typename FieldExprUnary<X, FieldExprShift<X>>::type operator-(const X& x, double c) { return FieldExprShift<X>(x, -c); }
+template<typename X> typename FieldExprUnary<X, FieldExprShift<FieldExprScale<X>>>::type operator-(double c, const X& x) { return FieldExprShift<FieldExprScale<X>>(FieldExprScale<X>(x, -1.), c); }
+
+//Nonlinear functions of real-space real expressions:
+#define DEFINE_FieldExprFunc(func) \
+	template<typename X> typename FieldExprUnary<X, FieldExprFunc<X,FieldExprFunc_##func>>::type func(const X& x) \
+	{	return FieldExprFunc<X,FieldExprFunc_##func>(x, FieldExprFunc_##func()); \
+	}
+DEFINE_FieldExprFunc(exp)
+DEFINE_FieldExprFunc(log)
+DEFINE_FieldExprFunc(sqrt)
+DEFINE_FieldExprFunc(inv)
+#undef DEFINE_FieldExprFunc
+template<typename X> typename FieldExprUnary<X, FieldExprFunc<X,FieldExprFunc_pow>>::type pow(const X& x, double alpha)
+{	FieldExprFunc_pow f; f.alpha = alpha;
+	return FieldExprFunc<X,FieldExprFunc_pow>(x, f);
+}
+#undef ExprOf
+
+//! @cond
+//out = e if !accumulate, and out = outScale*out + alpha*e otherwise
+template<typename E, typename DataType> void fieldExprEval_sub(size_t iStart, size_t iStop, const E* e, DataType* out, double outScale, double alpha, bool accumulate)
+{	if(accumulate) for(size_t i=iStart; i<iStop; i++) out[i] = outScale*out[i] + alpha*(*e)(i);
+	else for(size_t i=iStart; i<iStop; i++) out[i] = (*e)(i);
+}
+//! @endcond
+
+//! Evaluate an expression to a new field in a single pass over the grid
+template<typename E> typename FieldExprUnary<E, typename E::Field>::type eval(const E& e)
+{	typedef typename E::Field Field;
+	if(isGpuEnabled()) return clone(e.materialize()); //clone in case the expression is a single leaf
+	Field out = Field::element_type::alloc(e.gInfo());
+	threadLaunch(fieldExprEval_sub<E,typename E::DataType>, out->nElem, &e, out->data(), 1., 1., false);
+	return out;
+}
+
+//! Accumulate alpha times an expression into Y (which may also appear in the expression) in a single pass over the grid
+template<typename E> void axpy(double alpha, const E& e, typename FieldExprUnary<E, typename E::Field>::type& Y)
+{	if(!Y) { Y = alpha * eval(e); return; }
+	if(isGpuEnabled()) { axpy(alpha, e.materialize(), Y); return; }
+	//Absorb the scale of Y within the pass (any leaf of Y in e has already captured the unabsorbed data and scale):
+	threadLaunch(fieldExprEval_sub<E,typename E::DataType>, Y->nElem, &e, Y->data(false), Y->scale, alpha, true);
+	Y->scale = 1.;
+}
+template<typename E> typename E::Field& operator+=(typename FieldExprUnary<E, typename E::Field>::type& Y, const E& e) { axpy(+1., e, Y); return Y; } //!< Increment by expression
+template<typename E> typename E::Field& operator-=(typename FieldExprUnary<E, typename E::Field>::type& Y, const E& e) { axpy(-1., e, Y); return Y; } //!< Decrement by expression
+
+//! @}
+#endif // JDFTX_CORE_SCALARFIELDEXPR_H
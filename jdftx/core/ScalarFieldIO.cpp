@@ -21,10 +21,38 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/GridInfo.h>
 #include <core/Operators.h>
 #include <core/WignerSeitz.h>
+#include <core/Thread.h>
 #include <string.h>
 #include <algorithm>
+#include <mutex>
 
 
+void saveRawBinarySingle(const ScalarField& X, const char* filename)
+{	FILE* fp = fopen(filename, "wb");
+	if(!fp) die("Could not open '%s' for writing.\n", filename)
+	std::vector<float> buf(X->data(), X->data()+X->nElem);
+	int nWrote = fwriteLE(buf.data(), sizeof(float), buf.size(), fp);
+	if(nWrote < X->nElem) die("Write failed after %d of %d records.\n", nWrote, X->nElem)
+	fclose(fp);
+}
+
+void loadRawBinarySingle(ScalarField& X, const char* filename)
+{	off_t fLen = fileSize(filename);
+	off_t expectedLen = sizeof(float) * X->nElem;
+	if(fLen != expectedLen)
+	{	die("\nLength of '%s' was %ld instead of the expected %ld bytes.\n"
+				"Hint: Are you really reading the correct file?\n\n",
+				filename, (unsigned long)fLen, (unsigned long)expectedLen);
+	}
+	FILE* fp = fopen(filename, "rb");
+	if(!fp) die("Could not open '%s' for reading.\n", filename)
+	std::vector<float> buf(X->nElem);
+	int nRead = freadLE(buf.data(), sizeof(float), buf.size(), fp);
+	if(nRead < X->nElem) die("Read failed after %d of %d records.\n", nRead, X->nElem)
+	fclose(fp);
+	std::copy(buf.begin(), buf.end(), X->data());
+}
+
 void saveDX(const ScalarField& X, const char* filenamePrefix)
 {	char filename[256];
 	sprintf(filename, "%s.bin", filenamePrefix);
@@ -67,6 +95,39 @@ void saveDX(const ScalarField& X, const char* filenamePrefix)
 }
 
 
+//Radial spacing for sphericalize: drFac times the diameter of the mesh parellelopiped
+inline double sphericalizeSpacing(const GridInfo& gInfo, double drFac)
+{	double dr = 0.0;
+	const vector3<>* h = gInfo.h;
+	vector3<> hCenter = 0.5*(h[0]+h[1]+h[2]);
+	for(int i0=0; i0<2; i0++) for(int i1=0; i1<2; i1++) for(int i2=0; i2<2; i2++) //loop over vertices of parellelopiped
+	{	double distance = (h[0]*i0 + h[1]*i1 + h[2]*i2 - hCenter).length();
+		if(distance > dr) dr = distance;
+	}
+	return dr * (2.0*drFac);
+}
+
+//Fill rows of zero weight in sphericalize output by interpolating from neighbouring rows
+void sphericalizeFillEmpty(std::vector< std::vector<double> >& out, int nColumns)
+{	const std::vector<double>& weight = out[nColumns+1];
+	int nRadial = weight.size();
+	for(int i=0; i<nRadial; i++) if(!weight[i])
+	{	int iLeft=i-1; while(iLeft>=0 && !weight[iLeft]) iLeft--;
+		int iRight=i+1; while(iRight<nRadial && !weight[iRight]) iRight++;
+		if(iLeft>=0 && iRight<nRadial)
+		{	double wLeft = (iRight-i)*1./(iRight-iLeft);
+			for(int c=0; c<nColumns; c++) out[c+1][i] = out[c+1][iLeft]*wLeft + out[c+1][iRight]*(1.-wLeft);
+		}
+		else if(iLeft>=0 && iRight>=nRadial)
+		{	for(int c=0; c<nColumns; c++) out[c+1][i] = out[c+1][iLeft];
+		}
+		else if(iLeft<0 && iRight<nRadial)
+		{	for(int c=0; c<nColumns; c++) out[c+1][i] = out[c+1][iRight];
+		}
+		else assert("!All rows have zero weight!\n");
+	}
+}
+
 std::vector< std::vector<double> > sphericalize(const ScalarField* dataR, int nColumns, double drFac, vector3< double >* center)
 {	assert(nColumns > 0); assert(dataR[0]);
 	const GridInfo& gInfo = dataR[0]->gInfo;
@@ -82,15 +143,8 @@ std::vector< std::vector<double> > sphericalize(const ScalarField* dataR, int nC
 	logResume();
 	double rMax = ws.circumRadius();
 	
-	//Determine the diameter of the mesh parellelopiped:
-	double dr = 0.0;
-	const vector3<>* h = gInfo.h;
-	vector3<> hCenter = 0.5*(h[0]+h[1]+h[2]);
-	for(int i0=0; i0<2; i0++) for(int i1=0; i1<2; i1++) for(int i2=0; i2<2; i2++) //loop over vertices of parellelopiped
-	{	double distance = (h[0]*i0 + h[1]*i1 + h[2]*i2 - hCenter).length();
-		if(distance > dr) dr = distance;
-	}
-	dr *= (2.0*drFac);
+	//Radial spacing based on the diameter of the mesh parellelopiped:
+	double dr = sphericalizeSpacing(gInfo, drFac);
 	double drInv = 1.0/dr;
 	
 	//Histogram:
@@ -129,23 +183,148 @@ std::vector< std::vector<double> > sphericalize(const ScalarField* dataR, int nC
 	{	mpiWorld->allReduceData(out[c+1], MPIUtil::ReduceSum);
 		eblas_ddiv(nRadial, weight.data(),1, out[c+1].data(),1); //convert from sum to mean
 	}
-	//Fix rows of zero weight:
-	for(int i=0; i<nRadial; i++) if(!weight[i])
-	{	int iLeft=i-1; while(iLeft>=0 && !weight[iLeft]) iLeft--;
-		int iRight=i+1; while(iRight<nRadial && !weight[iRight]) iRight++;
-		if(iLeft>=0 && iRight<nRadial)
-		{	double wLeft = (iRight-i)*1./(iRight-iLeft);
-			for(int c=0; c<nColumns; c++) out[c+1][i] = out[c+1][iLeft]*wLeft + out[c+1][iRight]*(1.-wLeft);
-		}
-		else if(iLeft>=0 && iRight>=nRadial)
-		{	for(int c=0; c<nColumns; c++) out[c+1][i] = out[c+1][iLeft];
-		}
-		else if(iLeft<0 && iRight<nRadial)
-		{	for(int c=0; c<nColumns; c++) out[c+1][i] = out[c+1][iRight];
+	sphericalizeFillEmpty(out, nColumns);
+	return out;
+}
+
+//Cell lists of centers for sphericalize about multiple centers:
+struct SphericalizeCells
+{	const GridInfo* gInfo;
+	const WignerSeitz* ws;
+	std::vector< vector3<> > xCenters; //centers in lattice coordinates, wrapped to [0,1)
+	vector3<int> nCells; //number of cells along each lattice direction (each at least rMax wide)
+	std::vector< std::vector<int> > cellCenters; //indices of centers in each cell
+	std::vector< std::vector<int> > neighbourCells; //unique cells within one cell (periodically) of each cell
+	const double* const* data; int nColumns;
+	double rMax, drInv; int nRadial;
+	size_t iOffset; //start of the grid point range of current process
+	
+	inline int cellIndex(const vector3<>& x) const
+	{	vector3<int> ic;
+		for(int k=0; k<3; k++) ic[k] = std::min(nCells[k]-1, int(floor(x[k]*nCells[k])));
+		return ic[2] + nCells[2]*(ic[1] + nCells[1]*ic[0]);
+	}
+};
+
+//Accumulate histograms of all centers over grid points [iStart,iStop) of current process
+//with layout (center, column + weight, radial) in a thread-local buffer, then add to hist
+void sphericalizeCenters_sub(size_t iStart, size_t iStop, const SphericalizeCells* sc, double* hist, std::mutex* lock)
+{	const GridInfo& gInfo = *(sc->gInfo);
+	const vector3<int>& S = gInfo.S;
+	vector3<> invS(1./S[0], 1./S[1], 1./S[2]);
+	int nColumns = sc->nColumns, nRadial = sc->nRadial;
+	size_t centerStride = (nColumns+1) * nRadial;
+	std::vector<double> histLocal(sc->xCenters.size() * centerStride, 0.);
+	iStart += sc->iOffset;
+	iStop += sc->iOffset;
+	THREAD_rLoop
+	(	vector3<> x(iv[0]*invS[0], iv[1]*invS[1], iv[2]*invS[2]);
+		for(int jCell: sc->neighbourCells[sc->cellIndex(x)])
+			for(int c: sc->cellCenters[jCell])
+			{	double r = (gInfo.R * sc->ws->restrict(x - sc->xCenters[c])).length();
+				if(r >= sc->rMax) continue;
+				double rRel = r * sc->drInv;
+				int iRadial = int(floor(rRel));
+				double wRight = (pow(rRel,2) - pow(iRadial,2))/(2*iRadial+1);
+				double wLeft = 1.0 - wRight;
+				double* h = histLocal.data() + c*centerStride; //columns, followed by weight
+				if(wLeft && iRadial<nRadial)
+				{	for(int col=0; col<nColumns; col++) h[col*nRadial+iRadial] += wLeft * sc->data[col][i];
+					h[nColumns*nRadial+iRadial] += wLeft;
+				}
+				if(wRight && iRadial+1<nRadial)
+				{	for(int col=0; col<nColumns; col++) h[col*nRadial+iRadial+1] += wRight * sc->data[col][i];
+					h[nColumns*nRadial+iRadial+1] += wRight;
+				}
+			}
+	)
+	std::lock_guard<std::mutex> guard(*lock);
+	for(size_t j=0; j<histLocal.size(); j++) hist[j] += histLocal[j];
+}
+
+std::vector< std::vector< std::vector<double> > > sphericalize(const ScalarField* dataR, int nColumns,
+	const std::vector< vector3<> >& centers, double rMax, double drFac)
+{	static StopWatch watch("sphericalize(centers)"); watch.start();
+	assert(nColumns > 0); assert(dataR[0]);
+	const GridInfo& gInfo = dataR[0]->gInfo;
+	
+	//Radial grid:
+	logSuspend();
+	WignerSeitz ws(gInfo.R);
+	logResume();
+	if(rMax <= 0. || rMax > ws.circumRadius()) rMax = ws.circumRadius();
+	double dr = sphericalizeSpacing(gInfo, drFac);
+	int nRadial = int(ceil(rMax/dr));
+	
+	//Cell lists (a point within rMax of a center differs from it by at most rMax/d in the lattice coordinate of planes with spacing d):
+	SphericalizeCells sc;
+	sc.gInfo = &gInfo;
+	sc.ws = &ws;
+	for(int k=0; k<3; k++)
+	{	double planeSpacing = 1./gInfo.invR.row(k).length();
+		sc.nCells[k] = std::max(1, int(floor(planeSpacing/rMax)));
+	}
+	int nCellsTot = sc.nCells[0]*sc.nCells[1]*sc.nCells[2];
+	sc.cellCenters.resize(nCellsTot);
+	for(size_t c=0; c<centers.size(); c++)
+	{	vector3<> x = gInfo.invR * centers[c];
+		for(int k=0; k<3; k++) x[k] -= floor(x[k]);
+		sc.xCenters.push_back(x);
+		sc.cellCenters[sc.cellIndex(x)].push_back(c);
+	}
+	sc.neighbourCells.resize(nCellsTot);
+	vector3<int> ic;
+	for(ic[0]=0; ic[0]<sc.nCells[0]; ic[0]++)
+	for(ic[1]=0; ic[1]<sc.nCells[1]; ic[1]++)
+	for(ic[2]=0; ic[2]<sc.nCells[2]; ic[2]++)
+	{	std::vector<int>& neighbours = sc.neighbourCells[ic[2] + sc.nCells[2]*(ic[1] + sc.nCells[1]*ic[0])];
+		vector3<int> jc;
+		for(jc[0]=ic[0]-1; jc[0]<=ic[0]+1; jc[0]++)
+		for(jc[1]=ic[1]-1; jc[1]<=ic[1]+1; jc[1]++)
+		for(jc[2]=ic[2]-1; jc[2]<=ic[2]+1; jc[2]++)
+		{	vector3<int> jw;
+			for(int k=0; k<3; k++) jw[k] = (jc[k] + sc.nCells[k]) % sc.nCells[k];
+			neighbours.push_back(jw[2] + sc.nCells[2]*(jw[1] + sc.nCells[1]*jw[0]));
 		}
-		else assert("!All rows have zero weight!\n");
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
 	}
-	return out;
+	
+	//Histogram (threaded over grid points of the current process):
+	std::vector<const double*> data(nColumns);
+	for(int col=0; col<nColumns; col++)
+		data[col] = dataR[col]->data();
+	sc.data = data.data();
+	sc.nColumns = nColumns;
+	sc.rMax = rMax;
+	sc.drInv = 1./dr;
+	sc.nRadial = nRadial;
+	size_t iStart, iStop;
+	TaskDivision(gInfo.nr, mpiWorld).myRange(iStart, iStop);
+	sc.iOffset = iStart;
+	size_t centerStride = (nColumns+1) * nRadial;
+	std::vector<double> hist(centers.size() * centerStride, 0.);
+	std::mutex lock;
+	threadLaunch(sphericalizeCenters_sub, iStop-iStart, &sc, hist.data(), &lock);
+	mpiWorld->allReduceData(hist, MPIUtil::ReduceSum);
+	
+	//Convert to the output layout of sphericalize for each center:
+	std::vector< std::vector< std::vector<double> > > outAll(centers.size());
+	for(size_t c=0; c<centers.size(); c++)
+	{	std::vector< std::vector<double> >& out = outAll[c];
+		out.assign(nColumns+2, std::vector<double>(nRadial, 0.));
+		for(int iRadial=0; iRadial<nRadial; iRadial++)
+			out[0][iRadial] = iRadial*dr;
+		const double* h = hist.data() + c*centerStride;
+		std::vector<double>& weight = out[nColumns+1];
+		weight.assign(h+nColumns*nRadial, h+(nColumns+1)*nRadial);
+		for(int col=0; col<nColumns; col++)
+			for(int iRadial=0; iRadial<nRadial; iRadial++)
+				if(weight[iRadial]) out[col+1][iRadial] = h[col*nRadial+iRadial] / weight[iRadial]; //convert from sum to mean
+		sphericalizeFillEmpty(out, nColumns);
+	}
+	watch.stop();
+	return outAll;
 }
 
 
@@ -68,6 +68,12 @@ template<typename T> void loadRawBinary(Tptr& X, const char* filename)
 
 #undef Tptr
 
+//! Save real-space data in raw binary format at single precision (little-endian float32, i.e. half the size of saveRawBinary)
+void saveRawBinarySingle(const ScalarField& X, const char* filename);
+
+//! Load real-space data saved by saveRawBinarySingle (X must be allocated on the intended grid)
+void loadRawBinarySingle(ScalarField& X, const char* filename);
+
 /** Save data to a raw binary along with a DataExplorer header
 @param filenamePrefix Binary data is saved to filenamePrefix.bin with DataExplorer header filenamePrefix.dx
 */
@@ -82,6 +88,18 @@ void saveDX(const ScalarField&, const char* filenamePrefix);
 */
 std::vector< std::vector<double> > sphericalize(const ScalarField* dataR, int nColumns, double drFac=1.0, vector3<>* center=0);
 
+/** Spherically average scalar fields about each of several centers (eg. every atom) in a single threaded pass over the grid.
+Grid points are matched to nearby centers using cell lists, so that the cost scales with the number of grid points within rMax of each center.
+@param dataR The data to sphericalize
+@param nColumns Number of ScalarField's in dataR[]
+@param centers Cartesian positions of the centers
+@param rMax Maximum radius (the circum-radius of the Wigner-Seitz cell if zero, negative or larger)
+@param drFac is the spacing in radius as a fraction of the diameter of the sample box, as in sphericalize() above
+@return For each center, the same layout as sphericalize() above: radial grid, mean of each dataR, weight of each radial grid point
+*/
+std::vector< std::vector< std::vector<double> > > sphericalize(const ScalarField* dataR, int nColumns,
+	const std::vector< vector3<> >& centers, double rMax=0., double drFac=1.0);
+
 /** Saves an array of real space data pointers to a multicolumn 1D 'sphericalized' file (for gnuplot)
 @param dataR The data to sphericalize and save
 @param nColumns Number of ScalarField's in dataR[]
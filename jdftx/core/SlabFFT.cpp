@@ -0,0 +1,164 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <core/SlabFFT.h>
+#include <core/GridInfo.h>
+#include <core/Thread.h>
+#include <core/Util.h>
+#include <cstring>
+
+#ifdef MKL_PROVIDES_FFT
+#include <fftw3_mkl.h>
+#endif
+
+SlabFFT::SlabFFT(const vector3<int>& S, const MPIUtil* mpiUtil, int nThreads)
+: S(S), mpiUtil(mpiUtil), xDivision(S[0], mpiUtil), yDivision(S[1], mpiUtil)
+{	xDivision.myRange(xStart, xStop);
+	yDivision.myRange(yStart, yStop);
+	int nx = xStop-xStart, ny = yStop-yStart;
+	
+	//Alltoallv layout of the forward transpose (the inverse transpose swaps send and receive):
+	int nProcs = mpiUtil->nProcesses();
+	sendCounts.resize(nProcs); sendOffsets.resize(nProcs);
+	recvCounts.resize(nProcs); recvOffsets.resize(nProcs);
+	int sendOffset = 0, recvOffset = 0;
+	for(int jProc=0; jProc<nProcs; jProc++)
+	{	sendOffsets[jProc] = sendOffset;
+		sendOffset += (sendCounts[jProc] = nx * int(yDivision.stop(jProc)-yDivision.start(jProc)) * S[2]);
+		recvOffsets[jProc] = recvOffset;
+		recvOffset += (recvCounts[jProc] = int(xDivision.stop(jProc)-xDivision.start(jProc)) * ny * S[2]);
+	}
+	sendBuf.init(nLocal());
+	recvBuf.init(nLocal());
+	
+	//Create plans:
+	static StopWatch watch("SlabFFT::plan"); watch.start();
+	if(nThreads<=0) nThreads = nProcsAvailable;
+	#ifdef MKL_PROVIDES_FFT
+	fftw3_mkl.number_of_user_threads = ceildiv(nProcsAvailable, nThreads);
+	#endif
+	fftw_init_threads();
+	fftw_plan_with_nthreads(nThreads);
+	ManagedArray<complex> testMem; testMem.init(nLocal());
+	fftw_complex* testData = (fftw_complex*)testMem.data();
+	const int signs[2] = { FFTW_FORWARD, FFTW_BACKWARD };
+	for(int iDir=0; iDir<2; iDir++)
+	{	//--- 2D transforms in (y,z) of local x planes:
+		planYZ[iDir] = 0;
+		if(nx)
+		{	const int nYZ[2] = { S[1], S[2] };
+			planYZ[iDir] = fftw_plan_many_dft(2, nYZ, nx, testData, 0, 1, S[1]*S[2], testData, 0, 1, S[1]*S[2], signs[iDir], GridInfo::plannerFlags);
+			if(!planYZ[iDir]) die_alone("Failed to create 2D FFT plans for distributed FFT of %d x %d x %d grid.\n", S[0], S[1], S[2]);
+		}
+		//--- 1D transforms along x of local (transposed) y planes:
+		planX[iDir] = 0;
+		if(ny)
+		{	fftw_iodim dimX = { S[0], S[2], S[2] };
+			fftw_iodim dimsBatch[2] = { { ny, S[0]*S[2], S[0]*S[2] }, { S[2], 1, 1 } };
+			planX[iDir] = fftw_plan_guru_dft(1, &dimX, 2, dimsBatch, testData, testData, signs[iDir], GridInfo::plannerFlags);
+			if(!planX[iDir]) die_alone("Failed to create 1D FFT plans for distributed FFT of %d x %d x %d grid.\n", S[0], S[1], S[2]);
+		}
+	}
+	watch.stop();
+}
+
+SlabFFT::~SlabFFT()
+{	for(int iDir=0; iDir<2; iDir++)
+	{	if(planYZ[iDir]) fftw_destroy_plan(planYZ[iDir]);
+		if(planX[iDir]) fftw_destroy_plan(planX[iDir]);
+	}
+}
+
+size_t SlabFFT::nLocal() const
+{	return std::max(size_t(xStop-xStart)*S[1], size_t(yStop-yStart)*S[0]) * S[2];
+}
+
+void SlabFFT::forward(complex* data) const
+{	static StopWatch watch("SlabFFT::forward"); watch.start();
+	if(planYZ[0]) fftw_execute_dft(planYZ[0], (fftw_complex*)data, (fftw_complex*)data);
+	transposeXtoY(data);
+	if(planX[0]) fftw_execute_dft(planX[0], (fftw_complex*)data, (fftw_complex*)data);
+	watch.stop();
+}
+
+void SlabFFT::inverse(complex* data) const
+{	static StopWatch watch("SlabFFT::inverse"); watch.start();
+	if(planX[1]) fftw_execute_dft(planX[1], (fftw_complex*)data, (fftw_complex*)data);
+	transposeYtoX(data);
+	if(planYZ[1]) fftw_execute_dft(planYZ[1], (fftw_complex*)data, (fftw_complex*)data);
+	watch.stop();
+}
+
+//Exchange blocks packed in sendBuf by destination into recvBuf by source (counts and offsets in complex numbers)
+static void alltoall(const MPIUtil* mpiUtil, const complex* sendBuf, const std::vector<int>& sendCounts, const std::vector<int>& sendOffsets,
+	complex* recvBuf, const std::vector<int>& recvCounts, const std::vector<int>& recvOffsets)
+{	static StopWatch watch("SlabFFT::transpose"); watch.start();
+	#ifdef MPI_ENABLED
+	if(mpiUtil->nProcesses() > 1)
+	{	MPI_Alltoallv(sendBuf, sendCounts.data(), sendOffsets.data(), MPI_C_DOUBLE_COMPLEX,
+			recvBuf, recvCounts.data(), recvOffsets.data(), MPI_C_DOUBLE_COMPLEX, mpiUtil->communicator());
+		watch.stop();
+		return;
+	}
+	#endif
+	memcpy(recvBuf, sendBuf, sendCounts[0]*sizeof(complex)); //single process
+	watch.stop();
+}
+
+void SlabFFT::transposeXtoY(complex* data) const
+{	int nProcs = mpiUtil->nProcesses();
+	int nx = xStop-xStart, ny = yStop-yStart;
+	//Pack local x planes by destination y range, as [x-xStart][y-yStartDest][z]:
+	complex* sendData = sendBuf.data();
+	for(int jProc=0; jProc<nProcs; jProc++)
+	{	int ys = yDivision.start(jProc), nyDest = yDivision.stop(jProc)-ys;
+		for(int x=0; x<nx; x++)
+			memcpy(sendData + sendOffsets[jProc] + size_t(x)*nyDest*S[2], data + (size_t(x)*S[1] + ys)*S[2], size_t(nyDest)*S[2]*sizeof(complex));
+	}
+	complex* recvData = recvBuf.data();
+	alltoall(mpiUtil, sendData, sendCounts, sendOffsets, recvData, recvCounts, recvOffsets);
+	//Unpack blocks [x-xStartSrc][y-yStart][z] from each source into local y planes:
+	for(int jProc=0; jProc<nProcs; jProc++)
+	{	int xs = xDivision.start(jProc), nxSrc = xDivision.stop(jProc)-xs;
+		for(int x=0; x<nxSrc; x++)
+			for(int y=0; y<ny; y++)
+				memcpy(data + (size_t(y)*S[0] + xs+x)*S[2], recvData + recvOffsets[jProc] + (size_t(x)*ny + y)*S[2], S[2]*sizeof(complex));
+	}
+}
+
+void SlabFFT::transposeYtoX(complex* data) const
+{	int nProcs = mpiUtil->nProcesses();
+	int nx = xStop-xStart, ny = yStop-yStart;
+	//Pack local y planes by destination x range, as [x-xStartDest][y-yStart][z] (reverse of unpack in transposeXtoY):
+	complex* sendData = recvBuf.data();
+	for(int jProc=0; jProc<nProcs; jProc++)
+	{	int xs = xDivision.start(jProc), nxDest = xDivision.stop(jProc)-xs;
+		for(int x=0; x<nxDest; x++)
+			for(int y=0; y<ny; y++)
+				memcpy(sendData + recvOffsets[jProc] + (size_t(x)*ny + y)*S[2], data + (size_t(y)*S[0] + xs+x)*S[2], S[2]*sizeof(complex));
+	}
+	complex* recvData = sendBuf.data();
+	alltoall(mpiUtil, sendData, recvCounts, recvOffsets, recvData, sendCounts, sendOffsets);
+	//Unpack blocks [x-xStart][y-yStartSrc][z] from each source into local x planes (reverse of pack in transposeXtoY):
+	for(int jProc=0; jProc<nProcs; jProc++)
+	{	int ys = yDivision.start(jProc), nySrc = yDivision.stop(jProc)-ys;
+		for(int x=0; x<nx; x++)
+			memcpy(data + (size_t(x)*S[1] + ys)*S[2], recvData + sendOffsets[jProc] + size_t(x)*nySrc*S[2], size_t(nySrc)*S[2]*sizeof(complex));
+	}
+}
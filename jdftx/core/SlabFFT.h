@@ -0,0 +1,64 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_CORE_SLABFFT_H
+#define JDFTX_CORE_SLABFFT_H
+
+#include <core/MPIUtil.h>
+#include <core/ManagedMemory.h>
+#include <fftw3.h>
+
+//! @addtogroup Operators
+//! @{
+//! @file SlabFFT.h Slab-decomposed complex 3D FFT distributed over MPI processes
+
+//! Complex 3D FFT of a grid too large for one process, distributed as slabs over the processes of mpiUtil.
+//! In real space, each process holds planes x in [xStart,xStop) with data[((x-xStart)*S[1] + y)*S[2] + z].
+//! In reciprocal space, the result is left transposed with each process holding planes y in [yStart,yStop)
+//! with data[((y-yStart)*S[0] + x)*S[2] + z], which saves a second global transpose in each direction.
+//! The 2D transforms of the local planes, the MPI_Alltoallv transpose and the 1D transforms along
+//! the remaining direction are performed in turn; each process needs a buffer of nLocal() entries.
+class SlabFFT
+{
+public:
+	const vector3<int> S; //!< sample counts of the full grid
+	int xStart, xStop; //!< range of x planes of this process in real space
+	int yStart, yStop; //!< range of y planes of this process in reciprocal space
+	
+	//! Create plans for grid S divided over mpiUtil (collective); nThreads=0 uses all available threads
+	SlabFFT(const vector3<int>& S, const MPIUtil* mpiUtil, int nThreads=0);
+	~SlabFFT();
+	
+	size_t nLocal() const; //!< number of entries of data buffer needed on this process (max of real and reciprocal space slabs)
+	void forward(complex* data) const; //!< in-place forward transform (real to reciprocal space, sign convention of Idag); collective
+	void inverse(complex* data) const; //!< in-place inverse transform (reciprocal to real space, sign convention of I); collective
+	
+private:
+	const MPIUtil* mpiUtil;
+	TaskDivision xDivision, yDivision;
+	fftw_plan planYZ[2], planX[2]; //!< 2D plans of local x planes and 1D plans along x of local y planes (forward, inverse)
+	mutable ManagedArray<complex> sendBuf, recvBuf; //!< transpose buffers
+	std::vector<int> sendCounts, sendOffsets, recvCounts, recvOffsets; //!< Alltoallv layout (in complex numbers) for the forward transpose
+	
+	void transposeXtoY(complex* data) const; //!< redistribute x slabs to y slabs
+	void transposeYtoX(complex* data) const; //!< redistribute y slabs to x slabs
+};
+
+//! @}
+#endif // JDFTX_CORE_SLABFFT_H
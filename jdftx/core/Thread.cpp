@@ -22,6 +22,18 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <float.h>
 #include <string.h>
 #include <stdio.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <condition_variable>
+#include <algorithm>
+#include <set>
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <malloc.h>
+#endif
 
 #if defined(MKL_PROVIDES_BLAS) || defined(MKL_PROVIDES_FFT)
 #include <mkl.h>
@@ -62,3 +74,259 @@ void resumeOperatorThreading()
 	#endif
 	#endif
 }
+
+
+//--------------- Thread affinity and first-touch placement ---------------
+
+static std::vector<int> cpuOrder; //cpu assigned to each thread index (empty if threads are not pinned)
+
+//Pin the calling thread to the cpu for thread index iThread (no-op if affinity not set)
+static void pinCurrentThread(int iThread)
+{	if(!cpuOrder.size()) return;
+	#ifdef __linux__
+	cpu_set_t cpuSet; CPU_ZERO(&cpuSet);
+	CPU_SET(cpuOrder[iThread % cpuOrder.size()], &cpuSet);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+	#endif
+}
+
+#ifdef __linux__
+//Read an integer topology property of a cpu from sysfs (-1 if unavailable)
+static int readCpuTopology(int cpu, const char* name)
+{	char fname[256]; sprintf(fname, "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+	FILE* fp = fopen(fname, "r");
+	int result = -1;
+	if(fp)
+	{	if(fscanf(fp, "%d", &result) != 1) result = -1;
+		fclose(fp);
+	}
+	return result;
+}
+#endif
+
+void setThreadAffinity(ThreadAffinity affinity, int iSibling, int nSiblings)
+{	cpuOrder.clear();
+	if(affinity == ThreadAffinityNone) return;
+	#ifdef __linux__
+	cpu_set_t cpuSet;
+	if(sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet))
+	{	logPrintf("Could not determine available cores: threads will not be pinned.\n");
+		return;
+	}
+	//Collect topology of available cpus:
+	struct Cpu
+	{	int cpu, socket, core; //cpu index, and socket and core it belongs to
+		int smt, iInSocket; //hyperthread index within core, and core index within socket (for that hyperthread index)
+	};
+	std::vector<Cpu> cpus;
+	std::map<std::pair<int,int>,int> nPrevOnCore, nPrevOnSocket;
+	for(int cpu=0; cpu<CPU_SETSIZE; cpu++)
+		if(CPU_ISSET(cpu, &cpuSet))
+		{	Cpu c; c.cpu = cpu;
+			c.socket = std::max(0, readCpuTopology(cpu, "physical_package_id"));
+			c.core = readCpuTopology(cpu, "core_id");
+			if(c.core < 0) c.core = cpu;
+			c.smt = nPrevOnCore[std::make_pair(c.socket, c.core)]++;
+			c.iInSocket = nPrevOnSocket[std::make_pair(c.smt, c.socket)]++;
+			cpus.push_back(c);
+		}
+	if(!cpus.size()) return;
+	//Order cpus (first hyperthreads of all cores before any second ones):
+	std::sort(cpus.begin(), cpus.end(), [affinity](const Cpu& a, const Cpu& b)
+	{	if(a.smt != b.smt) return a.smt < b.smt;
+		if(affinity == ThreadAffinityCompact)
+			return (a.socket != b.socket) ? (a.socket < b.socket) : (a.iInSocket < b.iInSocket);
+		else
+			return (a.iInSocket != b.iInSocket) ? (a.iInSocket < b.iInSocket) : (a.socket < b.socket);
+	});
+	//Divide cores between processes on this node, unless already bound (eg. by mpirun):
+	if(nSiblings > 1 && int(cpus.size()) >= sysconf(_SC_NPROCESSORS_ONLN))
+	{	size_t nCores = 0; while(nCores<cpus.size() && cpus[nCores].smt==0) nCores++;
+		std::set<std::pair<int,int>> myCores;
+		for(size_t i=(nCores*iSibling)/nSiblings; i<(nCores*(iSibling+1))/nSiblings; i++)
+			myCores.insert(std::make_pair(cpus[i].socket, cpus[i].core));
+		std::vector<Cpu> myCpus;
+		for(const Cpu& c: cpus)
+			if(myCores.count(std::make_pair(c.socket, c.core)))
+				myCpus.push_back(c);
+		if(myCpus.size()) std::swap(cpus, myCpus);
+	}
+	std::set<int> sockets;
+	for(const Cpu& c: cpus)
+	{	cpuOrder.push_back(c.cpu);
+		sockets.insert(c.socket);
+	}
+	//Pin calling thread to the last position, which handles the last block of each launch (see ThreadPool::Pool::run):
+	pinCurrentThread(std::max(1, nProcsAvailable) - 1);
+	#ifdef __GLIBC__
+	mallopt(M_MMAP_THRESHOLD, 1<<20); //fixed threshold: large buffers always come from fresh pages, placed by firstTouch()
+	#endif
+	logPrintf("Pinned threads (%s) to %d cpus on %d socket(s).\n",
+		affinity==ThreadAffinityCompact ? "compact" : "scatter", int(cpuOrder.size()), int(sockets.size()));
+	#else
+	logPrintf("Thread affinity is only supported on Linux: threads will not be pinned.\n");
+	#endif
+}
+
+bool threadAffinityEnabled()
+{	return cpuOrder.size();
+}
+
+void firstTouch(void* ptr, size_t nBytes)
+{	if(!threadAffinityEnabled() || nBytes < (1<<20)) return; //not worth a launch for small buffers
+	char* data = (char*)ptr;
+	//Split bytes exactly as threadedLoop would split the elements of an array spanning the buffer:
+	auto touch = [data](size_t iMin, size_t iMax) { memset(data+iMin, 0, iMax-iMin); };
+	threadLaunchChunked(0, threadedLoopChunksPerThread, &touch, nBytes);
+}
+
+
+//--------------- Persistent work-stealing thread pool ---------------
+
+namespace ThreadPool
+{
+	typedef std::function<void(size_t,size_t)> Task;
+	
+	//A single call to threadLaunchPool
+	struct Job
+	{	const Task* task;
+		std::atomic<size_t> nPending; //number of ranges not yet completed
+	};
+	
+	//A range of a job, the unit of work queued / stolen
+	struct Range
+	{	Job* job;
+		size_t iMin, iMax;
+		void operator()() const
+		{	(*job->task)(iMin, iMax);
+			job->nPending--; //job may be freed by its owner immediately after this
+		}
+	};
+	
+	//Work queue owned by one thread: owner takes from the back (most recently queued, cache-hot),
+	//while other threads steal from the front (largest remaining contiguous block of work)
+	struct Queue
+	{	std::mutex lock;
+		std::deque<Range> ranges;
+		
+		bool pop(Range& r)
+		{	std::lock_guard<std::mutex> lg(lock);
+			if(ranges.empty()) return false;
+			r = ranges.back(); ranges.pop_back();
+			return true;
+		}
+		
+		bool steal(Range& r)
+		{	std::lock_guard<std::mutex> lg(lock);
+			if(ranges.empty()) return false;
+			r = ranges.front(); ranges.pop_front();
+			return true;
+		}
+	};
+	
+	static const int nWorkersMax = 1024;
+	thread_local int iQueueSelf = nWorkersMax; //queue owned by current thread (workers get theirs on startup)
+	
+	//Pool state: allocated once and never freed, so that detached (idle) workers
+	//never wait on synchronization objects destroyed during static destruction at exit
+	struct Pool
+	{	Queue queues[nWorkersMax+1]; //one per worker thread, and a shared one (the last) for threads external to the pool
+		std::atomic<int> nWorkers; //number of worker threads started so far
+		std::mutex growLock; //serializes growth of the pool
+		std::atomic<size_t> nQueued; //total number of ranges waiting in all queues
+		std::mutex sleepLock; std::condition_variable wakeup; //idle workers sleep on this till work is queued
+		
+		Pool() : nWorkers(0), nQueued(0) {}
+		
+		static Pool& get()
+		{	static Pool* pool = new Pool();
+			return *pool;
+		}
+		
+		//Find a range to work on, first from own queue and then by stealing from others
+		bool findWork(Range& r)
+		{	bool found = queues[iQueueSelf].pop(r);
+			int nQueues = nWorkers;
+			int iSelf = (iQueueSelf==nWorkersMax) ? nQueues : iQueueSelf; //position in cyclic order with the external queue last
+			for(int j=1; (!found) && j<=nQueues; j++)
+			{	int iQueue = (iSelf + j) % (nQueues+1); //start stealing from the neighbour to spread out contention
+				found = queues[iQueue==nQueues ? nWorkersMax : iQueue].steal(r);
+			}
+			if(found) nQueued--;
+			return found;
+		}
+		
+		static void workerLoop(Pool* pool, int iWorker)
+		{	iQueueSelf = iWorker;
+			pinCurrentThread(iWorker);
+			StopWatch::initThreadCounters(); //so that profiled sections include work done on pool threads
+			while(true)
+			{	Range r;
+				if(pool->findWork(r)) { r(); continue; }
+				std::unique_lock<std::mutex> lk(pool->sleepLock);
+				pool->wakeup.wait(lk, [pool]{ return pool->nQueued > 0; });
+			}
+		}
+		
+		//Ensure that at least nWorkersNeeded worker threads exist
+		void grow(int nWorkersNeeded)
+		{	nWorkersNeeded = std::min(nWorkersNeeded, nWorkersMax);
+			if(nWorkers >= nWorkersNeeded) return;
+			std::lock_guard<std::mutex> lg(growLock);
+			while(nWorkers < nWorkersNeeded)
+			{	std::thread(workerLoop, this, int(nWorkers)).detach(); //never joined: the pool lives for the duration of the process
+				nWorkers++;
+			}
+		}
+		
+		//Queue ranges[iStart:iStop] onto queue iQueue
+		void enqueue(int iQueue, const std::vector<Range>& ranges, size_t iStart, size_t iStop)
+		{	if(iStart >= iStop) return;
+			std::lock_guard<std::mutex> lg(queues[iQueue].lock);
+			//Owner pops from the back, so queue in reverse to have it process its share in increasing order:
+			for(size_t i=iStop; i>iStart; i--) queues[iQueue].ranges.push_back(ranges[i-1]);
+		}
+		
+		//Execute a job divided into specified ranges, using up to nThreads threads (including the calling one)
+		void run(int nThreads, Job& job, const std::vector<Range>& ranges)
+		{	grow(nThreads-1);
+			job.nPending = ranges.size();
+			//Distribute contiguous blocks of ranges to the queues (last block to the calling thread):
+			int nWorkersUsed = std::min(nThreads-1, int(nWorkers));
+			int nShares = nWorkersUsed + 1;
+			nQueued += ranges.size();
+			for(int t=0; t<nShares; t++)
+				enqueue(t<nWorkersUsed ? t : iQueueSelf, ranges, (t*ranges.size())/nShares, ((t+1)*ranges.size())/nShares);
+			{	std::lock_guard<std::mutex> lg(sleepLock);
+				wakeup.notify_all();
+			}
+			//Work (including on ranges of other jobs, which makes nested launches safe) until own job is complete:
+			while(job.nPending)
+			{	Range r;
+				if(findWork(r)) r();
+				else std::this_thread::yield();
+			}
+		}
+	};
+}
+
+void threadLaunchPool(int nThreads, size_t nJobs, int nChunksPerThread, const std::function<void(size_t,size_t)>& task)
+{	using namespace ThreadPool;
+	//Split work into ranges:
+	Job job; job.task = &task;
+	std::vector<Range> ranges;
+	if(nJobs > 0)
+	{	size_t nChunks = std::min(nJobs, size_t(nThreads)*std::max(1,nChunksPerThread));
+		for(size_t c=0; c<nChunks; c++)
+		{	Range r = { &job, (c*nJobs)/nChunks, ((c+1)*nJobs)/nChunks };
+			ranges.push_back(r);
+		}
+	}
+	else
+	{	for(int t=0; t<nThreads; t++)
+		{	Range r = { &job, size_t(t), size_t(nThreads) };
+			ranges.push_back(r);
+		}
+	}
+	Pool::get().run(nThreads, job, ranges);
+}
@@ -28,9 +28,11 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Util.h>
 #include <thread>
 #include <mutex>
+#include <functional>
 #include <unistd.h>
 
 extern int nProcsAvailable; //!< number of available processors (initialized to number of online processors, can be overriden)
+int getPhysicalCores(); //!< number of physical cores on this node (ignoring hyperthreads where this can be determined)
 
 /**
 Operators should run multithreaded if this returns true,
@@ -47,12 +49,35 @@ bool shouldThreadOperators();
 void suspendOperatorThreading(); //!< call from multi-threaded top-level code to disable threading within operators called from a parallel section
 void resumeOperatorThreading(); //!< call after a parallel section in top-level code to resume threading within subsequent operator calls
 
+//! Placement of threads on cores (Linux only)
+enum ThreadAffinity
+{	ThreadAffinityNone, //!< leave thread placement to the operating system (default)
+	ThreadAffinityCompact, //!< fill one socket before the next, with consecutive threads on adjacent cores
+	ThreadAffinityScatter //!< distribute consecutive threads round-robin over the sockets
+};
+
+/**
+Pin the calling (main) thread and all subsequently started pool threads to cores.
+The cores available to the process (see sched_getaffinity) are ordered as specified by affinity
+(one hyperthread per core before any second ones), and if the process is not already bound
+to a subset of the node, divided evenly between the nSiblings processes sharing the node.
+Call once during initialization, after nProcsAvailable has been finalized and before any threads are launched.
+*/
+void setThreadAffinity(ThreadAffinity affinity, int iSibling=0, int nSiblings=1);
+bool threadAffinityEnabled(); //!< whether threads have been pinned by setThreadAffinity
+
+//! Touch the pages of a freshly allocated CPU buffer with the same static thread partition used by
+//! threadedLoop, so that each page is first touched (and hence placed on the NUMA node of) the thread that
+//! will typically process it. No-op unless threadAffinityEnabled().
+void firstTouch(void* ptr, size_t nBytes);
+
 
 /**
 @brief A simple utility for running muliple threads
 
 Given a callable object func and an argument list args, this routine calls nThreads threads
-of func invoked as func(iMin, iMax, args). The nJobs jobs are evenly split between all the threads;
+of func invoked as func(iMin, iMax, args). The threads are drawn from a persistent pool
+(created on first use and grown on demand), so repeated launches do not pay for thread creation. The nJobs jobs are evenly split between all the threads;
 each instance of func should handle job index i satisfying iMin <= i < iMax.
 
 If nJobs <= 0, the behaviour changes: the function is invoked as func(iThread, nThreads, args)
@@ -86,8 +111,9 @@ Note that the calls are made from multiple threads, so func must
 be thread safe. (Hint: pass mutexes as a part of args if synchronization
 is required).
 
-As many threads as online processors are launched and the nIter iterations are evenly split
-between all the threads. Threaded loops will become single threaded if suspendOperatorThreading().
+As many threads as online processors are used, and the nIter iterations are split into
+several chunks per thread that are dynamically balanced between threads by work stealing.
+Threaded loops will become single threaded if suspendOperatorThreading().
 
 @param func The function / object with operator() to be looped over
 @param nIter The number of loop 'iterations'
@@ -114,23 +140,23 @@ double threadedAccumulate(Callable* func, size_t nIter, Args... args);
 //##########################
 //! @cond
 
+//Run task(iMin,iMax) on nThreads threads of the persistent pool, with each thread's share of [0,nJobs)
+//split into nChunksPerThread ranges that may be stolen by idle threads (implemented in Thread.cpp).
+//If nJobs<=0, task(iThread,nThreads) is invoked for each 0 <= iThread < nThreads instead.
+void threadLaunchPool(int nThreads, size_t nJobs, int nChunksPerThread, const std::function<void(size_t,size_t)>& task);
+
 template<typename Callable,typename ... Args>
-void threadLaunch(int nThreads, Callable* func, size_t nJobs, Args... args)
+void threadLaunchChunked(int nThreads, int nChunksPerThread, Callable* func, size_t nJobs, Args... args)
 {	if(nThreads<=0) nThreads = shouldThreadOperators() ? nProcsAvailable : 1;
-	if(nThreads>1) suspendOperatorThreading(); //Prevent func and anything it calls from launching nested threads
-	std::thread** tArr = new std::thread*[nThreads-1];
-	for(int t=0; t<nThreads; t++)
-	{	size_t i1 = (nJobs>0 ? (  t   * nJobs)/nThreads : t);
-		size_t i2 = (nJobs>0 ? ((t+1) * nJobs)/nThreads : nThreads);
-		if(t<nThreads-1) tArr[t] = new std::thread(func, i1, i2, args...);
-		else (*func)(i1, i2, args...);
-	}
-	for(int t=0; t<nThreads-1; t++)
-	{	tArr[t]->join();
-		delete tArr[t];
-	}
-	delete[] tArr;
-	if(nThreads>1) resumeOperatorThreading(); //End nested threading guard section
+	if(nThreads==1) { (*func)(0, nJobs>0 ? nJobs : 1, args...); return; } //serial fast path
+	suspendOperatorThreading(); //Prevent func and anything it calls from launching nested threads
+	threadLaunchPool(nThreads, nJobs, nChunksPerThread, [&](size_t iMin, size_t iMax) { (*func)(iMin, iMax, args...); });
+	resumeOperatorThreading(); //End nested threading guard section
+}
+
+template<typename Callable,typename ... Args>
+void threadLaunch(int nThreads, Callable* func, size_t nJobs, Args... args)
+{	threadLaunchChunked(nThreads, 1, func, nJobs, args...); //one contiguous range per thread (callers may rely on this split)
 }
 
 template<typename Callable,typename ... Args>
@@ -139,13 +165,15 @@ void threadLaunch(Callable* func, size_t nJobs, Args... args)
 }
 
 
+static const int threadedLoopChunksPerThread = 4; //granularity of dynamic load balancing in threadedLoop and threadedAccumulate
+
 template<typename Callable,typename ... Args>
 void threadedLoop_sub(size_t iMin, size_t iMax, Callable* func, Args... args)
 {	for(size_t i=iMin; i<iMax; i++) (*func)(i, args...);
 }
 template<typename Callable,typename ... Args>
 void threadedLoop(Callable* func, size_t nIter, Args... args)
-{	threadLaunch(threadedLoop_sub<Callable,Args...>, nIter, func, args...);
+{	threadLaunchChunked(0, threadedLoopChunksPerThread, threadedLoop_sub<Callable,Args...>, nIter, func, args...);
 }
 
 template<typename Callable,typename ... Args>
@@ -158,7 +186,7 @@ template<typename Callable,typename ... Args>
 double threadedAccumulate(Callable* func, size_t nIter, Args... args)
 {	double accumTot=0.0;
 	std::mutex m;
-	threadLaunch(threadedAccumulate_sub<Callable,Args...>, nIter, func, &accumTot, &m, args...);
+	threadLaunchChunked(0, threadedLoopChunksPerThread, threadedAccumulate_sub<Callable,Args...>, nIter, func, &accumTot, &m, args...);
 	return accumTot;
 }
 
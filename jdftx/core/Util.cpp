@@ -69,7 +69,7 @@ void printUsage(const char *name, const InitParams& ip)
 	logPrintf("\t-d --no-append          overwrite output file instead of appending\n");
 	logPrintf("\t-t --template           print an input file template\n");
 	logPrintf("\t-m --mpi-debug-log      write output from secondary MPI processes to jdftx.<proc>.mpiDebugLog (instead of /dev/null)\n");
-	logPrintf("\t-n --dry-run            quit after initialization (to verify commands and other input files)\n");
+	logPrintf("\t-n --dry-run            quit after initialization (to verify commands and other input files),\n\t                        reporting setup timings and estimated memory and per-iteration cost\n");
 	logPrintf("\t-c --cores              number of cores per process (ignored when launched using SLURM)\n");
 	logPrintf("\t-G --nGroups            number of MPI process groups (default or 0 => each process in own group of size 1)\n");
 	logPrintf("\t-s --skip-defaults      skip printing status of default commands issued automatically.\n");
@@ -145,13 +145,19 @@ void logResume()
 {	globalLog = globalLogOrig;
 }
 
+void logRedirect(FILE* fp)
+{	globalLog = globalLogOrig = fp;
+}
+
 int nProcessGroups = 0;
 MPIUtil* mpiWorld = 0;
 MPIUtil* mpiGroup = 0;
 MPIUtil* mpiGroupHead = 0;
+MPIUtil* mpiHost = 0;
 bool mpiDebugLog = false;
 bool manualThreadCount = false;
 size_t mempoolSize = 0;
+size_t memcacheSize = size_t(256) << 20; //256 MB default
 static double startTime_us; //Time at which system was initialized in microseconds
 const char* argv0 = 0;
 uint32_t crc32(const string& s); //CRC32 checksum for a string (implemented below)
@@ -196,11 +202,25 @@ void initSystem(int argc, char** argv, const InitParams* ip)
 	nullLog = fopen("/dev/null", "w");
 	if(!mpiWorld->isHead())
 	{	if(mpiDebugLog)
-		{	char fname[256]; sprintf(fname, "jdftx.%d.mpiDebugLog", mpiWorld->iProcess());
+		{	//Optionally on node-local storage:
+			const char* debugLogDir = getenv("JDFTX_DEBUG_LOG_DIR");
+			char fname[1024]; snprintf(fname, sizeof(fname), "%s%sjdftx.%d.mpiDebugLog",
+				debugLogDir ? debugLogDir : "", debugLogDir ? "/" : "", mpiWorld->iProcess());
 			globalLog = fopen(fname, "w");
+			if(!globalLog) globalLog = nullLog;
 		}
 		else globalLog = nullLog;
 	}
+	
+	//Asynchronous logging (only when not writing to a terminal, to keep interactive output prompt):
+	const char* asyncLogStr = getenv("JDFTX_ASYNC_LOG");
+	int asyncLogMB = 0;
+	if(asyncLogStr && !(sscanf(asyncLogStr, "%d", &asyncLogMB)==1 && asyncLogMB>=0))
+	{	fprintf(stderr, "Could not determine asynchronous log buffer size from JDFTX_ASYNC_LOG=\"%s\".\n", asyncLogStr);
+		asyncLogMB = 0;
+	}
+	if(asyncLogMB && globalLog != nullLog && !(globalLog == stdout && isatty(fileno(stdout))))
+		globalLog = asyncLogOpen(globalLog, ((size_t)asyncLogMB) << 20);
 	globalLogOrig = globalLog;
 	
 	//Star time and commandline:
@@ -227,10 +247,10 @@ void initSystem(int argc, char** argv, const InitParams* ip)
 	}
 	int hostsum = abs(int(crc32(hostname))); //ensure positive for MPI_split below
 	//---- create MPI group for each host:
-	MPIUtil mpiHost(0,0, MPIUtil::ProcDivision(mpiWorld, 0, hostsum));
+	mpiHost = new MPIUtil(0,0, MPIUtil::ProcDivision(mpiWorld, 0, hostsum));
 	MPIUtil mpiHostGpu(0,0, MPIUtil::ProcDivision(mpiWorld, 0, isGpuEnabled() ? hostsum : 0)); //for grouping processes with GPUs
-	MPIUtil mpiHostHead(0,0, MPIUtil::ProcDivision(mpiWorld, 0, mpiHost.iProcess())); //communicator between similar rank within each host
-	printProcessDistribution("Running on hosts", hostname, &mpiHost, &mpiHostHead);
+	MPIUtil mpiHostHead(0,0, MPIUtil::ProcDivision(mpiWorld, 0, mpiHost->iProcess())); //communicator between similar rank within each host
+	printProcessDistribution("Running on hosts", hostname, mpiHost, &mpiHostHead);
 	
 	//Initialize process groups:
 	if(nProcessGroups <= 0) nProcessGroups = mpiWorld->nProcesses(); //default: one group per process
@@ -257,8 +277,8 @@ void initSystem(int argc, char** argv, const InitParams* ip)
 	
 	//Divide up available cores between all MPI processes on a given node:
 	if(!manualThreadCount) //skip if number of cores per process has been set with -c
-	{	int nSiblings = mpiHost.nProcesses();
-		int iSibling = mpiHost.iProcess();
+	{	int nSiblings = mpiHost->nProcesses();
+		int iSibling = mpiHost->iProcess();
 		nProcsAvailable = std::max(1, (nProcsAvailable * (iSibling+1))/nSiblings - (nProcsAvailable*iSibling)/nSiblings);
 	}
 	
@@ -273,6 +293,15 @@ void initSystem(int argc, char** argv, const InitParams* ip)
 	}
 	resumeOperatorThreading(); //if necessary, this informs MKL of the thread count
 	
+	//Thread affinity:
+	const char* affinityStr = getenv("JDFTX_THREAD_AFFINITY");
+	if(affinityStr)
+	{	if(!strcmp(affinityStr,"compact")) setThreadAffinity(ThreadAffinityCompact, mpiHost->iProcess(), mpiHost->nProcesses());
+		else if(!strcmp(affinityStr,"scatter")) setThreadAffinity(ThreadAffinityScatter, mpiHost->iProcess(), mpiHost->nProcesses());
+		else if(strcmp(affinityStr,"none"))
+			logPrintf("Could not determine thread affinity from JDFTX_THREAD_AFFINITY=\"%s\" (should be compact, scatter or none).\n", affinityStr);
+	}
+	
 	//Print total resources used by run:
 	{	int nProcsTot = nProcsAvailable; mpiWorld->allReduce(nProcsTot, MPIUtil::ReduceSum);
 		double nGPUsTot = nGPUs; mpiWorld->allReduce(nGPUsTot, MPIUtil::ReduceSum);
@@ -292,6 +321,85 @@ void initSystem(int argc, char** argv, const InitParams* ip)
 			logPrintf("Could not determine memory pool size from JDFTX_MEMPOOL_SIZE=\"%s\".\n", mempoolSizeStr);
 	}
 	
+	//Memory telemetry:
+	const char* memstatsStr = getenv("JDFTX_MEMSTATS");
+	if(memstatsStr && strlen(memstatsStr))
+	{	ManagedMemoryBase::statsEnabled = true;
+		if(strcmp(memstatsStr, "yes")) ManagedMemoryBase::statsPrefix = memstatsStr; //any other value is a JSON file prefix
+	}
+	const char* memcapStr = getenv("JDFTX_MEMCAP");
+	if(memcapStr)
+	{	double memcapMB;
+		if(sscanf(memcapStr, "%lg", &memcapMB)==1 && memcapMB>=0.)
+		{	ManagedMemoryBase::softCap = size_t(memcapMB * (1<<20));
+			if(ManagedMemoryBase::softCap) ManagedMemoryBase::statsEnabled = true; //needed to track usage
+		}
+		else
+			logPrintf("Could not determine memory cap from JDFTX_MEMCAP=\"%s\".\n", memcapStr);
+	}
+	if(ManagedMemoryBase::statsEnabled)
+	{	logPrintf("Memory telemetry enabled");
+		if(ManagedMemoryBase::statsPrefix.length()) logPrintf(" (JSON: %s.<process>.json)", ManagedMemoryBase::statsPrefix.c_str());
+		if(ManagedMemoryBase::softCap) logPrintf(" with soft cap %lg MB per memory space", ManagedMemoryBase::softCap/1048576.);
+		logPrintf(".\n");
+	}
+	
+	//Run-time profiling:
+	const char* profileStr = getenv("JDFTX_PROFILE");
+	if(profileStr)
+	{	if(!strcmp(profileStr,"yes")) StopWatch::profilingEnabled = true;
+		else if(!strcmp(profileStr,"no")) StopWatch::profilingEnabled = false;
+		else logPrintf("Could not determine profiling mode from JDFTX_PROFILE=\"%s\" (should be yes or no).\n", profileStr);
+	}
+	const char* countersStr = getenv("JDFTX_PROFILE_COUNTERS");
+	if(countersStr)
+	{	if(!strcmp(countersStr,"yes")) StopWatch::profilingEnabled = StopWatch::countersEnabled = true;
+		else if(strcmp(countersStr,"no")) logPrintf("Could not determine counter mode from JDFTX_PROFILE_COUNTERS=\"%s\" (should be yes or no).\n", countersStr);
+	}
+	const char* peakGflopsStr = getenv("JDFTX_PEAK_GFLOPS");
+	if(peakGflopsStr && !(sscanf(peakGflopsStr, "%lg", &StopWatch::peakGflops)==1 && StopWatch::peakGflops>=0.))
+	{	logPrintf("Could not determine peak floating-point rate from JDFTX_PEAK_GFLOPS=\"%s\".\n", peakGflopsStr);
+		StopWatch::peakGflops = 0.;
+	}
+	const char* peakBandwidthStr = getenv("JDFTX_PEAK_BANDWIDTH");
+	if(peakBandwidthStr && !(sscanf(peakBandwidthStr, "%lg", &StopWatch::peakBandwidth)==1 && StopWatch::peakBandwidth>=0.))
+	{	logPrintf("Could not determine peak memory bandwidth from JDFTX_PEAK_BANDWIDTH=\"%s\".\n", peakBandwidthStr);
+		StopWatch::peakBandwidth = 0.;
+	}
+	const char* traceStr = getenv("JDFTX_TRACE");
+	if(traceStr && strlen(traceStr))
+	{	StopWatch::tracePrefix = traceStr;
+		StopWatch::profilingEnabled = true; //tracing requires profiling
+	}
+	if(StopWatch::profilingEnabled)
+		logPrintf("Profiling enabled%s.\n", StopWatch::tracePrefix.length()
+			? (" (trace: " + StopWatch::tracePrefix + ".<process>.json)").c_str() : "");
+	
+	//Two-level collectives:
+	const char* hierarchicalStr = getenv("JDFTX_HIERARCHICAL_COLLECTIVES");
+	if(hierarchicalStr)
+	{	double minMB;
+		if(sscanf(hierarchicalStr, "%lg", &minMB)==1 && minMB>=0.)
+		{	MPIUtil::hierarchicalMinBytes = size_t(minMB * (1<<20));
+			if(MPIUtil::hierarchicalMinBytes)
+				logPrintf("Two-level (node-aware) collectives for messages >= %lg MB.\n", minMB);
+		}
+		else
+			logPrintf("Could not determine collective message size threshold from JDFTX_HIERARCHICAL_COLLECTIVES=\"%s\".\n", hierarchicalStr);
+	}
+	
+	//Memory cache size:
+	const char* memcacheSizeStr = getenv("JDFTX_MEMCACHE_SIZE");
+	if(memcacheSizeStr)
+	{	int memcacheSizeMB;
+		if(sscanf(memcacheSizeStr, "%d", &memcacheSizeMB)==1 && memcacheSizeMB>=0)
+		{	memcacheSize = ((size_t)memcacheSizeMB) << 20; //convert to bytes
+			logPrintf("Memory cache size: %d MB (per process)\n", memcacheSizeMB);
+		}
+		else
+			logPrintf("Could not determine memory cache size from JDFTX_MEMCACHE_SIZE=\"%s\".\n", memcacheSizeStr);
+	}
+	
 	//Add citations to the code for all calculations:
 	Citations::add("Software package",
 		"R. Sundararaman, K. Letchworth-Weaver, K.A. Schwarz, D. Gunceler, Y. Ozhabes and T.A. Arias, "
@@ -384,18 +492,6 @@ void initSystemCmdline(int argc, char** argv, InitParams& ip)
 	initSystem(argc, argv, &ip);
 }
 
-#ifdef ENABLE_PROFILING
-void stopWatchManager(const StopWatch* addWatch=0, const string* watchName=0)
-{	static std::multimap<string, const StopWatch*> watches; //static array of all watches
-	if(addWatch) watches.insert(std::make_pair(*watchName,addWatch));
-	else //print timings:
-	{	logPrintf("\n");
-		for(const auto& wPair: watches) wPair.second->print();
-	}
-}
-#endif // ENABLE_PROFILING
-
-
 void finalizeSystem(bool successful)
 {
 	time_t endTime = time(0);
@@ -415,11 +511,12 @@ void finalizeSystem(bool successful)
 			fprintf(stderr, "Failed.\n");
 	}
 	
-	#ifdef ENABLE_PROFILING
-	stopWatchManager();
-	logPrintf("\n");
-	ManagedMemoryBase::reportUsage();
-	#endif
+	if(StopWatch::profilingEnabled)
+	{	StopWatch::report();
+		logPrintf("\n");
+		ManagedMemoryBase::reportUsage(); //includes memory telemetry, if enabled
+	}
+	else ManagedMemoryBase::reportStats(); //memory telemetry, if enabled
 	
 	if(!mpiWorld->isHead())
 	{	if(mpiDebugLog) fclose(globalLog);
@@ -430,6 +527,7 @@ void finalizeSystem(bool successful)
 		fclose(globalLog);
 	delete mpiGroupHead;
 	delete mpiGroup;
+	delete mpiHost;
 	delete mpiWorld;
 }
 
@@ -450,34 +548,6 @@ double clock_sec()
 }
 
 
-#ifdef ENABLE_PROFILING
-StopWatch::StopWatch(string name) : Ttot(0), TsqTot(0), nT(0), name(name) { stopWatchManager(this, &name); }
-void StopWatch::start()
-{
-	#ifdef GPU_ENABLED
-	cudaThreadSynchronize();
-	#endif
-	tPrev = clock_us();
-}
-void StopWatch::stop()
-{
-	#ifdef GPU_ENABLED
-	cudaThreadSynchronize();
-	#endif
-	double T = clock_us()-tPrev;
-	Ttot+=T; TsqTot+=T*T; nT++;
-}
-void StopWatch::print() const
-{	if(nT)
-	{	double meanT = Ttot/nT;
-		double sigmaT = sqrt(TsqTot/nT - meanT*meanT);
-		logPrintf("PROFILER: %30s %12.6lf +/- %12.6lf s, %4d calls, %13.6lf s total\n",
-			name.c_str(), meanT*1e-6, sigmaT*1e-6, nT, Ttot*1e-6);
-	}
-}
-#endif //ENABLE_PROFILING
-
-
 // Print a minimal stack trace (convenient for debugging)
 void printStack(bool detailedStackScript)
 {	const int maxStackLength = 1024;
@@ -585,6 +655,7 @@ size_t fwriteLE(const void *ptr, size_t size, size_t nmemb, FILE *fp)
 // Exit on error with a more in-depth stack trace
 void stackTraceExit(int code)
 {	printStack(true);
+	asyncLogDrain();
 	mpiWorld->exit(code);
 }
 
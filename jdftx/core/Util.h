@@ -26,6 +26,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 //! @file Util.h Miscellaneous utilities
 
 #include <core/MPIUtil.h>
+#include <core/Profiler.h>
 #include <map>
 #include <array>
 #include <cstring>
@@ -43,8 +44,10 @@ extern bool killFlag; //!< Flag set by signal handlers - all compute loops shoul
 extern MPIUtil* mpiWorld; //!< MPI across all processes
 extern MPIUtil* mpiGroup; //!< MPI within current group of processes
 extern MPIUtil* mpiGroupHead; //!< MPI across equal ranks in each group
+extern MPIUtil* mpiHost; //!< MPI within current node (host), used for node-shared memory (see NodeSharedArray)
 extern bool mpiDebugLog; //!< If true, all processes output to seperate debug log files, otherwise only head process outputs (set before calling initSystem())
 extern size_t mempoolSize; //!< If non-zero, size of memory pool managed internally by JDFTx
+extern size_t memcacheSize; //!< If non-zero, maximum unused memory held (per memory space) for reuse by freed blocks of the same category and size class
 
 //! Parameters used for common initialization functions
 struct InitParams
@@ -84,32 +87,7 @@ Code must be self-contained as a scope, as it will be surrounded by { }, and sho
 	fprintf(fp, "%s took %.2le s.\n", title, runTime*1e-6); \
 }
 
-//! Quick drop-in profiler for any function. Usage:
-//! * Create a static object of this class in the function
-//! * Call start and stop before and after the section to be timed
-//! * Timing statistics of the code block will be printed on exit
-#ifdef ENABLE_PROFILING
-class StopWatch
-{
-public:
-	StopWatch(string name);
-	void start();
-	void stop();
-	void print() const;
-private:
-	double tPrev, Ttot, TsqTot; int nT;
-	string name;
-};
-#else //ENABLE_PROFILING
-//Version which does no profiling for release versions
-class StopWatch
-{
-public:
-	StopWatch(string name) {}
-	void start() {}
-	void stop() {}
-};
-#endif //ENABLE_PROFILING
+//StopWatch: drop-in profiler for any function, see core/Profiler.h
 
 
 
@@ -127,6 +105,9 @@ extern FILE* globalLog;
 extern FILE* nullLog; //!< pointer to /dev/null
 void logSuspend(); //!< temporarily disable all log output (until logResume())
 void logResume(); //!< re-enable logging after a logSuspend() call
+void logRedirect(FILE* fp); //!< send all subsequent log output to fp (which logResume() will also return to)
+FILE* asyncLogOpen(FILE* fp, size_t bufferSize); //!< Wrap fp in a stream whose writes and flushes only copy into a buffer of bufferSize bytes, written to fp by a background thread (closing it closes fp, except stdout / stderr)
+void asyncLogDrain(); //!< Wait (up to a few seconds) for all asynchronous log streams to reach their files (called on error exits)
 
 #define logPrintf(...) fprintf(globalLog, __VA_ARGS__) //!< printf() for log files
 #define logFlush() fflush(globalLog) //!< fflush() for log files
@@ -144,6 +125,7 @@ void logResume(); //!< re-enable logging after a logSuspend() call
 #define die_alone(...) \
 	{	fprintf(globalLog, __VA_ARGS__); \
 		fflush(globalLog); \
+		asyncLogDrain(); \
 		if(mpiWorld->isHead() && globalLog != stdout) \
 			fprintf(stderr, __VA_ARGS__); \
 		mpiWorld->exit(1); \
@@ -173,6 +155,7 @@ off_t fileSize(const char *filename);
 #endif
 
 //Endianness utilities (all binary I/O is from little-endian files regardless of operating endianness):
+bool isLittleEndian(); //!< Whether the operating endianness is little-endian
 void convertToLE(void* ptr, size_t size, size_t nmemb); //!< Convert data from operating endianness to little-endian
 void convertFromLE(void* ptr, size_t size, size_t nmemb); //!< Convert data from little-endian to operating endianness
 size_t freadLE(void *ptr, size_t size, size_t nmemb, FILE* fp); //!< Read from a little-endian binary file, regardless of operating endianness
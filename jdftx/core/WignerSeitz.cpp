@@ -146,6 +146,18 @@ WignerSeitz::WignerSeitz(const matrix3<>& R)
 	logPrintf("%lu faces (%d quadrilaterals, %d hexagons)\n", face.size(), nQuad, nHex);
 }
 
+WignerSeitz::MeshRestriction::MeshRestriction(const WignerSeitz& ws, const vector3<int>& S) : S(S)
+{	for(const Face* f: ws.faceHalf)
+	{	vector3<> eqnMesh; vector3<int> imgMesh;
+		for(int k=0; k<3; k++)
+		{	eqnMesh[k] = f->eqn[k] / S[k];
+			imgMesh[k] = f->img[k] * S[k];
+		}
+		eqn.push_back(eqnMesh);
+		img.push_back(imgMesh);
+	}
+}
+
 WignerSeitz::~WignerSeitz()
 {	for(Vertex* v: vertex) delete v;
 	for(Edge* e: edge) delete e;
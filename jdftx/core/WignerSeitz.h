@@ -28,6 +28,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <array>
 #include <list>
 #include <set>
+#include <vector>
 
 //! Wigner-Seitz construction for a 3D lattice (and 2D lattice with orthogonal 3rd direction)
 class WignerSeitz
@@ -77,6 +78,45 @@ public:
 		return ivWS;
 	}
 	
+	//! Restriction to the Wigner-Seitz cell for loops over all points of a mesh with sample count S,
+	//! with the face equations and images pre-scaled to mesh coordinates once per mesh.
+	//! Points are first folded into the mesh cell centered at the origin, after which at most a few face corrections are needed.
+	//! Otherwise equivalent to restrict(iv, S, invS), except that equivalent points on the Wigner-Seitz boundary may map to another image.
+	class MeshRestriction
+	{
+	public:
+		MeshRestriction(const WignerSeitz& ws, const vector3<int>& S);
+		
+		inline vector3<int> operator()(vector3<int> iv) const
+		{	static const double tol = 1e-8;
+			for(int k=0; k<3; k++) //fold into [-S/2, S/2)
+			{	iv[k] %= S[k];
+				if(iv[k] < 0) iv[k] += S[k];
+				if(2*iv[k] >= S[k]) iv[k] -= S[k];
+			}
+			bool changed = true;
+			while(changed)
+			{	changed = false;
+				for(size_t iFace=0; iFace<eqn.size(); iFace++)
+				{	const vector3<>& eqnCur = eqn[iFace];
+					double d = 0.5 * (1. + eqnCur[0]*iv[0] + eqnCur[1]*iv[1] + eqnCur[2]*iv[2]);
+					if(d<-tol || d>1.+tol) //not in fundamental zone
+					{	int id = int(floor(d));
+						for(int k=0; k<3; k++)
+							iv[k] -= id * img[iFace][k];
+						changed = true;
+					}
+				}
+			}
+			return iv;
+		}
+	
+	private:
+		vector3<int> S; //!< mesh sample count
+		std::vector<vector3<>> eqn; //!< face equations (one from each inversion pair) in mesh coordinates
+		std::vector<vector3<int>> img; //!< corresponding images of the origin in mesh coordinates
+	};
+	
 	//! Find the smallest distance of a point inside the Wigner-Seitz cell from its surface
 	//! Returns 0 if the point is outside the Wigner-Seitz cell
 	//! Ignore direction iDir to obtain 2D behavior, if iDir >= 0
@@ -95,6 +95,10 @@ public:
 	void print_real(FILE* fp, const char* fmt="%lg\t") const; //!< print (ascii) real parts to stream
 	
 	void diagonalize(matrix& evecs, diagMatrix& eigs) const; //!< diagonalize a hermitian matrix
+	//! Diagonalize a hermitian matrix collectively over all processes of mpiUtil, using ScaLAPACK (pzheevd) on a 2D block-cyclic
+	//! process grid when available (and the matrix is large enough to benefit), or the serial version above on root otherwise.
+	//! Only the matrix on process root is used (it may be empty elsewhere); the results are returned on all processes.
+	void diagonalize(matrix& evecs, diagMatrix& eigs, const class MPIUtil* mpiUtil, int root=0) const;
 	void diagonalize(matrix& levecs, std::vector<complex>& eigs, matrix& revecs) const; //!< diagonalize an arbitrary matrix
 	void svd(matrix& U, diagMatrix& S, matrix& Vdag) const; //!< singular value decomposition (for dimensions of this: MxN, on output U: MxM, S: min(M,N), Vdag: NxN)
 	
@@ -201,11 +205,10 @@ matrix inv(const matrix& A); //!< inverse of matrix
 diagMatrix inv(const diagMatrix& A); //!< inverse of diagonal matrix
 matrix invApply(const matrix& A, const matrix& b); //!< return inv(A) * b (A must be hermitian, positive-definite)
 
-//! Compute the LU decomposition of the matrix
-matrix LU(const matrix& A);
+//! Compute the LU decomposition of the matrix, optionally retrieving the sign (+/-1) of the row permutation in permSign
+matrix LU(const matrix& A, int* permSign=0);
 
-//! Compute the determinant of an arbitrary matrix A (via LU decomposition)
-//! If skipZeros is true, skips diagonal entries in the diagonal of the LU decomposition that are below a tolerance
+//! Compute the determinant of an arbitrary matrix A (via LU decomposition, including the sign of the pivoting permutation)
 complex det(const matrix& A);
 
 //! Compute the determinant of an diagonal matrix A
@@ -219,6 +222,11 @@ matrix pow(const matrix& A, double exponent, matrix* Aevecs=0, diagMatrix* Aeigs
 //! If isSingular is provided, function will set it to true and return rather than stack-tracing in singular cases.
 matrix invsqrt(const matrix& A, matrix* Aevecs=0, diagMatrix* Aeigs=0, bool* isSingular=0);
 
+//! Compute U = R^-1, where R is the upper-triangular Cholesky factor of hermitian positive-definite A = R^R, so that U^ A U = 1.
+//! This orthonormalizes with O(N^3/3) work and no eigenvalue problem (unlike invsqrt), at the expense of not being symmetric.
+//! If isSingular is provided, function will set it to true and return an empty matrix rather than stack-tracing if A is not positive-definite.
+matrix invCholesky(const matrix& A, bool* isSingular=0);
+
 //! Compute cis(A) = exp(iota A) and optionally the eigensystem of A (if non-null)
 matrix cis(const matrix& A, matrix* Aevecs=0, diagMatrix* Aeigs=0);
 
@@ -226,6 +234,11 @@ matrix cis(const matrix& A, matrix* Aevecs=0, diagMatrix* Aeigs=0);
 //! Optionally retrieve the eigensystem of the result (note the real eigenvalues are of the input, not the result)
 matrix cisInv(const matrix& A, matrix* Bevecs=0, diagMatrix* Beigs=0);
 
+//! Diagonalize the hermitian matrices M[i] for qStart <= i < qStop together, setting evecs[i] and eigs[i].
+//! Equal-sized small matrices are solved in one batched call on the GPU (cuSolver syevjBatched, when available),
+//! and the problems are distributed over threads on the CPU, avoiding many small serialized solves (eg. over k-points).
+void diagonalizeBatch(const std::vector<matrix>& M, std::vector<matrix>& evecs, std::vector<diagMatrix>& eigs, int qStart, int qStop);
+
 //! Return gradient w.r.t A given gradient w.r.t sqrt(A) and A's eigensystem
 matrix sqrt_grad(const matrix& grad_sqrtA, const matrix& Aevecs, const diagMatrix& Aeigs);
 
@@ -19,10 +19,14 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/matrix.h>
 #include <core/GpuUtil.h>
+#include <core/MPIUtil.h>
+#include <core/Thread.h>
+#include <map>
 
 #if defined(GPU_ENABLED) and defined(CUSOLVER_ENABLED)
 	#define USE_CUSOLVER
 	#define NcutCuSolver 32  //minimum matrix dimension for which to use CuSolver (CPU LAPACK faster for small matrices)
+	#define NmaxCuSolverBatched 32  //maximum matrix dimension supported by the batched Jacobi eigensolver
 	#include <cusolverDn.h>
 #endif
 
@@ -44,6 +48,8 @@ extern "C"
 	void zgetrf_(int* M, int* N, complex* A, int* LDA, int* IPIV, int* INFO);
 	void zgetri_(int* N, complex* A, int* LDA, int* IPIV, complex* WORK, int* LWORK, int* INFO);
 	void zposv_(char* UPLO, int* N, int* NRHS, complex* A, int* LDA, complex* B, int* LDB, int* INFO);
+	void zpotrf_(char* UPLO, int* N, complex* A, int* LDA, int* INFO);
+	void ztrtri_(char* UPLO, char* DIAG, int* N, complex* A, int* LDA, int* INFO);
 }
 
 //------------------------- Eigensystem -----------------------------------
@@ -118,6 +124,177 @@ void matrix::diagonalize(matrix& evecs, diagMatrix& eigs) const
 	watch.stop();
 }
 
+void diagonalizeBatch_sub(size_t iStart, size_t iStop, const matrix* M, matrix* evecs, diagMatrix* eigs, const int* iArr)
+{	for(size_t i=iStart; i<iStop; i++)
+		M[iArr[i]].diagonalize(evecs[iArr[i]], eigs[iArr[i]]);
+}
+
+void diagonalizeBatch(const std::vector<matrix>& M, std::vector<matrix>& evecs, std::vector<diagMatrix>& eigs, int qStart, int qStop)
+{	static StopWatch watch("diagonalizeBatch"); watch.start();
+	std::vector<int> iRemaining; //problems not handled by a batched GPU call
+#ifdef USE_CUSOLVER
+	//Group small problems by dimension:
+	std::map<int, std::vector<int> > iByN;
+	for(int q=qStart; q<qStop; q++)
+	{	int N = M[q].nRows();
+		if(N <= NmaxCuSolverBatched) iByN[N].push_back(q);
+		else iRemaining.push_back(q);
+	}
+	for(const auto& entry: iByN)
+	{	int N = entry.first;
+		const std::vector<int>& iArr = entry.second;
+		int nBatch = iArr.size();
+		if(nBatch == 1) { iRemaining.push_back(iArr[0]); continue; }
+		//Pack the matrices contiguously:
+		ManagedArray<complex> A; A.init(N*N*nBatch, true);
+		ManagedArray<double> W; W.init(N*nBatch, true);
+		for(int b=0; b<nBatch; b++)
+		{	const matrix& Mb = M[iArr[b]];
+			assert(Mb.nCols()==N);
+			const double hermErr = relativeHermiticityError_gpu(N, Mb.dataGpu());
+			if(hermErr > 1e-10)
+			{	logPrintf("Relative hermiticity error of %le (>1e-10) encountered in diagonalizeBatch\n", hermErr);
+				stackTraceExit(1);
+			}
+			cudaMemcpyAsync(A.dataGpu()+N*N*b, Mb.dataGpu(), N*N*sizeof(complex), cudaMemcpyDeviceToDevice, gpuStream);
+		}
+		//Batched Jacobi eigensolver:
+		cusolverEigMode_t jobz = CUSOLVER_EIG_MODE_VECTOR;
+		cublasFillMode_t uplo = CUBLAS_FILL_MODE_UPPER;
+		syevjInfo_t params; cusolverDnCreateSyevjInfo(&params);
+		int lwork = 0;
+		cusolverDnZheevjBatched_bufferSize(cusolverHandle, jobz, uplo, N, (const double2*)A.dataGpu(), N, W.dataGpu(), &lwork, params, nBatch);
+		ManagedArray<double2> work; work.init(lwork, true);
+		ManagedArray<int> infoArr; infoArr.init(nBatch, true);
+		cusolverDnZheevjBatched(cusolverHandle, jobz, uplo, N, (double2*)A.dataGpu(), N, W.dataGpu(), work.dataGpu(), lwork, infoArr.dataGpu(), params, nBatch);
+		cusolverDnDestroySyevjInfo(params);
+		gpuErrorCheck();
+		//Unpack results (falling back to the individual solver for any that did not converge):
+		const int* info = infoArr.data();
+		const double* Wdata = W.data();
+		for(int b=0; b<nBatch; b++)
+		{	int q = iArr[b];
+			if(info[b]<0) { logPrintf("Argument# %d to cusolverDn eigenvalue routine ZheevjBatched is invalid.\n", -info[b]); stackTraceExit(1); }
+			if(info[b]>0) { iRemaining.push_back(q); continue; }
+			evecs[q].init(N, N, true);
+			cudaMemcpyAsync(evecs[q].dataGpu(), A.dataGpu()+N*N*b, N*N*sizeof(complex), cudaMemcpyDeviceToDevice, gpuStream);
+			eigs[q].resize(N);
+			eblas_copy(eigs[q].data(), Wdata+N*b, N);
+		}
+	}
+#else
+	for(int q=qStart; q<qStop; q++)
+		iRemaining.push_back(q);
+#endif
+	//Remaining problems individually (threaded over problems on the CPU):
+	if(iRemaining.size())
+		threadLaunchChunked(isGpuEnabled() ? 1 : 0, 2, diagonalizeBatch_sub, iRemaining.size(),
+			M.data(), evecs.data(), eigs.data(), (const int*)iRemaining.data()); //chunks balance differing sizes
+	watch.stop();
+}
+
+#ifdef SCALAPACK_ENABLED
+#define NcutScaLAPACK 256 //minimum matrix dimension for which to use ScaLAPACK (communication dominates for smaller matrices)
+extern "C"
+{	int Csys2blacs_handle(MPI_Comm comm);
+	void Cfree_blacs_system_handle(int handle);
+	void Cblacs_gridinit(int* context, const char* order, int nprow, int npcol);
+	void Cblacs_gridinfo(int context, int* nprow, int* npcol, int* myprow, int* mypcol);
+	void Cblacs_gridexit(int context);
+	void descinit_(int* desc, const int* m, const int* n, const int* mb, const int* nb,
+		const int* irsrc, const int* icsrc, const int* ictxt, const int* lld, int* info);
+	int numroc_(const int* n, const int* nb, const int* iproc, const int* srcproc, const int* nprocs);
+	void pzheevd_(const char* jobz, const char* uplo, const int* n, complex* a, const int* ia, const int* ja, const int* desca,
+		double* w, complex* z, const int* iz, const int* jz, const int* descz,
+		complex* work, const int* lwork, double* rwork, const int* lrwork, int* iwork, const int* liwork, int* info);
+}
+
+//Diagonalize A (available on all processes of mpiUtil) using pzheevd, and return results on all processes
+static void diagonalizeScaLAPACK(const matrix& A, matrix& evecs, diagMatrix& eigs, const MPIUtil* mpiUtil)
+{	static StopWatch watch("matrix::diagonalize(ScaLAPACK)");
+	watch.start();
+	int N = A.nRows();
+	//Squarest possible process grid on this communicator:
+	int nProcesses = mpiUtil->nProcesses();
+	int nProcsRow = int(round(sqrt(nProcesses)));
+	while(nProcesses % nProcsRow) nProcsRow--;
+	int nProcsCol = nProcesses / nProcsRow;
+	int blacsHandle = Csys2blacs_handle(mpiUtil->communicator());
+	int blacsContext = blacsHandle, iProcRow, iProcCol;
+	Cblacs_gridinit(&blacsContext, "Row-major", nProcsRow, nProcsCol);
+	Cblacs_gridinfo(blacsContext, &nProcsRow, &nProcsCol, &iProcRow, &iProcCol);
+	//Block-cyclic distribution:
+	int blockSize = std::min(64, std::max(1, N/std::max(nProcsRow,nProcsCol)));
+	int zero=0, one=1, info=0;
+	int nRowsMine = numroc_(&N, &blockSize, &iProcRow, &zero, &nProcsRow);
+	int nColsMine = numroc_(&N, &blockSize, &iProcCol, &zero, &nProcsCol);
+	int lld = std::max(1, nRowsMine);
+	int desc[9];
+	descinit_(desc, &N, &N, &blockSize, &blockSize, &zero, &zero, &blacsContext, &lld, &info); assert(info==0);
+	//Local to global index maps:
+	auto globalIndex = [&](int iLocal, int iProc, int nProcs) { return (iLocal/blockSize)*blockSize*nProcs + iProc*blockSize + iLocal%blockSize; };
+	std::vector<int> iRows(nRowsMine), iCols(nColsMine);
+	for(int i=0; i<nRowsMine; i++) iRows[i] = globalIndex(i, iProcRow, nProcsRow);
+	for(int j=0; j<nColsMine; j++) iCols[j] = globalIndex(j, iProcCol, nProcsCol);
+	//Extract local part of A:
+	const complex* Adata = A.data();
+	std::vector<complex> Alocal(size_t(lld)*std::max(1,nColsMine)), Zlocal(Alocal.size());
+	for(int j=0; j<nColsMine; j++)
+		for(int i=0; i<nRowsMine; i++)
+			Alocal[size_t(j)*lld+i] = Adata[A.index(iRows[i], iCols[j])];
+	//Workspace query and solve:
+	eigs.resize(N);
+	int lwork=-1, lrwork=-1, liwork=-1;
+	std::vector<complex> work(1); std::vector<double> rwork(1); std::vector<int> iwork(1);
+	for(int pass=0; pass<2; pass++)
+	{	pzheevd_("V", "U", &N, Alocal.data(), &one, &one, desc, eigs.data(), Zlocal.data(), &one, &one, desc,
+			work.data(), &lwork, rwork.data(), &lrwork, iwork.data(), &liwork, &info);
+		if(info<0) { logPrintf("Argument# %d to ScaLAPACK eigenvalue routine PZHEEVD is invalid.\n", -info); stackTraceExit(1); }
+		if(info>0) { logPrintf("Error code %d in ScaLAPACK eigenvalue routine PZHEEVD.\n", info); stackTraceExit(1); }
+		if(pass) break;
+		lwork = int(work[0].real()); work.resize(lwork);
+		lrwork = 2*int(rwork[0]); rwork.resize(lrwork); //extra space (workspace query known to underestimate)
+		liwork = iwork[0]; iwork.resize(liwork);
+	}
+	Cblacs_gridexit(blacsContext);
+	Cfree_blacs_system_handle(blacsHandle);
+	//Collect eigenvectors on all processes (eigenvalues are already replicated):
+	evecs = zeroes(N, N);
+	complex* evecsData = evecs.data();
+	for(int j=0; j<nColsMine; j++)
+		for(int i=0; i<nRowsMine; i++)
+			evecsData[evecs.index(iRows[i], iCols[j])] = Zlocal[size_t(j)*lld+i];
+	mpiUtil->allReduceData(evecs, MPIUtil::ReduceSum);
+	watch.stop();
+}
+#endif
+
+void matrix::diagonalize(matrix& evecs, diagMatrix& eigs, const MPIUtil* mpiUtil, int root) const
+{	if(!mpiUtil || mpiUtil->nProcesses()==1)
+	{	diagonalize(evecs, eigs);
+		return;
+	}
+	bool isRoot = (mpiUtil->iProcess() == root);
+	int N = isRoot ? nRows() : 0;
+	mpiUtil->bcast(N, root);
+	#ifdef SCALAPACK_ENABLED
+	if(N >= NcutScaLAPACK)
+	{	matrix A = isRoot ? *this : matrix(N, N);
+		mpiUtil->bcastData(A, root);
+		diagonalizeScaLAPACK(A, evecs, eigs, mpiUtil);
+		return;
+	}
+	#endif
+	//Serial diagonalization on root, with results broadcast:
+	if(isRoot) diagonalize(evecs, eigs);
+	else
+	{	evecs.init(N, N);
+		eigs.resize(N);
+	}
+	mpiUtil->bcastData(evecs, root);
+	mpiUtil->bcastData(eigs, root);
+}
+
 void matrix::diagonalize(matrix& levecs, std::vector<complex>& eigs, matrix& revecs) const
 {	static StopWatch watch("matrix::diagonalizeNH");
 	watch.start();
@@ -247,6 +424,37 @@ matrix pow(const matrix& A, double exponent, matrix* Aevecs, diagMatrix* Aeigs,
 	)
 }
 
+// Compute inverse of the upper-triangular Cholesky factor of A (A = R^R, return R^-1)
+matrix invCholesky(const matrix& A, bool* isSingular)
+{	static StopWatch watch("invCholesky(matrix)");
+	watch.start();
+	assert(A.nCols()==A.nRows());
+	int N = A.nRows();
+	assert(N > 0);
+	if(isSingular) *isSingular = false;
+	//Factorize and invert in place using LAPACK:
+	char uplo = 'U', diag = 'N';
+	matrix R = A;
+	int info = 0;
+	zpotrf_(&uplo, &N, R.data(), &N, &info);
+	if(info<0) { logPrintf("Argument# %d to LAPACK Cholesky routine ZPOTRF is invalid.\n", -info); stackTraceExit(1); }
+	if(info>0)
+	{	if(isSingular) { *isSingular = true; watch.stop(); return matrix(); }
+		logPrintf("Matrix not positive-definite at leading minor# %d in LAPACK Cholesky routine ZPOTRF.\n", info);
+		stackTraceExit(1);
+	}
+	ztrtri_(&uplo, &diag, &N, R.data(), &N, &info);
+	if(info<0) { logPrintf("Argument# %d to LAPACK triangular inverse routine ZTRTRI is invalid.\n", -info); stackTraceExit(1); }
+	if(info>0) { logPrintf("Singular triangular factor at diagonal# %d in LAPACK triangular inverse routine ZTRTRI.\n", info); stackTraceExit(1); }
+	//Zero out the lower triangle (left over from A):
+	complex* Rdata = R.data();
+	for(int j=0; j<N; j++)
+		for(int i=j+1; i<N; i++)
+			Rdata[R.index(i,j)] = 0.;
+	watch.stop();
+	return R;
+}
+
 // Compute matrix A^-0.5 and optionally the eigensystem of A (if non-null)
 matrix invsqrt(const matrix& A, matrix* Aevecs, diagMatrix* Aeigs, bool* isSingular)
 {	return pow(A, -0.5, Aevecs, Aeigs, isSingular);
@@ -317,7 +525,8 @@ matrix cis_grad(const matrix& gradIn, const matrix& Aevecs, const diagMatrix& Ae
 //--------- LU, linear solve and inverse ----------
 
 //Return LU decomposition if calcInv = false and inverse if calcInv = true
-matrix invOrLU(const matrix& A, bool calcInv)
+//(optionally setting permSign to the sign of the pivoting row permutation)
+matrix invOrLU(const matrix& A, bool calcInv, int* permSign=0)
 {	int N = A.nRows();
 	assert(N > 0);
 	assert(N == A.nCols());
@@ -335,6 +544,11 @@ matrix invOrLU(const matrix& A, bool calcInv)
 		gpuErrorCheck();
 		int info = infoArr.data()[0];
 		if(info<0) { logPrintf("Argument# %d to CuSolver LU decomposition routine Zgetrf is invalid.\n", -info); stackTraceExit(1); }
+		if(permSign)
+		{	*permSign = 1;
+			const int* iPivotData = iPivot.data();
+			for(int i=0; i<N; i++) if(iPivotData[i] != i+1) *permSign = -*permSign;
+		}
 		if(!calcInv) return LU; //rest only needed to calc inv() from LU
 		if(info>0) { logPrintf("CuSolver LU decomposition routine Zgetrf found input matrix to be singular at the %d'th step.\n", info); stackTraceExit(1); }
 		//Calculate inverse:
@@ -351,6 +565,10 @@ matrix invOrLU(const matrix& A, bool calcInv)
 	//LU decomposition (in place):
 	zgetrf_(&N, &N, LU.data(), &N, iPivot.data(), &info);
 	if(info<0) { logPrintf("Argument# %d to LAPACK LU decomposition routine ZGETRF is invalid.\n", -info); stackTraceExit(1); }
+	if(permSign)
+	{	*permSign = 1;
+		for(int i=0; i<N; i++) if(iPivot[i] != i+1) *permSign = -*permSign;
+	}
 	if(!calcInv) return LU; //rest only needed to calc inv() from LU
 	if(info>0) { logPrintf("LAPACK LU decomposition routine ZGETRF found input matrix to be singular at the %d'th step.\n", info); stackTraceExit(1); }
 	//Compute inverse in place:
@@ -362,10 +580,10 @@ matrix invOrLU(const matrix& A, bool calcInv)
 	return LU;
 }
 
-matrix LU(const matrix& A)
+matrix LU(const matrix& A, int* permSign)
 {	static StopWatch watch("LU(matrix)");
 	watch.start();
-	matrix result = invOrLU(A, false);
+	matrix result = invOrLU(A, false, permSign);
 	watch.stop();
 	return result;
 }
@@ -220,11 +220,12 @@ void randomize(matrix& x)
 
 complex det(const matrix& A)
 {
-	matrix decomposition = LU(A);
+	int permSign = 1;
+	matrix decomposition = LU(A, &permSign);
 	int N = A.nRows();
 	
-	// Multiplies the diagonal entries to get the determinant up to a sign
-	complex determinant(1., 0.);
+	// Multiplies the diagonal entries, with the sign of the row permutation
+	complex determinant(permSign, 0.);
 	for(int i=0; i<N; i++)
 		determinant *= decomposition(i,i);
 
@@ -29,7 +29,7 @@ void matrixSubGet_kernel(int nr, int iStart, int iStep, int iDelta, int jStart,
 }
 void matrixSubGet_gpu(int nr, int iStart, int iStep, int iDelta, int jStart, int jStep, int jDelta, const complex* in, complex* out)
 {	GpuLaunchConfig3D glc(matrixSubGet_kernel, vector3<int>(1,jDelta,iDelta));
-	matrixSubGet_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nr, iStart,iStep,iDelta, jStart,jStep,jDelta, in, out);
+	matrixSubGet_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, iStart,iStep,iDelta, jStart,jStep,jDelta, in, out);
 	gpuErrorCheck();
 }
 
@@ -42,7 +42,7 @@ void matrixSubGet_gpu(int nr, int iStart, int iStep, int iDelta, int jStart, int
 	} \
 	void matrixSub ##NAME## _gpu(int nr, int iStart, int iStep, int iDelta, int jStart, int jStep, int jDelta, const complex* in, complex* out) \
 	{	GpuLaunchConfig3D glc(matrixSub ##NAME## _kernel, vector3<int>(1,jDelta,iDelta)); \
-		matrixSub ##NAME## _kernel<<<glc.nBlocks,glc.nPerBlock>>>(nr, iStart,iStep,iDelta, jStart,jStep,jDelta, in, out); \
+		matrixSub ##NAME## _kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, iStart,iStep,iDelta, jStart,jStep,jDelta, in, out); \
 		gpuErrorCheck(); \
 	}
 DECLARE_matrixSubSetAccum(Set, =)
@@ -65,12 +65,12 @@ template<typename scalar> __global__ void mulDM_kernel(int nRows, int nCols, con
 }
 template<typename scalar> void mulMD_gpu(int nRows, int nCols, const complex* M, const scalar* D, complex* out)
 {	GpuLaunchConfig3D glc(mulMD_kernel<scalar>, vector3<int>(1,nCols,nRows));
-	mulMD_kernel<scalar><<<glc.nBlocks,glc.nPerBlock>>>(nRows, nCols, M, D, out);
+	mulMD_kernel<scalar><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nRows, nCols, M, D, out);
 	gpuErrorCheck();
 }
 template<typename scalar> void mulDM_gpu(int nRows, int nCols, const scalar* D, const complex* M, complex* out)
 {	GpuLaunchConfig3D glc(mulDM_kernel<scalar>, vector3<int>(1,nCols,nRows));
-	mulDM_kernel<scalar><<<glc.nBlocks,glc.nPerBlock>>>(nRows, nCols, D, M, out);
+	mulDM_kernel<scalar><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nRows, nCols, D, M, out);
 	gpuErrorCheck();
 }
 void mulMDdouble_gpu(int nRows, int nCols, const complex* M, const double* D, complex* out) { mulMD_gpu<double>(nRows, nCols, M, D, out); }
@@ -97,7 +97,7 @@ void relativeHermiticityError_kernel(int N, const complex* data, double* buf)
 double relativeHermiticityError_gpu(int N, const complex* data)
 {	GpuLaunchConfig1D glc(relativeHermiticityError_kernel, N);
 	double* buf; cudaMalloc(&buf, sizeof(double)*(2*N)); //buffer to store results per row
-	relativeHermiticityError_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, data, buf);
+	relativeHermiticityError_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, data, buf);
 	gpuErrorCheck();
 	double errNum = 0., errDen = 0.;
 	cublasDasum(cublasHandle, N, buf, 1, &errNum);
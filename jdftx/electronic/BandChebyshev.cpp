@@ -0,0 +1,155 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/BandChebyshev.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+
+std::vector<double> BandChebyshev::Hmax;
+std::vector<size_t> BandChebyshev::HmaxNbasis;
+
+BandChebyshev::BandChebyshev(Everything& e, int q): e(e), eVars(e.eVars), eInfo(e.eInfo), q(q)
+{	assert(e.cntrl.fixed_H); // Check whether the electron Hamiltonian is fixed
+	for(const auto& sp: e.iInfo.species)
+		if(sp->isUltrasoft())
+			die_alone("Chebyshev eigenvalue algorithm requires norm-conserving pseudopotentials\n"
+				"(filtering the generalized eigenproblem would need the inverse overlap).\n"
+				"Use elec-eigen-algo Davidson or PPCG instead.\n\n");
+	Hmax.resize(eInfo.nStates, 0.);
+	HmaxNbasis.resize(eInfo.nStates, 0);
+}
+
+ColumnBundle BandChebyshev::applyH(ColumnBundle& Y)
+{	std::vector<matrix> VdagY;
+	e.iInfo.project(Y, VdagY);
+	#define SWAP_C_Y \
+		std::swap(eVars.C[q], Y); \
+		std::swap(eVars.VdagC[q], VdagY);
+	SWAP_C_Y //Temporarily swap C and Y
+	ColumnBundle HY;
+	Energies ener; //not really used here
+	eVars.applyHamiltonian(q, eye(eVars.C[q].nCols()), HY, ener, true, false); //Hamiltonian always operates on C, where we put Y
+	SWAP_C_Y //Restore C and Y to correct places
+	#undef SWAP_C_Y
+	return HY;
+}
+
+double BandChebyshev::estimateHmax()
+{	ColumnBundle v = eVars.C[q].similar(1);
+	randomize(v);
+	v *= 1./nrm2(v);
+	ColumnBundle f = applyH(v);
+	double alpha = trace(v^f).real();
+	f -= alpha*v;
+	matrix T = zeroes(nLanczos, nLanczos);
+	T.set(0,0, alpha);
+	for(int j=1; j<nLanczos; j++)
+	{	double beta = nrm2(f);
+		ColumnBundle vPrev = v;
+		v = f * (1./beta);
+		f = applyH(v);
+		f -= beta*vPrev;
+		alpha = trace(v^f).real();
+		f -= alpha*v;
+		T.set(j,j, alpha);
+		T.set(j-1,j, beta);
+		T.set(j,j-1, beta);
+	}
+	matrix Tevecs; diagMatrix Teigs;
+	T.diagonalize(Tevecs, Teigs);
+	return Teigs.back() + nrm2(f);
+}
+
+void BandChebyshev::minimize()
+{	//Use the same working set as the CG minimizer:
+	ColumnBundle& C = eVars.C[q];
+	std::vector<matrix>& VdagC = eVars.VdagC[q];
+	matrix& Hsub = eVars.Hsub[q];
+	matrix& Hsub_evecs = eVars.Hsub_evecs[q];
+	diagMatrix& Hsub_eigs = eVars.Hsub_eigs[q];
+	const QuantumNumber& qnum = eInfo.qnums[q];
+	int nBands = eInfo.nBands;
+	
+	//Initial subspace eigenvalue problem:
+	ColumnBundle HC;
+	diagMatrix I = eye(nBands);
+	Energies ener; //not really used here
+	eVars.applyHamiltonian(q, I, HC, ener, true);
+	//--- switch C to subspace eigenbasis:
+	C = C * Hsub_evecs;
+	HC = HC * Hsub_evecs;
+	double Eband = qnum.weight * trace(Hsub_eigs);
+	logPrintf("BandChebyshev: Iter: %3d  Eband: %+.15lf\n", 0, Eband); fflush(globalLog);
+	
+	//Upper bound of spectrum (reused while the basis is unchanged, since it is dominated by kinetic energy):
+	if(HmaxNbasis[q] != C.basis->nbasis)
+	{	Hmax[q] = estimateHmax();
+		HmaxNbasis[q] = C.basis->nbasis;
+	}
+	
+	const MinimizeParams& mp = e.elecMinParams;
+	int iter=1;
+	for(; iter<=mp.nIterations; iter++)
+	{	//Filter bounds: damp (Hsub_eigs.back(), Hmax], and normalize the filter at the lowest Ritz value:
+		double a0 = Hsub_eigs.front(), a = Hsub_eigs.back();
+		if(Hmax[q] <= a) Hmax[q] = std::max(estimateHmax(), a + (a - a0)); //potential changed substantially
+		double halfWidth = 0.5*(Hmax[q] - a), center = 0.5*(Hmax[q] + a);
+		double sigma = halfWidth / (a0 - center), tau = 2./sigma;
+		//Apply scaled Chebyshev filter using the three-term recurrence:
+		ColumnBundle X = C, Y = HC; //first step reuses H*C from the previous Rayleigh-Ritz
+		HC.free();
+		Y -= center*X;
+		Y *= sigma/halfWidth;
+		for(int m=2; m<=filterDegree; m++)
+		{	double sigmaNew = 1./(tau - sigma);
+			ColumnBundle Ynew = applyH(Y);
+			Ynew -= center*Y;
+			Ynew *= 2.*sigmaNew/halfWidth;
+			Ynew -= (sigma*sigmaNew)*X;
+			std::swap(X, Y);
+			std::swap(Y, Ynew);
+			sigma = sigmaNew;
+		}
+		X.free();
+		//Orthonormalize (Cholesky) and Rayleigh-Ritz:
+		C = Y * invCholesky(dagger_symmetrize(Y ^ O(Y)));
+		Y.free();
+		e.iInfo.project(C, VdagC);
+		eVars.applyHamiltonian(q, I, HC, ener, true);
+		C = C * Hsub_evecs;
+		HC = HC * Hsub_evecs;
+		//Print and test convergence
+		double EbandPrev = Eband;
+		Eband = qnum.weight * trace(Hsub_eigs);
+		double dEband = Eband - EbandPrev;
+		logPrintf("BandChebyshev: Iter: %3d  Eband: %+.15lf  dEband: %le  t[s]: %9.2lf\n", iter, Eband, dEband, clock_sec()); fflush(globalLog);
+		if(dEband<0 and fabs(dEband)<mp.energyDiffThreshold)
+		{	logPrintf("BandChebyshev: Converged (dEband<%le)\n", mp.energyDiffThreshold);
+			break;
+		}
+	}
+	if(iter>mp.nIterations)
+		logPrintf("BandChebyshev: None of the convergence criteria satisfied after %d iterations.\n", mp.nIterations);
+	fflush(globalLog);
+	
+	//Update outputs (C is already in the subspace eigenbasis):
+	e.iInfo.project(C, VdagC);
+	Hsub = Hsub_eigs;
+	Hsub_evecs = I;
+}
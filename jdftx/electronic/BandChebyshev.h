@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_BANDCHEBYSHEV_H
+#define JDFTX_ELECTRONIC_BANDCHEBYSHEV_H
+
+#include <core/Minimize.h>
+
+class Everything;
+class ColumnBundle;
+
+//! @addtogroup ElecSystem
+//! @{
+
+//! Chebyshev-filtered subspace iteration (Zhou, Saad, Tiago and Chelikowsky, J. Comput. Phys. 219, 172 (2006)).
+//! Each iteration applies a Chebyshev polynomial in H that damps the spectrum above the current highest Ritz value
+//! (almost entirely batched H*C work), followed by a single orthonormalization and Rayleigh-Ritz step.
+//! The upper bound of the spectrum is estimated by a few Lanczos steps, and reused across calls for the same state.
+class BandChebyshev
+{
+public:
+	BandChebyshev(Everything& e, int q); //!< Construct Chebyshev-filtered eigenvalue solver for quantum number q
+	void minimize(); //!< Converge eigenproblem with tolerance set by e.elecMinParams
+	
+private:
+	Everything& e;
+	class ElecVars& eVars;
+	const class ElecInfo& eInfo;
+	int q;  //!< Current quantum number
+	
+	static const int filterDegree = 8; //!< degree of Chebyshev filter per iteration
+	static const int nLanczos = 10; //!< number of Lanczos steps to estimate the upper bound of the spectrum
+	
+	//! Cached upper bound of the spectrum of each state (reused across SCF cycles), valid for the recorded basis size
+	static std::vector<double> Hmax;
+	static std::vector<size_t> HmaxNbasis;
+	
+	ColumnBundle applyH(ColumnBundle& Y); //!< Apply the Hamiltonian to arbitrary columns Y (temporarily swapped into eVars.C[q], and restored on return)
+	double estimateHmax(); //!< Upper bound of the spectrum by Lanczos (following Zhou and Li, Linear Algebra Appl. 435, 480 (2011))
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_BANDCHEBYSHEV_H
@@ -25,6 +25,30 @@ BandDavidson::BandDavidson(Everything& e, int q): e(e), eVars(e.eVars), eInfo(e.
 {	assert(e.cntrl.fixed_H); // Check whether the electron Hamiltonian is fixed
 }
 
+//Helpers for working with the leading nCols columns of a ColumnBundle with storage for more columns:
+static ColumnBundle leadingTimes(const ColumnBundle& Y, int nCols, const matrix& M) //!< Y(:,0:nCols) * M
+{	assert(M.nRows()==nCols);
+	ColumnBundle YM = Y.similar(M.nCols());
+	callPref(eblas_zgemm)(CblasNoTrans, CblasNoTrans, Y.colLength(), M.nCols(), nCols,
+		1., Y.dataPref(), Y.colLength(), M.dataPref(), M.nRows(), 0., YM.dataPref(), YM.colLength());
+	return YM;
+}
+static matrix leadingDagTimes(const ColumnBundle& Y, int nCols, const ColumnBundle& X) //!< Y(:,0:nCols) ^ X
+{	assert(X.colLength()==Y.colLength());
+	matrix YdagX(nCols, X.nCols(), isGpuEnabled());
+	callPref(eblas_zgemm)(CblasConjTrans, CblasNoTrans, nCols, X.nCols(), Y.colLength(),
+		1., Y.dataPref(), Y.colLength(), X.dataPref(), X.colLength(), 0., YdagX.dataPref(), YdagX.nRows());
+	return YdagX;
+}
+static void appendColumns(matrix& M, const matrix& Mnew) //!< append columns of Mnew to M (used for projections)
+{	if(!M) { M = Mnew; return; }
+	assert(M.nRows()==Mnew.nRows());
+	matrix Mout(M.nRows(), M.nCols()+Mnew.nCols());
+	Mout.set(0,M.nRows(), 0,M.nCols(), M);
+	Mout.set(0,M.nRows(), M.nCols(),Mout.nCols(), Mnew);
+	M = Mout;
+}
+
 void BandDavidson::minimize()
 {	//Use the same working set as the CG minimizer:
 	ColumnBundle& C = eVars.C[q];
@@ -46,61 +70,84 @@ void BandDavidson::minimize()
 	eVars.applyHamiltonian(q, I, HC, ener, true);
 	Hsub = C^HC;
 	Hsub.diagonalize(Hsub_evecs, Hsub_eigs);
-	//--- switch C to subspace eigenbasis:
-	C = C * Hsub_evecs;
-	HC = HC * Hsub_evecs;
-	e.iInfo.project(C, VdagC, &Hsub_evecs);
 	double Eband = qnum.weight * trace(Hsub_eigs);
 	logPrintf("BandDavidson: Iter: %3d  Eband: %+.15lf\n", 0, Eband); fflush(globalLog);
 	
+	//Search subspace Y (along with HY and projections VdagY), which grows by a block of expansion vectors
+	//each iteration, retaining its reduced overlap and Hamiltonian matrices, until it is restarted
+	//(collapsed to the current Ritz vectors) when the next block would exceed its capacity:
+	int nYmax = 2*nBandsMax; //capacity of search subspace
+	ColumnBundle Y = C.similar(nYmax), HY = C.similar(nYmax);
+	Y.setSub(0, C); C.free();
+	HY.setSub(0, HC); HC.free();
+	std::vector<matrix> VdagY = VdagC; VdagC.clear();
+	int nY = nBandsOut; //current dimension of search subspace
+	matrix Ored = zeroes(nYmax, nYmax), Hred = zeroes(nYmax, nYmax); //reduced overlap and Hamiltonian (leading nY x nY block used)
+	Ored.set(0,nY, 0,nY, matrix(eye(nY)));
+	Hred.set(0,nY, 0,nY, Hsub);
+	matrix rot = Hsub_evecs; //Ritz vectors in terms of search subspace
+	diagMatrix eigs = Hsub_eigs; //Ritz values
+	int nRitz = nBandsOut; //number of Ritz pairs retained
+	int nLocked = 0; //number of lowest Ritz pairs that have converged (and are no longer expanded)
+	
 	const MinimizeParams& mp = e.elecMinParams;
 	int iter=1;
 	for(; iter<=mp.nIterations; iter++)
-	{	int nBands = C.nCols();
-		//Compute subspace expansion:
-		diagMatrix KEref = (-0.5) * diagDot(C, L(C)); //Update reference KE for preconditioning:
-		ColumnBundle Cexp = HC; Cexp -= O(C) * Hsub_eigs; //Calculate residual of current eigenvector guesses
-		precond_inv_kinetic_band(Cexp, KEref); //Davidson approximate inverse (using KE as the diagonal)
-		//Drop converged eigenpairs and approximately normalize subspace expansion (for avoiding roundoff issues only):
-		diagMatrix CexpNorm = diagDot(Cexp, Cexp);
-		double CexpNormCut = std::max(mp.energyDiffThreshold/nBands, 1e-15*Cexp.colLength());
-		{	//Drop columns whose norm falls below above cutoff
-			complex* CexpData = Cexp.dataPref();
-			int bOut = 0;
-			for(int b=0; b<nBands; b++)
+	{	int nActive = nRitz - nLocked;
+		//Restart search subspace if necessary:
+		if(nY + nActive > nYmax)
+		{	Y.setSub(0, leadingTimes(Y, nY, rot));
+			HY.setSub(0, leadingTimes(HY, nY, rot));
+			for(matrix& VdagYsp: VdagY) if(VdagYsp) VdagYsp = VdagYsp * rot;
+			nY = nRitz;
+			Ored.set(0,nY, 0,nY, matrix(eye(nY)));
+			Hred.set(0,nY, 0,nY, matrix(eigs));
+			rot = eye(nY);
+		}
+		//Residuals of active Ritz pairs (computing the unlocked Ritz vectors only):
+		matrix rotActive = rot(0,nY, nLocked,nRitz);
+		diagMatrix eigsActive = eigs(nLocked,nRitz);
+		ColumnBundle Cexp; diagMatrix CexpNorm;
+		double CexpNormCut = std::max(mp.energyDiffThreshold/nRitz, 1e-15*Y.colLength());
+		{	ColumnBundle Cactive = leadingTimes(Y, nY, rotActive);
+			ColumnBundle HCactive = leadingTimes(HY, nY, rotActive);
+			ColumnBundle OCactive = O(Cactive);
+			CexpNorm = precond_residual_band(Cactive, HCactive, OCactive, eigsActive, CexpNormCut, Cexp); //Davidson approximate inverse (using KE as the diagonal)
+		}
+		//Lock lowest converged Ritz pairs:
+		int nLockedPrev = nLocked;
+		while(nLocked < nRitz && CexpNorm[nLocked-nLockedPrev] < CexpNormCut) nLocked++;
+		//Drop converged eigenpairs from the subspace expansion:
+		int nBandsNew = 0;
+		{	complex* CexpData = Cexp.dataPref();
+			for(int b=nLocked-nLockedPrev; b<nActive; b++)
 			{	if(CexpNorm[b]<CexpNormCut) continue;
-				CexpNorm[bOut] = 1/sqrt(CexpNorm[b]);
-				if(bOut<b) callPref(eblas_copy)(CexpData+Cexp.index(bOut,0), CexpData+Cexp.index(b,0), Cexp.colLength());
-				bOut++;
-			}
-			if(!bOut) //This is unlikely, but just in case (to avoid zero column matrices below)
-			{	logPrintf("BandDavidson: Converged (dEband<%le)\n", mp.energyDiffThreshold);
-				break;
+				if(nBandsNew<b) callPref(eblas_copy)(CexpData+Cexp.index(nBandsNew,0), CexpData+Cexp.index(b,0), Cexp.colLength());
+				nBandsNew++;
 			}
-			if(bOut<nBands)
-			{	Cexp = Cexp.getSub(0,bOut);
-				CexpNorm = CexpNorm(0,bOut);
+		}
+		if(!nBandsNew)
+		{	if(nLockedPrev) //Check all residuals of the current subspace before concluding convergence
+			{	nLocked = 0;
+				continue;
 			}
+			logPrintf("BandDavidson: Converged (dEband<%le)\n", mp.energyDiffThreshold);
+			break;
 		}
-		Cexp = Cexp * CexpNorm;
-		int nBandsNew = Cexp.nCols();
-		int nBandsBig = nBands + nBandsNew;
+		if(nBandsNew<nActive) Cexp = Cexp.getSub(0,nBandsNew);
 		//Expansion subspace overlaps:
-		matrix bigOsub(nBandsBig, nBandsBig);
 		std::vector<matrix> VdagCexp;
 		{	ColumnBundle OCexp = O(Cexp, &VdagCexp);
-			matrix rotExisting = eye(Cexp.nCols());
+			matrix rotExisting = eye(nBandsNew);
 			e.iInfo.project(Cexp, VdagCexp, &rotExisting);
-			matrix CdagOCexp = C ^ OCexp;
-			bigOsub.set(0,nBands, 0,nBands, eye(nBands)); //since C's are already orthonormal
-			bigOsub.set(nBands,nBandsBig, nBands,nBandsBig, Cexp ^ OCexp);
-			bigOsub.set(0,nBands, nBands,nBandsBig, CdagOCexp);
-			bigOsub.set(nBands,nBandsBig, 0,nBands, dagger(CdagOCexp));
+			matrix YdagOCexp = leadingDagTimes(Y, nY, OCexp);
+			Ored.set(0,nY, nY,nY+nBandsNew, YdagOCexp);
+			Ored.set(nY,nY+nBandsNew, 0,nY, dagger(YdagOCexp));
+			Ored.set(nY,nY+nBandsNew, nY,nY+nBandsNew, Cexp ^ OCexp);
 		}
 		//Expansion subspace Hamiltonian:
-		matrix bigHsub(nBandsBig, nBandsBig);
-		ColumnBundle HCexp;
-		{	matrix HsubExp; diagMatrix HsubExp_eigs;
+		{	ColumnBundle HCexp;
+			matrix HsubExp; diagMatrix HsubExp_eigs;
 			#define SWAP_C_Cexp \
 				std::swap(C, Cexp); \
 				std::swap(VdagC, VdagCexp); \
@@ -109,32 +156,38 @@ void BandDavidson::minimize()
 			SWAP_C_Cexp //Temporarily swap C and Cexp
 			eVars.applyHamiltonian(q, eye(nBandsNew), HCexp, ener, true); //Hamiltonian always operates on C, where we put Cexp 
 			SWAP_C_Cexp  //Restore C and Cexp to correct places
-			matrix CdagHCexp = C  ^ HCexp;
-			bigHsub.set(0,nBands, 0,nBands, Hsub_eigs);
-			bigHsub.set(nBands,nBandsBig, nBands,nBandsBig, HsubExp);
-			bigHsub.set(0,nBands, nBands,nBandsBig, CdagHCexp);
-			bigHsub.set(nBands,nBandsBig, 0,nBands, dagger(CdagHCexp));
+			matrix YdagHCexp = leadingDagTimes(Y, nY, HCexp);
+			Hred.set(0,nY, nY,nY+nBandsNew, YdagHCexp);
+			Hred.set(nY,nY+nBandsNew, 0,nY, dagger(YdagHCexp));
+			Hred.set(nY,nY+nBandsNew, nY,nY+nBandsNew, HsubExp);
+			HY.setSub(nY, HCexp);
+		}
+		//Append expansion to search subspace:
+		Y.setSub(nY, Cexp); Cexp.free();
+		for(size_t sp=0; sp<VdagY.size(); sp++) if(VdagY[sp])
+			appendColumns(VdagY[sp], VdagCexp[sp]);
+		nY += nBandsNew;
+		//Solve search subspace generalized eigenvalue problem:
+		{	//Canonical orthogonalization (dropping near-linear dependencies):
+			matrix Oevecs; diagMatrix Oeigs;
+			matrix(Ored(0,nY, 0,nY)).diagonalize(Oevecs, Oeigs);
+			int nDrop = 0;
+			while(nDrop<nY && Oeigs[nDrop] < 1e-12*Oeigs.back()) nDrop++;
+			diagMatrix OeigsInvSqrt(nY-nDrop);
+			for(int i=nDrop; i<nY; i++) OeigsInvSqrt[i-nDrop] = 1./sqrt(Oeigs[i]);
+			matrix U = Oevecs(0,nY, nDrop,nY) * OeigsInvSqrt;
+			matrix HredEvecs; diagMatrix HredEigs;
+			dagger_symmetrize(dagger(U) * Hred(0,nY, 0,nY) * U).diagonalize(HredEvecs, HredEigs);
+			nRitz = std::min(nBandsMax, nY-nDrop); //number of Ritz pairs to retain
+			rot = U * HredEvecs(0,nY-nDrop, 0,nRitz);
+			eigs = HredEigs(0,nRitz);
+			nLocked = std::min(nLocked, nRitz);
 		}
-		//Solve expanded subspace generalized eigenvalue problem:
-		matrix bigU = invsqrt(bigOsub);
-		bigHsub = dagger_symmetrize(dagger(bigU) * bigHsub * bigU); //switch to the symmetrically-orthonormalized basis
-		matrix bigHsub_evecs; diagMatrix bigHsub_eigs;
-		bigHsub.diagonalize(bigHsub_evecs, bigHsub_eigs);
-		matrix rot = bigU * bigHsub_evecs; //rotation from [C,Cexp] to the expanded subspace eigenbasis
-		int nBandsNext = std::min(nBandsMax, nBandsBig); //number of bands to retain for next iteration
-		matrix Crot = rot(0,nBands, 0,nBandsNext); //contribution of C to lowest nBandsNext eigenvectors
-		matrix CexpRot = rot(nBands,nBandsBig, 0,nBandsNext); //contribution of Cexp to lowest nBandsNext eigenvectors
-		//Update C to optimum nBands subspace from [C,Cexp]
-		C = C*Crot + Cexp*CexpRot;
-		HC = HC*Crot + HCexp*CexpRot;
-		Hsub_eigs = bigHsub_eigs(0,nBandsNext);
-		for(size_t sp=0; sp<VdagC.size(); sp++) if(VdagC[sp])
-			VdagC[sp] = VdagC[sp]*Crot + VdagCexp[sp]*CexpRot;
 		//Print and test convergence
 		double EbandPrev = Eband;
-		Eband = qnum.weight * trace(Hsub_eigs(0,nBandsOut));
+		Eband = qnum.weight * trace(eigs(0,nBandsOut));
 		double dEband = Eband - EbandPrev;
-		logPrintf("BandDavidson: Iter: %3d  Eband: %+.15lf  dEband: %le  t[s]: %9.2lf\n", iter, Eband, dEband, clock_sec()); fflush(globalLog);
+		logPrintf("BandDavidson: Iter: %3d  Eband: %+.15lf  dEband: %le  nLocked: %d  t[s]: %9.2lf\n", iter, Eband, dEband, nLocked, clock_sec()); fflush(globalLog);
 		if(dEband<0 and fabs(dEband)<mp.energyDiffThreshold)
 		{	logPrintf("BandDavidson: Converged (dEband<%le)\n", mp.energyDiffThreshold);
 			break;
@@ -145,13 +198,13 @@ void BandDavidson::minimize()
 	fflush(globalLog);
 	
 	//Update final quantities:
-	if(C.nCols() != nBandsOut)
-	{	//reduce outputs to size:
-		C = C.getSub(0, nBandsOut);
-		for(size_t sp=0; sp<VdagC.size(); sp++) if(VdagC[sp])
-			VdagC[sp] = VdagC[sp](0,VdagC[sp].nRows(), 0,nBandsOut);
-		Hsub_eigs = Hsub_eigs(0,nBandsOut);
-	}
+	matrix rotOut = rot(0,nY, 0,nBandsOut);
+	C = leadingTimes(Y, nY, rotOut);
+	Y.free(); HY.free();
+	VdagC.resize(VdagY.size());
+	for(size_t sp=0; sp<VdagY.size(); sp++) if(VdagY[sp])
+		VdagC[sp] = VdagY[sp] * rotOut;
+	Hsub_eigs = eigs(0,nBandsOut);
 	Hsub = Hsub_eigs;
 	Hsub_evecs = I;
 }
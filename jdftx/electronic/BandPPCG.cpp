@@ -0,0 +1,173 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/BandPPCG.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+
+BandPPCG::BandPPCG(Everything& e, int q): e(e), eVars(e.eVars), eInfo(e.eInfo), q(q)
+{	assert(e.cntrl.fixed_H); // Check whether the electron Hamiltonian is fixed
+}
+
+//Lowest nOut eigenvectors (in terms of the block basis) of the generalized eigenproblem (Hblk, Oblk),
+//using canonical orthogonalization to drop near-linear dependencies within the block basis:
+static matrix blockRitz(const matrix& Hblk, const matrix& Oblk, int nOut)
+{	int N = Oblk.nRows();
+	matrix Oevecs; diagMatrix Oeigs;
+	Oblk.diagonalize(Oevecs, Oeigs);
+	int nDrop = 0;
+	while(nDrop < N-nOut && Oeigs[nDrop] < 1e-12*Oeigs.back()) nDrop++;
+	diagMatrix OeigsInvSqrt(N-nDrop);
+	for(int i=nDrop; i<N; i++) OeigsInvSqrt[i-nDrop] = 1./sqrt(Oeigs[i]);
+	matrix U = Oevecs(0,N, nDrop,N) * OeigsInvSqrt;
+	matrix Hevecs; diagMatrix Heigs;
+	matrix(dagger_symmetrize(dagger(U) * Hblk * U)).diagonalize(Hevecs, Heigs);
+	return U * Hevecs(0,N-nDrop, 0,nOut);
+}
+
+void BandPPCG::minimize()
+{	//Use the same working set as the CG minimizer:
+	ColumnBundle& C = eVars.C[q];
+	std::vector<matrix>& VdagC = eVars.VdagC[q];
+	matrix& Hsub = eVars.Hsub[q];
+	matrix& Hsub_evecs = eVars.Hsub_evecs[q];
+	diagMatrix& Hsub_eigs = eVars.Hsub_eigs[q];
+	const QuantumNumber& qnum = eInfo.qnums[q];
+	int nBands = eInfo.nBands;
+	if(2*nBands >= int(C.basis->nbasis))
+		die_alone("Cannot use PPCG eigenvalue algorithm when 2 x nBands > nBasis.\n"
+			"Reduce nBands, increase nBasis (Ecut) or use elec-eigen-algo CG.\n\n");
+	
+	//Initial subspace eigenvalue problem:
+	ColumnBundle HC;
+	diagMatrix I = eye(nBands);
+	Energies ener; //not really used here
+	eVars.applyHamiltonian(q, I, HC, ener, true);
+	//--- switch C to subspace eigenbasis:
+	C = C * Hsub_evecs;
+	HC = HC * Hsub_evecs;
+	ColumnBundle OC = O(C);
+	matrix CdagHC = Hsub_eigs; //subspace Hamiltonian of current (orthonormal) C
+	double Eband = qnum.weight * trace(Hsub_eigs);
+	logPrintf("BandPPCG: Iter: %3d  Eband: %+.15lf\n", 0, Eband); fflush(globalLog);
+	
+	const MinimizeParams& mp = e.elecMinParams;
+	ColumnBundle P, HP; //previous search directions (and H applied to them)
+	int iter=1;
+	for(; iter<=mp.nIterations; iter++)
+	{	//Preconditioned residual, projected out of current subspace:
+		diagMatrix KEref = (-0.5) * diagDot(C, L(C)); //reference KE for preconditioning
+		ColumnBundle W = HC; W -= OC * CdagHC;
+		precond_inv_kinetic_band(W, KEref);
+		W -= C * (OC ^ W);
+		bool havePrev = bool(P);
+		if(havePrev)
+		{	matrix CdagOP = OC ^ P;
+			P -= C * CdagOP;
+			HP -= HC * CdagOP;
+		}
+		else
+		{	P = C.similar();
+			HP = C.similar();
+		}
+		//Apply Hamiltonian to residuals:
+		ColumnBundle HW;
+		{	std::vector<matrix> VdagW;
+			e.iInfo.project(W, VdagW);
+			#define SWAP_C_W \
+				std::swap(C, W); \
+				std::swap(VdagC, VdagW);
+			SWAP_C_W //Temporarily swap C and W
+			eVars.applyHamiltonian(q, I, HW, ener, true, false); //Hamiltonian always operates on C, where we put W
+			SWAP_C_W //Restore C and W to correct places
+		}
+		//Rayleigh-Ritz within [X,W,P] for each block X of bands:
+		int nS = havePrev ? 3 : 2; //number of components in each block basis
+		for(int bStart=0; bStart<nBands; bStart+=blockSize)
+		{	int bStop = std::min(bStart+blockSize, nBands);
+			int nb = bStop - bStart;
+			std::vector<ColumnBundle> S(nS), HS(nS), OS(nS);
+			S[0] = C.getSub(bStart, bStop); HS[0] = HC.getSub(bStart, bStop); OS[0] = OC.getSub(bStart, bStop);
+			S[1] = W.getSub(bStart, bStop); HS[1] = HW.getSub(bStart, bStop); OS[1] = O(S[1]);
+			if(havePrev) { S[2] = P.getSub(bStart, bStop); HS[2] = HP.getSub(bStart, bStop); OS[2] = O(S[2]); }
+			matrix Hblk(nS*nb, nS*nb), Oblk(nS*nb, nS*nb);
+			for(int i=0; i<nS; i++)
+				for(int j=i; j<nS; j++)
+				{	matrix Hij = S[i] ^ HS[j], Oij = S[i] ^ OS[j];
+					Hblk.set(i*nb,(i+1)*nb, j*nb,(j+1)*nb, Hij);
+					Oblk.set(i*nb,(i+1)*nb, j*nb,(j+1)*nb, Oij);
+					if(i<j)
+					{	Hblk.set(j*nb,(j+1)*nb, i*nb,(i+1)*nb, dagger(Hij));
+						Oblk.set(j*nb,(j+1)*nb, i*nb,(i+1)*nb, dagger(Oij));
+					}
+				}
+			matrix rot = blockRitz(dagger_symmetrize(Hblk), dagger_symmetrize(Oblk), nb);
+			//Update search direction and bands in this block:
+			matrix rotW = rot(nb,2*nb, 0,nb);
+			ColumnBundle Pj = S[1] * rotW, HPj = HS[1] * rotW;
+			if(havePrev)
+			{	matrix rotP = rot(2*nb,3*nb, 0,nb);
+				Pj += S[2] * rotP;
+				HPj += HS[2] * rotP;
+			}
+			matrix rotX = rot(0,nb, 0,nb);
+			ColumnBundle Cj = S[0] * rotX, HCj = HS[0] * rotX;
+			Cj += Pj; HCj += HPj;
+			C.setSub(bStart, Cj); HC.setSub(bStart, HCj);
+			P.setSub(bStart, Pj); HP.setSub(bStart, HPj);
+		}
+		W.free(); HW.free();
+		//Orthonormalize (Cholesky), and perform full Rayleigh-Ritz periodically:
+		OC = O(C);
+		matrix U = invCholesky(dagger_symmetrize(C ^ OC));
+		C = C * U;
+		HC = HC * U;
+		OC = OC * U;
+		CdagHC = dagger_symmetrize(C ^ HC);
+		if(iter % rrInterval == 0)
+		{	matrix evecs; diagMatrix eigs;
+			CdagHC.diagonalize(evecs, eigs);
+			C = C * evecs;
+			HC = HC * evecs;
+			OC = OC * evecs;
+			P = P * evecs;
+			HP = HP * evecs;
+			CdagHC = eigs;
+		}
+		//Print and test convergence
+		double EbandPrev = Eband;
+		Eband = qnum.weight * trace(CdagHC).real();
+		double dEband = Eband - EbandPrev;
+		logPrintf("BandPPCG: Iter: %3d  Eband: %+.15lf  dEband: %le  t[s]: %9.2lf\n", iter, Eband, dEband, clock_sec()); fflush(globalLog);
+		if(dEband<0 and fabs(dEband)<mp.energyDiffThreshold)
+		{	logPrintf("BandPPCG: Converged (dEband<%le)\n", mp.energyDiffThreshold);
+			break;
+		}
+	}
+	if(iter>mp.nIterations)
+		logPrintf("BandPPCG: None of the convergence criteria satisfied after %d iterations.\n", mp.nIterations);
+	fflush(globalLog);
+	
+	//Final Rayleigh-Ritz and update of outputs:
+	CdagHC.diagonalize(Hsub_evecs, Hsub_eigs);
+	C = C * Hsub_evecs;
+	e.iInfo.project(C, VdagC); //update projections (stale during block updates above)
+	Hsub = Hsub_eigs;
+	Hsub_evecs = I;
+}
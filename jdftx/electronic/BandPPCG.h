@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_BANDPPCG_H
+#define JDFTX_ELECTRONIC_BANDPPCG_H
+
+#include <core/Minimize.h>
+
+class Everything;
+
+//! @addtogroup ElecSystem
+//! @{
+
+//! Projected preconditioned conjugate-gradient (PPCG) eigensolver (Vecharynski, Yang and Pask, J. Comput. Phys. 290, 73 (2015)).
+//! Each iteration performs Rayleigh-Ritz only within small blocks of bands (on [X, W, P] for each block of X),
+//! orthonormalizes by Cholesky factorization, and diagonalizes the full nBands subspace Hamiltonian only every few iterations,
+//! so that the bulk of the work is in BLAS3 ColumnBundle products rather than in dense eigenvalue problems.
+class BandPPCG
+{
+public:
+	BandPPCG(Everything& e, int q); //!< Construct PPCG eigenvalue solver for quantum number q
+	void minimize(); //!< Converge eigenproblem with tolerance set by e.elecMinParams
+	
+private:
+	Everything& e;
+	class ElecVars& eVars;
+	const class ElecInfo& eInfo;
+	int q;  //!< Current quantum number
+	
+	static const int blockSize = 16; //!< number of bands in each block Rayleigh-Ritz problem
+	static const int rrInterval = 5; //!< number of iterations between full Rayleigh-Ritz steps
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_BANDPPCG_H
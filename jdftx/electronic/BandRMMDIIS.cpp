@@ -0,0 +1,181 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/BandRMMDIIS.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <cfloat>
+#include <deque>
+
+BandRMMDIIS::BandRMMDIIS(Everything& e, int q): e(e), eVars(e.eVars), eInfo(e.eInfo), q(q)
+{	assert(e.cntrl.fixed_H); // Check whether the electron Hamiltonian is fixed
+}
+
+ColumnBundle BandRMMDIIS::applyH(ColumnBundle& Y)
+{	std::vector<matrix> VdagY;
+	e.iInfo.project(Y, VdagY);
+	#define SWAP_C_Y \
+		std::swap(eVars.C[q], Y); \
+		std::swap(eVars.VdagC[q], VdagY);
+	SWAP_C_Y //Temporarily swap C and Y
+	ColumnBundle HY;
+	Energies ener; //not really used here
+	eVars.applyHamiltonian(q, eye(eVars.C[q].nCols()), HY, ener, true, false); //Hamiltonian always operates on C, where we put Y
+	SWAP_C_Y //Restore C and Y to correct places
+	#undef SWAP_C_Y
+	return HY;
+}
+
+//Step size for each band along direction P that minimizes the Rayleigh quotient of C + lambda P,
+//given the band-wise expectation values of H and O within span(C, P)
+static diagMatrix rayleighStep(const ColumnBundle& C, const ColumnBundle& HC, const ColumnBundle& OC,
+	const ColumnBundle& P, const ColumnBundle& HP, const ColumnBundle& OP)
+{	diagMatrix Hcc = diagDot(C,HC), Hcp = diagDot(C,HP), Hpp = diagDot(P,HP);
+	diagMatrix Occ = diagDot(C,OC), Ocp = diagDot(C,OP), Opp = diagDot(P,OP);
+	diagMatrix lambda(C.nCols(), 0.);
+	for(int b=0; b<C.nCols(); b++)
+	{	//Stationary points of (Hcc + 2 Hcp l + Hpp l^2) / (Occ + 2 Ocp l + Opp l^2) satisfy A2 l^2 + A1 l + A0 = 0:
+		double A2 = Hpp[b]*Ocp[b] - Hcp[b]*Opp[b];
+		double A1 = Hpp[b]*Occ[b] - Hcc[b]*Opp[b];
+		double A0 = Hcp[b]*Occ[b] - Hcc[b]*Ocp[b];
+		std::vector<double> roots;
+		if(fabs(A2) > 1e-12*fabs(A1))
+		{	double disc = A1*A1 - 4*A2*A0;
+			if(disc >= 0.)
+			{	roots.push_back((-A1 + sqrt(disc))/(2*A2));
+				roots.push_back((-A1 - sqrt(disc))/(2*A2));
+			}
+		}
+		else if(A1) roots.push_back(-A0/A1);
+		double Emin = Hcc[b]/Occ[b];
+		for(double l: roots)
+		{	double E = (Hcc[b] + l*(2*Hcp[b] + l*Hpp[b])) / (Occ[b] + l*(2*Ocp[b] + l*Opp[b]));
+			if(E < Emin) { Emin = E; lambda[b] = l; }
+		}
+	}
+	return lambda;
+}
+
+void BandRMMDIIS::minimize()
+{	//Use the same working set as the CG minimizer:
+	ColumnBundle& C = eVars.C[q];
+	std::vector<matrix>& VdagC = eVars.VdagC[q];
+	matrix& Hsub = eVars.Hsub[q];
+	matrix& Hsub_evecs = eVars.Hsub_evecs[q];
+	diagMatrix& Hsub_eigs = eVars.Hsub_eigs[q];
+	const QuantumNumber& qnum = eInfo.qnums[q];
+	int nBands = eInfo.nBands;
+	
+	//Initial subspace eigenvalue problem:
+	ColumnBundle HC;
+	diagMatrix I = eye(nBands);
+	Energies ener; //not really used here
+	eVars.applyHamiltonian(q, I, HC, ener, true);
+	//--- switch C to subspace eigenbasis:
+	C = C * Hsub_evecs;
+	HC = HC * Hsub_evecs;
+	ColumnBundle OC = O(C);
+	diagMatrix eigs = Hsub_eigs;
+	double Eband = qnum.weight * trace(eigs);
+	logPrintf("BandRMMDIIS: Iter: %3d  Eband: %+.15lf\n", 0, Eband); fflush(globalLog);
+	
+	//History of trial vectors (and H, O and preconditioned residuals for each), independently for each band:
+	struct Trial { ColumnBundle C, HC, OC, KR; };
+	std::deque<Trial> history;
+	{	Trial t; t.C = C; t.HC = HC; t.OC = OC;
+		precond_residual_band(C, HC, OC, eigs, DBL_MAX, t.KR); //DBL_MAX: no normalization
+		history.push_back(t);
+	}
+	HC.free(); OC.free();
+	
+	const MinimizeParams& mp = e.elecMinParams;
+	diagMatrix lambda; //step size of each band (determined on the first step)
+	int iter=1;
+	for(; iter<=mp.nIterations; iter++)
+	{	//DIIS: combination of trial vectors of each band minimizing the norm of its residual:
+		Trial avg;
+		int n = history.size();
+		if(n == 1) avg = history[0];
+		else
+		{	std::vector<std::vector<diagMatrix>> overlap(n, std::vector<diagMatrix>(n));
+			for(int i=0; i<n; i++)
+				for(int j=0; j<=i; j++)
+					overlap[i][j] = overlap[j][i] = diagDot(history[i].KR, history[j].KR);
+			std::vector<diagMatrix> alpha(n, diagMatrix(nBands));
+			for(int b=0; b<nBands; b++)
+			{	matrix M = zeroes(n+1, n+1); //Lagrange-multiplier system for coefficients that sum to 1
+				double scale = 1./overlap[n-1][n-1][b];
+				for(int i=0; i<n; i++)
+				{	for(int j=0; j<n; j++) M.set(i,j, overlap[i][j][b]*scale);
+					M.set(i,n, 1.); M.set(n,i, 1.);
+				}
+				matrix Minv = inv(M);
+				for(int i=0; i<n; i++) alpha[i][b] = Minv(i,n).real();
+			}
+			avg.C = history[0].C * alpha[0]; avg.HC = history[0].HC * alpha[0];
+			avg.OC = history[0].OC * alpha[0]; avg.KR = history[0].KR * alpha[0];
+			for(int i=1; i<n; i++)
+			{	avg.C += history[i].C * alpha[i]; avg.HC += history[i].HC * alpha[i];
+				avg.OC += history[i].OC * alpha[i]; avg.KR += history[i].KR * alpha[i];
+			}
+		}
+		//New trial vector along the preconditioned residual of the DIIS combination:
+		ColumnBundle& P = avg.KR;
+		ColumnBundle HP = applyH(P), OP = O(P);
+		if(iter == 1) lambda = rayleighStep(avg.C, avg.HC, avg.OC, P, HP, OP);
+		Trial t;
+		t.C = avg.C; t.C += P * lambda;
+		t.HC = avg.HC; t.HC += HP * lambda;
+		t.OC = avg.OC; t.OC += OP * lambda;
+		avg = Trial(); HP.free(); OP.free();
+		//Rayleigh quotients and residuals:
+		diagMatrix Hdiag = diagDot(t.C, t.HC), Odiag = diagDot(t.C, t.OC);
+		for(int b=0; b<nBands; b++) eigs[b] = Hdiag[b] / Odiag[b];
+		precond_residual_band(t.C, t.HC, t.OC, eigs, DBL_MAX, t.KR);
+		history.push_back(t);
+		if(int(history.size()) > nHistory) history.pop_front();
+		//Print and test convergence
+		double EbandPrev = Eband;
+		Eband = qnum.weight * trace(eigs);
+		double dEband = Eband - EbandPrev;
+		logPrintf("BandRMMDIIS: Iter: %3d  Eband: %+.15lf  dEband: %le  t[s]: %9.2lf\n", iter, Eband, dEband, clock_sec()); fflush(globalLog);
+		if(dEband<0 and fabs(dEband)<mp.energyDiffThreshold)
+		{	logPrintf("BandRMMDIIS: Converged (dEband<%le)\n", mp.energyDiffThreshold);
+			break;
+		}
+	}
+	if(iter>mp.nIterations)
+		logPrintf("BandRMMDIIS: None of the convergence criteria satisfied after %d iterations.\n", mp.nIterations);
+	fflush(globalLog);
+	
+	//Orthonormalize (Cholesky) and Rayleigh-Ritz, using H*C from the history (exact, since H is linear):
+	C = history.back().C;
+	HC = history.back().HC;
+	OC = history.back().OC;
+	history.clear();
+	matrix U = invCholesky(dagger_symmetrize(C ^ OC));
+	C = C * U;
+	HC = HC * U;
+	OC.free();
+	matrix(dagger_symmetrize(C ^ HC)).diagonalize(Hsub_evecs, Hsub_eigs);
+	C = C * Hsub_evecs;
+	e.iInfo.project(C, VdagC);
+	Hsub = Hsub_eigs;
+	Hsub_evecs = I;
+}
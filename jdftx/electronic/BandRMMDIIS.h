@@ -0,0 +1,54 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_BANDRMMDIIS_H
+#define JDFTX_ELECTRONIC_BANDRMMDIIS_H
+
+#include <core/Minimize.h>
+
+class Everything;
+class ColumnBundle;
+
+//! @addtogroup ElecSystem
+//! @{
+
+//! Residual minimization with direct inversion in the iterative subspace (RMM-DIIS; Kresse and Furthmuller, PRB 54, 11169 (1996)).
+//! Each band is refined independently by minimizing the norm of its (preconditioned) residual over its own history of trial vectors,
+//! without orthogonalization in the inner loop; a single orthonormalization and Rayleigh-Ritz step is performed at the end.
+//! All bands advance in lock-step, so that Hamiltonian applications are batched over bands.
+//! Suitable only for refining nearly-converged bands, as in later SCF cycles (see SCFparams::rmmDiisThreshold).
+class BandRMMDIIS
+{
+public:
+	BandRMMDIIS(Everything& e, int q); //!< Construct RMM-DIIS band refinement for quantum number q
+	void minimize(); //!< Refine bands with number of steps and tolerance set by e.elecMinParams
+	
+private:
+	Everything& e;
+	class ElecVars& eVars;
+	const class ElecInfo& eInfo;
+	int q;  //!< Current quantum number
+	
+	static const int nHistory = 5; //!< maximum number of trial vectors per band in DIIS
+	
+	ColumnBundle applyH(ColumnBundle& Y); //!< Apply the Hamiltonian to arbitrary columns Y (temporarily swapped into eVars.C[q], and restored on return)
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_BANDRMMDIIS_H
@@ -29,6 +29,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 Basis::Basis()
 {	gInfo = 0;
 	nbasis = 0;
+	hash = 0;
 }
 
 Basis::Basis(const Basis& basis)
@@ -42,6 +43,8 @@ Basis& Basis::operator=(const Basis& basis)
 	iGarr = basis.iGarr;
 	index = basis.index;
 	head = basis.head;
+	hash = basis.hash;
+	radialShells = basis.radialShells;
 	return *this;
 }
 
@@ -65,6 +68,20 @@ void Basis::setup(const GridInfo& gInfo, const IonInfo& iInfo, double Ecut, cons
 	logPrintf("nbasis = %lu for k = ", nbasis); k.print(globalLog, " %6.3f ");
 }
 
+size_t Basis::count(const GridInfo& gInfo, double Ecut, const vector3<> k)
+{	vector3<int> iGbox;
+	for(int i=0; i<3; i++)
+		iGbox[i] = 1 + int(sqrt(2*Ecut) * gInfo.R.column(i).length() / (2*M_PI)) + ceil(fabs(k[i]));
+	size_t n = 0;
+	vector3<int> iG;
+	for(iG[0]=-iGbox[0]; iG[0]<=iGbox[0]; iG[0]++)
+		for(iG[1]=-iGbox[1]; iG[1]<=iGbox[1]; iG[1]++)
+			for(iG[2]=-iGbox[2]; iG[2]<=iGbox[2]; iG[2]++)
+				if(0.5*dot(iG+k, gInfo.GGT*(iG+k)) <= Ecut)
+					n++;
+	return n;
+}
+
 void Basis::setup(const GridInfo& gInfo, const IonInfo& iInfo, const std::vector<int>& indexVec)
 {	//Compute the integer G-vectors for the specified indices:
 	std::vector< vector3<int> > iGvec(indexVec.size());
@@ -93,6 +110,7 @@ void Basis::setup(const GridInfo& gInfo, const IonInfo& iInfo,
 	this->iInfo = &iInfo;
 	
 	nbasis = iGvec.size();
+	radialShells.clear();
 	iGarr.init(nbasis);
 	index.init(nbasis);
 	memcpy(iGarr.data(), &iGvec[0], sizeof(vector3<int>)*nbasis);
@@ -103,5 +121,12 @@ void Basis::setup(const GridInfo& gInfo, const IonInfo& iInfo,
 	for(size_t n=0; n<nbasis; n++)
 		if(iGvec[n].length_squared() < 4) //selects 27 entries (basically [-1,+1]^3)
 			head.push_back(n);
+	
+	//Hash the indices (FNV-1a):
+	hash = 14695981039346656037ULL;
+	for(int i: indexVec)
+	{	hash ^= uint64_t(uint32_t(i));
+		hash *= 1099511628211ULL;
+	}
 }
 
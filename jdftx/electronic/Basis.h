@@ -22,9 +22,12 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_ELECTRONIC_BASIS_H
 
 #include <core/ManagedMemory.h>
+#include <map>
+#include <memory>
 
 class GridInfo;
 class IonInfo;
+class RadialShells;
 
 //! @addtogroup ElecSystem
 //! @{
@@ -40,6 +43,8 @@ public:
 	IndexVecArray iGarr;
 	IndexArray index;
 	std::vector<int> head; //!< short list of low G basis locations (used for phase fixing)
+	uint64_t hash; //!< hash of the G-vector indices, identifying equivalent bases (eg. of both spin channels at a k-point, see ProjectorCache)
+	mutable std::map<vector3<>, std::shared_ptr<RadialShells>> radialShells; //!< shells of |k+G| for each k at which this basis was used (see RadialShells::get)
 	
 	Basis();
 	Basis(const Basis&); //!< copy by reference
@@ -48,6 +53,9 @@ public:
 	//! Setup the indices and integer G-vectors within Ecut for kpoint k
 	void setup(const GridInfo& gInfo, const IonInfo& iInfo, double Ecut, const vector3<> k);
 
+	//! Number of basis elements that setup() would produce for kpoint k (without allocating the basis)
+	static size_t count(const GridInfo& gInfo, double Ecut, const vector3<> k);
+	
 	//! Create a custom basis with an arbitrary indexing scheme
 	void setup(const GridInfo& gInfo, const IonInfo& iInfo, const std::vector<int>& indexVec);
 	
@@ -19,12 +19,17 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <electronic/Everything.h>
 #include <electronic/ColumnBundle.h>
+#include <electronic/ColumnBundleOperators_internal.h>
 #include <core/matrix.h>
 #include <core/vector3.h>
 #include <core/Random.h>
 #include <core/BlasExtra.h>
 #include <core/ScalarFieldIO.h>
 #include <fftw3.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Called by other constructors to do the work
 void ColumnBundle::init(int nc, size_t len, const Basis *b, const QuantumNumber* q, bool onGpu)
@@ -142,6 +147,23 @@ void ColumnBundle::accumColumn(int i, int s, const complexScalarFieldTilde& full
 	//Gather-accumulate from the full vector into the i'th column
 	callPref(eblas_gather_zdaxpy)(basis->nbasis, 1., basis->index.dataPref(), full->dataPref(), dataPref()+index(i,s*basis->nbasis));
 }
+void ColumnBundle::getColumns(int colStart, int colStop, complex* full) const
+{	const GridInfo& gInfo = *(basis->gInfo);
+	assert(colStart>=0 && colStart<=colStop && colStop<=nCols());
+	int nSpinor = spinorLength();
+	callPref(eblas_zero)(gInfo.nr*nSpinor*(colStop-colStart), full);
+	//Spinor components of consecutive columns are consecutive blocks of nbasis, scattered to consecutive boxes:
+	callPref(eblas_scatter_zdaxpy_batch)(basis->nbasis, 1., basis->index.dataPref(),
+		dataPref()+index(colStart,0), basis->nbasis, full, gInfo.nr, (colStop-colStart)*nSpinor);
+}
+
+void ColumnBundle::accumColumns(int colStart, int colStop, const complex* full, double alpha)
+{	const GridInfo& gInfo = *(basis->gInfo);
+	assert(colStart>=0 && colStart<=colStop && colStop<=nCols());
+	int nSpinor = spinorLength();
+	callPref(eblas_gather_zdaxpy_batch)(basis->nbasis, alpha, basis->index.dataPref(),
+		full, gInfo.nr, dataPref()+index(colStart,0), basis->nbasis, (colStop-colStart)*nSpinor);
+}
 #undef CHECK_COLUMN_INDEX
 
 
@@ -157,22 +179,30 @@ void init(std::vector<ColumnBundle>& Y, int nbundles, int ncols, const Basis* ba
 
 
 // Randomize with a high frequency cutoff of 0.75 hartrees
-void ColumnBundle::randomize(int colStart, int colStop)
+#ifdef GPU_ENABLED
+void randomize_gpu(int nbasis, int nSpinor, int colStart, int colStop, int bandOffset, complex* Y,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, uint32_t key0, uint32_t key1);
+#endif
+void ColumnBundle::randomize(int colStart, int colStop, int bandOffset)
 {	static StopWatch watch("ColumnBundle::randomize"); watch.start();
 	assert(basis->nbasis==colLength() || 2*basis->nbasis==colLength());
-	complex* thisData = data(); //currently only on cpu
+	assert(colStart>=0 && colStart<=colStop && colStop<=nCols());
 	int nSpinor = colLength()/basis->nbasis;
-	size_t j=0; //basis index
-	for(const vector3<int>& iG: basis->iGarr)
-	{	vector3<> kplusG = iG + qnum->k;
-		double KE = 0.5*dot(kplusG, basis->gInfo->GGT*kplusG);
-		double t = KE/0.75;
-		double sigma = 1.0/((1.0+t*t*t*t*t*t) * basis->gInfo->detR);
-		for(int s=0; s<nSpinor; s++)
-			for(int i=colStart; i<colStop; i++)
-				thisData[index(i,j+s*basis->nbasis)] = Random::normalComplex(sigma);
-		j++;
+	//Key the counter-based generator by state (FNV-1a hash of k-point and spin):
+	uint64_t key = 14695981039346656037ULL;
+	for(int dir=0; dir<3; dir++)
+	{	uint64_t kBits; double kDir = qnum->k[dir];
+		memcpy(&kBits, &kDir, sizeof(double));
+		key ^= kBits; key *= 1099511628211ULL;
 	}
+	key ^= uint64_t(int64_t(qnum->spin)); key *= 1099511628211ULL;
+	#ifdef GPU_ENABLED
+	randomize_gpu(basis->nbasis, nSpinor, colStart, colStop, bandOffset, dataGpu(),
+		basis->gInfo->GGT, basis->iGarr.dataGpu(), qnum->k, basis->gInfo->detR, uint32_t(key), uint32_t(key>>32));
+	#else
+	threadedLoop(nSpinor==1 ? randomize_calc<1> : randomize_calc<2>, basis->nbasis, basis->nbasis, colStart, colStop, bandOffset, data(),
+		basis->gInfo->GGT, basis->iGarr.data(), qnum->k, basis->gInfo->detR, uint32_t(key), uint32_t(key>>32));
+	#endif
 	watch.stop();
 }
 void randomize(std::vector<ColumnBundle>& Y, const ElecInfo& eInfo)
@@ -182,8 +212,60 @@ void randomize(std::vector<ColumnBundle>& Y, const ElecInfo& eInfo)
 
 //--------- Read/write an array of ColumnBundles from/to a file --------------
 
-void ElecInfo::write(const std::vector<ColumnBundle>& Y, const char* fname) const
+//Indexed wavefunction format: Header, followed by an Entry per state, followed by state data.
+//Data for each state starts at a multiple of Header::dataAlign (at least the page size),
+//so that individual states can be memory-mapped and read independently.
+//All fields, as well as the data, are little-endian.
+namespace WfnsIndexed
 {
+	const char magic[8] = { 'J','D','F','T','x','W','F','N' };
+	const uint32_t version = 1;
+	const size_t pageSize = 4096;
+	
+	struct Header
+	{	char magic[8];
+		uint32_t version, nStates;
+		uint64_t dataAlign; //alignment of each state's data in bytes
+	};
+	
+	struct Entry
+	{	int32_t nCols, present; //present = 0 for states missing in a partial checkpoint
+		uint64_t colLength; //number of complex numbers per column (basis size times spinor length)
+		uint64_t offset; //byte offset of state data from start of file
+		uint64_t checksum; //see checksum()
+	};
+	
+	inline uint64_t roundUp(uint64_t n, uint64_t align) { return ((n + align - 1) / align) * align; }
+	
+	//64-bit FNV-1a hash over the little-endian 8-byte words of the data
+	//(data is in native byte order if native=true, and as stored in the file otherwise)
+	uint64_t checksum(const complex* data, size_t nData, bool native)
+	{	const uint64_t* words = (const uint64_t*)data;
+		bool swap = native && !isLittleEndian();
+		uint64_t hash = 0xcbf29ce484222325UL;
+		for(size_t i=0; i<2*nData; i++)
+		{	uint64_t word = swap ? __builtin_bswap64(words[i]) : words[i];
+			hash = (hash ^ word) * 0x100000001b3UL;
+		}
+		return hash;
+	}
+	
+	//Check whether fname is in the indexed format
+	bool check(const char* fname)
+	{	FILE* fp = fopen(fname, "rb");
+		if(!fp) return false;
+		char buf[8];
+		bool result = (fread(buf, 1, 8, fp)==8) && !memcmp(buf, magic, 8);
+		fclose(fp);
+		return result;
+	}
+}
+
+void ElecInfo::write(const std::vector<ColumnBundle>& Y, const char* fname, size_t indexedAlign) const
+{	if(indexedAlign)
+	{	writeIndexed(Y, fname, indexedAlign);
+		return;
+	}
 #if MPI_SAFE_WRITE
 	//Safe mode / write from head:
 	if(mpiWorld->isHead())
@@ -231,6 +313,131 @@ void ElecInfo::write(const std::vector<ColumnBundle>& Y, const char* fname) cons
 }
 
 
+std::vector<char> ElecInfo::layoutIndexed(const std::vector<ColumnBundle>& Y, size_t indexedAlign, std::vector<uint64_t>& offsets) const
+{	using namespace WfnsIndexed;
+	//Collect table of states (present only if non-null on owner):
+	std::vector<int> nCols(nStates, 0), present(nStates, 0);
+	std::vector<unsigned long> colLength(nStates, 0), check(nStates, 0);
+	for(int q=qStart; q<qStop; q++)
+		if(q<int(Y.size()) && Y[q])
+		{	nCols[q] = Y[q].nCols();
+			present[q] = 1;
+			colLength[q] = Y[q].colLength();
+			check[q] = checksum(Y[q].data(), Y[q].nData(), true);
+		}
+	mpiWorld->allReduceData(nCols, MPIUtil::ReduceSum);
+	mpiWorld->allReduceData(present, MPIUtil::ReduceSum);
+	mpiWorld->allReduceData(colLength, MPIUtil::ReduceSum);
+	mpiWorld->allReduceData(check, MPIUtil::ReduceSum);
+	//Lay out the file:
+	Header header;
+	memcpy(header.magic, magic, 8);
+	header.version = version;
+	header.nStates = nStates;
+	header.dataAlign = roundUp(std::max(indexedAlign, pageSize), pageSize);
+	std::vector<Entry> table(nStates);
+	offsets.assign(nStates, 0);
+	uint64_t offset = roundUp(sizeof(Header) + nStates*sizeof(Entry), header.dataAlign);
+	for(int q=0; q<nStates; q++)
+	{	Entry& entry = table[q];
+		entry.nCols = nCols[q];
+		entry.present = present[q];
+		entry.colLength = colLength[q];
+		entry.offset = offsets[q] = present[q] ? offset : 0;
+		entry.checksum = check[q];
+		offset += roundUp(entry.nCols * entry.colLength * sizeof(complex), header.dataAlign);
+	}
+	//Convert header to little-endian and serialize:
+	convertToLE(&header.version, sizeof(uint32_t), 2);
+	convertToLE(&header.dataAlign, sizeof(uint64_t), 1);
+	for(Entry& entry: table)
+	{	convertToLE(&entry.nCols, sizeof(int32_t), 2);
+		convertToLE(&entry.colLength, sizeof(uint64_t), 3);
+	}
+	std::vector<char> result(sizeof(Header) + nStates*sizeof(Entry));
+	memcpy(result.data(), &header, sizeof(Header));
+	memcpy(result.data()+sizeof(Header), table.data(), nStates*sizeof(Entry));
+	return result;
+}
+
+void ElecInfo::writeIndexed(const std::vector<ColumnBundle>& Y, const char* fname, size_t indexedAlign) const
+{	static StopWatch watch("ElecInfo::writeIndexed"); watch.start();
+	std::vector<uint64_t> offsets;
+	std::vector<char> header = layoutIndexed(Y, indexedAlign, offsets);
+#if MPI_SAFE_WRITE
+	//Safe mode / write from head:
+	if(mpiWorld->isHead())
+	{	FILE* fp = fopen(fname, "w");
+		if(!fp) die_alone("Error opening file '%s' for writing.\n", fname);
+		fwrite(header.data(), 1, header.size(), fp);
+		for(int q=0; q<nStates; q++) if(offsets[q])
+		{	fseek(fp, offsets[q], SEEK_SET);
+			if(!isMine(q))
+			{	size_t nData = 0;
+				mpiWorld->recv(nData, whose(q), q);
+				ManagedArray<complex> buf; buf.init(nData);
+				mpiWorld->recvData(buf, whose(q), q);
+				buf.write(fp);
+			}
+			else Y[q].write(fp);
+		}
+		fclose(fp);
+	}
+	else
+		for(int q=qStart; q<qStop; q++) if(offsets[q])
+		{	mpiWorld->send(Y[q].nData(), 0, q);
+			mpiWorld->sendData(Y[q], 0, q);
+		}
+#else
+	//Parallel write: header from head, and each state from its owner at its own offset:
+	MPIUtil::File fp; mpiWorld->fopenWrite(fp, fname);
+	if(mpiWorld->isHead())
+		mpiWorld->fwrite(header.data(), 1, header.size(), fp); //byte-wise (already little-endian)
+	for(int q=qStart; q<qStop; q++) if(offsets[q])
+	{	mpiWorld->fseek(fp, offsets[q], SEEK_SET);
+		mpiWorld->fwriteData(Y[q], fp);
+	}
+	mpiWorld->fclose(fp);
+#endif
+	watch.stop();
+}
+
+bool ElecInfo::writeIndexedLocal(const std::vector<ColumnBundle>& Y, const char* fname, const std::vector<char>& header, const std::vector<uint64_t>& offsets) const
+{	int fd = open(fname, O_WRONLY|O_CREAT, 0666);
+	if(fd < 0) return false;
+	bool success = true;
+	if(mpiWorld->isHead())
+		success = (pwrite(fd, header.data(), header.size(), 0) == ssize_t(header.size()));
+	//Write states owned by this process, converting to little-endian in chunks:
+	const size_t nChunk = size_t(1) << 16; //complex numbers per chunk
+	std::vector<complex> buf(nChunk);
+	for(int q=qStart; q<qStop && success; q++) if(offsets[q])
+	{	const complex* data = Y[q].data();
+		size_t nData = Y[q].nData();
+		for(size_t start=0; start<nData && success; start+=nChunk)
+		{	size_t n = std::min(nChunk, nData-start);
+			memcpy(buf.data(), data+start, n*sizeof(complex));
+			convertToLE(buf.data(), sizeof(double), 2*n);
+			size_t nBytes = n*sizeof(complex);
+			success = (pwrite(fd, buf.data(), nBytes, offsets[q]+start*sizeof(complex)) == ssize_t(nBytes));
+		}
+	}
+	if(fsync(fd)) success = false;
+	if(close(fd)) success = false;
+	return success;
+}
+
+//Convert wavefunctions read with different bands and/or basis in Ytmp to Y (and free Ytmp)
+static void applyReadConversion(ColumnBundle& Y, ColumnBundle& Ytmp)
+{	if(Ytmp.basis!=Y.basis)
+		switchBasis(Ytmp, Y); //map coefficients directly in G-space (no FFTs)
+	else
+	{	if(Ytmp.nCols()<Y.nCols()) Y.setSub(0, Ytmp);
+		else Y = Ytmp.getSub(0, Y.nCols());
+	}
+	Ytmp.free();
+}
+
 ElecInfo::ColumnBundleReadConversion::ColumnBundleReadConversion()
 : realSpace(false), nBandsOld(0), Ecut(0), EcutOld(0)
 {
@@ -262,6 +469,8 @@ void ElecInfo::read(std::vector<ColumnBundle>& Y, const char *fname, const Colum
 			}
 		}
 	}
+	else if(WfnsIndexed::check(fname))
+		readIndexed(Y, fname, conversion);
 	else
 	{	//Check if a conversion is actually needed:
 		std::vector<ColumnBundle> Ytmp(qStop);
@@ -309,20 +518,84 @@ void ElecInfo::read(std::vector<ColumnBundle>& Y, const char *fname, const Colum
 		for(int q=qStart; q<qStop; q++)
 		{	ColumnBundle& Ycur = Ytmp[q] ? Ytmp[q] : Y[q];
 			mpiWorld->freadData(Ycur, fp);
-			if(Ytmp[q]) //apply conversions:
-			{	if(Ytmp[q].basis!=Y[q].basis)
-				{	int nSpinor = Y[q].spinorLength();
-					for(int b=0; b<std::min(Y[q].nCols(), Ytmp[q].nCols()); b++)
-						for(int s=0; s<nSpinor; s++)
-							Y[q].setColumn(b,s, Ytmp[q].getColumn(b,s)); //convert using the full G-space as an intermediate
-				}
-				else
-				{	if(Ytmp[q].nCols()<Y[q].nCols()) Y[q].setSub(0, Ytmp[q]);
-					else Y[q] = Ytmp[q].getSub(0, Y[q].nCols());
-				}
-				Ytmp[q].free();
-			}
+			if(Ytmp[q]) applyReadConversion(Y[q], Ytmp[q]);
 		}
 		mpiWorld->fclose(fp);
 	}
 }
+
+void ElecInfo::readIndexed(std::vector<ColumnBundle>& Y, const char* fname, const ColumnBundleReadConversion* conversion) const
+{	using namespace WfnsIndexed;
+	static StopWatch watch("ElecInfo::readIndexed"); watch.start();
+	//Memory-map the file (only pages of states read below are actually loaded):
+	int fd = open(fname, O_RDONLY);
+	struct stat st;
+	if(fd<0 || fstat(fd, &st)!=0) die_alone("Error opening file '%s' for reading.\n", fname);
+	size_t fsize = st.st_size;
+	const uint8_t* fileData = (const uint8_t*)mmap(0, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(fileData==MAP_FAILED) die_alone("Error memory-mapping file '%s' for reading.\n", fname);
+	//Read header:
+	Header header;
+	if(fsize < sizeof(Header)) die_alone("File '%s' is truncated (incomplete header).\n", fname);
+	memcpy(&header, fileData, sizeof(Header));
+	convertFromLE(&header.version, sizeof(uint32_t), 2);
+	convertFromLE(&header.dataAlign, sizeof(uint64_t), 1);
+	if(header.version != version)
+		die_alone("Unsupported version %u of wavefunction file '%s' (expected %u).\n", header.version, fname, version);
+	if(int(header.nStates) != nStates)
+		die_alone("Wavefunction file '%s' contains %u states instead of the expected %d.\n"
+			"Hint: Did you specify the correct kdepOld?\n", fname, header.nStates, nStates);
+	if(fsize < sizeof(Header) + nStates*sizeof(Entry)) die_alone("File '%s' is truncated (incomplete table).\n", fname);
+	const Entry* table = (const Entry*)(fileData + sizeof(Header));
+	//Read states on this process:
+	int nMissing = 0;
+	for(int q=qStart; q<qStop; q++)
+	{	Entry entry = table[q];
+		convertFromLE(&entry.nCols, sizeof(int32_t), 2);
+		convertFromLE(&entry.colLength, sizeof(uint64_t), 3);
+		if(!entry.present)
+		{	Y[q].randomize(0, Y[q].nCols());
+			nMissing++;
+			continue;
+		}
+		//Determine basis of stored data:
+		const Basis* basis = Y[q].basis;
+		Basis basisTmp;
+		if(conversion)
+		{	double EcutOld = conversion->EcutOld ? conversion->EcutOld : conversion->Ecut;
+			if(EcutOld != conversion->Ecut)
+			{	logSuspend();
+				basisTmp.setup(*(Y[q].basis->gInfo), *(Y[q].basis->iInfo), EcutOld, Y[q].qnum->k);
+				logResume();
+				basis = &basisTmp;
+			}
+		}
+		int nSpinor = Y[q].spinorLength();
+		if(entry.colLength != size_t(basis->nbasis*nSpinor))
+			die_alone("Basis size %lu of state %d in '%s' does not match the expected %lu.\n"
+				"Hint: Did you specify the correct EcutOld?\n", entry.colLength, q, fname, size_t(basis->nbasis*nSpinor));
+		size_t nData = entry.nCols * entry.colLength;
+		if(entry.offset + nData*sizeof(complex) > fsize)
+			die_alone("File '%s' is truncated (incomplete data for state %d).\n", fname, q);
+		const complex* src = (const complex*)(fileData + entry.offset);
+		madvise((void*)src, nData*sizeof(complex), MADV_SEQUENTIAL);
+		if(checksum(src, nData, false) != entry.checksum)
+			die_alone("Checksum mismatch for state %d in '%s' (file corrupted?).\n", q, fname);
+		//Copy, converting bands / basis if needed:
+		ColumnBundle Ytmp;
+		bool needTmp = (basis != Y[q].basis) || (entry.nCols != Y[q].nCols());
+		if(needTmp) Ytmp.init(entry.nCols, nData/entry.nCols, basis, Y[q].qnum);
+		ColumnBundle& Ycur = needTmp ? Ytmp : Y[q];
+		memcpy(Ycur.data(), src, nData*sizeof(complex));
+		convertFromLE(Ycur.data(), sizeof(double), 2*nData);
+		if(needTmp)
+		{	applyReadConversion(Y[q], Ytmp);
+			if(entry.nCols < Y[q].nCols()) Y[q].randomize(entry.nCols, Y[q].nCols()); //bands not present in file
+		}
+	}
+	munmap((void*)fileData, fsize);
+	mpiWorld->allReduce(nMissing, MPIUtil::ReduceSum);
+	if(nMissing) logPrintf("WARNING: %d states missing in partial checkpoint '%s' have been randomized.\n", nMissing, fname);
+	watch.stop();
+}
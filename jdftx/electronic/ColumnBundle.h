@@ -73,8 +73,14 @@ public:
 	complexScalarFieldTilde getColumn(int i, int s) const; //!< Expand the i'th column and s'th spinor component from reduced to full G-space
 	void setColumn(int i, int s, const complexScalarFieldTilde&); //!< Redeuce a full G-space vector and store it as the i'th column and s'th spinor component
 	void accumColumn(int i, int s, const complexScalarFieldTilde&); //!< Redeuce a full G-space vector and accumulate onto the i'th column and s'th spinor component
+	//Batched versions of above for columns [colStart,colStop), with full G-space boxes (of all spinor components)
+	//stored consecutively at full with box index (i-colStart)*spinorLength()+s (CPU or GPU pointer, as dataPref()):
+	void getColumns(int colStart, int colStop, complex* full) const; //!< Expand columns to (overwritten) full G-space boxes
+	void accumColumns(int colStart, int colStop, const complex* full, double alpha=1.); //!< Reduce full G-space boxes and accumulate alpha times them onto columns
 	
-	void randomize(int colStart, int colStop); //!< randomize a selected range of columns
+	//! Randomize a selected range of columns (reproducibly, based on k-point, spin, band and G-vector alone).
+	//! Column i is randomized as band i+bandOffset, so that columns destined for different bands are independent.
+	void randomize(int colStart, int colStop, int bandOffset=0);
 };
 
 //! Initialize an array of column bundles (with appropriate wavefunction sizes if ncols, basis, qnum and eInfo are all non-zero)
@@ -136,6 +142,16 @@ ColumnBundle operator-(const ColumnBundleMatrixProduct &XM1, const ColumnBundleM
 
 ColumnBundle operator*(const scaled<ColumnBundle>&, const diagMatrix&);
 matrix operator^(const scaled<ColumnBundle>&, const scaled<ColumnBundle>&); //!< inner product
+
+//Batched versions of the above over states qStart <= q < qStop, issuing the multiplies for all states together
+//(see eblas_zgemm_batch), which keeps the CPU / GPU busy when there are many states with small bases:
+void overlapBatch(const std::vector<ColumnBundle>& Y1, const std::vector<ColumnBundle>& Y2, std::vector<matrix>& Y1dY2, int qStart, int qStop); //!< Y1dY2[q] = Y1[q] ^ Y2[q]
+void multiplyBatch(const std::vector<ColumnBundle>& Y, const std::vector<matrix>& M, std::vector<ColumnBundle>& YM, int qStart, int qStop); //!< YM[q] = Y[q] * M[q] (YM may be the same array as Y)
+//! Slater-determinant overlaps det(Y1[q](cols1[q]) ^ Y2[q](cols2[q])) for states qStart <= q < qStop, restricted to the listed
+//! (e.g. occupied) columns of each, with the inner products of all states batched as in overlapBatch. Returns an array indexed
+//! by q (zero outside the range, or where the numbers of selected columns differ and the determinants are orthogonal)
+std::vector<complex> detOverlapBatch(const std::vector<ColumnBundle>& Y1, const std::vector<ColumnBundle>& Y2,
+	const std::vector<std::vector<int>>& cols1, const std::vector<std::vector<int>>& cols2, int qStart, int qStop);
 vector3<matrix> spinOverlap(const scaled<ColumnBundle> &sY1, const scaled<ColumnBundle> &sY2); //!< spin-resolved inner product for spinorial ColumnBundle's
 
 //------------------------------ Other operators ---------------------------------
@@ -144,8 +160,16 @@ vector3<matrix> spinOverlap(const scaled<ColumnBundle> &sY1, const scaled<Column
 //! The handling of the spin structure of V parallels that of diagouterI, with V.size() taking the role of nDensities
 ColumnBundle Idag_DiagV_I(const ColumnBundle& C, const ScalarFieldArray& V);
 
+//! Accumulate Idag V .* I C + tauScale sum_i D_i Idag Vtau .* I D_i C into VC (allocated if null),
+//! with both terms applied to each batch of columns while it is resident, avoiding full-size temporaries
+void Idag_DiagV_I_accum(const ColumnBundle& C, const ScalarFieldArray& V, ColumnBundle& VC, const ScalarFieldArray* Vtau=0, double tauScale=0.);
+
+//! Number of columns of C to transform together in batched FFTs (see I_batch), limiting total scratch memory over nThreads threads
+int fftBatchCols(const ColumnBundle& C, int nThreads);
+
 ColumnBundle L(const ColumnBundle &Y); //!< Apply Laplacian
 ColumnBundle Linv(const ColumnBundle &Y); //!< Apply Laplacian inverse
+diagMatrix applyKinetic(const ColumnBundle& C, ColumnBundle* HC); //!< Accumulate (-1/2) L C into HC (if non-null) and return the kinetic energy of each column in a single pass
 ColumnBundle O(const ColumnBundle &Y, std::vector<matrix>* VdagY=0); //!< Apply overlap (and optionally retrieve pseudopotential projections for later reuse)
 ColumnBundle D(const ColumnBundle &Y, int iDir); //!< Compute the cartesian gradient of a column bundle in direction# iDir
 ColumnBundle DD(const ColumnBundle &Y, int iDir, int jDir); //!< Compute second spatial derivative of a column bundle along directions# iDir, jDir
@@ -156,11 +180,21 @@ void precond_inv_kinetic(ColumnBundle &Y, double KErollover);
 diagMatrix diagDot(const ColumnBundle& X, const ColumnBundle& Y); //!< compute diag(X^Y) efficiently (avoid the off-diagonals)
 void precond_inv_kinetic_band(ColumnBundle& Y, const diagMatrix& KEref); //!< In-place inverse kinetic preconditioner with band-by-band KE reference (Used by BandDavidson)
 
+//! Preconditioned Davidson residuals R = K (HC - OC*eigs) for Ritz vectors C with Ritz values eigs (Used by BandDavidson),
+//! where K is the preconditioner of precond_inv_kinetic_band with KE reference computed from C.
+//! Fuses the KE reference, residual, preconditioning and normalization (of columns with squared norm >= normCut) into one pass.
+//! @return Squared norms of the preconditioned residuals (before normalization)
+diagMatrix precond_residual_band(const ColumnBundle& C, const ColumnBundle& HC, const ColumnBundle& OC,
+	const diagMatrix& eigs, double normCut, ColumnBundle& R);
+
 ColumnBundle translate(ColumnBundle&&, vector3<> dr); //!< translate a column-bundle by dr in lattice coordinates (destructible input)
 ColumnBundle translate(const ColumnBundle&, vector3<> dr); //!< translate a column-bundle by dr in lattice coordinates (preserve input)
 void translateColumns(ColumnBundle&, const vector3<>* dr); //!< translate each column of a column bundle by a different dr (in-place)
 
 ColumnBundle switchBasis(const ColumnBundle&, const Basis&); //!< return wavefunction projected to a different basis
+//! Project the first min(in.nCols(), out.nCols()) bands of in to the basis of out (overwriting those bands of out), directly in G-space.
+//! The bases may differ in cutoff, grid or k (at fixed periodic-part coefficients for each G), and are matched by merging their sorted G-vector lists.
+void switchBasis(const ColumnBundle& in, ColumnBundle& out);
 
 //------------------------------ Reductions ---------------------------------
 
@@ -175,5 +209,9 @@ complex traceinner(const diagMatrix &F, const ColumnBundle &X,const ColumnBundle
 //! If gInfoOut is specified, function ensures that the output is changed to that grid (in case tighter wfns grid is in use)
 ScalarFieldArray diagouterI(const diagMatrix &F,const ColumnBundle &X, int nDensities, const GridInfo* gInfoOut=0);
 
+//! Densities diag((I*X)*F[iSet]*(I*X)^) for several sets of fillings F together (as above for each entry), transforming each column of X only once.
+//! If tau is non-null, it is set to the KE density 0.5 sum_i F[0][i] |grad I X_i|^2 (same layout as the densities), computed in the same pass over the columns
+std::vector<ScalarFieldArray> diagouterI(const std::vector<diagMatrix>& F, const ColumnBundle &X, int nDensities, const GridInfo* gInfoOut=0, ScalarFieldArray* tau=0);
+
 //! @}
 #endif // JDFTX_ELECTRONIC_COLUMNBUNDLE_H
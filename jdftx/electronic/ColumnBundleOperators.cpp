@@ -30,6 +30,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/GridInfo.h>
 #include <core/LoopMacros.h>
 #include <core/Operators.h>
+#include <algorithm>
 
 //------------------------ Arithmetic operators --------------------
 
@@ -113,6 +114,72 @@ ColumnBundle operator-(const ColumnBundleMatrixProduct &XM1, const ColumnBundleM
 	return result;
 }
 
+void overlapBatch(const std::vector<ColumnBundle>& Y1, const std::vector<ColumnBundle>& Y2, std::vector<matrix>& Y1dY2, int qStart, int qStop)
+{	static StopWatch watch("Y1^Y2(batch)");
+	watch.start();
+	Y1dY2.resize(std::max(Y1dY2.size(), size_t(qStop)));
+	std::vector<ZgemmArgs> batch;
+	for(int q=qStart; q<qStop; q++)
+	{	if(!Y1[q]) continue;
+		if(Y1[q].colLength() != Y2[q].colLength()) { Y1dY2[q] = Y1[q] ^ Y2[q]; continue; } //spinor special case
+		int colLength = Y1[q].colLength();
+		Y1dY2[q].init(Y1[q].nCols(), Y2[q].nCols(), isGpuEnabled());
+		batch.push_back({CblasConjTrans, CblasNoTrans, Y1[q].nCols(), Y2[q].nCols(), colLength,
+			1., Y1[q].dataPref(), colLength, Y2[q].dataPref(), colLength,
+			0., Y1dY2[q].dataPref(), Y1dY2[q].nRows()});
+	}
+	callPref(eblas_zgemm_batch)(batch);
+	watch.stop();
+}
+
+std::vector<complex> detOverlapBatch(const std::vector<ColumnBundle>& Y1, const std::vector<ColumnBundle>& Y2,
+	const std::vector<std::vector<int>>& cols1, const std::vector<std::vector<int>>& cols2, int qStart, int qStop)
+{	static StopWatch watch("detOverlapBatch");
+	std::vector<matrix> Y1dY2;
+	overlapBatch(Y1, Y2, Y1dY2, qStart, qStop);
+	watch.start();
+	std::vector<complex> result(std::max(Y1.size(), size_t(qStop)), 0.);
+	for(int q=qStart; q<qStop; q++)
+	{	if(!Y1[q]) continue;
+		int n = cols1[q].size();
+		if(int(cols2[q].size()) != n) continue; //orthogonal by particle number
+		if(!n) { result[q] = 1.; continue; }
+		//Extract selected rows and columns of the overlap:
+		const matrix& S = Y1dY2[q];
+		const complex* Sdata = S.data();
+		matrix Ssel(n, n);
+		complex* SselData = Ssel.data();
+		for(int j=0; j<n; j++)
+			for(int i=0; i<n; i++)
+				*(SselData++) = Sdata[S.index(cols1[q][i], cols2[q][j])];
+		result[q] = det(Ssel);
+	}
+	watch.stop();
+	return result;
+}
+
+void multiplyBatch(const std::vector<ColumnBundle>& Y, const std::vector<matrix>& M, std::vector<ColumnBundle>& YM, int qStart, int qStop)
+{	static StopWatch watch("Y*M(batch)");
+	watch.start();
+	std::vector<ColumnBundle> result(qStop); //separate outputs, so that YM may alias Y
+	std::vector<ZgemmArgs> batch;
+	for(int q=qStart; q<qStop; q++)
+	{	if(!Y[q]) continue;
+		if(2*Y[q].nCols() == M[q].nRows()) { result[q] = Y[q] * M[q]; continue; } //spinor special case
+		assert(Y[q].nCols() == M[q].nRows());
+		int colLength = Y[q].colLength();
+		result[q] = Y[q].similar(M[q].nCols());
+		batch.push_back({CblasNoTrans, CblasNoTrans, colLength, M[q].nCols(), Y[q].nCols(),
+			1., Y[q].dataPref(), colLength, M[q].dataPref(), M[q].nRows(),
+			0., result[q].dataPref(), colLength});
+	}
+	callPref(eblas_zgemm_batch)(batch);
+	YM.resize(std::max(YM.size(), size_t(qStop)));
+	for(int q=qStart; q<qStop; q++)
+		if(result[q]) std::swap(YM[q], result[q]);
+	watch.stop();
+}
+
 ColumnBundle operator*(const scaled<ColumnBundle> &sY, const diagMatrix& d)
 {	const ColumnBundle& Y = sY.data;
 	assert(Y.nCols()==d.nRows());
@@ -194,49 +261,167 @@ vector3<matrix> spinOverlap(const scaled<ColumnBundle> &sY1, const scaled<Column
 
 //------------------------------ Other operators ---------------------------------
 
-void Idag_DiagV_I_sub(int colStart, int colEnd, const ColumnBundle* C, const ScalarFieldArray* V, ColumnBundle* VC)
+//Number of columns to transform together in batched FFTs, limiting total scratch memory over nThreads threads
+int fftBatchCols(const ColumnBundle& C, int nThreads)
+{	const size_t scratchMax = size_t(1)<<28; //overall limit of 256 MB on scratch space
+	const int nBatchMax = 8; //little gain in throughput beyond this
+	size_t colBytes = sizeof(complex) * C.basis->gInfo->nr * C.spinorLength();
+	return std::max(1, std::min(nBatchMax, int(scratchMax / (colBytes*nThreads))));
+}
+
+//Multiply nr-length real-space data by a scalar field (including its scale factor)
+void multiplyField(int nr, const ScalarField& V, complex* data)
+{	callPref(eblas_zmuld)(nr, V->dataPref(), 1, data, 1);
+	if(V->scale != 1.) callPref(eblas_zdscal)(nr, V->scale, data, 1);
+}
+void multiplyField(int nr, const complexScalarField& V, complex* data)
+{	callPref(eblas_zmul)(nr, V->dataPref(), 1, data, 1);
+	if(V->scale != 1.) callPref(eblas_zdscal)(nr, V->scale, data, 1);
+}
+
+//Scatter D(C) and accumulate D onto HC directly from / to full G-space boxes (see scatterD_calc and gatherDaccum_calc)
+#ifdef GPU_ENABLED
+void scatterD_gpu(int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<> Ge, const complex* C, complex* boxes);
+void gatherDaccum_gpu(int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<> Ge, double alpha, const complex* boxes, complex* HC);
+#endif
+void scatterD(const ColumnBundle& C, int colStart, int colStop, int iDir, complex* boxes)
+{	const Basis& basis = *(C.basis);
+	const vector3<> Ge = basis.gInfo->G.column(iDir);
+	double kdotGe = dot(C.qnum->k, Ge);
+	int nr = basis.gInfo->nr, nBoxes = (colStop-colStart)*C.spinorLength();
+	callPref(eblas_zero)(nr*nBoxes, boxes);
+	#ifdef GPU_ENABLED
+	scatterD_gpu(basis.nbasis, nr, nBoxes, basis.index.dataGpu(), basis.iGarr.dataGpu(), kdotGe, Ge, C.dataGpu()+C.index(colStart,0), boxes);
+	#else
+	//Note: called within threads over columns in Idag_DiagV_I_accum, so not threaded further
+	for(size_t j=0; j<basis.nbasis; j++)
+		scatterD_calc(j, basis.nbasis, nr, nBoxes, basis.index.data(), basis.iGarr.data(), kdotGe, Ge, C.data()+C.index(colStart,0), boxes);
+	#endif
+}
+void gatherDaccum(ColumnBundle& HC, int colStart, int colStop, int iDir, double alpha, const complex* boxes)
+{	const Basis& basis = *(HC.basis);
+	const vector3<> Ge = basis.gInfo->G.column(iDir);
+	double kdotGe = dot(HC.qnum->k, Ge);
+	int nr = basis.gInfo->nr, nBoxes = (colStop-colStart)*HC.spinorLength();
+	#ifdef GPU_ENABLED
+	gatherDaccum_gpu(basis.nbasis, nr, nBoxes, basis.index.dataGpu(), basis.iGarr.dataGpu(), kdotGe, Ge, alpha, boxes, HC.dataGpu()+HC.index(colStart,0));
+	#else
+	for(size_t j=0; j<basis.nbasis; j++)
+		gatherDaccum_calc(j, basis.nbasis, nr, nBoxes, basis.index.data(), basis.iGarr.data(), kdotGe, Ge, alpha, boxes, HC.data()+HC.index(colStart,0));
+	#endif
+}
+
+void Idag_DiagV_I_sub(int colStart, int colEnd, const ColumnBundle* C, const ScalarFieldArray* V,
+	const ScalarFieldArray* Vtau, double tauScale, ColumnBundle* VC)
 {	const ScalarField& Vs = V->at(V->size()==1 ? 0 : C->qnum->index());
+	const ScalarField* VtauS = Vtau ? &Vtau->at(Vtau->size()==1 ? 0 : C->qnum->index()) : 0;
+	const GridInfo& gInfo = *(C->basis->gInfo);
 	int nSpinor = VC->spinorLength();
-	for(int col=colStart; col<colEnd; col++)
-		for(int s=0; s<nSpinor; s++)
-			VC->accumColumn(col,s, Idag(Vs * I(C->getColumn(col,s)))); //note VC is zero'd just before
+	int nBatch = fftBatchCols(*C, isGpuEnabled() ? 1 : nProcsAvailable);
+	complex* buf = gInfo.getWorkspace(nSpinor*nBatch, isGpuEnabled()); //per-thread scratch reused across batches and calls
+	for(int colBatch=colStart; colBatch<colEnd; colBatch+=nBatch)
+	{	int colStop = std::min(colBatch+nBatch, colEnd);
+		int nBoxes = (colStop-colBatch)*nSpinor;
+		//Orbital kinetic-energy-density term, tauScale sum_i D_i Idag Diag(Vtau) I D_i C, while this block is in cache:
+		if(VtauS)
+		{	for(int iDir=0; iDir<3; iDir++)
+			{	scatterD(*C, colBatch, colStop, iDir, buf);
+				I_batch(gInfo, buf, nBoxes);
+				for(int iBox=0; iBox<nBoxes; iBox++)
+					multiplyField(gInfo.nr, *VtauS, buf+gInfo.nr*iBox);
+				Idag_batch(gInfo, buf, nBoxes);
+				gatherDaccum(*VC, colBatch, colStop, iDir, tauScale, buf);
+			}
+		}
+		//Local potential term:
+		C->getColumns(colBatch, colStop, buf);
+		I_batch(gInfo, buf, nBoxes);
+		for(int iBox=0; iBox<nBoxes; iBox++)
+			multiplyField(gInfo.nr, Vs, buf+gInfo.nr*iBox);
+		Idag_batch(gInfo, buf, nBoxes);
+		VC->accumColumns(colBatch, colStop, buf);
+	}
 }
 
-//Noncollinear version of above (with the preprocessing of complex off-diagonal potentials done in calling function)
+//Noncollinear version of above (with the preprocessing of complex off-diagonal potentials done in calling function).
+//The up and down components of each column are adjacent in the batch, so the 2x2 potential is applied in a single pass:
+#ifdef GPU_ENABLED
+void spinorMultiply_gpu(int nr, const double* Vup, double VupScale, const double* Vdn, double VdnScale,
+	const complex* VupDn, double VupDnScale, complex* ICup, complex* ICdn);
+#endif
+void spinorMultiply(int nr, const ScalarField& Vup, const ScalarField& Vdn, const complexScalarField& VupDn, complex* ICup, complex* ICdn)
+{
+	#ifdef GPU_ENABLED
+	spinorMultiply_gpu(nr, Vup->dataGpu(), Vup->scale, Vdn->dataGpu(), Vdn->scale, VupDn->dataGpu(), VupDn->scale, ICup, ICdn);
+	#else
+	//Note: called within threads over columns in Idag_DiagV_I, so not threaded further
+	const double* VupData = Vup->data(); const double* VdnData = Vdn->data(); const complex* VupDnData = VupDn->data();
+	for(int i=0; i<nr; i++)
+		spinorMultiply_calc(i, VupData, Vup->scale, VdnData, Vdn->scale, VupDnData, VupDn->scale, ICup, ICdn);
+	#endif
+}
 void Idag_DiagVmat_I_sub(int colStart, int colEnd, const ColumnBundle* C, const ScalarField* Vup, const ScalarField* Vdn,
-	const complexScalarField* VupDn, const complexScalarField* VdnUp, ColumnBundle* VC)
-{	for(int col=colStart; col<colEnd; col++)
-	{	complexScalarField ICup = I(C->getColumn(col,0));
-		complexScalarField ICdn = I(C->getColumn(col,1));
-		VC->accumColumn(col,0, Idag((*Vup)*ICup + (*VupDn)*ICdn));
-		VC->accumColumn(col,1, Idag((*Vdn)*ICdn + (*VdnUp)*ICup));
+	const complexScalarField* VupDn, ColumnBundle* VC)
+{	const GridInfo& gInfo = *(C->basis->gInfo);
+	int nBatch = fftBatchCols(*C, isGpuEnabled() ? 1 : nProcsAvailable);
+	complex* buf = gInfo.getWorkspace(2*nBatch, isGpuEnabled()); //per-thread scratch reused across batches and calls
+	for(int colBatch=colStart; colBatch<colEnd; colBatch+=nBatch)
+	{	int colStop = std::min(colBatch+nBatch, colEnd);
+		int nBoxes = (colStop-colBatch)*2;
+		C->getColumns(colBatch, colStop, buf);
+		I_batch(gInfo, buf, nBoxes);
+		for(int col=colBatch; col<colStop; col++)
+		{	complex* ICup = buf + gInfo.nr*(2*(col-colBatch));
+			spinorMultiply(gInfo.nr, *Vup, *Vdn, *VupDn, ICup, ICup+gInfo.nr);
+		}
+		Idag_batch(gInfo, buf, nBoxes);
+		VC->accumColumns(colBatch, colStop, buf);
 	}
-	
+}
+
+//Potential on the wavefunction grid (converted into Vtmp if necessary)
+static const ScalarFieldArray& onWfnsGrid(const ScalarFieldArray& V, const GridInfo& gInfoWfns, ScalarFieldArray& Vtmp)
+{	if(&(V[0]->gInfo) != &gInfoWfns)
+		for(const ScalarField& Vs: V)
+			Vtmp.push_back(Jdag(changeGrid(Idag(Vs), gInfoWfns), true));
+	return Vtmp.size() ? Vtmp : V;
 }
 
 ColumnBundle Idag_DiagV_I(const ColumnBundle& C, const ScalarFieldArray& V)
+{	ColumnBundle VC = C.similar(); VC.zero();
+	Idag_DiagV_I_accum(C, V, VC);
+	return VC;
+}
+
+void Idag_DiagV_I_accum(const ColumnBundle& C, const ScalarFieldArray& V, ColumnBundle& VC, const ScalarFieldArray* Vtau, double tauScale)
 {	static StopWatch watch("Idag_DiagV_I"); watch.start();
-	ColumnBundle VC = C.similar(); VC.zero();
+	if(!VC) { VC = C.similar(); VC.zero(); }
 	//Convert V to wfns grid if necessary:
 	const GridInfo& gInfoWfns = *(C.basis->gInfo);
-	ScalarFieldArray Vtmp;
-	if(&(V[0]->gInfo) != &gInfoWfns)
-		for(const ScalarField& Vs: V)
-			Vtmp.push_back(Jdag(changeGrid(Idag(Vs), gInfoWfns), true));
-	const ScalarFieldArray& Vwfns = Vtmp.size() ? Vtmp : V;
+	ScalarFieldArray Vtmp, VtauTmp;
+	const ScalarFieldArray& Vwfns = onWfnsGrid(V, gInfoWfns, Vtmp);
+	const ScalarFieldArray* VtauWfns = Vtau ? &onWfnsGrid(*Vtau, gInfoWfns, VtauTmp) : 0;
 	assert(Vwfns.size()==1 || Vwfns.size()==2 || Vwfns.size()==4);
 	if(Vwfns.size()==2) assert(!C.isSpinor());
+	if(VtauWfns && VtauWfns->size()==4) //noncollinear kinetic-energy-density potential: separate passes
+	{	for(int iDir=0; iDir<3; iDir++)
+			VC += tauScale * D(Idag_DiagV_I(D(C,iDir), *VtauWfns), iDir);
+		VtauWfns = 0;
+	}
 	if(Vwfns.size()==1 || Vwfns.size()==2)
-	{	threadLaunch(isGpuEnabled()?1:0, Idag_DiagV_I_sub, C.nCols(), &C, &Vwfns, &VC);
+	{	threadLaunch(isGpuEnabled()?1:0, Idag_DiagV_I_sub, C.nCols(), &C, &Vwfns, VtauWfns, tauScale, &VC);
 	}
 	else //Vwfns.size()==4
 	{	assert(C.isSpinor());
-		complexScalarField VupDn = 0.5*Complex(Vwfns[2], Vwfns[3]);
-		complexScalarField VdnUp = conj(VupDn);
-		threadLaunch(isGpuEnabled()?1:0, Idag_DiagVmat_I_sub, C.nCols(), &C, &Vwfns[0], &Vwfns[1], &VupDn, &VdnUp, &VC);
+		if(VtauWfns) //collinear kinetic-energy-density potential with noncollinear local potential (not fused)
+			for(int iDir=0; iDir<3; iDir++)
+				VC += tauScale * D(Idag_DiagV_I(D(C,iDir), *VtauWfns), iDir);
+		complexScalarField VupDn = 0.5*Complex(Vwfns[2], Vwfns[3]); //VdnUp = conj(VupDn) is applied within spinorMultiply
+		threadLaunch(isGpuEnabled()?1:0, Idag_DiagVmat_I_sub, C.nCols(), &C, &Vwfns[0], &Vwfns[1], &VupDn, &VC);
 	}
 	watch.stop();
-	return VC;
 }
 
 
@@ -260,6 +445,51 @@ ColumnBundle L(const ColumnBundle &Y)
 	return LY;
 }
 
+//Kinetic operator accumulate and per-column kinetic energy (fused)
+#ifdef GPU_ENABLED
+void kineticAccum_gpu(int nbasis, int ncols, const complex* C, complex* HC,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, double* KE);
+#else
+template<bool accumHC> void kineticAccum_cols(int colStart, int colStop, const ColumnBundle* C, ColumnBundle* HC, double* KE)
+{	const Basis& basis = *(C->basis);
+	for(int col=colStart; col<colStop; col++)
+	{	double KEcol = 0.;
+		for(size_t j=0; j<basis.nbasis; j++)
+			KEcol += kineticAccum_calc<accumHC>(j, basis.nbasis, col, C->data(), accumHC ? HC->data() : 0,
+				basis.gInfo->GGT, basis.iGarr.data(), C->qnum->k, basis.gInfo->detR);
+		KE[col] = KEcol;
+	}
+}
+void kineticAccum_sub(int colStart, int colStop, const ColumnBundle* C, ColumnBundle* HC, double* KE)
+{	if(HC) kineticAccum_cols<true>(colStart, colStop, C, HC, KE);
+	else kineticAccum_cols<false>(colStart, colStop, C, HC, KE);
+}
+#endif
+diagMatrix applyKinetic(const ColumnBundle& C, ColumnBundle* HC)
+{	static StopWatch watch("applyKinetic"); watch.start();
+	assert(C.basis);
+	const Basis& basis = *(C.basis);
+	int nSpinors = C.spinorLength();
+	int nColsTot = C.nCols()*nSpinors;
+	if(HC && !*HC) { *HC = C.similar(); HC->zero(); }
+	ManagedArray<double> KE; KE.init(nColsTot, isGpuEnabled());
+	#ifdef GPU_ENABLED
+	kineticAccum_gpu(basis.nbasis, nColsTot, C.dataGpu(), HC ? HC->dataGpu() : 0,
+		basis.gInfo->GGT, basis.iGarr.dataGpu(), C.qnum->k, basis.gInfo->detR, KE.dataGpu());
+	#else
+	threadLaunch(kineticAccum_sub, nColsTot, &C, HC, KE.data());
+	#endif
+	//Collect over spinor components:
+	diagMatrix KEcols(C.nCols(), 0.);
+	const double* KEdata = KE.data();
+	for(int b=0; b<C.nCols(); b++)
+		for(int s=0; s<nSpinors; s++)
+			KEcols[b] += KEdata[b*nSpinors+s];
+	watch.addWork(8.*basis.nbasis*nColsTot, basis.nbasis*nColsTot*(HC ? 3 : 1)*sizeof(complex));
+	watch.stop();
+	return KEcols;
+}
+
 //Inverse-Laplacian of a column bundle
 #ifdef GPU_ENABLED
 void reducedLinv_gpu(int nbasis, int ncols, const complex* Y, complex* LinvY,
@@ -397,6 +627,70 @@ void precond_inv_kinetic_band(ColumnBundle& Y, const diagMatrix& KErefIn)
 		basis.gInfo->GGT, basis.iGarr.dataPref(), Y.qnum->k);
 }
 
+void precond_residual_band_sub(size_t iStart, size_t iStop, int nbasis, int colLength,
+	const complex* C, const complex* HC, const complex* OC, const double* eigs,
+	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k, double detR,
+	double normCut, complex* R, double* norms)
+{	std::vector<double> KE(nbasis);
+	for(int j=0; j<nbasis; j++)
+		KE[j] = 0.5*GGT.metric_length_squared(iGarr[j]+k);
+	for(size_t i=iStart; i<iStop; i++)
+	{	size_t offset = i*colLength;
+		//KE reference for this band:
+		double KEref = 0.;
+		for(int j=0; j<colLength; j++)
+			KEref += KE[j % nbasis] * C[offset+j].norm();
+		KEref *= detR;
+		//Preconditioned residual and its norm:
+		double normSq = 0.;
+		for(int j=0; j<colLength; j++)
+		{	complex r = precond_residual_band_calc(offset+j, HC, OC, eigs[i], KE[j % nbasis], KEref);
+			R[offset+j] = r;
+			normSq += r.norm();
+		}
+		norms[i] = normSq;
+		//Normalize:
+		if(normSq >= normCut)
+		{	double scaleFac = 1./sqrt(normSq);
+			for(int j=0; j<colLength; j++)
+				R[offset+j] *= scaleFac;
+		}
+	}
+}
+void precond_residual_band(int nbasis, int colLength, int ncols,
+	const complex* C, const complex* HC, const complex* OC, const double* eigs,
+	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k, double detR,
+	double normCut, complex* R, double* norms)
+{	threadLaunch(precond_residual_band_sub, ncols, nbasis, colLength, C, HC, OC, eigs, GGT, iGarr, k, detR, normCut, R, norms);
+}
+#ifdef GPU_ENABLED
+void precond_residual_band_gpu(int nbasis, int colLength, int ncols,
+	const complex* C, const complex* HC, const complex* OC, const double* eigs,
+	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k, double detR,
+	double normCut, complex* R, double* norms);
+#endif
+diagMatrix precond_residual_band(const ColumnBundle& C, const ColumnBundle& HC, const ColumnBundle& OC,
+	const diagMatrix& eigs, double normCut, ColumnBundle& R)
+{	static StopWatch watch("precond_residual_band"); watch.start();
+	assert(C.basis);
+	const Basis& basis = *C.basis;
+	int nCols = C.nCols();
+	assert(HC.nCols()==nCols); assert(OC.nCols()==nCols); assert(eigs.nCols()==nCols);
+	assert(HC.colLength()==C.colLength()); assert(OC.colLength()==C.colLength());
+	R = C.similar();
+	//Band energies in, and squared norms out, via dummy ManagedMemory objects (as in precond_inv_kinetic_band):
+	matrix eigsBuf(nCols, 1), normsBuf(nCols, 1);
+	eblas_copy((double*)eigsBuf.data(), eigs.data(), nCols);
+	callPref(precond_residual_band)(basis.nbasis, C.colLength(), nCols,
+		C.dataPref(), HC.dataPref(), OC.dataPref(), (const double*)eigsBuf.dataPref(),
+		basis.gInfo->GGT, basis.iGarr.dataPref(), C.qnum->k, basis.gInfo->detR,
+		normCut, R.dataPref(), (double*)normsBuf.dataPref());
+	diagMatrix norms(nCols);
+	eblas_copy(norms.data(), (const double*)normsBuf.data(), nCols);
+	watch.stop();
+	return norms;
+}
+
 
 #ifdef GPU_ENABLED
 void translate_gpu(int nbasis, int ncols, complex* Y, const vector3<int>* iGarr, const vector3<>& k, const vector3<>& dr);
@@ -432,13 +726,92 @@ void translateColumns(ColumnBundle& Y, const vector3<>* dr)
 }
 
 
+//Order of basis entries by G-vector: the identity for bases set up from a cutoff (whose iGarr is lexicographically sorted)
+static std::vector<int> sortedBasisOrder(const Basis& basis)
+{	auto iGless = [](const vector3<int>& a, const vector3<int>& b)
+	{	for(int dir=0; dir<3; dir++) if(a[dir] != b[dir]) return a[dir] < b[dir];
+		return false;
+	};
+	const vector3<int>* iGarr = basis.iGarr.data();
+	std::vector<int> order(basis.nbasis);
+	for(size_t i=0; i<basis.nbasis; i++) order[i] = i;
+	if(!std::is_sorted(iGarr, iGarr+basis.nbasis, iGless)) //custom basis
+		std::sort(order.begin(), order.end(), [&](int i, int j) { return iGless(iGarr[i], iGarr[j]); });
+	return order;
+}
+
+//Positions iIn and iOut of the G-vectors common to two bases, by merging their sorted G-vector lists
+static void commonBasisIndices(const Basis& basisIn, const Basis& basisOut, std::vector<int>& iIn, std::vector<int>& iOut)
+{	std::vector<int> orderIn = sortedBasisOrder(basisIn), orderOut = sortedBasisOrder(basisOut);
+	const vector3<int>* iGin = basisIn.iGarr.data();
+	const vector3<int>* iGout = basisOut.iGarr.data();
+	iIn.clear(); iIn.reserve(std::min(basisIn.nbasis, basisOut.nbasis));
+	iOut.clear(); iOut.reserve(std::min(basisIn.nbasis, basisOut.nbasis));
+	size_t jIn=0, jOut=0;
+	while(jIn<orderIn.size() && jOut<orderOut.size())
+	{	const vector3<int>& a = iGin[orderIn[jIn]];
+		const vector3<int>& b = iGout[orderOut[jOut]];
+		int cmp = 0;
+		for(int dir=0; dir<3 && !cmp; dir++) cmp = (a[dir] < b[dir]) ? -1 : (a[dir] > b[dir] ? 1 : 0);
+		if(cmp < 0) jIn++;
+		else if(cmp > 0) jOut++;
+		else
+		{	iIn.push_back(orderIn[jIn++]);
+			iOut.push_back(orderOut[jOut++]);
+		}
+	}
+}
+
+//Copy columns [colStart,colStop) (each of length nbasis) between bases using the common index lists:
+//scatter if all of the input is retained, gather if all of the output is available, and both via tmp otherwise
+void switchBasis_sub(size_t colStart, size_t colStop, int nCommon, const int* indexIn, const int* indexOut,
+	const complex* inData, size_t nbasisIn, complex* outData, size_t nbasisOut, complex* tmpData)
+{	for(size_t col=colStart; col<colStop; col++)
+	{	const complex* x = inData + col*nbasisIn;
+		complex* y = outData + col*nbasisOut;
+		if(!indexIn) callPref(eblas_scatter_zdaxpy)(nCommon, 1., indexOut, x, y);
+		else if(!indexOut) callPref(eblas_gather_zdaxpy)(nCommon, 1., indexIn, x, y);
+		else
+		{	complex* t = tmpData + col*nCommon;
+			callPref(eblas_gather_zdaxpy)(nCommon, 1., indexIn, x, t);
+			callPref(eblas_scatter_zdaxpy)(nCommon, 1., indexOut, t, y);
+		}
+	}
+}
+
+void switchBasis(const ColumnBundle& in, ColumnBundle& out)
+{	static StopWatch watch("switchBasis"); watch.start();
+	assert(in.basis && out.basis);
+	assert(in.spinorLength() == out.spinorLength());
+	const Basis& basisIn = *in.basis;
+	const Basis& basisOut = *out.basis;
+	int nColsTot = std::min(in.nCols(), out.nCols()) * in.spinorLength(); //each column-spinor is contiguous in nbasis
+	std::vector<int> iIn, iOut;
+	commonBasisIndices(basisIn, basisOut, iIn, iOut);
+	int nCommon = iIn.size();
+	bool scatter = (size_t(nCommon) == basisIn.nbasis); //all of input retained (e.g. increased cutoff)
+	bool gather = !scatter && (size_t(nCommon) == basisOut.nbasis); //all of output available (e.g. decreased cutoff)
+	ManagedArray<int> indexIn, indexOut;
+	if(!scatter) indexIn = ManagedArray<int>(iIn);
+	if(!gather) indexOut = ManagedArray<int>(iOut);
+	ManagedArray<complex> tmp;
+	if(!scatter && !gather)
+	{	tmp.init(size_t(nColsTot)*nCommon, isGpuEnabled());
+		callPref(eblas_zero)(tmp.nData(), tmp.dataPref());
+	}
+	complex* outData = out.dataPref();
+	callPref(eblas_zero)(nColsTot*basisOut.nbasis, outData);
+	threadLaunch(isGpuEnabled() ? 1 : 0, switchBasis_sub, nColsTot, nCommon,
+		indexIn.nData() ? indexIn.dataPref() : (const int*)0, indexOut.nData() ? indexOut.dataPref() : (const int*)0,
+		in.dataPref(), basisIn.nbasis, outData, basisOut.nbasis, tmp.nData() ? tmp.dataPref() : (complex*)0);
+	watch.stop();
+}
+
 ColumnBundle switchBasis(const ColumnBundle& in, const Basis& basisOut)
 {	if(in.basis == &basisOut) return in; //no basis change required
 	int nSpinors = in.spinorLength();
 	ColumnBundle out(in.nCols(), basisOut.nbasis*nSpinors, &basisOut, 0, isGpuEnabled());
-	for(int b=0; b<in.nCols(); b++)
-		for(int s=0; s<nSpinors; s++)
-			out.setColumn(b,s, in.getColumn(b,s)); //convert using the full G-space as an intermediate
+	switchBasis(in, out);
 	return out;
 }
 
@@ -455,41 +828,71 @@ complex traceinner(const diagMatrix &F, const ColumnBundle &X, const ColumnBundl
 	return result;
 }
 
-// Compute the density from a subset of columns of a ColumnBundle
-void diagouterI_sub(int iThread, int nThreads, const diagMatrix *F, const ColumnBundle *X, std::vector<ScalarFieldArray>* nSub)
+// Accumulate Fi times the density of one real-space column psi (see diagouterI_sub)
+inline void diagouterI_accum(const GridInfo& gInfo, int nSpinor, double Fi, const complex* psi, ScalarFieldArray& n)
+{	if(n.size()==1) //Note that nDensities==2 will also enter this branch since only one component is non-zero
+	{	for(int s=0; s<nSpinor; s++)
+			callPref(eblas_accumNorm)(gInfo.nr, Fi, psi+gInfo.nr*s, n[0]->dataPref());
+	}
+	else //nDensities==4 (ensured by assertions in launching function below)
+	{	const complex* psiUp = psi;
+		const complex* psiDn = psi + gInfo.nr;
+		callPref(eblas_accumNorm)(gInfo.nr, Fi, psiUp, n[0]->dataPref()); //UpUp
+		callPref(eblas_accumNorm)(gInfo.nr, Fi, psiDn, n[1]->dataPref()); //DnDn
+		callPref(eblas_accumProd)(gInfo.nr, Fi, psiUp, psiDn, n[2]->dataPref(), n[3]->dataPref()); //Re and Im parts of UpDn
+	}
+}
+
+// Compute the densities for each set of fillings from a subset of columns of a ColumnBundle
+// (if withTau, the last entry of each nSub[iThread] accumulates the KE density for the first set of fillings)
+void diagouterI_sub(int iThread, int nThreads, const std::vector<diagMatrix> *F, const ColumnBundle *X, std::vector<std::vector<ScalarFieldArray>>* nSub, bool withTau)
 {
 	//Determine column range:
 	int colStart = (( iThread ) * X->nCols())/nThreads;
 	int colStop  = ((iThread+1) * X->nCols())/nThreads;
 	
-	ScalarFieldArray& nLocal = (*nSub)[iThread];
-	nullToZero(nLocal, *(X->basis->gInfo)); //sets to zero
-	int nDensities = nLocal.size();
-	if(nDensities==1) //Note that nDensities==2 below will also enter this branch sinc eonly one component is non-zero
-	{	int nSpinor = X->spinorLength();
-		for(int i=colStart; i<colStop; i++)
-			for(int s=0; s<nSpinor; s++)
-				callPref(eblas_accumNorm)(X->basis->gInfo->nr, (*F)[i], I(X->getColumn(i,s))->dataPref(), nLocal[0]->dataPref());
-	}
-	else //nDensities==4 (ensured by assertions in launching function below)
-	{	for(int i=colStart; i<colStop; i++)
-		{	complexScalarField psiUp = I(X->getColumn(i,0));
-			complexScalarField psiDn = I(X->getColumn(i,1));
-			callPref(eblas_accumNorm)(X->basis->gInfo->nr, (*F)[i], psiUp->dataPref(), nLocal[0]->dataPref()); //UpUp
-			callPref(eblas_accumNorm)(X->basis->gInfo->nr, (*F)[i], psiDn->dataPref(), nLocal[1]->dataPref()); //DnDn
-			callPref(eblas_accumProd)(X->basis->gInfo->nr, (*F)[i], psiUp->dataPref(), psiDn->dataPref(), nLocal[2]->dataPref(), nLocal[3]->dataPref()); //Re and Im parts of UpDn
+	std::vector<ScalarFieldArray>& nLocal = (*nSub)[iThread];
+	for(ScalarFieldArray& nLocalSet: nLocal) nullToZero(nLocalSet, *(X->basis->gInfo)); //sets to zero
+	int nSets = nLocal.size() - (withTau ? 1 : 0);
+	const GridInfo& gInfo = *(X->basis->gInfo);
+	int nSpinor = X->spinorLength();
+	int nBatch = fftBatchCols(*X, nThreads);
+	complex* buf = gInfo.getWorkspace(nSpinor*nBatch, isGpuEnabled()); //per-thread scratch reused across batches and calls
+	for(int colBatch=colStart; colBatch<colStop; colBatch+=nBatch)
+	{	int colBatchStop = std::min(colBatch+nBatch, colStop);
+		X->getColumns(colBatch, colBatchStop, buf);
+		I_batch(gInfo, buf, (colBatchStop-colBatch)*nSpinor);
+		for(int i=colBatch; i<colBatchStop; i++)
+		{	const complex* psi = buf + gInfo.nr*((i-colBatch)*nSpinor);
+			for(int iSet=0; iSet<nSets; iSet++)
+			{	double Fi = (*F)[iSet][i];
+				if(!Fi) continue; //common for energy-resolved fillings
+				diagouterI_accum(gInfo, nSpinor, Fi, psi, nLocal[iSet]);
+			}
+		}
+		//KE density from the gradients of the same block (scattered directly into the FFT boxes):
+		if(withTau)
+		{	for(int iDir=0; iDir<3; iDir++)
+			{	scatterD(*X, colBatch, colBatchStop, iDir, buf);
+				I_batch(gInfo, buf, (colBatchStop-colBatch)*nSpinor);
+				for(int i=colBatch; i<colBatchStop; i++)
+				{	double Fi = (*F)[0][i];
+					if(Fi) diagouterI_accum(gInfo, nSpinor, 0.5*Fi, buf + gInfo.nr*((i-colBatch)*nSpinor), nLocal[nSets]);
+				}
+			}
 		}
 	}
 }
 
 // Collect all contributions from nSub into the first entry
-void diagouterI_collect(size_t iStart, size_t iStop, std::vector<ScalarFieldArray>* nSub)
+void diagouterI_collect(size_t iStart, size_t iStop, std::vector<std::vector<ScalarFieldArray>>* nSub)
 {	assert(!isGpuEnabled()); // this is needed and should be called only in CPU mode
-	for(size_t s=0; s<(*nSub)[0].size(); s++)
+	int nThreads = nSub->size();
+	for(size_t iSet=0; iSet<(*nSub)[0].size(); iSet++)
+	for(size_t s=0; s<(*nSub)[0][iSet].size(); s++)
 	{	//Get the data pointers for each piece in nSub:
-		int nThreads = nSub->size();
 		std::vector<double*> nSubData(nThreads);
-		for(int j=0; j<nThreads; j++) nSubData[j] = (*nSub)[j][s]->data();
+		for(int j=0; j<nThreads; j++) nSubData[j] = (*nSub)[j][iSet][s]->data();
 
 		//Accumulate pointwise into the first piece:
 		for(size_t i=iStart; i<iStop; i++)
@@ -500,31 +903,47 @@ void diagouterI_collect(size_t iStart, size_t iStop, std::vector<ScalarFieldArra
 
 // Returns diag((I*X)*F*(I*X)^) where X^ is the hermetian adjoint of X.
 ScalarFieldArray diagouterI(const diagMatrix &F,const ColumnBundle &X,  int nDensities, const GridInfo* gInfoOut)
+{	return diagouterI(std::vector<diagMatrix>(1, F), X, nDensities, gInfoOut)[0];
+}
+
+// Returns diag((I*X)*F[iSet]*(I*X)^) for each iSet
+std::vector<ScalarFieldArray> diagouterI(const std::vector<diagMatrix>& F, const ColumnBundle &X,  int nDensities, const GridInfo* gInfoOut, ScalarFieldArray* tau)
 {	static StopWatch watch("diagouterI"); watch.start();
 	//Check sizes:
-	assert(F.nRows()==X.nCols());
+	assert(F.size());
+	for(const diagMatrix& Fset: F) assert(Fset.nRows()==X.nCols());
 	assert(nDensities==1 || nDensities==2 || nDensities==4);
 	if(nDensities==2) assert(!X.isSpinor());
 	if(nDensities==4) assert(X.isSpinor());
 	
 	//Collect the contributions for different sets of columns in separate scalar fields (one per thread):
-	int nThreads = isGpuEnabled() ? 1: nProcsAvailable;
-	std::vector<ScalarFieldArray> nSub(nThreads, ScalarFieldArray(nDensities==2 ? 1 : nDensities)); //collinear spin-polarized will have only one non-zero output channel
-	threadLaunch(nThreads, diagouterI_sub, 0, &F, &X, &nSub);
+	//(with many sets, fewer threads to bound the memory of the thread-local accumulators to that of a few sets on all threads)
+	bool withTau = tau;
+	int nOut = F.size() + (withTau ? 1 : 0); //KE density (if any) collected as an extra set
+	int nThreads = isGpuEnabled() ? 1: std::max(1, std::min(nProcsAvailable, (4*nProcsAvailable)/nOut));
+	std::vector<std::vector<ScalarFieldArray>> nSub(nThreads,
+		std::vector<ScalarFieldArray>(nOut, ScalarFieldArray(nDensities==2 ? 1 : nDensities))); //collinear spin-polarized will have only one non-zero output channel
+	threadLaunch(nThreads, diagouterI_sub, 0, &F, &X, &nSub, withTau);
 
 	//If more than one thread, accumulate all vectors in nSub into the first:
 	if(nThreads>1) threadLaunch(diagouterI_collect, X.basis->gInfo->nr, &nSub);
 	watch.stop();
 	
-	//Change grid if necessary:
-	if(gInfoOut && (X.basis->gInfo!=gInfoOut))
-		for(ScalarField& nSub0s: nSub[0])
-			nSub0s = changeGrid(nSub0s, *gInfoOut);
-	
-	//Correct the location of the single non-zero channel of collinear spin-polarized densities:
-	if(nDensities==2)
-	{	nSub[0].resize(2);
-		if(X.qnum->index()==1) std::swap(nSub[0][0], nSub[0][1]);
+	for(ScalarFieldArray& nSet: nSub[0])
+	{	//Change grid if necessary:
+		if(gInfoOut && (X.basis->gInfo!=gInfoOut))
+			for(ScalarField& nSub0s: nSet)
+				nSub0s = changeGrid(nSub0s, *gInfoOut);
+		
+		//Correct the location of the single non-zero channel of collinear spin-polarized densities:
+		if(nDensities==2)
+		{	nSet.resize(2);
+			if(X.qnum->index()==1) std::swap(nSet[0], nSet[1]);
+		}
+	}
+	if(withTau)
+	{	*tau = nSub[0].back();
+		nSub[0].pop_back();
 	}
 	return nSub[0]; //rest cleaned up destructor
 }
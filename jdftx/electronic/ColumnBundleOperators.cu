@@ -30,7 +30,7 @@ void reducedL_kernel(int nbasis, int ncols, const complex* Y, complex* LY,
 void reducedL_gpu(int nbasis, int ncols, const complex* Y, complex* LY,
 	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR)
 {	GpuLaunchConfig1D glc(reducedL_kernel, nbasis);
-	reducedL_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, LY, GGT, iGarr, k, detR);
+	reducedL_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, LY, GGT, iGarr, k, detR);
 	gpuErrorCheck();
 }
 
@@ -43,7 +43,22 @@ void reducedLinv_kernel(int nbasis, int ncols, const complex* Y, complex* LinvY,
 void reducedLinv_gpu(int nbasis, int ncols, const complex* Y, complex* LinvY,
 	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR)
 {	GpuLaunchConfig1D glc(reducedLinv_kernel, nbasis);
-	reducedLinv_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, LinvY, GGT, iGarr, k, detR);
+	reducedLinv_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, LinvY, GGT, iGarr, k, detR);
+	gpuErrorCheck();
+}
+
+
+template<int nSpinor> __global__
+void randomize_kernel(int nbasis, int colStart, int colStop, int bandOffset, complex* Y,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, uint32_t key0, uint32_t key1)
+{	int j = kernelIndex1D();
+	if(j<nbasis) randomize_calc<nSpinor>(j, nbasis, colStart, colStop, bandOffset, Y, GGT, iGarr, k, detR, key0, key1);
+}
+void randomize_gpu(int nbasis, int nSpinor, int colStart, int colStop, int bandOffset, complex* Y,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, uint32_t key0, uint32_t key1)
+{	GpuLaunchConfig1D glc(randomize_kernel<1>, nbasis);
+	if(nSpinor==1) randomize_kernel<1><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, colStart, colStop, bandOffset, Y, GGT, iGarr, k, detR, key0, key1);
+	else randomize_kernel<2><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, colStart, colStop, bandOffset, Y, GGT, iGarr, k, detR, key0, key1);
 	gpuErrorCheck();
 }
 
@@ -57,7 +72,7 @@ void precond_inv_kinetic_kernel(int nbasis, int ncols, complex* Y,
 void precond_inv_kinetic_gpu(int nbasis, int ncols, complex* Y,
 	double KErollover, const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double invdetR)
 {	GpuLaunchConfig1D glc(precond_inv_kinetic_kernel, nbasis);
-	precond_inv_kinetic_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, KErollover, GGT, iGarr, k, invdetR);
+	precond_inv_kinetic_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, KErollover, GGT, iGarr, k, invdetR);
 	gpuErrorCheck();
 }
 
@@ -70,7 +85,57 @@ void precond_inv_kinetic_band_kernel(int nbasis, int ncols, complex* Y, const do
 void precond_inv_kinetic_band_gpu(int nbasis, int ncols, complex* Y, const double* KEref,
 	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k)
 {	GpuLaunchConfig1D glc(precond_inv_kinetic_band_kernel, nbasis);
-	precond_inv_kinetic_band_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, KEref, GGT, iGarr, k);
+	precond_inv_kinetic_band_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, KEref, GGT, iGarr, k);
+	gpuErrorCheck();
+}
+
+//Sum x over the threads of a block (blockDim.x must be a power of 2, and buf must have blockDim.x entries)
+__device__ double precond_residual_band_blockSum(double* buf, double x)
+{	buf[threadIdx.x] = x;
+	__syncthreads();
+	for(int n=blockDim.x/2; n>0; n>>=1)
+	{	if(threadIdx.x < n) buf[threadIdx.x] += buf[threadIdx.x+n];
+		__syncthreads();
+	}
+	double result = buf[0];
+	__syncthreads();
+	return result;
+}
+const int precond_residual_band_blockSize = 256;
+//One block per column, so that the reductions (KE reference and norm) complete within the same kernel
+__global__
+void precond_residual_band_kernel(int nbasis, int colLength, const complex* C, const complex* HC, const complex* OC, const double* eigs,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, double normCut, complex* R, double* norms)
+{	__shared__ double buf[precond_residual_band_blockSize];
+	int i = blockIdx.x;
+	size_t offset = size_t(i)*colLength;
+	C += offset; HC += offset; OC += offset; R += offset;
+	//KE reference for this band:
+	double sum = 0.;
+	for(int j=threadIdx.x; j<colLength; j+=blockDim.x)
+		sum += GGT.metric_length_squared(iGarr[j % nbasis]+k) * C[j].norm();
+	double KEref = 0.5*detR*precond_residual_band_blockSum(buf, sum);
+	//Preconditioned residual and its norm:
+	sum = 0.;
+	for(int j=threadIdx.x; j<colLength; j+=blockDim.x)
+	{	complex r = precond_residual_band_calc(j, HC, OC, eigs[i], 0.5*GGT.metric_length_squared(iGarr[j % nbasis]+k), KEref);
+		R[j] = r;
+		sum += r.norm();
+	}
+	double normSq = precond_residual_band_blockSum(buf, sum);
+	if(threadIdx.x == 0) norms[i] = normSq;
+	//Normalize:
+	if(normSq >= normCut)
+	{	double scaleFac = 1./sqrt(normSq);
+		for(int j=threadIdx.x; j<colLength; j+=blockDim.x)
+			R[j] *= scaleFac;
+	}
+}
+void precond_residual_band_gpu(int nbasis, int colLength, int ncols,
+	const complex* C, const complex* HC, const complex* OC, const double* eigs,
+	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k, double detR,
+	double normCut, complex* R, double* norms)
+{	precond_residual_band_kernel<<<ncols, precond_residual_band_blockSize, 0, gpuStream>>>(nbasis, colLength, C, HC, OC, eigs, GGT, iGarr, k, detR, normCut, R, norms);
 	gpuErrorCheck();
 }
 
@@ -81,7 +146,7 @@ void translate_kernel(int nbasis, int ncols, complex* Y, const vector3<int>* iGa
 }
 void translate_gpu(int nbasis, int ncols, complex* Y, const vector3<int>* iGarr, const vector3<>& k, const vector3<>& dr)
 {	GpuLaunchConfig1D glc(translate_kernel, nbasis);
-	translate_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, iGarr, k, dr);
+	translate_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, iGarr, k, dr);
 	gpuErrorCheck();
 }
 
@@ -92,7 +157,7 @@ void translateColumns_kernel(int nbasis, int ncols, complex* Y, const vector3<in
 }
 void translateColumns_gpu(int nbasis, int ncols, complex* Y, const vector3<int>* iGarr, const vector3<>& k, const vector3<>* dr)
 {	GpuLaunchConfig1D glc(translateColumns_kernel, nbasis);
-	translateColumns_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, iGarr, k, dr);
+	translateColumns_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, iGarr, k, dr);
 	gpuErrorCheck();
 }
 
@@ -106,7 +171,7 @@ void reducedD_kernel(int nbasis, int ncols, const complex* Y, complex* DY,
 void reducedD_gpu(int nbasis, int ncols, const complex* Y, complex* DY, 
 	const vector3<int>* iGarr, double kdotGe, const vector3<> Ge)
 {	GpuLaunchConfig1D glc(reducedD_kernel, nbasis);
-	reducedD_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, DY, iGarr, kdotGe, Ge);
+	reducedD_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, DY, iGarr, kdotGe, Ge);
 	gpuErrorCheck();
 }
 
@@ -119,6 +184,70 @@ void reducedDD_kernel(int nbasis, int ncols, const complex* Y, complex* DDY,
 void reducedDD_gpu(int nbasis, int ncols, const complex* Y, complex* DDY, 
 	const vector3<int>* iGarr, double kdotGe1, double kdotGe2, const vector3<> Ge1, const vector3<> Ge2)
 {	GpuLaunchConfig1D glc(reducedDD_kernel, nbasis);
-	reducedDD_kernel<<<glc.nBlocks,glc.nPerBlock>>>(nbasis, ncols, Y, DDY, iGarr, kdotGe1, kdotGe2, Ge1, Ge2);
+	reducedDD_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, ncols, Y, DDY, iGarr, kdotGe1, kdotGe2, Ge1, Ge2);
+	gpuErrorCheck();
+}
+
+__global__
+void spinorMultiply_kernel(int nr, const double* Vup, double VupScale, const double* Vdn, double VdnScale,
+	const complex* VupDn, double VupDnScale, complex* ICup, complex* ICdn)
+{	int i = kernelIndex1D();
+	if(i<nr) spinorMultiply_calc(i, Vup, VupScale, Vdn, VdnScale, VupDn, VupDnScale, ICup, ICdn);
+}
+void spinorMultiply_gpu(int nr, const double* Vup, double VupScale, const double* Vdn, double VdnScale,
+	const complex* VupDn, double VupDnScale, complex* ICup, complex* ICdn)
+{	GpuLaunchConfig1D glc(spinorMultiply_kernel, nr);
+	spinorMultiply_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, Vup, VupScale, Vdn, VdnScale, VupDn, VupDnScale, ICup, ICdn);
+	gpuErrorCheck();
+}
+
+__global__
+void scatterD_kernel(int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<> Ge, const complex* C, complex* boxes)
+{	int j = kernelIndex1D();
+	if(j<nbasis) scatterD_calc(j, nbasis, nr, nBoxes, index, iGarr, kdotGe, Ge, C, boxes);
+}
+void scatterD_gpu(int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<> Ge, const complex* C, complex* boxes)
+{	GpuLaunchConfig1D glc(scatterD_kernel, nbasis);
+	scatterD_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, nr, nBoxes, index, iGarr, kdotGe, Ge, C, boxes);
+	gpuErrorCheck();
+}
+
+__global__
+void gatherDaccum_kernel(int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<> Ge, double alpha, const complex* boxes, complex* HC)
+{	int j = kernelIndex1D();
+	if(j<nbasis) gatherDaccum_calc(j, nbasis, nr, nBoxes, index, iGarr, kdotGe, Ge, alpha, boxes, HC);
+}
+void gatherDaccum_gpu(int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<> Ge, double alpha, const complex* boxes, complex* HC)
+{	GpuLaunchConfig1D glc(gatherDaccum_kernel, nbasis);
+	gatherDaccum_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, nr, nBoxes, index, iGarr, kdotGe, Ge, alpha, boxes, HC);
+	gpuErrorCheck();
+}
+
+//One block per column, reducing the kinetic energy of the column in shared memory:
+const int kineticAccumBlockSize = 256;
+template<bool accumHC> __global__
+void kineticAccum_kernel(int nbasis, const complex* C, complex* HC,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, double* KE)
+{	__shared__ double sum[kineticAccumBlockSize];
+	int col = blockIdx.x;
+	double s = 0.;
+	for(int j=threadIdx.x; j<nbasis; j+=blockDim.x)
+		s += kineticAccum_calc<accumHC>(j, nbasis, col, C, HC, GGT, iGarr, k, detR);
+	sum[threadIdx.x] = s;
+	__syncthreads();
+	for(int n=blockDim.x/2; n>0; n>>=1)
+	{	if(threadIdx.x < n) sum[threadIdx.x] += sum[threadIdx.x+n];
+		__syncthreads();
+	}
+	if(!threadIdx.x) KE[col] = sum[0];
+}
+void kineticAccum_gpu(int nbasis, int ncols, const complex* C, complex* HC,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, double* KE)
+{	if(HC) kineticAccum_kernel<true><<<ncols, kineticAccumBlockSize, 0, gpuStream>>>(nbasis, C, HC, GGT, iGarr, k, detR, KE);
+	else kineticAccum_kernel<false><<<ncols, kineticAccumBlockSize, 0, gpuStream>>>(nbasis, C, HC, GGT, iGarr, k, detR, KE);
 	gpuErrorCheck();
 }
@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_ELECTRONIC_COLUMNBUNDLEOPERATORS_INTERNAL_H
 
 #include <core/matrix3.h>
+#include <core/Random.h>
 
 //! @cond
 
@@ -37,6 +38,21 @@ __hostanddev__ void reducedLinv_calc(int j, int nbasis, int ncols, const complex
 	}
 }
 
+//Random wavefunction coefficients with a high frequency cutoff of 0.75 hartrees for columns colStart to colStop-1.
+//The counter is (band, iG, spinor) with band = column + bandOffset, and the key identifies the state,
+//so that the result is independent of basis ordering and of how states, bands and G-vectors are distributed.
+//Specialized on nSpinor (1 or 2), so that the column loop has a compile-time stride.
+template<int nSpinor> __hostanddev__ void randomize_calc(int j, int nbasis, int colStart, int colStop, int bandOffset, complex* Y,
+	const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double detR, uint32_t key0, uint32_t key1)
+{	const vector3<int>& iG = iGarr[j];
+	double t = 0.5*GGT.metric_length_squared(iG+k)/0.75;
+	double sigma = 1.0/((1.0+t*t*t*t*t*t) * detR);
+	int colLength = nbasis*nSpinor;
+	for(int s=0; s<nSpinor; s++)
+		for(int i=colStart; i<colStop; i++)
+			Y[i*colLength + j + s*nbasis] = Random::counterNormalComplex(sigma, i+bandOffset, iG[0], iG[1], 2*iG[2]+s, key0, key1);
+}
+
 __hostanddev__ void precond_inv_kinetic_calc(int j, int nbasis, int ncols, complex* Ydata,
 	double KErollover, const matrix3<> GGT, const vector3<int>* iGarr, const vector3<> k, double invdetR)
 {
@@ -47,14 +63,21 @@ __hostanddev__ void precond_inv_kinetic_calc(int j, int nbasis, int ncols, compl
 		Ydata[nbasis*i+j] *= precondFactor;
 }
 
+__hostanddev__ double precond_inv_kinetic_band_factor(double x)
+{	return (27.+x*(18.+x*(12.+x*8.))) / (27.+x*(18.+x*(12.+x*(8.+x*16))));
+}
+
 __hostanddev__ void precond_inv_kinetic_band_calc(int j, int nbasis, int ncols, complex* Ydata, const double* KEref,
 	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k)
 {
 	double KE = 0.5*GGT.metric_length_squared(iGarr[j]+k);
 	for(int i=0; i<ncols; i++)
-	{	double x = KE/KEref[i];
-		Ydata[nbasis*i+j] *= (27.+x*(18.+x*(12.+x*8.))) / (27.+x*(18.+x*(12.+x*(8.+x*16))));
-	}
+		Ydata[nbasis*i+j] *= precond_inv_kinetic_band_factor(KE/KEref[i]);
+}
+
+//Davidson residual for one column, in terms of per-basis-index kinetic energy KE[j] (see precond_residual_band)
+__hostanddev__ complex precond_residual_band_calc(int j, const complex* HC, const complex* OC, double eig, double KE, double KEref)
+{	return precond_inv_kinetic_band_factor(KE/KEref) * (HC[j] - eig*OC[j]);
 }
 
 __hostanddev__
@@ -87,5 +110,40 @@ __hostanddev__ void reducedDD_calc(int j, int nbasis, int ncols, const complex*
 		DYdata[nbasis*i+j] = Di*Dj*Ydata[nbasis*i+j];
 }
 
+//Scatter i(k+G).e times columns to (zeroed) full G-space boxes, i.e. getColumns of D(C)
+__hostanddev__ void scatterD_calc(int j, int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<>& Ge, const complex* C, complex* boxes)
+{	complex Di(0, kdotGe+dot(iGarr[j],Ge)); // i (k+G).e
+	for(int s=0; s<nBoxes; s++)
+		boxes[nr*s+index[j]] = Di * C[nbasis*s+j];
+}
+
+//Accumulate alpha i(k+G).e times the basis entries of full G-space boxes to columns, i.e. accumColumns followed by D
+__hostanddev__ void gatherDaccum_calc(int j, int nbasis, int nr, int nBoxes, const int* index, const vector3<int>* iGarr,
+	double kdotGe, const vector3<>& Ge, double alpha, const complex* boxes, complex* HC)
+{	complex Di(0, alpha*(kdotGe+dot(iGarr[j],Ge))); // alpha i (k+G).e
+	for(int s=0; s<nBoxes; s++)
+		HC[nbasis*s+j] += Di * boxes[nr*s+index[j]];
+}
+
+//Accumulate -0.5 L onto HC (if accumHC) for one column, and return the contribution of this entry to its kinetic energy
+//(specialized on accumHC so that the energy-only variant carries no per-entry branch or store)
+template<bool accumHC> __hostanddev__ double kineticAccum_calc(int j, int nbasis, int col, const complex* C, complex* HC,
+	const matrix3<>& GGT, const vector3<int>* iGarr, const vector3<>& k, double detR)
+{	double T = (0.5*detR) * GGT.metric_length_squared(iGarr[j]+k);
+	complex Cj = C[nbasis*col+j];
+	if(accumHC) HC[nbasis*col+j] += T * Cj;
+	return T * Cj.norm();
+}
+
+//Apply the 2x2 spinor potential [[Vup, VupDn], [conj(VupDn), Vdn]] to the up and down components of one column in place
+__hostanddev__ void spinorMultiply_calc(int i, const double* Vup, double VupScale, const double* Vdn, double VdnScale,
+	const complex* VupDn, double VupDnScale, complex* ICup, complex* ICdn)
+{	complex up = ICup[i], dn = ICdn[i];
+	complex Vud = VupDnScale * VupDn[i];
+	ICup[i] = (VupScale * Vup[i]) * up + Vud * dn;
+	ICdn[i] = (VdnScale * Vdn[i]) * dn + Vud.conj() * up;
+}
+
 //! @endcond
 #endif // JDFTX_ELECTRONIC_COLUMNBUNDLEOPERATORS_INTERNAL_H
@@ -18,6 +18,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 -------------------------------------------------------------------*/
 
 #include <electronic/ColumnBundleTransform.h>
+#include <electronic/ColumnBundleTransform_internal.h>
 #include <electronic/ColumnBundle.h>
 #include <electronic/Everything.h>
 #include <core/LatticeUtils.h>
@@ -41,7 +42,8 @@ ColumnBundleTransform::BasisWrapper::BasisWrapper(const Basis& basis) : basis(ba
 }
 
 ColumnBundleTransform::ColumnBundleTransform(const vector3<>& kC, const Basis& basisC, const vector3<>& kD,
-	const ColumnBundleTransform::BasisWrapper& basisDwrapper, int nSpinor, const SpaceGroupOp& sym, int invert, const matrix3<int>& super)
+	const ColumnBundleTransform::BasisWrapper& basisDwrapper, int nSpinor, const SpaceGroupOp& sym, int invert, const matrix3<int>& super,
+	const ColumnBundleTransform* indexSource)
 : basisC(basisC), basisD(basisDwrapper.basis), nSpinor(nSpinor), invert(invert), kC(kC), kD(kD), sym(sym)
 {
 	//Check k-point transformation and determine offset
@@ -49,19 +51,29 @@ ColumnBundleTransform::ColumnBundleTransform(const vector3<>& kC, const Basis& b
 	assert(nrm2(metricC - (~sym.rot)*metricC*sym.rot) < symmThreshold * nrm2(metricC)); //check symmetry
 	assert(abs(invert) == 1); //check inversion
 	assert(nrm2(basisC.gInfo->R * super - basisD.gInfo->R) < symmThreshold * nrm2(basisD.gInfo->R)); //check supercell
-	matrix3<int> affine = sym.rot * invert * super; //net affine transformation
+	affine = sym.rot * invert * super; //net affine transformation
 	double offsetErr;
 	vector3<int> offset = round(kC * affine - kD, &offsetErr);
 	assert(offsetErr < symmThreshold);
 	
 	//Initialize index map:
-	index.init(basisC.nbasis);
-	int* indexPtr = index.data();
-	for(const vector3<int>& iG_C: basisC.iGarr) //for each C recip lattice coords
-	{	vector3<int> iG_D = iG_C * affine + offset; //corresponding D recip lattice coords
-		*(indexPtr++) = basisDwrapper.table[dot(basisDwrapper.pitch, iG_D + basisDwrapper.iGbox)]; //use lookup table to get D index
+	if(indexSource)
+	{	assert(&indexSource->basisC == &basisC);
+		assert(&indexSource->basisD == &basisD);
+		assert(indexSource->affine == affine);
+		assert((indexSource->kD - kD).length_squared() < symmThreshold);
+		index = indexSource->index;
+	}
+	else
+	{	index = std::make_shared<IndexArray>();
+		index->init(basisC.nbasis);
+		int* indexPtr = index->data();
+		for(const vector3<int>& iG_C: basisC.iGarr) //for each C recip lattice coords
+		{	vector3<int> iG_D = iG_C * affine + offset; //corresponding D recip lattice coords
+			*(indexPtr++) = basisDwrapper.table[dot(basisDwrapper.pitch, iG_D + basisDwrapper.iGbox)]; //use lookup table to get D index
+		}
+		assert(*std::min_element(index->begin(), index->end()) >= 0); //make sure all entries were found
 	}
-	assert(*std::min_element(index.begin(), index.end()) >= 0); //make sure all entries were found
 	
 	//Initialize translation phase (if necessary)
 	if(sym.a.length_squared())
@@ -86,41 +98,69 @@ ColumnBundleTransform::ColumnBundleTransform(const vector3<>& kC, const Basis& b
 		}
 		default: assert(!"Invalid value for nSpinor");
 	}
+	
+	//Pack non-zero spinor terms:
+	matrix spinorRotInv = (invert<0) ? transpose(spinorRot) : dagger(spinorRot);
+	for(int sD=0; sD<nSpinor; sD++)
+		for(int sC=0; sC<nSpinor; sC++)
+		{	SpinorTerm term; term.sC = sC; term.sD = sD;
+			term.coeff = spinorRot(sD,sC);
+			if(term.coeff.norm() > symmThresholdSq) scatterTerms.push_back(term);
+			term.coeff = spinorRotInv(sC,sD);
+			if(term.coeff.norm() > symmThresholdSq) gatherTerms.push_back(term);
+		}
 }
 
-void ColumnBundleTransform::scatterAxpy(complex alpha, const ColumnBundle& C_C, int bC, ColumnBundle& C_D, int bD) const
+void ColumnBundleTransform::scatterAxpy(complex alpha, const ColumnBundle& C_C, int bC, ColumnBundle& C_D, int bD, int bDstep, int nCols) const
 {	//Check inputs:
-	assert(C_C.colLength() == nSpinor*basisC.nbasis); assert(bC >= 0 && bC < C_C.nCols());
-	assert(C_D.colLength() == nSpinor*basisD.nbasis); assert(bD >= 0 && bD < C_D.nCols());
+	assert(C_C.colLength() == nSpinor*basisC.nbasis); assert(bC >= 0 && bC+nCols <= C_C.nCols());
+	assert(C_D.colLength() == nSpinor*basisD.nbasis); assert(bD >= 0 && bD+(nCols-1)*bDstep < C_D.nCols());
+	assert(bDstep > 0 || nCols == 1); //columns are accumulated in parallel
 	//Scatter:
-	for(int sD=0; sD<nSpinor; sD++)
-		for(int sC=0; sC<nSpinor; sC++)
-			callPref(eblas_scatter_zaxpy)(index.nData(), alpha*spinorRot(sD,sC), index.dataPref(),
-				C_C.dataPref() + C_C.index(bC, sC*C_C.basis->nbasis),
-				C_D.dataPref() + C_D.index(bD, sD*C_D.basis->nbasis), invert<0,
-				phase.dataPref(), invert<0);
+	for(const SpinorTerm& term: scatterTerms)
+		callPref(transformAxpy)(true, index->nData(), nCols, alpha*term.coeff, index->dataPref(), phase.dataPref(), invert<0, invert<0,
+			C_C.dataPref() + C_C.index(bC, term.sC*C_C.basis->nbasis), C_C.colLength(),
+			C_D.dataPref() + C_D.index(bD, term.sD*C_D.basis->nbasis), bDstep*C_D.colLength());
 }
 
-void ColumnBundleTransform::gatherAxpy(complex alpha, const ColumnBundle& C_D, int bD, ColumnBundle& C_C, int bC) const
+void ColumnBundleTransform::gatherAxpy(complex alpha, const ColumnBundle& C_D, int bD, int bDstep, ColumnBundle& C_C, int bC, int nCols) const
 {	//Check inputs:
-	assert(C_C.colLength() == nSpinor*basisC.nbasis); assert(bC >= 0 && bC < C_C.nCols());
-	assert(C_D.colLength() == nSpinor*basisD.nbasis); assert(bD >= 0 && bD < C_D.nCols());
+	assert(C_C.colLength() == nSpinor*basisC.nbasis); assert(bC >= 0 && bC+nCols <= C_C.nCols());
+	assert(C_D.colLength() == nSpinor*basisD.nbasis); assert(bD >= 0 && bD+(nCols-1)*bDstep < C_D.nCols());
 	//Gather:
-	matrix spinorRotInv = (invert<0) ? transpose(spinorRot) : dagger(spinorRot);
-	for(int sD=0; sD<nSpinor; sD++)
-		for(int sC=0; sC<nSpinor; sC++)
-			callPref(eblas_gather_zaxpy)(index.nData(), alpha*spinorRotInv(sC,sD), index.dataPref(),
-				C_D.dataPref() + C_D.index(bD, sD*C_D.basis->nbasis),
-				C_C.dataPref() + C_C.index(bC, sC*C_C.basis->nbasis), invert<0,
-				phase.dataPref(), true);
+	for(const SpinorTerm& term: gatherTerms)
+		callPref(transformAxpy)(false, index->nData(), nCols, alpha*term.coeff, index->dataPref(), phase.dataPref(), invert<0, true,
+			C_D.dataPref() + C_D.index(bD, term.sD*C_D.basis->nbasis), bDstep*C_D.colLength(),
+			C_C.dataPref() + C_C.index(bC, term.sC*C_C.basis->nbasis), C_C.colLength());
+}
+
+template<bool scatter> void transformAxpy_sub(size_t iStart, size_t iStop, int nIndex, complex a, const int* index, const complex* phase,
+	bool conjx, bool conjPhase, const complex* x, int xStride, complex* y, int yStride)
+{	for(size_t j=iStart; j<iStop; j++)
+		transformAxpy_calc<scatter>(j%nIndex, j/nIndex, a, index, phase, conjx, conjPhase, x, xStride, y, yStride);
+}
+void transformAxpy(bool scatter, int nIndex, int nCols, complex a, const int* index, const complex* phase, bool conjx, bool conjPhase,
+	const complex* x, int xStride, complex* y, int yStride)
+{	size_t nJobs = size_t(nIndex)*nCols;
+	int nThreads = (nJobs<100000) ? 1 : 0;
+	if(scatter) threadLaunch(nThreads, transformAxpy_sub<true>, nJobs, nIndex, a, index, phase, conjx, conjPhase, x, xStride, y, yStride);
+	else threadLaunch(nThreads, transformAxpy_sub<false>, nJobs, nIndex, a, index, phase, conjx, conjPhase, x, xStride, y, yStride);
+}
+
+void ColumnBundleTransform::scatterAxpy(complex alpha, const ColumnBundle& C_C, int bC, ColumnBundle& C_D, int bD) const
+{	scatterAxpy(alpha, C_C,bC, C_D,bD,1, 1);
+}
+
+void ColumnBundleTransform::gatherAxpy(complex alpha, const ColumnBundle& C_D, int bD, ColumnBundle& C_C, int bC) const
+{	gatherAxpy(alpha, C_D,bD,1, C_C,bC, 1);
 }
 
 void ColumnBundleTransform::scatterAxpy(complex alpha, const ColumnBundle& C_C, ColumnBundle& C_D, int bDstart, int bDstep) const
-{	for(int bC=0; bC<C_C.nCols(); bC++) scatterAxpy(alpha, C_C,bC, C_D,bDstart+bDstep*bC);
+{	if(C_C.nCols()) scatterAxpy(alpha, C_C,0, C_D,bDstart,bDstep, C_C.nCols());
 }
 
 void ColumnBundleTransform::gatherAxpy(complex alpha, const ColumnBundle& C_D, int bDstart, int bDstep, ColumnBundle& C_C) const
-{	for(int bC=0; bC<C_C.nCols(); bC++) gatherAxpy(alpha, C_D,bDstart+bDstep*bC, C_C,bC);
+{	if(C_C.nCols()) gatherAxpy(alpha, C_D,bDstart,bDstep, C_C,0, C_C.nCols());
 }
 
 std::vector<matrix> ColumnBundleTransform::transformVdagC(const std::vector<matrix>& VdagC_C, int iSym) const
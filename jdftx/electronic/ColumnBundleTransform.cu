@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+
+#include <electronic/ColumnBundleTransform_internal.h>
+#include <core/GpuKernelUtils.h>
+
+template<bool scatter> __global__
+void transformAxpy_kernel(int nIndex, int nCols, complex a, const int* index, const complex* phase, bool conjx, bool conjPhase,
+	const complex* x, int xStride, complex* y, int yStride)
+{	int j = kernelIndex1D();
+	if(j < nIndex*nCols) transformAxpy_calc<scatter>(j%nIndex, j/nIndex, a, index, phase, conjx, conjPhase, x, xStride, y, yStride);
+}
+void transformAxpy_gpu(bool scatter, int nIndex, int nCols, complex a, const int* index, const complex* phase, bool conjx, bool conjPhase,
+	const complex* x, int xStride, complex* y, int yStride)
+{	if(scatter)
+	{	GpuLaunchConfig1D glc(transformAxpy_kernel<true>, nIndex*nCols);
+		transformAxpy_kernel<true><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nIndex, nCols, a, index, phase, conjx, conjPhase, x, xStride, y, yStride);
+	}
+	else
+	{	GpuLaunchConfig1D glc(transformAxpy_kernel<false>, nIndex*nCols);
+		transformAxpy_kernel<false><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nIndex, nCols, a, index, phase, conjx, conjPhase, x, xStride, y, yStride);
+	}
+	gpuErrorCheck();
+}
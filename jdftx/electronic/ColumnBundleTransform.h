@@ -22,6 +22,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <electronic/Basis.h>
 #include <core/matrix.h>
+#include <memory>
 
 class ColumnBundle;
 
@@ -50,10 +51,13 @@ public:
 	Optionally, super specifies a transform to a supercell (D corresponds to a supercell of C);
 	columnbundles will however not be automatically re-normalized for the supercell
 	Note that the transformation is kD = kC * sym * invert * super + offset (where offset is determined automatically).
-	If the ColumnBundles are spinorial (nSpinor=2), corresponding spin-space transformations will also be applied
+	If the ColumnBundles are spinorial (nSpinor=2), corresponding spin-space transformations will also be applied.
+	Optionally, indexSource is an existing transform between the same bases with the same net rotation sym * invert * super
+	(eg. from a symmetry operation differing only in translation), whose index map is then shared instead of recomputed.
 	*/
 	ColumnBundleTransform(const vector3<>& kC, const Basis& basisC, const vector3<>& kD, const BasisWrapper& basisDwrapper,
-		int nSpinor, const SpaceGroupOp& sym, int invert, const matrix3<int>& super = matrix3<int>(1,1,1));
+		int nSpinor, const SpaceGroupOp& sym, int invert, const matrix3<int>& super = matrix3<int>(1,1,1),
+		const ColumnBundleTransform* indexSource = 0);
 	
 	//Non-copyable:
 	ColumnBundleTransform(const ColumnBundleTransform&)=delete;
@@ -62,8 +66,10 @@ public:
 	void scatterAxpy(complex alpha, const ColumnBundle& C_C, int bC, ColumnBundle& C_D, int bD) const; //!< scatter-accumulate a single column
 	void gatherAxpy(complex alpha, const ColumnBundle& C_D, int bD, ColumnBundle& C_C, int bC) const; //!< gather-accumulate a single column
 	
-	void scatterAxpy(complex alpha, const ColumnBundle& C_C, ColumnBundle& C_D, int bDstart, int bDstep) const; //!< scatter-accumulate all columns of C_C
-	void gatherAxpy(complex alpha, const ColumnBundle& C_D, int bDstart, int bDstep, ColumnBundle& C_C) const; //!< gather-accumulate all columns of C_C
+	void scatterAxpy(complex alpha, const ColumnBundle& C_C, ColumnBundle& C_D, int bDstart, int bDstep) const; //!< scatter-accumulate all columns of C_C (in one batched pass)
+	void gatherAxpy(complex alpha, const ColumnBundle& C_D, int bDstart, int bDstep, ColumnBundle& C_C) const; //!< gather-accumulate all columns of C_C (in one batched pass)
+	
+	const matrix3<int>& affineRotation() const { return affine; } //!< net rotation sym * invert * super of the k-point transformation
 
 	//! Transform psp projection VdagC_C to VdagC_D.
 	//! Need iSym for spherical and atom transformations.
@@ -77,11 +83,21 @@ private:
 	const vector3<> kC, kD;
 	const SpaceGroupOp& sym;
 	
+	matrix3<int> affine; //net rotation sym * invert * super
+	
 	//Index array:
-	IndexArray index;
+	std::shared_ptr<IndexArray> index; //(shareable between transforms differing only in translation)
 	ManagedArray<complex> phase; //Bloch phase for space-group translation
 
 	matrix spinorRot; //spinor space rotation
+	
+	//Non-zero spinor rotation terms, packed separately for scattering and gathering:
+	struct SpinorTerm { int sC, sD; complex coeff; };
+	std::vector<SpinorTerm> scatterTerms, gatherTerms;
+	
+	//Batched accumulation of nCols columns from columns bC + j of C_C to bD + j*bDstep of C_D (or the reverse for gather):
+	void scatterAxpy(complex alpha, const ColumnBundle& C_C, int bC, ColumnBundle& C_D, int bD, int bDstep, int nCols) const;
+	void gatherAxpy(complex alpha, const ColumnBundle& C_D, int bD, int bDstep, ColumnBundle& C_C, int bC, int nCols) const;
 	friend class WannierMinimizer;
 };
 
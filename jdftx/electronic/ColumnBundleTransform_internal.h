@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+
+#ifndef JDFTX_ELECTRONIC_COLUMNBUNDLETRANSFORM_INTERNAL_H
+#define JDFTX_ELECTRONIC_COLUMNBUNDLETRANSFORM_INTERNAL_H
+
+//! @addtogroup Operators
+//! @{
+//!@file ColumnBundleTransform_internal.h Shared GPU/CPU code for batched ColumnBundle transformations
+
+#include <core/scalar.h>
+
+//! Accumulate element i of column b: y[b][index[i]] += a x[b][i] (scatter) or y[b][i] += a x[b][index[i]] (gather),
+//! with x optionally conjugated and multiplied by (optionally conjugated) phase[i].
+template<bool scatter> __hostanddev__
+void transformAxpy_calc(int i, int b, complex a, const int* index, const complex* phase, bool conjx, bool conjPhase,
+	const complex* x, int xStride, complex* y, int yStride)
+{	int ix = scatter ? i : index[i];
+	int iy = scatter ? index[i] : i;
+	complex xi = x[b*xStride + ix];
+	if(conjx) xi = xi.conj();
+	if(phase) xi *= (conjPhase ? phase[i].conj() : phase[i]);
+	y[b*yStride + iy] += a * xi;
+}
+
+//! Apply transformAxpy_calc to all nIndex elements of nCols columns (with column strides xStride and yStride)
+void transformAxpy(bool scatter, int nIndex, int nCols, complex a, const int* index, const complex* phase, bool conjx, bool conjPhase,
+	const complex* x, int xStride, complex* y, int yStride);
+#ifdef GPU_ENABLED
+void transformAxpy_gpu(bool scatter, int nIndex, int nCols, complex a, const int* index, const complex* phase, bool conjx, bool conjPhase,
+	const complex* x, int xStride, complex* y, int yStride);
+#endif
+
+//! @}
+#endif // JDFTX_ELECTRONIC_COLUMNBUNDLETRANSFORM_INTERNAL_H
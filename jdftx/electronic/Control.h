@@ -32,25 +32,36 @@ enum BasisKdep { BasisKpointDep, BasisKpointIndep } ;
 static EnumStringMap<BasisKdep> kdepMap(BasisKpointDep, "kpoint-dependent", BasisKpointIndep, "single" );
 
 //! Electronic eigenvalue method
-enum ElecEigenAlgo { ElecEigenCG, ElecEigenDavidson };
+enum ParallelLayoutMode { ParallelLayoutNone, ParallelLayoutSuggest, ParallelLayoutAuto }; //!< startup tuning of processes / threads per node (see tuneParallelLayout)
+
+enum ElecEigenAlgo { ElecEigenCG, ElecEigenDavidson, ElecEigenPPCG, ElecEigenChebyshev, ElecEigenRMMDIIS }; //RMM-DIIS is only switched on by SCF (see SCFparams::rmmDiisThreshold)
 
 //! Miscellaneous flags controlling electronic DFT
 class Control
 {
 public:
 	bool fixed_H; //!< fixed Hamiltonian (band structure) mode for electronic sector
-	bool cacheProjectors; //!< whether to cache nonlocal projectors
+	bool cacheProjectors; //!< whether to cache nonlocal projectors (see IonInfo::projectorCache for the memory budget)
+	bool projectorsOnTheFly; //!< whether to build projectors in blocks fused with projections, when they are not cached
+	double realSpaceProjectorTol; //!< if non-zero, apply nonlocal projectors in real space, truncated where they fall below this fraction of their maximum
 	double davidsonBandRatio; //!< ratio of number of Davidson working bands to actual bands in system (>= 1)
 	
 	ElecEigenAlgo elecEigenAlgo; //!< Eigenvalue algorithm
 	BasisKdep basisKdep; //!< k-dependence of basis
 	double Ecut, EcutRho; //!< energy cutoff for electrons and charge density grid (EcutRho=0 => EcutRho = 4 Ecut)
+	double EcutInitial; //!< if non-zero, first converge fresh wavefunctions with this reduced cutoff (see command elec-initial-cutoff)
+	double EcutInitialThreshold; //!< energy-difference threshold of the reduced-cutoff stage
 	
 	bool dragWavefunctions; //!< whether to drag wavefunctions using atomic orbital projections on ionic steps
+	int dragHistory; //!< number of previous ionic steps (0, or 2 to 3) whose converged wavefunctions are extrapolated on ionic minimization steps
 	vector3<> lattMoveScale; //!< preconditioning factor for each lattice vector during lattice minimization
+	int lattStressOrder; //!< order of accuracy (2 or 4) of the central-difference stencil for the stress tensor
+	double lattStressStep; //!< strain step size of the central-difference stencil for the stress tensor
 	
 	int fluidGummel_nIterations; //!< max iterations of the fluid<->electron self-consistency loop
 	double fluidGummel_Atol; //!< stopping free-energy tolerance for the fluid<->electron self-consistency loop
+	double fluidGummel_tolFactor; //!< inner minimization thresholds as a fraction of the previous free-energy change of the self-consistency loop
+	double fluidGummel_AtolInner; //!< free-energy change of the self-consistency loop below which to switch to solving the fluid every electronic step (0 = never)
 
 	bool shouldPrintEigsFillings; //!< whether eigenvalues and fillings should be printed at each iteration
 	bool shouldPrintEcomponents; //!< whether energy components should be printed at each iteration
@@ -62,15 +73,20 @@ public:
 	
 	bool scf; //!< whether SCF iteration or total energy minimizer will be called
 	bool convergeEmptyStates; //!< whether to converge empty states after every electronic minimization
+	bool streamBands; //!< whether band-structure calculations solve one state at a time without storing wavefunctions of all states
 	bool dumpOnly; //!< run a single-electronic-point energy evaluation and process the end dump
+	double mixedPrecisionThreshold; //!< if non-zero, perform wavefunction transforms in single precision until the energy change per iteration drops below this
+	string serverInput, serverOutput; //!< if non-empty, serve energy and force requests read from serverInput (see IonicMinimizer::serve)
+	std::vector<string> batchInputs; //!< if non-empty, run each of these input files as an independent calculation in this process (see command batch)
+	ParallelLayoutMode parallelLayout; //!< whether to benchmark and report (or also set) the division of nodes between processes and threads
 	
 	Control()
 	:	fixed_H(false),
-		cacheProjectors(true), davidsonBandRatio(1.1),
-		elecEigenAlgo(ElecEigenDavidson), basisKdep(BasisKpointDep), Ecut(0), EcutRho(0), dragWavefunctions(true),
-		fluidGummel_nIterations(10), fluidGummel_Atol(1e-5),
+		cacheProjectors(true), projectorsOnTheFly(false), realSpaceProjectorTol(0.), davidsonBandRatio(1.1),
+		elecEigenAlgo(ElecEigenDavidson), basisKdep(BasisKpointDep), Ecut(0), EcutRho(0), EcutInitial(0.), EcutInitialThreshold(1e-4), dragWavefunctions(true), dragHistory(0), lattStressOrder(4), lattStressStep(1e-5),
+		fluidGummel_nIterations(10), fluidGummel_Atol(1e-5), fluidGummel_tolFactor(0.01), fluidGummel_AtolInner(0.),
 		shouldPrintEigsFillings(false), shouldPrintEcomponents(false), shouldPrintMuSearch(false), shouldPrintKpointsBasis(false),
-		subspaceRotationFactor(1.), subspaceRotationAdjust(true), scf(false), convergeEmptyStates(false), dumpOnly(false)
+		subspaceRotationFactor(1.), subspaceRotationAdjust(true), scf(false), convergeEmptyStates(false), streamBands(false), dumpOnly(false), mixedPrecisionThreshold(0.), parallelLayout(ParallelLayoutNone)
 	{
 	}
 };
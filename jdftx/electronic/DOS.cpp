@@ -30,6 +30,24 @@ DOS::DOS() : Etol(1e-6), Esigma(0)
 {
 }
 
+//Set the orbital-projected weights for bands [bandStart,bandStop) of state iState from the overlaps CdagOpsi(Ortho)
+//(nBands x nOrbitals, on the CPU) of those bands with all atomic orbitals, summing over the orbital columns weightCols of each weight
+void accumOrbitalWeights(int bandStart, int bandStop, const std::vector<DOS::Weight>* weights, const std::vector<std::vector<int>>* weightCols,
+	const complex* proj, const complex* projOrtho, int nBands, TetrahedralDOS* eval, int iState)
+{	for(unsigned iWeight=0; iWeight<weights->size(); iWeight++)
+	{	const DOS::Weight& weight = weights->at(iWeight);
+		if(weight.type == DOS::Weight::Orbital || weight.type == DOS::Weight::OrthoOrbital)
+		{	const complex* projRel = weight.type==DOS::Weight::Orbital ? proj : projOrtho;
+			for(int iBand=bandStart; iBand<bandStop; iBand++)
+			{	double w = 0.; //replaces the default of 1 in eval
+				for(int iCol: weightCols->at(iWeight))
+					w += projRel[iBand + nBands*iCol].norm();
+				eval->w(iWeight, iState, iBand) = w;
+			}
+		}
+	}
+}
+
 void DOS::setup(const Everything& everything)
 {	e = &everything;
 	if(!weights.size()) //Add the default of Total Complete DOS:
@@ -383,87 +401,80 @@ void DOS::dump()
 	
 	//Compute projections for orbital mode:
 	if(needOrbitals || needOrthoOrbitals)
-	{	for(int iState=eInfo.qStart; iState<eInfo.qStop; iState++)
-		{	const ColumnBundle& C = e->eVars.C[iState];
-			//Count atomic orbitals:
-			int nOrbitals = 0;
-			std::vector<int> spOffset(e->iInfo.species.size()); //species offset into atomic orbitals list
-			for(unsigned sp=0; sp<e->iInfo.species.size(); sp++)
-			{	spOffset[sp] = nOrbitals;
-				nOrbitals += e->iInfo.species[sp]->nAtomicOrbitals();
-			}
-			//Atomic-orbital projections if needed:
-			matrix CdagOpsi;
-			if(needOrbitals)
-				CdagOpsi = C ^ e->iInfo.getAtomicOrbitals(iState, true); //directly calculate overlap using Opsi
-			//Ortho-orbital projections if needed:
-			matrix CdagOpsiOrtho;
-			if(needOrthoOrbitals)
-			{	ColumnBundle psi = e->iInfo.getAtomicOrbitals(iState, false);
-				//Orthogonalize:
-				ColumnBundle Opsi = O(psi);
-				matrix orthoMat = invsqrt(psi ^ Opsi); //orthonormalizing matrix
-				CdagOpsiOrtho = (C ^ Opsi) * orthoMat;
-			}
-			for(unsigned iWeight=0; iWeight<weights.size(); iWeight++)
-			{	const Weight& weight = weights[iWeight];
-				if(weight.type == Weight::Orbital || weight.type == Weight::OrthoOrbital)
-				{	const Weight::OrbitalDesc& oDesc = weight.orbitalDesc;
-					const matrix& CdagOpsiRel = weight.type==Weight::Orbital ? CdagOpsi : CdagOpsiOrtho;
-					int l = oDesc.l;
-					//Check relativistic psp compatibility:
-					if(e->iInfo.species[weight.specieIndex]->isRelativistic() && oDesc.l)
-					{	if(!(oDesc.spinType==SpinOrbit || (oDesc.spinType==SpinNone && oDesc.m==l+1)))
-							die("Individual orbital projections for l>0 in relativsitic pseudopotentials must use the j,mj specification (eg. 'p+(+1/2)').\n");
-					}
-					else
-					{	if(oDesc.spinType==SpinOrbit)
-							die("Only l>0 projections in relativistic pseudopotentials may use the j,mj specification.\n");
+	{	//Count atomic orbitals:
+		int nOrbitals = 0;
+		std::vector<int> spOffset(e->iInfo.species.size()); //species offset into atomic orbitals list
+		for(unsigned sp=0; sp<e->iInfo.species.size(); sp++)
+		{	spOffset[sp] = nOrbitals;
+			nOrbitals += e->iInfo.species[sp]->nAtomicOrbitals();
+		}
+		//Determine the atomic-orbital columns contributing to each orbital weight (same for all states):
+		std::vector<std::vector<int>> weightCols(weights.size());
+		for(unsigned iWeight=0; iWeight<weights.size(); iWeight++)
+		{	const Weight& weight = weights[iWeight];
+			if(weight.type == Weight::Orbital || weight.type == Weight::OrthoOrbital)
+			{	const Weight::OrbitalDesc& oDesc = weight.orbitalDesc;
+				int l = oDesc.l;
+				//Check relativistic psp compatibility:
+				if(e->iInfo.species[weight.specieIndex]->isRelativistic() && oDesc.l)
+				{	if(!(oDesc.spinType==SpinOrbit || (oDesc.spinType==SpinNone && oDesc.m==l+1)))
+						die("Individual orbital projections for l>0 in relativsitic pseudopotentials must use the j,mj specification (eg. 'p+(+1/2)').\n");
+				}
+				else
+				{	if(oDesc.spinType==SpinOrbit)
+						die("Only l>0 projections in relativistic pseudopotentials may use the j,mj specification.\n");
+				}
+				int sStart, sStop;
+				if(oDesc.spinType==SpinNone)
+				{	sStart=0;
+					sStop=eInfo.spinorLength();
+				}
+				else
+				{	sStart=oDesc.s;
+					sStop=oDesc.s+1;
+				}
+				for(int s=sStart; s<sStop; s++)
+				{	std::vector<int> mArr; //set of m to include
+					if(oDesc.m==l+1) //all orbitals
+					{	int mMin = -l;
+						int mMax = +l;
+						if(e->iInfo.species[weight.specieIndex]->isRelativistic())
+							mMin -= (s ? -1 : +1);
+						for(int m=mMin; m<=mMax; m++)
+							mArr.push_back(m);
 					}
-					//Initialize to zero (eval has 1 by default):
-					for(int iBand=0; iBand<eInfo.nBands; iBand++)
-						eval.w(iWeight, iState, iBand) = 0.;
-					//Accumulate weights:
-					int sStart, sStop;
-					if(oDesc.spinType==SpinNone)
-					{	sStart=0;
-						sStop=eInfo.spinorLength();
+					else if(l==2 && oDesc.m==l+2) //t2g set of d orbitals
+					{	mArr.push_back(-2); //dxy
+						mArr.push_back(-1); //dyz
+						mArr.push_back(+1); //dxz
 					}
-					else
-					{	sStart=oDesc.s;
-						sStop=oDesc.s+1;
+					else if(l==2 && oDesc.m==l+3) //eg set of d orbitals
+					{	mArr.push_back(0); //dz2
+						mArr.push_back(2); //dx2-y2
 					}
-					for(int s=sStart; s<sStop; s++)
-					{	std::vector<int> mArr; //set of m to include
-						if(oDesc.m==l+1) //all orbitals
-						{	int mMin = -l;
-							int mMax = +l;
-							if(e->iInfo.species[weight.specieIndex]->isRelativistic())
-								mMin -= (s ? -1 : +1);
-							for(int m=mMin; m<=mMax; m++)
-								mArr.push_back(m);
-						}
-						else if(l==2 && oDesc.m==l+2) //t2g set of d orbitals
-						{	mArr.push_back(-2); //dxy
-							mArr.push_back(-1); //dyz
-							mArr.push_back(+1); //dxz
-						}
-						else if(l==2 && oDesc.m==l+3) //eg set of d orbitals
-						{	mArr.push_back(0); //dz2
-							mArr.push_back(2); //dx2-y2
-						}
-						else //single orbital mode
-						{	mArr.push_back(oDesc.m);
-						}
-						for(int m: mArr)
-						{	int iCol = spOffset[weight.specieIndex] + e->iInfo.species[weight.specieIndex]->atomicOrbitalOffset(weight.atomIndex, oDesc.n, l, m, s);
-							for(int iBand=0; iBand<eInfo.nBands; iBand++)
-								eval.w(iWeight, iState, iBand) += (CdagOpsiRel.data()[CdagOpsiRel.index(iBand, iCol)]).norm();
-						}
+					else //single orbital mode
+					{	mArr.push_back(oDesc.m);
 					}
+					for(int m: mArr)
+						weightCols[iWeight].push_back(spOffset[weight.specieIndex] + e->iInfo.species[weight.specieIndex]->atomicOrbitalOffset(weight.atomIndex, oDesc.n, l, m, s));
 				}
 			}
 		}
+		for(int iState=eInfo.qStart; iState<eInfo.qStop; iState++)
+		{	const ColumnBundle& C = e->eVars.C[iState];
+			//Atomic-orbital projections of all bands, computed once and shared by all orbital weights:
+			ColumnBundle psi = e->iInfo.getAtomicOrbitals(iState, false);
+			ColumnBundle Opsi = O(psi);
+			matrix CdagOpsi = C ^ Opsi;
+			//Ortho-orbital projections if needed:
+			matrix CdagOpsiOrtho;
+			if(needOrthoOrbitals)
+				CdagOpsiOrtho = CdagOpsi * invsqrt(psi ^ Opsi); //orthonormalizing matrix applied to the same overlaps
+			psi.free(); Opsi.free();
+			//Accumulate weights (threaded over bands):
+			threadLaunch(accumOrbitalWeights, eInfo.nBands, &weights, &weightCols,
+				CdagOpsi.data(), needOrthoOrbitals ? CdagOpsiOrtho.data() : (const complex*)0, eInfo.nBands, &eval, iState);
+		}
 	}
 	
 	//Read override eigenvalues if any:
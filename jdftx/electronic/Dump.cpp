@@ -32,8 +32,11 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarFieldIO.h>
 #include <ctime>
 
+extern EnumStringMap<DumpVariable> varMap; //dump variable names (defined in commands/dump.cpp)
+
 Dump::Dump()
-: potentialSubtraction(true), curIter(0), Munfold(1,1,1)
+: potentialSubtraction(true), Munfold(1,1,1), wfnsIndexedAlign(0), checkpointInterval(0.),
+	excitationsWindow(-DBL_MAX, DBL_MAX), excitationsBinary(false), hdf5Compression(-1), curIter(0)
 {
 }
 
@@ -61,6 +64,32 @@ void Dump::setup(const Everything& everything)
 			}
 			default:; //No action necessary (needed only to suppress compiler warnings)
 		}
+	
+	//Drop outputs that need wavefunctions of all states, which are not stored in band streaming mode:
+	if(e->cntrl.fixed_H && e->cntrl.streamBands)
+	{	bool dosNeedsWfns = false;
+		if(dos)
+			for(const DOS::Weight& weight: dos->weights)
+				if(weight.type != DOS::Weight::Total)
+					dosNeedsWfns = true;
+		for(auto iter=begin(); iter!=end();)
+		{	bool needsWfns = false;
+			switch(iter->second)
+			{	case DumpKEdensity: case DumpBandUnfold: case DumpQMC: case DumpOcean: case DumpBGW:
+				case DumpRealSpaceWfns: case DumpPolarizability: case DumpElectronScattering: case DumpSIC:
+				case DumpExcitations: case DumpSpin: case DumpMomenta: case DumpOrbitalDep:
+				case DumpEresolvedDensity: case DumpFermiDensity:
+					needsWfns = true; break;
+				case DumpDOS: needsWfns = dosNeedsWfns; break;
+				default:;
+			}
+			if(needsWfns)
+			{	logPrintf("WARNING: band streaming mode does not store wavefunctions; dropping dump of %s.\n", varMap.getString(iter->second));
+				iter = erase(iter);
+			}
+			else iter++;
+		}
+	}
 }
 
 
@@ -76,6 +105,8 @@ void Dump::operator()(DumpFrequency freq, int iter)
 			break;
 		}
 	if(!foundVars) return;
+	string phasePrev = ManagedMemoryBase::getPhase(); ManagedMemoryBase::setPhase("dump"); //for memory telemetry
+	checkpointWait(); //so that an older background checkpoint does not replace the files written below
 	logPrintf("\n");
 	
 	const ElecInfo &eInfo = e->eInfo;
@@ -96,27 +127,24 @@ void Dump::operator()(DumpFrequency freq, int iter)
 	#define EndDump \
 		logPrintf("done\n"); logFlush();
 
-	#define DUMP_nocheck(object, prefix) \
-		{	StartDump(prefix) \
-			if(mpiWorld->isHead()) saveRawBinary(object, fname.c_str()); \
-			EndDump \
-		}
+	#define DUMP_nocheck(object, prefix, varname) \
+		writeField(object, prefix, Dump##varname);
 	
-	#define DUMP_spinCollection(object, prefix) \
-		{	if(object.size()==1) DUMP_nocheck(object[0], prefix) \
+	#define DUMP_spinCollection(object, prefix, varname) \
+		{	if(object.size()==1) DUMP_nocheck(object[0], prefix, varname) \
 			else if(object.size()!=0) \
-			{	DUMP_nocheck(object[0], (prefix+string("_up")).c_str()) \
-				DUMP_nocheck(object[1], (prefix+string("_dn")).c_str()) \
+			{	DUMP_nocheck(object[0], (prefix+string("_up")).c_str(), varname) \
+				DUMP_nocheck(object[1], (prefix+string("_dn")).c_str(), varname) \
 				if(object.size()==4) \
-				{	DUMP_nocheck(object[2], (prefix+string("_re")).c_str()) \
-					DUMP_nocheck(object[3], (prefix+string("_im")).c_str()) \
+				{	DUMP_nocheck(object[2], (prefix+string("_re")).c_str(), varname) \
+					DUMP_nocheck(object[3], (prefix+string("_im")).c_str(), varname) \
 				} \
 			} \
 		}
 
 	#define DUMP(object, prefix, varname) \
 		if(ShouldDump(varname) && object) \
-		{	DUMP_nocheck(object, prefix) \
+		{	DUMP_nocheck(object, prefix, varname) \
 		}
 	
 	// Set up date/time stamp
@@ -126,6 +154,7 @@ void Dump::operator()(DumpFrequency freq, int iter)
 	stampStream << (mytm->tm_mon+1) << '.' << mytm->tm_mday << '.'
 		<< mytm->tm_hour << '-' << mytm->tm_min << '-' << mytm->tm_sec;
 	stamp = stampStream.str();
+	h5open(); //single HDF5 file for scalar fields of this dump (if enabled)
 	
 	if((ShouldDump(State) and eInfo.fillingsUpdate==ElecInfo::FillingsHsub) or ShouldDump(Fillings))
 	{	//Dump fillings
@@ -139,10 +168,12 @@ void Dump::operator()(DumpFrequency freq, int iter)
 	
 	if(ShouldDump(State))
 	{
-		//Dump wave functions
-		StartDump("wfns")
-		eInfo.write(eVars.C, fname.c_str());
-		EndDump
+		//Dump wave functions (unless discarded in band streaming mode)
+		if(!(e->cntrl.fixed_H && e->cntrl.streamBands))
+		{	StartDump("wfns")
+			eInfo.write(eVars.C, fname.c_str(), wfnsIndexedAlign);
+			EndDump
+		}
 		
 		if(hasFluid)
 		{	//Dump state of fluid:
@@ -189,14 +220,14 @@ void Dump::operator()(DumpFrequency freq, int iter)
 	DUMP(I(iInfo.rhoIon), "Nion", IonicDensity)
 	
 	if(ShouldDump(ElecDensity))
-		DUMP_spinCollection(eVars.n, "n")
+		DUMP_spinCollection(eVars.n, "n", ElecDensity)
 	if(ShouldDump(ElecDensityAccum))
-		DUMP_spinCollection(eVars.nAccumulated, "nAccum")
+		DUMP_spinCollection(eVars.nAccumulated, "nAccum", ElecDensityAccum)
 	if(iInfo.nCore) DUMP(iInfo.nCore, "nCore", CoreDensity)
 	
 	if((ShouldDump(KEdensity) or (e->exCorr.needsKEdensity() and ShouldDump(ElecDensity))))
 	{	const auto& tau = (e->exCorr.needsKEdensity() ? e->eVars.tau : e->eVars.KEdensity());
-		 DUMP_spinCollection(tau, "tau")
+		 DUMP_spinCollection(tau, "tau", KEdensity)
 	}
 
 	//Electrostatic and fluid potentials:
@@ -249,9 +280,9 @@ void Dump::operator()(DumpFrequency freq, int iter)
 
 	DUMP(I(iInfo.Vlocps), "Vlocps", Vlocps)
 	if(ShouldDump(Vscloc))
-		DUMP_spinCollection(eVars.Vscloc, "Vscloc")
+		DUMP_spinCollection(eVars.Vscloc, "Vscloc", Vscloc)
 	if(ShouldDump(Vscloc) and e->exCorr.needsKEdensity())
-		DUMP_spinCollection(eVars.Vtau, "Vtau")
+		DUMP_spinCollection(eVars.Vtau, "Vtau", Vscloc)
 	
 	if(ShouldDump(BandEigs) ||
 		(ShouldDump(State) &&
@@ -365,7 +396,7 @@ void Dump::operator()(DumpFrequency freq, int iter)
 		nboundTilde->setGzero(-rhoTot_Gzero); //total bound charge will neutralize system
 		if(ShouldDump(SolvationRadii))
 		{	StartDump("Rsol")
-			if(mpiWorld->isHead()) dumpRsol(I(nboundTilde), fname);
+			dumpRsol(I(nboundTilde), fname);
 			EndDump
 		}
 		DUMP(I(nboundTilde), "nbound", BoundCharge)
@@ -475,26 +506,18 @@ void Dump::operator()(DumpFrequency freq, int iter)
 		std::vector<matrix> momenta(eInfo.nStates);
 		for(int q=eInfo.qStart; q<eInfo.qStop; q++) //kpoint/spin
 		{	momenta[q] = zeroes(eInfo.nBands, eInfo.nBands*3);
+			vector3<matrix> rHq = iInfo.rHcommutator(eVars.C[q], eVars.Hsub_eigs[q]); //all directions together
 			for(int k=0; k<3; k++) //cartesian direction
-				momenta[q].set(0,eInfo.nBands, eInfo.nBands*k,eInfo.nBands*(k+1),
-					complex(0,-1) * iInfo.rHcommutator(eVars.C[q], k, eVars.Hsub_eigs[q]) );
+				momenta[q].set(0,eInfo.nBands, eInfo.nBands*k,eInfo.nBands*(k+1), complex(0,-1) * rHq[k]);
 		}
 		eInfo.write(momenta, fname.c_str(), eInfo.nBands, eInfo.nBands*3);
 		EndDump
 	}
 	
-	if(ShouldDump(RealSpaceWfns))
-	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-		{	int nSpinor = eVars.C[q].spinorLength();
-			for(int b=0; b<eInfo.nBands; b++) for(int s=0; s<nSpinor; s++)
-			{	ostringstream prefixStream;
-				prefixStream << "wfns_" << q << '_' << (b*nSpinor+s) << ".rs";
-				StartDump(prefixStream.str())
-				saveRawBinary(I(eVars.C[q].getColumn(b,s)), fname.c_str());
-				EndDump
-			}
-		}
-	}
+	if(ShouldDump(RealSpaceWfns) && h5)
+		h5writeRealSpaceWfns();
+	else if(ShouldDump(RealSpaceWfns))
+		dumpRealSpaceWfns();
 
 	if(ShouldDump(ExcCompare))
 	{	StartDump("ExcCompare") logPrintf("\n");
@@ -566,49 +589,57 @@ void Dump::operator()(DumpFrequency freq, int iter)
 	}
 	
 	if(ShouldDump(XCanalysis))
-	{	ScalarFieldArray tauW = XC_Analysis::tauWeizsacker(*e); DUMP_spinCollection(tauW, "tauW");
-		ScalarFieldArray spness = XC_Analysis::spness(*e); DUMP_spinCollection(spness, "spness");
-		ScalarFieldArray sVh = XC_Analysis::sHartree(*e); DUMP_spinCollection(sVh, "sHartree");
+	{	ScalarFieldArray tauW = XC_Analysis::tauWeizsacker(*e); DUMP_spinCollection(tauW, "tauW", XCanalysis);
+		ScalarFieldArray spness = XC_Analysis::spness(*e); DUMP_spinCollection(spness, "spness", XCanalysis);
+		ScalarFieldArray sVh = XC_Analysis::sHartree(*e); DUMP_spinCollection(sVh, "sHartree", XCanalysis);
 	}
 
-	if(ShouldDump(EresolvedDensity))
-	{	std::vector<diagMatrix>& F = ((ElecVars&)e->eVars).F;
-		std::vector<diagMatrix> Forig = F; //backup fillings
-		int iRange=0;
-		for(const auto& Erange: densityErange)
-		{	//Set fillings based on current energy range:
-			for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-				for(int b=0; b<eInfo.nBands; b++)
-				{	double e_qb = eVars.Hsub_eigs[q][b];
-					F[q][b] = (e_qb >= Erange.first && e_qb <= Erange.second) ? 1. : 0.;
+	if(ShouldDump(EresolvedDensity) || ShouldDump(FermiDensity))
+	{	//Fillings for all energy windows and Fermi levels, whose densities are computed in one sweep over bands:
+		std::vector<std::vector<diagMatrix>> Fsets;
+		if(ShouldDump(EresolvedDensity))
+			for(const auto& Erange: densityErange)
+			{	std::vector<diagMatrix> F(eInfo.nStates);
+				for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+				{	F[q].resize(eInfo.nBands);
+					for(int b=0; b<eInfo.nBands; b++)
+					{	double e_qb = eVars.Hsub_eigs[q][b];
+						F[q][b] = (e_qb >= Erange.first && e_qb <= Erange.second) ? 1. : 0.;
+					}
+				}
+				Fsets.push_back(F);
+			}
+		if(ShouldDump(FermiDensity))
+			for(const auto& muLevel: fermiDensityLevels)
+			{	//Set fillings based on derivative of smearing function evaluated at muLevel
+				double muF, Bz;
+				//calculate mu if not set
+				muF = ( !std::isnan(muLevel) ? muLevel : eInfo.findMu(eVars.Hsub_eigs,eInfo.nElectrons,Bz) );
+				std::vector<diagMatrix> F(eInfo.nStates);
+				for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+				{	F[q].resize(eInfo.nBands);
+					for(int b=0; b<eInfo.nBands; b++)
+						F[q][b] = -eInfo.smearPrime(muF,eVars.Hsub_eigs[q][b]);
 				}
-			//Calculate and dump density:
-			ScalarFieldArray density = eVars.calcDensity();
-			ostringstream oss; oss << "EresolvedDensity." << iRange; iRange++;
-			DUMP_spinCollection(density, oss.str())
-		}
-		F = Forig; //restore fillings
-	}
-	
-	if(ShouldDump(FermiDensity)) 
-	{	std::vector<diagMatrix>& F = ((ElecVars&)e->eVars).F;
-		std::vector<diagMatrix> Forig = F; //backup fillings
-		int iRange=0;
-		for(const auto& muLevel: fermiDensityLevels)
-		{	//Set fillings based on derivative of smearing function evaluated at muLevel
-			double muF, Bz;
-			//calculate mu if not set
-			muF = ( !std::isnan(muLevel) ? muLevel : eInfo.findMu(eVars.Hsub_eigs,eInfo.nElectrons,Bz) );
-			for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-				for(int b=0; b<eInfo.nBands; b++)
-					F[q][b] = -eInfo.smearPrime(muF,eVars.Hsub_eigs[q][b]);
-			//Calculate and dump density
-			ScalarFieldArray density = eVars.calcDensity();
-			ostringstream oss; oss << "FermiDensity." << iRange; iRange++;
-			DUMP_spinCollection(density, oss.str())
-		}
-		F = Forig; //restore fillings
+				Fsets.push_back(F);
+			}
+		//Calculate and dump densities:
+		std::vector<ScalarFieldArray> densities = eVars.calcDensities(Fsets);
+		int iSet = 0;
+		if(ShouldDump(EresolvedDensity))
+			for(int iRange=0; iRange<int(densityErange.size()); iRange++)
+			{	const ScalarFieldArray& density = densities[iSet++];
+				ostringstream oss; oss << "EresolvedDensity." << iRange;
+				DUMP_spinCollection(density, oss.str(), EresolvedDensity)
+			}
+		if(ShouldDump(FermiDensity))
+			for(int iRange=0; iRange<int(fermiDensityLevels.size()); iRange++)
+			{	const ScalarFieldArray& density = densities[iSet++];
+				ostringstream oss; oss << "FermiDensity." << iRange;
+				DUMP_spinCollection(density, oss.str(), FermiDensity)
+			}
 	}
+	h5close();
 	
 	//----------------------------------------------------------------------
 	//The following compute-intensive things are free to clear wavefunctions
@@ -621,6 +652,7 @@ void Dump::operator()(DumpFrequency freq, int iter)
 	if(freq==DumpFreq_End && ShouldDump(ElectronScattering))
 	{	electronScattering->dump(*e);
 	}
+	ManagedMemoryBase::setPhase(phasePrev);
 }
 
 bool Dump::checkInterval(DumpFrequency freq, int iter) const
@@ -630,6 +662,99 @@ bool Dump::checkInterval(DumpFrequency freq, int iter) const
 		|| ((iter+1) % intervalFreq->second == 0)); //or iteration number is divisible by it
 }
 
+void Dump::writeField(const ScalarField& X, string prefix, DumpVariable var)
+{	FieldFormat ff;
+	auto iter = fieldFormat.find(var);
+	if(iter != fieldFormat.end()) ff = iter->second;
+	//Resample to coarser grid if needed:
+	ScalarField Xout = X;
+	if(ff.downsample > 1)
+	{	std::shared_ptr<GridInfo>& gInfoOut = downsampledGrids[ff.downsample];
+		if(!gInfoOut || gInfoOut->R != X->gInfo.R) //create grid (or recreate after a lattice change)
+		{	gInfoOut = std::make_shared<GridInfo>();
+			gInfoOut->R = X->gInfo.R;
+			for(int k=0; k<3; k++)
+			{	int Sk = 2*int(ceil(0.5*X->gInfo.S[k]/ff.downsample));
+				while(!fftSuitable(Sk)) Sk += 2; //pick the next even number suitable for FFT
+				gInfoOut->S[k] = std::min(Sk, X->gInfo.S[k]);
+			}
+			gInfoOut->initialize(true);
+		}
+		Xout = changeGrid(X, *gInfoOut);
+	}
+	//Write:
+	if(h5)
+	{	h5write(Xout, prefix, ff.singlePrecision);
+		return;
+	}
+	string fname = getFilename(prefix);
+	logPrintf("Dumping '%s' ", fname.c_str());
+	if(ff.singlePrecision) logPrintf("(single precision) ");
+	if(ff.downsample > 1) logPrintf("(on %d x %d x %d grid) ", Xout->gInfo.S[0], Xout->gInfo.S[1], Xout->gInfo.S[2]);
+	logPrintf("... "); logFlush();
+	if(mpiWorld->isHead())
+	{	if(ff.singlePrecision) saveRawBinarySingle(Xout, fname.c_str());
+		else saveRawBinary(Xout, fname.c_str());
+	}
+	logPrintf("done\n"); logFlush();
+}
+
+void Dump::realSpaceWfnsRanges(std::vector<int>& bStart, std::vector<int>& bStop) const
+{	const ElecInfo& eInfo = e->eInfo;
+	const RealSpaceWfnsSelection& sel = realSpaceWfnsSelection;
+	int bandStop = sel.bandStop ? std::min(sel.bandStop, eInfo.nBands) : eInfo.nBands;
+	bStart.assign(eInfo.nStates, 0);
+	bStop.assign(eInfo.nStates, 0);
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	int b0 = std::min(sel.bandStart, bandStop), b1 = bandStop;
+		if(!std::isnan(sel.Emin)) //narrow to energy window (eigenvalues are in ascending order)
+		{	const diagMatrix& eigs = e->eVars.Hsub_eigs[q];
+			while(b0<b1 && eigs[b0]<sel.Emin) b0++;
+			while(b1>b0 && eigs[b1-1]>sel.Emax) b1--;
+		}
+		bStart[q] = b0;
+		bStop[q] = b1;
+	}
+	mpiWorld->allReduceData(bStart, MPIUtil::ReduceSum);
+	mpiWorld->allReduceData(bStop, MPIUtil::ReduceSum);
+}
+
+void Dump::dumpRealSpaceWfns()
+{	static StopWatch watch("Dump::realSpaceWfns"); watch.start();
+	const ElecInfo& eInfo = e->eInfo;
+	const ElecVars& eVars = e->eVars;
+	std::vector<int> bStart, bStop;
+	realSpaceWfnsRanges(bStart, bStop);
+	logPrintf("Dumping '%s' for each state q ... ", getFilename("wfns_<q>.rs").c_str()); logFlush();
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	const ColumnBundle& C = eVars.C[q];
+		const GridInfo& gInfoWfns = *(C.basis->gInfo);
+		int nSpinor = C.spinorLength();
+		ostringstream oss; oss << "wfns_" << q << ".rs";
+		string fname = getFilename(oss.str());
+		FILE* fp = fopen(fname.c_str(), "wb");
+		if(!fp) die_alone("Error opening file '%s' for writing.\n", fname.c_str());
+		//Header: first band, number of bands, spinor length and grid dimensions:
+		int32_t header[6] = { bStart[q], bStop[q]-bStart[q], nSpinor, gInfoWfns.S[0], gInfoWfns.S[1], gInfoWfns.S[2] };
+		fwriteLE(header, sizeof(int32_t), 6, fp);
+		//Stream blocks of bands through batched FFTs:
+		int nBatch = fftBatchCols(C, 1);
+		ManagedArray<complex> buf; buf.init(gInfoWfns.nr*nSpinor*nBatch, isGpuEnabled()); //scratch space reused across blocks
+		for(int bBatch=bStart[q]; bBatch<bStop[q]; bBatch+=nBatch)
+		{	int bBatchStop = std::min(bBatch+nBatch, bStop[q]);
+			int nBoxes = (bBatchStop-bBatch)*nSpinor;
+			C.getColumns(bBatch, bBatchStop, buf.dataPref());
+			I_batch(gInfoWfns, buf.dataPref(), nBoxes);
+			size_t nDoubles = 2*gInfoWfns.nr*nBoxes;
+			if(fwriteLE(buf.data(), sizeof(double), nDoubles, fp) < nDoubles)
+				die_alone("Error writing file '%s'.\n", fname.c_str());
+		}
+		fclose(fp);
+	}
+	logPrintf("done\n"); logFlush();
+	watch.stop();
+}
+
 string Dump::getFilename(string varName) const
 {	//Create a map of substitutions:
 	std::map<string,string> subMap;
@@ -25,6 +25,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarField.h>
 #include <set>
 #include <memory>
+#include <functional>
 
 //! @addtogroup Output
 //! @{
@@ -73,6 +74,19 @@ public:
 	//! Check whether to dump at given frequency and iteration:
 	bool checkInterval(DumpFrequency freq, int iter) const;
 	
+	//! Function that writes a snapshot of some state to the specified file, returning false on failure
+	typedef std::function<bool(const char*)> SnapshotWriter;
+	
+	//! Start a background checkpoint of the electronic state at the iter'th electronic iteration,
+	//! if checkpointInterval seconds of wall time have elapsed since the previous one (collective).
+	//! If provided, getHistoryWriter is called on the head (in the foreground) only when a checkpoint starts,
+	//! and should return a writer for an independent snapshot of the mixing history (see Pulay::getStateSnapshot)
+	void checkpoint(int iter, std::function<SnapshotWriter()> getHistoryWriter=0);
+	
+	//! Wait for any background checkpoint to complete and commit it (collective); must be called
+	//! before the objects captured by a history writer are destroyed, and is called before every dump
+	void checkpointWait();
+	
 	std::shared_ptr<class DOS> dos; //!< density-of-states calculator
 	std::shared_ptr<struct Polarizability> polarizability; //!< electronic polarizability calculator
 	std::shared_ptr<struct ElectronScattering> electronScattering; //!< electron-electron scattering calculator
@@ -84,6 +98,33 @@ public:
 	std::shared_ptr<struct BGWparams> bgwParams; //!< parameters for BGW claculation if any
 	bool potentialSubtraction; //!< whether to subtract neutral-atom potentials in Dvac and Dtot output
 	matrix3<int> Munfold; //!< transformation matrix for band structure unfolding
+	size_t wfnsIndexedAlign; //!< if non-zero, write wavefunctions in the indexed format with this alignment in bytes (see ElecInfo::write)
+	double checkpointInterval; //!< if non-zero, wall-time interval in seconds between background checkpoints (see command dump-checkpoint)
+	std::pair<double,double> excitationsWindow; //!< range of excitation energies included in dump variable Excitations (see command dump-excitations-format)
+	bool excitationsBinary; //!< whether to write dump variable Excitations in binary rather than text (see command dump-excitations-format)
+	string metricsFilename; //!< if non-empty, append one JSON line per iteration of each optimization / dynamics loop to this file (see command dump-metrics)
+	
+	//! Append a line to the metrics stream (if metricsFilename is set) for iteration iter of the named loop, with energy E,
+	//! residual (or gradient norm; NaN if not applicable) and any extra named values, along with wall time, time per iteration,
+	//! load imbalance between processes and peak memory. Must be called on all processes together (implemented in DumpMetrics.cpp).
+	void metrics(const char* loop, int iter, double E, double residual, const std::vector<std::pair<const char*,double>>& extra = std::vector<std::pair<const char*,double>>());
+	
+	//! Output format of a scalar-field dump variable (see command dump-field-format)
+	struct FieldFormat
+	{	bool singlePrecision; //!< write in single rather than double precision
+		int downsample; //!< factor by which to reduce the grid sample count (by Fourier resampling) before writing
+		FieldFormat() : singlePrecision(false), downsample(1) {}
+	};
+	std::map<DumpVariable,FieldFormat> fieldFormat; //!< non-default output formats by dump variable
+	int hdf5Compression; //!< if non-negative, write scalar fields and real-space wavefunctions of each dump to one HDF5 file with this gzip level (see command dump-hdf5)
+	
+	//! Selection of bands for real-space wavefunction output (see command dump-realspace-wfns)
+	struct RealSpaceWfnsSelection
+	{	int bandStart, bandStop; //!< range of band indices [bandStart,bandStop) (bandStop = 0 => up to nBands)
+		double Emin, Emax; //!< optional window on subspace eigenvalues (NaN => no window)
+		RealSpaceWfnsSelection() : bandStart(0), bandStop(0), Emin(NAN), Emax(NAN) {}
+	}
+	realSpaceWfnsSelection; //!< bands to write for dump variable RealSpaceWfns
 private:
 	const Everything* e;
 	string format; //!< Filename format containing $VAR, $STAMP, $FREQ etc.
@@ -92,6 +133,7 @@ private:
 	std::map<DumpFrequency,int> interval; //!< for each frequency, dump every interval times
 	std::map<DumpFrequency,string> formatFreq; //!< frequency-dependent format override
 	friend class Phonon;
+	friend class NudgedElasticBand;
 	friend struct CommandDump;
 	friend struct CommandDumpName;
 	friend struct CommandDumpInterval;
@@ -99,7 +141,20 @@ private:
 	void dumpOcean(); //!< BSE code export implemented in DumpOcean.cpp
 	void dumpBGW(); //!< BerkeleyGW code export implemented in DumpBGW.cpp
 	void dumpRsol(ScalarField nbound, string fname);
+	void writeField(const ScalarField& X, string prefix, DumpVariable var); //!< write scalar field in the format selected for var (collective)
+	std::map<int,std::shared_ptr<GridInfo>> downsampledGrids; //!< grids used for downsampled output (by factor)
 	void dumpUnfold();
+	void dumpRealSpaceWfns(); //!< write selected real-space wavefunctions of local states, one indexed file per state
+	void realSpaceWfnsRanges(std::vector<int>& bStart, std::vector<int>& bStop) const; //!< contiguous band range selected for each state for RealSpaceWfns output (collective)
+	std::shared_ptr<struct CheckpointState> checkpointState; //!< background checkpoint status, implemented in DumpCheckpoint.cpp
+	std::shared_ptr<struct MetricsState> metricsState; //!< open metrics stream and previous timings, implemented in DumpMetrics.cpp
+	bool checkpointFinish(bool wait); //!< commit the checkpoint in progress if complete on all processes (or after waiting if wait=true), returning whether no checkpoint remains in progress
+	//HDF5 output, implemented in DumpHDF5.cpp:
+	std::shared_ptr<struct DumpH5> h5; //!< HDF5 file of the dump in progress (null if not in use)
+	void h5open(); //!< open HDF5 file for current dump if hdf5Compression >= 0 (collective)
+	void h5close(); //!< close HDF5 file of current dump, if any (collective)
+	void h5write(const ScalarField& X, string name, bool singlePrecision=false); //!< write scalar field as dataset name in HDF5 file (collective)
+	void h5writeRealSpaceWfns(); //!< write real-space wavefunctions of all states to HDF5 file (collective)
 };
 
 //! @}
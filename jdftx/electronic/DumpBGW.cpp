@@ -155,32 +155,46 @@ void BGW::writeWfn() const
 		hid_t sid = H5Screate_simple(4, dims, NULL);
 		hid_t did = H5Dcreate(gidWfns, "coeffs", H5T_NATIVE_DOUBLE, sid, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 		hid_t plid = H5Pcreate(H5P_DATASET_XFER);
+		H5Pset_dxpl_mpio(plid, H5FD_MPIO_COLLECTIVE);
 		H5Sclose(sid);
-		//Loop over k, bands and spin/spinors:
-		hsize_t offset[4] = { 0, 0, 0, 0 };
-		hsize_t count[4] = { 1, 1, 1, 2 };
-		std::vector<complex> buffer(*std::max_element(nBasis.begin(), nBasis.end()));
+		//Collective writes of a chunk of bands of one state from every process in each round:
+		int nBandsChunk = bgwp.nBandsChunk ? std::min(bgwp.nBandsChunk, nBands) : nBands;
+		int nChunks = (nBands + nBandsChunk - 1) / nBandsChunk;
+		int nStatesMineMax = eInfo.qStop - eInfo.qStart;
+		mpiWorld->allReduce(nStatesMineMax, MPIUtil::ReduceMax);
+		std::vector<complex> buffer(size_t(nBandsChunk) * nBasisMax);
 		double volScaleFac = sqrt(gInfo.detR);
-		for(int iSpin=0; iSpin<nSpins; iSpin++)
 		for(int iSpinor=0; iSpinor<nSpinor; iSpinor++)
-		{	offset[1] = iSpin*nSpinor + iSpinor;
-			for(int ik=0; ik<nReducedKpts; ik++)
-			{	int q=iSpin*nReducedKpts+ik;
-				if(!eInfo.isMine(q)) continue;
-				count[2] = nBasis[ik];
-				offset[2] = nBasisPrev[ik];
-				hid_t sidMem = H5Screate_simple(4, count, NULL);
-				for(int b=0; b<nBands; b++)
-				{	offset[0] = b;
-					sid = H5Dget_space(did);
+		for(int iRound=0; iRound<nStatesMineMax; iRound++)
+		{	int q = eInfo.qStart + iRound;
+			bool haveState = (q < eInfo.qStop);
+			int ik = q % nReducedKpts, iSpin = q / nReducedKpts;
+			for(int iChunk=0; iChunk<nChunks; iChunk++)
+			{	int bStart = iChunk*nBandsChunk;
+				int bStop = std::min(bStart+nBandsChunk, nBands);
+				hsize_t offset[4] = { 0, 0, 0, 0 };
+				hsize_t count[4] = { 0, 1, 0, 2 };
+				sid = H5Dget_space(did);
+				if(haveState)
+				{	offset[0] = bStart; count[0] = bStop-bStart; //band range
+					offset[1] = iSpin*nSpinor + iSpinor;
+					offset[2] = nBasisPrev[ik]; count[2] = nBasis[ik]; //G-vector range
 					H5Sselect_hyperslab(sid, H5S_SELECT_SET, offset, NULL, count, NULL);
 					//Copy to buffer and scale:
-					eblas_copy(buffer.data(), eVars.C[q].data()+eVars.C[q].index(b, iSpinor*nBasis[ik]), nBasis[ik]);
-					eblas_zdscal(nBasis[ik], volScaleFac, buffer.data(), 1);
-					//Write buffer to HDF5:
-					H5Dwrite(did, H5T_NATIVE_DOUBLE, sidMem, sid, plid, buffer.data());
+					for(int b=bStart; b<bStop; b++)
+						eblas_copy(buffer.data()+(b-bStart)*nBasis[ik], eVars.C[q].data()+eVars.C[q].index(b, iSpinor*nBasis[ik]), nBasis[ik]);
+					eblas_zdscal(count[0]*count[2], volScaleFac, buffer.data(), 1);
+				}
+				else
+				{	count[0] = 1; count[2] = 1; //memory dataspace dimensions must be non-zero
+					H5Sselect_none(sid);
 				}
+				hid_t sidMem = H5Screate_simple(4, count, NULL);
+				if(!haveState) H5Sselect_none(sidMem);
+				//Write buffer to HDF5:
+				H5Dwrite(did, H5T_NATIVE_DOUBLE, sidMem, sid, plid, buffer.data());
 				H5Sclose(sidMem);
+				H5Sclose(sid);
 			}
 		}
 		H5Pclose(plid);
@@ -478,6 +492,7 @@ void BGW::writeChiFluid(bool write_q0) const
 	hid_t sid = H5Screate_simple(6, dims, NULL);
 	hid_t did = H5Dcreate(gidMats, "matrix", H5T_NATIVE_DOUBLE, sid, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 	hid_t plid = H5Pcreate(H5P_DATASET_XFER);
+	H5Pset_dxpl_mpio(plid, H5FD_MPIO_COLLECTIVE); //every process writes its block of each matrix
 	H5Sclose(sid);
 	//--- loop over q and frequencies:
 	matrix buf(nRowsMine, nColsMine);
@@ -535,6 +550,7 @@ void BGW::writeChiFluid(bool write_q0) const
 				hid_t sidMem = H5Screate_simple(6, count, NULL);
 				H5Dwrite(did, H5T_NATIVE_DOUBLE, sidMem, sid, plid, buf.data());
 				H5Sclose(sidMem);
+				H5Sclose(sid);
 			}
 			logPrintf(" %d", iFreq+1); logFlush();
 		}
@@ -720,6 +736,38 @@ std::vector<int> distributedIndices(int nTotal, int blockSize, int iProcDim, int
 	return myIndices;
 }
 
+//Block-cyclic indices of one process along a dimension (from distributedIndices, possibly truncated),
+//decomposed into a strided run of complete blocks and a final partial block (if any), suitable for HDF5 hyperslabs
+struct BlockCyclicRange
+{	hsize_t start, stride, nFull, block; //nFull complete blocks of size block starting at start, separated by stride
+	hsize_t remStart, remCount; //final partial block (remCount = 0 if none)
+	
+	BlockCyclicRange(const std::vector<int>& iMine, int blockSize, int nProcsDim)
+	: start(iMine.size() ? iMine[0] : 0), stride(hsize_t(blockSize)*nProcsDim),
+		nFull(iMine.size()/blockSize), block(blockSize),
+		remStart(0), remCount(iMine.size()%blockSize)
+	{	if(remCount) remStart = iMine[nFull*blockSize];
+	}
+};
+
+//Select the block-cyclic portion rows x cols (G-vectors x bands) of a 4D (band, spin, G, re/im) dataset, shifting G by rowOffset
+void selectBlockCyclic(hid_t sid, const BlockCyclicRange& rows, const BlockCyclicRange& cols, hsize_t iSpin, hsize_t rowOffset)
+{	H5S_seloper_t op = H5S_SELECT_SET;
+	for(int colPart=0; colPart<2; colPart++) //complete blocks, then partial block
+	for(int rowPart=0; rowPart<2; rowPart++)
+	{	hsize_t colCount = colPart ? (cols.remCount ? 1 : 0) : cols.nFull;
+		hsize_t rowCount = rowPart ? (rows.remCount ? 1 : 0) : rows.nFull;
+		if(!colCount || !rowCount) continue;
+		hsize_t offset[4] = { colPart ? cols.remStart : cols.start, iSpin, (rowPart ? rows.remStart : rows.start) + rowOffset, 0 };
+		hsize_t stride[4] = { cols.stride, 1, rows.stride, 1 };
+		hsize_t count[4] = { colCount, 1, rowCount, 1 };
+		hsize_t block[4] = { colPart ? cols.remCount : cols.block, 1, rowPart ? rows.remCount : rows.block, 2 };
+		H5Sselect_hyperslab(sid, op, offset, stride, count, block);
+		op = H5S_SELECT_OR;
+	}
+	if(op == H5S_SELECT_SET) H5Sselect_none(sid); //nothing on this process
+}
+
 //Create a vector by indexing an attay i.e. return v[index] in octave/numpy notation
 template<typename T> std::vector<T> indexVector(const T* v, const std::vector<int>& index)
 {	std::vector<T> result;
@@ -762,6 +810,7 @@ void BGW::denseWriteWfn(hid_t gidWfns)
 	hid_t sid = H5Screate_simple(4, dims, NULL);
 	hid_t did = H5Dcreate(gidWfns, "coeffs", H5T_NATIVE_DOUBLE, sid, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 	hid_t plid = H5Pcreate(H5P_DATASET_XFER);
+	H5Pset_dxpl_mpio(plid, H5FD_MPIO_COLLECTIVE); //all processes write their part of each state's eigenvectors together
 	H5Sclose(sid);
 	
 	//Loop over states:
@@ -852,7 +901,7 @@ void BGW::denseWriteWfn(hid_t gidWfns)
 				callPref(eblas_copy)(Vcol_a.dataPref(), Vcol.dataPref() + a*Vcol_a.nData(), Vcol_a.nData());
 				H += (1./e.gInfo.detR) * Vrow_a * sp->MnlAll * dagger(Vcol_a);
 			}
-			sp->sync_atpos(); //free cached projectors
+			e.iInfo.projectorCache.clear(sp.get()); //free cached projectors
 		}
 		//--- DFT+U contributions:
 		const matrix* U_rhoPtr = e.eVars.U_rhoAtom.data();
@@ -937,31 +986,16 @@ void BGW::denseWriteWfn(hid_t gidWfns)
 			F[q].resize(nBands, 0.); //update to nBandsDense (padded with zeroes)
 		}
 		
-		//Write the wavefunctions:
-		hsize_t offset[4] = { 0, hsize_t(iSpin), 0, 0 };
-		hsize_t count[4] = { 1, 1, 1, 2 };
-		matrix buf(blockSize, blockSize);
-		int nBlockRows = (nRowsMine+blockSize-1)/blockSize;
-		int nBlockCols = (nEigColsMine+blockSize-1)/blockSize;
-		for(int jBlock=0; jBlock<nBlockCols; jBlock++)
-		{	int jStart = jBlock*blockSize; //start index in local matrix
-			int jCount = std::min(blockSize, nEigColsMine-jStart); //number
-			int jOffset = iEigColsMine[jStart]; //start index in global matrix
-			for(int iBlock=0; iBlock<nBlockRows; iBlock++)
-			{	int iStart = iBlock*blockSize; //start index in local matrix
-				int iCount = std::min(blockSize, nRowsMine-iStart); //number
-				int iOffset = iRowsMine[iStart]; //start index in global matrix
-				//Copy block from local matrix to contiguous buffer:
-				zlacpy_("A", &iCount, &jCount, evecs.data()+nRowsMine*jStart+iStart, &nRowsMine, buf.data(), &iCount);
-				//Select destination in hdf5 file and wwrite from buffer:
-				count[0] = jCount; offset[0] = jOffset; //band index
-				count[2] = iCount; offset[2] = iOffset+nBasisPrev[ik]; //G-vector index
-				sid = H5Dget_space(did);
-				H5Sselect_hyperslab(sid, H5S_SELECT_SET, offset, NULL, count, NULL);
-				hid_t sidMem = H5Screate_simple(4, count, NULL);
-				H5Dwrite(did, H5T_NATIVE_DOUBLE, sidMem, sid, plid, buf.data());
-				H5Sclose(sidMem);
-			}
+		//Write the wavefunctions (local eigenvector columns directly, as one collective write of block-cyclic hyperslabs):
+		{	hsize_t countMem[4] = { hsize_t(std::max(nEigColsMine,1)), 1, hsize_t(nRowsMine), 2 };
+			hid_t sidMem = H5Screate_simple(4, countMem, NULL);
+			if(!nEigColsMine) H5Sselect_none(sidMem);
+			sid = H5Dget_space(did);
+			selectBlockCyclic(sid, BlockCyclicRange(iRowsMine, blockSize, nProcsRow),
+				BlockCyclicRange(iEigColsMine, blockSize, nProcsCol), iSpin, nBasisPrev[ik]);
+			H5Dwrite(did, H5T_NATIVE_DOUBLE, sidMem, sid, plid, evecs.data());
+			H5Sclose(sidMem);
+			H5Sclose(sid);
 		}
 		
 		//Transform Vxc to eigenbasis:
@@ -1,6 +1,7 @@
 #include <electronic/Dump.h>
 #include <electronic/Everything.h>
 #include <electronic/Dump_internal.h>
+#include <electronic/DumpChargedDefects_internal.h>
 #include <core/WignerSeitz.h>
 #include <core/Operators.h>
 #include <core/ScalarFieldIO.h>
@@ -11,13 +12,14 @@
 
 //-------------------------- Slab epsilon ----------------------------------
 
-inline void planarAvg_sub(size_t iStart, size_t iStop, const vector3<int>& S, int iDir, complex* data)
-{	int jDir = (iDir+1)%3;
-	int kDir = (iDir+2)%3;
-	THREAD_halfGspaceLoop( if(iG[jDir] || iG[kDir]) data[i] = 0.; )
+void planarAvg_sub(size_t iStart, size_t iStop, const vector3<int>& S, int iDir, complex* data)
+{	THREAD_halfGspaceLoop( planarAvg_calc(i, iG, iDir, data); )
+}
+void planarAvg(const vector3<int>& S, int iDir, complex* data)
+{	threadLaunch(planarAvg_sub, S[0]*S[1]*(S[2]/2+1), S, iDir, data);
 }
 inline void planarAvg(ScalarFieldTilde& X, int iDir)
-{	threadLaunch(planarAvg_sub, X->gInfo.nG, X->gInfo.S, iDir, X->data());
+{	callPref(planarAvg)(X->gInfo.S, iDir, X->dataPref());
 }
 inline ScalarField getPlanarAvg(const ScalarField& X, int iDir)
 {	ScalarFieldTilde Xtilde = J(X);
@@ -28,32 +30,27 @@ inline void planarAvg(ScalarField& X, int iDir)
 {	X = getPlanarAvg(X, iDir);
 }
 
-//Multiply by phase factor, that when averaged extracts the prefactor of -sin(2 pi x)/(2pi) (the form used in Coulomb::getEfieldPotential) along direction jDir
-inline void sinMultiply_sub(size_t iStart, size_t iStop, const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data)
-{	double invSj = 1./S[jDir];
-	THREAD_rLoop(
-		double xj = invSj * iv[jDir] - xCenter[jDir];
-		data[i] *= (-4*M_PI) * sin(2*M_PI*xj);
-	)
+void sinMultiply_sub(size_t iStart, size_t iStop, const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data)
+{	THREAD_rLoop( sinMultiply_calc(i, iv, S, jDir, xCenter, data); )
+}
+void sinMultiply(const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data)
+{	threadLaunch(sinMultiply_sub, S[0]*S[1]*S[2], S, jDir, xCenter, data);
 }
 inline void sinMultiply(ScalarField& X, int jDir, const vector3<>& xCenter)
-{	threadLaunch(sinMultiply_sub, X->gInfo.nr, X->gInfo.S, jDir, xCenter, X->data());
+{	callPref(sinMultiply)(X->gInfo.S, jDir, xCenter, X->dataPref());
 }
 
-inline void fixBoundary_sub(size_t iStart, size_t iStop, const vector3<int>& S, int iDir, int iBoundary, double* eps)
-{	iBoundary = positiveRemainder(iBoundary, S[iDir]);
-	THREAD_rLoop(
-		int dist = iv[iDir] - iBoundary;
-		if(dist*2 > S[iDir]) dist -= S[iDir];
-		if(dist*2 < -S[iDir]) dist += S[iDir];
-		if(abs(dist)<=2) eps[i] = 1.;
-	)
+void fixBoundary_sub(size_t iStart, size_t iStop, const vector3<int>& S, int iDir, int iBoundary, double* eps)
+{	THREAD_rLoop( fixBoundary_calc(i, iv, S, iDir, iBoundary, eps); )
+}
+void fixBoundary(const vector3<int>& S, int iDir, int iBoundary, double* eps)
+{	threadLaunch(fixBoundary_sub, S[0]*S[1]*S[2], S, iDir, iBoundary, eps);
 }
 inline void fixBoundarySmooth(ScalarField& epsInv, int iDir, const vector3<>& xCenter, double sigma)
 {	const GridInfo& gInfo = epsInv->gInfo;
 	//Fix values of epsilon near truncation boundary to 1:
-	int iBoundary = int(round((xCenter[iDir]+0.5) * gInfo.S[iDir]));
-	threadLaunch(fixBoundary_sub, gInfo.nr, gInfo.S, iDir, iBoundary, epsInv->data());
+	int iBoundary = positiveRemainder(int(round((xCenter[iDir]+0.5) * gInfo.S[iDir])), gInfo.S[iDir]);
+	callPref(fixBoundary)(gInfo.S, iDir, iBoundary, epsInv->dataPref());
 	//Smooth:
 	epsInv = I(gaussConvolve(J(epsInv), sigma));
 }
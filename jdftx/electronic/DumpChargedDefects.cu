@@ -0,0 +1,58 @@
+/*-------------------------------------------------------------------
+Copyright 2016 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/DumpChargedDefects_internal.h>
+#include <core/GpuKernelUtils.h>
+#include <core/LoopMacros.h>
+
+__global__
+void planarAvg_kernel(int zBlock, const vector3<int> S, int iDir, complex* data)
+{	COMPUTE_halfGindices
+	planarAvg_calc(i, iG, iDir, data);
+}
+void planarAvg_gpu(const vector3<int>& S, int iDir, complex* data)
+{	GpuLaunchConfigHalf3D glc(planarAvg_kernel, S);
+	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
+		planarAvg_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, iDir, data);
+	gpuErrorCheck();
+}
+
+__global__
+void sinMultiply_kernel(int zBlock, const vector3<int> S, int jDir, const vector3<> xCenter, double* data)
+{	COMPUTE_rIndices
+	sinMultiply_calc(i, iv, S, jDir, xCenter, data);
+}
+void sinMultiply_gpu(const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data)
+{	GpuLaunchConfig3D glc(sinMultiply_kernel, S);
+	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
+		sinMultiply_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, jDir, xCenter, data);
+	gpuErrorCheck();
+}
+
+__global__
+void fixBoundary_kernel(int zBlock, const vector3<int> S, int iDir, int iBoundary, double* eps)
+{	COMPUTE_rIndices
+	fixBoundary_calc(i, iv, S, iDir, iBoundary, eps);
+}
+void fixBoundary_gpu(const vector3<int>& S, int iDir, int iBoundary, double* eps)
+{	GpuLaunchConfig3D glc(fixBoundary_kernel, S);
+	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
+		fixBoundary_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, iDir, iBoundary, eps);
+	gpuErrorCheck();
+}
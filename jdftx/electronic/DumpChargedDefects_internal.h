@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------
+Copyright 2016 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_DUMPCHARGEDDEFECTS_INTERNAL_H
+#define JDFTX_ELECTRONIC_DUMPCHARGEDDEFECTS_INTERNAL_H
+
+//! @addtogroup Output
+//! @{
+//! @file DumpChargedDefects_internal.h Shared GPU/CPU kernels for slab dielectric and charged-defect corrections
+
+#include <core/scalar.h>
+#include <core/vector3.h>
+
+//! Zero all G-vectors that are not along iDir (planar average normal to iDir)
+__hostanddev__ void planarAvg_calc(size_t i, const vector3<int>& iG, int iDir, complex* data)
+{	if(iG[(iDir+1)%3] || iG[(iDir+2)%3]) data[i] = 0.;
+}
+
+//! Multiply by phase factor, that when averaged extracts the prefactor of -sin(2 pi x)/(2pi) (the form used in Coulomb::getEfieldPotential) along direction jDir
+__hostanddev__ void sinMultiply_calc(size_t i, const vector3<int>& iv, const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data)
+{	double xj = iv[jDir] * (1./S[jDir]) - xCenter[jDir];
+	data[i] *= (-4*M_PI) * sin(2*M_PI*xj);
+}
+
+//! Set epsilon to 1 within two grid points of the plane iBoundary (in [0,S[iDir])) normal to iDir
+__hostanddev__ void fixBoundary_calc(size_t i, const vector3<int>& iv, const vector3<int>& S, int iDir, int iBoundary, double* eps)
+{	int dist = iv[iDir] - iBoundary;
+	if(dist*2 > S[iDir]) dist -= S[iDir];
+	if(dist*2 < -S[iDir]) dist += S[iDir];
+	if(abs(dist)<=2) eps[i] = 1.;
+}
+
+void planarAvg(const vector3<int>& S, int iDir, complex* data);
+void sinMultiply(const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data);
+void fixBoundary(const vector3<int>& S, int iDir, int iBoundary, double* eps);
+#ifdef GPU_ENABLED
+void planarAvg_gpu(const vector3<int>& S, int iDir, complex* data);
+void sinMultiply_gpu(const vector3<int>& S, int jDir, const vector3<>& xCenter, double* data);
+void fixBoundary_gpu(const vector3<int>& S, int iDir, int iBoundary, double* eps);
+#endif
+
+//! @}
+#endif // JDFTX_ELECTRONIC_DUMPCHARGEDDEFECTS_INTERNAL_H
@@ -0,0 +1,169 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/Dump.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+//Background checkpoint status. While a checkpoint is active, the snapshot below is written from a
+//separate thread using only POSIX I/O (no MPI calls), to <fname>.tmp for each of fnames.
+//Once the writes complete on all processes, the head renames them to fnames, so that an interrupted
+//checkpoint never leaves a partially-written file in place of the previous one.
+struct CheckpointState
+{	double tLast; //wall time at start of previous checkpoint (used on head)
+	bool active; //whether a checkpoint has started but not yet been committed
+	int iter; //electronic iteration of active checkpoint
+	std::vector<string> fnames; //final filenames: wfns, eigenvals, [fillings], [scfHistory]
+	std::thread thread;
+	std::atomic<bool> done; //whether writes on this process have completed
+	bool success; //whether writes on this process succeeded (valid once done)
+
+	//Snapshot:
+	std::vector<ColumnBundle> C; std::vector<char> wfnsHeader; std::vector<uint64_t> wfnsOffsets;
+	std::vector<diagMatrix> eigs, F;
+	Dump::SnapshotWriter historyWriter;
+
+	CheckpointState() : tLast(clock_sec()), active(false), done(false), success(true) {}
+	~CheckpointState() { if(thread.joinable()) thread.join(); }
+
+	void write(const ElecInfo& eInfo); //run on background thread
+
+	void clearSnapshot()
+	{	C.clear(); wfnsHeader.clear(); wfnsOffsets.clear();
+		eigs.clear(); F.clear();
+		historyWriter = 0;
+	}
+};
+
+//Write diagMatrix of each state owned by this process in the layout of ElecInfo::write, without MPI calls
+static bool writeLocal(const ElecInfo& eInfo, const std::vector<diagMatrix>& M, const char* fname)
+{	int fd = open(fname, O_WRONLY|O_CREAT, 0666);
+	if(fd < 0) return false;
+	bool success = true;
+	for(int q=eInfo.qStart; q<eInfo.qStop && success; q++)
+	{	diagMatrix buf = M[q];
+		convertToLE(buf.data(), sizeof(double), buf.size());
+		size_t nBytes = buf.size()*sizeof(double);
+		success = (pwrite(fd, buf.data(), nBytes, size_t(q)*eInfo.nBands*sizeof(double)) == ssize_t(nBytes));
+	}
+	if(fsync(fd)) success = false;
+	if(close(fd)) success = false;
+	return success;
+}
+
+void CheckpointState::write(const ElecInfo& eInfo)
+{	bool result = eInfo.writeIndexedLocal(C, (fnames[0]+".tmp").c_str(), wfnsHeader, wfnsOffsets);
+	result = writeLocal(eInfo, eigs, (fnames[1]+".tmp").c_str()) && result;
+	size_t iFile = 2;
+	if(F.size()) result = writeLocal(eInfo, F, (fnames[iFile++]+".tmp").c_str()) && result;
+	if(historyWriter) result = historyWriter((fnames[iFile++]+".tmp").c_str()) && result;
+	success = result;
+	done = true;
+}
+
+
+void Dump::checkpoint(int iter, std::function<SnapshotWriter()> getHistoryWriter)
+{	if(!checkpointInterval) return;
+	if(!checkpointState) checkpointState = std::make_shared<CheckpointState>();
+	CheckpointState& cs = *checkpointState;
+	if(!checkpointFinish(false)) return; //previous checkpoint still being written: skip this one rather than block
+
+	//Check wall-time budget on head, so that all processes stay in sync:
+	bool start = (clock_sec() - cs.tLast >= checkpointInterval);
+	mpiWorld->bcast(start);
+	if(!start) return;
+	static StopWatch watch("Dump::checkpoint"); watch.start();
+	cs.tLast = clock_sec();
+	cs.iter = iter;
+	curIter = iter; curFreq = DumpFreq_Electronic; //used by getFilename()
+	const ElecInfo& eInfo = e->eInfo;
+	const ElecVars& eVars = e->eVars;
+
+	//Snapshot wavefunctions and lay out their file (collective, and also moves snapshot data to the CPU):
+	cs.fnames.assign(1, getFilename("wfns"));
+	cs.C.resize(eInfo.nStates);
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++) cs.C[q] = eVars.C[q];
+	cs.wfnsHeader = eInfo.layoutIndexed(cs.C, wfnsIndexedAlign, cs.wfnsOffsets);
+
+	//Snapshot subspace eigenvalues and fillings (if required for restart):
+	cs.fnames.push_back(getFilename("eigenvals"));
+	cs.eigs.assign(eInfo.nStates, diagMatrix());
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++) cs.eigs[q] = eVars.Hsub_eigs[q];
+	if(eInfo.fillingsUpdate==ElecInfo::FillingsHsub)
+	{	cs.fnames.push_back(getFilename("fillings"));
+		double wInv = eInfo.spinType==SpinNone ? 0.5 : 1.0; //normalization factor from external to internal fillings
+		cs.F.assign(eInfo.nStates, diagMatrix());
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++) cs.F[q] = eVars.F[q] * (1./wInv);
+	}
+
+	//Snapshot mixing history (only needed on head):
+	if(getHistoryWriter)
+	{	cs.fnames.push_back(getFilename("scfHistory"));
+		if(mpiWorld->isHead()) cs.historyWriter = getHistoryWriter();
+	}
+
+	//Remove stale temporary files (the broadcast ensures this precedes their creation on other processes):
+	if(mpiWorld->isHead())
+		for(const string& fname: cs.fnames)
+			unlink((fname+".tmp").c_str());
+	mpiWorld->bcast(start);
+
+	//Start writing in the background:
+	cs.active = true;
+	cs.done = false;
+	cs.thread = std::thread(&CheckpointState::write, &cs, std::cref(eInfo));
+	logPrintf("Started background checkpoint of electronic iteration %d to '%s' etc.\n", iter, cs.fnames[0].c_str()); logFlush();
+	watch.stop();
+}
+
+void Dump::checkpointWait()
+{	checkpointFinish(true);
+}
+
+bool Dump::checkpointFinish(bool wait)
+{	if(!checkpointState || !checkpointState->active) return true;
+	CheckpointState& cs = *checkpointState;
+	if(wait) cs.thread.join();
+	bool done = cs.done;
+	mpiWorld->allReduce(&done, 1, MPIUtil::ReduceLAnd);
+	if(!done) return false;
+	if(cs.thread.joinable()) cs.thread.join();
+	cs.clearSnapshot();
+	cs.active = false;
+
+	//Commit on success everywhere:
+	bool success = cs.success;
+	mpiWorld->allReduce(&success, 1, MPIUtil::ReduceLAnd);
+	if(success && mpiWorld->isHead())
+		for(const string& fname: cs.fnames)
+			if(rename((fname+".tmp").c_str(), fname.c_str()))
+				success = false;
+	mpiWorld->bcast(success);
+	if(success)
+		logPrintf("Committed background checkpoint of electronic iteration %d.\n", cs.iter);
+	else
+		logPrintf("WARNING: background checkpoint of electronic iteration %d failed to write; previous files left unchanged.\n", cs.iter);
+	logFlush();
+	return true;
+}
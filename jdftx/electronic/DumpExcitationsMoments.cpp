@@ -20,9 +20,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/Dump.h>
 #include <electronic/Everything.h>
 #include <electronic/ColumnBundle.h>
-#include <electronic/ColumnBundleTransform.h>
 #include <electronic/Dump_internal.h>
-#include <core/WignerSeitz.h>
+#include <core/ScalarFieldIO.h>
 #include <core/Operators.h>
 #include <core/Units.h>
 #include <core/LatticeUtils.h>
@@ -31,17 +30,34 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 void dumpExcitations(const Everything& e, const char* filename)
 {
+	static StopWatch watch("dumpExcitations"); watch.start();
 	const GridInfo& g = e.gInfo;
+	const double dEmin = e.dump.excitationsWindow.first;
+	const double dEmax = e.dump.excitationsWindow.second;
 
 	struct excitation
 	{	int q,o,u;
 		double dE;
-		double dreal, dimag, dnorm;
+		vector3<complex> d; //dipole matrix element <psi_u|r|psi_o>
 		
-		excitation(int q, int o, int u, double dE, double dreal, double dimag, double dnorm): q(q), o(o), u(u), dE(dE), dreal(dreal), dimag(dimag), dnorm(dnorm){};
+		excitation(int q=0, int o=0, int u=0, double dE=0., vector3<complex> d=vector3<complex>()): q(q), o(o), u(u), dE(dE), d(d) {};
 		
 		inline bool operator<(const excitation& other) const {return dE<other.dE;}
-		void print(FILE* fp) const { fprintf(fp, "%5i %3i %3i %12.5e %12.5e %12.5e %12.5e\n", q, o, u, dE, dreal, dimag, dnorm); }
+		void print(FILE* fp) const
+		{	double dreal=0., dimag=0., dnorm=0.;
+			for(int k=0; k<3; k++)
+			{	dreal += std::pow(d[k].real(), 2);
+				dimag += std::pow(d[k].imag(), 2);
+				dnorm += d[k].norm();
+			}
+			fprintf(fp, "%5i %3i %3i %12.5e %12.5e %12.5e %12.5e\n", q, o, u, dE, dreal, dimag, dnorm);
+		}
+		void write(FILE* fp) const //binary record: int32 q, o, u; float64 dE, Re(dx), Im(dx), Re(dy), Im(dy), Re(dz), Im(dz)
+		{	int32_t qou[3] = { q, o, u };
+			fwrite(qou, sizeof(int32_t), 3, fp);
+			fwrite(&dE, sizeof(double), 1, fp);
+			fwrite(&d, sizeof(complex), 3, fp);
+		}
 	};
 	std::vector<excitation> excitations;
 
@@ -63,11 +79,11 @@ void dumpExcitations(const Everything& e, const char* filename)
 	const std::vector<diagMatrix>& eigs = eigsQP.size() ? eigsQP : e.eVars.Hsub_eigs;
 	
 	// Integral kernel's for Fermi's golden rule
-	ScalarField r0, r1, r2;
-	nullToZero(r0, g); 	nullToZero(r1, g); 	nullToZero(r2, g);
-	applyFunc_r(g, Moments::rn_pow_x, 0, g.R, 1, vector3<>(0.,0.,0.), r0->data());
-	applyFunc_r(g, Moments::rn_pow_x, 1, g.R, 1, vector3<>(0.,0.,0.), r1->data());
-	applyFunc_r(g, Moments::rn_pow_x, 2, g.R, 1, vector3<>(0.,0.,0.), r2->data());
+	ScalarFieldArray r(3);
+	for(int k=0; k<3; k++)
+	{	nullToZero(r[k], g);
+		applyFunc_r(g, Moments::rn_pow_x, k, g.R, 1, vector3<>(0.,0.,0.), r[k]->data());
+	}
 	
 	//Find and cache all excitations in system (between same qnums)
 	bool insufficientBands = false;
@@ -80,16 +96,26 @@ void dumpExcitations(const Everything& e, const char* filename)
 		if(eigs[q][HOMO]   > maxHOMO) { maxHOMOq = q; maxHOMOn = HOMO;   maxHOMO = eigs[q][HOMO];   }
 		if(eigs[q][HOMO+1] < minLUMO) { minLUMOq = q; minLUMOn = HOMO+1; minLUMO = eigs[q][HOMO+1]; }
 		
-		for(int o=HOMO; o>=0; o--)
-		{	for(int u=(HOMO+1); u<e.eInfo.nBands; u++)
-			{	complex x = integral(I(e.eVars.C[q].getColumn(u,0))*r0*I(e.eVars.C[q].getColumn(o,0)));
-				complex y = integral(I(e.eVars.C[q].getColumn(u,0))*r1*I(e.eVars.C[q].getColumn(o,0)));
-				complex z = integral(I(e.eVars.C[q].getColumn(u,0))*r2*I(e.eVars.C[q].getColumn(o,0)));
-				vector3<> dreal(x.real(), y.real(),z.real());
-				vector3<> dimag(x.imag(), y.imag(),z.imag());
-				vector3<> dnorm(sqrt(x.norm()), sqrt(y.norm()),sqrt(z.norm()));
-				double dE = eigs[q][u]-eigs[q][o]; //Excitation energy
-				excitations.push_back(excitation(q, o, u, dE, dreal.length_squared(), dimag.length_squared(), dnorm.length_squared()));
+		//Restrict to the occupied and unoccupied bands that can contribute to excitations within the window:
+		int oStart = 0; while(eigs[q][HOMO+1]-eigs[q][oStart] > dEmax) oStart++; //deepest occupied band
+		int uStop = e.eInfo.nBands; while(eigs[q][uStop-1]-eigs[q][HOMO] > dEmax) uStop--; //highest unoccupied band
+		if(oStart>HOMO || uStop<=HOMO+1) continue;
+		
+		//Occupied-unoccupied dipole matrix elements (one batched transform of the occupied block and one GEMM per direction):
+		const ColumnBundle& C = e.eVars.C[q];
+		ColumnBundle Cocc = C.getSub(oStart, HOMO+1), Cunocc = C.getSub(HOMO+1, uStop);
+		vector3<matrix> dMat;
+		for(int k=0; k<3; k++)
+			dMat[k] = g.dV * (Cunocc ^ Idag_DiagV_I(Cocc, ScalarFieldArray(1, r[k])));
+		
+		for(int o=HOMO; o>=oStart; o--)
+		{	for(int u=(HOMO+1); u<uStop; u++)
+			{	double dE = eigs[q][u]-eigs[q][o]; //Excitation energy
+				if(dE<dEmin || dE>dEmax) continue;
+				vector3<complex> d;
+				for(int k=0; k<3; k++)
+					d[k] = dMat[k](u-(HOMO+1), o-oStart);
+				excitations.push_back(excitation(q, o, u, dE, d));
 			}
 		}
 	}
@@ -97,17 +123,17 @@ void dumpExcitations(const Everything& e, const char* filename)
 	if(insufficientBands)
 	{	logPrintf("Insufficient bands to calculate excited states!\n");
 		logPrintf("Increase the number of bands (elec-n-bands) and try again!\n");
+		watch.stop();
 		return;
 	}
 	
 	//Transmit results to head process:
 	if(mpiWorld->isHead())
-	{	excitations.reserve(excitations.size() * mpiWorld->nProcesses());
-		for(int jProcess=1; jProcess<mpiWorld->nProcesses(); jProcess++)
+	{	for(int jProcess=1; jProcess<mpiWorld->nProcesses(); jProcess++)
 		{	//Receive data:
 			size_t nExcitations; mpiWorld->recv(nExcitations, jProcess, 0);
 			std::vector<int> msgInt(4 + nExcitations*3); 
-			std::vector<double> msgDbl(2 + nExcitations*4);
+			std::vector<double> msgDbl(2 + nExcitations*7);
 			mpiWorld->recvData(msgInt, jProcess, 1);
 			mpiWorld->recvData(msgDbl, jProcess, 2);
 			//Unpack:
@@ -119,11 +145,13 @@ void dumpExcitations(const Everything& e, const char* filename)
 			if(j_maxHOMO > maxHOMO) { maxHOMOq=j_maxHOMOq; maxHOMOn=j_maxHOMOn; maxHOMO=j_maxHOMO; }
 			if(j_minLUMO < minLUMO) { minLUMOq=j_minLUMOq; minLUMOn=j_minLUMOn; minLUMO=j_minLUMO; }
 			//--- excitation array:
+			excitations.reserve(excitations.size() + nExcitations);
 			for(size_t iExcitation=0; iExcitation<nExcitations; iExcitation++)
 			{	int q = *(intPtr++); int o = *(intPtr++); int u = *(intPtr++);
 				double dE = *(dblPtr++);
-				double dreal = *(dblPtr++); double dimag = *(dblPtr++); double dnorm = *(dblPtr++);
-				excitations.push_back(excitation(q, o, u, dE, dreal, dimag, dnorm));
+				vector3<complex> d;
+				for(int k=0; k<3; k++) { d[k].real() = *(dblPtr++); d[k].imag() = *(dblPtr++); }
+				excitations.push_back(excitation(q, o, u, dE, d));
 			}
 		}
 	}
@@ -132,13 +160,13 @@ void dumpExcitations(const Everything& e, const char* filename)
 		std::vector<int> msgInt; std::vector<double> msgDbl;
 		size_t nExcitations = excitations.size();
 		msgInt.reserve(4 + nExcitations*3);
-		msgDbl.reserve(2 + nExcitations*4);
+		msgDbl.reserve(2 + nExcitations*7);
 		msgInt.push_back(maxHOMOq); msgInt.push_back(maxHOMOn); msgDbl.push_back(maxHOMO);
 		msgInt.push_back(minLUMOq); msgInt.push_back(minLUMOn); msgDbl.push_back(minLUMO);
 		for(const excitation& e: excitations)
 		{	msgInt.push_back(e.q); msgInt.push_back(e.o); msgInt.push_back(e.u);
 			msgDbl.push_back(e.dE);
-			msgDbl.push_back(e.dreal); msgDbl.push_back(e.dimag); msgDbl.push_back(e.dnorm);
+			for(int k=0; k<3; k++) { msgDbl.push_back(e.d[k].real()); msgDbl.push_back(e.d[k].imag()); }
 		}
 		//Send data:
 		mpiWorld->send(nExcitations, 0, 0);
@@ -147,21 +175,32 @@ void dumpExcitations(const Everything& e, const char* filename)
 	}
 
 	//Process and print excitations:
-	if(!mpiWorld->isHead()) return;
+	if(!mpiWorld->isHead()) { watch.stop(); return; }
+	std::sort(excitations.begin(), excitations.end());
 	
-	FILE* fp = fopen(filename, "w");
+	//Summary (in the text file, or the log for binary output):
+	FILE* fp = e.dump.excitationsBinary ? globalLog : fopen(filename, "w");
 	if(!fp) die("Error opening %s for writing.\n", filename);
-	
-	std::sort(excitations.begin(), excitations.end());
-	const excitation& opt = excitations.front();
 	fprintf(fp, "Using %s eigenvalues.      HOMO: %.5f   LUMO: %.5f  \n", eigsQP.size() ? "discontinuity-corrected QP" : "KS", maxHOMO, minLUMO);
-	fprintf(fp, "Optical (direct) gap: %.5e (from n = %i to %i in qnum = %i)\n", opt.dE, opt.o, opt.u, opt.q);
+	if(excitations.size())
+	{	const excitation& opt = excitations.front();
+		fprintf(fp, "Optical (direct) gap: %.5e (from n = %i to %i in qnum = %i)\n", opt.dE, opt.o, opt.u, opt.q);
+	}
 	fprintf(fp, "Indirect gap: %.5e (from (%i, %i) to (%i, %i))\n\n", minLUMO-maxHOMO, maxHOMOq, maxHOMOn, minLUMOq, minLUMOn);
 	
-	fprintf(fp, "Optical excitation energies and corresponding electric dipole transition strengths\n");
-	fprintf(fp, "qnum   i   f      dE        |<psi1|r|psi2>|^2 (real, imag, norm)\n");
-	for(const excitation& e: excitations) e.print(fp);
+	if(e.dump.excitationsBinary)
+	{	fp = fopen(filename, "wb");
+		if(!fp) die("Error opening %s for writing.\n", filename);
+		for(const excitation& e: excitations) e.write(fp);
+		logPrintf("\tWrote %lu excitations in binary format.\n", excitations.size());
+	}
+	else
+	{	fprintf(fp, "Optical excitation energies and corresponding electric dipole transition strengths\n");
+		fprintf(fp, "qnum   i   f      dE        |<psi1|r|psi2>|^2 (real, imag, norm)\n");
+		for(const excitation& e: excitations) e.print(fp);
+	}
 	fclose(fp);
+	watch.stop();
 }
 
 
@@ -274,66 +313,93 @@ namespace XC_Analysis
 
 //-------------------------- Solvation radii ----------------------------------
 
-inline void set_rInv(size_t iStart, size_t iStop, const vector3<int>& S, const matrix3<>& RTR, const WignerSeitz* ws, double* rInv)
-{	vector3<> invS; for(int k=0; k<3; k++) invS[k] = 1./S[k];
-	matrix3<> meshMetric = Diag(invS) * RTR * Diag(invS);
-	const double rWidth = 1.;
-	THREAD_rLoop( 
-		double r = sqrt(meshMetric.metric_length_squared(ws->restrict(iv, S, invS)));
-		if(r < rWidth) //Polynomial with f',f" zero at origin and f,f',f" matched at rWidth
-		{	double t = r/rWidth;
-			rInv[i] = (1./rWidth) * (1. + 0.5*(1.+t*t*t*(-2.+t)) + (1./12)*(1.+t*t*t*(-4.+t*3.))*2. );
-		}
-		else rInv[i] = 1./r;
-	)
+//Regularized 1/r: polynomial with f',f" zero at origin and f,f',f" matched at rWidth
+inline double rInvSmooth(double r)
+{	const double rWidth = 1.;
+	if(r < rWidth)
+	{	double t = r/rWidth;
+		return (1./rWidth) * (1. + 0.5*(1.+t*t*t*(-2.+t)) + (1./12)*(1.+t*t*t*(-4.+t*3.))*2. );
+	}
+	else return 1./r;
 }
 
 void Dump::dumpRsol(ScalarField nbound, string fname)
 {	
-	//Compute normalization factor for the partition:
+	//Compute normalization factor for the partition, and the radial profile of each species' atomic density:
 	int nAtomsTot = 0; for(const auto& sp: e->iInfo.species) nAtomsTot += sp->atpos.size();
 	const double nFloor = 1e-5/nAtomsTot; //lower cap on densities to prevent Nyquist noise in low density regions
+	const double drFac = 0.5; //radial resolution of the atom-centered averages
 	ScalarField nAtomicTot;
-	for(const auto& sp: e->iInfo.species)
-	{	RadialFunctionG nRadial;
+	std::vector< vector3<> > centers; //Cartesian positions of all atoms
+	std::vector< std::vector<double> > nAtomicProfile(e->iInfo.species.size()); //spherical average of (capped) atomic density of each species
+	for(size_t iSp=0; iSp<e->iInfo.species.size(); iSp++)
+	{	const auto& sp = e->iInfo.species[iSp];
+		RadialFunctionG nRadial;
 		logSuspend(); sp->getAtom_nRadial(0,0, nRadial, true); logResume();
 		for(unsigned atom=0; atom<sp->atpos.size(); atom++)
 		{	ScalarField nAtomic = radialFunction(e->gInfo, nRadial, sp->atpos[atom]);
 			double nMin, nMax; callPref(eblas_capMinMax)(e->gInfo.nr, nAtomic->dataPref(), nMin, nMax, nFloor);
 			nAtomicTot += nAtomic;
+			centers.push_back(e->gInfo.R * sp->atpos[atom]);
+			if(!atom) nAtomicProfile[iSp] = sphericalize(&nAtomic, 1, std::vector< vector3<> >(1, centers.back()), 0., drFac)[0][1];
 		}
 	}
 	ScalarField nboundByAtomic = (nbound*nbound) * inv(nAtomicTot);
-
-	ScalarField rInv0(ScalarFieldData::alloc(e->gInfo));
-	{	logSuspend(); WignerSeitz ws(e->gInfo.R); logResume();
-		threadLaunch(set_rInv, e->gInfo.nr, e->gInfo.S, e->gInfo.RTR, &ws, rInv0->data());
-	}
+	
+	//Spherical averages of the partitioned bound charge about all atoms in one pass:
+	std::vector< std::vector< std::vector<double> > > hist = sphericalize(&nboundByAtomic, 1, centers, 0., drFac);
 	
 	//Compute bound charge 1/r and 1/r^2 expectation values weighted by atom-density partition:
-	FILE* fp = fopen(fname.c_str(), "w");
-	fprintf(fp, "#Species   rMean +/- rSigma [bohrs]   (rMean +/- rSigma [Angstrom])   sqrt(Int|nbound^2|) in partition\n");
-	for(const auto& sp: e->iInfo.species)
-	{	RadialFunctionG nRadial;
-		logSuspend(); sp->getAtom_nRadial(0,0, nRadial, true); logResume();
+	FILE* fp = 0;
+	if(mpiWorld->isHead())
+	{	fp = fopen(fname.c_str(), "w");
+		if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
+		fprintf(fp, "#Species   rMean +/- rSigma [bohrs]   (rMean +/- rSigma [Angstrom])   sqrt(Int|nbound^2|) in partition\n");
+	}
+	int iAtom = 0;
+	for(size_t iSp=0; iSp<e->iInfo.species.size(); iSp++)
+	{	const auto& sp = e->iInfo.species[iSp];
+		const std::vector<double>& nAtomicRadial = nAtomicProfile[iSp];
 		for(unsigned atom=0; atom<sp->atpos.size(); atom++)
-		{	ScalarField w = radialFunction(e->gInfo, nRadial, sp->atpos[atom]) * nboundByAtomic;
-			//Get r centered at current atom:
-			ScalarFieldTilde trans; nullToZero(trans, e->gInfo); initTranslation(trans, e->gInfo.R*sp->atpos[atom]);
-			ScalarField rInv = I(trans * J(rInv0));
-			//Compute moments:
-			double wNorm = integral(w);
-			double rInvMean = integral(w * rInv) / wNorm;
-			double rInvSqMean = integral(w * rInv * rInv) / wNorm;
+		{	const std::vector<double>& rRadial = hist[iAtom][0];
+			const std::vector<double>& nboundRadial = hist[iAtom][1];
+			const std::vector<double>& wRadial = hist[iAtom][2];
+			iAtom++;
+			//Compute moments (integrals over shells of the atomic density times the partitioned bound charge):
+			double wNorm = 0., rInvSum = 0., rInvSqSum = 0.;
+			for(size_t i=0; i<rRadial.size(); i++)
+			{	double wShell = e->gInfo.dV * wRadial[i] * nAtomicRadial[i] * nboundRadial[i];
+				double rInv = rInvSmooth(rRadial[i]);
+				wNorm += wShell;
+				rInvSum += wShell * rInv;
+				rInvSqSum += wShell * rInv * rInv;
+			}
+			double rInvMean = rInvSum / wNorm;
+			double rInvSqMean = rInvSqSum / wNorm;
 			double rInvSigma = sqrt(rInvSqMean - rInvMean*rInvMean);
 			double rMean = 1./rInvMean;
 			double rSigma = rInvSigma / (rInvMean*rInvMean);
 			//Print stats:
-			fprintf(fp, "Rsol %s    %.2lf +/- %.2lf    ( %.2lf +/- %.2lf A )   Qrms: %.1le\n", sp->name.c_str(),
+			if(fp) fprintf(fp, "Rsol %s    %.2lf +/- %.2lf    ( %.2lf +/- %.2lf A )   Qrms: %.1le\n", sp->name.c_str(),
 				rMean, rSigma, rMean/Angstrom, rSigma/Angstrom, sqrt(wNorm));
 		}
 	}
-	fclose(fp);
+	if(fp) fclose(fp);
+}
+
+//Accumulate unfolding weights of bands [bStart,bStop) to the unit cell k of each basis function (with weights ordered by unit cell k, then band)
+void unfoldWeights_sub(size_t bStart, size_t bStop, int nbasis, int nSpinor, int nBands, const int* iUnit,
+	const complex* C, const complex* OC, double* weights)
+{	int colLength = nbasis*nSpinor;
+	for(size_t b=bStart; b<bStop; b++)
+	{	const complex* Cb = C + b*colLength;
+		const complex* OCb = OC + b*colLength;
+		for(int s=0; s<nSpinor; s++)
+			for(int n=0; n<nbasis; n++)
+			{	int i = n + s*nbasis;
+				weights[iUnit[n]*nBands + b] += (Cb[i].conj() * OCb[i]).real();
+			}
+	}
 }
 
 void Dump::dumpUnfold()
@@ -384,30 +450,30 @@ void Dump::dumpUnfold()
 	//Weights of each unit cell k:
 	fname = getFilename("bandUnfold");
 	logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+	//(Each supercell basis function maps to exactly one unit cell basis function of one unit cell k, with the same
+	//kinetic energy, so the weights are partial sums of the overlaps of each band over supercell basis functions.)
 	std::vector<diagMatrix> unitWeights(eInfo.nStates);
+	int qPrev = -1; std::vector<int> iUnit; //unit cell k index of each basis function (shared by states with the same k and basis, eg. spins)
 	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-	{	unitWeights[q].reserve(nUnits * eInfo.nBands);
-		for(const vector3<>& k: kUnit[q])
-		{	//Create basis and qnum for unit cell k:
-			Basis basisUnit;
-			logSuspend();
-			basisUnit.setup(gInfoUnit, e->iInfo, e->cntrl.Ecut, k);
-			logResume();
-			QuantumNumber qnumUnit; qnumUnit.k = k;
-			//Setup wave function transformation:
-			int nSpinor = eInfo.spinorLength();
-			ColumnBundleTransform cbt(k, basisUnit, eInfo.qnums[q].k, e->basis[q], nSpinor, SpaceGroupOp(), +1, M);
-			//Extract unit cell wavefunctions:
-			const ColumnBundle& C = e->eVars.C[q];
-			ColumnBundle OC = O(C);
-			ColumnBundle Cunit(1, basisUnit.nbasis*nSpinor, &basisUnit, &qnumUnit, isGpuEnabled());
-			ColumnBundle OCunit = Cunit.similar();
-			for(int b=0; b<eInfo.nBands; b++)
-			{	Cunit.zero(); cbt.gatherAxpy(1., C,b, Cunit,0);
-				OCunit.zero(); cbt.gatherAxpy(1., OC,b, OCunit,0);
-				unitWeights[q].push_back(trace(Cunit^OCunit).real());
+	{	const Basis& basis = e->basis[q];
+		if(qPrev<0 || basis.hash != e->basis[qPrev].hash || (eInfo.qnums[q].k - eInfo.qnums[qPrev].k).length_squared())
+		{	PeriodicLookup<vector3<>> plook(kUnit[q], gInfoUnit.GGT);
+			iUnit.resize(basis.nbasis);
+			const vector3<int>* iGarr = basis.iGarr.data();
+			for(size_t n=0; n<basis.nbasis; n++)
+			{	vector3<> k = (eInfo.qnums[q].k + iGarr[n]) * invM; //corresponding unit cell k
+				size_t iUnitCur = plook.find(k);
+				assert(iUnitCur != string::npos);
+				iUnit[n] = iUnitCur;
 			}
+			qPrev = q;
 		}
+		//Weights of all bands in one pass over the wavefunctions:
+		const ColumnBundle& C = e->eVars.C[q];
+		ColumnBundle OC = O(C);
+		unitWeights[q].assign(nUnits * eInfo.nBands, 0.);
+		threadLaunch(unfoldWeights_sub, eInfo.nBands, int(basis.nbasis), eInfo.spinorLength(), eInfo.nBands, iUnit.data(),
+			C.data(), OC.data(), unitWeights[q].data());
 	}
 	eInfo.write(unitWeights, fname.c_str(), nUnits*eInfo.nBands);
 	logPrintf("done\n"); logFlush();
@@ -0,0 +1,168 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/Dump.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <core/H5io.h>
+
+#ifdef HDF5_ENABLED
+
+//Single HDF5 file collecting the scalar field (and real-space wavefunction) output of one dump
+struct DumpH5
+{	string fname;
+	hid_t fid;
+	int compression; //gzip level (0 = uncompressed)
+
+	DumpH5(string fname, int compression) : fname(fname), compression(compression)
+	{	//Create file with MPI access across all processes:
+		hid_t plid = H5Pcreate(H5P_FILE_ACCESS);
+		H5Pset_fapl_mpio(plid, MPI_COMM_WORLD, MPI_INFO_NULL);
+		fid = H5Fcreate(fname.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plid);
+		if(fid<0) die("Could not open/create output HDF5 file '%s'\n", fname.c_str());
+		H5Pclose(plid);
+	}
+
+	~DumpH5()
+	{	H5Fclose(fid);
+	}
+
+	//Create a chunked (and optionally compressed) dataset (collective)
+	hid_t createDataset(const string& name, hid_t dataType, const hsize_t* dims, const hsize_t* chunk, int rank) const
+	{	hid_t sid = H5Screate_simple(rank, dims, NULL);
+		hid_t plid = H5Pcreate(H5P_DATASET_CREATE);
+		H5Pset_chunk(plid, rank, chunk);
+		if(compression) H5Pset_deflate(plid, compression);
+		hid_t did = H5Dcreate(fid, name.c_str(), dataType, sid, H5P_DEFAULT, plid, H5P_DEFAULT);
+		H5Pclose(plid);
+		H5Sclose(sid);
+		if(did<0) die("Could not create dataset '%s' in HDF5 file '%s'.\n", name.c_str(), fname.c_str());
+		return did;
+	}
+
+	//Collectively write the hyperslab at offset of size count from each process (count[0]=0 if none)
+	void writeSlab(hid_t did, hid_t dataType, const void* data, const hsize_t* offset, const hsize_t* count, int rank) const
+	{	hid_t sid = H5Dget_space(did);
+		hid_t sidMem = H5Screate_simple(rank, count, NULL);
+		if(count[0]) H5Sselect_hyperslab(sid, H5S_SELECT_SET, offset, NULL, count, NULL);
+		else { H5Sselect_none(sid); H5Sselect_none(sidMem); }
+		hid_t plid = H5Pcreate(H5P_DATASET_XFER);
+		H5Pset_dxpl_mpio(plid, H5FD_MPIO_COLLECTIVE); //collective I/O is required for compressed datasets
+		if(H5Dwrite(did, dataType, sidMem, sid, plid, data) < 0)
+			die("Error writing dataset in HDF5 file '%s'.\n", fname.c_str());
+		H5Pclose(plid);
+		H5Sclose(sidMem);
+		H5Sclose(sid);
+	}
+
+	//Write lattice, grid sample count and iteration (in atomic units)
+	void writeMetadata(const GridInfo& gInfo, int iter) const
+	{	std::vector<double> R; //row-major, with lattice vectors in columns
+		for(int j=0; j<3; j++) for(int k=0; k<3; k++) R.push_back(gInfo.R(j,k));
+		hsize_t dimsR[2] = { 3, 3 };
+		h5writeVector(fid, "R", R.data(), dimsR, 2);
+		h5writeVector(fid, "S", &gInfo.S[0], 3);
+		h5writeScalar(fid, "iter", iter);
+	}
+};
+
+void Dump::h5open()
+{	h5 = 0; //close any previous file
+	if(hdf5Compression < 0) return;
+	string fname = getFilename("h5");
+	logPrintf("Opening '%s' for HDF5 output.\n", fname.c_str()); logFlush();
+	h5 = std::make_shared<DumpH5>(fname, hdf5Compression);
+	h5->writeMetadata(e->gInfo, curIter);
+}
+
+void Dump::h5close()
+{	h5 = 0;
+}
+
+void Dump::h5write(const ScalarField& X, string name, bool singlePrecision)
+{	const GridInfo& gInfo = X->gInfo;
+	logPrintf("Dumping '%s' to '%s' ... ", name.c_str(), h5->fname.c_str()); logFlush();
+	hsize_t dims[3] = { hsize_t(gInfo.S[0]), hsize_t(gInfo.S[1]), hsize_t(gInfo.S[2]) };
+	hsize_t chunk[3] = { 1, dims[1], dims[2] }; //one plane per chunk
+	hid_t dataType = singlePrecision ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE;
+	hid_t did = h5->createDataset(name, dataType, dims, chunk, 3);
+	//Each process writes a contiguous range of planes (the full field is available on all processes):
+	TaskDivision planeDivision(gInfo.S[0], mpiWorld);
+	hsize_t offset[3] = { hsize_t(planeDivision.start()), 0, 0 };
+	hsize_t count[3] = { hsize_t(planeDivision.stop() - planeDivision.start()), dims[1], dims[2] };
+	const double* data = X->data() + offset[0]*dims[1]*dims[2];
+	if(singlePrecision)
+	{	std::vector<float> buf(data, data + count[0]*count[1]*count[2]);
+		h5->writeSlab(did, dataType, buf.data(), offset, count, 3);
+	}
+	else h5->writeSlab(did, dataType, data, offset, count, 3);
+	H5Dclose(did);
+	logPrintf("done\n"); logFlush();
+}
+
+void Dump::h5writeRealSpaceWfns()
+{	const ElecInfo& eInfo = e->eInfo;
+	const ElecVars& eVars = e->eVars;
+	const GridInfo& gInfoWfns = e->gInfoWfns ? *(e->gInfoWfns) : e->gInfo;
+	logPrintf("Dumping real-space wavefunctions to '%s' ... ", h5->fname.c_str()); logFlush();
+	std::vector<int> bStart, bStop;
+	realSpaceWfnsRanges(bStart, bStop);
+	h5writeVector(h5->fid, "wfnsRealSpaceBandStart", bStart);
+	hid_t gid = h5createGroup(h5->fid, "wfnsRealSpace");
+	int nSpinor = eInfo.spinorLength();
+	const vector3<int>& S = gInfoWfns.S;
+	hsize_t chunk[5] = { 1, 1, hsize_t(S[1]), hsize_t(S[2]), 2 }; //one plane of one column per chunk
+	for(int q=0; q<eInfo.nStates; q++) //collective over all states; only the owner writes each one
+	{	int nCols = (bStop[q] - bStart[q]) * nSpinor;
+		if(!nCols) continue;
+		ostringstream oss; oss << "wfnsRealSpace/" << q;
+		hsize_t dims[5] = { hsize_t(nCols), hsize_t(S[0]), hsize_t(S[1]), hsize_t(S[2]), 2 }; //complex as pairs of doubles
+		hid_t did = h5->createDataset(oss.str(), H5T_NATIVE_DOUBLE, dims, chunk, 5);
+		//Stream blocks of bands through batched FFTs (block size set by owner):
+		int nBatch = eInfo.isMine(q) ? fftBatchCols(eVars.C[q], 1) : 0;
+		mpiWorld->bcast(nBatch, eInfo.whose(q));
+		ManagedArray<complex> buf;
+		if(eInfo.isMine(q)) buf.init(gInfoWfns.nr*nSpinor*nBatch, isGpuEnabled()); //scratch space reused across blocks
+		for(int bBatch=bStart[q]; bBatch<bStop[q]; bBatch+=nBatch)
+		{	int bBatchStop = std::min(bBatch+nBatch, bStop[q]);
+			int nBoxes = (bBatchStop-bBatch)*nSpinor;
+			hsize_t offset[5] = { hsize_t((bBatch-bStart[q])*nSpinor), 0, 0, 0, 0 };
+			hsize_t count[5] = { hsize_t(nBoxes), dims[1], dims[2], dims[3], 2 };
+			if(eInfo.isMine(q))
+			{	eVars.C[q].getColumns(bBatch, bBatchStop, buf.dataPref());
+				I_batch(gInfoWfns, buf.dataPref(), nBoxes);
+			}
+			else count[0] = 0;
+			h5->writeSlab(did, H5T_NATIVE_DOUBLE, count[0] ? (const double*)buf.data() : 0, offset, count, 5);
+		}
+		H5Dclose(did);
+	}
+	H5Gclose(gid);
+	logPrintf("done\n"); logFlush();
+}
+
+#else //HDF5_ENABLED
+
+//Never invoked without HDF5 support (command dump-hdf5 is unavailable):
+void Dump::h5open() {}
+void Dump::h5close() {}
+void Dump::h5write(const ScalarField& X, string name, bool singlePrecision) { assert(!"HDF5 support not compiled in"); }
+void Dump::h5writeRealSpaceWfns() { assert(!"HDF5 support not compiled in"); }
+
+#endif //HDF5_ENABLED
@@ -0,0 +1,94 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/Dump.h>
+#include <electronic/Everything.h>
+#include <core/GpuUtil.h>
+#include <sys/resource.h>
+#include <cmath>
+
+//Open metrics stream (on head) and timings of the previous record
+struct MetricsState
+{	FILE* fp; //null except on head
+	std::map<string,double> tPrev; //wall time of previous record of each loop
+	double stateTimePrev; //local applyHamiltonian time at previous record (for load imbalance)
+	MetricsState() : fp(0), stateTimePrev(0.) {}
+	~MetricsState() { if(fp) fclose(fp); }
+};
+
+//Write a number as JSON (null if not finite)
+static void jsonNumber(FILE* fp, double x)
+{	if(std::isfinite(x)) fprintf(fp, "%.15lg", x);
+	else fprintf(fp, "null");
+}
+
+void Dump::metrics(const char* loop, int iter, double E, double residual, const std::vector<std::pair<const char*,double>>& extra)
+{	if(!metricsFilename.length()) return;
+	if(!metricsState)
+	{	metricsState = std::make_shared<MetricsState>();
+		if(mpiWorld->isHead())
+		{	metricsState->fp = fopen(metricsFilename.c_str(), "a");
+			if(!metricsState->fp) logPrintf("WARNING: could not open '%s' for the metrics stream.\n", metricsFilename.c_str());
+		}
+	}
+	MetricsState& ms = *metricsState;
+	double t = clock_sec();
+	
+	//Time per iteration (since previous record of the same loop):
+	auto tPrevIter = ms.tPrev.find(loop);
+	double dt = (tPrevIter==ms.tPrev.end()) ? NAN : t - tPrevIter->second;
+	ms.tPrev[loop] = t;
+	
+	//Load imbalance: maximum / mean over processes of Hamiltonian time on local states since the previous record:
+	double stateTimeCur = 0.;
+	const std::vector<double>& stateTime = e->eVars.stateTime;
+	for(int q=e->eInfo.qStart; q<std::min(e->eInfo.qStop, int(stateTime.size())); q++)
+		stateTimeCur += stateTime[q];
+	double stateTimeDelta = stateTimeCur - ms.stateTimePrev;
+	ms.stateTimePrev = stateTimeCur;
+	double stateTimeMax = stateTimeDelta, stateTimeSum = stateTimeDelta;
+	mpiWorld->allReduce(stateTimeMax, MPIUtil::ReduceMax);
+	mpiWorld->allReduce(stateTimeSum, MPIUtil::ReduceSum);
+	double imbalance = (stateTimeSum > 0.) ? stateTimeMax * mpiWorld->nProcesses() / stateTimeSum : NAN;
+	
+	//Peak memory (maximum over processes):
+	struct rusage usage; getrusage(RUSAGE_SELF, &usage);
+	double maxRSS = usage.ru_maxrss / 1024.; //in MB
+	mpiWorld->allReduce(maxRSS, MPIUtil::ReduceMax);
+	double gpuUsed = NAN;
+	#ifdef GPU_ENABLED
+	if(isGpuEnabled())
+	{	size_t memFree, memTotal; cudaMemGetInfo(&memFree, &memTotal);
+		gpuUsed = (memTotal - memFree) / 1048576.; //in MB
+		mpiWorld->allReduce(gpuUsed, MPIUtil::ReduceMax);
+	}
+	#endif
+	
+	//Write record:
+	if(!ms.fp) return;
+	fprintf(ms.fp, "{\"t\":%.3lf,\"loop\":\"%s\",\"iter\":%d,\"E\":", t, loop, iter); jsonNumber(ms.fp, E);
+	fprintf(ms.fp, ",\"residual\":"); jsonNumber(ms.fp, residual);
+	for(const auto& entry: extra) { fprintf(ms.fp, ",\"%s\":", entry.first); jsonNumber(ms.fp, entry.second); }
+	fprintf(ms.fp, ",\"dt\":"); jsonNumber(ms.fp, dt);
+	fprintf(ms.fp, ",\"imbalance\":"); jsonNumber(ms.fp, imbalance);
+	fprintf(ms.fp, ",\"maxRSS_MB\":%.1lf", maxRSS);
+	if(std::isfinite(gpuUsed)) fprintf(ms.fp, ",\"gpuUsed_MB\":%.1lf", gpuUsed);
+	fprintf(ms.fp, "}\n");
+	fflush(ms.fp);
+}
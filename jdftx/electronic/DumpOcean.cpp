@@ -41,74 +41,76 @@ void Dump::dumpOcean()
 	double sqrtvol=sqrt(e->gInfo.detR);
 
 	logPrintf("\nDumping Kohn-Sham orbitals for the OCEAN code:\n");
+	//Wrap k-points to [0,1) in the OCEAN convention, and list the files:
+	std::vector<vector3<>> kOut(nkPoints);
 	for(int ik=0; ik<nkPoints; ik++)
-	{
-		//Output filename for each k-point:
-		std::string fname = "kpoint" + std::to_string(ik);
-		logPrintf("\tDumping '%s' ... ", fname.c_str()); logFlush();
-		
-		//Initialize k-point transformation from JDFTx to OCEAN convention:
-		const Basis& basis = e->basis[ik];
-		const QuantumNumber& qnum = eInfo.qnums[ik];
-		vector3<> kOut = qnum.k;
-		logPrintf("at k = [ ");
+	{	kOut[ik] = eInfo.qnums[ik].k;
 		for(int j=0; j<3; j++)
-		{	//Wrap to [0,1)
-			kOut[j] -= floor(kOut[j]);
-			if(fabs(kOut[j] - 1.) < symmThreshold)
-				kOut[j] -= 1.; //make sure components ~ 0.9999 wrap to 0
-			logPrintf("%+.6f ", kOut[j]);
+		{	kOut[ik][j] -= floor(kOut[ik][j]);
+			if(fabs(kOut[ik][j] - 1.) < symmThreshold)
+				kOut[ik][j] -= 1.; //make sure components ~ 0.9999 wrap to 0
 		}
-		logPrintf("] "); logFlush();
-		vector3<int> kOffset = round(qnum.k - kOut);
+		logPrintf("\t'kpoint%d' at k = [ %+.6f %+.6f %+.6f ]\n", ik, kOut[ik][0], kOut[ik][1], kOut[ik][2]);
+	}
+	logPrintf("\tWriting files ... "); logFlush();
+	
+	//Send wavefunctions of other spin channels to the owner of the first spin channel at each k (asynchronously):
+	//(Messages between a pair of processes with the same tag arrive in order of ik, which the receives below follow)
+	std::vector<MPIUtil::Request> requests;
+	for(int q=std::max(eInfo.qStart,nkPoints); q<eInfo.qStop; q++)
+	{	int ik = q % nkPoints, s = q / nkPoints;
+		if(!eInfo.isMine(ik))
+		{	requests.push_back(MPIUtil::Request());
+			mpiWorld->sendData(eVars.C[q], eInfo.whose(ik), s, &requests.back()); //use spin as a tag
+		}
+	}
+	
+	//Write the k-points whose first spin channel is local, independently on each process:
+	std::vector<vector3<int>> iGout;
+	std::vector<double> buf;
+	for(int ik=eInfo.qStart; ik<std::min(eInfo.qStop,nkPoints); ik++)
+	{	const Basis& basis = e->basis[ik];
+		const QuantumNumber& qnum = eInfo.qnums[ik];
+		vector3<int> kOffset = round(qnum.k - kOut[ik]);
+		std::string fname = "kpoint" + std::to_string(ik);
+		FILE *fp = fopen(fname.c_str(), "wb");
+		if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
 		
-		if(eInfo.isMine(ik)) //All the writing happens from the process that owns the first spin channel
-		{
-			//Open the file:
-			FILE *fp = fopen(fname.c_str(), "wb");
-			if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
-			
-			//Write header:
-			int nbasis = basis.nbasis; //cast nbasis to int
-			fwriteLE(&nbasis, sizeof(int), 1, fp); //Number of G-vectors
-			for(const vector3<int>& iGin: basis.iGarr)
-			{	vector3<int> iGout = iGin + kOffset;
-				fwriteLE(&iGout, sizeof(int), 3, fp); //List of G-vectors
-			}
-			
-			//Collect relevant wavefunctions:
-			std::vector<ColumnBundle> CkTemp(nSpins);
-			std::vector<const ColumnBundle*> Ck(nSpins);
-			for(int s=0; s<nSpins; s++)
-			{	int q = ik + nkPoints*s; //net quantum number
-				if(eInfo.isMine(q))
-					Ck[s] = &eVars.C[q];
-				else
-				{	Ck[s] = &CkTemp[s];
-					CkTemp[s].init(eInfo.nBands, nbasis, &basis, &qnum);
-					mpiWorld->recvData(CkTemp[s], eInfo.whose(q), s);
-				}
+		//Write header:
+		int nbasis = basis.nbasis; //cast nbasis to int
+		fwriteLE(&nbasis, sizeof(int), 1, fp); //Number of G-vectors
+		iGout.resize(nbasis);
+		const vector3<int>* iGin = basis.iGarr.data();
+		for(int n=0; n<nbasis; n++)
+			iGout[n] = iGin[n] + kOffset;
+		fwriteLE(iGout.data(), sizeof(int), 3*nbasis, fp); //List of G-vectors
+		
+		//Collect relevant wavefunctions:
+		std::vector<ColumnBundle> CkTemp(nSpins);
+		std::vector<const ColumnBundle*> Ck(nSpins);
+		for(int s=0; s<nSpins; s++)
+		{	int q = ik + nkPoints*s; //net quantum number
+			if(eInfo.isMine(q))
+				Ck[s] = &eVars.C[q];
+			else
+			{	Ck[s] = &CkTemp[s];
+				CkTemp[s].init(eInfo.nBands, nbasis, &basis, &qnum);
+				mpiWorld->recvData(CkTemp[s], eInfo.whose(q), s);
 			}
-			
-			//Write wavefunctions:
-			std::vector<complex> phases(2);
-			phases[0] = complex(+sqrtvol, 0); //normalize and get real part below
-			phases[1] = complex(0, -sqrtvol); //normalize and get imag part below
-			for(complex phase: phases) //loop over real/imag part
-				for(const ColumnBundle* Cq: Ck) //loop over spin
-					(phase * (*Cq)).write_real(fp); //outer loop over bands, inner loop over G-vectors
-			
-			fclose(fp);
-			
 		}
-		else //Send wavefunctions to the owner of the first spin channel at this k
-		{
-			for(int s=0; s<nSpins; s++)
-			{	int q = ik + nkPoints*s; //net quantum number
-				if(eInfo.isMine(q))
-					mpiWorld->sendData(eVars.C[q], eInfo.whose(ik), s); //use spin as a tag
+		
+		//Write wavefunctions: real parts of all spins, followed by imaginary parts of all spins
+		//(normalized; outer loop over bands, inner loop over G-vectors within each spin)
+		for(int iPart=0; iPart<2; iPart++) //loop over real/imag part
+			for(const ColumnBundle* Cq: Ck) //loop over spin
+			{	const double* CqData = ((const double*)Cq->data()) + iPart;
+				buf.resize(Cq->nData());
+				for(size_t i=0; i<buf.size(); i++)
+					buf[i] = sqrtvol * CqData[2*i];
+				fwriteLE(buf.data(), sizeof(double), buf.size(), fp);
 			}
-		}
-		logPrintf("done.\n"); logFlush();
+		fclose(fp);
 	}
+	MPIUtil::waitAll(requests);
+	logPrintf("done.\n"); logFlush();
 }
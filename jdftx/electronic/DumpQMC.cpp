@@ -29,6 +29,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarFieldIO.h>
 #include <config.h>
 #include <map>
+#include <thread>
+#include <cstdarg>
 
 int nAtomsTot(const IonInfo& iInfo)
 {	unsigned res=0;
@@ -99,6 +101,74 @@ struct ImagPartMinimizer: public Minimizable<ElecGradient>  //Uses only the Haux
 	double sync(double x) const { mpiWorld->bcast(x); return x; } //!< All processes minimize together; make sure scalars are in sync to round-off error
 };
 
+//Append printf-formatted text to s
+static void appendPrintf(std::string& s, const char* format, ...)
+{	char buf[1024];
+	va_list ap; va_start(ap, format);
+	vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+	s += buf;
+}
+
+//Format blip coefficients one per line (same as the precision-12 scientific stream output), threaded over chunks
+static void formatBlipCoeffs_sub(size_t jStart, size_t jStop, size_t nChunks, size_t N, const complex* data, bool realOnly, std::string* chunks)
+{	char buf[64];
+	for(size_t j=jStart; j<jStop; j++)
+	{	size_t iStart = (N*j)/nChunks, iStop = (N*(j+1))/nChunks;
+		std::string& out = chunks[j];
+		out.reserve((iStop-iStart) * (realOnly ? 22 : 44));
+		for(size_t i=iStart; i<iStop; i++)
+		{	int len = realOnly
+				? snprintf(buf, sizeof(buf), "  %.12e\n", data[i].real())
+				: snprintf(buf, sizeof(buf), "  (%.12e,%.12e)\n", data[i].real(), data[i].imag());
+			out.append(buf, len);
+		}
+	}
+}
+
+//Convert band b of state q to blips, and return its bwfn.data block and log report (run on the process owning q)
+static void processOrbitalQMC(const ColumnBundle& Cq, int q, int b, int bandIndex, int spinIndex, double eig, bool realOrbitals,
+	const BlipConverter& blipConvert, const ScalarField& Vdiel, const ScalarField& VdielBlip, bool reportVdiel,
+	std::string& block, std::string& report)
+{	const GridInfo& gInfo = Vdiel->gInfo;
+	appendPrintf(report, "\tProcessing state %3d band %3d:\n", q, b);
+	appendPrintf(block, " Band, spin, eigenvalue (au), localized\n  %d %d %.12e F\n %s blip coefficients for extended orbitals\n",
+		bandIndex, spinIndex, eig, realOrbitals ? "Real" : "Complex");
+	//Get orbital in real space
+	complexScalarField phi = I(Cq.getColumn(b,0));
+	//Compute kinetic and potential energy (in Vdiel) of original PW orbitals:
+	double Tpw = -0.5*dot(phi, Jdag(L(J(phi)))).real();
+	double Vpw = gInfo.dV*dot(phi, Vdiel*phi).real();
+	//Adjust phase, convert to blip and output in appropriate format:
+	if(realOrbitals)
+	{	//Convert orbital to real:
+		double phaseMean, phaseSigma, imagErrorRMS;
+		removePhase(gInfo.nr, phi->data(), phaseMean, phaseSigma, imagErrorRMS);
+		appendPrintf(report, "\t\tPhase = %lf +/- %lf\n", phaseMean, phaseSigma);
+		appendPrintf(report, "\t\tImagErrorRMS = %le\n", imagErrorRMS);
+	}
+	phi = blipConvert(phi);
+	size_t nChunks = nProcsAvailable;
+	std::vector<std::string> chunks(nChunks);
+	threadLaunch(formatBlipCoeffs_sub, nChunks, nChunks, size_t(gInfo.nr), (const complex*)phi->data(), realOrbitals, chunks.data());
+	for(std::string& chunk: chunks)
+	{	block += chunk;
+		chunk.clear(); chunk.shrink_to_fit();
+	}
+	//Compare PW and Blip kinetic and potential energies
+	double tMax; int i0max, i1max, i2max;
+	double Tblip = ::Tblip(phi, &tMax, &i0max, &i1max, &i2max);
+	appendPrintf(report, "\t\tKinetic Energy    (PW)    = %.12le\n", Tpw);
+	appendPrintf(report, "\t\tKinetic Energy    (Blip)  = %.12le (Ratio = %.6lf)\n", Tblip, Tblip/Tpw);
+	appendPrintf(report, "\t\tMax local KE      (Blip)  = %.12le at cell#(%d,%d,%d)\n", tMax, i0max, i1max, i2max);
+	if(reportVdiel)
+	{	//Vdiel potential contribution only when Adiel is non-zero
+		double Vblip = ::Vblip(phi, VdielBlip);
+		appendPrintf(report, "\t\tInt Vdiel.|phi^2| (PW)    = %.12le\n", Vpw);
+		appendPrintf(report, "\t\tInt Vdiel.|phi^2| (Blip)  = %.12le (Ratio = %.6lf)\n", Vblip, Vblip/Vpw);
+	}
+}
+
 void Dump::dumpQMC()
 {
 	const IonInfo &iInfo = e->iInfo;
@@ -293,9 +363,14 @@ void Dump::dumpQMC()
 		}
 	}
 	
+	//Orbitals are processed by the process that owns each state, and head writes the output block
+	//of each orbital in a background thread while the next one is processed (or received):
+	std::thread writer; std::string blockWriting;
+	auto waitWriter = [&]() { if(writer.joinable()) writer.join(); };
 	for(int ik=0; ik<nkPoints; ik++)
 	{
 		vector3<> k(eInfo.qnums[ik].k * gInfo.G); //cartesian k-vector
+		waitWriter();
 		ofs <<
 			" k-point # ; # of bands (up spin/down spin) ; k-point coords (au)\n"
 			"  " << ik+1 << " " << eInfo.nBands << " " << (nSpins==2 ? eInfo.nBands : 0)
@@ -304,94 +379,51 @@ void Dump::dumpQMC()
 		{
 			int spinIndex = 1-2*s;
 			int q = ik + nkPoints*s; //net quantum number
+			bool mine = eInfo.isMine(q);
+			if(!(mine || mpiWorld->isHead())) continue;
 			
-			//Get relevant wavefunctions and eigenvalues (from another process if necessary)
-			ColumnBundle CqTemp; diagMatrix Hsub_eigsqTemp;
-			const ColumnBundle* Cq=0; const diagMatrix* Hsub_eigsq=0;
-			if(mpiWorld->isHead())
-			{	if(eInfo.isMine(q))
-				{	Cq = &eVars.C[q];
-					Hsub_eigsq = &eVars.Hsub_eigs[q];
-				}
-				else
-				{	Cq = &CqTemp;
-					CqTemp.init(eInfo.nBands, e->basis[q].nbasis, &e->basis[q], &eInfo.qnums[q]);
-					mpiWorld->recvData(CqTemp, eInfo.whose(q), q);
-					Hsub_eigsq = &Hsub_eigsqTemp;
-					Hsub_eigsqTemp.resize(eInfo.nBands);
-					mpiWorld->recvData(Hsub_eigsqTemp, eInfo.whose(q), q);
-					if(Udeg.size())
-					{	Udeg[q].init(eInfo.nBands, eInfo.nBands);
-						mpiWorld->recvData(Udeg[q], eInfo.whose(q), q);
-					}
-				}
-			}
-			else
-			{	if(eInfo.isMine(q))
-				{	mpiWorld->sendData(eVars.C[q], 0, q);
-					mpiWorld->sendData(eVars.Hsub_eigs[q], 0, q);
-					if(Udeg.size()) mpiWorld->sendData(Udeg[q], 0, q);
+			//Apply degeneracy rotations (if any) on the process owning the state:
+			ColumnBundle CqRot; const ColumnBundle* Cq = 0;
+			if(mine)
+			{	Cq = &eVars.C[q];
+				if(Udeg.size())
+				{	CqRot = (*Cq) * Udeg[q];
+					Cq = &CqRot;
 				}
-				continue; //only head performs computation below
-			}
-			
-			//Apply degeneracy rotations (if any):
-			if(Udeg.size())
-			{	CqTemp = (*Cq) * Udeg[q];
-				Cq = &CqTemp;
 			}
 			
 			//Loop over bands
-			for (int b=0; b < eInfo.nBands; b++)
-			{
-				logPrintf("\tProcessing state %3d band %3d:\n", q, b); logFlush();
-				int bandIndex = b+1 + s*eInfo.nBands;
-				ofs <<
-					" Band, spin, eigenvalue (au), localized\n"
-					"  " << bandIndex << " " << spinIndex << " " << Hsub_eigsq->at(b) << " F\n"
-					" " << (nkPoints==1 ? "Real" : "Complex") << " blip coefficients for extended orbitals\n";
-				//Get orbital in real space
-				complexScalarField phi = I(Cq->getColumn(b,0));
-				//Compute kinetic and potential energy (in Vdiel) of original PW orbitals:
-				double Tpw = -0.5*dot(phi, Jdag(L(J(phi)))).real();
-				double Vpw = gInfo.dV*dot(phi, Vdiel*phi).real();
-				//Adjust phase, convert to blip and output in appropriate format:
-				if(nkPoints==1)
-				{	//Convert orbital to real:
-					double phaseMean, phaseSigma, imagErrorRMS;
-					removePhase(gInfo.nr, phi->data(), phaseMean, phaseSigma, imagErrorRMS);
-					logPrintf("\t\tPhase = %lf +/- %lf\n", phaseMean, phaseSigma); logFlush();
-					logPrintf("\t\tImagErrorRMS = %le\n", imagErrorRMS); logFlush();
-					//Convert PW to blip and output:
-					phi = blipConvert(phi);
-					complex* phiData = phi->data();
-					for(int i=0; i<gInfo.nr; i++)
-						ofs << "  " << phiData[i].real() << "\n";
-				}
-				else
-				{	//Convert PW to blip:
-					phi = blipConvert(phi); complex* phiData = phi->data();
-					//Output:
-					for(int i=0; i<gInfo.nr; i++)
-						ofs << "  (" << phiData[i].real() << "," << phiData[i].imag() << ")\n";
+			for(int b=0; b < eInfo.nBands; b++)
+			{	int bandIndex = b+1 + s*eInfo.nBands;
+				std::string block, report;
+				if(mine)
+					processOrbitalQMC(*Cq, q, b, bandIndex, spinIndex, eVars.Hsub_eigs[q][b], nkPoints==1,
+						blipConvert, Vdiel, VdielBlip, A_diel, block, report);
+				if(mpiWorld->isHead())
+				{	if(!mine) //receive from owner
+					{	unsigned long len;
+						mpiWorld->recv(len, eInfo.whose(q), q); report.resize(len);
+						mpiWorld->recv(&report[0], len, eInfo.whose(q), q);
+						mpiWorld->recv(len, eInfo.whose(q), q); block.resize(len);
+						mpiWorld->recv(&block[0], len, eInfo.whose(q), q);
+					}
+					logPrintf("%s", report.c_str()); logFlush();
+					waitWriter();
+					std::swap(blockWriting, block);
+					writer = std::thread([&ofs, &blockWriting]() { ofs.write(blockWriting.data(), blockWriting.size()); });
 				}
-				//Compare PW and Blip kinetic and potential energies
-				double tMax; int i0max, i1max, i2max;
-				double Tblip = ::Tblip(phi, &tMax, &i0max, &i1max, &i2max);
-				logPrintf("\t\tKinetic Energy    (PW)    = %.12le\n", Tpw);
-				logPrintf("\t\tKinetic Energy    (Blip)  = %.12le (Ratio = %.6lf)\n", Tblip, Tblip/Tpw);
-				logPrintf("\t\tMax local KE      (Blip)  = %.12le at cell#(%d,%d,%d)\n", tMax, i0max, i1max, i2max);
-				logFlush();
-				if(A_diel)
-				{	//Vdiel potential contribution only when Adiel is non-zero
-					double Vblip = ::Vblip(phi, VdielBlip);
-					logPrintf("\t\tInt Vdiel.|phi^2| (PW)    = %.12le\n", Vpw);
-					logPrintf("\t\tInt Vdiel.|phi^2| (Blip)  = %.12le (Ratio = %.6lf)\n", Vblip, Vblip/Vpw);
-					logFlush();
+				else //send to head
+				{	unsigned long len = report.size();
+					mpiWorld->send(len, 0, q);
+					mpiWorld->send(report.data(), len, 0, q);
+					len = block.size();
+					mpiWorld->send(len, 0, q);
+					mpiWorld->send(block.data(), len, 0, q);
 				}
 			}
 		}
 	}
+	waitWriter();
 	logPrintf("\tDone.\n"); logFlush();
 	ofs.close();
 }
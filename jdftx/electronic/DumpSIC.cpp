@@ -29,62 +29,72 @@ DumpSelfInteractionCorrection::DumpSelfInteractionCorrection(const Everything& e
 }
 
 double DumpSelfInteractionCorrection::operator()(std::vector<diagMatrix>* correctedEigenvalues)
-{
-	// Loop over all quantum numbers (spin+kpoint) and bands; and corrects their eigenvalues
+{	static StopWatch watch("DumpSelfInteractionCorrection"); watch.start();
+	// Loop over local quantum numbers (spin+kpoint) and blocks of bands; and correct their eigenvalues
+	// (each process handles its own states, with the energies evaluated process-locally, and only the total reduced)
+	const ElecInfo& eInfo = e->eInfo;
 	double selfInteractionEnergy = 0;
-	DC.resize(3);
-	for(int q=0; q<e->eInfo.nStates; q++) //need to loop over all states since XC is MPI parallelized
-	{	if(e->exCorr.needsKEdensity() && e->eInfo.isMine(q))
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	const ColumnBundle& Cq = e->eVars.C[q];
+		if(e->exCorr.needsKEdensity())
+		{	DC.resize(3);
 			for(int iDir=0; iDir<3; iDir++)
-				DC[iDir] = D(e->eVars.C[q], iDir);
-		if(e->eInfo.isMine(q) && correctedEigenvalues)
-			(*correctedEigenvalues)[q].resize(e->eInfo.nBands);
-		for(int n=0; n<e->eInfo.nBands; n++)
-		{	double selfInteractionError = calcSelfInteractionError(q,n);
-			if(e->eInfo.isMine(q))
+				DC[iDir] = D(Cq, iDir);
+		}
+		if(correctedEigenvalues)
+			(*correctedEigenvalues)[q].resize(eInfo.nBands);
+		int nBandsBlock = fftBatchCols(Cq, 1); //orbital densities computed together in batched FFTs
+		for(int bStart=0; bStart<eInfo.nBands; bStart+=nBandsBlock)
+		{	int bStop = std::min(bStart+nBandsBlock, eInfo.nBands);
+			std::vector<double> selfInteractionError = calcSelfInteractionErrors(q, bStart, bStop);
+			for(int n=bStart; n<bStop; n++)
 			{	if(correctedEigenvalues)
-					(*correctedEigenvalues)[q][n] = e->eVars.Hsub_eigs[q][n] - selfInteractionError;
-				selfInteractionEnergy += e->eVars.F[q][n]*e->eInfo.qnums[q].weight*selfInteractionError;
+					(*correctedEigenvalues)[q][n] = e->eVars.Hsub_eigs[q][n] - selfInteractionError[n-bStart];
+				selfInteractionEnergy += e->eVars.F[q][n]*eInfo.qnums[q].weight*selfInteractionError[n-bStart];
 			}
 		}
 	}
 	DC.clear();
 	mpiWorld->allReduce(selfInteractionEnergy, MPIUtil::ReduceSum);
+	watch.stop();
 	return selfInteractionEnergy;
-	
 }
 
-double DumpSelfInteractionCorrection::calcSelfInteractionError(int q, int n)
+std::vector<double> DumpSelfInteractionCorrection::calcSelfInteractionErrors(int q, int bStart, int bStop)
 {
-	// Get the real-space orbital density
-	ScalarField orbitalDensity; nullToZero(orbitalDensity, e->gInfo);
-	if(e->eInfo.isMine(q))
-		orbitalDensity = diagouterI(eye(1), e->eVars.C[q].getSub(n,n+1), 1, &e->gInfo)[0];
-	orbitalDensity->bcastData(mpiWorld, e->eInfo.whose(q));
-	ScalarFieldTilde orbitalDensityTilde = J(orbitalDensity);
-	
-	// Calculate the Coulomb energy
-	ScalarFieldTilde VorbitalTilde = (*e->coulomb)(orbitalDensityTilde);
-	double coulombEnergy = 0.5*dot(orbitalDensityTilde, O(VorbitalTilde));
-	
-	// Sets up the spin dependent density for the orbital
-	ScalarFieldArray orbitalSpinDensity(2);
-	orbitalSpinDensity[0] = orbitalDensity;
-	nullToZero(orbitalSpinDensity[1], e->gInfo);
+	// Get the real-space orbital densities of the block (one batched pass over its columns)
+	int nBandsBlock = bStop - bStart;
+	std::vector<diagMatrix> Fsel(nBandsBlock, diagMatrix(nBandsBlock, 0.)); //unit filling selecting each orbital
+	for(int b=0; b<nBandsBlock; b++) Fsel[b][b] = 1.;
+	std::vector<ScalarFieldArray> orbitalDensity = diagouterI(Fsel, e->eVars.C[q].getSub(bStart,bStop), 1, &e->gInfo);
 	
-	// Calculate the orbital KE if needed
-	ScalarFieldArray KEdensity(2);
+	// Calculate the orbital KE densities if needed
+	std::vector<ScalarFieldArray> KEdensity(nBandsBlock, ScalarFieldArray(2));
 	if(e->exCorr.needsKEdensity())
-	{	nullToZero(KEdensity, e->gInfo);
-		if(e->eInfo.isMine(q))
-			for(int iDir=0; iDir<3; iDir++)
-				KEdensity[0] += 0.5 * diagouterI(eye(1), DC[iDir].getSub(n,n+1), 1, &e->gInfo)[0];
-		KEdensity[0]->bcastData(mpiWorld, e->eInfo.whose(q));
+	{	for(ScalarFieldArray& KEb: KEdensity) nullToZero(KEb, e->gInfo);
+		for(int iDir=0; iDir<3; iDir++)
+		{	std::vector<ScalarFieldArray> DCdensity = diagouterI(Fsel, DC[iDir].getSub(bStart,bStop), 1, &e->gInfo);
+			for(int b=0; b<nBandsBlock; b++)
+				KEdensity[b][0] += 0.5 * DCdensity[b][0];
+		}
 	}
-
-	double xcEnergy = e->exCorr(orbitalSpinDensity, 0, IncludeTXC(), &KEdensity, 0);
 	
-	return coulombEnergy + xcEnergy;
+	std::vector<double> selfInteractionError(nBandsBlock);
+	for(int b=0; b<nBandsBlock; b++)
+	{	// Calculate the Coulomb energy
+		ScalarFieldTilde orbitalDensityTilde = J(orbitalDensity[b][0]);
+		ScalarFieldTilde VorbitalTilde = (*e->coulomb)(orbitalDensityTilde);
+		double coulombEnergy = 0.5*dot(orbitalDensityTilde, O(VorbitalTilde));
+		
+		// Sets up the spin dependent density for the orbital
+		ScalarFieldArray orbitalSpinDensity(2);
+		orbitalSpinDensity[0] = orbitalDensity[b][0];
+		nullToZero(orbitalSpinDensity[1], e->gInfo);
+		
+		double xcEnergy = e->exCorr(orbitalSpinDensity, 0, IncludeTXC(), &KEdensity[b], 0, true); //process-local evaluation
+		selfInteractionError[b] = coulombEnergy + xcEnergy;
+	}
+	return selfInteractionError;
 }
 
 DumpSelfInteractionCorrection::~DumpSelfInteractionCorrection()
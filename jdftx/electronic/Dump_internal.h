@@ -44,7 +44,7 @@ public:
 	bool needsTau;  //!< The kinetic energy density is needed for meta-gga functionals.
 private:
 	const Everything* e;
-	double calcSelfInteractionError(int q, int n); //!< Calculates the self-interaction error of the KS orbital atthe n'th band at q'th quantum number
+	std::vector<double> calcSelfInteractionErrors(int q, int bStart, int bStop); //!< Calculates the self-interaction errors of the KS orbitals of bands bStart to bStop-1 at the (local) q'th quantum number
 	std::vector<ColumnBundle> DC; //!< ColumnBundle for the derivative of the wavefunctions in each cartesian direction
 };
 
@@ -115,6 +115,7 @@ struct BGWparams
 {	int nBandsDense; //!< if non-zero, use a dense ScaLAPACK solver to calculate more bands
 	int blockSize; //!< block size for ScaLAPACK diagonalization
 	int clusterSize; //!< maximum eigenvalue cluster size to allocate extra ScaLAPACK workspace for
+	int nBandsChunk; //!< if non-zero, maximum number of bands per collective wavefunction write (bounds the write buffer)
 	
 	double EcutChiFluid; //!< KE cutoff for fluid polarizability output (enabled if non-zero)
 	vector3<> q0; //!< zero wavevector replacement used for polarizability output
@@ -124,7 +125,7 @@ struct BGWparams
 	int freqNimag; //!< number of imaginary frequencies
 	double freqPlasma; //!< plasma frequency in Hartrees used in GW imaginary frequency grid, set to zero for RPA frequency grid
 	
-	BGWparams() : nBandsDense(0), blockSize(32), clusterSize(10),
+	BGWparams() : nBandsDense(0), blockSize(32), clusterSize(10), nBandsChunk(0),
 		EcutChiFluid(0.), freqReMax_eV(30.), freqReStep_eV(1.), freqBroaden_eV(0.1),
 		freqNimag(25), freqPlasma(1.)
 	{}
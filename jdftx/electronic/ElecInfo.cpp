@@ -20,6 +20,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/ElecInfo.h>
 #include <electronic/Everything.h>
 #include <electronic/SpeciesInfo.h>
+#include <electronic/Basis.h>
 #include <core/matrix.h>
 #include <fluid/Euler.h>
 #include <algorithm>
@@ -38,7 +39,7 @@ ElecInfo::ElecInfo()
 fillingsUpdate(FillingsConst), scalarFillings(true),
 smearingType(SmearingFermi), smearingWidth(1e-3),
 mu(NAN), Bz(NAN), muLoop(false),
-hasU(false), nBandsOld(0),
+hasU(false), stateBalance(BalanceUniform), nBandsOld(0),
 Qinitial(0.), Minitial(0.)
 {
 }
@@ -60,8 +61,26 @@ void ElecInfo::setup(const Everything &everything, std::vector<diagMatrix>& F, E
 	nStates = qnums.size();
 	
 	//Determine distribution amongst processes:
-	qDivision.init(nStates, mpiWorld);
+	if(stateBalance==BalanceUniform || mpiWorld->nProcesses()==1)
+		qDivision.init(nStates, mpiWorld);
+	else
+	{	qDivision.init(getStateCosts(), mpiWorld);
+		logPrintf("Balanced %d states over %d processes by %s.\n", nStates, mpiWorld->nProcesses(),
+			stateBalance==BalanceMeasured ? "measured cost" : "basis size");
+	}
 	qDivision.myRange(qStart, qStop);
+	{	//Group processes without states with the owner of the next state (as for exact exchange band groups):
+		int iGroup = whose(std::min(qStart, nStates-1));
+		mpiStateGroup = std::make_shared<MPIUtil>(0, (char**)0, MPIUtil::ProcDivision(mpiWorld, 0, iGroup));
+		qStartGroup = qStartOther(iGroup);
+		qStopGroup = qStopOther(iGroup);
+		iStateGroupOwner = (qStop > qStart) ? mpiStateGroup->iProcess() : 0;
+		mpiStateGroup->allReduce(iStateGroupOwner, MPIUtil::ReduceMax);
+		int nGroupMax = mpiStateGroup->nProcesses();
+		mpiWorld->allReduce(nGroupMax, MPIUtil::ReduceMax);
+		if(nGroupMax > 1)
+			logPrintf("Sharing dense subspace linear algebra over up to %d processes per state.\n", nGroupMax);
+	}
 	
 	//Allocate the fillings matrices.
 	F.resize(nStates);
@@ -347,73 +366,107 @@ matrix ElecInfo::smearGrad(double mu, const diagMatrix& eps, const matrix& gradF
 }
 
 
-//Number of electrons and magnetization in a fermi distribution of given mu, Bz and eigenvalues:
-double ElecInfo::magnetizationCalc(double mu, double Bz, const std::vector<diagMatrix>& eps, double& N) const
-{	N = 0.;
-	double M = 0.;
+std::vector<diagMatrix> ElecInfo::gatherEigs(const std::vector<diagMatrix>& eps) const
+{	//Collect number of eigenvalues per state and hence offsets into a flat array:
+	std::vector<int> nEigs(nStates, 0);
+	for(int q=qStart; q<qStop; q++) nEigs[q] = eps[q].size();
+	mpiWorld->allReduceData(nEigs, MPIUtil::ReduceSum);
+	std::vector<size_t> offset(nStates+1, 0);
+	for(int q=0; q<nStates; q++) offset[q+1] = offset[q] + nEigs[q];
+	//Gather eigenvalues:
+	std::vector<double> epsFlat(offset[nStates], 0.);
 	for(int q=qStart; q<qStop; q++)
+		std::copy(eps[q].begin(), eps[q].end(), epsFlat.begin()+offset[q]);
+	mpiWorld->allReduceData(epsFlat, MPIUtil::ReduceSum);
+	std::vector<diagMatrix> epsAll(nStates);
+	for(int q=0; q<nStates; q++)
+		epsAll[q].assign(epsFlat.begin()+offset[q], epsFlat.begin()+offset[q+1]);
+	return epsAll;
+}
+
+//Number of electrons and magnetization in a fermi distribution of given mu, Bz and eigenvalues of all states:
+double ElecInfo::magnetizationCalc(double mu, double Bz, const std::vector<diagMatrix>& epsAll, double& N, double* dNdmu, double* dMdBz) const
+{	N = 0.;
+	double M = 0., dN = 0., dM = 0.;
+	for(int q=0; q<nStates; q++)
 	{	double s = qnums[q].spin;
+		double w = qnums[q].weight;
 		double muEff = this->muEff(mu, Bz, q);
-		for(double epsCur: eps[q])
-		{	double wf = qnums[q].weight * smear(muEff, epsCur);
+		for(double epsCur: epsAll[q])
+		{	double wf = w * smear(muEff, epsCur);
 			N += wf;
 			M += s * wf;
+			if(dNdmu || dMdBz)
+			{	double wfPrime = -w * smearPrime(muEff, epsCur); //derivative w.r.t muEff
+				dN += wfPrime;
+				dM += s * s * wfPrime;
+			}
 		}
 	}
-	mpiWorld->allReduce(N, MPIUtil::ReduceSum, true);
-	mpiWorld->allReduce(M, MPIUtil::ReduceSum, true);
+	if(dNdmu) *dNdmu = dN;
+	if(dMdBz) *dMdBz = dM;
 	return M;
 }
 
-//Calculate nElectrons at given mu, bisecting on Bz if M is constrained
+//Solve F(x) = target for an increasing function F (which returns the value and sets the derivative),
+//using Newton steps safeguarded by bisection within a bracket that is first expanded from [xMin,xMax]
+template<typename Func> double solveIncreasing(const Func& F, double target, double xMin, double xMax,
+	double fTol, double xTolAbs, double xTolRel, bool verbose, const char* label, const char* xName, const char* fName)
+{	double dF;
+	//Find a range which is known to bracket the result:
+	while(F(xMin,dF)>=target+fTol) xMin-=(xMax-xMin);
+	while(F(xMax,dF)<=target-fTol) xMax+=(xMax-xMin);
+	//Newton-bisection:
+	double xTol = std::max(xTolAbs, xTolRel*std::max(fabs(xMin),fabs(xMax)));
+	double x = 0.5*(xMin + xMax);
+	while(xMax-xMin>=xTol)
+	{	double f = F(x, dF);
+		if(verbose) logPrintf("%s: %s = [ %.15le %.15le %.15le ]  %s = %le\n", label, xName, xMin, x, xMax, fName, f);
+		if(f>target) xMax = x;
+		else xMin = x;
+		double dx = (dF>0.) ? (target-f)/dF : NAN;
+		if(std::isnan(dx) || x+dx<=xMin || x+dx>=xMax)
+			x = 0.5*(xMin + xMax); //bisect when Newton step fails or leaves the bracket
+		else
+		{	x += dx;
+			if(fabs(dx)<xTol) break; //Newton step converged
+		}
+	}
+	return x;
+}
+
+//Calculate nElectrons at given mu, solving for Bz if M is constrained
 double ElecInfo::nElectronsCalc(double mu, const std::vector< diagMatrix >& eps, double& Bz) const
+{	return nElectronsCalcAll(mu, gatherEigs(eps), Bz);
+}
+
+double ElecInfo::nElectronsCalcAll(double mu, const std::vector< diagMatrix >& epsAll, double& Bz, double* dNdmu) const
 {	double N = 0.;
 	Bz = this->Bz; //target value or NAN
 	if(std::isnan(Bz)) //Fixed magnetization
 	{	const bool& verbose = e->cntrl.shouldPrintMuSearch;
-		if(verbose) logPrintf("\nBisecting to find Bz(M=%5lf)\n", Minitial);
-		//Find a range which is known to bracket the result:
+		if(verbose) logPrintf("\nSolving for Bz(M=%5lf)\n", Minitial);
 		const double absTol = 1e-10, relTol = 1e-14;
 		double Mtol = std::max(absTol, relTol*fabs(Minitial));
-		double BzMin=-0.1, BzMax=+0.1;
-		while(magnetizationCalc(mu,BzMin,eps,N)>=Minitial+Mtol) BzMin-=(BzMax-BzMin);
-		while(magnetizationCalc(mu,BzMax,eps,N)<=Minitial-Mtol) BzMax+=(BzMax-BzMin);
-		//Bisect:
-		double BzTol = std::max(absTol*smearingWidth, relTol*std::max(fabs(BzMin),fabs(BzMax)));
-		while(BzMax-BzMin>=BzTol)
-		{	double Bz = 0.5*(BzMin + BzMax);
-			double M = magnetizationCalc(mu, Bz, eps, N);
-			if(verbose) logPrintf("BzBISECT: Bz = [ %.15le %.15le %.15le ]  M = %le\n", BzMin, Bz, BzMax, M);
-			if(M>Minitial) BzMax = Bz;
-			else BzMin = Bz;
-		}
-		Bz = 0.5*(BzMin + BzMax);
+		auto Mcalc = [&](double Bz, double& dMdBz) { return magnetizationCalc(mu, Bz, epsAll, N, 0, &dMdBz); };
+		Bz = solveIncreasing(Mcalc, Minitial, -0.1, +0.1, Mtol, absTol*smearingWidth, relTol, verbose, "BzBISECT", "Bz", "M");
 	}
-	magnetizationCalc(mu, Bz, eps, N);
+	magnetizationCalc(mu, Bz, epsAll, N, dNdmu);
 	return N;
 }
 
 
-//Return the mu that would match Ntarget at the current eigenvalues (bisection method)
+//Return the mu that would match Ntarget at the current eigenvalues (Newton-bisection method)
 double ElecInfo::findMu(const std::vector<diagMatrix>& eps, double nElectrons, double& Bz) const
 {	const bool& verbose = e->cntrl.shouldPrintMuSearch;
-	if(verbose) logPrintf("\nBisecting to find mu(nElectrons=%.15le)\n", nElectrons);
-	//Find a range which is known to bracket the result:
+	if(verbose) logPrintf("\nSolving for mu(nElectrons=%.15le)\n", nElectrons);
+	std::vector<diagMatrix> epsAll = gatherEigs(eps); //all further work is local
 	const double absTol = 1e-10, relTol = 1e-14;
 	double nTol = std::max(absTol, relTol*fabs(nElectrons));
-	double muMin=-0.1, muMax=+0.0;
-	while(nElectronsCalc(muMin,eps,Bz)>=nElectrons+nTol) muMin-=(muMax-muMin);
-	while(nElectronsCalc(muMax,eps,Bz)<=nElectrons-nTol) muMax+=(muMax-muMin);
-	//Bisect:
-	double muTol = std::max(absTol*smearingWidth, relTol*std::max(fabs(muMin),fabs(muMax)));
-	while(muMax-muMin>=muTol)
-	{	double mu = 0.5*(muMin + muMax);
-		double N = nElectronsCalc(mu, eps, Bz);
-		if(verbose) logPrintf("MUBISECT: mu = [ %.15le %.15le %.15le ]  N = %le\n", muMin, mu, muMax, N);
-		if(N>nElectrons) muMax = mu;
-		else muMin = mu;
-	}
-	return 0.5*(muMin + muMax);
+	auto Ncalc = [&](double mu, double& dNdmu) { return nElectronsCalcAll(mu, epsAll, Bz, &dNdmu); };
+	double mu = solveIncreasing(Ncalc, nElectrons, -0.1, +0.0, nTol, absTol*smearingWidth, relTol, verbose, "MUBISECT", "mu", "N");
+	nElectronsCalcAll(mu, epsAll, Bz); //make sure Bz corresponds to the final mu
+	return mu;
 }
 
 
@@ -592,3 +645,66 @@ void ElecInfo::write(const std::vector<matrix>& M, const char *fname, int nRowsO
 	mpiWorld->fclose(fp);
 #endif
 }
+
+void ElecInfo::diagonalizeStates(const std::vector<matrix>& M, std::vector<matrix>& evecs, std::vector<diagMatrix>& eigs) const
+{	if(!stateGroupShared())
+	{	diagonalizeBatch(M, evecs, eigs, qStart, qStop); //all local states together
+		return;
+	}
+	bool isOwner = (mpiStateGroup->iProcess() == iStateGroupOwner);
+	for(int q=qStartGroup; q<qStopGroup; q++)
+	{	matrix evecsQ; diagMatrix eigsQ;
+		(isOwner ? M[q] : matrix()).diagonalize(evecsQ, eigsQ, mpiStateGroup.get(), iStateGroupOwner);
+		if(isOwner)
+		{	evecs[q] = evecsQ;
+			eigs[q] = eigsQ;
+		}
+	}
+}
+
+std::vector<double> ElecInfo::getStateCosts() const
+{	std::vector<double> cost(nStates);
+	//Measured costs from a previous run, if available:
+	if(stateBalance==BalanceMeasured)
+	{	bool valid = false;
+		if(mpiWorld->isHead())
+		{	FILE* fp = fopen(stateCostsFilename.c_str(), "r");
+			if(fp)
+			{	int nRead = 0;
+				while(nRead<nStates && fscanf(fp, "%lg", &cost[nRead])==1) nRead++;
+				double extra;
+				valid = (nRead==nStates) && (fscanf(fp, "%lg", &extra)!=1); //must match the number of states exactly
+				fclose(fp);
+			}
+		}
+		mpiWorld->bcast(valid);
+		if(valid)
+		{	mpiWorld->bcastData(cost);
+			return cost;
+		}
+		logPrintf("No valid state costs in '%s'; balancing by basis size instead.\n", stateCostsFilename.c_str());
+	}
+	//Cost model proportional to basis size:
+	const GridInfo& gInfoBasis = e->gInfoWfns ? *(e->gInfoWfns) : e->gInfo;
+	for(int q=0; q<nStates; q++)
+		cost[q] = (e->cntrl.basisKdep==BasisKpointDep)
+			? Basis::count(gInfoBasis, e->cntrl.Ecut, qnums[q].k)
+			: 1.;
+	return cost;
+}
+
+void ElecInfo::saveStateCosts(const std::vector<double>& stateTime) const
+{	if(stateBalance != BalanceMeasured) return;
+	std::vector<double> cost(nStates, 0.);
+	for(int q=qStart; q<qStop; q++) cost[q] = stateTime[q];
+	mpiWorld->allReduceData(cost, MPIUtil::ReduceSum);
+	if(mpiWorld->isHead())
+	{	FILE* fp = fopen(stateCostsFilename.c_str(), "w");
+		if(!fp)
+		{	logPrintf("WARNING: could not open '%s' to write state costs.\n", stateCostsFilename.c_str());
+			return;
+		}
+		for(double c: cost) fprintf(fp, "%.6le\n", c);
+		fclose(fp);
+	}
+}
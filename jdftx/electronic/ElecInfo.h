@@ -23,6 +23,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/vector3.h>
 #include <core/MPIUtil.h>
+#include <memory>
 
 class matrix;
 class diagMatrix;
@@ -68,6 +69,18 @@ public:
 	int qStartOther(int iProc) const { return qDivision.start(iProc); } //!< find out qStart for another process
 	int qStopOther(int iProc) const { return qDivision.stop(iProc); } //!< find out qStop for another process
 	
+	//! State group: processes without states of their own (when there are more processes than states)
+	//! join the owner of the next state, and help with its dense subspace linear algebra
+	std::shared_ptr<MPIUtil> mpiStateGroup;
+	int qStartGroup, qStopGroup; //!< range of states of the owner of this process's state group
+	int iStateGroupOwner; //!< rank of the state owner within mpiStateGroup
+	bool stateGroupShared() const { return mpiStateGroup && mpiStateGroup->nProcesses()>1; } //!< whether this state group has helpers
+	
+	//! collectively over the group (see matrix::diagonalize with an MPIUtil) when it has helpers, and batched over states otherwise (see diagonalizeBatch).
+	//! collectively over the group (see matrix::diagonalize with an MPIUtil) when it has helpers, and serially otherwise.
+	//! Must be called on all processes together; M[q] is only needed (and results only set) on the owner of q.
+	void diagonalizeStates(const std::vector<matrix>& M, std::vector<matrix>& evecs, std::vector<diagMatrix>& eigs) const;
+	
 	SpinType spinType; //!< type of spin treatment
 	double nElectrons; //!< the number of electrons = Sum w Tr[F]
 	std::vector<QuantumNumber> qnums; //!< k-points, spins and weights for each state
@@ -96,8 +109,19 @@ public:
 	double mu; //!< If NaN, fix nElectrons, otherwise fix/target chemical potential to this
 	double Bz; //!< If NaN, fix magnetization, otherwise fix/target magnetic field to this value
 	bool muLoop; //!< Whether to optimize mu in an outer loop over fixed charge calculations
+	std::vector<double> muScan; //!< If non-empty, run the calculation at each of these mu in turn, each starting from the previous converged state (see target-mu-scan)
 	
 	bool hasU; //! Flag to check whether the calculation has a DFT+U self-interaction correction
+	
+	//! Division of states between processes
+	enum StateBalance
+	{	BalanceUniform, //!< equal number of states per process (default)
+		BalanceBasis, //!< equal total cost, estimated as proportional to the basis size of each state
+		BalanceMeasured //!< equal total cost, using Hamiltonian timings saved by a previous run (falls back to BalanceBasis)
+	}
+	stateBalance; //!< division of states between processes
+	string stateCostsFilename; //!< file to read and write measured per-state costs (BalanceMeasured)
+	void saveStateCosts(const std::vector<double>& stateTime) const; //!< collect per-state timings from all processes and write them to stateCostsFilename (BalanceMeasured only)
 
 	string initialFillingsFilename; //!< filename for initial fillings (zero-length if none)
 	
@@ -146,12 +170,23 @@ public:
 		vector3<int> S_old; //!< fftbox size for the input wavefunction in double space
 		ColumnBundleReadConversion();
 	};
-	void read(std::vector<class ColumnBundle>&, const char *fname, const ColumnBundleReadConversion* conversion=0) const; //!< Read array of columnbundles, optionally with conversion
-	void write(const std::vector<class ColumnBundle>&, const char *fname) const; //!< write an array of columnbundles to file
+	void read(std::vector<class ColumnBundle>&, const char *fname, const ColumnBundleReadConversion* conversion=0) const; //!< Read array of columnbundles, optionally with conversion (flat or indexed format, detected automatically)
+	void write(const std::vector<class ColumnBundle>&, const char *fname, size_t indexedAlign=0) const; //!< write an array of columnbundles to file: flat by default, or in the indexed format with state data aligned to indexedAlign bytes if non-zero
+	
+	//! Collectively lay out an indexed wavefunction file for Y: returns the (little-endian) header including the state table, and sets the byte offset of each state's data (0 for absent states)
+	std::vector<char> layoutIndexed(const std::vector<class ColumnBundle>& Y, size_t indexedAlign, std::vector<uint64_t>& offsets) const;
+	//! Write an indexed wavefunction file laid out by layoutIndexed using only POSIX I/O and no MPI calls (usable from a background thread):
+	//! the head writes the header, and each process writes the states it owns. Returns false on any I/O error.
+	bool writeIndexedLocal(const std::vector<class ColumnBundle>& Y, const char *fname, const std::vector<char>& header, const std::vector<uint64_t>& offsets) const;
 
 private:
 	const Everything* e;
 	TaskDivision qDivision; //!< MPI division of k-points
+	std::vector<double> getStateCosts() const; //!< relative cost of each state for load balancing (as selected by stateBalance)
+	
+	//Indexed wavefunction format (header with a table of per-state offsets, basis sizes and checksums):
+	void readIndexed(std::vector<class ColumnBundle>&, const char *fname, const ColumnBundleReadConversion* conversion) const;
+	void writeIndexed(const std::vector<class ColumnBundle>&, const char *fname, size_t indexedAlign) const;
 	
 	//Initial fillings:
 	int nBandsOld; //!<number of bands in file being read
@@ -163,8 +198,16 @@ private:
 	friend class ElecVars;
 	friend struct LCAOminimizer;
 	
-	//!Calculate nElectrons and return magnetization at given mu, Bz and eigenvalues eps
-	double magnetizationCalc(double mu, double Bz, const std::vector<diagMatrix>& eps, double& nElectrons) const; 
+	//! Eigenvalues of all states on every process, gathered from the local states of eps with a single reduction
+	//! (so that the mu and Bz searches below need no communication within their iterations)
+	std::vector<diagMatrix> gatherEigs(const std::vector<diagMatrix>& eps) const;
+	
+	//!Calculate nElectrons and return magnetization at given mu, Bz and eigenvalues epsAll of all states (from gatherEigs)
+	//!Optionally also retrieve the derivatives dN/dmu and dM/dBz
+	double magnetizationCalc(double mu, double Bz, const std::vector<diagMatrix>& epsAll, double& nElectrons, double* dNdmu=0, double* dMdBz=0) const; 
+	
+	//!Version of nElectronsCalc for eigenvalues epsAll of all states (from gatherEigs), optionally retrieving dN/dmu (at fixed Bz)
+	double nElectronsCalcAll(double mu, const std::vector<diagMatrix>& epsAll, double& Bz, double* dNdmu=0) const; 
 	
 	//k-points:
 	vector3<int> kfold; //!< kpoint fold vector
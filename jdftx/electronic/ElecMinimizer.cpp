@@ -20,6 +20,9 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/ElecMinimizer.h>
 #include <electronic/BandMinimizer.h>
 #include <electronic/BandDavidson.h>
+#include <electronic/BandPPCG.h>
+#include <electronic/BandChebyshev.h>
+#include <electronic/BandRMMDIIS.h>
 #include <electronic/ColumnBundle.h>
 #include <electronic/Everything.h>
 #include <electronic/Dump.h>
@@ -27,6 +30,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/Random.h>
 #include <core/ScalarField.h>
 #include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
 #include <electronic/SCF.h>
 
 void ElecGradient::init(const Everything& e)
@@ -150,6 +155,8 @@ ElecMinimizer::ElecMinimizer(Everything& e)
 		rotPrevCinv[q] = eye(eInfo.nBands);
 	}
 	rotExists = false; //rotation is identity
+	lineDir = 0;
+	Eprev = NAN;
 	
 	//Initialize subspace rotation adjuster if required:
 	if(e.cntrl.subspaceRotationAdjust && ( eInfo.fillingsUpdate==ElecInfo::FillingsHsub || !eInfo.scalarFillings) )
@@ -158,49 +165,72 @@ ElecMinimizer::ElecMinimizer(Everything& e)
 
 void ElecMinimizer::step(const ElecGradient& dir, double alpha)
 {	assert(dir.eInfo == &eInfo);
+	bool needRotations = !(eInfo.fillingsUpdate==ElecInfo::FillingsConst && eInfo.scalarFillings); //Haux or non-scalar fillings
+	bool useLineCache = (lineDir == &dir); //overlaps and projections along dir cached by constrain
+	std::vector<matrix> rot(eInfo.nStates), rotC(eInfo.nStates), Osub;
+	if(useLineCache) Osub.resize(eInfo.nStates);
+	std::vector<ColumnBundle> dirC; //search direction in the current (rotated) basis, if different
+	if(rotExists) multiplyBatch(dir.C, rotPrevC, dirC, eInfo.qStart, eInfo.qStop);
 	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-	{	axpy(alpha, rotExists ? dir.C[q]*rotPrevC[q] : dir.C[q], eVars.C[q]);
-		if(eInfo.fillingsUpdate==ElecInfo::FillingsConst && eInfo.scalarFillings)
-		{	//Constant scalar fillings: no rotations required
-			eVars.orthonormalize(q);
+	{	axpy(alpha, rotExists ? dirC[q] : dir.C[q], eVars.C[q]);
+		if(rotExists) dirC[q].free();
+		if(useLineCache)
+		{	//Overlaps and projections of C + alpha*dirC from those of C (orthonormal) and dir:
+			matrix CdagOdirC = lineCdagOdir[q], dirCdagOdirC = lineDirOdir[q];
+			if(rotExists)
+			{	CdagOdirC = CdagOdirC * rotPrevC[q];
+				dirCdagOdirC = dagger(rotPrevC[q]) * dirCdagOdirC * rotPrevC[q];
+			}
+			Osub[q] = eye(eInfo.nBands) + alpha*(CdagOdirC + dagger(CdagOdirC)) + (alpha*alpha)*dirCdagOdirC;
+			for(unsigned sp=0; sp<lineVdagDir[q].size(); sp++)
+				if(lineVdagDir[q][sp])
+					eVars.VdagC[q][sp] += alpha * (rotExists ? lineVdagDir[q][sp] * rotPrevC[q] : lineVdagDir[q][sp]);
+			lineCdagOdir[q] += alpha * (rotExists ? dagger(rotPrevC[q]) * lineDirOdir[q] : lineDirOdir[q]); //rotated below
+			if(!needRotations) rotC[q] = eye(eInfo.nBands); //retrieves the orthonormalizing rotation below
 		}
-		else
-		{	//Haux or non-scalar fillings: rotations required
-			assert(dir.Haux[q]);
-			matrix rot;
+		if(needRotations)
+		{	assert(dir.Haux[q]);
 			if(eInfo.fillingsUpdate == ElecInfo::FillingsHsub)
 			{	//Haux fillings:
 				matrix Haux = eVars.Haux_eigs[q];
 				axpy(alpha, rotExists ? dagger(rotPrev[q])*dir.Haux[q]*rotPrev[q] : dir.Haux[q], Haux);
-				Haux.diagonalize(rot, eVars.Haux_eigs[q]); //rotation chosen to diagonalize auxiliary matrix
+				Haux.diagonalize(rot[q], eVars.Haux_eigs[q]); //rotation chosen to diagonalize auxiliary matrix
 			}
 			else
 			{	//Non-scalar fillings:
 				assert(!eInfo.scalarFillings);
-				rot = cis(alpha * dir.Haux[q]); //auxiliary matrix directly generates rotations
+				rot[q] = cis(alpha * dir.Haux[q]); //auxiliary matrix directly generates rotations
 			}
-			matrix rotC = rot;
-			eVars.orthonormalize(q, &rotC);
-			rotPrev[q] = rotPrev[q] * rot;
-			rotPrevC[q] = rotPrevC[q] * rotC;
-			rotPrevCinv[q] = inv(rotC) * rotPrevCinv[q];
-			rotExists = true; //rotation is no longer identity
+			rotC[q] = rot[q];
 		}
 	}
+	//Orthonormalize (constant scalar fillings need no further rotations):
+	eVars.orthonormalizeAll((needRotations || useLineCache) ? &rotC : 0, useLineCache ? &Osub : 0);
+	if(useLineCache)
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+			lineCdagOdir[q] = dagger(rotC[q]) * lineCdagOdir[q];
+	if(needRotations)
+	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	rotPrev[q] = rotPrev[q] * rot[q];
+			rotPrevC[q] = rotPrevC[q] * rotC[q];
+			rotPrevCinv[q] = inv(rotC[q]) * rotPrevCinv[q];
+		}
+		rotExists = true; //rotation is no longer identity
+	}
 }
 
 double ElecMinimizer::compute(ElecGradient* grad, ElecGradient* Kgrad)
 {	if(grad) grad->init(e);
 	if(Kgrad) Kgrad->init(e);
+	if(grad) lineDir = 0; //gradient evaluation ends the line search (and the search direction may be updated next)
 	double ener = e.eVars.elecEnergyAndGrad(e.ener, grad, Kgrad);
 	if(grad)
-	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-		{	//Rotate wavefunction gradients if necessary:
-			if(rotExists)
-			{	grad->C[q] = grad->C[q] * rotPrevCinv[q];
-				Kgrad->C[q] = Kgrad->C[q] * rotPrevCinv[q];
-			}
-			//Subspace gradient handling depends on mode:
+	{	if(rotExists) //Rotate wavefunction gradients (multiplies batched over states):
+		{	multiplyBatch(grad->C, rotPrevCinv, grad->C, eInfo.qStart, eInfo.qStop);
+			multiplyBatch(Kgrad->C, rotPrevCinv, Kgrad->C, eInfo.qStart, eInfo.qStop);
+		}
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	//Subspace gradient handling depends on mode:
 			if(eInfo.fillingsUpdate == ElecInfo::FillingsHsub)
 			{	//Haux fillings: rotate gradient computed by ElecVars if necessary
 				if(rotExists)
@@ -224,7 +254,8 @@ double ElecMinimizer::compute(ElecGradient* grad, ElecGradient* Kgrad)
 }
 
 bool ElecMinimizer::report(int iter)
-{
+{	ManagedMemoryBase::reportIteration("ElecMinimize", iter);
+	lineDir = 0; //wavefunctions or rotations may change below
 	if(e.cntrl.shouldPrintEcomponents)
 	{	//Print the iteration header
 		time_t timenow = time(0);
@@ -245,6 +276,7 @@ bool ElecMinimizer::report(int iter)
 	
 	//Dump:
 	e.dump(DumpFreq_Electronic, iter);
+	e.dump.checkpoint(iter);
 	
 	//Re-unitarize rotations:
 	if(rotExists)
@@ -253,16 +285,45 @@ bool ElecMinimizer::report(int iter)
 			rotPrevCinv[q] = dagger(rotPrev[q]);
 		}
 	
+	//Switch to double-precision transforms when sufficiently converged (SCF handles this in SCF::cycle instead):
+	bool precisionChanged = false;
+	if(GridInfo::batchSinglePrecision && !e.cntrl.scf)
+	{	double E = relevantFreeEnergy(e);
+		if(fabs(E - Eprev) < e.cntrl.mixedPrecisionThreshold)
+		{	GridInfo::batchSinglePrecision = false;
+			logPrintf("ElecMinimize: |dE| < %le: switching to double-precision wavefunction transforms.\n", e.cntrl.mixedPrecisionThreshold);
+			precisionChanged = true;
+		}
+		Eprev = E;
+	}
+	
 	//Subspace rotation preconditioner handling:
-	if(sra) return sra->report(KgradHaux);
-	return false;
+	bool sraChanged = sra ? sra->report(KgradHaux) : false;
+	return sraChanged || precisionChanged;
 }
 
 void ElecMinimizer::constrain(ElecGradient& dir)
 {	assert(dir.eInfo == &eInfo);
-	//Project component of search direction along current wavefunctions:
+	//Project component of search direction along current wavefunctions,
+	//caching its overlaps and projections for the steps along it that follow (see step):
+	lineVdagDir.resize(eInfo.nStates);
+	lineCdagOdir.resize(eInfo.nStates);
+	lineDirOdir.resize(eInfo.nStates);
 	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-		dir.C[q] -= eVars.C[q] * (eVars.C[q]^O(dir.C[q]));
+	{	std::vector<matrix>& VdagDir = lineVdagDir[q];
+		VdagDir.clear();
+		ColumnBundle Odir = O(dir.C[q], &VdagDir); //retrieves ultrasoft projections
+		for(unsigned sp=0; sp<e.iInfo.species.size(); sp++)
+			if(!VdagDir[sp]) VdagDir[sp] = e.iInfo.species[sp]->getVdagC(dir.C[q]); //remaining projections
+		matrix CdagOdir = eVars.C[q] ^ Odir;
+		dir.C[q] -= eVars.C[q] * CdagOdir;
+		//Corresponding updates to the overlaps and projections (C is orthonormal):
+		lineDirOdir[q] = dagger_symmetrize(dir.C[q] ^ Odir); //= dir^O(dir) of the projected dir
+		for(unsigned sp=0; sp<VdagDir.size(); sp++)
+			if(VdagDir[sp]) VdagDir[sp] -= eVars.VdagC[q][sp] * CdagOdir;
+		lineCdagOdir[q] = zeroes(eInfo.nBands, eInfo.nBands);
+	}
+	lineDir = &dir;
 }
 
 double ElecMinimizer::sync(double x) const
@@ -270,18 +331,83 @@ double ElecMinimizer::sync(double x) const
 	return x;
 }
 
+//Solve for the bands of state q, starting from the current eVars.C[q]
+static void bandMinimize(Everything& e, int q)
+{	logPrintf("\n---- Minimization of quantum number: "); e.eInfo.kpointPrint(globalLog, q, true); logPrintf(" ----\n");
+	switch(e.cntrl.elecEigenAlgo)
+	{	case ElecEigenCG: { BandMinimizer(e, q).minimize(e.elecMinParams); break; }
+		case ElecEigenDavidson: { BandDavidson(e, q).minimize(); break; }
+		case ElecEigenPPCG: { BandPPCG(e, q).minimize(); break; }
+		case ElecEigenChebyshev: { BandChebyshev(e, q).minimize(); break; }
+		case ElecEigenRMMDIIS: { BandRMMDIIS(e, q).minimize(); break; }
+	}
+	e.ener.Eband += e.eInfo.qnums[q].weight * trace(e.eVars.Hsub_eigs[q]);
+}
+
+//Band-structure minimization one state at a time, without storing wavefunctions of all states.
+//Each state starts from the converged eigenvectors of the previous local state (projected to its basis),
+//and its eigenvalues are written to the eigenvals file (in the layout of ElecInfo::write) as soon as it is solved.
+static void bandMinimizeStreaming(Everything& e)
+{	const ElecInfo& eInfo = e.eInfo;
+	ElecVars& eVars = e.eVars;
+	logPrintf("Streaming mode: wavefunctions of each state are discarded once solved.\n");
+	
+	//Open eigenvalue output (head truncates first, so that all processes write into a file of the final size):
+	string fname = e.dump.getFilename("eigenvals");
+	size_t nBytesState = eInfo.nBands*sizeof(double);
+	if(mpiWorld->isHead())
+	{	int fd = open(fname.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+		if(fd<0 || ftruncate(fd, nBytesState*eInfo.nStates) || close(fd))
+			die("Error creating '%s' for streamed eigenvalue output.\n", fname.c_str());
+	}
+	bool created = true; mpiWorld->bcast(created); //ensures creation precedes opening on other processes
+	int fd = open(fname.c_str(), O_WRONLY);
+	if(fd < 0) die_alone("Error opening '%s' for streamed eigenvalue output.\n", fname.c_str());
+	logPrintf("Writing eigenvalues of each state to '%s' as it completes.\n", fname.c_str());
+	
+	ColumnBundle Cprev; //converged wavefunctions of previous state (initial guess for the next one)
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	//Initialize wavefunctions:
+		ColumnBundle& C = eVars.C[q];
+		if(Cprev)
+		{	C = switchBasis(Cprev, e.basis[q]);
+			C.qnum = &eInfo.qnums[q];
+			Cprev.free();
+		}
+		else
+		{	C.init(eInfo.nBands, e.basis[q].nbasis*eInfo.spinorLength(), &e.basis[q], &eInfo.qnums[q], isGpuEnabled());
+			C.randomize(0, eInfo.nBands);
+		}
+		C = C * invsqrt(C^O(C));
+		e.iInfo.project(C, eVars.VdagC[q]);
+		
+		//Solve and write eigenvalues:
+		bandMinimize(e, q);
+		diagMatrix eigs = eVars.Hsub_eigs[q];
+		convertToLE(eigs.data(), sizeof(double), eigs.size());
+		if(pwrite(fd, eigs.data(), nBytesState, nBytesState*q) != ssize_t(nBytesState))
+			die_alone("Error writing eigenvalues of state %d to '%s'.\n", q, fname.c_str());
+		
+		//Keep eigenvectors as the initial guess for the next state and release the rest:
+		Cprev = C * eVars.Hsub_evecs[q];
+		C.free();
+		for(matrix& VdagCq_sp: eVars.VdagC[q]) VdagCq_sp = matrix();
+		if(eInfo.fillingsUpdate==ElecInfo::FillingsHsub) eVars.Haux_eigs[q] = eVars.Hsub_eigs[q];
+		eVars.Hsub[q] = eVars.Hsub_eigs[q];
+		eVars.Hsub_evecs[q] = eye(eInfo.nBands);
+	}
+	close(fd);
+}
+
 void bandMinimize(Everything& e)
 {	bool fixed_H = true; std::swap(fixed_H, e.cntrl.fixed_H); //remember fixed_H flag and temporarily set it to true
 	logPrintf("Minimization will be done independently for each quantum number.\n");
 	e.ener.Eband = 0.;
-	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
-	{	logPrintf("\n---- Minimization of quantum number: "); e.eInfo.kpointPrint(globalLog, q, true); logPrintf(" ----\n");
-		switch(e.cntrl.elecEigenAlgo)
-		{	case ElecEigenCG: { BandMinimizer(e, q).minimize(e.elecMinParams); break; }
-			case ElecEigenDavidson: { BandDavidson(e, q).minimize(); break; }
-		}
-		e.ener.Eband += e.eInfo.qnums[q].weight * trace(e.eVars.Hsub_eigs[q]);
-	}
+	if(e.cntrl.streamBands)
+		bandMinimizeStreaming(e);
+	else
+		for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+			bandMinimize(e, q);
 	mpiWorld->allReduce(e.ener.Eband, MPIUtil::ReduceSum);
 	if(e.cntrl.shouldPrintEigsFillings)
 	{	//Print the eigenvalues if requested
@@ -289,7 +415,7 @@ void bandMinimize(Everything& e)
 		logPrintf("\n"); logFlush();
 	}
 	std::swap(fixed_H, e.cntrl.fixed_H); //restore fixed_H flag
-	e.eVars.setEigenvectors();
+	if(!e.cntrl.streamBands) e.eVars.setEigenvectors();
 }
 
 
@@ -346,34 +472,104 @@ void muOuterLoop(Everything& e)
 
 
 void elecMinimize(Everything& e)
-{	
+{	ManagedMemoryBase::setPhase("electronic"); //for memory telemetry
 	if(!std::isnan(e.eInfo.mu) && e.eInfo.muLoop)
 	{	muOuterLoop(e); //Run a loop over fixed charge calculations to target mu
 	}
-	else if(e.cntrl.scf)
-	{	SCF scf(e);
-		scf.minimize();
-	}
-	else if(e.cntrl.fixed_H)
-	{	bandMinimize(e);
-	}
 	else
-	{	ElecMinimizer emin(e);
-		emin.minimize(e.elecMinParams);
-		if (!e.ionDynamicsParams.tMax) e.eVars.setEigenvectors(); //Don't spend time with this if running MD
+	{	//Mixed precision: start with single-precision transforms (switched off by ElecMinimizer::report or SCF::cycle):
+		if(e.cntrl.mixedPrecisionThreshold)
+		{	GridInfo::batchSinglePrecision = true;
+			logPrintf("Using single-precision wavefunction transforms until |dE| < %le.\n", e.cntrl.mixedPrecisionThreshold);
+		}
+		if(e.cntrl.scf)
+		{	SCF scf(e);
+			scf.minimize();
+		}
+		else if(e.cntrl.fixed_H)
+		{	bandMinimize(e);
+		}
+		else
+		{	ElecMinimizer emin(e);
+			emin.minimize(e.elecMinParams);
+			if (!e.ionDynamicsParams.tMax) e.eVars.setEigenvectors(); //Don't spend time with this if running MD
+		}
+		if(GridInfo::batchSinglePrecision) //stopped before reaching the threshold:
+		{	GridInfo::batchSinglePrecision = false;
+			logPrintf("Mixed-precision threshold not reached: recomputing final energy in double precision.\n");
+			if(!e.cntrl.fixed_H) e.eVars.elecEnergyAndGrad(e.ener);
+		}
 	}
+	e.dump.checkpointWait();
+	e.eInfo.saveStateCosts(e.eVars.stateTime); //for measured load balancing in subsequent runs (if enabled)
 	e.eVars.isRandom = false; //wavefunctions are no longer random
 	//Converge empty states if necessary:
 	if(e.cntrl.convergeEmptyStates and (not e.cntrl.fixed_H))
 		convergeEmptyStates(e);
 }
 
+//Replace the wavefunction bases in e.basis in place (so that pointers to them stay valid) by those
+//with cutoff Ecut, and project the local wavefunctions to them (re-orthonormalized)
+static void switchWavefunctionCutoff(Everything& e, double Ecut)
+{	const ElecInfo& eInfo = e.eInfo;
+	ElecVars& eVars = e.eVars;
+	bool kDep = (e.cntrl.basisKdep==BasisKpointDep);
+	//Set up new bases (handling k-dependence as in Everything::setup):
+	const GridInfo& gInfoBasis = e.gInfoWfns ? *e.gInfoWfns : e.gInfo;
+	std::vector<Basis> basis(eInfo.nStates);
+	logSuspend();
+	for(int q=0; q<eInfo.nStates; q++)
+	{	if(kDep) basis[q].setup(gInfoBasis, e.iInfo, Ecut, eInfo.qnums[q].k);
+		else
+		{	if(q==0) basis[q].setup(gInfoBasis, e.iInfo, Ecut, vector3<>(0,0,0));
+			else basis[q] = basis[0];
+		}
+	}
+	logResume();
+	//Project wavefunctions (while the previous bases are still intact):
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	eVars.C[q] = switchBasis(eVars.C[q], basis[q]);
+		eVars.C[q].qnum = &eInfo.qnums[q];
+	}
+	//Exchange the bases without copying (so that C[q].basis now points into e.basis):
+	std::swap(e.basis, basis);
+	if(!kDep) for(int q=1; q<eInfo.nStates; q++) basis[q] = Basis(); //drop references to basis[0] before it is freed
+	e.iInfo.projectorCache.clear(); //cached projectors are specific to the previous bases
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		eVars.orthonormalize(q);
+}
+
+//Converge fresh wavefunctions with a reduced cutoff first (see command elec-initial-cutoff),
+//and promote them to the full basis for the subsequent minimizations
+static void reducedCutoffMinimize(Everything& e)
+{	Control& cntrl = e.cntrl;
+	if(e.exx)
+	{	logPrintf("\nWARNING: skipping the reduced-cutoff stage, which is not supported with exact exchange.\n");
+		return;
+	}
+	logPrintf("\n-------- Initial electronic minimization at reduced cutoff %lg Hartrees -----------\n", cntrl.EcutInitial); logFlush();
+	switchWavefunctionCutoff(e, cntrl.EcutInitial);
+	//Minimize to the looser threshold of this stage:
+	double& threshold = cntrl.scf ? e.scfParams.energyDiffThreshold : e.elecMinParams.energyDiffThreshold;
+	double thresholdFull = threshold;
+	threshold = std::max(threshold, cntrl.EcutInitialThreshold);
+	bool convergeEmptyStates = false; std::swap(convergeEmptyStates, cntrl.convergeEmptyStates);
+	elecMinimize(e);
+	threshold = thresholdFull;
+	std::swap(convergeEmptyStates, cntrl.convergeEmptyStates);
+	//Promote to the full basis:
+	logPrintf("\nPromoting wavefunctions to full cutoff %lg Hartrees.\n", cntrl.Ecut); logFlush();
+	switchWavefunctionCutoff(e, cntrl.Ecut);
+}
+
 void elecFluidMinimize(Everything &e)
 {	Control &cntrl = e.cntrl;
 	ElecVars &eVars = e.eVars;
 	ElecInfo& eInfo = e.eInfo;
 	IonInfo& iInfo = e.iInfo;
 	Energies &ener = e.ener;
+	
+	if(eVars.externalRefresh) eVars.refreshExternal();
 
 	if(!eVars.HauxInitialized && eInfo.fillingsUpdate==ElecInfo::FillingsHsub)
 	{	if(std::isnan(eInfo.mu)) //Constant nElectrons mode
@@ -392,6 +588,18 @@ void elecFluidMinimize(Everything &e)
 				"or elec-initial-eigenvals, or be automatically initialized during LCAO.");
 	}
 	
+	if(eVars.isRandom && cntrl.EcutInitial)
+	{	//Reduced-cutoff stage (in vacuum, with the fluid solved at full cutoff below):
+		FluidType origType = eVars.fluidParams.fluidType;
+		eVars.fluidParams.fluidType = FluidNone; //temporarily disable the fluid
+		double muOrig = eInfo.mu;
+		eInfo.mu = NAN; //temporarily disable fixed mu (if present)
+		reducedCutoffMinimize(e);
+		eVars.fluidParams.fluidType = origType; //restore fluid flag
+		eInfo.mu = muOrig; //restore mu target (if any)
+		eVars.isRandom = true; //still treat as fresh, so that a vacuum solve at full cutoff precedes any fluid
+	}
+	
 	double Evac0 = NAN;
 	if(eVars.isRandom && eVars.fluidParams.fluidType!=FluidNone)
 	{	logPrintf("Fluid solver invoked on fresh (partially random / LCAO) wavefunctions\n");
@@ -431,14 +639,39 @@ void elecFluidMinimize(Everything &e)
 	if(eVars.fluidParams.fluidType!=FluidNone && eVars.fluidSolver->useGummel())
 	{	//gummel loop
 		logPrintf("\n-------- Electron <-> Fluid self-consistency loop -----------\n"); logFlush();
+		//Inner minimizations are converged to a fraction of the previous outer free-energy change,
+		//so that early iterations are not over-converged; the specified thresholds are the tightest used:
+		const double fluidThreshold = e.fluidMinParams.energyDiffThreshold;
+		const double elecThreshold = e.elecMinParams.energyDiffThreshold;
+		const double thresholdMax = 1e-3; //loosest inner threshold (used for the first iteration)
 		double dAtyp = 1.;
 		bool converged = false;
 		for(int iGummel=0; iGummel<cntrl.fluidGummel_nIterations && !killFlag; iGummel++)
 		{
+			//Switch to solving the fluid at every electronic step once close enough to self-consistency:
+			if(dAtyp < cntrl.fluidGummel_AtolInner)
+			{	logPrintf("\n------------- Electronic Minimization # %d with inner fluid solve --------------\n", iGummel+1); logFlush();
+				double A_JDFT_prev = relevantFreeEnergy(e);
+				e.fluidMinParams.energyDiffThreshold = fluidThreshold;
+				e.elecMinParams.energyDiffThreshold = elecThreshold;
+				FluidSolveFrequency solveFrequency = eVars.fluidParams.solveFrequency;
+				eVars.fluidParams.solveFrequency = FluidFreqInner; //fluid minimized within each EdensityAndVscloc()
+				elecMinimize(e);
+				eVars.fluidParams.solveFrequency = solveFrequency;
+				double dA = relevantFreeEnergy(e) - A_JDFT_prev;
+				logPrintf("\nElectronic minimization # %d with inner fluid solve changed total free energy by %le at t[s]: %9.2lf\n", iGummel+1, dA, clock_sec());
+				e.dump(DumpFreq_Gummel, iGummel);
+				logPrintf("\nFluid<-->Electron self-consistency reached by simultaneous minimization after %d iterations at t[s]: %9.2lf.\n",
+					iGummel+1, clock_sec());
+				converged = true;
+				break;
+			}
+			
 			//Fluid-side:
 			logPrintf("\n---------------------- Fluid Minimization # %d -----------------------\n", iGummel+1); logFlush();
 			double A_diel_prev = ener.E["A_diel"];
-			e.fluidMinParams.energyDiffThreshold = std::min(1e-5, 0.01*dAtyp);
+			double innerThreshold = std::min(thresholdMax, cntrl.fluidGummel_tolFactor*dAtyp);
+			e.fluidMinParams.energyDiffThreshold = std::max(fluidThreshold, innerThreshold);
 			eVars.fluidSolver->minimizeFluid();
 			ener.E["A_diel"] = eVars.fluidSolver->get_Adiel_and_grad(&eVars.d_fluid, &eVars.V_cavity);
 			double dAfluid = ener.E["A_diel"] - A_diel_prev;
@@ -447,7 +680,7 @@ void elecFluidMinimize(Everything &e)
 			//Electron-side:
 			logPrintf("\n-------------------- Electronic Minimization # %d ---------------------\n", iGummel+1); logFlush();
 			double A_JDFT_prev = relevantFreeEnergy(e);
-			e.elecMinParams.energyDiffThreshold = std::min(1e-5, 0.01*dAtyp);
+			e.elecMinParams.energyDiffThreshold = std::max(elecThreshold, innerThreshold);
 			elecMinimize(e);
 			double dAelec = relevantFreeEnergy(e) - A_JDFT_prev;
 			logPrintf("\nElectronic minimization # %d changed total free energy by %le at t[s]: %9.2lf\n", iGummel+1, dAelec, clock_sec());
@@ -455,9 +688,9 @@ void elecFluidMinimize(Everything &e)
 			//Dump:
 			e.dump(DumpFreq_Gummel, iGummel);
 
-			//Check self-consistency:
+			//Check self-consistency (only trusted once the inner minimizations were converged tighter than Atol):
 			dAtyp = std::max(fabs(dAfluid), fabs(dAelec));
-			if(dAtyp<cntrl.fluidGummel_Atol)
+			if(dAtyp<cntrl.fluidGummel_Atol && innerThreshold<=cntrl.fluidGummel_Atol)
 			{	logPrintf("\nFluid<-->Electron self-consistency loop converged to %le hartrees after %d minimization pairs at t[s]: %9.2lf.\n",
 					cntrl.fluidGummel_Atol, iGummel+1, clock_sec());
 				converged = true;
@@ -467,6 +700,9 @@ void elecFluidMinimize(Everything &e)
 		if(!converged)
 			logPrintf("\nFluid<-->Electron self-consistency loop not yet converged to %le hartrees after %d minimization pairs at t[s]: %9.2lf.\n",
 				cntrl.fluidGummel_Atol, cntrl.fluidGummel_nIterations, clock_sec());
+		//Restore specified thresholds (for subsequent ionic / lattice steps):
+		e.fluidMinParams.energyDiffThreshold = fluidThreshold;
+		e.elecMinParams.energyDiffThreshold = elecThreshold;
 	}
 	
 	if(!std::isnan(Evac0))
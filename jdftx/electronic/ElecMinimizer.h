@@ -71,6 +71,14 @@ private:
 	std::vector<matrix> rotPrevCinv; //!< inverse of rotPrevC (which is not just dagger, since these are not exactly unitary)
 	
 	bool rotExists; //!< whether rotPrev is non-trivial (not identity)
+	
+	//Line search cache: overlaps and projections of the search direction, so that steps along it
+	//update the overlaps and projections of C algebraically instead of recomputing them (see constrain and step)
+	const ElecGradient* lineDir; //!< search direction for which the cache is valid (null if invalid)
+	std::vector<std::vector<matrix>> lineVdagDir; //!< pseudopotential projections of lineDir->C
+	std::vector<matrix> lineCdagOdir; //!< overlap of current C with lineDir->C
+	std::vector<matrix> lineDirOdir; //!< self-overlap of lineDir->C
+	double Eprev; //!< energy at previous report (used to switch out of single-precision transforms, see Control::mixedPrecisionThreshold)
 	std::shared_ptr<struct SubspaceRotationAdjust> sra; //!< Subspace rotation adjustment helper
 };
 
@@ -29,13 +29,83 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarFieldIO.h>
 #include <cstdio>
 #include <cmath>
+#include <cfloat>
 #include <limits.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
 
 ElecVars::ElecVars()
-: isRandom(true), initLCAO(true), skipWfnsInit(false), HauxInitialized(false), lcaoIter(-1), lcaoTol(1e-6)
+: externalRefresh(false), isRandom(true), initLCAO(true), skipWfnsInit(false), HauxInitialized(false), orthoMethod(OrthoSymmetric), lcaoIter(-1), lcaoTol(1e-6)
 {
 }
 
+void ElecVars::setExternal(const ScalarFieldArray* VexternalNew, const ScalarFieldTilde* rhoExternalNew)
+{	if(VexternalNew)
+	{	VexternalInput = *VexternalNew;
+		if(VexternalInput.size()==1 && n.size()==2) //Replicate potential for second spin:
+			VexternalInput.push_back(VexternalInput[0]->clone());
+		if(VexternalInput.size() && VexternalInput.size() != n.size())
+			die("External potential has %d components, but the density has %d.\n", int(VexternalInput.size()), int(n.size()));
+		combineVexternal();
+	}
+	if(rhoExternalNew)
+		rhoExternal = *rhoExternalNew;
+}
+
+void ElecVars::combineVexternal()
+{	Vexternal.clear();
+	if(!(VexternalInput.size() || VexternalFixed)) return;
+	Vexternal.resize(n.size());
+	for(unsigned s=0; s<n.size(); s++)
+	{	if(VexternalFixed) Vexternal[s] = VexternalFixed->clone();
+		if(VexternalInput.size()) Vexternal[s] += VexternalInput[s];
+	}
+}
+
+//Modification time of a file (broadcast from head), or 0 if unavailable
+static time_t fileModTime(const string& fname)
+{	time_t t = 0;
+	struct stat st;
+	if(mpiWorld->isHead() && stat(fname.c_str(), &st)==0) t = st.st_mtime;
+	mpiWorld->bcast(t);
+	return t;
+}
+
+void ElecVars::readExternal()
+{	const GridInfo& gInfo = e->gInfo;
+	externalModTime.clear();
+	for(const string& fname: VexternalFilename) externalModTime.push_back(fileModTime(fname));
+	if(rhoExternalFilename.length()) externalModTime.push_back(fileModTime(rhoExternalFilename));
+	
+	ScalarFieldArray VexternalNew(VexternalFilename.size());
+	for(unsigned s=0; s<VexternalNew.size(); s++)
+	{	VexternalNew[s] = ScalarFieldData::alloc(gInfo);
+		logPrintf("Reading external potential from '%s'\n", VexternalFilename[s].c_str());
+		loadRawBinary(VexternalNew[s], VexternalFilename[s].c_str());
+	}
+	ScalarFieldTilde rhoExternalNew;
+	if(rhoExternalFilename.length())
+	{	logPrintf("Reading external charge from '%s'\n", rhoExternalFilename.c_str());
+		ScalarField temp(ScalarFieldData::alloc(gInfo));
+		loadRawBinary(temp, rhoExternalFilename.c_str());
+		rhoExternalNew = J(temp);
+	}
+	setExternal(&VexternalNew, rhoExternalFilename.length() ? &rhoExternalNew : 0);
+}
+
+void ElecVars::refreshExternal()
+{	std::vector<time_t> modTimePrev = externalModTime;
+	externalModTime.clear();
+	for(const string& fname: VexternalFilename) externalModTime.push_back(fileModTime(fname));
+	if(rhoExternalFilename.length()) externalModTime.push_back(fileModTime(rhoExternalFilename));
+	if(externalModTime != modTimePrev)
+	{	logPrintf("External potential / charge files modified: updating.\n");
+		readExternal();
+	}
+}
+
 // Kernel for generating box shaped external potentials
 void applyBoxPot(int i, vector3<> r, matrix3<>& R, const ElecVars::BoxPotential* bP, double* Vbox)
 {	// Map lattice intervals [0,1) to [-0.5,0.5)
@@ -52,6 +122,72 @@ void applyBoxPot(int i, vector3<> r, matrix3<>& R, const ElecVars::BoxPotential*
 	Vbox[i] = bP->Vin;
 }
 
+//Background reader of restart files: the data is only pulled into the operating-system file cache,
+//from which the regular (MPI) reads in ElecVars::setup and FluidSolver::loadState are then served.
+//Uses only POSIX I/O on its own thread (no MPI calls), and ignores any errors (left to the regular reads).
+struct RestartPrefetch
+{	std::vector<string> fnames;
+	std::thread thread;
+
+	RestartPrefetch(const std::vector<string>& fnames, bool readFully) : fnames(fnames)
+	{	thread = std::thread(&RestartPrefetch::run, this, readFully);
+	}
+	~RestartPrefetch() { wait(); }
+	void wait() { if(thread.joinable()) thread.join(); }
+
+	void run(bool readFully)
+	{	const size_t chunkSize = 1<<22;
+		std::vector<char> buf(readFully ? chunkSize : 0);
+		for(const string& fname: fnames)
+		{	int fd = open(fname.c_str(), O_RDONLY);
+			if(fd < 0) continue;
+			posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED); //asynchronous read-ahead of the whole file
+			if(readFully) //additionally block this thread on the data, so that it is resident once wait() returns
+				while(read(fd, buf.data(), chunkSize) > 0);
+			close(fd);
+		}
+	}
+};
+
+void ElecVars::prefetchRestart(const Everything &everything)
+{	//Collect the restart files that setup() will read (file names and sizes are known once the input is parsed):
+	std::vector<string> candidates;
+	if(!skipWfnsInit && wfnsFilename.length() && wfnsFilename.find('%')==string::npos //(per-column real-space files not prefetched)
+		&& !(everything.cntrl.fixed_H && everything.cntrl.streamBands))
+		candidates.push_back(wfnsFilename);
+	if(eigsFilename.length()) candidates.push_back(eigsFilename);
+	if(fluidInitialStateFilename.length() && fluidParams.fluidType!=FluidNone) candidates.push_back(fluidInitialStateFilename);
+	if(everything.cntrl.fixed_H)
+	{	string fnamePattern = nFilenamePattern.length() ? nFilenamePattern : VFilenamePattern;
+		size_t pos = fnamePattern.find("$VAR");
+		if(pos != string::npos)
+		{	std::vector<string> vars = nFilenamePattern.length()
+				? std::vector<string>{"n", "tau", "rhoAtom"}
+				: std::vector<string>{"Vscloc", "Vtau", "U_rhoAtom"};
+			for(const string& var: vars)
+				for(const char* suffix: {"", "_up", "_dn", "_re", "_im"})
+				{	string fname = fnamePattern;
+					fname.replace(pos,4, var+suffix);
+					candidates.push_back(fname);
+				}
+		}
+	}
+	//Keep only those that exist:
+	std::vector<string> fnames;
+	size_t nBytes = 0;
+	for(const string& fname: candidates)
+	{	struct stat st;
+		if(stat(fname.c_str(), &st)==0 && S_ISREG(st.st_mode) && st.st_size)
+		{	fnames.push_back(fname);
+			nBytes += st.st_size;
+		}
+	}
+	if(!fnames.size()) return;
+	logPrintf("Prefetching %d restart file(s) (%.1lf MB) in the background.\n", int(fnames.size()), nBytes*1e-6);
+	//Only the head reads the data fully; other processes only request read-ahead on their node:
+	restartPrefetch = std::make_shared<RestartPrefetch>(fnames, mpiWorld->isHead());
+}
+
 void ElecVars::setup(const Everything &everything)
 {	
 	this->e = &everything;
@@ -71,50 +207,35 @@ void ElecVars::setup(const Everything &everything)
 		iInfo.rhoAtom_initZero(U_rhoAtom);
 	}
 	
-	if(VexternalFilename.size())
-	{	Vexternal.resize(VexternalFilename.size());
-		for(unsigned s=0; s<Vexternal.size(); s++)
-		{	Vexternal[s] = ScalarFieldData::alloc(gInfo);
-			logPrintf("Reading external potential from '%s'\n", VexternalFilename[s].c_str());
-			loadRawBinary(Vexternal[s], VexternalFilename[s].c_str());
-		}
-		if(Vexternal.size()==1 && n.size()==2) //Replicate potential for second spin:
-			Vexternal.push_back(Vexternal[0]->clone());
-	}
-
 	//Vexternal contributions from boxPot's.
 	for(size_t j = 0; j<boxPot.size(); j++)
 	{	//Create potential
 		ScalarField temp; nullToZero(temp, e->gInfo);
 		applyFunc_r(e->gInfo, applyBoxPot, gInfo.R, &boxPot[j], temp->data());
 		temp = I(gaussConvolve(J(temp), boxPot[j].convolve_radius));
-		//Add to Vexternal
-		if(!Vexternal.size()) Vexternal.resize(n.size());
-		for(unsigned s=0; s<n.size(); s++) Vexternal[s] += temp;
+		VexternalFixed += temp;
 	}
 
 	//Vexternal contributions due to external field
 	if(e->coulombParams.Efield.length_squared())
-	{	ScalarField temp = e->coulomb->getEfieldPotential();
-		//Add to Vexternal
-		if(!Vexternal.size()) Vexternal.resize(n.size());
-		for(unsigned s=0; s<n.size(); s++) Vexternal[s] += temp;
-	}
-
-	if(rhoExternalFilename.length())
-	{	logPrintf("Reading external charge from '%s'\n", rhoExternalFilename.c_str());
-		ScalarField temp(ScalarFieldData::alloc(gInfo));
-		loadRawBinary(temp, rhoExternalFilename.c_str());
-		rhoExternal = J(temp);
-	}
+		VexternalFixed += e->coulomb->getEfieldPotential();
 	
+	//Vexternal and rhoExternal from files (and combine with above):
+	readExternal();
 	
 	//Initialize matrix arrays if required:
 	Hsub.resize(eInfo.nStates);
+	stateTime.assign(eInfo.nStates, 0.);
 	Hsub_evecs.resize(eInfo.nStates);
 	Hsub_eigs.resize(eInfo.nStates);
 	if(eInfo.fillingsUpdate==ElecInfo::FillingsHsub)
 		Haux_eigs.resize(eInfo.nStates);
+	if(restartPrefetch) //hand off restart files read in the background since the start of Everything::setup
+	{	static StopWatch watch("ElecVars::prefetchWait"); watch.start();
+		restartPrefetch->wait();
+		restartPrefetch = 0;
+		watch.stop();
+	}
 	if(eigsFilename.length())
 	{	eInfo.read(Hsub_eigs, eigsFilename.c_str());
 		if(eInfo.fillingsUpdate==ElecInfo::FillingsHsub)
@@ -183,6 +304,12 @@ void ElecVars::setup(const Everything &everything)
 	{	C.resize(eInfo.nStates); //skip memory allocation, but initialize array
 		logPrintf("Skipped wave function initialization.\n");
 	}
+	else if(e->cntrl.fixed_H && e->cntrl.streamBands)
+	{	C.resize(eInfo.nStates); //allocated one state at a time by bandMinimize
+		if(wfnsFilename.length())
+			logPrintf("WARNING: ignoring initial wavefunctions '%s' in band streaming mode.\n", wfnsFilename.c_str());
+		logPrintf("Wave functions will be initialized one state at a time (band streaming).\n");
+	}
 	else
 	{
 		// Initialize ColumnBundle arrays for the electronic wave-functions:
@@ -191,7 +318,12 @@ void ElecVars::setup(const Everything &everything)
 
 		//Initial wave functions
 		int nBandsInited = 0;
-		if(wfnsFilename.length())
+		if(wfnsFilename.length() && wfnsKmeshFilename.length())
+		{	logPrintf("reading from '%s' on a different k-mesh\n", wfnsFilename.c_str()); logFlush();
+			nBandsInited = readKmesh();
+			isRandom = (nBandsInited<eInfo.nBands);
+		}
+		else if(wfnsFilename.length())
 		{	logPrintf("reading from '%s'\n", wfnsFilename.c_str()); logFlush();
 			if(readConversion) readConversion->Ecut = e->cntrl.Ecut;
 			eInfo.read(C, wfnsFilename.c_str(), readConversion.get());
@@ -337,7 +469,8 @@ void ElecVars::EdensityAndVscloc(Energies& ener, const ExCorr* alternateExCorr)
 		{	if(e->cntrl.fixed_H) die("Orbital-dependent potential functionals do not support fix-density; use fix-potential instead.\n")
 			else die("Orbital-dependent potential functionals do not support total-energy minimization; use SCF instead.\n")
 		}
-		Vxc += exCorr.orbitalDep->getPotential();
+		Vxc += nOrbitalDep.size() ? exCorr.orbitalDep->getPotential(nOrbitalDep) : exCorr.orbitalDep->getPotential();
+		nOrbitalDep.clear(); //only valid along with the density it was computed with
 	}
 	if(VtauTilde) Vtau.resize(n.size());
 	for(unsigned s=0; s<Vscloc.size(); s++)
@@ -349,13 +482,31 @@ void ElecVars::EdensityAndVscloc(Energies& ener, const ExCorr* alternateExCorr)
 		{	ener.E["Eexternal"] += e->gInfo.dV * dot(n[s], Vexternal[s]);
 			Vscloc[s] += JdagOJ(Vexternal[s]);
 		}
-		e->symm.symmetrize(Vscloc[s]);
 		if(VtauTilde) Vtau[s] += I(VtauTilde);
-		if(Vtau[s]) e->symm.symmetrize(Vtau[s]);
 	}
+	e->symm.symmetrize(Vscloc); //all spin channels together
+	e->symm.symmetrize(Vtau);
+	VsclocSrc.clear(); VtauSrc.clear(); //invalidate wavefunction-grid copies (Vtau may have been updated in place)
 	watch.stop();
 }
 
+const ScalarFieldArray& ElecVars::onWfnsGrid(const ScalarFieldArray& V, ScalarFieldArray& Vsrc, ScalarFieldArray& Vwfns)
+{	if(!e->gInfoWfns || !V.size()) return V;
+	//Check if V has been replaced (SCF mixing / EdensityAndVscloc assign new fields) since the previous conversion:
+	bool changed = (Vsrc.size() != V.size());
+	for(size_t s=0; s<V.size() && !changed; s++)
+		if(Vsrc[s] != V[s]) changed = true;
+	if(changed)
+	{	static StopWatch watch("ElecVars::onWfnsGrid"); watch.start();
+		Vwfns.assign(V.size(), ScalarField());
+		for(size_t s=0; s<V.size(); s++)
+			if(V[s]) Vwfns[s] = Jdag(changeGrid(Idag(V[s]), *(e->gInfoWfns)), true);
+		Vsrc = V; //holding references also prevents reuse of the addresses compared above
+		watch.stop();
+	}
+	return Vwfns;
+}
+
 
 //-----  Electronic energy and (preconditioned) gradient calculation ----------
 
@@ -384,9 +535,16 @@ double ElecVars::elecEnergyAndGrad(Energies& ener, ElecGradient* grad, ElecGradi
 		if(e->cntrl.scf && n[0]) eInfo.smearReport();
 	}
 	
-	//Update the density and density-dependent pieces if required:
-	n = calcDensity();
-	if(e->exCorr.needsKEdensity()) tau = KEdensity();
+	//Update the density and density-dependent pieces if required
+	//(along with any orbital-weighted density of an orbital-dependent functional, from the same real-space orbitals):
+	std::vector<std::vector<diagMatrix>> Fsets(1, F);
+	if(e->exCorr.orbitalDep)
+	{	std::vector<diagMatrix> Fweighted = e->exCorr.orbitalDep->getDensityWeights();
+		if(Fweighted.size()) Fsets.push_back(Fweighted);
+	}
+	std::vector<ScalarFieldArray> densities = calcDensities(Fsets, e->exCorr.needsKEdensity() ? &tau : 0); //KE density (if needed) from the same pass
+	n = densities[0];
+	nOrbitalDep = (Fsets.size() > 1) ? densities[1] : ScalarFieldArray();
 	if(eInfo.hasU) e->iInfo.rhoAtom_calc(F, C, rhoAtom); //Atomic density matrix contributions for DFT+U
 	EdensityAndVscloc(ener); //Calculate density functional and its gradient
 	if(need_Hsub) e->iInfo.augmentDensityGridGrad(Vscloc); //Update Vscloc projected onto spherical functions for ultrasoft psps
@@ -401,14 +559,21 @@ double ElecVars::elecEnergyAndGrad(Energies& ener, ElecGradient* grad, ElecGradi
 	{	double aXX = e->exCorr.exxFactor();
 		double omega = e->exCorr.exxRange();
 		assert(e->exx);
-		ener.E["EXX"] = (*e->exx)(aXX, omega, F, C, need_Hsub ? &HC : 0);
+		bool buildACE = e->cntrl.scf; //SCF eigensolver steps use the ACE operator at the current wavefunctions, refreshed once per SCF cycle
+		ener.E["EXX"] = (*e->exx)(aXX, omega, F, C, (need_Hsub || buildACE) ? &HC : 0);
+		if(buildACE)
+		{	e->exx->setACE(C, HC);
+			if(!need_Hsub) HC.assign(eInfo.nStates, ColumnBundle()); //exchange gradient only needed for ACE
+		}
 	}
 	
 	//Do the single-particle contributions one state at a time to save memory (and for better cache warmth):
 	ener.E["KE"] = 0.;
 	ener.E["Enl"] = 0.;
+	//(Hsub of all states is diagonalized together after the loop, batched or collectively within state groups)
 	for(int q=eInfo.qStart; q<e->eInfo.qStop; q++)
-	{	double KEq = applyHamiltonian(q, F[q], HC[q], ener, need_Hsub);
+	{	if(q+1 < eInfo.qStop) C[q+1].prefetchGpu(); //overlap transfer of next state with this one (wavefunction-offload only)
+		double KEq = applyHamiltonian(q, F[q], HC[q], ener, need_Hsub, true, false, false); //exact exchange already in HC
 		if(grad) //Calculate wavefunction gradients:
 		{	const QuantumNumber& qnum = eInfo.qnums[q];
 			HC[q] -= O(C[q]) * Hsub[q]; //Include orthonormality contribution
@@ -421,6 +586,7 @@ double ElecVars::elecEnergyAndGrad(Energies& ener, ElecGradient* grad, ElecGradi
 			}
 		}
 	}
+	if(need_Hsub) eInfo.diagonalizeStates(Hsub, Hsub_evecs, Hsub_eigs);
 	mpiWorld->allReduce(ener.E["KE"], MPIUtil::ReduceSum);
 	mpiWorld->allReduce(ener.E["Enl"], MPIUtil::ReduceSum);
 	
@@ -549,79 +715,242 @@ ScalarFieldArray ElecVars::KEdensity() const
 	for(int q=e->eInfo.qStart; q<e->eInfo.qStop; q++)
 		for(int iDir=0; iDir<3; iDir++)
 			tau += (0.5*C[q].qnum->weight) * diagouterI(F[q], D(C[q],iDir), tau.size(), &e->gInfo);
+	KEdensityFinish(tau);
+	return tau;
+}
+
+void ElecVars::KEdensityFinish(ScalarFieldArray& tau) const
+{	nullToZero(tau, e->gInfo, n.size());
+	e->symm.symmetrize(tau); //Symmetrize (all spin channels together)
 	for(ScalarField& tau_s: tau)
-	{	nullToZero(tau_s, e->gInfo);
-		e->symm.symmetrize(tau_s); //Symmetrize
 		tau_s->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-	}
 	//Add core KE density model:
 	if(e->iInfo.tauCore)
 	{	for(unsigned s=0; s<tau.size(); s++)
 			tau[s] += (1.0/tau.size()) * e->iInfo.tauCore; //add core KE density
 	}
-	return tau;
 }
 
 ScalarFieldArray ElecVars::calcDensity() const
-{	ScalarFieldArray density(n.size());
-	//Runs over all states and accumulates density to the corresponding spin channel of the total density
-	e->iInfo.augmentDensityInit();
-	for(int q=e->eInfo.qStart; q<e->eInfo.qStop; q++)
-	{	density += e->eInfo.qnums[q].weight * diagouterI(F[q], C[q], density.size(), &e->gInfo);
-		e->iInfo.augmentDensitySpherical(e->eInfo.qnums[q], F[q], VdagC[q]); //pseudopotential contribution
+{	return calcDensities(std::vector<std::vector<diagMatrix>>(1, F))[0];
+}
+
+std::vector<ScalarFieldArray> ElecVars::calcDensities(const std::vector<std::vector<diagMatrix>>& Fsets, ScalarFieldArray* tau) const
+{	const ElecInfo& eInfo = e->eInfo;
+	int nSets = Fsets.size();
+	std::vector<ScalarFieldArray> densities(nSets, ScalarFieldArray(n.size()));
+	if(tau) *tau = ScalarFieldArray(n.size());
+	ScalarFieldArray tauq;
+	//Runs over all states and accumulates densities of all sets to the corresponding spin channels:
+	std::vector<diagMatrix> Fq(nSets);
+	if(eInfo.stateGroupShared())
+	{	//Band-parallel: the owner shares each state with the helpers in its state group (see ElecInfo::mpiStateGroup),
+		//and each member accumulates the density of a share of the bands (collected by the reduction below):
+		static StopWatch watchShare("ElecVars::calcDensities(share)");
+		const MPIUtil* mpiGroup = eInfo.mpiStateGroup.get();
+		bool isOwner = (mpiGroup->iProcess() == eInfo.iStateGroupOwner);
+		TaskDivision bandDivision(eInfo.nBands, mpiGroup);
+		int bStart = bandDivision.start(), bStop = bandDivision.stop();
+		for(int q=eInfo.qStartGroup; q<eInfo.qStopGroup; q++)
+		{	watchShare.start();
+			ColumnBundle Cq;
+			if(isOwner) Cq = C[q];
+			else Cq.init(eInfo.nBands, e->basis[q].nbasis*eInfo.spinorLength(), &e->basis[q], &eInfo.qnums[q], isGpuEnabled());
+			mpiGroup->bcastData(Cq, eInfo.iStateGroupOwner);
+			for(int iSet=0; iSet<nSets; iSet++)
+			{	Fq[iSet] = isOwner ? Fsets[iSet][q] : diagMatrix(eInfo.nBands);
+				mpiGroup->bcastData(Fq[iSet], eInfo.iStateGroupOwner);
+				Fq[iSet] = Fq[iSet](bStart, bStop);
+			}
+			watchShare.stop();
+			if(bStart == bStop) continue;
+			std::vector<ScalarFieldArray> nq = diagouterI(Fq, Cq.getSub(bStart, bStop), n.size(), &e->gInfo, tau ? &tauq : 0);
+			for(int iSet=0; iSet<nSets; iSet++)
+				densities[iSet] += eInfo.qnums[q].weight * nq[iSet];
+			if(tau) *tau += eInfo.qnums[q].weight * tauq;
+		}
+	}
+	else
+	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	if(q+1 < eInfo.qStop) C[q+1].prefetchGpu(); //overlap transfer of next state with this one (wavefunction-offload only)
+			for(int iSet=0; iSet<nSets; iSet++) Fq[iSet] = Fsets[iSet][q];
+			std::vector<ScalarFieldArray> nq = diagouterI(Fq, C[q], n.size(), &e->gInfo, tau ? &tauq : 0);
+			for(int iSet=0; iSet<nSets; iSet++)
+				densities[iSet] += eInfo.qnums[q].weight * nq[iSet];
+			if(tau) *tau += eInfo.qnums[q].weight * tauq;
+		}
 	}
-	e->iInfo.augmentDensityGrid(density);
 	
-	for(ScalarField& ns: density)
-	{	nullToZero(ns, e->gInfo);
-		e->symm.symmetrize(ns); //Symmetrize
-		ns->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+	for(int iSet=0; iSet<nSets; iSet++)
+	{	ScalarFieldArray& density = densities[iSet];
+		//Pseudopotential contributions (from stored projections):
+		e->iInfo.augmentDensityInit();
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+			e->iInfo.augmentDensitySpherical(eInfo.qnums[q], Fsets[iSet][q], VdagC[q]);
+		
+		//Collect over processes, pipelined over spin channels so that the reduction
+		//of each channel overlaps with augmentation and symmetrization of the next:
+		e->iInfo.augmentDensityReduce(true);
+		std::vector<MPIUtil::Request> requests(density.size());
+		for(unsigned s=0; s<density.size(); s++)
+		{	ScalarField& ns = density[s];
+			e->iInfo.augmentDensityGrid(density, s);
+			nullToZero(ns, e->gInfo);
+			e->symm.symmetrize(ns); //Symmetrize
+			ns->allReduceData(mpiWorld, MPIUtil::ReduceSum, false, &requests[s]);
+		}
+		MPIUtil::waitAll(requests);
+	}
+	if(tau) KEdensityFinish(*tau);
+	return densities;
+}
+
+//CholeskyQR2 rotation for overlap Osub (rot^ Osub rot = 1 with upper-triangular rot), or null if Osub is ill-conditioned.
+//The second pass corrects the rounding errors of the first using the overlap transformed by it (instead of recomputing it).
+static matrix choleskyRotation(const matrix& Osub)
+{	bool isSingular = false;
+	matrix rot1 = invCholesky(Osub, &isSingular);
+	if(isSingular) return matrix();
+	//Estimate condition number from the diagonal of the triangular factor (squared for Osub):
+	double dMin = DBL_MAX, dMax = 0.;
+	const complex* rot1data = rot1.data();
+	for(int i=0; i<rot1.nRows(); i++)
+	{	double d = rot1data[rot1.index(i,i)].abs();
+		dMin = std::min(dMin, d);
+		dMax = std::max(dMax, d);
+	}
+	if(std::pow(dMax/dMin, 2) > 1e8) return matrix(); //CholeskyQR2 unstable beyond ~ 1/sqrt(epsilon)
+	matrix rot2 = invCholesky(dagger_symmetrize(dagger(rot1) * Osub * rot1), &isSingular);
+	if(isSingular) return matrix();
+	return rot1 * rot2;
+}
+
+//Orthonormalizing rotation for overlap Osub by the selected method:
+static matrix orthoRotation(const matrix& Osub, ElecVars::OrthoMethod orthoMethod)
+{	if(orthoMethod == ElecVars::OrthoCholesky)
+	{	matrix rot = choleskyRotation(Osub);
+		if(rot) return rot;
 	}
-	return density;
+	return invsqrt(Osub);
 }
 
 void ElecVars::orthonormalize(int q, matrix* extraRotation)
 {	assert(e->eInfo.isMine(q));
 	VdagC[q].clear();
-	matrix rot = invsqrt(C[q]^O(C[q], &VdagC[q])); //Compute U:
+	matrix rot = orthoRotation(C[q]^O(C[q], &VdagC[q]), orthoMethod); //Compute U:
 	if(extraRotation) *extraRotation = (rot = rot * (*extraRotation)); //set rot and extraRotation to the net transformation
 	C[q] = C[q] * rot;
 	e->iInfo.project(C[q], VdagC[q], &rot); //update the atomic projections
 }
 
-double ElecVars::applyHamiltonian(int q, const diagMatrix& Fq, ColumnBundle& HCq, Energies& ener, bool need_Hsub)
+void ElecVars::orthonormalizeAll(std::vector<matrix>* extraRotations, const std::vector<matrix>* overlaps)
+{	const ElecInfo& eInfo = e->eInfo;
+	//Overlaps of all local states (multiplies batched over states), unless provided:
+	std::vector<matrix> Osub(eInfo.nStates), rot(eInfo.nStates);
+	if(overlaps) Osub = *overlaps;
+	else
+	{	std::vector<ColumnBundle> OC(eInfo.nStates);
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	VdagC[q].clear();
+			OC[q] = O(C[q], &VdagC[q]);
+		}
+		overlapBatch(C, OC, Osub, eInfo.qStart, eInfo.qStop);
+	}
+	if(orthoMethod == OrthoCholesky) //CholeskyQR2 of each local state (serial eigen path only for ill-conditioned overlaps):
+	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+			rot[q] = orthoRotation(Osub[q], orthoMethod);
+	}
+	else //Symmetric orthonormalization (overlaps diagonalized together, see ElecInfo::diagonalizeStates):
+	{	std::vector<matrix> Oevecs(eInfo.nStates);
+		std::vector<diagMatrix> Oeigs(eInfo.nStates);
+		eInfo.diagonalizeStates(Osub, Oevecs, Oeigs);
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	for(double& eig: Oeigs[q])
+			{	if(eig <= 0.) die("Wavefunction overlap is singular in orthonormalizeAll.\n");
+				eig = 1./sqrt(eig);
+			}
+			rot[q] = Oevecs[q] * Oeigs[q] * dagger(Oevecs[q]); //as in invsqrt
+		}
+	}
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		if(extraRotations) extraRotations->at(q) = (rot[q] = rot[q] * extraRotations->at(q));
+	multiplyBatch(C, rot, C, eInfo.qStart, eInfo.qStop);
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		e->iInfo.project(C[q], VdagC[q], &rot[q]); //update the atomic projections
+}
+
+void ElecVars::resizeBands(int nBandsNew)
+{	ElecInfo& eInfo = (ElecInfo&)e->eInfo;
+	int nBandsOld = eInfo.nBands;
+	if(nBandsNew == nBandsOld) return;
+	int nKeep = std::min(nBandsOld, nBandsNew);
+	eInfo.nBands = nBandsNew;
+	//Resize a vector of eigenvalues / fillings, padding with the specified value:
+	auto resize = [&](const diagMatrix& d, double pad)
+	{	diagMatrix dNew(nBandsNew, pad);
+		for(int b=0; b<nKeep; b++) dNew[b] = d[b];
+		return dNew;
+	};
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	//Keep the lowest eigenvectors of Hsub:
+		matrix keep = Hsub_evecs[q](0,nBandsOld, 0,nKeep);
+		ColumnBundle Cnew = C[q].similar(nBandsNew);
+		Cnew.setSub(0, C[q] * keep);
+		for(matrix& VdagCq_sp: VdagC[q])
+			if(VdagCq_sp) VdagCq_sp = VdagCq_sp * keep;
+		C[q] = Cnew;
+		//Add random bands orthogonal to the kept ones (so that orthonormalization leaves those unchanged):
+		if(nBandsNew > nKeep)
+		{	ColumnBundle Ckeep = C[q].getSub(0, nKeep);
+			ColumnBundle Cextra = Ckeep.similar(nBandsNew-nKeep);
+			Cextra.randomize(0, Cextra.nCols(), nKeep);
+			Cextra -= Ckeep * (Ckeep ^ O(Cextra));
+			C[q].setSub(nKeep, Cextra);
+			orthonormalize(q);
+		}
+		//Subspace quantities in the new (eigen)basis:
+		double epsPad = Hsub_eigs[q][nBandsOld-1];
+		Hsub_eigs[q] = resize(Hsub_eigs[q], epsPad);
+		Hsub[q] = Hsub_eigs[q];
+		Hsub_evecs[q] = eye(nBandsNew);
+		if(Haux_eigs[q].nRows()) Haux_eigs[q] = resize(Haux_eigs[q], epsPad);
+		F[q] = resize(F[q], 0.);
+	}
+}
+
+double ElecVars::applyHamiltonian(int q, const diagMatrix& Fq, ColumnBundle& HCq, Energies& ener, bool need_Hsub, bool compute_Hsub, bool diagonalize_Hsub, bool includeACE)
 {	assert(C[q]); //make sure wavefunction is available for this states
+	double tStart = clock_sec();
 	const QuantumNumber& qnum = e->eInfo.qnums[q];
 	std::vector<matrix> HVdagCq(e->iInfo.species.size());
 	
 	//Propagate grad_n (Vscloc) to HCq (which is grad_Cq upto weights and fillings) if required
 	if(need_Hsub)
-	{	HCq += Idag_DiagV_I(C[q], Vscloc); //Accumulate Idag Diag(Vscloc) I C
+	{	//Accumulate Idag Diag(Vscloc) I C, and the contribution via orbital KE if any, in one pass over the bands:
+		bool needVtau = e->exCorr.needsKEdensity() && Vtau[qnum.index()];
+		const ScalarFieldArray& VsclocQ = onWfnsGrid(Vscloc, VsclocSrc, VsclocWfns); //interpolated once for all states (dual-grid mode)
+		const ScalarFieldArray* VtauQ = needVtau ? &onWfnsGrid(Vtau, VtauSrc, VtauWfns) : 0;
+		Idag_DiagV_I_accum(C[q], VsclocQ, HCq, VtauQ, -0.5*e->gInfo.dV);
 		e->iInfo.augmentDensitySphericalGrad(qnum, VdagC[q], HVdagCq); //Contribution via pseudopotential density augmentation
-		if(e->exCorr.needsKEdensity() && Vtau[qnum.index()]) //Contribution via orbital KE:
-		{	for(int iDir=0; iDir<3; iDir++)
-				HCq -= (0.5*e->gInfo.dV) * D(Idag_DiagV_I(D(C[q],iDir), Vtau), iDir);
-		}
 		if(e->eInfo.hasU) //Contribution via atomic density matrix projections (DFT+U)
 			e->iInfo.rhoAtom_grad(C[q], U_rhoAtom, HCq);
+		if(includeACE && e->exx) //Exact exchange via ACE operator (if set)
+			e->exx->applyACE(q, C[q], HCq);
 	}
 
 	//Kinetic energy:
-	double KEq;
-	{	ColumnBundle LCq = L(C[q]);
-		if(HCq) HCq += (-0.5) * LCq;
-		KEq = qnum.weight * (-0.5) * traceinner(Fq, C[q], LCq).real();
-		ener.E["KE"] += KEq;
-	}
+	double KEq = qnum.weight * trace(Fq * applyKinetic(C[q], HCq ? &HCq : 0));
+	ener.E["KE"] += KEq;
 	
 	//Nonlocal pseudopotentials:
 	ener.E["Enl"] += qnum.weight * e->iInfo.EnlAndGrad(qnum, Fq, VdagC[q], HVdagCq);
 	if(HCq) e->iInfo.projectGrad(HVdagCq, C[q], HCq);
 	
 	//Compute subspace hamiltonian if needed:
-	if(need_Hsub)
+	if(need_Hsub && compute_Hsub)
 	{	Hsub[q] = C[q] ^ HCq;
-		Hsub[q].diagonalize(Hsub_evecs[q], Hsub_eigs[q]);
+		if(diagonalize_Hsub) Hsub[q].diagonalize(Hsub_evecs[q], Hsub_eigs[q]);
 	}
+	stateTime[q] += clock_sec() - tStart;
 	return KEq;
 }
@@ -74,6 +74,15 @@ public:
 		double convolve_radius; //!< smoothing radius
 	};
 	std::vector<BoxPotential> boxPot; //!< parameters for the external box potential
+	bool externalRefresh; //!< whether to re-read the Vexternal and rhoExternal files when modified, before each electronic minimization
+	
+	//! Replace the potential from Vexternal (keeping box-potential and electric-field contributions) and / or the external charge
+	//! in memory, eg. between ionic or dynamics steps of a QM/MM calculation. A null argument leaves that part unchanged,
+	//! while empty / null contents remove it. VexternalNew must have one component per density component (or one for both spins).
+	//! Only the dependent energy terms and potentials, which are recomputed at the next energy evaluation, change:
+	//! wavefunctions, SCF mixing history and fluid state carry over as the starting point. Must be called on all processes together.
+	void setExternal(const ScalarFieldArray* VexternalNew, const ScalarFieldTilde* rhoExternalNew);
+	void refreshExternal(); //!< re-read Vexternal and rhoExternal files if modified since they were last read (see externalRefresh)
 
 	//Fluid properties
 	FluidSolverParams fluidParams;
@@ -83,7 +92,9 @@ public:
 	//Wavefunction initialization:
 	string wfnsFilename; //!< file to read wavefunctions from
 	std::shared_ptr<struct ElecInfo::ColumnBundleReadConversion> readConversion; //!< ColumnBundle conversion
+	string wfnsKmeshFilename; //!< if non-empty, wfnsFilename is from a different k-mesh with k-points listed in this file (see wavefunction read-kmesh)
 	bool isRandom; //!< indicates whether the electronic state is random (not yet minimized)
+	std::vector<double> stateTime; //!< accumulated applyHamiltonian wall time of each local state (for measured load balancing, see ElecInfo::stateBalance)
 	bool initLCAO; //!< initialize wave functions using linear combinations of atomic orbitals
 	bool skipWfnsInit; //!< whether to skip wavefunction initialization (used to speed up dry runs, phonon calculations)
 
@@ -98,6 +109,11 @@ public:
 	ElecVars();
 	void setup(const Everything &everything);
 
+	//! Start reading the restart files (wavefunctions, eigenvalues, fluid state, fixed density / potential) into the
+	//! operating-system file cache on a background thread, so that the reads in setup() overlap the preceding setup phases.
+	//! Called at the start of Everything::setup; setup() waits for the prefetch to complete before its own (cached) reads.
+	void prefetchRestart(const Everything &everything);
+
 	//! Compute the terms written as a functional of the electronic density, and its gradient i.e. Vscloc
 	//! If supplied, alternateExCorr replaces the main exchange and correlaton functional
 	void EdensityAndVscloc(Energies& ener, const ExCorr* alternateExCorr=0);
@@ -111,31 +127,73 @@ public:
 	
 	//! Compute the kinetic energy density
 	ScalarFieldArray KEdensity() const;
+	void KEdensityFinish(ScalarFieldArray& tau) const; //!< symmetrize, collect over processes and add core contributions to the valence KE density
 	
 	//! Calculate density using current orthonormal wavefunctions (C)
 	ScalarFieldArray calcDensity() const;
 	
+	//! Calculate densities using current orthonormal wavefunctions (C) for several sets of fillings Fsets[iSet][q] (local states only) together,
+	//! transforming each wavefunction to real space once for all the sets.
+	//! If tau is non-null, also compute the KE density (as in KEdensity) for Fsets[0] in the same pass over the bands
+	std::vector<ScalarFieldArray> calcDensities(const std::vector<std::vector<diagMatrix>>& Fsets, ScalarFieldArray* tau=0) const;
+	
+	//! Method used by orthonormalize and orthonormalizeAll
+	enum OrthoMethod
+	{	OrthoSymmetric, //!< symmetric (Lowdin) orthonormalization by invsqrt of the overlap (eigen-decomposition)
+		OrthoCholesky //!< CholeskyQR2 by triangular factors of the overlap, falling back to OrthoSymmetric for ill-conditioned overlaps
+	}
+	orthoMethod;
+	
 	//! Orthonormalise wavefunctions, with an optional extra rotation
-	//! If extraRotation is present, it is applied after symmetric orthononormalization,
+	//! If extraRotation is present, it is applied after orthononormalization (by orthoMethod),
 	//! and on output extraRotation contains the net transformation applied to the wavefunctions.
 	void orthonormalize(int q, matrix* extraRotation=0);
 	
 	//! Applies the Kohn-Sham Hamiltonian on the orthonormal wavefunctions C, and computes Hsub if necessary, for a single quantum number
 	//! Returns the Kinetic energy contribution from q, which can be used for the inverse kinetic preconditioner
-	double applyHamiltonian(int q, const diagMatrix& Fq, ColumnBundle& HCq, Energies& ener, bool need_Hsub = false);
+	//! If compute_Hsub is false, all terms of need_Hsub mode are still applied, but Hsub is neither computed nor diagonalized
+	//! (used by eigensolvers to apply the fixed Hamiltonian to trial vectors placed in C[q], with projections in VdagC[q]).
+	//! If diagonalize_Hsub is false, Hsub is computed but its diagonalization is left to the caller (eg. with ElecInfo::diagonalizeStates).
+	//! If includeACE is true and an ACE exchange operator has been set (see ExactExchange::setACE), it is included in HCq.
+	double applyHamiltonian(int q, const diagMatrix& Fq, ColumnBundle& HCq, Energies& ener, bool need_Hsub = false, bool compute_Hsub = true, bool diagonalize_Hsub = true, bool includeACE = true);
+	
+	//! Orthonormalize wavefunctions of all local states, equivalent to orthonormalize(q, extraRotations ? &extraRotations->at(q) : 0),
+	//! but with the overlaps and rotations batched over states (see overlapBatch and multiplyBatch),
+	//! and the overlap diagonalizations batched over states or shared within state groups (see ElecInfo::diagonalizeStates).
+	//! If overlaps is provided, it must contain the overlaps C^O(C) of all local states, with VdagC already the projections of the current C
+	//! (used by ElecMinimizer to update both algebraically along a line search direction, instead of recomputing them).
+	//! Must be called on all processes together.
+	void orthonormalizeAll(std::vector<matrix>* extraRotations=0, const std::vector<matrix>* overlaps=0);
+	
+	//! Change the number of bands (ElecInfo::nBands) of all states, keeping the lowest eigenvectors of Hsub
+	//! and adding random orthonormal bands (with zero fillings and eigenvalues of the previous highest band) if needed
+	void resizeBands(int nBandsNew);
 	
 private:
 	const Everything* e;
+	std::shared_ptr<struct RestartPrefetch> restartPrefetch; //!< background reader of restart files (see prefetchRestart)
+	ScalarFieldArray nOrbitalDep; //!< orbital-weighted density of an orbital-dependent functional, computed with n in elecEnergyAndGrad for the following EdensityAndVscloc
+	
+	//Vscloc and Vtau interpolated to the wavefunction grid (if separate, see Everything::gInfoWfns), once per change rather than per state:
+	ScalarFieldArray VsclocSrc, VsclocWfns; //!< Vscloc that VsclocWfns was computed from, and the result
+	ScalarFieldArray VtauSrc, VtauWfns; //!< Vtau that VtauWfns was computed from, and the result
+	const ScalarFieldArray& onWfnsGrid(const ScalarFieldArray& V, ScalarFieldArray& Vsrc, ScalarFieldArray& Vwfns); //!< V on the wavefunction grid, reusing Vwfns if V is unchanged since Vsrc
 	
 	std::vector<string> VexternalFilename; //!< external potential filename (read in real space)
 	friend struct CommandVexternal;
 	
 	string rhoExternalFilename; //!< external charge filename
 	friend struct CommandRhoExternal;
+	ScalarFieldArray VexternalInput; //!< part of Vexternal from files or setExternal (one per density component)
+	ScalarField VexternalFixed; //!< part of Vexternal from box potentials and electric fields (same for all components)
+	std::vector<time_t> externalModTime; //!< modification times of VexternalFilename and rhoExternalFilename when last read
+	void readExternal(); //!< read Vexternal and rhoExternal files and update the corresponding potentials / charges
+	void combineVexternal(); //!< set Vexternal = VexternalInput + VexternalFixed
 
 	int lcaoIter; //!< number of iterations for LCAO (automatic if negative)
 	double lcaoTol; //!< tolerance for LCAO subspace minimization
 	int LCAO(); //!< Initialize LCAO wavefunctions (returns the number of bands initialized)
+	int readKmesh(); //!< Initialize wavefunctions from the nearest k-points of a different mesh (returns the number of bands initialized)
 	friend struct CommandWavefunction;
 	friend struct CommandLcaoParams;
 	friend class Dump;
@@ -45,17 +45,20 @@ struct LCAOminimizer : Minimizable<ElecGradient> //Uses only the Haux entries of
 	}
 	
 	void step(const ElecGradient& dir, double alpha)
-	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	//Move aux along dir after transforming dir to match rotations:
+		std::vector<matrix> Haux(eInfo.nStates), Haux_evecs(eInfo.nStates);
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
 		{	assert(dir.Haux[q]);
-			//Move aux along dir after transforming dir to match rotations:
-			matrix Haux = eVars.Haux_eigs[q], Haux_evecs;
-			axpy(alpha, dagger(rotPrev[q])*dir.Haux[q]*rotPrev[q], Haux);
-			//Adjust rotations to make Haux diagonal again:
-			Haux.diagonalize(Haux_evecs, eVars.Haux_eigs[q]);
-			rotPrev[q] = rotPrev[q] * Haux_evecs;
-			eVars.C[q] = eVars.C[q] * Haux_evecs;
+			Haux[q] = eVars.Haux_eigs[q];
+			axpy(alpha, dagger(rotPrev[q])*dir.Haux[q]*rotPrev[q], Haux[q]);
+		}
+		//Adjust rotations to make Haux diagonal again:
+		eInfo.diagonalizeStates(Haux, Haux_evecs, eVars.Haux_eigs);
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	rotPrev[q] = rotPrev[q] * Haux_evecs[q];
+			eVars.C[q] = eVars.C[q] * Haux_evecs[q];
 			for(unsigned sp=0; sp<e.iInfo.species.size(); sp++)
-				if(eVars.VdagC[q][sp]) eVars.VdagC[q][sp] = eVars.VdagC[q][sp] * Haux_evecs;
+				if(eVars.VdagC[q][sp]) eVars.VdagC[q][sp] = eVars.VdagC[q][sp] * Haux_evecs[q];
 		}
 	}
 	
@@ -96,7 +99,6 @@ struct LCAOminimizer : Minimizable<ElecGradient> //Uses only the Haux entries of
 				e.iInfo.augmentDensitySphericalGrad(qnum, eVars.VdagC[q], HVdagCq); //Contribution via pseudopotential density augmentation
 				e.iInfo.projectGrad(HVdagCq, eVars.C[q], HCq);
 				eVars.Hsub[q] = HniRot + (eVars.C[q]^HCq);
-				eVars.Hsub[q].diagonalize(eVars.Hsub_evecs[q], eVars.Hsub_eigs[q]);
 				//N/M constraint contributions to gradient:
 				diagMatrix fprime = eInfo.smearPrime(eInfo.muEff(mu,Bz,q), eVars.Haux_eigs[q]);
 				double w = eInfo.qnums[q].weight;
@@ -106,6 +108,7 @@ struct LCAOminimizer : Minimizable<ElecGradient> //Uses only the Haux entries of
 			}
 		}
 		mpiWorld->allReduce(ener.E["NI"], MPIUtil::ReduceSum);
+		if(grad) eInfo.diagonalizeStates(eVars.Hsub, eVars.Hsub_evecs, eVars.Hsub_eigs); //all states together (collectively within state groups)
 		
 		//Final gradient propagation to auxiliary Hamiltonian:
 		if(grad) 
@@ -236,10 +239,12 @@ int ElecVars::LCAO()
 			iInfo.augmentDensitySphericalGrad(eInfo.qnums[q], VdagC[q], HVdagCq); //ultrasoft augmentation
 			iInfo.projectGrad(HVdagCq, C[q], HCq);
 			Hsub[q] = dagger(lcao.rotPrev[q]) * lcao.HniSub[q] * lcao.rotPrev[q] + (C[q]^HCq);
-			
-			//Switch to eigenvectors of Hsub:
-			Hsub[q].diagonalize(Hsub_evecs[q], Hsub_eigs[q]);
-			C[q] = C[q] * Hsub_evecs[q];
+		}
+		
+		//Switch to eigenvectors of Hsub:
+		eInfo.diagonalizeStates(Hsub, Hsub_evecs, Hsub_eigs);
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{	C[q] = C[q] * Hsub_evecs[q];
 			for(unsigned sp=0; sp<iInfo.species.size(); sp++)
 				if(VdagC[q][sp]) VdagC[q][sp] = VdagC[q][sp] * Hsub_evecs[q]; 
 			lcao.rotPrev[q] = lcao.rotPrev[q] * Hsub_evecs[q];
@@ -266,12 +271,13 @@ int ElecVars::LCAO()
 	
 	//Cut wavefunctions and subspace Hamiltonia back down to size:
 	if(eInfo.nBands<lcao.nBands)
-		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
 		{	Hsub[q] = Hsub[q](0,eInfo.nBands, 0,eInfo.nBands);
-			Hsub[q].diagonalize(Hsub_evecs[q], Hsub_eigs[q]);
 			C[q] = C[q].getSub(0,eInfo.nBands);
 			Haux_eigs[q].resize(eInfo.nBands);
 		}
+		eInfo.diagonalizeStates(Hsub, Hsub_evecs, Hsub_eigs);
+	}
 	
 	//Transition fillings :
 	if(eInfo.fillingsUpdate==ElecInfo::FillingsHsub)
@@ -0,0 +1,118 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <electronic/ColumnBundleTransform.h>
+#include <core/LatticeUtils.h>
+#include <cstdio>
+#include <cfloat>
+
+//Read the k-points and spins of a previous calculation from its kPts output (see ElecInfo::kpointsPrint)
+static std::vector<QuantumNumber> readKpointsFile(const char* fname)
+{	std::vector<QuantumNumber> qnums;
+	FILE* fp = fopen(fname, "r");
+	if(!fp) die("Could not open k-points file '%s' for reading.\n", fname);
+	char line[1024];
+	while(fgets(line, sizeof(line), fp))
+	{	QuantumNumber qnum; int q, spin = 0;
+		int nRead = sscanf(line, "%d [ %lf %lf %lf ] %lf spin %d", &q, &qnum.k[0], &qnum.k[1], &qnum.k[2], &qnum.weight, &spin);
+		if(nRead < 5) continue; //not a k-point line
+		if(q != int(qnums.size())) die("k-points file '%s' is not in order of state index.\n", fname);
+		qnum.spin = spin;
+		qnums.push_back(qnum);
+	}
+	fclose(fp);
+	if(!qnums.size()) die("No k-points found in file '%s'.\n", fname);
+	return qnums;
+}
+
+int ElecVars::readKmesh()
+{	static StopWatch watch("ElecVars::readKmesh"); watch.start();
+	const ElecInfo& eInfo = e->eInfo;
+	const GridInfo& gInfoBasis = e->gInfoWfns ? *(e->gInfoWfns) : e->gInfo;
+	const std::vector<SpaceGroupOp>& sym = e->symm.getMatrices();
+	const std::vector<int>& invertList = e->symm.getKpointInvertList();
+	int nSpinor = eInfo.spinorLength();
+	double Ecut = e->cntrl.Ecut;
+
+	//Determine layout of previous wavefunctions (flat format, same Ecut and k-dependent bases):
+	std::vector<QuantumNumber> qnumsOld = readKpointsFile(wfnsKmeshFilename.c_str());
+	int nStatesOld = qnumsOld.size();
+	logPrintf("Mapping from %d states of previous k-mesh in '%s'.\n", nStatesOld, wfnsKmeshFilename.c_str());
+	for(const QuantumNumber& qnumOld: qnumsOld)
+		if((qnumOld.spin!=0) != (eInfo.spinType==SpinZ))
+			die("Spin polarization of states in '%s' does not match the current calculation.\n", wfnsKmeshFilename.c_str());
+	std::vector<size_t> colLengthOld(nStatesOld), offsetOld(nStatesOld+1, 0);
+	for(int qOld=0; qOld<nStatesOld; qOld++)
+	{	colLengthOld[qOld] = Basis::count(gInfoBasis, Ecut, qnumsOld[qOld].k) * nSpinor;
+		offsetOld[qOld+1] = offsetOld[qOld] + colLengthOld[qOld];
+	}
+	off_t fsize = fileSize(wfnsFilename.c_str());
+	size_t bytesPerBand = offsetOld.back() * sizeof(complex);
+	if(fsize <= 0 || fsize % bytesPerBand)
+		die("File '%s' is not a multiple of %zu bytes per band of the previous k-mesh.\n"
+			"Hint: the previous calculation must use the same Ecut and write wavefunctions in the flat format.\n",
+			wfnsFilename.c_str(), bytesPerBand);
+	int nBandsOld = fsize / bytesPerBand;
+	int nBandsInited = std::min(nBandsOld, eInfo.nBands);
+
+	double dkMax = 0.; //largest distance to a previous k-point
+	MPIUtil::File fp; mpiWorld->fopenRead(fp, wfnsFilename.c_str(), fsize);
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	const vector3<>& k = eInfo.qnums[q].k;
+		//Find the nearest image of a previous k-point (under the symmetries of the current calculation):
+		double dkSqMin = DBL_MAX; int qOld=0, iSym=0, invert=1; vector3<> kImage;
+		for(int qOldCur=0; qOldCur<nStatesOld; qOldCur++)
+		{	if(qnumsOld[qOldCur].spin != eInfo.qnums[q].spin) continue;
+			for(int invertCur: invertList)
+				for(unsigned iSymCur=0; iSymCur<sym.size(); iSymCur++)
+				{	vector3<> kCur = (qnumsOld[qOldCur].k * sym[iSymCur].rot) * invertCur;
+					kCur -= vector3<>(round(kCur - k)); //nearest periodic image
+					vector3<> dk = kCur - k;
+					double dkSq = dot(dk, e->gInfo.GGT * dk);
+					if(dkSq < dkSqMin - symmThresholdSq)
+					{	dkSqMin = dkSq; qOld = qOldCur; iSym = iSymCur; invert = invertCur; kImage = kCur;
+					}
+				}
+		}
+		//Read wavefunctions of that state:
+		logSuspend();
+		Basis basisOld; basisOld.setup(gInfoBasis, e->iInfo, Ecut, qnumsOld[qOld].k);
+		Basis basisImage; basisImage.setup(gInfoBasis, e->iInfo, Ecut, kImage);
+		logResume();
+		ColumnBundle Cold(nBandsOld, colLengthOld[qOld], &basisOld, 0);
+		mpiWorld->fseek(fp, offsetOld[qOld]*nBandsOld*sizeof(complex), SEEK_SET);
+		mpiWorld->freadData(Cold, fp);
+		//Rotate to the symmetry-equivalent image nearest to k:
+		ColumnBundle Cimage(nBandsOld, basisImage.nbasis*nSpinor, &basisImage, 0);
+		Cimage.zero();
+		ColumnBundleTransform(qnumsOld[qOld].k, basisOld, kImage, basisImage, nSpinor, sym[iSym], invert).scatterAxpy(1., Cold, Cimage, 0, 1);
+		Cold.free();
+		//Transfer the periodic parts (same coefficient for each G) to the basis at k, dropping components outside it:
+		C[q].zero();
+		switchBasis(Cimage, C[q]);
+		dkMax = std::max(dkMax, sqrt(dkSqMin));
+	}
+	mpiWorld->fclose(fp);
+	mpiWorld->allReduce(dkMax, MPIUtil::ReduceMax);
+	logPrintf("Initialized %d bands from nearest previous k-points (max |dk| = %lg bohr^-1).\n", nBandsInited, dkMax);
+	watch.stop();
+	return nBandsInited;
+}
@@ -42,6 +42,13 @@ double regularizedDelta(double omega, double omega0, double etaInv)
 	return (1./M_PI) * (etaInv/(1+t*t));
 }
 
+//Number of frequencies to batch together into one matrix multiply, given the number of
+//matrix entries needed per frequency, so that the stacked matrices stay within a fixed budget:
+inline int omegaBatchSize(int nOmega, size_t nDataPerOmega)
+{	const size_t nDataMax = size_t(1) << 24; //256 MB of complex entries per batch
+	return std::max(1, std::min(nOmega, int(nDataMax / std::max(nDataPerOmega, size_t(1)))));
+}
+
 ElectronScattering::ElectronScattering()
 : eta(0.), Ecut(0.), fCut(1e-6), omegaMax(0.), RPA(false), slabResponse(false), EcutTransverse(0.)
 {
@@ -278,15 +285,20 @@ void ElectronScattering::dump(const Everything& everything)
 			size_t jk; matrix nij;
 			std::vector<Event> events = getEvents(true, iSpin, ik, iq, jk, nij);
 			if(!events.size()) continue;
-			//Collect contributions for each frequency:
-			for(int iOmega=0; iOmega<omegaGrid.nRows(); iOmega++)
-			{	double omega = omegaGrid[iOmega];
-				std::vector<complex> Xks; Xks.reserve(events.size());
-				for(const Event& event: events)
-					Xks.push_back(-e.gInfo.detR * kWeight * event.fWeight *
-						( regularizedPole(omega, -event.Eji, etaInv)
-						- regularizedPole(omega, +event.Eji, etaInv) ) );
-				chiKS[iOmega] += (nij * Xks) * dagger(nij);
+			//Collect contributions for batches of frequencies, each with one matrix multiply:
+			int nEvents = events.size();
+			matrix nijDag = dagger(nij);
+			int nOmegaBatch = omegaBatchSize(omegaGrid.nRows(), size_t(nbasis)*(nEvents+nbasis));
+			for(int iOmega0=0; iOmega0<omegaGrid.nRows(); iOmega0+=nOmegaBatch)
+			{	int nOmegaCur = std::min(nOmegaBatch, omegaGrid.nRows()-iOmega0);
+				matrix nijX(nOmegaCur*nbasis, nEvents); //nij * diag(X(omega)) for each omega, stacked vertically
+				threadLaunch(chiKSbatch_thread, nEvents, nbasis, nij.data(), nijX.data(),
+					omegaGrid.data()+iOmega0, nOmegaCur, &events, -e.gInfo.detR * kWeight, etaInv);
+				matrix chiKSbatch = nijX * nijDag;
+				for(int iOmega=iOmega0; iOmega<iOmega0+nOmegaCur; iOmega++)
+				{	int rowStart = (iOmega-iOmega0)*nbasis;
+					chiKS[iOmega] += chiKSbatch(rowStart,rowStart+nbasis, 0,nbasis);
+				}
 			}
 		}
 		for(int iOmega=0; iOmega<omegaGrid.nRows(); iOmega++)
@@ -320,6 +332,20 @@ void ElectronScattering::dump(const Everything& everything)
 		{	if(!omegaDiv.isMine(iOmega)) ImKscr[iOmega] = zeroes(nbasis,nbasis);
 			mpiWorld->bcastData(ImKscr[iOmega], omegaDiv.whose(iOmega));
 		}
+		//--- stack into batches of frequencies for the matrix multiplies below:
+		int nOmegaBatch = omegaBatchSize(omegaGrid.nRows(), size_t(nbasis)*std::max(nbasis, nBands*nBands));
+		std::vector<matrix> ImKscrBatch;
+		for(int iOmega0=0; iOmega0<omegaGrid.nRows(); iOmega0+=nOmegaBatch)
+		{	int nOmegaCur = std::min(nOmegaBatch, omegaGrid.nRows()-iOmega0);
+			matrix Kbatch(nOmegaCur*nbasis, nbasis);
+			for(int iOmega=iOmega0; iOmega<iOmega0+nOmegaCur; iOmega++)
+			{	int rowStart = (iOmega-iOmega0)*nbasis;
+				Kbatch.set(rowStart,rowStart+nbasis, 0,nbasis, ImKscr[iOmega]);
+				ImKscr[iOmega] = 0; //free to save memory
+			}
+			ImKscrBatch.push_back(Kbatch);
+		}
+		ImKscr.clear();
 		logPrintf("done.\n"); logFlush();
 		
 		//Calculate ImSigma contributions:
@@ -337,17 +363,16 @@ void ElectronScattering::dump(const Everything& everything)
 			std::vector<Event> events = getEvents(false, iSpin, ik, iq, jk, nij);
 			if(!events.size()) continue;
 			//Integrate over frequency for event contributions to linewidth:
-			diagMatrix eventContrib(events.size(), 0);
-			for(int iOmega=0; iOmega<omegaGrid.nRows(); iOmega++)
-			{	//Construct energy conserving delta-function:
-				double omega = omegaGrid[iOmega];
-				complex omegaTilde(omega, 2*eta);
-				diagMatrix delta; delta.reserve(events.size());
-				for(const Event& event: events)
-					delta.push_back(e.gInfo.detR * event.fWeight * //overlap and sign for electron / hole
-						( regularizedDelta(omega, +event.Eji, etaInv)
-						- regularizedDelta(omega, -event.Eji, etaInv) ) ); //pick up correct omega
-				eventContrib += wOmega[iOmega] * delta * diag(dagger(nij) * ImKscr[iOmega] * nij);
+			int nEvents = events.size();
+			diagMatrix eventContrib(nEvents, 0.);
+			int iOmega0 = 0;
+			for(const matrix& Kbatch: ImKscrBatch)
+			{	int nOmegaCur = Kbatch.nRows() / nbasis;
+				matrix Knij = Kbatch * nij; //ImKscr(omega) * nij for each omega in batch, stacked vertically
+				threadLaunch(ImSigmaBatch_thread, nEvents, nbasis, nij.data(), Knij.data(),
+					omegaGrid.data()+iOmega0, wOmega.data()+iOmega0, nOmegaCur, &events,
+					e.gInfo.detR, etaInv, eventContrib.data());
+				iOmega0 += nOmegaCur;
 			}
 			//Accumulate contributions to linewidth:
 			int iReduced = supercell->kmeshTransform[ik].iReduced; //directly collect to reduced k-point
@@ -406,6 +431,40 @@ diagMatrix diagouter(const matrix& A, const matrix& B)
 	return result;
 }
 
+void ElectronScattering::chiKSbatch_thread(size_t iStart, size_t iStop, int nbasis, const complex* nij, complex* nijX,
+	const double* omega, int nOmega, const std::vector<Event>* events, double prefac, double etaInv)
+{	for(size_t iEvent=iStart; iEvent<iStop; iEvent++)
+	{	const Event& event = events->at(iEvent);
+		const complex* nijCol = nij + iEvent*nbasis;
+		complex* nijXcol = nijX + iEvent*nbasis*nOmega;
+		for(int iOmega=0; iOmega<nOmega; iOmega++)
+		{	complex X = prefac * event.fWeight *
+				( regularizedPole(omega[iOmega], -event.Eji, etaInv)
+				- regularizedPole(omega[iOmega], +event.Eji, etaInv) );
+			for(int g=0; g<nbasis; g++)
+				*(nijXcol++) = nijCol[g] * X;
+		}
+	}
+}
+
+void ElectronScattering::ImSigmaBatch_thread(size_t iStart, size_t iStop, int nbasis, const complex* nij, const complex* Knij,
+	const double* omega, const double* wOmega, int nOmega, const std::vector<Event>* events, double prefac, double etaInv, double* eventContrib)
+{	for(size_t iEvent=iStart; iEvent<iStop; iEvent++)
+	{	const Event& event = events->at(iEvent);
+		const complex* nijCol = nij + iEvent*nbasis;
+		const complex* KnijCol = Knij + iEvent*nbasis*nOmega;
+		for(int iOmega=0; iOmega<nOmega; iOmega++)
+		{	double delta = prefac * event.fWeight * //overlap and sign for electron / hole
+				( regularizedDelta(omega[iOmega], +event.Eji, etaInv)
+				- regularizedDelta(omega[iOmega], -event.Eji, etaInv) ); //pick up correct omega
+			double nKn = 0.; //diagonal element of nij^ ImKscr nij (which is real)
+			for(int g=0; g<nbasis; g++)
+				nKn += (nijCol[g].conj() * (*(KnijCol++))).real();
+			eventContrib[iEvent] += wOmega[iOmega] * delta * nKn;
+		}
+	}
+}
+
 std::vector<ElectronScattering::Event> ElectronScattering::getEvents(bool chiMode, int iSpin, size_t ik, size_t iq, size_t& jk, matrix& nij) const
 {	static StopWatch watchI("ElectronScattering::getEventsI"), watchJ("ElectronScattering::getEventsJ"), watchAug("ElectronScattering::nAug");
 	//Find target k-point:
@@ -571,11 +630,12 @@ void ElectronScattering::nAugRhoAtomInit(size_t iq)
 			complex* nData = n.dataPref();
 			int atomStride = basis_q.nbasis * nQijlm;
 			int ijlmIndex = 0;
+			AtomPhases phases(basis_q.gInfo->S, sp.atpos.size(), sp.atpos.data(), qmesh[iq].k);
 			for(const auto& entry: sp.Qradial)
 			{	const int& l = entry.first.l;
 				for(int m=-l; m<=l; m++)
 				{	callPref(Vnl)(basis_q.nbasis, atomStride, sp.atpos.size(), l, m, qmesh[iq].k, basis_q.iGarr.dataPref(),
-						e->gInfo.G, sp.atposManaged.dataPref(), entry.second, nData);
+						e->gInfo.G, sp.atposManaged.dataPref(), phases.tables(), entry.second, nData);
 					ijlmMap[std::make_pair(entry.first,m)] = ijlmIndex;
 					nData += basis_q.nbasis;
 					ijlmIndex++;
@@ -77,6 +77,12 @@ private:
 		matrix& nij //!< set pair densities for each event, one per column
 	) const;
 	
+	//Thread functions for batching frequencies into single matrix multiplies (see dump):
+	static void chiKSbatch_thread(size_t iStart, size_t iStop, int nbasis, const complex* nij, complex* nijX,
+		const double* omega, int nOmega, const std::vector<Event>* events, double prefac, double etaInv); //!< set nij * diag(X(omega)) for each event, with omega stacked along rows
+	static void ImSigmaBatch_thread(size_t iStart, size_t iStop, int nbasis, const complex* nij, const complex* Knij,
+		const double* omega, const double* wOmega, int nOmega, const std::vector<Event>* events, double prefac, double etaInv, double* eventContrib); //!< accumulate frequency integral of delta(omega) * diag(nij^ ImKscr(omega) nij)
+	
 	ColumnBundle getWfns(size_t ik, int iSpin, const vector3<>& k, std::vector<matrix>* VdagCi=0) const; //get wavefunctions at an arbitrary point in k-mesh
 	matrix coulombMatrix(size_t iq, matrix& Kxc) const; //retrieve the Coulomb and XC (if not RPA) operators for a specific momentum transfer
 	void nAugRhoAtomInit(size_t iq); //Initialize nAugRhoAtom for a specific momentum transfer
@@ -0,0 +1,176 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/Embedding.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <electronic/IonicMinimizer.h>
+#include <electronic/LatticeMinimizer.h>
+#include <commands/parser.h>
+
+struct JDFTxInstance
+{	Everything e;
+	std::shared_ptr<IonicMinimizer> imin; //used to move atoms and compute energy / forces, as in server mode
+	std::vector<double> forces; //cartesian forces flattened in atom order
+	
+	int nAtoms() const
+	{	int n = 0;
+		for(const auto& sp: e.iInfo.species) n += sp->atpos.size();
+		return n;
+	}
+	
+	void setLattice(const matrix3<>& R)
+	{	e.gInfo.R = R;
+		LatticeMinimizer::updateLatticeDependent(e);
+	}
+};
+
+static bool embeddingLogOpened = false; //whether jdftx_initialize opened the log file
+
+void jdftx_initialize(const char* logFilename)
+{	if(logFilename)
+	{	globalLog = fopen(logFilename, "w");
+		if(!globalLog) { globalLog = stdout; fprintf(stderr, "WARNING: could not open log file '%s'; logging to stdout.\n", logFilename); }
+		else embeddingLogOpened = true;
+	}
+	char argv0[] = "libjdftx"; char* argv[] = {argv0, 0};
+	initSystem(1, argv);
+}
+
+void jdftx_finalize()
+{	finalizeSystem(); //closes the log if not stdout
+	embeddingLogOpened = false;
+}
+
+JDFTxInstance* jdftx_create(const char* inputFilename)
+{	JDFTxInstance* jdftx = new JDFTxInstance;
+	Everything& e = jdftx->e;
+	parse(readInputFile(inputFilename), e);
+	e.setup();
+	jdftx->imin = std::make_shared<IonicMinimizer>(e);
+	jdftx->forces.assign(3*jdftx->nAtoms(), 0.);
+	logPrintf("Initialization of embedded instance completed at t[s]: %9.2lf\n\n", clock_sec());
+	logFlush();
+	return jdftx;
+}
+
+void jdftx_destroy(JDFTxInstance* jdftx)
+{	delete jdftx;
+}
+
+int jdftx_num_atoms(const JDFTxInstance* jdftx)
+{	return jdftx->nAtoms();
+}
+
+int jdftx_num_spins(const JDFTxInstance* jdftx)
+{	return jdftx->e.eVars.n.size();
+}
+
+void jdftx_grid_shape(const JDFTxInstance* jdftx, int* S)
+{	for(int k=0; k<3; k++) S[k] = jdftx->e.gInfo.S[k];
+}
+
+void jdftx_state_range(const JDFTxInstance* jdftx, int* qStart, int* qStop)
+{	*qStart = jdftx->e.eInfo.qStart;
+	*qStop = jdftx->e.eInfo.qStop;
+}
+
+void jdftx_set_lattice(JDFTxInstance* jdftx, const double* R)
+{	matrix3<> Rnew;
+	for(int i=0; i<3; i++)
+		for(int j=0; j<3; j++)
+			Rnew(i,j) = R[3*i+j];
+	mpiWorld->bcast(&Rnew(0,0), 9); //ensure consistency to numerical precision
+	jdftx->setLattice(Rnew);
+}
+
+void jdftx_set_positions(JDFTxInstance* jdftx, const double* pos)
+{	Everything& e = jdftx->e;
+	IonInfo& iInfo = e.iInfo;
+	//Move to requested positions (using nearest periodic image of each displacement):
+	IonicGradient dir; dir.init(iInfo);
+	const double* posCur = pos;
+	for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
+		for(unsigned atom=0; atom<dir[iSp].size(); atom++)
+		{	vector3<> dLat = e.gInfo.invR * vector3<>(posCur[0], posCur[1], posCur[2]) - iInfo.species[iSp]->atpos[atom];
+			for(int k=0; k<3; k++) dLat[k] -= floor(0.5 + dLat[k]);
+			dir[iSp][atom] = e.gInfo.R * dLat;
+			posCur += 3;
+		}
+	for(auto& dir_sp: dir) mpiWorld->bcastData(dir_sp);
+	jdftx->imin->step(dir, 1.);
+}
+
+void jdftx_set_external_potential(JDFTxInstance* jdftx, const double* V)
+{	ElecVars& eVars = jdftx->e.eVars;
+	const GridInfo& gInfo = jdftx->e.gInfo;
+	ScalarFieldArray Vnew(V ? eVars.n.size() : 0);
+	for(ScalarField& Vs: Vnew)
+	{	Vs = ScalarFieldData::alloc(gInfo);
+		memcpy(Vs->data(), V, gInfo.nr*sizeof(double));
+		Vs->bcastData(mpiWorld);
+		V += gInfo.nr;
+	}
+	eVars.setExternal(&Vnew, 0);
+}
+
+void jdftx_set_external_charge(JDFTxInstance* jdftx, const double* rho)
+{	const GridInfo& gInfo = jdftx->e.gInfo;
+	ScalarFieldTilde rhoNew;
+	if(rho)
+	{	ScalarField temp(ScalarFieldData::alloc(gInfo));
+		memcpy(temp->data(), rho, gInfo.nr*sizeof(double));
+		temp->bcastData(mpiWorld);
+		rhoNew = J(temp);
+	}
+	jdftx->e.eVars.setExternal(0, &rhoNew);
+}
+
+double jdftx_compute(JDFTxInstance* jdftx, int computeForces)
+{	IonicGradient grad;
+	double E = jdftx->imin->compute(computeForces ? &grad : 0, 0);
+	if(computeForces)
+	{	double* f = jdftx->forces.data();
+		for(const auto& grad_sp: grad)
+			for(const vector3<>& g: grad_sp)
+				for(int k=0; k<3; k++)
+					*(f++) = std::isnan(E) ? 0. : -g[k];
+	}
+	logFlush();
+	return E;
+}
+
+const double* jdftx_forces(const JDFTxInstance* jdftx)
+{	return jdftx->forces.data();
+}
+
+const double* jdftx_density(JDFTxInstance* jdftx, int s)
+{	return jdftx->e.eVars.n[s]->data();
+}
+
+const double* jdftx_potential(JDFTxInstance* jdftx, int s)
+{	return jdftx->e.eVars.Vscloc[s]->data();
+}
+
+const double* jdftx_eigenvalues(const JDFTxInstance* jdftx, int q, int* nBands)
+{	const ElecInfo& eInfo = jdftx->e.eInfo;
+	*nBands = eInfo.nBands;
+	if(!eInfo.isMine(q)) return 0;
+	return jdftx->e.eVars.Hsub_eigs[q].data();
+}
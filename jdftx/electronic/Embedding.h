@@ -0,0 +1,76 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_EMBEDDING_H
+#define JDFTX_ELECTRONIC_EMBEDDING_H
+
+//! @addtogroup ElectronicDFT
+//! @{
+//! @file Embedding.h C interface for driving JDFTx in-process from external codes
+
+/**
+This header has C linkage so that it may be used via ctypes / cffi or from C and Fortran drivers,
+linking only against libjdftx. All functions must be called on all MPI processes together.
+Arrays returned by the accessors below are read-only views of JDFTx's own data, valid until the next call
+that modifies the state (set_* or compute) or destroys the instance. In GPU builds, the density and potential
+accessors first make the host copies current (a device to host transfer, but still no additional copy).
+
+Conventions (all in atomic units, Hartrees and bohrs):
+- Lattice vectors are the columns of the 3x3 matrix R, passed as 9 doubles in row-major order.
+- Atoms are ordered by species (in order of ion-species in the input) and then in order of the ion commands,
+	and positions / forces are cartesian, 3 doubles per atom.
+- Scalar fields are in real space on the S[0] x S[1] x S[2] grid in row-major order (last index fastest),
+	exactly as in the binary dump files.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct JDFTxInstance JDFTxInstance; //!< opaque handle to one calculation
+
+void jdftx_initialize(const char* logFilename); //!< initialize JDFTx (MPI unless already initialized by the host, threads, GPUs) and log to logFilename (stdout if null); call once per process
+void jdftx_finalize(); //!< clean up after all instances have been destroyed (finalizes MPI only if initialized by jdftx_initialize)
+
+JDFTxInstance* jdftx_create(const char* inputFilename); //!< parse the commands in inputFilename and initialize the system (as the jdftx executable would, without running it)
+void jdftx_destroy(JDFTxInstance* jdftx); //!< free all memory associated with an instance
+
+int jdftx_num_atoms(const JDFTxInstance* jdftx); //!< total number of atoms
+int jdftx_num_spins(const JDFTxInstance* jdftx); //!< number of spin channels of the density and potentials (1 or 2, or 4 for noncollinear magnetism)
+void jdftx_grid_shape(const JDFTxInstance* jdftx, int* S); //!< set S[0..2] to the dimensions of the real-space grid
+void jdftx_state_range(const JDFTxInstance* jdftx, int* qStart, int* qStop); //!< range of k-point/spin states whose eigenvalues are available on this process
+
+void jdftx_set_lattice(JDFTxInstance* jdftx, const double* R); //!< change the lattice vectors (keeping fractional atomic coordinates)
+void jdftx_set_positions(JDFTxInstance* jdftx, const double* pos); //!< move atoms to the cartesian positions (3 per atom), dragging wavefunctions where possible
+void jdftx_set_external_potential(JDFTxInstance* jdftx, const double* V); //!< set the external potential (one scalar field per spin channel, contiguous), replacing that from Vexternal in the input (but not box potentials or electric fields); clears it if null
+void jdftx_set_external_charge(JDFTxInstance* jdftx, const double* rho); //!< set the external charge density in electrons/bohr^3 (one scalar field), replacing that from rhoExternal in the input; clears it if null
+
+double jdftx_compute(JDFTxInstance* jdftx, int computeForces); //!< converge the electronic (and fluid) state at the current geometry and return the free energy minimized by JDFTx; optionally compute forces
+
+const double* jdftx_forces(const JDFTxInstance* jdftx); //!< cartesian forces (3 per atom) from the most recent jdftx_compute with computeForces set
+const double* jdftx_density(JDFTxInstance* jdftx, int s); //!< electron density of spin channel s (ElecVars::n)
+const double* jdftx_potential(JDFTxInstance* jdftx, int s); //!< self-consistent local potential of spin channel s (ElecVars::Vscloc, which includes the integration weight dV)
+const double* jdftx_eigenvalues(const JDFTxInstance* jdftx, int q, int* nBands); //!< subspace eigenvalues of state q (if in jdftx_state_range, null otherwise), setting nBands
+
+#ifdef __cplusplus
+}
+#endif
+
+//! @}
+#endif // JDFTX_ELECTRONIC_EMBEDDING_H
@@ -22,11 +22,23 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/VanDerWaals.h>
 #include <electronic/Vibrations.h>
 #include <electronic/DOS.h>
+#include <electronic/ParallelLayout.h>
 #include <core/LatticeUtils.h>
 #include <fluid/FluidSolver.h>
 
 void Everything::setup()
-{
+{	//Record wall time of each setup phase (reported by printSetupReport):
+	setupTimes.clear();
+	double tPhase = clock_sec();
+	auto markPhase = [&](const char* name)
+	{	double t = clock_sec();
+		setupTimes.push_back(std::make_pair(string(name), t - tPhase));
+		tPhase = t;
+	};
+	
+	//Start reading restart files in the background (overlapped with the setup phases below until ElecVars::setup):
+	eVars.prefetchRestart(*this);
+	
 	//Symmetries (phase 1: lattice+basis dependent)
 	if(vibrations)
 	{	symmUnperturbed = symm;
@@ -34,6 +46,7 @@ void Everything::setup()
 		symmUnperturbed.setup(*this); //calculate symmetries of unperturbed system for optimizing force matrix calculation
 	}
 	symm.setup(*this);
+	markPhase("symmetries");
 	
 	//Initialize the grid:
 	gInfo.Gmax = sqrt(2*cntrl.Ecut); //Ecut = 0.5 Gmax^2
@@ -43,6 +56,7 @@ void Everything::setup()
 	{	gInfoWfns = std::make_shared<GridInfo>();
 		gInfoWfns->R = gInfo.R;
 		gInfoWfns->Gmax = gInfo.Gmax;
+		gInfoWfns->nTuneS = gInfo.nTuneS;
 		logPrintf("\n---------- Initializing tighter grid for wavefunction operations ----------\n");
 		gInfoWfns->initialize(true, vibrations ? symmUnperturbed.getMatrices() : symm.getMatrices());
 		if(gInfoWfns->S == gInfo.S)
@@ -51,6 +65,8 @@ void Everything::setup()
 		}
 	}
 
+	markPhase("grids");
+	
 	//Exchange correlation setup
 	logPrintf("\n---------- Exchange Correlation functional ----------\n");
 	exCorr.setup(*this); //main functional
@@ -60,17 +76,25 @@ void Everything::setup()
 			ec->setup(*this); //comparison functionals evaluated at the end
 	}
 
+	markPhase("exchange-correlation");
+	
 	//Atom positions, pseudopotentials
 	iInfo.setup(*this);
 	
+	markPhase("pseudopotentials");
+	
 	//Symmetries (phase 2: fftbox and k-mesh dependent)
 	eInfo.kpointsFold();
 	symm.setupMesh();
 	if(vibrations) symmUnperturbed.setupMesh();
 	
+	markPhase("k-mesh");
+	
 	//Set up k-points, bands and fillings
 	eInfo.setup(*this, eVars.F, ener);
 
+	markPhase("states");
+	
 	//Set up the reduced bases for wavefunctions:
 	logPrintf("\n----- Setting up reduced wavefunction bases (%s) -----\n",
 		(cntrl.basisKdep==BasisKpointIndep) ? "single at Gamma point" :  "one per k-point");
@@ -93,6 +117,14 @@ void Everything::setup()
 		pow(sqrt(2*cntrl.Ecut),3)*(gInfo.detR/(6*M_PI*M_PI)));
 	logFlush();
 
+	markPhase("basis");
+	
+	//Benchmark and report the division of nodes between processes and threads:
+	if(cntrl.parallelLayout != ParallelLayoutNone)
+		tuneParallelLayout(*this, cntrl.parallelLayout==ParallelLayoutAuto);
+	
+	markPhase("parallel-layout");
+	
 	//Check if DOS calculator is needed:
 	if(!dump.dos)
 	{	for(auto dumpPair: dump)
@@ -115,22 +147,34 @@ void Everything::setup()
 	updateSupercell();
 	coulomb = coulombParams.createCoulomb(gInfo);
 	
+	markPhase("coulomb");
+	
 	//Exact exchange (if required)
 	if(exxPresent)
 		exx = std::make_shared<ExactExchange>(*this);
 
+	markPhase("exact-exchange");
+	
 	//Setup VanDerWaals corrections
 	if(iInfo.vdWenable || eVars.fluidParams.needsVDW())
 		vanDerWaals = std::make_shared<VanDerWaals>(*this);
 	
+	markPhase("van-der-Waals");
+	
 	//Setup wavefunctions, densities, fluid, output module etc:
 	iInfo.update(ener); //needs to happen before eVars setup for LCAO
+	markPhase("ionic-update");
 	eVars.setup(*this);
+	markPhase("electronic-variables");
 	dump.setup(*this);
 
+	markPhase("dump");
+	
 	//Setup vibrations module:
 	if(vibrations) vibrations->setup(this);
 	
+	markPhase("vibrations");
+	
 	//Setup electronic minimization parameters:
 	elecMinParams.nDim = 0;
 	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
@@ -189,11 +233,76 @@ void Everything::setup()
 	latticeMinParams.linePrefix = "LatticeMinimize: ";
 	latticeMinParams.energyLabel = relevantFreeEnergyName(*this);
 	latticeMinParams.energyFormat = "%+.15lf";
+	
+	//Connect the outer loops to the metrics stream, if any:
+	if(dump.metricsFilename.length())
+	{	Dump* dumpPtr = &dump;
+		elecMinParams.metrics = [dumpPtr](int iter, double E, double gradNorm) { dumpPtr->metrics("ElecMinimize", iter, E, gradNorm); };
+		ionicMinParams.metrics = [dumpPtr](int iter, double E, double gradNorm) { dumpPtr->metrics("IonicMinimize", iter, E, gradNorm); };
+		latticeMinParams.metrics = [dumpPtr](int iter, double E, double gradNorm) { dumpPtr->metrics("LatticeMinimize", iter, E, gradNorm); };
+		scfParams.metrics = [dumpPtr](int iter, double E, double residualNorm) { dumpPtr->metrics("SCF", iter, E, residualNorm); };
+	}
+	markPhase("minimizer-parameters");
 
 	logPrintf("\n"); logFlush();
 }
 
 
+void Everything::printSetupReport() const
+{	logPrintf("\n---------- Setup timing ----------\n");
+	double tTot = 0.;
+	for(const auto& phase: setupTimes) tTot += phase.second;
+	for(const auto& phase: setupTimes)
+		logPrintf("%24s: %9.3lf s (%5.1lf%%)\n", phase.first.c_str(), phase.second, tTot ? 100.*phase.second/tTot : 0.);
+	logPrintf("%24s: %9.3lf s\n", "total", tTot);
+	
+	//Rough model of the per-iteration cost of the electronic solve (local states on each process):
+	const GridInfo& gInfoBasis = gInfoWfns ? *gInfoWfns : gInfo;
+	int nSpinor = eInfo.spinorLength();
+	int nProj = 0;
+	for(auto sp: iInfo.species) nProj += sp->nProjectors();
+	double fftFlops = 5. * gInfoBasis.nr * log2(double(gInfoBasis.nr)); //per complex FFT
+	double bytesWfns = 0., bytesProj = 0., flops = 0.;
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	double nbasis = basis[q].nbasis * nSpinor, nBands = eInfo.nBands;
+		bytesWfns += nbasis * nBands * sizeof(complex);
+		bytesProj += basis[q].nbasis * nProj * sizeof(complex);
+		flops += 3 * nBands * nSpinor * fftFlops; //local potential (I, Idag) and density (I) per band
+		flops += 3 * 8. * nbasis * nBands * nBands; //subspace Hamiltonian, overlap and rotation
+		flops += 2 * 8. * basis[q].nbasis * nProj * nBands * nSpinor; //nonlocal projections and their application
+	}
+	//--- wavefunction workspace (C plus gradient, search direction and preconditioned gradient, or Davidson/PPCG blocks):
+	double nWfnsCopies = (cntrl.scf && cntrl.elecEigenAlgo==ElecEigenDavidson) ? 7. : 5.;
+	bytesWfns *= nWfnsCopies;
+	//--- projectors (cached up to the memory budget, otherwise one species at a time):
+	if(!cntrl.cacheProjectors) bytesProj = 0.;
+	else if(iInfo.projectorCache.maxBytes) bytesProj = std::min(bytesProj, double(iInfo.projectorCache.maxBytes));
+	//--- grid fields (densities, potentials and their gradients, plus SCF mixing history):
+	double bytesGrid = 8. * gInfo.nr * eInfo.nDensities * (10 + (cntrl.scf ? 2*scfParams.history : 0));
+	//--- fluid minimizer state, gradient, search direction and preconditioned gradient:
+	double bytesFluid = 4. * 8. * fluidMinParams.nDim;
+	double bytesTot = bytesWfns + bytesProj + bytesGrid + bytesFluid;
+	//--- collect maximum per process and total work:
+	double bytesMax[5] = { bytesWfns, bytesProj, bytesGrid, bytesFluid, bytesTot };
+	mpiWorld->allReduce(bytesMax, 5, MPIUtil::ReduceMax);
+	double flopsMax = flops, flopsTot = flops;
+	mpiWorld->allReduce(flopsMax, MPIUtil::ReduceMax);
+	mpiWorld->allReduce(flopsTot, MPIUtil::ReduceSum);
+	const double MB = 1024.*1024.;
+	logPrintf("\n---------- Estimated per-process memory (largest over %d processes) ----------\n", mpiWorld->nProcesses());
+	logPrintf("%24s: %10.1lf MB\n", "wavefunctions", bytesMax[0]/MB);
+	logPrintf("%24s: %10.1lf MB\n", "projectors", bytesMax[1]/MB);
+	logPrintf("%24s: %10.1lf MB\n", "grid fields", bytesMax[2]/MB);
+	logPrintf("%24s: %10.1lf MB\n", "fluid", bytesMax[3]/MB);
+	logPrintf("%24s: %10.1lf MB\n", "total", bytesMax[4]/MB);
+	logPrintf("\n---------- Estimated electronic iteration cost ----------\n");
+	logPrintf("%24s: %10.3lf GFLOP (total %.3lf GFLOP, load imbalance %.2lf)\n", "largest per process",
+		flopsMax*1e-9, flopsTot*1e-9, flopsTot ? flopsMax*mpiWorld->nProcesses()/flopsTot : 1.);
+	logPrintf("These are rough analytic estimates, intended for comparing setups before a run.\n");
+	logFlush();
+}
+
+
 void Everything::updateSupercell(bool force)
 {	if(force || coulombParams.omegaSet.size() || dump.dos || dump.electronScattering)
 	{	//Initialize k-point sampled supercell:
@@ -35,6 +35,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/Dump.h>
 #include <electronic/SCFparams.h>
 #include <electronic/IonDynamicsParams.h>
+#include <electronic/NEBparams.h>
 #include <memory>
 
 //! @addtogroup ElectronicDFT
@@ -65,6 +66,7 @@ public:
 	MinimizeParams latticeMinParams; //!< lattice minimization parameters
 	MinimizeParams inverseKSminParams; //!< Inverse Kohn-sham minimization parameters
 	IonDynamicsParams ionDynamicsParams; //!< Molecular dynamics parameters
+	NEBparams nebParams; //!< Nudged-elastic-band parameters
 	SCFparams scfParams; //!< Self-consistent field mixing parameters
 	
 	CoulombParams coulombParams; //!< Coulomb truncation parameters
@@ -76,6 +78,9 @@ public:
 	//! Call the setup/initialize routines of all the above in the necessray order
 	void setup();
 	void updateSupercell(bool force=false); //!< (re-)initialize coulombParams.supercell if necessary (or if forced)
+	
+	std::vector<std::pair<string,double>> setupTimes; //!< wall time (in seconds) of each phase of setup(), in order
+	void printSetupReport() const; //!< print setup timings along with an estimate of per-iteration memory and work (used by dry runs)
 };
 
 //! @}
@@ -61,6 +61,20 @@ void spinDiagonalize_gpu(int N, std::vector<const double*> n, std::vector<const
 void spinDiagonalizeGrad_gpu(int N, std::vector<const double*> n, std::vector<const double*> x, std::vector<const double*> E_xDiag, std::vector<double*> E_n, std::vector<double*> E_x);
 #endif
 
+//---------------- Threaded loop over grid points for internal functionals --------------------
+
+//Unlike threadedLoop, which calls the per-point function through a pointer, the point calculator Calc is a
+//template parameter here, so that Calc::compute is inlined into the loop over each chunk. This lets the
+//compiler hoist the checks of optional (null) outputs out of the loop and vectorize the loop body
+//(most effective with CompileNative, which enables the wider SIMD instruction sets of the current CPU).
+template<typename Calc, typename... Args> void xcLoop_sub(size_t iStart, size_t iStop, Args... args)
+{	for(size_t i=iStart; i<iStop; i++)
+		Calc::compute(i, args...);
+}
+template<typename Calc, typename... Args> void xcLoop(size_t N, Args... args)
+{	threadLaunchChunked(0, threadedLoopChunksPerThread, xcLoop_sub<Calc,Args...>, N, args...);
+}
+
 //---------------- LDA thread launcher / gpu switch --------------------
 
 FunctionalLDA::FunctionalLDA(LDA_Variant variant, double scaleFac) : Functional(scaleFac), variant(variant)
@@ -77,7 +91,7 @@ FunctionalLDA::FunctionalLDA(LDA_Variant variant, double scaleFac) : Functional(
 
 template<LDA_Variant variant, int nCount>
 void LDA(int N, array<const double*,nCount> n, double* E, array<double*,nCount> E_n, double scaleFac)
-{	threadedLoop(LDA_calc<variant,nCount>::compute, N, n, E, E_n, scaleFac);
+{	xcLoop<LDA_calc<variant,nCount>>(N, n, E, E_n, scaleFac);
 }
 void LDA(LDA_Variant variant, int N, std::vector<const double*> n, double* E, std::vector<double*> E_n, double scaleFac)
 {	SwitchTemplate_spin(SwitchTemplate_LDA, variant, n.size(), LDA, (N, n, E, E_n, scaleFac) )
@@ -116,7 +130,7 @@ FunctionalGGA::FunctionalGGA(GGA_Variant variant, double scaleFac) : Functional(
 template<GGA_Variant variant, bool spinScaling, int nCount>
 void GGA(int N, array<const double*,nCount> n, array<const double*,2*nCount-1> sigma,
 	double* E, array<double*,nCount> E_n, array<double*,2*nCount-1> E_sigma, double scaleFac)
-{	threadedLoop(GGA_calc<variant,spinScaling,nCount>::compute, N, n, sigma, E, E_n, E_sigma, scaleFac);
+{	xcLoop<GGA_calc<variant,spinScaling,nCount>>(N, n, sigma, E, E_n, E_sigma, scaleFac);
 }
 void GGA(GGA_Variant variant, int N, std::vector<const double*> n, std::vector<const double*> sigma,
 	double* E, std::vector<double*> E_n, std::vector<double*> E_sigma, double scaleFac)
@@ -153,7 +167,7 @@ void mGGA(int N, array<const double*,nCount> n, array<const double*,2*nCount-1>
 	array<const double*,nCount> lap, array<const double*,nCount> tau,
 	double* E, array<double*,nCount> E_n, array<double*,2*nCount-1> E_sigma,
 	array<double*,nCount> E_lap, array<double*,nCount> E_tau, double scaleFac)
-{	threadedLoop(mGGA_calc<variant,spinScaling,nCount>::compute, N,
+{	xcLoop<mGGA_calc<variant,spinScaling,nCount>>(N,
 		n, sigma, lap, tau, E, E_n, E_sigma, E_lap, E_tau, scaleFac);
 }
 void mGGA(mGGA_Variant variant, int N, std::vector<const double*> n, std::vector<const double*> sigma,
@@ -237,12 +251,13 @@ public:
 		int sigmaCount = 2*nCount-1; //1 for unpolarized, 3 for polarized
 		int Nn = N * nCount;
 		int Nsigma = N * sigmaCount;
-		//Alloctae temporaries:
-		std::vector<double> eTemp(N);
-		std::vector<double> E_nTemp(E_n ? Nn : 0);
-		std::vector<double> E_sigmaTemp(E_n && needsSigma() ? Nsigma : 0);
-		std::vector<double> E_lapTemp(E_n && needsLap() ? Nn : 0);
-		std::vector<double> E_tauTemp(E_n && needsTau() ? Nn : 0);
+		//Scratch space, persistent per thread so that repeated calls on each chunk of the grid do not reallocate:
+		thread_local std::vector<double> eScratch, E_nScratch, E_sigmaScratch, E_lapScratch, E_tauScratch;
+		double* eTemp = scratch(eScratch, N);
+		double* E_nTemp = scratch(E_nScratch, E_n ? Nn : 0);
+		double* E_sigmaTemp = scratch(E_sigmaScratch, E_n && needsSigma() ? Nsigma : 0);
+		double* E_lapTemp = scratch(E_lapScratch, E_n && needsLap() ? Nn : 0);
+		double* E_tauTemp = scratch(E_tauScratch, E_n && needsTau() ? Nn : 0);
 		//Invoke appropriate LibXC function in scratch space:
 		if(needsTau())
 		{	//Project out problematic mGGA points (not handled correctly by LibXC 4:
@@ -277,23 +292,35 @@ public:
 			}
 			#endif
 			if(E_n) xc_mgga_exc_vxc(&func, N, n, sigma, lap, tau,
-				&eTemp[0], &E_nTemp[0], &E_sigmaTemp[0], &E_lapTemp[0], &E_tauTemp[0]);
-			else xc_mgga_exc(&func, N, n, sigma, lap, tau, &eTemp[0]);
+				eTemp, E_nTemp, E_sigmaTemp, E_lapTemp, E_tauTemp);
+			else xc_mgga_exc(&func, N, n, sigma, lap, tau, eTemp);
 		}
 		else if(needsSigma())
-		{	if(E_n) xc_gga_exc_vxc(&func, N, n, sigma, &eTemp[0], &E_nTemp[0], &E_sigmaTemp[0]); //need gradient
-			else xc_gga_exc(&func, N, n, sigma, &eTemp[0]);
+		{	if(E_n) xc_gga_exc_vxc(&func, N, n, sigma, eTemp, E_nTemp, E_sigmaTemp); //need gradient
+			else xc_gga_exc(&func, N, n, sigma, eTemp);
 		}
 		else
-		{	if(E_n) xc_lda_exc_vxc(&func, N, n, &eTemp[0], &E_nTemp[0]); //need gradient
-			else xc_lda_exc(&func, N, n, &eTemp[0]);
+		{	if(E_n) xc_lda_exc_vxc(&func, N, n, eTemp, E_nTemp); //need gradient
+			else xc_lda_exc(&func, N, n, eTemp);
 		}
-		//Accumulate onto final results
-		eblas_daxpy(N, 1., &eTemp[0], 1, e, 1);
-		if(E_nTemp.size()) eblas_daxpy(Nn, 1., &E_nTemp[0], 1, E_n, 1);
-		if(E_sigmaTemp.size()) eblas_daxpy(Nsigma, 1., &E_sigmaTemp[0], 1, E_sigma, 1);
-		if(E_lapTemp.size()) eblas_daxpy(Nn, 1., &E_lapTemp[0], 1, E_lap, 1);
-		if(E_tauTemp.size()) eblas_daxpy(Nn, 1., &E_tauTemp[0], 1, E_tau, 1);
+		//Accumulate onto final results (called within threads, so use unthreaded loops):
+		accumulate(N, eTemp, e);
+		if(E_nTemp) accumulate(Nn, E_nTemp, E_n);
+		if(E_sigmaTemp) accumulate(Nsigma, E_sigmaTemp, E_sigma);
+		if(E_lapTemp) accumulate(Nn, E_lapTemp, E_lap);
+		if(E_tauTemp) accumulate(Nn, E_tauTemp, E_tau);
+	}
+	
+	//! Ensure at least n entries in buf and return its data (null if n is zero)
+	static double* scratch(std::vector<double>& buf, int n)
+	{	if(!n) return 0;
+		if(buf.size() < size_t(n)) buf.resize(n);
+		return buf.data();
+	}
+	
+	//! y += x over N entries
+	static void accumulate(int N, const double* x, double* y)
+	{	for(int i=0; i<N; i++) y[i] += x[i];
 	}
 	
 	static void evaluate_thread(int iStart, int iStop, const FunctionalLibXC* func, int iOffset,
@@ -320,28 +347,37 @@ public:
 	}
 };
 
+template<unsigned M> void transposeIn_thread(size_t iStart, size_t iStop, const double* const* in, double* out)
+{	double* outPtr = out + M*iStart;
+	for(size_t n=iStart; n<iStop; n++)
+		for(unsigned m=0; m<M; m++)
+			*(outPtr++) = in[m][n];
+}
+
 //! Convert a collection of scalar fields into an interleaved vector field.
 //! result can be freed using delete[]
 template<unsigned M> double* transpose(const ScalarFieldArray& inVec)
 {	assert(inVec.size()==M);
 	const unsigned N = inVec[0]->nElem;
 	const double* in[M]; for(unsigned m=0; m<M; m++) in[m] = inVec[m]->data();
-	double *out = new double[M*N], *outPtr = out;
-	for(unsigned n=0; n<N; n++)
-		for(unsigned m=0; m<M; m++)
-			*(outPtr++) = in[m][n];
+	double *out = new double[M*N];
+	threadLaunch(transposeIn_thread<M>, N, (const double* const*)in, out);
 	return out;
 }
 
+template<unsigned M> void transposeOut_thread(size_t iStart, size_t iStop, const double* in, double* const* out)
+{	const double* inPtr = in + M*iStart;
+	for(size_t n=iStart; n<iStop; n++)
+		for(unsigned m=0; m<M; m++)
+			out[m][n] = *(inPtr++);
+}
+
 //! Convert an interleaved vector field to a collection of scalar fields
 template<unsigned M> void transpose(double* in, ScalarFieldArray& outVec)
 {	assert(outVec.size()==M);
 	const unsigned N = outVec[0]->nElem;
 	double* out[M]; for(unsigned m=0; m<M; m++) out[m] = outVec[m]->data();
-	double *inPtr = in;
-	for(unsigned n=0; n<N; n++)
-		for(unsigned m=0; m<M; m++)
-			out[m][n] = *(inPtr++);
+	threadLaunch(transposeOut_thread<M>, N, (const double*)in, (double* const*)out);
 }
 
 #endif //LIBXC_ENABLED
@@ -373,7 +409,7 @@ struct FunctionalList
 
 extern EnumStringMap<ExCorrType> exCorrTypeMap;
 
-ExCorr::ExCorr(ExCorrType exCorrType, KineticType kineticType) : exCorrType(exCorrType), kineticType(kineticType), xcName(exCorrTypeMap.getString(exCorrType)),
+ExCorr::ExCorr(ExCorrType exCorrType, KineticType kineticType) : exxPairThreshold(0.), exxLocalize(true), exxReduceImages(true), exCorrType(exCorrType), kineticType(kineticType), xcName(exCorrTypeMap.getString(exCorrType)),
 exxScale(0.), exxOmega(0.), exxScaleOverride(0.), exxOmegaOverride(0.),
 functionals(std::make_shared<FunctionalList>())
 #ifdef LIBXC_ENABLED
@@ -617,7 +653,7 @@ template<typename Func> bool shouldInclude(const std::shared_ptr<Func>& function
 }
 
 double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, IncludeTXC includeTXC,
-		const ScalarFieldArray* tauPtr, ScalarFieldArray* Vtau) const
+		const ScalarFieldArray* tauPtr, ScalarFieldArray* Vtau, bool processLocal) const
 {
 	static StopWatch watch("ExCorrTotal"), watchComm("ExCorrCommunication"), watchFunc("ExCorrFunctional");
 	watch.start();
@@ -626,6 +662,8 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 	const int nCount = std::min(nInCount, 2); //Number of spin-densities used in the parametrization of the functional
 	const int sigmaCount = 2*nCount-1;
 	const GridInfo& gInfo = n[0]->gInfo;
+	size_t irStart = processLocal ? 0 : gInfo.irStart; //range of grid points evaluated on this process
+	size_t irStop = processLocal ? gInfo.nr : gInfo.irStop;
 	
 	//------- Prepare inputs, allocate outputs -------
 	
@@ -658,8 +696,8 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 	
 	//Calculate spatial gradients for GGA (if needed)
 	std::vector<VectorField> Dn(nInCount);
-	int iDirStart, iDirStop;
-	TaskDivision(3, mpiWorld).myRange(iDirStart, iDirStop);
+	int iDirStart = 0, iDirStop = 3;
+	if(!processLocal) TaskDivision(3, mpiWorld).myRange(iDirStart, iDirStop);
 	if(needsSigma)
 	{	//Compute the gradients of the (spin-)densities:
 		for(int s=0; s<nInCount; s++)
@@ -734,10 +772,12 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 			for(int s2=s1; s2<nCount; s2++)
 			{	for(int i=iDirStart; i<iDirStop; i++)
 					sigma[s1+s2] += Dn[s1][i] * Dn[s2][i];
-				watchComm.start();
 				nullToZero(sigma[s1+s2], gInfo);
-				sigma[s1+s2]->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-				watchComm.stop();
+				if(!processLocal)
+				{	watchComm.start();
+					sigma[s1+s2]->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+					watchComm.stop();
+				}
 			}
 		//Allocate gradient if required:
 		if(Vxc) nullToZero(E_sigma, gInfo, sigmaCount);
@@ -778,7 +818,7 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 		watchFunc.start();
 		for(auto func: functionals->libXC)
 			if(shouldInclude(func, includeTXC))
-				func->evaluateSub(nCount, gInfo.irStart, gInfo.irStop, nData, sigmaData, lapData, tauData,
+				func->evaluateSub(nCount, irStart, irStop, nData, sigmaData, lapData, tauData,
 					eData, E_nData, E_sigmaData, E_lapData, E_tauData);
 		watchFunc.stop();
 		
@@ -805,7 +845,7 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 	watchFunc.start();
 	for(auto func: functionals->internal)
 		if(shouldInclude(func, includeTXC))
-			func->evaluateSub(gInfo.irStart, gInfo.irStop,
+			func->evaluateSub(irStart, irStop,
 				constDataPref(nCapped), constDataPref(sigma), constDataPref(lap), constDataPref(tau),
 				E->dataPref(), dataPref(E_n), dataPref(E_sigma), dataPref(E_lap), dataPref(E_tau));
 	watchFunc.stop();
@@ -818,13 +858,15 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 	tau.clear();
 	
 	//---------------- Collect results over processes ----------------
-	watchComm.start();
-	mpiWorld->allReduce(Exc, MPIUtil::ReduceSum);
-	for(ScalarField& x: E_n) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-	for(ScalarField& x: E_sigma) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-	for(ScalarField& x: E_lap) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-	for(ScalarField& x: E_tau) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-	watchComm.stop();
+	if(!processLocal)
+	{	watchComm.start();
+		mpiWorld->allReduce(Exc, MPIUtil::ReduceSum);
+		for(ScalarField& x: E_n) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+		for(ScalarField& x: E_sigma) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+		for(ScalarField& x: E_lap) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+		for(ScalarField& x: E_tau) if(x) x->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+		watchComm.stop();
+	}
 
 	//--------------- Gradient propagation ---------------------
 	if(Vxc)
@@ -884,10 +926,12 @@ double ExCorr::operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc, Incl
 			}
 			//Accumulate over processes:
 			for(int s=0; s<nInCount; s++)
-			{	watchComm.start();
-				nullToZero(E_nTilde[s], gInfo);
-				E_nTilde[s]->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-				watchComm.stop();
+			{	nullToZero(E_nTilde[s], gInfo);
+				if(!processLocal)
+				{	watchComm.start();
+					E_nTilde[s]->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+					watchComm.stop();
+				}
 				E_n[s] += Jdag(E_nTilde[s],true);
 			}
 		}
@@ -986,7 +1030,7 @@ void ExCorr::getSecondDerivatives(const ScalarField& n, ScalarField& e_nn, Scala
 		//Compute LibXC functionals:
 		for(auto func: functionals->libXC)
 			if(!func->hasKinetic())
-				func->evaluate(1, gInfo.nr, nData[0], sigmaData[0], lapData[0], tauData[0],
+				func->evaluateSub(1, 0, gInfo.nr, nData[0], sigmaData[0], lapData[0], tauData[0],
 					eData, e_nData[0], e_sigmaData[0], e_lapData[0], e_tauData[0]);
 		#endif
 		//Compute internal functionals:
@@ -1011,3 +1055,12 @@ void ExCorr::getSecondDerivatives(const ScalarField& n, ScalarField& e_nn, Scala
 		e_sigmasigma = 0;
 	}
 }
+
+
+std::vector<diagMatrix> ExCorr::OrbitalDep::getDensityWeights() const
+{	return std::vector<diagMatrix>();
+}
+
+ScalarFieldArray ExCorr::OrbitalDep::getPotential(const ScalarFieldArray& nWeighted) const
+{	return getPotential();
+}
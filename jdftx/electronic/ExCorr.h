@@ -22,6 +22,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/ScalarFieldArray.h>
 
+class diagMatrix;
+
 //! @addtogroup ExchangeCorrelation
 //! @{
 //! @file ExCorr.h Class ExCorr and helpers
@@ -85,8 +87,10 @@ public:
 	//! Orbital KE density tau must be provided if needsKEdensity() is true (for meta GGAs)
 	//! and the corresponding gradient will be returned in Vtau if non-null
 	//! For metaGGAs, Vtau should be non-null if Vxc is non-null
+	//! If processLocal is true, the evaluation is entirely within this process (no division of work or communication),
+	//! so that different processes may evaluate independent densities (eg. of different orbitals) concurrently.
 	double operator()(const ScalarFieldArray& n, ScalarFieldArray* Vxc=0, IncludeTXC includeTXC=IncludeTXC(),
-		const ScalarFieldArray* tau=0, ScalarFieldArray* Vtau=0) const;
+		const ScalarFieldArray* tau=0, ScalarFieldArray* Vtau=0, bool processLocal=false) const;
 	
 	//! Compute the exchange-correlation energy (and optionally gradient) for a unpolarized density n
 	//! includeTXC selects which components to include in result (XC without kinetic by default).
@@ -98,6 +102,9 @@ public:
 
 	double exxFactor() const; //!< retrieve the exact exchange scale factor (0 if no exact exchange)
 	double exxRange() const; //!< range parameter (omega) for screened exchange (0 for long-range exchange)
+	double exxPairThreshold; //!< skip exact-exchange pairs whose pair-density norm bound is below this (0 to evaluate all pairs)
+	bool exxLocalize; //!< rotate occupied orbitals to SCDM-localized orbitals before screening exact-exchange pairs
+	bool exxReduceImages; //!< evaluate each distinct symmetry image of a reduced k-point once in exact exchange, weighted by its multiplicity
 	bool needsKEdensity() const; //!< whether orbital KE density is required as an input (for meta GGAs)
 	bool hasEnergy() const; //!< whether functional supports a total energy (if not, only usable in SCF, and no forces)
 	
@@ -113,6 +120,11 @@ public:
 		virtual ~OrbitalDep() {}
 		virtual bool ignore_nCore() const=0; //!< Whether partial cores need to be ignored for this functional
 		virtual ScalarFieldArray getPotential() const=0; //!< Return orbital-dependent portion of potential (obtains any necessary electronic property directly from ElecVars / ElecInfo)
+		//! Optional fillings-like orbital weights (of all states, non-empty only for local ones) of an orbital-weighted density that the potential depends on,
+		//! so that ElecVars can accumulate it together with the electron density from the same real-space orbitals (no such density by default)
+		virtual std::vector<diagMatrix> getDensityWeights() const;
+		//! Return orbital-dependent portion of potential, given the orbital-weighted density with weights from getDensityWeights
+		virtual ScalarFieldArray getPotential(const ScalarFieldArray& nWeighted) const;
 		virtual void dump() const=0; //!< Dump any functional-specific quantities
 	protected:
 		const Everything& e;
@@ -71,6 +71,18 @@ ScalarFieldArray ExCorr_OrbitalDep_GLLBsc::getPotential() const
 	return getPotential(eHOMO);
 }
 
+std::vector<diagMatrix> ExCorr_OrbitalDep_GLLBsc::getDensityWeights() const
+{	if(!e.eVars.Hsub_eigs[e.eInfo.qStart].size()) return std::vector<diagMatrix>(); //no eigenvalues yet
+	return getWeights(getExtremalEnergy(true));
+}
+
+ScalarFieldArray ExCorr_OrbitalDep_GLLBsc::getPotential(const ScalarFieldArray& nWeighted) const
+{	ScalarFieldArray V(nWeighted.size());
+	for(unsigned s=0; s<V.size(); s++)
+		V[s] = nWeighted[s] * inv(e.eVars.n[s]); //denominator added here
+	return V;
+}
+
 void ExCorr_OrbitalDep_GLLBsc::dump() const
 {	int nSpins = e.eVars.n.size();
 	if(!e.eVars.Hsub_eigs[e.eInfo.qStart].size()) return; //no eigenvalues yet
@@ -170,29 +182,23 @@ double smoothedSqrt(double de, double width)
 	else return sqrt(std::max(0., de));
 }
 
-ScalarFieldArray ExCorr_OrbitalDep_GLLBsc::getPotential(std::vector<double> eHOMO, std::vector<double>* eLUMO) const
-{	int nSpins = eHOMO.size();
-	const double Kx = 8*sqrt(2)/(3*M_PI*M_PI);
-	ScalarFieldArray V(nSpins);
-	e.iInfo.augmentDensityInit();
+std::vector<diagMatrix> ExCorr_OrbitalDep_GLLBsc::getWeights(std::vector<double> eHOMO, std::vector<double>* eLUMO) const
+{	const double Kx = 8*sqrt(2)/(3*M_PI*M_PI);
+	std::vector<diagMatrix> Feff(e.eInfo.nStates);
 	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
-	{	const QuantumNumber& qnum = e.eInfo.qnums[q];
-		int s = qnum.index();
-		diagMatrix Feff(e.eInfo.nBands);
+	{	int s = e.eInfo.qnums[q].index();
+		Feff[q].resize(e.eInfo.nBands);
 		for(int b=0; b<e.eInfo.nBands; b++)
 		{	double deTerm = smoothedSqrt(eHOMO[s]-e.eVars.Hsub_eigs[q][b], smearingWidth); //orbital-dep potential
 			if(eLUMO) deTerm = smoothedSqrt((*eLUMO)[s]-e.eVars.Hsub_eigs[q][b], smearingWidth) - deTerm; //convert to the discontinuity contribution
-			Feff[b] = e.eVars.F[q][b] * Kx * deTerm;
+			Feff[q][b] = e.eVars.F[q][b] * Kx * deTerm;
 		}
-		V += qnum.weight * diagouterI(Feff, e.eVars.C[q], V.size(), &e.gInfo); //without the 1/n(r) denominator
-		e.iInfo.augmentDensitySpherical(qnum, Feff, e.eVars.VdagC[q]); //ultrasoft contribution
-	}
-	e.iInfo.augmentDensityGrid(V);
-	for(int s=0; s<nSpins; s++)
-	{	nullToZero(V[s], e.gInfo);
-		V[s]->allReduceData(mpiWorld, MPIUtil::ReduceSum);
-		e.symm.symmetrize(V[s]);
-		V[s] *= inv(e.eVars.n[s]); //denominator added here
 	}
-	return V;
+	return Feff;
+}
+
+ScalarFieldArray ExCorr_OrbitalDep_GLLBsc::getPotential(std::vector<double> eHOMO, std::vector<double>* eLUMO) const
+{	//Weighted density (including ultrasoft contributions), without the 1/n(r) denominator:
+	std::vector<std::vector<diagMatrix>> Fsets(1, getWeights(eHOMO, eLUMO));
+	return getPotential(e.eVars.calcDensities(Fsets)[0]);
 }
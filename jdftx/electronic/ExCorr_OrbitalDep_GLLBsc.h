@@ -30,10 +30,13 @@ struct ExCorr_OrbitalDep_GLLBsc : public ExCorr::OrbitalDep
 {	ExCorr_OrbitalDep_GLLBsc(const Everything&);
 	bool ignore_nCore() const { return true; }
 	ScalarFieldArray getPotential() const;
+	std::vector<diagMatrix> getDensityWeights() const;
+	ScalarFieldArray getPotential(const ScalarFieldArray& nWeighted) const;
 	void dump() const;
 private:
 	double smearingWidth; //smearing width
 	std::vector<double> getExtremalEnergy(bool HOMO) const; //!<  get HOMO or LUMO energy (depending on HOMO=true/false), optionally accounting for smearing (depending on T)
+	std::vector<diagMatrix> getWeights(std::vector<double> eHOMO, std::vector<double>* eLUMO=0) const; //!< orbital weights of the density in the orbital dep potential (or discontinuity contribution if eLUMO is non-null)
 	ScalarFieldArray getPotential(std::vector<double> eHOMO, std::vector<double>* eLUMO=0) const; //!< get the orbital dep potential (or discontinuity contribution if eLUMO is non-null)
 };
 
@@ -25,7 +25,15 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/GpuUtil.h>
 #include <core/Operators.h>
 #include <core/LatticeUtils.h>
+#include <core/Thread.h>
 #include <list>
+#include <mutex>
+#include <algorithm>
+
+extern "C"
+{	void zgeqp3_(int* M, int* N, complex* A, int* LDA, int* JPVT, complex* TAU,
+		complex* WORK, int* LWORK, double* RWORK, int* INFO);
+}
 
 //! Internal computation object for ExactExchange
 class ExactExchangeEval
@@ -33,9 +41,18 @@ class ExactExchangeEval
 public:
 	ExactExchangeEval(const Everything& e);
 	
-	//! Calculate for one entry of the k-mesh at a particular spin:
+	//! Calculate for one entry of the k-mesh at a particular spin (with the parameters of its image, if reduced; see KmapEntry):
+	//! Pair screening requires block amplitudes ampGroup (see getGroupAmplitudes) of the band group's states
 	double calc(int iSpin, unsigned iReduced, unsigned iInvert, unsigned iSym, 
-		double aXX, double omega, const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C, std::vector<ColumnBundle>* HC) const;
+		double aXX, double omega, const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C, std::vector<ColumnBundle>* HC,
+		const std::vector<std::vector<double>>& ampGroup) const;
+	
+	//! Make states of band group's owner available on all its members (no-op without helpers)
+	void shareGroupStates(const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C,
+		std::vector<diagMatrix>& Fgroup, std::vector<ColumnBundle>& Cgroup, std::vector<ColumnBundle>* HCgroup) const;
+	
+	//! Collect gradient contributions of helpers onto band group's owner (no-op without helpers)
+	void collectGroupGradients(std::vector<ColumnBundle>& HCgroup, std::vector<ColumnBundle>& HC) const;
 	
 private:
 	friend class ExactExchange;
@@ -48,11 +65,39 @@ private:
 	//Symmetry rotation map:
 	struct KmapEntry
 	{	vector3<> k;
-		Basis basis;
+		std::shared_ptr<Basis> basis; //shared between entries with the same k
+		std::shared_ptr<ColumnBundleTransform::BasisWrapper> basisWrapper;
 		std::shared_ptr<ColumnBundleTransform> transform; //wavefunction transformation from reduced set
+		int multiplicity; //number of operations with this image: 1 if not reducing images, 0 for repeated images when reducing
 	};
 	std::vector<KmapEntry> kmap;
 	inline int kmapIndex(int iReduced, int iInvert, int iSym) const { return (iReduced*invertList.size() + iInvert)*sym.size() + iSym; }
+	//Band-pair parallelization: processes that own no states (when there are more processes than states)
+	//join the band group of the process owning the next state, and split its pair loop over bk with it:
+	std::shared_ptr<MPIUtil> mpiBand; //!< communicator within band group (state owner is the last process)
+	int qStartGroup, qStopGroup; //!< range of states handled by band group
+	TaskDivision bkDivision; //!< division of bands bk of the k-mesh state over band group
+	bool hasHelpers() const { return mpiBand->nProcesses() > 1; }
+	
+	//Pair screening: |psi_k psi_q| integrated over real space is bounded (by Cauchy-Schwarz) by the
+	//product of the orbitals' norms within each block of the grid, summed over blocks
+	double pairThreshold; //!< skip pairs whose pair-density norm bound is below this (0 if screening disabled)
+	vector3<int> blockStride, nBlocks; //!< grid points per block and number of blocks along each direction
+	int nBlocksTot; //!< total number of blocks
+	void getBlockAmplitudes(const std::vector<complexScalarField>& Ipsi, double* amp) const; //!< sqrt of orbital norm within each block
+	std::vector<std::vector<double>> getGroupAmplitudes(const std::vector<ColumnBundle>& C) const; //!< block amplitudes of band group's states (band-major)
+	matrix localizingRotation(const diagMatrix& F, const ColumnBundle& C) const; //!< SCDM rotation of the occupied subspace (identity if fillings not uniform)
+	
+	//Per-thread accumulated quantities of pair calculation
+	struct PairAccum
+	{	double EXX;
+		std::vector<complexScalarField> grad_Ipsik;
+		std::mutex lock;
+	};
+	static void pairs_thread(size_t iStart, size_t iStop, const ExactExchangeEval* eval,
+		const std::vector<std::pair<int,int>>* pairs, const std::vector<complexScalarField>* Ipsik, const QuantumNumber* qnum_k,
+		double wFk, double prefac, double omega, const std::vector<diagMatrix>* F, const std::vector<ColumnBundle>* C,
+		std::vector<ColumnBundle>* HC, PairAccum* accum);
 };
 
 
@@ -80,17 +125,72 @@ double ExactExchange::operator()(double aXX, double omega,
 				(*HC)[q].zero();
 			}
 	
+	//Optionally rotate occupied subspaces to localized orbitals to make pair screening effective
+	//(exchange energy is invariant under such rotations when the occupied fillings are uniform):
+	std::vector<matrix> Uloc; std::vector<ColumnBundle> Cloc, HCloc;
+	if(eval->pairThreshold && e.exCorr.exxLocalize)
+	{	Uloc.resize(e.eInfo.nStates);
+		Cloc.resize(e.eInfo.nStates);
+		if(HC) HCloc.resize(e.eInfo.nStates);
+		for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+		{	Uloc[q] = eval->localizingRotation(F[q], C[q]);
+			Cloc[q] = C[q] * Uloc[q];
+			if(HC) { HCloc[q] = C[q].similar(); HCloc[q].zero(); }
+		}
+	}
+	const std::vector<ColumnBundle>& Cin = Cloc.size() ? Cloc : C;
+	std::vector<ColumnBundle>* HCin = HCloc.size() ? &HCloc : HC;
+	
+	//Share band group's states with helper processes (if any):
+	std::vector<diagMatrix> Fgroup; std::vector<ColumnBundle> Cgroup, HCgroup;
+	eval->shareGroupStates(F, Cin, Fgroup, Cgroup, HCin ? &HCgroup : 0);
+	const std::vector<diagMatrix>& Fuse = eval->hasHelpers() ? Fgroup : F;
+	const std::vector<ColumnBundle>& Cuse = eval->hasHelpers() ? Cgroup : Cin;
+	std::vector<ColumnBundle>* HCuse = (HCin && eval->hasHelpers()) ? &HCgroup : HCin;
+	std::vector<std::vector<double>> ampGroup;
+	if(eval->pairThreshold) ampGroup = eval->getGroupAmplitudes(Cuse);
+	
 	//Calculate:
 	double EXX = 0.0;
 	for(int iSpin=0; iSpin<eval->nSpins; iSpin++)
 		for(int iReduced=0; iReduced<eval->qCount; iReduced++)
 		for(unsigned iInvert=0; iInvert<eval->invertList.size(); iInvert++)
 		for(unsigned iSym=0; iSym<eval->sym.size(); iSym++)
-			EXX += eval->calc(iSpin, iReduced, iInvert, iSym, aXX, omega, F, C, HC);
+			if(eval->kmap[eval->kmapIndex(iReduced, iInvert, iSym)].multiplicity)
+				EXX += eval->calc(iSpin, iReduced, iInvert, iSym, aXX, omega, Fuse, Cuse, HCuse, ampGroup);
+	if(HCuse != HCin) eval->collectGroupGradients(HCgroup, *HCin);
+	
+	//Rotate gradients of localized orbitals back to the input wavefunctions:
+	if(HCin != HC)
+		for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+			(*HC)[q] += HCloc[q] * dagger(Uloc[q]);
 	watch.stop();
 	return EXX;
 }
 
+void ExactExchange::setACE(const std::vector<ColumnBundle>& C, const std::vector<ColumnBundle>& HC)
+{	static StopWatch watch("ExactExchange::setACE"); watch.start();
+	xiACE.resize(e.eInfo.nStates);
+	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+	{	//Exchange is negative definite, so that -C^HC = U^-dag U^-1 with U = invCholesky(-C^HC),
+		//and HC (C^HC)^-1 HC^ = -xi xi^ with xi = HC U:
+		bool isSingular = false;
+		matrix U = invCholesky(dagger_symmetrize(-(C[q] ^ HC[q])), &isSingular);
+		if(isSingular) die_alone("Exchange operator not negative definite in subspace of state %d; cannot build ACE projectors.\n", q);
+		xiACE[q] = HC[q] * U;
+	}
+	watch.stop();
+}
+
+void ExactExchange::applyACE(int q, const ColumnBundle& Cq, ColumnBundle& HCq) const
+{	if(q >= int(xiACE.size()) || !xiACE[q]) return;
+	static StopWatch watch("ExactExchange::applyACE"); watch.start();
+	const ColumnBundle& xi = xiACE[q];
+	if(HCq) HCq -= xi * (xi ^ Cq);
+	else HCq = xi * (-(xi ^ Cq));
+	watch.stop();
+}
+
 //--------------- class ExactExchangeEval implementation ----------------------
 
 
@@ -102,7 +202,8 @@ ExactExchangeEval::ExactExchangeEval(const Everything& e)
 	nSpins(e.eInfo.nSpins()),
 	nSpinor(e.eInfo.spinorLength()),
 	qCount(e.eInfo.nStates/nSpins),
-	kmap(qCount * invertList.size() * sym.size())
+	kmap(qCount * invertList.size() * sym.size()),
+	pairThreshold(e.exCorr.exxPairThreshold), blockStride(4,4,4)
 {
 	//Print cost estimate to give the user some idea of how long it might take!
 	double costFFT = e.eInfo.nStates * e.eInfo.nBands * 9.*e.gInfo.nr*log(e.gInfo.nr);
@@ -116,28 +217,123 @@ ExactExchangeEval::ExactExchangeEval(const Everything& e)
 	if(qCount==1 && sym.size()>1)
 		logPrintf("HINT: For gamma-point only calculations, turn off symmetries to speed up exact exchange.\n");
 	
+	//Blocks for pair screening:
+	nBlocksTot = 1;
+	for(int dir=0; dir<3; dir++)
+	{	nBlocks[dir] = (e.gInfo.S[dir] + blockStride[dir] - 1) / blockStride[dir];
+		nBlocksTot *= nBlocks[dir];
+	}
+	if(pairThreshold)
+		logPrintf("Screening pairs with pair-density norm bound below %lg over %d real-space blocks%s.\n",
+			pairThreshold, nBlocksTot, e.exCorr.exxLocalize ? " (with SCDM-localized occupied orbitals)" : "");
+	
 	//Initialize kmap:
+	//--- operations in the same coset of the stabilizer of a reduced k-point share the basis of their common image,
+	//--- and those that also share the net rotation (differing only in translation) share the transform index map
 	logSuspend();
 	for(int iReduced=0; iReduced<qCount; iReduced++)
 	for(unsigned iInvert=0; iInvert<invertList.size(); iInvert++)
 	for(unsigned iSym=0; iSym<sym.size(); iSym++)
 	{	KmapEntry& ki = kmap[kmapIndex(iReduced, iInvert, iSym)];
 		ki.k = e.eInfo.qnums[iReduced].k * sym[iSym].rot * invertList[iInvert];
-		ki.basis.setup(e.gInfo, e.iInfo, e.cntrl.Ecut, ki.k);
+		KmapEntry* kiPrev = 0; //earlier entry of same reduced k-point with same image
+		for(int j=kmapIndex(iReduced,0,0); j<kmapIndex(iReduced, iInvert, iSym); j++)
+			if((kmap[j].k - ki.k).length_squared() < symmThresholdSq)
+			{	kiPrev = &kmap[j];
+				break;
+			}
+		ki.multiplicity = 1;
+		if(kiPrev)
+		{	ki.basis = kiPrev->basis;
+			ki.basisWrapper = kiPrev->basisWrapper;
+			if(e.exCorr.exxReduceImages)
+			{	//Little group of the reduced k-point maps it to the same image: equivalent contribution for symmetric states
+				kiPrev->multiplicity++;
+				ki.multiplicity = 0;
+				continue; //no transform needed
+			}
+		}
+		else
+		{	ki.basis = std::make_shared<Basis>();
+			ki.basis->setup(e.gInfo, e.iInfo, e.cntrl.Ecut, ki.k);
+		}
 		if(e.eInfo.isMine(iReduced) || e.eInfo.isMine(iReduced + qCount))
+		{	if(!ki.basisWrapper) ki.basisWrapper = std::make_shared<ColumnBundleTransform::BasisWrapper>(*ki.basis);
+			//Find transform with same net rotation from the same coset (if any):
+			const ColumnBundleTransform* indexSource = 0;
+			matrix3<int> affine = sym[iSym].rot * invertList[iInvert];
+			for(int j=kmapIndex(iReduced,0,0); j<kmapIndex(iReduced, iInvert, iSym); j++)
+				if(kmap[j].basis == ki.basis && kmap[j].transform && kmap[j].transform->affineRotation() == affine)
+				{	indexSource = kmap[j].transform.get();
+					break;
+				}
 			ki.transform = std::make_shared<ColumnBundleTransform>(e.eInfo.qnums[iReduced].k, e.basis[iReduced],
-				ki.k, ki.basis, nSpinor, sym[iSym], invertList[iInvert]);
+				ki.k, *ki.basisWrapper, nSpinor, sym[iSym], invertList[iInvert], matrix3<int>(1,1,1), indexSource);
+		}
 	}
 	logResume();
+	if(e.exCorr.exxReduceImages)
+	{	int nImages = 0;
+		for(const KmapEntry& ki: kmap) if(ki.multiplicity) nImages++;
+		if(nImages < int(kmap.size()))
+			logPrintf("Evaluating %d distinct symmetry images of reduced k-points (instead of %lu).\n", nImages, kmap.size());
+	}
+	
+	//Initialize band groups:
+	int iGroup = e.eInfo.whose(e.eInfo.qStart); //owner of own states, or of next state for processes without states
+	mpiBand = std::make_shared<MPIUtil>(0, (char**)0, MPIUtil::ProcDivision(mpiWorld, 0, iGroup));
+	qStartGroup = e.eInfo.qStartOther(iGroup);
+	qStopGroup = e.eInfo.qStopOther(iGroup);
+	bkDivision.init(e.eInfo.nBands, mpiBand.get());
+	int nHelped = hasHelpers() ? 1 : 0; mpiWorld->allReduce(nHelped, MPIUtil::ReduceSum);
+	if(nHelped)
+		logPrintf("Distributing band pairs over %d processes for each of %d states.\n",
+			mpiWorld->nProcesses()/e.eInfo.nStates, e.eInfo.nStates);
+}
+
+void ExactExchangeEval::shareGroupStates(const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C,
+	std::vector<diagMatrix>& Fgroup, std::vector<ColumnBundle>& Cgroup, std::vector<ColumnBundle>* HCgroup) const
+{	if(!hasHelpers()) return;
+	static StopWatch watch("ExactExchange::share"); watch.start();
+	int iOwner = mpiBand->nProcesses()-1;
+	bool isOwner = (mpiBand->iProcess() == iOwner);
+	Fgroup.resize(e.eInfo.nStates);
+	Cgroup.resize(e.eInfo.nStates);
+	if(HCgroup) HCgroup->resize(e.eInfo.nStates);
+	for(int q=qStartGroup; q<qStopGroup; q++)
+	{	if(isOwner)
+		{	Fgroup[q] = F[q];
+			Cgroup[q] = C[q];
+		}
+		else
+		{	Fgroup[q].resize(e.eInfo.nBands);
+			Cgroup[q].init(e.eInfo.nBands, e.basis[q].nbasis*nSpinor, &e.basis[q], &e.eInfo.qnums[q], isGpuEnabled());
+		}
+		mpiBand->bcastData(Fgroup[q], iOwner);
+		mpiBand->bcastData(Cgroup[q], iOwner);
+		if(HCgroup) { (*HCgroup)[q] = Cgroup[q].similar(); (*HCgroup)[q].zero(); }
+	}
+	watch.stop();
+}
+
+void ExactExchangeEval::collectGroupGradients(std::vector<ColumnBundle>& HCgroup, std::vector<ColumnBundle>& HC) const
+{	static StopWatch watch("ExactExchange::collect"); watch.start();
+	int iOwner = mpiBand->nProcesses()-1;
+	for(int q=qStartGroup; q<qStopGroup; q++)
+	{	mpiBand->reduceData(HCgroup[q], MPIUtil::ReduceSum, iOwner);
+		if(mpiBand->iProcess() == iOwner) HC[q] += HCgroup[q];
+	}
+	watch.stop();
 }
 
 double ExactExchangeEval::calc(int iSpin, unsigned iReduced, unsigned iInvert, unsigned iSym,
-	double aXX, double omega, const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C, std::vector<ColumnBundle>* HC) const
+	double aXX, double omega, const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C, std::vector<ColumnBundle>* HC,
+	const std::vector<std::vector<double>>& ampGroup) const
 {
 	//Prepare ik state and gradient on all processes:
 	const KmapEntry& ki = kmap[kmapIndex(iReduced, iInvert, iSym)];
 	int ikSrc = iReduced + iSpin*qCount; //source state number
-	const Basis& basis_k = ki.basis;
+	const Basis& basis_k = *ki.basis;
 	QuantumNumber qnum_k = e.eInfo.qnums[ikSrc]; qnum_k.k =  ki.k;
 	ColumnBundle Ck(e.eInfo.nBands, basis_k.nbasis*nSpinor, &basis_k, &qnum_k, isGpuEnabled()), HCk;
 	diagMatrix Fk(e.eInfo.nBands);
@@ -151,46 +347,47 @@ double ExactExchangeEval::calc(int iSpin, unsigned iReduced, unsigned iInvert, u
 	if(HC) { HCk = Ck.similar(); HCk.zero(); }
 	
 	//Calculate energy (and gradient):
-	const double prefac = -0.5*aXX / (sym.size()*invertList.size()*e.eInfo.spinWeight);
+	const double prefac = -0.5*aXX * ki.multiplicity / (sym.size()*invertList.size()*e.eInfo.spinWeight);
 	double EXX = 0.;
-	for(int bk=0; bk<e.eInfo.nBands; bk++)
+	for(int bk=bkDivision.start(); bk<int(bkDivision.stop()); bk++)
 	{	//Put this state in real space:
-		std::vector<complexScalarField> Ipsik(nSpinor), grad_Ipsik(nSpinor);
+		std::vector<complexScalarField> Ipsik(nSpinor);
 		for(int s=0; s<nSpinor; s++)
 			Ipsik[s] = I(Ck.getColumn(bk,s));
 		double wFk = qnum_k.weight * Fk[bk];
+		std::vector<double> ampk;
+		if(pairThreshold)
+		{	ampk.resize(nBlocksTot);
+			getBlockAmplitudes(Ipsik, ampk.data());
+		}
 		
-		//Loop over states of same spin belonging to this MPI process:
-		for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
-		{	const QuantumNumber& qnum_q = e.eInfo.qnums[q];
-			if(qnum_k.spin != qnum_q.spin) continue;
+		//List pairs with states of same spin belonging to this band group:
+		std::vector<std::pair<int,int>> pairs;
+		for(int q=qStartGroup; q<qStopGroup; q++)
+		{	if(qnum_k.spin != e.eInfo.qnums[q].spin) continue;
 			for(int bq=0; bq<e.eInfo.nBands; bq++)
-			{	double wFq = qnum_q.weight * F[q][bq];
-				if(!wFk && !wFq) continue; //at least one of the orbitals must be occupied
-				
-				std::vector<complexScalarField> Ipsiq(nSpinor);
-				complexScalarField In; //state pair density
-				for(int s=0; s<nSpinor; s++)
-				{	Ipsiq[s] = I(C[q].getColumn(bq,s));
-					In += conj(Ipsik[s]) * Ipsiq[s];
-				}
-				complexScalarFieldTilde n = J(In);
-				complexScalarFieldTilde Kn = O((*e.coulomb)(n, qnum_q.k-qnum_k.k, omega)); //Electrostatic potential due to n
-				EXX += (prefac*wFk*wFq) * dot(n,Kn).real();
-				
-				if(HC)
-				{	complexScalarField E_In = Jdag(Kn);
-					for(int s=0; s<nSpinor; s++)
-					{	grad_Ipsik[s] += (prefac*wFq) * conj(E_In) * Ipsiq[s];
-						(*HC)[q].accumColumn(bq,s, Idag((prefac*wFk) * E_In * Ipsik[s]));
-					}
+			{	double wFq = e.eInfo.qnums[q].weight * F[q][bq];
+				if(!(wFk || wFq)) continue; //at least one of the orbitals must be occupied
+				if(pairThreshold)
+				{	const double* ampq = ampGroup[q].data() + bq*nBlocksTot;
+					double pairBound = 0.;
+					for(int iBlock=0; iBlock<nBlocksTot; iBlock++)
+						pairBound += ampk[iBlock] * ampq[iBlock];
+					if(pairBound < pairThreshold) continue; //negligible pair density
 				}
+				pairs.push_back(std::make_pair(q,bq));
 			}
 		}
+		
+		//Process pairs in parallel:
+		PairAccum accum; accum.EXX = 0.; accum.grad_Ipsik.resize(nSpinor);
+		threadLaunch(isGpuEnabled()?1:0, pairs_thread, pairs.size(), this, &pairs, &Ipsik, &qnum_k,
+			wFk, prefac, omega, &F, &C, HC, &accum);
+		EXX += accum.EXX;
 		if(HC)
 		{	for(int s=0; s<nSpinor; s++)
-				if(grad_Ipsik[s])
-					HCk.accumColumn(bk,s, Idag(grad_Ipsik[s]));
+				if(accum.grad_Ipsik[s])
+					HCk.accumColumn(bk,s, Idag(accum.grad_Ipsik[s]));
 		}
 	}
 	mpiWorld->allReduce(EXX, MPIUtil::ReduceSum, true);
@@ -203,3 +400,132 @@ double ExactExchangeEval::calc(int iSpin, unsigned iReduced, unsigned iInvert, u
 	}
 	return EXX;
 }
+
+void ExactExchangeEval::getBlockAmplitudes(const std::vector<complexScalarField>& Ipsi, double* amp) const
+{	const vector3<int>& S = e.gInfo.S;
+	std::fill(amp, amp+nBlocksTot, 0.);
+	for(const complexScalarField& Ipsi_s: Ipsi)
+	{	const complex* psi = Ipsi_s->data();
+		size_t i = 0;
+		for(int i0=0; i0<S[0]; i0++)
+		for(int i1=0; i1<S[1]; i1++)
+		{	double* ampRow = amp + ((i0/blockStride[0])*nBlocks[1] + i1/blockStride[1])*nBlocks[2];
+			for(int i2=0; i2<S[2]; i2++)
+				ampRow[i2/blockStride[2]] += psi[i++].norm();
+		}
+	}
+	for(int iBlock=0; iBlock<nBlocksTot; iBlock++)
+		amp[iBlock] = sqrt(amp[iBlock] * e.gInfo.dV);
+}
+
+std::vector<std::vector<double>> ExactExchangeEval::getGroupAmplitudes(const std::vector<ColumnBundle>& C) const
+{	static StopWatch watch("ExactExchange::screen"); watch.start();
+	std::vector<std::vector<double>> amp(e.eInfo.nStates);
+	for(int q=qStartGroup; q<qStopGroup; q++)
+	{	amp[q].resize(e.eInfo.nBands * nBlocksTot);
+		for(int b=0; b<e.eInfo.nBands; b++)
+		{	std::vector<complexScalarField> Ipsi(nSpinor);
+			for(int s=0; s<nSpinor; s++)
+				Ipsi[s] = I(C[q].getColumn(b,s));
+			getBlockAmplitudes(Ipsi, amp[q].data() + b*nBlocksTot);
+		}
+	}
+	watch.stop();
+	return amp;
+}
+
+matrix ExactExchangeEval::localizingRotation(const diagMatrix& F, const ColumnBundle& C) const
+{	static StopWatch watch("ExactExchange::localize"); watch.start();
+	int nBands = C.nCols();
+	matrix U = eye(nBands);
+	//Identify occupied subspace (leave canonical orbitals if fillings are fractional):
+	double Fmax = F.size() ? *std::max_element(F.begin(), F.end()) : 0.;
+	std::vector<int> bOcc;
+	for(int b=0; b<nBands; b++)
+	{	if(fabs(F[b]-Fmax) < 1e-12) bOcc.push_back(b);
+		else if(fabs(F[b]) > 1e-12) { watch.stop(); return U; }
+	}
+	int nOcc = bOcc.size();
+	int nSamples = nBlocksTot * nSpinor;
+	if(Fmax<=0. || nOcc<2 || nSamples<nOcc) { watch.stop(); return U; }
+	
+	//Sample occupied orbitals at the block corners (columns of PsiDag are the orbital values at each point):
+	matrix PsiDag(nOcc, nSamples);
+	complex* PsiDagData = PsiDag.data();
+	for(int i=0; i<nOcc; i++)
+		for(int s=0; s<nSpinor; s++)
+		{	complexScalarField Ipsi = I(C.getColumn(bOcc[i],s));
+			const complex* psi = Ipsi->data();
+			int j = s*nBlocksTot;
+			vector3<int> iv;
+			for(iv[0]=0; iv[0]<e.gInfo.S[0]; iv[0]+=blockStride[0])
+			for(iv[1]=0; iv[1]<e.gInfo.S[1]; iv[1]+=blockStride[1])
+			for(iv[2]=0; iv[2]<e.gInfo.S[2]; iv[2]+=blockStride[2])
+				PsiDagData[PsiDag.index(i,j++)] = psi[e.gInfo.fullRindex(iv)].conj();
+		}
+	
+	//Select the most representative points by QR with column pivoting (SCDM):
+	matrix A(PsiDag);
+	std::vector<int> jpvt(nSamples, 0);
+	std::vector<complex> tau(nOcc);
+	std::vector<double> rwork(2*nSamples);
+	int lwork = -1, info = 0; complex lworkOpt;
+	zgeqp3_(&nOcc, &nSamples, A.data(), &nOcc, jpvt.data(), tau.data(), &lworkOpt, &lwork, rwork.data(), &info);
+	lwork = int(lworkOpt.real());
+	std::vector<complex> work(lwork);
+	zgeqp3_(&nOcc, &nSamples, A.data(), &nOcc, jpvt.data(), tau.data(), work.data(), &lwork, rwork.data(), &info);
+	if(info) { watch.stop(); return U; }
+	
+	//Orthonormalized density-matrix columns at the selected points:
+	matrix Psel(nOcc, nOcc);
+	for(int j=0; j<nOcc; j++)
+		Psel.set(0,nOcc, j,j+1, PsiDag(0,nOcc, jpvt[j]-1,jpvt[j]));
+	bool isSingular = false;
+	matrix Uocc = Psel * invsqrt(dagger(Psel) * Psel, 0, 0, &isSingular);
+	if(!isSingular)
+		for(int i=0; i<nOcc; i++)
+			for(int j=0; j<nOcc; j++)
+				U.set(bOcc[i], bOcc[j], Uocc(i,j));
+	watch.stop();
+	return U;
+}
+
+void ExactExchangeEval::pairs_thread(size_t iStart, size_t iStop, const ExactExchangeEval* eval,
+	const std::vector<std::pair<int,int>>* pairs, const std::vector<complexScalarField>* Ipsik, const QuantumNumber* qnum_k,
+	double wFk, double prefac, double omega, const std::vector<diagMatrix>* F, const std::vector<ColumnBundle>* C,
+	std::vector<ColumnBundle>* HC, PairAccum* accum)
+{	const Everything& e = eval->e;
+	int nSpinor = eval->nSpinor;
+	double EXX = 0.;
+	std::vector<complexScalarField> grad_Ipsik(nSpinor);
+	for(size_t iPair=iStart; iPair<iStop; iPair++)
+	{	int q = pairs->at(iPair).first;
+		int bq = pairs->at(iPair).second;
+		const QuantumNumber& qnum_q = e.eInfo.qnums[q];
+		double wFq = qnum_q.weight * F->at(q)[bq];
+		
+		std::vector<complexScalarField> Ipsiq(nSpinor);
+		complexScalarField In; //state pair density
+		for(int s=0; s<nSpinor; s++)
+		{	Ipsiq[s] = I(C->at(q).getColumn(bq,s));
+			In += conj(Ipsik->at(s)) * Ipsiq[s];
+		}
+		complexScalarFieldTilde n = J(In);
+		complexScalarFieldTilde Kn = O((*e.coulomb)(n, qnum_q.k-qnum_k->k, omega)); //Electrostatic potential due to n
+		EXX += (prefac*wFk*wFq) * dot(n,Kn).real();
+		
+		if(HC)
+		{	complexScalarField E_In = Jdag(Kn);
+			for(int s=0; s<nSpinor; s++)
+			{	grad_Ipsik[s] += (prefac*wFq) * conj(E_In) * Ipsiq[s];
+				(*HC)[q].accumColumn(bq,s, Idag((prefac*wFk) * E_In * Ipsik->at(s))); //distinct columns in each thread
+			}
+		}
+	}
+	//Collect per-thread results:
+	std::lock_guard<std::mutex> lock(accum->lock);
+	accum->EXX += EXX;
+	for(int s=0; s<nSpinor; s++)
+		if(grad_Ipsik[s])
+			accum->grad_Ipsik[s] += grad_Ipsik[s];
+}
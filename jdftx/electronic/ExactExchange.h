@@ -40,9 +40,17 @@ public:
 	double operator()(double aXX, double omega,
 		const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C,
 		std::vector<ColumnBundle>* HC = 0) const;
+	
+	//! Build the adaptively compressed exchange (ACE) operator -xi xi^ from the exchange gradients HC
+	//! computed by operator() at wavefunctions C, which reproduces the exchange operator exactly within
+	//! the span of C for each local state (used by the SCF eigensolver steps in place of the full pair loop)
+	void setACE(const std::vector<ColumnBundle>& C, const std::vector<ColumnBundle>& HC);
+	//! Accumulate the ACE operator applied to Cq into HCq (no-op if ACE has not been set for state q)
+	void applyACE(int q, const ColumnBundle& Cq, ColumnBundle& HCq) const;
 private:
 	const Everything& e;
 	class ExactExchangeEval* eval; //!< opaque pointer to an internal computation class
+	std::vector<ColumnBundle> xiACE; //!< ACE projectors xi for each local state (empty if not set)
 };
 
 //! @}
@@ -250,7 +250,19 @@ bool IonDynamics::report(double t)
 {	int iter = lrint(t/e.ionDynamicsParams.dt); //round to int to get iteration number
 	//Dump:
 	e.dump(DumpFreq_Ionic, iter);
+	e.dump.metrics("IonDynamics", iter, kineticEnergy + potentialEnergy - initialPotentialEnergy, NAN,
+		{{"KE", kineticEnergy}, {"pressure", pressure}});
 	
+	const IonDynamicsParams& idp = e.ionDynamicsParams;
+	if(trajectory && iter % idp.trajectoryStride == 0)
+		trajectory->addFrame(iter, t, kineticEnergy, potentialEnergy - initialPotentialEnergy, pressure, totalMomentumNorm);
+	
+	if(idp.compactLog)
+	{	logPrintf("VerletMD: Iter: %5d  t[fs]: %10.3lf  E_Kin: %+.10lf  E_pot: %+.10lf  E_tot: %+.10lf  P[Bar]: %+.4le  |p|: %.2le\n",
+			iter, t/fs, kineticEnergy, potentialEnergy - initialPotentialEnergy,
+			kineticEnergy + potentialEnergy - initialPotentialEnergy, pressure/Bar, totalMomentumNorm);
+		return false;
+	}
 	logPrintf("\nVerletMD t = %f fs (dt = %f in atomic units) Iter: %d",t/fs,e.ionDynamicsParams.dt, iter);
 	logPrintf("\nE_Kin = %lg \t E_pot = %lg \t E_tot = %lg \t pressure(in Bar) = %lg Momentum = %lg",
 		  kineticEnergy, potentialEnergy - initialPotentialEnergy, 
@@ -261,6 +273,50 @@ bool IonDynamics::report(double t)
 	return false;
 }
 
+void IonDynamics::saveWavefunctions()
+{	int nHistory = e.ionDynamicsParams.extrapolationOrder + 1;
+	if(nHistory < 2) return; //only the current wavefunctions are used
+	static StopWatch watch("IonDynamics::saveWavefunctions"); watch.start();
+	const ElecInfo& eInfo = e.eInfo;
+	const std::vector<ColumnBundle>& C = e.eVars.C;
+	//Rotate previous steps' wavefunctions within their subspace to best match the current ones:
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	ColumnBundle OC = O(C[q]);
+		for(std::vector<ColumnBundle>& Cprev: Chistory)
+		{	matrix M = Cprev[q] ^ OC;
+			Cprev[q] = Cprev[q] * (M * invsqrt(dagger(M) * M)); //unitary part of M
+		}
+	}
+	//Add current wavefunctions, discarding the oldest beyond those needed:
+	Chistory.push_front(std::vector<ColumnBundle>(eInfo.nStates));
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		Chistory.front()[q] = C[q];
+	if(int(Chistory.size()) > nHistory) Chistory.pop_back();
+	watch.stop();
+}
+
+void IonDynamics::extrapolateWavefunctions()
+{	if(Chistory.size() < 2) return; //nothing to extrapolate from yet
+	static StopWatch watch("IonDynamics::extrapolateWavefunctions"); watch.start();
+	//Coefficients of the always stable predictor (J. Kolafa, J. Comput. Chem. 25, 335 (2004))
+	//of the highest order K supported by the available history (of length K+1):
+	int K = Chistory.size() - 1;
+	std::vector<double> B(K+1);
+	auto binomial = [](int n, int k) { double result = 1.; for(int i=1; i<=k; i++) result *= (n-k+i)*(1./i); return result; };
+	for(int m=1; m<=K+1; m++)
+		B[m-1] = (m%2 ? 1 : -1) * m * binomial(2*K+2, K+1-m) / binomial(2*K, K);
+	//Predict and orthonormalize (at the new ionic positions) wavefunctions:
+	ElecVars& eVars = e.eVars;
+	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+	{	eVars.C[q] = Chistory[0][q] * B[0];
+		for(int m=1; m<=K; m++)
+			eVars.C[q] += Chistory[m][q] * B[m];
+		eVars.orthonormalize(q);
+	}
+	logPrintf("Extrapolated wavefunctions from %d previous ionic steps.\n", K+1);
+	watch.stop();
+}
+
 void IonDynamics::step(const IonicGradient& accel, const double& dt)
 {	IonicGradient dpos;
 	dpos.init(e.iInfo);
@@ -284,7 +340,9 @@ void IonDynamics::step(const IonicGradient& accel, const double& dt)
 	dpos = dpos + e.gInfo.invR*accel*(dt*dt); //accel is in cartesian, dpos in lattice
 	
 	//call the IonicMinimizer::step() that moves the wavefunctions and the nuclei
+	saveWavefunctions();
 	imin.step(e.gInfo.R * dpos, 1.0); //takes its argument in cartesian coordinates
+	extrapolateWavefunctions(); //overrides wavefunction drag (if enabled) once enough history is available
 	//Update the velocities
 	for(unsigned sp=0; sp < e.iInfo.species.size(); sp++)
 	{	SpeciesInfo& spInfo = *(e.iInfo.species[sp]);
@@ -307,6 +365,8 @@ void IonDynamics::run()
 	accel.init(e.iInfo);
 	initialPotentialEnergy = (double)NAN; // ground state potential
 	nullToZero(e.eVars.nAccumulated,e.gInfo);
+	if(e.ionDynamicsParams.trajectoryFilename.length())
+		trajectory = std::make_shared<TrajectoryWriter>(e, e.ionDynamicsParams.trajectoryFilename);
 	
 	for(double t=0.0; t<e.ionDynamicsParams.tMax; t+=e.ionDynamicsParams.dt)
 	{	potentialEnergy = computeAcceleration(accel);
@@ -324,6 +384,7 @@ void IonDynamics::run()
 		  e.eVars.nAccumulated[s]=(e.eVars.nAccumulated[s]*t+e.eVars.n[s]*e.ionDynamicsParams.dt)*(1.0/(t+e.ionDynamicsParams.dt));
 		}
 	}
+	trajectory = 0; //write out remaining frames
 }
 
 void IonDynamics::removeNetDriftVelocity()  
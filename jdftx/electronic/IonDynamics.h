@@ -21,7 +21,10 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_ELECTRONIC_IONDYNAMICS_H
 
 #include <electronic/IonicMinimizer.h>
+#include <electronic/ColumnBundle.h>
+#include <electronic/IonDynamicsTrajectory.h>
 #include <core/matrix3.h>
+#include <deque>
 
 //! @addtogroup IonicSystem
 //! @{
@@ -40,7 +43,13 @@ private:
 	double totalMass; int numberOfAtoms;
 	vector3<double> totalMomentum;
 	
+	std::shared_ptr<TrajectoryWriter> trajectory; //!< binary trajectory output (if enabled)
 	IonicMinimizer imin; //Just to be able to call IonicMinimizer::step(). Doesn't minimize anything.
+	
+	//Wavefunction extrapolation:
+	std::deque<std::vector<ColumnBundle>> Chistory; //!< converged wavefunctions of previous steps (newest first), each rotated to best match the newest
+	void saveWavefunctions(); //!< add the current converged wavefunctions to Chistory (if extrapolation is enabled)
+	void extrapolateWavefunctions(); //!< predict wavefunctions at the new ionic positions from Chistory (always stable predictor of Kolafa)
 
 	// similar to the virtual functions of Minimizable:
 	void step(const IonicGradient&, const double&);   //!< Given the acceleration, take a time step. Scale the velocities if heat bath exists
@@ -21,6 +21,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_ELECTRONIC_IONDYNAMICSPARAMS_H
 
 #include <core/Units.h>
+#include <core/string.h>
 
 //! @addtogroup IonicSystem
 //! @{
@@ -51,9 +52,13 @@ struct IonDynamicsParams
 	DriftRemovalType driftType; //!< drift removal strategy
 	ConfiningPotentialType confineType; //!< confinement potential type
 	std::vector<double> confineParameters; //!< parameters controlling confinement potential
+	int extrapolationOrder; //!< order K of ASPC wavefunction extrapolation from K+1 previous steps (0 to reuse the previous step's wavefunctions)
+	string trajectoryFilename; //!< binary trajectory output file (none if empty)
+	int trajectoryStride; //!< number of steps between trajectory frames
+	bool compactLog; //!< whether to log only one line of energies per step (instead of positions, forces and energy components)
 	
 	//! Set the default values
-	IonDynamicsParams(): dt(1.0*fs), tMax(0.0) ,kT(0.001), alpha(0.0), driftType(DriftMomentum), confineType(ConfineNone){}
+	IonDynamicsParams(): dt(1.0*fs), tMax(0.0) ,kT(0.001), alpha(0.0), driftType(DriftMomentum), confineType(ConfineNone), extrapolationOrder(0), trajectoryStride(1), compactLog(false) {}
 };
 
 //! @}
@@ -0,0 +1,143 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/IonDynamicsTrajectory.h>
+#include <electronic/Everything.h>
+#include <unistd.h>
+
+static const char trajectoryMagic[8] = {'J','D','F','T','X','T','R','J'};
+static const uint64_t trajectoryVersion = 1;
+static const size_t trajectoryFrameScalars = 16; //iter, t, KE, PE, Etot, pressure, |momentum| and R
+
+//Append little-endian binary representations of scalars to buf:
+static void append(std::vector<char>& buf, const void* data, size_t size, size_t nmemb)
+{	size_t offs = buf.size();
+	buf.resize(offs + size*nmemb);
+	memcpy(buf.data()+offs, data, size*nmemb);
+	convertToLE(buf.data()+offs, size, nmemb);
+}
+static void append(std::vector<char>& buf, uint64_t i) { append(buf, &i, sizeof(i), 1); }
+static void append(std::vector<char>& buf, double x) { append(buf, &x, sizeof(x), 1); }
+static void append(std::vector<char>& buf, const vector3<>& v) { append(buf, &v[0], sizeof(double), 3); }
+
+TrajectoryWriter::TrajectoryWriter(const Everything& e, string fname) : e(e), fp(0), nAtoms(0), finished(false)
+{	const IonInfo& iInfo = e.iInfo;
+	for(const auto& sp: iInfo.species) nAtoms += sp->atpos.size();
+	frameBytes = sizeof(double) * (trajectoryFrameScalars + 9*nAtoms);
+	if(!mpiWorld->isHead()) return;
+
+	//Construct header:
+	std::vector<char> header(trajectoryMagic, trajectoryMagic+sizeof(trajectoryMagic));
+	size_t headerBytes = sizeof(trajectoryMagic) + sizeof(uint64_t)*(5 + 2*iInfo.species.size()) + 16*iInfo.species.size();
+	append(header, trajectoryVersion);
+	append(header, uint64_t(headerBytes));
+	append(header, uint64_t(frameBytes));
+	append(header, uint64_t(nAtoms));
+	append(header, uint64_t(iInfo.species.size()));
+	for(const auto& sp: iInfo.species)
+	{	char name[16] = {0};
+		strncpy(name, sp->name.c_str(), sizeof(name)-1);
+		header.insert(header.end(), name, name+sizeof(name));
+		append(header, uint64_t(sp->atpos.size()));
+		append(header, sp->mass);
+	}
+	assert(header.size() == headerBytes);
+
+	//Append to an existing compatible trajectory, if any:
+	off_t fsize = fileSize(fname.c_str());
+	if(fsize >= off_t(headerBytes))
+	{	std::vector<char> headerPrev(headerBytes);
+		FILE* fpPrev = fopen(fname.c_str(), "rb");
+		bool match = fpPrev && fread(headerPrev.data(), 1, headerBytes, fpPrev)==headerBytes && headerPrev==header;
+		if(fpPrev) fclose(fpPrev);
+		if(match)
+		{	size_t nFrames = (fsize - headerBytes) / frameBytes;
+			if(truncate(fname.c_str(), headerBytes + nFrames*frameBytes)) //drop any partially-written frame
+				die("Could not truncate trajectory file '%s'.\n", fname.c_str());
+			fp = fopen(fname.c_str(), "ab");
+			if(!fp) die("Could not open trajectory file '%s' for appending.\n", fname.c_str());
+			logPrintf("Appending ionic dynamics trajectory to '%s' after %zu existing frames.\n", fname.c_str(), nFrames);
+		}
+		else logPrintf("Existing file '%s' does not match the current system: overwriting it.\n", fname.c_str());
+	}
+	if(!fp)
+	{	fp = fopen(fname.c_str(), "wb");
+		if(!fp) die("Could not open trajectory file '%s' for writing.\n", fname.c_str());
+		if(fwrite(header.data(), 1, headerBytes, fp) != headerBytes)
+			die("Error writing trajectory file '%s'.\n", fname.c_str());
+		logPrintf("Writing ionic dynamics trajectory to '%s' (%zu bytes per frame).\n", fname.c_str(), frameBytes);
+	}
+	thread = std::thread(&TrajectoryWriter::writeLoop, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{	if(!fp) return;
+	{	std::lock_guard<std::mutex> lock(m);
+		finished = true;
+	}
+	cv.notify_one();
+	thread.join();
+	fclose(fp);
+}
+
+void TrajectoryWriter::addFrame(int iter, double t, double KE, double PE, double pressure, double momentumNorm)
+{	if(!fp) return;
+	const IonInfo& iInfo = e.iInfo;
+	const matrix3<>& R = e.gInfo.R;
+	std::vector<char> buf; buf.reserve(frameBytes);
+	append(buf, uint64_t(iter));
+	append(buf, t);
+	append(buf, KE);
+	append(buf, PE);
+	append(buf, KE + PE);
+	append(buf, pressure);
+	append(buf, momentumNorm);
+	for(int i=0; i<3; i++)
+		for(int j=0; j<3; j++)
+			append(buf, R(i,j));
+	for(unsigned sp=0; sp<iInfo.species.size(); sp++)
+	{	const SpeciesInfo& spInfo = *(iInfo.species[sp]);
+		for(unsigned atom=0; atom<spInfo.atpos.size(); atom++)
+		{	append(buf, R * spInfo.atpos[atom]);
+			append(buf, spInfo.velocities.size() ? R * spInfo.velocities[atom] : vector3<>());
+			append(buf, iInfo.forces.size() ? e.gInfo.invRT * iInfo.forces[sp][atom] : vector3<>());
+		}
+	}
+	assert(buf.size() == frameBytes);
+	{	std::lock_guard<std::mutex> lock(m);
+		queue.push_back(std::move(buf));
+	}
+	cv.notify_one();
+}
+
+void TrajectoryWriter::writeLoop()
+{	std::unique_lock<std::mutex> lock(m);
+	while(true)
+	{	cv.wait(lock, [this](){ return finished || queue.size(); });
+		if(!queue.size()) break; //finished, with nothing left to write
+		//Write all currently queued frames outside the lock:
+		std::deque<std::vector<char>> pending; pending.swap(queue);
+		lock.unlock();
+		for(const std::vector<char>& buf: pending)
+			if(fwrite(buf.data(), 1, buf.size(), fp) != buf.size())
+				fprintf(stderr, "WARNING: error writing ionic dynamics trajectory frame.\n");
+		fflush(fp); //complete frames are visible to readers of a running trajectory
+		lock.lock();
+	}
+}
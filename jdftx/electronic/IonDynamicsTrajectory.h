@@ -0,0 +1,71 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_IONDYNAMICSTRAJECTORY_H
+#define JDFTX_ELECTRONIC_IONDYNAMICSTRAJECTORY_H
+
+#include <core/string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdio>
+
+class Everything;
+
+//! @addtogroup IonicSystem
+//! @{
+//! @file IonDynamicsTrajectory.h Binary trajectory output for ionic dynamics
+
+/**
+Appendable binary trajectory of an ionic dynamics run (see command ionic-dynamics-trajectory).
+The file starts with a header (all little-endian, 64-bit integers and doubles):
+	char magic[8] = "JDFTXTRJ", uint64 version, headerBytes, frameBytes, nAtoms, nSpecies,
+	and for each species: char name[16], uint64 nAtoms, double mass (amu),
+followed by fixed-size frames of frameBytes each, so that frame i starts at headerBytes + i*frameBytes:
+	uint64 iter, double t, KE, PE (relative to the first step), Etot, pressure, |momentum|, R[3][3] (row-major, columns are lattice vectors),
+	and then for each atom (in species order) the cartesian position, velocity and force (3 doubles each).
+All quantities are in atomic units (Hartrees, bohrs and hbar/Eh for time).
+Frames are queued by the head process and written from a background thread, so that the dynamics is not held up by I/O.
+*/
+class TrajectoryWriter
+{
+public:
+	//! Open fname on head, appending to an existing trajectory of the same system and layout, or starting a new one otherwise
+	TrajectoryWriter(const Everything& e, string fname);
+	~TrajectoryWriter(); //!< write out all queued frames and close the file
+
+	//! Queue a frame with the current positions, velocities and forces of e.iInfo (call on all processes; only the head writes)
+	void addFrame(int iter, double t, double KE, double PE, double pressure, double momentumNorm);
+
+private:
+	const Everything& e;
+	FILE* fp; //!< output file (head only)
+	size_t nAtoms, frameBytes;
+	std::deque<std::vector<char>> queue; //!< serialized frames waiting to be written
+	std::mutex m;
+	std::condition_variable cv;
+	bool finished; //!< set once no further frames will be queued
+	std::thread thread; //!< background writer
+	void writeLoop(); //!< run on background thread
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_IONDYNAMICSTRAJECTORY_H
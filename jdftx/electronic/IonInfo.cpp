@@ -36,6 +36,7 @@ IonInfo::IonInfo()
 {	shouldPrintForceComponents = false;
 	vdWenable = false;
 	vdWscale = 0.;
+	ionicPreconditioner = IonicPrecondNone;
 }
 
 void IonInfo::setup(const Everything &everything)
@@ -134,18 +135,32 @@ void IonInfo::update(Energies& ener)
 {	const GridInfo &gInfo = e->gInfo;
 
 	//----------- update Vlocps, rhoIon, nCore and nChargeball --------------
-	initZero(Vlocps, gInfo);
-	initZero(rhoIon, gInfo);
-	if(nChargeball) nChargeball->zero();
-	ScalarFieldTilde nCoreTilde, tauCoreTilde;
+	//Update the species sums incrementally if the lattice is unchanged and at most half the atoms moved:
+	bool incremental = VlocpsSpecies && (Rspecies == gInfo.R);
+	int nAtoms = 0, nMoved = 0;
+	for(auto sp: species)
+	{	int nMovedSp = sp->nMovedLocal();
+		if(nMovedSp < 0) incremental = false;
+		nAtoms += sp->atpos.size();
+		nMoved += nMovedSp;
+	}
+	if(2*nMoved > nAtoms) incremental = false;
+	if(!incremental)
+	{	initZero(VlocpsSpecies, gInfo);
+		initZero(rhoIonSpecies, gInfo);
+		if(nChargeball) nChargeball->zero();
+		nCoreSpecies = 0;
+		tauCoreSpecies = 0;
+		Rspecies = gInfo.R;
+	}
 	for(auto sp: species) //collect contributions to the above from all species
-		sp->updateLocal(Vlocps, rhoIon, nChargeball, nCoreTilde, tauCoreTilde);
+		sp->updateLocal(VlocpsSpecies, rhoIonSpecies, nChargeball, nCoreSpecies, tauCoreSpecies, incremental);
 	//Add long-range part to Vlocps and smoothen rhoIon:
-	Vlocps += (*e->coulomb)(rhoIon, Coulomb::PointChargeRight);
-	rhoIon = gaussConvolve(rhoIon, ionWidth);
+	Vlocps = VlocpsSpecies + (*e->coulomb)(rhoIonSpecies, Coulomb::PointChargeRight);
+	rhoIon = gaussConvolve(rhoIonSpecies, ionWidth);
 	//Process partial core density:
-	if(nCoreTilde) nCore = I(nCoreTilde); // put in real space
-	if(tauCoreTilde) tauCore = I(tauCoreTilde); // put in real space
+	if(nCoreSpecies) nCore = I(nCoreSpecies); // put in real space
+	if(tauCoreSpecies) tauCore = I(tauCoreSpecies); // put in real space
 	
 	//---------- energies dependent on ionic positions alone ----------------
 	
@@ -269,6 +284,12 @@ void IonInfo::augmentDensitySpherical(const QuantumNumber& qnum, const diagMatri
 void IonInfo::augmentDensityGrid(ScalarFieldArray& n) const
 {	for(auto sp: species) sp->augmentDensityGrid(n);
 }
+void IonInfo::augmentDensityReduce(bool async) const
+{	for(auto sp: species) ((SpeciesInfo&)(*sp)).augmentDensityReduce(async);
+}
+void IonInfo::augmentDensityGrid(ScalarFieldArray& n, int s) const
+{	for(auto sp: species) ((SpeciesInfo&)(*sp)).augmentDensityGrid(n, s);
+}
 void IonInfo::augmentDensityGridGrad(const ScalarFieldArray& E_n, IonicGradient* forces) const
 {	for(unsigned sp=0; sp<species.size(); sp++)
 		((SpeciesInfo&)(*species[sp])).augmentDensityGridGrad(E_n, forces ? &forces->at(sp) : 0);
@@ -283,15 +304,13 @@ void IonInfo::project(const ColumnBundle& Cq, std::vector<matrix>& VdagCq, matri
 	for(unsigned sp=0; sp<e->iInfo.species.size(); sp++)
 	{	if(rotExisting && VdagCq[sp]) VdagCq[sp] = VdagCq[sp] * (*rotExisting); //rotate and keep the existing projections
 		else
-		{	auto V = e->iInfo.species[sp]->getV(Cq);
-			if(V) VdagCq[sp] = (*V) ^ Cq;
-		}
+			VdagCq[sp] = e->iInfo.species[sp]->getVdagC(Cq);
 	}
 }
 
 void IonInfo::projectGrad(const std::vector<matrix>& HVdagCq, const ColumnBundle& Cq, ColumnBundle& HCq) const
 {	for(unsigned sp=0; sp<species.size(); sp++)
-		if(HVdagCq[sp]) HCq += *(species[sp]->getV(Cq)) * HVdagCq[sp];
+		if(HVdagCq[sp]) species[sp]->accumV(HVdagCq[sp], HCq);
 }
 
 //----- DFT+U functions --------
@@ -351,26 +370,42 @@ void IonInfo::rhoAtom_forces(const std::vector<diagMatrix>& F, const std::vector
 }
 
 matrix IonInfo::rHcommutator(const ColumnBundle& Y, int iDir, const matrix& YdagHY) const
-{	matrix result = e->gInfo.detR * (Y ^ D(Y, iDir)); //contribution from kinetic term
+{	matrix result;
+	rHcommutator(Y, YdagHY, iDir, iDir+1, &result);
+	return result;
+}
+
+vector3<matrix> IonInfo::rHcommutator(const ColumnBundle& Y, const matrix& YdagHY) const
+{	vector3<matrix> result;
+	rHcommutator(Y, YdagHY, 0, 3, &result[0]);
+	return result;
+}
+
+void IonInfo::rHcommutator(const ColumnBundle& Y, const matrix& YdagHY, int iDirStart, int iDirStop, matrix* result) const
+{	static StopWatch watch("IonInfo::rHcommutator"); watch.start();
+	for(int iDir=iDirStart; iDir<iDirStop; iDir++)
+		result[iDir-iDirStart] = e->gInfo.detR * (Y ^ D(Y, iDir)); //contribution from kinetic term
 	//k-space derivative contributions:
-	vector3<> dirHat; dirHat[iDir] = 1.; //Cartesian unit vector corresponding to iDir
 	complex minus_i(0,-1); //prefactor to k-derivatives
 	//DFT+U corrections:
 	if(e->eInfo.hasU)
 	{	const matrix* U_rhoAtomPtr = e->eVars.U_rhoAtom.data();
 		for(const auto& sp: species)
 		{	if(sp->rhoAtom_nMatrices())
-			{	matrix Urho, psiDagY, ri_psiDagY, ri_psiDagYnew;
+			{	matrix Urho, psiDagY;
 				{	ColumnBundle psi;
 					sp->rhoAtom_getV(Y, U_rhoAtomPtr, psi, Urho);
 					psiDagY = psi ^ Y;
 				}
-				{	ColumnBundle psiPrime; matrix UrhoUnused;
+				matrix UrhoPsiDagY = Urho * psiDagY; //shared by all directions
+				for(int iDir=iDirStart; iDir<iDirStop; iDir++)
+				{	vector3<> dirHat; dirHat[iDir] = 1.; //Cartesian unit vector corresponding to iDir
+					ColumnBundle psiPrime; matrix UrhoUnused;
 					sp->rhoAtom_getV(Y, U_rhoAtomPtr, psiPrime, UrhoUnused, &dirHat);
-					ri_psiDagY = minus_i * (psiPrime ^ Y);
+					matrix ri_psiDagY = minus_i * (psiPrime ^ Y);
+					matrix contrib = dagger(ri_psiDagY) * UrhoPsiDagY;
+					result[iDir-iDirStart] += contrib - dagger(contrib);
 				}
-				matrix contrib = dagger(ri_psiDagY) * (Urho * psiDagY);
-				result += contrib - dagger(contrib);
 				U_rhoAtomPtr += sp->rhoAtom_nMatrices();
 			}
 		}
@@ -380,30 +415,35 @@ matrix IonInfo::rHcommutator(const ColumnBundle& Y, int iDir, const matrix& Ydag
 		if(species[sp]->nProjectors())
 		{	const SpeciesInfo& s = *species[sp];
 			const int nAtoms = s.atpos.size();
-			//Get nonlocal psp matrices and projections:
+			//Get nonlocal psp matrices and projections (shared by all directions):
 			matrix Mnl = s.MnlAll;
 			matrix VdagY = (*(s.getV(Y))) ^ Y;
-			matrix ri_VdagY = minus_i * (*(s.getV(Y, &dirHat)) ^ Y);
 			//Ultrasoft augmentation contribution (if any):
 			const matrix id = eye(Mnl.nRows()*nAtoms); //identity
 			matrix Maug = zeroes(id.nRows(), id.nCols());
 			s.augmentDensitySphericalGrad(*Y.qnum, id, Maug);
-			//Apply nonlocal and augmentation corrections to the commutator:
-			matrix contrib = dagger(ri_VdagY) * (tiledBlockMatrix(Mnl, nAtoms)*VdagY + Maug*VdagY);
-			result += contrib - dagger(contrib);
-			//Account for overlap augmentation (if any):
-			if(s.QintAll.nRows())
-			{	const matrix& Q = s.QintAll;
-				std::vector<complex> riArr;
-				for(const vector3<>& x: s.atpos)
-					riArr.push_back(dot(e->gInfo.R.row(iDir), x));
-				matrix contrib =
-					( dagger(VdagY) * (tiledBlockMatrix(Q, nAtoms, &riArr) * VdagY)
-					- dagger(ri_VdagY) * (tiledBlockMatrix(Q, nAtoms) * VdagY) ) * YdagHY;
-				result += contrib - dagger(contrib);
+			matrix MVdagY = tiledBlockMatrix(Mnl, nAtoms)*VdagY + Maug*VdagY;
+			matrix QVdagY; if(s.QintAll.nRows()) QVdagY = tiledBlockMatrix(s.QintAll, nAtoms) * VdagY;
+			for(int iDir=iDirStart; iDir<iDirStop; iDir++)
+			{	vector3<> dirHat; dirHat[iDir] = 1.; //Cartesian unit vector corresponding to iDir
+				matrix ri_VdagY = minus_i * (*(s.getV(Y, &dirHat)) ^ Y);
+				//Apply nonlocal and augmentation corrections to the commutator:
+				matrix contrib = dagger(ri_VdagY) * MVdagY;
+				result[iDir-iDirStart] += contrib - dagger(contrib);
+				//Account for overlap augmentation (if any):
+				if(s.QintAll.nRows())
+				{	const matrix& Q = s.QintAll;
+					std::vector<complex> riArr;
+					for(const vector3<>& x: s.atpos)
+						riArr.push_back(dot(e->gInfo.R.row(iDir), x));
+					matrix contrib =
+						( dagger(VdagY) * (tiledBlockMatrix(Q, nAtoms, &riArr) * VdagY)
+						- dagger(ri_VdagY) * QVdagY ) * YdagHY;
+					result[iDir-iDirStart] += contrib - dagger(contrib);
+				}
 			}
 		}
-	return result;
+	watch.stop();
 }
 
 int IonInfo::nAtomicOrbitals() const
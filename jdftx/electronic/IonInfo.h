@@ -23,6 +23,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <electronic/SpeciesInfo.h>
 #include <electronic/IonicMinimizer.h>
+#include <electronic/ProjectorCache.h>
 #include <core/matrix.h>
 #include <core/ScalarField.h>
 #include <core/Thread.h>
@@ -55,6 +56,8 @@ public:
 	CoordsType coordsType; //!< coordinate system for ionic positions etc.
 	ForcesOutputCoords forcesOutputCoords; //!< coordinate system to print forces in
 	coreOverlapCheck coreOverlapCondition; //! Check method used for determining whether pseudopotential cores overlap
+	IonicPreconditioner ionicPreconditioner; //!< preconditioner for ionic (and the ionic part of lattice) minimization
+	string ionicHistoryFilename; //!< L-BFGS history of a previous ionic minimization to resume from (set by initial-state if available)
 	bool vdWenable; //!< whether vdW pair-potential corrections are enabled
 	double vdWscale; //!< If non-zero, override the default scale parameter
 	
@@ -91,6 +94,8 @@ public:
 	void augmentDensityInit() const; //!< initialize density augmentation
 	void augmentDensitySpherical(const QuantumNumber& qnum, const diagMatrix& Fq, const std::vector<matrix>& VdagCq) const; //!< calculate density augmentation in spherical functions
 	void augmentDensityGrid(ScalarFieldArray& n) const; //!< propagate from spherical functions to grid
+	void augmentDensityReduce(bool async=false) const; //!< collect spherical functions over processes (optionally non-blocking per spin channel)
+	void augmentDensityGrid(ScalarFieldArray& n, int s) const; //!< propagate spin channel s from spherical functions to grid (after augmentDensityReduce)
 	void augmentDensityGridGrad(const ScalarFieldArray& E_n, IonicGradient* forces=0) const; //!< propagate grid gradients to spherical functions
 	void augmentDensitySphericalGrad(const QuantumNumber& qnum, const std::vector<matrix>& VdagCq, std::vector<matrix>& HVdagCq) const; //!< propagate spherical function gradients to wavefunctions
 	
@@ -107,6 +112,8 @@ public:
 	void rhoAtom_forces(const std::vector<diagMatrix>& F, const std::vector<ColumnBundle>& C, const std::vector<matrix>& U_rhoAtom, IonicGradient& forces) const; //!< propagate U_rhoAtom to forces
 	
 	matrix rHcommutator(const ColumnBundle &Y, int iDir, const matrix& YdagHY) const; //!< Expectation value of [r_iDir,H] = D_iDir + nonlocal corrections
+	vector3<matrix> rHcommutator(const ColumnBundle &Y, const matrix& YdagHY) const; //!< Expectation values of [r,H] for all Cartesian directions together (sharing the projections)
+	void rHcommutator(const ColumnBundle &Y, const matrix& YdagHY, int iDirStart, int iDirStop, matrix* result) const; //!< Set result[iDir-iDirStart] = [r_iDir,H] for iDirStart <= iDir < iDirStop
 	
 	int nAtomicOrbitals() const; //!< Get total number of atomic orbitals
 	ColumnBundle getAtomicOrbitals(int q, bool applyO, int extraCols=0) const; //!< Get all atomic orbitals of a given state number q, optionally with operator O pre-applied (with room for extra columns if specified)
@@ -120,10 +127,16 @@ public:
 	ionWidthMethod; //!< method for determining ion charge width
 	double ionWidth; //!< width for gaussian representation of nuclei
 	bool shouldPrintForceComponents;
+	
+	mutable ProjectorCache projectorCache; //!< nonlocal projectors of all species (see SpeciesInfo::getV)
 
 private:
 	const Everything* e;
 	
+	//Sums of species contributions in update(), retained to update them incrementally when only a few atoms move:
+	ScalarFieldTilde VlocpsSpecies, rhoIonSpecies, nCoreSpecies, tauCoreSpecies; //!< before long-range corrections and smoothing
+	matrix3<> Rspecies; //!< lattice vectors at which the above were computed
+	
 	//! Compute all pair-potential terms in the energy or forces (electrostatic, and optionally vdW)
 	void pairPotentialsAndGrad(class Energies* ener=0, IonicGradient* forces=0) const;
 };
@@ -24,6 +24,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/ElecMinimizer.h>
 #include <electronic/ColumnBundle.h>
 #include <electronic/Dump.h>
+#include <fluid/FluidSolver.h>
 #include <core/Random.h>
 #include <core/BlasExtra.h>
 
@@ -172,104 +173,216 @@ void IonicMinimizer::step(const IonicGradient& dir, double alpha)
 {	static StopWatch watch("WavefunctionDrag"); watch.start();
 	ElecVars& eVars = e.eVars;
 	ElecInfo& eInfo = e.eInfo;
-	IonInfo& iInfo = e.iInfo;
+	
+	IonicGradient dpos = alpha * e.gInfo.invR * dir; //dir is in cartesian, atpos in lattice
+	
+	//Predict wavefunctions from previous ionic steps if possible (leaving the unexplained displacement in dpos):
+	if(alpha && e.cntrl.dragHistory && int(Chistory.size())>=2)
+	{	if(populationAnalysisPending) dragWavefunctions(dpos, false); //analyze the converged wavefunctions before replacing them
+		extrapolateWavefunctions(dpos);
+	}
 	
 	//Check step size to determine whether to allow wavefunction dragging:
 	double dMax = 0.;
-	for(const auto& spArr: dir)
+	for(const auto& spArr: dpos)
 		for(const vector3<>& d: spArr)
-			dMax = std::max(dMax, d.length());
-	if(alpha*dMax > maxWfnsDragDisplacement)
+			dMax = std::max(dMax, (e.gInfo.R * d).length());
+	if(dMax > maxWfnsDragDisplacement)
 		skipWfnsDrag = true;
 	
-	IonicGradient dpos = alpha * e.gInfo.invR * dir; //dir is in cartesian, atpos in lattice
-	
 	if(e.cntrl.dragWavefunctions || populationAnalysisPending)
-	{	//Check if atomic orbitals available and compile list of displacements for each orbital:
-		std::vector< vector3<> > drColumns;
-		std::vector<int> spOffset(iInfo.species.size()+1, 0); //species offsets into atomic orbitals
-		for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
-		{	const SpeciesInfo& sp = *(iInfo.species[iSp]);
-			int spOrbCount = sp.nAtomicOrbitals(); //total number of orbitals for current species
-			spOffset[iSp+1] = spOffset[iSp] + spOrbCount;
-			int nOrb = (spOrbCount / sp.atpos.size()) * eInfo.spinorLength(); //number of dr entries (orbitals * nSpinor) per atom
-			for(const vector3<>& dr: dpos[iSp])
-				drColumns.insert(drColumns.end(), nOrb, dr);
-		}
+		dragWavefunctions(dpos, alpha && e.cntrl.dragWavefunctions && (!skipWfnsDrag));
+	if(!alpha) //case when step was invoked purely for population analysis
+	{	watch.stop(); return; 
+	}
+	
+	//Move the atoms:
+	moveAtoms(dpos);
+	
+	//Orthonormalize wavefunctions: (must do this after updating atom positions, since O depends on atpos for ultrasoft)
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		eVars.orthonormalize(q);
+	
+	//Predict fluid state at new positions:
+	if(eVars.fluidSolver) eVars.fluidSolver->extrapolateState();
+	
+	watch.stop();
+}
+
+void IonicMinimizer::dragWavefunctions(const IonicGradient& dpos, bool drag)
+{	ElecVars& eVars = e.eVars;
+	ElecInfo& eInfo = e.eInfo;
+	IonInfo& iInfo = e.iInfo;
+	
+	//Check if atomic orbitals available and compile list of displacements for each orbital:
+	std::vector< vector3<> > drColumns;
+	std::vector<int> spOffset(iInfo.species.size()+1, 0); //species offsets into atomic orbitals
+	for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
+	{	const SpeciesInfo& sp = *(iInfo.species[iSp]);
+		int spOrbCount = sp.nAtomicOrbitals(); //total number of orbitals for current species
+		spOffset[iSp+1] = spOffset[iSp] + spOrbCount;
+		int nOrb = (spOrbCount / sp.atpos.size()) * eInfo.spinorLength(); //number of dr entries (orbitals * nSpinor) per atom
+		for(const vector3<>& dr: dpos[iSp])
+			drColumns.insert(drColumns.end(), nOrb, dr);
+	}
+	
+	if(drColumns.size()) 
+	{	int nSpins = eInfo.nSpins();
+		std::vector<matrix> Rho(nSpins); //density matrix in the basis of Lowdin symmetrized orbitals
 		
-		if(drColumns.size()) 
-		{	int nSpins = eInfo.nSpins();
-			std::vector<matrix> Rho(nSpins); //density matrix in the basis of Lowdin symmetrized orbitals
+		for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		{
+			//Get atomic orbitals at old positions:
+			ColumnBundle psi = iInfo.getAtomicOrbitals(q, false);
 			
-			for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-			{
-				//Get atomic orbitals at old positions:
-				ColumnBundle psi = iInfo.getAtomicOrbitals(q, false);
-				
-				//Compute atomic orbital projections:
-				matrix psiDagOpsi, psiDagOC;
-				{	ColumnBundle Opsi = O(psi); //non-trivial cost for uspp
-					psiDagOpsi = psi^Opsi;
-					psiDagOC = Opsi^eVars.C[q];
-				}
-				
-				if(populationAnalysisPending)
-				{	matrix lowdin = invsqrt(psiDagOpsi) * psiDagOC; //Lowdin coefficients (note symmetric orthonormalization)
-					Rho[eInfo.qnums[q].index()] += eInfo.qnums[q].weight * (lowdin * eVars.F[q] * dagger(lowdin)); //density matrix contribution
-				}
-				
-				if(alpha && e.cntrl.dragWavefunctions && (!skipWfnsDrag)) //needed only if actually dragging wavefunctions
-				{	matrix coeff = inv(psiDagOpsi) * psiDagOC;  //LCAO coefficients for best fit (minimize C0^OC0 where C0 is the remainder)
-					eVars.C[q] -= psi * coeff; //now contains the residual C0 mentioned above
-				
-					//Translate the atomic orbitals and reconsitute wavefunctions:
-					translateColumns(psi, drColumns.data());
-					eVars.C[q] += psi * coeff;
-				}
+			//Compute atomic orbital projections:
+			matrix psiDagOpsi, psiDagOC;
+			{	ColumnBundle Opsi = O(psi); //non-trivial cost for uspp
+				psiDagOpsi = psi^Opsi;
+				psiDagOC = Opsi^eVars.C[q];
 			}
 			
-			//Call population analysis:
 			if(populationAnalysisPending)
-			{	logPrintf("\n#--- Lowdin population analysis ---\n");
-				for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
-				{	const SpeciesInfo& sp = *(iInfo.species[iSp]);
-					if(sp.nAtomicOrbitals())
-					{	std::vector<matrix> RhoSub(Rho.size());
-						for(unsigned s=0; s<Rho.size(); s++)
-						{	RhoSub[s] = Rho[s]
-								? matrix(Rho[s](spOffset[iSp],spOffset[iSp+1], spOffset[iSp],spOffset[iSp+1]))
-								: zeroes(spOffset[iSp+1]-spOffset[iSp], spOffset[iSp+1]-spOffset[iSp]);
-							mpiWorld->allReduceData(RhoSub[s], MPIUtil::ReduceSum);
-						}
-						sp.populationAnalysis(RhoSub);
+			{	matrix lowdin = invsqrt(psiDagOpsi) * psiDagOC; //Lowdin coefficients (note symmetric orthonormalization)
+				Rho[eInfo.qnums[q].index()] += eInfo.qnums[q].weight * (lowdin * eVars.F[q] * dagger(lowdin)); //density matrix contribution
+			}
+			
+			if(drag) //needed only if actually dragging wavefunctions
+			{	matrix coeff = inv(psiDagOpsi) * psiDagOC;  //LCAO coefficients for best fit (minimize C0^OC0 where C0 is the remainder)
+				eVars.C[q] -= psi * coeff; //now contains the residual C0 mentioned above
+			
+				//Translate the atomic orbitals and reconsitute wavefunctions:
+				translateColumns(psi, drColumns.data());
+				eVars.C[q] += psi * coeff;
+			}
+		}
+		
+		//Call population analysis:
+		if(populationAnalysisPending)
+		{	logPrintf("\n#--- Lowdin population analysis ---\n");
+			for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
+			{	const SpeciesInfo& sp = *(iInfo.species[iSp]);
+				if(sp.nAtomicOrbitals())
+				{	std::vector<matrix> RhoSub(Rho.size());
+					for(unsigned s=0; s<Rho.size(); s++)
+					{	RhoSub[s] = Rho[s]
+							? matrix(Rho[s](spOffset[iSp],spOffset[iSp+1], spOffset[iSp],spOffset[iSp+1]))
+							: zeroes(spOffset[iSp+1]-spOffset[iSp], spOffset[iSp+1]-spOffset[iSp]);
+						mpiWorld->allReduceData(RhoSub[s], MPIUtil::ReduceSum);
 					}
-					else logPrintf("# species %s skipped because pseudopotential does not contain atomic orbitals\n", sp.name.c_str());
+					sp.populationAnalysis(RhoSub);
 				}
-				logPrintf("\n");
+				else logPrintf("# species %s skipped because pseudopotential does not contain atomic orbitals\n", sp.name.c_str());
 			}
+			logPrintf("\n");
 		}
-		populationAnalysisPending = false;
-	}
-	if(!alpha) //case when step was invoked purely for population analysis
-	{	watch.stop(); return; 
 	}
-	
-	//Move the atoms:
-	for(unsigned sp=0; sp < iInfo.species.size(); sp++)
-	{	SpeciesInfo& spInfo = *(iInfo.species[sp]);
+	populationAnalysisPending = false;
+}
+
+void IonicMinimizer::moveAtoms(const IonicGradient& dpos)
+{	for(unsigned sp=0; sp < e.iInfo.species.size(); sp++)
+	{	SpeciesInfo& spInfo = *(e.iInfo.species[sp]);
 		for(unsigned atom=0; atom<spInfo.atpos.size(); atom++)
 			spInfo.atpos[atom] += dpos[sp][atom]; 
 		mpiWorld->bcastData(spInfo.atpos);
 		spInfo.sync_atpos();
 	}
-	
-	//Orthonormalize wavefunctions: (must do this after updating atom positions, since O depends on atpos for ultrasoft)
+}
+
+void IonicMinimizer::saveWavefunctions()
+{	int nHistory = e.cntrl.dragHistory;
+	if(nHistory < 2) return; //extrapolation disabled
+	static StopWatch watch("IonicMinimizer::saveWavefunctions"); watch.start();
+	const ElecInfo& eInfo = e.eInfo;
+	const std::vector<ColumnBundle>& C = e.eVars.C;
+	//Reset history if lattice vectors or band count changed:
+	if(Chistory.size() && (!(Rhistory == e.gInfo.R) || Chistory.front()[eInfo.qStart].nCols() != C[eInfo.qStart].nCols()))
+	{	Chistory.clear();
+		xHistory.clear();
+	}
+	Rhistory = e.gInfo.R;
+	//Rotate previous steps' wavefunctions within their subspace to best match the current ones:
 	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
-		eVars.orthonormalize(q);
-	
+	{	ColumnBundle OC = O(C[q]);
+		for(std::vector<ColumnBundle>& Cprev: Chistory)
+		{	matrix M = Cprev[q] ^ OC;
+			Cprev[q] = Cprev[q] * (M * invsqrt(dagger(M) * M)); //unitary part of M
+		}
+	}
+	//Add current wavefunctions and positions, discarding the oldest beyond those needed:
+	Chistory.push_front(std::vector<ColumnBundle>(eInfo.nStates));
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		Chistory.front()[q] = C[q];
+	xHistory.push_front(std::vector<vector3<>>());
+	for(const auto& sp: e.iInfo.species)
+		for(const vector3<>& x: sp->atpos)
+			xHistory.front().push_back(e.gInfo.R * x);
+	if(int(Chistory.size()) > nHistory)
+	{	Chistory.pop_back();
+		xHistory.pop_back();
+	}
 	watch.stop();
 }
 
+bool IonicMinimizer::extrapolateWavefunctions(IonicGradient& dpos)
+{	if(Chistory.size() < 2) return false;
+	//Compute displacement from newest history position, and differences between history positions:
+	const GridInfo& gInfo = e.gInfo;
+	bool second = (Chistory.size() >= 3); //whether second-order extrapolation is possible
+	const std::vector<vector3<>>& x0 = xHistory[0];
+	const std::vector<vector3<>>& x1 = xHistory[1];
+	double dDota=0., dDotb=0., aDota=0., aDotb=0., bDotb=0.;
+	std::vector<vector3<>> xCur; //current cartesian positions
+	size_t iAtom = 0;
+	for(unsigned sp=0; sp<e.iInfo.species.size(); sp++)
+		for(unsigned atom=0; atom<dpos[sp].size(); atom++)
+		{	const vector3<> x = gInfo.R * e.iInfo.species[sp]->atpos[atom];
+			vector3<> d = x + gInfo.R * dpos[sp][atom] - x0[iAtom];
+			vector3<> a = x0[iAtom] - x1[iAtom];
+			dDota += dot(d, a);
+			aDota += dot(a, a);
+			if(second)
+			{	vector3<> b = x1[iAtom] - xHistory[2][iAtom];
+				dDotb += dot(d, b);
+				aDotb += dot(a, b);
+				bDotb += dot(b, b);
+			}
+			xCur.push_back(x);
+			iAtom++;
+		}
+	if(!aDota) return false; //no displacement in history to extrapolate from
+	//Least-squares fit d ~ alpha a + beta b:
+	double alpha = dDota/aDota, beta = 0.;
+	double det = aDota*bDotb - aDotb*aDotb;
+	if(second && det > 1e-6*aDota*bDotb) //not collinear
+	{	alpha = (dDota*bDotb - dDotb*aDotb) / det;
+		beta = (aDota*dDotb - aDotb*dDota) / det;
+	}
+	//Extrapolate wavefunctions with the same coefficients:
+	ElecVars& eVars = e.eVars;
+	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+	{	eVars.C[q] = Chistory[0][q] * (1.+alpha);
+		eVars.C[q] -= Chistory[1][q] * (alpha-beta);
+		if(beta) eVars.C[q] -= Chistory[2][q] * beta;
+	}
+	//Move atoms to the fit positions, leaving the residual displacement in dpos:
+	IonicGradient dposFit; dposFit.init(e.iInfo);
+	iAtom = 0;
+	for(unsigned sp=0; sp<dposFit.size(); sp++)
+		for(unsigned atom=0; atom<dposFit[sp].size(); atom++)
+		{	vector3<> a = x0[iAtom] - x1[iAtom];
+			vector3<> xFit = x0[iAtom] + alpha*a;
+			if(beta) xFit += beta*(x1[iAtom] - xHistory[2][iAtom]);
+			dposFit[sp][atom] = gInfo.invR * (xFit - xCur[iAtom]);
+			iAtom++;
+		}
+	moveAtoms(dposFit);
+	axpy(-1., dposFit, dpos);
+	logPrintf("Extrapolated wavefunctions from %d previous ionic steps (alpha = %lg, beta = %lg).\n", second ? 3 : 2, alpha, beta);
+	return true;
+}
+
 double IonicMinimizer::compute(IonicGradient* grad, IonicGradient* Kgrad)
 {
 	if(not e.iInfo.checkPositions())
@@ -282,6 +395,7 @@ double IonicMinimizer::compute(IonicGradient* grad, IonicGradient* Kgrad)
 
 	//Minimize the electronic system:
 	elecFluidMinimize(e);
+	saveWavefunctions(); //for extrapolation at subsequent steps (if enabled)
 	
 	//Calculate forces if needed:
 	if(grad)
@@ -291,6 +405,11 @@ double IonicMinimizer::compute(IonicGradient* grad, IonicGradient* Kgrad)
 		//Preconditioned gradient:
 		if(Kgrad)
 		{	*Kgrad = *grad;
+			if(e.iInfo.ionicPreconditioner != IonicPrecondNone)
+			{	updatePreconditioner();
+				constrain(*Kgrad);
+				applyPreconditioner(*Kgrad);
+			}
 			//Apply scale factors:
 			for(unsigned sp=0; sp<Kgrad->size(); sp++)
 			{	const SpeciesInfo& spInfo = *(e.iInfo.species[sp]);
@@ -305,6 +424,52 @@ double IonicMinimizer::compute(IonicGradient* grad, IonicGradient* Kgrad)
 	return relevantFreeEnergy(e);
 }
 
+void IonicMinimizer::saveHistory(const std::vector<const IonicGradient*>& vectors, const std::vector<double>& scalars)
+{	if(!(e.dump.count(std::make_pair(DumpFreq_Ionic,DumpState)) || e.dump.count(std::make_pair(DumpFreq_End,DumpState))))
+		return;
+	if(!mpiWorld->isHead()) return; //identical on all processes
+	//Write to a temporary file and rename, so that an interrupted write never replaces the previous history:
+	string fname = e.dump.getFilename("ionicHistory");
+	string fnameTmp = fname + ".tmp";
+	FILE* fp = fopen(fnameTmp.c_str(), "wb");
+	if(!fp) { logPrintf("WARNING: could not open '%s' for writing.\n", fnameTmp.c_str()); return; }
+	uint64_t nScalars = scalars.size();
+	bool success = (fwriteLE(&nScalars, sizeof(uint64_t), 1, fp) == 1);
+	success = success && (fwriteLE(scalars.data(), sizeof(double), nScalars, fp) == nScalars);
+	for(const IonicGradient* v: vectors)
+		for(const auto& vSp: *v)
+			success = success && (fwriteLE(vSp.data(), sizeof(double), 3*vSp.size(), fp) == 3*vSp.size());
+	if(fclose(fp)) success = false;
+	if(!success || rename(fnameTmp.c_str(), fname.c_str()))
+		logPrintf("WARNING: could not write ionic minimizer history to '%s'.\n", fname.c_str());
+}
+
+bool IonicMinimizer::loadHistory(std::vector<IonicGradient>& vectors, std::vector<double>& scalars)
+{	string& fname = e.iInfo.ionicHistoryFilename;
+	if(!fname.length()) return false;
+	logPrintf("Reading ionic minimizer history from '%s' ... ", fname.c_str()); logFlush();
+	bool success = false;
+	FILE* fp = fopen(fname.c_str(), "rb");
+	if(fp)
+	{	uint64_t nScalars = 0;
+		if(freadLE(&nScalars, sizeof(uint64_t), 1, fp)==1 && nScalars>0 && nScalars<(1u<<20))
+		{	scalars.resize(nScalars);
+			success = (freadLE(scalars.data(), sizeof(double), nScalars, fp) == nScalars);
+			vectors.resize(2*(nScalars-1));
+			for(IonicGradient& v: vectors)
+			{	v.init(e.iInfo);
+				for(auto& vSp: v)
+					success = success && (freadLE(vSp.data(), sizeof(double), 3*vSp.size(), fp) == 3*vSp.size());
+			}
+			success = success && (fgetc(fp) == EOF); //guard against a history of a different system
+		}
+		fclose(fp);
+	}
+	fname.clear(); //only resume the first minimization (eg. not each lattice step)
+	logPrintf(success ? "done.\n" : "failed (not compatible with current system); starting without history.\n");
+	return success;
+}
+
 bool IonicMinimizer::report(int iter)
 {	logPrintf("\n"); e.iInfo.printPositions(globalLog);
 	logPrintf("\n"); e.iInfo.forces.print(e, globalLog);
@@ -359,6 +524,112 @@ void IonicMinimizer::constrain(IonicGradient& x)
 	#undef SymmetrizeCartesian
 }
 
+void IonicMinimizer::updatePreconditioner()
+{	static StopWatch watch("IonicMinimizer::precondition"); watch.start();
+	const IonInfo& iInfo = e.iInfo;
+	const matrix3<>& R = e.gInfo.R;
+	//Flatten atoms:
+	std::vector<vector3<>> pos; std::vector<int> row; //lattice coordinates and periodic table row (0-based, upto 2)
+	for(const auto& sp: iInfo.species)
+		for(const vector3<>& x: sp->atpos)
+		{	pos.push_back(x);
+			int Z = sp->atomicNumber;
+			row.push_back((Z>0 && Z<=2) ? 0 : ((Z>0 && Z<=10) ? 1 : 2));
+		}
+	int nAtoms = pos.size();
+	//Loop over pairs of distinct atoms (including periodic images) within rCut:
+	auto forEachPair = [&](double rCut, std::function<void(int,int,const vector3<>&)> f)
+	{	vector3<int> nImages;
+		for(int k=0; k<3; k++)
+			nImages[k] = int(ceil(rCut * e.gInfo.invR.row(k).length())); //rCut / (spacing of lattice planes)
+		vector3<int> iImage;
+		for(int i=0; i<nAtoms; i++)
+			for(int j=0; j<nAtoms; j++)
+			{	vector3<> x0 = pos[j] - pos[i];
+				for(int k=0; k<3; k++) x0[k] -= floor(0.5 + x0[k]);
+				for(iImage[0]=-nImages[0]; iImage[0]<=nImages[0]; iImage[0]++)
+				for(iImage[1]=-nImages[1]; iImage[1]<=nImages[1]; iImage[1]++)
+				for(iImage[2]=-nImages[2]; iImage[2]<=nImages[2]; iImage[2]++)
+				{	vector3<> r = R * (x0 + iImage);
+					double rSq = r.length_squared();
+					if((i!=j || iImage.length_squared()) && rSq < rCut*rCut)
+						f(i, j, r);
+				}
+			}
+	};
+	const double cStab = 0.1; //stabilization as a fraction of the average diagonal entry
+	switch(iInfo.ionicPreconditioner)
+	{	case IonicPrecondExp:
+		{	double rNN = DBL_MAX; //nearest-neighbour distance
+			double rNNmax = 0.; for(int k=0; k<3; k++) rNNmax = std::max(rNNmax, R.column(k).length());
+			forEachPair(rNNmax, [&](int i, int j, const vector3<>& r) { rNN = std::min(rNN, r.length()); });
+			const double A = 3.; //exponential decay rate with distance in units of rNN
+			Pions = zeroes(nAtoms, nAtoms);
+			if(rNN < DBL_MAX)
+				forEachPair(2.*rNN, [&](int i, int j, const vector3<>& r)
+				{	double w = exp(-A*(r.length()/rNN - 1.));
+					Pions.data()[Pions.index(i,i)] += w;
+					Pions.data()[Pions.index(i,j)] -= w;
+				});
+			break;
+		}
+		case IonicPrecondFF:
+		{	//Stretch force constants k rho(r) with rho = exp(alpha (rRef^2 - r^2)) for each pair of rows:
+			const double k = 0.45;
+			const double alpha[3][3] = {{1.0000, 0.3949, 0.3949}, {0.3949, 0.2800, 0.2800}, {0.3949, 0.2800, 0.2800}};
+			const double rRef[3][3] = {{1.35, 2.10, 2.53}, {2.10, 2.87, 3.40}, {2.53, 3.40, 3.40}};
+			const double rhoMin = 1e-4; //neglect weaker contributions
+			double rCut = 0.;
+			for(int r1=0; r1<3; r1++)
+				for(int r2=0; r2<3; r2++)
+					rCut = std::max(rCut, sqrt(rRef[r1][r2]*rRef[r1][r2] - log(rhoMin)/alpha[r1][r2]));
+			Pions = zeroes(3*nAtoms, 3*nAtoms);
+			forEachPair(rCut, [&](int i, int j, const vector3<>& r)
+			{	int r1 = row[i], r2 = row[j];
+				double rho = exp(alpha[r1][r2]*(rRef[r1][r2]*rRef[r1][r2] - r.length_squared()));
+				if(rho < rhoMin) return;
+				vector3<> u = r * (1./r.length()); //bond direction
+				for(int a=0; a<3; a++)
+					for(int b=0; b<3; b++)
+					{	double H = k * rho * u[a] * u[b];
+						Pions.data()[Pions.index(3*i+a,3*i+b)] += H;
+						Pions.data()[Pions.index(3*i+a,3*j+b)] -= H;
+					}
+			});
+			break;
+		}
+		case IonicPrecondNone: assert(false); //should not get here
+	}
+	//Normalize to unit diagonal on average (so that step sizes are comparable to the unpreconditioned case) and stabilize:
+	double diagMean = trace(Pions).real() / Pions.nRows();
+	if(diagMean <= 0.) diagMean = 1.; //no neighbours: reduces to identity
+	Pions *= 1./((1.+cStab)*diagMean);
+	for(int i=0; i<Pions.nRows(); i++)
+		Pions.data()[Pions.index(i,i)] += cStab/(1.+cStab);
+	watch.stop();
+}
+
+void IonicMinimizer::applyPreconditioner(IonicGradient& x) const
+{	int nAtoms = 0; for(const auto& x_sp: x) nAtoms += x_sp.size();
+	bool isotropic = (Pions.nRows() == nAtoms); //same nAtoms square preconditioner for each direction
+	matrix xMat = isotropic ? zeroes(nAtoms, 3) : zeroes(3*nAtoms, 1);
+	int iAtom = 0;
+	for(const auto& x_sp: x)
+		for(const vector3<>& x_sp_at: x_sp)
+		{	for(int k=0; k<3; k++)
+				xMat.data()[isotropic ? xMat.index(iAtom,k) : 3*iAtom+k] = x_sp_at[k];
+			iAtom++;
+		}
+	xMat = invApply(Pions, xMat);
+	iAtom = 0;
+	for(auto& x_sp: x)
+		for(vector3<>& x_sp_at: x_sp)
+		{	for(int k=0; k<3; k++)
+				x_sp_at[k] = xMat.data()[isotropic ? xMat.index(iAtom,k) : 3*iAtom+k].real();
+			iAtom++;
+		}
+}
+
 double IonicMinimizer::safeStepSize(const IonicGradient& dir) const
 {	//Determine mx displacement in dir:
 	double dMax = 0.;
@@ -378,3 +649,80 @@ double IonicMinimizer::minimize(const MinimizeParams& params)
 	step(e.iInfo.forces, 0.); //so that population analysis may be performed at final positions
 	return result;
 }
+
+void IonicMinimizer::serve(const string& inName, const string& outName)
+{	IonInfo& iInfo = e.iInfo;
+	logPrintf("\n---------- Serving energy and force requests from '%s' to '%s' ----------\n", inName.c_str(), outName.c_str());
+	for(int iRequest=0; ; iRequest++)
+	{	//Read request on head:
+		std::vector<int> order; //species and atom index of each position, in order of request
+		std::vector<double> pos; //cartesian positions in that order
+		bool quit = false;
+		if(mpiWorld->isHead())
+		{	FILE* fp = fopen(inName.c_str(), "r");
+			if(!fp) die("Error opening server input '%s' for reading.\n", inName.c_str());
+			std::vector<unsigned> nAtomsRead(iInfo.species.size(), 0);
+			char lineBuf[1024];
+			while(fgets(lineBuf, sizeof(lineBuf), fp))
+			{	istringstream iss(lineBuf);
+				string key; iss >> key;
+				if(!key.length() || key[0]=='#') continue;
+				if(key == "quit") { quit = true; break; }
+				if(key != "ion") die("Unrecognized line '%s' in server request %d.\n", lineBuf, iRequest);
+				string spName; vector3<> x;
+				iss >> spName >> x[0] >> x[1] >> x[2];
+				if(iss.fail()) die("Malformed line '%s' in server request %d.\n", lineBuf, iRequest);
+				unsigned iSp = 0;
+				while(iSp<iInfo.species.size() && iInfo.species[iSp]->name!=spName) iSp++;
+				if(iSp==iInfo.species.size()) die("Unknown species '%s' in server request %d.\n", spName.c_str(), iRequest);
+				if(nAtomsRead[iSp] == iInfo.species[iSp]->atpos.size()) die("Too many atoms of species '%s' in server request %d.\n", spName.c_str(), iRequest);
+				order.push_back(iSp);
+				order.push_back(nAtomsRead[iSp]++);
+				for(int k=0; k<3; k++) pos.push_back(x[k]);
+			}
+			fclose(fp);
+			if(!quit)
+				for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
+					if(nAtomsRead[iSp] != iInfo.species[iSp]->atpos.size())
+						die("Server request %d specifies %u instead of %lu atoms of species '%s'.\n", iRequest,
+							nAtomsRead[iSp], iInfo.species[iSp]->atpos.size(), iInfo.species[iSp]->name.c_str());
+		}
+		mpiWorld->bcast(quit);
+		if(quit) break;
+		mpiWorld->bcastData(order);
+		mpiWorld->bcastData(pos);
+		logPrintf("\n---------- Server request %d ----------\n", iRequest); logFlush();
+		
+		//Move to requested positions (using nearest periodic image of each displacement):
+		IonicGradient dir; dir.init(iInfo);
+		for(unsigned i=0; i<order.size()/2; i++)
+		{	int iSp = order[2*i], atom = order[2*i+1];
+			vector3<> dLat = e.gInfo.invR * vector3<>(pos[3*i], pos[3*i+1], pos[3*i+2]) - iInfo.species[iSp]->atpos[atom];
+			for(int k=0; k<3; k++) dLat[k] -= floor(0.5 + dLat[k]);
+			dir[iSp][atom] = e.gInfo.R * dLat;
+		}
+		step(dir, 1.);
+		
+		//Compute energy and forces:
+		IonicGradient grad;
+		double E = compute(&grad, 0);
+		if(std::isnan(E)) grad.init(iInfo);
+		report(iRequest);
+		populationAnalysisPending = false;
+		
+		//Write response on head (in order of request):
+		if(mpiWorld->isHead())
+		{	FILE* fp = fopen(outName.c_str(), "w");
+			if(!fp) die("Error opening server output '%s' for writing.\n", outName.c_str());
+			fprintf(fp, "energy %.15lf\n", E);
+			for(unsigned i=0; i<order.size()/2; i++)
+			{	int iSp = order[2*i], atom = order[2*i+1];
+				const vector3<>& g = grad[iSp][atom];
+				fprintf(fp, "force %s %.15lf %.15lf %.15lf\n", iInfo.species[iSp]->name.c_str(), -g[0], -g[1], -g[2]);
+			}
+			fprintf(fp, "end\n");
+			fclose(fp);
+		}
+	}
+	logPrintf("\nServer quit requested.\n"); logFlush();
+}
@@ -23,6 +23,9 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/RadialFunction.h>
 #include <core/Minimize.h>
 #include <core/matrix3.h>
+#include <core/matrix.h>
+#include <electronic/ColumnBundle.h>
+#include <deque>
 
 //! @addtogroup IonicSystem
 //! @{
@@ -51,6 +54,13 @@ void randomize(IonicGradient& x); //!< initialize with random numbers
 
 IonicGradient operator*(const matrix3<>&, const IonicGradient&); //!< coordinate transformations
 
+//! Preconditioner for ionic minimization (see command ionic-preconditioner)
+enum IonicPreconditioner
+{	IonicPrecondNone, //!< identity metric in cartesian coordinates (apart from constraint scale factors)
+	IonicPrecondExp, //!< exponential connectivity Laplacian in the neighbor distances \cite ExpPreconditioner
+	IonicPrecondFF //!< bond-stretch force-field Hessian estimate with distance-dependent force constants \cite LindhHessian
+};
+
 //! Ionic minimizer
 class IonicMinimizer : public Minimizable<IonicGradient>
 {	Everything& e;
@@ -66,12 +76,33 @@ public:
 	static const double maxWfnsDragDisplacement; //!< maximum atom displacement for which wavefunction drag is allowed
 	double safeStepSize(const IonicGradient& dir) const; //!< enforces IonicMinimizer::maxAtomTestDisplacement on test step size
 	double sync(double x) const; //!< All processes minimize together; make sure scalars are in sync to round-off error
+	void saveHistory(const std::vector<const IonicGradient*>& vectors, const std::vector<double>& scalars); //!< write L-BFGS history to dump file ionicHistory (when dumping State)
+	bool loadHistory(std::vector<IonicGradient>& vectors, std::vector<double>& scalars); //!< read L-BFGS history from IonInfo::ionicHistoryFilename (once)
 	
 	double minimize(const MinimizeParams& params); //!< minor addition to Minimizable::minimize to invoke charge analysis at final positions
+	
+	//! Repeatedly read atom positions from inName, and write the energy and forces at those positions to outName,
+	//! until a request contains 'quit'. Each request is read until end of file, so both may be named pipes.
+	//! Setup, FFT plans and caches persist between requests, wavefunctions are dragged to the new positions
+	//! when possible, and subsequent electronic minimizations start from the previous converged state.
+	void serve(const string& inName, const string& outName);
 private:
 	bool populationAnalysisPending; //!< report() has requested a charge analysis output that is yet to be done
 	bool skipWfnsDrag; //!< whether to temprarily skip wavefunction dragging due to large steps
 	bool anyConstrained; //!< whether any atoms are constrained
+	matrix Pions; //!< preconditioner Hessian estimate at the current positions: nAtoms square (same for each cartesian direction) or 3 nAtoms square
+	void updatePreconditioner(); //!< compute Pions at the current atomic positions, if a preconditioner is enabled
+	void applyPreconditioner(IonicGradient& x) const; //!< replace x by inv(Pions) * x
+	
+	void dragWavefunctions(const IonicGradient& dpos, bool drag); //!< perform pending population analysis and (if drag) translate atomic-orbital components of wavefunctions by dpos (lattice coordinates)
+	void moveAtoms(const IonicGradient& dpos); //!< displace atoms by dpos (lattice coordinates)
+	
+	//Wavefunction extrapolation (see command wavefunction-drag):
+	std::deque<std::vector<ColumnBundle>> Chistory; //!< converged wavefunctions at previous positions (newest first), each rotated to best match the newest
+	std::deque<std::vector<vector3<>>> xHistory; //!< corresponding (flattened) cartesian atomic positions
+	matrix3<> Rhistory; //!< lattice vectors for the history (reset if changed)
+	void saveWavefunctions(); //!< add the current converged wavefunctions to Chistory (if extrapolation is enabled)
+	bool extrapolateWavefunctions(IonicGradient& dpos); //!< predict wavefunctions for displacement dpos from history; moves atoms to the fit positions and leaves the residual displacement in dpos
 };
 
 //! @}
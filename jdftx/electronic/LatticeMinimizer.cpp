@@ -116,7 +116,7 @@ LatticeMinimizer::LatticeMinimizer(Everything& e)
 		logPrintf("\n");
 	}
 
-	h = 1e-5;
+	h = e.cntrl.lattStressStep;
 	
 	//Set preconditioner (brings lattice Hessian to same dimensions as ionic):
 	for(int iDir=0; iDir<3; iDir++)
@@ -202,11 +202,12 @@ double LatticeMinimizer::compute(LatticeGradient* grad, LatticeGradient* Kgrad)
 
 void LatticeMinimizer::calculateStress()
 {	matrix3<> E_strain;
+	std::shared_ptr<Coulomb> coulomb = e.coulomb; //reused when restoring the unperturbed lattice below (avoids recomputing truncated kernels)
 	for(size_t i=0; i<strainBasis.size(); i++)
 		E_strain += strainBasis[i]*centralDifference(strainBasis[i]);
 	e.gInfo.R = Rorig + Rorig*strain;
 	bcast(e.gInfo.R); //ensure consistency to numerical precision
-	updateLatticeDependent(e);
+	updateLatticeDependent(e, false, coulomb);
 	e.iInfo.stress = E_strain * (1./e.gInfo.detR);
 	bcast(e.iInfo.stress); //ensure consistency to numerical precision
 }
@@ -220,16 +221,21 @@ double LatticeMinimizer::minimize(const MinimizeParams& params)
 
 
 double LatticeMinimizer::centralDifference(matrix3<> direction)
-{ 	//Central difference derivative with O(h^4)
-	double hArr[4] = { -2*h, -h, +h, +2*h };
-	double Earr[4];
-	for(int j=0; j<4; j++)
+{ 	//Central difference derivative with O(h^2) or O(h^4):
+	bool fourthOrder = (e.cntrl.lattStressOrder == 4);
+	std::vector<double> hArr = fourthOrder
+		? std::vector<double>{ -2*h, -h, +h, +2*h }
+		: std::vector<double>{ -h, +h };
+	std::vector<double> Earr(hArr.size());
+	for(size_t j=0; j<hArr.size(); j++)
 	{	e.gInfo.R = Rorig + Rorig*(strain+(hArr[j]*direction));
 		bcast(e.gInfo.R); //ensure consistency to numerical precision
 		updateLatticeDependent(e);
 		Earr[j] = sync(relevantFreeEnergy(e));
 	}
-	return (1./(12.*h))*(Earr[0] - 8.*Earr[1] + 8.*Earr[2] - Earr[3]);
+	return fourthOrder
+		? (1./(12.*h))*(Earr[0] - 8.*Earr[1] + 8.*Earr[2] - Earr[3])
+		: (0.5/h)*(Earr[1] - Earr[0]);
 }
 
 
@@ -267,7 +273,7 @@ double LatticeMinimizer::sync(double x) const
 	return x;
 }
 
-void LatticeMinimizer::updateLatticeDependent(Everything& e, bool ignoreElectronic)
+void LatticeMinimizer::updateLatticeDependent(Everything& e, bool ignoreElectronic, std::shared_ptr<Coulomb> coulomb)
 {	logSuspend();
 	e.gInfo.update();
 	if(e.gInfoWfns)
@@ -275,7 +281,7 @@ void LatticeMinimizer::updateLatticeDependent(Everything& e, bool ignoreElectron
 		e.gInfoWfns->update();
 	}
 	e.updateSupercell();
-	e.coulomb = e.coulombParams.createCoulomb(e.gInfo);
+	e.coulomb = coulomb ? coulomb : e.coulombParams.createCoulomb(e.gInfo);
 	e.iInfo.update(e.ener);
 	if(!ignoreElectronic)
 	{	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
@@ -68,14 +68,16 @@ private:
 	//!Their span is consistent with symmetries and truncation (if any).
 	std::vector<matrix3<>> strainBasis;
 
-	double h; //! Finite difference step size
+	double h; //! Finite difference step size (Control::lattStressStep)
 	double centralDifference(matrix3<> direction);  //! Returns the numerical derivative along the given strain
 	
 	//! Updates lattice dependent quantities, but does not
-	//! reconverge ionic positions or wavefunctions
-	static void updateLatticeDependent(Everything& e, bool ignoreElectronic=false);
+	//! reconverge ionic positions or wavefunctions.
+	//! If coulomb is provided, it is reused instead of being recreated (it must belong to the current lattice).
+	static void updateLatticeDependent(Everything& e, bool ignoreElectronic=false, std::shared_ptr<class Coulomb> coulomb=0);
 	
 	friend class IonDynamics;
+	friend struct JDFTxInstance;
 };
 
 //! @}
@@ -0,0 +1,249 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/LinearResponse.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <core/ScalarFieldIO.h>
+
+LinearResponse::LinearResponse(Everything& e, const PulayParams& pp)
+: Pulay<ScalarFieldArray>(pp), nCGiterations(50), cgThreshold(1e-6), e(e), mixFraction(pp.mixFraction)
+{	const ElecInfo& eInfo = e.eInfo;
+	ElecVars& eVars = e.eVars;
+
+	//Check applicability:
+	for(const auto& sp: e.iInfo.species)
+		if(sp->isUltrasoft())
+			die("Linear response is currently implemented only for norm-conserving pseudopotentials.\n");
+	if(eInfo.isNoncollinear()) die("Linear response is currently implemented only for collinear spin.\n");
+	if(e.exCorr.exxFactor()) die("Linear response is not yet implemented for hybrid functionals.\n");
+	if(e.exCorr.needsKEdensity()) die("Linear response is not yet implemented for meta-GGA functionals.\n");
+	if(eInfo.hasU) die("Linear response is not yet implemented for DFT+U.\n");
+	if(eVars.fluidSolver) die("Linear response is not yet implemented with fluids.\n");
+	if(e.symm.mode != SymmetriesNone)
+		die("Linear response to a general perturbation requires symmetries to be turned off (symmetries none).\n");
+
+	//Extract occupied subspace of each state in its eigenbasis:
+	Cocc.resize(eInfo.nStates);
+	eigOcc.resize(eInfo.nStates);
+	dC.resize(eInfo.nStates);
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	const diagMatrix& Fq = eVars.F[q];
+		int nOcc = 0;
+		for(int b=0; b<eInfo.nBands; b++)
+		{	if(fabs(Fq[b]-1.) < 1e-6)
+			{	if(nOcc < b) die("Occupied bands must precede unoccupied ones for linear response.\n");
+				nOcc++;
+			}
+			else if(fabs(Fq[b]) > 1e-6)
+				die("Linear response is currently implemented only for insulators (integer fillings).\n");
+		}
+		if(nOcc == eInfo.nBands)
+			logPrintf("WARNING: no empty bands in state %d; first-order wavefunctions do not need them, but check convergence of the ground state.\n", q);
+		//Diagonalize subspace Hamiltonian in the occupied space:
+		ColumnBundle HC; Energies ener;
+		eVars.applyHamiltonian(q, eye(eInfo.nBands), HC, ener, true, false);
+		ColumnBundle Cq = eVars.C[q].getSub(0, nOcc);
+		matrix Hocc = dagger_symmetrize(Cq ^ HC.getSub(0, nOcc));
+		matrix evecs; Hocc.diagonalize(evecs, eigOcc[q]);
+		Cocc[q] = Cq * evecs;
+	}
+}
+
+ScalarFieldArray LinearResponse::solve(const ScalarFieldArray& dVext, std::vector<ColumnBundle>* dCout)
+{	static StopWatch watch("LinearResponse::solve"); watch.start();
+	assert(dVext.size() == e.eVars.n.size());
+	this->dVext = clone(dVext);
+	dVscf = clone(dVext); //non-self-consistent initial guess
+	for(ColumnBundle& dCq: dC) dCq.free();
+	clearState();
+	minimize();
+	if(dCout) *dCout = dC;
+	watch.stop();
+	return dn;
+}
+
+void LinearResponse::sternheimer(int q, const ScalarFieldArray& dV, ColumnBundle& dCq) const
+{	static StopWatch watch("LinearResponse::sternheimer"); watch.start();
+	ElecVars& eVars = e.eVars;
+	const ColumnBundle& Cq = Cocc[q];
+	const diagMatrix& eigq = eigOcc[q];
+	int nOcc = Cq.nCols();
+	ColumnBundle OCq = O(Cq);
+
+	//Apply (H - eig O) to a trial bundle in the unoccupied space:
+	auto applyA = [&](const ColumnBundle& X)
+	{	ColumnBundle Xq = X;
+		std::vector<matrix> VdagX;
+		e.iInfo.project(Xq, VdagX);
+		std::swap(eVars.C[q], Xq); std::swap(eVars.VdagC[q], VdagX); //Hamiltonian always operates on C, where we put X
+		ColumnBundle HX; Energies ener; //energies not needed
+		eVars.applyHamiltonian(q, eye(nOcc), HX, ener, true, false);
+		std::swap(eVars.C[q], Xq); std::swap(eVars.VdagC[q], VdagX);
+		HX -= O(X) * eigq;
+		return HX;
+	};
+	//Preconditioner projected to the unoccupied space:
+	diagMatrix KEref = (-0.5) * diagDot(Cq, L(Cq));
+	auto precondition = [&](const ColumnBundle& R)
+	{	ColumnBundle Z = R;
+		precond_inv_kinetic_band(Z, KEref);
+		Z -= Cq * (OCq ^ Z);
+		return Z;
+	};
+
+	//Right hand side: -Pc^ dV C (in the same dual representation as the output of applyHamiltonian)
+	ScalarFieldArray JdagOJdV(dV.size());
+	for(size_t s=0; s<dV.size(); s++) JdagOJdV[s] = JdagOJ(dV[s]);
+	ColumnBundle B = Idag_DiagV_I(Cq, JdagOJdV);
+	B -= OCq * (Cq ^ B);
+	B *= -1.;
+	diagMatrix Bsq = diagDot(B, B);
+
+	//Band-by-band preconditioned conjugate gradients, starting from the previous solution if available:
+	ColumnBundle R = B;
+	if(dCq && dCq.nCols()==nOcc) R -= applyA(dCq);
+	else { dCq = B.similar(); dCq.zero(); }
+	ColumnBundle Z = precondition(R), P = Z;
+	diagMatrix rz = diagDot(R, Z), step(nOcc), beta(nOcc);
+	int iter = 0, nUnconverged = nOcc;
+	for(; iter<nCGiterations; iter++)
+	{	diagMatrix Rsq = diagDot(R, R);
+		nUnconverged = 0;
+		for(int b=0; b<nOcc; b++)
+			if(Rsq[b] > cgThreshold*cgThreshold*Bsq[b]) nUnconverged++;
+		if(!nUnconverged) break;
+		//Step:
+		ColumnBundle AP = applyA(P);
+		diagMatrix PAP = diagDot(P, AP);
+		for(int b=0; b<nOcc; b++) step[b] = (PAP[b] > 0.) ? rz[b]/PAP[b] : 0.;
+		dCq += P * step;
+		R -= AP * step;
+		//Update search direction:
+		Z = precondition(R);
+		diagMatrix rzNew = diagDot(R, Z);
+		for(int b=0; b<nOcc; b++) beta[b] = (rz[b] > 0.) ? rzNew[b]/rz[b] : 0.;
+		P = P * beta;
+		P += Z;
+		rz = rzNew;
+	}
+	if(nUnconverged)
+		logPrintf("\tLinearResponse: Sternheimer solve of state %d did not converge for %d bands in %d iterations.\n", q, nUnconverged, iter);
+	watch.stop();
+}
+
+ScalarFieldArray LinearResponse::densityResponse() const
+{	const ElecInfo& eInfo = e.eInfo;
+	int nDensities = e.eVars.n.size();
+	ScalarFieldArray dn(nDensities);
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+	{	//dn = 2 Re(C* dC) = (|C+dC|^2 - |C-dC|^2)/2 summed over occupied bands:
+		diagMatrix Focc(Cocc[q].nCols(), 1.);
+		ColumnBundle Cplus = Cocc[q]; Cplus += dC[q];
+		ColumnBundle Cminus = Cocc[q]; Cminus -= dC[q];
+		dn += (0.5*eInfo.qnums[q].weight) * diagouterI(Focc, Cplus, nDensities, &e.gInfo);
+		dn -= (0.5*eInfo.qnums[q].weight) * diagouterI(Focc, Cminus, nDensities, &e.gInfo);
+	}
+	nullToZero(dn, e.gInfo, nDensities);
+	for(ScalarField& dns: dn)
+		dns->allReduceData(mpiWorld, MPIUtil::ReduceSum);
+	return dn;
+}
+
+ScalarFieldArray LinearResponse::potentialResponse(const ScalarFieldArray& dn) const
+{	ScalarFieldArray dV(dn.size());
+	nullToZero(dV, e.gInfo);
+	double dnNormSq = ::dot(dn, dn);
+	if(!dnNormSq) return dV;
+	//Hartree:
+	ScalarField dnTot = dn.size()==1 ? dn[0] : dn[0]+dn[1];
+	ScalarField dVH = I((*e.coulomb)(J(dnTot)));
+	for(ScalarField& dVs: dV) dVs += dVH;
+	//Exchange-correlation by central difference along dn:
+	ScalarFieldArray nXC = e.eVars.get_nXC();
+	double h = 1e-4 * sqrt(::dot(nXC, nXC) / dnNormSq);
+	ScalarFieldArray nPlus = clone(nXC), nMinus = clone(nXC);
+	::axpy(+h, dn, nPlus);
+	::axpy(-h, dn, nMinus);
+	ScalarFieldArray VxcPlus, VxcMinus;
+	e.exCorr(nPlus, &VxcPlus);
+	e.exCorr(nMinus, &VxcMinus);
+	::axpy(+0.5/h, VxcPlus, dV);
+	::axpy(-0.5/h, VxcMinus, dV);
+	return dV;
+}
+
+//---- Interface to Pulay ----
+
+double LinearResponse::sync(double x) const
+{	mpiWorld->bcast(x);
+	return x;
+}
+
+double LinearResponse::cycle(double dEprev, std::vector<double>& extraValues)
+{	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
+		sternheimer(q, dVscf, dC[q]);
+	dn = densityResponse();
+	//Output first-order potential:
+	dVscf = potentialResponse(dn);
+	dVscf += dVext;
+	return 0.5 * e.gInfo.dV * ::dot(dn, dVext); //second-order energy change
+}
+
+void LinearResponse::axpy(double alpha, const ScalarFieldArray& X, ScalarFieldArray& Y) const
+{	::axpy(alpha, X, Y);
+}
+
+double LinearResponse::dot(const ScalarFieldArray& X, const ScalarFieldArray& Y) const
+{	return e.gInfo.dV * ::dot(X, Y);
+}
+
+void LinearResponse::dotMulti(const std::vector<ScalarFieldArray>& X, const ScalarFieldArray& Y, double* result) const
+{	std::fill(result, result+X.size(), 0.);
+	::dotMulti(X, Y, result, e.gInfo.dV);
+}
+
+size_t LinearResponse::variableSize() const
+{	return e.gInfo.nr * e.eVars.n.size() * sizeof(double);
+}
+
+void LinearResponse::readVariable(ScalarFieldArray& v, FILE* fp) const
+{	nullToZero(v, e.gInfo, e.eVars.n.size());
+	for(ScalarField& X: v) loadRawBinary(X, fp);
+}
+
+void LinearResponse::writeVariable(const ScalarFieldArray& v, FILE* fp) const
+{	for(const ScalarField& X: v) saveRawBinary(X, fp);
+}
+
+ScalarFieldArray LinearResponse::getVariable() const
+{	return clone(dVscf);
+}
+
+void LinearResponse::setVariable(const ScalarFieldArray& v)
+{	dVscf = clone(v);
+}
+
+ScalarFieldArray LinearResponse::precondition(const ScalarFieldArray& v) const
+{	return mixFraction * v;
+}
+
+ScalarFieldArray LinearResponse::applyMetric(const ScalarFieldArray& v) const
+{	return clone(v);
+}
@@ -0,0 +1,80 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_LINEARRESPONSE_H
+#define JDFTX_ELECTRONIC_LINEARRESPONSE_H
+
+#include <core/Pulay.h>
+#include <core/ScalarFieldArray.h>
+#include <electronic/ColumnBundle.h>
+
+//! @addtogroup ElecSystem
+//! @{
+//! @file LinearResponse.h Class LinearResponse for density-functional perturbation theory
+
+//! @brief Self-consistent linear response of the converged ground state to a local potential perturbation.
+//! The first-order wavefunctions are obtained from Sternheimer equations restricted to the unoccupied subspace,
+//! and the first-order self-consistent potential (external + Hartree + XC response) is Pulay-mixed.
+//! Currently limited to periodic (q=0) local perturbations of insulators with norm-conserving pseudopotentials,
+//! and semi-local functionals without symmetry reduction of k-points.
+class LinearResponse : public Pulay<ScalarFieldArray>
+{
+public:
+	//! The caller retains ownership of pp, which must outlive this object (energyDiffThreshold is not used)
+	LinearResponse(Everything& e, const PulayParams& pp);
+
+	//! Solve for the first-order density response dn to the (spin) potential perturbation dVext (real space, same layout as ElecVars::n).
+	//! Optionally retrieve the first-order wavefunctions (projected on the unoccupied subspace, in the Hsub eigenbasis of the occupied bands).
+	ScalarFieldArray solve(const ScalarFieldArray& dVext, std::vector<ColumnBundle>* dCout=0);
+
+	int nCGiterations; //!< maximum iterations of each Sternheimer solve (default 50)
+	double cgThreshold; //!< relative residual threshold for each Sternheimer solve (default 1e-6)
+
+protected:
+	//---- Interface to Pulay ----
+	double sync(double x) const;
+	double cycle(double dEprev, std::vector<double>& extraValues);
+	void axpy(double alpha, const ScalarFieldArray& X, ScalarFieldArray& Y) const;
+	double dot(const ScalarFieldArray& X, const ScalarFieldArray& Y) const;
+	void dotMulti(const std::vector<ScalarFieldArray>& X, const ScalarFieldArray& Y, double* result) const;
+	size_t variableSize() const;
+	void readVariable(ScalarFieldArray&, FILE*) const;
+	void writeVariable(const ScalarFieldArray&, FILE*) const;
+	ScalarFieldArray getVariable() const;
+	void setVariable(const ScalarFieldArray&);
+	ScalarFieldArray precondition(const ScalarFieldArray&) const;
+	ScalarFieldArray applyMetric(const ScalarFieldArray&) const;
+
+private:
+	Everything& e;
+	double mixFraction; //!< linear mixing fraction of the first-order potential (from PulayParams)
+	std::vector<ColumnBundle> Cocc; //!< occupied bands in the Hsub eigenbasis of each local state
+	std::vector<diagMatrix> eigOcc; //!< corresponding eigenvalues
+	std::vector<ColumnBundle> dC; //!< first-order wavefunctions from the latest cycle
+	ScalarFieldArray dVext; //!< external perturbation
+	ScalarFieldArray dVscf; //!< first-order self-consistent potential (the mixed variable)
+	ScalarFieldArray dn; //!< first-order density from the latest cycle
+
+	void sternheimer(int q, const ScalarFieldArray& dV, ColumnBundle& dCq) const; //!< solve for first-order wavefunctions of state q in potential dV
+	ScalarFieldArray densityResponse() const; //!< first-order density from dC
+	ScalarFieldArray potentialResponse(const ScalarFieldArray& dn) const; //!< first-order Hartree + XC potential due to dn
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_LINEARRESPONSE_H
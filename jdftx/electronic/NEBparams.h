@@ -0,0 +1,44 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_NEBPARAMS_H
+#define JDFTX_ELECTRONIC_NEBPARAMS_H
+
+#include <core/Util.h>
+
+//! @addtogroup IonicSystem
+//! @{
+//! @file NEBparams.h Parameters of the nudged-elastic-band driver
+
+//! Parameters to control NudgedElasticBand
+struct NEBparams
+{	int nImages; //!< number of images including both end points (0 disables the driver)
+	string finalFilename; //!< file containing ion positions of the final end point
+	double springConstant; //!< spring constant between neighbouring images (Eh/bohr^2)
+	bool climb; //!< whether to promote the highest-energy image to a climbing image
+	int nIterations; //!< maximum number of band relaxation steps
+	double forceTol; //!< convergence threshold on the largest atomic force on any image (Eh/bohr)
+	double dt; //!< initial time step of the FIRE relaxation (atomic units with unit mass)
+	
+	//! Set the default values
+	NEBparams() : nImages(0), springConstant(0.002), climb(true), nIterations(100), forceTol(1e-3), dt(1.) {}
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_NEBPARAMS_H
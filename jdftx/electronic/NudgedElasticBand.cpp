@@ -0,0 +1,307 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+
+#include <electronic/NudgedElasticBand.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <commands/parser.h>
+
+NudgedElasticBand::NudgedElasticBand(Everything& e, const std::vector< std::pair<string,string> >& input)
+: e(e), input(input), nAtoms(0)
+{	for(auto sp: e.iInfo.species)
+		nAtoms += sp->atpos.size();
+}
+
+std::vector<std::vector<vector3<>>> NudgedElasticBand::readFinalPositions() const
+{	const IonInfo& iInfo = e.iInfo;
+	std::vector<std::vector<vector3<>>> atpos(iInfo.species.size());
+	std::vector<double> pos; //flattened in species-major order
+	if(mpiWorld->isHead())
+	{	const char* fname = e.nebParams.finalFilename.c_str();
+		FILE* fp = fopen(fname, "r");
+		if(!fp) die("Error opening NEB final positions file '%s' for reading.\n", fname);
+		std::vector<std::vector<vector3<>>> atposRead(iInfo.species.size());
+		char lineBuf[1024];
+		while(fgets(lineBuf, sizeof(lineBuf), fp))
+		{	istringstream iss(lineBuf);
+			string key; iss >> key;
+			if(key != "ion") continue; //only positions are read (same format as ion commands)
+			string spName; vector3<> x;
+			iss >> spName >> x[0] >> x[1] >> x[2];
+			if(iss.fail()) die("Malformed line '%s' in NEB final positions file '%s'.\n", lineBuf, fname);
+			unsigned iSp = 0;
+			while(iSp<iInfo.species.size() && iInfo.species[iSp]->name!=spName) iSp++;
+			if(iSp==iInfo.species.size()) die("Unknown species '%s' in NEB final positions file '%s'.\n", spName.c_str(), fname);
+			if(iInfo.coordsType == CoordsCartesian) x = inv(e.gInfo.R) * x;
+			atposRead[iSp].push_back(x);
+		}
+		fclose(fp);
+		for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
+		{	if(atposRead[iSp].size() != iInfo.species[iSp]->atpos.size())
+				die("NEB final positions file '%s' contains %lu instead of %lu atoms of species '%s'.\n", fname,
+					atposRead[iSp].size(), iInfo.species[iSp]->atpos.size(), iInfo.species[iSp]->name.c_str());
+			for(const vector3<>& x: atposRead[iSp])
+				for(int k=0; k<3; k++) pos.push_back(x[k]);
+		}
+	}
+	mpiWorld->bcastData(pos);
+	const double* posPtr = pos.data();
+	for(unsigned iSp=0; iSp<iInfo.species.size(); iSp++)
+		for(unsigned atom=0; atom<iInfo.species[iSp]->atpos.size(); atom++, posPtr+=3)
+			atpos[iSp].push_back(vector3<>(posPtr[0], posPtr[1], posPtr[2]));
+	return atpos;
+}
+
+std::vector<double> NudgedElasticBand::getPositions(const Image& image) const
+{	std::vector<double> pos; pos.reserve(3*nAtoms);
+	for(auto sp: image.e->iInfo.species)
+		for(const vector3<>& x: sp->atpos)
+		{	vector3<> r = image.e->gInfo.R * x;
+			for(int k=0; k<3; k++) pos.push_back(r[k]);
+		}
+	return pos;
+}
+
+void NudgedElasticBand::compute(Image& image)
+{	logPrintf("\n---------- NEB image %d ----------\n", image.index); logFlush();
+	IonicGradient grad;
+	image.E = image.imin->compute(&grad, 0);
+	if(std::isnan(image.E)) die("NEB image %d has overlapping pseudopotential cores.\n", image.index);
+	image.F.clear();
+	for(const auto& gradSp: grad)
+		for(const vector3<>& g: gradSp)
+			for(int k=0; k<3; k++) image.F.push_back(-g[k]);
+}
+
+//Norm, dot product and accumulation for flattened coordinates:
+inline double dot(const std::vector<double>& x, const std::vector<double>& y)
+{	double result = 0.;
+	for(size_t i=0; i<x.size(); i++) result += x[i]*y[i];
+	return result;
+}
+inline void axpy(double alpha, const std::vector<double>& x, std::vector<double>& y)
+{	for(size_t i=0; i<x.size(); i++) y[i] += alpha*x[i];
+}
+
+void NudgedElasticBand::run()
+{	static StopWatch watch("NudgedElasticBand"); watch.start();
+	const NEBparams& np = e.nebParams;
+	const int nImages = np.nImages;
+	const int nDim = 3*nAtoms;
+	logPrintf("\n---------- Nudged elastic band with %d images (%s) ----------\n", nImages, np.climb ? "climbing image" : "no climbing image");
+	
+	//Linearly interpolate initial path (lattice coordinates, nearest periodic image of final positions):
+	std::vector<std::vector<vector3<>>> atposFinal = readFinalPositions();
+	std::vector<std::vector<vector3<>>> atposInitial(e.iInfo.species.size());
+	for(unsigned iSp=0; iSp<e.iInfo.species.size(); iSp++)
+	{	atposInitial[iSp] = e.iInfo.species[iSp]->atpos;
+		for(unsigned atom=0; atom<atposFinal[iSp].size(); atom++)
+		{	vector3<> dx = atposFinal[iSp][atom] - atposInitial[iSp][atom];
+			for(int k=0; k<3; k++) dx[k] -= floor(0.5 + dx[k]);
+			atposFinal[iSp][atom] = atposInitial[iSp][atom] + dx;
+		}
+	}
+	
+	//Divide processes into groups, and images between groups:
+	MPIUtil* mpiWorldAll = mpiWorld;
+	int nGroups = std::min(nImages, mpiWorldAll->nProcesses());
+	MPIUtil::ProcDivision procDivision(mpiWorldAll, nGroups);
+	std::shared_ptr<MPIUtil> mpiGroup = std::make_shared<MPIUtil>(0, (char**)0, procDivision);
+	logPrintf("Dividing %d processes into %d groups of images.\n", mpiWorldAll->nProcesses(), nGroups); logFlush();
+	mpiWorld = mpiGroup.get(); //all image calculations run within a group
+	
+	//Set up images of this group:
+	for(int i=procDivision.iGroup; i<nImages; i+=nGroups)
+	{	Image image;
+		image.index = i;
+		image.e = std::make_shared<Everything>();
+		Everything& ei = *(image.e);
+		logSuspend(); parse(input, ei); logResume();
+		double t = i * (1./(nImages-1)); //interpolation parameter
+		for(unsigned iSp=0; iSp<ei.iInfo.species.size(); iSp++)
+			for(unsigned atom=0; atom<atposFinal[iSp].size(); atom++)
+				ei.iInfo.species[iSp]->atpos[atom] = (1.-t)*atposInitial[iSp][atom] + t*atposFinal[iSp][atom];
+		ei.symm.mode = SymmetriesNone; //intermediate images generally break symmetries of the end points
+		//Separate outputs for each image:
+		ostringstream tag; tag << "image" << i << ".";
+		ei.dump.format.insert(ei.dump.format.find("$VAR"), tag.str());
+		for(auto& ff: ei.dump.formatFreq)
+			if(ff.second.find("$VAR") != string::npos)
+				ff.second.insert(ff.second.find("$VAR"), tag.str());
+		logPrintf("\n########### Setting up NEB image %d #############\n", i);
+		ei.setup();
+		image.imin = std::make_shared<IonicMinimizer>(ei);
+		images.push_back(image);
+	}
+	
+	//Relax the band:
+	std::vector<double> v((nImages-2)*nDim, 0.); //FIRE velocities of interior images
+	double dt = np.dt, alpha = 0.1; int nPositive = 0; //FIRE state
+	const double dtMax = 10.*np.dt, alphaStart = 0.1, fInc = 1.1, fDec = 0.5, fAlpha = 0.99; const int nMin = 5; //FIRE parameters
+	bool climbing = false;
+	std::vector<double> E(nImages), X(nImages*nDim), F(nImages*nDim);
+	for(int iter=0; ; iter++)
+	{	//Compute and collect energies, positions and forces:
+		std::fill(E.begin(), E.end(), 0.);
+		std::fill(X.begin(), X.end(), 0.);
+		std::fill(F.begin(), F.end(), 0.);
+		for(Image& image: images)
+		{	int i = image.index;
+			if(iter==0 || (i>0 && i<nImages-1)) compute(image); //end points are fixed
+			if(mpiWorld->isHead())
+			{	E[i] = image.E;
+				std::vector<double> pos = getPositions(image);
+				std::copy(pos.begin(), pos.end(), X.begin()+i*nDim);
+				std::copy(image.F.begin(), image.F.end(), F.begin()+i*nDim);
+			}
+		}
+		mpiWorldAll->allReduceData(E, MPIUtil::ReduceSum);
+		mpiWorldAll->allReduceData(X, MPIUtil::ReduceSum);
+		mpiWorldAll->allReduceData(F, MPIUtil::ReduceSum);
+		
+		//NEB forces on interior images:
+		std::vector<std::vector<double>> Fneb(nImages-2);
+		int iClimb = 0; //highest energy interior image
+		for(int i=1; i<nImages-1; i++)
+			if(iClimb==0 || E[i] > E[iClimb]) iClimb = i;
+		double Fmax = 0.;
+		for(int pass=0; pass<2; pass++) //second pass only if climbing image is activated by the first pass
+		{	Fmax = 0.;
+			for(int i=1; i<nImages-1; i++)
+			{	//Tangent (upwind scheme for stability):
+				std::vector<double> tPlus(X.begin()+(i+1)*nDim, X.begin()+(i+2)*nDim);
+				std::vector<double> tMinus(X.begin()+i*nDim, X.begin()+(i+1)*nDim);
+				axpy(-1., tMinus, tPlus); //= X[i+1] - X[i]
+				axpy(-1., std::vector<double>(X.begin()+(i-1)*nDim, X.begin()+i*nDim), tMinus); //= X[i] - X[i-1]
+				std::vector<double> tau(nDim, 0.);
+				if(E[i+1]>E[i] && E[i]>E[i-1]) tau = tPlus;
+				else if(E[i+1]<E[i] && E[i]<E[i-1]) tau = tMinus;
+				else
+				{	double dEplus = fabs(E[i+1]-E[i]), dEminus = fabs(E[i-1]-E[i]);
+					double dEmax = std::max(dEplus, dEminus), dEmin = std::min(dEplus, dEminus);
+					bool plusHigher = (E[i+1] > E[i-1]);
+					axpy(plusHigher ? dEmax : dEmin, tPlus, tau);
+					axpy(plusHigher ? dEmin : dEmax, tMinus, tau);
+				}
+				double tauNorm = sqrt(dot(tau, tau));
+				if(tauNorm) for(double& t: tau) t /= tauNorm;
+				//True force perpendicular to the path (inverted along it for the climbing image) and spring force along it:
+				std::vector<double>& Fi = Fneb[i-1];
+				Fi.assign(F.begin()+i*nDim, F.begin()+(i+1)*nDim);
+				double Fpar = dot(Fi, tau);
+				if(climbing && i==iClimb) axpy(-2.*Fpar, tau, Fi);
+				else
+				{	axpy(-Fpar, tau, Fi);
+					axpy(np.springConstant*(sqrt(dot(tPlus,tPlus)) - sqrt(dot(tMinus,tMinus))), tau, Fi);
+				}
+				//Per-atom constraints:
+				int iAtom = 0;
+				for(auto sp: e.iInfo.species)
+					for(const SpeciesInfo::Constraint& constraint: sp->constraints)
+					{	double* f = Fi.data() + 3*(iAtom++);
+						vector3<> fc = constraint.moveScale ? constraint(vector3<>(f[0], f[1], f[2])) : vector3<>();
+						for(int k=0; k<3; k++) f[k] = fc[k];
+						Fmax = std::max(Fmax, fc.length());
+					}
+			}
+			if(np.climb && (!climbing) && nImages>2 && Fmax < 10.*np.forceTol) climbing = true; //start climbing once the band is roughly relaxed
+			else break;
+		}
+		
+		//Report:
+		double Emax = *std::max_element(E.begin(), E.end());
+		logPrintf("\nNEB: Iter: %3d  Emax: %+.12lf  Ebarrier: %+.12lf  |F|max: %.3le  Climbing: %s  t[s]: %9.2lf\n",
+			iter, Emax, Emax-E[0], Fmax, (climbing ? "yes" : "no"), clock_sec());
+		logFlush();
+		bool converged = (Fmax < np.forceTol);
+		if(converged) logPrintf("NEB: Converged (|F|max < %.3le).\n", np.forceTol);
+		if(converged || iter >= np.nIterations)
+		{	logPrintf("\n# NEB path: image, reaction coordinate [bohr], energy relative to initial image [Eh]\n");
+			double s = 0.;
+			for(int i=0; i<nImages; i++)
+			{	if(i)
+				{	std::vector<double> dX(X.begin()+i*nDim, X.begin()+(i+1)*nDim);
+					axpy(-1., std::vector<double>(X.begin()+(i-1)*nDim, X.begin()+i*nDim), dX);
+					s += sqrt(dot(dX, dX));
+				}
+				logPrintf("NEBpath %3d %10.6lf %+.12lf%s\n", i, s, E[i]-E[0], (climbing && i==iClimb) ? "  (climbing image)" : "");
+			}
+			logFlush();
+			break;
+		}
+		
+		//FIRE step:
+		double P = 0., vNormSq = 0., FnormSq = 0.;
+		for(int i=0; i<nImages-2; i++)
+		{	const double* vi = v.data() + i*nDim;
+			P += dot(Fneb[i], std::vector<double>(vi, vi+nDim));
+			vNormSq += dot(std::vector<double>(vi, vi+nDim), std::vector<double>(vi, vi+nDim));
+			FnormSq += dot(Fneb[i], Fneb[i]);
+		}
+		if(P > 0.)
+		{	double vScale = FnormSq ? alpha*sqrt(vNormSq/FnormSq) : 0.;
+			for(int i=0; i<nImages-2; i++)
+				for(int j=0; j<nDim; j++)
+					v[i*nDim+j] = (1.-alpha)*v[i*nDim+j] + vScale*Fneb[i][j];
+			if(++nPositive > nMin)
+			{	dt = std::min(dt*fInc, dtMax);
+				alpha *= fAlpha;
+			}
+		}
+		else
+		{	std::fill(v.begin(), v.end(), 0.);
+			dt *= fDec;
+			alpha = alphaStart;
+			nPositive = 0;
+		}
+		std::vector<double> dX(v.size());
+		double dXmax = 0.;
+		for(int i=0; i<nImages-2; i++)
+			for(int j=0; j<nDim; j++)
+			{	v[i*nDim+j] += dt * Fneb[i][j];
+				dX[i*nDim+j] = dt * v[i*nDim+j];
+			}
+		for(int iAtom=0; iAtom<nAtoms*(nImages-2); iAtom++)
+			dXmax = std::max(dXmax, sqrt(dX[3*iAtom]*dX[3*iAtom] + dX[3*iAtom+1]*dX[3*iAtom+1] + dX[3*iAtom+2]*dX[3*iAtom+2]));
+		if(dXmax > IonicMinimizer::maxAtomTestDisplacement) //limit largest atomic displacement per step
+			for(double& d: dX) d *= IonicMinimizer::maxAtomTestDisplacement/dXmax;
+		
+		//Move interior images of this group (dragging wavefunctions):
+		for(Image& image: images)
+		{	int i = image.index;
+			if(i==0 || i==nImages-1) continue;
+			IonicGradient dir; dir.init(image.e->iInfo);
+			const double* dXi = dX.data() + (i-1)*nDim;
+			for(auto& dirSp: dir)
+				for(vector3<>& d: dirSp)
+				{	d = vector3<>(dXi[0], dXi[1], dXi[2]);
+					dXi += 3;
+				}
+			image.imin->step(dir, 1.);
+		}
+	}
+	
+	//Final outputs of each image:
+	for(Image& image: images)
+		image.e->dump(DumpFreq_End, 0);
+	images.clear();
+	mpiWorld = mpiWorldAll;
+	watch.stop();
+}
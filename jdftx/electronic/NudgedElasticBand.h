@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+
+#ifndef JDFTX_ELECTRONIC_NUDGEDELASTICBAND_H
+#define JDFTX_ELECTRONIC_NUDGEDELASTICBAND_H
+
+#include <electronic/IonicMinimizer.h>
+#include <memory>
+
+//! @addtogroup IonicSystem
+//! @{
+//! @file NudgedElasticBand.h Climbing-image nudged-elastic-band driver
+
+//! Nudged-elastic-band (NEB) driver for minimum energy paths and transition states.
+//! The images are distributed over groups of processes (each with its own mpiWorld while an image is active),
+//! and each image keeps its own Everything so that its electronic state is reused between band iterations.
+class NudgedElasticBand
+{
+public:
+	//! Template e must have been parsed from input (but not set up); each image is re-parsed from input
+	NudgedElasticBand(Everything& e, const std::vector< std::pair<string,string> >& input);
+	void run(); //!< set up all images and relax the band (collective over all processes)
+	
+private:
+	Everything& e; //!< parsed template used for atom lists and constraints
+	const std::vector< std::pair<string,string> >& input;
+	int nAtoms; //!< total number of atoms in each image
+	
+	//! Image handled by the current process group
+	struct Image
+	{	int index;
+		std::shared_ptr<Everything> e;
+		std::shared_ptr<IonicMinimizer> imin;
+		double E; //!< energy at current positions
+		std::vector<double> F; //!< cartesian forces at current positions (flattened, species-major)
+	};
+	std::vector<Image> images;
+	
+	std::vector<std::vector<vector3<>>> readFinalPositions() const; //!< final end point positions (lattice coordinates) from NEBparams::finalFilename
+	void compute(Image& image); //!< electronic minimization, energy and forces at the current positions of image
+	std::vector<double> getPositions(const Image& image) const; //!< cartesian positions (flattened, species-major)
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_NUDGEDELASTICBAND_H
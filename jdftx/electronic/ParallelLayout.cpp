@@ -0,0 +1,176 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <electronic/ParallelLayout.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <core/Thread.h>
+#include <core/Operators.h>
+#include <cmath>
+
+//Time per call of f in seconds, repeated for at least tMin seconds after a warm-up call (maximum over all processes)
+template<typename Func> static double benchmark(const Func& f, double tMin=0.05)
+{	f(); //warm up (FFT plans, memory caches)
+	int nCalls = 0;
+	double tStart = clock_us();
+	do { f(); nCalls++; } while(clock_us()-tStart < tMin*1e6);
+	double t = 1e-6*(clock_us()-tStart)/nCalls;
+	mpiWorld->allReduce(t, MPIUtil::ReduceMax);
+	return t;
+}
+
+//Cost model with Amdahl scaling in the thread count, fit to timings on 1 and nThreads0 threads
+struct ThreadScaling
+{	double t1, fParallel; //single-threaded time, and parallelizable fraction
+
+	template<typename Func> ThreadScaling(const Func& f, int nThreads0)
+	{	suspendOperatorThreading(); //single-threaded operators
+		t1 = benchmark(f);
+		resumeOperatorThreading();
+		double tN = (nThreads0 > 1) ? benchmark(f) : t1;
+		fParallel = (nThreads0 > 1) ? std::min(1., std::max(0., (1.-tN/t1)/(1.-1./nThreads0))) : 1.;
+	}
+
+	double operator()(int nThreads) const { return t1*((1.-fParallel) + fParallel/nThreads); }
+	double speedup(int nThreads) const { return t1/operator()(nThreads); }
+};
+
+//A candidate division of each node
+struct Layout
+{	int nProcsPerNode, nThreads; //processes per node and threads per process
+	int nStatesPerProc; //states handled by each process (at least 1, with helpers otherwise)
+	double memPerProc; //estimated memory per process in bytes
+	double tIter; //estimated time per electronic iteration in seconds
+};
+
+void tuneParallelLayout(const Everything& e, bool autoSet)
+{	static StopWatch watch("tuneParallelLayout"); watch.start();
+	logPrintf("\n---------- Parallel layout ----------\n");
+	const ElecInfo& eInfo = e.eInfo;
+	const GridInfo& gInfoWfns = e.gInfoWfns ? *(e.gInfoWfns) : e.gInfo;
+	int nSpinor = eInfo.spinorLength();
+
+	//Current layout:
+	int nProcs = mpiWorld->nProcesses();
+	int nNodes = (mpiHost->iProcess()==0) ? 1 : 0; mpiWorld->allReduce(nNodes, MPIUtil::ReduceSum);
+	int nProcsPerNodeCur = (nProcs + nNodes - 1) / nNodes;
+	int nCoresPerNode = getPhysicalCores();
+	const char* envCpusPerNode = getenv("JDFTX_CPUS_PER_NODE");
+	if(envCpusPerNode) sscanf(envCpusPerNode, "%d", &nCoresPerNode);
+	mpiWorld->allReduce(nCoresPerNode, MPIUtil::ReduceMin);
+	int nThreadsHost = nProcsAvailable; mpiHost->allReduce(nThreadsHost, MPIUtil::ReduceSum);
+	mpiWorld->allReduce(nThreadsHost, MPIUtil::ReduceMax);
+	double memPerNode = double(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+	mpiWorld->allReduce(memPerNode, MPIUtil::ReduceMin);
+	int nGpusPerNode = 0;
+	#ifdef GPU_ENABLED
+	if(isGpuEnabled()) cudaGetDeviceCount(&nGpusPerNode);
+	mpiWorld->allReduce(nGpusPerNode, MPIUtil::ReduceMin);
+	#endif
+	logPrintf("Current layout: %d node(s) with %d process(es) x %d thread(s) each;"
+		" %d physical cores, %.1lf GB", nNodes, nProcsPerNodeCur, nProcsAvailable, nCoresPerNode, memPerNode/(1<<30));
+	if(nGpusPerNode) logPrintf(" and %d GPU(s)", nGpusPerNode);
+	logPrintf(" per node.\n");
+
+	//Micro-benchmarks of the dominant operations per state, on data sized like the actual calculation:
+	double nbasisAvg = 0.;
+	for(int q=0; q<eInfo.nStates; q++) nbasisAvg += e.basis[q].nbasis;
+	nbasisAvg /= eInfo.nStates;
+	int qBench = (eInfo.qStart < eInfo.nStates) ? eInfo.qStart : 0;
+	const int nBandsBench = std::min(eInfo.nBands, 64); //subset of bands for the (nBands^2) overlap benchmark
+	complexScalarFieldTilde psiTilde; nullToZero(psiTilde, gInfoWfns);
+	ThreadScaling tFFT([&](){ complexScalarField psi = I(psiTilde); psiTilde = J(psi); }, nProcsAvailable);
+	ColumnBundle Cbench(nBandsBench, e.basis[qBench].nbasis*nSpinor, &e.basis[qBench], 0, isGpuEnabled());
+	Cbench.randomize(0, nBandsBench);
+	ThreadScaling tGemm([&](){ matrix M = Cbench^Cbench; }, nProcsAvailable);
+	Cbench.free(); psiTilde = 0;
+	std::vector<double> reduceBuf(e.gInfo.nr, 0.);
+	double tCopy = benchmark([&](){ std::vector<double> copy(reduceBuf); reduceBuf.swap(copy); });
+	double tReduceStep = 2.*tCopy; //cost per stage of a tree reduction of one grid-sized array (intra-node estimate)
+	if(nProcs > 1)
+		tReduceStep = benchmark([&](){ mpiWorld->allReduceData(reduceBuf, MPIUtil::ReduceSum); }) / log2(nProcs);
+	logPrintf("Micro-benchmarks: FFT %.3lf ms (x%.1lf on %d threads), %d-band overlap %.3lf ms (x%.1lf), grid reduction %.3lf ms/stage\n",
+		tFFT.t1*1e3, tFFT.speedup(nProcsAvailable), nProcsAvailable, nBandsBench, tGemm.t1*1e3, tGemm.speedup(nProcsAvailable), tReduceStep*1e3);
+
+	//Cost model per electronic iteration: four transforms per band-spinor (Hamiltonian and density),
+	//a handful of subspace overlaps, and reductions of the densities across processes:
+	double gemmScale = std::pow(eInfo.nBands*1./nBandsBench, 2) * nbasisAvg / e.basis[qBench].nbasis;
+	auto tState = [&](int nThreads) { return 4.*eInfo.nBands*nSpinor*tFFT(nThreads) + 6.*gemmScale*tGemm(nThreads); };
+	double bytesPerState = 6. * eInfo.nBands * nbasisAvg * nSpinor * sizeof(complex); //wavefunctions, gradients, search directions etc.
+	double bytesGrid = 50. * e.gInfo.nr * sizeof(double); //densities, potentials and scratch
+	std::vector<Layout> layouts;
+	int nProcsPerNodeMax = nGpusPerNode ? std::max(nProcsPerNodeCur, 2*nGpusPerNode) : nCoresPerNode;
+	for(int nProcsPerNode=1; nProcsPerNode<=nProcsPerNodeMax; nProcsPerNode++)
+	{	if(!nGpusPerNode && nProcsPerNode!=nProcsPerNodeCur && nCoresPerNode % nProcsPerNode) continue; //only even divisions (and the current one)
+		Layout l;
+		l.nProcsPerNode = nProcsPerNode;
+		l.nThreads = std::max(1, nCoresPerNode / nProcsPerNode);
+		int nProcsTot = nProcsPerNode * nNodes;
+		l.nStatesPerProc = (eInfo.nStates + nProcsTot - 1) / nProcsTot;
+		l.memPerProc = l.nStatesPerProc * bytesPerState + bytesGrid;
+		if(l.memPerProc * nProcsPerNode > 0.8*memPerNode) continue; //would not fit
+		double tStateCur = nGpusPerNode
+			? tState(nProcsAvailable) * std::max(1., nProcsPerNode*1./nGpusPerNode) / std::max(1., nProcsPerNodeCur*1./nGpusPerNode) //GPUs shared round-robin
+			: tState(l.nThreads);
+		l.tIter = l.nStatesPerProc * tStateCur + 2.*eInfo.nDensities * tReduceStep * log2(nProcsTot);
+		layouts.push_back(l);
+	}
+	if(!layouts.size())
+	{	logPrintf("Estimated memory requirement exceeds that available on the nodes for all layouts: use more nodes.\n");
+		watch.stop();
+		return;
+	}
+
+	//Report:
+	const Layout* best = &layouts[0];
+	const Layout* cur = 0;
+	for(const Layout& l: layouts)
+	{	if(l.tIter < best->tIter) best = &l;
+		if(l.nProcsPerNode == nProcsPerNodeCur) cur = &l;
+	}
+	logPrintf("Estimated cost per electronic iteration (for %d states of %d bands, average nbasis = %.0lf):\n", eInfo.nStates, eInfo.nBands, nbasisAvg);
+	logPrintf("\t%12s %8s %12s %14s %10s\n", "procs/node", "threads", "states/proc", "mem/proc[GB]", "t/iter[s]");
+	for(const Layout& l: layouts)
+		logPrintf("\t%12d %8d %12d %14.2lf %10.3lf%s\n", l.nProcsPerNode, l.nThreads, l.nStatesPerProc,
+			l.memPerProc/(1<<30), l.tIter, (&l==best) ? (&l==cur ? "  <- best, current" : "  <- best") : (&l==cur ? "  <- current" : ""));
+	if(nThreadsHost > nCoresPerNode)
+		logPrintf("WARNING: %d threads per node oversubscribe the %d physical cores.\n", nThreadsHost, nCoresPerNode);
+	if(nGpusPerNode && nProcsPerNodeCur % nGpusPerNode)
+		logPrintf("WARNING: %d processes per node do not divide evenly between the %d GPUs per node.\n", nProcsPerNodeCur, nGpusPerNode);
+	if(cur && best != cur && best->tIter < 0.9*cur->tIter)
+		logPrintf("Suggestion: run %d process(es) per node%s%s for an estimated %.1lfx speedup.\n", best->nProcsPerNode,
+			nGpusPerNode ? "" : (" with " + std::to_string(best->nThreads) + " thread(s) each (-c)").c_str(),
+			nGpusPerNode ? " (one per GPU)" : "", cur->tIter/best->tIter);
+	else if(!cur)
+		logPrintf("Suggestion: run %d process(es) per node (the current layout does not fit in memory).\n", best->nProcsPerNode);
+	else
+		logPrintf("The current layout is within 10%% of the best estimate.\n");
+
+	//Adjust threads of each process to its share of the node:
+	if(autoSet && !nGpusPerNode)
+	{	int nThreadsAuto = std::max(1, nCoresPerNode / mpiHost->nProcesses());
+		if(nThreadsAuto != nProcsAvailable)
+		{	logPrintf("Setting threads per process from %d to %d.\n", nProcsAvailable, nThreadsAuto);
+			nProcsAvailable = nThreadsAuto;
+			resumeOperatorThreading(); //inform MKL of the updated thread count
+		}
+	}
+	logFlush();
+	watch.stop();
+}
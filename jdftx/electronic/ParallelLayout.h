@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_PARALLELLAYOUT_H
+#define JDFTX_ELECTRONIC_PARALLELLAYOUT_H
+
+class Everything;
+
+//! @addtogroup ElecSystem
+//! @{
+//! @file ParallelLayout.h Startup estimate of the best division of each node between MPI processes, threads and GPUs
+
+//! Time short FFT, ZGEMM and reduction micro-benchmarks on the current system, estimate the cost and memory
+//! per electronic iteration for each possible number of processes per node (with the cores divided evenly
+//! between them), and report the fastest layout that fits in memory (see command parallel-layout).
+//! If autoSet, also set the thread count of each process to its share of the node (the process and GPU
+//! counts are fixed by the launcher and can only be suggested). Must be called on all processes together,
+//! after the wavefunction bases have been set up.
+void tuneParallelLayout(const Everything& e, bool autoSet);
+
+//! @}
+#endif // JDFTX_ELECTRONIC_PARALLELLAYOUT_H
@@ -25,7 +25,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/VectorField.h>
 #include <core/ScalarFieldIO.h>
 
-Polarizability::Polarizability() : eigenBasis(NonInteracting), Ecut(0), nEigs(0)
+Polarizability::Polarizability() : eigenBasis(NonInteracting), Ecut(0), nEigs(0), lowRank(false)
 {
 }
 
@@ -149,6 +149,23 @@ public:
 			1., minusXni.dataPref(), minusXni.nRows());
 	}
 	
+	//Accumulate the negative of the noninteracting susceptibility in plane-wave basis times X into Y,
+	//without forming the matrix (Y += detR*rho*(dagger(rho)*X), with rho for the current k-point pair):
+	void accumMinusXniTimesPW(int nV, int nC, const Basis& basis, const matrix& X, matrix& Y)
+	{	assert(X.nRows() == int(basis.nbasis));
+		assert(Y.nRows() == int(basis.nbasis));
+		assert(Y.nCols() == X.nCols());
+		ColumnBundle rho(nV*nC, basis.nbasis, &basis);
+		compute(nV, nC, rho, 0);
+		matrix rhoDagX(rho.nCols(), X.nCols());
+		callPref(eblas_zgemm)(CblasConjTrans, CblasNoTrans, rho.nCols(), X.nCols(), basis.nbasis,
+			1., rho.dataPref(), rho.colLength(), X.dataPref(), X.nRows(),
+			0., rhoDagX.dataPref(), rhoDagX.nRows());
+		callPref(eblas_zgemm)(CblasNoTrans, CblasNoTrans, basis.nbasis, X.nCols(), rho.nCols(),
+			basis.gInfo->detR, rho.dataPref(), rho.colLength(), rhoDagX.dataPref(), rhoDagX.nRows(),
+			1., Y.dataPref(), Y.nRows());
+	}
+	
 private:
 	void compute_sub(int bStart, int bStop, int nV, int nC, ColumnBundle* rho, int kOffset) const
 	{	int b = bStart;
@@ -300,11 +317,48 @@ void Polarizability::dump(const Everything& e)
 	int nColumns = pwBasis ? int(basis.nbasis) : nCVK;
 	const char* basisName = pwBasis ? "PW" : "CV";
 	
+	//Determine whether to restrict to a low-rank subspace of the non-interacting response:
+	if(lowRank && (eigenBasis!=NonInteracting || nEigs<=0 || nEigs>=nColumns))
+	{	logPrintf("	Ignoring lowRank, which requires eigenBasis NonInteracting and 0 < nEigs < %d.\n", nColumns);
+		lowRank = false;
+	}
+	if(lowRank)
+	{	pwBasis = true; //subspace iteration on the operator in the PW basis (memory independent of CV basis size)
+		nColumns = nEigs;
+		basisName = "low-rank";
+	}
+	
 	QuantumNumber qnum; qnum.k = dk; qnum.spin = 0; qnum.weight = 1./nK;
 	ColumnBundle V(nColumns, basis.nbasis, &basis, &qnum); //orthonormal basis vectors
 	matrix Xni; //non-interacting susceptibility (in basis V)
 	
-	if(pwBasis)
+	if(lowRank)
+	{	//Randomized subspace iteration for the dominant eigenspace of -Xni, applying it one k-point pair at a time:
+		int nTrial = std::min(std::min(int(basis.nbasis), nCVK), nEigs + std::max(10, nEigs/4)); //oversampled subspace dimension
+		const int nPasses = 3; //subspace iterations (the last one is used for Rayleigh-Ritz)
+		logPrintf("\tComputing %d NonInteracting eigenvectors by subspace iteration (dimension %d)\n", nEigs, nTrial); logFlush();
+		matrix X(basis.nbasis, nTrial); randomize(X);
+		X = X * invCholesky(dagger(X) * X);
+		matrix Y;
+		for(int iPass=0; iPass<nPasses; iPass++)
+		{	Y = zeroes(basis.nbasis, nTrial);
+			for(int ik=0; ik<nK; ik++)
+				PairDensityCalculator(e, dk, ik).accumMinusXniTimesPW(nV, nC, basis, X, Y);
+			if(iPass+1 < nPasses) X = Y * invCholesky(dagger(Y) * Y);
+		}
+		//Rayleigh-Ritz in final subspace:
+		matrix evecs; diagMatrix eigs;
+		dagger_symmetrize(dagger(X) * Y).diagonalize(evecs, eigs); //eigenvalues of -Xni in ascending order
+		matrix Q = evecs(0,nTrial, nTrial-nEigs,nTrial);
+		diagMatrix XniEigs(nEigs);
+		for(int i=0; i<nEigs; i++) XniEigs[i] = -eigs[nTrial-nEigs+i];
+		logPrintf("\tNonInteracting eigenvalue range: [%lg, %lg]\n", XniEigs.front(), XniEigs.back());
+		double invsqrtVol = 1./sqrt(e.gInfo.detR);
+		matrix Vdata = invsqrtVol * (X * Q);
+		callPref(eblas_copy)(V.dataPref(), Vdata.dataPref(), V.nData());
+		Xni = XniEigs;
+	}
+	else if(pwBasis)
 	{	logPrintf("\tComputing NonInteracting polarizability in plane-wave basis\n"); logFlush();
 		//Set the basis to an identity matrix:
 		V.zero();
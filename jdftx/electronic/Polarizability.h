@@ -39,6 +39,7 @@ struct Polarizability
 	
 	double Ecut; //!< energy-cutoff for occupied-valence pair densities (if zero, 4*Ecut of wavefunctions)
 	int nEigs; //!< number of eigenvectors in output (if zero, output all)
+	bool lowRank; //!< if true, find the nEigs NonInteracting eigenvectors by subspace iteration, and compute all quantities within their span
 	
 	vector3<> dk; //!< k-point difference at which to obtain results
 	
@@ -0,0 +1,105 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+
+#include <electronic/ProjectorCache.h>
+#include <electronic/ColumnBundle.h>
+#include <core/Util.h>
+
+ProjectorCache::ProjectorCache()
+: maxBytes(0), nBytes(0), nBytesGpu(0), nHits(0), nShared(0), nMisses(0), nEvicted(0)
+{
+}
+
+std::shared_ptr<ColumnBundle> ProjectorCache::find(const SpeciesInfo* sp, const vector3<>& k, const Basis* basis, int kind)
+{	std::lock_guard<std::mutex> guard(lock);
+	auto iter = index.find(Key(sp, kind, k, basis));
+	if(iter == index.end())
+	{	//Look for an equivalent basis at the same k-point (eg. the other spin channel):
+		auto sameKey = [&](const Key& key) { return std::get<0>(key)==sp && std::get<1>(key)==kind && std::get<2>(key)==k; };
+		for(iter=index.lower_bound(Key(sp, kind, k, 0)); iter!=index.end() && sameKey(iter->first); iter++)
+		{	const Entry& entry = *(iter->second);
+			if(entry.gInfo==basis->gInfo && entry.nbasis==basis->nbasis && entry.basisHash==basis->hash)
+				break;
+		}
+		if(iter==index.end() || !sameKey(iter->first))
+		{	nMisses++;
+			return 0;
+		}
+		nShared++;
+	}
+	nHits++;
+	entries.splice(entries.begin(), entries, iter->second); //move to front (iterators remain valid)
+	return iter->second->V;
+}
+
+void ProjectorCache::insert(const SpeciesInfo* sp, const vector3<>& k, const Basis* basis, std::shared_ptr<ColumnBundle> V, int kind)
+{	Entry entry;
+	entry.key = Key(sp, kind, k, basis);
+	entry.V = V;
+	entry.gInfo = basis->gInfo;
+	entry.nbasis = basis->nbasis;
+	entry.basisHash = basis->hash;
+	entry.nBytes = V->nData() * sizeof(complex);
+	entry.onGpu = V->isOnGpu();
+	if(!fits(entry.nBytes)) return;
+	std::lock_guard<std::mutex> guard(lock);
+	auto iter = index.find(entry.key);
+	if(iter != index.end()) erase(iter->second); //replace existing entry
+	//Evict least recently used entries to make room:
+	while(maxBytes && entries.size() && nBytes+entry.nBytes > maxBytes)
+	{	erase(std::prev(entries.end()));
+		nEvicted++;
+	}
+	entries.push_front(entry);
+	index[entry.key] = entries.begin();
+	nBytes += entry.nBytes;
+	if(entry.onGpu) nBytesGpu += entry.nBytes;
+}
+
+void ProjectorCache::clear(const SpeciesInfo* sp, int kind)
+{	std::lock_guard<std::mutex> guard(lock);
+	for(auto iter=entries.begin(); iter!=entries.end();)
+	{	auto next = std::next(iter);
+		if((!sp || std::get<0>(iter->key)==sp) && (kind<0 || std::get<1>(iter->key)==kind)) erase(iter);
+		iter = next;
+	}
+}
+
+void ProjectorCache::update(const SpeciesInfo* sp, const std::function<void(ColumnBundle&)>& func, int kind)
+{	std::lock_guard<std::mutex> guard(lock);
+	for(Entry& entry: entries)
+		if(std::get<0>(entry.key)==sp && std::get<1>(entry.key)==kind)
+			func(*entry.V);
+}
+
+void ProjectorCache::erase(std::list<Entry>::iterator iter)
+{	nBytes -= iter->nBytes;
+	if(iter->onGpu) nBytesGpu -= iter->nBytes;
+	index.erase(iter->key);
+	entries.erase(iter);
+}
+
+void ProjectorCache::print() const
+{	std::lock_guard<std::mutex> guard(lock);
+	size_t stats[6] = { nBytes, nBytesGpu, nHits, nShared, nMisses, nEvicted };
+	mpiWorld->reduce(stats, 6, MPIUtil::ReduceSum);
+	logPrintf("Projector cache: %.1lf MB (%.1lf MB on GPU) in use summed over processes, with budget %.1lf MB per process; %lu hits (%lu shared between equivalent bases), %lu misses, %lu evictions.\n",
+		stats[0]*1e-6, stats[1]*1e-6, maxBytes*1e-6, stats[2], stats[3], stats[4], stats[5]);
+}
@@ -0,0 +1,83 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_ELECTRONIC_PROJECTORCACHE_H
+#define JDFTX_ELECTRONIC_PROJECTORCACHE_H
+
+#include <core/vector3.h>
+#include <memory>
+#include <list>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <functional>
+
+//! @addtogroup IonicSystem
+//! @{
+//! @file ProjectorCache.h Least-recently-used cache of nonlocal projectors (and DFT+U orbitals) shared by all species
+
+class ColumnBundle;
+class SpeciesInfo;
+class Basis;
+class GridInfo;
+
+//! Least-recently-used cache of nonlocal projectors (identified by species, k-point and basis),
+//! shared by all species so that a single memory budget applies to all projectors.
+//! Other per-species, per-k-point functions (such as the DFT+U orbitals) are cached under a non-zero kind.
+class ProjectorCache
+{
+public:
+	static const int KindProjectors = 0; //!< kind of entries holding nonlocal projectors (computed by SpeciesInfo::getV)
+	size_t maxBytes; //!< memory budget for cached projectors (0 = unlimited)
+	
+	ProjectorCache();
+	
+	//! Get cached projectors of species sp at k-point k with basis (null if not cached), and mark them most recently used.
+	//! Projectors cached for an equivalent basis at the same k (eg. for the other spin channel) are also returned.
+	std::shared_ptr<ColumnBundle> find(const SpeciesInfo* sp, const vector3<>& k, const Basis* basis, int kind=KindProjectors);
+	
+	//! Cache projectors V of species sp for the k-point and basis, evicting least recently used projectors to stay within the budget
+	//! (V is not cached if it alone exceeds the budget)
+	void insert(const SpeciesInfo* sp, const vector3<>& k, const Basis* basis, std::shared_ptr<ColumnBundle> V, int kind=KindProjectors);
+	
+	bool fits(size_t nBytes) const { return (!maxBytes) || nBytes<=maxBytes; } //!< whether projectors of nBytes can be cached at all
+	void clear(const SpeciesInfo* sp=0, int kind=-1); //!< remove cached entries of one species (or of all species if sp is null), of one kind (or of all kinds if kind < 0)
+	void update(const SpeciesInfo* sp, const std::function<void(ColumnBundle&)>& func, int kind=KindProjectors); //!< apply func to each cached entry of species sp and kind in place (eg. to recompute columns of moved atoms)
+	void print() const; //!< report usage and hit statistics (from all processes)
+	
+private:
+	typedef std::tuple<const SpeciesInfo*, int, vector3<>, const Basis*> Key; //species, kind, k and basis
+	struct Entry
+	{	Key key;
+		std::shared_ptr<ColumnBundle> V;
+		const GridInfo* gInfo; size_t nbasis; uint64_t basisHash; //identify equivalent bases (without accessing the basis, which may no longer exist)
+		size_t nBytes;
+		bool onGpu; //whether V is resident on the GPU (at the time of insertion)
+	};
+	std::list<Entry> entries; //in order of most to least recently used
+	std::map<Key, std::list<Entry>::iterator> index; //lookup of entries by key
+	size_t nBytes, nBytesGpu; //current cache size (total and GPU-resident)
+	size_t nHits, nShared, nMisses, nEvicted; //statistics (nShared counts hits for equivalent bases)
+	mutable std::mutex lock;
+	
+	void erase(std::list<Entry>::iterator iter);
+};
+
+//! @}
+#endif // JDFTX_ELECTRONIC_PROJECTORCACHE_H
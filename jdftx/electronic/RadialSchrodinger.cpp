@@ -19,6 +19,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <electronic/RadialSchrodinger.h>
 #include <core/Util.h>
+#include <core/Thread.h>
 #include <stack>
 #include <cfloat>
 #include <algorithm>
@@ -120,39 +121,63 @@ double RadialSchrodinger::compute(const std::vector< std::vector<double> >& F, O
 	if(outputs.tau) { outputs.tau->assign(rArr.size(), 0.); tau = &outputs.tau->front(); }
 	if(outputs.z) outputs.z->assign(F.size(), std::vector< std::vector<complex> >());
 	if(outputs.E) outputs.E->assign(F.size(), std::vector<double>());
-	//Loop over all occupied states:
-	std::vector<complex> z(rArr.size()); //space for single eigenfunction
-	double Etot = 0.;
-	for(size_t l=0; l<F.size(); l++)
-		for(size_t nNodes=0; nNodes<F[l].size(); nNodes++)
-		{	double f = F[l][nNodes];
-			double E = getEig(l,nNodes);
-			solveSchEqn(l, E, &z.front());
-			//Accumulate orbital-summed quantities:
-			Etot += f*E;
-			for(size_t i=0; i<rArr.size(); i++)
-			{	//Radial wavefunction and its derivative:
-				double u = z[i].real(), uPrime = z[i].imag();
-				double r = rArr[i], rl = pow(r,l), rlm1 = l ? pow(r,l-1) : 0.; //r^(l-1) terms are non-zero only for l>0
-				double R = rl*u, Rbyr = rlm1*u;
-				double Rprime = rl*uPrime + l*Rbyr;
-				//Compute required quantities:
-				if(n) n[i] += f*(R*R);
-				if(Dn) Dn[i] += f*(2*R*Rprime);
-				if(tau) tau[i] += 0.5*f*(Rprime*Rprime + l*(l+1)*Rbyr*Rbyr);
+	//Size the per-l caches up front, so that different l's share no mutable state:
+	size_t nL = F.size();
+	if(nodesEmin.size()<nL) nodesEmin.resize(nL);
+	if(nodesEmax.size()<nL) nodesEmax.resize(nL);
+	if(cachedEerr.size()<nL) cachedEerr.resize(nL);
+	if(cachedE.size()<nL) cachedE.resize(nL);
+	if(wArr.size()<nL) wArr.resize(nL);
+	//Solve each angular momentum channel in parallel, accumulating into per-l buffers:
+	std::vector<double> Etot_l(nL, 0.);
+	std::vector< std::vector<double> > n_l(n ? nL : 0), Dn_l(Dn ? nL : 0), tau_l(tau ? nL : 0);
+	auto computeChannels = [&](size_t lStart, size_t lStop)
+	{	std::vector<complex> z(rArr.size()); //space for single eigenfunction
+		for(size_t l=lStart; l<lStop; l++)
+		{	double* nCur = n ? (n_l[l].assign(rArr.size(), 0.), n_l[l].data()) : 0;
+			double* DnCur = Dn ? (Dn_l[l].assign(rArr.size(), 0.), Dn_l[l].data()) : 0;
+			double* tauCur = tau ? (tau_l[l].assign(rArr.size(), 0.), tau_l[l].data()) : 0;
+			for(size_t nNodes=0; nNodes<F[l].size(); nNodes++)
+			{	double f = F[l][nNodes];
+				double E = getEig(l,nNodes);
+				solveSchEqn(l, E, &z.front());
+				//Accumulate orbital-summed quantities:
+				Etot_l[l] += f*E;
+				for(size_t i=0; i<rArr.size(); i++)
+				{	//Radial wavefunction and its derivative:
+					double u = z[i].real(), uPrime = z[i].imag();
+					double r = rArr[i], rl = pow(r,l), rlm1 = l ? pow(r,l-1) : 0.; //r^(l-1) terms are non-zero only for l>0
+					double R = rl*u, Rbyr = rlm1*u;
+					double Rprime = rl*uPrime + l*Rbyr;
+					//Compute required quantities:
+					if(nCur) nCur[i] += f*(R*R);
+					if(DnCur) DnCur[i] += f*(2*R*Rprime);
+					if(tauCur) tauCur[i] += 0.5*f*(Rprime*Rprime + l*(l+1)*Rbyr*Rbyr);
+				}
+				//Store individual orbital quantities:
+				if(outputs.E) outputs.E->at(l).push_back(E);
+				if(outputs.z) outputs.z->at(l).push_back(z);
 			}
-			//Store individual orbital quantities:
-			if(outputs.E) outputs.E->at(l).push_back(E);
-			if(outputs.z) outputs.z->at(l).push_back(z);
 		}
+	};
+	threadLaunch(&computeChannels, nL);
+	//Collect in a fixed order of l (results independent of thread count):
+	double Etot = 0.;
+	for(size_t l=0; l<nL; l++)
+	{	Etot += Etot_l[l];
+		for(size_t i=0; i<rArr.size(); i++)
+		{	if(n) n[i] += n_l[l][i];
+			if(Dn) Dn[i] += Dn_l[l][i];
+			if(tau) tau[i] += tau_l[l][i];
+		}
+	}
 	return Etot;
 }
 
 
 // Inward and outward integration of the Schrodinger equation
 int RadialSchrodinger::solveSchEqn(int l, double E, complex* zSave)
-{	//Cached integration weights
-	static std::vector< std::vector<double> > wArr;
+{	//Cached integration weights:
 	if(size_t(l+1)>wArr.size()) wArr.resize(l+1);
 	if(!wArr[l].size())
 	{	wArr[l].resize(rArr.size());
@@ -357,7 +382,7 @@ double RadialSchrodinger::findE(int l, double Elo, double Ehi, double tol)
 // Find eigenvalue (and optionally eigenfunction) for a specific node count and angular momentum
 double RadialSchrodinger::getEig(int l, int nNodes, complex* zEvec)
 {	//Seed the node count maps:
-	if(size_t(l+1)>=nodesEmin.size() || !nodesEmin[l].size())
+	if(size_t(l+1)>nodesEmin.size() || !nodesEmin[l].size())
 	{	double Vmin = *std::min_element(Vsub.begin(),Vsub.end());
 		solveSchEqn(l, Vmin-0.5*Z*Z/((l+1)*(l+1))); //lower bound on eigenvalue
 		solveSchEqn(l, Vmin+1.); //typical energy range for eigenvalue spacing
@@ -71,6 +71,7 @@ private:
 	std::vector< std::map<int,double> > nodesEmin, nodesEmax; //!< min and max E so far recorded at a given node count, for each l.
 	std::vector< std::map<double,double> > cachedEerr; //!< Cached matching error for attempted E's for each l
 	std::vector< std::map<int,double> > cachedE; //!< Cached eigenvalues for each l and node count
+	std::vector< std::vector<double> > wArr; //!< Cached integration weights 4 pi r^(2l+2) dr for each l (per instance, since the grid differs between atoms)
 
 	//! Use complex arithmetic to represent the second order schrodinger equation
 	//!  Real(z) stores u(r) = r^(1-l) R(r) and Imag(z) stores u'(r)
@@ -91,6 +91,7 @@ void SCF::minimize()
 	//Backup electronic minimize params that are modified below:
 	double eMinThreshold = e.elecMinParams.energyDiffThreshold;
 	int eMinIterations = e.elecMinParams.nIterations;
+	ElecEigenAlgo eigenAlgo = e.cntrl.elecEigenAlgo;
 
 	//Compute energy for the initial guess
 	double E = eVars.elecEnergyAndGrad(e.ener, 0, 0, true); mpiWorld->bcast(E); //Compute energy (and ensure consistency to machine precision)
@@ -100,13 +101,16 @@ void SCF::minimize()
 	std::vector<double> extraThresh(1, sp.eigDiffThreshold);
 	Pulay<SCFvariable>::minimize(E, extraNames, extraThresh);
 	e.iInfo.augmentDensityGridGrad(e.eVars.Vscloc); //to make sure grid projections are compatible with final Vscloc
+	if(sp.historySaveFilename.length()) saveState(sp.historySaveFilename.c_str());
 	
 	//Restore electronic minimize params that were modified above:
 	e.elecMinParams.energyDiffThreshold = eMinThreshold;
 	e.elecMinParams.nIterations = eMinIterations;
+	e.cntrl.elecEigenAlgo = eigenAlgo;
 	
 	//Set auxiliary Hamiltonian equal to subspace Hamiltonian (used for fillings updates)
 	if(e.eInfo.fillingsUpdate == ElecInfo::FillingsHsub) eVars.Haux_eigs = eVars.Hsub_eigs;
+	e.dump.checkpointWait(); //the history writer of a pending checkpoint refers to this object
 }
 
 double SCF::sync(double x) const
@@ -117,6 +121,21 @@ double SCF::sync(double x) const
 double SCF::cycle(double dEprev, std::vector<double>& extraValues)
 {	const SCFparams& sp = e.scfParams;
 	
+	//Switch to double-precision transforms when sufficiently converged (in mixed-precision mode):
+	if(GridInfo::batchSinglePrecision && fabs(dEprev) < e.cntrl.mixedPrecisionThreshold)
+	{	GridInfo::batchSinglePrecision = false;
+		logPrintf("SCF: |dE| < %le: switching to double-precision wavefunction transforms.\n", e.cntrl.mixedPrecisionThreshold);
+	}
+	
+	//Switch to RMM-DIIS band refinement when sufficiently converged (if enabled):
+	if(sp.rmmDiisThreshold && e.cntrl.elecEigenAlgo!=ElecEigenRMMDIIS && fabs(dEprev) < sp.rmmDiisThreshold)
+	{	e.cntrl.elecEigenAlgo = ElecEigenRMMDIIS; //restored at the end of SCF::minimize
+		logPrintf("SCF: |dE| < %le: switching to RMM-DIIS band refinement.\n", sp.rmmDiisThreshold);
+	}
+	
+	//Adapt the number of bands to the current fillings (if enabled):
+	if(sp.bandFillThreshold && e.eInfo.fillingsUpdate==ElecInfo::FillingsHsub) adjustBands();
+	
 	//Cache required quantities:
 	std::vector<diagMatrix> eigsPrev = e.eVars.Hsub_eigs;
 	
@@ -138,7 +157,7 @@ double SCF::cycle(double dEprev, std::vector<double>& extraValues)
 }
 
 void SCF::report(int iter)
-{
+{	ManagedMemoryBase::reportIteration("SCF", iter);
 	if(e.cntrl.shouldPrintEigsFillings) print_Hsub_eigs(e);
 	if(e.cntrl.shouldPrintEcomponents) { logPrintf("\n"); e.ener.print(); logPrintf("\n"); }
 	logFlush();
@@ -151,6 +170,11 @@ void SCF::report(int iter)
 		saveState(fname.c_str());
 		logPrintf("done\n"); logFlush();
 	}
+	//--- background checkpoint, if enabled (including SCF history):
+	e.dump.checkpoint(iter, [this]()
+	{	auto snapshot = std::make_shared<StateSnapshot>(getStateSnapshot()); //serialized, so the background writer does not touch the GPU
+		return Dump::SnapshotWriter([this, snapshot](const char* fname) { return saveState(fname, *snapshot); });
+	});
 }
 
 
@@ -186,6 +210,24 @@ double SCF::dot(const SCFvariable& X, const SCFvariable& Y) const
 	return ret;
 }
 
+void SCF::dotMulti(const std::vector<SCFvariable>& X, const SCFvariable& Y, double* result) const
+{	std::fill(result, result+X.size(), 0.);
+	//Density and KE density (single pass over Y for all X):
+	std::vector<ScalarFieldArray> Xfield(X.size());
+	for(size_t j=0; j<X.size(); j++) Xfield[j] = X[j].n;
+	::dotMulti(Xfield, Y.n, result, e.gInfo.dV);
+	if(mixTau)
+	{	for(size_t j=0; j<X.size(); j++) Xfield[j] = X[j].tau;
+		::dotMulti(Xfield, Y.tau, result, e.gInfo.dV);
+	}
+	//Atomic density matrices:
+	if(e.eInfo.hasU)
+	{	for(size_t j=0; j<X.size(); j++)
+			for(size_t i=0; i<X[j].rhoAtom.size(); i++)
+				result[j] += dotc(X[j].rhoAtom[i],Y.rhoAtom[i]).real();
+	}
+}
+
 size_t SCF::variableSize() const
 {	size_t nDoubles = e.gInfo.nr * e.eVars.n.size() * (mixTau ? 2 : 1); //n and optionally tau
 	if(e.eInfo.hasU)
@@ -327,7 +369,8 @@ double SCF::eigDiffRMS(const std::vector<diagMatrix>& eigs1, const std::vector<d
 {	double rmsNum=0., rmsDen=0.;
 	for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
 	{	double wq = e.eInfo.qnums[q].weight;
-		for(int b=0; b<e.eInfo.nBands; b++)
+		int nBands = std::min(eigs1[q].nRows(), eigs2[q].nRows()); //differ in the cycle where the band count changes (see adjustBands)
+		for(int b=0; b<nBands; b++)
 		{	double de = eigs1[q][b] - eigs2[q][b];
 			rmsNum += wq * de*de;
 			rmsDen += wq;
@@ -341,3 +384,24 @@ double SCF::eigDiffRMS(const std::vector<diagMatrix>& eigs1, const std::vector<d
 double SCF::eigDiffRMS(const std::vector<diagMatrix>& eigs1, const std::vector<diagMatrix>& eigs2) const
 {	return eigDiffRMS(eigs1, eigs2, e);
 }
+
+void SCF::adjustBands()
+{	const ElecInfo& eInfo = e.eInfo;
+	const SCFparams& sp = e.scfParams;
+	//Find the highest band filled above threshold in any state:
+	int nFilled = 1;
+	for(int q=eInfo.qStart; q<eInfo.qStop; q++)
+		for(int b=eInfo.nBands-1; b>=nFilled; b--)
+			if(e.eVars.F[q][b] > sp.bandFillThreshold)
+			{	nFilled = b+1;
+				break;
+			}
+	mpiWorld->allReduce(nFilled, MPIUtil::ReduceMax);
+	int nBuffer = std::max(2, int(ceil(sp.bandBufferFraction * nFilled)));
+	int nBandsTarget = nFilled + nBuffer;
+	//Grow as soon as the highest band is filled, but only shrink when well beyond the target (to avoid oscillating):
+	if(nFilled < eInfo.nBands && eInfo.nBands <= nBandsTarget + nBuffer) return;
+	logPrintf("SCF: %d bands filled above %lg: %s nBands from %d to %d.\n", nFilled, sp.bandFillThreshold,
+		(nBandsTarget > eInfo.nBands ? "increasing" : "reducing"), eInfo.nBands, nBandsTarget);
+	e.eVars.resizeBands(nBandsTarget);
+}
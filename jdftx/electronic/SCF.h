@@ -53,6 +53,7 @@ protected:
 	void report(int iter);
 	void axpy(double alpha, const SCFvariable& X, SCFvariable& Y) const;
 	double dot(const SCFvariable& X, const SCFvariable& Y) const;
+	void dotMulti(const std::vector<SCFvariable>& X, const SCFvariable& Y, double* result) const;
 	size_t variableSize() const;
 	void readVariable(SCFvariable&, FILE*) const;
 	void writeVariable(const SCFvariable&, FILE*) const;
@@ -67,6 +68,7 @@ private:
 	RealKernel kerkerMix, diisMetric; //!< convolution kernels for kerker preconditioning and the DIIS overlap metric
 	
 	double eigDiffRMS(const std::vector<diagMatrix>&, const std::vector<diagMatrix>&) const; //!< weighted RMS difference between two sets of eigenvalues
+	void adjustBands(); //!< adapt the number of bands to the fillings of the previous cycle (if SCFparams::bandFillThreshold is set)
 };
 
 //! @}
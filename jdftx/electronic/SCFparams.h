@@ -31,8 +31,12 @@ struct SCFparams : public PulayParams
 {
 	int nEigSteps; //!< number of steps of the eigenvalue solver per iteration (use elecMinParams.nIterations if 0)
 	double eigDiffThreshold; //!< convergence threshold on the RMS change of eigenvalues
+	double rmmDiisThreshold; //!< if non-zero, switch the eigensolver to RMM-DIIS band refinement once the energy change per cycle drops below this
+	double bandFillThreshold; //!< if non-zero, adapt nBands between cycles to keep the fillings of the highest band below this (see SCF::adjustBands)
+	double bandBufferFraction; //!< empty bands kept above the last significantly-filled one, as a fraction of the filled bands (at least 2)
 
 	string historyFilename; //!< Read SCF history in order to resume a previous run
+	string historySaveFilename; //!< If non-empty, save the SCF history here at the end of each SCF (so that a later SCF can resume from it, eg. in a potential scan)
 	
 	enum MixedVariable
 	{	MV_Density, //!< Mix electron density (n) and kinetic energy density (tau)
@@ -49,6 +53,9 @@ struct SCFparams : public PulayParams
 	SCFparams()
 	{	nEigSteps = 2; //for Davidson; the default for CG is 40 (and set by the command)
 		eigDiffThreshold = 1e-8;
+		rmmDiisThreshold = 0.;
+		bandFillThreshold = 0.;
+		bandBufferFraction = 0.1;
 		mixedVariable = MV_Density;
 		qKerker = 0.8;
 		qKappa = -1.;
@@ -27,16 +27,129 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/matrix.h>
 #include <core/LatticeUtils.h>
 #include <core/VectorField.h>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
 
+AtomPhases::AtomPhases(const vector3<int>& S, int nAtoms, const vector3<>* pos, const vector3<>& k) : S(S), nPerAtom(0)
+{	vector3<int> h;
+	for(int dir=0; dir<3; dir++)
+	{	h[dir] = S[dir]/2;
+		offset[dir] = nPerAtom + h[dir];
+		nPerAtom += 2*h[dir] + 1;
+	}
+	data.init(nAtoms * nPerAtom);
+	complex* t = data.data();
+	for(int atom=0; atom<nAtoms; atom++)
+	{	complex kPhase = cis((-2*M_PI)*dot(pos[atom], k)); //folded into the first direction's table
+		for(int dir=0; dir<3; dir++)
+			for(int iG=-h[dir]; iG<=h[dir]; iG++)
+				t[offset[dir]+iG] = cis((-2*M_PI)*iG*pos[atom][dir]) * (dir ? complex(1,0) : kPhase);
+		t += nPerAtom;
+	}
+}
+
+AtomPhaseTables AtomPhases::tables(int atomStart) const
+{	AtomPhaseTables t;
+	t.data = data.dataPref() + atomStart*nPerAtom;
+	t.offset = offset;
+	t.nPerAtom = nPerAtom;
+	return t;
+}
+
+RadialShells::RadialShells(const Basis& basis, const vector3<>& k) : GGT(basis.gInfo->GGT)
+{	std::vector<double> q(basis.nbasis);
+	const vector3<int>* iGarr = basis.iGarr.data();
+	for(size_t n=0; n<basis.nbasis; n++)
+		q[n] = sqrt(GGT.metric_length_squared(k + iGarr[n]));
+	init(q);
+}
+
+RadialShells::RadialShells(const GridInfo& gInfo) : GGT(gInfo.GGT)
+{	const double* Gsq = gInfo.getGsqTable();
+	std::vector<double> q(gInfo.nG);
+	for(int i=0; i<gInfo.nG; i++) q[i] = sqrt(Gsq[i]);
+	init(q);
+}
+
+void RadialShells::init(const std::vector<double>& q)
+{	const double tol = 1e-12; //relative tolerance for equal lengths
+	std::vector<int> order(q.size());
+	for(size_t i=0; i<q.size(); i++) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int i, int j) { return q[i] < q[j]; });
+	shellIndex.init(q.size());
+	int* index = shellIndex.data();
+	qShell.clear();
+	for(int i: order)
+	{	if(!qShell.size() || q[i] > qShell.back()*(1.+tol) + tol)
+			qShell.push_back(q[i]);
+		index[i] = qShell.size()-1;
+	}
+}
+
+std::shared_ptr<RadialShells> RadialShells::get(const Basis& basis, const vector3<>& k)
+{	std::shared_ptr<RadialShells>& shells = basis.radialShells[k];
+	if(!shells || !(shells->GGT == basis.gInfo->GGT))
+		shells = std::make_shared<RadialShells>(basis, k);
+	return shells;
+}
+
+std::shared_ptr<RadialShells> RadialShells::get(const GridInfo& gInfo)
+{	static std::map<const GridInfo*, std::shared_ptr<RadialShells>> cache;
+	std::shared_ptr<RadialShells>& shells = cache[&gInfo];
+	if(!shells || !(shells->GGT == gInfo.GGT) || shells->shellIndex.nData() != size_t(gInfo.nG))
+		shells = std::make_shared<RadialShells>(gInfo); //shells depend only on GGT and S, so a reused address is also handled
+	return shells;
+}
+
+RadialShellValues RadialShells::evaluate(const RadialFunctionG& f, ManagedArray<double>& values) const
+{	values.init(qShell.size());
+	double* v = values.data();
+	for(size_t s=0; s<qShell.size(); s++)
+		v[s] = f(qShell[s]);
+	RadialShellValues result;
+	result.shellIndex = shellIndex.dataPref();
+	result.values = values.dataPref();
+	return result;
+}
+
+const AtomPhases& SpeciesInfo::getAtomPhases() const
+{	if(!atomPhases || !(atomPhases->getS() == e->gInfo.S))
+		atomPhases = std::make_shared<AtomPhases>(e->gInfo.S, atpos.size(), atpos.data());
+	return *atomPhases;
+}
+
 void SpeciesInfo::sync_atpos()
-{	if(!atpos.size()) return; //unused species
+{	atomPhases = 0; //recomputed on next use
+	if(!atpos.size()) return; //unused species
+	//Find atoms that moved since the previous update:
+	std::vector<int> moved;
+	bool sameCount = (atposManaged.nData() == atpos.size());
+	if(sameCount)
+	{	const vector3<>* atposPrev = atposManaged.data();
+		for(int atom=0; atom<int(atpos.size()); atom++)
+			if((atpos[atom] - atposPrev[atom]).length_squared())
+				moved.push_back(atom);
+	}
 	//Update managed version of atpos:
 	atposManaged = ManagedArray<vector3<>>(atpos); //it will get transferred to GPU if/when necessary
-	//Invalidate cached projectors:
-	cachedV.clear();
+	//Update cached projectors, recomputing only the columns of moved atoms when few of them moved:
+	if(!sameCount || 2*moved.size() > atpos.size())
+		e->iInfo.projectorCache.clear(this);
+	else if(moved.size())
+	{	//DFT+U orbitals (cached with kind 1+iU, see getOpsiU) are recomputed on demand:
+		for(int iU=0; iU<int(plusU.size()); iU++)
+			e->iInfo.projectorCache.clear(this, ProjectorCache::KindProjectors + 1 + iU);
+		int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+		e->iInfo.projectorCache.update(this, [&](ColumnBundle& V)
+		{	ColumnBundle Vatom = V.similar(nProj);
+			for(int atom: moved)
+			{	computeV(atom, atom+1, Vatom);
+				V.setSub(atom*nProj, Vatom);
+			}
+		});
+	}
 }
 
 inline bool isParallel(vector3<> x, vector3<> y)
@@ -127,20 +240,45 @@ void axpy(double alpha, const RadialFunctionR& X, RadialFunctionR& Y);
 
 const std::vector<string>& getPseudopotentialPrefixes(); //implemented in ion_species.cpp
 
+//Read the entire contents of a file on the head process and broadcast it to all processes.
+//Returns false (on all processes) if the file could not be opened.
+//This way, files needed by every process are read once, rather than by every process from a shared filesystem.
+static bool readFileBroadcast(const string& fname, string& contents)
+{	bool opened = false;
+	contents.clear();
+	if(mpiWorld->isHead())
+	{	FILE* fp = fopen(fname.c_str(), "rb");
+		if(fp)
+		{	opened = true;
+			char buf[65536]; size_t nRead;
+			while((nRead = fread(buf, 1, sizeof(buf), fp)))
+				contents.append(buf, nRead);
+			fclose(fp);
+		}
+	}
+	mpiWorld->bcast(opened);
+	if(opened) mpiWorld->bcast(contents);
+	return opened;
+}
+
 void SpeciesInfo::setup(const Everything &everything)
 {	e = &everything;
 	if(!atpos.size()) return; //unused species
 	
-	//Read pseudopotential
-	ifstream ifs;
-	const std::vector<string>& prefixes = getPseudopotentialPrefixes();
+	//Read pseudopotential (once, on head) and parse it from memory:
+	istringstream ifs;
 	string potfilenameFull; //full filename with prefix (if any)
-	for(const string& prefix: prefixes)
-	{	potfilenameFull = prefix + potfilename;
-		ifs.open(potfilenameFull.c_str());
-		if(ifs.is_open()) break;
+	{	const std::vector<string>& prefixes = getPseudopotentialPrefixes();
+		string potContents;
+		bool opened = false;
+		for(const string& prefix: prefixes)
+		{	potfilenameFull = prefix + potfilename;
+			opened = readFileBroadcast(potfilenameFull, potContents);
+			if(opened) break;
+		}
+		if(!opened) die("Can't open pseudopotential file '%s' for reading.\n", potfilename.c_str());
+		ifs.str(potContents);
 	}
-	if(!ifs.is_open()) die("Can't open pseudopotential file '%s' for reading.\n", potfilename.c_str());
 	logPrintf("\nReading pseudopotential file '%s':\n",potfilenameFull.c_str());
 	switch(pspFormat)
 	{	case Fhi: readFhi(ifs); break;
@@ -166,6 +304,9 @@ void SpeciesInfo::setup(const Everything &everything)
 	
 	//Pulay info:
 	setupPulay(); 
+	
+	//Real-space projectors (if enabled):
+	if(e->cntrl.realSpaceProjectorTol && VnlRadial.size()) setupRealSpaceProjectors();
 
 	//Check for augmentation:
 	if(Qint.size())
@@ -203,6 +344,7 @@ void SpeciesInfo::setup(const Everything &everything)
 		{	if(isRelativistic() && nSpinors != 2)
 				die("\nRelativistic pseudopotentials can only be used in noncollinear spin modes.\n");
 			MnlAll = zeroes(nProj,nProj);
+			MnlBlocks.clear();
 			if(Qint.size())
 				QintAll = zeroes(nProj,nProj);
 			if(isRelativistic())
@@ -228,12 +370,16 @@ void SpeciesInfo::setup(const Everything &everything)
 							(isRelativistic()
 								? (Vnl2j[l][ni]==Vnl2j[l][nj] ? flj : Zl) //enforce delta_{jj'}
 								: Il ));
+						if(isRelativistic() && Vnl2j[l][ni]==Vnl2j[l][nj])
+							MnlBlocks.push_back({iProj,iStop, jProj,jStop, MnlAll(iProj,iStop, jProj,jStop)});
 						if(Qint.size() && Qint[l]) //Note that f factor for Q is added below (since it contributes non-diagonally as well)
 							QintAll.set(iProj,iStop, jProj,jStop, Qint[l].data()[Qint[l].index(ni,nj)] * Il);
 						jProj = jStop;
 					}
 					iProj = iStop;
 				}
+				if(!isRelativistic() && iProj>lOffset) //all projectors of this l in one block
+					MnlBlocks.push_back({lOffset,iProj, lOffset,iProj, MnlAll(lOffset,iProj, lOffset,iProj)});
 				lOffset = iProj;
 			}
 			if(isRelativistic() && Qint.size())
@@ -394,13 +540,18 @@ void SpeciesInfo::updateLatticeDependent()
 		nCoreRadial.updateGmax(0, nGridLoc);
 		tauCoreRadial.updateGmax(0, nGridLoc);
 		for(auto& Qijl: Qradial) Qijl.second.updateGmax(Qijl.first.l, nGridLoc);
-		cachedV.clear(); //clear any cached projectors
+		e->iInfo.projectorCache.clear(this); //clear any cached projectors
 	}
 	
-	//Update Qradial indices, matrix and nagIndex if not previously init'd, or if R has changed:
-	if(Qint.size() && (Rchanged || !QradialMat))
-	{	int nCoeffHlf = (Qradial.cbegin()->second.nCoeff+1)/2; //pack real radial functions into complex numbers
-		int nCoeff = 2*nCoeffHlf;
+	//Update Qradial indices, matrix and nagIndex if not previously init'd, or if the radial functions were resampled:
+	int nCoeffHlf = Qint.size() ? (Qradial.cbegin()->second.nCoeff+1)/2 : 0; //pack real radial functions into complex numbers
+	int nCoeff = 2*nCoeffHlf;
+	if(Qint.size() && QradialMat && QradialMat.nRows()==nCoeffHlf)
+	{	//Radial functions unchanged: only the binning of G-vectors by length depends on R
+		if(Rchanged) updateNagIndex(gInfo.S, gInfo.G, gInfo.iGstart, gInfo.iGstop, nCoeff, 1./gInfo.dGradial, nagIndex.data(), nagIndexPtr.data());
+	}
+	else if(Qint.size())
+	{
 		//Qradial:
 		QradialMat = zeroes(nCoeffHlf, Qradial.size());
 		double* QradialMatData = (double*)QradialMat.dataPref();
@@ -410,6 +561,29 @@ void SpeciesInfo::updateLatticeDependent()
 			callPref(eblas_copy)(QradialMatData+index*nCoeff, Qijl.second.coeffPref(), Qijl.second.nCoeff);
 			index++;
 		}
+		//Flattened augmentation terms (avoids Ylm product expansions and Qradial lookups per atom and state):
+		augmentTerms.clear();
+		int i1 = 0;
+		for(int l1=0; l1<int(VnlRadial.size()); l1++)
+		for(int p1=0; p1<int(VnlRadial[l1].size()); p1++)
+		for(int m1=-l1; m1<=l1; m1++)
+		{	int i2 = 0;
+			for(int l2=0; l2<int(VnlRadial.size()); l2++)
+			for(int p2=0; p2<int(VnlRadial[l2].size()); p2++)
+			for(int m2=-l2; m2<=l2; m2++)
+			{	if(i2<=i1)
+				{	for(const YlmProdTerm& term: expandYlmProd(l1,m1, l2,m2))
+					{	QijIndex qIndex = { l1, p1, l2, p2, term.l };
+						auto Qijl = Qradial.find(qIndex);
+						if(Qijl==Qradial.end()) continue; //no entry at this l
+						AugmentTerm aTerm = { i1, i2, Qijl->first.index, term.l*(term.l+1) + term.m, term.coeff, cis(0.5*M_PI*(l2-l1)) };
+						augmentTerms.push_back(aTerm);
+					}
+				}
+				i2++;
+			}
+			i1++;
+		}
 		//nagIndex:
 		nagIndex.init(gInfo.iGstop-gInfo.iGstart);
 		nagIndexPtr.init(nCoeff+1);
@@ -431,8 +605,9 @@ void SpeciesInfo::setupPulay()
 {	
 	if(pulayfilename == "none") return;
 	
-	ifstream ifs(pulayfilename.c_str());
-	if(!ifs.is_open()) die("  Can't open pulay file %s for reading.\n", pulayfilename.c_str());
+	string pulayContents;
+	if(!readFileBroadcast(pulayfilename, pulayContents)) die("  Can't open pulay file %s for reading.\n", pulayfilename.c_str());
+	istringstream ifs(pulayContents);
 	logPrintf("  Reading pulay file %s ... ", pulayfilename.c_str());
 	istringstream iss;
 	int nEcuts; istringstream(getLineIgnoringComments(ifs)) >> nEcuts;
@@ -18,6 +18,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 -------------------------------------------------------------------*/
 
 #include <electronic/SpeciesInfo_internal.h>
+#include <core/Operators_internal.h>
 #include <core/GpuKernelUtils.h>
 #include <core/LoopMacros.h>
 
@@ -29,57 +30,77 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 //Calculate non-local pseudopotential projector (or its k derivatives)
 template<int l, int m> __global__
 void Vnl_kernel(int nbasis, int atomStride, int nAtoms, vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG VnlRadial, complex* V)
+	const matrix3<> G, const AtomPhaseTables phases, const RadialFunctionG VnlRadial, const RadialShellValues shells, complex* V)
 {	int n = kernelIndex1D();
-	if(n<nbasis) Vnl_calc<l,m>(n, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, V);
+	if(n<nbasis) Vnl_calc<l,m>(n, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, shells, V);
 }
 template<int l, int m> __global__
 void VnlPrime_kernel(int nbasis, int atomStride, int nAtoms, vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG VnlRadial,
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables phases, const RadialFunctionG VnlRadial,
 	const vector3<> dir, const vector3<> RTdir, complex* V)
 {	int n = kernelIndex1D();
-	if(n<nbasis) VnlPrime_calc<l,m>(n, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, dir, RTdir, V);
+	if(n<nbasis) VnlPrime_calc<l,m>(n, atomStride, nAtoms, k, iGarr, G, pos, phases, VnlRadial, dir, RTdir, V);
 }
 template<int l, int m>
 void Vnl_gpu(int nbasis, int atomStride, int nAtoms, vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* V, const vector3<>* derivDir)
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V,
+	const vector3<>* derivDir, const RadialShellValues& shells)
 {	if(derivDir) //derivative w.r.t Cartesian k
 	{	const vector3<> RTdir = (2*M_PI)*(*derivDir * inv(G));
 		GpuLaunchConfig1D glc(VnlPrime_kernel<l,m>, nbasis);
-		VnlPrime_kernel<l,m><<<glc.nBlocks,glc.nPerBlock>>>(nbasis, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, *derivDir, RTdir, V);
+		VnlPrime_kernel<l,m><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, atomStride, nAtoms, k, iGarr, G, pos, phases, VnlRadial, *derivDir, RTdir, V);
 		gpuErrorCheck();
 	}
 	else //value
 	{	GpuLaunchConfig1D glc(Vnl_kernel<l,m>, nbasis);
-		Vnl_kernel<l,m><<<glc.nBlocks,glc.nPerBlock>>>(nbasis, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, V);
+		Vnl_kernel<l,m><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, shells, V);
 		gpuErrorCheck();
 	}
 }
 void Vnl_gpu(int nbasis, int atomStride, int nAtoms, int l, int m, vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* V, const vector3<>* derivDir)
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V,
+	const vector3<>* derivDir, const RadialShellValues& shells)
 {
-	SwitchTemplate_lm(l,m, Vnl_gpu, (nbasis, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, V, derivDir) )
+	SwitchTemplate_lm(l,m, Vnl_gpu, (nbasis, atomStride, nAtoms, k, iGarr, G, pos, phases, VnlRadial, V, derivDir, shells) )
+}
+
+template<int l> __global__
+void VnlAll_kernel(int nbasis, int mStride, int atomStride, int nAtoms, vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables phases, const RadialFunctionG VnlRadial, const RadialShellValues shells, complex* V)
+{	int n = kernelIndex1D();
+	if(n<nbasis) VnlAll_calc<l>(n, mStride, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, shells, V);
+}
+template<int l>
+void VnlAll_gpu(int nbasis, int mStride, int atomStride, int nAtoms, vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V, const RadialShellValues& shells)
+{	GpuLaunchConfig1D glc(VnlAll_kernel<l>, nbasis);
+	VnlAll_kernel<l><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nbasis, mStride, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, shells, V);
+	gpuErrorCheck();
+}
+void VnlAll_gpu(int nbasis, int mStride, int atomStride, int nAtoms, int l, vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V, const RadialShellValues& shells)
+{	SwitchTemplate_l(l, VnlAll_gpu, (nbasis, mStride, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, V, shells) )
 }
 
 
 //Augment electron density by spherical functions
 template<int Nlm> __global__ void nAugment_kernel(int zBlock, const vector3<int> S, const matrix3<> G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<> atpos, complex* n)
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
 {	COMPUTE_halfGindices
 	if(i<iGstart || i>=iGstop) return;
-	nAugment_calc<Nlm>(i, iG, G, nCoeff, dGinv, nRadial, atpos, n);
+	nAugment_calc<Nlm>(i, iG, G, nCoeff, dGinv, nRadial, nAtoms, atpos, n);
 }
 template<int Nlm> void nAugment_gpu(const vector3<int> S, const matrix3<>& G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n)
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
 {	GpuLaunchConfigHalf3D glc(nAugment_kernel<Nlm>, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		nAugment_kernel<Nlm><<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, iGstart, iGstop, nCoeff, dGinv, nRadial, atpos, n);
+		nAugment_kernel<Nlm><<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, iGstart, iGstop, nCoeff, dGinv, nRadial, nAtoms, atpos, n);
 	gpuErrorCheck();
 }
 void nAugment_gpu(int Nlm, const vector3<int> S, const matrix3<>& G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n)
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
 {
-	SwitchTemplate_Nlm(Nlm, nAugment_gpu, (S, G, iGstart, iGstop, nCoeff, dGinv, nRadial, atpos, n) )
+	SwitchTemplate_Nlm(Nlm, nAugment_gpu, (S, G, iGstart, iGstop, nCoeff, dGinv, nRadial, nAtoms, atpos, n) )
 }
 
 
@@ -125,11 +146,11 @@ template<int Nlm> void nAugmentGrad_gpu(const vector3<int> S, const matrix3<>& G
 	cudaMemset(E_nRadialTemp, 0, sizeof(double)*nCoeff*Nlm*8);
 	gpuErrorCheck();
 	//Stage 1: calculate with the scattered accumulate to E_nRadial
-	nAugmentGrad_kernel<Nlm><<<nBlocks,nPerBlock,sharedMemPerThread*nPerBlock>>>(S, G, nCoeff, dGinv, nRadial, atpos, ccE_n, E_nRadialTemp, E_atpos, nagIndex, nagIndexPtr);
+	nAugmentGrad_kernel<Nlm><<<nBlocks, nPerBlock, sharedMemPerThread*nPerBlock, gpuStream>>>(S, G, nCoeff, dGinv, nRadial, atpos, ccE_n, E_nRadialTemp, E_atpos, nagIndex, nagIndexPtr);
 	gpuErrorCheck();
 	//Stage 2: collect from E_nRadialTemp to E_nRadial
 	GpuLaunchConfig1D glc(nAugmentGrad_collectKernel, nCoeff*Nlm);
-	nAugmentGrad_collectKernel<<<glc.nBlocks,glc.nPerBlock>>>(nCoeff*Nlm, E_nRadialTemp, E_nRadial);
+	nAugmentGrad_collectKernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nCoeff*Nlm, E_nRadialTemp, E_nRadial);
 	gpuErrorCheck();
 	//Cleanup:
 	cudaFree(E_nRadialTemp);
@@ -144,14 +165,14 @@ void nAugmentGrad_gpu(int Nlm, const vector3<int> S, const matrix3<>& G,
 
 //Structure factor
 __global__
-void getSG_kernel(int zBlock, const vector3<int> S, int nAtoms, const vector3<>* atpos, double invVol, complex* SG)
+void getSG_kernel(int zBlock, const vector3<int> S, int nAtoms, const AtomPhaseTables phases, double invVol, complex* SG)
 {	COMPUTE_halfGindices
-	SG[i] = invVol * getSG_calc(iG, nAtoms, atpos);
+	SG[i] = invVol * getSG_calc(iG, nAtoms, phases);
 }
-void getSG_gpu(const vector3<int> S, int nAtoms, const vector3<>* atpos, double invVol, complex* SG)
+void getSG_gpu(const vector3<int> S, int nAtoms, const AtomPhaseTables& phases, double invVol, complex* SG)
 {	GpuLaunchConfigHalf3D glc(getSG_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		getSG_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, nAtoms, atpos, invVol, SG);
+		getSG_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, nAtoms, phases, invVol, SG);
 	gpuErrorCheck();
 }
 
@@ -159,25 +180,25 @@ void getSG_gpu(const vector3<int> S, int nAtoms, const vector3<>* atpos, double
 __global__
 void updateLocal_kernel(int zBlock, const vector3<int> S, const matrix3<> GGT,
 	complex *Vlocps,  complex *rhoIon, complex *nChargeball, complex *nCore, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG VlocRadial,
-	double Z, const RadialFunctionG nCoreRadial, const RadialFunctionG tauCoreRadial,
+	int nAtoms, const AtomPhaseTables phases, double invVol, const RadialShellValues VlocShells,
+	double Z, const RadialShellValues nCoreShells, const RadialShellValues tauCoreShells,
 	double Zchargeball, double wChargeball)
 {
 	COMPUTE_halfGindices
 	updateLocal_calc(i, iG, GGT, Vlocps, rhoIon, nChargeball,
-		nCore, tauCore, nAtoms, atpos, invVol, VlocRadial,
-		Z, nCoreRadial, tauCoreRadial, Zchargeball, wChargeball);
+		nCore, tauCore, nAtoms, phases, invVol, VlocShells,
+		Z, nCoreShells, tauCoreShells, Zchargeball, wChargeball);
 }
 void updateLocal_gpu(const vector3<int> S, const matrix3<> GGT,
 	complex *Vlocps,  complex *rhoIon, complex *nChargeball, complex *nCore, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG& VlocRadial,
-	double Z, const RadialFunctionG& nCoreRadial, const RadialFunctionG& tauCoreRadial,
+	int nAtoms, const AtomPhaseTables& phases, double invVol, const RadialShellValues& VlocShells,
+	double Z, const RadialShellValues& nCoreShells, const RadialShellValues& tauCoreShells,
 	double Zchargeball, double wChargeball)
 {	GpuLaunchConfigHalf3D glc(updateLocal_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		updateLocal_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT, Vlocps, rhoIon, nChargeball,
-			nCore, tauCore, nAtoms, atpos, invVol, VlocRadial,
-			Z, nCoreRadial, tauCoreRadial, Zchargeball, wChargeball);
+		updateLocal_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT, Vlocps, rhoIon, nChargeball,
+			nCore, tauCore, nAtoms, phases, invVol, VlocShells,
+			Z, nCoreShells, tauCoreShells, Zchargeball, wChargeball);
 	gpuErrorCheck();
 }
 
@@ -203,7 +224,7 @@ void gradLocalToSG_gpu(const vector3<int> S, const matrix3<> GGT,
 	double Zchargeball, double wChargeball)
 {	GpuLaunchConfigHalf3D glc(gradLocalToSG_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		gradLocalToSG_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, GGT,
+		gradLocalToSG_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, GGT,
 			ccgrad_Vlocps, ccgrad_rhoIon, ccgrad_nChargeball,
 			ccgrad_nCore, ccgrad_tauCore, ccgrad_SG, VlocRadial, Z,
 			nCoreRadial, tauCoreRadial, Zchargeball, wChargeball);
@@ -222,6 +243,6 @@ void gradSGtoAtpos_gpu(const vector3<int> S, const vector3<> atpos,
 	const complex* ccgrad_SG, vector3<complex*> grad_atpos)
 {	GpuLaunchConfigHalf3D glc(gradSGtoAtpos_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		gradSGtoAtpos_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, atpos, ccgrad_SG, grad_atpos);
+		gradSGtoAtpos_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, atpos, ccgrad_SG, grad_atpos);
 	gpuErrorCheck();
 }
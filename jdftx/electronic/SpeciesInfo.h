@@ -31,10 +31,46 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 class ColumnBundle;
 class QuantumNumber;
 class Basis;
+struct AtomPhaseTables;
+struct RadialShellValues;
 
 //! @addtogroup IonicSystem
 //! @{
 
+//! Separable structure factor phase tables of a set of atoms covering |iG[dir]| <= S[dir]/2 (at an optional k),
+//! computed once in O(nAtoms sum(S)) so that each exp(-2 pi i (k+iG).x) costs two complex multiplies (see AtomPhaseTables)
+class AtomPhases
+{
+public:
+	AtomPhases(const vector3<int>& S, int nAtoms, const vector3<>* pos, const vector3<>& k=vector3<>());
+	AtomPhaseTables tables(int atomStart=0) const; //!< tables of atoms from atomStart onwards, in the preferred memory space
+	const vector3<int>& getS() const { return S; } //!< sample counts of the grid the tables cover
+private:
+	vector3<int> S, offset;
+	int nPerAtom;
+	ManagedArray<complex> data;
+};
+
+//! Distinct lengths |k+G| (shells) of the G-vectors of a basis, or of the half G-space of a grid (in the order of the
+//! half G-space loops), so that radial functions are evaluated once per shell and broadcast (see RadialShellValues)
+class RadialShells
+{
+public:
+	RadialShells(const Basis& basis, const vector3<>& k);
+	RadialShells(const GridInfo& gInfo);
+	static std::shared_ptr<RadialShells> get(const Basis& basis, const vector3<>& k); //!< shells of basis at k, cached in the basis until the lattice changes
+	static std::shared_ptr<RadialShells> get(const GridInfo& gInfo); //!< shells of the half G-space of gInfo, cached until its lattice changes
+	
+	//! Evaluate f at each shell into values, and return a view (in the preferred memory space) valid while both exist
+	RadialShellValues evaluate(const RadialFunctionG& f, ManagedArray<double>& values) const;
+	size_t nShells() const { return qShell.size(); }
+private:
+	matrix3<> GGT; //metric for which the shells were identified
+	std::vector<double> qShell; //length of each shell
+	ManagedArray<int> shellIndex; //shell of each G-vector
+	void init(const std::vector<double>& q); //identify shells given the length of each G-vector
+};
+
 //! Pseudopotential for a species of ions, and atom positions and other properties for that species
 class SpeciesInfo
 {
@@ -50,7 +86,8 @@ public:
 	std::vector<vector3<> > atpos; //!< array of atomic positions of this species
 	std::vector<vector3<> > velocities; //!< array of atomic velocities (null unless running MD) in lattice coordinates
 	ManagedArray<vector3<>> atposManaged; //!< managed copy of atpos accessed from operator code (for auto cpu/gpu transfers)
-	void sync_atpos(); //!< update changes in atpos; call whenever atpos is changed (this will update atposManaged and invalidate cached projectors, if any)
+	void sync_atpos(); //!< update changes in atpos; call whenever atpos is changed (this will update atposManaged and the columns of moved atoms in cached projectors, if any)
+	const AtomPhases& getAtomPhases() const; //!< structure factor phase tables of atpos on e->gInfo (computed once per sync_atpos and shared by the G-space local quantities)
 	
 	double dE_dnG; //!< Derivative of [total energy per atom] w.r.t [nPlanewaves per unit volume] (for Pulay corrections)
 	double mass; //!< ionic mass (currently unused)	
@@ -94,6 +131,14 @@ public:
 	std::shared_ptr<ColumnBundle> getV(const ColumnBundle& Cq, const vector3<>* derivDir=0) const;
 	int nProjectors() const { return MnlAll.nRows() * atpos.size(); } //!< total number of projectors for all atoms in this species (number of columns in result of getV)
 	
+	//! Get projections V^Cq on all projectors of this species: uses getV, or builds the projectors
+	//! on the fly in blocks of atoms fused with the product if enabled (see command cache-projectors),
+	//! or applies them in real space if enabled (see command realspace-projectors)
+	matrix getVdagC(const ColumnBundle& Cq) const;
+	
+	//! Accumulate V * M to HCq, with projectors V at the k-point and basis of HCq (using getV, on the fly or in real space as in getVdagC)
+	void accumV(const matrix& M, ColumnBundle& HCq) const;
+	
 	//! Return non-local energy for this species and quantum number q and optionally accumulate
 	//! projected electronic gradient in HVdagCq (if non-null)
 	double EnlAndGrad(const QuantumNumber& qnum, const diagMatrix& Fq, const matrix& VdagCq, matrix& HVdagCq) const;
@@ -107,6 +152,10 @@ public:
 	void augmentDensitySpherical(const QuantumNumber& qnum, const diagMatrix& Fq, const matrix& VdagCq);
 	//! Accumulate the spherical augmentation functions nAug to the grid electron density (call only once, after augmentDensitySpherical on all k-points)
 	void augmentDensityGrid(ScalarFieldArray& n) const;
+	//! Sum nAug over processes in preparation for augmentDensityGrid(n,s); if async, one non-blocking reduction is started per spin channel
+	void augmentDensityReduce(bool async=false);
+	//! Accumulate spin channel s of nAug to the grid electron density (call after augmentDensityReduce; waits for that channel's reduction if needed)
+	void augmentDensityGrid(ScalarFieldArray& n, int s);
 	
 	//! Gradient propagation corresponding to augmentDensityGrid (stores intermediate spherical function results to E_nAug; call only once) 
 	void augmentDensityGridGrad(const ScalarFieldArray& E_n, std::vector<vector3<> >* forces=0);
@@ -135,9 +184,11 @@ public:
 	int atomicOrbitalOffset(unsigned iAtom, unsigned n, int l, int m, int s) const; //!< offset of specified atomic orbital in output of current species (when not using the fixed n and l version)
 		//!< s is 0/1 for up/dn spinors in non-relativistic case, s=0/1 is for j=l+/-0.5 and mj=m+/-0.5 in relativistic case
 
-	//! Add contributions from this species to Vlocps, rhoIon, nChargeball and nCore/tauCore (if any)
+	//! Add contributions from this species to Vlocps, rhoIon, nChargeball and nCore/tauCore (if any).
+	//! If incremental, only add the change in contributions of atoms that moved since the previous call (see nMovedLocal)
 	void updateLocal(ScalarFieldTilde& Vlocps, ScalarFieldTilde& rhoIon, ScalarFieldTilde& nChargeball,
-		ScalarFieldTilde& nCore, ScalarFieldTilde& tauCore) const; 
+		ScalarFieldTilde& nCore, ScalarFieldTilde& tauCore, bool incremental=false) const; 
+	int nMovedLocal() const; //!< number of atoms moved since the previous updateLocal (-1 if unavailable, i.e. before the first call or if the number of atoms changed)
 	
 	//! Return the local forces (due to Vlocps, rhoIon, nChargeball and nCore/tauCore)
 	std::vector< vector3<> > getLocalForces(const ScalarFieldTilde& ccgrad_Vlocps, const ScalarFieldTilde& ccgrad_rhoIon,
@@ -150,6 +201,8 @@ public:
 	static matrix getYlmToSpinAngleMatrix(int l, int j2); //!< Get the ((2l+1)*2)x(j2+1) matrix that transforms the Ylm+spin to the spin-angle functions, where j2=2*j with j = l+/-0.5
 	static matrix getYlmOverlapMatrix(int l, int j2); //!< Get the ((2l+1)*2)x((2l+1)*2) overlap matrix of the spin-spherical harmonics for total angular momentum j (note j2=2*j)
 private:
+	mutable std::vector<vector3<>> atposLocal; //!< atomic positions at the previous updateLocal
+	mutable std::shared_ptr<AtomPhases> atomPhases; //!< cached result of getAtomPhases (reset by sync_atpos)
 	matrix3<> Rprev; void updateLatticeDependent(); //!< If Rprev differs from gInfo.R, update the lattice dependent quantities (such as the radial functions)
 
 	RadialFunctionG VlocRadial; //!< local pseudopotential
@@ -159,11 +212,26 @@ private:
 	std::vector< std::vector<RadialFunctionG> > VnlRadial; //!< non-local projectors (outer index l, inner index projetcor)
 	std::vector<matrix> Mnl; //!< nonlocal pseudopotential projector matrix (indexed by l)
 	matrix MnlAll; //!< block matrix containing Mnl for all l,m 
+	struct MnlBlock { int rowStart, rowStop, colStart, colStop; matrix M; }; //!< a non-zero block of MnlAll
+	std::vector<MnlBlock> MnlBlocks; //!< non-zero blocks of MnlAll: one per l, or one per pair of projectors with equal j for relativistic psps
+	matrix applyMnl(const matrix& X) const; //!< MnlAll * X (for X with nProj rows per atom-column), using only the non-zero blocks
 	
 	std::vector<matrix> Qint; //!< overlap augmentation matrix (indexed by l, empty if no augmentation)
 	matrix QintAll; //!< block matrix containing Qint for all l,m 
 	
-	std::map<std::pair<vector3<>,const Basis*>, std::shared_ptr<ColumnBundle> > cachedV; //cached projectors (identified by k-point and basis pointer)
+	//Nonlocal projectors (cached in IonInfo::projectorCache by getV):
+	void computeV(int atomStart, int atomStop, ColumnBundle& V, const vector3<>* derivDir=0) const; //compute projectors of atoms atomStart to atomStop-1 at the k-point and basis of V
+	bool projectOnTheFly(const ColumnBundle& Cq) const; //whether getVdagC and accumV should build projectors on the fly
+	
+	//DFT+U orbitals with O applied, for plusU[iU] at the k-point and basis of Cq (also cached in IonInfo::projectorCache, with kind 1+iU):
+	std::shared_ptr<ColumnBundle> getOpsiU(const ColumnBundle& Cq, int iU) const;
+	
+	//Real-space nonlocal projectors (optional alternative for getVdagC and accumV, implemented in SpeciesInfo_realSpace.cpp):
+	std::shared_ptr<struct RealSpaceProjectors> realSpaceProjectors; //radial functions (null if not in use)
+	void setupRealSpaceProjectors(); //filter radial functions and determine their extent
+	void getRealSpaceProjectors(const ColumnBundle& Cq, int atom, std::vector<int>& index, matrix& P) const; //projectors at grid points (index) near atom, at the k-point and grid of Cq
+	matrix getVdagC_realSpace(const ColumnBundle& Cq) const;
+	void accumV_realSpace(const matrix& M, ColumnBundle& HCq) const;
 	
 	struct QijIndex
 	{	int l1, p1; //!< Angular momentum and projector index for channel i
@@ -176,8 +244,19 @@ private:
 	};
 	std::map<QijIndex,RadialFunctionG> Qradial; //!< radial functions for density augmentation
 	matrix QradialMat; //!< matrix with all the radial augmentation functions in columns (ordered by index)
+	//! Contribution of one projector pair (i1,i2) on an atom to one spherical augmentation function
+	struct AugmentTerm
+	{	int i1, i2; //!< projector indices within an atom (i2 <= i1; rest obtained by symmetry)
+		int iQ; //!< index of radial function in Qradial
+		int lm; //!< combined index l*(l+1)+m of spherical harmonic
+		double coeff; //!< spherical harmonic product expansion coefficient
+		complex phase; //!< i^(l2-l1) for the pair
+	};
+	std::vector<AugmentTerm> augmentTerms; //!< flattened list of all non-zero augmentation terms (set up along with QradialMat)
 	matrix nAug; //!< intermediate electron density augmentation in the basis of Qradial functions (Flat array indexed by spin, atom number and then Qradial index)
 	matrix E_nAug; //!< Gradient w.r.t nAug (same layout)
+	matrix nAugTot; //!< nAug summed over processes (set by augmentDensityReduce)
+	std::vector<MPIUtil::Request> nAugRequests; //!< pending reductions of nAugTot by spin channel (empty if complete)
 	ManagedArray<uint64_t> nagIndex; ManagedArray<size_t> nagIndexPtr; //!< grid indices arranged by |G|, used for coordinating scattered accumulate in nAugmentGrad(_gpu)
 
 	std::vector<std::vector<RadialFunctionG> > psiRadial; //!< radial part of the atomic orbitals (outer index l, inner index shell)
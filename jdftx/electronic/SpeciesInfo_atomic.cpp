@@ -110,9 +110,9 @@ void SpeciesInfo::accumulateAtomicDensity(ScalarFieldTildeArray& nTilde) const
 		//Collect contributions for each direction with this magnitude:
 		for(const MomentDirection& Mdir: Mmag.Mdirs)
 		{	//Compute structure factor for atoms with current magnetization vector:
-			ManagedArray<vector3<>> atposCur(Mdir.atpos);
+			AtomPhases phasesCur(e->gInfo.S, Mdir.atpos.size(), Mdir.atpos.data());
 			ScalarFieldTilde SG; nullToZero(SG, e->gInfo);
-			callPref(getSG)(e->gInfo.S, Mdir.atpos.size(), atposCur.dataPref(), 1./e->gInfo.detR, SG->dataPref());
+			callPref(getSG)(e->gInfo.S, Mdir.atpos.size(), phasesCur.tables(), 1./e->gInfo.detR, SG->dataPref());
 			//Spin-densities in diagonal basis
 			std::vector<ScalarFieldTilde> nDiag;
 			for(const RadialFunctionG& nRad: nRadial)
@@ -145,12 +145,58 @@ void SpeciesInfo::accumulateAtomicPotential(ScalarFieldTilde& dTilde) const
 	getAtomPotential(dRadial);
 	//Gets tructure factor:
 	ScalarFieldTilde SG; nullToZero(SG, e->gInfo);
-	callPref(getSG)(e->gInfo.S, atpos.size(), atposManaged.dataPref(), 1./e->gInfo.detR, SG->dataPref());
+	callPref(getSG)(e->gInfo.S, atpos.size(), getAtomPhases().tables(), 1./e->gInfo.detR, SG->dataPref());
 	//Accumulate contrbutions:
 	dTilde += dRadial * SG;
 	dRadial.free();
 }
 
+//All atomic orbitals of one species, evaluated together at each basis vector so that the radial interpolation,
+//spherical harmonics and structure factors are shared between orbitals (rather than recomputed for each l,m)
+struct AtomicOrbitalsBatch
+{	int nbasis, nAtoms, nSpinCopies, lMax;
+	size_t colLength, atomStride;
+	vector3<> k; const vector3<int>* iGarr; matrix3<> G; const vector3<>* pos;
+	std::vector<const RadialFunctionG*> fRadial; std::vector<int> lRadial; //radial function and l of each (l,n) in column order
+	int nOrbitalsNoSpin; //number of orbitals per atom excluding spin copies
+	complex* psi; //start of first column
+};
+
+static void atomicOrbitalsBatch_thread(size_t iStart, size_t iStop, const AtomicOrbitalsBatch* b)
+{	std::vector<double> Y((b->lMax+1)*(b->lMax+1)), prefac(b->nOrbitalsNoSpin);
+	for(size_t i=iStart; i<iStop; i++)
+	{	vector3<> kpG = b->k + b->iGarr[i]; //k+G in reciprocal lattice coordinates
+		vector3<> qvec = kpG * b->G; //k+G in cartesian coordinates
+		double q = qvec.length();
+		vector3<> qhat = qvec * (q ? 1.0/q : 0.0);
+		for(int l=0; l<=b->lMax; l++)
+			for(int m=-l; m<=l; m++)
+				Y[l*(l+1)+m] = Ylm(l, m, qhat);
+		//Prefactor to structure factor for each orbital:
+		int iOrb = 0;
+		for(size_t r=0; r<b->fRadial.size(); r++)
+		{	int l = b->lRadial[r];
+			double f = (*b->fRadial[r])(q);
+			for(int m=-l; m<=l; m++)
+				prefac[iOrb++] = Y[l*(l+1)+m] * f;
+		}
+		//Structure factor for each atom:
+		for(int atom=0; atom<b->nAtoms; atom++)
+		{	complex S = cis((-2*M_PI)*dot(b->pos[atom], kpG));
+			complex* psiAtom = b->psi + atom*b->atomStride + i;
+			for(iOrb=0; iOrb<b->nOrbitalsNoSpin; iOrb++)
+			{	complex* psiCol = psiAtom + iOrb*b->nSpinCopies*b->colLength;
+				psiCol[0] = prefac[iOrb] * S;
+				if(b->nSpinCopies>1) //copy for other spin
+				{	psiCol[b->nbasis] = 0.;
+					psiCol[b->colLength] = 0.;
+					psiCol[b->colLength+b->nbasis] = psiCol[0];
+				}
+			}
+		}
+	}
+}
+
 //Set atomic orbitals in column bundle from radial functions (almost same operation as setting Vnl)
 void SpeciesInfo::setAtomicOrbitals(ColumnBundle& Y, bool applyO, int colOffset, const vector3<>* derivDir) const
 {	if(!atpos.size()) return;
@@ -159,6 +205,33 @@ void SpeciesInfo::setAtomicOrbitals(ColumnBundle& Y, bool applyO, int colOffset,
 	int nOrbitalsPerAtom = 0;
 	for(int l=0; l<int(fRadial.size()); l++)
 		nOrbitalsPerAtom += nAtomicOrbitals(l)*(2*l+1)*nSpinCopies;
+	if(!(derivDir || isRelativistic() || isGpuEnabled()))
+	{	//Batched evaluation of all orbitals:
+		assert(Y.basis); assert(Y.qnum);
+		assert(colOffset + nOrbitalsPerAtom*int(atpos.size()) <= Y.nCols());
+		if(nSpinCopies>1) assert(Y.isSpinor());
+		const Basis& basis = *Y.basis;
+		AtomicOrbitalsBatch b;
+		b.nbasis = basis.nbasis;
+		b.nAtoms = atpos.size();
+		b.nSpinCopies = nSpinCopies;
+		b.lMax = int(fRadial.size())-1;
+		b.colLength = Y.colLength();
+		b.atomStride = b.colLength * nOrbitalsPerAtom;
+		b.k = Y.qnum->k;
+		b.iGarr = basis.iGarr.data();
+		b.G = e->gInfo.G;
+		b.pos = atposManaged.data();
+		for(int l=0; l<int(fRadial.size()); l++)
+			for(int n=0; n<nAtomicOrbitals(l); n++)
+			{	b.fRadial.push_back(&fRadial[l][n]);
+				b.lRadial.push_back(l);
+			}
+		b.nOrbitalsNoSpin = nOrbitalsPerAtom / nSpinCopies;
+		b.psi = Y.data() + colOffset*b.colLength;
+		threadLaunch(atomicOrbitalsBatch_thread, basis.nbasis, &b);
+		return;
+	}
 	int iCol = colOffset;
 	for(int l=0; l<int(fRadial.size()); l++)
 		for(int n=0; n<nAtomicOrbitals(l); n++)
@@ -178,6 +251,9 @@ void SpeciesInfo::setAtomicOrbitals(ColumnBundle& psi, bool applyO, unsigned n,
 	assert(colOffset + atomColStride*int(atpos.size()-1) + nOrbitalsPerAtom <= psi.nCols());
 	if(nSpinCopies>1) assert(psi.isSpinor()); //can have multiple spinor copies only in spinor mode
 	const Basis& basis = *psi.basis;
+	AtomPhases phases(basis.gInfo->S, atpos.size(), atpos.data(), psi.qnum->k);
+	std::shared_ptr<RadialShells> shells = RadialShells::get(basis, psi.qnum->k);
+	ManagedArray<double> shellValues;
 	if(isRelativistic() && l>0)
 	{	//find the two orbital indices corresponding to different j of same n
 		std::vector<int> pArr; 
@@ -192,12 +268,21 @@ void SpeciesInfo::setAtomicOrbitals(ColumnBundle& psi, bool applyO, unsigned n,
 		//Initialize a non-spinor ColumnBundle containing all m's for both j functions:
 		ColumnBundle V(atpos.size()*nOrbitalsPerAtom, basis.nbasis, &basis, psi.qnum, isGpuEnabled());
 		int iCol=0;
-		for(int p: pArr) for(int m=-l; m<=l; m++)
-		{	size_t atomStride = V.colLength() * nOrbitalsPerAtom;
-			size_t offs = iCol * V.colLength();
-			callPref(Vnl)(basis.nbasis, atomStride, atpos.size(), l, m, psi.qnum->k, basis.iGarr.dataPref(),
-				e->gInfo.G, atposManaged.dataPref(), fRadial[l][p], V.dataPref()+offs, derivDir);
-			iCol++;
+		for(int p: pArr)
+		{	RadialShellValues fShells = shells->evaluate(fRadial[l][p], shellValues); //shared by all m
+			size_t atomStride = V.colLength() * nOrbitalsPerAtom;
+			if(!derivDir)
+			{	callPref(VnlAll)(basis.nbasis, V.colLength(), atomStride, atpos.size(), l, psi.qnum->k, basis.iGarr.dataPref(),
+					e->gInfo.G, phases.tables(), fRadial[l][p], V.dataPref()+iCol*V.colLength(), fShells);
+				iCol += 2*l+1;
+				continue;
+			}
+			for(int m=-l; m<=l; m++)
+			{	size_t offs = iCol * V.colLength();
+				callPref(Vnl)(basis.nbasis, atomStride, atpos.size(), l, m, psi.qnum->k, basis.iGarr.dataPref(),
+					e->gInfo.G, atposManaged.dataPref(), phases.tables(), fRadial[l][p], V.dataPref()+offs, derivDir, fShells);
+				iCol++;
+			}
 		}
 		//Transform the non-spinor ColumnBundle to the spinorial j eigenfunctions:
 		int N = nOrbitalsPerAtom;
@@ -209,12 +294,13 @@ void SpeciesInfo::setAtomicOrbitals(ColumnBundle& psi, bool applyO, unsigned n,
 	}
 	else
 	{	int iCol = colOffset; //current column
+		RadialShellValues fShells = shells->evaluate(fRadial[l][n], shellValues); //shared by all m
 		for(int m=-l; m<=l; m++)
 		{	//Set atomic orbitals for all atoms at specified (n,l,m):
 			size_t atomStride = psi.colLength() * atomColStride;
 			size_t offs = iCol * psi.colLength();
 			callPref(Vnl)(basis.nbasis, atomStride, atpos.size(), l, m, psi.qnum->k, basis.iGarr.dataPref(),
-				e->gInfo.G, atposManaged.dataPref(), fRadial[l][n], psi.dataPref()+offs, derivDir);
+				e->gInfo.G, atposManaged.dataPref(), phases.tables(), fRadial[l][n], psi.dataPref()+offs, derivDir, fShells);
 			if(nSpinCopies>1) //make copy for other spin
 			{	complex* dataPtr = psi.dataPref()+offs;
 				for(size_t a=0; a<atpos.size(); a++)
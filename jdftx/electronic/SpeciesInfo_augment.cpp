@@ -30,10 +30,9 @@ void SpeciesInfo::augmentOverlap(const ColumnBundle& Cq, ColumnBundle& OCq, matr
 {	static StopWatch watch("augmentOverlap"); watch.start();
 	if(!atpos.size()) return; //unused species
 	if(!Qint.size()) return; //no overlap augmentation
-	std::shared_ptr<ColumnBundle> V = getV(Cq);
-	matrix VdagCq = (*V) ^ Cq;
+	matrix VdagCq = getVdagC(Cq);
 	if(VdagCqPtr) *VdagCqPtr = VdagCq; //cache for later usage
-	OCq += (*V) * (tiledBlockMatrix(QintAll,atpos.size()) * VdagCq);
+	accumV(tiledBlockMatrix(QintAll,atpos.size()) * VdagCq, OCq);
 	watch.stop();
 }
 
@@ -69,12 +68,13 @@ void SpeciesInfo::augmentDensitySpherical(const QuantumNumber& qnum, const diagM
 	int nProj = MnlAll.nRows();
 	const GridInfo &gInfo = e->gInfo;
 	complex* nAugData = nAug.data();
+	matrix VdagCqF = VdagCq * Fq; //fillings applied once for all atoms
 	
 	//Loop over atoms:
 	for(unsigned atom=0; atom<atpos.size(); atom++)
 	{	//Get projections and calculate density matrix at this atom:
 		matrix atomVdagC = VdagCq(atom*nProj,(atom+1)*nProj, 0,VdagCq.nCols());
-		matrix RhoAll = atomVdagC * Fq * dagger(atomVdagC); //density matrix in projector basis on this atom
+		matrix RhoAll = VdagCqF(atom*nProj,(atom+1)*nProj, 0,VdagCq.nCols()) * dagger(atomVdagC); //density matrix in projector basis on this atom
 		if(isRelativistic()) RhoAll = fljAll * RhoAll * fljAll; //transformation for relativistic pseudopotential
 		std::vector<matrix> Rho(e->eInfo.nDensities); //RhoAll split by spin(-density-matrix) components
 		if(e->eInfo.isNoncollinear())
@@ -96,30 +96,11 @@ void SpeciesInfo::augmentDensitySpherical(const QuantumNumber& qnum, const diagM
 		//Calculate spherical function contributions from density matrix:
 		for(size_t s=0; s<Rho.size(); s++) if(Rho[s])
 		{	int atomOffs = Nlm*(atom + s*atpos.size());
-			//Triple loop over first projector:
-			int i1 = 0;
-			for(int l1=0; l1<int(VnlRadial.size()); l1++)
-			for(int p1=0; p1<int(VnlRadial[l1].size()); p1++)
-			for(int m1=-l1; m1<=l1; m1++)
-			{	//Triple loop over second projector:
-				int i2 = 0;
-				for(int l2=0; l2<int(VnlRadial.size()); l2++)
-				for(int p2=0; p2<int(VnlRadial[l2].size()); p2++)
-				for(int m2=-l2; m2<=l2; m2++)
-				{	if(i2<=i1) //rest handled by i1<->i2 symmetry
-					{	std::vector<YlmProdTerm> terms = expandYlmProd(l1,m1, l2,m2);
-						double prefac = qnum.weight * ((i1==i2 ? 1 : 2)/gInfo.detR)
-									* (Rho[s].data()[Rho[s].index(i2,i1)] * cis(0.5*M_PI*(l2-l1))).real();
-						for(const YlmProdTerm& term: terms)
-						{	QijIndex qIndex = { l1, p1, l2, p2, term.l };
-							auto Qijl = Qradial.find(qIndex);
-							if(Qijl==Qradial.end()) continue; //no entry at this l
-							nAugData[nAug.index(Qijl->first.index, atomOffs + term.l*(term.l+1) + term.m)] += term.coeff * prefac;
-						}
-					}
-					i2++;
-				}
-				i1++;
+			const complex* RhoData = Rho[s].data();
+			for(const AugmentTerm& term: augmentTerms)
+			{	double prefac = qnum.weight * ((term.i1==term.i2 ? 1 : 2)/gInfo.detR) //rest handled by i1<->i2 symmetry
+							* (RhoData[Rho[s].index(term.i2,term.i1)] * term.phase).real();
+				nAugData[nAug.index(term.iQ, atomOffs + term.lm)] += term.coeff * prefac;
 			}
 		}
 	}
@@ -127,21 +108,40 @@ void SpeciesInfo::augmentDensitySpherical(const QuantumNumber& qnum, const diagM
 }
 
 void SpeciesInfo::augmentDensityGrid(ScalarFieldArray& n) const
+{	if(!atpos.size()) return; //unused species
+	if(!Qint.size()) return; //no overlap augmentation
+	SpeciesInfo& sp = *((SpeciesInfo*)this);
+	sp.augmentDensityReduce();
+	for(unsigned s=0; s<n.size(); s++)
+		sp.augmentDensityGrid(n, s);
+}
+
+void SpeciesInfo::augmentDensityReduce(bool async)
+{	augmentDensity_COMMON_INIT
+	nAugTot = nAug;
+	nAugRequests.assign(async ? e->eInfo.nDensities : 0, MPIUtil::Request());
+	//Collect radial functions from all processes (split by G-vectors in augmentDensityGrid), separately for each spin channel:
+	int nColsPerSpin = Nlm * atpos.size();
+	size_t nDataPerSpin = size_t(nAugTot.nRows()) * nColsPerSpin;
+	for(int s=0; s<e->eInfo.nDensities; s++)
+		mpiWorld->allReduce(nAugTot.data() + nAugTot.index(0, s*nColsPerSpin), nDataPerSpin,
+			MPIUtil::ReduceSum, false, async ? &nAugRequests[s] : 0);
+}
+
+void SpeciesInfo::augmentDensityGrid(ScalarFieldArray& n, int s)
 {	static StopWatch watch("augmentDensityGrid"); watch.start(); 
 	augmentDensityGrid_COMMON_INIT
+	if(nAugRequests.size()) MPIUtil::wait(nAugRequests[s]);
+	if(s+1 == int(n.size())) nAugRequests.clear(); //all channels complete
 	const GridInfo &gInfo = e->gInfo;
 	double dGinv = 1./gInfo.dGradial;
-	matrix nAugTot = nAug; mpiWorld->allReduceData(nAugTot, MPIUtil::ReduceSum); //collect radial functions from all processes, and split by G-vectors below
-	matrix nAugRadial = QradialMat * nAugTot; //transform from radial functions to spline coeffs
+	int nColsPerSpin = Nlm * atpos.size();
+	matrix nAugRadial = QradialMat * nAugTot(0,nAugTot.nRows(), s*nColsPerSpin,(s+1)*nColsPerSpin); //transform from radial functions to spline coeffs
 	double* nAugRadialData = (double*)nAugRadial.dataPref();
-	for(unsigned s=0; s<n.size(); s++)
-	{	ScalarFieldTilde nAugTilde; nullToZero(nAugTilde, gInfo);
-		for(unsigned atom=0; atom<atpos.size(); atom++)
-		{	int atomOffs = nCoeff * Nlm * (atom + atpos.size()*s);
-			callPref(nAugment)(Nlm, gInfo.S, gInfo.G, gInfo.iGstart, gInfo.iGstop, nCoeff, dGinv, nAugRadialData+atomOffs, atpos[atom], nAugTilde->dataPref());
-		}
-		n[s] += I(nAugTilde);
-	}
+	ScalarFieldTilde nAugTilde; nullToZero(nAugTilde, gInfo);
+	callPref(nAugment)(Nlm, gInfo.S, gInfo.G, gInfo.iGstart, gInfo.iGstop, nCoeff, dGinv, nAugRadialData, //all atoms in one pass over the grid
+		atpos.size(), atposManaged.dataPref(), nAugTilde->dataPref());
+	n[s] += I(nAugTilde);
 	watch.stop();
 }
 
@@ -195,32 +195,11 @@ void SpeciesInfo::augmentDensitySphericalGrad(const QuantumNumber& qnum, const m
 		//Propagate gradients from spherical functions to density matrix:
 		for(size_t s=0; s<E_Rho.size(); s++) if(E_Rho[s])
 		{	int atomOffs = Nlm*(atom + s*atpos.size());
-			//Triple loop over first projector:
-			int i1 = 0;
-			for(int l1=0; l1<int(VnlRadial.size()); l1++)
-			for(int p1=0; p1<int(VnlRadial[l1].size()); p1++)
-			for(int m1=-l1; m1<=l1; m1++)
-			{	//Triple loop over second projector:
-				int i2 = 0;
-				for(int l2=0; l2<int(VnlRadial.size()); l2++)
-				for(int p2=0; p2<int(VnlRadial[l2].size()); p2++)
-				for(int m2=-l2; m2<=l2; m2++)
-				{	if(i2<=i1) //rest handled by i1<->i2 symmetry 
-					{	std::vector<YlmProdTerm> terms = expandYlmProd(l1,m1, l2,m2);
-						double E_Rho_i1i2sum = 0.;
-						for(const YlmProdTerm& term: terms)
-						{	QijIndex qIndex = { l1, p1, l2, p2, term.l };
-							auto Qijl = Qradial.find(qIndex);
-							if(Qijl==Qradial.end()) continue; //no entry at this l
-							E_Rho_i1i2sum += term.coeff * E_nAugData[E_nAug.index(Qijl->first.index, atomOffs + term.l*(term.l+1) + term.m)].real();
-						}
-						complex E_Rho_i1i2 = E_Rho_i1i2sum * (1./gInfo.detR) * cis(0.5*M_PI*(l2-l1));
-						E_Rho[s].data()[E_Rho[s].index(i2,i1)] += E_Rho_i1i2.conj();
-						if(i1!=i2) E_Rho[s].data()[E_Rho[s].index(i1,i2)] += E_Rho_i1i2;
-					}
-					i2++;
-				}
-				i1++;
+			complex* E_RhoData = E_Rho[s].data();
+			for(const AugmentTerm& term: augmentTerms)
+			{	complex E_Rho_i1i2 = (term.coeff * E_nAugData[E_nAug.index(term.iQ, atomOffs + term.lm)].real() * (1./gInfo.detR)) * term.phase;
+				E_RhoData[E_Rho[s].index(term.i2,term.i1)] += E_Rho_i1i2.conj();
+				if(term.i1!=term.i2) E_RhoData[E_Rho[s].index(term.i1,term.i2)] += E_Rho_i1i2; //rest handled by i1<->i2 symmetry
 			}
 		}
 		
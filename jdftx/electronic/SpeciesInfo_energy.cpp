@@ -33,19 +33,27 @@ double SpeciesInfo::EnlAndGrad(const QuantumNumber& qnum, const diagMatrix& Fq,
 	if(!MnlAll) return 0.; //purely local psp
 	int nProj = MnlAll.nRows();
 	
-	matrix MVdagC = zeroes(VdagCq.nRows(), VdagCq.nCols());
-	double Enlq = 0.0;
-	for(unsigned atom=0; atom<atpos.size(); atom++)
-	{	matrix atomVdagC = VdagCq(atom*nProj,(atom+1)*nProj, 0,VdagCq.nCols());
-		matrix MatomVdagC = MnlAll * atomVdagC;
-		MVdagC.set(atom*nProj,(atom+1)*nProj, 0,VdagCq.nCols(), MatomVdagC);
-		Enlq += trace(Fq * dagger(atomVdagC) * MatomVdagC).real();
-	}
+	//Apply Mnl to all atoms at once: the rows of each atom (column-major) are the columns of an nProj x (nAtoms*nBands) matrix
+	matrix VdagCall = VdagCq;
+	VdagCall.reshape(nProj, atpos.size()*VdagCq.nCols());
+	matrix MVdagC = applyMnl(VdagCall);
+	MVdagC.reshape(VdagCq.nRows(), VdagCq.nCols());
+	double Enlq = dotc(VdagCq, MVdagC*Fq).real();
 	HVdagCq += MVdagC;
 	watch.stop();
 	return Enlq;
 }
 
+matrix SpeciesInfo::applyMnl(const matrix& X) const
+{	matrix MX = zeroes(X.nRows(), X.nCols());
+	for(const MnlBlock& block: MnlBlocks)
+	{	matrix MXblock = MX(block.rowStart,block.rowStop, 0,X.nCols()); //several blocks share rows for relativistic psps
+		MXblock += block.M * X(block.colStart,block.colStop, 0,X.nCols());
+		MX.set(block.rowStart,block.rowStop, 0,X.nCols(), MXblock);
+	}
+	return MX;
+}
+
 //-------------- DFT + U --------------------
 
 size_t SpeciesInfo::rhoAtom_nMatrices() const
@@ -57,8 +65,9 @@ size_t SpeciesInfo::rhoAtom_nMatrices() const
 	int spinorLength = e->eInfo.spinorLength();
 
 #define UparamLOOP(code) \
-	for(auto Uparams: plusU) \
-	{	int orbCount = (2*Uparams.l+1) * spinorLength; /* number of orbitals at given n,l */ \
+	for(int iU=0; iU<int(plusU.size()); iU++) \
+	{	const PlusU& Uparams = plusU[iU]; \
+		int orbCount = (2*Uparams.l+1) * spinorLength; /* number of orbitals at given n,l */ \
 		code \
 	}
 
@@ -80,9 +89,7 @@ void SpeciesInfo::rhoAtom_calc(const std::vector<diagMatrix>& F, const std::vect
 		for(int q=e->eInfo.qStart; q<e->eInfo.qStop; q++)
 		{	const QuantumNumber& qnum = e->eInfo.qnums[q];
 			int s = qnum.index();
-			ColumnBundle Opsi(C[q].similar(matSize));
-			setAtomicOrbitals(Opsi, true, Uparams.n, Uparams.l);
-			matrix psiOCdag = Opsi ^ C[q];
+			matrix psiOCdag = (*getOpsiU(C[q], iU)) ^ C[q];
 			rho[s] += (qnum.weight/e->eInfo.spinWeight) * psiOCdag * F[q] * dagger(psiOCdag);
 		}
 		for(int s=0; s<nSpins; s++)
@@ -131,8 +138,7 @@ void SpeciesInfo::rhoAtom_grad(const ColumnBundle& Cq, const matrix* U_rhoAtomPt
 	UparamLOOP
 	(	U_rho_PACK
 		int s = Cq.qnum->index();
-		ColumnBundle Opsi(Cq.similar(matSize));
-		setAtomicOrbitals(Opsi, true, Uparams.n, Uparams.l);
+		const ColumnBundle& Opsi = *getOpsiU(Cq, iU);
 		HCq += (1./e->eInfo.spinWeight) * Opsi * (U_rho[s] * (Opsi ^ Cq)); //gradient upto state weight and fillings
 	)
 	watch.stop();
@@ -145,8 +151,7 @@ void SpeciesInfo::rhoAtom_forces(const std::vector<diagMatrix>& F, const std::ve
 		for(int q=e->eInfo.qStart; q<e->eInfo.qStop; q++)
 		{	const QuantumNumber& qnum = e->eInfo.qnums[q];
 			int s = qnum.index();
-			ColumnBundle Opsi(C[q].similar(matSize));
-			setAtomicOrbitals(Opsi, true, Uparams.n, Uparams.l);
+			const ColumnBundle& Opsi = *getOpsiU(C[q], iU);
 			matrix psiOCdag = Opsi ^ C[q];
 			diagMatrix fCartMat[3];
 			for(int k=0; k<3; k++)
@@ -170,17 +175,48 @@ void SpeciesInfo::rhoAtom_getV(const ColumnBundle& Cq, const matrix* U_rhoAtomPt
 	UparamLOOP
 	(	U_rho_PACK
 		int s = Cq.qnum->index();
-		setAtomicOrbitals(Opsi, true, Uparams.n, Uparams.l, matSizePrev, 0, derivDir);
+		if(derivDir) setAtomicOrbitals(Opsi, true, Uparams.n, Uparams.l, matSizePrev, 0, derivDir);
+		else Opsi.setSub(matSizePrev, *getOpsiU(Cq, iU));
 		M.set(matSizePrev,matSizePrev+matSize, matSizePrev,matSizePrev+matSize, (1./e->eInfo.spinWeight) * U_rho[s]);
 		matSizePrev += matSize;
 	)
 }
+std::shared_ptr<ColumnBundle> SpeciesInfo::getOpsiU(const ColumnBundle& Cq, int iU) const
+{	const QuantumNumber& qnum = *(Cq.qnum);
+	const Basis& basis = *(Cq.basis);
+	const PlusU& Uparams = plusU[iU];
+	int kind = ProjectorCache::KindProjectors + 1 + iU;
+	//First check cache
+	ProjectorCache& cache = e->iInfo.projectorCache;
+	bool useCache = e->cntrl.cacheProjectors;
+	if(useCache)
+	{	std::shared_ptr<ColumnBundle> Opsi = cache.find(this, qnum.k, &basis, kind);
+		if(Opsi) return Opsi; //return cached value
+	}
+	//No cache / not found in cache; compute:
+	int orbCount = (2*Uparams.l+1) * e->eInfo.spinorLength();
+	std::shared_ptr<ColumnBundle> Opsi = std::make_shared<ColumnBundle>(Cq.similar(orbCount * atpos.size()));
+	setAtomicOrbitals(*Opsi, true, Uparams.n, Uparams.l);
+	//Add to cache if necessary:
+	if(useCache) cache.insert(this, qnum.k, &basis, Opsi, kind);
+	return Opsi;
+}
+
 #undef rhoAtom_COMMONinit
 #undef UparamLOOP
 #undef U_rho_PACK
 
+int SpeciesInfo::nMovedLocal() const
+{	if(atposLocal.size() != atpos.size()) return -1;
+	int nMoved = 0;
+	for(size_t atom=0; atom<atpos.size(); atom++)
+		if((atpos[atom] - atposLocal[atom]).length_squared())
+			nMoved++;
+	return nMoved;
+}
+
 void SpeciesInfo::updateLocal(ScalarFieldTilde& Vlocps, ScalarFieldTilde& rhoIon, ScalarFieldTilde& nChargeball,
-	ScalarFieldTilde& nCore, ScalarFieldTilde& tauCore) const
+	ScalarFieldTilde& nCore, ScalarFieldTilde& tauCore, bool incremental) const
 {	if(!atpos.size()) return; //unused species
 	((SpeciesInfo*)this)->updateLatticeDependent(); //update lattice dependent quantities (if lattice vectors have changed)
 	const GridInfo& gInfo = e->gInfo;
@@ -191,12 +227,44 @@ void SpeciesInfo::updateLocal(ScalarFieldTilde& Vlocps, ScalarFieldTilde& rhoIon
 	if(nCoreRadial) { nullToZero(nCore, gInfo); nCoreData = nCore->dataPref(); }
 	if(tauCoreRadial) { nullToZero(tauCore, gInfo); tauCoreData = tauCore->dataPref(); }
 	
+	//Radial functions at each |G| shell of the half G-space:
+	std::shared_ptr<RadialShells> shells = RadialShells::get(gInfo);
+	ManagedArray<double> VlocValues, nCoreValues, tauCoreValues;
+	RadialShellValues VlocShells = shells->evaluate(VlocRadial, VlocValues), nCoreShells, tauCoreShells;
+	if(nCoreRadial) nCoreShells = shells->evaluate(nCoreRadial, nCoreValues);
+	if(tauCoreRadial) tauCoreShells = shells->evaluate(tauCoreRadial, tauCoreValues);
+	
 	//Calculate in half G-space:
 	double invVol = 1.0/gInfo.detR;
-	callPref(::updateLocal)(gInfo.S, gInfo.GGT,
-		Vlocps->dataPref(), rhoIon->dataPref(), nChargeballData, nCoreData, tauCoreData,
-		atpos.size(), atposManaged.dataPref(), invVol, VlocRadial,
-		Z, nCoreRadial, tauCoreRadial, Z_chargeball, width_chargeball);
+	if(incremental)
+	{	//Contributions are linear in the structure factor: add those at the new positions
+		//and subtract those at the old positions (by flipping the normalization) of moved atoms only:
+		assert(nMovedLocal() >= 0);
+		std::vector<vector3<>> atposNew, atposOld;
+		for(size_t atom=0; atom<atpos.size(); atom++)
+			if((atpos[atom] - atposLocal[atom]).length_squared())
+			{	atposNew.push_back(atpos[atom]);
+				atposOld.push_back(atposLocal[atom]);
+			}
+		if(atposNew.size())
+		{	AtomPhases phasesNew(gInfo.S, atposNew.size(), atposNew.data()), phasesOld(gInfo.S, atposOld.size(), atposOld.data());
+			callPref(::updateLocal)(gInfo.S, gInfo.GGT,
+				Vlocps->dataPref(), rhoIon->dataPref(), nChargeballData, nCoreData, tauCoreData,
+				atposNew.size(), phasesNew.tables(), invVol, VlocShells,
+				Z, nCoreShells, tauCoreShells, Z_chargeball, width_chargeball);
+			callPref(::updateLocal)(gInfo.S, gInfo.GGT,
+				Vlocps->dataPref(), rhoIon->dataPref(), nChargeballData, nCoreData, tauCoreData,
+				atposOld.size(), phasesOld.tables(), -invVol, VlocShells,
+				Z, nCoreShells, tauCoreShells, Z_chargeball, width_chargeball);
+		}
+	}
+	else
+	{	callPref(::updateLocal)(gInfo.S, gInfo.GGT,
+			Vlocps->dataPref(), rhoIon->dataPref(), nChargeballData, nCoreData, tauCoreData,
+			atpos.size(), getAtomPhases().tables(), invVol, VlocShells,
+			Z, nCoreShells, tauCoreShells, Z_chargeball, width_chargeball);
+	}
+	atposLocal = atpos;
 }
 
 
@@ -231,54 +299,149 @@ std::vector< vector3<double> > SpeciesInfo::getLocalForces(const ScalarFieldTild
 	return forces;
 }
 
+//Number of atoms per block for on-the-fly projectors (at least nProjBlock projectors, so that the products stay efficient):
+const int nProjBlock = 128;
+inline int atomsPerBlock(int nProj) { return std::max(1, (nProjBlock + nProj - 1) / nProj); }
+
 void SpeciesInfo::accumNonlocalForces(const ColumnBundle& Cq, const matrix& VdagC, const matrix& E_VdagC, const matrix& grad_CdagOCq, std::vector<vector3<> >& forces) const
-{	matrix DVdagC[3]; //cartesian gradient of VdagC
-	{	auto V = getV(Cq);
-		for(int k=0; k<3; k++)
-			DVdagC[k] = D(*V,k)^Cq;
-	}
-	int nProj = MnlAll.nRows();
-	//Loop over atoms:
-	for(unsigned atom=0; atom<atpos.size(); atom++)
-	{	matrix atomVdagC = VdagC(atom*nProj,(atom+1)*nProj, 0,E_VdagC.nCols());
-		matrix E_atomVdagC = E_VdagC(atom*nProj,(atom+1)*nProj, 0,E_VdagC.nCols());
-		if(QintAll) E_atomVdagC += QintAll * atomVdagC * grad_CdagOCq; //Contribution via overlap augmentation
-		
-		vector3<> fCart; //proportional to cartesian force
+{	int nProj = MnlAll.nRows(); //per atom (including spinor components)
+	int nProjV = nProj / e->eInfo.spinorLength(); //projector columns per atom
+	if(!nProjV || !atpos.size()) return; //purely local psp / unused species
+	static StopWatch watch("accumNonlocalForces"); watch.start();
+	int nBands = E_VdagC.nCols();
+	//Build projectors (or take them from the cache) in blocks of atoms, and propagate all three
+	//cartesian derivatives of each block with a single product with Cq:
+	std::shared_ptr<ColumnBundle> Vall = projectOnTheFly(Cq) ? 0 : getV(Cq);
+	int nAtomsBlock = atomsPerBlock(nProjV);
+	for(int atomStart=0; atomStart<int(atpos.size()); atomStart+=nAtomsBlock)
+	{	int atomStop = std::min(atomStart+nAtomsBlock, int(atpos.size()));
+		int nColsV = nProjV*(atomStop-atomStart);
+		ColumnBundle V;
+		if(Vall) V = Vall->getSub(nProjV*atomStart, nProjV*atomStop);
+		else
+		{	V.init(nColsV, Cq.basis->nbasis, Cq.basis, Cq.qnum, isGpuEnabled());
+			computeV(atomStart, atomStop, V);
+		}
+		ColumnBundle DV(3*nColsV, V.colLength(), V.basis, V.qnum, isGpuEnabled());
 		for(int k=0; k<3; k++)
-		{	matrix atomDVdagC = DVdagC[k](atom*nProj,(atom+1)*nProj, 0,E_VdagC.nCols());
-			fCart[k] = trace(E_atomVdagC * dagger(atomDVdagC)).real();
+			DV.setSub(k*nColsV, D(V,k));
+		V.free();
+		matrix DVdagC = DV ^ Cq; //cartesian gradient of VdagC for this block, directions stacked along rows
+		int nRowsBlock = nProj*(atomStop-atomStart);
+		//Loop over atoms:
+		for(int atom=atomStart; atom<atomStop; atom++)
+		{	matrix atomVdagC = VdagC(atom*nProj,(atom+1)*nProj, 0,nBands);
+			matrix E_atomVdagC = E_VdagC(atom*nProj,(atom+1)*nProj, 0,nBands);
+			if(QintAll) E_atomVdagC += QintAll * atomVdagC * grad_CdagOCq; //Contribution via overlap augmentation
+			
+			vector3<> fCart; //proportional to cartesian force
+			int rowOffset = (atom-atomStart)*nProj;
+			for(int k=0; k<3; k++)
+			{	matrix atomDVdagC = DVdagC(k*nRowsBlock+rowOffset,k*nRowsBlock+rowOffset+nProj, 0,nBands);
+				fCart[k] = trace(E_atomVdagC * dagger(atomDVdagC)).real();
+			}
+			forces[atom] += 2.*Cq.qnum->weight * (e->gInfo.RT * fCart);
 		}
-		forces[atom] += 2.*Cq.qnum->weight * (e->gInfo.RT * fCart);
 	}
+	watch.stop();
 }
 
 std::shared_ptr<ColumnBundle> SpeciesInfo::getV(const ColumnBundle& Cq, const vector3<>* derivDir) const
 {	const QuantumNumber& qnum = *(Cq.qnum);
 	const Basis& basis = *(Cq.basis);
-	std::pair<vector3<>,const Basis*> cacheKey = std::make_pair(qnum.k, &basis);
 	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
 	if(!nProj) return 0; //purely local psp
 	//First check cache
-	if(e->cntrl.cacheProjectors && (!derivDir))
-	{	auto iter = cachedV.find(cacheKey);
-		if(iter != cachedV.end()) //found
-			return iter->second; //return cached value
+	ProjectorCache& cache = e->iInfo.projectorCache;
+	bool useCache = e->cntrl.cacheProjectors && (!derivDir);
+	if(useCache)
+	{	std::shared_ptr<ColumnBundle> V = cache.find(this, qnum.k, &basis);
+		if(V) return V; //return cached value
 	}
 	//No cache / not found in cache; compute:
 	std::shared_ptr<ColumnBundle> V = std::make_shared<ColumnBundle>(nProj*atpos.size(), basis.nbasis, &basis, &qnum, isGpuEnabled()); //not a spinor regardless of spin type
+	computeV(0, atpos.size(), *V, derivDir);
+	//Add to cache if necessary:
+	if(useCache) cache.insert(this, qnum.k, &basis, V);
+	return V;
+}
+
+void SpeciesInfo::computeV(int atomStart, int atomStop, ColumnBundle& V, const vector3<>* derivDir) const
+{	const QuantumNumber& qnum = *(V.qnum);
+	const Basis& basis = *(V.basis);
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	assert(V.nCols() == nProj*(atomStop-atomStart));
+	AtomPhases phases(basis.gInfo->S, atomStop-atomStart, atpos.data()+atomStart, qnum.k);
+	std::shared_ptr<RadialShells> shells = RadialShells::get(basis, qnum.k);
+	ManagedArray<double> shellValues;
 	int iProj = 0;
 	for(int l=0; l<int(VnlRadial.size()); l++)
 		for(unsigned p=0; p<VnlRadial[l].size(); p++)
+		{	RadialShellValues VnlShells = shells->evaluate(VnlRadial[l][p], shellValues); //shared by all m
+			size_t atomStride = nProj * basis.nbasis;
+			if(!derivDir) //all m in one pass, sharing direction, radial function and structure factor per G-vector
+			{	callPref(VnlAll)(basis.nbasis, basis.nbasis, atomStride, atomStop-atomStart, l, qnum.k, basis.iGarr.dataPref(),
+					basis.gInfo->G, phases.tables(), VnlRadial[l][p], V.dataPref()+iProj*basis.nbasis, VnlShells);
+				iProj += 2*l+1;
+				continue;
+			}
 			for(int m=-l; m<=l; m++)
 			{	size_t offs = iProj * basis.nbasis;
-				size_t atomStride = nProj * basis.nbasis;
-				callPref(Vnl)(basis.nbasis, atomStride, atpos.size(), l, m, qnum.k, basis.iGarr.dataPref(),
-					basis.gInfo->G, atposManaged.dataPref(), VnlRadial[l][p], V->dataPref()+offs, derivDir);
+				callPref(Vnl)(basis.nbasis, atomStride, atomStop-atomStart, l, m, qnum.k, basis.iGarr.dataPref(),
+					basis.gInfo->G, atposManaged.dataPref()+atomStart, phases.tables(), VnlRadial[l][p], V.dataPref()+offs, derivDir, VnlShells);
 				iProj++;
 			}
-	//Add to cache if necessary:
-	if(e->cntrl.cacheProjectors && (!derivDir))
-		((SpeciesInfo*)this)->cachedV[cacheKey] = V;
-	return V;
+		}
+}
+
+bool SpeciesInfo::projectOnTheFly(const ColumnBundle& Cq) const
+{	if(!e->cntrl.projectorsOnTheFly || !atpos.size()) return false;
+	if(!e->cntrl.cacheProjectors) return true;
+	//Use cached projectors if possible, and build them on the fly only if they cannot be cached at all:
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	return !e->iInfo.projectorCache.fits(nProj * atpos.size() * Cq.basis->nbasis * sizeof(complex));
+}
+
+matrix SpeciesInfo::getVdagC(const ColumnBundle& Cq) const
+{	if(realSpaceProjectors && atpos.size()) return getVdagC_realSpace(Cq);
+	if(!projectOnTheFly(Cq))
+	{	std::shared_ptr<ColumnBundle> V = getV(Cq);
+		return V ? (*V) ^ Cq : matrix();
+	}
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	if(!nProj) return matrix(); //purely local psp
+	static StopWatch watch("getVdagC(onTheFly)"); watch.start();
+	int nAtomsBlock = atomsPerBlock(nProj);
+	matrix VdagC;
+	for(int atomStart=0; atomStart<int(atpos.size()); atomStart+=nAtomsBlock)
+	{	int atomStop = std::min(atomStart+nAtomsBlock, int(atpos.size()));
+		ColumnBundle V(nProj*(atomStop-atomStart), Cq.basis->nbasis, Cq.basis, Cq.qnum, isGpuEnabled());
+		computeV(atomStart, atomStop, V);
+		matrix VdagCblock = V ^ Cq;
+		if(!VdagC) VdagC.init(nProj*atpos.size(), VdagCblock.nCols(), isGpuEnabled());
+		VdagC.set(nProj*atomStart, nProj*atomStop, 0, VdagC.nCols(), VdagCblock);
+	}
+	watch.stop();
+	return VdagC;
+}
+
+void SpeciesInfo::accumV(const matrix& M, ColumnBundle& HCq) const
+{	if(realSpaceProjectors && atpos.size()) { accumV_realSpace(M, HCq); return; }
+	if(!projectOnTheFly(HCq))
+	{	std::shared_ptr<ColumnBundle> V = getV(HCq);
+		if(V) HCq += (*V) * M;
+		return;
+	}
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	if(!nProj) return; //purely local psp
+	static StopWatch watch("accumV(onTheFly)"); watch.start();
+	int nAtomsBlock = atomsPerBlock(nProj);
+	int rowFactor = M.nRows() / (nProj*atpos.size()); //2 for spinor HCq (rows of M interleaved by spin), 1 otherwise
+	for(int atomStart=0; atomStart<int(atpos.size()); atomStart+=nAtomsBlock)
+	{	int atomStop = std::min(atomStart+nAtomsBlock, int(atpos.size()));
+		ColumnBundle V(nProj*(atomStop-atomStart), HCq.basis->nbasis, HCq.basis, HCq.qnum, isGpuEnabled());
+		computeV(atomStart, atomStop, V);
+		HCq += V * matrix(M(rowFactor*nProj*atomStart, rowFactor*nProj*atomStop, 0, M.nCols()));
+	}
+	watch.stop();
 }
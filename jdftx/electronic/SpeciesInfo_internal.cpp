@@ -19,6 +19,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 -------------------------------------------------------------------*/
 
 #include <electronic/SpeciesInfo_internal.h>
+#include <core/Operators_internal.h>
 #include <core/LoopMacros.h>
 #include <core/Thread.h>
 #include <core/BlasExtra.h>
@@ -28,34 +29,46 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 //Initialize non-local projector from a radial function at a particular l,m (or its k derivatives)
 template<int l, int m>
 void Vnl(int nbasis, int atomStride, int nAtoms, const vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* V, const vector3<>* derivDir)
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V,
+	const vector3<>* derivDir, const RadialShellValues& shells)
 {	if(derivDir) //derivative w.r.t Cartesian k
 	{	const vector3<> RTdir = (2*M_PI)*(*derivDir * inv(G));
-		threadedLoop(VnlPrime_calc<l,m>, nbasis, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, *derivDir, RTdir, V);
+		threadedLoop(VnlPrime_calc<l,m>, nbasis, atomStride, nAtoms, k, iGarr, G, pos, phases, VnlRadial, *derivDir, RTdir, V);
 	}
-	else threadedLoop(Vnl_calc<l,m>, nbasis, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, V);
+	else threadedLoop(Vnl_calc<l,m>, nbasis, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, shells, V);
 }
 void Vnl(int nbasis, int atomStride, int nAtoms, int l, int m, const vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* V, const vector3<>* derivDir)
-{	SwitchTemplate_lm(l,m, Vnl, (nbasis, atomStride, nAtoms, k, iGarr, G, pos, VnlRadial, V, derivDir) )
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V,
+	const vector3<>* derivDir, const RadialShellValues& shells)
+{	SwitchTemplate_lm(l,m, Vnl, (nbasis, atomStride, nAtoms, k, iGarr, G, pos, phases, VnlRadial, V, derivDir, shells) )
+}
+
+template<int l>
+void VnlAll(int nbasis, int mStride, int atomStride, int nAtoms, const vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V, const RadialShellValues& shells)
+{	threadedLoop(VnlAll_calc<l>, nbasis, mStride, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, shells, V);
+}
+void VnlAll(int nbasis, int mStride, int atomStride, int nAtoms, int l, const vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* V, const RadialShellValues& shells)
+{	SwitchTemplate_l(l, VnlAll, (nbasis, mStride, atomStride, nAtoms, k, iGarr, G, phases, VnlRadial, V, shells) )
 }
 
 //Augment electron density by spherical functions
 template<int Nlm> void nAugment_sub(size_t diStart, size_t diStop, const vector3<int> S, const matrix3<>& G, int iGstart,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n)
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
 {	size_t iStart = iGstart + diStart;
 	size_t iStop = iGstart + diStop;
-	THREAD_halfGspaceLoop( (nAugment_calc<Nlm>)(i, iG, G, nCoeff, dGinv, nRadial, atpos, n); )
+	THREAD_halfGspaceLoop( (nAugment_calc<Nlm>)(i, iG, G, nCoeff, dGinv, nRadial, nAtoms, atpos, n); )
 }
 template<int Nlm> void nAugment(const vector3<int> S, const matrix3<>& G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n)
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
 {
-	threadLaunch(nAugment_sub<Nlm>, iGstop-iGstart, S, G, iGstart, nCoeff, dGinv, nRadial, atpos, n);
+	threadLaunch(nAugment_sub<Nlm>, iGstop-iGstart, S, G, iGstart, nCoeff, dGinv, nRadial, nAtoms, atpos, n);
 }
 void nAugment(int Nlm, const vector3<int> S, const matrix3<>& G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n)
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
 {	
-	SwitchTemplate_Nlm(Nlm, nAugment, (S, G, iGstart, iGstop, nCoeff, dGinv, nRadial, atpos, n) )
+	SwitchTemplate_Nlm(Nlm, nAugment, (S, G, iGstart, iGstop, nCoeff, dGinv, nRadial, nAtoms, atpos, n) )
 }
 
 //Function for initializing the index arrays used by nAugmentGrad
@@ -85,6 +98,34 @@ void setNagIndex(const vector3<int>& S, const matrix3<>& G, int iGstart, int iGs
 	threadLaunch(setNagIndexPtr_sub, nGsub, nGsub, nCoeff, nagIndex, nagIndexPtr); //Initialize pointers to boundaries between different Gindices
 }
 
+void updateNagIndex_sub(size_t iStart, size_t iStop, const vector3<int> S, const matrix3<> G, double dGinv, uint64_t* nagIndex, bool* moved)
+{	const uint64_t mask16 = 0xFFFF, mask48 = (uint64_t(1)<<48)-1;
+	for(size_t i=iStart; i<iStop; i++)
+	{	vector3<int> iG(int((nagIndex[i]>>32) & mask16), int((nagIndex[i]>>16) & mask16), int(nagIndex[i] & mask16));
+		for(int k=0; k<3; k++) if(2*iG[k]>S[k]) iG[k] -= S[k]; //undo wrapping of setNagIndex_sub
+		uint64_t Gindex = uint64_t((iG*G).length() * dGinv);
+		moved[i] = (Gindex != (nagIndex[i] >> 48));
+		nagIndex[i] = (Gindex << 48) + (nagIndex[i] & mask48);
+	}
+}
+void updateNagIndex(const vector3<int>& S, const matrix3<>& G, int iGstart, int iGstop,
+	int nCoeff, double dGinv, uint64_t* nagIndex, size_t* nagIndexPtr)
+{	size_t nGsub = iGstop-iGstart;
+	bool* moved = new bool[nGsub];
+	threadLaunch(updateNagIndex_sub, nGsub, S, G, dGinv, nagIndex, moved); //Recompute Gindex in place
+	//Entries that stayed in their bin remain sorted; sort the rest and merge them in:
+	std::vector<uint64_t> kept, changed;
+	kept.reserve(nGsub);
+	for(size_t i=0; i<nGsub; i++)
+		(moved[i] ? changed : kept).push_back(nagIndex[i]);
+	delete[] moved;
+	if(changed.size())
+	{	std::sort(changed.begin(), changed.end());
+		std::merge(kept.begin(), kept.end(), changed.begin(), changed.end(), nagIndex);
+	}
+	threadLaunch(setNagIndexPtr_sub, nGsub, nGsub, nCoeff, nagIndex, nagIndexPtr); //Initialize pointers to boundaries between different Gindices
+}
+
 //Propagate gradients corresponding to above electron density augmentation
 template<int Nlm> void nAugmentGrad_sub(int iStart, int iStop, const vector3<int> S, const matrix3<>& G,
 	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos,
@@ -115,34 +156,34 @@ void nAugmentGrad(int Nlm, const vector3<int> S, const matrix3<>& G,
 
 //Structure factor
 void getSG_sub(size_t iStart, size_t iStop, const vector3<int> S,
-	int nAtoms, const vector3<>* atpos, double invVol, complex* SG)
-{	THREAD_halfGspaceLoop( SG[i] = invVol * getSG_calc(iG, nAtoms, atpos); )
+	int nAtoms, const AtomPhaseTables& phases, double invVol, complex* SG)
+{	THREAD_halfGspaceLoop( SG[i] = invVol * getSG_calc(iG, nAtoms, phases); )
 }
-void getSG(const vector3<int> S, int nAtoms, const vector3<>* atpos, double invVol, complex* SG)
-{	threadLaunch(getSG_sub, S[0]*S[1]*(S[2]/2+1), S, nAtoms, atpos, invVol, SG);
+void getSG(const vector3<int> S, int nAtoms, const AtomPhaseTables& phases, double invVol, complex* SG)
+{	threadLaunch(getSG_sub, S[0]*S[1]*(S[2]/2+1), S, nAtoms, phases, invVol, SG);
 }
 
 //Local pseudopotential, ionic charge, chargeball and partial cores (CPU thread and launcher)
 void updateLocal_sub(size_t iStart, size_t iStop, const vector3<int> S, const matrix3<> GGT,
 	complex *Vlocps,  complex *rhoIon, complex *nChargeball, complex *nCore, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG& VlocRadial,
-	double Z, const RadialFunctionG& nCoreRadial, const RadialFunctionG& tauCoreRadial,
+	int nAtoms, const AtomPhaseTables& phases, double invVol, const RadialShellValues& VlocShells,
+	double Z, const RadialShellValues& nCoreShells, const RadialShellValues& tauCoreShells,
 	double Zchargeball, double wChargeball)
 {	THREAD_halfGspaceLoop(
 		updateLocal_calc(i, iG, GGT,
 			Vlocps, rhoIon, nChargeball, nCore, tauCore,
-			nAtoms, atpos, invVol, VlocRadial,
-			Z, nCoreRadial, tauCoreRadial, Zchargeball, wChargeball); )
+			nAtoms, phases, invVol, VlocShells,
+			Z, nCoreShells, tauCoreShells, Zchargeball, wChargeball); )
 }
 void updateLocal(const vector3<int> S, const matrix3<> GGT,
 	complex *Vlocps,  complex *rhoIon, complex *nChargeball, complex *nCore, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG& VlocRadial,
-	double Z, const RadialFunctionG& nCoreRadial, const RadialFunctionG& tauCoreRadial,
+	int nAtoms, const AtomPhaseTables& phases, double invVol, const RadialShellValues& VlocShells,
+	double Z, const RadialShellValues& nCoreShells, const RadialShellValues& tauCoreShells,
 	double Zchargeball, double wChargeball)
 {	threadLaunch(updateLocal_sub, S[0]*S[1]*(S[2]/2+1), S, GGT,
 		Vlocps, rhoIon, nChargeball, nCore, tauCore,
-		nAtoms, atpos, invVol, VlocRadial,
-		Z, nCoreRadial, tauCoreRadial, Zchargeball, wChargeball);
+		nAtoms, phases, invVol, VlocShells,
+		Z, nCoreShells, tauCoreShells, Zchargeball, wChargeball);
 }
 
 //Forces due to local pseudopotential, ionic charge, chargeball and partial cores (to gradient w.r.t structure factor)
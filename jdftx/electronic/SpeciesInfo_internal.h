@@ -29,25 +29,78 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/RadialFunction.h>
 #include <core/SphericalHarmonics.h>
 #include <stdint.h>
+#include <vector>
+
+//! Separable structure factor phases: exp(-2 pi i (k+iG).x) of each atom as a product of three entries of per-direction tables
+//! exp(-2 pi i iG[dir] x[dir]), with the k-dependent factor folded into the first (initialized by AtomPhases in SpeciesInfo.h)
+struct AtomPhaseTables
+{	const complex* data; //!< tables of all atoms, with nPerAtom entries per atom
+	vector3<int> offset; //!< location of iG[dir] = 0 in the tables of each atom
+	int nPerAtom; //!< number of table entries per atom
+
+	__hostanddev__ complex operator()(int atom, const vector3<int>& iG) const
+	{	const complex* t = data + atom*nPerAtom;
+		return t[offset[0]+iG[0]] * t[offset[1]+iG[1]] * t[offset[2]+iG[2]];
+	}
+};
+
+//! Values of a radial function at the distinct |k+G| (shells) of a basis or grid, broadcast to each G-vector by its shell index
+//! (initialized by RadialShells in SpeciesInfo.h; a default-constructed view has null pointers)
+struct RadialShellValues
+{	const int* shellIndex; //!< shell of each G-vector
+	const double* values; //!< radial function at each shell
+
+	RadialShellValues() : shellIndex(0), values(0) {}
+	__hostanddev__ double operator()(int i) const { return values[shellIndex[i]]; }
+};
 
 //! Compute Vnl at specific l and m for several atomic positions
 template<int l, int m> __hostanddev__
 void Vnl_calc(int n, int atomStride, int nAtoms, const vector3<>& k, const vector3<int>* iGarr,
-	const matrix3<>& G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* Vnl)
+	const matrix3<>& G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, const RadialShellValues& shells, complex* Vnl)
 {
 	vector3<> kpG = k + iGarr[n]; //k+G in reciprocal lattice coordinates:
 	vector3<> qvec = kpG * G; //k+G in cartesian coordinates
 	double q = qvec.length();
 	vector3<> qhat = qvec * (q ? 1.0/q : 0.0); //the unit vector along qvec (set qhat to 0 for q=0 (doesn't matter))
-	double prefac = Ylm<l,m>(qhat) * VnlRadial(q); //prefactor to structure factor
+	double prefac = Ylm<l,m>(qhat) * (shells.values ? shells(n) : VnlRadial(q)); //prefactor to structure factor
 	//Loop over columns (multiple atoms at same l,m):
 	for(int atom=0; atom<nAtoms; atom++)
-		Vnl[atom*atomStride+n] = prefac * cis((-2*M_PI)*dot(pos[atom],kpG));
+		Vnl[atom*atomStride+n] = prefac * phases(atom, iGarr[n]);
+}
+
+//! Static loop over m that sets Y[l+m] = Ylm<l,m>(qhat) for all m at once
+template<int l, int lpm> struct YlmAll_staticLoop
+{	static __hostanddev__ void set(const vector3<>& qhat, double* Y)
+	{	Y[lpm] = Ylm<l,lpm-l>(qhat);
+		YlmAll_staticLoop<l,lpm-1>::set(qhat, Y);
+	}
+};
+template<int l> struct YlmAll_staticLoop<l,-1> { static __hostanddev__ void set(const vector3<>& qhat, double* Y) {} }; //end recursion
+
+//! Compute Vnl for all m at specific l for several atomic positions (projector for m at offset (l+m)*mStride),
+//! sharing the direction, radial function and structure factor of each G-vector between the m's
+template<int l> __hostanddev__
+void VnlAll_calc(int n, int mStride, int atomStride, int nAtoms, const vector3<>& k, const vector3<int>* iGarr,
+	const matrix3<>& G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, const RadialShellValues& shells, complex* Vnl)
+{
+	vector3<> qvec = (k + iGarr[n]) * G; //k+G in cartesian coordinates
+	double q = qvec.length();
+	vector3<> qhat = qvec * (q ? 1.0/q : 0.0);
+	double Y[2*l+1]; YlmAll_staticLoop<l,2*l>::set(qhat, Y);
+	double Vradial = shells.values ? shells(n) : VnlRadial(q);
+	for(int atom=0; atom<nAtoms; atom++)
+	{	complex SV = Vradial * phases(atom, iGarr[n]);
+		complex* Vatom = Vnl + atom*atomStride + n;
+		for(int lpm=0; lpm<=2*l; lpm++)
+			Vatom[lpm*mStride] = Y[lpm] * SV;
+	}
 }
+
 //! Derivative of above with respect to Cartesian k in direction iDir
 template<int l, int m> __hostanddev__
 void VnlPrime_calc(int n, int atomStride, int nAtoms, const vector3<>& k, const vector3<int>* iGarr,
-	const matrix3<>& G, const vector3<>* pos, const RadialFunctionG& VnlRadial,
+	const matrix3<>& G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial,
 	const vector3<>& dir, const vector3<>& RTdir, complex* Vprime)
 {
 	vector3<> kpG = k + iGarr[n]; //k+G in reciprocal lattice coordinates:
@@ -65,18 +118,33 @@ void VnlPrime_calc(int n, int atomStride, int nAtoms, const vector3<>& k, const
 	double prefac = Y*Vradial, predac_qDir = Y_qDir*Vradial + Y*Vradial_qDir;
 	//Loop over columns (multiple atoms at same l,m):
 	for(int atom=0; atom<nAtoms; atom++)
-	{	complex S = cis((-2*M_PI)*dot(pos[atom],kpG));
+	{	complex S = phases(atom, iGarr[n]);
 		complex S_qDir = S * complex(0.,-dot(pos[atom],RTdir));
 		Vprime[atom*atomStride+n] = predac_qDir*S + prefac*S_qDir;
 	}
 }
 //! Driver routine for calculating Vnl for all basis functions
 //! If derivDir is non-null, then calculate derivative with respect to Cartesian k oprojected along *derivDir
+//! The structure factors are taken from phases, initialized for the same atoms at this k (pos is only needed for derivatives),
+//! and the radial function from shells if provided (values of VnlRadial at the shells of this basis; unused for derivatives)
 void Vnl(int nbasis, int atomStride, int nAtoms, int l, int m, const vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* Vnl, const vector3<>* derivDir=0);
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* Vnl,
+	const vector3<>* derivDir=0, const RadialShellValues& shells=RadialShellValues());
 #ifdef GPU_ENABLED
 void Vnl_gpu(int nbasis, int atomStride, int nAtoms, int l, int m, const vector3<> k, const vector3<int>* iGarr,
-	const matrix3<> G, const vector3<>* pos, const RadialFunctionG& VnlRadial, complex* Vnl, const vector3<>* derivDir=0);
+	const matrix3<> G, const vector3<>* pos, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* Vnl,
+	const vector3<>* derivDir=0, const RadialShellValues& shells=RadialShellValues());
+#endif
+
+//! Driver routine for calculating Vnl for all 2l+1 values of m in one pass over the basis,
+//! with the projector for each m stored at an offset of (l+m)*mStride from Vnl (values only; use Vnl above for derivatives)
+void VnlAll(int nbasis, int mStride, int atomStride, int nAtoms, int l, const vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* Vnl,
+	const RadialShellValues& shells=RadialShellValues());
+#ifdef GPU_ENABLED
+void VnlAll_gpu(int nbasis, int mStride, int atomStride, int nAtoms, int l, const vector3<> k, const vector3<int>* iGarr,
+	const matrix3<> G, const AtomPhaseTables& phases, const RadialFunctionG& VnlRadial, complex* Vnl,
+	const RadialShellValues& shells=RadialShellValues());
 #endif
 
 
@@ -113,6 +181,7 @@ template<int Nlm, typename Functor> __hostanddev__ void staticLoopYlm(Functor* f
 //! Augment electron density by spherical functions (radial functions multiplied by spherical harmonics)
 //! and propagate gradient w.r.t to it to that w.r.t the atom position (accumulate)
 //! (In MPI mode, each process only collects contributions for a subset of G-vectors)
+//! All atoms of a species are handled in one pass over the grid, with the radial coefficients of each atom at a stride of Nlm*nCoeff
 struct nAugmentFunctor
 {	vector3<> qhat; double q;
 	int nCoeff; double dGinv; const double* nRadial;
@@ -136,19 +205,23 @@ struct nAugmentFunctor
 };
 template<int Nlm> __hostanddev__
 void nAugment_calc(int i, const vector3<int>& iG, const matrix3<>& G,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n)
-{
-	nAugmentFunctor functor(iG*G, nCoeff, dGinv, nRadial);
-	staticLoopYlm<Nlm>(&functor);
-	n[i] += functor.n * cis((-2*M_PI)*dot(atpos,iG));
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n)
+{	vector3<> qvec = iG*G;
+	complex nSum;
+	for(int atom=0; atom<nAtoms; atom++)
+	{	nAugmentFunctor functor(qvec, nCoeff, dGinv, nRadial+atom*Nlm*nCoeff);
+		staticLoopYlm<Nlm>(&functor);
+		nSum += functor.n * cis((-2*M_PI)*dot(atpos[atom],iG));
+	}
+	n[i] += nSum;
 }
 void nAugment(int Nlm,
 	const vector3<int> S, const matrix3<>& G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n);
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n);
 #ifdef GPU_ENABLED
 void nAugment_gpu(int Nlm,
 	const vector3<int> S, const matrix3<>& G, int iGstart, int iGstop,
-	int nCoeff, double dGinv, const double* nRadial, const vector3<>& atpos, complex* n);
+	int nCoeff, double dGinv, const double* nRadial, int nAtoms, const vector3<>* atpos, complex* n);
 #endif
 
 //Function for initializing the index arrays used by nAugmentGrad
@@ -156,6 +229,11 @@ void nAugment_gpu(int Nlm,
 void setNagIndex(const vector3<int>& S, const matrix3<>& G, int iGstart, int iGstop,
 	int nCoeff, double dGinv, uint64_t* nagIndex, size_t* nagIndexPtr);
 
+//! Update index arrays initialized by setNagIndex (for the same grid and nCoeff) to a new metric G:
+//! only entries whose radial bin changed are re-sorted and merged back, which is cheap for small strains
+void updateNagIndex(const vector3<int>& S, const matrix3<>& G, int iGstart, int iGstop,
+	int nCoeff, double dGinv, uint64_t* nagIndex, size_t* nagIndexPtr);
+
 //Gradient propragation corresponding to nAugment:
 //(The MPI division happens implicitly here, because nagIndex is limited to each process's share (see above))
 struct nAugmentGradFunctor
@@ -214,33 +292,34 @@ void nAugmentGrad_gpu(int Nlm, const vector3<int> S, const matrix3<>& G,
 #endif
 
 
-//!Get structure factor for a specific iG, given a list of atoms
-__hostanddev__ complex getSG_calc(const vector3<int>& iG, const int& nAtoms, const vector3<>* atpos)
+//!Get structure factor for a specific iG, given the phase tables of a list of atoms
+__hostanddev__ complex getSG_calc(const vector3<int>& iG, const int& nAtoms, const AtomPhaseTables& phases)
 {	complex SG = complex(0,0);
 	for(int atom=0; atom<nAtoms; atom++)
-		SG += cis(-2*M_PI*dot(iG,atpos[atom]));
+		SG += phases(atom, iG);
 	return SG;
 }
 //!Get structure factor in a ScalarFieldTilde's data/dataGpu (with 1/vol normalization factor)
-void getSG(const vector3<int> S, int nAtoms, const vector3<>* atpos, double invVol, complex* SG);
+void getSG(const vector3<int> S, int nAtoms, const AtomPhaseTables& phases, double invVol, complex* SG);
 #ifdef GPU_ENABLED
-void getSG_gpu(const vector3<int> S, int nAtoms, const vector3<>* atpos, double invVol, complex* SG);
+void getSG_gpu(const vector3<int> S, int nAtoms, const AtomPhaseTables& phases, double invVol, complex* SG);
 #endif
 
-//! Calculate local pseudopotential, ionic density and chargeball due to one species at a given G-vector
+//! Calculate local pseudopotential, ionic density and chargeball due to one species at a given G-vector,
+//! with the radial functions evaluated at the shells of the half G-space (see RadialShells)
 __hostanddev__ void updateLocal_calc(int i, const vector3<int>& iG, const matrix3<>& GGT,
 	complex *Vlocps, complex *rhoIon, complex *nChargeball, complex* nCore, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG& VlocRadial,
-	double Z, const RadialFunctionG& nCoreRadial, const RadialFunctionG& tauCoreRadial,
+	int nAtoms, const AtomPhaseTables& phases, double invVol, const RadialShellValues& VlocShells,
+	double Z, const RadialShellValues& nCoreShells, const RadialShellValues& tauCoreShells,
 	double Zchargeball, double wChargeball)
 {
 	double Gsq = GGT.metric_length_squared(iG);
 
 	//Compute structure factor (scaled by 1/detR):
-	complex SGinvVol = getSG_calc(iG, nAtoms, atpos) * invVol;
+	complex SGinvVol = getSG_calc(iG, nAtoms, phases) * invVol;
 
 	//Short-ranged part of Local potential (long-ranged part added on later in IonInfo.cpp):
-	Vlocps[i] += SGinvVol * VlocRadial(sqrt(Gsq));
+	Vlocps[i] += SGinvVol * VlocShells(i);
 
 	//Nuclear charge (optionally widened to a gaussian later in IonInfo.cpp):
 	rhoIon[i] += SGinvVol * (-Z);
@@ -250,19 +329,19 @@ __hostanddev__ void updateLocal_calc(int i, const vector3<int>& iG, const matrix
 		nChargeball[i] += SGinvVol * Zchargeball * exp(-0.5*Gsq*pow(wChargeball,2));
 
 	//Partial core:
-	if(nCore) nCore[i] += SGinvVol * nCoreRadial(sqrt(Gsq));
-	if(tauCore) tauCore[i] += SGinvVol * tauCoreRadial(sqrt(Gsq));
+	if(nCore) nCore[i] += SGinvVol * nCoreShells(i);
+	if(tauCore) tauCore[i] += SGinvVol * tauCoreShells(i);
 }
 void updateLocal(const vector3<int> S, const matrix3<> GGT,
 	complex *Vlocps,  complex *rhoIon, complex *n_chargeball, complex* n_core, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG& VlocRadial,
-	double Z, const RadialFunctionG& nCoreRadial, const RadialFunctionG& tauCoreRadial,
+	int nAtoms, const AtomPhaseTables& phases, double invVol, const RadialShellValues& VlocShells,
+	double Z, const RadialShellValues& nCoreShells, const RadialShellValues& tauCoreShells,
 	double Zchargeball, double wChargeball);
 #ifdef GPU_ENABLED
 void updateLocal_gpu(const vector3<int> S, const matrix3<> GGT,
 	complex *Vlocps,  complex *rhoIon, complex *n_chargeball, complex* n_core, complex* tauCore,
-	int nAtoms, const vector3<>* atpos, double invVol, const RadialFunctionG& VlocRadial,
-	double Z, const RadialFunctionG& nCoreRadial, const RadialFunctionG& tauCoreRadial,
+	int nAtoms, const AtomPhaseTables& phases, double invVol, const RadialShellValues& VlocShells,
+	double Z, const RadialShellValues& nCoreShells, const RadialShellValues& tauCoreShells,
 	double Zchargeball, double wChargeball);
 #endif
 
@@ -327,5 +406,40 @@ void gradSGtoAtpos_gpu(const vector3<int> S, const vector3<> atpos,
 	const complex* ccgrad_SG, vector3<complex*> grad_atpos);
 #endif
 
+//! Nonlocal projectors of one species in real space (see command realspace-projectors).
+//! The radial functions are filtered using a King-Smith mask, so that they are confined within rCut,
+//! while remaining accurate for the wavevectors within the wavefunction cutoff.
+struct RealSpaceProjectors
+{	double dr; //!< radial sample spacing
+	double rCut; //!< maximum radius of all projectors
+	std::vector< std::vector< std::vector<double> > > radial; //!< radial samples (indexed by l, projector and radial grid point), zero beyond the last sample
+	
+	//! Radial function of l and projector p at radius r (linear interpolation)
+	inline double radialValue(int l, int p, double r) const
+	{	const std::vector<double>& samples = radial[l][p];
+		double t = r/dr; int i = int(t);
+		if(i+1 >= int(samples.size())) return 0.;
+		t -= i;
+		return samples[i] + t*(samples[i+1]-samples[i]);
+	}
+	
+	//! Compute all projectors (in the order l, p, m of SpeciesInfo::getV) at Cartesian displacement x
+	//! from the atom, multiplied by phase, storing the result at P[iProj*stride]; returns the number of projectors
+	inline int calc(const vector3<>& x, complex phase, complex* P, size_t stride) const
+	{	double r = x.length();
+		vector3<> xhat = x * (r ? 1.0/r : 0.0); //direction at r=0 doesn't matter (only l=0 survives)
+		int iProj = 0;
+		for(int l=0; l<int(radial.size()); l++)
+		{	complex lPhase = phase * cis(0.5*M_PI*l); //i^l from the plane-wave expansion
+			for(unsigned p=0; p<radial[l].size(); p++)
+			{	double f = radialValue(l, p, r);
+				for(int m=-l; m<=l; m++)
+					P[(iProj++)*stride] = (f ? f*Ylm(l, m, xhat) : 0.) * lPhase;
+			}
+		}
+		return iProj;
+	}
+};
+
 //! @}
 #endif // JDFTX_ELECTRONIC_SPECIESINFO_INTERNAL_H
@@ -0,0 +1,238 @@
+/*-------------------------------------------------------------------
+Copyright 2011 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+
+#include <electronic/SpeciesInfo.h>
+#include <electronic/SpeciesInfo_internal.h>
+#include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
+#include <core/Operators.h>
+#include <core/Thread.h>
+
+//Simpson-rule weight for sample i of n (n even) with unit spacing
+inline double simpsonWeight(int i, int n) { return (i==0 || i==n) ? 1./3 : ((i%2) ? 4./3 : 2./3); }
+
+//Round up to an even number (for Simpson-rule integration)
+inline int roundEven(double x) { return 2*int(ceil(0.5*x)); }
+
+void SpeciesInfo::setupRealSpaceProjectors()
+{	if(isGpuEnabled())
+	{	logPrintf("  WARNING: real-space projectors are not yet supported on GPUs; using reciprocal-space projectors.\n");
+		return;
+	}
+	const double tol = e->cntrl.realSpaceProjectorTol;
+	const double Gwfns = sqrt(2.*e->cntrl.Ecut); //wavefunction cutoff (projectors need to be accurate only below this)
+	const double rMax = 10.; //maximum radius of real-space projectors (bohrs)
+	const double dr = 0.005; //radial grid spacing for tabulating real-space projectors (bohrs)
+	const double dq = 0.01; //reciprocal space integration grid spacing (bohr^-1)
+	const double maskAlpha = 4.; //King-Smith mask exp(-maskAlpha (r/rCut)^2)
+	const double qFilterFactor = 1.5; //filter in reciprocal space to this multiple of Gwfns
+	int nr = roundEven(rMax/dr);
+	
+	auto rsp = std::make_shared<RealSpaceProjectors>();
+	rsp->dr = dr;
+	rsp->rCut = 0.;
+	rsp->radial.resize(VnlRadial.size());
+	for(int l=0; l<int(VnlRadial.size()); l++)
+	{	rsp->radial[l].resize(VnlRadial[l].size());
+		for(unsigned p=0; p<VnlRadial[l].size(); p++)
+		{	const RadialFunctionG& f = VnlRadial[l][p];
+			//Real-space radial function beta(r) = (1/2pi^2) int dq q^2 f(q) j_l(qr):
+			double qMax = (f.nCoeff-5) / f.dGinv;
+			int nq = roundEven(qMax/dq); double hq = qMax/nq;
+			std::vector<double> fw(nq+1);
+			for(int i=0; i<=nq; i++)
+			{	double q = i*hq;
+				fw[i] = simpsonWeight(i,nq) * hq * q*q * f(q) / (2*M_PI*M_PI);
+			}
+			std::vector<double> beta(nr+1); double betaMax = 0.;
+			for(int j=0; j<=nr; j++)
+			{	double r = j*dr, sum = 0.;
+				for(int i=0; i<=nq; i++) sum += fw[i] * bessel_jl(l, i*hq*r);
+				beta[j] = sum;
+				betaMax = std::max(betaMax, fabs(sum));
+			}
+			//Determine extent, beyond which |beta| < tol * max|beta|:
+			int jCut = nr;
+			while(jCut>2 && fabs(beta[jCut-1]) < tol*betaMax) jCut--;
+			jCut = std::min(nr, roundEven(jCut));
+			double rCut = jCut*dr;
+			//King-Smith filtering: chi = beta/mask within rCut, restricted to q < qFilter, then multiplied by mask:
+			std::vector<double> mask(jCut+1), chiw(jCut+1);
+			for(int j=0; j<=jCut; j++)
+			{	double r = j*dr;
+				mask[j] = exp(-maskAlpha*std::pow(r/rCut,2));
+				chiw[j] = simpsonWeight(j,jCut) * dr * 4*M_PI * r*r * beta[j] / mask[j];
+			}
+			double qFilter = qFilterFactor * Gwfns;
+			int nqFilter = roundEven(qFilter/dq); double hqFilter = qFilter/nqFilter;
+			std::vector<double> chiTilde(nqFilter+1);
+			for(int i=0; i<=nqFilter; i++)
+			{	double q = i*hqFilter, sum = 0.;
+				for(int j=0; j<=jCut; j++) sum += chiw[j] * bessel_jl(l, q*j*dr);
+				chiTilde[i] = simpsonWeight(i,nqFilter) * hqFilter * q*q * sum / (2*M_PI*M_PI);
+			}
+			std::vector<double>& samples = rsp->radial[l][p];
+			samples.resize(jCut+1);
+			for(int j=0; j<=jCut; j++)
+			{	double r = j*dr, sum = 0.;
+				for(int i=0; i<=nqFilter; i++) sum += chiTilde[i] * bessel_jl(l, i*hqFilter*r);
+				samples[j] = mask[j] * sum;
+			}
+			samples[jCut] = 0.; //so that the interpolated projector vanishes continuously at rCut
+			rsp->rCut = std::max(rsp->rCut, rCut);
+		}
+	}
+	realSpaceProjectors = rsp;
+	logPrintf("  Applying nonlocal projectors in real space within %.2lf bohrs of each atom.\n", rsp->rCut);
+}
+
+void SpeciesInfo::getRealSpaceProjectors(const ColumnBundle& Cq, int atom, std::vector<int>& index, matrix& P) const
+{	const GridInfo& gInfo = *(Cq.basis->gInfo);
+	const RealSpaceProjectors& rsp = *realSpaceProjectors;
+	const vector3<>& pos = atpos[atom];
+	const vector3<>& k = Cq.qnum->k;
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	//Range of (unwrapped) grid points that could be within rCut:
+	vector3<int> iMin, iMax;
+	for(int d=0; d<3; d++)
+	{	double extent = rsp.rCut * gInfo.G.row(d).length() / (2*M_PI); //extent of sphere in lattice coordinate d
+		iMin[d] = int(ceil((pos[d]-extent) * gInfo.S[d]));
+		iMax[d] = int(floor((pos[d]+extent) * gInfo.S[d]));
+	}
+	//Collect points within rCut (periodic images of a grid point are listed separately):
+	std::vector<vector3<>> xList; //displacements from atom in lattice coordinates
+	index.clear();
+	double rCutSq = rsp.rCut * rsp.rCut;
+	vector3<int> i;
+	for(i[0]=iMin[0]; i[0]<=iMax[0]; i[0]++)
+	for(i[1]=iMin[1]; i[1]<=iMax[1]; i[1]++)
+	for(i[2]=iMin[2]; i[2]<=iMax[2]; i[2]++)
+	{	vector3<> x; for(int d=0; d<3; d++) x[d] = i[d]*(1./gInfo.S[d]) - pos[d];
+		if((gInfo.R * x).length_squared() >= rCutSq) continue;
+		vector3<int> iWrapped;
+		for(int d=0; d<3; d++) iWrapped[d] = ((i[d] % gInfo.S[d]) + gInfo.S[d]) % gInfo.S[d];
+		index.push_back(gInfo.fullRindex(iWrapped));
+		xList.push_back(x);
+	}
+	//Compute projectors, normalized so that P^C_r matches V^C in reciprocal space
+	//(where C_r is the result of I, which includes the periodic part of the Bloch phase alone):
+	int nPts = index.size();
+	P.init(nPts, nProj);
+	complex* Pdata = P.data();
+	double prefac = gInfo.detR / gInfo.nr;
+	for(int iPt=0; iPt<nPts; iPt++)
+	{	const vector3<>& x = xList[iPt];
+		complex phase = prefac * cis(-2*M_PI*dot(k, x+pos));
+		rsp.calc(gInfo.R * x, phase, Pdata+iPt, nPts);
+	}
+}
+
+//Number of columns to transform together, limiting the scratch memory
+inline int realSpaceBatchCols(const ColumnBundle& C)
+{	const size_t scratchMax = size_t(1)<<28; //256 MB
+	size_t colBytes = sizeof(complex) * C.basis->gInfo->nr * C.spinorLength();
+	return std::max(1, std::min(C.nCols(), int(scratchMax / colBytes)));
+}
+
+matrix SpeciesInfo::getVdagC_realSpace(const ColumnBundle& Cq) const
+{	static StopWatch watch("getVdagC(realSpace)"); watch.start();
+	const GridInfo& gInfo = *(Cq.basis->gInfo);
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	int nAtoms = atpos.size();
+	int nSpinor = Cq.spinorLength();
+	//Projectors near each atom:
+	std::vector<std::vector<int>> index(nAtoms);
+	std::vector<matrix> P(nAtoms);
+	auto getProjectors = [&](size_t atomStart, size_t atomStop)
+	{	for(size_t atom=atomStart; atom<atomStop; atom++)
+			getRealSpaceProjectors(Cq, atom, index[atom], P[atom]);
+	};
+	threadLaunch(&getProjectors, nAtoms);
+	//Project in batches of columns (spinor components as separate columns, as in V^C with non-spinor V):
+	matrix VdagC(nProj*nAtoms, Cq.nCols()*nSpinor);
+	int nBatch = realSpaceBatchCols(Cq);
+	ManagedArray<complex> buf; buf.init(gInfo.nr*nSpinor*nBatch);
+	for(int colBatch=0; colBatch<Cq.nCols(); colBatch+=nBatch)
+	{	int colStop = std::min(colBatch+nBatch, Cq.nCols());
+		int nBoxes = (colStop-colBatch)*nSpinor;
+		Cq.getColumns(colBatch, colStop, buf.data());
+		I_batch(gInfo, buf.data(), nBoxes);
+		for(int atom=0; atom<nAtoms; atom++)
+		{	const std::vector<int>& idx = index[atom];
+			int nPts = idx.size();
+			matrix Cs(nPts, nBoxes); //wavefunctions at points near atom
+			complex* CsData = Cs.data();
+			for(int j=0; j<nBoxes; j++)
+			{	const complex* psi = buf.data() + gInfo.nr*j;
+				for(int iPt=0; iPt<nPts; iPt++) CsData[iPt+nPts*j] = psi[idx[iPt]];
+			}
+			VdagC.set(atom*nProj, (atom+1)*nProj, colBatch*nSpinor, colStop*nSpinor, dagger(P[atom]) * Cs);
+		}
+	}
+	watch.stop();
+	return VdagC;
+}
+
+void SpeciesInfo::accumV_realSpace(const matrix& M, ColumnBundle& HCq) const
+{	static StopWatch watch("accumV(realSpace)"); watch.start();
+	const GridInfo& gInfo = *(HCq.basis->gInfo);
+	int nProj = MnlAll.nRows() / e->eInfo.spinorLength();
+	int nAtoms = atpos.size();
+	int nSpinor = HCq.spinorLength();
+	assert(M.nRows() == nProj*nAtoms*nSpinor); //rows of M interleaved by spin for spinor HCq
+	assert(M.nCols() == HCq.nCols());
+	//Projectors near each atom:
+	std::vector<std::vector<int>> index(nAtoms);
+	std::vector<matrix> P(nAtoms);
+	auto getProjectors = [&](size_t atomStart, size_t atomStop)
+	{	for(size_t atom=atomStart; atom<atomStop; atom++)
+			getRealSpaceProjectors(HCq, atom, index[atom], P[atom]);
+	};
+	threadLaunch(&getProjectors, nAtoms);
+	//Accumulate in batches of columns:
+	int nBatch = realSpaceBatchCols(HCq);
+	ManagedArray<complex> buf; buf.init(gInfo.nr*nSpinor*nBatch);
+	const complex* Mdata = M.data();
+	for(int colBatch=0; colBatch<HCq.nCols(); colBatch+=nBatch)
+	{	int colStop = std::min(colBatch+nBatch, HCq.nCols());
+		int nBoxes = (colStop-colBatch)*nSpinor;
+		eblas_zero(gInfo.nr*nBoxes, buf.data());
+		for(int atom=0; atom<nAtoms; atom++)
+		{	//Coefficients of this atom's projectors for each real-space column:
+			matrix Ma(nProj, nBoxes);
+			complex* MaData = Ma.data();
+			for(int b=colBatch; b<colStop; b++)
+				for(int s=0; s<nSpinor; s++)
+					for(int p=0; p<nProj; p++)
+						MaData[p+nProj*((b-colBatch)*nSpinor+s)] = Mdata[M.index(nSpinor*(atom*nProj+p)+s, b)];
+			matrix Hs = P[atom] * Ma; //contributions at points near atom
+			const complex* HsData = Hs.data();
+			const std::vector<int>& idx = index[atom];
+			int nPts = idx.size();
+			for(int j=0; j<nBoxes; j++)
+			{	complex* Hpsi = buf.data() + gInfo.nr*j;
+				for(int iPt=0; iPt<nPts; iPt++) Hpsi[idx[iPt]] += HsData[iPt+nPts*j];
+			}
+		}
+		Idag_batch(gInfo, buf.data(), nBoxes);
+		HCq.accumColumns(colBatch, colStop, buf.data());
+	}
+	watch.stop();
+}
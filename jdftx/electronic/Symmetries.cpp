@@ -170,6 +170,28 @@ void Symmetries::symmetrize(complexScalarFieldTilde& x) const
 	callPref(eblas_symmetrize)(nSymmClasses, sym.size(), symmIndex.dataPref(), symmMult.dataPref(), symmIndexPhase.dataPref(), x->dataPref());
 }
 
+void Symmetries::symmetrize(ScalarFieldArray& x) const
+{	if(sym.size()==1 || !x.size()) return; // No symmetries or fields, nothing to do
+	if(x.size()==1) { if(x[0]) symmetrize(x[0]); return; }
+	static StopWatch watch("Symmetries::symmetrize"); watch.start();
+	std::vector<complexScalarFieldTilde> xTilde(x.size());
+	for(unsigned s=0; s<x.size(); s++)
+		if(x[s]) xTilde[s] = J(Complex(x[s]));
+	int nSymmClasses = symmIndex.nData() / sym.size(); //number of equivalence classes
+	#ifdef GPU_ENABLED
+	for(complexScalarFieldTilde& xs: xTilde)
+		if(xs) eblas_symmetrize_gpu(nSymmClasses, sym.size(), symmIndex.dataGpu(), symmMult.dataGpu(), symmIndexPhase.dataGpu(), xs->dataGpu());
+	#else
+	std::vector<complex*> xData;
+	for(complexScalarFieldTilde& xs: xTilde)
+		if(xs) xData.push_back(xs->data());
+	eblas_symmetrize(nSymmClasses, sym.size(), symmIndex.data(), symmMult.data(), symmIndexPhase.data(), xData.size(), xData.data());
+	#endif
+	for(unsigned s=0; s<x.size(); s++)
+		if(x[s]) x[s] = Real(I(xTilde[s]));
+	watch.stop();
+}
+
 //Symmetrize forces:
 void Symmetries::symmetrize(IonicGradient& f) const
 {	if(sym.size() <= 1) return;
@@ -198,17 +220,27 @@ void Symmetries::symmetrizeSpherical(matrix& X, const SpeciesInfo* specie) const
 	assert(X.nCols()==nTot);
 	if(!l || sym.size()==1) return; //symmetries do nothing
 	const std::vector<matrix>& sym_l = getSphericalMatrices(l, specie->isRelativistic());
-	matrix result;
+	//Apply each rotation block-wise, moving the atom-pair blocks according to the atom maps
+	//(equivalent to m X m^ with the block-sparse transformation m, without forming it):
+	std::vector<matrix> blocks(nAtoms*nAtoms), resultBlocks(nAtoms*nAtoms);
+	for(int atom1=0; atom1<nAtoms; atom1++)
+		for(int atom2=0; atom2<nAtoms; atom2++)
+			blocks[atom1*nAtoms+atom2] = X(atom1*orbCount,(atom1+1)*orbCount, atom2*orbCount,(atom2+1)*orbCount);
 	for(unsigned iRot=0; iRot<sym_l.size(); iRot++)
-	{	//Construct transformation matrix including atom maps:
-		matrix m = zeroes(nTot, nTot);
-		for(int atom=0; atom<nAtoms; atom++)
-		{	int atomOut = atomMap[sp][atom][iRot];
-			m.set(atomOut*orbCount,(atomOut+1)*orbCount, atom*orbCount,(atom+1)*orbCount, sym_l[iRot]);
+	{	const matrix& rot = sym_l[iRot];
+		matrix rotDag = dagger(rot);
+		for(int atom1=0; atom1<nAtoms; atom1++)
+		{	int atom1out = atomMap[sp][atom1][iRot];
+			for(int atom2=0; atom2<nAtoms; atom2++)
+			{	int atom2out = atomMap[sp][atom2][iRot];
+				resultBlocks[atom1out*nAtoms+atom2out] += rot * blocks[atom1*nAtoms+atom2] * rotDag;
+			}
 		}
-		//Apply
-		result += m * X * dagger(m);
 	}
+	matrix result = zeroes(nTot, nTot);
+	for(int atom1=0; atom1<nAtoms; atom1++)
+		for(int atom2=0; atom2<nAtoms; atom2++)
+			result.set(atom1*orbCount,(atom1+1)*orbCount, atom2*orbCount,(atom2+1)*orbCount, resultBlocks[atom1*nAtoms+atom2]);
 	X = (1./sym_l.size()) * result;
 }
 
@@ -359,79 +391,108 @@ bool magMomEquivalent(const vector3<>& a, const vector3<>& b)
 {	return (a-b).length_squared() < symmThresholdSq;
 }
 
+//Species and magnetic moment of an atom, to match atoms of all species in a single lookup
+struct AtomTag
+{	int iSp; //species index
+	vector3<> M; //initial magnetic moment (zero if none)
+};
+static bool atomTagEquivalent(const AtomTag& a, const AtomTag& b)
+{	return a.iSp==b.iSp && magMomEquivalent(a.M, b.M);
+}
+
 std::vector<SpaceGroupOp> Symmetries::findSpaceGroup(const std::vector< matrix3<int> >& symLattice) const
-{	std::vector<SpaceGroupOp> spaceGroup;
-	//Loop over lattice symmetries:
-	for(const matrix3<int>& rot: symLattice)
-	{	
-		//Determine offsets after this rotation that map the structure onto itself 
-		std::vector<vector3<>> aArr; //list of candidates for the offset
-		bool firstAtom = true;
-		for(auto sp: e->iInfo.species)
-		{	const std::vector< vector3<> >* M = sp->initialMagneticMoments.size() ? &sp->initialMagneticMoments : 0;
-			for(size_t a1=0; a1<sp->atpos.size(); a1++)
-			{
-				//Generate list of offsets that would work for current atom by itself:
-				std::vector<vector3<>> aCur;
-				PeriodicLookup<vector3<>> plook(aCur, (~e->gInfo.R) * e->gInfo.R);
-				vector3<> pos1rot = rot*sp->atpos[a1]; //rotated version of a1 position
-				vector3<> M1rot; if(M) M1rot = (e->eInfo.spinType==SpinVector ? rot*(*M)[a1] : (*M)[a1]); //original or rotated M[a1] depending on spin type
-				for(size_t a2=0; a2<sp->atpos.size(); a2++)
-					if( (!M) || magMomEquivalent(M1rot, (*M)[a2]) )
-					{	vector3<> dpos = Diag(sup) * (sp->atpos[a2] - pos1rot); //note in unit cell coordinates (matters if this is a phonon supercell)
-						for(int k=0; k<3; k++) dpos[k] -= floor(0.5+dpos[k]); //wrap offset to base cell
-						if(plook.find(dpos) == string::npos) //keep offsets unique modulo unit cell (rather than supercell in the phonon case)
-						{	plook.addPoint(aCur.size(), dpos);
-							aCur.push_back(dpos);
-						}
-					}
-				
-				//Intersect current candidates with global list:
-				if(firstAtom)
-				{	aArr = aCur; //no previous list; intersection = current
-					firstAtom = false;
-					continue;
+{	static StopWatch watch("findSpaceGroup"); watch.start();
+	const std::vector<std::shared_ptr<SpeciesInfo>>& species = e->iInfo.species;
+	bool rotateM = (e->eInfo.spinType==SpinVector); //whether magnetic moments rotate with the atoms
+	
+	//Collect all atoms in unit cell coordinates (matters if this is a phonon supercell) in a single lookup,
+	//and pick the species with fewest atoms to seed candidate offsets:
+	matrix3<> supDiag = Diag(vector3<>(sup)), invSup = inv(supDiag);
+	std::vector< vector3<> > posCell; std::vector<AtomTag> tags;
+	std::vector<size_t> spStart(species.size()+1, 0); //range of each species in the combined lists
+	int iSpSeed = -1;
+	for(size_t iSp=0; iSp<species.size(); iSp++)
+	{	const SpeciesInfo& sp = *species[iSp];
+		for(size_t a=0; a<sp.atpos.size(); a++)
+		{	posCell.push_back(supDiag * sp.atpos[a]);
+			AtomTag tag; tag.iSp = iSp;
+			if(sp.initialMagneticMoments.size()) tag.M = sp.initialMagneticMoments[a];
+			tags.push_back(tag);
+		}
+		spStart[iSp+1] = posCell.size();
+		if(sp.atpos.size() && (iSpSeed<0 || sp.atpos.size() < species[iSpSeed]->atpos.size()))
+			iSpSeed = iSp;
+	}
+	if(iSpSeed < 0) //Special handling for system with no atoms: space group = point group
+	{	std::vector<SpaceGroupOp> spaceGroup;
+		for(const matrix3<int>& rot: symLattice)
+			spaceGroup.push_back(SpaceGroupOp(rot, vector3<>()));
+		watch.stop();
+		return spaceGroup;
+	}
+	PeriodicLookup< vector3<> > plookCell(posCell, invSup * ((~e->gInfo.R) * e->gInfo.R) * invSup); //matches modulo unit cell
+	std::vector<std::shared_ptr<PeriodicLookup< vector3<> >>> plookSp; //per-species lookups in the (super)cell, for refining offsets
+	for(auto sp: species)
+		plookSp.push_back(std::make_shared<PeriodicLookup< vector3<> >>(sp->atpos, (~e->gInfo.R) * e->gInfo.R));
+	
+	//Find and refine offsets for each lattice symmetry (independently, in parallel):
+	std::vector<std::vector<SpaceGroupOp>> spaceGroupRot(symLattice.size());
+	auto processRotations = [&](size_t iRotStart, size_t iRotStop)
+	{	for(size_t iRot=iRotStart; iRot<iRotStop; iRot++)
+		{	const matrix3<int>& rot = symLattice[iRot];
+			//Rotated atoms in unit cell coordinates (with rotated magnetic moments, if appropriate):
+			std::vector< vector3<> > posRot(posCell.size());
+			std::vector<AtomTag> tagsRot(tags);
+			for(size_t iSp=0; iSp<species.size(); iSp++)
+				for(size_t i=spStart[iSp]; i<spStart[iSp+1]; i++)
+				{	posRot[i] = supDiag * (rot * species[iSp]->atpos[i-spStart[iSp]]);
+					if(rotateM) tagsRot[i].M = rot * tags[i].M;
 				}
-				std::vector<vector3<>> aNext; //intersection results
-				if(aCur.size())
-				{	for(vector3<> a: aArr)
-						if(plook.find(a) != string::npos)
-							aNext.push_back(a);
+			//Candidate offsets that map the first seed atom onto some seed atom (unique modulo unit cell):
+			size_t i1 = spStart[iSpSeed];
+			std::vector< vector3<> > aCandidates;
+			PeriodicLookup< vector3<> > plookCandidates(aCandidates, invSup * ((~e->gInfo.R) * e->gInfo.R) * invSup, spStart[iSpSeed+1]-i1);
+			for(size_t i2=i1; i2<spStart[iSpSeed+1]; i2++)
+				if(atomTagEquivalent(tagsRot[i1], tags[i2]))
+				{	vector3<> dpos = posCell[i2] - posRot[i1];
+					for(int k=0; k<3; k++) dpos[k] -= floor(0.5+dpos[k]); //wrap offset to base cell
+					if(plookCandidates.find(dpos) == string::npos)
+					{	plookCandidates.addPoint(aCandidates.size(), dpos);
+						aCandidates.push_back(dpos);
+					}
 				}
-				aArr = aNext;
-				
-				if(!aArr.size()) break;
-			}
-			if(!aArr.size()) break;
-		}
-		
-		//Special handling for system with no atoms:
-		if(firstAtom)
-		{	spaceGroup.push_back(SpaceGroupOp(rot, vector3<>())); //space group = point group
-			continue;
-		}
-		
-		//Refine offsets:
-		for(vector3<>& a: aArr)
-		{	a = inv(Diag(vector3<>(sup))) * a; //switch offset back to current cell coordinates (matters if this is a phonon supercell)
-			vector3<> daSum; int nAtoms = 0.;
-			for(auto sp: e->iInfo.species) //For each species
-			{	PeriodicLookup< vector3<> > plook(sp->atpos, (~e->gInfo.R) * e->gInfo.R);
-				const std::vector< vector3<> >* M = sp->initialMagneticMoments.size() ? &sp->initialMagneticMoments : 0;
-				for(size_t a1=0; a1<sp->atpos.size(); a1++) //For each atom
-				{	vector3<> pos1rot = rot*sp->atpos[a1] + a; //now including offset
-					vector3<> M1rot; if(M) M1rot = (e->eInfo.spinType==SpinVector ? rot*(*M)[a1] : (*M)[a1]); //original or rotated M[a1] depending on spin type
-					size_t a2 = plook.find(pos1rot, M1rot, M, magMomEquivalent); //match position and magentic moment
-					assert(a2 != string::npos); //the above algorithm should guarantee this
-					vector3<> da = sp->atpos[a2] - pos1rot;
-					for(int k=0; k<3; k++) da[k] -= floor(0.5+da[k]);
-					daSum += da; nAtoms++;
+			//Keep candidates that map every atom onto an equivalent one:
+			for(vector3<> a: aCandidates)
+			{	bool valid = true;
+				for(size_t i=0; i<posCell.size() && valid; i++)
+					valid = (plookCell.find(posRot[i] + a, tagsRot[i], &tags, atomTagEquivalent) != string::npos);
+				if(!valid) continue;
+				//Refine offset:
+				a = invSup * a; //switch offset back to current cell coordinates
+				vector3<> daSum; int nAtoms = 0;
+				for(size_t iSp=0; iSp<species.size(); iSp++)
+				{	const SpeciesInfo& sp = *species[iSp];
+					const std::vector< vector3<> >* M = sp.initialMagneticMoments.size() ? &sp.initialMagneticMoments : 0;
+					for(size_t a1=0; a1<sp.atpos.size(); a1++)
+					{	vector3<> pos1rot = rot*sp.atpos[a1] + a; //now including offset
+						size_t a2 = plookSp[iSp]->find(pos1rot, tagsRot[spStart[iSp]+a1].M, M, magMomEquivalent); //match position and magnetic moment
+						assert(a2 != string::npos); //guaranteed by the validation above
+						vector3<> da = sp.atpos[a2] - pos1rot;
+						for(int k=0; k<3; k++) da[k] -= floor(0.5+da[k]);
+						daSum += da; nAtoms++;
+					}
 				}
+				spaceGroupRot[iRot].push_back(SpaceGroupOp(rot, a + daSum/nAtoms));
 			}
-			a += daSum / nAtoms;
-			spaceGroup.push_back(SpaceGroupOp(rot, a));
 		}
-	}
+	};
+	threadLaunch(&processRotations, symLattice.size());
+	
+	//Collect in order of lattice symmetries:
+	std::vector<SpaceGroupOp> spaceGroup;
+	for(const std::vector<SpaceGroupOp>& ops: spaceGroupRot)
+		spaceGroup.insert(spaceGroup.end(), ops.begin(), ops.end());
+	watch.stop();
 	return spaceGroup;
 }
 
@@ -441,12 +502,14 @@ void Symmetries::initSymmIndex()
 
 	std::vector<int> symmIndexVec, symmMultVec;
 	std::vector<complex> symmIndexPhaseVec;
-	symmIndexVec.reserve(gInfo.nr);
-	symmMultVec.reserve(gInfo.nr / sym.size());
-	symmIndexPhaseVec.reserve(gInfo.nr);
-	std::vector<bool> done(gInfo.nr, false); //use full G-space for symmetrization
-	//Loop over all points not already handled as an image of a previous one:
-	{	const vector3<int>& S = gInfo.S;
+	//Loop over all points not already handled as an image of a previous one
+	//(only on processes that fill the node-shared index arrays):
+	if(symmIndex.isWriter())
+	{	symmIndexVec.reserve(gInfo.nr);
+		symmMultVec.reserve(gInfo.nr / sym.size());
+		symmIndexPhaseVec.reserve(gInfo.nr);
+		std::vector<bool> done(gInfo.nr, false); //use full G-space for symmetrization
+		const vector3<int>& S = gInfo.S;
 		size_t iStart = 0, iStop = gInfo.nr;
 		THREAD_fullGspaceLoop
 		(	if(!done[i])
@@ -476,14 +539,23 @@ void Symmetries::initSymmIndex()
 			}
 		)
 	}
-	//Set the final pointers:
-	int nSymmIndex = symmIndexVec.size();
+	//Set the final pointers (stored once per node):
+	int nSymmIndex = symmIndexVec.size(), nSymmMult = symmMultVec.size();
+	if(nodeSharedEnabled())
+	{	mpiHost->bcast(nSymmIndex);
+		mpiHost->bcast(nSymmMult);
+	}
 	symmIndex.init(nSymmIndex);
-	symmMult.init(symmMultVec.size());
+	symmMult.init(nSymmMult);
 	symmIndexPhase.init(nSymmIndex);
-	memcpy(symmIndex.data(), &symmIndexVec[0], nSymmIndex*sizeof(int));
-	memcpy(symmMult.data(), &symmMultVec[0], symmMultVec.size()*sizeof(int));
-	memcpy(symmIndexPhase.data(), &symmIndexPhaseVec[0], nSymmIndex*sizeof(complex));
+	if(symmIndex.isWriter())
+	{	memcpy(symmIndex.data(), &symmIndexVec[0], nSymmIndex*sizeof(int));
+		memcpy(symmMult.data(), &symmMultVec[0], nSymmMult*sizeof(int));
+		memcpy(symmIndexPhase.data(), &symmIndexPhaseVec[0], nSymmIndex*sizeof(complex));
+	}
+	symmIndex.commit();
+	symmMult.commit();
+	symmIndexPhase.commit();
 }
 
 void Symmetries::sortSymmetries()
@@ -23,6 +23,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/matrix3.h>
 #include <core/ScalarField.h>
+#include <core/ScalarFieldArray.h>
 #include <list>
 
 class Everything;
@@ -49,6 +50,7 @@ public:
 	void symmetrize(ScalarField&) const; //!< symmetrize a scalar field
 	void symmetrize(ScalarFieldTilde&) const; //!< symmetrize a scalar field
 	void symmetrize(complexScalarFieldTilde&) const; //!< symmetrize a scalar field
+	void symmetrize(ScalarFieldArray&) const; //!< symmetrize several scalar fields (eg. spin channels) together, sharing the passes over the symmetry orbits
 	void symmetrize(struct IonicGradient&) const; //!< symmetrize forces
 	void symmetrizeSpherical(matrix&, const class SpeciesInfo* specie) const; //!< symmetrize matrices in Ylm basis per atom of species sp (accounting for atom maps)
 	const std::vector<SpaceGroupOp>& getMatrices() const; //!< directly access the symmetry matrices (in lattice coords)
@@ -82,10 +84,10 @@ private:
 	void checkFFTbox(); //!< verify that the sampled mesh is commensurate with symmetries
 	void checkSymmetries(); //!< check validity of manually specified symmetry matrices
 	
-	//Index map for scalar field (electron density, potential) symmetrization in reciprocal space
-	IndexArray symmIndex; //negative index corresponds to real-symmetry-folded part of G-space (which will be complex conjugated)
-	ManagedArray<complex> symmIndexPhase; //phase factor for entry at each index
-	IndexArray symmMult; //multiplicity (how many times each element is repeated) in each equivalence class
+	//Index map for scalar field (electron density, potential) symmetrization in reciprocal space (stored once per node):
+	NodeSharedArray<int> symmIndex; //negative index corresponds to real-symmetry-folded part of G-space (which will be complex conjugated)
+	NodeSharedArray<complex> symmIndexPhase; //phase factor for entry at each index
+	NodeSharedArray<int> symmMult; //multiplicity (how many times each element is repeated) in each equivalence class
 	void initSymmIndex();
 	
 	//Atom maps:
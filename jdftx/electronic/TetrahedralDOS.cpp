@@ -20,6 +20,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/TetrahedralDOS.h>
 #include <core/LatticeUtils.h>
 #include <core/Util.h>
+#include <core/Thread.h>
 #include <algorithm>
 #include <cfloat>
 #include <map>
@@ -138,38 +139,66 @@ void TetrahedralDOS::weldEigenvalues(double Etol)
 	}
 }
 
-//Apply gaussian smoothing of width Esigma
-TetrahedralDOS::Lspline TetrahedralDOS::gaussSmooth(const Lspline& in, double Esigma) const
-{	assert(Esigma > 0.);
-	//Initialize uniform energy grid:
-	double Emin = in.front().first - 10*Esigma;
-	double Emax = in.back().first + 10*Esigma;
-	double dE = 0.2*Esigma;
-	size_t nE = ceil((Emax-Emin)/dE);
-	if(nE > 1000000) logPrintf(
-		"WARNING: very fine energy grid for DOS. If this takes too long /\n"
-		"         results in too large a file, either increase Esigma or\n"
-		"         set it\n to zero (raw output of tetrahedron method).\n" );
-	Lspline out(nE, std::make_pair(0., std::vector<double>(nWeights, 0.)));
-	for(size_t iE=0; iE<nE; iE++) out[iE].first = Emin + iE*dE;
-	//Apply the gaussian smoothing to each channel:
+//Accumulate gaussian-smoothed DOS for output energies in [iStart,iStop) from all input intervals within reach:
+static void gaussSmooth_thread(size_t iStart, size_t iStop, const TetrahedralDOS::Lspline* inPtr, TetrahedralDOS::Lspline* outPtr, double Esigma, int nWeights)
+{	const TetrahedralDOS::Lspline& in = *inPtr;
+	TetrahedralDOS::Lspline& out = *outPtr;
 	const double EsigmaDen = 1./(Esigma*sqrt(2.));
+	double Elo = out[iStart].first - 10*Esigma;
+	double Ehi = out[iStop-1].first + 10*Esigma;
+	auto outStart = out.begin()+iStart, outStop = out.begin()+iStop;
 	for(size_t iIn=0; iIn+1<in.size(); iIn++)
 	{	const double& E0 = in[ iIn ].first; const std::vector<double>& w0 = in[ iIn ].second;
 		const double& E1 = in[iIn+1].first; const std::vector<double>& w1 = in[iIn+1].second;
-		if(E1==E0) continue;
-		size_t iEstart = std::max(floor((E0-10*Esigma-Emin)/dE), 0.);
-		size_t iEstop = std::min(ceil((E1+10*Esigma-Emin)/dE), double(nE));
-		for(size_t iE=iEstart; iE<iEstop; iE++)
-		{	double E = out[iE].first;
+		if(E1==E0 || E1<Elo || E0>Ehi) continue;
+		auto oStart = std::lower_bound(outStart, outStop, E0-10*Esigma,
+			[](const TetrahedralDOS::LsplineElem& l, double E) { return l.first < E; });
+		auto oStop = std::upper_bound(oStart, outStop, E1+10*Esigma,
+			[](double E, const TetrahedralDOS::LsplineElem& l) { return E < l.first; });
+		for(auto oIter=oStart; oIter!=oStop; oIter++)
+		{	double E = oIter->first;
 			double e0 = (E-E0)*EsigmaDen;
 			double e1 = (E1-E)*EsigmaDen;
 			double gaussTerm = (exp(-e0*e0) - exp(-e1*e1)) / (2*sqrt(M_PI) * (e0 + e1));
 			double erfTerm = (erf(e0) + erf(e1)) / (2 * (e0 + e1));
+			std::vector<double>& wOut = oIter->second;
 			for(int iW=0; iW<nWeights; iW++)
-				out[iE].second[iW] += gaussTerm*(w1[iW] - w0[iW]) + erfTerm*(e0*w1[iW] + e1*w0[iW]);
+				wOut[iW] += gaussTerm*(w1[iW] - w0[iW]) + erfTerm*(e0*w1[iW] + e1*w0[iW]);
 		}
 	}
+}
+
+//Apply gaussian smoothing of width Esigma
+TetrahedralDOS::Lspline TetrahedralDOS::gaussSmooth(const Lspline& in, double Esigma) const
+{	assert(Esigma > 0.);
+	//Initialize energy grid, uniform but restricted to within 10 Esigma of a non-zero input
+	//(so that band gaps and empty ranges between well-separated bands are skipped):
+	double Emin = in.front().first - 10*Esigma;
+	double dE = 0.2*Esigma;
+	std::vector<double> Egrid;
+	size_t iEnext = 0; //first grid point not yet added
+	for(size_t iIn=0; iIn+1<in.size(); iIn++)
+	{	const double& E0 = in[iIn].first;
+		const double& E1 = in[iIn+1].first;
+		bool nonZero = false;
+		for(int iW=0; iW<nWeights; iW++)
+			if(in[iIn].second[iW] || in[iIn+1].second[iW]) { nonZero = true; break; }
+		if(!nonZero) continue;
+		size_t iEstart = std::max(size_t(std::max(floor((E0-10*Esigma-Emin)/dE), 0.)), iEnext);
+		size_t iEstop = ceil((E1+10*Esigma-Emin)/dE) + 1;
+		for(size_t iE=iEstart; iE<iEstop; iE++)
+			Egrid.push_back(Emin + iE*dE);
+		iEnext = std::max(iEnext, iEstop);
+	}
+	size_t nE = Egrid.size();
+	if(nE > 1000000) logPrintf(
+		"WARNING: very fine energy grid for DOS. If this takes too long /\n"
+		"         results in too large a file, either increase Esigma or\n"
+		"         set it\n to zero (raw output of tetrahedron method).\n" );
+	Lspline out(nE, std::make_pair(0., std::vector<double>(nWeights, 0.)));
+	for(size_t iE=0; iE<nE; iE++) out[iE].first = Egrid[iE];
+	//Apply the gaussian smoothing to each channel (threaded over output energies):
+	if(nE) threadLaunch(gaussSmooth_thread, nE, &in, &out, Esigma, nWeights);
 	return out;
 }
 
@@ -510,26 +539,39 @@ TetrahedralDOS::Lspline TetrahedralDOS::mergeLsplines(const std::vector<Lspline>
 	return combined;
 }
 
-//Generate the density of states for a given state offset:
-TetrahedralDOS::Lspline TetrahedralDOS::getDOS(int iSpin, double Etol) const
-{	std::vector<Lspline> lsplines(nBands);
-	for(int iBand=0; iBand<nBands; iBand++)
+//Generate the density of states of bands [iStart,iStop) for a given spin channel:
+void TetrahedralDOS::getDOS_sub(size_t iStart, size_t iStop, int iSpin, double Etol, std::vector<Lspline>* lsplines) const
+{	for(size_t iBand=iStart; iBand<iStop; iBand++)
 	{	Cspline wdos;
 		for(const Tetrahedron& t: tetrahedra)
 			accumTetrahedron(t, iBand, iSpin, wdos);
+		Lspline& lspline = lsplines->at(iBand);
 		if(wdos.size()==0 && wdos.deltas.size()==1) // band is a single delta function
 		{	double eDelta = wdos.deltas.begin()->first;
 			const std::vector<double>& wDelta = wdos.deltas.begin()->second;
-			lsplines[iBand].resize(3, std::make_pair(eDelta, std::vector<double>(nWeights, 0.)));
-			lsplines[iBand][0].first = eDelta-0.5*Etol;
-			lsplines[iBand][2].first = eDelta+0.5*Etol;
+			lspline.resize(3, std::make_pair(eDelta, std::vector<double>(nWeights, 0.)));
+			lspline[0].first = eDelta-0.5*Etol;
+			lspline[2].first = eDelta+0.5*Etol;
 			for(int i=0; i<nWeights; i++)
-				lsplines[iBand][1].second[i] = wDelta[i] * (2./Etol);
+				lspline[1].second[i] = wDelta[i] * (2./Etol);
 		}
 		else
 		{	coalesceIntervals(wdos);
-			lsplines[iBand] = convertLspline(wdos);
+			lspline = convertLspline(wdos);
 		}
 	}
-	return mergeLsplines(lsplines);
+}
+
+void TetrahedralDOS::getDOS_thread(size_t iStart, size_t iStop, const TetrahedralDOS* td, int iSpin, double Etol, std::vector<Lspline>* lsplines)
+{	td->getDOS_sub(iStart, iStop, iSpin, Etol, lsplines);
+}
+
+//Generate the density of states for a given state offset:
+TetrahedralDOS::Lspline TetrahedralDOS::getDOS(int iSpin, double Etol) const
+{	static StopWatch watch("TetrahedralDOS::getDOS"); watch.start();
+	std::vector<Lspline> lsplines(nBands);
+	threadLaunchChunked(0, 4, getDOS_thread, nBands, this, iSpin, Etol, &lsplines); //bands differ in cost, so allow load balancing
+	Lspline result = mergeLsplines(lsplines);
+	watch.stop();
+	return result;
 }
@@ -93,6 +93,10 @@ private:
 
 	//! Collect contributions from multiple linear splines (one for each band)
 	Lspline mergeLsplines(const std::vector<Lspline>& lsplines) const;
+	
+	//! Compute the linear splines for bands [iStart,iStop) for getDOS (and corresponding thread function)
+	void getDOS_sub(size_t iStart, size_t iStop, int iSpin, double Etol, std::vector<Lspline>* lsplines) const;
+	static void getDOS_thread(size_t iStart, size_t iStop, const TetrahedralDOS* td, int iSpin, double Etol, std::vector<Lspline>* lsplines);
 };
 
 #endif //JDFTX_ELECTRONIC_TETRAHEDRALDOS_H
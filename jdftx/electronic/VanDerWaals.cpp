@@ -22,6 +22,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/SpeciesInfo_internal.h>
 #include <core/VectorField.h>
 #include <core/Units.h>
+#include <core/Thread.h>
 
 const static int atomicNumberMaxGrimme = 54;
 const static int atomicNumberMax = 118;
@@ -134,44 +135,111 @@ VanDerWaals::VanDerWaals(const Everything& everything)
 	}
 }
 
-double VanDerWaals::energyAndGrad(std::vector<Atom>& atoms, const double scaleFac) const
-{
-	//Truncate summation at 1/r^6 < 10^-16 => r ~ 100 bohrs
+//Truncate summation at 1/r^6 < 10^-16 => r ~ 100 bohrs (with a margin, since the tail extends over many cells);
+//the damping function is unity to double precision well within this and does not restrict the range further
+const static double vdwCutoff = 200.;
+
+void VanDerWaals::updateImageList(double reach) const
+{	const matrix3<>& R = e->gInfo.R;
+	if(imageList.images.size() && imageList.R==R && imageList.reach>=reach)
+		return; //existing list still valid
+	static StopWatch watch("VanDerWaals::updateImageList"); watch.start();
+	imageList.R = R;
+	imageList.reach = 1.1*reach; //allow some slack for atoms moving between ionic steps
+	imageList.images.clear();
 	vector3<bool> isTruncated = e->coulombParams.isTruncated();
-	vector3<int> S; //number of unit cells sampled in each direction
+	matrix3<> invR = inv(R);
+	vector3<int> Nmax; //max unit cell indices in each direction
 	for(int k=0; k<3; k++)
-		S[k] = 1 + 2*(isTruncated[k] ? 0 : (int)ceil(200./e->gInfo.R.column(k).length()));
-	size_t nCellsHlf = S[0] * S[1] * (S[2]/2+1);; //similar to the half-G-space used for FFTs
-	size_t iStart, iStop; TaskDivision(nCellsHlf, mpiWorld).myRange(iStart, iStop);
-	
-	double Etot = 0.;  //Total VDW Energy
-	std::vector<vector3<>> forces(atoms.size()); //VDW forces per atom
-	for(int c1=0; c1<int(atoms.size()); c1++)
-	{	const AtomParams& c1params = getParams(atoms[c1].atomicNumber, atoms[c1].sp);
-		for(int c2=0; c2<int(atoms.size()); c2++)
-		{	const AtomParams& c2params = getParams(atoms[c2].atomicNumber, atoms[c2].sp);
+		Nmax[k] = isTruncated[k] ? 0 : (int)ceil(imageList.reach * invR.row(k).length());
+	double reachSq = imageList.reach * imageList.reach;
+	vector3<int> iR; //integer cell number
+	for(iR[0]=-Nmax[0]; iR[0]<=Nmax[0]; iR[0]++)
+		for(iR[1]=-Nmax[1]; iR[1]<=Nmax[1]; iR[1]++)
+			for(iR[2]=0; iR[2]<=Nmax[2]; iR[2]++) //similar to the half-G-space used for FFTs
+				if(e->gInfo.RTR.metric_length_squared(iR) <= reachSq)
+					imageList.images.push_back(std::make_pair(iR, iR[2] ? 1. : 0.5)); //account for double-counting in half-space cut plane
+	logPrintf("Updated van der Waals pair list to %lu unit cells within %lg bohrs.\n", imageList.images.size(), imageList.reach);
+	watch.stop();
+}
+
+//Accumulate pair interactions of atoms c1 in [c1start,c1stop) with all atoms, over the lattice vectors in images,
+//collecting energy and forces locally and then (protected by lock) into Etot and forces
+void vdwPairs_thread(size_t c1start, size_t c1stop, const std::vector<vector3<>>* pos, const std::vector<VanDerWaals::AtomParams>* params,
+	const std::pair<vector3<int>,double>* images, size_t nImages, matrix3<> RTR, double rCutSq, double scaleFac,
+	double* Etot, std::vector<vector3<>>* forces, std::mutex* lock)
+{	double E = 0.;
+	std::vector<vector3<>> F(pos->size(), vector3<>(0.,0.,0.));
+	for(size_t c1=c1start; c1<c1stop; c1++)
+	{	const VanDerWaals::AtomParams& c1params = params->at(c1);
+		for(size_t c2=0; c2<pos->size(); c2++)
+		{	const VanDerWaals::AtomParams& c2params = params->at(c2);
 			double C6 = sqrt(c1params.C6 * c2params.C6);
 			double R0 = c1params.R0 + c2params.R0;
-			THREAD_halfGspaceLoop(
-				const vector3<int>& iR = iG;
-				vector3<> x = iR + (atoms[c1].pos - atoms[c2].pos);
-				double rSq = e->gInfo.RTR.metric_length_squared(x);
-				if(rSq)
+			vector3<> x0 = pos->at(c1) - pos->at(c2);
+			vector3<> F12(0.,0.,0.);
+			for(size_t iImage=0; iImage<nImages; iImage++)
+			{	vector3<> x = images[iImage].first + x0;
+				double rSq = RTR.metric_length_squared(x);
+				if(rSq && rSq<=rCutSq)
 				{	double r = sqrt(rSq); double E_r = 0.;
-					double cellWeight = (iR[2] ? 1. : 0.5); //account for double-counting in half-space cut plane
-					Etot -= cellWeight * scaleFac * vdwPairEnergyAndGrad(r, C6, R0, E_r);
-					vector3<> E_x = (cellWeight * scaleFac * E_r/r) * (e->gInfo.RTR * x); 
-					forces[c1] += E_x;
-					forces[c2] -= E_x;
+					double cellWeight = images[iImage].second;
+					E -= cellWeight * scaleFac * vdwPairEnergyAndGrad(r, C6, R0, E_r);
+					F12 += (cellWeight * scaleFac * E_r/r) * (RTR * x);
 				}
-			)
+			}
+			F[c1] += F12;
+			F[c2] -= F12;
 		}
 	}
+	lock->lock();
+	*Etot += E;
+	for(size_t c=0; c<pos->size(); c++)
+		forces->at(c) += F[c];
+	lock->unlock();
+}
+
+double VanDerWaals::energyAndGrad(std::vector<Atom>& atoms, const double scaleFac) const
+{	if(!atoms.size()) return 0.;
+	static StopWatch watch("VanDerWaals::energyAndGrad"); watch.start();
+	//Reduce positions to first centered unit cell along periodic directions, and find their extent:
+	vector3<bool> isTruncated = e->coulombParams.isTruncated();
+	std::vector<vector3<>> pos(atoms.size());
+	std::vector<AtomParams> params(atoms.size());
+	vector3<> posMin(0.,0.,0.), posMax(0.,0.,0.);
+	for(size_t c=0; c<atoms.size(); c++)
+	{	pos[c] = atoms[c].pos;
+		for(int k=0; k<3; k++)
+			if(!isTruncated[k])
+				pos[c][k] -= floor(0.5 + pos[c][k]);
+		for(int k=0; k<3; k++)
+		{	posMin[k] = c ? std::min(posMin[k], pos[c][k]) : pos[c][k];
+			posMax[k] = c ? std::max(posMax[k], pos[c][k]) : pos[c][k];
+		}
+		params[c] = getParams(atoms[c].atomicNumber, atoms[c].sp);
+	}
+	//Lattice vectors that can bring any pair of atoms within the cutoff:
+	const matrix3<>& R = e->gInfo.R;
+	vector3<> span = posMax - posMin;
+	double spanMax = 0.; //maximum separation of atoms within the unit cell (bounded by the diagonals of their bounding box)
+	for(int s1=-1; s1<=1; s1+=2)
+		for(int s2=-1; s2<=1; s2+=2)
+			spanMax = std::max(spanMax, (R * vector3<>(span[0], s1*span[1], s2*span[2])).length());
+	updateImageList(vdwCutoff + spanMax);
+	
+	//Divide lattice vectors over processes, and atoms over threads:
+	size_t iStart, iStop; TaskDivision(imageList.images.size(), mpiWorld).myRange(iStart, iStop);
+	double Etot = 0.;  //Total VDW Energy
+	std::vector<vector3<>> forces(atoms.size(), vector3<>(0.,0.,0.)); //VDW forces per atom
+	std::mutex lock;
+	threadLaunch(vdwPairs_thread, atoms.size(), &pos, &params, imageList.images.data()+iStart, iStop-iStart,
+		e->gInfo.RTR, vdwCutoff*vdwCutoff, scaleFac, &Etot, &forces, &lock);
 	//Collect over MPI:
 	mpiWorld->allReduce(Etot, MPIUtil::ReduceSum, true);
 	mpiWorld->allReduce(&forces[0][0], 3*atoms.size(), MPIUtil::ReduceSum, true);
 	for(int c=0; c<int(atoms.size()); c++)
 		atoms[c].force += forces[c];
+	watch.stop();
 	return Etot;
 }
 
@@ -183,30 +251,31 @@ double VanDerWaals::energyAndGrad(const std::vector< std::vector< vector3<> > >&
 	const GridInfo& gInfo = Ntilde[0]->gInfo;
 	const std::vector< std::shared_ptr<SpeciesInfo> >& species = e->iInfo.species;
 	
+	//Energy and site-density gradients from the combined potential of all explicit atoms:
+	updateSiteKernels(gInfo, atpos, atomicNumber);
+	for(unsigned j=0; j<atomicNumber.size(); j++) //Loop over sites in the fluid
+		if(siteKernels.V[j])
+		{	ScalarFieldTilde E_Ntilde = scaleFac * siteKernels.V[j]; //effect of all explicit atoms on gradient wrt jth site density
+			Etot += gInfo.dV * dot(Ntilde[j], E_Ntilde); //accumulate into total energy
+			if(grad_Ntilde)
+				(*grad_Ntilde)[j] += E_Ntilde; //accumulate into gradient wrt jth site density
+		}
+	if(!forces) return Etot;
+	
 	for(unsigned i=0; i<species.size(); i++) //Loop over species of explicit system
 	{	
 		std::shared_ptr<SpeciesInfo> sp = species[i];
-		ScalarFieldTilde SG(ScalarFieldTildeData::alloc(gInfo, isGpuEnabled()));
 		ScalarFieldTilde ccgrad_SG; //set grad wrt structure factor
 		int nAtoms = atpos[i].size(); //number of atoms of ith species
 		
-		matrix atposTemp(3, ceildiv(nAtoms,2));
-		memcpy(atposTemp.data(), atpos[i].data(), sizeof(vector3<>)*nAtoms);
-		callPref(getSG)(gInfo.S, nAtoms, (const vector3<>*)atposTemp.dataPref(), 1./gInfo.detR, SG->dataPref()); //get structure factor SG for atom type i
-		
 		for(unsigned j=0; j<atomicNumber.size(); j++) //Loop over sites in the fluid
 			if(atomicNumber[j]) //Check to make sure fluid site should include van der Waals corrections
 			{
 				const RadialFunctionG& Kernel_ij = getRadialFunction(sp->atomicNumber,atomicNumber[j], i,-1); //get ij radial function
-				ScalarFieldTilde E_Ntilde = (-scaleFac * gInfo.nr) * (Kernel_ij * SG); //calculate effect of ith explicit atom on gradient wrt jth site density
-				Etot += gInfo.dV * dot(Ntilde[j], E_Ntilde); //accumulate into total energy
-				if(grad_Ntilde)
-					(*grad_Ntilde)[j] += E_Ntilde; //accumulate into gradient wrt jth site density
-				if(forces)
-					ccgrad_SG += (-scaleFac) * (Kernel_ij * Ntilde[j]); //accumulate forces on ith atom type from jth site density
+				ccgrad_SG += (-scaleFac) * (Kernel_ij * Ntilde[j]); //accumulate forces on ith atom type from jth site density
 			}
 
-		if(forces && ccgrad_SG) //calculate forces due to ith atom
+		if(ccgrad_SG) //calculate forces due to ith atom
 		{	VectorFieldTilde gradAtpos; nullToZero(gradAtpos, gInfo);
 			vector3<complex*> gradAtposData; for(int k=0; k<3; k++) gradAtposData[k] = gradAtpos[k]->dataPref();
 			for(int at=0; at<nAtoms; at++)
@@ -219,6 +288,30 @@ double VanDerWaals::energyAndGrad(const std::vector< std::vector< vector3<> > >&
 	return Etot;
 }
 
+void VanDerWaals::updateSiteKernels(const GridInfo& gInfo, const std::vector< std::vector< vector3<> > >& atpos, const std::vector<int>& atomicNumber) const
+{	if(siteKernels.gInfo==&gInfo && siteKernels.R==gInfo.R && siteKernels.atpos==atpos && siteKernels.atomicNumber==atomicNumber)
+		return; //existing potentials still valid
+	static StopWatch watch("VanDerWaals::updateSiteKernels"); watch.start();
+	siteKernels.gInfo = &gInfo;
+	siteKernels.R = gInfo.R;
+	siteKernels.atpos = atpos;
+	siteKernels.atomicNumber = atomicNumber;
+	siteKernels.V.assign(atomicNumber.size(), ScalarFieldTilde());
+	const std::vector< std::shared_ptr<SpeciesInfo> >& species = e->iInfo.species;
+	for(unsigned i=0; i<species.size(); i++) //Loop over species of explicit system
+	{	int nAtoms = atpos[i].size(); //number of atoms of ith species
+		ScalarFieldTilde SG(ScalarFieldTildeData::alloc(gInfo, isGpuEnabled()));
+		AtomPhases phases(gInfo.S, nAtoms, atpos[i].data());
+		callPref(getSG)(gInfo.S, nAtoms, phases.tables(), 1./gInfo.detR, SG->dataPref()); //get structure factor SG for atom type i
+		for(unsigned j=0; j<atomicNumber.size(); j++) //Loop over sites in the fluid
+			if(atomicNumber[j]) //Check to make sure fluid site should include van der Waals corrections
+			{	const RadialFunctionG& Kernel_ij = getRadialFunction(species[i]->atomicNumber,atomicNumber[j], i,-1); //get ij radial function
+				siteKernels.V[j] += (-gInfo.nr) * (Kernel_ij * SG); //potential of ith explicit atom type on jth site density
+			}
+	}
+	watch.stop();
+}
+
 double VanDerWaals::getScaleFactor(string exCorrName, double scaleOverride) const
 {	if(scaleOverride) return scaleOverride;
 	auto iter = scalingFactor.find(exCorrName);
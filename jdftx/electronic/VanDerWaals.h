@@ -74,6 +74,32 @@ private:
 	const RadialFunctionG& getRadialFunction(int Z1, int Z2, int sp1, int sp2) const;
 	
 	std::map<std::pair<int,int>,RadialFunctionG> radialFunctions;
+	
+	//! Lattice vectors (in half of real space, with weights accounting for the cut plane) within reach of each other
+	//! for the discrete-atom pair sum; cached and reused (eg. across ionic steps) while the lattice vectors are unchanged
+	//! and the atoms remain within the extent that the list was built for
+	struct ImageList
+	{	matrix3<> R; //!< lattice vectors the list was built for
+		double reach; //!< maximum distance between lattice points in the list (pair cutoff + extent of atom positions)
+		std::vector<std::pair<vector3<int>,double>> images; //!< lattice vectors and weights (1 or 0.5 in the cut plane)
+		ImageList() : reach(0.) {}
+	};
+	mutable ImageList imageList;
+	void updateImageList(double reach) const; //!< rebuild imageList if needed, so that it covers at least reach
+	
+	//! Potential (per unit scale factor) of all discrete atoms on each continuous site density, combining the kernels
+	//! of all species in reciprocal space; cached and reused (eg. across fluid iterations) while the lattice vectors,
+	//! atom positions and site atomic numbers are unchanged
+	struct SiteKernels
+	{	const GridInfo* gInfo; //!< grid the potentials were computed on
+		matrix3<> R; //!< lattice vectors the potentials were computed for
+		std::vector< std::vector< vector3<> > > atpos; //!< atom positions the potentials were computed for
+		std::vector<int> atomicNumber; //!< site atomic numbers the potentials were computed for
+		ScalarFieldTildeArray V; //!< combined potential for each site (null for sites without vdW interactions)
+		SiteKernels() : gInfo(0) {}
+	};
+	mutable SiteKernels siteKernels;
+	void updateSiteKernels(const GridInfo& gInfo, const std::vector< std::vector< vector3<> > >& atpos, const std::vector<int>& atomicNumber) const; //!< recompute siteKernels if needed
 };
 
 //! @}
@@ -20,11 +20,13 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/Vibrations.h>
 #include <electronic/IonicMinimizer.h>
 #include <electronic/Everything.h>
+#include <electronic/ColumnBundle.h>
 #include <core/LatticeUtils.h>
 #include <core/Units.h>
 
 Vibrations::Vibrations() : dr(0.01), centralDiff(false), useConstraints(false),
-translationSym(true), rotationSym(false), omegaMin(2e-4), T(298*Kelvin), omegaResolution(1e-4)
+translationSym(true), rotationSym(false), omegaMin(2e-4), T(298*Kelvin), omegaResolution(1e-4),
+nTasks(1), iTask(0)
 {
 }
 
@@ -36,6 +38,8 @@ void Vibrations::setup(Everything* e)
 		translationSym = false;
 		rotationSym = false;
 	}
+	if(nTasks>1 && !resultsFilename.length())
+		die("Vibrations: resultsFile must be specified when dividing displacements between tasks.\n");
 }
 
 inline void setPtest(size_t iStart, size_t iStop, const vector3<int>& S, std::vector<double*> Ptest, vector3<> split)
@@ -159,8 +163,19 @@ void Vibrations::calculate()
 	nullToZero(Ptest, e->gInfo);
 	threadLaunch(setPtest, e->gInfo.nr, e->gInfo.S, Ptest.data(), getSplit());
 
+	//Results of displaced configurations from previous runs or other tasks, if any:
+	std::map<int,DisplacedResult> results;
+	readResults(results);
+	
 	//Get forces in unperturbed configuration
-	int nConfigurations = 1 + nPrimary * (centralDiff ? 2 : 1);
+	int nConfigurations = 1; //number of configurations computed in this run
+	int iPrimary = 0;
+	for(const Mode& mode: modes) if(mode.isPrimary)
+	{	if(iPrimary % nTasks == iTask)
+			for(int iSign=0; iSign<(centralDiff ? 2 : 1); iSign++)
+				if(!results.count(2*iPrimary+iSign)) nConfigurations++;
+		iPrimary++;
+	}
 	int iConfiguration = 0;
 	IonicMinimizer imin(*e);
 	IonicGradient grad0;
@@ -168,29 +183,65 @@ void Vibrations::calculate()
 	vector3<> Pel0 = getPel(); //electronic dipole moment
 	logPrintf("Completed %d of %d configurations.\n", ++iConfiguration, nConfigurations);
 	
+	//Ground-state wavefunctions, from which each displaced configuration is started:
+	std::vector<ColumnBundle> C0(e->eInfo.nStates);
+	for(int q=e->eInfo.qStart; q<e->eInfo.qStop; q++) C0[q] = e->eVars.C[q];
+	IonicGradient dPrev; dPrev.init(e->iInfo); //previous displacement (initially zero)
+	auto displace = [&](const IonicGradient& d)
+	{	//Return to the unperturbed positions (without dragging) and wavefunctions:
+		bool dragWavefunctions = e->cntrl.dragWavefunctions;
+		e->cntrl.dragWavefunctions = false;
+		imin.step(dPrev, -dr);
+		e->cntrl.dragWavefunctions = dragWavefunctions;
+		for(int q=e->eInfo.qStart; q<e->eInfo.qStop; q++) e->eVars.C[q] = C0[q];
+		//Move to the new displacement, dragging the ground-state wavefunctions along:
+		imin.step(d, dr);
+		dPrev = d;
+	};
+	
+	//Get results of a displaced configuration (from a previous run / other task, or by computing it if assigned to this task):
+	int nMissing = 0; //number of configurations assigned to other tasks and not yet available
+	auto getResult = [&](int iConfig, const IonicGradient& d, IonicGradient& grad, vector3<>& Pel)
+	{	auto iter = results.find(iConfig);
+		if(iter != results.end())
+		{	grad = iter->second.grad;
+			Pel = iter->second.Pel;
+			return true;
+		}
+		if((iConfig/2) % nTasks != iTask)
+		{	nMissing++;
+			return false;
+		}
+		displace(d);
+		imin.compute(&grad, 0);
+		Pel = getPel();
+		logPrintf("Completed %d of %d configurations.\n", ++iConfiguration, nConfigurations);
+		DisplacedResult& result = results[iConfig];
+		result.grad = grad;
+		result.Pel = Pel;
+		writeResult(iConfig, result);
+		return true;
+	};
+	
 	//Compute force matrix:
 	matrix K = zeroes(nModes, nModes);
 	matrix dP = zeroes(nModes, 3); //dipole derivative
 	{	diagMatrix mult(nModes, 0.); //multiplicity in entries due to symmetrization
-		IonicGradient dPrev; dPrev.init(e->iInfo); //previous displacement (initially zero)
 		complex *Kdata = K.data(), *dPdata = dP.data();
+		iPrimary = 0;
 		for(const Mode& mode: modes) if(mode.isPrimary) //Loop over modes in irredicuble wedge
-		{	//Create ionic gradient object corresponding to mode:
+		{	int iConfigPlus = 2*(iPrimary++);
+			//Create ionic gradient object corresponding to mode:
 			IonicGradient d; d.init(e->iInfo);
 			d[mode.s][mode.a] = mode.n; //all others zero
 			//Compute forces at perturbed position:
 			IonicGradient gradPlus, gradMinus, Kcur;
-			imin.step(d-dPrev, dr); dPrev=d;
-			imin.compute(&gradPlus, 0);
-			vector3<> PelPlus = getPel(), PelMinus, dPcur; //electronic dipole moment and derivative w.r.t mode
-			logPrintf("Completed %d of %d configurations.\n", ++iConfiguration, nConfigurations);
+			vector3<> PelPlus, PelMinus, dPcur; //electronic dipole moment and derivative w.r.t mode
+			if(!getResult(iConfigPlus, d, gradPlus, PelPlus)) continue;
 	
 			if(centralDiff)
 			{	d *= -1;
-				imin.step(d-dPrev, dr); dPrev=d;
-				imin.compute(&gradMinus, 0);
-				PelMinus = getPel();
-				logPrintf("Completed %d of %d configurations.\n", ++iConfiguration, nConfigurations);
+				if(!getResult(iConfigPlus+1, d, gradMinus, PelMinus)) continue;
 				Kcur = (gradPlus - gradMinus) * (0.5/dr);
 				dPcur = (PelPlus - PelMinus) * (0.5/dr);
 			}
@@ -226,7 +277,12 @@ void Vibrations::calculate()
 			}
 		}
 		IonicGradient d; d.init(e->iInfo); //all zeroes
-		imin.step(d-dPrev, dr); dPrev=d; //Restore original ionic positions
+		displace(d); //Restore original ionic positions and wavefunctions
+		if(nMissing)
+		{	logPrintf("\nVibrations: %d displaced configurations are assigned to other tasks and not yet available in '%s.*'.\n"
+				"Rerun once all tasks have completed to merge the results.\n\n", nMissing, resultsFilename.c_str());
+			return;
+		}
 		
 		//Invert multiplicity matrixZero out  modes to be set by translational symmetry:
 		for(int i=0; i<nModes; i++)
@@ -446,3 +502,66 @@ vector3<> Vibrations::getPel() const
 		Pel[k] = e->gInfo.dV * dot(Ptest[k], e->eVars.get_nTot());
 	return e->gInfo.R * Pel; //convert to Cartesian coordinates
 }
+
+//Number of values in each result: gradient on all atoms followed by dipole moment
+inline size_t resultSize(const IonInfo& iInfo)
+{	size_t nAtoms = 0;
+	for(const auto& sp: iInfo.species) nAtoms += sp->atpos.size();
+	return 3*(nAtoms+1);
+}
+
+void Vibrations::readResults(std::map<int,DisplacedResult>& results) const
+{	if(!resultsFilename.length()) return;
+	size_t nValues = resultSize(e->iInfo);
+	std::vector<int> iConfigs; std::vector<double> values; //flattened results
+	if(mpiWorld->isHead())
+	{	for(int jTask=0; jTask<nTasks; jTask++)
+		{	ostringstream oss; oss << resultsFilename << '.' << jTask;
+			FILE* fp = fopen(oss.str().c_str(), "r");
+			if(!fp) continue;
+			int iConfig;
+			while(fscanf(fp, "%d", &iConfig)==1)
+			{	std::vector<double> entry(nValues);
+				size_t nRead = 0;
+				while(nRead<nValues && fscanf(fp, "%lg", &entry[nRead])==1) nRead++;
+				if(nRead < nValues) break; //incomplete entry (eg. interrupted write)
+				iConfigs.push_back(iConfig);
+				values.insert(values.end(), entry.begin(), entry.end());
+			}
+			fclose(fp);
+		}
+	}
+	//Broadcast results:
+	size_t nResults = iConfigs.size();
+	mpiWorld->bcast(nResults);
+	iConfigs.resize(nResults);
+	values.resize(nResults*nValues);
+	mpiWorld->bcastData(iConfigs);
+	mpiWorld->bcastData(values);
+	//Unpack:
+	const double* valuePtr = values.data();
+	for(int iConfig: iConfigs)
+	{	DisplacedResult& result = results[iConfig];
+		result.grad.init(e->iInfo);
+		for(auto& spGrad: result.grad)
+			for(vector3<>& g: spGrad)
+				for(int k=0; k<3; k++)
+					g[k] = *(valuePtr++);
+		for(int k=0; k<3; k++)
+			result.Pel[k] = *(valuePtr++);
+	}
+	if(nResults) logPrintf("Vibrations: read %lu displaced configurations from '%s.*'.\n", nResults, resultsFilename.c_str());
+}
+
+void Vibrations::writeResult(int iConfig, const DisplacedResult& result) const
+{	if(!resultsFilename.length() || !mpiWorld->isHead()) return;
+	ostringstream oss; oss << resultsFilename << '.' << iTask;
+	FILE* fp = fopen(oss.str().c_str(), "a");
+	if(!fp) die("Vibrations: could not open '%s' for writing.\n", oss.str().c_str());
+	fprintf(fp, "%d", iConfig);
+	for(const auto& spGrad: result.grad)
+		for(const vector3<>& g: spGrad)
+			fprintf(fp, " %.15le %.15le %.15le", g[0], g[1], g[2]);
+	fprintf(fp, " %.15le %.15le %.15le\n", result.Pel[0], result.Pel[1], result.Pel[2]);
+	fclose(fp);
+}
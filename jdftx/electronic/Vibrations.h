@@ -21,6 +21,8 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_ELECTRONIC_VIBRATIONS_H
 
 #include <core/VectorField.h>
+#include <electronic/IonicMinimizer.h>
+#include <map>
 
 class Everything;
 
@@ -39,6 +41,9 @@ public:
 	double omegaMin; //!< frequency cutoff for free energy calculation and detailed mode print out
 	double T; //!< ionic temperature used for entropy and free energy estimation
 	double omegaResolution; //!< frequency resolution used for identifying and reporting degeneracies
+	int nTasks; //!< number of independent runs that the displaced configurations are divided between
+	int iTask; //!< index of the displaced configurations handled by this run (0 to nTasks-1)
+	string resultsFilename; //!< if non-empty, save results of displaced configurations to resultsFilename.<iTask>, and reuse those of all tasks found there
 	
 	Vibrations();
 	void setup(Everything* e);
@@ -50,6 +55,11 @@ private:
 	struct IonicGradient getCMcoords() const; //get cartesian coordinates of all atoms relative to molecule center of mass
 	VectorField Ptest; //vector field that measures dipole moment in lattice coordinates
 	vector3<> getPel() const; //get electronic dipole moment at current state in cartesian coordinates
+	
+	//Results of displaced configurations (indexed by 2*iPrimaryMode + (1 for negative displacement)):
+	struct DisplacedResult { IonicGradient grad; vector3<> Pel; };
+	void readResults(std::map<int,DisplacedResult>& results) const; //read results of all tasks (if any)
+	void writeResult(int iConfig, const DisplacedResult& result) const; //append result of this task
 };
 
 //! @}
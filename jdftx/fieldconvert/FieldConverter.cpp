@@ -0,0 +1,354 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <fieldconvert/FieldConverter.h>
+#include <electronic/symbols.h>
+#include <core/ScalarFieldIO.h>
+#include <core/Operators.h>
+#include <core/Thread.h>
+#include <core/Units.h>
+#include <algorithm>
+
+EnumStringMap<FieldFormat> fieldFormatMap
+(	FieldFormatXSF, "xsf",
+	FieldFormatCube, "cube",
+	FieldFormatVTK, "vtk"
+);
+
+FieldConverter::FieldConverter()
+: format(FieldFormatXSF), downsample(1), Sout(0,0,0), crop(false), singlePrecision(false)
+{
+}
+
+//Reduced sample count for Fourier downsampling by factor (same rounding as dump-field-format)
+inline vector3<int> reducedGrid(const vector3<int>& S, int factor)
+{	vector3<int> Sred;
+	for(int k=0; k<3; k++)
+	{	int Sk = 2*int(ceil(0.5*S[k]/factor));
+		while(!fftSuitable(Sk)) Sk += 2;
+		Sred[k] = std::min(Sk, S[k]);
+	}
+	return Sred;
+}
+
+//Parse a row of a matrix printed by matrix3<>::print, i.e. "[ a b c ]"
+inline bool parseRow(const string& line, vector3<>& row)
+{	return sscanf(line.c_str(), " [ %lf %lf %lf ]", &row[0], &row[1], &row[2]) == 3;
+}
+
+//Parse an ion command "ion <name> <x> <y> <z> ..."
+inline bool parseIon(const string& line, string& name, vector3<>& pos)
+{	char nameBuf[256];
+	if(sscanf(line.c_str(), "ion %255s %lf %lf %lf", nameBuf, &pos[0], &pos[1], &pos[2]) != 4) return false;
+	name = nameBuf;
+	return true;
+}
+
+void FieldConverter::readOutput(const char* filename)
+{	ifstream ifs(filename);
+	if(!ifs.is_open()) die("Could not open '%s' for reading.\n", filename)
+	logPrintf("Reading structure from '%s' ... ", filename); logFlush();
+	Step initial; initial.cartesian = true;
+	bool gridStarted = false; //whether the header (input file echo) has been read
+	bool acceptS = false; //whether the next fftbox size is for a unit-cell grid
+	bool latticeFound = false;
+	matrix3<> R;
+	string line;
+	while(!ifs.eof())
+	{	getline(ifs, line);
+		if(!gridStarted)
+		{	//Header: atoms and coordinate system from the input file echo
+			string name; vector3<> pos;
+			if(parseIon(line, name, pos))
+			{	atomNames.push_back(name);
+				initial.pos.push_back(pos);
+			}
+			else if(line.find("coords-type")==0)
+				initial.cartesian = (line.find("Cartesian") != string::npos);
+			if(line.find("Initializing the Grid") != string::npos)
+				gridStarted = acceptS = true;
+			continue;
+		}
+		//Lattice vectors (initially, and when they change during lattice minimization):
+		string lineTrimmed = line; trim(lineTrimmed);
+		if(lineTrimmed == "R =")
+		{	for(int i=0; i<3; i++)
+			{	vector3<> row;
+				getline(ifs, line);
+				if(!parseRow(line, row)) die("Could not parse lattice vectors near '%s'.\n", line.c_str())
+				for(int j=0; j<3; j++) R(i,j) = row[j];
+			}
+			if(!latticeFound) { initial.R = R; latticeFound = true; }
+			if(steps.size()) steps.back().R = R; //lattice printed after the positions of the same step
+			continue;
+		}
+		//Grid sizes (skipping supercell and double-sized grids, which do not span the unit cell):
+		if(line.find("Initializing tighter grid") != string::npos) acceptS = true;
+		if(line.find("Initializing supercell grid") != string::npos
+			|| line.find("Setting up double-sized grid") != string::npos) acceptS = false;
+		if(acceptS && line.find("Chosen fftbox size, S =") == 0)
+		{	vector3<int> S;
+			if(sscanf(line.c_str()+line.find('['), "[ %d %d %d ]", &S[0], &S[1], &S[2]) != 3)
+				die("Could not parse fftbox size from '%s'.\n", line.c_str())
+			if(std::find(Sdump.begin(), Sdump.end(), S) == Sdump.end()) Sdump.push_back(S);
+			acceptS = false;
+			continue;
+		}
+		//Ionic positions of each step:
+		if(line.find("# Ionic positions in") == 0)
+		{	Step step;
+			step.R = R;
+			step.cartesian = (line.find("cartesian") != string::npos);
+			for(size_t iAtom=0; iAtom<atomNames.size(); iAtom++)
+			{	string name; vector3<> pos;
+				getline(ifs, line);
+				if(!parseIon(line, name, pos) || name != atomNames[iAtom])
+					die("Could not parse ionic positions near '%s'.\n", line.c_str())
+				step.pos.push_back(pos);
+			}
+			steps.push_back(step);
+		}
+	}
+	if(!latticeFound) die("\nCould not find lattice vectors in '%s'.\n", filename)
+	if(!Sdump.size()) die("\nCould not find fftbox sizes in '%s'.\n", filename)
+	if(!steps.size()) steps.push_back(initial);
+	//Atomic numbers from species names (ignoring trailing non-letters):
+	for(const string& name: atomNames)
+	{	string symbol = name;
+		while(symbol.length() && !isalpha(symbol.back())) symbol.erase(symbol.length()-1);
+		AtomicSymbol atSym;
+		if(!atomicSymbolMap.getEnum(symbol.c_str(), atSym))
+			die("\nCould not determine atomic number for species '%s': name species by chemical symbol.\n", name.c_str())
+		atomicNumbers.push_back(int(atSym));
+	}
+	logPrintf("done.\n");
+	logPrintf("Found %lu atoms in %lu ionic steps, and fftbox %s", atomNames.size(), steps.size(), Sdump.size()>1 ? "sizes" : "size");
+	for(const vector3<int>& S: Sdump) logPrintf(" [ %d %d %d ]", S[0], S[1], S[2]);
+	logPrintf(".\n"); logFlush();
+}
+
+const GridInfo& FieldConverter::getGrid(const matrix3<>& R, const vector3<int>& S)
+{	for(const std::shared_ptr<GridInfo>& gInfo: grids)
+		if(gInfo->R == R && gInfo->S == S)
+			return *gInfo;
+	//Create new grid, dropping those of previous lattices (fields on them are no longer in use):
+	grids.erase(std::remove_if(grids.begin(), grids.end(),
+		[&](const std::shared_ptr<GridInfo>& gInfo) { return !(gInfo->R == R); }), grids.end());
+	std::shared_ptr<GridInfo> gInfo = std::make_shared<GridInfo>();
+	gInfo->R = R;
+	gInfo->S = S;
+	logSuspend();
+	gInfo->initialize(true);
+	logResume();
+	grids.push_back(gInfo);
+	return *gInfo;
+}
+
+ScalarField FieldConverter::loadField(const string& filename, const matrix3<>& R)
+{	off_t fLen = fileSize(filename.c_str());
+	if(fLen < 0) die("Could not open '%s' for reading.\n", filename.c_str())
+	//Candidate grids: unit-cell fftboxes, and their reductions by dump-field-format:
+	std::vector<vector3<int>> candidates = Sdump;
+	for(const vector3<int>& S: Sdump)
+		for(int factor=2; factor<=8; factor++)
+		{	vector3<int> Sred = reducedGrid(S, factor);
+			if(std::find(candidates.begin(), candidates.end(), Sred) == candidates.end()) candidates.push_back(Sred);
+		}
+	for(bool single: {false, true})
+		for(const vector3<int>& S: candidates)
+			if(fLen == off_t(S[0])*S[1]*S[2]*off_t(single ? sizeof(float) : sizeof(double)))
+			{	ScalarField X; nullToZero(X, getGrid(R, S));
+				if(single) loadRawBinarySingle(X, filename.c_str());
+				else loadRawBinary(X, filename.c_str());
+				return X;
+			}
+	die("\nLength of '%s' (%ld bytes) does not match a real scalar field in double or single precision on any of the grids of this run.\n",
+		filename.c_str(), (long)fLen)
+}
+
+
+//---- Output ----
+
+//Format values as text (6 per line, and starting a new line after every rowLength values) in chunks that are written in order
+void formatValues_sub(size_t iChunkStart, size_t iChunkStop, size_t nChunks, const std::vector<double>* values,
+	size_t rowLength, const char* fmt, std::vector<std::string>* chunks)
+{	size_t N = values->size();
+	const double* v = values->data();
+	char buf[64];
+	for(size_t iChunk=iChunkStart; iChunk<iChunkStop; iChunk++)
+	{	std::string& out = (*chunks)[iChunk];
+		size_t pStart = (N*iChunk)/nChunks, pStop = (N*(iChunk+1))/nChunks;
+		out.reserve((pStop-pStart)*20);
+		for(size_t p=pStart; p<pStop; p++)
+		{	size_t col = p % rowLength;
+			int len = snprintf(buf, sizeof(buf), fmt, v[p]);
+			out.append(buf, len);
+			out.push_back((col%6==5 || col+1==rowLength) ? '\n' : ' ');
+		}
+	}
+}
+void writeText(const std::vector<double>& values, size_t rowLength, bool singlePrecision, FILE* fp)
+{	size_t nChunks = std::min(values.size(), size_t(8*nProcsAvailable));
+	std::vector<std::string> chunks(nChunks);
+	threadLaunch(formatValues_sub, nChunks, nChunks, &values, rowLength, singlePrecision ? "%.6e" : "%.12e", &chunks);
+	for(const std::string& chunk: chunks)
+		fwrite(chunk.data(), 1, chunk.size(), fp);
+}
+
+//Write binary data in big-endian order (required by legacy VTK)
+template<typename T> void fwriteBE(std::vector<T>& data, FILE* fp)
+{	if(isLittleEndian())
+		for(T& x: data)
+		{	char* c = (char*)&x;
+			std::reverse(c, c+sizeof(T));
+		}
+	fwrite(data.data(), sizeof(T), data.size(), fp);
+}
+template<typename T> void writeBinary(const std::vector<double>& values, FILE* fp)
+{	std::vector<T> buf(values.begin(), values.end());
+	fwriteBE(buf, fp);
+	fprintf(fp, "\n");
+}
+
+//Name of a field for XSF / VTK from its filename (without path, and with only alphanumeric characters)
+string fieldName(const string& filename)
+{	string name = filename.substr(filename.find_last_of("\\/")+1);
+	for(char& c: name) if(!isalnum(c)) c = '_';
+	return name;
+}
+
+void FieldConverter::convert(int iStep, const std::vector<string>& fieldFilenames, const string& outFilename)
+{	static StopWatch watch("FieldConverter::convert"); watch.start();
+	const Step& step = steps[std::max(0, std::min(iStep, nSteps()-1))];
+	const matrix3<>& R = step.R;
+	if(format==FieldFormatCube && fieldFilenames.size()!=1)
+		die("Cube format requires exactly one field per output file.\n")
+	
+	//Load fields and bring them to a common output grid:
+	std::vector<ScalarField> fields;
+	vector3<int> S = Sout;
+	for(const string& fname: fieldFilenames)
+	{	ScalarField X = loadField(fname, R);
+		if(!S.length_squared()) S = (downsample>1) ? reducedGrid(X->gInfo.S, downsample) : X->gInfo.S;
+		if(!(X->gInfo.S == S)) X = changeGrid(X, getGrid(R, S));
+		fields.push_back(X);
+	}
+	
+	//Output mesh-index range (XSF general grids include the periodic end point):
+	vector3<int> iStart(0,0,0), iStop = S - vector3<int>(1,1,1);
+	if(format==FieldFormatXSF) iStop = S;
+	if(crop) { iStart = cropStart; iStop = cropStop; }
+	vector3<int> n = iStop - iStart + vector3<int>(1,1,1);
+	if(n[0]<=0 || n[1]<=0 || n[2]<=0) die("Empty crop range for output grid [ %d %d %d ].\n", S[0], S[1], S[2])
+	size_t nPoints = size_t(n[0])*n[1]*n[2];
+	//--- gather data in output order (first index fastest, except for cube where the last index is fastest):
+	auto gather = [&](const ScalarField& X)
+	{	std::vector<double> values; values.reserve(nPoints);
+		const double* data = X->data();
+		vector3<int> i;
+		auto wrapIndex = [&]()
+		{	vector3<int> iw;
+			for(int k=0; k<3; k++) iw[k] = ((i[k] % S[k]) + S[k]) % S[k];
+			return X->gInfo.fullRindex(iw);
+		};
+		if(format==FieldFormatCube)
+		{	for(i[0]=iStart[0]; i[0]<=iStop[0]; i[0]++)
+			for(i[1]=iStart[1]; i[1]<=iStop[1]; i[1]++)
+			for(i[2]=iStart[2]; i[2]<=iStop[2]; i[2]++)
+				values.push_back(data[wrapIndex()]);
+		}
+		else
+		{	for(i[2]=iStart[2]; i[2]<=iStop[2]; i[2]++)
+			for(i[1]=iStart[1]; i[1]<=iStop[1]; i[1]++)
+			for(i[0]=iStart[0]; i[0]<=iStop[0]; i[0]++)
+				values.push_back(data[wrapIndex()]);
+		}
+		return values;
+	};
+	//--- grid geometry:
+	vector3<> origin = R * vector3<>(double(iStart[0])/S[0], double(iStart[1])/S[1], double(iStart[2])/S[2]);
+	vector3<> h[3]; for(int k=0; k<3; k++) h[k] = R.column(k) / S[k]; //grid spacing vectors
+	std::vector<vector3<>> pos(step.pos.size());
+	for(size_t iAtom=0; iAtom<pos.size(); iAtom++)
+		pos[iAtom] = step.cartesian ? step.pos[iAtom] : R * step.pos[iAtom];
+	
+	FILE* fp = fopen(outFilename.c_str(), format==FieldFormatVTK ? "wb" : "w");
+	if(!fp) die("Could not open '%s' for writing.\n", outFilename.c_str())
+	switch(format)
+	{	case FieldFormatXSF:
+		{	fprintf(fp, "CRYSTAL\nPRIMVEC\n");
+			for(int k=0; k<3; k++)
+			{	vector3<> Rk = R.column(k) / Angstrom;
+				fprintf(fp, "%14.8lf %14.8lf %14.8lf\n", Rk[0], Rk[1], Rk[2]);
+			}
+			fprintf(fp, "PRIMCOORD\n%lu 1\n", pos.size());
+			for(size_t iAtom=0; iAtom<pos.size(); iAtom++)
+			{	vector3<> r = pos[iAtom] / Angstrom;
+				fprintf(fp, "%3d %14.8lf %14.8lf %14.8lf\n", atomicNumbers[iAtom], r[0], r[1], r[2]);
+			}
+			fprintf(fp, "BEGIN_BLOCK_DATAGRID_3D\n fields\n");
+			for(size_t iField=0; iField<fields.size(); iField++)
+			{	fprintf(fp, " BEGIN_DATAGRID_3D_%s\n  %d %d %d\n", fieldName(fieldFilenames[iField]).c_str(), n[0], n[1], n[2]);
+				vector3<> r0 = origin / Angstrom;
+				fprintf(fp, "  %14.8lf %14.8lf %14.8lf\n", r0[0], r0[1], r0[2]);
+				for(int k=0; k<3; k++)
+				{	vector3<> span = h[k] * ((n[k]-1) / Angstrom); //XSF spans first to last grid point
+					fprintf(fp, "  %14.8lf %14.8lf %14.8lf\n", span[0], span[1], span[2]);
+				}
+				writeText(gather(fields[iField]), nPoints, singlePrecision, fp);
+				fprintf(fp, " END_DATAGRID_3D\n");
+			}
+			fprintf(fp, "END_BLOCK_DATAGRID_3D\n");
+			break;
+		}
+		case FieldFormatCube:
+		{	fprintf(fp, "%s\nConverted by fieldconvert: outer loop x, middle loop y, inner loop z\n", fieldFilenames[0].c_str());
+			fprintf(fp, "%5lu %12.6lf %12.6lf %12.6lf\n", pos.size(), origin[0], origin[1], origin[2]);
+			for(int k=0; k<3; k++)
+				fprintf(fp, "%5d %12.6lf %12.6lf %12.6lf\n", n[k], h[k][0], h[k][1], h[k][2]);
+			for(size_t iAtom=0; iAtom<pos.size(); iAtom++)
+				fprintf(fp, "%5d %12.6lf %12.6lf %12.6lf %12.6lf\n", atomicNumbers[iAtom], double(atomicNumbers[iAtom]), pos[iAtom][0], pos[iAtom][1], pos[iAtom][2]);
+			writeText(gather(fields[0]), n[2], singlePrecision, fp);
+			break;
+		}
+		case FieldFormatVTK:
+		{	const char* typeName = singlePrecision ? "float" : "double";
+			fprintf(fp, "# vtk DataFile Version 3.0\nConverted by fieldconvert (lengths in Angstroms)\nBINARY\n");
+			fprintf(fp, "DATASET STRUCTURED_GRID\nDIMENSIONS %d %d %d\nPOINTS %lu %s\n", n[0], n[1], n[2], nPoints, typeName);
+			std::vector<double> points; points.reserve(3*nPoints);
+			vector3<int> i;
+			for(i[2]=iStart[2]; i[2]<=iStop[2]; i[2]++)
+			for(i[1]=iStart[1]; i[1]<=iStop[1]; i[1]++)
+			for(i[0]=iStart[0]; i[0]<=iStop[0]; i[0]++)
+			{	vector3<> r = (h[0]*i[0] + h[1]*i[1] + h[2]*i[2]) / Angstrom;
+				for(int k=0; k<3; k++) points.push_back(r[k]);
+			}
+			if(singlePrecision) writeBinary<float>(points, fp); else writeBinary<double>(points, fp);
+			fprintf(fp, "POINT_DATA %lu\n", nPoints);
+			for(size_t iField=0; iField<fields.size(); iField++)
+			{	fprintf(fp, "SCALARS %s %s 1\nLOOKUP_TABLE default\n", fieldName(fieldFilenames[iField]).c_str(), typeName);
+				std::vector<double> values = gather(fields[iField]);
+				if(singlePrecision) writeBinary<float>(values, fp); else writeBinary<double>(values, fp);
+			}
+			break;
+		}
+	}
+	fclose(fp);
+	watch.stop();
+}
@@ -0,0 +1,77 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#ifndef JDFTX_FIELDCONVERT_FIELDCONVERTER_H
+#define JDFTX_FIELDCONVERT_FIELDCONVERTER_H
+
+#include <core/GridInfo.h>
+#include <core/ScalarField.h>
+#include <memory>
+
+//! @addtogroup Output
+//! @{
+//! @file FieldConverter.h Conversion of raw binary scalar field dumps to visualization formats
+
+//! Output formats supported by FieldConverter
+enum FieldFormat
+{	FieldFormatXSF, //!< XCrySDen structure file with 3D data grids (text)
+	FieldFormatCube, //!< Gaussian cube file (text, single field)
+	FieldFormatVTK //!< Legacy VTK structured grid (binary)
+};
+extern EnumStringMap<FieldFormat> fieldFormatMap;
+
+//! Convert raw binary scalar field dumps (double or single precision) to XSF / cube / VTK,
+//! with the lattice, atoms and fftbox sizes extracted from a JDFTx output file.
+//! Fields may be Fourier resampled and cropped, and are formatted in parallel over threads.
+class FieldConverter
+{
+public:
+	FieldFormat format; //!< output format
+	int downsample; //!< Fourier downsampling factor, with the same rounding as dump-field-format (1 = none)
+	vector3<int> Sout; //!< explicit output grid (overrides downsample if non-zero)
+	bool crop; //!< whether cropStart / cropStop are used (else the entire unit cell is written)
+	vector3<int> cropStart, cropStop; //!< inclusive mesh-index range on the output grid (may extend periodically past the cell)
+	bool singlePrecision; //!< write 32-bit floats (VTK) or 7 significant digits (text formats)
+
+	FieldConverter();
+	void readOutput(const char* filename); //!< extract atoms, lattice of each ionic step and fftbox sizes from a JDFTx output file
+	int nSteps() const { return steps.size(); } //!< number of ionic steps found in the output file (at least 1)
+
+	//! Convert fields (raw binary dump files) to outFilename, using the structure at ionic step iStep (0-based, clamped to the available range)
+	void convert(int iStep, const std::vector<string>& fieldFilenames, const string& outFilename);
+
+private:
+	//! Lattice and atom positions of one ionic step
+	struct Step
+	{	matrix3<> R; //!< lattice vectors in columns
+		std::vector<vector3<>> pos; //!< atom positions (in coordinates given by cartesian)
+		bool cartesian; //!< whether pos is in Cartesian rather than lattice coordinates
+	};
+	std::vector<string> atomNames; //!< species name of each atom
+	std::vector<int> atomicNumbers; //!< atomic number of each atom
+	std::vector<Step> steps;
+	std::vector<vector3<int>> Sdump; //!< fftbox sizes of the unit cell grids used by the run
+	std::vector<std::shared_ptr<GridInfo>> grids; //!< recently used grids (reused while the lattice is unchanged)
+
+	const GridInfo& getGrid(const matrix3<>& R, const vector3<int>& S); //!< retrieve (or create) the grid with lattice R and sample count S
+	ScalarField loadField(const string& filename, const matrix3<>& R); //!< load a field, identifying its grid and precision by file size
+};
+
+//! @}
+#endif // JDFTX_FIELDCONVERT_FIELDCONVERTER_H
@@ -0,0 +1,152 @@
+/*-------------------------------------------------------------------
+Copyright 2018 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <fieldconvert/FieldConverter.h>
+#include <core/MPIUtil.h>
+#include <getopt.h>
+
+void printUsage(const char* name)
+{	printf("\nUsage: %s [options] <jdftxOutFile> <outFile> <field1> [<field2> ...]\n\n", name);
+	printf("Convert raw binary scalar fields dumped by JDFTx to XSF, cube or VTK, using the lattice,\n");
+	printf("atoms and fftbox sizes from the JDFTx output file <jdftxOutFile>. The grid and precision\n");
+	printf("of each field is identified from its file size (including dump-field-format output).\n\n");
+	printf("\t-h --help               help (this output)\n");
+	printf("\t-t --type <type>        output format xsf|cube|vtk (default: from <outFile> extension)\n");
+	printf("\t-d --downsample <n>     Fourier downsample by factor <n> (rounded as in dump-field-format)\n");
+	printf("\t-g --grid <n0,n1,n2>    Fourier resample to this grid (overrides -d)\n");
+	printf("\t-r --crop <i0:i1,j0:j1,k0:k1>  inclusive mesh-index ranges on the output grid\n");
+	printf("\t                        (may extend past the cell, which is periodically repeated)\n");
+	printf("\t-s --single             single precision output (32-bit VTK, 7 digits in text formats)\n");
+	printf("\t-F --frames <first:last[:stride]>  convert a sequence of frames: '%%d' in <outFile>\n");
+	printf("\t                        and in the field filenames is replaced by the frame number,\n");
+	printf("\t                        and the structure is taken from ionic step (frame + offset)\n");
+	printf("\t-O --step-offset <n>    offset of ionic step number from frame number (default 0)\n");
+	printf("\nWithout -F, the final structure in <jdftxOutFile> is used. Frames are divided over\n");
+	printf("MPI processes, and text output of each frame is formatted in parallel over threads.\n\n");
+}
+
+//Replace all occurrences of %d in pattern by frame number
+string substituteFrame(const string& pattern, int frame)
+{	string result = pattern;
+	string frameStr = std::to_string(frame).c_str();
+	size_t pos;
+	while((pos = result.find("%d")) != string::npos)
+		result.replace(pos, 2, frameStr);
+	return result;
+}
+
+//Program entry point
+int main(int argc, char** argv)
+{	mpiWorld = new MPIUtil(argc, argv);
+
+	//Parse command line:
+	FieldConverter fc;
+	bool formatSpecified = false;
+	bool frameMode = false; int frameStart=1, frameStop=1, frameStride=1, stepOffset=0;
+	option long_options[] =
+		{	{"help", no_argument, 0, 'h'},
+			{"type", required_argument, 0, 't'},
+			{"downsample", required_argument, 0, 'd'},
+			{"grid", required_argument, 0, 'g'},
+			{"crop", required_argument, 0, 'r'},
+			{"single", no_argument, 0, 's'},
+			{"frames", required_argument, 0, 'F'},
+			{"step-offset", required_argument, 0, 'O'},
+			{0, 0, 0, 0}
+		};
+	#define FAIL_USAGE(...) { if(mpiWorld->isHead()) { printf(__VA_ARGS__); printUsage(argv[0]); } delete mpiWorld; exit(1); }
+	while(1)
+	{	int c = getopt_long(argc, argv, "ht:d:g:r:sF:O:", long_options, 0);
+		if(c == -1) break; //end of options
+		switch(c)
+		{	case 'h': if(mpiWorld->isHead()) printUsage(argv[0]); delete mpiWorld; exit(0);
+			case 't':
+				if(!fieldFormatMap.getEnum(optarg, fc.format)) FAIL_USAGE("\nUnknown output format '%s'.\n", optarg)
+				formatSpecified = true;
+				break;
+			case 'd':
+				if(!(sscanf(optarg, "%d", &fc.downsample)==1 && fc.downsample>0)) FAIL_USAGE("\nDownsample factor must be a positive integer.\n")
+				break;
+			case 'g':
+				if(!(sscanf(optarg, "%d,%d,%d", &fc.Sout[0], &fc.Sout[1], &fc.Sout[2])==3 && fc.Sout[0]>0 && fc.Sout[1]>0 && fc.Sout[2]>0))
+					FAIL_USAGE("\nGrid must be specified as three positive integers <n0,n1,n2>.\n")
+				break;
+			case 'r':
+				if(sscanf(optarg, "%d:%d,%d:%d,%d:%d", &fc.cropStart[0], &fc.cropStop[0],
+					&fc.cropStart[1], &fc.cropStop[1], &fc.cropStart[2], &fc.cropStop[2]) != 6)
+					FAIL_USAGE("\nCrop range must be specified as <i0:i1,j0:j1,k0:k1>.\n")
+				fc.crop = true;
+				break;
+			case 's': fc.singlePrecision = true; break;
+			case 'F':
+			{	int nRead = sscanf(optarg, "%d:%d:%d", &frameStart, &frameStop, &frameStride);
+				if(nRead < 2 || frameStride <= 0 || frameStop < frameStart)
+					FAIL_USAGE("\nFrames must be specified as <first:last[:stride]> with first <= last and stride > 0.\n")
+				frameMode = true;
+				break;
+			}
+			case 'O':
+				if(sscanf(optarg, "%d", &stepOffset) != 1) FAIL_USAGE("\nStep offset must be an integer.\n")
+				break;
+			default: FAIL_USAGE("\n")
+		}
+	}
+	if(argc - optind < 3) FAIL_USAGE("\nInsufficient arguments.\n")
+	const char* outFilenameJDFTx = argv[optind];
+	string outPattern = argv[optind+1];
+	std::vector<string> fieldPatterns(argv+optind+2, argv+argc);
+	if(!formatSpecified)
+	{	size_t lastDot = outPattern.find_last_of(".");
+		if(lastDot==string::npos || !fieldFormatMap.getEnum(outPattern.substr(lastDot+1).c_str(), fc.format))
+			FAIL_USAGE("\nCould not determine output format from extension of '%s': specify it with -t.\n", outPattern.c_str())
+	}
+	if(frameMode && outPattern.find("%d")==string::npos)
+		FAIL_USAGE("\nIn frames mode, <outFile> must contain '%%d' (replaced by frame numbers).\n")
+	#undef FAIL_USAGE
+
+	initSystem(argc, argv);
+	fc.readOutput(outFilenameJDFTx);
+
+	//Convert frames (divided over processes):
+	std::vector<int> frames;
+	if(frameMode) for(int frame=frameStart; frame<=frameStop; frame+=frameStride) frames.push_back(frame);
+	else frames.push_back(0);
+	TaskDivision frameDivision(frames.size(), mpiWorld);
+	int nConverted = 0;
+	for(size_t iFrame=frameDivision.start(); iFrame<frameDivision.stop(); iFrame++)
+	{	int frame = frames[iFrame];
+		string outFilename = outPattern;
+		std::vector<string> fieldFilenames = fieldPatterns;
+		int iStep = fc.nSteps()-1; //final structure by default
+		if(frameMode)
+		{	outFilename = substituteFrame(outPattern, frame);
+			for(string& fname: fieldFilenames) fname = substituteFrame(fname, frame);
+			iStep = frame + stepOffset - 1; //ionic steps are numbered from 1 (clamped to available range)
+		}
+		logPrintf("Writing '%s' ... ", outFilename.c_str()); logFlush();
+		fc.convert(iStep, fieldFilenames, outFilename);
+		logPrintf("done.\n"); logFlush();
+		nConverted++;
+	}
+	mpiWorld->allReduce(nConverted, MPIUtil::ReduceSum);
+	if(frameMode) logPrintf("Converted %d frames on %d processes.\n", nConverted, mpiWorld->nProcesses());
+
+	finalizeSystem();
+	return 0;
+}
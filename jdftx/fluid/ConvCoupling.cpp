@@ -25,7 +25,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarField.h>
 
 ConvCoupling::ConvCoupling(FluidMixture* fluidMixture, const ExCorr& exCorr)
-: Fmix(fluidMixture), exCorr(exCorr), component(fluidMixture->getComponents())
+: Fmix(fluidMixture), exCorr(exCorr), component(fluidMixture->getComponents()), Phi_cavity(0.)
 {
 	Citations::add("Convolution-coupling for Joint Density Functional Theory",
 		"K. Letchworth-Weaver, R. Sundararaman and T.A. Arias, (under preparation)");
@@ -45,6 +45,8 @@ string ConvCoupling::getName() const
 
 void ConvCoupling::setExplicit(const ScalarFieldTilde& nCavityTilde)
 {	this->nCavity = I(nCavityTilde);
+	Vxc_cavity = 0;
+	Phi_cavity = exCorr(nCavity, &Vxc_cavity, true);
 }
 
 double ConvCoupling::energyAndGrad(const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArray* Phi_Ntilde, ScalarFieldTilde* Phi_nCavityTilde) const
@@ -63,11 +65,11 @@ double ConvCoupling::energyAndGrad(const ScalarFieldTildeArray& Ntilde, ScalarFi
 	
 	//Calculate exchange, correlation, and kinetic energy
 	ScalarField nTot = nFluid + nCavity;
-	ScalarField Vxc_tot, Vxc_fluid, Vxc_cavity;
+	ScalarField Vxc_tot, Vxc_fluid;
 	double Phi =
 		+ exCorr(nTot, &Vxc_tot, true)
 		- exCorr(nFluid, &Vxc_fluid, true)
-		- exCorr(nCavity, &Vxc_cavity,  true);
+		- Phi_cavity; //cached in setExplicit()
 	
 	//Accumulate electronic-side gradient if required:
 	if(Phi_nCavityTilde)
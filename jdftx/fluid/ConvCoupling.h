@@ -53,6 +53,8 @@ public:
 private:
 	const std::vector<const FluidComponent*>& component;
 	ScalarField nCavity;
+	double Phi_cavity; //!< exchange-correlation energy of nCavity alone (constant during fluid minimization, so cached)
+	ScalarField Vxc_cavity; //!< corresponding potential
 };
 
 //! @}
@@ -89,18 +89,20 @@ double Fex_H2O_FittedCorrelations::compute(const ScalarFieldTilde* Ntilde, Scala
 	PhiEx += 0.5*gInfo.dV*(dot(V_O,Ntilde[0]) + dot(V_H,Ntilde[1]));
 
 	//Compute gaussian weighted densities:
-	ScalarField NObar = I(fex_gauss*Ntilde[0]), Phi_NObar; nullToZero(Phi_NObar, gInfo);
-	ScalarField NHbar = I(fex_gauss*Ntilde[1]), Phi_NHbar; nullToZero(Phi_NHbar, gInfo);
-	//Evaluated weighted density functional:
+	ScalarField NObar = I(fex_gauss*Ntilde[0]);
+	ScalarField NHbar = I(fex_gauss*Ntilde[1]);
+	//Evaluate weighted density functional, overwriting the weighted densities by the gradients in the same pass:
 	#ifdef GPU_ENABLED
-	ScalarField fex(ScalarFieldData::alloc(gInfo,isGpuEnabled()));
+	if(!fexScratch) fexScratch = ScalarFieldData::alloc(gInfo, true);
 	Fex_H20_FittedCorrelations_gpu(gInfo.nr, NObar->dataGpu(), NHbar->dataGpu(),
-		 fex->dataGpu(), Phi_NObar->dataGpu(), Phi_NHbar->dataGpu());
-	PhiEx += integral(fex);
+		 fexScratch->dataGpu(), NObar->dataGpu(), NHbar->dataGpu());
+	PhiEx += integral(fexScratch);
 	#else
 	PhiEx += gInfo.dV*threadedAccumulate(Fex_H2O_FittedCorrelations_calc, gInfo.nr,
-		 NObar->data(), NHbar->data(), Phi_NObar->data(), Phi_NHbar->data());
+		 NObar->data(), NHbar->data(), NObar->data(), NHbar->data());
 	#endif
+	const ScalarField& Phi_NObar = NObar;
+	const ScalarField& Phi_NHbar = NHbar;
 	//Convert gradients:
 	Phi_Ntilde[0] += fex_gauss*Idag(Phi_NObar);
 	Phi_Ntilde[1] += fex_gauss*Idag(Phi_NHbar);
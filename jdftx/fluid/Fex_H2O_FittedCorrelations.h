@@ -35,6 +35,9 @@ public:
 	double computeUniform(const double* N, double* Phi_N) const;
 private:
 	RadialFunctionG COO, COH, CHH, fex_gauss;
+	#ifdef GPU_ENABLED
+	mutable ScalarField fexScratch; //!< energy density buffer for the GPU kernel (reused between compute() calls)
+	#endif
 };
 
 //! @}
@@ -44,14 +44,16 @@ namespace Fex_H2O_FittedCorrelations_internal
 	}
 }
 //Compute the gaussian weighted density energy and gradients
+//(Phi_NObar and Phi_NHbar may alias NObar and NHbar respectively, to evaluate in place)
 __hostanddev__
 double Fex_H2O_FittedCorrelations_calc(int i, const double* NObar, const double* NHbar, double* Phi_NObar, double* Phi_NHbar)
 {	using namespace Fex_H2O_FittedCorrelations_internal;
-	double Nmean = (1.0/3)*(NObar[i] + NHbar[i]);
+	double NO = NObar[i], NH = NHbar[i];
+	double Nmean = (1.0/3)*(NO + NH);
 	double fDotMean = fexDot(Nmean);
-	Phi_NObar[i] = ((1.0/3)*pMean*fDotMean + pObar*fexDot(NObar[i]));
-	Phi_NHbar[i] = ((1.0/3)*pMean*fDotMean + pHbar*fexDot(NHbar[i]*0.5)*0.5);
-	return pMean*fex(Nmean) + pObar*fex(NObar[i]) + pHbar*fex(NHbar[i]*0.5);
+	Phi_NObar[i] = ((1.0/3)*pMean*fDotMean + pObar*fexDot(NO));
+	Phi_NHbar[i] = ((1.0/3)*pMean*fDotMean + pHbar*fexDot(NH*0.5)*0.5);
+	return pMean*fex(Nmean) + pObar*fex(NO) + pHbar*fex(NH*0.5);
 }
 
 #endif // JDFTX_FLUID_FEX_H2O_FITTEDCORRELATIONS_INTERNAL_H
@@ -98,6 +98,13 @@ double Fmix_LJ::compute(const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArr
 	Phi_Ntilde[i2] += V1;
 	return gInfo.dV*dot(V1,Ntilde[i2]);
 }
+bool Fmix_LJ::getPairKernel(PairKernel& pk) const
+{	pk.i1 = fluid1->offsetDensity;
+	pk.i2 = fluid2->offsetDensity;
+	pk.kernel = &ljatt;
+	pk.prefactor = 1.;
+	return true;
+}
 double Fmix_LJ::computeUniform(const std::vector<double>& N, std::vector<double>& Phi_N) const
 {	unsigned i1 = fluid1->offsetDensity;
 	unsigned i2 = fluid2->offsetDensity;
@@ -137,6 +144,14 @@ double Fmix_GaussianKernel::computeUniform(const std::vector< double >& N, std::
 		return N[i1]*Kmul*Ksolv(0)*N[i2];
 }
 
+bool Fmix_GaussianKernel::getPairKernel(PairKernel& pk) const
+{	pk.i1 = fluid1->offsetDensity;
+	pk.i2 = fluid2->offsetDensity;
+	pk.kernel = &Ksolv;
+	pk.prefactor = Kmul;
+	return true;
+}
+
 double Fmix_GaussianKernel::compute(const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArray& Phi_Ntilde) const
 {
 		unsigned i1 = fluid1->offsetDensity;
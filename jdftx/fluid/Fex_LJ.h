@@ -62,6 +62,7 @@ public:
 
 	double compute(const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArray& Phi_Ntilde) const;
 	double computeUniform(const std::vector<double>& N, std::vector<double>& Phi_N) const;
+	bool getPairKernel(PairKernel& pk) const;
 private:
 	std::shared_ptr<FluidComponent> fluid1, fluid2;
 	RadialFunctionG ljatt;
@@ -80,6 +81,7 @@ public:
 
 	double compute(const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArray& Phi_Ntilde) const;
 	double computeUniform(const std::vector<double>& N, std::vector<double>& Phi_N) const;
+	bool getPairKernel(PairKernel& pk) const;
 private:
 	std::shared_ptr<FluidComponent> fluid1, fluid2;
 	RadialFunctionG Ksolv; //shape function for interaction
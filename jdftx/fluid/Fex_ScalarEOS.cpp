@@ -57,17 +57,23 @@ double Fex_ScalarEOS::compute(const ScalarFieldTilde* Ntilde, ScalarFieldTilde*
 	NavgTilde *= (1./alphaTot);
 	//Compute LJatt weighted density:
 	ScalarField Nbar = I(fex_LJatt*NavgTilde);
-	//Evaluated weighted density functional:
-	ScalarField Aex, Aex_Nbar; nullToZero(Aex, gInfo); nullToZero(Aex_Nbar, gInfo);
-	callPref(eos.evaluate)(gInfo.nr, Nbar->dataPref(), Aex->dataPref(), Aex_Nbar->dataPref(), Vhs);
-	//Convert gradients:
 	ScalarField Navg = I(NavgTilde);
-	ScalarFieldTilde IdagAex = Idag(Aex);
+	//Evaluate weighted density functional, overwriting Nbar by the gradient Navg*Aex_Nbar in the same pass:
+	if(!Aex) Aex = ScalarFieldData::alloc(gInfo, isGpuEnabled());
+	#ifdef GPU_ENABLED
+	eos.evaluateFused_gpu(gInfo.nr, Nbar->dataGpu(), Navg->dataGpu(), Aex->dataGpu(), Nbar->dataGpu(), Vhs);
+	double PhiEx = gInfo.dV*dot(Navg,Aex);
+	#else
+	double PhiEx = gInfo.dV*eos.evaluateFused(gInfo.nr, Nbar->data(), Navg->data(), Aex->data(), Nbar->data(), Vhs);
+	#endif
+	const ScalarField& NavgAex_Nbar = Nbar;
+	//Convert gradients (common to all sites, up to the polarizability weights):
+	ScalarFieldTilde Phi_NavgTilde = fex_LJatt*Idag(NavgAex_Nbar) + Idag(Aex);
 	for(unsigned i=0; i<molecule.sites.size(); i++)
 	{	const Molecule::Site& s = *(molecule.sites[i]);
-		Phi_Ntilde[i] += (fex_LJatt*Idag(Navg*Aex_Nbar) + IdagAex) * (s.alpha/alphaTot);
+		Phi_Ntilde[i] += (s.alpha/alphaTot) * Phi_NavgTilde;
 	}
-	return gInfo.dV*dot(Navg,Aex);
+	return PhiEx;
 }
 
 double Fex_ScalarEOS::computeUniform(const double* N, double* Phi_N) const
@@ -97,11 +103,18 @@ void evalJeffereyAustinEOS_sub(size_t iStart, size_t iStop, const double* N, dou
 void JeffereyAustinEOS::evaluate(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const
 {	threadLaunch(evalJeffereyAustinEOS_sub, nData, N, Aex, Aex_N, Vhs, *eval);
 }
+double JeffereyAustinEOS::evaluateFused(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const
+{	return threadedAccumulate(ScalarEOS_fused_calc<JeffereyAustinEOS_eval>, nData, N, Navg, Aex, NavgAex_N, Vhs, *eval);
+}
 #ifdef GPU_ENABLED
 void evalJeffereyAustinEOS_gpu(int nr, const double* Nbar, double* Fex, double* Phi_Nbar, double Vhs, const JeffereyAustinEOS_eval& eval);
 void JeffereyAustinEOS::evaluate_gpu(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const
 {	evalJeffereyAustinEOS_gpu(nData, N, Aex, Aex_N, Vhs, *eval);
 }
+void evalJeffereyAustinEOSFused_gpu(int nr, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const JeffereyAustinEOS_eval& eval);
+void JeffereyAustinEOS::evaluateFused_gpu(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const
+{	evalJeffereyAustinEOSFused_gpu(nData, N, Navg, Aex, NavgAex_N, Vhs, *eval);
+}
 #endif
 
 //--------------- class TaoMasonEOS ---------------
@@ -121,9 +134,16 @@ void evalTaoMasonEOS_sub(size_t iStart, size_t iStop, const double* N, double* A
 void TaoMasonEOS::evaluate(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const
 {	threadLaunch(evalTaoMasonEOS_sub, nData, N, Aex, Aex_N, Vhs, *eval);
 }
+double TaoMasonEOS::evaluateFused(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const
+{	return threadedAccumulate(ScalarEOS_fused_calc<TaoMasonEOS_eval>, nData, N, Navg, Aex, NavgAex_N, Vhs, *eval);
+}
 #ifdef GPU_ENABLED
 void evalTaoMasonEOS_gpu(int nr, const double* Nbar, double* Fex, double* Phi_Nbar, double Vhs, const TaoMasonEOS_eval& eval);
 void TaoMasonEOS::evaluate_gpu(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const
 {	evalTaoMasonEOS_gpu(nData, N, Aex, Aex_N, Vhs, *eval);
 }
+void evalTaoMasonEOSFused_gpu(int nr, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const TaoMasonEOS_eval& eval);
+void TaoMasonEOS::evaluateFused_gpu(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const
+{	evalTaoMasonEOSFused_gpu(nData, N, Navg, Aex, NavgAex_N, Vhs, *eval);
+}
 #endif
@@ -27,7 +27,17 @@ void evalJeffereyAustinEOS_kernel(int nr, const double* Nbar, double* Aex, doubl
 }
 void evalJeffereyAustinEOS_gpu(int nr, const double* Nbar, double* Aex, double* Aex_N, double Vhs, const JeffereyAustinEOS_eval& eval)
 {	GpuLaunchConfig1D glc(evalJeffereyAustinEOS_kernel, nr);
-	evalJeffereyAustinEOS_kernel<<<glc.nBlocks, glc.nPerBlock>>>(nr, Nbar, Aex, Aex_N, Vhs, eval);
+	evalJeffereyAustinEOS_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, Nbar, Aex, Aex_N, Vhs, eval);
+}
+
+__global__
+void evalJeffereyAustinEOSFused_kernel(int nr, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const JeffereyAustinEOS_eval eval)
+{	int i = kernelIndex1D();
+	if(i<nr) ScalarEOS_fused_calc(i, Nbar, Navg, Aex, NavgAex_Nbar, Vhs, eval);
+}
+void evalJeffereyAustinEOSFused_gpu(int nr, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const JeffereyAustinEOS_eval& eval)
+{	GpuLaunchConfig1D glc(evalJeffereyAustinEOSFused_kernel, nr);
+	evalJeffereyAustinEOSFused_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, Nbar, Navg, Aex, NavgAex_Nbar, Vhs, eval);
 }
 
 
@@ -38,6 +48,16 @@ void evalTaoMasonEOS_kernel(int nr, const double* Nbar, double* Aex, double* Aex
 }
 void evalTaoMasonEOS_gpu(int nr, const double* Nbar, double* Aex, double* Aex_N, double Vhs, const TaoMasonEOS_eval& eval)
 {	GpuLaunchConfig1D glc(evalTaoMasonEOS_kernel, nr);
-	evalTaoMasonEOS_kernel<<<glc.nBlocks, glc.nPerBlock>>>(nr, Nbar, Aex, Aex_N, Vhs, eval);
+	evalTaoMasonEOS_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, Nbar, Aex, Aex_N, Vhs, eval);
+}
+
+__global__
+void evalTaoMasonEOSFused_kernel(int nr, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const TaoMasonEOS_eval eval)
+{	int i = kernelIndex1D();
+	if(i<nr) ScalarEOS_fused_calc(i, Nbar, Navg, Aex, NavgAex_Nbar, Vhs, eval);
+}
+void evalTaoMasonEOSFused_gpu(int nr, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const TaoMasonEOS_eval& eval)
+{	GpuLaunchConfig1D glc(evalTaoMasonEOSFused_kernel, nr);
+	evalTaoMasonEOSFused_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(nr, Nbar, Navg, Aex, NavgAex_Nbar, Vhs, eval);
 }
 
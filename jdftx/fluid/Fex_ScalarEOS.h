@@ -34,6 +34,12 @@ struct ScalarEOS
 	#ifdef GPU_ENABLED
 	virtual void evaluate_gpu(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const=0;
 	#endif
+	//! Fused evaluation for a weighted density N and averaged density Navg: compute Aex and NavgAex_N = Navg*Aex_N
+	//! in one pass (NavgAex_N may alias N), and return the sum of Navg*Aex (the GPU version does not accumulate)
+	virtual double evaluateFused(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const=0;
+	#ifdef GPU_ENABLED
+	virtual void evaluateFused_gpu(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const=0;
+	#endif
 	ScalarEOS(double sigmaEOS) : sigmaEOS(sigmaEOS) {}
 	virtual ~ScalarEOS() {}
 };
@@ -51,6 +57,7 @@ public:
 private:
 	const ScalarEOS& eos; double Vhs;
 	RadialFunctionG fex_LJatt;
+	mutable ScalarField Aex; //!< per-particle excess free energy buffer (reused between compute() calls)
 };
 
 //! Jefferey-Austin equation of state for water
@@ -58,8 +65,10 @@ struct JeffereyAustinEOS : public ScalarEOS
 {	JeffereyAustinEOS(double T, double sigmaEOS);
 	double vdwRadius() const;
 	void evaluate(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const;
+	double evaluateFused(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const;
 	#ifdef GPU_ENABLED
 	void evaluate_gpu(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const;
+	void evaluateFused_gpu(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const;
 	#endif
 private:
 	std::shared_ptr<struct JeffereyAustinEOS_eval> eval;
@@ -70,8 +79,10 @@ struct TaoMasonEOS : public ScalarEOS
 {	TaoMasonEOS(double T, double Tc, double Pc, double omega, double sigmaEOS);
 	double vdwRadius() const;
 	void evaluate(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const;
+	double evaluateFused(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const;
 	#ifdef GPU_ENABLED
 	void evaluate_gpu(size_t nData, const double* N, double* Aex, double* Aex_N, double Vhs) const;
+	void evaluateFused_gpu(size_t nData, const double* N, const double* Navg, double* Aex, double* NavgAex_N, double Vhs) const;
 	#endif
 private:
 	std::shared_ptr<struct TaoMasonEOS_eval> eval;
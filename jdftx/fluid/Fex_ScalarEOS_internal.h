@@ -180,5 +180,15 @@ struct TaoMasonEOS_eval : public ScalarEOS_eval
 	}
 };
 
+//! Fused evaluation of the weighted density functional at grid point i: set Aex and NavgAex_Nbar = Navg * dAex/dNbar,
+//! and return the energy density Navg*Aex. NavgAex_Nbar may alias Nbar, to evaluate the gradient in place.
+template<typename EOS_eval> __hostanddev__
+double ScalarEOS_fused_calc(int i, const double* Nbar, const double* Navg, double* Aex, double* NavgAex_Nbar, double Vhs, const EOS_eval& eval)
+{	double NavgCur = Navg[i];
+	eval(i, Nbar, Aex, NavgAex_Nbar, Vhs); //reads Nbar[i] before writing NavgAex_Nbar[i]
+	NavgAex_Nbar[i] *= NavgCur;
+	return NavgCur * Aex[i];
+}
+
 //! @}
 #endif // JDFTX_FLUID_FEX_SCALAREOS_INTERNAL_H
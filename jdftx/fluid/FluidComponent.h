@@ -103,7 +103,8 @@ struct FluidComponent
 	enum TranslationMode
 	{	ConstantSpline,
 		LinearSpline, //!< default and recommended
-		Fourier
+		Fourier,
+		FourierCached //!< Fourier with reciprocal-space phase factors precomputed for each site translation (faster, but memory intensive)
 	}
 	translationMode; //!< type of translation operator used for sampling rigid molecule geometry
 	
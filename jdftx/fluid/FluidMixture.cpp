@@ -24,7 +24,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 extern string rigidMoleculeCDFT_ScalarEOSpaper;
 
 FluidMixture::FluidMixture(const GridInfo& gInfo, const double T)
-: gInfo(gInfo), T(T), verboseLog(false), useMFKernel(false), Qtol(1e-12), nIndepIdgas(0), nDensities(0), polarizable(false)
+: gInfo(gInfo), T(T), verboseLog(false), useMFKernel(false), Qtol(1e-12), historyResetThreshold(0.1), nIndepIdgas(0), nDensities(0), polarizable(false)
 {
 	logPrintf("Initializing fluid mixture at T=%lf K ...\n", T/Kelvin);
 	Citations::add("Rigid-molecule density functional theory framework", rigidMoleculeCDFT_ScalarEOSpaper);
@@ -163,7 +163,8 @@ void FluidMixture::addFmix(const Fmix* fmix)
 
 
 void FluidMixture::initState(double scale, double Elo, double Ehi)
-{	//Compute the effective nonlinear coupling potential for the uniform fluid:
+{	clearHistory();
+	//Compute the effective nonlinear coupling potential for the uniform fluid:
 	ScalarFieldArray Vex(nDensities);
 	{	//Get the uniform fluid site densities:
 		std::vector<double> Nbulk(nDensities);
@@ -224,7 +225,8 @@ void FluidMixture::initState(double scale, double Elo, double Ehi)
 }
 
 void FluidMixture::loadState(const char* filename)
-{	nullToZero(state, gInfo, get_nIndep());
+{	clearHistory();
+	nullToZero(state, gInfo, get_nIndep());
 	loadFromFile(state, filename);
 }
 
@@ -271,6 +273,43 @@ double FluidMixture::sync(double x) const
 	return x;
 }
 
+void FluidMixture::clearHistory()
+{	historyVectors.clear();
+	historyScalars.clear();
+	rhoExternalHistory = 0;
+}
+
+void FluidMixture::saveHistory(const std::vector<const ScalarFieldArray*>& vectors, const std::vector<double>& scalars)
+{	//L-BFGS never modifies history entries in place, so share their data rather than copying:
+	historyVectors.resize(vectors.size());
+	for(size_t i=0; i<vectors.size(); i++) historyVectors[i] = *(vectors[i]);
+	historyScalars = scalars;
+}
+
+bool FluidMixture::loadHistory(std::vector<ScalarFieldArray>& vectors, std::vector<double>& scalars)
+{	//Check validity of history against the change in rhoExternal:
+	bool valid = historyScalars.size() && historyResetThreshold > 0.;
+	if(valid && (rhoExternal || rhoExternalHistory))
+	{	double rhoNorm = rhoExternal ? nrm2(rhoExternal) : 0.;
+		double rhoChange = rhoExternalHistory ? nrm2(rhoExternal ? rhoExternal-rhoExternalHistory : rhoExternalHistory) : rhoNorm;
+		double relChange = rhoNorm ? rhoChange/rhoNorm : (rhoChange ? DBL_MAX : 0.);
+		if(relChange > historyResetThreshold)
+		{	logPrintf("\tDiscarding fluid minimizer history: relative change in rhoExternal %.2le exceeds %lg.\n", relChange, historyResetThreshold);
+			valid = false;
+		}
+	}
+	//History saved during this minimization will correspond to current rhoExternal:
+	rhoExternalHistory = rhoExternal ? clone(rhoExternal) : 0;
+	if(!valid)
+	{	historyVectors.clear();
+		historyScalars.clear();
+		return false;
+	}
+	vectors = historyVectors;
+	scalars = historyScalars;
+	return true;
+}
+
 double FluidMixture::compute_p(double Ntot) const
 {	std::vector<double> Nmol(component.size()), Phi_Nmol(component.size());
 	double Nguess=0.;
@@ -66,6 +66,11 @@ public:
 	ScalarFieldTilde rhoExternal;
 	bool useMFKernel; //!If true, use the mean field kernel for external coulomb interactions as well 
 	double Qtol; //!< tolerance for unit cell neutrality (default 1e-12)
+	
+	//! L-BFGS history of the previous minimize() is resumed unless the relative change (2-norm) in rhoExternal
+	//! since then exceeds this threshold (default 0.1; set to 0 to always start afresh)
+	double historyResetThreshold;
+	void clearHistory(); //!< discard the L-BFGS history kept across minimize() calls (state changed externally)
 
 	//! Initialize the independent variables
 	//! @param scale scale the state that would produce the equilibrium ideal gas densities by this amount to ge tthe guess
@@ -114,7 +119,17 @@ public:
 	
 	double sync(double x) const; //!< All processes minimize together; make sure scalars are in sync to round-off error
 	
+	//! Keep the L-BFGS history (interface for minimize())
+	void saveHistory(const std::vector<const ScalarFieldArray*>& vectors, const std::vector<double>& scalars);
+	
+	//! Resume the L-BFGS history of the previous minimize(), if rhoExternal has not changed significantly (interface for minimize())
+	bool loadHistory(std::vector<ScalarFieldArray>& vectors, std::vector<double>& scalars);
+	
 private:
+	std::vector<ScalarFieldArray> historyVectors; //!< L-BFGS history vectors kept across minimize() calls (shared with the minimizer, not copied)
+	std::vector<double> historyScalars; //!< L-BFGS history scalars kept across minimize() calls
+	ScalarFieldTilde rhoExternalHistory; //!< rhoExternal at which historyVectors / historyScalars were accumulated
+	
 	unsigned nIndepIdgas; //!< number of scalar fields used as independent variables for the component ideal gases
 	unsigned nDensities; //!< total number of site densities
 	bool polarizable;  //!< whether an additional vector field is required due to polarizable components
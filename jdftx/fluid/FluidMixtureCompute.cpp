@@ -44,6 +44,7 @@ double Qtot(double betaV, double& Qtot_betaV, const std::vector<std::pair<double
 
 double FluidMixture::operator()(const ScalarFieldArray& indep, ScalarFieldArray& Phi_indep, Outputs outputs) const
 {	static StopWatch watch("FluidMixture::operator()"); watch.start();
+	ManagedMemoryBase::TransferStats transfers0 = ManagedMemoryBase::getTransferStats(); //to report any host-device migrations
 
 	//logPrintf("indep.size: %d nIndep: %d\n",indep.size(),nIndep);
 	assert(indep.size()==get_nIndep());
@@ -156,7 +157,8 @@ double FluidMixture::operator()(const ScalarFieldArray& indep, ScalarFieldArray&
 			  { 
 			    const Molecule::Site& s = *(c.molecule.sites[i]);
 			    Phi["Gzero"] += Qfixed*(Ntot_c[ic]/gInfo.detR-c.idealGas->Nbulk)*s.positions.size()*s.deltaS;
-			    Phi_Ntilde[c.offsetDensity+i]->data()[0] += (1.0/gInfo.dV) * (Qfixed*s.deltaS);
+			    ScalarFieldTilde& Phi_Nsite = Phi_Ntilde[c.offsetDensity+i];
+			    Phi_Nsite->setGzero(Phi_Nsite->getGzero() + (1.0/gInfo.dV) * (Qfixed*s.deltaS)); //avoid migrating the whole array to the CPU
 			  }
 		}
 	}
@@ -304,24 +306,29 @@ double FluidMixture::operator()(const ScalarFieldArray& indep, ScalarFieldArray&
 			}
 		}
 		if(n0tilde) //at least one sphere in the mixture
-		{	ScalarField n0 = I(n0tilde); n0tilde=0;
-			ScalarField n1 = I(n1tilde); n1tilde=0;
-			ScalarField n2 = I(n2tilde); n2tilde=0;
-			ScalarField Phi_n0, Phi_n1, Phi_n2; ScalarFieldTilde Phi_n3tilde, Phi_n1vTilde, Phi_n2mTilde;
+		{	ScalarFieldTilde Phi_n0tilde, Phi_n1tilde, Phi_n2tilde, Phi_n3tilde, Phi_n1vTilde, Phi_n2mTilde;
+			std::vector<ScalarField> Phi_n0mol(component.size());
+			//Bonding corrections if required (evaluated within PhiFMT, reusing its real-space weighted densities):
+			double PhiBonding = 0.;
+			auto bondTerms = [&](const ScalarField& n2, const ScalarField& n3, const VectorField& n2v,
+				ScalarField& Phi_n2, ScalarField& Phi_n3, VectorField& Phi_n2v)
+			{	for(unsigned ic=0; ic<component.size(); ic++)
+					for(const auto& b: bond[ic])
+						PhiBonding += PhiBond(b.first, b.second*1./n0mult[ic],
+							n0mol[ic], n2, n3, n2v, Phi_n0mol[ic], Phi_n2, Phi_n3, Phi_n2v);
+			};
 			//Compute the sphere mixture free energy:
-			Phi["MixedFMT"] += T * PhiFMT(n0, n1, n2, n3tilde, n1vTilde, n2mTilde,
-				Phi_n0, Phi_n1, Phi_n2, Phi_n3tilde, Phi_n1vTilde, Phi_n2mTilde);
-			//Bonding corrections if required
+			Phi["MixedFMT"] += T * PhiFMT(n0tilde, n1tilde, n2tilde, n3tilde, n1vTilde, n2mTilde,
+				Phi_n0tilde, Phi_n1tilde, Phi_n2tilde, Phi_n3tilde, Phi_n1vTilde, Phi_n2mTilde,
+				bondsPresent ? PhiFMTextra(bondTerms) : PhiFMTextra());
+			n0tilde=0; n1tilde=0; n2tilde=0;
 			if(bondsPresent)
-			{	for(unsigned ic=0; ic<component.size(); ic++)
+			{	Phi["Bonding"] += T * PhiBonding;
+				for(unsigned ic=0; ic<component.size(); ic++)
 				{	const FluidComponent& c = *component[ic];
-					ScalarField Phi_n0mol;
-					for(const auto& b: bond[ic])
-						Phi["Bonding"] += T * PhiBond(b.first, b.second*1./n0mult[ic],
-							n0mol[ic], n2, n3tilde, Phi_n0mol, Phi_n2, Phi_n3tilde);
-					if(Phi_n0mol)
+					if(Phi_n0mol[ic])
 					{	//Propagate gradient w.r.t n0mol[ic] to the site densities:
-						ScalarFieldTilde Phi_n0molTilde = Idag(Phi_n0mol);
+						ScalarFieldTilde Phi_n0molTilde = Idag(Phi_n0mol[ic]); Phi_n0mol[ic]=0;
 						for(unsigned i=0; i<c.molecule.sites.size(); i++)
 						{	const Molecule::Site& s = *(c.molecule.sites[i]);
 							if(s.Rhs)
@@ -331,9 +338,6 @@ double FluidMixture::operator()(const ScalarFieldArray& indep, ScalarFieldArray&
 				}
 			}
 			//Accumulate gradients w.r.t weighted densities to site densities:
-			ScalarFieldTilde Phi_n0tilde = Idag(Phi_n0); Phi_n0=0;
-			ScalarFieldTilde Phi_n1tilde = Idag(Phi_n1); Phi_n1=0;
-			ScalarFieldTilde Phi_n2tilde = Idag(Phi_n2); Phi_n2=0;
 			for(const FluidComponent* c: component)
 			{	for(unsigned i=0; i<c->molecule.sites.size(); i++)
 				{	const Molecule::Site& s = *(c->molecule.sites[i]);
@@ -356,8 +360,22 @@ double FluidMixture::operator()(const ScalarFieldArray& indep, ScalarFieldArray&
 		Phi["Fex("+c->molecule.name+")"] += c->fex->compute(&Ntilde[c->offsetDensity], &Phi_Ntilde[c->offsetDensity]);
 
 	//--------- Mixing functionals --------------
+	//(pairwise kernels are evaluated together in one reciprocal-space pass, the remaining functionals individually)
+	std::vector<Fmix::PairKernel> pairs;
+	std::vector<const Fmix*> pairFmix;
 	for(const Fmix* fmix: fmixArr)
-		Phi["Fmix("+fmix->getName()+")"] += fmix->compute(Ntilde, Phi_Ntilde);
+	{	Fmix::PairKernel pk;
+		if(fmix->getPairKernel(pk))
+		{	pairs.push_back(pk);
+			pairFmix.push_back(fmix);
+		}
+		else Phi["Fmix("+fmix->getName()+")"] += fmix->compute(Ntilde, Phi_Ntilde);
+	}
+	if(pairs.size())
+	{	std::vector<double> Epairs = Fmix::computePairs(gInfo, pairs, Ntilde, Phi_Ntilde);
+		for(size_t p=0; p<pairs.size(); p++)
+			Phi["Fmix("+pairFmix[p]->getName()+")"] += Epairs[p];
+	}
 
 	//--------- PhiNI ---------
 	nullToZero(Phi_Ntilde, gInfo);
@@ -457,6 +475,7 @@ double FluidMixture::operator()(const ScalarFieldArray& indep, ScalarFieldArray&
 	if(outputs.Phi) *(outputs.Phi) = Phi;
 	
 	Phi_indep *= gInfo.dV; //convert functional derivative to partial derivative
+	ManagedMemoryBase::reportTransfers("FluidMixture", transfers0); //should be silent when the evaluation is fully GPU-resident
 	watch.stop();
 	return Phi;
 }
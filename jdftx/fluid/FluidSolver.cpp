@@ -34,6 +34,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarFieldIO.h>
 #include <core/Units.h>
 #include <core/WignerSeitz.h>
+#include <core/LatticeUtils.h>
 
 //--------------------------------------------------------------------------
 //-------------------- Convolution coupled fluid solver --------------------
@@ -225,6 +226,16 @@ public:
 		if(!Adiel_rhoExplicitTilde) updateCached();
 	}
 	
+	void getStateFields(ScalarFieldArray& fields) const
+	{	fields = fluidMixture->state;
+	}
+	
+	void setStateFields(const ScalarFieldArray& fields)
+	{	fluidMixture->state = fields;
+		fluidMixture->clearHistory(); //minimizer history does not apply to the new state
+		Adiel_rhoExplicitTilde = 0; //cached quantities updated at next set_internal
+	}
+	
 	void updateCached()
 	{	ScalarFieldArray N;
 		FluidMixture::Outputs outputs(&N, 0, &Adiel_rhoExplicitTilde, 0, &Adiel);
@@ -265,7 +276,7 @@ public:
 //---------------------------------------------------------------------
 
 FluidSolver::FluidSolver(const Everything& e, const FluidSolverParams& fsp)
-: e(e), gInfo(e.coulomb->gInfo), fsp(fsp), atpos(e.iInfo.species.size())
+: e(e), gInfo(e.coulomb->gInfo), fsp(fsp), atpos(e.iInfo.species.size()), atposConverged(false)
 {	//Initialize radial kernels in molecule sites:
 	for(const auto& c: fsp.components)
 		if(!c->molecule)
@@ -313,7 +324,7 @@ double FluidSolver::ionWidthMuCorrection() const
 {	return (4*M_PI/gInfo.detR) * (-0.5*pow(e.iInfo.ionWidth,2)) * e.iInfo.getZtot();
 }
 
-void FluidSolver::set(const ScalarFieldTilde& rhoExplicitTilde, const ScalarFieldTilde& nCavityTilde)
+void FluidSolver::updateAtpos()
 {	for(unsigned iSp=0; iSp<atpos.size(); iSp++)
 		atpos[iSp] = e.iInfo.species[iSp]->atpos;
 	if(e.coulombParams.embed)
@@ -321,12 +332,85 @@ void FluidSolver::set(const ScalarFieldTilde& rhoExplicitTilde, const ScalarFiel
 		for(std::vector<vector3<> >& posArr: atpos)
 			for(vector3<>& pos: posArr) //transform to embedded lattice coordinates:
 				pos = embedScaleMat *  e.coulomb->wsOrig->restrict(pos - e.coulomb->xCenter);
-		set_internal(e.coulomb->embedExpand(rhoExplicitTilde), e.coulomb->embedExpand(nCavityTilde));
 	}
+}
+
+void FluidSolver::set(const ScalarFieldTilde& rhoExplicitTilde, const ScalarFieldTilde& nCavityTilde)
+{	updateAtpos();
+	atposConverged = true;
+	if(e.coulombParams.embed)
+		set_internal(e.coulomb->embedExpand(rhoExplicitTilde), e.coulomb->embedExpand(nCavityTilde));
 	else
 		set_internal(rhoExplicitTilde, nCavityTilde);
 }
 
+void FluidSolver::extrapolateState()
+{	if(!fsp.extrapolationHistory) return;
+	ScalarFieldArray fields; getStateFields(fields);
+	if(!fields.size()) return; //not supported by this fluid, or no state yet
+	static StopWatch watch("FluidSolver::extrapolateState"); watch.start();
+	auto flatPositions = [&]()
+	{	std::vector<vector3<>> pos;
+		for(const std::vector<vector3<>>& posArr: atpos)
+			for(const vector3<>& x: posArr)
+				pos.push_back(gInfo.R * x);
+		return pos;
+	};
+	if(nrm2(gInfo.R - Rhistory) > symmThreshold) stateHistory.clear(); //lattice changed: history invalid
+	Rhistory = gInfo.R;
+	
+	//Add current state to history if it was converged at atpos:
+	if(atposConverged)
+	{	StateSnapshot snapshot;
+		snapshot.pos = flatPositions();
+		snapshot.fields = clone(fields);
+		//Replace latest entry if at the same positions (eg. after a rejected ionic step):
+		if(stateHistory.size())
+		{	double distSq = 0.;
+			for(size_t i=0; i<snapshot.pos.size(); i++)
+				distSq += (snapshot.pos[i] - stateHistory.front().pos[i]).length_squared();
+			if(distSq < symmThresholdSq) stateHistory.pop_front();
+		}
+		stateHistory.push_front(snapshot);
+		while(int(stateHistory.size()) > fsp.extrapolationHistory) stateHistory.pop_back();
+	}
+	updateAtpos();
+	atposConverged = false;
+	int nHist = stateHistory.size();
+	if(nHist < 2) { watch.stop(); return; } //nothing to extrapolate from yet
+	
+	//Express new displacement from the latest positions as a combination of those of previous steps
+	//(least-squares with a small ridge term): this reduces to polynomial extrapolation for uniform time steps,
+	//and remains sensible for the variable steps of line searches.
+	std::vector<vector3<>> posNew = flatPositions();
+	const std::vector<vector3<>>& pos0 = stateHistory[0].pos;
+	matrix M = zeroes(nHist-1, nHist-1), b = zeroes(nHist-1, 1);
+	for(int j=1; j<nHist; j++)
+	{	const std::vector<vector3<>>& posj = stateHistory[j].pos;
+		for(size_t i=0; i<pos0.size(); i++)
+		{	vector3<> Dj = posj[i] - pos0[i];
+			b.set(j-1,0, b(j-1,0) + dot(Dj, posNew[i]-pos0[i]));
+			for(int k=1; k<nHist; k++)
+				M.set(j-1,k-1, M(j-1,k-1) + dot(Dj, stateHistory[k].pos[i]-pos0[i]));
+		}
+	}
+	double ridge = 1e-3 * trace(M).real() / (nHist-1);
+	if(!ridge) { watch.stop(); return; } //no displacement in history
+	for(int j=0; j<nHist-1; j++) M.set(j,j, M(j,j) + ridge);
+	matrix c = inv(M) * b;
+	
+	//Apply the same combination to the states:
+	ScalarFieldArray fieldsNew = clone(stateHistory[0].fields);
+	for(int j=1; j<nHist; j++)
+	{	double cj = c(j-1,0).real();
+		axpy(cj, stateHistory[j].fields, fieldsNew);
+		axpy(-cj, stateHistory[0].fields, fieldsNew);
+	}
+	setStateFields(fieldsNew);
+	logPrintf("Extrapolated fluid state from %d previous ionic steps.\n", nHist);
+	watch.stop();
+}
+
 double FluidSolver::get_Adiel_and_grad(ScalarFieldTilde* Adiel_rhoExplicitTilde, ScalarFieldTilde* Adiel_nCavityTilde, IonicGradient* extraForces) const
 {	if(e.coulombParams.embed)
 	{	ScalarFieldTilde Adiel_rho_big, Adiel_n_big;
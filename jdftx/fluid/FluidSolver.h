@@ -27,6 +27,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/ScalarField.h>
 #include <fluid/FluidSolverParams.h>
 #include <electronic/IonicMinimizer.h>
+#include <deque>
 
 //! Abstract base class for the fluid solvers
 struct FluidSolver
@@ -76,6 +77,11 @@ struct FluidSolver
 	void getSusceptibility(const std::vector<complex>& omega, std::vector<SusceptibilityTerm>& susceptibility, ScalarFieldTildeArray& sTilde) const;
 
 	virtual double bulkPotential() {return 0.0;}
+	
+	//! Extrapolate the fluid state to the current atomic positions, from its converged values at up to
+	//! FluidSolverParams::extrapolationHistory previous positions (no-op if that is zero).
+	//! Called after each ionic step, before the electronic system and fluid are re-converged.
+	void extrapolateState();
 
 	//! Dump relevant fluid densities (eg. NO and NH) to file(s)
 	//! the provided pattern will have a single %s which may be substituted
@@ -110,6 +116,23 @@ protected:
 	
 	//! Fluid-dependent implementation of getSusceptibility()
 	virtual void getSusceptibility_internal(const std::vector<complex>& omega, std::vector<SusceptibilityTerm>& susceptibility, ScalarFieldArray& sArr) const;
+	
+	//! Get the independent variables of the fluid as real-space fields for extrapolateState()
+	//! (returning an empty list, as by default, disables extrapolation)
+	virtual void getStateFields(ScalarFieldArray& fields) const {}
+	
+	//! Set the independent variables of the fluid from fields in the layout of getStateFields()
+	virtual void setStateFields(const ScalarFieldArray& fields) {}
+
+private:
+	void updateAtpos(); //!< set atpos from current positions (in embedded coordinates if necessary)
+	bool atposConverged; //!< whether the fluid state was last converged at atpos (rather than extrapolated to it)
+	struct StateSnapshot
+	{	std::vector<vector3<>> pos; //!< atomic positions (in cartesian coordinates, flattened over species)
+		ScalarFieldArray fields; //!< converged fluid state at these positions
+	};
+	std::deque<StateSnapshot> stateHistory; //!< most recent first
+	matrix3<> Rhistory; //!< lattice vectors of stateHistory (cleared when these change)
 };
 
 //! Create and return a JDFTx solver (the solver can be freed using delete)
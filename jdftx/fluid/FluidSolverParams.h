@@ -145,12 +145,17 @@ struct FluidSolverParams
 	double zMaskIonH; //half-width in z lattice coordinates for ionic cavity mask
 	double zMaskSigma; //smoothness of z-mask in bohrs
 	
+	double cavityReuseThreshold; //!< relative RMS change in cavity inputs below which the previous cavity is reused (0 => reuse only if unchanged)
+	
 	//Debug parameters for Nonlinear PCM's:
 	bool linearDielectric; //!< If true, work in the linear dielectric response limit
 	bool linearScreening; //!< If true, work in the linearized Poisson-Boltzman limit for the ions
 	bool nonlinearSCF; //!< whether to use an SCF method for nonlinear PCMs
+	bool nonlinearNewton; //!< whether the SCF method for nonlinear PCMs uses Newton-Krylov steps instead of Pulay mixing
 	double screenOverride; //! overrides screening factor with this value
 	PulayParams scfParams; //!< parameters controlling Pulay mixing for SCF version of nonlinear PCM
+	int pcmMultigridLevels; //!< number of coarse grids in the multigrid preconditioner of linear PCM solves (0 = kinetic preconditioner only)
+	int extrapolationHistory; //!< number of previous ionic steps used to extrapolate the fluid state at each new step (0 = restart from previous state)
 	
 	//For Explicit Fluid JDFT alone:
 	ExCorr exCorr; //!< Fluid exchange-correlation and kinetic energy functional
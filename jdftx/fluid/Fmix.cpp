@@ -19,9 +19,72 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <fluid/Fmix.h>
 #include <fluid/FluidMixture.h>
+#include <core/Operators.h>
+#include <core/LoopMacros.h>
+#include <core/Thread.h>
+#include <mutex>
 
 Fmix::Fmix(FluidMixture* fluidMixture)
 : gInfo(fluidMixture->gInfo), T(fluidMixture->T)
 {	fluidMixture->addFmix(this);
 }
 
+
+#ifndef GPU_ENABLED
+void computePairs_sub(size_t iStart, size_t iStop, const vector3<int> S, const matrix3<>& GGT,
+	const Fmix::PairKernel* pairs, int nPairs, const complex* const* N, complex* const* Phi, double* E, std::mutex* lock)
+{	std::vector<double> Elocal(nPairs, 0.);
+	THREAD_halfGspaceLoop
+	(	double G = sqrt(GGT.metric_length_squared(iG));
+		double w = (iG[2]==0 || iG[2]==size2-1) ? 1. : 2.; //half-space weights (same as dot of ScalarFieldTilde's)
+		for(int p=0; p<nPairs; p++)
+		{	const Fmix::PairKernel& pk = pairs[p];
+			double K = pk.prefactor * (*pk.kernel)(G);
+			complex N1 = N[pk.i1][i];
+			complex N2 = N[pk.i2][i];
+			Phi[pk.i1][i] += K * N2;
+			Phi[pk.i2][i] += K * N1;
+			Elocal[p] += w * K * (N1.conj() * N2).real();
+		}
+	)
+	std::lock_guard<std::mutex> guard(*lock);
+	for(int p=0; p<nPairs; p++) E[p] += Elocal[p];
+}
+#endif
+
+std::vector<double> Fmix::computePairs(const GridInfo& gInfo, const std::vector<PairKernel>& pairs,
+	const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArray& Phi_Ntilde)
+{	static StopWatch watch("Fmix::computePairs"); watch.start();
+	int nPairs = pairs.size();
+	std::vector<double> E(nPairs, 0.);
+	#ifdef GPU_ENABLED
+	//Per-pair kernel products (same operations as the individual compute() implementations):
+	for(int p=0; p<nPairs; p++)
+	{	const PairKernel& pk = pairs[p];
+		ScalarFieldTilde V1 = (gInfo.nr * pk.prefactor) * ((*pk.kernel) * Ntilde[pk.i1]);
+		ScalarFieldTilde V2 = (gInfo.nr * pk.prefactor) * ((*pk.kernel) * Ntilde[pk.i2]);
+		Phi_Ntilde[pk.i1] += V2;
+		Phi_Ntilde[pk.i2] += V1;
+		E[p] = gInfo.dV * dot(V1, Ntilde[pk.i2]);
+	}
+	#else
+	//Collect data pointers of the site densities involved (with scale factors absorbed):
+	std::vector<const complex*> N(Ntilde.size(), 0);
+	std::vector<complex*> Phi(Ntilde.size(), 0);
+	for(const PairKernel& pk: pairs)
+		for(unsigned iSite: {pk.i1, pk.i2})
+			if(!N[iSite])
+			{	N[iSite] = Ntilde[iSite]->data();
+				if(!Phi_Ntilde[iSite]) nullToZero(Phi_Ntilde[iSite], gInfo);
+				Phi[iSite] = Phi_Ntilde[iSite]->data();
+			}
+	//Single pass over G, evaluating each kernel once per G-vector for all pairs:
+	std::vector<PairKernel> pairsScaled(pairs);
+	for(PairKernel& pk: pairsScaled) pk.prefactor *= gInfo.nr;
+	std::mutex lock;
+	threadLaunch(computePairs_sub, gInfo.nG, gInfo.S, gInfo.GGT, pairsScaled.data(), nPairs, N.data(), Phi.data(), E.data(), &lock);
+	for(double& Ep: E) Ep *= gInfo.dV;
+	#endif
+	watch.stop();
+	return E;
+}
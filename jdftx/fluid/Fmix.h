@@ -24,6 +24,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 
 class FluidMixture;
+struct RadialFunctionG;
 
 //! @addtogroup ClassicalDFT
 //! @{
@@ -56,6 +57,22 @@ public:
 	//! is Fmix's responsibility to pick up the correct site densities
 	//! (perhaps using FluidMixture::get_offsetDensity())
 	virtual double computeUniform(const std::vector<double>& N, std::vector<double>& Phi_N) const=0;
+
+	//! Parameters of a pairwise mixing functional Phi = prefactor nr dV Sum_G conj(N[i1](G)) kernel(|G|) N[i2](G)
+	struct PairKernel
+	{	unsigned i1, i2; //!< site density indices
+		const RadialFunctionG* kernel; //!< radial interaction kernel
+		double prefactor; //!< scale factor of kernel
+	};
+
+	//! Functionals of the PairKernel form may return true and set pk, so that FluidMixture evaluates
+	//! all of them together in one reciprocal-space pass (see computePairs) instead of calling compute()
+	virtual bool getPairKernel(PairKernel& pk) const { return false; }
+
+	//! Evaluate all pairwise functionals in a single pass over reciprocal space, accumulating gradients
+	//! in Phi_Ntilde, and returning the energy of each pair (equivalent to calling compute() for each)
+	static std::vector<double> computePairs(const GridInfo& gInfo, const std::vector<PairKernel>& pairs,
+		const ScalarFieldTildeArray& Ntilde, ScalarFieldTildeArray& Phi_Ntilde);
 };
 
 //! @}
@@ -19,11 +19,21 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <fluid/IdealGasPomega.h>
 #include <fluid/Euler.h>
+#include <core/ScalarFieldArray.h>
 
 IdealGasPomega::IdealGasPomega(const FluidMixture* fluidMixture, const FluidComponent* comp, const SO3quad& quad, const TranslationOperator& trans, unsigned nIndepOverride)
 : IdealGas(nIndepOverride ? nIndepOverride : quad.nOrientations(), fluidMixture, comp), quad(quad), trans(trans), pMol(molecule.getDipole())
 {
 	TaskDivision(quad.nOrientations(), mpiWorld).myRange(oStart, oStop);
+	//Precompute rotated site positions for the local orientations:
+	const std::vector<matrix3<>>& rot = quad.rotations();
+	for(const auto& site: molecule.sites)
+		for(const vector3<>& pos: site->positions)
+		{	std::vector<vector3<>> offsets(oStop-oStart);
+			for(int o=oStart; o<oStop; o++)
+				offsets[o-oStart] = rot[o] * pos;
+			siteOffsets.push_back(offsets);
+		}
 }
 
 string IdealGasPomega::representationName() const
@@ -42,6 +52,28 @@ void IdealGasPomega::convertGradients_o(int o, const matrix3<>& rot, const Scala
 {	Phi_logPomega[o] += Phi_logPomega_o;
 }
 
+void IdealGasPomega::getDensities_oBatch(int oBatchStart, int oBatchStop, const std::vector<matrix3<>>& rot, const ScalarField* state, ScalarField* logPomega_o) const
+{	for(int o=oBatchStart; o<oBatchStop; o++)
+		getDensities_o(o, rot[o-oBatchStart], state, logPomega_o[o-oBatchStart]);
+}
+
+void IdealGasPomega::convertGradients_oBatch(int oBatchStart, int oBatchStop, const std::vector<matrix3<>>& rot, const ScalarField* Phi_logPomega_o, ScalarField* Phi_state) const
+{	for(int o=oBatchStart; o<oBatchStop; o++)
+		convertGradients_o(o, rot[o-oBatchStart], Phi_logPomega_o[o-oBatchStart], Phi_state);
+}
+
+std::vector<matrix3<>> IdealGasPomega::getRotations(int oBatchStart, int oBatchStop) const
+{	const std::vector<matrix3<>>& rot = quad.rotations();
+	return std::vector<matrix3<>>(rot.begin()+oBatchStart, rot.begin()+oBatchStop);
+}
+
+std::vector<vector3<>> IdealGasPomega::siteTranslations(int iSitePos, int oBatchStart, int oBatchStop, bool negate) const
+{	const std::vector<vector3<>>& offsets = siteOffsets[iSitePos];
+	std::vector<vector3<>> t(offsets.begin()+(oBatchStart-oStart), offsets.begin()+(oBatchStop-oStart));
+	if(negate) for(vector3<>& t_o: t) t_o = -t_o;
+	return t;
+}
+
 
 void IdealGasPomega::initState(const ScalarField* Vex, ScalarField* indep, double scale, double Elo, double Ehi) const
 {	for(int k=0; k<nIndep; k++) indep[k]=0;
@@ -51,21 +83,25 @@ void IdealGasPomega::initState(const ScalarField* Vex, ScalarField* indep, doubl
 		Veff[i] += Vex[i];
 	}
 	double Emin=+DBL_MAX, Emax=-DBL_MAX, Emean=0.0;
-	for(int o=oStart; o<oStop; o++)
-	{	matrix3<> rot = matrixFromEuler(quad.euler(o));
-		ScalarField Emolecule;
+	for(int oBatchStart=oStart; oBatchStart<oStop; oBatchStart+=nOrientationsBatch)
+	{	int oBatchStop = std::min(oBatchStart+nOrientationsBatch, oStop);
+		std::vector<matrix3<>> rot = getRotations(oBatchStart, oBatchStop);
+		ScalarFieldArray Emolecule(rot.size());
 		//Sum the potentials collected over sites for each orientation:
-		for(unsigned i=0; i<molecule.sites.size(); i++)
-			for(vector3<> pos: molecule.sites[i]->positions)
-				trans.taxpy(-(rot*pos), 1., Veff[i], Emolecule);
-		//Accumulate stats and cap:
-		Emean += quad.weight(o) * sum(Emolecule)/gInfo.nr;
-		double Emin_o, Emax_o;
-		callPref(eblas_capMinMax)(gInfo.nr, Emolecule->dataPref(), Emin_o, Emax_o, Elo, Ehi);
-		if(Emin_o<Emin) Emin=Emin_o;
-		if(Emax_o>Emax) Emax=Emax_o;
-		//Set contributions to the state (with appropriate scale factor):
-		initState_o(o, rot, scale, Emolecule, indep);
+		for(unsigned i=0, iSitePos=0; i<molecule.sites.size(); i++)
+			for(unsigned p=0; p<molecule.sites[i]->positions.size(); p++, iSitePos++)
+				trans.taxpyMulti(siteTranslations(iSitePos, oBatchStart, oBatchStop, true), 1., Veff[i], Emolecule.data());
+		for(int o=oBatchStart; o<oBatchStop; o++)
+		{	ScalarField& Emolecule_o = Emolecule[o-oBatchStart];
+			//Accumulate stats and cap:
+			Emean += quad.weight(o) * sum(Emolecule_o)/gInfo.nr;
+			double Emin_o, Emax_o;
+			callPref(eblas_capMinMax)(gInfo.nr, Emolecule_o->dataPref(), Emin_o, Emax_o, Elo, Ehi);
+			if(Emin_o<Emin) Emin=Emin_o;
+			if(Emax_o>Emax) Emax=Emax_o;
+			//Set contributions to the state (with appropriate scale factor):
+			initState_o(o, rot[o-oBatchStart], scale, Emolecule_o, indep);
+		}
 	}
 	//MPI collect:
 	for(int k=0; k<nIndep; k++)
@@ -85,19 +121,24 @@ void IdealGasPomega::getDensities(const ScalarField* indep, ScalarField* N, vect
 	double& S = ((IdealGasPomega*)this)->S;
 	S=0.0;
 	VectorField P;
-	//Loop over orientations:
-	for(int o=oStart; o<oStop; o++)
-	{	matrix3<> rot = matrixFromEuler(quad.euler(o));
-		ScalarField logPomega_o; getDensities_o(o, rot, indep,logPomega_o);
-		ScalarField N_o = (quad.weight(o) * Nbulk) * exp(logPomega_o); //contribution form this orientation
+	//Loop over batches of orientations:
+	for(int oBatchStart=oStart; oBatchStart<oStop; oBatchStart+=nOrientationsBatch)
+	{	int oBatchStop = std::min(oBatchStart+nOrientationsBatch, oStop);
+		std::vector<matrix3<>> rot = getRotations(oBatchStart, oBatchStop);
+		ScalarFieldArray logPomega_o(rot.size()); getDensities_oBatch(oBatchStart, oBatchStop, rot, indep, logPomega_o.data());
+		ScalarFieldArray N_o(rot.size());
+		for(int o=oBatchStart; o<oBatchStop; o++)
+		{	int b = o-oBatchStart;
+			N_o[b] = (quad.weight(o) * Nbulk) * exp(logPomega_o[b]); //contribution form this orientation
+			//Accumulate contributions to the entropy:
+			S += gInfo.dV*dot(N_o[b], logPomega_o[b]);
+			//Accumulate the polarization density:
+			if(pMol.length_squared()) P += (rot[b] * pMol) * N_o[b];
+		}
 		//Accumulate N_o to each site density with appropriate translations:
-		for(unsigned i=0; i<molecule.sites.size(); i++)
-			for(vector3<> pos: molecule.sites[i]->positions)
-				trans.taxpy(rot*pos, 1., N_o, N[i]);
-		//Accumulate contributions to the entropy:
-		S += gInfo.dV*dot(N_o, logPomega_o);
-		//Accumulate the polarization density:
-		if(pMol.length_squared()) P += (rot * pMol) * N_o;
+		for(unsigned i=0, iSitePos=0; i<molecule.sites.size(); i++)
+			for(unsigned p=0; p<molecule.sites[i]->positions.size(); p++, iSitePos++)
+				trans.taxpySum(siteTranslations(iSitePos, oBatchStart, oBatchStop, false), 1., N_o.data(), N[i]);
 	}
 	//MPI collect:
 	for(unsigned i=0; i<molecule.sites.size(); i++) { nullToZero(N[i],gInfo); N[i]->allReduceData(mpiWorld, MPIUtil::ReduceSum); }
@@ -137,22 +178,30 @@ double IdealGasPomega::compute(const ScalarField* indep, const ScalarField* N, S
 
 void IdealGasPomega::convertGradients(const ScalarField* indep, const ScalarField* N, const ScalarField* Phi_N, const vector3<>& Phi_P0, ScalarField* Phi_indep, const double Nscale) const
 {	for(int k=0; k<nIndep; k++) Phi_indep[k]=0;
-	//Loop over orientations:
-	for(int o=oStart; o<oStop; o++)
-	{	matrix3<> rot = matrixFromEuler(quad.euler(o));
-		ScalarField logPomega_o; getDensities_o(o, rot, indep, logPomega_o);
-		ScalarField N_o = (quad.weight(o) * Nbulk * Nscale) * exp(logPomega_o);
-		ScalarField Phi_N_o; //gradient w.r.t N_o (as calculated in getDensities)
+	//Loop over batches of orientations:
+	for(int oBatchStart=oStart; oBatchStart<oStop; oBatchStart+=nOrientationsBatch)
+	{	int oBatchStop = std::min(oBatchStart+nOrientationsBatch, oStop);
+		std::vector<matrix3<>> rot = getRotations(oBatchStart, oBatchStop);
+		ScalarFieldArray logPomega_o(rot.size()); getDensities_oBatch(oBatchStart, oBatchStop, rot, indep, logPomega_o.data());
+		ScalarFieldArray Phi_N_o(rot.size()); //gradient w.r.t N_o (as calculated in getDensities)
 		//Collect the contributions from each Phi_N in Phi_N_o
-		for(unsigned i=0; i<molecule.sites.size(); i++)
-			for(vector3<> pos: molecule.sites[i]->positions)
-				trans.taxpy(-rot*pos, 1., Phi_N[i], Phi_N_o);
-		//Collect the contributions from the entropy:
-		Phi_N_o += T*logPomega_o;
-		//Collect the contribution from Phi_P0 and Ecorr_P:
-		if(pMol.length_squared()) Phi_N_o += dot(rot * pMol, Nscale*Ecorr_P) + dot(rot * pMol, Phi_P0);
-		//Propagate Phi_N_o to Phi_logPomega_o and then to Phi_indep:
-		convertGradients_o(o, rot, N_o*Phi_N_o, Phi_indep);
+		for(unsigned i=0, iSitePos=0; i<molecule.sites.size(); i++)
+			for(unsigned p=0; p<molecule.sites[i]->positions.size(); p++, iSitePos++)
+				trans.taxpyMulti(siteTranslations(iSitePos, oBatchStart, oBatchStop, true), 1., Phi_N[i], Phi_N_o.data());
+		ScalarFieldArray Phi_logPomega_o(rot.size());
+		for(int o=oBatchStart; o<oBatchStop; o++)
+		{	int b = o-oBatchStart;
+			ScalarField N_o = (quad.weight(o) * Nbulk * Nscale) * exp(logPomega_o[b]);
+			//Collect the contributions from the entropy:
+			Phi_N_o[b] += T*logPomega_o[b];
+			//Collect the contribution from Phi_P0 and Ecorr_P:
+			if(pMol.length_squared()) Phi_N_o[b] += dot(rot[b] * pMol, Nscale*Ecorr_P) + dot(rot[b] * pMol, Phi_P0);
+			//Propagate Phi_N_o to Phi_logPomega_o:
+			Phi_logPomega_o[b] = N_o*Phi_N_o[b];
+			Phi_N_o[b] = 0; logPomega_o[b] = 0; //no longer needed
+		}
+		//Propagate Phi_logPomega_o to Phi_indep:
+		convertGradients_oBatch(oBatchStart, oBatchStop, rot, Phi_logPomega_o.data(), Phi_indep);
 	}
 	for(int k=0; k<nIndep; k++) { nullToZero(Phi_indep[k],gInfo); Phi_indep[k]->allReduceData(mpiWorld, MPIUtil::ReduceSum); }
 }
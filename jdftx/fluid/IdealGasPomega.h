@@ -55,7 +55,19 @@ protected:
 	virtual void getDensities_o(int o, const matrix3<>& rot, const ScalarField* state, ScalarField& logPomega_o) const;
 	virtual void convertGradients_o(int o, const matrix3<>& rot, const ScalarField& Phi_logPomega_o, ScalarField* Phi_state) const;
 	
+	//These functions are called once for each batch of orientations [oBatchStart,oBatchStop),
+	//with rot, logPomega_o and Phi_logPomega_o indexed relative to oBatchStart.
+	//The defaults loop over the single-orientation versions above; representations that translate
+	//site fields override these to process all orientations of the batch in each grid sweep.
+	virtual void getDensities_oBatch(int oBatchStart, int oBatchStop, const std::vector<matrix3<>>& rot, const ScalarField* state, ScalarField* logPomega_o) const;
+	virtual void convertGradients_oBatch(int oBatchStart, int oBatchStop, const std::vector<matrix3<>>& rot, const ScalarField* Phi_logPomega_o, ScalarField* Phi_state) const;
+	
+	static const int nOrientationsBatch = 16; //!< maximum number of orientations processed together (limits the memory of per-orientation temporaries)
+	std::vector<matrix3<>> getRotations(int oBatchStart, int oBatchStop) const; //!< rotation matrices of a batch of orientations
+	std::vector<vector3<>> siteTranslations(int iSitePos, int oBatchStart, int oBatchStop, bool negate) const; //!< translation rot*pos (or -rot*pos if negate) of the iSitePos'th site position for each orientation of a batch
+	
 private:
+	std::vector<std::vector<vector3<>>> siteOffsets; //!< rotated site positions rot*pos for each site position (sites, then their positions) and local orientation (relative to oStart)
 	double S; //!< cache the entropy, because it is most efficiently computed during getDensities()
 	double Ecorr; VectorField Ecorr_P; //!< cache the correlation correction and its derivatives, since they are most efficiently computed during getDensities()
 };
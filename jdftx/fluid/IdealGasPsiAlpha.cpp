@@ -57,3 +57,15 @@ void IdealGasPsiAlpha::convertGradients_o(int o, const matrix3<>& rot, const Sca
 		for(vector3<> pos: molecule.sites[i]->positions)
 			trans.taxpy(rot*pos, 1., Phi_logPomega_o, Phi_psi[i]);
 }
+
+void IdealGasPsiAlpha::getDensities_oBatch(int oBatchStart, int oBatchStop, const std::vector<matrix3<>>& rot, const ScalarField* psi, ScalarField* logPomega_o) const
+{	for(unsigned i=0, iSitePos=0; i<molecule.sites.size(); i++)
+		for(unsigned p=0; p<molecule.sites[i]->positions.size(); p++, iSitePos++)
+			trans.taxpyMulti(siteTranslations(iSitePos, oBatchStart, oBatchStop, true), 1., psi[i], logPomega_o);
+}
+
+void IdealGasPsiAlpha::convertGradients_oBatch(int oBatchStart, int oBatchStop, const std::vector<matrix3<>>& rot, const ScalarField* Phi_logPomega_o, ScalarField* Phi_psi) const
+{	for(unsigned i=0, iSitePos=0; i<molecule.sites.size(); i++)
+		for(unsigned p=0; p<molecule.sites[i]->positions.size(); p++, iSitePos++)
+			trans.taxpySum(siteTranslations(iSitePos, oBatchStart, oBatchStop, false), 1., Phi_logPomega_o, Phi_psi[i]);
+}
@@ -23,6 +23,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <core/VectorField.h>
 #include <core/ScalarFieldIO.h>
 #include <core/Thread.h>
+#include <algorithm>
 
 LinearPCM::LinearPCM(const Everything& e, const FluidSolverParams& fsp)
 : PCM(e, fsp)
@@ -34,20 +35,25 @@ LinearPCM::~LinearPCM()
 {	Kkernel.free();
 }
 
-ScalarFieldTilde LinearPCM::hessian(const ScalarFieldTilde& phiTilde) const
+//Variable-coefficient Poisson operator of the linear PCM (kappaSq may be null)
+inline ScalarFieldTilde pcmHessian(const ScalarFieldTilde& phiTilde, const ScalarField& epsilon, const ScalarField& kappaSq)
 {	//Dielectric term:
-	ScalarField epsilon = epsilonOverride ? epsilonOverride : 1. + (epsBulk-1.) * shape[0];
 	ScalarFieldTilde rhoTilde = divergence(J(epsilon * I(gradient(phiTilde))));
 	//Screening term:
-	if(k2factor)
-	{	ScalarField kappaSq = kappaSqOverride ? kappaSqOverride : k2factor * shape.back();
-		rhoTilde -= J(kappaSq * I(phiTilde));
-	}
+	if(kappaSq) rhoTilde -= J(kappaSq * I(phiTilde));
 	return (-1./(4*M_PI)) * rhoTilde;
 }
 
+ScalarFieldTilde LinearPCM::hessian(const ScalarFieldTilde& phiTilde) const
+{	ScalarField epsilon = epsilonOverride ? epsilonOverride : 1. + (epsBulk-1.) * shape[0];
+	ScalarField kappaSq;
+	if(k2factor) kappaSq = kappaSqOverride ? kappaSqOverride : k2factor * shape.back();
+	return pcmHessian(phiTilde, epsilon, kappaSq);
+}
+
 ScalarFieldTilde LinearPCM::precondition(const ScalarFieldTilde& rTilde) const
-{	return Kkernel*(J(epsInv*I(Kkernel*rTilde)));
+{	if(mgLevels.size()) return vcycle(0, rTilde);
+	return Kkernel*(J(epsInv*I(Kkernel*rTilde)));
 }
 
 //Initialize Kkernel to square-root of the inverse kinetic operator
@@ -77,6 +83,98 @@ void LinearPCM::updatePreconditioner(const ScalarField& epsilon, const ScalarFie
 	double epsMean = sum(epsilon) / gInfo.nr;
 	double kappaSqMean = (kappaSq ? sum(kappaSq) : 0.) / gInfo.nr;
 	Kkernel.init(0, 0.02, gInfo.GmaxGrid, setPreconditionerKernel, epsMean, sqrt(kappaSqMean/epsMean));
+	if(fsp.pcmMultigridLevels) updateMultigrid(epsilon, kappaSq);
+}
+
+//------------- Multigrid preconditioner -------------
+
+ScalarFieldTilde LinearPCM::MultigridLevel::hessian(const ScalarFieldTilde& phiTilde) const
+{	return pcmHessian(phiTilde, epsilon, kappaSq);
+}
+
+ScalarFieldTilde LinearPCM::MultigridLevel::smooth(const ScalarFieldTilde& rTilde) const
+{	return omega * (Kkernel*(J(epsInv*I(Kkernel*rTilde))));
+}
+
+//Clip undershoots of Fourier resampling below xMin (in place)
+static void clampMin(ScalarField& x, double xMin)
+{	double* xData = x->data();
+	for(int i=0; i<x->gInfo.nr; i++)
+		xData[i] = std::max(xData[i], xMin);
+}
+
+void LinearPCM::updateMultigrid(const ScalarField& epsilon, const ScalarField& kappaSq)
+{	static StopWatch watch("LinearPCM::updateMultigrid"); watch.start();
+	//Create grids on first use (retained to reuse their FFT plans), halving each even dimension down to 8:
+	if(!mgLevels.size())
+	{	mgLevels.push_back(std::make_shared<MultigridLevel>());
+		mgLevels[0]->gInfo = &gInfo;
+		for(int iLevel=1; iLevel<=fsp.pcmMultigridLevels; iLevel++)
+		{	const vector3<int>& Sfine = mgLevels.back()->gInfo->S;
+			vector3<int> Scoarse = Sfine;
+			for(int k=0; k<3; k++)
+				if(Sfine[k]%2==0 && Sfine[k]>=16)
+					Scoarse[k] = Sfine[k]/2;
+			if(Scoarse == Sfine) break; //cannot coarsen further
+			auto level = std::make_shared<MultigridLevel>();
+			level->gInfoCoarse = std::make_shared<GridInfo>();
+			level->gInfoCoarse->R = gInfo.R;
+			level->gInfoCoarse->S = Scoarse;
+			logSuspend(); level->gInfoCoarse->initialize(true); logResume();
+			level->gInfo = level->gInfoCoarse.get();
+			mgLevels.push_back(level);
+		}
+		logPrintf("Initialized PCM multigrid preconditioner with coarse grids:");
+		for(size_t iLevel=1; iLevel<mgLevels.size(); iLevel++)
+		{	const vector3<int>& S = mgLevels[iLevel]->gInfo->S;
+			logPrintf(" %dx%dx%d", S[0], S[1], S[2]);
+		}
+		logPrintf("%s\n", mgLevels.size()>1 ? "" : " none (grid too small)");
+	}
+	//Restrict coefficients to each level and set up its smoother:
+	for(size_t iLevel=0; iLevel<mgLevels.size(); iLevel++)
+	{	MultigridLevel& level = *mgLevels[iLevel];
+		if(iLevel==0)
+		{	level.epsilon = epsilon;
+			level.kappaSq = kappaSq;
+		}
+		else
+		{	const MultigridLevel& levelFine = *mgLevels[iLevel-1];
+			level.epsilon = changeGrid(levelFine.epsilon, *level.gInfo); clampMin(level.epsilon, 1.);
+			level.kappaSq = 0;
+			if(levelFine.kappaSq) { level.kappaSq = changeGrid(levelFine.kappaSq, *level.gInfo); clampMin(level.kappaSq, 0.); }
+		}
+		level.epsInv = inv(level.epsilon);
+		double epsMean = sum(level.epsilon) / level.gInfo->nr;
+		double kappaSqMean = (level.kappaSq ? sum(level.kappaSq) : 0.) / level.gInfo->nr;
+		level.Kkernel.free();
+		level.Kkernel.init(0, 0.02, level.gInfo->GmaxGrid, setPreconditionerKernel, epsMean, sqrt(kappaSqMean/epsMean));
+		//Damp smoother by the largest eigenvalue of its product with the hessian (power iteration, warm-started after first use):
+		int nPowerIter = 3;
+		if(!level.eigVec) { level.eigVec = J(level.epsilon); nPowerIter = 10; }
+		level.omega = 1.;
+		double lambdaMax = 0.;
+		for(int iter=0; iter<nPowerIter; iter++)
+		{	ScalarFieldTilde y = level.smooth(level.hessian(level.eigVec));
+			double yNorm = sqrt(dot(y,y));
+			lambdaMax = yNorm / sqrt(dot(level.eigVec,level.eigVec));
+			level.eigVec = (1./yNorm) * y;
+		}
+		level.omega = 1./(1.1*lambdaMax); //margin for underestimate of eigenvalue
+	}
+	watch.stop();
+}
+
+ScalarFieldTilde LinearPCM::vcycle(int iLevel, const ScalarFieldTilde& rTilde) const
+{	//Symmetric V-cycle (same smoother before and after coarse-grid correction, and restriction = prolongation^T), as required by CG
+	const MultigridLevel& level = *mgLevels[iLevel];
+	ScalarFieldTilde x = level.smooth(rTilde); //pre-smoothing
+	if(iLevel+1 < int(mgLevels.size()))
+	{	const GridInfo& gInfoCoarse = *(mgLevels[iLevel+1]->gInfo);
+		x += changeGrid(vcycle(iLevel+1, changeGrid(rTilde - level.hessian(x), gInfoCoarse)), *level.gInfo); //coarse-grid correction
+	}
+	x += level.smooth(rTilde - level.hessian(x)); //post-smoothing
+	return x;
 }
 
 void LinearPCM::override(const ScalarField& epsilon, const ScalarField& kappaSq)
@@ -155,6 +253,14 @@ void LinearPCM::saveState(const char* filename) const
 {	if(mpiWorld->isHead()) saveRawBinary(I(state), filename); //saved data is in real space
 }
 
+void LinearPCM::getStateFields(ScalarFieldArray& fields) const
+{	if(state) fields.assign(1, I(state));
+}
+
+void LinearPCM::setStateFields(const ScalarFieldArray& fields)
+{	state = J(fields[0]);
+}
+
 void LinearPCM::dumpDensities(const char* filenamePattern) const
 {	PCM::dumpDensities(filenamePattern);
 	//Output dielectric bound charge
@@ -46,10 +46,29 @@ protected:
 	void set_internal(const ScalarFieldTilde& rhoExplicitTilde, const ScalarFieldTilde& nCavityTilde);
 	double get_Adiel_and_grad_internal(ScalarFieldTilde& grad_rhoExplicitTilde, ScalarFieldTilde& grad_nCavityTilde, IonicGradient* extraForces) const;
 	void getSusceptibility_internal(const std::vector<complex>& omega, std::vector<SusceptibilityTerm>& susceptibility, ScalarFieldArray& sArr) const;
+	void getStateFields(ScalarFieldArray& fields) const;
+	void setStateFields(const ScalarFieldArray& fields);
 private:
 	RadialFunctionG Kkernel; ScalarField epsInv; // for preconditioner
 	void updatePreconditioner(const ScalarField& epsilon, const ScalarField& kappaSq);
 	
+	//Optional geometric multigrid preconditioner (see pcm-multigrid):
+	struct MultigridLevel
+	{	std::shared_ptr<GridInfo> gInfoCoarse; //grid of this level (null for the finest level, which uses the PCM grid)
+		const GridInfo* gInfo; //grid of this level
+		ScalarField epsilon, kappaSq, epsInv; //operator coefficients restricted to this grid (kappaSq null if no screening)
+		RadialFunctionG Kkernel; //kernel of the smoother (inverse-kinetic preconditioner on this grid)
+		double omega; //smoother damping, set from the estimated largest eigenvalue of the smoothed operator
+		ScalarFieldTilde eigVec; //estimate of the corresponding eigenvector (warm start for subsequent updates)
+		MultigridLevel() : gInfo(0), omega(0.) {}
+		~MultigridLevel() { Kkernel.free(); }
+		ScalarFieldTilde hessian(const ScalarFieldTilde& phiTilde) const; //!< PCM hessian on this grid
+		ScalarFieldTilde smooth(const ScalarFieldTilde& rTilde) const; //!< damped kinetic preconditioner on this grid
+	};
+	std::vector<std::shared_ptr<MultigridLevel>> mgLevels; //finest level first
+	void updateMultigrid(const ScalarField& epsilon, const ScalarField& kappaSq);
+	ScalarFieldTilde vcycle(int iLevel, const ScalarFieldTilde& rTilde) const; //!< multigrid V-cycle starting at level iLevel
+	
 	//Optionally override epsilon and kappaSq (when used as the inner solver in NonlinearPCM's SCF):
 	friend class NonlinearPCM;
 	ScalarField epsilonOverride, kappaSqOverride;
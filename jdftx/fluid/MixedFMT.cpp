@@ -20,6 +20,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <fluid/MixedFMT.h>
 #include <fluid/MixedFMT_internal.h>
 #include <core/VectorField.h>
+#include <core/ScalarFieldArray.h>
 
 //Compute the tensor weighted density (threaded/gpu):
 inline void tensorKernel_sub(size_t iStart, size_t iStop, vector3<int> S, const matrix3<> G,
@@ -71,18 +72,30 @@ void phiFMT_gpu(int N, double* phiArr,
 #endif
 
 
-double PhiFMT(const ScalarField& n0, const ScalarField& n1, const ScalarField& n2,
+double PhiFMT(const ScalarFieldTilde& n0tilde, const ScalarFieldTilde& n1tilde, const ScalarFieldTilde& n2tilde,
 	const ScalarFieldTilde& n3tilde, const ScalarFieldTilde& n1vTilde, const ScalarFieldTilde& n2mTilde,
-	ScalarField& grad_n0, ScalarField& grad_n1, ScalarField& grad_n2,
-	ScalarFieldTilde& grad_n3tilde, ScalarFieldTilde& grad_n1vTilde, ScalarFieldTilde& grad_n2mTilde)
+	ScalarFieldTilde& grad_n0tilde, ScalarFieldTilde& grad_n1tilde, ScalarFieldTilde& grad_n2tilde,
+	ScalarFieldTilde& grad_n3tilde, ScalarFieldTilde& grad_n1vTilde, ScalarFieldTilde& grad_n2mTilde,
+	const PhiFMTextra& extra)
 {
-	const GridInfo& gInfo = n0->gInfo;
-	ScalarField n3 = I(n3tilde);
-	VectorField n1v = I(gradient(n1vTilde));
-	VectorField n2v = I(gradient(-n3tilde));
-	TensorField n2m = I(tensorKernel(n2mTilde));
-
-	ScalarField grad_n3; VectorField grad_n1v, grad_n2v; TensorField grad_n2m;
+	const GridInfo& gInfo = n0tilde->gInfo;
+	//Transform all weighted densities to real space together (layout: n0, n1, n2, n3, n1v[3], n2v[3], n2m[5]):
+	ScalarFieldArray n;
+	{	VectorFieldTilde n1vTildeGrad = gradient(n1vTilde);
+		VectorFieldTilde n2vTilde = gradient(-n3tilde);
+		TensorFieldTilde n2mTildeTensor = tensorKernel(n2mTilde);
+		ScalarFieldTildeArray nTilde = { clone(n0tilde), clone(n1tilde), clone(n2tilde), clone(n3tilde) };
+		nTilde.insert(nTilde.end(), n1vTildeGrad.component.begin(), n1vTildeGrad.component.end());
+		nTilde.insert(nTilde.end(), n2vTilde.component.begin(), n2vTilde.component.end());
+		nTilde.insert(nTilde.end(), n2mTildeTensor.component.begin(), n2mTildeTensor.component.end());
+		n1vTildeGrad = 0; n2vTilde = 0; n2mTildeTensor = 0; //drop references, so that the transforms below can destroy their inputs
+		n = I(std::move(nTilde));
+	}
+	const ScalarField &n0 = n[0], &n1 = n[1], &n2 = n[2], &n3 = n[3];
+	VectorField n1v(&n[4]), n2v(&n[7]);
+	TensorField n2m(&n[10]);
+	
+	ScalarField grad_n0, grad_n1, grad_n2, grad_n3; VectorField grad_n1v, grad_n2v; TensorField grad_n2m;
 	nullToZero(grad_n0, gInfo); nullToZero(grad_n1, gInfo); nullToZero(grad_n2, gInfo); nullToZero(grad_n3, gInfo);
 	nullToZero(grad_n1v, gInfo); nullToZero(grad_n2v, gInfo); nullToZero(grad_n2m, gInfo);
 
@@ -101,11 +114,22 @@ double PhiFMT(const ScalarField& n0, const ScalarField& n1, const ScalarField& n
 			grad_n0->data(), grad_n1->data(), grad_n2->data(), grad_n3->data(),
 			grad_n1v.data(), grad_n2v.data(), grad_n2m.data());
 	#endif
-	n3=0; n1v=0; n2v=0; n2m=0; //no longer need these weighted densities (clean up)
-
-	grad_n2mTilde += tensorKernel_grad(Idag(grad_n2m)); grad_n2m=0;
-	grad_n1vTilde -= divergence(Idag(grad_n1v)); grad_n1v=0;
-	grad_n3tilde += ( Idag(grad_n3) + divergence(Idag(grad_n2v)) ); grad_n3=0; grad_n2v=0;
+	if(extra) extra(n2, n3, n2v, grad_n2, grad_n3, grad_n2v);
+	n.clear(); n1v=0; n2v=0; n2m=0; //no longer need these weighted densities (clean up)
+
+	//Transform all gradients to reciprocal space together (same layout as above):
+	ScalarFieldArray grad_n = { grad_n0, grad_n1, grad_n2, grad_n3 };
+	grad_n.insert(grad_n.end(), grad_n1v.component.begin(), grad_n1v.component.end());
+	grad_n.insert(grad_n.end(), grad_n2v.component.begin(), grad_n2v.component.end());
+	grad_n.insert(grad_n.end(), grad_n2m.component.begin(), grad_n2m.component.end());
+	grad_n0=0; grad_n1=0; grad_n2=0; grad_n3=0; grad_n1v=0; grad_n2v=0; grad_n2m=0;
+	ScalarFieldTildeArray grad_nTilde = Idag(grad_n); grad_n.clear();
+	grad_n0tilde += grad_nTilde[0];
+	grad_n1tilde += grad_nTilde[1];
+	grad_n2tilde += grad_nTilde[2];
+	grad_n3tilde += ( grad_nTilde[3] + divergence(VectorFieldTilde(&grad_nTilde[7])) );
+	grad_n1vTilde -= divergence(VectorFieldTilde(&grad_nTilde[4]));
+	grad_n2mTilde += tensorKernel_grad(TensorFieldTilde(&grad_nTilde[10]));
 	return result;
 }
 
@@ -135,6 +159,19 @@ double PhiBond(double Rhm, double scale, const ScalarField& n0mol, const ScalarF
 	VectorField n2v = I(gradient(-n3tilde));
 	//Bonding correction and gradient:
 	ScalarField grad_n3; VectorField grad_n2v;
+	nullToZero(grad_n3, gInfo);
+	nullToZero(grad_n2v, gInfo);
+	double result = PhiBond(Rhm, scale, n0mol, n2, n3, n2v, grad_n0mol, grad_n2, grad_n3, grad_n2v);
+	n3=0; n2v=0; //no longer need these weighted densities (clean up)
+	//Propagate grad_n2v and grad_n3 to grad_n3tilde:
+	grad_n3tilde += ( Idag(grad_n3) + divergence(Idag(grad_n2v)) );
+	return result;
+}
+
+double PhiBond(double Rhm, double scale, const ScalarField& n0mol, const ScalarField& n2, const ScalarField& n3, const VectorField& n2v,
+	ScalarField& grad_n0mol, ScalarField& grad_n2, ScalarField& grad_n3, VectorField& grad_n2v)
+{
+	const GridInfo& gInfo = n0mol->gInfo;
 	nullToZero(grad_n0mol, gInfo);
 	nullToZero(grad_n2, gInfo);
 	nullToZero(grad_n3, gInfo);
@@ -150,9 +187,6 @@ double PhiBond(double Rhm, double scale, const ScalarField& n0mol, const ScalarF
 			n0mol->data(), n2->data(), n3->data(), n2v.const_data(),
 			grad_n0mol->data(), grad_n2->data(), grad_n3->data(), grad_n2v.data());
 	#endif
-	n3=0; n2v=0; //no longer need these weighted densities (clean up)
-	//Propagate grad_n2v and grad_n3 to grad_n3tilde:
-	grad_n3tilde += ( Idag(grad_n3) + divergence(Idag(grad_n2v)) );
 	return result;
 }
 
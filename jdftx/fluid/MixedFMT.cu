@@ -29,7 +29,7 @@ void tensorKernel_kernel(int zBlock, const vector3<int> S, const matrix3<> G, co
 void tensorKernel_gpu(const vector3<int> S, const matrix3<> G, const complex* nTilde, tensor3<complex*> mTilde)
 {	GpuLaunchConfigHalf3D glc(tensorKernel_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		tensorKernel_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, nTilde, mTilde);
+		tensorKernel_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, nTilde, mTilde);
 	gpuErrorCheck();
 }
 
@@ -41,7 +41,7 @@ void tensorKernel_grad_kernel(int zBlock, const vector3<int> S, const matrix3<>
 void tensorKernel_grad_gpu(const vector3<int> S, const matrix3<> G, tensor3<const complex*> grad_mTilde, complex* grad_nTilde)
 {	GpuLaunchConfigHalf3D glc(tensorKernel_grad_kernel, S);
 	for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-		tensorKernel_grad_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, G, grad_mTilde, grad_nTilde);
+		tensorKernel_grad_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, G, grad_mTilde, grad_nTilde);
 	gpuErrorCheck();
 }
 
@@ -62,7 +62,7 @@ void phiFMT_gpu(int N, double* phiArr,
 	double *grad_n0arr, double *grad_n1arr, double *grad_n2arr, double *grad_n3arr,
 	vector3<double*> grad_n1vArr, vector3<double*> grad_n2vArr, tensor3<double*> grad_n2mArr)
 {	GpuLaunchConfig1D glc(phiFMT_kernel, N);
-	phiFMT_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, phiArr, n0arr, n1arr, n2arr, n3arr, n1vArr, n2vArr, n2mArr,
+	phiFMT_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, phiArr, n0arr, n1arr, n2arr, n3arr, n1vArr, n2vArr, n2mArr,
 			grad_n0arr, grad_n1arr, grad_n2arr, grad_n3arr, grad_n1vArr, grad_n2vArr, grad_n2mArr);
 }
 
@@ -79,6 +79,6 @@ void phiBond_gpu(int N, double Rhm, double scale, double* phiArr,
 	const double *n0arr, const double *n2arr, const double *n3arr, vector3<const double*> n2vArr,
 	double *grad_n0arr, double *grad_n2arr, double *grad_n3arr, vector3<double*> grad_n2vArr)
 {	GpuLaunchConfig1D glc(phiBond_kernel, N);
-	phiBond_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, Rhm, scale, phiArr,
+	phiBond_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, Rhm, scale, phiArr,
 		n0arr, n2arr, n3arr, n2vArr, grad_n0arr, grad_n2arr, grad_n3arr, grad_n2vArr);
 }
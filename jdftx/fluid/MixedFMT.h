@@ -21,22 +21,31 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #define JDFTX_FLUID_MIXEDFMT_H
 
 #include <core/Operators.h>
+#include <core/VectorField.h>
+#include <functional>
 
 //! @addtogroup ClassicalDFT
 //! @{
 
 //!@file MixedFMT.h Sphere mixture functional via (optionally soft) Fundamental Measure Theory
 
+//! Additional terms evaluated by PhiFMT() in real space on the weighted densities n2, n3 and n2v,
+//! which must accumulate their gradients in grad_n2, grad_n3 and grad_n2v (eg. bonding corrections using PhiBond)
+typedef std::function<void(const ScalarField& n2, const ScalarField& n3, const VectorField& n2v,
+	ScalarField& grad_n2, ScalarField& grad_n3, VectorField& grad_n2v)> PhiFMTextra;
+
 //! Returns the `White-Bear mark II' mixed sphere free energy/T given the weighted densities n*
 //! and accumulates the gradients in grad_n*. Note that n1v and n2m are scalar
 //! weighted densities, from which the vector and tensor weighted densities are obtained
 //! internally by a gradient and traceless tensor second derivative respectively.
-//! n2v is obtained as the negative gradient of n3. This is why n3, n1v and n2m
-//! are passed in reciprocal space: they need fourier space processing for gradients etc.
-double PhiFMT(const ScalarField& n0, const ScalarField& n1, const ScalarField& n2,
+//! n2v is obtained as the negative gradient of n3. All weighted densities are transformed
+//! to real space in a single multi-field pass (15 fields, threaded over fields), and all gradients
+//! back in another, with optional extra terms (see PhiFMTextra) evaluated in between.
+double PhiFMT(const ScalarFieldTilde& n0tilde, const ScalarFieldTilde& n1tilde, const ScalarFieldTilde& n2tilde,
 	const ScalarFieldTilde& n3tilde, const ScalarFieldTilde& n1vTilde, const ScalarFieldTilde& n2mTilde,
-	ScalarField& grad_n0, ScalarField& grad_n1, ScalarField& grad_n2,
-	ScalarFieldTilde& grad_n3tilde, ScalarFieldTilde& grad_n1vTilde, ScalarFieldTilde& grad_n2mTilde);
+	ScalarFieldTilde& grad_n0tilde, ScalarFieldTilde& grad_n1tilde, ScalarFieldTilde& grad_n2tilde,
+	ScalarFieldTilde& grad_n3tilde, ScalarFieldTilde& grad_n1vTilde, ScalarFieldTilde& grad_n2mTilde,
+	const PhiFMTextra& extra=PhiFMTextra());
 
 //! Returns the free energy density/T and accumulates derivatives
 //! corresponding to PhiFMT() for the uniform fluid
@@ -54,6 +63,11 @@ double phiFMTuniform(double n0, double n1, double n2, double n3,
 double PhiBond(double Rhm, double scale, const ScalarField& n0mol, const ScalarField& n2, const ScalarFieldTilde& n3tilde,
 	ScalarField& grad_n0mol, ScalarField& grad_n2, ScalarFieldTilde& grad_n3tilde);
 
+//! Version of PhiBond() with n3 and n2v precomputed in real space (for use within PhiFMTextra),
+//! accumulating gradients in grad_n3 and grad_n2v in real space
+double PhiBond(double Rhm, double scale, const ScalarField& n0mol, const ScalarField& n2, const ScalarField& n3, const VectorField& n2v,
+	ScalarField& grad_n0mol, ScalarField& grad_n2, ScalarField& grad_n3, VectorField& grad_n2v);
+
 //! Returns the free energy density/T and accumulates derivatives
 //! corresponding to PhiBond() for the uniform fluid
 double phiBondUniform(double Rhm, double scale, double n0mol, double n2, double n3,
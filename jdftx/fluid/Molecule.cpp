@@ -21,6 +21,11 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <fluid/Molecule.h>
 #include <core/Operators.h>
 #include <electronic/ColumnBundle.h>
+#include <core/Util.h>
+#include <functional>
+#include <mutex>
+#include <cstdio>
+#include <unistd.h>
 
 Molecule::Site::Site(string name, int atomicNumber) : name(name), Rhs(0), atomicNumber(atomicNumber), Znuc(0), sigmaNuc(0), Zelec(0), aElec(0), Zsite(0), deltaS(0), sigmaElec(0), rcElec(0), alpha(0), aPol(0), initialized(false)
 {	
@@ -73,12 +78,143 @@ RadialFunctionR getLogGridKernel()
 	return KernelR;
 }
 
+//---- Registry of site kernels (see Molecule::Site::kernelCacheDir) ----
+string Molecule::Site::kernelCacheDir;
+
+//Kernels and derived scalars of a site, as produced by Molecule::Site::setup
+struct SiteKernels
+{	double deltaSchange, Znuc;
+	std::vector<std::vector<double>> coeff; //coefficients of each kernel (empty for null kernels)
+	std::vector<double> dGinv;
+};
+static std::map<string,SiteKernels> siteKernelRegistry;
+static std::mutex siteKernelRegistryLock;
+
+//Append the contents of a file (if any) to the key, so that edited radial model files are not confused:
+static void appendFileContents(ostringstream& oss, const string& fname)
+{	if(!fname.length()) return;
+	oss << " file:" << fname << ':';
+	FILE* fp = fopen(fname.c_str(), "r");
+	if(!fp) return; //error reported by setup
+	char buf[4096]; size_t n;
+	string contents;
+	while((n = fread(buf, 1, sizeof(buf), fp))) contents.append(buf, n);
+	fclose(fp);
+	oss << std::hex << std::hash<std::string>()(std::string(contents.c_str(), contents.size())) << std::dec;
+}
+
+string Molecule::Site::kernelCacheKey(double dG, int nGridLoc) const
+{	ostringstream oss;
+	oss.precision(17);
+	oss << "dG=" << dG << " nG=" << nGridLoc << " Rhs=" << Rhs << " Znuc=" << Znuc << " sigmaNuc=" << sigmaNuc
+		<< " Zelec=" << Zelec << " aElec=" << aElec << " Zsite=" << Zsite << " sigmaElec=" << sigmaElec
+		<< " rcElec=" << rcElec << " alpha=" << alpha << " aPol=" << aPol;
+	appendFileContents(oss, elecFilename);
+	appendFileContents(oss, elecFilenameG);
+	return oss.str();
+}
+
+std::vector<RadialFunctionG*> Molecule::Site::kernels()
+{	return { &elecKernel, &chargeKernel, &polKernel, &w0, &w1, &w2, &w3, &w1v, &w2m };
+}
+
+//Filename in kernelCacheDir for a given key:
+static string siteKernelFilename(const string& key)
+{	ostringstream oss;
+	oss << Molecule::Site::kernelCacheDir << "/siteKernels." << std::hex << std::hash<std::string>()(std::string(key.c_str())) << ".bin";
+	return oss.str();
+}
+
+//Load kernels from disk (returns false if unavailable or saved for a different key)
+static bool loadSiteKernels(const string& key, SiteKernels& sk)
+{	FILE* fp = fopen(siteKernelFilename(key).c_str(), "rb");
+	if(!fp) return false;
+	bool success = false;
+	uint64_t keyLength = 0;
+	if(freadLE(&keyLength, sizeof(uint64_t), 1, fp)==1 && keyLength==key.length())
+	{	std::vector<char> keyFile(keyLength);
+		uint64_t nKernels = 0;
+		if(fread(keyFile.data(), 1, keyLength, fp)==keyLength && string(keyFile.data(), keyLength)==key
+			&& freadLE(&sk.deltaSchange, sizeof(double), 1, fp)==1
+			&& freadLE(&sk.Znuc, sizeof(double), 1, fp)==1
+			&& freadLE(&nKernels, sizeof(uint64_t), 1, fp)==1)
+		{	sk.coeff.resize(nKernels);
+			sk.dGinv.resize(nKernels);
+			success = true;
+			for(uint64_t k=0; k<nKernels && success; k++)
+			{	uint64_t nCoeff = 0;
+				success = freadLE(&sk.dGinv[k], sizeof(double), 1, fp)==1 && freadLE(&nCoeff, sizeof(uint64_t), 1, fp)==1;
+				if(!success) break;
+				sk.coeff[k].resize(nCoeff);
+				success = (freadLE(sk.coeff[k].data(), sizeof(double), nCoeff, fp)==nCoeff);
+			}
+		}
+	}
+	fclose(fp);
+	return success;
+}
+
+//Save kernels to disk, via a temporary file and rename (so that concurrent jobs sharing the directory never read a partial file)
+static void saveSiteKernels(const string& key, const SiteKernels& sk)
+{	if(!mpiWorld->isHead()) return;
+	string fname = siteKernelFilename(key);
+	ostringstream ossTmp; ossTmp << fname << ".tmp" << getpid();
+	string fnameTmp = ossTmp.str();
+	FILE* fp = fopen(fnameTmp.c_str(), "wb");
+	if(!fp) { logPrintf("       WARNING: could not write site kernel cache file '%s'.\n", fname.c_str()); return; }
+	uint64_t keyLength = key.length();
+	fwriteLE(&keyLength, sizeof(uint64_t), 1, fp);
+	fwrite(key.data(), 1, keyLength, fp);
+	fwriteLE(&sk.deltaSchange, sizeof(double), 1, fp);
+	fwriteLE(&sk.Znuc, sizeof(double), 1, fp);
+	uint64_t nKernels = sk.coeff.size();
+	fwriteLE(&nKernels, sizeof(uint64_t), 1, fp);
+	for(uint64_t k=0; k<nKernels; k++)
+	{	uint64_t nCoeff = sk.coeff[k].size();
+		fwriteLE(&sk.dGinv[k], sizeof(double), 1, fp);
+		fwriteLE(&nCoeff, sizeof(uint64_t), 1, fp);
+		fwriteLE(sk.coeff[k].data(), sizeof(double), nCoeff, fp);
+	}
+	bool success = !ferror(fp);
+	if(fclose(fp)) success = false;
+	if(!success || rename(fnameTmp.c_str(), fname.c_str()))
+	{	logPrintf("       WARNING: could not write site kernel cache file '%s'.\n", fname.c_str());
+		unlink(fnameTmp.c_str());
+	}
+}
+
 void Molecule::Site::setup(const GridInfo& gInfo)
 {	if(initialized) free();
 	double dG = gInfo.dGradial;
 	int nGridLoc = int(ceil(gInfo.GmaxGrid/dG))+5;
 	logPrintf("     Initializing site '%s'\n", name.c_str());
 	
+	//Reuse kernels of an identical site computed previously in this run, or saved in kernelCacheDir:
+	string key = kernelCacheKey(dG, nGridLoc);
+	{	std::lock_guard<std::mutex> lock(siteKernelRegistryLock);
+		auto iter = siteKernelRegistry.find(key);
+		SiteKernels sk;
+		bool found = (iter != siteKernelRegistry.end());
+		if(found) sk = iter->second;
+		else if(kernelCacheDir.length() && loadSiteKernels(key, sk) && sk.coeff.size()==kernels().size())
+		{	siteKernelRegistry[key] = sk;
+			found = true;
+		}
+		if(found)
+		{	std::vector<RadialFunctionG*> kArr = kernels();
+			for(size_t k=0; k<kArr.size(); k++)
+				if(sk.coeff[k].size()) kArr[k]->set(sk.coeff[k], sk.dGinv[k]);
+			deltaS += sk.deltaSchange;
+			Znuc = sk.Znuc;
+			logPrintf("       Reusing cached kernels with net site charge %lg\n", chargeKernel ? chargeKernel(0) : 0.);
+			logPrintf("       Positions in reference frame:\n");
+			for(vector3<> r: positions) logPrintf("         [ %+.6lf %+.6lf %+.6lf ]\n", r[0], r[1], r[2]);
+			initialized = true;
+			return;
+		}
+	}
+	double deltaSinitial = deltaS;
+	
 	//Initialize electron density kernel:
 	if(elecFilename.length() || elecFilenameG.length() || Zelec)
 	{	logPrintf("       Electron density: ");
@@ -233,6 +369,19 @@ void Molecule::Site::setup(const GridInfo& gInfo)
 		this->w2m.init(0, w2m, dG);
 	}
 	
+	//Register the kernels for reuse by identical sites (and save to disk if requested):
+	{	SiteKernels sk;
+		sk.deltaSchange = deltaS - deltaSinitial;
+		sk.Znuc = Znuc;
+		for(RadialFunctionG* kernel: kernels())
+		{	sk.coeff.push_back(*kernel ? kernel->coeff : std::vector<double>());
+			sk.dGinv.push_back(kernel->dGinv);
+		}
+		std::lock_guard<std::mutex> lock(siteKernelRegistryLock);
+		siteKernelRegistry[key] = sk;
+		if(kernelCacheDir.length()) saveSiteKernels(key, sk);
+	}
+	
 	logPrintf("       Positions in reference frame:\n");
 	for(vector3<> r: positions) logPrintf("         [ %+.6lf %+.6lf %+.6lf ]\n", r[0], r[1], r[2]);
 	initialized = true;
@@ -54,9 +54,15 @@ struct Molecule
 		
 		RadialFunctionG w0, w1, w2, w3, w1v, w2m; //!< Hard sphere weight functions
 		RadialFunctionG elecKernel, chargeKernel, polKernel; //!< Electron density, net charge density and polarizability kernels for the sites
+
+		//! If non-empty, the kernels computed by setup() are also saved to and loaded from files in this directory, keyed
+		//! by a hash of the site model and radial grid (within a run, identical sites always share one computation)
+		static string kernelCacheDir;
 	private:
 		bool initialized;
 		void free();
+		string kernelCacheKey(double dG, int nGridLoc) const; //!< serialized site model and grid, identifying its kernels
+		std::vector<RadialFunctionG*> kernels(); //!< all the radial functions computed by setup(), in a fixed order
 	};
 	std::vector< std::shared_ptr<Site> > sites;
 	RadialFunctionG mfKernel; //!< Mean field interaction kernel (with minimum Coulomb self energy while preserving intermolecular interactions)
@@ -22,7 +22,9 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <fluid/LinearPCM.h>
 #include <fluid/PCM_internal.h>
 #include <core/ScalarFieldIO.h>
+#include <core/ScalarFieldExpr.h>
 #include <core/Util.h>
+#include <algorithm>
 
 //Utility functions to extract/set the members of a MuEps
 inline ScalarField& getMuPlus(ScalarFieldMuEps& X) { return X[0]; }
@@ -158,9 +160,9 @@ void NonlinearPCM::set_internal(const ScalarFieldTilde& rhoExplicitTilde, const
 		else initZero(mu, gInfo); //initialization logic does not work well with hard sphere limit
 		//eps:
 		VectorField eps = (-pMol/fsp.T) * I(gradient(linearPCM->state));
-		ScalarField E = sqrt(eps[0]*eps[0] + eps[1]*eps[1] + eps[2]*eps[2]);
-		ScalarField Ecomb = 0.5*((dielectricEval->alpha-3.) + E);
-		ScalarField epsByE = inv(E) * (Ecomb + sqrt(Ecomb*Ecomb + 3.*E));
+		ScalarField E = eval(sqrt(lazy(eps[0])*eps[0] + eps[1]*eps[1] + eps[2]*eps[2]));
+		ScalarField Ecomb = eval(0.5*((dielectricEval->alpha-3.) + lazy(E)));
+		ScalarField epsByE = eval(inv(lazy(E)) * (Ecomb + sqrt(lazy(Ecomb)*Ecomb + 3.*E)));
 		eps *= epsByE; //enhancement due to correlations
 		//collect:
 		setMuEps(state, mu, clone(mu), eps);
@@ -270,7 +272,8 @@ double NonlinearPCM::operator()(const ScalarFieldMuEps& state, ScalarFieldMuEps&
 void NonlinearPCM::minimizeFluid()
 {	if(fsp.nonlinearSCF)
 	{	clearState();
-		Pulay<ScalarFieldTilde>::minimize(compute(0,0));
+		if(fsp.nonlinearNewton) minimizeNewton();
+		else Pulay<ScalarFieldTilde>::minimize(compute(0,0));
 	}
 	else
 		Minimizable<ScalarFieldMuEps>::minimize(e.fluidMinParams);
@@ -285,6 +288,14 @@ void NonlinearPCM::saveState(const char* filename) const
 {	if(mpiWorld->isHead()) state.saveToFile(filename);
 }
 
+void NonlinearPCM::getStateFields(ScalarFieldArray& fields) const
+{	if(state[0]) fields = state.component;
+}
+
+void NonlinearPCM::setStateFields(const ScalarFieldArray& fields)
+{	state.component = fields;
+}
+
 double NonlinearPCM::get_Adiel_and_grad_internal(ScalarFieldTilde& Adiel_rhoExplicitTilde, ScalarFieldTilde& Adiel_nCavityTilde, IonicGradient* extraForces) const
 {	ScalarFieldMuEps Adiel_state;
 	double A = (*this)(state, Adiel_state, &Adiel_rhoExplicitTilde, &Adiel_nCavityTilde, extraForces);
@@ -414,3 +425,110 @@ void NonlinearPCM::phiToState(bool setState)
 	else
 		linearPCM->override(epsilon, kappaSq);
 }
+
+//--------- Newton-Krylov version ---------
+
+void NonlinearPCM::phiToHessian()
+{	static StopWatch watch("NonlinearPCM::phiToHessian"); watch.start();
+	DphiNewton = I(gradient(linearPCM->state));
+	ScalarField epsilon, kappaSq;
+	nullToZero(epsilon, gInfo);
+	nullToZero(epsilonAniso, gInfo);
+	callPref(dielectricEval->phiToHessian)(gInfo.nr, DphiNewton.const_dataPref(), shape[0]->dataPref(), gLookup,
+		epsilon->dataPref(), epsilonAniso->dataPref());
+	if(screeningEval)
+	{	const ScalarField phi = I(linearPCM->state);
+		nullToZero(kappaSq, gInfo);
+		nullToZero(kappaSqDiff, gInfo);
+		callPref(screeningEval->phiToHessian)(gInfo.nr, phi->dataPref(), shape.back()->dataPref(), xLookup,
+			kappaSq->dataPref(), kappaSqDiff->dataPref());
+	}
+	linearPCM->override(epsilon, kappaSq); //residual and preconditioner use the effective (secant) response
+	watch.stop();
+}
+
+ScalarFieldTilde NonlinearPCM::newtonHessian(const ScalarFieldTilde& dphiTilde) const
+{	//Dielectric term with differential tensor epsilon + epsilonAniso Dphi Dphi^T:
+	VectorField Ddphi = I(gradient(dphiTilde));
+	VectorField D = linearPCM->epsilonOverride * Ddphi;
+	D += (epsilonAniso * dotElemwise(DphiNewton, Ddphi)) * DphiNewton;
+	ScalarFieldTilde rhoTilde = divergence(J(D));
+	//Screening term:
+	if(kappaSqDiff) rhoTilde -= J(kappaSqDiff * I(dphiTilde));
+	return (-1./(4*M_PI)) * rhoTilde;
+}
+
+int NonlinearPCM::newtonSolve(const ScalarFieldTilde& residual, ScalarFieldTilde& dphiTilde, double tol) const
+{	static StopWatch watch("NonlinearPCM::newtonSolve"); watch.start();
+	nullToZero(dphiTilde, gInfo);
+	dphiTilde->zero();
+	ScalarFieldTilde r = -1.*residual;
+	ScalarFieldTilde z = linearPCM->precondition(r);
+	ScalarFieldTilde d = clone(z);
+	double rdotz = dot(r, z), rdotzStop = tol*tol*rdotz;
+	int iter = 0;
+	for(; iter<e.fluidMinParams.nIterations && rdotz>rdotzStop; iter++)
+	{	ScalarFieldTilde w = newtonHessian(d);
+		double alpha = rdotz / dot(w, d);
+		axpy(alpha, d, dphiTilde);
+		axpy(-alpha, w, r);
+		z = linearPCM->precondition(r);
+		double rdotzPrev = rdotz;
+		rdotz = dot(r, z);
+		d *= rdotz/rdotzPrev;
+		d += z;
+	}
+	watch.stop();
+	return iter;
+}
+
+void NonlinearPCM::minimizeNewton()
+{	const PulayParams& pp = fsp.scfParams;
+	string linePrefix(useGummel() ? "NonlinearFluidNewton: " : "\tNonlinearFluidNewton: ");
+	ScalarFieldTilde& phi = linearPCM->state;
+	//Residual of the nonlinear Poisson equation, and its norm in the Coulomb metric:
+	auto getResidual = [&](double& residualNorm)
+	{	phiToHessian();
+		ScalarFieldTilde residual = linearPCM->hessian(phi) - rhoExplicitTilde;
+		residualNorm = sqrt(std::max(0., dot(residual, O(coulomb(residual)))));
+		return residual;
+	};
+	double residualNorm; ScalarFieldTilde residual = getResidual(residualNorm);
+	double residualNorm0 = residualNorm;
+	phiToState(true);
+	double A = compute(0,0);
+	fprintf(pp.fpLog, "%sIter: %2i   %s: ", linePrefix.c_str(), 0, pp.energyLabel);
+	fprintf(pp.fpLog, pp.energyFormat, A);
+	fprintf(pp.fpLog, "   |Residual|: %.3e  t[s]: %9.2lf\n", residualNorm, clock_sec()); fflush(pp.fpLog);
+	for(int iter=1; iter<=pp.nIterations; iter++)
+	{	//Inexact Newton step, with forcing term tightening as the residual drops:
+		double tol = std::min(0.1, sqrt(residualNorm/residualNorm0));
+		ScalarFieldTilde dphi;
+		int nKrylov = newtonSolve(residual, dphi, tol);
+		//Backtrack (a few times at most) if the full step increases the residual:
+		ScalarFieldTilde phiPrev = clone(phi);
+		double stepSize = 1., residualNormNew = 0.;
+		for(int iBacktrack=0; ; iBacktrack++)
+		{	phi = phiPrev + stepSize*dphi;
+			residual = getResidual(residualNormNew);
+			if(residualNormNew < residualNorm || iBacktrack==3) break;
+			stepSize *= 0.5;
+		}
+		residualNorm = residualNormNew;
+		//Update state and energy:
+		phiToState(true);
+		double Aprev = A;
+		A = compute(0,0);
+		double dA = A - Aprev;
+		fprintf(pp.fpLog, "%sIter: %2i   %s: ", linePrefix.c_str(), iter, pp.energyLabel);
+		fprintf(pp.fpLog, pp.energyFormat, A);
+		fprintf(pp.fpLog, "   d%s: %+.3e   |Residual|: %.3e   nKrylov: %d   step: %lg  t[s]: %9.2lf\n",
+			pp.energyLabel, dA, residualNorm, nKrylov, stepSize, clock_sec());
+		fflush(pp.fpLog);
+		if(fabs(dA) < pp.energyDiffThreshold)
+		{	fprintf(pp.fpLog, "%sConverged (|Delta %s|<%le).\n\n", linePrefix.c_str(), pp.energyLabel, pp.energyDiffThreshold);
+			fflush(pp.fpLog);
+			break;
+		}
+	}
+}
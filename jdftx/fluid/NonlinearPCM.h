@@ -49,7 +49,7 @@ public:
 	void loadState(const char* filename); //!< Load state from file
 	void saveState(const char* filename) const; //!< Save state to file
 	void dumpDensities(const char* filenamePattern) const;
-	void minimizeFluid(); //!< Converge using nonlinear conjugate gradients
+	void minimizeFluid(); //!< Converge using nonlinear conjugate gradients, or SCF / Newton-Krylov on the potential
 
 	//! Compute gradient and free energy (with optional outputs)
 	double operator()(const ScalarFieldMuEps& state, ScalarFieldMuEps& Adiel_state,
@@ -62,6 +62,8 @@ public:
 protected:
 	void set_internal(const ScalarFieldTilde& rhoExplicitTilde, const ScalarFieldTilde& nCavityTilde);
 	double get_Adiel_and_grad_internal(ScalarFieldTilde& Adiel_rhoExplicitTilde, ScalarFieldTilde& Adiel_nCavityTilde, IonicGradient* extraForces) const;
+	void getStateFields(ScalarFieldArray& fields) const;
+	void setStateFields(const ScalarFieldArray& fields);
 
 private:
 	double pMol, ionNbulk, ionZ;
@@ -77,6 +79,7 @@ protected:
 	double cycle(double dEprev, std::vector<double>& extraValues);
 	void axpy(double alpha, const ScalarFieldTilde& X, ScalarFieldTilde& Y) const { ::axpy(alpha, X, Y); }
 	double dot(const ScalarFieldTilde& X, const ScalarFieldTilde& Y) const { return ::dot(X, Y); }
+	void dotMulti(const std::vector<ScalarFieldTilde>& X, const ScalarFieldTilde& Y, double* result) const { std::fill(result, result+X.size(), 0.); ::dotMulti(X, Y, result); }
 	size_t variableSize() const { return gInfo.nG * sizeof(complex); }
 	void readVariable(ScalarFieldTilde& X, FILE* fp) const;
 	void writeVariable(const ScalarFieldTilde& X, FILE* fp) const;
@@ -86,6 +89,14 @@ protected:
 	ScalarFieldTilde applyMetric(const ScalarFieldTilde&) const;
 private:
 	void phiToState(bool setState); //!< update state if setState=true and epsilon/kappaSq in linearPCM if setState=false from the current phi
+	
+	//Newton-Krylov version (see command pcm-nonlinear-newton):
+	VectorField DphiNewton; //!< gradient of phi at the current linearization
+	ScalarField epsilonAniso, kappaSqDiff; //!< differential response at DphiNewton (in addition to effective epsilon in linearPCM)
+	void phiToHessian(); //!< update effective epsilon/kappaSq in linearPCM, and the differential response, from the current phi
+	ScalarFieldTilde newtonHessian(const ScalarFieldTilde& dphiTilde) const; //!< Hessian-vector product of the nonlinear Poisson operator at the current linearization
+	int newtonSolve(const ScalarFieldTilde& residual, ScalarFieldTilde& dphiTilde, double tol) const; //!< Newton step by CG preconditioned with the linearPCM operator; returns iterations
+	void minimizeNewton(); //!< Inexact Newton-Krylov solve for the potential
 };
 
 //! @}
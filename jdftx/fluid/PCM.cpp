@@ -265,21 +265,48 @@ PCM::~PCM()
 	for(unsigned i=0; i<Sf.size(); i++) Sf[i].free();
 }
 
+bool PCM::reuseCavity()
+{	if(fsp.pcmVariant==PCM_SoftSphere || fsp.pcmVariant==PCM_FixedCavity)
+		return false; //these only depend on atom positions, and handle their own updates
+	bool reuse = nCavityPrev && (atpos == atposPrev);
+	double thresholdSq = std::pow(fsp.cavityReuseThreshold, 2);
+	if(reuse)
+	{	ScalarField dn = nCavity - nCavityPrev;
+		reuse = (dot(dn,dn) <= thresholdSq * dot(nCavityPrev,nCavityPrev));
+	}
+	if(reuse && fsp.pcmVariant==PCM_CANDLE)
+	{	ScalarFieldTilde dRho = rhoExplicitTilde - rhoExplicitPrev;
+		reuse = (dot(dRho,dRho) <= thresholdSq * dot(rhoExplicitPrev,rhoExplicitPrev));
+	}
+	if(reuse)
+	{	nCavity = nCavityPrev; //keep cavity-determining density consistent with cached intermediates
+		return true;
+	}
+	nCavityPrev = clone(nCavity);
+	if(fsp.pcmVariant==PCM_CANDLE) rhoExplicitPrev = clone(rhoExplicitTilde);
+	atposPrev = atpos;
+	return false;
+}
+
 void PCM::updateCavity()
 {
+	if(reuseCavity()) return; //shape functions, cavitation energies and cached gradients are still valid
+	static StopWatch watch("PCM::updateCavity"); watch.start();
 	bool cavityChanged = true; //keep track of whether cavity is updated in code below (usually yes, except for SS)
 	
 	//Cavities from expanded densities for SGA13 variant:
 	if(fsp.pcmVariant == PCM_SGA13)
 	{	ScalarField* shapeEx[2] = { &shape[0], &shapeVdw };
 		for(int i=0; i<2; i++)
-		{	ShapeFunctionSGA13::expandDensity(wExpand[i], Rex[i], nCavity, nCavityEx[i]);
-			ShapeFunction::compute(nCavityEx[i], *(shapeEx[i]), fsp.nc, fsp.sigma);
+		{	ShapeFunctionSGA13::expandDensity(wExpand[i], Rex[i], nCavity, nCavityEx[i], nCavityEx_nBar[i], nCavityEx_DnBarSq[i], DnBarEx[i]);
+			ShapeFunction::compute(nCavityEx[i], *(shapeEx[i]), shape_nCavity[i], fsp.nc, fsp.sigma);
 		}
 	}
 	else if(fsp.pcmVariant == PCM_CANDLE)
 	{	nCavityEx[0] = fsp.Ztot * I(Sf[0] * J(nCavity));
-		ShapeFunctionCANDLE::compute(nCavityEx[0], coulomb(Sf[0]*rhoExplicitTilde), shapeVdw,
+		DnCavity = gradient(nCavityEx[0]);
+		DphiCavity = I(gradient(coulomb(Sf[0]*rhoExplicitTilde)));
+		ShapeFunctionCANDLE::compute(nCavityEx[0], DnCavity, DphiCavity, shapeVdw,
 			fsp.nc, fsp.sigma, fsp.pCavity); //vdW cavity
 		shape[0] = I(wExpand[0] * J(shapeVdw)); //dielectric cavity
 	}
@@ -306,7 +333,7 @@ void PCM::updateCavity()
 	else if(isPCM_SCCS(fsp.pcmVariant))
 		ShapeFunctionSCCS::compute(nCavity, shape[0], fsp.rhoMin, fsp.rhoMax, epsBulk);
 	else //Compute directly from nCavity (which is a density product for SaLSA):
-		ShapeFunction::compute(nCavity, shape[0], fsp.nc, fsp.sigma);
+		ShapeFunction::compute(nCavity, shape[0], shape_nCavity[0], fsp.nc, fsp.sigma);
 	
 	//Apply cavity masks (if any):
 	if((zMask[0] || zMask[1]) && cavityChanged)
@@ -375,15 +402,16 @@ void PCM::updateCavity()
 		case_PCM_SCCS_any:
 		{	//Volume contribution:
 			Adiel["CavityPressure"] = fsp.cavityPressure * (gInfo.detR - integral(shape[0]));
-			//Surface contribution:
-			ScalarField shapePlus, shapeMinus;
+			//Surface contribution (intermediates cached for propagateCavityGradients):
 			ShapeFunctionSCCS::compute(nCavity+(0.5*fsp.rhoDelta), shapePlus, fsp.rhoMin, fsp.rhoMax, epsBulk);
 			ShapeFunctionSCCS::compute(nCavity-(0.5*fsp.rhoDelta), shapeMinus, fsp.rhoMin, fsp.rhoMax, epsBulk);
-			ScalarField DnLength = sqrt(lengthSquared(gradient(nCavity)));
-			Adiel["CavityTension"] = (fsp.cavityTension/fsp.rhoDelta) * integral(DnLength * (shapeMinus - shapePlus));
+			DnCavity = gradient(nCavity);
+			DnCavityLength = sqrt(lengthSquared(DnCavity));
+			Adiel["CavityTension"] = (fsp.cavityTension/fsp.rhoDelta) * integral(DnCavityLength * (shapeMinus - shapePlus));
 			break;
 		}
 	}
+	watch.stop();
 }
 
 void PCM::propagateCavityGradients(const ScalarFieldArray& A_shape, ScalarField& A_nCavity, ScalarFieldTilde& A_rhoExplicitTilde, IonicGradient* forces) const
@@ -408,17 +436,15 @@ void PCM::propagateCavityGradients(const ScalarFieldArray& A_shape, ScalarField&
 		const ScalarField* A_shapeEx[2] = { &A_shape[0], &Acavity_shapeVdw };
 		for(int i=0; i<2; i++)
 		{	//First compute derivative w.r.t expanded electron density:
-			ScalarField A_nCavityEx;
-			ShapeFunction::propagateGradient(nCavityEx[i], *(A_shapeEx[i]), A_nCavityEx, fsp.nc, fsp.sigma);
+			ScalarField A_nCavityEx = (*(A_shapeEx[i])) * shape_nCavity[i];
 			((PCM*)this)->A_nc += (-1./fsp.nc) * integral(A_nCavityEx*nCavityEx[i]);
 			//then propagate to original electron density:
-			ScalarField nCavityExUnused; //unused return value below
-			ShapeFunctionSGA13::expandDensity(wExpand[i], Rex[i], nCavity, nCavityExUnused, &A_nCavityEx, &A_nCavity);
+			ShapeFunctionSGA13::propagateGradient(wExpand[i], Rex[i], nCavityEx_nBar[i], nCavityEx_DnBarSq[i], DnBarEx[i], A_nCavityEx, A_nCavity);
 		}
 	}
 	else if(fsp.pcmVariant == PCM_CANDLE)
 	{	ScalarField A_nCavityEx; ScalarFieldTilde A_phiExt; double A_pCavity=0.;
-		ShapeFunctionCANDLE::propagateGradient(nCavityEx[0], coulomb(Sf[0]*rhoExplicitTilde), I(wExpand[0]*J(A_shape[0])) + Acavity_shapeVdw,
+		ShapeFunctionCANDLE::propagateGradient(nCavityEx[0], DnCavity, DphiCavity, I(wExpand[0]*J(A_shape[0])) + Acavity_shapeVdw,
 			A_nCavityEx, A_phiExt, A_pCavity, fsp.nc, fsp.sigma, fsp.pCavity);
 		A_nCavity += fsp.Ztot * I(Sf[0] * J(A_nCavityEx));
 		((PCM*)this)->A_rhoNonES = coulomb(Sf[0]*A_phiExt);
@@ -448,20 +474,15 @@ void PCM::propagateCavityGradients(const ScalarFieldArray& A_shape, ScalarField&
 	else if(isPCM_SCCS(fsp.pcmVariant))
 	{	//Electrostatic and volumetric combinations via shape:
 		ShapeFunctionSCCS::propagateGradient(nCavity, A_shape[0] - fsp.cavityPressure, A_nCavity, fsp.rhoMin, fsp.rhoMax, epsBulk);
-		//Add surface contributions:
-		ScalarField shapePlus, shapeMinus;
-		ShapeFunctionSCCS::compute(nCavity+(0.5*fsp.rhoDelta), shapePlus, fsp.rhoMin, fsp.rhoMax, epsBulk);
-		ShapeFunctionSCCS::compute(nCavity-(0.5*fsp.rhoDelta), shapeMinus, fsp.rhoMin, fsp.rhoMax, epsBulk);
-		VectorField Dn = gradient(nCavity);
-		ScalarField DnLength = sqrt(lengthSquared(Dn));
-		ScalarField A_shapeMinus = (fsp.cavityTension/fsp.rhoDelta) * DnLength;
+		//Add surface contributions (using intermediates cached in updateCavity):
+		ScalarField A_shapeMinus = (fsp.cavityTension/fsp.rhoDelta) * DnCavityLength;
 		ScalarField A_DnLength = (fsp.cavityTension/fsp.rhoDelta) * (shapeMinus - shapePlus);
-		A_nCavity -= divergence(Dn * (inv(DnLength) * A_DnLength));
+		A_nCavity -= divergence(DnCavity * (inv(DnCavityLength) * A_DnLength));
 		ShapeFunctionSCCS::propagateGradient(nCavity+(0.5*fsp.rhoDelta), -A_shapeMinus, A_nCavity, fsp.rhoMin, fsp.rhoMax, epsBulk);
 		ShapeFunctionSCCS::propagateGradient(nCavity-(0.5*fsp.rhoDelta),  A_shapeMinus, A_nCavity, fsp.rhoMin, fsp.rhoMax, epsBulk);
 	}
 	else //All gradients are w.r.t the same shape function - propagate them to nCavity (which is defined as a density product for SaLSA)
-	{	ShapeFunction::propagateGradient(nCavity, A_shape[0] + Acavity_shape, A_nCavity, fsp.nc, fsp.sigma);
+	{	A_nCavity += (A_shape[0] + Acavity_shape) * shape_nCavity[0];
 		((PCM*)this)->A_nc = (-1./fsp.nc) * integral(A_nCavity*nCavity);
 	}
 }
@@ -509,9 +530,9 @@ ScalarFieldTilde PCM::getFullCore() const
 		case PCM_CANDLE:
 		{	ScalarFieldTilde nFullCore, SG(ScalarFieldTildeData::alloc(gInfo, isGpuEnabled()));
 			for(unsigned iSp=0; iSp<atpos.size(); iSp++)
-			{	ManagedArray<vector3<>> atposManaged(atpos[iSp]);
+			{	AtomPhases phases(gInfo.S, atpos[iSp].size(), atpos[iSp].data());
 				//Compute structure factor and accumulate contribution from this species:
-				callPref(getSG)(gInfo.S, atposManaged.nData(), atposManaged.dataPref(), 1./gInfo.detR, SG->dataPref());
+				callPref(getSG)(gInfo.S, atpos[iSp].size(), phases.tables(), 1./gInfo.detR, SG->dataPref());
 				nFullCore += e.iInfo.species[iSp]->ZfullCore * SG;
 			}
 			return nFullCore;
@@ -70,6 +70,19 @@ private:
 	ScalarFieldArray zMask; //optional cavity mask function
 	int nShape; //natural number of shape functions of the solvation model (2 if ionspacing is used to make ionic cavity, else 1)
 	bool fixedCavityMasked; //!< whether mask has already been applied to fixed cavity
+	
+	//Intermediates of the most recent updateCavity(), reused by propagateCavityGradients():
+	ScalarField shape_nCavity[2]; //!< derivative of shape functions w.r.t (expanded for SGA13) cavity-determining density
+	ScalarField nCavityEx_nBar[2], nCavityEx_DnBarSq[2]; VectorField DnBarEx[2]; //!< derivatives and weighted density gradients of the expanded densities (SGA13 only)
+	VectorField DnCavity; //!< gradient of cavity-determining density (expanded for CANDLE; CANDLE and SCCS only)
+	VectorField DphiCavity; //!< gradient of vacuum electric potential of the cavity-determining charge (CANDLE only)
+	ScalarField shapePlus, shapeMinus, DnCavityLength; //!< shifted shape functions and density gradient magnitude for the quantum surface (SCCS only)
+	
+	//Inputs of the most recent cavity update (to skip it when inputs change by less than fsp.cavityReuseThreshold):
+	ScalarField nCavityPrev;
+	ScalarFieldTilde rhoExplicitPrev; //!< (CANDLE only)
+	std::vector<std::vector<vector3<>>> atposPrev;
+	bool reuseCavity(); //!< check whether previous cavity can be reused for current inputs (and restore the previous nCavity if so), else remember current inputs
 protected:
 	std::vector<RadialFunctionG> Sf; //!< spherically-averaged structure factors for each solvent site
 	std::vector<int> atomicNumbers; //!< atomic number for each solvent site (for dispersion interactions)
@@ -30,17 +30,26 @@ namespace ShapeFunction
 	void compute(int N, const double* n, double* shape, const double nc, const double sigma)
 	{	threadedLoop(compute_calc, N, n, shape, nc, sigma);
 	}
+	void computeWithDerivative(int N, const double* n, double* shape, double* shape_n, const double nc, const double sigma)
+	{	threadedLoop(computeWithDerivative_calc, N, n, shape, shape_n, nc, sigma);
+	}
 	void propagateGradient(int N, const double* n, const double* grad_shape, double* grad_n, const double nc, const double sigma)
 	{	threadedLoop(propagateGradient_calc, N, n, grad_shape, grad_n, nc, sigma);
 	}
 	#ifdef GPU_ENABLED
 	void compute_gpu(int N, const double* n, double* shape, const double nc, const double sigma);
+	void computeWithDerivative_gpu(int N, const double* n, double* shape, double* shape_n, const double nc, const double sigma);
 	void propagateGradient_gpu(int N, const double* n, const double* grad_shape, double* grad_n, const double nc, const double sigma);
 	#endif
 	void compute(const ScalarField& n, ScalarField& shape, const double nc, const double sigma)
 	{	nullToZero(shape, n->gInfo);
 		callPref(compute)(n->gInfo.nr, n->dataPref(), shape->dataPref(), nc, sigma);
 	}
+	void compute(const ScalarField& n, ScalarField& shape, ScalarField& shape_n, const double nc, const double sigma)
+	{	nullToZero(shape, n->gInfo);
+		nullToZero(shape_n, n->gInfo);
+		callPref(computeWithDerivative)(n->gInfo.nr, n->dataPref(), shape->dataPref(), shape_n->dataPref(), nc, sigma);
+	}
 	void propagateGradient(const ScalarField& n, const ScalarField& grad_shape, ScalarField& grad_n, const double nc, const double sigma)
 	{	nullToZero(grad_n, n->gInfo);
 		callPref(propagateGradient)(n->gInfo.nr, n->dataPref(), grad_shape->dataPref(), grad_n->dataPref(), nc, sigma);
@@ -61,21 +70,17 @@ namespace ShapeFunctionCANDLE
 		const double* A_shape, double* A_n, vector3<double*> A_Dn, vector3<double*> A_Dphi, double* A_pCavity,
 		const double nc, const double invSigmaSqrt2, const double pCavity);
 	#endif
-	void compute(const ScalarField& n, const ScalarFieldTilde& phi,
+	void compute(const ScalarField& n, const VectorField& Dn, const VectorField& Dphi,
 		ScalarField& shape, double nc, double sigma, double pCavity)
-	{	VectorField Dn = gradient(n);
-		VectorField Dphi = I(gradient(phi));
-		nullToZero(shape, n->gInfo);
+	{	nullToZero(shape, n->gInfo);
 		callPref(compute_or_grad)(n->gInfo.nr, false,
 			n->dataPref(), Dn.const_dataPref(), Dphi.const_dataPref(), shape->dataPref(),
 			0, 0, vector3<double*>(), vector3<double*>(), 0,
 			nc, sqrt(0.5)/sigma, pCavity);
 	}
-	void propagateGradient(const ScalarField& n, const ScalarFieldTilde& phi, const ScalarField& E_shape,
+	void propagateGradient(const ScalarField& n, const VectorField& Dn, const VectorField& Dphi, const ScalarField& E_shape,
 		ScalarField& E_n, ScalarFieldTilde& E_phi, double& E_pCavity, double nc, double sigma, double pCavity)
-	{	VectorField Dn = gradient(n);
-		VectorField Dphi = I(gradient(phi));
-		nullToZero(E_n, n->gInfo);
+	{	nullToZero(E_n, n->gInfo);
 		VectorField E_Dn; nullToZero(E_Dn, n->gInfo);
 		VectorField E_Dphi; nullToZero(E_Dphi, n->gInfo);
 		ScalarField E_pCavityArr; nullToZero(E_pCavityArr, n->gInfo);
@@ -83,7 +88,6 @@ namespace ShapeFunctionCANDLE
 			n->dataPref(), Dn.const_dataPref(), Dphi.const_dataPref(), 0,
 			E_shape->dataPref(), E_n->dataPref(), E_Dn.dataPref(), E_Dphi.dataPref(), E_pCavityArr->dataPref(),
 			nc, sqrt(0.5)/sigma, pCavity);
-		Dn=0; Dphi=0; //free memory
 		E_n -= divergence(E_Dn);
 		E_phi -= divergence(J(E_Dphi));
 		E_pCavity += integral(E_pCavityArr);
@@ -98,29 +102,26 @@ namespace ShapeFunctionSGA13
 	#ifdef GPU_ENABLED
 	void expandDensityHelper_gpu(int N, double alpha, const double* nBar, const double* DnBarSq, double* nEx, double* nEx_nBar, double* nEx_DnBarSq);
 	#endif
-	void expandDensity(const RadialFunctionG& w, double R, const ScalarField& n, ScalarField& nEx, const ScalarField* A_nEx, ScalarField* A_n)
+	void expandDensity(const RadialFunctionG& w, double R, const ScalarField& n, ScalarField& nEx,
+		ScalarField& nEx_nBar, ScalarField& nEx_DnBarSq, VectorField& DnBar)
 	{	//Compute weighted densities:
 		ScalarFieldTilde nBarTilde = w * J(n);
 		ScalarField nBar = I(nBarTilde);
-		VectorField DnBar = I(gradient(R * nBarTilde));
+		DnBar = I(gradient(R * nBarTilde));
 		ScalarField DnBarSq = lengthSquared(DnBar);
-		//Compute the elementwise function and optionally its derivatives:
+		//Compute the elementwise function and its derivatives:
 		nullToZero(nEx, n->gInfo);
-		ScalarField nEx_nBar, nEx_DnBarSq;
-		if(A_n)
-		{	assert(A_nEx);
-			nullToZero(nEx_nBar, n->gInfo);
-			nullToZero(nEx_DnBarSq, n->gInfo);
-		}
+		nullToZero(nEx_nBar, n->gInfo);
+		nullToZero(nEx_DnBarSq, n->gInfo);
 		callPref(expandDensityHelper)(n->gInfo.nr, R*R*R, nBar->dataPref(), DnBarSq->dataPref(), nEx->dataPref(),
-			(A_n ? nEx_nBar->dataPref() : 0), (A_n ? nEx_DnBarSq->dataPref() : 0));
-		//Propagate gradients if necessary:
-		if(A_n)
-		{	ScalarFieldTilde A_nBarTilde = Idag((*A_nEx) * nEx_nBar); //contribution through nBar
-			ScalarField A_DnBarSq = (*A_nEx) * nEx_DnBarSq;
-			A_nBarTilde -= (2.*R) * divergence(Idag(A_DnBarSq * DnBar)); //contribution through DnBar
-			(*A_n) += Jdag(w * A_nBarTilde);
-		}
+			nEx_nBar->dataPref(), nEx_DnBarSq->dataPref());
+	}
+	void propagateGradient(const RadialFunctionG& w, double R, const ScalarField& nEx_nBar, const ScalarField& nEx_DnBarSq,
+		const VectorField& DnBar, const ScalarField& A_nEx, ScalarField& A_n)
+	{	ScalarFieldTilde A_nBarTilde = Idag(A_nEx * nEx_nBar); //contribution through nBar
+		ScalarField A_DnBarSq = A_nEx * nEx_DnBarSq;
+		A_nBarTilde -= (2.*R) * divergence(Idag(A_DnBarSq * DnBar)); //contribution through DnBar
+		A_n += Jdag(w * A_nBarTilde);
 	}
 }
 
@@ -242,6 +243,13 @@ namespace NonlinearPCMeval
 	{	threadLaunch(ScreeningPhiToState_sub, N, phi, s, xLookup, setState, muPlus, muMinus, kappaSq, *this);
 	}
 	
+	void ScreeningPhiToHessian_sub(size_t iStart, size_t iStop, const double* phi, const double* s, const RadialFunctionG& xLookup, double* kappaSq, double* kappaSqDiff, const Screening& eval)
+	{	for(size_t i=iStart; i<iStop; i++) eval.phiToHessian_calc(i, phi, s, xLookup, kappaSq, kappaSqDiff);
+	}
+	void Screening::phiToHessian(size_t N, const double* phi, const double* s, const RadialFunctionG& xLookup, double* kappaSq, double* kappaSqDiff) const
+	{	threadLaunch(ScreeningPhiToHessian_sub, N, phi, s, xLookup, kappaSq, kappaSqDiff, *this);
+	}
+	
 	
 	Dielectric::Dielectric(bool linear, double T, double Nmol, double pMol, double epsBulk, double epsInf)
 	: linear(linear), Np(Nmol * pMol), pByT(pMol/T), NT(Nmol * T),
@@ -277,5 +285,12 @@ namespace NonlinearPCMeval
 	void Dielectric::phiToState(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, bool setState, vector3<double*> eps, double* epsilon) const
 	{	threadLaunch(DielectricPhiToState_sub, N, Dphi, s, gLookup, setState, eps, epsilon, *this);
 	}
+	
+	void DielectricPhiToHessian_sub(size_t iStart, size_t iStop, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, double* epsilon, double* epsilonAniso, const Dielectric& eval)
+	{	for(size_t i=iStart; i<iStop; i++) eval.phiToHessian_calc(i, Dphi, s, gLookup, epsilon, epsilonAniso);
+	}
+	void Dielectric::phiToHessian(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, double* epsilon, double* epsilonAniso) const
+	{	threadLaunch(DielectricPhiToHessian_sub, N, Dphi, s, gLookup, epsilon, epsilonAniso, *this);
+	}
 
 }
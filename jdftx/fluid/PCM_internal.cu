@@ -29,7 +29,17 @@ namespace ShapeFunction
 	}
 	void compute_gpu(int N, const double* n, double* shape, const double nc, const double sigma)
 	{	GpuLaunchConfig1D glc(compute_kernel, N);
-		compute_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, n, shape, nc, sigma);
+		compute_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, shape, nc, sigma);
+		gpuErrorCheck();
+	}
+
+	__global__
+	void computeWithDerivative_kernel(int N, const double* n, double* shape, double* shape_n, const double nc, const double sigma)
+	{	int i = kernelIndex1D(); if(i<N) computeWithDerivative_calc(i, n, shape, shape_n, nc, sigma);
+	}
+	void computeWithDerivative_gpu(int N, const double* n, double* shape, double* shape_n, const double nc, const double sigma)
+	{	GpuLaunchConfig1D glc(computeWithDerivative_kernel, N);
+		computeWithDerivative_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, shape, shape_n, nc, sigma);
 		gpuErrorCheck();
 	}
 
@@ -39,7 +49,7 @@ namespace ShapeFunction
 	}
 	void propagateGradient_gpu(int N, const double* n, const double* grad_shape, double* grad_n, const double nc, const double sigma)
 	{	GpuLaunchConfig1D glc(propagateGradient_kernel, N);
-		propagateGradient_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, n, grad_shape, grad_n, nc, sigma);
+		propagateGradient_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, grad_shape, grad_n, nc, sigma);
 		gpuErrorCheck();
 	}
 }
@@ -59,7 +69,7 @@ namespace ShapeFunctionCANDLE
 		const double* A_shape, double* A_n, vector3<double*> A_Dn, vector3<double*> A_Dphi, double* A_pCavity,
 		const double nc, const double invSigmaSqrt2, const double pCavity)
 	{	GpuLaunchConfig1D glc(compute_or_grad_kernel, N);
-		compute_or_grad_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, grad, n, Dn, Dphi, shape, A_shape, A_n, A_Dn, A_Dphi, A_pCavity, nc, invSigmaSqrt2, pCavity);
+		compute_or_grad_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, grad, n, Dn, Dphi, shape, A_shape, A_n, A_Dn, A_Dphi, A_pCavity, nc, invSigmaSqrt2, pCavity);
 		gpuErrorCheck();
 	}
 }
@@ -72,7 +82,7 @@ namespace ShapeFunctionSGA13
 	}
 	void expandDensityHelper_gpu(int N, double alpha, const double* nBar, const double* DnBarSq, double* nEx, double* nEx_nBar, double* nEx_DnBarSq)
 	{	GpuLaunchConfig1D glc(expandDensityHelper_kernel, N);
-		expandDensityHelper_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, alpha, nBar, DnBarSq, nEx, nEx_nBar, nEx_DnBarSq);
+		expandDensityHelper_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, alpha, nBar, DnBarSq, nEx, nEx_nBar, nEx_DnBarSq);
 		gpuErrorCheck();
 	}
 }
@@ -90,7 +100,7 @@ namespace ShapeFunctionSoftSphere
 	{	GpuLaunchConfig3D glc(compute_kernel, S);
 		vector3<> Sinv(1./S[0], 1./S[1], 1./S[2]);
 		for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-			compute_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, Sinv, RTR, nAtoms, x, nReps, reps, radius, shape, sigmaInv);
+			compute_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, Sinv, RTR, nAtoms, x, nReps, reps, radius, shape, sigmaInv);
 		gpuErrorCheck();
 	}
 	
@@ -107,7 +117,7 @@ namespace ShapeFunctionSoftSphere
 	{	GpuLaunchConfig3D glc(propagateGradient_kernel, S);
 		vector3<> Sinv(1./S[0], 1./S[1], 1./S[2]);
 		for(int zBlock=0; zBlock<glc.zBlockMax; zBlock++)
-			propagateGradient_kernel<<<glc.nBlocks,glc.nPerBlock>>>(zBlock, S, Sinv, RTR, x, nReps, reps, radius, shape, E_shape, E_x, E_radius, sigmaInv);
+			propagateGradient_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(zBlock, S, Sinv, RTR, x, nReps, reps, radius, shape, E_shape, E_x, E_radius, sigmaInv);
 		gpuErrorCheck();
 	}
 }
@@ -120,7 +130,7 @@ namespace ShapeFunctionSCCS
 	}
 	void compute_gpu(int N, const double* n, double* shape, const double rhoMin, const double rhoMax, const double epsBulk)
 	{	GpuLaunchConfig1D glc(compute_kernel, N);
-		compute_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, n, shape, rhoMin, rhoMax, epsBulk);
+		compute_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, shape, rhoMin, rhoMax, epsBulk);
 		gpuErrorCheck();
 	}
 
@@ -130,7 +140,7 @@ namespace ShapeFunctionSCCS
 	}
 	void propagateGradient_gpu(int N, const double* n, const double* grad_shape, double* grad_n, const double rhoMin, const double rhoMax, const double epsBulk)
 	{	GpuLaunchConfig1D glc(propagateGradient_kernel, N);
-		propagateGradient_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, n, grad_shape, grad_n, rhoMin, rhoMax, epsBulk);
+		propagateGradient_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, n, grad_shape, grad_n, rhoMin, rhoMax, epsBulk);
 		gpuErrorCheck();
 	}
 }
@@ -144,7 +154,7 @@ namespace NonlinearPCMeval
 	}
 	void Screening::freeEnergy_gpu(size_t N, double mu0, const double* muPlus, const double* muMinus, const double* s, double* rho, double* A, double* A_muPlus, double* A_muMinus, double* A_s) const
 	{	GpuLaunchConfig1D glc(ScreeningFreeEnergy_kernel, N);
-		ScreeningFreeEnergy_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, mu0, muPlus, muMinus, s, rho, A, A_muPlus, A_muMinus, A_s, *this);
+		ScreeningFreeEnergy_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, mu0, muPlus, muMinus, s, rho, A, A_muPlus, A_muMinus, A_s, *this);
 		gpuErrorCheck();
 	}
 	
@@ -154,7 +164,7 @@ namespace NonlinearPCMeval
 	}
 	void Screening::convertDerivative_gpu(size_t N, double mu0, const double* muPlus, const double* muMinus, const double* s, const double* A_rho, double* A_muPlus, double* A_muMinus, double* A_s) const
 	{	GpuLaunchConfig1D glc(ScreeningConvertDerivative_kernel, N);
-		ScreeningConvertDerivative_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, mu0, muPlus, muMinus, s, A_rho, A_muPlus, A_muMinus, A_s, *this);
+		ScreeningConvertDerivative_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, mu0, muPlus, muMinus, s, A_rho, A_muPlus, A_muMinus, A_s, *this);
 		gpuErrorCheck();
 	}
 	
@@ -164,7 +174,17 @@ namespace NonlinearPCMeval
 	}
 	void Screening::phiToState_gpu(size_t N, const double* phi, const double* s, const RadialFunctionG& xLookup, bool setState, double* muPlus, double* muMinus, double* kappaSq) const
 	{	GpuLaunchConfig1D glc(ScreeningPhiToState_kernel, N);
-		ScreeningPhiToState_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, phi, s, xLookup, setState, muPlus, muMinus, kappaSq, *this);
+		ScreeningPhiToState_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, phi, s, xLookup, setState, muPlus, muMinus, kappaSq, *this);
+		gpuErrorCheck();
+	}
+	
+	__global__
+	void ScreeningPhiToHessian_kernel(size_t N, const double* phi, const double* s, const RadialFunctionG xLookup, double* kappaSq, double* kappaSqDiff, const Screening eval)
+	{	int i = kernelIndex1D(); if(i<N) eval.phiToHessian_calc(i, phi, s, xLookup, kappaSq, kappaSqDiff);
+	}
+	void Screening::phiToHessian_gpu(size_t N, const double* phi, const double* s, const RadialFunctionG& xLookup, double* kappaSq, double* kappaSqDiff) const
+	{	GpuLaunchConfig1D glc(ScreeningPhiToHessian_kernel, N);
+		ScreeningPhiToHessian_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, phi, s, xLookup, kappaSq, kappaSqDiff, *this);
 		gpuErrorCheck();
 	}
 	
@@ -174,7 +194,7 @@ namespace NonlinearPCMeval
 	}
 	void Dielectric::freeEnergy_gpu(size_t N, vector3<const double*> eps, const double* s, vector3<double*> p, double* A, vector3<double*> A_eps, double* A_s) const
 	{	GpuLaunchConfig1D glc(DielectricFreeEnergy_kernel, N);
-		DielectricFreeEnergy_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, eps, s, p, A, A_eps, A_s, *this);
+		DielectricFreeEnergy_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, eps, s, p, A, A_eps, A_s, *this);
 		gpuErrorCheck();
 	}
 	
@@ -184,7 +204,7 @@ namespace NonlinearPCMeval
 	}
 	void Dielectric::convertDerivative_gpu(size_t N, vector3<const double*> eps, const double* s, vector3<const double*> A_p, vector3<double*> A_eps, double* A_s) const
 	{	GpuLaunchConfig1D glc(DielectricConvertDerivative_kernel, N);
-		DielectricConvertDerivative_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, eps, s, A_p, A_eps, A_s, *this);
+		DielectricConvertDerivative_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, eps, s, A_p, A_eps, A_s, *this);
 		gpuErrorCheck();
 	}
 
@@ -194,7 +214,17 @@ namespace NonlinearPCMeval
 	}
 	void Dielectric::phiToState_gpu(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, bool setState, vector3<double*> eps, double* epsilon) const
 	{	GpuLaunchConfig1D glc(DielectricPhiToState_kernel, N);
-		DielectricPhiToState_kernel<<<glc.nBlocks,glc.nPerBlock>>>(N, Dphi, s, gLookup, setState, eps, epsilon, *this);
+		DielectricPhiToState_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, Dphi, s, gLookup, setState, eps, epsilon, *this);
+		gpuErrorCheck();
+	}
+	
+	__global__
+	void DielectricPhiToHessian_kernel(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG gLookup, double* epsilon, double* epsilonAniso, const Dielectric eval)
+	{	int i = kernelIndex1D(); if(i<N) eval.phiToHessian_calc(i, Dphi, s, gLookup, epsilon, epsilonAniso);
+	}
+	void Dielectric::phiToHessian_gpu(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, double* epsilon, double* epsilonAniso) const
+	{	GpuLaunchConfig1D glc(DielectricPhiToHessian_kernel, N);
+		DielectricPhiToHessian_kernel<<<glc.nBlocks, glc.nPerBlock, 0, gpuStream>>>(N, Dphi, s, gLookup, epsilon, epsilonAniso, *this);
 		gpuErrorCheck();
 	}
 }
@@ -40,6 +40,10 @@ namespace ShapeFunction
 	//! Compute the shape function (0 to 1) given the cavity-determining electron density
 	void compute(const ScalarField& n, ScalarField& shape, double nc, double sigma);
 
+	//! Compute the shape function and its derivative shape_n w.r.t the cavity-determining electron density in one pass
+	//! (so that gradients can later be propagated as E_n += E_shape * shape_n)
+	void compute(const ScalarField& n, ScalarField& shape, ScalarField& shape_n, double nc, double sigma);
+
 	//! Propagate gradient w.r.t shape function to that w.r.t cavity-determining electron density (accumulate to E_n)
 	void propagateGradient(const ScalarField& n, const ScalarField& E_shape, ScalarField& E_n, double nc, double sigma);
 }
@@ -47,20 +51,27 @@ namespace ShapeFunction
 //! Shape function in CANDLE \cite CANDLE
 namespace ShapeFunctionCANDLE
 {
-	//! Compute shape function that includes charge asymmetry from cavity-determining electron density and vacuum electric potential
-	void compute(const ScalarField& n, const ScalarFieldTilde& phi,
+	//! Compute shape function that includes charge asymmetry from cavity-determining electron density n (with gradient Dn)
+	//! and the gradient Dphi of the vacuum electric potential (gradients shared with propagateGradient to avoid recomputing them)
+	void compute(const ScalarField& n, const VectorField& Dn, const VectorField& Dphi,
 		ScalarField& shape, double nc, double sigma, double pCavity);
 	
 	//! Propagate gradients w.r.t shape function to n, phi and pCavity (accumulate to E_n, E_phi, E_pCavity)
-	void propagateGradient(const ScalarField& n, const ScalarFieldTilde& phi, const ScalarField& E_shape,
+	void propagateGradient(const ScalarField& n, const VectorField& Dn, const VectorField& Dphi, const ScalarField& E_shape,
 		ScalarField& E_n, ScalarFieldTilde& E_phi, double& E_pCavity, double nc, double sigma, double pCavity);
 }
 
 //! Shape function for \cite CavityWDA
 namespace ShapeFunctionSGA13
 {
-	//! Compute expanded density nEx from n, and optionally propagate gradients from nEx to n (accumulate to A_n)
-	void expandDensity(const RadialFunctionG& w, double R, const ScalarField& n, ScalarField& nEx, const ScalarField* A_nEx=0, ScalarField* A_n=0);
+	//! Compute expanded density nEx from n, along with the intermediates required by propagateGradient:
+	//! derivatives nEx_nBar and nEx_DnBarSq w.r.t the weighted density and its square gradient, and the weighted density gradient DnBar
+	void expandDensity(const RadialFunctionG& w, double R, const ScalarField& n, ScalarField& nEx,
+		ScalarField& nEx_nBar, ScalarField& nEx_DnBarSq, VectorField& DnBar);
+	
+	//! Propagate gradients from nEx to n (accumulate to A_n), using the intermediates from expandDensity
+	void propagateGradient(const RadialFunctionG& w, double R, const ScalarField& nEx_nBar, const ScalarField& nEx_DnBarSq,
+		const VectorField& DnBar, const ScalarField& A_nEx, ScalarField& A_n);
 }
 
 //! Shape function for the soft-sphere model \cite PCM-SoftSphere
@@ -112,6 +123,11 @@ namespace ShapeFunction
 	{	grad_nCavity[i] += (-1.0/(nc*sigma*sqrt(2*M_PI))) * grad_shape[i]
 			* exp(0.5*(pow(sigma,2) - pow(log(fabs(nCavity[i])/nc)/sigma + sigma, 2)));
 	}
+	__hostanddev__ void computeWithDerivative_calc(int i, const double* nCavity, double* shape, double* shape_n, const double nc, const double sigma)
+	{	double lognByNc = log(fabs(nCavity[i])/nc);
+		shape[i] = erfc(sqrt(0.5)*lognByNc/sigma)*0.5;
+		shape_n[i] = (-1.0/(nc*sigma*sqrt(2*M_PI))) * exp(0.5*(pow(sigma,2) - pow(lognByNc/sigma + sigma, 2)));
+	}
 }
 
 namespace ShapeFunctionCANDLE
@@ -328,6 +344,26 @@ namespace NonlinearPCMeval
 			return f;
 		}
 		
+		//! Hard sphere free energy per particle and its first two derivatives, where x is total packing fraction
+		__hostanddev__ double fHS(double xIn, double& f_xIn, double& f_xInxIn) const
+		{	double x = xIn, x_xIn = 1., x_xInxIn = 0.;
+			if(xIn > 0.5) //soft packing: remap [0.5,infty) on to [0.5,1)
+			{	double xInInv = 1./xIn;
+				x = 1.-0.25*xInInv;
+				x_xIn = 0.25*xInInv*xInInv;
+				x_xInxIn = -0.5*xInInv*xInInv*xInInv;
+			}
+			double den = 1./(1-x), den0 = 1./(1-x0);
+			double comb = (x-x0)*den*den0, comb_x = den*den, comb_xx = 2.*den*den*den;
+			double prefac = (2./x0);
+			double f = prefac * comb*comb;
+			double f_x = prefac * 2.*comb*comb_x;
+			double f_xx = prefac * 2.*(comb_x*comb_x + comb*comb_xx);
+			f_xIn = f_x * x_xIn;
+			f_xInxIn = f_xx * x_xIn*x_xIn + f_x * x_xInxIn;
+			return f;
+		}
+		
 		//! Compute the nonlinear functions in the free energy and charge density prior to scaling by shape function
 		//! Note that each mu here is mu(r) + mu0, i.e. after imposing charge neutrality constraint
 		__hostanddev__ void compute(double muPlus, double muMinus, double& F, double& F_muPlus, double& F_muMinus, double& Rho, double& Rho_muPlus, double& Rho_muMinus) const
@@ -428,6 +464,29 @@ namespace NonlinearPCMeval
 		#ifdef GPU_ENABLED
 		void phiToState_gpu(size_t N, const double* phi, const double* s, const RadialFunctionG& xLookup, bool setState, double* muPlus, double* muMinus, double* kappaSq) const;
 		#endif
+		
+		//! Given shape function s and phi, calculate effective kappaSq (as in phiToState) and the differential kappaSqDiff = -4 pi drho/dphi
+		//! (including the self-consistent response of the packing fraction), for Hessian-vector products of the nonlinear Poisson-Boltzmann operator
+		__hostanddev__ void phiToHessian_calc(size_t i, const double* phi, const double* s, const RadialFunctionG& xLookup, double* kappaSq, double* kappaSqDiff) const
+		{	double V = ZbyT * phi[i];
+			if(fabs(V) < 1e-7) V = copysign(1e-7, V); //Avoid V=0 in calculating kappaSq below
+			double twoCbrtV= 2.*pow(fabs(V), 1./3);
+			double Vmapped = copysign(twoCbrtV / (1. + sqrt(1. + twoCbrtV*twoCbrtV)), V);
+			double xMapped = xLookup(1.+Vmapped);
+			double x = 1./xMapped - 1.;
+			double f_x, f_xx; fHS(x, f_x, f_xx); //hard sphere potential and its derivative
+			double etaPlus = exp(-V - f_x*x0plus);
+			double etaMinus = exp(+V - f_x*x0minus);
+			kappaSq[i] = (4*M_PI)*s[i]*(NZ*ZbyT)*(etaMinus - etaPlus)/V;
+			//Derivative of the self-consistent packing fraction x = x0plus etaPlus + x0minus etaMinus w.r.t V:
+			double x_V = (x0minus*etaMinus - x0plus*etaPlus) / (1. + f_xx*(x0plus*x0plus*etaPlus + x0minus*x0minus*etaMinus));
+			double rho_V = etaPlus*(-1. - f_xx*x0plus*x_V) - etaMinus*(1. - f_xx*x0minus*x_V); //derivative of etaPlus - etaMinus
+			kappaSqDiff[i] = -(4*M_PI)*s[i]*(NZ*ZbyT)*rho_V;
+		}
+		void phiToHessian(size_t N, const double* phi, const double* s, const RadialFunctionG& xLookup, double* kappaSq, double* kappaSqDiff) const;
+		#ifdef GPU_ENABLED
+		void phiToHessian_gpu(size_t N, const double* phi, const double* s, const RadialFunctionG& xLookup, double* kappaSq, double* kappaSqDiff) const;
+		#endif
 
 	};
 	
@@ -547,6 +606,26 @@ namespace NonlinearPCMeval
 		#ifdef GPU_ENABLED
 		void phiToState_gpu(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, bool setState, vector3<double*> eps, double* epsilon) const;
 		#endif
+		
+		//! Given shape function s and gradient of phi Dphi, calculate effective epsilon (as in phiToState) and epsilonAniso,
+		//! such that the differential dielectric tensor dD/dE = epsilon + epsilonAniso Dphi Dphi^T (for Hessian-vector products)
+		__hostanddev__ void phiToHessian_calc(size_t i, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, double* epsilon, double* epsilonAniso) const
+		{	vector3<> DphiVec = loadVector(Dphi, i);
+			double DphiSq = DphiVec.length_squared();
+			double x = pByT * sqrt(DphiSq);
+			double g = gLookup(x/(1.+x));
+			double prefac = (4*M_PI)*s[i]*(Np*pByT);
+			epsilon[i] = 1. + prefac*((g-1.)/alpha + X);
+			//x dg/dx = 1/(dx/deps) - g, where eps = g x and x = eps (1 - alpha frac(eps)):
+			double eps = g*x, frac, frac_epsSqHlf, logsinch;
+			calcFunctions(eps, frac, frac_epsSqHlf, logsinch);
+			double x_eps = 1. - alpha*(frac + eps*eps*frac_epsSqHlf);
+			epsilonAniso[i] = (DphiSq > 1e-16) ? (prefac/alpha) * (1./x_eps - g) / DphiSq : 0.;
+		}
+		void phiToHessian(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, double* epsilon, double* epsilonAniso) const;
+		#ifdef GPU_ENABLED
+		void phiToHessian_gpu(size_t N, vector3<const double*> Dphi, const double* s, const RadialFunctionG& gLookup, double* epsilon, double* epsilonAniso) const;
+		#endif
 	};
 }
 
@@ -159,4 +159,9 @@ void SO3quad::setup(const S2quad& s2quad, const Molecule& molecule)
 		rmsErr = sqrt(rmsErr/nEquations);
 		logPrintf("Done (MaxError~%.0le, RMSerror~%.0le.)\n", maxErr, rmsErr); logFlush();
 	}
+	
+	//Precompute rotation matrices (used by every orientation loop of the ideal gas):
+	rotationTable.resize(nOrientations());
+	for(int o=0; o<nOrientations(); o++)
+		rotationTable[o] = matrixFromEuler(euler(o));
 }
@@ -24,6 +24,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 //! @{
 
 #include <fluid/S2quad.h>
+#include <core/matrix3.h>
 struct Molecule;
 
 //! @brief Quadrature for SO(3)
@@ -41,12 +42,14 @@ public:
 	int nOrientations() const; //!< get cardinality of sampling set
 	vector3<> euler(int iOrientation) const; //!< get euler angles for the iOrientation'th node
 	double weight(int iOrientation) const; //!< get weight for the iOrientation'th node
+	const std::vector<matrix3<>>& rotations() const { return rotationTable; } //!< rotation matrices of all nodes (precomputed from the euler angles)
 
 private:
 	int nS1byZn; //!< actual number of S1 samples (reduced by symmetry)
 	int nS1; //!< effective number of S1 samples (counting symmetric images)
 	std::vector<vector3<> > eulerS2; //!< S2 quadrature points
 	std::vector<double> weightS2; //!< S2 quadrature weights
+	std::vector<matrix3<>> rotationTable; //!< rotation matrix for each orientation
 	void setup(const S2quad&, const Molecule& molecule); //!< Initialize SO3 quadrature from an S2 quadrature decsription
 };
 
@@ -179,6 +179,20 @@ SaLSA::SaLSA(const Everything& e, const FluidSolverParams& fsp)
 	
 	//MPI division:
 	TaskDivision(response.size(), mpiWorld).myRange(rStart, rStop);
+	
+	//Cache the reciprocal-space kernels of local responses, so that chi only needs elementwise multiplies
+	//(these depend only on the grid, and hence remain valid across cavity updates, SCF and ionic steps):
+	ScalarFieldTilde unit(ScalarFieldTildeData::alloc(gInfo));
+	complex* unitData = unit->data();
+	for(int i=0; i<gInfo.nG; i++) unitData[i] = 1.;
+	for(int r=rStart; r<rStop; r++)
+	{	const MultipoleResponse& resp = *response[r];
+		if(resp.l>6) die("Angular momenta l > 6 not supported.\n");
+		kernelOffset.push_back(responseKernel.size());
+		ScalarFieldTildeArray K = lGradient(resp.V * unit, resp.l);
+		responseKernel.insert(responseKernel.end(), K.begin(), K.end());
+	}
+	kernelOffset.push_back(responseKernel.size());
 }
 
 SaLSA::~SaLSA()
@@ -187,14 +201,31 @@ SaLSA::~SaLSA()
 }
 
 
+ScalarFieldArray SaLSA::applyKernels(const ScalarFieldTilde& phiTilde) const
+{	ScalarFieldTildeArray KphiTilde(responseKernel.size());
+	for(size_t j=0; j<responseKernel.size(); j++)
+		KphiTilde[j] = responseKernel[j] * phiTilde;
+	return I(std::move(KphiTilde)); //all responses and m transformed together
+}
+
 ScalarFieldTilde SaLSA::chi(const ScalarFieldTilde& phiTilde) const
-{	ScalarFieldTilde rhoTilde;
+{	//Multiply by shape functions in real space:
+	ScalarFieldArray sKphi = applyKernels(phiTilde);
+	for(int r=rStart; r<rStop; r++)
+	{	const ScalarField& s = response[r]->selectSite(shape, siteShape);
+		for(int j=kernelOffset[r-rStart]; j<kernelOffset[r-rStart+1]; j++)
+			sKphi[j] *= s;
+	}
+	ScalarFieldTildeArray sKphiTilde = J(sKphi); sKphi.clear();
+	//Apply kernel again (equivalent to lDivergence and V) and collect:
+	ScalarFieldTilde rhoTilde;
 	for(int r=rStart; r<rStop; r++)
 	{	const MultipoleResponse& resp = *response[r];
-		const ScalarField& s = resp.selectSite(shape, siteShape);
-		if(resp.l>6) die("Angular momenta l > 6 not supported.\n");
 		double prefac = pow(-1,resp.l) * 4*M_PI/(2*resp.l+1);
-		rhoTilde -= prefac * (resp.V * lDivergence(J(s * I(lGradient(resp.V * phiTilde, resp.l))), resp.l));
+		for(int j=kernelOffset[r-rStart]; j<kernelOffset[r-rStart+1]; j++)
+		{	sKphiTilde[j] *= responseKernel[j];
+			rhoTilde -= prefac * sKphiTilde[j];
+		}
 	}
 	nullToZero(rhoTilde, gInfo); rhoTilde->allReduceData(mpiWorld, MPIUtil::ReduceSum);
 	return rhoTilde;
@@ -260,15 +291,15 @@ double SaLSA::get_Adiel_and_grad_internal(ScalarFieldTilde& Adiel_rhoExplicitTil
 	//The "cavity" gradient is computed by chain rule via the gradient w.r.t to the shape function:
 	const auto& solvent = fsp.solvents[0];
 	ScalarFieldArray Adiel_shape(shape.size()); ScalarFieldArray Adiel_siteShape(solvent->molecule.sites.size());
+	ScalarFieldArray IlGradVphi = applyKernels(phi);
 	for(int r=rStart; r<rStop; r++)
 	{	const MultipoleResponse& resp = *response[r];
 		ScalarField& Adiel_s = resp.selectSite(Adiel_shape, Adiel_siteShape);
-		if(resp.l>6) die("Angular momenta l > 6 not supported.\n");
 		double prefac = 0.5 * 4*M_PI/(2*resp.l+1);
-		ScalarFieldArray IlGradVphi = I(lGradient(resp.V * phi, resp.l));
-		for(int lpm=0; lpm<(2*resp.l+1); lpm++)
-			Adiel_s -= prefac * (IlGradVphi[lpm]*IlGradVphi[lpm]);
+		for(int j=kernelOffset[r-rStart]; j<kernelOffset[r-rStart+1]; j++)
+			Adiel_s -= prefac * (IlGradVphi[j]*IlGradVphi[j]);
 	}
+	IlGradVphi.clear();
 	for(unsigned iSite=0; iSite<solvent->molecule.sites.size(); iSite++)
 		if(Adiel_siteShape[iSite])
 			Adiel_shape[0] += I(Sf[iSite] * J(Adiel_siteShape[iSite]));
@@ -296,6 +327,14 @@ void SaLSA::saveState(const char* filename) const
 {	if(mpiWorld->isHead()) saveRawBinary(I(state), filename); //saved data is in real space
 }
 
+void SaLSA::getStateFields(ScalarFieldArray& fields) const
+{	if(state) fields.assign(1, I(state));
+}
+
+void SaLSA::setStateFields(const ScalarFieldArray& fields)
+{	state = J(fields[0]);
+}
+
 void SaLSA::dumpDensities(const char* filenamePattern) const
 {	PCM::dumpDensities(filenamePattern);
 	
@@ -47,10 +47,15 @@ public:
 protected:
 	void set_internal(const ScalarFieldTilde& rhoExplicitTilde, const ScalarFieldTilde& nCavityTilde);
 	double get_Adiel_and_grad_internal(ScalarFieldTilde& grad_rhoExplicitTilde, ScalarFieldTilde& grad_nCavityTilde, IonicGradient* extraForces) const;
+	void getStateFields(ScalarFieldArray& fields) const;
+	void setStateFields(const ScalarFieldArray& fields);
 
 private:
 	std::vector< std::shared_ptr<struct MultipoleResponse> > response; //array of multipolar components in chi
 	int rStart, rStop; //MPI division of response array
+	ScalarFieldTildeArray responseKernel; //cached reciprocal-space kernels V(G) Ylm(Ghat) (iG)^l for each local response and m (depend only on the grid)
+	std::vector<int> kernelOffset; //offset of each local response's kernels in responseKernel (with an end marker)
+	ScalarFieldArray applyKernels(const ScalarFieldTilde& phiTilde) const; //real-space (lGradient(V phi)) for all local responses and m
 	RadialFunctionG nFluid; //electron density model for the fluid
 	RadialFunctionG Kkernel; ScalarField epsInv; //for preconditioner
 	ScalarFieldArray siteShape; //shape functions for sites
@@ -20,12 +20,72 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <fluid/TranslationOperator.h>
 #include <fluid/TranslationOperator_internal.h>
 #include <core/Operators.h>
+#include <core/ScalarFieldArray.h>
 
 
 TranslationOperator::TranslationOperator(const GridInfo& gInfo) : gInfo(gInfo)
 {
 }
 
+//Group coincident translations: returns the distinct translations, and sets iUnique[j] to the index of the distinct translation of t[j]
+std::vector<vector3<>> uniqueTranslations(const GridInfo& gInfo, const std::vector<vector3<>>& t, std::vector<int>& iUnique)
+{	std::vector<vector3<>> tUnique;
+	iUnique.resize(t.size());
+	double tolSq = 1e-16 * trace(gInfo.RTR);
+	for(size_t j=0; j<t.size(); j++)
+	{	iUnique[j] = -1;
+		for(size_t u=0; u<tUnique.size(); u++)
+			if((t[j]-tUnique[u]).length_squared() < tolSq)
+			{	iUnique[j] = u;
+				break;
+			}
+		if(iUnique[j] < 0)
+		{	iUnique[j] = tUnique.size();
+			tUnique.push_back(t[j]);
+		}
+	}
+	return tUnique;
+}
+
+void TranslationOperator::taxpyMulti(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const
+{	std::vector<int> iUnique;
+	std::vector<vector3<>> tUnique = uniqueTranslations(gInfo, t, iUnique);
+	if(tUnique.size() == t.size())
+	{	taxpyMulti_internal(t, alpha, x, y);
+		return;
+	}
+	//Translate once for each distinct translation, and then distribute:
+	ScalarFieldArray yUnique(tUnique.size());
+	taxpyMulti_internal(tUnique, 1., x, yUnique.data());
+	for(size_t j=0; j<t.size(); j++)
+		y[j] += alpha * yUnique[iUnique[j]];
+}
+
+void TranslationOperator::taxpySum(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const
+{	std::vector<int> iUnique;
+	std::vector<vector3<>> tUnique = uniqueTranslations(gInfo, t, iUnique);
+	if(tUnique.size() == t.size())
+	{	taxpySum_internal(t, alpha, x, y);
+		return;
+	}
+	//Sum sources for each distinct translation, and then translate once:
+	ScalarFieldArray xUnique(tUnique.size());
+	for(size_t j=0; j<t.size(); j++)
+		xUnique[iUnique[j]] += x[j];
+	taxpySum_internal(tUnique, alpha, xUnique.data(), y);
+}
+
+void TranslationOperator::taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const
+{	for(size_t j=0; j<t.size(); j++)
+		taxpy(t[j], alpha, x, y[j]);
+}
+
+void TranslationOperator::taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const
+{	for(size_t j=0; j<t.size(); j++)
+		taxpy(t[j], alpha, x[j], y);
+}
+
+
 TranslationOperatorSpline::TranslationOperatorSpline(const GridInfo& gInfo, SplineType splineType)
 : TranslationOperator(gInfo), splineType(splineType)
 {
@@ -45,13 +105,10 @@ void constantSplineTaxpy_gpu(const vector3<int> S,
 void linearSplineTaxpy_gpu(const vector3<int> S,
 	double alpha, const double* x, double* y, const vector3<int> Tint, const vector3<> Tfrac);
 #endif
-void TranslationOperatorSpline::taxpy(const vector3<>& t, double alpha, const ScalarField& x, ScalarField& y) const
+void TranslationOperatorSpline::getOffsets(const vector3<>& t, vector3<int>& Tint, vector3<>& Tfrac) const
 {	//Perform a gather with the inverse translation (hence negate t),
 	//instead of scatter which is less efficient to parallelize
-	vector3<> Tfrac = Diag(gInfo.S) * inv(gInfo.R) * (-t); //now in grid point units
-	vector3<int> Tint;
-	//Prepare output:
-	nullToZero(y, gInfo);
+	Tfrac = Diag(gInfo.S) * inv(gInfo.R) * (-t); //now in grid point units
 	switch(splineType)
 	{	case Constant:
 		{	for(int k=0; k<3; k++)
@@ -61,12 +118,7 @@ void TranslationOperatorSpline::taxpy(const vector3<>& t, double alpha, const Sc
 				Tint[k] = Tint[k] % gInfo.S[k];
 				if(Tint[k]<0) Tint[k] += gInfo.S[k];
 			}
-			//Launch threads/gpu kernels:
-			#ifdef GPU_ENABLED
-			constantSplineTaxpy_gpu(gInfo.S, alpha*x->scale, x->dataGpu(false), y->dataGpu(), Tint);
-			#else
-			threadLaunch(constantSplineTaxpy_sub, gInfo.nr, gInfo.S, alpha*x->scale, x->data(false), y->data(), Tint);
-			#endif
+			Tfrac = vector3<>();
 			break;
 		}
 		case Linear:
@@ -79,19 +131,104 @@ void TranslationOperatorSpline::taxpy(const vector3<>& t, double alpha, const Sc
 				Tfrac[k] -= Tint[k];
 				Tint[k] = Tint[k] % gInfo.S[k];
 			}
-			//Launch threads/gpu kernels:
+			break;
+		}
+	}
+}
+
+void TranslationOperatorSpline::taxpy(const vector3<>& t, double alpha, const ScalarField& x, ScalarField& y) const
+{	static StopWatch watch("TranslationOperator::taxpy");
+	vector3<int> Tint; vector3<> Tfrac;
+	getOffsets(t, Tint, Tfrac);
+	//Prepare output:
+	nullToZero(y, gInfo);
+	//Launch threads/gpu kernels:
+	watch.start();
+	switch(splineType)
+	{	case Constant:
+			watch.addWork(2.*gInfo.nr, 24.*gInfo.nr); //axpy; read x and read-write y once
+			#ifdef GPU_ENABLED
+			constantSplineTaxpy_gpu(gInfo.S, alpha*x->scale, x->dataGpu(false), y->dataGpu(), Tint);
+			#else
+			threadLaunch(constantSplineTaxpy_sub, gInfo.nr, gInfo.S, alpha*x->scale, x->data(false), y->data(), Tint);
+			#endif
+			break;
+		case Linear:
+			watch.addWork(30.*gInfo.nr, 24.*gInfo.nr); //multiply-adds over 8, 4 and 2 points and an axpy; neighbours of x from cache
 			#ifdef GPU_ENABLED
 			linearSplineTaxpy_gpu(gInfo.S, alpha*x->scale, x->dataGpu(false), y->dataGpu(), Tint, Tfrac);
 			#else
 			threadLaunch(linearSplineTaxpy_sub, gInfo.nr, gInfo.S, alpha*x->scale, x->data(false), y->data(), Tint, Tfrac);
 			#endif
 			break;
+	}
+	watch.stop();
+}
+
+#ifdef GPU_ENABLED
+//Batched versions simply loop over the single-translation kernels on the GPU:
+void TranslationOperatorSpline::taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const
+{	TranslationOperator::taxpyMulti_internal(t, alpha, x, y);
+}
+void TranslationOperatorSpline::taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const
+{	TranslationOperator::taxpySum_internal(t, alpha, x, y);
+}
+#else
+//Translation offsets and data pointers for one term of a batched spline translation
+struct SplineTerm
+{	vector3<int> Tint; vector3<> Tfrac;
+	double alpha;
+	const double* x;
+	double* y;
+};
+
+//Process the grid in blocks small enough that the output (taxpySum) or the neighbourhood
+//of the input being gathered from (taxpyMulti) stays in cache across all the terms:
+const size_t splineBlockSize = 2048;
+void splineTaxpyBatch_sub(size_t iStart, size_t iStop, const vector3<int> S, bool linear, const std::vector<SplineTerm>* terms)
+{	for(size_t iBlockStart=iStart; iBlockStart<iStop; iBlockStart+=splineBlockSize)
+	{	size_t iBlockStop = std::min(iBlockStart+splineBlockSize, iStop);
+		for(const SplineTerm& term: *terms)
+		{	if(linear)
+			{	linearSplineTaxpy_sub(iBlockStart, iBlockStop, S, term.alpha, term.x, term.y, term.Tint, term.Tfrac);
+			}
+			else
+			{	constantSplineTaxpy_sub(iBlockStart, iBlockStop, S, term.alpha, term.x, term.y, term.Tint);
+			}
 		}
 	}
 }
 
-TranslationOperatorFourier::TranslationOperatorFourier(const GridInfo& gInfo)
-: TranslationOperator(gInfo)
+void TranslationOperatorSpline::taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const
+{	std::vector<SplineTerm> terms(t.size());
+	for(size_t j=0; j<t.size(); j++)
+	{	SplineTerm& term = terms[j];
+		getOffsets(t[j], term.Tint, term.Tfrac);
+		nullToZero(y[j], gInfo);
+		term.alpha = alpha * x->scale;
+		term.x = x->data(false);
+		term.y = y[j]->data(); //absorbs scale factor of y[j]
+	}
+	threadLaunch(splineTaxpyBatch_sub, gInfo.nr, gInfo.S, splineType==Linear, &terms);
+}
+
+void TranslationOperatorSpline::taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const
+{	nullToZero(y, gInfo);
+	double* yData = y->data(); //absorbs scale factor of y
+	std::vector<SplineTerm> terms(t.size());
+	for(size_t j=0; j<t.size(); j++)
+	{	SplineTerm& term = terms[j];
+		getOffsets(t[j], term.Tint, term.Tfrac);
+		term.alpha = alpha * x[j]->scale;
+		term.x = x[j]->data(false);
+		term.y = yData;
+	}
+	threadLaunch(splineTaxpyBatch_sub, gInfo.nr, gInfo.S, splineType==Linear, &terms);
+}
+#endif
+
+TranslationOperatorFourier::TranslationOperatorFourier(const GridInfo& gInfo, bool cachePhases)
+: TranslationOperator(gInfo), cachePhases(cachePhases)
 {
 }
 inline void fourierTranslate_sub(size_t iStart, size_t iStop, const vector3<int> S, const vector3<> Gt, complex* xTilde)
@@ -100,12 +237,60 @@ inline void fourierTranslate_sub(size_t iStart, size_t iStop, const vector3<int>
 #ifdef GPU_ENABLED //implemented in TranslationOperator.cu
 void fourierTranslate_gpu(const vector3<int> S, const vector3<> Gt, complex* xTilde);
 #endif
+void TranslationOperatorFourier::translate(const vector3<>& t, ScalarFieldTilde& xTilde) const
+{	if(cachePhases)
+	{	//Find or compute the phase factors for this translation:
+		const ScalarFieldTilde* phase = 0;
+		for(const auto& entry: phaseCache)
+			if(entry.first == t)
+			{	phase = &entry.second;
+				break;
+			}
+		if(!phase)
+		{	ScalarFieldTilde phaseNew(ScalarFieldTildeData::alloc(gInfo));
+			complex* phaseData = phaseNew->data();
+			for(int i=0; i<gInfo.nG; i++) phaseData[i] = 1.;
+			#ifdef GPU_ENABLED
+			fourierTranslate_gpu(gInfo.S, gInfo.G*t, phaseNew->dataGpu());
+			#else
+			threadLaunch(fourierTranslate_sub, gInfo.nG, gInfo.S, gInfo.G*t, phaseNew->data());
+			#endif
+			phaseCache.push_back(std::make_pair(t, phaseNew));
+			phase = &phaseCache.back().second;
+		}
+		xTilde *= *phase;
+	}
+	else
+	{
+		#ifdef GPU_ENABLED
+		fourierTranslate_gpu(gInfo.S, gInfo.G*t, xTilde->dataGpu(false));
+		#else
+		threadLaunch(fourierTranslate_sub, gInfo.nG, gInfo.S, gInfo.G*t, xTilde->data(false));
+		#endif
+	}
+}
+
 void TranslationOperatorFourier::taxpy(const vector3<>& t, double alpha, const ScalarField& x, ScalarField& y) const
 {	ScalarFieldTilde xTilde = J(x);
-	#ifdef GPU_ENABLED
-	fourierTranslate_gpu(gInfo.S, gInfo.G*t, xTilde->dataGpu(false));
-	#else
-	threadLaunch(fourierTranslate_sub, gInfo.nG, gInfo.S, gInfo.G*t, xTilde->data(false));
-	#endif
+	translate(t, xTilde);
 	y += alpha*I(xTilde);
 }
+
+void TranslationOperatorFourier::taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const
+{	ScalarFieldTilde xTilde = J(x); //shared forward transform
+	for(size_t j=0; j<t.size(); j++)
+	{	ScalarFieldTilde xTilde_j = clone(xTilde);
+		translate(t[j], xTilde_j);
+		y[j] += alpha*I(xTilde_j);
+	}
+}
+
+void TranslationOperatorFourier::taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const
+{	ScalarFieldTilde yTilde;
+	for(size_t j=0; j<t.size(); j++)
+	{	ScalarFieldTilde xTilde_j = J(x[j]);
+		translate(t[j], xTilde_j);
+		yTilde += xTilde_j;
+	}
+	y += alpha*I(yTilde); //shared inverse transform
+}
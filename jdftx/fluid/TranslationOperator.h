@@ -26,6 +26,7 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <core/GridInfo.h>
 #include <core/ScalarField.h>
+#include <vector>
 
 //! Abstract base class for translation operators
 class TranslationOperator
@@ -41,6 +42,20 @@ public:
 	//! T must conserve integral(x) and satisfy @f$ T^{\dagger}_t = T_{-t} @f$ exactly for gradient correctness
 	//! Note that @f$ T^{-1}_t = T_{-t} @f$ may only be approximately true for some implementations.
 	virtual void taxpy(const vector3<>& t, double alpha, const ScalarField& x, ScalarField& y) const=0;
+	
+	//! Compute @f$ y_j += alpha T_{t_j}(x) @f$ for all j (one source, several translations and outputs).
+	//! Outputs with coincident translations share a single translation of x.
+	void taxpyMulti(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const;
+	
+	//! Compute @f$ y += alpha \sum_j T_{t_j}(x_j) @f$ (several sources and translations, one output),
+	//! the adjoint of taxpyMulti(). Sources with coincident translations are summed before translation.
+	void taxpySum(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const;
+	
+protected:
+	//! Implementations of taxpyMulti() and taxpySum() for distinct translations,
+	//! which default to a loop over taxpy(), and may be overridden to process all translations in one pass
+	virtual void taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const;
+	virtual void taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const;
 };
 
 //! Translation operator which works in real space using interpolating splines
@@ -55,14 +70,32 @@ public:
 
 	TranslationOperatorSpline(const GridInfo& gInfo, SplineType splineType);
 	void taxpy(const vector3<>& t, double alpha, const ScalarField& x, ScalarField& y) const;
+
+protected:
+	//Cache-blocked versions that sweep over the grid once for all translations:
+	void taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const;
+	void taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const;
+private:
+	void getOffsets(const vector3<>& t, vector3<int>& Tint, vector3<>& Tfrac) const; //!< integer and fractional grid offsets for translation t
 };
 
 //! The exact translation operator in PW basis, although much slower and with potential ringing issues
 class TranslationOperatorFourier : public TranslationOperator
 {
 public:
-	TranslationOperatorFourier(const GridInfo& gInfo);
+	//! If cachePhases, the reciprocal-space phase factors are stored for each distinct translation
+	//! on first use, trading memory (one complex reciprocal-space grid per translation) for speed
+	TranslationOperatorFourier(const GridInfo& gInfo, bool cachePhases=false);
 	void taxpy(const vector3<>& t, double alpha, const ScalarField& x, ScalarField& y) const;
+
+protected:
+	//Versions that share the forward (taxpyMulti) or inverse (taxpySum) transform over all translations:
+	void taxpyMulti_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField& x, ScalarField* y) const;
+	void taxpySum_internal(const std::vector<vector3<>>& t, double alpha, const ScalarField* x, ScalarField& y) const;
+private:
+	bool cachePhases;
+	mutable std::vector<std::pair<vector3<>,ScalarFieldTilde>> phaseCache; //!< phase factors for each translation (if cachePhases)
+	void translate(const vector3<>& t, ScalarFieldTilde& xTilde) const; //!< apply translation to xTilde in place
 };
 
 //! @}
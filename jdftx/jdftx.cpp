@@ -25,28 +25,73 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 #include <electronic/LatticeMinimizer.h>
 #include <electronic/Vibrations.h>
 #include <electronic/IonDynamics.h>
+#include <electronic/NudgedElasticBand.h>
 #include <fluid/FluidSolver.h>
 #include <core/Util.h>
 #include <commands/parser.h>
 
-//Program entry point
-int main(int argc, char** argv)
-{	//Parse command line, initialize system and logs:
-	Everything e; //the parent data structure for, well, everything
-	InitParams ip("Performs Joint Density Functional Theory calculations.", &e);
-	initSystemCmdline(argc, argv, ip);
-	
-	//Parse input file and setup
-	ElecVars& eVars = e.eVars;
-	parse(readInputFile(ip.inputFilename), e, ip.printDefaults);
-	if(ip.dryRun) eVars.skipWfnsInit = true;
+//Run the ionic (and electronic / fluid) minimization at each chemical potential of target-mu-scan in turn,
+//each starting from the converged electronic state, fluid state and SCF history of the previous one
+static void runMuScan(Everything& e)
+{	const std::vector<double>& muScan = e.eInfo.muScan;
+	int nPoints = muScan.size();
+	std::vector<double> Nscan, Gscan;
+	string historyFilename = e.dump.getFilename("scfHistoryScan");
+	for(int iPoint=0; iPoint<nPoints; iPoint++)
+	{	double mu = muScan[iPoint];
+		logPrintf("\n-------- Potential scan point %d of %d: mu = %+.9lf -----------\n", iPoint+1, nPoints, mu); logFlush();
+		//Extrapolate the electron count using the differential capacitance of the previous two points:
+		if(iPoint >= 2 && muScan[iPoint-1] != muScan[iPoint-2])
+		{	double dNdmu = (Nscan[iPoint-1] - Nscan[iPoint-2]) / (muScan[iPoint-1] - muScan[iPoint-2]);
+			e.eInfo.nElectrons = Nscan[iPoint-1] + dNdmu * (mu - muScan[iPoint-1]);
+			logPrintf("MuScan: extrapolated nElectrons = %.6lf using dN/dmu = %lg\n", e.eInfo.nElectrons, dNdmu);
+		}
+		e.eInfo.mu = mu;
+		if(e.cntrl.scf)
+		{	if(iPoint) e.scfParams.historyFilename = historyFilename; //resume mixing from the previous point
+			e.scfParams.historySaveFilename = historyFilename;
+		}
+		IonicMinimizer imin(e);
+		imin.minimize(e.ionicMinParams);
+		Nscan.push_back(e.eInfo.nElectrons);
+		Gscan.push_back(relevantFreeEnergy(e));
+		logPrintf("MuScan: Point: %3d  mu: %+.9lf  nElectrons: %.9lf  %s: %+.15lf\n",
+			iPoint, mu, Nscan.back(), relevantFreeEnergyName(e), Gscan.back());
+		logFlush();
+	}
+	e.scfParams.historySaveFilename.clear();
+	//Write the charge-potential curve:
+	if(mpiWorld->isHead())
+	{	string fname = e.dump.getFilename("muScan");
+		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp) die_alone("could not open file for writing.\n");
+		fprintf(fp, "#mu[Eh] nElectrons %s[Eh]\n", relevantFreeEnergyName(e));
+		for(int iPoint=0; iPoint<nPoints; iPoint++)
+			fprintf(fp, "%+.9le %.9le %+.15le\n", muScan[iPoint], Nscan[iPoint], Gscan[iPoint]);
+		fclose(fp);
+		logPrintf("done.\n"); logFlush();
+	}
+}
+
+//Set up and run the calculation specified by input (already parsed into e) in the current mpiWorld
+static void runCalculation(Everything& e, const std::vector< std::pair<string,string> >& input, bool dryRun, double tParse)
+{	ElecVars& eVars = e.eVars;
+	if(dryRun) eVars.skipWfnsInit = true;
+	else if(e.nebParams.nImages)
+	{	//Nudged elastic band sets up its own copy of the system for each image:
+		NudgedElasticBand neb(e, input);
+		neb.run();
+		return;
+	}
 	e.setup();
+	e.setupTimes.insert(e.setupTimes.begin(), std::make_pair(string("input-parsing"), tParse));
 	e.dump(DumpFreq_Init, 0);
 	Citations::print();
-	if(ip.dryRun)
-	{	logPrintf("Dry run successful: commands are valid and initialization succeeded.\n");
-		finalizeSystem();
-		return 0;
+	if(dryRun)
+	{	e.printSetupReport();
+		logPrintf("Dry run successful: commands are valid and initialization succeeded.\n");
+		return;
 	}
 	else logPrintf("Initialization completed successfully at t[s]: %9.2lf\n\n", clock_sec());
 	logFlush();
@@ -86,6 +131,11 @@ int main(int argc, char** argv)
 	else if(e.vibrations) //Bypasses ionic/lattice minimization, calls electron/fluid minimization loops at various ionic configurations
 	{	e.vibrations->calculate();
 	}
+	else if(e.cntrl.serverInput.length())
+	{	//Energy and force evaluations requested by an external driver:
+		IonicMinimizer imin(e);
+		imin.serve(e.cntrl.serverInput, e.cntrl.serverOutput);
+	}
 	else if(e.latticeMinParams.nIterations)
 	{	//Lattice minimization loop (which invokes the ionic minimization loop)
 		LatticeMinimizer lmin(e);
@@ -96,6 +146,10 @@ int main(int argc, char** argv)
 		IonDynamics verlet(e);
 		verlet.run();
 	}
+	else if(e.eInfo.muScan.size())
+	{	//Ionic minimization loop at each chemical potential in turn
+		runMuScan(e);
+	}
 	else
 	{	//Ionic minimization loop (which calls electron/fluid minimization loops)
 		IonicMinimizer imin(e);
@@ -104,6 +158,82 @@ int main(int argc, char** argv)
 
 	//Final dump:
 	e.dump(DumpFreq_End, 0);
+	if(e.iInfo.projectorCache.maxBytes) e.iInfo.projectorCache.print();
+}
+
+//Run independent calculations for each of inputs, divided between groups of processes (see command batch)
+static void runBatch(const std::vector<string>& inputs, bool dryRun)
+{	static StopWatch watch("batch"); watch.start();
+	int nInputs = inputs.size();
+	MPIUtil* mpiWorldAll = mpiWorld;
+	int nGroups = std::min(nInputs, mpiWorldAll->nProcesses());
+	MPIUtil::ProcDivision procDivision(mpiWorldAll, nGroups);
+	std::shared_ptr<MPIUtil> mpiBatchGroup = std::make_shared<MPIUtil>(0, (char**)0, procDivision);
+	logPrintf("\n---------- Batch of %d calculations in %d groups of processes ----------\n", nInputs, nGroups); logFlush();
+	FILE* logAll = globalLog;
+	mpiWorld = mpiBatchGroup.get(); //each calculation runs within a group
+	
+	std::vector<double> tInput(nInputs, 0.); //wall time of each calculation (on its group head)
+	for(int i=procDivision.iGroup; i<nInputs; i+=nGroups)
+	{	const string& inputFilename = inputs[i];
+		string outFilename = inputFilename;
+		if(outFilename.length()>3 && outFilename.substr(outFilename.length()-3)==".in")
+			outFilename.resize(outFilename.length()-3);
+		outFilename += ".out";
+		if(mpiWorld->isHead())
+		{	fprintf(logAll, "Group %d: running '%s' with output to '%s'.\n", procDivision.iGroup, inputFilename.c_str(), outFilename.c_str());
+			fflush(logAll);
+			FILE* fp = fopen(outFilename.c_str(), "w");
+			if(!fp) die_alone("Could not open '%s' for writing.\n", outFilename.c_str());
+			logRedirect(fp);
+		}
+		double tStart = clock_sec();
+		printVersionBanner();
+		{	Everything e;
+			double tParse = clock_sec();
+			std::vector< std::pair<string,string> > input = readInputFile(inputFilename);
+			parse(input, e);
+			tParse = clock_sec() - tParse;
+			if(e.cntrl.batchInputs.size()) die("Batch input '%s' may not itself contain the batch command.\n", inputFilename.c_str());
+			runCalculation(e, input, dryRun, tParse);
+		}
+		tInput[i] = clock_sec() - tStart;
+		logPrintf("Batch calculation '%s' done in %.2lf s.\n", inputFilename.c_str(), tInput[i]);
+		if(mpiWorld->isHead())
+		{	fclose(globalLog);
+			logRedirect(logAll);
+		}
+		else tInput[i] = 0.; //reported from group head
+	}
+	
+	//Summary:
+	mpiWorld = mpiWorldAll;
+	mpiWorld->allReduceData(tInput, MPIUtil::ReduceSum);
+	logPrintf("\nCompleted batch calculations:\n");
+	for(int i=0; i<nInputs; i++)
+		logPrintf("\t%-40s %10.2lf s\n", inputs[i].c_str(), tInput[i]);
+	logFlush();
+	watch.stop();
+}
+
+//Program entry point
+int main(int argc, char** argv)
+{	//Parse command line, initialize system and logs:
+	Everything e; //the parent data structure for, well, everything
+	InitParams ip("Performs Joint Density Functional Theory calculations.", &e);
+	initSystemCmdline(argc, argv, ip);
+	
+	//Parse input file:
+	double tParse = clock_sec();
+	std::vector< std::pair<string,string> > input = readInputFile(ip.inputFilename);
+	parse(input, e, ip.printDefaults);
+	tParse = clock_sec() - tParse;
+	
+	//Run calculation(s):
+	if(e.cntrl.batchInputs.size())
+		runBatch(e.cntrl.batchInputs, ip.dryRun);
+	else
+		runCalculation(e, input, ip.dryRun, tParse);
 	
 	finalizeSystem();
 	return 0;
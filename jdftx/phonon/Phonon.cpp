@@ -25,21 +25,60 @@ void Phonon::dump()
 {	//Zero force matrix and electron-phonon matrix elements:
 	IonicGradient zeroForce; zeroForce.init(eSupTemplate.iInfo);
 	dgrad.assign(modes.size(), zeroForce);
-	dHsub.assign(modes.size(), std::vector<matrix>(nSpins));
 	
 	//Accumulate contributions to force matrix and electron-phonon matrix elements for each irreducible perturbation:
 	unsigned iPertStart = (iPerturbation>=0) ? iPerturbation : 0;
 	unsigned iPertStop  = (iPerturbation>=0) ? iPerturbation+1 : perturbations.size();
 	std::vector<int> nStatesPert(perturbations.size());
+	//--- optionally divide perturbations between groups of processes:
+	std::vector<int> pertGroup(perturbations.size(), 0); //group that runs each perturbation
+	int iGroup = 0; //group of current process
+	std::shared_ptr<MPIUtil> mpiPert; //communicator within group
+	bool useGroups = (iPerturbation<0) && (!dryRun) && (std::min(nPertGroups, mpiWorld->nProcesses()) > 1);
+	if(useGroups)
+	{	int nGroups = std::min(nPertGroups, mpiWorld->nProcesses());
+		mpiPert = std::make_shared<MPIUtil>(0, (char**)0, MPIUtil::ProcDivision(mpiWorld, nGroups));
+		iGroup = mpiPert->procDivision.iGroup;
+		//Assign in order of decreasing cost to least loaded group, with cost estimated by the weight
+		//(proportional to the number of images of the perturbation, and hence the number of k-points):
+		std::vector<std::pair<double,int>> pertCost;
+		for(unsigned iPert=iPertStart; iPert<iPertStop; iPert++)
+			pertCost.push_back(std::make_pair(-perturbations[iPert].weight, iPert));
+		std::sort(pertCost.begin(), pertCost.end());
+		std::vector<double> groupCost(nGroups, 0.);
+		for(const auto& pc: pertCost)
+		{	int jGroup = std::min_element(groupCost.begin(), groupCost.end()) - groupCost.begin();
+			pertGroup[pc.second] = jGroup;
+			groupCost[jGroup] -= pc.first;
+		}
+		logPrintf("Running supercell calculations in %d process groups (only those of group 0 are logged below):\n", nGroups);
+		for(unsigned iPert=iPertStart; iPert<iPertStop; iPert++)
+			logPrintf("\tPerturbation: %u  group: %d\n", iPert+1, pertGroup[iPert]);
+	}
+	MPIUtil* mpiWorldOrig = mpiWorld;
 	for(unsigned iPert=iPertStart; iPert<iPertStop; iPert++)
-	{	logPrintf("########### Perturbed supercell calculation %u of %d #############\n", iPert+1, int(perturbations.size()));
+	{	if(pertGroup[iPert] != iGroup) continue; //handled by another group
+		logPrintf("########### Perturbed supercell calculation %u of %d #############\n", iPert+1, int(perturbations.size()));
 		ostringstream oss; oss << "phonon." << iPert+1 << ".$@#!"; //placeholder for $VAR
 		string fnamePattern = e.dump.getFilename(oss.str()); //(because dump variable name cannot contain $VAR)
 		fnamePattern.replace(fnamePattern.find("$@#!"), 4, "$VAR"); //replace placeholder with $VAR
+		if(useGroups) mpiWorld = mpiPert.get(); //supercell calculation (and all its communication) restricted to group
 		processPerturbation(perturbations[iPert], fnamePattern);
+		mpiWorld = mpiWorldOrig;
 		nStatesPert[iPert] = eSup->eInfo.nStates;
 		logPrintf("\n"); logFlush();
 	}
+	if(useGroups)
+	{	//Collect contributions from all groups (each counted once, from the group head):
+		//(Subspace Hamiltonian changes were streamed to disk by each group head, and are read back by dumpHsub)
+		bool contribute = mpiPert->isHead();
+		for(size_t iMode=0; iMode<modes.size(); iMode++)
+			for(std::vector<vector3<>>& dgradSp: dgrad[iMode])
+			{	if(!contribute) std::fill(dgradSp.begin(), dgradSp.end(), vector3<>());
+				mpiWorld->allReduceData(dgradSp, MPIUtil::ReduceSum);
+			}
+		logPrintf("Collected supercell calculation results from all process groups.\n");
+	}
 	if(dryRun)
 	{	logPrintf("\nParameter summary for supercell calculations:\n");
 		for(unsigned iPert=iPertStart; iPert<iPertStop; iPert++)
@@ -79,27 +118,33 @@ void Phonon::dump()
 	
 	//--- remap force matrix on cells (with duplicated ones on WS-supercell boundary):
 	std::vector<matrix> F(cellMap.size());
-	auto iter = cellMap.begin();
-	for(size_t iCell=0; iCell<cellMap.size(); iCell++)
-	{	//Get cell map entry:
-		vector3<int> iR = iter->first;
-		const matrix& weight = iter->second;
-		iter++;
-		//Find index of cell in supercell:
-		for(int j=0; j<3; j++)
-			iR[j] = positiveRemainder(iR[j], sup[j]);
-		int cellIndex =  (iR[0]*sup[1] + iR[1])*sup[2] + iR[2]; //corresponding to the order of atom replication in setup()
-		//Collect omegaSq entries:
-		F[iCell].init(modes.size(), modes.size());
-		for(size_t iMode1=0; iMode1<modes.size(); iMode1++)
-		{	const IonicGradient& F1 = dgrad[iMode1];
-			for(size_t iMode2=0; iMode2<modes.size(); iMode2++)
-			{	const Mode& mode2 = modes[iMode2];
-				size_t cellOffsetSp = cellIndex * e.iInfo.species[mode2.sp]->atpos.size(); //offset into atoms of current cell for current species
-				F[iCell].set(iMode1,iMode2, weight(iMode1/3,iMode2/3) * dot(F1[mode2.sp][mode2.at + cellOffsetSp], mode2.dir));
+	std::vector<std::pair<vector3<int>,const matrix*>> cellEntries; //cell map entries in order
+	std::vector<complex*> Fdata(cellMap.size());
+	for(const auto& entry: cellMap)
+	{	F[cellEntries.size()].init(modes.size(), modes.size());
+		Fdata[cellEntries.size()] = F[cellEntries.size()].data();
+		cellEntries.push_back(std::make_pair(entry.first, &entry.second));
+	}
+	auto remapCells = [&](size_t iCellStart, size_t iCellStop)
+	{	for(size_t iCell=iCellStart; iCell<iCellStop; iCell++)
+		{	vector3<int> iR = cellEntries[iCell].first;
+			const matrix& weight = *(cellEntries[iCell].second);
+			//Find index of cell in supercell:
+			for(int j=0; j<3; j++)
+				iR[j] = positiveRemainder(iR[j], sup[j]);
+			int cellIndex =  (iR[0]*sup[1] + iR[1])*sup[2] + iR[2]; //corresponding to the order of atom replication in setup()
+			//Collect omegaSq entries:
+			for(size_t iMode1=0; iMode1<modes.size(); iMode1++)
+			{	const IonicGradient& F1 = dgrad[iMode1];
+				for(size_t iMode2=0; iMode2<modes.size(); iMode2++)
+				{	const Mode& mode2 = modes[iMode2];
+					size_t cellOffsetSp = cellIndex * e.iInfo.species[mode2.sp]->atpos.size(); //offset into atoms of current cell for current species
+					Fdata[iCell][F[iCell].index(iMode1,iMode2)] = weight(iMode1/3,iMode2/3) * dot(F1[mode2.sp][mode2.at + cellOffsetSp], mode2.dir);
+				}
 			}
 		}
-	}
+	};
+	threadLaunch(&remapCells, cellMap.size());
 	
 	//--- check force matrix
 	logPrintf("\nFinalizing force matrix in real space:\n");
@@ -147,44 +192,21 @@ void Phonon::dump()
 	
 	//Output electron-phonon matrix elements:
 	if(mpiWorld->isHead() && saveHsub)
-	{	const int& nBands = e.eInfo.nBands;
-		for(int s=0; s<nSpins; s++)
-		{	string spinSuffix = (nSpins==1 ? "" : (s==0 ? "Up" : "Dn"));
-			string fname = e.dump.getFilename("phononHsub" + spinSuffix);
-			logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
-			FILE* fp = fopen(fname.c_str(), "w");
-			for(size_t iMode=0; iMode<modes.size(); iMode++)
-				for(int ik1=0; ik1<prodSup; ik1++)
-					for(int ik2=0; ik2<prodSup; ik2++)
-					{	matrix HePh = invsqrtM[modes[iMode].sp] * //incorporate mass factor in eigen-displacement
-							dHsub[iMode][s](ik1*nBands,(ik1+1)*nBands, ik2*nBands,(ik2+1)*nBands); //split into k-point pairs
-						HePh.write(fp);
-					}
-			fclose(fp);
-			logPrintf("done.\n"); logFlush();
-		}
-	}
+		dumpHsub(invsqrtM);
 
 	//Calculate free energy (properly handling singularities at Gamma point):
 	std::vector< std::pair<vector3<>,double> > getQuadratureBZ(vector3<bool>); //implemented below
 	std::vector< std::pair<vector3<>,double> > quad = getQuadratureBZ(e.coulombParams.isTruncated());
 	int ikStart, ikStop;
 	TaskDivision(quad.size(), mpiWorld).myRange(ikStart, ikStop);
+	std::vector<vector3<>> kArr; //k-points of the quadrature
+	for(const auto& entry: quad) kArr.push_back(entry.first);
+	std::vector<diagMatrix> omegaSqEigsArr = interpolateOmegaSq(kArr, ikStart, ikStop, cellMap, omegaSq);
 	double ZPE = 0., Evib = 0., Avib = 0.;
 	double kSqMaxIm = 0.; //maximum |k|^2 with imaginary frequencies (if any)
 	double omegaSqMin = 0.; int ikMin=-1; //most negative frequency squared and corresponding k index
 	for(int ik=ikStart; ik<ikStop; ik++)
-	{	//Calculate phonon omegaSq at current k:
-		matrix omegaSq_k;
-		iter = cellMap.begin();
-		for(size_t iCell=0; iCell<cellMap.size(); iCell++)
-		{	omegaSq_k += cis(2*M_PI*dot(iter->first, quad[ik].first)) * omegaSq[iCell];
-			iter++;
-		}
-		//Diagonalize:
-		diagMatrix omegaSqEigs; matrix omegaSqEvecs;
-		omegaSq_k = dagger_symmetrize(omegaSq_k);
-		omegaSq_k.diagonalize(omegaSqEvecs, omegaSqEigs);
+	{	const diagMatrix& omegaSqEigs = omegaSqEigsArr[ik-ikStart];
 		//Check for imaginary frequencies:
 		if(omegaSqEigs[0] <= 0.) //eigenvalues in ascending order
 		{	kSqMaxIm = std::max(kSqMaxIm, e.gInfo.GGT.metric_length_squared(quad[ik].first));
@@ -222,6 +244,150 @@ void Phonon::dump()
 			sqrt(-omegaSqMin), kMin[0], kMin[1], kMin[2]);
 	}
 	logPrintf("\n");
+	
+	//Optional dispersion and density of states output:
+	if(dispersionFile.length()) dumpDispersion(cellMap, omegaSq);
+	if(dosMesh.length_squared()) dumpDOS(cellMap, omegaSq);
+}
+
+//Fourier interpolate omegaSq (on cellMap) to qArr[iq] for qStart <= iq < qStop, and return the eigenvalues (ascending) at each.
+//Each block of q is transformed in a single matrix product, and its small hermitian eigenproblems are solved together.
+std::vector<diagMatrix> Phonon::interpolateOmegaSq(const std::vector<vector3<>>& qArr, int qStart, int qStop,
+	const std::map<vector3<int>,matrix>& cellMap, const std::vector<matrix>& omegaSq)
+{	static StopWatch watch("Phonon::interpolateOmegaSq"); watch.start();
+	int nCells = cellMap.size();
+	int nModes = omegaSq[0].nRows();
+	int nModesSq = nModes*nModes;
+	//Collect into a nModesSq x nCells matrix:
+	matrix omegaSqR(nModesSq, nCells);
+	std::vector<vector3<int>> iRarr;
+	for(const auto& entry: cellMap)
+	{	matrix M = omegaSq[iRarr.size()];
+		M.reshape(nModesSq, 1);
+		omegaSqR.set(0,nModesSq, iRarr.size(),iRarr.size()+1, M);
+		iRarr.push_back(entry.first);
+	}
+	//Transform and diagonalize in blocks of q (bounding the memory of the transformed block):
+	std::vector<diagMatrix> eigs;
+	int qBlockSize = std::max(1, (1<<22)/nModesSq);
+	for(int qBlockStart=qStart; qBlockStart<qStop; qBlockStart+=qBlockSize)
+	{	int qBlockStop = std::min(qStop, qBlockStart+qBlockSize);
+		int nqBlock = qBlockStop - qBlockStart;
+		//Fourier transform phase:
+		matrix phase(nCells, nqBlock);
+		complex* phaseData = phase.data();
+		for(int iq=qBlockStart; iq<qBlockStop; iq++)
+			for(int iCell=0; iCell<nCells; iCell++)
+				*(phaseData++) = cis(2*M_PI*dot(iRarr[iCell], qArr[iq]));
+		matrix omegaSqq = omegaSqR * phase;
+		//Diagonalize:
+		std::vector<matrix> M(nqBlock), evecs(nqBlock);
+		std::vector<diagMatrix> eigsBlock(nqBlock);
+		for(int iq=0; iq<nqBlock; iq++)
+		{	M[iq] = omegaSqq(0,nModesSq, iq,iq+1);
+			M[iq].reshape(nModes, nModes);
+			M[iq] = dagger_symmetrize(M[iq]);
+		}
+		diagonalizeBatch(M, evecs, eigsBlock, 0, nqBlock);
+		eigs.insert(eigs.end(), eigsBlock.begin(), eigsBlock.end());
+	}
+	watch.stop();
+	return eigs;
+}
+
+//Signed phonon frequency: negative for imaginary frequencies
+inline double signedOmega(double omegaSq)
+{	return omegaSq<0. ? -sqrt(-omegaSq) : sqrt(omegaSq);
+}
+
+//Output phonon frequencies along the q-points in dispersionFile
+void Phonon::dumpDispersion(const std::map<vector3<int>,matrix>& cellMap, const std::vector<matrix>& omegaSq) const
+{	//Read q-points (kpoint lines in lattice coordinates, as output by bandstructKpoints):
+	std::vector<vector3<>> qArr;
+	ifstream ifs(dispersionFile);
+	if(!ifs.is_open()) die("Could not open phonon dispersion q-points file '%s' for reading.\n", dispersionFile.c_str());
+	while(!ifs.eof())
+	{	string line; getline(ifs, line);
+		istringstream iss(line);
+		string cmd; iss >> cmd;
+		if(cmd != "kpoint") continue;
+		vector3<> q; iss >> q[0] >> q[1] >> q[2];
+		if(iss.fail()) die("Error reading q-point from line '%s' of file '%s'.\n", line.c_str(), dispersionFile.c_str());
+		qArr.push_back(q);
+	}
+	if(!qArr.size()) die("No q-points ('kpoint' lines) found in file '%s'.\n", dispersionFile.c_str());
+	//Compute frequencies divided over processes:
+	int nq = qArr.size(), nModes = modes.size();
+	int iqStart, iqStop;
+	TaskDivision(nq, mpiWorld).myRange(iqStart, iqStop);
+	std::vector<diagMatrix> omegaSqEigs = interpolateOmegaSq(qArr, iqStart, iqStop, cellMap, omegaSq);
+	std::vector<double> omegaArr(nq*nModes, 0.);
+	for(int iq=iqStart; iq<iqStop; iq++)
+		for(int iMode=0; iMode<nModes; iMode++)
+			omegaArr[iq*nModes+iMode] = signedOmega(omegaSqEigs[iq-iqStart][iMode]);
+	mpiWorld->allReduceData(omegaArr, MPIUtil::ReduceSum);
+	//Write:
+	if(mpiWorld->isHead())
+	{	string fname = e.dump.getFilename("phononDispersion");
+		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp) die_alone("could not open file for writing.\n");
+		fprintf(fp, "#Phonon frequencies [Eh] (negative for imaginary) in ascending order for each of %d q-points in '%s'\n", nq, dispersionFile.c_str());
+		for(int iq=0; iq<nq; iq++)
+		{	for(int iMode=0; iMode<nModes; iMode++)
+				fprintf(fp, "%+.10le ", omegaArr[iq*nModes+iMode]);
+			fprintf(fp, "\n");
+		}
+		fclose(fp);
+		logPrintf("done.\n"); logFlush();
+	}
+}
+
+//Output phonon density of states by histogramming frequencies on a uniform Gamma-centered q-mesh
+void Phonon::dumpDOS(const std::map<vector3<int>,matrix>& cellMap, const std::vector<matrix>& omegaSq) const
+{	//Generate mesh divided over processes:
+	int nq = dosMesh[0]*dosMesh[1]*dosMesh[2], nModes = modes.size();
+	logPrintf("Computing phonon DOS on %d x %d x %d q-mesh ... ", dosMesh[0], dosMesh[1], dosMesh[2]); logFlush();
+	int iqStart, iqStop;
+	TaskDivision(nq, mpiWorld).myRange(iqStart, iqStop);
+	std::vector<vector3<>> qArr(nq);
+	for(int iq=iqStart; iq<iqStop; iq++)
+	{	int i2 = iq % dosMesh[2];
+		int i1 = (iq / dosMesh[2]) % dosMesh[1];
+		int i0 = iq / (dosMesh[2]*dosMesh[1]);
+		qArr[iq] = vector3<>(double(i0)/dosMesh[0], double(i1)/dosMesh[1], double(i2)/dosMesh[2]);
+	}
+	std::vector<diagMatrix> omegaSqEigs = interpolateOmegaSq(qArr, iqStart, iqStop, cellMap, omegaSq);
+	//Determine frequency range:
+	double omegaMin = 0., omegaMax = 0.;
+	for(const diagMatrix& eigs: omegaSqEigs)
+	{	omegaMin = std::min(omegaMin, signedOmega(eigs.front()));
+		omegaMax = std::max(omegaMax, signedOmega(eigs.back()));
+	}
+	mpiWorld->allReduce(omegaMin, MPIUtil::ReduceMin);
+	mpiWorld->allReduce(omegaMax, MPIUtil::ReduceMax);
+	int binMin = int(floor(omegaMin/dosBinWidth));
+	int nBins = int(floor(omegaMax/dosBinWidth)) - binMin + 1;
+	//Histogram (normalized to nModes states per unit cell):
+	std::vector<double> dos(nBins, 0.);
+	double w = 1./(nq*dosBinWidth);
+	for(const diagMatrix& eigs: omegaSqEigs)
+		for(double eig: eigs)
+			dos[int(floor(signedOmega(eig)/dosBinWidth)) - binMin] += w;
+	mpiWorld->allReduceData(dos, MPIUtil::ReduceSum);
+	logPrintf("done.\n");
+	//Write:
+	if(mpiWorld->isHead())
+	{	string fname = e.dump.getFilename("phononDOS");
+		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp) die_alone("could not open file for writing.\n");
+		fprintf(fp, "#omega[Eh] DOS[per Eh per unit cell] (bin centers; negative omega for imaginary; %d modes total)\n", nModes);
+		for(int iBin=0; iBin<nBins; iBin++)
+			fprintf(fp, "%+.10le %.10le\n", (binMin+iBin+0.5)*dosBinWidth, dos[iBin]);
+		fclose(fp);
+		logPrintf("done.\n"); logFlush();
+	}
 }
 
 vector3<int> Phonon::getCell(int unit) const
@@ -384,9 +550,12 @@ void Phonon::dgradSymmetrize(std::vector<IonicGradient>& dgrad) const
 	}
 	//Forward transform:
 	matrix Ftilde = F * phase;
-	//Apply corrections per k:
+	//Apply corrections per k (divided over processes):
 	double Fnorm = 0., dFtransNorm = 0., dFhermNorm = 0.;
-	for(int ik=0; ik<prodSup; ik++)
+	int ikStart, ikStop;
+	TaskDivision(prodSup, mpiWorld).myRange(ikStart, ikStop);
+	matrix FtildeNew = zeroes(nModesSq, prodSup);
+	for(int ik=ikStart; ik<ikStop; ik++)
 	{	matrix Fk = Ftilde(0,nModesSq, ik,ik+1);
 		Fk.reshape(nModes, nModes);
 		Fnorm += std::pow(nrm2(Fk),2);
@@ -409,10 +578,14 @@ void Phonon::dgradSymmetrize(std::vector<IonicGradient>& dgrad) const
 		}
 		//Store corrected version
 		Fk.reshape(nModesSq, 1);
-		Ftilde.set(0,nModesSq, ik,ik+1, Fk);
+		FtildeNew.set(0,nModesSq, ik,ik+1, Fk);
 	}
+	mpiWorld->allReduceData(FtildeNew, MPIUtil::ReduceSum);
+	mpiWorld->allReduce(Fnorm, MPIUtil::ReduceSum);
+	mpiWorld->allReduce(dFhermNorm, MPIUtil::ReduceSum);
+	mpiWorld->allReduce(dFtransNorm, MPIUtil::ReduceSum);
 	//Inverse transform:
-	F = (Ftilde * dagger(phase)) * (1./prodSup);
+	F = (FtildeNew * dagger(phase)) * (1./prodSup);
 	//Convert back to atoms:
 	Fdata = F.data();
 	for(int iCell=0; iCell<prodSup; iCell++)
@@ -63,6 +63,11 @@ public:
 	int iPerturbation; //!< if >=0, only run one supercell calculation
 	bool collectPerturbations; //!< if true, collect results of previously computed perturbations (skips supercell SCF/Minimize)
 	bool saveHsub; //!< whether to compute / output electron-phonon matrix elements
+	int nPertGroups; //!< number of process groups that run supercell calculations concurrently (task farm)
+	bool dragPert; //!< whether to start each supercell calculation from unperturbed wavefunctions with atomic-orbital components of the perturbed atom displaced along with it
+	string dispersionFile; //!< if non-empty, file of q-points (kpoint lines) along which to output phonon frequencies
+	vector3<int> dosMesh; //!< if non-zero, uniform q-mesh on which to compute the phonon density of states
+	double dosBinWidth; //!< frequency bin width (Eh) for the phonon density of states
 	
 	Phonon();
 	void setup(bool printDefaults); //!< setup unit cell and basis modes for perturbations
@@ -89,7 +94,6 @@ private:
 	double E0; //!< energy of unperturbed supercell
 	IonicGradient grad0; //!< forces of unperturbed supercell
 	std::vector<IonicGradient> dgrad; //!< change in forces per unit displacement in each mode (force matrix)
-	std::vector< std::vector<matrix> > dHsub; //!< change in electronic subspace Hamiltonian per unit displacement in each mode (precursor to electron-phonon matrix elements)
 	
 	//!Minimal basis of perturbations for supercell calculations:
 	struct Perturbation : public Mode
@@ -103,9 +107,20 @@ private:
 	//!Set unperturbed state of supercell from unit cell and retrieve unperturbed subspace Hamiltonian at supercell Gamma point (for all bands)
 	std::vector<diagMatrix> setSupState();
 	
+	//!First-order guess for the perturbed supercell state (starting from the unperturbed state set by setSupState):
+	//!translate the atomic-orbital components of the wavefunctions on the perturbed atom along with it
+	void dragPerturbation(const Perturbation& pert);
+	
 	//!Calculate subspace Hamiltonian of perturbed supercell:
 	std::vector<matrix> getPerturbedHsub(const Perturbation& pert, const std::vector<diagMatrix>& Hsub0);
 	
+	//!Get the unit cell mode (with the cell offset of its atom and the index of the first of its three modes) that symmetry iSym maps pert to
+	void getImageMode(const Perturbation& pert, unsigned iSym, Mode& mode, vector3<int>& cellOffset, unsigned& iModeStart) const;
+	
+	//!Symmetrize the subspace Hamiltonian changes streamed to disk per perturbation (phonon.<iPert>.dHsub),
+	//!and output the electron-phonon matrix elements one atom at a time (head process only)
+	void dumpHsub(const std::vector<double>& invsqrtM) const;
+	
 	//!Mapping between unit cell and current supercell k-points (generated by processPerturbation and used by setSupState)
 	struct StateMapEntry : public Supercell::KmeshTransform //contain source k-point rotation here
 	{	int qSup; //!< state index for supercell
@@ -130,6 +145,13 @@ private:
 
 	//! Check translational invariance sum rule of force matrix
 	void forceMatrixSumRuleCheck(const std::vector<matrix>& F, const std::map<vector3<int>,matrix>& cellMap) const;
+	
+	//! Fourier interpolate omegaSq (on cellMap) to qArr[iq] for qStart <= iq < qStop, returning the eigenvalues at each (ascending)
+	static std::vector<diagMatrix> interpolateOmegaSq(const std::vector<vector3<>>& qArr, int qStart, int qStop,
+		const std::map<vector3<int>,matrix>& cellMap, const std::vector<matrix>& omegaSq);
+	
+	void dumpDispersion(const std::map<vector3<int>,matrix>& cellMap, const std::vector<matrix>& omegaSq) const; //!< output frequencies along the q-points in dispersionFile
+	void dumpDOS(const std::map<vector3<int>,matrix>& cellMap, const std::vector<matrix>& omegaSq) const; //!< output phonon density of states on dosMesh
 };
 
 //! @}
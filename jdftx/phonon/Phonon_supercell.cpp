@@ -128,6 +128,8 @@ void Phonon::processPerturbation(const Perturbation& pert, string fnamePattern)
 	std::vector<diagMatrix> Hsub0;
 	if(!collectPerturbations || saveHsub)
 		Hsub0 = setSupState();
+	if(dragPert && !collectPerturbations && !eSup->eVars.wfnsFilename.length())
+		dragPerturbation(pert);
 	
 	//Calculate energy and forces:
 	IonicGradient dgrad_pert;
@@ -169,28 +171,20 @@ void Phonon::processPerturbation(const Perturbation& pert, string fnamePattern)
 			dHsub_pert[s] = (1./dr) * (Hsub[s] - Hsub0[s]);
 	}
 	
+	//Stream subspace Hamiltonian change to disk (symmetrized and output one atom at a time by dumpHsub):
+	if(saveHsub && mpiWorld->isHead())
+	{	string fname = eSup->dump.getFilename("dHsub");
+		FILE* fp = fopen(fname.c_str(), "wb");
+		if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
+		for(const matrix& M: dHsub_pert) M.write(fp);
+		fclose(fp);
+	}
+	
 	//Accumulate results for all symmetric images of perturbation:
 	const auto& atomMap = eSupTemplate.symm.getAtomMap();
 	for(unsigned iSym=0; iSym<symSupCart.size(); iSym++)
-	{
-		//Figure out the mode that the rotated perturbation corresponds to:
-		Mode mode;
-		mode.sp = pert.sp; //rotations are not alchemists!
-		mode.at = atomMap[pert.sp][pert.at][iSym];
-		mode.dir = symSupCart[iSym] * pert.dir;
-		
-		//Reduce mode atom to fundamental unit cell if necessary:
-		int nAtoms = e.iInfo.species[mode.sp]->atpos.size(); //per unit cell
-		int unit = mode.at / nAtoms; //unit cell index of mapped atom
-		mode.at -= nAtoms*unit; //mode.at is now in [0,nAtoms)
-		vector3<int> cellOffset = -getCell(unit); //corresponding displacement in unit cell lattice coords
-		
-		//Find index of first mode that matches sp and at:
-		unsigned iModeStart = 0;
-		for(iModeStart=0; iModeStart<modes.size(); iModeStart++)
-			if(mode.sp==modes[iModeStart].sp && mode.at==modes[iModeStart].at)
-				break;
-		assert(iModeStart+3 <= modes.size());
+	{	Mode mode; vector3<int> cellOffset; unsigned iModeStart;
+		getImageMode(pert, iSym, mode, cellOffset, iModeStart);
 		
 		//Accumulate dgrad contributions:
 		for(unsigned sp2=0; sp2<eSup->iInfo.species.size(); sp2++)
@@ -204,30 +198,93 @@ void Phonon::processPerturbation(const Perturbation& pert, string fnamePattern)
 					dgrad[iMode2][sp2][at2rot] += (pert.weight * dot(modes[iMode2].dir, mode.dir)) * Frot;
 			}
 		}
-		
-		//Accumulate Hsub contributions:
-		if(saveHsub)
-			for(int iSpin=0; iSpin<nSpins; iSpin++)
-			{	//Fetch Hsub with rotations:
-				matrix contrib = stateRot[iSpin][iSym].transform(dHsub_pert[iSpin]);
-				//Collect k-vectors in order of the blocks of Hsub:
-				int qSup = iSpin*(eSup->eInfo.nStates/nSpins); //Gamma point is always first in the list for each spin
-				assert(eSup->eInfo.qnums[qSup].k.length_squared() == 0); //make sure that above is true
-				std::vector< vector3<> > k; k.reserve(prodSup);
-				for(const StateMapEntry& sme: stateMap) if(sme.qSup==qSup)
-					k.push_back(sme.k);
-				assert(int(k.size()) == prodSup);
-				//Apply phase factors due to translations:
-				int nBands = e.eInfo.nBands;
-				for(unsigned ik1=0; ik1<k.size(); ik1++)
-					for(unsigned ik2=0; ik2<k.size(); ik2++)
-						contrib.set(ik1*nBands,(ik1+1)*nBands, ik2*nBands,(ik2+1)*nBands,
-							contrib(ik1*nBands,(ik1+1)*nBands, ik2*nBands,(ik2+1)*nBands)
-								* cis(-2*M_PI*dot(cellOffset, k[ik1]-k[ik2])));
-				for(unsigned iMode2=iModeStart; iMode2<iModeStart+3; iMode2++)
-					dHsub[iMode2][iSpin] += contrib * (pert.weight * dot(modes[iMode2].dir, mode.dir));
+	}
+}
+
+void Phonon::getImageMode(const Perturbation& pert, unsigned iSym, Mode& mode, vector3<int>& cellOffset, unsigned& iModeStart) const
+{	//Figure out the mode that the rotated perturbation corresponds to:
+	const auto& atomMap = eSupTemplate.symm.getAtomMap();
+	mode.sp = pert.sp; //rotations are not alchemists!
+	mode.at = atomMap[pert.sp][pert.at][iSym];
+	mode.dir = symSupCart[iSym] * pert.dir;
+	
+	//Reduce mode atom to fundamental unit cell if necessary:
+	int nAtoms = e.iInfo.species[mode.sp]->atpos.size(); //per unit cell
+	int unit = mode.at / nAtoms; //unit cell index of mapped atom
+	mode.at -= nAtoms*unit; //mode.at is now in [0,nAtoms)
+	cellOffset = -getCell(unit); //corresponding displacement in unit cell lattice coords
+	
+	//Find index of first mode that matches sp and at:
+	for(iModeStart=0; iModeStart<modes.size(); iModeStart++)
+		if(mode.sp==modes[iModeStart].sp && mode.at==modes[iModeStart].at)
+			break;
+	assert(iModeStart+3 <= modes.size());
+}
+
+void Phonon::dumpHsub(const std::vector<double>& invsqrtM) const
+{	static StopWatch watch("phonon::dumpHsub"); watch.start();
+	const int& nBands = e.eInfo.nBands;
+	int nBandsSup = nBands * prodSup;
+	size_t matSize = size_t(nBandsSup)*nBandsSup*sizeof(complex);
+	//Supercell-commensurate unit cell k-points, in order of the blocks of Hsub (same order as stateMap of the supercell Gamma point):
+	std::vector< vector3<> > k; k.reserve(prodSup);
+	for(const vector3<>& kCur: e.coulombParams.supercell->kmesh)
+	{	vector3<> kSup = matrix3<>(Diag(sup)) * kCur;
+		if((kSup - vector3<>(round(kSup))).length_squared() < symmThresholdSq)
+			k.push_back(kCur);
+	}
+	assert(int(k.size()) == prodSup);
+	for(int s=0; s<nSpins; s++)
+	{	string spinSuffix = (nSpins==1 ? "" : (s==0 ? "Up" : "Dn"));
+		string fname = e.dump.getFilename("phononHsub" + spinSuffix);
+		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
+		//Symmetrize and output the three modes of one atom at a time (bounding memory to those and one perturbation):
+		for(unsigned iModeStart=0; iModeStart<modes.size(); iModeStart+=3)
+		{	std::vector<matrix> dHsubAtom(3, zeroes(nBandsSup, nBandsSup));
+			for(unsigned iPert=0; iPert<perturbations.size(); iPert++)
+			{	const Perturbation& pert = perturbations[iPert];
+				matrix dHsubPert; //read when first needed below
+				for(unsigned iSym=0; iSym<symSupCart.size(); iSym++)
+				{	Mode mode; vector3<int> cellOffset; unsigned iModeStartImage;
+					getImageMode(pert, iSym, mode, cellOffset, iModeStartImage);
+					if(iModeStartImage != iModeStart) continue; //contributes to a different atom
+					if(!dHsubPert)
+					{	ostringstream oss; oss << "phonon." << iPert+1 << ".dHsub";
+						string fnamePert = e.dump.getFilename(oss.str());
+						FILE* fpPert = fopen(fnamePert.c_str(), "rb");
+						if(!fpPert) die_alone("Error opening %s for reading.\n", fnamePert.c_str());
+						fseek(fpPert, s*matSize, SEEK_SET);
+						dHsubPert.init(nBandsSup, nBandsSup);
+						dHsubPert.read(fpPert);
+						fclose(fpPert);
+					}
+					//Fetch Hsub with rotations:
+					matrix contrib = stateRot[s][iSym].transform(dHsubPert);
+					//Apply phase factors due to translations:
+					for(unsigned ik1=0; ik1<k.size(); ik1++)
+						for(unsigned ik2=0; ik2<k.size(); ik2++)
+							contrib.set(ik1*nBands,(ik1+1)*nBands, ik2*nBands,(ik2+1)*nBands,
+								contrib(ik1*nBands,(ik1+1)*nBands, ik2*nBands,(ik2+1)*nBands)
+									* cis(-2*M_PI*dot(cellOffset, k[ik1]-k[ik2])));
+					for(unsigned iMode2=iModeStart; iMode2<iModeStart+3; iMode2++)
+						dHsubAtom[iMode2-iModeStart] += contrib * (pert.weight * dot(modes[iMode2].dir, mode.dir));
+				}
 			}
+			//Output (split into k-point pairs):
+			for(unsigned iMode=iModeStart; iMode<iModeStart+3; iMode++)
+				for(int ik1=0; ik1<prodSup; ik1++)
+					for(int ik2=0; ik2<prodSup; ik2++)
+					{	matrix HePh = invsqrtM[modes[iMode].sp] * //incorporate mass factor in eigen-displacement
+							dHsubAtom[iMode-iModeStart](ik1*nBands,(ik1+1)*nBands, ik2*nBands,(ik2+1)*nBands);
+						HePh.write(fp);
+					}
+		}
+		fclose(fp);
+		logPrintf("done.\n"); logFlush();
 	}
+	watch.stop();
 }
 
 #define INITwfnsSup(C, nCols) \
@@ -305,6 +362,41 @@ std::vector<diagMatrix> Phonon::setSupState()
 	return Hsub0;
 }
 
+void Phonon::dragPerturbation(const Perturbation& pert)
+{	SpeciesInfo& spPert = *(eSup->iInfo.species[pert.sp]); //species that has been perturbed
+	int nSpinor = e.eInfo.spinorLength();
+	int nOrbAtom = (spPert.nAtomicOrbitals() / spPert.atpos.size()) * nSpinor; //orbital columns per atom
+	if(!nOrbAtom) return; //no atomic orbitals available
+	static StopWatch watch("phonon::dragPerturbation"); watch.start();
+	int colStart = nOrbAtom * pert.at; //first column of perturbed atom within all atomic orbitals
+	for(int sp=0; sp<pert.sp; sp++)
+		colStart += eSup->iInfo.species[sp]->nAtomicOrbitals() * nSpinor;
+	
+	//Undo perturbation (so that orbitals and overlaps below correspond to the unperturbed state):
+	vector3<> atpos0 = eSupTemplate.iInfo.species[pert.sp]->atpos[pert.at]; //unperturbed atom position
+	vector3<> dxPert = spPert.atpos[pert.at] - atpos0;
+	std::swap(spPert.atpos[pert.at], atpos0);
+	spPert.sync_atpos();
+	std::vector<vector3<>> drColumns(nOrbAtom, dxPert);
+	for(int qSup=eSup->eInfo.qStart; qSup<eSup->eInfo.qStop; qSup++)
+	{	ColumnBundle& Csup = eSup->eVars.C[qSup];
+		ColumnBundle psi = eSup->iInfo.getAtomicOrbitals(qSup, false).getSub(colStart, colStart+nOrbAtom);
+		ColumnBundle Opsi = O(psi);
+		matrix coeff = inv(psi^Opsi) * (Opsi^Csup); //LCAO coefficients on perturbed atom (best fit)
+		Csup -= psi * coeff; //remainder
+		translateColumns(psi, drColumns.data());
+		Csup += psi * coeff; //reconstitute with displaced orbitals
+	}
+	//Redo perturbation and update projections:
+	std::swap(spPert.atpos[pert.at], atpos0);
+	spPert.sync_atpos();
+	for(int qSup=eSup->eInfo.qStart; qSup<eSup->eInfo.qStop; qSup++)
+	{	if(eSup->cntrl.scf) eSup->eVars.orthonormalize(qSup); //SCF assumes orthonormal
+		else eSup->iInfo.project(eSup->eVars.C[qSup], eSup->eVars.VdagC[qSup]);
+	}
+	watch.stop();
+}
+
 std::vector<matrix> Phonon::getPerturbedHsub(const Perturbation& pert, const std::vector<diagMatrix>& Hsub0)
 {	static StopWatch watch("phonon::getPerturbedHsub"); watch.start();
 	double scaleFac = 1./sqrt(prodSup); //to account for normalization
@@ -321,7 +413,7 @@ std::vector<matrix> Phonon::getPerturbedHsub(const Perturbation& pert, const std
 	{	//Undo perturbation (needed to get unperturbed projectors below):
 		vector3<> atpos0 = eSupTemplate.iInfo.species[pert.sp]->atpos[pert.at]; //unperturbed atom position
 		std::swap(spPert.atpos[pert.at], atpos0);
-		spPert.sync_atpos(); //Note: also clears cached projectors
+		spPert.sync_atpos(); //Note: also updates cached projectors
 		for(int s=0; s<nSpins; s++)
 		{	int qSup = s*(eSup->eInfo.nStates/nSpins); //Gamma point is always first in the list for each spin
 			pStart = spPert.QintAll.nRows() * pert.at; //perturbed atom projector starts here ...
@@ -27,9 +27,14 @@ enum PhononMember
 	PM_iPerturbation,
 	PM_collectPerturbations,
 	PM_saveHsub,
+	PM_perturbationGroups,
+	PM_dragPerturbation,
  	PM_T,
 	PM_Fcut,
 	PM_rSmooth,
+	PM_dispersion,
+	PM_dosMesh,
+	PM_dosBinWidth,
 	PM_delim
 };
 
@@ -39,9 +44,14 @@ EnumStringMap<PhononMember> phononMemberMap
 	PM_iPerturbation,"iPerturbation",
 	PM_collectPerturbations, "collectPerturbations",
 	PM_saveHsub, "saveHsub",
+	PM_perturbationGroups, "perturbationGroups",
+	PM_dragPerturbation, "dragPerturbation",
 	PM_T, "T",
 	PM_Fcut, "Fcut",
-	PM_rSmooth, "rSmooth"
+	PM_rSmooth, "rSmooth",
+	PM_dispersion, "dispersion",
+	PM_dosMesh, "dosMesh",
+	PM_dosBinWidth, "dosBinWidth"
 );
 
 struct CommandPhonon : public Command
@@ -70,6 +80,20 @@ struct CommandPhonon : public Command
 			"\n+ saveHsub yes|no\n\n"
 			"   Whether to compute / save phononHsub: the electron-phonon matrix elements.\n"
 			"   Default: yes.\n"
+			"\n+ perturbationGroups <nGroups>\n\n"
+			"   Divide the processes into <nGroups> groups that run different supercell\n"
+			"   calculations concurrently, each using only the processes of its group.\n"
+			"   Perturbations are assigned to groups in advance, in decreasing order of\n"
+			"   estimated cost (lower-symmetry perturbations have more k-points), and the\n"
+			"   results are collected from all groups automatically at the end.\n"
+			"   Useful when the number of processes exceeds what each supercell calculation\n"
+			"   can use efficiently (default 1: all processes run each perturbation in turn).\n"
+			"\n+ dragPerturbation yes|no\n\n"
+			"   Whether to improve the initial guess for each supercell calculation by\n"
+			"   displacing the atomic-orbital components of the unperturbed wavefunctions\n"
+			"   on the perturbed atom along with it (first order in the displacement).\n"
+			"   Requires atomic orbitals in the pseudopotential of the perturbed species\n"
+			"   (no effect otherwise). Default: yes.\n"
 			"\n+ T <T>\n\n"
 			"   Temperature (in Kelvins) used for vibrational free energy estimation (default 298).\n"
 			"\n+ Fcut <Fcut>\n\n"
@@ -78,7 +102,16 @@ struct CommandPhonon : public Command
 			"   are desired; this flag ensures that those extra bands do not affect the\n"
 			"   performance or memory requirements of the supercell calculations.\n"
 			"\n+ rSmooth <rSmooth>\n\n"
-			"   Width in bohrs of the supercell boundary region over which matrix elements are smoothed.";
+			"   Width in bohrs of the supercell boundary region over which matrix elements are smoothed.\n"
+			"\n+ dispersion <file>\n\n"
+			"   Output phononDispersion: the frequencies (in Eh, negative for imaginary ones)\n"
+			"   Fourier interpolated to each q-point in <file>, specified as kpoint lines in\n"
+			"   lattice coordinates (eg. as created by bandstructKpoints).\n"
+			"\n+ dosMesh <N0> <N1> <N2>\n\n"
+			"   Output phononDOS: the phonon density of states (per Eh per unit cell) from\n"
+			"   frequencies Fourier interpolated to a uniform Gamma-centered q-mesh of this size.\n"
+			"\n+ dosBinWidth <dOmega>\n\n"
+			"   Frequency bin width (in Eh) for phononDOS (default 1e-5).";
 		
 		forbid("fix-electron-density");
 		forbid("fix-electron-potential");
@@ -117,6 +150,13 @@ struct CommandPhonon : public Command
 				case PM_saveHsub:
 					pl.get(phonon.saveHsub, true, boolMap, "saveHsub", true);
 					break;
+				case PM_perturbationGroups:
+					pl.get(phonon.nPertGroups, 1, "nGroups", true);
+					if(phonon.nPertGroups <= 0) throw string("<nGroups> must be positive");
+					break;
+				case PM_dragPerturbation:
+					pl.get(phonon.dragPert, true, boolMap, "dragPerturbation", true);
+					break;
 				case PM_T:
 					pl.get(phonon.T, 0., "T", true);
 					phonon.T *= Kelvin;
@@ -129,6 +169,21 @@ struct CommandPhonon : public Command
 					pl.get(phonon.rSmooth, 1., "rSmooth", true);
 					if(phonon.rSmooth <= 0.) throw string("<rSmooth> must be positive");
 					break;
+				case PM_dispersion:
+					pl.get(phonon.dispersionFile, string(), "file", true);
+					break;
+				case PM_dosMesh:
+					for(int j=0; j<3; j++)
+					{	char paramName[8]; sprintf(paramName, "N%d", j);
+						pl.get(phonon.dosMesh[j], 0, paramName, true);
+						if(phonon.dosMesh[j]<=0)
+							throw string("DOS q-mesh dimensions must be positive");
+					}
+					break;
+				case PM_dosBinWidth:
+					pl.get(phonon.dosBinWidth, 0., "dOmega", true);
+					if(phonon.dosBinWidth <= 0.) throw string("<dOmega> must be positive");
+					break;
 				case PM_delim: //should never be encountered
 					break;
 			}
@@ -142,9 +197,14 @@ struct CommandPhonon : public Command
 		if(phonon.iPerturbation>=0) logPrintf(" \\\n\tiPerturbation %d", phonon.iPerturbation+1); //print 1-based index
 		if(phonon.collectPerturbations) logPrintf(" \\\n\tcollectPerturbations");
 		logPrintf(" \\\n\tsaveHsub %s", boolMap.getString(phonon.saveHsub));
+		logPrintf(" \\\n\tperturbationGroups %d", phonon.nPertGroups);
+		logPrintf(" \\\n\tdragPerturbation %s", boolMap.getString(phonon.dragPert));
 		logPrintf(" \\\n\tT %lg", phonon.T/Kelvin);
 		logPrintf(" \\\n\tFcut %lg", phonon.Fcut);
 		logPrintf(" \\\n\trSmooth %lg", phonon.rSmooth);
+		if(phonon.dispersionFile.length()) logPrintf(" \\\n\tdispersion %s", phonon.dispersionFile.c_str());
+		if(phonon.dosMesh.length_squared()) logPrintf(" \\\n\tdosMesh %d %d %d", phonon.dosMesh[0], phonon.dosMesh[1], phonon.dosMesh[2]);
+		logPrintf(" \\\n\tdosBinWidth %lg", phonon.dosBinWidth);
 	}
 }
 commandPhonon;
@@ -11,7 +11,7 @@
 
 from os import system as shell            # Put system calls
 from commands import getoutput as shellO  # Put system calls and retrieve output
-import copy, random, re, scipy
+import copy, random, re, scipy, os, subprocess
 
 from ase.calculators.interface import Calculator
 from ase.units import Bohr, Hartree
@@ -19,7 +19,7 @@ from ase.units import Bohr, Hartree
 
 class JDFTx(Calculator):
 
-    def __init__(self, executable='$JDFTx', pseudoDir='$JDFTx_pseudo', commands={}):
+    def __init__(self, executable='$JDFTx', pseudoDir='$JDFTx_pseudo', commands={}, persistent=False):
 
         self.executable = shellO('echo %s' % (executable))  # Path to the jdftx executable (cpu or gpu)
         self.pseudoDir = shellO('echo %s' % (pseudoDir))    # Path to the pseudopotentials folder
@@ -44,6 +44,13 @@ class JDFTx(Calculator):
         self.lastAtoms = None
         self.lastInput = None
 
+        # Persistent server (see command ionic-server), started on first use if requested;
+        # it is restarted whenever anything other than the atom positions changes
+        self.persistent = persistent
+        self.server = None
+        self.serverDir = None
+        self.serverAtoms = None
+
     ########### Interface Functions ###########
 
     def calculation_required(self, atoms, quantities):
@@ -105,7 +112,72 @@ class JDFTx(Calculator):
 
     def update(self, atoms):
 
-        self.runJDFTx(self.constructInput(atoms))
+        if(self.persistent):
+            self.runServer(atoms)
+        else:
+            self.runJDFTx(self.constructInput(atoms))
+
+    def serverCompatible(self, atoms):
+        """ Checks whether the running server can handle atoms (only positions may change) """
+
+        if((self.server == None) or (self.server.poll() != None) or (self.input != self.lastInput)):
+            return False
+        old = self.serverAtoms
+        return ((old.get_chemical_symbols() == atoms.get_chemical_symbols())
+            and (abs(old.get_cell() - atoms.get_cell()).max() < 1e-12)
+            and (list(old.get_pbc()) == list(atoms.get_pbc())))
+
+    def runServer(self, atoms):
+        """ Evaluates energy and forces using a persistent JDFTx process """
+
+        if(not self.serverCompatible(atoms)):
+            self.stopServer()
+            self.serverDir = 'temp.%s' % (int(round(100000 * random.random())))
+            os.mkdir(self.serverDir)
+            for name in ['request', 'response']:
+                os.mkfifo('%s/%s' % (self.serverDir, name))
+            inputfile = self.constructInput(atoms) + '\nionic-server request response\n'
+            inFile = open('%s/in' % (self.serverDir), 'w')
+            inFile.write(inputfile)
+            inFile.close()
+            self.server = subprocess.Popen('%s -i in -o temp.out' % (self.executable), shell=True, cwd=self.serverDir)
+            self.serverAtoms = copy.deepcopy(atoms)
+
+        # Send positions (in bohrs) and read back energy and forces (in the same order):
+        request = open('%s/request' % (self.serverDir), 'w')
+        for name, pos in zip(atoms.get_chemical_symbols(), atoms.get_positions() / Bohr):
+            request.write('ion %s %.15f %.15f %.15f\n' % (name, pos[0], pos[1], pos[2]))
+        request.close()
+        response = open('%s/response' % (self.serverDir), 'r')
+        forces = []
+        for line in response:
+            word = line.split()
+            if(len(word) and word[0] == 'energy'):
+                self.E = float(word[1]) * Hartree
+            elif(len(word) and word[0] == 'force'):
+                forces.append(scipy.array([float(word[2]), float(word[3]), float(word[4])]))
+        response.close()
+        if(len(forces) != len(atoms)):
+            raise IOError('Error: incomplete response from JDFTx server in %s.' % (self.serverDir))
+        self.Forces = (Hartree / Bohr) * scipy.array(forces)
+        self.lastAtoms = copy.deepcopy(atoms)
+
+    def stopServer(self):
+        """ Shuts down the persistent JDFTx process (if any) and removes its directory """
+
+        if(self.server != None):
+            if(self.server.poll() == None):
+                request = open('%s/request' % (self.serverDir), 'w')
+                request.write('quit\n')
+                request.close()
+                self.server.wait()
+            shell('rm -rf %s' % (self.serverDir))
+        self.server = None
+        self.serverDir = None
+
+    def __del__(self):
+
+        self.stopServer()
 
     def runJDFTx(self, inputfile):
         """ Runs a JDFTx calculation """
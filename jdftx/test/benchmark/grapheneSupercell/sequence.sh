@@ -0,0 +1,3 @@
+#!/bin/bash
+export runs="bench"
+export nProcs="4"
@@ -0,0 +1,100 @@
+#!/bin/bash
+
+benchName="$1"
+benchSrcDir="$2"
+benchRunDir="$3"
+jdftxBuildDir="$4"
+baselineDir="$5"
+
+caseSrcDir="$benchSrcDir/$benchName"
+caseRunDir="$benchRunDir/$benchName"
+
+#Tolerances (relative) for regression against baseline:
+tolTime="${JDFTX_BENCHMARK_TOL_TIME:-0.15}"   #wall time and profiled function times
+tolMemory="${JDFTX_BENCHMARK_TOL_MEMORY:-0.05}" #peak memory usage
+tolIter="${JDFTX_BENCHMARK_TOL_ITER:-0.10}"     #iteration counts
+minTime="${JDFTX_BENCHMARK_MIN_TIME:-0.5}"     #absolute slack in seconds (ignore noise in short functions)
+
+mkdir -p $caseRunDir
+cd $caseRunDir
+rm -f *.out metrics comparison summary
+export SRCDIR="$caseSrcDir"
+export JDFTX_PROFILE="yes" #per-function timings and peak memory (requires a build with EnableProfiling)
+
+#Run JDFTx on all runs of this benchmark (always rerun, as timings are the results):
+source $caseSrcDir/sequence.sh
+if [[ "$JDFTX_LAUNCH" == *'%d'* ]]; then
+	LAUNCH="$(printf "$JDFTX_LAUNCH" "$nProcs")"
+else
+	LAUNCH="$JDFTX_LAUNCH"
+fi
+echo "launch=\"$LAUNCH\""
+for run in $runs; do
+	$LAUNCH $jdftxBuildDir/jdftx$JDFTX_SUFFIX -i $caseSrcDir/$run.in -o $run.out
+	if [ "$?" -ne "0" ]; then
+		echo "FAILED: error running $run" > summary
+		exit 1
+	fi
+done
+
+#Extract metrics (<name> <value>) from each run:
+for run in $runs; do
+	awk -v run="$run" '
+		/End date and time:/ {
+			split($NF, t, /[-:)]/); #Duration: days-hours:minutes:seconds)
+			printf("%s.walltime %.2f\n", run, ((t[1]*24 + t[2])*60 + t[3])*60 + t[4]);
+		}
+		/ElecMinimize: Iter:|SCF: Cycle:/ { nElec++ }
+		/IonicMinimize: Iter:|LatticeMinimize: Iter:/ { nIonic++ }
+		/^PROFILER:/ { printf("%s.time.%s %.6f\n", run, $2, $(NF-1)) }
+		/^MEMUSAGE:/ { printf("%s.memory.%s %.6f\n", run, $2, $3) }
+		END {
+			printf("%s.iterations.electronic %d\n", run, nElec);
+			printf("%s.iterations.ionic %d\n", run, nIonic);
+		}
+	' $run.out >> metrics
+done
+
+#Record baseline if requested:
+if [ -n "$JDFTX_BENCHMARK_RECORD" ]; then
+	mkdir -p $baselineDir
+	cp metrics $baselineDir/$benchName.metrics
+	echo "Recorded: baseline $baselineDir/$benchName.metrics" > summary
+	exit 0
+fi
+if [ ! -f $baselineDir/$benchName.metrics ]; then
+	echo "Skipped: no baseline $baselineDir/$benchName.metrics (run make benchmark-baseline)" > summary
+	exit 0
+fi
+
+#Compare against baseline (only increases beyond tolerance count as regressions):
+awk -v tolTime="$tolTime" -v tolMemory="$tolMemory" -v tolIter="$tolIter" -v minTime="$minTime" '
+	FNR==NR { base[$1] = $2; order[++nBase] = $1; next }
+	{ obtained[$1] = $2 }
+	END {
+		printf("%50s  %12s %12s %8s Status\n", "Metric", "Obtained", "Baseline", "Change");
+		nRegressed = 0;
+		for(i=1; i<=nBase; i++)
+		{	name = order[i]; xBase = base[name];
+			if(!(name in obtained)) { printf("%50s  %12s %12g %8s [MISSING]\n", name, "-", xBase, "-"); continue; }
+			x = obtained[name];
+			if(name ~ /\.memory\./) { tol = tolMemory; slack = 0.; }
+			else if(name ~ /\.iterations\./) { tol = tolIter; slack = 1.; }
+			else { tol = tolTime; slack = minTime; }
+			status = "ok";
+			if(x > xBase*(1.+tol) + slack) { status = "REGRESSED"; nRegressed++; }
+			else if(x < xBase*(1.-tol) - slack) status = "improved";
+			change = xBase ? sprintf("%+7.1f%%", 100.*(x-xBase)/xBase) : "-";
+			if(status != "ok" || name !~ /\.time\./) #list all regressions and the summary metrics
+				printf("%50s  %12g %12g %8s [%s]\n", name, x, xBase, change, status);
+		}
+		if(nRegressed)
+		{	printf("FAILED: %d of %d metrics regressed.\n", nRegressed, nBase) > "summary";
+			exit 1;
+		}
+		else
+		{	printf("Passed: no regressions in %d metrics.\n", nBase) > "summary";
+			exit 0;
+		}
+	}
+' $baselineDir/$benchName.metrics metrics > comparison
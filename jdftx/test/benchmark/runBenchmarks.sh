@@ -0,0 +1,33 @@
+#!/bin/bash
+
+benchSrcDir="$1"
+benchRunDir="$2"
+jdftxBuildDir="$3"
+shift 3
+
+#Baselines are machine-specific, so they are stored per machine (override with JDFTX_BENCHMARK_BASELINE):
+machine="${JDFTX_BENCHMARK_MACHINE:-$(hostname -s)}"
+baselineDir="${JDFTX_BENCHMARK_BASELINE:-$benchSrcDir/baselines/$machine}"
+
+#Benchmarks to run (all by default):
+benchmarks="$@"
+if [ -z "$benchmarks" ]; then
+	benchmarks="metalBulkSupercell grapheneSupercell waterSolvation platinumSpinOrbit"
+fi
+
+status=0
+for benchmark in $benchmarks; do
+	echo "Running benchmark $benchmark ..."
+	$benchSrcDir/runBenchmark.sh $benchmark $benchSrcDir $benchRunDir $jdftxBuildDir $baselineDir || status=1
+	if [ -f $benchRunDir/$benchmark/comparison ]; then
+		cat $benchRunDir/$benchmark/comparison
+	fi
+	echo
+done
+
+echo "Summary of benchmarks (baseline: $baselineDir):"
+for benchmark in $benchmarks; do
+	printf "%30s: " $benchmark
+	cat $benchRunDir/$benchmark/summary
+done
+exit $status
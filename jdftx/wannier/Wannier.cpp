@@ -23,9 +23,10 @@ along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
 
 Wannier::Wannier() : needAtomicOrbitals(false), localizationMeasure(LM_FiniteDifference), precond(false),
 	bStart(0), outerWindow(false), innerWindow(false), nFrozen(0),
-	saveWfns(false), saveWfnsRealSpace(false), saveMomenta(false),
+	saveWfns(false), saveWfnsRealSpace(false), cropWfnsRealSpace(0.), saveMomenta(false), sparseThreshold(0.),
 	z0(0.), zH(0.), zSigma(0.),
-	loadRotations(false), numericalOrbitalsOffset(0.5,0.5,0.5), rSmooth(1.), wrapWS(false), spinMode(SpinAll)
+	loadRotations(false), loadOverlaps(false), numericalOrbitalsOffset(0.5,0.5,0.5), rSmooth(1.), wrapWS(false),
+	interpBinWidth(1e-4), fermiMu(0.), fermiWidth(0.), spinMode(SpinAll)
 {
 }
 
@@ -70,12 +70,15 @@ public:
 	
 	bool saveWfns; //!< whether to write wavefunctions
 	bool saveWfnsRealSpace; //!< whether to output Wannier functions band-by-band in real-space
+	double cropWfnsRealSpace; //!< if non-zero, crop real-space Wannier functions to the box where |psi| exceeds this fraction of its maximum
 	bool saveMomenta; //!< whether to output momentum matrix elements
 	bool saveSpin; //!< whether to output spin matrix elements (non-collinear only)
+	double sparseThreshold; //!< if non-zero, write Wannierized matrices sparsely, dropping blocks with all elements below this magnitude
 	
 	double z0, zH, zSigma; //!< center (lattice coords), half-width (lattice coords) and smoothness (bohrs) for slab-weight function
 
 	bool loadRotations; //!< whether to load initial rotations from previous dump
+	bool loadOverlaps; //!< whether to reuse finite-difference overlaps from previous dump (independent of trial orbitals and windows)
 	string initFilename, dumpFilename; //!< filename patterns for input and output
 	string eigsFilename; //!< optional override for eigenvals file
 	
@@ -86,6 +89,10 @@ public:
 	double rSmooth; //!< supercell boundary width over which matrix elements are smoothed
 	bool wrapWS; //!< whether to wrap Wannier centers (and phonon atom perturbations) to a Wigner-Seitz cell
 	
+	vector3<int> interpMesh; //!< if non-zero, dense k-mesh on which to interpolate the Wannier Hamiltonian for DOS / transport output
+	double interpBinWidth; //!< energy bin width (Eh) of the interpolated density of states
+	double fermiMu, fermiWidth; //!< if fermiWidth is non-zero, output interpolated states with energy within fermiWidth of fermiMu
+	
 	enum SpinMode
 	{	SpinUp,
 		SpinDn,
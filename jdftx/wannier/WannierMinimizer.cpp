@@ -66,25 +66,52 @@ void randomize(WannierGradient& x)
 
 //---- energy/gradient functions required by Minimizable<WannierGradient> -----
 
-void WannierMinimizer::step(const WannierGradient& grad, double alpha)
-{	static StopWatch watch("WannierMinimizer::step"); watch.start();
-	assert(grad.wmin == this);
-	for(unsigned ik=ikStart; ik<ikStop; ik++)
-	{	KmeshEntry& ki = kMesh[ik];
+//Return cis(alpha*B) for hermitian B with eigensystem (Bevecs, Beigs)
+inline matrix cisScaled(double alpha, const matrix& Bevecs, const diagMatrix& Beigs)
+{	std::vector<complex> phase(Beigs.nRows());
+	for(int i=0; i<Beigs.nRows(); i++) phase[i] = cis(alpha*Beigs[i]);
+	return Bevecs * matrix(phase) * dagger(Bevecs);
+}
+
+//Check whether A and B have identical contents (to detect repeated step directions)
+inline bool sameContents(const matrix& A, const matrix& B)
+{	return A && B && A.nRows()==B.nRows() && A.nCols()==B.nCols()
+		&& !memcmp(A.data(), B.data(), A.nData()*sizeof(complex));
+}
+
+void WannierMinimizer::step_thread(size_t ikMin, size_t ikMax, WannierMinimizer* wmin, const WannierGradient* grad, double alpha)
+{	int nCenters = wmin->nCenters, nFrozen = wmin->nFrozen, nBands = wmin->nBands;
+	for(size_t ik=wmin->ikStart+ikMin; ik<wmin->ikStart+ikMax; ik++)
+	{	KmeshEntry& ki = wmin->kMesh[ik];
 		//Stage 1:
 		if(ki.nIn > nCenters)
-		{	int nFreeIn = ki.nIn - ki.nFixed;
-			int nFree = nCenters - ki.nFixed;
-			matrix B1 = zeroes(nFreeIn, nFreeIn);
-			B1.set(0,nFree, nFree,nFreeIn, alpha*grad.B1[ik]);
-			B1.set(nFree,nFreeIn, 0,nFree, alpha*dagger(grad.B1[ik]));
-			ki.U1.set(0,nBands, ki.nFixed,ki.nIn, ki.U1(0,nBands, ki.nFixed,ki.nIn) * cis(B1));
+		{	if(!sameContents(ki.B1dir, grad->B1[ik])) //new direction: diagonalize the hermitian generator
+			{	int nFreeIn = ki.nIn - ki.nFixed;
+				int nFree = nCenters - ki.nFixed;
+				matrix B1 = zeroes(nFreeIn, nFreeIn);
+				B1.set(0,nFree, nFree,nFreeIn, grad->B1[ik]);
+				B1.set(nFree,nFreeIn, 0,nFree, dagger(grad->B1[ik]));
+				B1.diagonalize(ki.B1evecs, ki.B1eigs);
+				ki.B1dir = clone(grad->B1[ik]);
+			}
+			ki.U1.set(0,nBands, ki.nFixed,ki.nIn, ki.U1(0,nBands, ki.nFixed,ki.nIn) * cisScaled(alpha, ki.B1evecs, ki.B1eigs));
 		}
 		//Stage 2:
-		ki.U2.set(nFrozen,nCenters, nFrozen,nCenters, cis(alpha*grad.B2[ik]) * ki.U2(nFrozen,nCenters, nFrozen,nCenters));
+		if(!sameContents(ki.B2dir, grad->B2[ik]))
+		{	grad->B2[ik].diagonalize(ki.B2evecs, ki.B2eigs);
+			ki.B2dir = clone(grad->B2[ik]);
+		}
+		ki.U2.set(nFrozen,nCenters, nFrozen,nCenters, cisScaled(alpha, ki.B2evecs, ki.B2eigs) * ki.U2(nFrozen,nCenters, nFrozen,nCenters));
 		//Net rotation:
 		ki.U = ki.U1 * ki.U2;
 	}
+}
+
+void WannierMinimizer::step(const WannierGradient& grad, double alpha)
+{	static StopWatch watch("WannierMinimizer::step"); watch.start();
+	assert(grad.wmin == this);
+	//Independent for each k-point; a few chunks per thread balance the varying subspace sizes:
+	threadLaunchChunked(isGpuEnabled() ? 1 : 0, 4, step_thread, ikStop-ikStart, this, &grad, alpha);
 	watch.stop();
 	bcastU(); //Make U available on all processes that need it
 }
@@ -309,6 +336,7 @@ ColumnBundle WannierMinimizer::trialWfns(const WannierMinimizer::Kpoint& kpoint)
 			if(ao.sigma > 0.)
 			{	//--- Copy the center to managed memory:
 				ManagedArray<vector3<>> pos(&ao.r, 1);
+				AtomPhases phases(basis.gInfo->S, 1, &ao.r, kpoint.k);
 				//--- Get / create the radial part:
 				RadialFunctionG hRadial;
 				double Al = 0.25*sqrt(M_PI);
@@ -320,7 +348,7 @@ ColumnBundle WannierMinimizer::trialWfns(const WannierMinimizer::Kpoint& kpoint)
 				//--- Initialize the projector:
 				assert(od.s < nSpinor);
 				if(nSpinor > 1) { temp.zero(); assert(od.spinType==SpinZ); }
-				callPref(Vnl)(basis.nbasis, basis.nbasis, 1, od.l, od.m, kpoint.k, basis.iGarr.dataPref(), e.gInfo.G, pos.dataPref(), hRadial, temp.dataPref()+od.s*basis.nbasis);
+				callPref(Vnl)(basis.nbasis, basis.nbasis, 1, od.l, od.m, kpoint.k, basis.iGarr.dataPref(), e.gInfo.G, pos.dataPref(), phases.tables(), hRadial, temp.dataPref()+od.s*basis.nbasis);
 				hRadial.free();
 				//--- Accumulate to trial orbital:
 				callPref(eblas_zaxpy)(ret.colLength(), ao.coeff*lPhase/e.gInfo.detR, temp.dataPref(),1, retData,1);
@@ -338,50 +366,54 @@ matrix WannierMinimizer::overlap(const ColumnBundle& C1, const ColumnBundle& C2,
 	const GridInfo& gInfo = *(C1.basis->gInfo);
 	const IonInfo& iInfo = *(C1.basis->iInfo);
 	matrix ret = gInfo.detR * (C1 ^ C2);
-	//k-point difference:
-	vector3<> dkVec = C2.qnum->k - C1.qnum->k;
-	double dk = sqrt(gInfo.GGT.metric_length_squared(dkVec));
-	vector3<> dkHat = gInfo.GT * dkVec * (dk ? 1.0/dk : 0.0); //the unit Vector along dkVec (set dkHat to 0 for dk=0 (doesn't matter))
 	//Augment at each species:
 	for(size_t iSp=0; iSp<iInfo.species.size(); iSp++)
 	{	const SpeciesInfo& sp = *(iInfo.species[iSp]);
 		if(!sp.isUltrasoft()) continue; //no augmentation
-		//Create the Q matrix appropriate for current k-point difference:
-		matrix Qk = zeroes(sp.QintAll.nRows(), sp.QintAll.nCols());
-		complex* QkData = Qk.data();
-		int i1 = 0;
-		for(int l1=0; l1<int(sp.VnlRadial.size()); l1++)
-		for(int p1=0; p1<int(sp.VnlRadial[l1].size()); p1++)
-		for(int m1=-l1; m1<=l1; m1++)
-		{	//Triple loop over second projector:
-			int i2 = 0;
-			for(int l2=0; l2<int(sp.VnlRadial.size()); l2++)
-			for(int p2=0; p2<int(sp.VnlRadial[l2].size()); p2++)
-			for(int m2=-l2; m2<=l2; m2++)
-			{	std::vector<YlmProdTerm> terms = expandYlmProd(l1,m1, l2,m2);
-				complex q12 = 0.;
-				for(const YlmProdTerm& term: terms)
-				{	SpeciesInfo::QijIndex qIndex = { l1, p1, l2, p2, term.l };
-					auto Qijl = sp.Qradial.find(qIndex);
-					if(Qijl==sp.Qradial.end()) continue; //no entry at this l
-					q12 += term.coeff * cis(0.5*M_PI*(l2-l1-term.l)) * Ylm(term.l,term.m, dkHat) * Qijl->second(dk);
-				}
-				for(int s=0; s<nSpinor; s++)
-					QkData[Qk.index(i1+s,i2+s)] = q12;
-				i2 += nSpinor;
-			}
-			i1 += nSpinor;
-		}
-		if(sp.isRelativistic()) Qk = sp.fljAll * Qk * sp.fljAll;
-		//Phases for each atom:
-		std::vector<complex> phaseArr;
-		for(vector3<> x: sp.atpos)
-			phaseArr.push_back(cis(-2*M_PI*dot(dkVec,x)));
-		//Augment the overlap
 		matrix VdagC1 = VdagC1ptr ? VdagC1ptr->at(iSp) : (*sp.getV(C1)) ^ C1;
 		matrix VdagC2 = VdagC2ptr ? VdagC2ptr->at(iSp) : (*sp.getV(C2)) ^ C2;
-		ret += dagger(VdagC1) * (tiledBlockMatrix(Qk, sp.atpos.size(), &phaseArr) * VdagC2);
+		augmentOverlap(ret, C2.qnum->k - C1.qnum->k, iSp, VdagC1, VdagC2);
 	}
 	watch.stop();
 	return ret;
 }
+
+void WannierMinimizer::augmentOverlap(matrix& ret, const vector3<>& dkVec, size_t iSp, const matrix& VdagC1, const matrix& VdagC2) const
+{	const SpeciesInfo& sp = *(e.iInfo.species[iSp]);
+	//k-point difference:
+	double dk = sqrt(e.gInfo.GGT.metric_length_squared(dkVec));
+	vector3<> dkHat = e.gInfo.GT * dkVec * (dk ? 1.0/dk : 0.0); //the unit Vector along dkVec (set dkHat to 0 for dk=0 (doesn't matter))
+	//Create the Q matrix appropriate for current k-point difference:
+	matrix Qk = zeroes(sp.QintAll.nRows(), sp.QintAll.nCols());
+	complex* QkData = Qk.data();
+	int i1 = 0;
+	for(int l1=0; l1<int(sp.VnlRadial.size()); l1++)
+	for(int p1=0; p1<int(sp.VnlRadial[l1].size()); p1++)
+	for(int m1=-l1; m1<=l1; m1++)
+	{	//Triple loop over second projector:
+		int i2 = 0;
+		for(int l2=0; l2<int(sp.VnlRadial.size()); l2++)
+		for(int p2=0; p2<int(sp.VnlRadial[l2].size()); p2++)
+		for(int m2=-l2; m2<=l2; m2++)
+		{	std::vector<YlmProdTerm> terms = expandYlmProd(l1,m1, l2,m2);
+			complex q12 = 0.;
+			for(const YlmProdTerm& term: terms)
+			{	SpeciesInfo::QijIndex qIndex = { l1, p1, l2, p2, term.l };
+				auto Qijl = sp.Qradial.find(qIndex);
+				if(Qijl==sp.Qradial.end()) continue; //no entry at this l
+				q12 += term.coeff * cis(0.5*M_PI*(l2-l1-term.l)) * Ylm(term.l,term.m, dkHat) * Qijl->second(dk);
+			}
+			for(int s=0; s<nSpinor; s++)
+				QkData[Qk.index(i1+s,i2+s)] = q12;
+			i2 += nSpinor;
+		}
+		i1 += nSpinor;
+	}
+	if(sp.isRelativistic()) Qk = sp.fljAll * Qk * sp.fljAll;
+	//Phases for each atom:
+	std::vector<complex> phaseArr;
+	for(vector3<> x: sp.atpos)
+		phaseArr.push_back(cis(-2*M_PI*dot(dkVec,x)));
+	//Augment the overlap
+	ret += dagger(VdagC1) * (tiledBlockMatrix(Qk, sp.atpos.size(), &phaseArr) * VdagC2);
+}
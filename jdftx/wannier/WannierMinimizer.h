@@ -85,9 +85,13 @@ public:
 		matrix U1; //Initial rotation into Wannier subspace (nBands x nIn)
 		matrix U2; //Rotation within Wannier subspace (nIn x nIn)
 		//NOTE: U and U2 are truncated from nIn -> nCenters after minimization
+		//Eigensystems of the most recent step direction, reused by successive steps along it (as in line minimization):
+		matrix B1dir, B2dir; //step direction blocks (as in WannierGradient) that the eigensystems below correspond to
+		matrix B1evecs, B2evecs; diagMatrix B1eigs, B2eigs;
 		std::shared_ptr<MPIUtil> mpi; //MPI communicator with head=whose(ik) over which U must be bcast'd and reduced (created by subclass if needed)
 	};
 	void bcastU(); //broadcast U to any processes that need it
+	static void step_thread(size_t ikMin, size_t ikMax, WannierMinimizer* wmin, const WannierGradient* grad, double alpha); //step for a range of local k-points
 	
 	//-------- Interface for subclasses that provide the objective function for Wannier minimization
 	
@@ -161,9 +165,18 @@ protected:
 	//! If provided, use the cached projections instead of recomputing them.
 	matrix overlap(const ColumnBundle& C1, const ColumnBundle& C2, const std::vector<matrix>* VdagC1ptr=0, const std::vector<matrix>* VdagC2ptr=0) const;
 	
-	//! Wannierize and dump a Bloch-space matrix to file, optionally zeroing out the real parts
+	//! Add ultrasoft augmentation of species iSp to overlap ret between states differing in wave-vector by dkVec (lattice coordinates),
+	//! given the projections VdagC1 and VdagC2 of the two sets of states (used by overlap, and directly when batching overlaps)
+	void augmentOverlap(matrix& ret, const vector3<>& dkVec, size_t iSp, const matrix& VdagC1, const matrix& VdagC2) const;
+	
+	//! Wannierize and dump a Bloch-space matrix to file, optionally zeroing out the real parts.
+	//! If Hout is non-null, also retain the output (as written, on all processes) with one column per cell.
 	void dumpWannierized(const matrix& Htilde, const std::map<vector3<int>,matrix>& iCellMap,
-		const matrix& phase, int nMatrices, string varName, bool realPartOnly, int iSpin) const;
+		const matrix& phase, int nMatrices, string varName, bool realPartOnly, int iSpin, matrix* Hout=0) const;
+	
+	//! Interpolate the Wannierized Hamiltonian H (and momenta P) with one column per cell of iCellMap
+	//! to the dense k-mesh wannier.interpMesh, and output the density of states (with transport DOS and Fermi surface if P is non-empty)
+	void interpolateBands(int iSpin, const std::map<vector3<int>,matrix>& iCellMap, const matrix& H, const matrix& P) const;
 	
 	//! Return an exactly unitary version of U (orthogonalize columns)
 	//! If isSingular is provided, function will set it to true and return rather than stack-tracing in singular cases.
@@ -185,11 +185,19 @@ void WannierMinimizerFD::initialize(int iSpin)
 {
 	//Read overlap matrices, if available:
 	string fname = wannier.getFilename(Wannier::FilenameDump, "mlwfM0", &iSpin);
-	bool M0exists = (fileSize(fname.c_str()) > 0);
-	mpiWorld->bcast(M0exists); //Ensure MPI consistency of file check (avoid occassional NFS errors)
-	if(wannier.loadRotations && M0exists)
+	size_t sizePerK = edges[0].size() * nBands*nBands * sizeof(complex);
+	off_t M0size = fileSize(fname.c_str());
+	mpiWorld->bcast(M0size); //Ensure MPI consistency of file check (avoid occassional NFS errors)
+	bool M0exists = (M0size > 0);
+	bool M0reuse = (wannier.loadRotations || wannier.loadOverlaps) && M0exists;
+	if(M0reuse && size_t(M0size) != kMesh.size()*sizePerK)
+	{	if(wannier.loadRotations)
+			die("Length of '%s' was %ld instead of the expected %ld bytes.\n", fname.c_str(), long(M0size), long(kMesh.size()*sizePerK));
+		logPrintf("Ignoring overlap cache '%s': its length does not match the current k-mesh and bands.\n", fname.c_str());
+		M0reuse = false;
+	}
+	if(M0reuse)
 	{	logPrintf("Reading initial overlaps from '%s' ... ", fname.c_str()); logFlush();
-		size_t sizePerK = edges[0].size() * nBands*nBands * sizeof(complex);
 		MPIUtil::File fp;
 		mpiWorld->fopenRead(fp, fname.c_str(), kMesh.size()*sizePerK);
 		mpiWorld->fseek(fp, ikStart*sizePerK, SEEK_SET);
@@ -204,6 +212,10 @@ void WannierMinimizerFD::initialize(int iSpin)
 	}
 	
 	//Compute the overlap matrices for current spin:
+	static StopWatch watch("WannierMinimizerFD::initOverlaps"); watch.start();
+	bool anyUltrasoft = false;
+	for(const auto& sp: e.iInfo.species)
+		if(sp->isUltrasoft()) anyUltrasoft = true;
 	for(int jProcess=0; jProcess<mpiWorld->nProcesses(); jProcess++)
 	{	//Send/recv wavefunctions to other processes:
 		Cother.assign(e.eInfo.nStates, ColumnBundle());
@@ -232,16 +244,32 @@ void WannierMinimizerFD::initialize(int iSpin)
 		}
 		
 		for(size_t ik=0; ik<kMesh.size(); ik++) if(isMine_q(ik,iSpin))
-		{	KmeshEntry& ke = kMesh[ik];
-			std::vector<matrix> VdagCi, VdagCj;
-			ColumnBundle Ci = getWfns(ke.point, iSpin, &VdagCi); //Bloch functions at ik
-			//Overlap with neighbours:
+		{	//Collect neighbours available from jProcess:
+			std::vector<Edge*> edgesCur;
 			for(Edge& edge: edges[ik])
 				if(whose_q(edge.ik,iSpin)==jProcess)
-					edge.M0 = overlap(Ci, getWfns(edge.point, iSpin, &VdagCj), &VdagCi, &VdagCj);
+					edgesCur.push_back(&edge);
+			if(!edgesCur.size()) continue;
+			//Overlap with all these neighbours in a single matrix multiply:
+			KmeshEntry& ke = kMesh[ik];
+			std::vector<matrix> VdagCi;
+			ColumnBundle Ci = getWfns(ke.point, iSpin, anyUltrasoft ? &VdagCi : 0); //Bloch functions at ik
+			ColumnBundle Cj(nBands*edgesCur.size(), basis.nbasis*nSpinor, &basis, &ke.point, isGpuEnabled());
+			std::vector<std::vector<matrix>> VdagCj(edgesCur.size());
+			for(size_t j=0; j<edgesCur.size(); j++)
+				Cj.setSub(j*nBands, getWfns(edgesCur[j]->point, iSpin, anyUltrasoft ? &VdagCj[j] : 0));
+			matrix M = e.gInfo.detR * (Ci ^ Cj);
+			for(size_t j=0; j<edgesCur.size(); j++)
+			{	Edge& edge = *edgesCur[j];
+				edge.M0 = M(0,nBands, j*nBands,(j+1)*nBands);
+				for(size_t iSp=0; iSp<e.iInfo.species.size(); iSp++)
+					if(e.iInfo.species[iSp]->isUltrasoft())
+						augmentOverlap(edge.M0, edge.point.k - ke.point.k, iSp, VdagCi[iSp], VdagCj[j][iSp]);
+			}
 		}
 	}
 	Cother.clear();
+	watch.stop();
 	
 	//Broadcast and dump the overlap matrices:
 	FILE* fp = 0;
@@ -264,20 +292,33 @@ void WannierMinimizerFD::initialize(int iSpin)
 }
 
 
+//Rotate the initial overlaps of the edges of local k-points ikStart+[ikMin,ikMax) by the current rotations into Mcache
+void rotateOverlaps_thread(size_t ikMin, size_t ikMax, size_t ikStart, const std::vector<WannierMinimizer::KmeshEntry>* kMesh,
+	const std::vector< std::vector<WannierMinimizerFD::Edge> >* edges, matrix* Mcache)
+{	size_t nEdges = edges->at(0).size();
+	for(size_t ik=ikStart+ikMin; ik<ikStart+ikMax; ik++)
+	{	const WannierMinimizer::KmeshEntry& ki = kMesh->at(ik);
+		matrix* McachePtr = Mcache + (ik-ikStart)*nEdges;
+		for(const WannierMinimizerFD::Edge& edge: edges->at(ik))
+			*(McachePtr++) = dagger(ki.U) * edge.M0 * kMesh->at(edge.ik).U;
+	}
+}
+
 double WannierMinimizerFD::getOmega(bool grad)
 {	static StopWatch watch("WannierMinimizerFD::getOmega"); watch.start();
 	
+	//Rotate overlap matrices (independent for each k-point, and the dominant cost):
+	std::vector<matrix> Mcache((ikStop-ikStart)*edges[0].size());
+	threadLaunchChunked(isGpuEnabled() ? 1 : 0, 4, rotateOverlaps_thread, ikStop-ikStart, size_t(ikStart), &kMesh, &edges, Mcache.data());
+	
 	//Compute the expectation values of r and rSq for each center (split over processes)
 	rSqExpect.assign(nCenters, 0.);
 	rExpect.assign(nCenters, vector3<>());
-	std::vector<matrix> Mcache((ikStop-ikStart)*edges[0].size());
-	matrix* McachePtr = Mcache.data();
+	const matrix* McachePtr = Mcache.data();
 	for(size_t ik=ikStart; ik<ikStop; ik++)
 	{	const KmeshEntry& ki = kMesh[ik];
 		for(const Edge& edge: edges[ik])
-		{	const KmeshEntry& kj = kMesh[edge.ik];
-			matrix& M = *(McachePtr++);
-			M = dagger(ki.U) * edge.M0 * kj.U;
+		{	const matrix& M = *(McachePtr++);
 			const complex* Mdata = M.data();
 			for(int n=0; n<nCenters; n++)
 			{	complex Tnn = cis(dot(rPinned[n], edge.b)); //translation phase to rPinned as origin
@@ -306,7 +347,7 @@ double WannierMinimizerFD::getOmega(bool grad)
 	
 	//Compute gradients if required:
 	if(grad)
-	{	const matrix* McachePtr = Mcache.data();
+	{	McachePtr = Mcache.data();
 		for(size_t ik=ikStart; ik<ikStop; ik++)
 		{	KmeshEntry& ki = kMesh[ik];
 			for(Edge& edge: edges[ik])
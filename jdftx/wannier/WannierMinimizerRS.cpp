@@ -75,14 +75,24 @@ static complexScalarField operator*(complex s, const complexScalarField& in)
 
 double WannierMinimizerRS::getOmega(bool grad, bool invariant)
 {	resumeOperatorThreading();
-	//Compute supercell wave-functions:
-	ColumnBundle Csuper(nCenters, basisSuper.nbasis*nSpinor, &basisSuper, &qnumSuper, isGpuEnabled());
-	Csuper.zero();
-	for(unsigned i=0; i<kMesh.size(); i++) if(isMine_q(i,iSpin))
-	{	const KmeshEntry& ki = kMesh[i];
-		axpyWfns(ki.point.weight, ki.U(0,nBands,0,nCenters), ki.point, iSpin, Csuper);
+	int nMine = nStop - nStart;
+	int iProcess = mpiWorld->iProcess(), nProcesses = mpiWorld->nProcesses();
+	TaskDivision centerDiv(nCenters, mpiWorld);
+	
+	//Compute supercell wave-functions, distributed by center (each is reduced only to the process that owns it):
+	ColumnBundle Csuper; //centers nStart to nStop
+	for(int jProcess=0; jProcess<nProcesses; jProcess++)
+	{	int nStartJ = centerDiv.start(jProcess), nStopJ = centerDiv.stop(jProcess);
+		if(nStopJ == nStartJ) continue;
+		ColumnBundle CsuperJ(nStopJ-nStartJ, basisSuper.nbasis*nSpinor, &basisSuper, &qnumSuper, isGpuEnabled());
+		CsuperJ.zero();
+		for(unsigned i=0; i<kMesh.size(); i++) if(isMine_q(i,iSpin))
+		{	const KmeshEntry& ki = kMesh[i];
+			axpyWfns(ki.point.weight, ki.U(0,nBands,nStartJ,nStopJ), ki.point, iSpin, CsuperJ);
+		}
+		mpiWorld->reduceData(CsuperJ, MPIUtil::ReduceSum, jProcess);
+		if(jProcess == iProcess) std::swap(Csuper, CsuperJ);
 	}
-	mpiWorld->allReduceData(Csuper, MPIUtil::ReduceSum);
 	
 	//Translation to handle high offsets
 	std::vector<vector3<>> dr(nCenters), drReverse(nCenters);
@@ -90,18 +100,21 @@ double WannierMinimizerRS::getOmega(bool grad, bool invariant)
 	{	drReverse[n] = gInfoSuper.invR * rPinned[n]; //translation from origin to rPinned
 		dr[n] = -drReverse[n]; //and translation to rPinned as origin, both in supercell-lattice coords
 	}
-	translateColumns(Csuper, dr.data());
+	if(nMine) translateColumns(Csuper, dr.data()+nStart);
 	
 	//Compute spread (and optionally its gradient w.r.t Csuper):
 	double Omega = 0.;
 	rSqExpect.assign(nCenters, 0.);
 	rExpect.assign(nCenters, vector3<>());
-	ColumnBundle Omega_Csuper; if(grad) { Omega_Csuper = Csuper.similar(); Omega_Csuper.zero(); }
+	ColumnBundle Omega_Csuper; if(grad && nMine) { Omega_Csuper = Csuper.similar(); Omega_Csuper.zero(); }
+	std::vector<ColumnBundle> rCsuper(invariant ? 3 : 0); //r*psi in reciprocal space for the off-diagonal corrections
+	for(ColumnBundle& rC: rCsuper) if(nMine) { rC = Csuper.similar(); rC.zero(); }
 	for(int n=nStart; n<nStop; n++)
-	{	std::vector<complexScalarField> psi(nSpinor), Omega_psi(nSpinor);
+	{	int nLocal = n - nStart;
+		std::vector<complexScalarField> psi(nSpinor), Omega_psi(nSpinor);
 		//|r^2| contribution:
 		for(int s=0; s<nSpinor; s++)
-		{	psi[s] = I(Csuper.getColumn(n,s));
+		{	psi[s] = I(Csuper.getColumn(nLocal,s));
 			complexScalarField rSq_psi = rSq * psi[s];
 			rSqExpect[n] += gInfoSuper.dV * dot(psi[s], rSq_psi).real();
 			if(grad) Omega_psi[s] += (2*gInfoSuper.dV) * rSq_psi;
@@ -109,7 +122,10 @@ double WannierMinimizerRS::getOmega(bool grad, bool invariant)
 		//|r|^2 contribution:
 		for(int dir=0; dir<3; dir++)
 			for(int s=0; s<nSpinor; s++)
-				rExpect[n][dir] += gInfoSuper.dV * dot(psi[s], r[dir]* psi[s]).real();
+			{	complexScalarField r_psi = r[dir] * psi[s];
+				rExpect[n][dir] += gInfoSuper.dV * dot(psi[s], r_psi).real();
+				if(invariant) rCsuper[dir].accumColumn(nLocal,s, Idag(r_psi));
+			}
 		//Accumulate contributions to Omega:
 		bool shouldPin = pinned[n] && !invariant;
 		const vector3<> r0_n = shouldPin ? vector3<>() : rExpect[n];
@@ -123,47 +139,65 @@ double WannierMinimizerRS::getOmega(bool grad, bool invariant)
 		{	for(int dir=0; dir<3; dir++)
 				for(int s=0; s<nSpinor; s++)
 					Omega_psi[s] += (-2.*r0_n[dir] * 2*gInfoSuper.dV) * r[dir]*psi[s];
+			for(int s=0; s<nSpinor; s++)
+				Omega_Csuper.accumColumn(nLocal,s, Idag(Omega_psi[s]));
 		}
-		//Off-diagonal corrections to get the invariant part (expensive):
-		if(invariant)
-		{	for(int m=0; m<nCenters; m++) if(m != n)
-			{	std::vector<complexScalarField> psi_m(2), Omega_psi_m(2);
-				for(int s=0; s<nSpinor; s++)
-					psi_m[s] = I(Csuper.getColumn(m,s));
-				for(int dir=0; dir<3; dir++)
-				{	complex rExpect_mn;
-					for(int s=0; s<nSpinor; s++)
-						rExpect_mn += gInfoSuper.dV * dot(psi_m[s], r[dir] * psi[s]);
-					Omega -= rExpect_mn.norm();
-					if(grad)
-						for(int s=0; s<nSpinor; s++)
-						{	Omega_psi[s] -= 2*rExpect_mn * gInfoSuper.dV * (r[dir] * psi_m[s]);
-							Omega_psi_m[s] -= 2*rExpect_mn.conj() * gInfoSuper.dV * (r[dir] * psi[s]);
-						}
+	}
+	
+	//Off-diagonal corrections to get the invariant part (expensive):
+	if(invariant)
+	{	//Matrix elements rMat[dir](m,n) = <m|r_dir|n>, with the rows of this process's centers
+		//computed against each process's block of r*psi in turn (only one remote block held at a time):
+		std::vector<matrix> rMat(3);
+		for(int dir=0; dir<3; dir++)
+		{	rMat[dir] = zeroes(nCenters, nCenters);
+			for(int jProcess=0; jProcess<nProcesses; jProcess++)
+			{	int nStartJ = centerDiv.start(jProcess), nStopJ = centerDiv.stop(jProcess);
+				if(nStopJ == nStartJ) continue;
+				ColumnBundle rCj = (jProcess==iProcess) ? rCsuper[dir]
+					: ColumnBundle(nStopJ-nStartJ, basisSuper.nbasis*nSpinor, &basisSuper, &qnumSuper, isGpuEnabled());
+				mpiWorld->bcastData(rCj, jProcess);
+				if(nMine) rMat[dir].set(nStart,nStop, nStartJ,nStopJ, gInfoSuper.dV * (Csuper ^ rCj));
+			}
+			mpiWorld->allReduceData(rMat[dir], MPIUtil::ReduceSum);
+			//Omega contributions from rows of this process (diagonal excluded):
+			for(int m=nStart; m<nStop; m++)
+				for(int n=0; n<nCenters; n++) if(m != n)
+					Omega -= rMat[dir](m,n).norm();
+			//Gradient: Omega_C[k] = -4 sum_{m!=k} rMat(m,k) r*psi[m], collected from each block of r*psi in turn:
+			if(grad)
+			{	for(int n=0; n<nCenters; n++) rMat[dir].set(n,n, 0.);
+				for(int jProcess=0; jProcess<nProcesses; jProcess++)
+				{	int nStartJ = centerDiv.start(jProcess), nStopJ = centerDiv.stop(jProcess);
+					if(nStopJ == nStartJ) continue;
+					ColumnBundle rCj = (jProcess==iProcess) ? rCsuper[dir]
+						: ColumnBundle(nStopJ-nStartJ, basisSuper.nbasis*nSpinor, &basisSuper, &qnumSuper, isGpuEnabled());
+					mpiWorld->bcastData(rCj, jProcess);
+					if(nMine) Omega_Csuper += rCj * ((-4.*gInfoSuper.dV) * rMat[dir](nStartJ,nStopJ, nStart,nStop));
 				}
-				if(grad)
-					for(int s=0; s<nSpinor; s++)
-						Omega_Csuper.accumColumn(m,s, Idag(Omega_psi_m[s]));
 			}
 		}
-		if(grad)
-			for(int s=0; s<nSpinor; s++)
-				Omega_Csuper.accumColumn(n,s, Idag(Omega_psi[s]));
 	}
 	mpiWorld->allReduce(Omega, MPIUtil::ReduceSum);
 	mpiWorld->allReduceData(rSqExpect, MPIUtil::ReduceSum);
 	mpiWorld->allReduceData(rExpect, MPIUtil::ReduceSum);
 	
 	if(grad)
-	{	//Collect across processes:
-		mpiWorld->allReduceData(Omega_Csuper, MPIUtil::ReduceSum);
-		translateColumns(Omega_Csuper, drReverse.data());
-		//Propagate to rotations:
-		for(unsigned i=0; i<kMesh.size(); i++) if(isMine_q(i,iSpin))
-		{	KmeshEntry& ki = kMesh[i];
-			matrix Omega_U;
-			axpyWfns_grad(ki.point.weight, Omega_U, ki.point, iSpin, Omega_Csuper);
-			ki.Omega_UdotU += Omega_U(0,nCenters, 0,nBands) * ki.U;
+	{	if(nMine) translateColumns(Omega_Csuper, drReverse.data()+nStart);
+		//Propagate to rotations, with each process's block of gradients made available in turn:
+		for(int jProcess=0; jProcess<nProcesses; jProcess++)
+		{	int nStartJ = centerDiv.start(jProcess), nStopJ = centerDiv.stop(jProcess);
+			if(nStopJ == nStartJ) continue;
+			ColumnBundle Omega_CsuperJ = (jProcess==iProcess) ? Omega_Csuper
+				: ColumnBundle(nStopJ-nStartJ, basisSuper.nbasis*nSpinor, &basisSuper, &qnumSuper, isGpuEnabled());
+			mpiWorld->bcastData(Omega_CsuperJ, jProcess);
+			for(unsigned i=0; i<kMesh.size(); i++) if(isMine_q(i,iSpin))
+			{	KmeshEntry& ki = kMesh[i];
+				matrix Omega_U;
+				axpyWfns_grad(ki.point.weight, Omega_U, ki.point, iSpin, Omega_CsuperJ);
+				ki.Omega_UdotU.set(nStartJ,nStopJ, 0,ki.nIn,
+					ki.Omega_UdotU(nStartJ,nStopJ, 0,ki.nIn) + Omega_U(0,nStopJ-nStartJ, 0,nBands) * ki.U);
+			}
 		}
 	}
 	suspendOperatorThreading();
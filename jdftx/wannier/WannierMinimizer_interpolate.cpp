@@ -0,0 +1,160 @@
+/*-------------------------------------------------------------------
+Copyright 2014 Ravishankar Sundararaman
+
+This file is part of JDFTx.
+
+JDFTx is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+JDFTx is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with JDFTx.  If not, see <http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------*/
+
+#include <wannier/WannierMinimizer.h>
+#include <cfloat>
+
+void WannierMinimizer::interpolateBands(int iSpin, const std::map<vector3<int>,matrix>& iCellMap, const matrix& H, const matrix& P) const
+{	static StopWatch watch("WannierMinimizer::interpolateBands"); watch.start();
+	const vector3<int>& mesh = wannier.interpMesh;
+	int nk = mesh[0]*mesh[1]*mesh[2];
+	int nCells = iCellMap.size();
+	int nCentersSq = nCenters*nCenters;
+	bool haveP = bool(P);
+	bool fermiOut = haveP && wannier.fermiWidth;
+	logPrintf("Interpolating Wannier bands on %d x %d x %d k-mesh ... ", mesh[0], mesh[1], mesh[2]); logFlush();
+	std::vector<vector3<int>> iRarr;
+	for(const auto& entry: iCellMap) iRarr.push_back(entry.first);
+
+	//Bound the eigenvalues (Gershgorin discs of H summed over cells) to set up the energy bins:
+	std::vector<double> Hdiag(nCenters, 0.), Hradius(nCenters, 0.);
+	const complex* Hdata = H.data();
+	for(int iCell=0; iCell<nCells; iCell++)
+		for(int j=0; j<nCenters; j++)
+			for(int i=0; i<nCenters; i++)
+			{	complex Hij = Hdata[H.index(i+nCenters*j, iCell)];
+				if(i==j && !iRarr[iCell].length_squared()) Hdiag[i] = Hij.real();
+				else Hradius[i] += Hij.abs();
+			}
+	double Emin = DBL_MAX, Emax = -DBL_MAX;
+	for(int i=0; i<nCenters; i++)
+	{	Emin = std::min(Emin, Hdiag[i]-Hradius[i]);
+		Emax = std::max(Emax, Hdiag[i]+Hradius[i]);
+	}
+	const double& dE = wannier.interpBinWidth;
+	int binMin = int(floor(Emin/dE));
+	int nBins = int(floor(Emax/dE)) - binMin + 1;
+	std::vector<double> dos(nBins, 0.), tdos(haveP ? 6*nBins : 0, 0.);
+	double w = e.eInfo.spinWeight / (nk*dE); //histogram weight per state
+	std::vector<double> fermiRecords; //k (3), E and v (3) for states near the Fermi level
+
+	//Process k-points divided over processes, in blocks that are transformed by a single matrix product and diagonalized together:
+	int ikStart, ikStop;
+	TaskDivision(nk, mpiWorld).myRange(ikStart, ikStop);
+	int kBlockSize = std::max(1, (1<<22)/(nCentersSq*(haveP ? 4 : 1))); //bound memory of transformed block
+	for(int ikBlockStart=ikStart; ikBlockStart<ikStop; ikBlockStart+=kBlockSize)
+	{	int ikBlockStop = std::min(ikStop, ikBlockStart+kBlockSize);
+		int nkBlock = ikBlockStop - ikBlockStart;
+		//Fourier transform:
+		std::vector<vector3<>> kArr(nkBlock);
+		matrix phase(nCells, nkBlock);
+		complex* phaseData = phase.data();
+		for(int ik=0; ik<nkBlock; ik++)
+		{	int ikMesh = ikBlockStart + ik;
+			vector3<int> iMesh;
+			iMesh[2] = ikMesh % mesh[2]; ikMesh /= mesh[2];
+			iMesh[1] = ikMesh % mesh[1]; ikMesh /= mesh[1];
+			iMesh[0] = ikMesh;
+			for(int j=0; j<3; j++) kArr[ik][j] = double(iMesh[j]) / mesh[j];
+			for(int iCell=0; iCell<nCells; iCell++)
+				*(phaseData++) = cis(2*M_PI*dot(kArr[ik], iRarr[iCell]));
+		}
+		matrix Hk = H * phase;
+		matrix Pk; if(haveP) Pk = P * phase;
+		//Diagonalize:
+		std::vector<matrix> M(nkBlock), evecs(nkBlock);
+		std::vector<diagMatrix> eigs(nkBlock);
+		for(int ik=0; ik<nkBlock; ik++)
+		{	M[ik] = Hk(0,nCentersSq, ik,ik+1);
+			M[ik].reshape(nCenters, nCenters);
+			M[ik] = dagger_symmetrize(M[ik]);
+		}
+		diagonalizeBatch(M, evecs, eigs, 0, nkBlock);
+		//Accumulate histograms:
+		for(int ik=0; ik<nkBlock; ik++)
+		{	std::vector<vector3<>> v(nCenters);
+			if(haveP)
+				for(int iDir=0; iDir<3; iDir++)
+				{	matrix Pdir = Pk(iDir*nCentersSq,(iDir+1)*nCentersSq, ik,ik+1);
+					Pdir.reshape(nCenters, nCenters);
+					matrix PdirEig = dagger(evecs[ik]) * Pdir * evecs[ik];
+					for(int b=0; b<nCenters; b++)
+						v[b][iDir] = PdirEig(b,b).imag(); //momentum = -i [r,H] (the iota dropped in mlwfP)
+				}
+			for(int b=0; b<nCenters; b++)
+			{	double E = eigs[ik][b];
+				int iBin = int(floor(E/dE)) - binMin;
+				if(iBin<0 || iBin>=nBins) continue; //cannot happen, up to roundoff
+				dos[iBin] += w;
+				if(haveP)
+				{	const vector3<>& vb = v[b];
+					double* t = tdos.data() + 6*iBin;
+					t[0] += w*vb[0]*vb[0]; t[1] += w*vb[1]*vb[1]; t[2] += w*vb[2]*vb[2];
+					t[3] += w*vb[1]*vb[2]; t[4] += w*vb[2]*vb[0]; t[5] += w*vb[0]*vb[1];
+				}
+				if(fermiOut && fabs(E-wannier.fermiMu) < wannier.fermiWidth)
+				{	for(int j=0; j<3; j++) fermiRecords.push_back(kArr[ik][j]);
+					fermiRecords.push_back(E);
+					for(int j=0; j<3; j++) fermiRecords.push_back(v[b][j]);
+				}
+			}
+		}
+	}
+	mpiWorld->allReduceData(dos, MPIUtil::ReduceSum);
+	if(haveP) mpiWorld->allReduceData(tdos, MPIUtil::ReduceSum);
+	logPrintf("done.\n"); logFlush();
+
+	//Write DOS:
+	if(mpiWorld->isHead())
+	{	string fname = wannier.getFilename(Wannier::FilenameDump, "mlwfInterpDOS", &iSpin);
+		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp) die_alone("could not open file for writing.\n");
+		fprintf(fp, "#E[Eh] DOS[1/Eh]%s\n", haveP ? " TDOS_xx TDOS_yy TDOS_zz TDOS_yz TDOS_zx TDOS_xy" : "");
+		for(int iBin=0; iBin<nBins; iBin++)
+		{	fprintf(fp, "%+.10le %.10le", (binMin+iBin+0.5)*dE, dos[iBin]);
+			if(haveP)
+				for(int j=0; j<6; j++)
+					fprintf(fp, " %+.10le", tdos[6*iBin+j]);
+			fprintf(fp, "\n");
+		}
+		fclose(fp);
+		logPrintf("done.\n"); logFlush();
+	}
+
+	//Write Fermi-surface states (each process at its offset, in order of k):
+	if(fermiOut)
+	{	string fname = wannier.getFilename(Wannier::FilenameDump, "mlwfInterpFermi", &iSpin);
+		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
+		std::vector<int> nRecords(mpiWorld->nProcesses(), 0);
+		nRecords[mpiWorld->iProcess()] = fermiRecords.size() / 7;
+		mpiWorld->allReduceData(nRecords, MPIUtil::ReduceSum);
+		size_t offset = 0, nRecordsTot = 0;
+		for(int jProcess=0; jProcess<mpiWorld->nProcesses(); jProcess++)
+		{	if(jProcess < mpiWorld->iProcess()) offset += nRecords[jProcess];
+			nRecordsTot += nRecords[jProcess];
+		}
+		MPIUtil::File fp; mpiWorld->fopenWrite(fp, fname.c_str());
+		mpiWorld->fseek(fp, offset*7*sizeof(double), SEEK_SET);
+		mpiWorld->fwriteData(fermiRecords, fp);
+		mpiWorld->fclose(fp);
+		logPrintf("done (%lu states).\n", nRecordsTot); logFlush();
+	}
+	watch.stop();
+}
@@ -40,6 +40,81 @@ inline void slabWeight_thread(size_t iStart, size_t iStop, const vector3<int>& S
 	)
 }
 
+//Write the box [iStart,iStart+nBox) of a real-space field on grid S to fp slab by slab (in x),
+//converting each slab to little-endian in a buffer, so that each write is a single contiguous call.
+//If realPartOnly, only the real parts are written (as doubles); otherwise the complex values.
+static bool writeBoxLE(FILE* fp, const complex* data, const vector3<int>& S, const vector3<int>& iStart, const vector3<int>& nBox, bool realPartOnly)
+{	size_t nSlab = size_t(nBox[1])*nBox[2];
+	std::vector<double> buf(realPartOnly ? nSlab : 2*nSlab);
+	for(int i0=iStart[0]; i0<iStart[0]+nBox[0]; i0++)
+	{	double* bufPtr = buf.data();
+		for(int i1=iStart[1]; i1<iStart[1]+nBox[1]; i1++)
+		{	const complex* row = data + S[2]*(i1 + S[1]*size_t(i0)) + iStart[2];
+			for(int i2=0; i2<nBox[2]; i2++)
+			{	*(bufPtr++) = row[i2].real();
+				if(!realPartOnly) *(bufPtr++) = row[i2].imag();
+			}
+		}
+		convertToLE(buf.data(), sizeof(double), buf.size());
+		if(fwrite(buf.data(), sizeof(double), buf.size(), fp) != buf.size()) return false;
+	}
+	return true;
+}
+
+//Streaming writer for the sparse cell-map format (see command wannier, key sparseOutput), used on head alone.
+//Matrices are passed in the same order as the dense output, and are split into nCenters x nCenters blocks,
+//of which only those with some element above threshold in magnitude are written; the index follows the data.
+class SparseBlockWriter
+{	FILE* fp;
+	int nCenters; bool realPartOnly; double threshold;
+	std::vector<uint64_t> iBlockKept; //dense index of each retained block
+	uint64_t iBlockNext, nBlocksTotal;
+public:
+	SparseBlockWriter(string fname, int nCenters, bool realPartOnly, double threshold, uint64_t nBlocksTotal)
+	: nCenters(nCenters), realPartOnly(realPartOnly), threshold(threshold), iBlockNext(0), nBlocksTotal(nBlocksTotal)
+	{	fp = fopen(fname.c_str(), "wb");
+		if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
+		const char magic[8] = {'J','D','F','T','X','S','P','M'};
+		int32_t header32[2] = { nCenters, int32_t(realPartOnly ? sizeof(double) : sizeof(complex)) };
+		uint64_t header64[2] = { nBlocksTotal, 32 };
+		fwrite(magic, 1, 8, fp);
+		fwriteLE(header32, sizeof(int32_t), 2, fp);
+		fwriteLE(header64, sizeof(uint64_t), 2, fp);
+	}
+	
+	void write(const matrix& M)
+	{	size_t blockSize = nCenters*nCenters;
+		assert(M.nData() % blockSize == 0);
+		const complex* data = M.data();
+		std::vector<double> buf(realPartOnly ? blockSize : 2*blockSize);
+		for(size_t iStart=0; iStart<M.nData(); iStart+=blockSize)
+		{	const complex* block = data + iStart;
+			double maxAbs = 0.;
+			for(size_t i=0; i<blockSize; i++)
+				maxAbs = std::max(maxAbs, realPartOnly ? fabs(block[i].real()) : block[i].abs());
+			if(maxAbs > threshold)
+			{	if(realPartOnly)
+					for(size_t i=0; i<blockSize; i++) buf[i] = block[i].real();
+				else
+					eblas_copy((complex*)buf.data(), block, blockSize);
+				fwriteLE(buf.data(), sizeof(double), buf.size(), fp);
+				iBlockKept.push_back(iBlockNext);
+			}
+			iBlockNext++;
+		}
+	}
+	
+	//Write index, close file and return number of blocks retained:
+	size_t close()
+	{	assert(iBlockNext == nBlocksTotal);
+		uint64_t nKept = iBlockKept.size();
+		fwriteLE(iBlockKept.data(), sizeof(uint64_t), nKept, fp);
+		fwriteLE(&nKept, sizeof(uint64_t), 1, fp);
+		fclose(fp);
+		return nKept;
+	}
+};
+
 void WannierMinimizer::saveMLWF()
 {	for(int iSpin: wannier.iSpinArr)
 	{	logPrintf("\n");
@@ -465,32 +540,94 @@ void WannierMinimizer::saveMLWF(int iSpin)
 			logPrintf("done.\n"); logFlush();
 		}
 		
-		//--- Save supercell wavefunctions in real space:
-		if(mpiWorld->isHead() && wannier.saveWfnsRealSpace) for(int n=0; n<nCenters; n++) for(int s=0; s<nSpinor; s++)
-		{	//Generate filename
-			ostringstream varName;
-			varName << (nSpinor*n+s) << ".mlwf";
-			string fname = wannier.getFilename(Wannier::FilenameDump, varName.str(), &iSpin);
-			logPrintf("Dumping '%s':\n", fname.c_str());
-			//Convert to real space and optionally remove phase:
-			complexScalarField psi = I(Csuper.getColumn(n,s));
-			if(qnumSuper.k.length_squared() > symmThresholdSq)
-				multiplyBlochPhase(psi, qnumSuper.k);
-			if(realPartOnly)
-			{	complex* psiData = psi->data();
-				double meanPhase, sigmaPhase, rmsImagErr;
-				removePhase(gInfoSuper.nr, psiData, meanPhase, sigmaPhase, rmsImagErr);
-				logPrintf("\tPhase = %lf +/- %lf\n", meanPhase, sigmaPhase); logFlush();
-				logPrintf("\tRMS imaginary part = %le (after phase removal)\n", rmsImagErr);
-				logFlush();
-				//Write real part of supercell wavefunction to file:
+		//--- Save supercell wavefunctions in real space (columns divided over processes):
+		if(wannier.saveWfnsRealSpace)
+		{	int nColumns = nCenters*nSpinor;
+			TaskDivision colDivision(nColumns, mpiWorld);
+			const vector3<int>& S = gInfoSuper.S;
+			std::vector<double> phaseMean(nColumns), phaseSigma(nColumns), imagErr(nColumns); //phase statistics (realPartOnly)
+			std::vector<int> boxArr(6*nColumns); //offset and size of output box of each column
+			bool success = true;
+			logPrintf("Dumping real-space supercell wavefunctions '%s' ... ",
+				wannier.getFilename(Wannier::FilenameDump, "<n>.mlwf", &iSpin).c_str()); logFlush();
+			for(int iCol=colDivision.start(); iCol<int(colDivision.stop()); iCol++)
+			{	int n = iCol / nSpinor;
+				int s = iCol - n*nSpinor;
+				//Generate filename:
+				ostringstream varName;
+				varName << iCol << ".mlwf";
+				string fname = wannier.getFilename(Wannier::FilenameDump, varName.str(), &iSpin);
+				//Convert to real space and optionally remove phase:
+				complexScalarField psi = I(Csuper.getColumn(n,s));
+				if(qnumSuper.k.length_squared() > symmThresholdSq)
+					multiplyBlochPhase(psi, qnumSuper.k);
+				complex* psiData = psi->data();
+				if(realPartOnly)
+					removePhase(gInfoSuper.nr, psiData, phaseMean[iCol], phaseSigma[iCol], imagErr[iCol]);
+				//Determine output box:
+				vector3<int> iOffset, nBox = S;
+				if(wannier.cropWfnsRealSpace)
+				{	double normSqMax = 0.;
+					for(int i=0; i<gInfoSuper.nr; i++)
+						normSqMax = std::max(normSqMax, realPartOnly ? std::pow(psiData[i].real(),2) : psiData[i].norm());
+					double normSqCut = std::pow(wannier.cropWfnsRealSpace,2) * normSqMax;
+					vector3<int> iMin = S, iMax(-1,-1,-1);
+					size_t i = 0;
+					vector3<int> iv;
+					for(iv[0]=0; iv[0]<S[0]; iv[0]++)
+					for(iv[1]=0; iv[1]<S[1]; iv[1]++)
+					for(iv[2]=0; iv[2]<S[2]; iv[2]++)
+					{	double normSq = realPartOnly ? std::pow(psiData[i].real(),2) : psiData[i].norm();
+						if(normSq > normSqCut)
+							for(int k=0; k<3; k++)
+							{	iMin[k] = std::min(iMin[k], iv[k]);
+								iMax[k] = std::max(iMax[k], iv[k]);
+							}
+						i++;
+					}
+					iOffset = iMin;
+					nBox = iMax - iMin + vector3<int>(1,1,1);
+				}
+				for(int k=0; k<3; k++)
+				{	boxArr[6*iCol+k] = iOffset[k];
+					boxArr[6*iCol+3+k] = nBox[k];
+				}
+				//Write (real part of) supercell wavefunction to file:
 				FILE* fp = fopen(fname.c_str(), "wb");
-				if(!fp) die("Failed to open file '%s' for binary write.\n", fname.c_str());
-				for(int i=0; i<gInfoSuper.nr; i++)
-					fwriteLE(psiData+i, sizeof(double), 1, fp);
-				fclose(fp);
+				if(!fp || !writeBoxLE(fp, psiData, S, iOffset, nBox, realPartOnly)) success = false;
+				if(fp) fclose(fp);
+				if(wannier.cropWfnsRealSpace)
+				{	fp = fopen((fname + ".box").c_str(), "w");
+					if(fp)
+					{	fprintf(fp, "%d %d %d #offset\n", iOffset[0], iOffset[1], iOffset[2]);
+						fprintf(fp, "%d %d %d #box dimensions\n", nBox[0], nBox[1], nBox[2]);
+						fprintf(fp, "%d %d %d #supercell grid dimensions\n", S[0], S[1], S[2]);
+						fclose(fp);
+					}
+					else success = false;
+				}
 			}
-			else saveRawBinary(psi, fname.c_str());
+			mpiWorld->allReduce(success, MPIUtil::ReduceLAnd);
+			if(!success) die("Failed to write one or more real-space supercell wavefunction files.\n");
+			mpiWorld->allReduceData(phaseMean, MPIUtil::ReduceSum);
+			mpiWorld->allReduceData(phaseSigma, MPIUtil::ReduceSum);
+			mpiWorld->allReduceData(imagErr, MPIUtil::ReduceSum);
+			mpiWorld->allReduceData(boxArr, MPIUtil::ReduceSum);
+			logPrintf("done.\n");
+			//Report per-column statistics:
+			for(int iCol=0; iCol<nColumns; iCol++)
+			{	if(!realPartOnly && !wannier.cropWfnsRealSpace) break;
+				logPrintf("\tmlwf %d:", iCol);
+				if(realPartOnly)
+					logPrintf(" Phase = %lf +/- %lf, RMS imaginary part = %le (after phase removal).",
+						phaseMean[iCol], phaseSigma[iCol], imagErr[iCol]);
+				if(wannier.cropWfnsRealSpace)
+				{	const int* box = boxArr.data() + 6*iCol;
+					logPrintf(" Box offset [ %d %d %d ] dimensions [ %d %d %d ].", box[0], box[1], box[2], box[3], box[4], box[5]);
+				}
+				logPrintf("\n");
+			}
+			logFlush();
 		}
 		suspendOperatorThreading();
 	}
@@ -521,6 +658,8 @@ void WannierMinimizer::saveMLWF(int iSpin)
 		nqMine++;
 	nqMine = std::max(nqMine,1); //avoid zero size matrices below
 	matrix phase = zeroes(nqMine, iCellMap.size());
+	bool interpolate = wannier.interpMesh.length_squared(); //whether to interpolate bands on a dense k-mesh below
+	matrix Hwannier; //Wannierized Hamiltonian retained for interpolation (if needed)
 	{	matrix HwannierTilde = zeroes(nCenters*nCenters, nqMine);
 		int iqMine = 0;
 		for(unsigned i=0; i<kMesh.size(); i++) if(isMine_q(i,iSpin))
@@ -534,18 +673,18 @@ void WannierMinimizer::saveMLWF(int iSpin)
 			iqMine++;
 		}
 		//Fourier transform to Wannier space and save
-		dumpWannierized(HwannierTilde, iCellMap, phase, 1, "mlwfH", realPartOnly, iSpin);
+		dumpWannierized(HwannierTilde, iCellMap, phase, 1, "mlwfH", realPartOnly, iSpin, interpolate ? &Hwannier : 0);
 	}
 	resumeOperatorThreading();
 	
 	//Save momenta in Wannier basis:
+	matrix Pwannier; //Wannierized momenta retained for interpolation (if needed)
 	if(wannier.saveMomenta)
 	{	//--- compute momentum matrix elements of Bloch states:
 		std::vector<vector3<matrix>> pBloch(e.eInfo.nStates);
 		for(int q=e.eInfo.qStart; q<e.eInfo.qStop; q++)
 			if(e.eInfo.qnums[q].index()==iSpin)
-				for(int iDir=0; iDir<3; iDir++)
-					pBloch[q][iDir] = e.iInfo.rHcommutator(e.eVars.C[q], iDir, e.eVars.Hsub_eigs[q]); //note factor of -iota dropped to make it real (and anti-symmetric)
+				pBloch[q] = e.iInfo.rHcommutator(e.eVars.C[q], e.eVars.Hsub_eigs[q]); //note factor of -iota dropped to make it real (and anti-symmetric)
 		//--- convert to Wannier basis:
 		matrix pWannierTilde = zeroes(nCenters*nCenters*3, nqMine);
 		int iqMine = 0;
@@ -565,8 +704,9 @@ void WannierMinimizer::saveMLWF(int iSpin)
 			iqMine++;
 		}
 		//Fourier transform to Wannier space and save
-		dumpWannierized(pWannierTilde, iCellMap, phase, 3, "mlwfP", realPartOnly, iSpin);
+		dumpWannierized(pWannierTilde, iCellMap, phase, 3, "mlwfP", realPartOnly, iSpin, interpolate ? &Pwannier : 0);
 	}
+	if(interpolate) interpolateBands(iSpin, iCellMap, Hwannier, Pwannier);
 	
 	//Save spin in Wannier basis:
 	if(wannier.saveSpin)
@@ -929,9 +1069,16 @@ void WannierMinimizer::saveMLWF(int iSpin)
 		string fname = wannier.getFilename(Wannier::FilenameDump, "mlwfHePh", &iSpin);
 		logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
 		FILE* fp = 0;
+		std::shared_ptr<SparseBlockWriter> sparseWriter;
+		uint64_t nBlocksTotal = uint64_t(ePhCellMap.size())*phononCellMap.size()*nPhononModes; //same as number of matrices in dense output
 		if(mpiWorld->isHead())
-		{	fp = fopen(fname.c_str(), "wb");
-			if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
+		{	if(wannier.sparseThreshold)
+				sparseWriter = std::make_shared<SparseBlockWriter>(fname+".sparse", nCenters, realPartOnly,
+					wannier.sparseThreshold, nBlocksTotal);
+			else
+			{	fp = fopen(fname.c_str(), "wb");
+				if(!fp) die_alone("Error opening %s for writing.\n", fname.c_str());
+			}
 		}
 		matrix phase = zeroes(nPairsMine, phononCellMap.size());
 		double kPairWeight = 1./prodPhononSup;
@@ -963,13 +1110,24 @@ void WannierMinimizer::saveMLWF(int iSpin)
 					}
 				}
 			if(realPartOnly)
-			{	if(mpiWorld->isHead()) HePh.write_real(fp);
-				nrm2totSq += std::pow(nrm2(HePh), 2); 
+			{	nrm2totSq += std::pow(nrm2(HePh), 2); 
 				nrm2imSq += std::pow(callPref(eblas_dnrm2)(HePh.nData(), ((double*)HePh.dataPref())+1, 2), 2); //look only at imaginary parts with a stride of 2
 			}
-			else { if(mpiWorld->isHead()) HePh.write(fp); }
+			if(mpiWorld->isHead())
+			{	if(sparseWriter) sparseWriter->write(HePh);
+				else if(realPartOnly) HePh.write_real(fp);
+				else HePh.write(fp);
+			}
+		}
+		size_t nKept = 0;
+		if(mpiWorld->isHead())
+		{	if(sparseWriter) nKept = sparseWriter->close();
+			else fclose(fp);
+		}
+		if(wannier.sparseThreshold)
+		{	mpiWorld->bcast(nKept);
+			logPrintf("(kept %lu of %lu blocks in '%s.sparse') ", nKept, size_t(nBlocksTotal), fname.c_str());
 		}
-		if(mpiWorld->isHead()) fclose(fp);
 		if(realPartOnly)
 			logPrintf("done. Relative discarded imaginary part: %le\n", sqrt(nrm2imSq / nrm2totSq));
 		else
@@ -979,19 +1137,26 @@ void WannierMinimizer::saveMLWF(int iSpin)
 
 
 void WannierMinimizer::dumpWannierized(const matrix& Htilde, const std::map<vector3<int>,matrix>& iCellMap,
-	const matrix& phase, int nMatrices, string varName, bool realPartOnly, int iSpin) const
+	const matrix& phase, int nMatrices, string varName, bool realPartOnly, int iSpin, matrix* Hout) const
 {
 	string fname = wannier.getFilename(Wannier::FilenameDump, varName, &iSpin);
 	logPrintf("Dumping '%s' ... ", fname.c_str()); logFlush();
 	FILE* fp = 0; auto cmIter = iCellMap.begin();
+	int nCells = iCellMap.size();
+	std::shared_ptr<SparseBlockWriter> sparseWriter;
 	if(mpiWorld->isHead())
-	{	fp = fopen(fname.c_str(), "w");
-		if(!fp) die_alone("could not open file for writing.\n");
+	{	if(wannier.sparseThreshold)
+			sparseWriter = std::make_shared<SparseBlockWriter>(fname+".sparse", nCenters, realPartOnly,
+				wannier.sparseThreshold, uint64_t(nCells)*nMatrices);
+		else
+		{	fp = fopen(fname.c_str(), "w");
+			if(!fp) die_alone("could not open file for writing.\n");
+		}
 	}
 	//Determine block size:
-	int nCells = iCellMap.size();
 	int blockSize = ceildiv(nCells, mpiWorld->nProcesses()); //so that memory before and after FT roughly similar
 	int nBlocks = ceildiv(nCells, blockSize);
+	if(Hout) *Hout = zeroes(Htilde.nRows(), nCells);
 	//Loop over blocks:
 	int iCellStart = 0;
 	double nrm2totSq = 0., nrm2imSq = 0.;
@@ -1013,13 +1178,27 @@ void WannierMinimizer::dumpWannierized(const matrix& Htilde, const std::map<vect
 			if(realPartOnly)
 			{	nrm2totSq += std::pow(nrm2(Hblock), 2); 
 				nrm2imSq += std::pow(callPref(eblas_dnrm2)(Hblock.nData(), ((double*)Hblock.dataPref())+1, 2), 2); //imaginary parts with a stride of 2
-				Hblock.write_real(fp);
 			}
+			if(sparseWriter) sparseWriter->write(Hblock);
+			else if(realPartOnly) Hblock.write_real(fp);
 			else Hblock.write(fp);
+			if(Hout)
+			{	if(realPartOnly) callPref(eblas_dscal)(Hblock.nData(), 0., ((double*)Hblock.dataPref())+1, 2); //same as written
+				Hout->set(0,Hblock.nRows(), iCellStart,iCellStop, Hblock);
+			}
 		}
 		iCellStart = iCellStop;
 	}
-	if(mpiWorld->isHead()) fclose(fp);
+	if(Hout) mpiWorld->bcastData(*Hout);
+	size_t nKept = 0;
+	if(mpiWorld->isHead())
+	{	if(sparseWriter) nKept = sparseWriter->close();
+		else fclose(fp);
+	}
+	if(wannier.sparseThreshold)
+	{	mpiWorld->bcast(nKept);
+		logPrintf("(kept %lu of %lu blocks in '%s.sparse') ", nKept, size_t(nCells)*nMatrices, fname.c_str());
+	}
 	if(realPartOnly)
 	{	mpiWorld->bcast(nrm2totSq);
 		mpiWorld->bcast(nrm2imSq);
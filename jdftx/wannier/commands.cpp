@@ -30,16 +30,22 @@ enum WannierMember
 	WM_frozenCenters,
 	WM_saveWfns,
 	WM_saveWfnsRealSpace,
+	WM_cropWfnsRealSpace,
 	WM_saveMomenta,
 	WM_saveSpin,
+	WM_sparseOutput,
 	WM_slabWeight,
 	WM_loadRotations,
+	WM_loadOverlaps,
 	WM_eigsOverride,
 	WM_numericalOrbitals,
 	WM_numericalOrbitalsOffset,
 	WM_phononSup,
 	WM_rSmooth,
 	WM_wrapWignerSeitz,
+	WM_interpolateMesh,
+	WM_interpolateBinWidth,
+	WM_fermiSurface,
 	WM_spinMode,
 	WM_delim
 };
@@ -53,16 +59,22 @@ EnumStringMap<WannierMember> wannierMemberMap
 	WM_frozenCenters, "frozenCenters",
 	WM_saveWfns, "saveWfns",
 	WM_saveWfnsRealSpace, "saveWfnsRealSpace",
+	WM_cropWfnsRealSpace, "cropWfnsRealSpace",
 	WM_saveMomenta, "saveMomenta",
 	WM_saveSpin, "saveSpin",
+	WM_sparseOutput, "sparseOutput",
 	WM_slabWeight, "slabWeight",
 	WM_loadRotations, "loadRotations",
+	WM_loadOverlaps, "loadOverlaps",
 	WM_eigsOverride, "eigsOverride",
 	WM_numericalOrbitals, "numericalOrbitals",
 	WM_numericalOrbitalsOffset, "numericalOrbitalsOffset",
 	WM_phononSup, "phononSupercell",
 	WM_rSmooth, "rSmooth",
 	WM_wrapWignerSeitz, "wrapWignerSeitz",
+	WM_interpolateMesh, "interpolateMesh",
+	WM_interpolateBinWidth, "interpolateBinWidth",
+	WM_fermiSurface, "fermiSurface",
 	WM_spinMode, "spinMode"
 );
 
@@ -122,7 +134,13 @@ struct CommandWannier : public Command
 			"   Default: no.\n"
 			"\n+ saveWfnsRealSpace yes|no\n\n"
 			"   Whether to write supercell wavefunctions band-by-band in real space (can be enormous).\n"
+			"   The files are written in parallel, with each process handling a subset of the centers.\n"
 			"   Default: no.\n"
+			"\n+ cropWfnsRealSpace <threshold>\n\n"
+			"   If non-zero, write each real-space supercell wavefunction only within the smallest\n"
+			"   box of grid points containing all values with |psi| > threshold * max|psi|, and write\n"
+			"   the offset and dimensions of that box to a text file with extension '.box' alongside.\n"
+			"   Default: 0 (write the full supercell grid).\n"
 			"\n+ saveMomenta yes|no\n\n"
 			"   Whether to write momentum matrix elements in the same format as Hamiltonian.\n"
 			"   The output is real and antisymmetric (drops the iota so as to half the output size).\n"
@@ -130,6 +148,17 @@ struct CommandWannier : public Command
 			"\n+ saveSpin yes|no\n\n"
 			"   Whether to write spin matrix elements (for non-collinear calculations only).\n"
 			"   Default: no.\n"
+			"\n+ sparseOutput <threshold>\n\n"
+			"   If non-zero, write Wannierized matrix elements (mlwfH, mlwfP, mlwfS, mlwfHePh etc.)\n"
+			"   in a sparse indexed format to <file>.sparse in place of the dense files, keeping only\n"
+			"   those nCenters x nCenters blocks (one per cell and component, in the dense order)\n"
+			"   with at least one element larger than <threshold> in magnitude (atomic units).\n"
+			"   The file contains a 32-byte little-endian header (char[8] magic 'JDFTXSPM',\n"
+			"   int32 nCenters, int32 bytes per element: 8 if real or 16 if complex, uint64\n"
+			"   total number of blocks in the dense order, uint64 data offset), followed by the\n"
+			"   retained blocks (column-major, contiguous), and finally the uint64 dense index\n"
+			"   of each retained block in increasing order, and the uint64 number retained.\n"
+			"   Default: 0 (dense output).\n"
 			"\n+ slabWeight <z0> <zH> <zSigma>\n\n"
 			"   If specified, output the Wannier matrix elements of a slab weight function\n"
 			"   centered at z0 (lattice coordinates) with half-width zH (lattice coordinates)\n"
@@ -137,6 +166,11 @@ struct CommandWannier : public Command
 			"\n+ loadRotations yes|no\n\n"
 			"   Whether to load rotations (.mlwU and .mlwfU2) from a previous %Wannier run.\n"
 			"   Default: no.\n"
+			"\n+ loadOverlaps yes|no\n\n"
+			"   Whether to reuse the finite-difference overlap matrices (mlwfM0) from a previous\n"
+			"   %Wannier run on the same wavefunctions, if available; these do not depend on the\n"
+			"   trial orbitals, energy windows or frozen centers, which may therefore be changed.\n"
+			"   (Always reused along with rotations when loadRotations is set.) Default: no.\n"
 			"\n+ eigsOverride <filename>\n\n"
 			"   Optionally read an alternate eigenvalues file to over-ride those from the total\n"
 			"   energy calculation. Useful for generating Wannier Hamiltonians using eigenvalues\n"
@@ -164,6 +198,19 @@ struct CommandWannier : public Command
 			"   so as to minimize the number of cells in the Wannier-basis output.  As a consequence,\n"
 			"   however, minimized Wannier centers may differ from the guesses by some lattice vector.\n"
 			"   Default: no.\n"
+			"\n+ interpolateMesh <N0> <N1> <N2>\n\n"
+			"   If specified, Fourier interpolate the Wannier Hamiltonian (and momenta, if saveMomenta)\n"
+			"   to a uniform Gamma-centered k-mesh of these dimensions, with the k-points divided over\n"
+			"   processes in blocks that are transformed and diagonalized together. Outputs mlwfInterpDOS,\n"
+			"   with columns energy [Eh], density of states [per Eh per unit cell, including the spin\n"
+			"   weight], and if saveMomenta, the transport DOS sum_n v_i v_j delta(E-E_n) in the same\n"
+			"   units times velocity^2 [atomic units] for ij = xx, yy, zz, yz, zx and xy.\n"
+			"\n+ interpolateBinWidth <dE>\n\n"
+			"   Energy bin width (in Eh) for mlwfInterpDOS (default 1e-4).\n"
+			"\n+ fermiSurface <mu> <dE>\n\n"
+			"   With interpolateMesh and saveMomenta, write the interpolated states with energy within\n"
+			"   <dE> of <mu> (both in Eh) to mlwfInterpFermi, as binary records of 7 doubles:\n"
+			"   k0 k1 k2 (lattice coordinates), energy, and Cartesian velocity vx vy vz.\n"
 			"\n+ spinMode" + spinModeMap.optionList() + "\n\n"
 			"   If Up or Dn, only generate Wannier functions for that spin channel, allowing\n"
 			"   different input files for each channel (independent centers, windows etc.).\n"
@@ -208,6 +255,10 @@ struct CommandWannier : public Command
 				case WM_saveWfnsRealSpace:
 					pl.get(wannier.saveWfnsRealSpace, false, boolMap, "saveWfnsRealSpace", true);
 					break;
+				case WM_cropWfnsRealSpace:
+					pl.get(wannier.cropWfnsRealSpace, 0., "threshold", true);
+					if(wannier.cropWfnsRealSpace<0. || wannier.cropWfnsRealSpace>=1.) throw string("threshold must be in [0,1)");
+					break;
 				case WM_saveMomenta:
 					pl.get(wannier.saveMomenta, false, boolMap, "saveMomenta", true);
 					break;
@@ -216,6 +267,10 @@ struct CommandWannier : public Command
 					if(wannier.saveSpin and not e.eInfo.isNoncollinear())
 						throw string("saveSpin requires noncollinear spin mode");
 					break;
+				case WM_sparseOutput:
+					pl.get(wannier.sparseThreshold, 0., "threshold", true);
+					if(wannier.sparseThreshold < 0.) throw string("<threshold> must be non-negative");
+					break;
 				case WM_slabWeight:
 					pl.get(wannier.z0, 0., "z0", true);
 					pl.get(wannier.zH, 0., "zH", true);
@@ -224,6 +279,9 @@ struct CommandWannier : public Command
 				case WM_loadRotations:
 					pl.get(wannier.loadRotations, false, boolMap, "loadRotations", true);
 					break;
+				case WM_loadOverlaps:
+					pl.get(wannier.loadOverlaps, false, boolMap, "loadOverlaps", true);
+					break;
 				case WM_eigsOverride:
 					pl.get(wannier.eigsFilename, string(), "filename", true);
 					break;
@@ -247,6 +305,22 @@ struct CommandWannier : public Command
 				case WM_wrapWignerSeitz:
 					pl.get(wannier.wrapWS, false, boolMap, "wrapWignerSeitz", true);
 					break;
+				case WM_interpolateMesh:
+					for(int j=0; j<3; j++)
+					{	char paramName[8]; sprintf(paramName, "N%d", j);
+						pl.get(wannier.interpMesh[j], 0, paramName, true);
+						if(wannier.interpMesh[j] <= 0) throw string("interpolation mesh dimensions must be positive");
+					}
+					break;
+				case WM_interpolateBinWidth:
+					pl.get(wannier.interpBinWidth, 0., "dE", true);
+					if(wannier.interpBinWidth <= 0.) throw string("<dE> must be positive");
+					break;
+				case WM_fermiSurface:
+					pl.get(wannier.fermiMu, 0., "mu", true);
+					pl.get(wannier.fermiWidth, 0., "dE", true);
+					if(wannier.fermiWidth <= 0.) throw string("<dE> must be positive");
+					break;
 				case WM_spinMode:
 					pl.get(wannier.spinMode, Wannier::SpinAll,  spinModeMap, "spinMode", true);
 					if(e.eInfo.spinType!=SpinZ && wannier.spinMode!=Wannier::SpinAll)
@@ -264,11 +338,16 @@ struct CommandWannier : public Command
 		logPrintf(" \\\n\tprecondition %s", boolMap.getString(wannier.precond));
 		logPrintf(" \\\n\tsaveWfns %s", boolMap.getString(wannier.saveWfns));
 		logPrintf(" \\\n\tsaveWfnsRealSpace %s", boolMap.getString(wannier.saveWfnsRealSpace));
+		if(wannier.cropWfnsRealSpace)
+			logPrintf(" \\\n\tcropWfnsRealSpace %lg", wannier.cropWfnsRealSpace);
 		logPrintf(" \\\n\tsaveMomenta %s", boolMap.getString(wannier.saveMomenta));
 		logPrintf(" \\\n\tsaveSpin %s", boolMap.getString(wannier.saveSpin));
+		if(wannier.sparseThreshold)
+			logPrintf(" \\\n\tsparseOutput %lg", wannier.sparseThreshold);
 		if(wannier.zH)
 			logPrintf(" \\\n\tslabWeight %lg %lg %lg", wannier.z0, wannier.zH, wannier.zSigma);
 		logPrintf(" \\\n\tloadRotations %s", boolMap.getString(wannier.loadRotations));
+		logPrintf(" \\\n\tloadOverlaps %s", boolMap.getString(wannier.loadOverlaps));
 		if(wannier.eigsFilename.length())
 			logPrintf(" \\\n\teigsFilename %s", wannier.eigsFilename.c_str());
 		if(wannier.outerWindow)
@@ -290,6 +369,12 @@ struct CommandWannier : public Command
 			logPrintf(" \\\n\tphononSupercell %d %d %d", wannier.phononSup[0], wannier.phononSup[1], wannier.phononSup[2]);
 		logPrintf(" \\\n\trSmooth %lg", wannier.rSmooth);
 		logPrintf(" \\\n\twrapWignerSeitz %s", boolMap.getString(wannier.wrapWS));
+		if(wannier.interpMesh.length_squared())
+		{	logPrintf(" \\\n\tinterpolateMesh %d %d %d", wannier.interpMesh[0], wannier.interpMesh[1], wannier.interpMesh[2]);
+			logPrintf(" \\\n\tinterpolateBinWidth %lg", wannier.interpBinWidth);
+			if(wannier.fermiWidth)
+				logPrintf(" \\\n\tfermiSurface %lg %lg", wannier.fermiMu, wannier.fermiWidth);
+		}
 		logPrintf(" \\\n\tspinMode %s", spinModeMap.getString(wannier.spinMode));
 	}
 }